@@ -21,6 +21,8 @@
 #include "dbprint.h"
 #include "pm3_cmd.h"
 #include "util.h" // nbytes
+#include "cmd.h"
+#include "parity.h"
 
 #define BIGBUF_ALIGN_BYTES (4)
 #define BIGBUF_ALIGN_MASK  (0xFFFF + 1 - BIGBUF_ALIGN_BYTES)
@@ -44,9 +46,39 @@ static uint32_t s_bigbuf_size = 0;
 // High memory mark
 static uint32_t s_bigbuf_hi = 0;
 
+// Lowest high memory mark since power up,  i.e. the most BigBuf ever allocated at once
+static uint32_t s_bigbuf_lowest_hi = 0;
+
+// Peak of allocations plus trace since BigBuf_window_reset(),  used by the memory profiler
+static uint32_t s_bigbuf_window_used = 0;
+
+// Named marks.  BigBuf_release() frees everything allocated after its mark and leaves older
+// allocations alone,  so features can keep their buffers while others come and go.
+#define BIGBUF_MAX_MARKS 8
+typedef struct {
+    const char *name;
+    uint32_t hi;    // s_bigbuf_hi when the mark was set,  the region grows down from here
+    uint32_t peak;  // lowest s_bigbuf_hi while the mark was live
+} bigbuf_mark_entry_t;
+static bigbuf_mark_entry_t s_marks[BIGBUF_MAX_MARKS];
+static uint8_t s_marks_num = 0;
+
 // pointer to the emulator memory.
 static uint8_t *emulator_memory = NULL;
 
+// Emulator memory snapshots live at the very top of BigBuf,  above the emulator memory.
+// s_bigbuf_size is lowered by what they take,  so BigBuf_free() and friends leave them alone.
+// Only emlSnapshotClear() gives the space back.
+#define EML_SNAPSHOT_MIN_FREE (8 * 1024)
+typedef struct {
+    char name[EML_SNAPSHOT_NAME_LEN];
+    uint16_t size;
+    uint32_t offset;
+} eml_snapshot_t;
+static eml_snapshot_t s_snapshots[EML_SNAPSHOT_MAX];
+static uint8_t s_snapshots_num = 0;
+static uint32_t s_bigbuf_full_size = 0;
+
 //=============================================================================
 // The ToSend buffer.
 // A buffer where we can queue things up to be sent through the FPGA, for
@@ -76,10 +108,30 @@ static dmabuf8_t dma_8 = {
 static uint32_t trace_len = 0;
 static bool tracing = true;
 
+// Ring trace mode.  The trace area is used as a byte ring and the oldest records get overwritten
+// when a new one doesn't fit.  trace_len then is the number of bytes held,  starting at trace_ring_tail.
+static bool trace_ring = false;
+static uint32_t trace_ring_size = 0;
+static uint32_t trace_ring_tail = 0;
+
+// Compact encoding,  see TRACELOG_COMPACT_*.  Stays on until the trace is cleared,
+// a trace must not mix both encodings.
+static bool trace_compact = false;
+static uint32_t trace_compact_last_ts = 0;
+
+// Streaming.  The newest trace_stream_pending bytes of the ring are not sent to the client yet.
+static bool trace_stream = false;
+static uint32_t trace_stream_pending = 0;
+static uint32_t trace_stream_dropped = 0;
+
 // compute the available size for BigBuf
 void BigBuf_initialize(void) {
     s_bigbuf_size = (uint32_t)_stack_start - (uint32_t)__bss_end__;
+    s_bigbuf_full_size = s_bigbuf_size;
+    s_snapshots_num = 0;
     s_bigbuf_hi = s_bigbuf_size;
+    s_bigbuf_lowest_hi = s_bigbuf_size;
+    s_marks_num = 0;
     trace_len = 0;
 }
 
@@ -143,6 +195,14 @@ uint8_t *BigBuf_malloc(uint16_t chunksize) {
     }
 
     s_bigbuf_hi -= chunksize;  // aligned to 4 Byte boundary
+
+    if (s_bigbuf_hi < s_bigbuf_lowest_hi) {
+        s_bigbuf_lowest_hi = s_bigbuf_hi;
+    }
+    if (s_marks_num && (s_bigbuf_hi < s_marks[s_marks_num - 1].peak)) {
+        s_marks[s_marks_num - 1].peak = s_bigbuf_hi;
+    }
+    BigBuf_window_update();
     return (uint8_t *)BigBuf + s_bigbuf_hi;
 }
 
@@ -159,6 +219,7 @@ uint8_t *BigBuf_calloc(uint16_t chunksize) {
 // free ALL allocated chunks. The whole BigBuf is available for traces or samples again.
 void BigBuf_free(void) {
     s_bigbuf_hi = s_bigbuf_size;
+    s_marks_num = 0;
     emulator_memory = NULL;
     // shouldn't this empty BigBuf also?
     toSend.buf = NULL;
@@ -173,15 +234,88 @@ void BigBuf_free_keep_EM(void) {
     else
         s_bigbuf_hi = s_bigbuf_size;
 
+    // marks set after the emulator memory are gone
+    while (s_marks_num && (s_marks[s_marks_num - 1].hi < s_bigbuf_hi)) {
+        s_marks_num--;
+    }
+
     toSend.buf = NULL;
     dma_16.buf = NULL;
     dma_8.buf = NULL;
 }
 
+// Start a new peak usage window at the current usage
+void BigBuf_window_reset(void) {
+    s_bigbuf_window_used = 0;
+    BigBuf_window_update();
+}
+
+void BigBuf_window_update(void) {
+    uint32_t used = s_bigbuf_size - s_bigbuf_hi + trace_len;
+    if (used > s_bigbuf_window_used) {
+        s_bigbuf_window_used = used;
+    }
+}
+
+uint32_t BigBuf_window_peak(void) {
+    return s_bigbuf_window_used;
+}
+
+// Set a named mark at the current allocation level.  Returns the mark to hand to BigBuf_release(),
+// or -1 when all marks are taken.
+int BigBuf_mark(const char *name) {
+    if (s_marks_num == BIGBUF_MAX_MARKS) {
+        return -1;
+    }
+    s_marks[s_marks_num].name = name;
+    s_marks[s_marks_num].hi = s_bigbuf_hi;
+    s_marks[s_marks_num].peak = s_bigbuf_hi;
+    return s_marks_num++;
+}
+
+// Free everything allocated after the mark was set,  the mark and all later ones included.
+void BigBuf_release(int mark) {
+    if ((mark < 0) || (mark >= s_marks_num)) {
+        return;
+    }
+
+    // the enclosing region saw the same peak
+    for (int i = s_marks_num - 1; i > 0 && i >= mark; i--) {
+        if (s_marks[i].peak < s_marks[i - 1].peak) {
+            s_marks[i - 1].peak = s_marks[i].peak;
+        }
+    }
+
+    s_bigbuf_hi = s_marks[mark].hi;
+    s_marks_num = mark;
+
+    // cached buffers which lived in the released region
+    uint8_t *hi = (uint8_t *)BigBuf + s_bigbuf_hi;
+    if (emulator_memory && emulator_memory < hi) {
+        emulator_memory = NULL;
+    }
+    if (toSend.buf && toSend.buf < hi) {
+        toSend.buf = NULL;
+    }
+    if (dma_16.buf && (uint8_t *)dma_16.buf < hi) {
+        dma_16.buf = NULL;
+    }
+    if (dma_8.buf && dma_8.buf < hi) {
+        dma_8.buf = NULL;
+    }
+}
+
 void BigBuf_print_status(void) {
     DbpString(_CYAN_("Memory"));
     Dbprintf("  BigBuf_size............. %d", s_bigbuf_size);
     Dbprintf("  Available memory........ %d", s_bigbuf_hi);
+    Dbprintf("  Peak allocated.......... %d", s_bigbuf_size - s_bigbuf_lowest_hi);
+    if (s_snapshots_num) {
+        Dbprintf("  EML snapshots........... %d ( %d bytes )", s_snapshots_num, s_bigbuf_full_size - s_bigbuf_size);
+    }
+    for (uint8_t i = 0; i < s_marks_num; i++) {
+        Dbprintf("  %-16s ....... in use %u  peak %u", s_marks[i].name ? s_marks[i].name : "?", s_marks[i].hi - s_bigbuf_hi, s_marks[i].hi - s_marks[i].peak);
+    }
     DbpString(_CYAN_("Tracing"));
     Dbprintf("  tracing ................ %d", tracing);
     Dbprintf("  traceLen ............... %d", trace_len);
@@ -214,6 +348,11 @@ uint16_t BigBuf_max_traceLen(void) {
 
 void clear_trace(void) {
     trace_len = 0;
+    trace_ring_size = 0;
+    trace_ring_tail = 0;
+    trace_stream_pending = 0;
+    trace_stream_dropped = 0;
+    trace_compact = false;
 }
 
 void set_tracelen(uint32_t value) {
@@ -228,6 +367,273 @@ bool get_tracing(void) {
     return tracing;
 }
 
+// pos is below 2 * trace_ring_size
+static uint32_t RAMFUNC trace_ring_pos(uint32_t pos) {
+    return (pos >= trace_ring_size) ? pos - trace_ring_size : pos;
+}
+
+// copy into the ring,  NULL src writes zeros
+static void RAMFUNC trace_ring_write(uint32_t pos, const uint8_t *src, uint32_t len) {
+    uint8_t *trace = BigBuf_get_addr();
+    uint32_t first = MIN(len, trace_ring_size - pos);
+    if (src) {
+        memcpy(trace + pos, src, first);
+        memcpy(trace, src + first, len - first);
+    } else {
+        memset(trace + pos, 0x00, first);
+        memset(trace, 0x00, len - first);
+    }
+}
+
+static void RAMFUNC trace_ring_read(uint32_t pos, uint8_t *dst, uint32_t len) {
+    const uint8_t *trace = BigBuf_get_addr();
+    uint32_t first = MIN(len, trace_ring_size - pos);
+    memcpy(dst, trace + pos, first);
+    memcpy(dst + first, trace, len - first);
+}
+
+// size of the record starting at pos
+static uint32_t RAMFUNC trace_ring_reclen(uint32_t pos) {
+    tracelog_hdr_t hdr;
+    trace_ring_read(pos, (uint8_t *)&hdr, TRACELOG_HDR_LEN);
+    return TRACELOG_HDR_LEN + hdr.data_len + TRACELOG_PARITY_LEN(&hdr);
+}
+
+static void trace_reverse(uint8_t *p, uint32_t len) {
+    for (uint32_t i = 0, j = len; i + 1 < j; i++) {
+        j--;
+        uint8_t tmp = p[i];
+        p[i] = p[j];
+        p[j] = tmp;
+    }
+}
+
+// Rotate the ring in place so the oldest record is at the start of BigBuf again,
+// everything else (download, spiffs save, ..) expects a linear trace.
+static void trace_ring_linearize(void) {
+    if (trace_ring_tail == 0) {
+        return;
+    }
+    uint8_t *trace = BigBuf_get_addr();
+    trace_reverse(trace, trace_ring_tail);
+    trace_reverse(trace + trace_ring_tail, trace_ring_size - trace_ring_tail);
+    trace_reverse(trace, trace_ring_size);
+    trace_ring_tail = 0;
+}
+
+void set_trace_ring(bool enable) {
+    if (trace_ring && (enable == false)) {
+        trace_ring_linearize();
+    }
+    trace_ring = enable;
+}
+
+void set_trace_stream(bool enable) {
+    trace_stream = enable;
+    if (enable == false) {
+        trace_stream_pending = 0;
+    }
+}
+
+static uint8_t *RAMFUNC trace_put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+static bool RAMFUNC trace_compact_log(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint16_t duration, const uint8_t *parity, uint16_t num_paritybytes, bool reader2tag) {
+
+    uint8_t *trace = BigBuf_get_addr();
+
+    if (trace_len == 0) {
+        if (BigBuf_max_traceLen() < TRACELOG_COMPACT_MAGIC_LEN) {
+            return false;
+        }
+        memcpy(trace, TRACELOG_COMPACT_MAGIC, TRACELOG_COMPACT_MAGIC_LEN);
+        trace_len = TRACELOG_COMPACT_MAGIC_LEN;
+        trace_compact_last_ts = 0;
+    }
+
+    // flags + 3 varints at most,  data,  parity
+    if (1 + 5 + 3 + 3 + iLen + num_paritybytes >= BigBuf_max_traceLen() - trace_len) {
+        tracing = false;
+        return false;
+    }
+
+    uint8_t flags = reader2tag ? 0 : TRACELOG_COMPACT_RESPONSE;
+
+    // only keep the parity bytes when they are neither all zero, nor plain odd parity
+    if (parity != NULL) {
+        bool zero = true, odd = (btBytes != NULL);
+        for (uint16_t i = 0; i < num_paritybytes; i++) {
+            if (parity[i]) {
+                zero = false;
+            }
+            if (odd) {
+                uint8_t expect = 0;
+                for (uint16_t j = i * 8; j < iLen && j < (i + 1) * 8; j++) {
+                    expect |= oddparity8(btBytes[j]) << (7 - (j & 0x07));
+                }
+                if (parity[i] != expect) {
+                    odd = false;
+                }
+            }
+        }
+        if (zero == false) {
+            flags |= (odd) ? TRACELOG_COMPACT_PAR_ODD : TRACELOG_COMPACT_PAR_RAW;
+        }
+    }
+
+    flags |= (iLen < TRACELOG_COMPACT_LEN_VARINT) ? iLen : TRACELOG_COMPACT_LEN_VARINT;
+
+    uint8_t *p = trace + trace_len;
+    *p++ = flags;
+    p = trace_put_varint(p, timestamp_start - trace_compact_last_ts);
+    p = trace_put_varint(p, duration);
+    if (iLen >= TRACELOG_COMPACT_LEN_VARINT) {
+        p = trace_put_varint(p, iLen);
+    }
+
+    if (btBytes != NULL) {
+        memcpy(p, btBytes, iLen);
+    } else {
+        memset(p, 0x00, iLen);
+    }
+    p += iLen;
+
+    if ((flags & TRACELOG_COMPACT_PAR_MASK) == TRACELOG_COMPACT_PAR_RAW) {
+        memcpy(p, parity, num_paritybytes);
+        p += num_paritybytes;
+    }
+
+    trace_compact_last_ts = timestamp_start;
+    trace_len = p - trace;
+    return true;
+}
+
+static bool RAMFUNC trace_ring_log(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint16_t duration, const uint8_t *parity, uint16_t num_paritybytes, bool reader2tag) {
+
+    // taken at the first record,  the sniff functions have done their BigBuf_malloc() by then
+    if (trace_ring_size == 0) {
+        trace_ring_size = BigBuf_max_traceLen();
+        trace_ring_tail = 0;
+        trace_len = 0;
+    }
+
+    uint32_t need = TRACELOG_HDR_LEN + iLen + num_paritybytes;
+    if (need > trace_ring_size) {
+        return false;
+    }
+
+    // overwrite the oldest records until the new one fits
+    while (trace_ring_size - trace_len < need) {
+        uint32_t rec = trace_ring_reclen(trace_ring_tail);
+        trace_ring_tail = trace_ring_pos(trace_ring_tail + rec);
+        trace_len -= rec;
+        if (trace_stream_pending > trace_len) {
+            trace_stream_pending = trace_len;
+            trace_stream_dropped++;
+        }
+    }
+
+    tracelog_hdr_t hdr = {
+        .timestamp = timestamp_start,
+        .duration = duration,
+        .data_len = iLen,
+        .isResponse = !reader2tag,
+    };
+
+    uint32_t pos = trace_ring_pos(trace_ring_tail + trace_len);
+    trace_ring_write(pos, (const uint8_t *)&hdr, TRACELOG_HDR_LEN);
+    pos = trace_ring_pos(pos + TRACELOG_HDR_LEN);
+    trace_ring_write(pos, btBytes, iLen);
+    pos = trace_ring_pos(pos + iLen);
+    trace_ring_write(pos, parity, num_paritybytes);
+
+    trace_len += need;
+    if (trace_stream) {
+        trace_stream_pending += need;
+    }
+    return true;
+}
+
+// Send the records not streamed yet as one CMD_TRACE_STREAM,  but only if the USB queue takes it
+// without blocking.  Meant to be called from the idle spots of a sniff loop.
+void trace_stream_poll(void) {
+
+    if ((trace_stream == false) || (trace_stream_pending == 0) || (g_reply_via_usb == false)) {
+        return;
+    }
+
+    if (reply_tx_room() < sizeof(PacketResponseNGRaw)) {
+        return;
+    }
+
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+    trace_stream_t *out = (trace_stream_t *)buf;
+    const uint32_t max = sizeof(buf) - sizeof(trace_stream_t);
+
+    uint32_t start = trace_ring_pos(trace_ring_tail + trace_len - trace_stream_pending);
+    uint32_t n = 0;
+    while (n < trace_stream_pending) {
+        uint32_t rec = trace_ring_reclen(trace_ring_pos(start + n));
+        if (n + rec > max) {
+            // can't ever be sent in one go
+            if (n == 0) {
+                trace_stream_pending -= rec;
+                trace_stream_dropped++;
+                return;
+            }
+            break;
+        }
+        n += rec;
+    }
+
+    out->dropped = trace_stream_dropped;
+    trace_ring_read(start, out->data, n);
+    if (reply_ng(CMD_TRACE_STREAM, PM3_SUCCESS, buf, sizeof(trace_stream_t) + n) == PM3_SUCCESS) {
+        trace_stream_pending -= n;
+    }
+}
+
+// Compact encoding for an empty trace.  The ring needs fixed headers to find its oldest record,
+// so both don't go together.
+void set_trace_compact(bool enable) {
+    if (trace_len == 0 && trace_ring == false) {
+        trace_compact = enable;
+    }
+}
+
+// Ring / stream / compact mode of a sniff from its SNIFF_PARAM_TRACE_* bits,  call after clear_trace()
+void trace_sniff_start(uint8_t param) {
+    set_trace_ring(param & (SNIFF_PARAM_TRACE_RING | SNIFF_PARAM_TRACE_STREAM));
+    set_trace_stream(param & SNIFF_PARAM_TRACE_STREAM);
+    set_trace_compact(param & SNIFF_PARAM_TRACE_COMPACT);
+}
+
+// Sends what is left and puts the trace back in its usual linear form
+void trace_sniff_stop(void) {
+    trace_stream_flush();
+    set_trace_stream(false);
+    set_trace_ring(false);
+}
+
+// Send all records not streamed yet,  at the end of a sniff
+void trace_stream_flush(void) {
+    while (trace_stream && trace_stream_pending && g_reply_via_usb) {
+        uint32_t pending = trace_stream_pending;
+        reply_tx_flush();
+        trace_stream_poll();
+        if (trace_stream_pending == pending) {
+            break;
+        }
+    }
+    reply_tx_flush();
+}
+
 /**
  * Get the number of bytes traced
  * @return
@@ -247,17 +653,8 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
         return false;
     }
 
-    uint8_t *trace = BigBuf_get_addr();
-    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + trace_len);
-
     uint16_t num_paritybytes = (iLen - 1) / 8 + 1; // number of valid paritybytes in *parity
 
-    // Return when trace is full
-    if (TRACELOG_HDR_LEN + iLen + num_paritybytes >= BigBuf_max_traceLen() - trace_len) {
-        tracing = false;
-        return false;
-    }
-
     uint32_t duration;
     if (timestamp_end > timestamp_start) {
         duration = timestamp_end - timestamp_start;
@@ -274,6 +671,23 @@ bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_
         duration = 0xFFFF;
     }
 
+    if (trace_ring) {
+        return trace_ring_log(btBytes, iLen, timestamp_start, duration, parity, num_paritybytes, reader2tag);
+    }
+
+    if (trace_compact) {
+        return trace_compact_log(btBytes, iLen, timestamp_start, duration, parity, num_paritybytes, reader2tag);
+    }
+
+    uint8_t *trace = BigBuf_get_addr();
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + trace_len);
+
+    // Return when trace is full
+    if (TRACELOG_HDR_LEN + iLen + num_paritybytes >= BigBuf_max_traceLen() - trace_len) {
+        tracing = false;
+        return false;
+    }
+
     hdr->timestamp = timestamp_start;
     hdr->duration = duration & 0xFFFF;
     hdr->data_len = iLen;
@@ -332,6 +746,93 @@ int emlSet(const uint8_t *data, uint32_t offset, uint32_t length) {
     return PM3_EOUTOFBOUND;
 }
 
+// Move the top of BigBuf to new_size,  taking the emulator memory along.
+// Everything else allocated is freed.
+static void bigbuf_set_top(uint32_t new_size) {
+    uint8_t *old_em = emulator_memory;
+
+    if (trace_len > new_size - CARD_MEMORY_SIZE) {
+        clear_trace();
+    }
+
+    BigBuf_free();
+    s_bigbuf_size = new_size;
+    s_bigbuf_hi = new_size;
+
+    if (old_em != NULL) {
+        emulator_memory = BigBuf_malloc(CARD_MEMORY_SIZE);
+        memmove(emulator_memory, old_em, CARD_MEMORY_SIZE);
+    }
+}
+
+static eml_snapshot_t *eml_snapshot_find(const char *name) {
+    for (uint8_t i = 0; i < s_snapshots_num; i++) {
+        if (strncmp(s_snapshots[i].name, name, EML_SNAPSHOT_NAME_LEN) == 0) {
+            return &s_snapshots[i];
+        }
+    }
+    return NULL;
+}
+
+// Copy the first size bytes of emulator memory into the snapshot called name.
+// An existing snapshot is overwritten when the size matches.
+int emlSnapshotSave(const char *name, uint16_t size) {
+    if (size == 0 || size > CARD_MEMORY_SIZE) {
+        return PM3_EINVARG;
+    }
+
+    eml_snapshot_t *snap = eml_snapshot_find(name);
+    if (snap == NULL) {
+        if (s_snapshots_num == EML_SNAPSHOT_MAX) {
+            return PM3_EOVFLOW;
+        }
+
+        uint32_t need = (size + 3) & ~3;
+        if (s_bigbuf_size < need + CARD_MEMORY_SIZE + EML_SNAPSHOT_MIN_FREE) {
+            return PM3_EMALLOC;
+        }
+
+        bigbuf_set_top(s_bigbuf_size - need);
+
+        snap = &s_snapshots[s_snapshots_num++];
+        memcpy(snap->name, name, EML_SNAPSHOT_NAME_LEN);
+        snap->size = size;
+        snap->offset = s_bigbuf_size;
+    } else if (snap->size != size) {
+        return PM3_EINVARG;
+    }
+
+    memcpy((uint8_t *)BigBuf + snap->offset, BigBuf_get_EM_addr(), size);
+    return PM3_SUCCESS;
+}
+
+// Copy the snapshot called name back into emulator memory
+int emlSnapshotLoad(const char *name) {
+    const eml_snapshot_t *snap = eml_snapshot_find(name);
+    if (snap == NULL) {
+        return PM3_ENODATA;
+    }
+    memcpy(BigBuf_get_EM_addr(), (uint8_t *)BigBuf + snap->offset, snap->size);
+    return PM3_SUCCESS;
+}
+
+uint8_t emlSnapshotList(eml_snapshot_info_t *out) {
+    for (uint8_t i = 0; i < s_snapshots_num; i++) {
+        memcpy(out[i].name, s_snapshots[i].name, EML_SNAPSHOT_NAME_LEN);
+        out[i].size = s_snapshots[i].size;
+    }
+    return s_snapshots_num;
+}
+
+// Drop all snapshots and give their space back to BigBuf
+void emlSnapshotClear(void) {
+    if (s_snapshots_num == 0) {
+        return;
+    }
+    s_snapshots_num = 0;
+    bigbuf_set_top(s_bigbuf_full_size);
+}
+
 int emlGet(uint8_t *out, uint32_t offset, uint32_t length) {
     uint8_t *mem = BigBuf_get_EM_addr();
     if (offset + length <= CARD_MEMORY_SIZE) {
@@ -381,6 +882,30 @@ void tosend_stuffbit(int b) {
     }
 }
 
+// Append the n (max 32) lowest bits of bits,  most significant first.
+// Same result as n calls to tosend_stuffbit(),  but fills up to a byte per step.
+void tosend_stuffbits(uint32_t bits, uint8_t n) {
+
+    while (n) {
+        if (toSend.bit >= 8) {
+            if (toSend.max >= TOSEND_BUFFER_SIZE - 1) {
+                Dbprintf(_RED_("toSend overflow"));
+                return;
+            }
+            toSend.max++;
+            toSend.buf[toSend.max] = 0;
+            toSend.bit = 0;
+        }
+
+        uint8_t room = 8 - toSend.bit;
+        uint8_t take = MIN(room, n);
+        uint8_t chunk = (bits >> (n - take)) & ((1 << take) - 1);
+        toSend.buf[toSend.max] |= chunk << (room - take);
+        toSend.bit += take;
+        n -= take;
+    }
+}
+
 dmabuf16_t *get_dma16(void) {
     if (dma_16.buf == NULL) {
         dma_16.buf = (uint16_t *)BigBuf_malloc(DMA_BUFFER_SIZE * sizeof(uint16_t));
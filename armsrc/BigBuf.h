@@ -20,6 +20,7 @@
 #define __BIGBUF_H
 
 #include "common.h"
+#include "pm3_cmd.h"
 
 #define MAX_FRAME_SIZE          256 // maximum allowed ISO14443 frame
 #define MAX_PARITY_SIZE         ((MAX_FRAME_SIZE + 7) / 8)
@@ -47,12 +48,24 @@ uint8_t *BigBuf_malloc(uint16_t);
 uint8_t *BigBuf_calloc(uint16_t);
 void BigBuf_free(void);
 void BigBuf_free_keep_EM(void);
+int BigBuf_mark(const char *name);
+void BigBuf_release(int mark);
+void BigBuf_window_reset(void);
+void BigBuf_window_update(void);
+uint32_t BigBuf_window_peak(void);
 void BigBuf_print_status(void);
 uint32_t BigBuf_get_traceLen(void);
 void clear_trace(void);
 void set_tracing(bool enable);
 void set_tracelen(uint32_t value);
 bool get_tracing(void);
+void set_trace_ring(bool enable);
+void set_trace_stream(bool enable);
+void set_trace_compact(bool enable);
+void trace_stream_poll(void);
+void trace_stream_flush(void);
+void trace_sniff_start(uint8_t param);
+void trace_sniff_stop(void);
 
 bool RAMFUNC LogTrace(const uint8_t *btBytes, uint16_t iLen, uint32_t timestamp_start, uint32_t timestamp_end, const uint8_t *parity, bool reader2tag);
 bool RAMFUNC LogTraceBits(const uint8_t *btBytes, uint16_t bitLen, uint32_t timestamp_start, uint32_t timestamp_end, bool reader2tag);
@@ -61,6 +74,11 @@ bool LogTrace_ISO15693(const uint8_t *bytes, uint16_t len, uint32_t ts_start, ui
 int emlSet(const uint8_t *data, uint32_t offset, uint32_t length);
 int emlGet(uint8_t *out, uint32_t offset, uint32_t length);
 
+int emlSnapshotSave(const char *name, uint16_t size);
+int emlSnapshotLoad(const char *name);
+uint8_t emlSnapshotList(eml_snapshot_info_t *out);
+void emlSnapshotClear(void);
+
 typedef struct {
     int max;
     int bit;
@@ -70,6 +88,7 @@ typedef struct {
 tosend_t *get_tosend(void);
 void tosend_reset(void);
 void tosend_stuffbit(int b);
+void tosend_stuffbits(uint32_t bits, uint8_t n);
 
 typedef struct {
     uint16_t size;
@@ -34,6 +34,7 @@
 #include "vtsend.h"
 #include "spiffs.h"
 #include "frozen.h"
+#include "mfc_stage.h"  // shared chk/dump/sim stages
 
 #define MF1KSZ 1024
 #define MF1KSZSIZE 64
@@ -89,9 +90,7 @@
 
 */
 
-static uint8_t colin_cjuid[10];
-static uint32_t colin_cjcuid;
-static iso14a_card_select_t colin_p_card;
+static mfc_stage_ctx_t colin_ctx;
 static int colin_currline;
 static int colin_currfline;
 static int colin_curlline;
@@ -206,6 +205,8 @@ MFC1KSchema_t InfiHexact = {.name = "Infineon/Hexact",
 
 static int colin_total_schemas = 0;
 
+static void saMifareMakeTag(mfc_stage_ctx_t *ctx);
+
 static void add_schema(MFC1KSchema_t *p, MFC1KSchema_t a, int *schemas_counter) {
     if (*schemas_counter < MAX_SCHEMAS) {
         p[*schemas_counter] = a;
@@ -301,36 +302,70 @@ static void ReadLastTagFromFlash(void) {
     return;
 }
 
-void WriteTagToFlash(uint32_t uid, size_t size) {
+static void WriteTagToFlash(mfc_stage_ctx_t *ctx) {
     SpinOff(0);
     LED_A_ON();
     LED_B_ON();
     LED_C_ON();
     LED_D_ON();
 
-    uint32_t len = size;
-    uint8_t data[(size * (16 * 64)) / 1024];
-
-    emlGetMem(data, 0, (size * 64) / 1024);
-
     char dest[SPIFFS_OBJ_NAME_LEN];
     uint8_t buid[4];
-    num_to_bytes(uid, 4, buid);
+    num_to_bytes(ctx->cuid, 4, buid);
     sprintf(dest, "hf_colin/mf_%02x%02x%02x%02x.bin", buid[0], buid[1], buid[2], buid[3]);
 
-    // TODO : by using safe function for multiple writes we are both breaking cache mechanisms and making useless and
-    // unoptimized mount operations we should manage at out level the mount status before and after the whole
-    // standalone mode
-    rdv40_spiffs_write((char *)dest, (uint8_t *)data, len, RDV40_SPIFFS_SAFETY_SAFE);
     // lastag will only contain filename/path to last written tag file so we don't loose time or space.
-    rdv40_spiffs_make_symlink((char *)dest, (char *)HFCOLIN_LASTTAG_SYMLINK, RDV40_SPIFFS_SAFETY_SAFE);
-
-    DbprintfEx(FLAG_NEWLINE, "[OK] TAG WRITTEN TO FLASH !");
+    if (mfc_stage_save(ctx, dest, HFCOLIN_LASTTAG_SYMLINK) == PM3_SUCCESS) {
+        DbprintfEx(FLAG_NEWLINE, "[OK] TAG WRITTEN TO FLASH !");
+    } else {
+        DbprintfEx(FLAG_NEWLINE, "[FAIL] TAG NOT WRITTEN TO FLASH");
+    }
     cjSetCursLeft();
     SpinOff(0);
     return;
 }
 
+// every found key is shown, a key which triggers a known scheme gives all the others
+static bool colin_onkey(mfc_stage_ctx_t *ctx, uint8_t sector, uint8_t keytype, uint64_t key) {
+    cjSetCursRight();
+    DbprintfEx(FLAG_NEWLINE, "SEC: %02x ; KEY : %012" PRIx64 " ; TYP: %i", sector, key, keytype);
+
+    /*  BRACE YOURSELF : AS LONG AS WE TRAP A KNOWN KEY, WE STOP CHECKING AND ENFORCE KNOWN SCHEMES */
+    for (int i = 0; i < colin_total_schemas; i++) {
+        if (key != colin_Schemas[i].trigger) {
+            continue;
+        }
+
+        cjSetCursLeft();
+        DbprintfEx(FLAG_NEWLINE, "%s>>>>>>>>>>>>!*STOP*!<<<<<<<<<<<<<<%s", _XRED_, _XWHITE_);
+        cjSetCursLeft();
+
+        DbprintfEx(FLAG_NEWLINE, "    .TAG SEEMS %sDETERMINISTIC%s.     ", _XGREEN_, _XWHITE_);
+        cjSetCursLeft();
+
+        DbprintfEx(FLAG_NEWLINE, "%sDetected: %s %s%s", _XORANGE_, _XCYAN_, colin_Schemas[i].name, _XWHITE_);
+        cjSetCursLeft();
+
+        DbprintfEx(FLAG_NEWLINE, "...%s[%sKey_derivation_schemeTest%s]%s...", _XYELLOW_, _XGREEN_,
+                   _XYELLOW_, _XGREEN_);
+        cjSetCursLeft();
+
+        DbprintfEx(FLAG_NEWLINE, "%s>>>>>>>>>>>>!*DONE*!<<<<<<<<<<<<<<%s", _XGREEN_, _XWHITE_);
+
+        for (uint8_t t = 0; t < 2; t++) {
+            for (uint8_t s = 0; s < ctx->sectors; s++) {
+                uint64_t k = (t == 0) ? colin_Schemas[i].keysA[s] : colin_Schemas[i].keysB[s];
+                mfc_stage_set_key(ctx, s, t, k);
+                cjSetCursRight();
+                DbprintfEx(FLAG_NEWLINE, "SEC: %02x ; KEY : %012" PRIx64 " ; TYP: %d", s, k, t);
+            }
+        }
+        return true;
+    }
+    /* etc etc for testing schemes quick schemes */
+    return false;
+}
+
 void ModInfo(void) {
     DbpString("  HF Mifare ultra fast sniff/sim/clone - aka VIGIKPWN (Colin Brigato)");
 }
@@ -351,11 +386,8 @@ void RunMod(void) {
     colin_currline = 20;
     colin_curlline = 20;
     colin_currfline = 24;
-    memset(colin_cjuid, 0, sizeof(colin_cjuid));
-    colin_cjcuid = 0;
-    uint8_t sectorsCnt = (MF1KSZ / MF1KSZSIZE);
-    uint64_t key64;    // Defines current key
-    uint8_t *keyBlock; // Where the keys will be held in memory.
+    mfc_stage_ctx_t *ctx = &colin_ctx;
+    mfc_stage_init(ctx);
 
     /* VIGIK EXPIRED DUMP FOR STUDY
     Sector 0
@@ -439,34 +471,12 @@ void RunMod(void) {
         0x22729a9bd40f  // INFINEON B 0E
     };
 
-    // Can remember something like that in case of Bigbuf
-    keyBlock = BigBuf_malloc(ARRAYLEN(mfKeys) * 6);
-    int mfKeysCnt = ARRAYLEN(mfKeys);
-
-    for (int mfKeyCounter = 0; mfKeyCounter < mfKeysCnt; mfKeyCounter++) {
-        num_to_bytes(mfKeys[mfKeyCounter], 6, (uint8_t *)(keyBlock + mfKeyCounter * 6));
-    }
-
-    // TODO : remember why we actually had need to initialize this array in such specific case
-    //   and why not a simple memset abuse to 0xffize the whole space in one go ?
-    // uint8_t foundKey[2][40][6]; //= [ {0xff} ]; /* C99 abusal 6.7.8.21
-    uint8_t foundKey[2][40][6];
-    for (uint16_t i = 0; i < 2; i++) {
-        for (uint16_t sectorNo = 0; sectorNo < sectorsCnt; sectorNo++) {
-            foundKey[i][sectorNo][0] = 0xFF;
-            foundKey[i][sectorNo][1] = 0xFF;
-            foundKey[i][sectorNo][2] = 0xFF;
-            foundKey[i][sectorNo][3] = 0xFF;
-            foundKey[i][sectorNo][4] = 0xFF;
-            foundKey[i][sectorNo][5] = 0xFF;
-        }
+    // the flash memory dictionary is tried after the VIGIK keys
+    if (mfc_stage_keys(ctx, mfKeys, ARRAYLEN(mfKeys), true) != PM3_SUCCESS) {
+        DbprintfEx(FLAG_NEWLINE, "FATAL:NO_MEM_FOR_KEYS");
+        return;
     }
-
-    int key = -1;
-    bool err = 0;
-    bool trapped = 0;
-    bool allKeysFound = true;
-    uint32_t size = mfKeysCnt;
+    ctx->onkey = colin_onkey;
 
     // banner:
     vtsend_reset(NULL);
@@ -493,7 +503,7 @@ failtag:
     SpinOff(50);
     LED_A_ON();
 
-    while (!iso14443a_select_card(colin_cjuid, &colin_p_card, &colin_cjcuid, true, 0, true)) {
+    while (!iso14443a_select_card(ctx->uid, &ctx->card, &ctx->cuid, true, 0, true)) {
         WDT_HIT();
         if (BUTTON_HELD(10) == BUTTON_HOLD) {
             WDT_HIT();
@@ -515,9 +525,9 @@ failtag:
     DbprintfEx(FLAG_NEWLINE, "\t\t\t       `---> Breaking keys ---->");
     cjSetCursRight();
 
-    DbprintfEx(FLAG_NEWLINE, "\t%sGOT TAG :%s %08x%s", _XRED_, _XCYAN_, colin_cjcuid, _XWHITE_);
+    DbprintfEx(FLAG_NEWLINE, "\t%sGOT TAG :%s %08x%s", _XRED_, _XCYAN_, ctx->cuid, _XWHITE_);
 
-    if (colin_cjcuid == 0) {
+    if (ctx->cuid == 0) {
         cjSetCursLeft();
         DbprintfEx(FLAG_NEWLINE, "%s>>%s BUG: 0000_CJCUID! Retrying...", _XRED_, _XWHITE_);
         SpinErr(LED_A, 100, 8);
@@ -563,74 +573,9 @@ failtag:
     // -----------------------------------------------------------------------------
     // also we could avoid first UID check for every block
 
-    // then let's expose this optimal case of well known vigik schemes :
-    for (uint8_t type = 0; type < 2 && !err && !trapped; type++) {
-        for (int sec = 0; sec < sectorsCnt && !err && !trapped; ++sec) {
-            key = cjat91_saMifareChkKeys(sec * 4, type, NULL, size, &keyBlock[0], &key64);
-
-            if (key == -1) {
-                err = 1;
-                allKeysFound = false;
-                // used in portable imlementation on microcontroller: it reports back the fail and open the
-                // standalone lock reply_ng(CMD_CJB_FSMSTATE_MENU, NULL, 0);
-                break;
-            } else if (key == -2) {
-                err = 1; // Can't select card.
-                allKeysFound = false;
-                // reply_old(CMD_CJB_FSMSTATE_MENU, 0, 0, 0, 0, 0);
-                break;
-            } else {
-                /*  BRACE YOURSELF : AS LONG AS WE TRAP A KNOWN KEY, WE STOP CHECKING AND ENFORCE KNOWN SCHEMES */
-                // uint8_t tosendkey[13];
-                char tosendkey[13];
-                num_to_bytes(key64, 6, foundKey[type][sec]);
-                cjSetCursRight();
-                DbprintfEx(FLAG_NEWLINE, "SEC: %02x ; KEY : %012" PRIx64 " ; TYP: %i", sec, key64, type);
-                /*reply_old(CMD_CJB_INFORM_CLIENT_KEY, 12, sec, type, tosendkey, 12);*/
-
-                for (int i = 0; i < colin_total_schemas; i++) {
-                    if (key64 == colin_Schemas[i].trigger) {
-
-                        cjSetCursLeft();
-                        DbprintfEx(FLAG_NEWLINE, "%s>>>>>>>>>>>>!*STOP*!<<<<<<<<<<<<<<%s", _XRED_, _XWHITE_);
-                        cjSetCursLeft();
-
-                        DbprintfEx(FLAG_NEWLINE, "    .TAG SEEMS %sDETERMINISTIC%s.     ", _XGREEN_, _XWHITE_);
-                        cjSetCursLeft();
-
-                        DbprintfEx(FLAG_NEWLINE, "%sDetected: %s %s%s", _XORANGE_, _XCYAN_, colin_Schemas[i].name, _XWHITE_);
-                        cjSetCursLeft();
-
-                        DbprintfEx(FLAG_NEWLINE, "...%s[%sKey_derivation_schemeTest%s]%s...", _XYELLOW_, _XGREEN_,
-                                   _XYELLOW_, _XGREEN_);
-                        cjSetCursLeft();
-
-                        DbprintfEx(FLAG_NEWLINE, "%s>>>>>>>>>>>>!*DONE*!<<<<<<<<<<<<<<%s", _XGREEN_, _XWHITE_);
-
-                        uint16_t t = 0;
-                        for (uint16_t s = 0; s < sectorsCnt; s++) {
-                            num_to_bytes(colin_Schemas[i].keysA[s], 6, foundKey[t][s]);
-                            sprintf(tosendkey, "%02x%02x%02x%02x%02x%02x", foundKey[t][s][0], foundKey[t][s][1],
-                                    foundKey[t][s][2], foundKey[t][s][3], foundKey[t][s][4], foundKey[t][s][5]);
-                            cjSetCursRight();
-                            DbprintfEx(FLAG_NEWLINE, "SEC: %02x ; KEY : %s ; TYP: %d", s, tosendkey, t);
-                        }
-                        t = 1;
-                        for (uint16_t s = 0; s < sectorsCnt; s++) {
-                            num_to_bytes(colin_Schemas[i].keysB[s], 6, foundKey[t][s]);
-                            sprintf(tosendkey, "%02x%02x%02x%02x%02x%02x", foundKey[t][s][0], foundKey[t][s][1],
-                                    foundKey[t][s][2], foundKey[t][s][3], foundKey[t][s][4], foundKey[t][s][5]);
-                            cjSetCursRight();
-                            DbprintfEx(FLAG_NEWLINE, "SEC: %02x ; KEY : %s ; TYP: %d", s, tosendkey, t);
-                        }
-                        trapped = 1;
-                        break;
-                    }
-                }
-                /* etc etc for testing schemes quick schemes */
-            }
-        }
-    }
+    // then let's expose this optimal case of well known vigik schemes, sectors are read while checking keys
+    mfc_stage_chk(ctx);
+    bool allKeysFound = mfc_stage_all_keys(ctx);
 
     if (!allKeysFound) {
         cjSetCursLeft();
@@ -642,40 +587,20 @@ failtag:
         return;
     }
 
-    // Settings keys to emulator
-    emlClearMem();
-    uint8_t mblock[16];
-    for (uint8_t sectorNo = 0; sectorNo < sectorsCnt; sectorNo++) {
-        emlGetMem(mblock, FirstBlockOfSector(sectorNo) + NumBlocksPerSector(sectorNo) - 1, 1);
-        for (uint8_t t = 0; t < 2; t++) {
-            memcpy(mblock + t * 10, foundKey[t][sectorNo], 6);
-        }
-        emlSetMem_xt(mblock, FirstBlockOfSector(sectorNo) + NumBlocksPerSector(sectorNo) - 1, 1, 16);
-    }
     cjSetCursLeft();
 
     DbprintfEx(FLAG_NEWLINE, "%s>>%s Setting Keys->Emulator MEM...[%sOK%s]", _XYELLOW_, _XWHITE_, _XGREEN_, _XWHITE_);
 
-    // filling TAG to emulator
-    int filled;
+    // filling TAG to emulator, the sectors the key check didn't read
     cjSetCursLeft();
 
-    DbprintfEx(FLAG_NEWLINE, "%s>>%s Filling Emulator <- from A keys...", _XYELLOW_, _XWHITE_);
-    filled = e_MifareECardLoad(sectorsCnt, 0);
-    if (filled != PM3_SUCCESS) {
+    DbprintfEx(FLAG_NEWLINE, "%s>>%s Filling Emulator <- from found keys...", _XYELLOW_, _XWHITE_);
+    if (mfc_stage_dump(ctx) != PM3_SUCCESS) {
         cjSetCursLeft();
-
-        DbprintfEx(FLAG_NEWLINE, "%s>>%s W_FAILURE ! %sTrying fallback B keys....", _XRED_, _XORANGE_, _XWHITE_);
-
-        // no trace, no dbg
-        filled = e_MifareECardLoad(sectorsCnt, 1);
-        if (filled != PM3_SUCCESS) {
-            cjSetCursLeft();
-            DbprintfEx(FLAG_NEWLINE, "FATAL:EML_FALLBACKFILL_B");
-            SpinErr(LED_C, 100, 8);
-            SpinOff(100);
-            return;
-        }
+        DbprintfEx(FLAG_NEWLINE, "FATAL:EML_FILL");
+        SpinErr(LED_C, 100, 8);
+        SpinOff(100);
+        return;
     }
 
     delta_time = GetTickCountDelta(start_time);
@@ -692,7 +617,7 @@ failtag:
     cjSetCursLeft();
     cjSetCursLeft();
 
-    WriteTagToFlash(colin_cjcuid, 1024);
+    WriteTagToFlash(ctx);
 
 readysim:
     cjSetCursLeft();
@@ -717,37 +642,9 @@ readysim:
     SpinOff(100);
     LED_C_ON();
 
-    /*
-    uint16_t flags = 0;
-    switch (colin_p_card.uidlen) {
-        case 10:
-            flags = FLAG_10B_UID_IN_DATA;
-            break;
-        case 7:
-            flags = FLAG_7B_UID_IN_DATA;
-            break;
-        case 4:
-            flags = FLAG_4B_UID_IN_DATA;
-            break;
-        default:
-            flags = FLAG_UID_IN_EMUL;
-            break;
-    }
-    // Use UID, SAK, ATQA from EMUL, if uid not defined
-    if ((flags & (FLAG_4B_UID_IN_DATA | FLAG_7B_UID_IN_DATA | FLAG_10B_UID_IN_DATA)) == 0) {
-       flags |= FLAG_UID_IN_EMUL;
-    }
-    flags |= FLAG_MF_1K;
-    if ((flags & (FLAG_4B_UID_IN_DATA | FLAG_7B_UID_IN_DATA | FLAG_10B_UID_IN_DATA)) == 0) {
-        flags |= FLAG_UID_IN_EMUL;
-     }
-    flags = 0x10;
-    */
-    uint16_t flags = FLAG_UID_IN_EMUL;
-    DbprintfEx(FLAG_NEWLINE, "\n\n\n\n\n\n\n\nn\n\nn\n\n\nflags: %d (0x%02x)", flags, flags);
     cjSetCursLeft();
     SpinOff(1000);
-    Mifare1ksim(flags, 0, colin_cjuid, 0, 0);
+    mfc_stage_sim(ctx);
     LED_C_OFF();
     SpinOff(50);
     vtsend_cursor_position_restore(NULL);
@@ -760,7 +657,7 @@ readysim:
     cjSetCursLeft();
 
     DbprintfEx(FLAG_NEWLINE, "-> Trying a clone !");
-    saMifareMakeTag();
+    saMifareMakeTag(ctx);
     cjSetCursLeft();
     vtsend_cursor_position_restore(NULL);
     DbprintfEx(FLAG_NEWLINE, "%s[ CLONED? ]", _XCYAN_);
@@ -768,6 +665,9 @@ readysim:
     DbprintfEx(FLAG_NEWLINE, "-> End Cloning.");
     WDT_HIT();
 
+    cjSetCursLeft();
+    mfc_stage_report(ctx);
+
     // Debunk...
     cjSetCursLeft();
     cjTabulize();
@@ -782,112 +682,7 @@ readysim:
     return;
 }
 
-/* Abusive microgain on original MifareECardLoad :
- * - *datain used as error return
- * - tracing is falsed
- */
-int e_MifareECardLoad(uint32_t numofsectors, uint8_t keytype) {
-    uint8_t numSectors = numofsectors;
-    uint8_t keyType = keytype;
-
-    struct Crypto1State mpcs = {0, 0};
-    struct Crypto1State *pcs;
-    pcs = &mpcs;
-
-    uint8_t dataoutbuf[16];
-    uint8_t dataoutbuf2[16];
-
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-    clear_trace();
-    set_tracing(false);
-
-    bool isOK = true;
-
-    if (!iso14443a_select_card(colin_cjuid, &colin_p_card, &colin_cjcuid, true, 0, true)) {
-        isOK = false;
-    }
-
-    for (uint8_t s = 0; isOK && s < numSectors; s++) {
-        uint64_t ui64Key = emlGetKey(s, keyType);
-        if (s == 0) {
-            if (isOK && mifare_classic_auth(pcs, colin_cjcuid, FirstBlockOfSector(s), keyType, ui64Key, AUTH_FIRST)) {
-                break;
-            }
-        } else {
-            if (isOK && mifare_classic_auth(pcs, colin_cjcuid, FirstBlockOfSector(s), keyType, ui64Key, AUTH_NESTED)) {
-                isOK = false;
-                break;
-            }
-        }
-
-        for (uint8_t blockNo = 0; isOK && blockNo < NumBlocksPerSector(s); blockNo++) {
-            if (isOK && mifare_classic_readblock(pcs, FirstBlockOfSector(s) + blockNo, dataoutbuf)) {
-                isOK = false;
-                break;
-            };
-            if (isOK) {
-                if (blockNo < NumBlocksPerSector(s) - 1) {
-                    emlSetMem_xt(dataoutbuf, FirstBlockOfSector(s) + blockNo, 1, 16);
-                } else {
-                    // sector trailer, keep the keys, set only the AC
-                    emlGetMem(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1);
-                    memcpy(&dataoutbuf2[6], &dataoutbuf[6], 4);
-                    emlSetMem_xt(dataoutbuf2, FirstBlockOfSector(s) + blockNo, 1, 16);
-                }
-            }
-        }
-    }
-
-    int res = mifare_classic_halt(pcs);
-    (void)res;
-
-    crypto1_deinit(pcs);
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    return (isOK) ? PM3_SUCCESS : PM3_EUNDEF;
-}
-
-/* the chk function is a piwi'ed(tm) check that will try all keys for
-a particular sector. also no tracing no dbg */
-int cjat91_saMifareChkKeys(uint8_t blockNo, uint8_t keyType, bool clearTrace,
-                           uint8_t keyCount, uint8_t *datain, uint64_t *key) {
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-    set_tracing(false);
-
-    struct Crypto1State mpcs = {0, 0};
-    struct Crypto1State *pcs;
-    pcs = &mpcs;
-
-    int retval = -1;
-
-    for (uint8_t i = 0; i < keyCount; i++) {
-
-        /* no need for anticollision. just verify tag is still here */
-        // if (!iso14443a_fast_select_card(colin_cjuid, 0)) {
-        if (!iso14443a_select_card(colin_cjuid, &colin_p_card, &colin_cjcuid, true, 0, true)) {
-            cjSetCursLeft();
-            DbprintfEx(FLAG_NEWLINE, "%sFATAL%s : E_MF_LOSTTAG", _XRED_, _XWHITE_);
-            break;
-        }
-
-        uint64_t ui64Key = bytes_to_num(datain + i * 6, 6);
-        if (mifare_classic_auth(pcs, colin_cjcuid, blockNo, keyType, ui64Key, AUTH_FIRST)) {
-            uint8_t dummy_answer = 0;
-            ReaderTransmit(&dummy_answer, 1, NULL);
-            // wait for the card to become ready again
-            SpinDelayUs(AUTHENTICATION_TIMEOUT);
-            continue;
-        }
-        *key = ui64Key;
-        retval = i;
-        break;
-    }
-    crypto1_deinit(pcs);
-    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
-    return retval;
-}
-
-void saMifareMakeTag(void) {
-    uint8_t cfail = 0;
+static void saMifareMakeTag(mfc_stage_ctx_t *ctx) {
     cjSetCursLeft();
     cjTabulize();
     vtsend_cursor_position_save(NULL);
@@ -898,166 +693,15 @@ void saMifareMakeTag(void) {
     cjSetCursFRight();
 
     DbprintfEx(FLAG_NEWLINE, ">> Write to Special:");
-    int flags = 0;
-    for (int blockNum = 0; blockNum < 16 * 4; blockNum++) {
-        uint8_t mblock[16];
-        emlGetMem(mblock, blockNum, 1);
-        // switch on field and send magic sequence
-        if (blockNum == 0)
-            flags = 0x08 + 0x02;
-
-        // just write
-        if (blockNum == 1)
-            flags = 0;
-
-        // Done. Magic Halt and switch off field.
-        if (blockNum == 16 * 4 - 1)
-            flags = 0x04 + 0x10;
-
-        if (saMifareCSetBlock(0, flags & 0xFE, blockNum, mblock)) {
-            cjSetCursFRight();
-            if (colin_currfline > 53) {
-                colin_currfline = 54;
-            }
-            DbprintfEx(FLAG_NEWLINE, "Block :%02x %sOK%s", blockNum, _XGREEN_, _XWHITE_);
-            continue;
-        } else {
-            cjSetCursLeft();
-            cjSetCursLeft();
-            DbprintfEx(FLAG_NEWLINE, "`--> %sFAIL%s : CHN_FAIL_BLK_%02x_NOK", _XRED_, _XWHITE_, blockNum);
-            cjSetCursFRight();
-            DbprintfEx(FLAG_NEWLINE, "%s>>>>%s STOP AT %02x", _XRED_, _XWHITE_, blockNum);
-            cfail++;
-            break;
-        }
+    if (mfc_stage_clone(ctx) == PM3_SUCCESS) {
         cjSetCursFRight();
         DbprintfEx(FLAG_NEWLINE, "%s>>>>>>>> END <<<<<<<<%s", _XYELLOW_, _XWHITE_);
-    }
-
-    if (cfail == 0) {
         SpinUp(50);
         SpinUp(50);
         SpinUp(50);
-    }
-}
-
-// TODO : make this work either for a Gen1a or for a block 0 direct write all transparently
-//-----------------------------------------------------------------------------
-// Matt's StandAlone mod.
-// Work with "magic Chinese" card (email him: ouyangweidaxian@live.cn)
-//-----------------------------------------------------------------------------
-int saMifareCSetBlock(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain) {
-    // params
-    uint8_t needWipe = arg0;
-    // bit 0 - need get UID
-    // bit 1 - need wupC
-    // bit 2 - need HALT after sequence
-    // bit 3 - need init FPGA and field before sequence
-    // bit 4 - need reset FPGA and LED
-    uint8_t workFlags = arg1;
-    uint8_t blockNo = arg2;
-
-    // card commands
-    uint8_t wupC1[] = {0x40};
-    uint8_t wupC2[] = {0x43};
-    uint8_t wipeC[] = {0x41};
-
-    // variables
-    uint8_t isOK = 0;
-    uint8_t d_block[18] = {0x00};
-
-    uint8_t receivedAnswer[MAX_MIFARE_FRAME_SIZE];
-    uint8_t receivedAnswerPar[MAX_MIFARE_PARITY_SIZE];
-
-    // reset FPGA and LED
-    if (workFlags & 0x08) {
-        iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-        //  clear_trace();
-        set_tracing(FALSE);
-    }
-
-    while (true) {
+    } else {
         cjSetCursLeft();
-
-        // get UID from chip
-        if (workFlags & 0x01) {
-            if (!iso14443a_select_card(colin_cjuid, &colin_p_card, &colin_cjcuid, true, 0, true)) {
-                DbprintfEx(FLAG_NEWLINE, "Can't select card");
-                break;
-            };
-
-            if (mifare_classic_halt(NULL)) {
-                DbprintfEx(FLAG_NEWLINE, "Halt error");
-                break;
-            };
-        };
-
-        // reset chip
-        if (needWipe) {
-            ReaderTransmitBitsPar(wupC1, 7, 0, NULL);
-            if (!ReaderReceive(receivedAnswer, receivedAnswerPar) || (receivedAnswer[0] != 0x0a)) {
-                DbprintfEx(FLAG_NEWLINE, "wupC1 error");
-                break;
-            };
-
-            ReaderTransmit(wipeC, sizeof(wipeC), NULL);
-            if (!ReaderReceive(receivedAnswer, receivedAnswerPar) || (receivedAnswer[0] != 0x0a)) {
-                DbprintfEx(FLAG_NEWLINE, "wipeC error");
-                break;
-            };
-
-            if (mifare_classic_halt(NULL)) {
-                DbprintfEx(FLAG_NEWLINE, "Halt error");
-                break;
-            };
-        };
-
-        // chaud
-        // write block
-        if (workFlags & 0x02) {
-            ReaderTransmitBitsPar(wupC1, 7, 0, NULL);
-            if (!ReaderReceive(receivedAnswer, receivedAnswerPar) || (receivedAnswer[0] != 0x0a)) {
-                DbprintfEx(FLAG_NEWLINE, "wupC1 error");
-                break;
-            };
-
-            ReaderTransmit(wupC2, sizeof(wupC2), NULL);
-            if (!ReaderReceive(receivedAnswer, receivedAnswerPar) || (receivedAnswer[0] != 0x0a)) {
-                DbprintfEx(FLAG_NEWLINE, "wupC2 errorv");
-                break;
-            };
-        }
-
-        if ((mifare_sendcmd_short(NULL, CRYPT_NONE, 0xA0, blockNo, receivedAnswer, receivedAnswerPar, NULL) != 1) ||
-                (receivedAnswer[0] != 0x0a)) {
-            DbprintfEx(FLAG_NEWLINE, "write block send command error");
-            break;
-        };
-
-        memcpy(d_block, datain, 16);
-        AddCrc14A(d_block, 16);
-        ReaderTransmit(d_block, sizeof(d_block), NULL);
-        if ((ReaderReceive(receivedAnswer, receivedAnswerPar) != 1) || (receivedAnswer[0] != 0x0a)) {
-            DbprintfEx(FLAG_NEWLINE, "write block send data error");
-            break;
-        };
-
-        if (workFlags & 0x04) {
-            if (mifare_classic_halt(NULL)) {
-                cjSetCursFRight();
-
-                DbprintfEx(FLAG_NEWLINE, "Halt error");
-                break;
-            };
-        }
-
-        isOK = 1;
-        break;
-    }
-
-    if ((workFlags & 0x10) || (!isOK)) {
-        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        cjSetCursLeft();
+        DbprintfEx(FLAG_NEWLINE, "`--> %sFAIL%s : CHN_FAIL", _XRED_, _XWHITE_);
     }
-
-    return isOK;
 }
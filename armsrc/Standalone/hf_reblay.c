@@ -45,20 +45,24 @@ void ModInfo(void) {
 * I recommend setting up & run the other end before start sending or receiving data in this Proxmark3
 * standalone.
 *
+* Both directions use the same frame: a 7 byte header
+*   [payload length] [type] [sequence] [card time, us, 2 bytes LE] [device time, us, 2 bytes LE]
+* then the payload.  Two Proxmark3s,  one in each mode,  can therefore be paired directly
+* ( two BT add-ons,  or TX/RX crossed over the FPC connector ) with no host in between.
+*
 * For the reading mode:
 * - Set up and run the other end first, to where the Proxmark3 will send the data.
-* - After the card is detected, Proxmark3 will send a package. The first byte will be the package
-*   length, then, the card data. Use the first length byte to read the whole package.
-* - Proxmark3 will expect a raw APDU from the other end, then it will be sent to the card.
-* - The answer of the card will be sent back to the connection, repeating the cycle.
+* - After the card is detected, Proxmark3 will send a PING frame with UID + ATQA + SAK.
+* - Proxmark3 will expect CMD frames with a raw APDU,  which is sent to the card.
+* - The answer of the card goes back as a RSP frame,  with the time the card took and the time
+*   this device took overall,  repeating the cycle.  A DONE frame ends it.
 *
 * For the emulation mode:
 * - Set up and run the other end first, from where the Proxmark3 will receive the data.
-* - When the Proxmark3 detected the terminal, it will send the command to the connection.
-* - The first byte will be the package length, then, the terminal command. Use the first
-*   length byte to read the whole package.
-* - Proxmark3 will expect a raw APDU from the other end, then it will be sent to the terminal.
-* - The command of the terminal will be sent back to the connection, repeating the cycle.
+* - When the Proxmark3 detected the terminal, it will send the command as a CMD frame.
+* - Proxmark3 will expect a RSP frame with the raw answer, then it will be sent to the terminal.
+* - When the field goes,  the time spent per hop is printed:  reader to link,  link round trip,
+*   the reading device and its card,  and waiting for the reader to poll again.
 *
 *  Notes:
 * - The emulation mode was tested in a real SumUp payment terminal. This does not mean
@@ -71,6 +75,82 @@ void ModInfo(void) {
 * Be brave enough to share your knowledge & inspire others.
 */
 
+#define REBLAY_PING 0x01    // reading side,  UID + ATQA + SAK of the card
+#define REBLAY_CMD  0x02    // APDU for the card
+#define REBLAY_RSP  0x03    // card answer
+#define REBLAY_DONE 0x04    // end of the session
+
+typedef struct {
+    uint8_t len;
+    uint8_t type;
+    uint8_t seq;
+    uint16_t card_us;       // RSP: card exchange on the reading side
+    uint16_t dev_us;        // RSP: CMD received to RSP queued on the reading side
+    uint8_t payload[MAX_FRAME_SIZE];
+} PACKED reblay_frame_t;
+
+#define REBLAY_HDR_LEN      (sizeof(reblay_frame_t) - MAX_FRAME_SIZE)
+
+// Frames being sent stay in this ring while the PDC reads them,  the two PDC banks hold
+// at most two of them,  so a slot is free again by the time the ring comes round
+#define REBLAY_TX_FRAMES    4
+static reblay_frame_t reblay_tx[REBLAY_TX_FRAMES];
+static uint8_t reblay_tx_next = 0;
+
+// the ISO14443a SSP clock runs at fc/16 in both modes
+#define REBLAY_SSP_TO_US(x) (((x) * 118) / 100)
+
+static reblay_frame_t *reblay_tx_slot(uint8_t type, uint8_t seq) {
+    reblay_frame_t *f = &reblay_tx[reblay_tx_next];
+    reblay_tx_next = (reblay_tx_next + 1) % REBLAY_TX_FRAMES;
+    f->len = 0;
+    f->type = type;
+    f->seq = seq;
+    f->card_us = 0;
+    f->dev_us = 0;
+    return f;
+}
+
+static void reblay_tx_queue(const reblay_frame_t *f) {
+    usart_writebuffer_async((const uint8_t *)f, REBLAY_HDR_LEN + f->len);
+}
+
+// header into hdr,  payload straight to where it is needed
+static bool reblay_recv(reblay_frame_t *hdr, uint8_t *payload) {
+    if (usart_read_ng((uint8_t *)hdr, REBLAY_HDR_LEN) != REBLAY_HDR_LEN) {
+        return false;
+    }
+    if (hdr->len && usart_read_ng(payload, hdr->len) != hdr->len) {
+        return false;
+    }
+    return true;
+}
+
+typedef struct {
+    uint32_t n;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} reblay_hop_t;
+
+static void reblay_hop_add(reblay_hop_t *h, uint32_t us) {
+    if (h->n == 0 || us < h->min) {
+        h->min = us;
+    }
+    if (us > h->max) {
+        h->max = us;
+    }
+    h->sum += us;
+    h->n++;
+}
+
+static void reblay_hop_print(const char *name, const reblay_hop_t *h) {
+    if (h->n == 0) {
+        return;
+    }
+    Dbprintf("  %-18s min %6u  avg %6u  max %6u us  ( %u )", name, h->min, (uint32_t)(h->sum / h->n), h->max, h->n);
+}
+
 void RunMod() {
     StandAloneMode();
     DbpString("");
@@ -93,18 +173,10 @@ void RunMod() {
 
     uint32_t cuid = 0;
 
-    // For received Bluetooth package
-    uint8_t rpacket[MAX_FRAME_SIZE] = { 0x00 };
+    // Received link frame
+    reblay_frame_t rframe;
     uint16_t lenpacket;
 
-    // For answering the commands
-    uint8_t apdubuffer[MAX_FRAME_SIZE] = { 0x00 };
-    uint8_t apdulen = 0;
-
-    // Buffer for Bluetooth data
-    uint8_t buffert[MAX_FRAME_SIZE] = { 0x00 };
-    uint8_t bufferlen = 0;
-
     // Reading card
     iso14a_card_select_t card_a_info;
 
@@ -116,8 +188,6 @@ void RunMod() {
     uint8_t ats[MAX_FRAME_SIZE] = { 0x00 };
     uint8_t atsl = 0;
 
-    uint8_t rdata[14] = { 0x00 };
-
     // Command buffers
     uint8_t receivedCmd[MAX_FRAME_SIZE] = { 0x00 };
     uint8_t receivedCmdPar[MAX_PARITY_SIZE] = { 0x00 };
@@ -200,55 +270,75 @@ void RunMod() {
                 DbpString(_YELLOW_("[ ") "ATS:" _YELLOW_(" ]"));
                 Dbhexdump(atsl, ats, false);
 
-                memcpy(&rdata[1], uidc, uidlen);
-                memcpy(&rdata[uidlen + 1], atqa, 2);
-                memcpy(&rdata[uidlen + 3], &sak, 1);
-
-                rdata[0] = uidlen + 3;
-
                 // ping = UID + ATQA + SAK
+                reblay_frame_t *ping = reblay_tx_slot(REBLAY_PING, 0);
+                memcpy(ping->payload, uidc, uidlen);
+                memcpy(&ping->payload[uidlen], atqa, 2);
+                ping->payload[uidlen + 2] = sak;
+                ping->len = uidlen + 3;
+
                 DbpString(_YELLOW_("[ ") "Ping:" _YELLOW_(" ]"));
-                Dbhexdump(uidlen + 4, rdata, false);
+                Dbhexdump(ping->len, ping->payload, false);
 
                 DbpString(_YELLOW_("[ ") "Sending ping" _YELLOW_(" ]"));
 
-                if (usart_writebuffer_sync(rdata, uidlen + 4) == PM3_SUCCESS) {
+                if (usart_writebuffer_sync((uint8_t *)ping, REBLAY_HDR_LEN + ping->len) == PM3_SUCCESS) {
 
                     DbpString(_YELLOW_("[ ") "Sent!" _YELLOW_(" ]"));
 
-                    for (;;) {
-                        if (usart_rxdata_available()) {
-                            lenpacket = usart_read_ng(rpacket, sizeof(rpacket));
-
-                            if (lenpacket > 1) {
-                                DbpString(_YELLOW_("[ ") "Bluetooth data:" _YELLOW_(" ]"));
-                                Dbhexdump(lenpacket, rpacket, false);
+                    reblay_hop_t card_hop = {0}, dev_hop = {0};
 
-                                apdulen = iso14_apdu(rpacket, (uint16_t) lenpacket, false, apdubuffer, NULL);
+                    for (;;) {
+                        WDT_HIT();
+                        if (BUTTON_PRESS()) {
+                            break;
+                        }
+                        if (usart_rxdata_available() < REBLAY_HDR_LEN) {
+                            continue;
+                        }
 
-                                DbpString(_YELLOW_("[ ") "Card response:" _YELLOW_(" ]"));
-                                Dbhexdump(apdulen - 2, apdubuffer, false);
+                        if (reblay_recv(&rframe, rframe.payload) == false) {
+                            DbpString(_RED_("[ ") "Broken frame, dropped" _RED_(" ]"));
+                            continue;
+                        }
+                        uint32_t t_in = GetCountSspClk();
 
-                                bufferlen = apdulen - 2;
+                        if (rframe.type == REBLAY_CMD && rframe.len) {
+                            if (g_dbglevel >= DBG_DEBUG) {
+                                DbpString(_YELLOW_("[ ") "Link data:" _YELLOW_(" ]"));
+                                Dbhexdump(rframe.len, rframe.payload, false);
+                            }
 
-                                memcpy(&buffert[0], &bufferlen, 1);
-                                memcpy(&buffert[1], apdubuffer, bufferlen);
+                            // the card answers straight into the outgoing frame
+                            reblay_frame_t *rsp = reblay_tx_slot(REBLAY_RSP, rframe.seq);
+                            uint32_t t_card = GetCountSspClk();
+                            int apdulen = iso14_apdu(rframe.payload, rframe.len, false, rsp->payload, NULL);
+                            t_card = REBLAY_SSP_TO_US(GetCountSspClk() - t_card);
+                            rsp->len = (apdulen > 2) ? MIN(apdulen - 2, 0xFF) : 0;
 
-                                DbpString(_YELLOW_("[ ") "Buffer:" _YELLOW_(" ]"));
-                                Dbhexdump(bufferlen, buffert, false);
+                            if (g_dbglevel >= DBG_DEBUG) {
+                                DbpString(_YELLOW_("[ ") "Card response:" _YELLOW_(" ]"));
+                                Dbhexdump(rsp->len, rsp->payload, false);
+                            }
 
-                                usart_writebuffer_sync(buffert, bufferlen + 1);
+                            uint32_t t_dev = REBLAY_SSP_TO_US(GetCountSspClk() - t_in);
+                            rsp->card_us = MIN(t_card, 0xFFFF);
+                            rsp->dev_us = MIN(t_dev, 0xFFFF);
+                            reblay_tx_queue(rsp);
 
+                            reblay_hop_add(&card_hop, t_card);
+                            reblay_hop_add(&dev_hop, t_dev);
 
-                            } else if (lenpacket == 1) {
-                                DbpString(_YELLOW_("[ ") "Done!" _YELLOW_(" ]"));
-                                LED_C_ON();
+                        } else if (rframe.type == REBLAY_DONE) {
+                            DbpString(_YELLOW_("[ ") "Done!" _YELLOW_(" ]"));
+                            reblay_hop_print("card exchange", &card_hop);
+                            reblay_hop_print("this device", &dev_hop);
+                            LED_C_ON();
 
-                                for (uint8_t i = 0; i < 3; i++)
-                                    SpinDelay(1000);
+                            for (uint8_t i = 0; i < 3; i++)
+                                SpinDelay(1000);
 
-                                break;
-                            }
+                            break;
                         }
                         LED_B_OFF();
                     }
@@ -292,6 +382,12 @@ void RunMod() {
             // Keep track of last terminal type command
             uint8_t prevcmd = 0x00;
 
+            // terminal command waiting to go out,  and its timing
+            reblay_frame_t *cmdf = NULL;
+            uint8_t seq = 0;
+            uint32_t t_cmd = 0, t_sent = 0, t_rsp = 0;
+            reblay_hop_t hop_out = {0}, hop_link = {0}, hop_card = {0}, hop_dev = {0}, hop_poll = {0};
+
             clear_trace();
             set_tracing(true);
 
@@ -311,13 +407,22 @@ void RunMod() {
                 dynamic_response_info.response_n = 0;
 
                 if (lenpacket == 0 && resp == 2) { // Check for Bluetooth packages
-                    if (usart_rxdata_available()) {
-                        lenpacket = usart_read_ng(rpacket, sizeof(rpacket));
+                    if (usart_rxdata_available() >= REBLAY_HDR_LEN) {
+                        // the answer goes straight behind the PCB of the response
+                        if (reblay_recv(&rframe, &dynamic_response_info.response[1]) && rframe.type == REBLAY_RSP && rframe.seq == seq) {
+                            lenpacket = rframe.len;
+                            t_rsp = GetCountSspClk();
+                            uint32_t rtt = REBLAY_SSP_TO_US(t_rsp - t_sent);
+                            reblay_hop_add(&hop_link, (rtt > rframe.dev_us) ? rtt - rframe.dev_us : 0);
+                            reblay_hop_add(&hop_card, rframe.card_us);
+                            reblay_hop_add(&hop_dev, rframe.dev_us - MIN(rframe.dev_us, rframe.card_us));
+                        }
 
                         if (lenpacket > 0) {
-                            DbpString(_YELLOW_("[ ") "Received Bluetooth data" _YELLOW_(" ]"));
-                            Dbhexdump(lenpacket, rpacket, false);
-                            memcpy(&dynamic_response_info.response[1], rpacket, lenpacket);
+                            if (g_dbglevel >= DBG_DEBUG) {
+                                DbpString(_YELLOW_("[ ") "Received Bluetooth data" _YELLOW_(" ]"));
+                                Dbhexdump(lenpacket, &dynamic_response_info.response[1], false);
+                            }
                             dynamic_response_info.response[0] = prevcmd;
                             dynamic_response_info.response_n = lenpacket + 1;
                             resp = 1;
@@ -365,22 +470,30 @@ void RunMod() {
                     if ((receivedCmd[0] == 0x02 || receivedCmd[0] == 0x03) && len > 3) { // Process reader commands
 
                         if (resp == 1) {
+                            t_cmd = GetCountSspClk();
                             prevcmd = receivedCmd[0];
-                            bufferlen = len - 3;
-                            memcpy(&buffert[0], &bufferlen, 1);
-                            memcpy(&buffert[1], &receivedCmd[1], bufferlen);
+                            cmdf = reblay_tx_slot(REBLAY_CMD, ++seq);
+                            cmdf->len = MIN(len - 3, 0xFF);
+                            memcpy(cmdf->payload, &receivedCmd[1], cmdf->len);
                             resp = 2;
                         }
                         if (lenpacket > 0) {
                             DbpString(_YELLOW_("[ ") "Answering using Bluetooth data!" _YELLOW_(" ]"));
-                            memcpy(&dynamic_response_info.response[1], rpacket, lenpacket);
+                            // still in place since it was received
                             dynamic_response_info.response[0] = receivedCmd[0];
                             dynamic_response_info.response_n = lenpacket + 1;
                             lenpacket = 0;
                             resp = 1;
                         } else {
-                            DbpString(_YELLOW_("[ ") "New command: sent it & waiting for Bluetooth response!" _YELLOW_(" ]"));
-                            usart_writebuffer_sync(buffert, bufferlen + 1);
+                            if (g_dbglevel >= DBG_DEBUG) {
+                                DbpString(_YELLOW_("[ ") "New command: sent it & waiting for Bluetooth response!" _YELLOW_(" ]"));
+                            }
+                            if (cmdf) {
+                                reblay_tx_queue(cmdf);
+                                t_sent = GetCountSspClk();
+                                reblay_hop_add(&hop_out, REBLAY_SSP_TO_US(t_sent - t_cmd));
+                                cmdf = NULL;
+                            }
                             p_response = NULL;
                         }
 
@@ -396,9 +509,11 @@ void RunMod() {
                 }
 
                 if (dynamic_response_info.response_n > 0) {
-                    DbpString("[ " _GREEN_("Proxmark3 answer") " ]");
-                    Dbhexdump(dynamic_response_info.response_n, dynamic_response_info.response, false);
-                    DbpString("----");
+                    if (g_dbglevel >= DBG_DEBUG) {
+                        DbpString("[ " _GREEN_("Proxmark3 answer") " ]");
+                        Dbhexdump(dynamic_response_info.response_n, dynamic_response_info.response, false);
+                        DbpString("----");
+                    }
                     if (lenpacket > 0) {
                         lenpacket = 0;
                         resp = 1;
@@ -418,9 +533,26 @@ void RunMod() {
 
                 if (p_response != NULL) {
                     EmSendPrecompiledCmd(p_response);
+                    if (t_rsp && p_response == &dynamic_response_info) {
+                        reblay_hop_add(&hop_poll, REBLAY_SSP_TO_US(GetCountSspClk() - t_rsp));
+                        t_rsp = 0;
+                    }
                 }
             }
 
+            // lets a directly paired reading device stop too
+            reblay_frame_t *done = reblay_tx_slot(REBLAY_DONE, seq);
+            usart_writebuffer_sync((uint8_t *)done, REBLAY_HDR_LEN);
+
+            if (hop_link.n) {
+                DbpString("Relay time per hop:");
+                reblay_hop_print("reader to link", &hop_out);
+                reblay_hop_print("link round trip", &hop_link);
+                reblay_hop_print("reading device", &hop_dev);
+                reblay_hop_print("card exchange", &hop_card);
+                reblay_hop_print("wait reader poll", &hop_poll);
+            }
+
             switch_off();
             set_tracing(false);
             BigBuf_free_keep_EM();
@@ -338,10 +338,10 @@ void RunMod(void) {
             SniffIso14443b();
             break;
         case HF_UNISNIFF_PROTO_15:
-            SniffIso15693(0, NULL, false);
+            SniffIso15693(0, NULL, false, 0);
             break;
         case HF_UNISNIFF_PROTO_ICLASS:
-            SniffIso15693(0, NULL, true);
+            SniffIso15693(0, NULL, true, 0);
             break;
         default:
             Dbprintf("No protocol selected, exiting...");
@@ -0,0 +1,171 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Shared HID Prox bruteforce schedule for the LF standalone modes
+//-----------------------------------------------------------------------------
+#include "lf_brute.h"
+
+#include "proxmark3_arm.h"
+#include "util.h"
+#include "ticks.h"
+#include "parity.h"
+
+// parity over the bits of x by byte table,  1 = odd number of ones
+static inline uint8_t lf_brute_parity(uint32_t x) {
+    x ^= x >> 16;
+    x ^= x >> 8;
+    return ODD_PARITY8(x & 0xFF) ^ 1;
+}
+
+// parity bit masks of the formats,  as laid out in the HID high / low words
+#define H10301_EVEN_LO   0x01FFE000     // bits 13..24
+#define H10301_ODD_LO    0x00001FFE     // bits 1..12
+#define C1K35_P34_LO     0xB6DB6DB6     // even,  with high bit 0
+#define C1K35_P1_LO      0x6DB6DB6C     // odd,   with high bits 0..1
+
+uint32_t lf_brute_max(lf_brute_format_t format, lf_brute_field_t field) {
+    switch (format) {
+        case LF_BRUTE_C1K35:
+            return (field == LF_BRUTE_FC) ? 0xFFF : 0xFFFFF;
+        case LF_BRUTE_H10301:
+        default:
+            return (field == LF_BRUTE_FC) ? 0xFF : 0xFFFF;
+    }
+}
+
+void lf_brute_encode(lf_brute_format_t format, uint32_t fc, uint32_t cn, uint32_t *high, uint32_t *low) {
+    uint32_t hi, lo;
+
+    switch (format) {
+        case LF_BRUTE_C1K35: {
+            lo = ((fc & 0x7FF) << 21) | ((cn & 0xFFFFF) << 1);
+            hi = 0x28 | ((fc >> 11) & 1);
+
+            // bit 34,  even
+            if (lf_brute_parity(lo & C1K35_P34_LO) ^ (hi & 1)) {
+                hi |= 0x2;
+            }
+            // bit 1,  odd
+            if ((lf_brute_parity(lo & C1K35_P1_LO) ^ (hi & 1) ^ ((hi >> 1) & 1)) == 0) {
+                lo |= 0x1;
+            }
+            // bit 35,  odd over everything else
+            if ((lf_brute_parity(lo) ^ (hi & 1) ^ ((hi >> 1) & 1)) == 0) {
+                hi |= 0x4;
+            }
+            break;
+        }
+        case LF_BRUTE_H10301:
+        default: {
+            lo = ((fc & 0xFF) << 17) | ((cn & 0xFFFF) << 1);
+            lo |= lf_brute_parity(lo & H10301_ODD_LO) ^ 1;
+            lo |= lf_brute_parity(lo & H10301_EVEN_LO) << 25;
+            lo |= 1U << 26;  // sentinel
+            hi = 0x20;       // bit 37,  standard header
+            break;
+        }
+    }
+
+    *high = hi;
+    *low = lo;
+}
+
+bool lf_brute_decode(lf_brute_format_t format, uint32_t high, uint32_t low, uint32_t *fc, uint32_t *cn) {
+    switch (format) {
+        case LF_BRUTE_C1K35:
+            if ((high & 0xFFFFFFF8) != 0x28) {
+                return false;
+            }
+            *fc = ((high & 1) << 11) | (low >> 21);
+            *cn = (low >> 1) & 0xFFFFF;
+            return true;
+        case LF_BRUTE_H10301:
+        default:
+            if (high != 0x20 || ((low >> 26) & 1) == 0) {
+                return false;
+            }
+            *fc = (low >> 17) & 0xFF;
+            *cn = (low >> 1) & 0xFFFF;
+            return true;
+    }
+}
+
+void lf_brute_init(lf_brute_t *b, lf_brute_format_t format, lf_brute_field_t field,
+                   uint32_t fc, uint32_t cn, uint32_t end, int dwell, uint16_t gap_ms) {
+
+    b->format = format;
+    b->field = field;
+    b->fc = fc;
+    b->cn = cn;
+
+    uint32_t start = (field == LF_BRUTE_FC) ? fc : cn;
+    b->end = MIN(end, lf_brute_max(format, field));
+    b->step = (b->end >= start) ? 1 : -1;
+    b->done = (start > lf_brute_max(format, field));
+
+    b->dwell = dwell;
+    b->gap_ms = gap_ms;
+    b->ledcontrol = true;
+
+    b->tried = 0;
+    b->batch_len = 0;
+    b->batch_idx = 0;
+
+    // BigBuf was most likely used since the last simulation
+    b->wave.bitslen = 0;
+}
+
+static void lf_brute_fill(lf_brute_t *b) {
+    uint32_t *v = (b->field == LF_BRUTE_FC) ? &b->fc : &b->cn;
+
+    b->batch_len = 0;
+    b->batch_idx = 0;
+
+    while (b->done == false && b->batch_len < LF_BRUTE_BATCH) {
+        b->batch_val[b->batch_len] = *v;
+        lf_brute_encode(b->format, b->fc, b->cn, &b->batch_hi[b->batch_len], &b->batch_lo[b->batch_len]);
+        b->batch_len++;
+
+        if (*v == b->end) {
+            b->done = true;
+        } else {
+            *v += b->step;
+        }
+    }
+}
+
+// next candidate into value / high / low,  false when the schedule is exhausted
+bool lf_brute_next(lf_brute_t *b) {
+    if (b->batch_idx == b->batch_len) {
+        lf_brute_fill(b);
+        if (b->batch_len == 0) {
+            return false;
+        }
+    }
+
+    b->value = b->batch_val[b->batch_idx];
+    b->high = b->batch_hi[b->batch_idx];
+    b->low = b->batch_lo[b->batch_idx];
+    b->batch_idx++;
+    b->tried++;
+    return true;
+}
+
+void lf_brute_sim(lf_brute_t *b) {
+    CmdHIDsimTAGWave(&b->wave, 0, b->high, b->low, 0, b->ledcontrol, b->dwell);
+    if (b->gap_ms) {
+        SpinDelay(b->gap_ms);
+    }
+}
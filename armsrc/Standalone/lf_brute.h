@@ -0,0 +1,77 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Shared HID Prox bruteforce schedule for the LF standalone modes
+//
+// Candidates are encoded a batch at a time, the part of the credential which
+// stays the same is encoded once.  Each candidate is simulated for a fixed
+// dwell time, reusing the FSK waveform of the previous one.
+//-----------------------------------------------------------------------------
+#ifndef __LF_BRUTE_H
+#define __LF_BRUTE_H
+
+#include "common.h"
+#include "lfops.h"      // lf_fsk_wave_t
+
+typedef enum {
+    LF_BRUTE_H10301 = 0,    // HID 26 bit,  FC 8 bits,  CN 16 bits
+    LF_BRUTE_C1K35,         // HID Corporate 1000 35 bit,  FC 12 bits,  CN 20 bits
+} lf_brute_format_t;
+
+typedef enum {
+    LF_BRUTE_CN = 0,        // sweep the card number,  keep the facility code
+    LF_BRUTE_FC,            // sweep the facility code,  keep the card number
+} lf_brute_field_t;
+
+#define LF_BRUTE_BATCH 32
+
+typedef struct {
+    lf_brute_format_t format;
+    lf_brute_field_t field;
+    uint32_t fc;
+    uint32_t cn;
+    uint32_t end;           // last value of the swept field,  inclusive
+    int8_t step;
+    bool done;
+
+    int dwell;              // simulation cycles per candidate
+    uint16_t gap_ms;        // field off between candidates
+    bool ledcontrol;
+
+    // current candidate
+    uint32_t value;
+    uint32_t high;
+    uint32_t low;
+    uint32_t tried;
+
+    uint32_t batch_val[LF_BRUTE_BATCH];
+    uint32_t batch_hi[LF_BRUTE_BATCH];
+    uint32_t batch_lo[LF_BRUTE_BATCH];
+    uint8_t batch_len;
+    uint8_t batch_idx;
+
+    lf_fsk_wave_t wave;
+} lf_brute_t;
+
+uint32_t lf_brute_max(lf_brute_format_t format, lf_brute_field_t field);
+void lf_brute_encode(lf_brute_format_t format, uint32_t fc, uint32_t cn, uint32_t *high, uint32_t *low);
+bool lf_brute_decode(lf_brute_format_t format, uint32_t high, uint32_t low, uint32_t *fc, uint32_t *cn);
+
+void lf_brute_init(lf_brute_t *b, lf_brute_format_t format, lf_brute_field_t field,
+                   uint32_t fc, uint32_t cn, uint32_t end, int dwell, uint16_t gap_ms);
+bool lf_brute_next(lf_brute_t *b);
+void lf_brute_sim(lf_brute_t *b);
+
+#endif
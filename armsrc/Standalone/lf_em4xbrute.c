@@ -0,0 +1,101 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// main code for headless EM4x50 / EM4x05 / EM4x70 password brute force
+//-----------------------------------------------------------------------------
+#include "standalone.h"
+#include "proxmark3_arm.h"
+#include "appmain.h"
+#include "fpgaloader.h"
+#include "util.h"
+#include "dbprint.h"
+#include "string.h"
+#include "lfops.h"
+#include "../bf_checkpoint.h"
+#include "../em4x50.h"
+#include "../em4x70.h"
+
+/*
+ * `lf_em4xbrute` continues an EM4x50, EM4x05 or EM4x70 password brute force
+ * from its flash checkpoint,  without a client.
+ * It requires RDV4 hardware (for flash and battery).
+ *
+ * Start the search once from the client,  it checkpoints to flash every minute:
+ * - lf em 4x50 brute --mode range --begin 00000000 --end ffffffff
+ * - lf em 4x05 brute
+ * - lf em 4x70 brute -b 9 --rnd ... --frnd ...
+ * Then unplug it,  power it from the battery and put it on the tag.
+ *
+ * On entering stand-alone mode the first checkpoint found is resumed,
+ * in the order EM4x50, EM4x05, EM4x70.  The search keeps writing checkpoints
+ * and removes its file when it is done.  Press the button to stop,  the
+ * position is saved.
+ *
+ * The outcome is shown in the debug log,  when connected later:
+ * - lf em 4x05 brute --resume     ( or 4x50 / 4x70 ) picks up where it stopped
+ *
+ * LEDs:
+ * - LED A blinking: no checkpoint in flash
+ * - LED C / D: searching ( the brute force functions' own LEDs )
+ */
+
+void ModInfo(void) {
+    DbpString("  LF EM4x50 / EM4x05 / EM4x70 brute force resume from flash");
+}
+
+void RunMod(void) {
+    StandAloneMode();
+    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+    Dbprintf("[=] LF EM4x brute started");
+
+    bf_checkpoint_t cp;
+
+#ifdef WITH_EM4x50
+    if (bf_checkpoint_load(BF_CP_EM4X50, &cp) == PM3_SUCCESS) {
+        em4x50_data_t etd;
+        memset(&etd, 0, sizeof(etd));
+        etd.bruteforce_resume = true;
+        em4x50_brute(&etd, true);
+        DbpString("[=] exiting");
+        LEDsoff();
+        return;
+    }
+#endif
+
+    if (bf_checkpoint_load(BF_CP_EM4X05, &cp) == PM3_SUCCESS) {
+        EM4xBruteforce(0, 0, true, true);
+        DbpString("[=] exiting");
+        LEDsoff();
+        return;
+    }
+
+#ifdef WITH_EM4x70
+    if (bf_checkpoint_load(BF_CP_EM4X70, &cp) == PM3_SUCCESS) {
+        em4x70_data_t etd;
+        memset(&etd, 0, sizeof(etd));
+        etd.resume = true;
+        em4x70_brute(&etd, true);
+        DbpString("[=] exiting");
+        LEDsoff();
+        return;
+    }
+#endif
+
+    DbpString("[!] no brute force checkpoint in flash");
+    SpinErr(LED_A, 250, 5);
+
+    DbpString("[=] exiting");
+    LEDsoff();
+}
@@ -39,13 +39,46 @@
 #include "dbprint.h"
 #include "ticks.h"
 #include "lfops.h"
+#include "lf_brute.h"
 
 #define OPTS 3
+// simulation cycles per card number
+#ifndef HIDBRUTE_DWELL
+#define HIDBRUTE_DWELL 50000
+#endif
 
 void ModInfo(void) {
     DbpString("  LF HID corporate 1000 bruteforce - aka Corporatebrute (Federico dotta & Maurizio Agazzini)");
 }
 
+static lf_brute_t brute;
+
+// try card numbers start..end,  returns true when the button was held to leave the mode
+static bool hidbrute_sweep(uint32_t fc, uint32_t start, uint32_t end) {
+
+    lf_brute_init(&brute, LF_BRUTE_C1K35, LF_BRUTE_CN, fc, start, end, HIDBRUTE_DWELL, 0);
+
+    while (lf_brute_next(&brute)) {
+
+        // Needed for exiting from proxbrute when button is pressed
+        if (BUTTON_PRESS()) {
+            if (BUTTON_HELD(1000) == BUTTON_HOLD) {
+                return true;
+            }
+            while (BUTTON_PRESS()) {
+                WDT_HIT();
+            }
+            break;
+        }
+
+        // Print actual code to brute
+        Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", brute.high, brute.low, (brute.low >> 1) & 0xFFFF, fc, brute.value);
+
+        lf_brute_sim(&brute);
+    }
+    return false;
+}
+
 // samy's sniff and repeat routine for LF
 void RunMod(void) {
     StandAloneMode();
@@ -164,64 +197,17 @@ void RunMod(void) {
                 WAIT_BUTTON_RELEASED();
 
                 // Calculate Facility Code and Card Number from high and low
-                uint32_t cardnum = (low[selected] >> 1) & 0xFFFFF;
-                uint32_t fc = ((high[selected] & 1) << 11) | (low[selected] >> 21);
-                uint32_t original_cardnum = cardnum;
+                uint32_t fc = 0, cardnum = 0;
+                lf_brute_decode(LF_BRUTE_C1K35, high[selected], low[selected], &fc, &cardnum);
 
                 Dbprintf("[=] HID brute - starting decrementing card number");
-
-                while (cardnum > 0) {
-
-                    // Needed for exiting from proxbrute when button is pressed
-                    if (BUTTON_PRESS()) {
-                        if (BUTTON_HELD(1000) == BUTTON_HOLD) {
-                            goto out;
-                        } else {
-                            while (BUTTON_PRESS()) {
-                                WDT_HIT();
-                            }
-                            break;
-                        }
-                    }
-
-                    // Decrement Card Number
-                    cardnum--;
-
-                    // Calculate checksum of HID Corporate 1000 and set card number and facility code in high and low variables
-                    hid_corporate_1000_calculate_checksum_and_set(&high[selected], &low[selected], cardnum, fc);
-
-                    // Print actual code to brute
-                    Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", high[selected], low[selected], (low[selected] >> 1) & 0xFFFF, fc, cardnum);
-
-                    CmdHIDsimTAGEx(0, high[selected], low[selected], 0, 1, 50000);
+                if (cardnum > 0 && hidbrute_sweep(fc, cardnum - 1, 0)) {
+                    goto out;
                 }
 
-                cardnum = original_cardnum;
-
                 Dbprintf("[=] HID brute - starting incrementing card number");
-
-                while (cardnum <= 0xFFFFF) {
-
-                    // Needed for exiting from proxbrute when button is pressed
-                    if (BUTTON_PRESS()) {
-                        if (BUTTON_HELD(1000) == BUTTON_HOLD) {
-                            goto out;
-                        } else {
-                            while (BUTTON_PRESS()) { WDT_HIT(); }
-                            break;
-                        }
-                    }
-
-                    // Decrement Card Number
-                    cardnum++;
-
-                    // Calculate checksum of HID Corporate 1000 and set card number and facility code in high and low variables
-                    hid_corporate_1000_calculate_checksum_and_set(&high[selected], &low[selected], cardnum, fc);
-
-                    // Print actual code to brute
-                    Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", high[selected], low[selected], (low[selected] >> 1) & 0xFFFF, fc, cardnum);
-
-                    CmdHIDsimTAGEx(0, high[selected], low[selected], 0, 1, 50000);
+                if (cardnum < lf_brute_max(LF_BRUTE_C1K35, LF_BRUTE_CN) && hidbrute_sweep(fc, cardnum + 1, lf_brute_max(LF_BRUTE_C1K35, LF_BRUTE_CN))) {
+                    goto out;
                 }
 
                 DbpString("[=] done bruteforcing");
@@ -249,80 +235,6 @@ out:
     LEDsoff();
 }
 
-// Function that calculate next value for the brutforce of HID corporate 1000
-void hid_corporate_1000_calculate_checksum_and_set(uint32_t *high, uint32_t *low, uint32_t cardnum, uint32_t fc) {
-
-    uint32_t new_high = 0;
-    uint32_t new_low = 0;
-
-    // Calculate new high and low base value from card number and facility code, without parity
-    new_low = (fc << 21) | (cardnum << 1);
-    new_high = 0x28 | ((fc >> 11) & 1); // 0x28 is 101000
-
-    int n_ones;
-    uint32_t i;
-
-    // Calculating and setting parity bit 34
-    // Select only bit used for parity bit 34 in low number (10110110110110110110110110110110)
-    uint32_t parity_bit_34_low = new_low & 0xB6DB6DB6;
-    n_ones = 0;
-    // Calculate number of ones in low number
-    for (i = 1; i != 0; i <<= 1) {
-        if (parity_bit_34_low & i)
-            n_ones++;
-    }
-    // Calculate number of ones in high number
-    if (new_high & 1)
-        n_ones++;
-
-    // Set parity bit (Even parity)
-    if (n_ones % 2)
-        new_high = new_high | 0x2;
-
-    // Calculating and setting parity bit 1
-    // Select only bit used for parity bit 1 in low number (01101101101101101101101101101100)
-    uint32_t parity_bit_1_low = new_low & 0x6DB6DB6C;
-    n_ones = 0;
-
-    // Calculate number of ones in low number
-    for (i = 1; i != 0; i <<= 1) {
-        if (parity_bit_1_low & i)
-            n_ones++;
-    }
-    // Calculate number of ones in high number
-    if (new_high & 0x1)
-        n_ones++;
-
-    if (new_high & 0x2)
-        n_ones++;
-
-    // Set parity bit (Odd parity)
-    if (!(n_ones % 2))
-        new_low = new_low | 0x1;
-
-    // Calculating and setting parity bit 35
-    n_ones = 0;
-    // Calculate number of ones in low number (all bit of low, bitmask unnecessary)
-    for (i = 1; i != 0; i <<= 1) {
-        if (new_low & i)
-            n_ones++;
-    }
-    // Calculate number of ones in high number
-    if (new_high & 0x1)
-        n_ones++;
-
-    if (new_high & 0x2)
-        n_ones++;
-
-    // Set parity bit (Odd parity)
-    if (!(n_ones % 2))
-        new_high = new_high | 0x4;
-
-    // Setting new calculated values
-    *low = new_low;
-    *high = new_high;
-}
-
 // prepare a waveform pattern in the buffer based on the ID given then
 // simulate a HID tag until the button is pressed or after #numcycles cycles
 // Used to bruteforce HID in standalone mode.
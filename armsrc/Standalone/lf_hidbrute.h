@@ -35,6 +35,4 @@
 
 #include <stdint.h>
 
-void hid_corporate_1000_calculate_checksum_and_set(uint32_t *high, uint32_t *low, uint32_t cardnum, uint32_t fc);
-
 #endif /* __LF_HIDBRUTE_H */
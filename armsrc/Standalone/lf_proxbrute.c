@@ -24,11 +24,20 @@
 #include "dbprint.h"
 #include "ticks.h"
 #include "lfops.h"
+#include "lf_brute.h"
+
+// simulation cycles per card number,  and the pause after it
+#ifndef PROXBRUTE_DWELL
+#define PROXBRUTE_DWELL 20000
+#endif
+#define PROXBRUTE_GAP_MS 100
 
 void ModInfo(void) {
     DbpString("  LF HID ProxII bruteforce - aka Proxbrute (Brad Antoniewicz)");
 }
 
+static lf_brute_t brute;
+
 // samy's sniff and repeat routine for LF
 void RunMod(void) {
     StandAloneMode();
@@ -97,20 +106,27 @@ void RunMod(void) {
             DbpString("[=] entering ProxBrute mode");
             Dbprintf("[=] simulating | %08x%08x", high, low);
 
-            for (uint16_t i = low - 1; i > 0; i--) {
+            // count down from the recorded card number,  keeping its facility code
+            uint32_t fc = 0, cn = 0;
+            if (lf_brute_decode(LF_BRUTE_H10301, high, low, &fc, &cn) && cn > 0) {
+
+                lf_brute_init(&brute, LF_BRUTE_H10301, LF_BRUTE_CN, fc, cn - 1, 0, PROXBRUTE_DWELL, PROXBRUTE_GAP_MS);
+                brute.ledcontrol = false;
 
-                if (data_available()) break;
+                while (lf_brute_next(&brute)) {
 
-                // Was our button held down or pressed?
-                button_pressed = BUTTON_HELD(280);
-                if (button_pressed != BUTTON_HOLD) break;
+                    if (data_available()) break;
 
-                Dbprintf("[=] trying Facility = %08x ID %08x", high, i);
+                    // Was our button held down or pressed?
+                    button_pressed = BUTTON_HELD(280);
+                    if (button_pressed != BUTTON_HOLD) break;
 
-                // high, i, ledcontrol,  timelimit 20000
-                CmdHIDsimTAGEx(0, high, i, 0, false, 20000);
+                    Dbprintf("[=] trying Facility = %08x ID %08x", fc, brute.value);
 
-                SpinDelay(100);
+                    lf_brute_sim(&brute);
+                }
+            } else {
+                DbpString("[-] not a HID 26 bit card,  nothing to bruteforce");
             }
 
             state = STATE_READ;
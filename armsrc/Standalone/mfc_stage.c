@@ -0,0 +1,550 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Shared MIFARE Classic stages for standalone modes
+//-----------------------------------------------------------------------------
+#include "mfc_stage.h"
+
+#include <inttypes.h>
+#include "proxmark3_arm.h"
+#include "ticks.h"
+#include "BigBuf.h"
+#include "commonutil.h"
+#include "fpgaloader.h"
+#include "util.h"
+#include "dbprint.h"
+#include "string.h"
+#include "iso14443a.h"
+#include "crc16.h"
+#include "protocols.h"  // ISO14443A_CMD_WRITEBLOCK
+#include "mifaresim.h"  // mifare1ksim
+#include "mifareutil.h"
+
+#ifdef WITH_FLASH
+#include "flashmem.h"
+#include "pmflash.h"
+#include "spiffs.h"
+#endif
+
+#define MFC_STAGE_KEY_SIZE 6
+
+static const char *mfc_stage_names[MFC_STAGE_COUNT] = {
+    "select", "chk", "dump", "save", "sim", "clone"
+};
+
+static void mfc_stage_done(mfc_stage_ctx_t *ctx, mfc_stage_id_t id, uint32_t start) {
+    ctx->ms[id] += GetTickCountDelta(start);
+    ctx->ran |= (1 << id);
+}
+
+static uint16_t mfc_stage_blocks(const mfc_stage_ctx_t *ctx) {
+    return FirstBlockOfSector(ctx->sectors - 1) + NumBlocksPerSector(ctx->sectors - 1);
+}
+
+void mfc_stage_init(mfc_stage_ctx_t *ctx) {
+    memset(ctx, 0, sizeof(mfc_stage_ctx_t));
+    ctx->sectors = MIFARE_1K_MAXSECTOR;
+    emlClearMem();
+}
+
+/**
+ * @brief Build the key list, the given keys first, followed by the flash memory dictionary
+ *
+ * The flash memory dictionary is already deduplicated and ordered by hits when loaded with `mem load -m`,
+ * only the keys also in the given list are dropped.
+ */
+int mfc_stage_keys(mfc_stage_ctx_t *ctx, const uint64_t *keys, uint16_t keycnt, bool use_flash) {
+    uint16_t flashcnt = 0;
+
+#ifdef WITH_FLASH
+    if (use_flash) {
+        uint8_t size[2] = {0x00, 0x00};
+        if (Flash_ReadData(DEFAULT_MF_KEYS_OFFSET, size, sizeof(size)) == sizeof(size)) {
+            flashcnt = size[1] << 8 | size[0];
+            if (flashcnt > DEFAULT_MF_KEYS_MAX) {
+                flashcnt = 0;
+            }
+        }
+    }
+#else
+    (void)use_flash;
+#endif
+
+    ctx->keys = BigBuf_malloc((keycnt + flashcnt) * MFC_STAGE_KEY_SIZE);
+    if (ctx->keys == NULL && flashcnt) {
+        Dbprintf("no room for the flash memory dictionary");
+        flashcnt = 0;
+        ctx->keys = BigBuf_malloc(keycnt * MFC_STAGE_KEY_SIZE);
+    }
+    if (ctx->keys == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    for (uint16_t i = 0; i < keycnt; i++) {
+        num_to_bytes(keys[i], MFC_STAGE_KEY_SIZE, ctx->keys + (i * MFC_STAGE_KEY_SIZE));
+    }
+    ctx->keycnt = keycnt;
+
+#ifdef WITH_FLASH
+    if (flashcnt) {
+        uint8_t *p = ctx->keys + (keycnt * MFC_STAGE_KEY_SIZE);
+        uint16_t len = flashcnt * MFC_STAGE_KEY_SIZE;
+        if (Flash_ReadData(DEFAULT_MF_KEYS_OFFSET + 2, p, len) == len) {
+            for (uint16_t i = 0; i < flashcnt; i++) {
+                uint64_t key = bytes_to_num(p + (i * MFC_STAGE_KEY_SIZE), MFC_STAGE_KEY_SIZE);
+                bool dup = false;
+                for (uint16_t j = 0; j < keycnt; j++) {
+                    if (keys[j] == key) {
+                        dup = true;
+                        break;
+                    }
+                }
+                if (dup == false) {
+                    memmove(ctx->keys + (ctx->keycnt * MFC_STAGE_KEY_SIZE), p + (i * MFC_STAGE_KEY_SIZE), MFC_STAGE_KEY_SIZE);
+                    ctx->keycnt++;
+                }
+            }
+        }
+        Dbprintf("keys " _YELLOW_("%u") " ( " _YELLOW_("%u") " from flash memory )", ctx->keycnt, ctx->keycnt - keycnt);
+    }
+#endif
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Record a key, if the sector is in emulator memory already its trailer gets the key too
+ */
+void mfc_stage_set_key(mfc_stage_ctx_t *ctx, uint8_t sector, uint8_t keytype, uint64_t key) {
+    ctx->found[keytype][sector] = true;
+    ctx->key[keytype][sector] = key;
+
+    if (ctx->read[sector]) {
+        uint8_t trailer[16];
+        uint8_t block = FirstBlockOfSector(sector) + NumBlocksPerSector(sector) - 1;
+        emlGetMem(trailer, block, 1);
+        num_to_bytes(key, MFC_STAGE_KEY_SIZE, trailer + (keytype * 10));
+        emlSetMem_xt(trailer, block, 1, 16);
+    }
+}
+
+bool mfc_stage_all_keys(const mfc_stage_ctx_t *ctx) {
+    for (uint8_t s = 0; s < ctx->sectors; s++) {
+        if (ctx->found[0][s] == false || ctx->found[1][s] == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mfc_stage_any_key(const mfc_stage_ctx_t *ctx) {
+    for (uint8_t s = 0; s < ctx->sectors; s++) {
+        if (ctx->found[0][s] || ctx->found[1][s]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool mfc_stage_abort(void) {
+    return BUTTON_PRESS() || data_available();
+}
+
+/**
+ * @brief Wait for a card, its size is taken from the SAK
+ */
+int mfc_stage_select(mfc_stage_ctx_t *ctx) {
+    uint32_t start = GetTickCount();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(false);
+
+    int res = PM3_SUCCESS;
+    while (iso14443a_select_card(ctx->uid, &ctx->card, &ctx->cuid, true, 0, true) == false || ctx->cuid == 0) {
+        WDT_HIT();
+        if (mfc_stage_abort()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        SpinDelay(100);
+        iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    }
+
+    if (res == PM3_SUCCESS) {
+        switch (ctx->card.sak & 0x19) {
+            case 0x09:
+                ctx->sectors = MIFARE_MINI_MAXSECTOR;
+                break;
+            case 0x18:
+                ctx->sectors = MIFARE_4K_MAXSECTOR;
+                break;
+            case 0x19:
+            case 0x10:
+                ctx->sectors = MIFARE_2K_MAXSECTOR;
+                break;
+            default:
+                ctx->sectors = MIFARE_1K_MAXSECTOR;
+                break;
+        }
+    }
+
+    mfc_stage_done(ctx, MFC_STAGE_SELECT, start);
+    return res;
+}
+
+// read an authenticated sector into emulator memory, the trailer gets the known keys
+static int mfc_stage_read_sector(mfc_stage_ctx_t *ctx, struct Crypto1State *pcs, uint8_t sector) {
+    uint8_t first = FirstBlockOfSector(sector);
+    uint8_t blocks = NumBlocksPerSector(sector);
+    uint8_t data[16];
+
+    for (uint8_t b = 0; b < blocks; b++) {
+        if (mifare_classic_readblock(pcs, first + b, data)) {
+            return PM3_ESOFT;
+        }
+
+        if (b == blocks - 1) {
+            // key A never reads back, key B only with some access conditions
+            for (uint8_t t = 0; t < 2; t++) {
+                if (ctx->found[t][sector]) {
+                    num_to_bytes(ctx->key[t][sector], MFC_STAGE_KEY_SIZE, data + (t * 10));
+                }
+            }
+        }
+        emlSetMem_xt(data, first + b, 1, 16);
+    }
+
+    ctx->read[sector] = true;
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Check the key list against all sectors, key by key so the most likely keys go first on every sector
+ *
+ * A sector is read as soon as a key for it authenticates and the next candidate is tried with a nested auth,
+ * the card only needs selecting again after a failed auth.
+ */
+int mfc_stage_chk(mfc_stage_ctx_t *ctx) {
+    uint32_t start = GetTickCount();
+
+    int oldbg = g_dbglevel;
+    g_dbglevel = DBG_NONE;
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(false);
+
+    int res = PM3_SUCCESS;
+    bool selected = false;
+    bool authed = false;
+    bool stop = false;
+
+    for (uint16_t i = 0; i < ctx->keycnt && stop == false; i++) {
+        uint64_t key = bytes_to_num(ctx->keys + (i * MFC_STAGE_KEY_SIZE), MFC_STAGE_KEY_SIZE);
+
+        for (uint8_t s = 0; s < ctx->sectors && stop == false; s++) {
+            for (uint8_t t = 0; t < 2 && stop == false; t++) {
+
+                if (ctx->found[t][s]) {
+                    continue;
+                }
+
+                WDT_HIT();
+                if (mfc_stage_abort()) {
+                    res = PM3_EOPABORTED;
+                    goto out;
+                }
+
+                if (selected == false) {
+                    // one retry, the card may just have been between two fields
+                    if (iso14443a_select_card(ctx->uid, &ctx->card, &ctx->cuid, true, 0, true) == false
+                            && iso14443a_select_card(ctx->uid, &ctx->card, &ctx->cuid, true, 0, true) == false) {
+                        res = PM3_ECARDEXCHANGE;
+                        goto out;
+                    }
+                    selected = true;
+                    authed = false;
+                }
+
+                if (mifare_classic_auth(pcs, ctx->cuid, FirstBlockOfSector(s), t, key, authed ? AUTH_NESTED : AUTH_FIRST)) {
+                    // back to idle after a failed auth
+                    uint8_t dummy_answer = 0;
+                    ReaderTransmit(&dummy_answer, 1, NULL);
+                    SpinDelayUs(AUTHENTICATION_TIMEOUT);
+                    crypto1_deinit(pcs);
+                    selected = false;
+                    authed = false;
+                    continue;
+                }
+                authed = true;
+
+                mfc_stage_set_key(ctx, s, t, key);
+
+                if (ctx->read[s] == false && mfc_stage_read_sector(ctx, pcs, s) != PM3_SUCCESS) {
+                    // access conditions, the dump stage tries the other key
+                    crypto1_deinit(pcs);
+                    selected = false;
+                    authed = false;
+                }
+
+                if (ctx->onkey && ctx->onkey(ctx, s, t, key)) {
+                    stop = true;
+                }
+            }
+        }
+
+        if (mfc_stage_all_keys(ctx)) {
+            break;
+        }
+    }
+
+out:
+    if (authed) {
+        mifare_classic_halt(pcs);
+    }
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    g_dbglevel = oldbg;
+    mfc_stage_done(ctx, MFC_STAGE_CHK, start);
+    return res;
+}
+
+/**
+ * @brief Read the sectors with a known key the chk stage didn't read
+ */
+int mfc_stage_dump(mfc_stage_ctx_t *ctx) {
+    uint32_t start = GetTickCount();
+
+    int oldbg = g_dbglevel;
+    g_dbglevel = DBG_NONE;
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    set_tracing(false);
+
+    int res = PM3_SUCCESS;
+    bool selected = false;
+    bool authed = false;
+
+    for (uint8_t s = 0; s < ctx->sectors; s++) {
+        for (uint8_t t = 0; t < 2 && ctx->read[s] == false; t++) {
+
+            if (ctx->found[t][s] == false) {
+                continue;
+            }
+
+            WDT_HIT();
+            if (mfc_stage_abort()) {
+                res = PM3_EOPABORTED;
+                goto out;
+            }
+
+            if (selected == false) {
+                if (iso14443a_select_card(ctx->uid, &ctx->card, &ctx->cuid, true, 0, true) == false) {
+                    res = PM3_ECARDEXCHANGE;
+                    goto out;
+                }
+                selected = true;
+                authed = false;
+            }
+
+            if (mifare_classic_auth(pcs, ctx->cuid, FirstBlockOfSector(s), t, ctx->key[t][s], authed ? AUTH_NESTED : AUTH_FIRST)
+                    || mfc_stage_read_sector(ctx, pcs, s) != PM3_SUCCESS) {
+                crypto1_deinit(pcs);
+                selected = false;
+                authed = false;
+                continue;
+            }
+            authed = true;
+        }
+
+        if (ctx->read[s] == false) {
+            res = PM3_ESOFT;
+        }
+    }
+
+out:
+    if (authed) {
+        mifare_classic_halt(pcs);
+    }
+    crypto1_deinit(pcs);
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    g_dbglevel = oldbg;
+    mfc_stage_done(ctx, MFC_STAGE_DUMP, start);
+    return res;
+}
+
+/**
+ * @brief Write the emulator memory to a file in flash memory, and point a symlink at it
+ */
+int mfc_stage_save(mfc_stage_ctx_t *ctx, const char *filename, const char *symlink) {
+#ifdef WITH_FLASH
+    uint32_t start = GetTickCount();
+
+    int res = rdv40_spiffs_write(filename, BigBuf_get_EM_addr(), mfc_stage_blocks(ctx) * 16, RDV40_SPIFFS_SAFETY_SAFE);
+    if (res == SPIFFS_OK && symlink != NULL) {
+        res = rdv40_spiffs_make_symlink(filename, symlink, RDV40_SPIFFS_SAFETY_SAFE);
+    }
+
+    mfc_stage_done(ctx, MFC_STAGE_SAVE, start);
+    return (res == SPIFFS_OK) ? PM3_SUCCESS : PM3_EFLASH;
+#else
+    (void)ctx;
+    (void)filename;
+    (void)symlink;
+    return PM3_ENOTIMPL;
+#endif
+}
+
+/**
+ * @brief Simulate the emulator memory with the card UID, until the button is pressed
+ */
+int mfc_stage_sim(mfc_stage_ctx_t *ctx) {
+    uint32_t start = GetTickCount();
+
+    uint16_t flags;
+    switch (ctx->card.uidlen) {
+        case 10:
+            flags = FLAG_10B_UID_IN_DATA;
+            break;
+        case 7:
+            flags = FLAG_7B_UID_IN_DATA;
+            break;
+        case 4:
+            flags = FLAG_4B_UID_IN_DATA;
+            break;
+        default:
+            flags = FLAG_UID_IN_EMUL;
+            break;
+    }
+
+    switch (ctx->sectors) {
+        case MIFARE_MINI_MAXSECTOR:
+            flags |= FLAG_MF_MINI;
+            break;
+        case MIFARE_2K_MAXSECTOR:
+            flags |= FLAG_MF_2K;
+            break;
+        case MIFARE_4K_MAXSECTOR:
+            flags |= FLAG_MF_4K;
+            break;
+        default:
+            flags |= FLAG_MF_1K;
+            break;
+    }
+
+    Mifare1ksim(flags, 0, ctx->uid, 0, 0);
+
+    mfc_stage_done(ctx, MFC_STAGE_SIM, start);
+    return PM3_SUCCESS;
+}
+
+// write one block to a gen1a magic card, the magic wakeup is sent with the first block
+static bool mfc_stage_gen1a_write(uint8_t blockno, const uint8_t *data, bool first) {
+    uint8_t wupC1[] = {0x40};
+    uint8_t wupC2[] = {0x43};
+
+    uint8_t answer[MAX_MIFARE_FRAME_SIZE];
+    uint8_t answer_par[MAX_MIFARE_PARITY_SIZE];
+
+    if (first) {
+        iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+        set_tracing(false);
+
+        ReaderTransmitBitsPar(wupC1, 7, NULL, NULL);
+        if (ReaderReceive(answer, answer_par) == 0 || (answer[0] != 0x0a)) {
+            return false;
+        }
+
+        ReaderTransmit(wupC2, sizeof(wupC2), NULL);
+        if (ReaderReceive(answer, answer_par) == 0 || (answer[0] != 0x0a)) {
+            return false;
+        }
+    }
+
+    if ((mifare_sendcmd_short(NULL, CRYPT_NONE, ISO14443A_CMD_WRITEBLOCK, blockno, answer, answer_par, NULL) != 1) || (answer[0] != 0x0a)) {
+        return false;
+    }
+
+    uint8_t d_block[18] = {0x00};
+    memcpy(d_block, data, 16);
+    AddCrc14A(d_block, 16);
+    ReaderTransmit(d_block, sizeof(d_block), NULL);
+    if ((ReaderReceive(answer, answer_par) != 1) || (answer[0] != 0x0a)) {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write the emulator memory to a gen1a magic card
+ */
+int mfc_stage_clone(mfc_stage_ctx_t *ctx) {
+    uint32_t start = GetTickCount();
+
+    int res = PM3_SUCCESS;
+    uint16_t blocks = mfc_stage_blocks(ctx);
+    bool first = true;
+
+    for (uint16_t b = 0; b < blocks; b++) {
+        WDT_HIT();
+
+        uint8_t data[16];
+        emlGetMem(data, b, 1);
+
+        uint8_t retry = 5;
+        while (mfc_stage_gen1a_write(b, data, first) == false) {
+            // wake the card up again before the retry
+            first = true;
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+            SpinDelay(20);
+            if (--retry == 0) {
+                break;
+            }
+        }
+        if (retry == 0) {
+            Dbprintf("clone failed at block %u", b);
+            res = PM3_ESOFT;
+            break;
+        }
+        first = false;
+    }
+
+    if (res == PM3_SUCCESS) {
+        mifare_classic_halt(NULL);
+    }
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    mfc_stage_done(ctx, MFC_STAGE_CLONE, start);
+    return res;
+}
+
+/**
+ * @brief Print the time spent in each stage that ran
+ */
+void mfc_stage_report(const mfc_stage_ctx_t *ctx) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < MFC_STAGE_COUNT; i++) {
+        if (ctx->ran & (1 << i)) {
+            Dbprintf("  %-6s " _YELLOW_("%6u") " ms", mfc_stage_names[i], ctx->ms[i]);
+            total += ctx->ms[i];
+        }
+    }
+    Dbprintf("  total  " _YELLOW_("%6u") " ms", total);
+}
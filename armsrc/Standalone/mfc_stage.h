@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Shared MIFARE Classic stages for standalone modes:
+//   select -> chk -> dump -> save -> sim -> clone
+//
+// The chk stage reads a sector into emulator memory as soon as a key for it
+// authenticates, and keeps the card authenticated to try the next candidate
+// with a nested auth, so most of the dump is done while keys are checked.
+//-----------------------------------------------------------------------------
+#ifndef __MFC_STAGE_H
+#define __MFC_STAGE_H
+
+#include "common.h"
+#include "iso14443a.h"
+#include "mifareutil.h"     // MIFARE_4K_MAXSECTOR
+
+typedef enum {
+    MFC_STAGE_SELECT = 0,
+    MFC_STAGE_CHK,
+    MFC_STAGE_DUMP,
+    MFC_STAGE_SAVE,
+    MFC_STAGE_SIM,
+    MFC_STAGE_CLONE,
+    MFC_STAGE_COUNT
+} mfc_stage_id_t;
+
+typedef struct mfc_stage_ctx mfc_stage_ctx_t;
+
+// called for every key found by the chk stage, return true to stop checking
+typedef bool (*mfc_stage_onkey_t)(mfc_stage_ctx_t *ctx, uint8_t sector, uint8_t keytype, uint64_t key);
+
+struct mfc_stage_ctx {
+    uint8_t uid[10];
+    uint32_t cuid;
+    iso14a_card_select_t card;
+    uint8_t sectors;
+
+    // dictionary, 6 bytes per key
+    uint8_t *keys;
+    uint16_t keycnt;
+
+    // per sector and key type
+    bool found[2][MIFARE_4K_MAXSECTOR];
+    uint64_t key[2][MIFARE_4K_MAXSECTOR];
+    // sector already in emulator memory
+    bool read[MIFARE_4K_MAXSECTOR];
+
+    mfc_stage_onkey_t onkey;
+    uint32_t ms[MFC_STAGE_COUNT];
+    uint8_t ran;        // bit per stage
+};
+
+void mfc_stage_init(mfc_stage_ctx_t *ctx);
+int mfc_stage_keys(mfc_stage_ctx_t *ctx, const uint64_t *keys, uint16_t keycnt, bool use_flash);
+void mfc_stage_set_key(mfc_stage_ctx_t *ctx, uint8_t sector, uint8_t keytype, uint64_t key);
+bool mfc_stage_all_keys(const mfc_stage_ctx_t *ctx);
+bool mfc_stage_any_key(const mfc_stage_ctx_t *ctx);
+
+int mfc_stage_select(mfc_stage_ctx_t *ctx);
+int mfc_stage_chk(mfc_stage_ctx_t *ctx);
+int mfc_stage_dump(mfc_stage_ctx_t *ctx);
+int mfc_stage_save(mfc_stage_ctx_t *ctx, const char *filename, const char *symlink);
+int mfc_stage_sim(mfc_stage_ctx_t *ctx);
+int mfc_stage_clone(mfc_stage_ctx_t *ctx);
+void mfc_stage_report(const mfc_stage_ctx_t *ctx);
+
+#endif
@@ -31,6 +31,7 @@
 #include "printf.h"
 #include "legicrf.h"
 #include "BigBuf.h"
+#include "decoder_stats.h"
 #include "iclass_cmd.h"
 #include "hfops.h"
 #include "iso14443a.h"
@@ -60,6 +61,7 @@
 #include "ticks.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "crc32.h"
 #include "protocols.h"
 #include "mifareutil.h"
 #include "sam_picopass.h"
@@ -249,13 +251,136 @@ static uint32_t MeasureAntennaTuningLfData(void) {
     return (MAX_ADC_LF_VOLTAGE * (SumAdc(ADC_CHAN_LF, 32) >> 1)) >> 14;
 }
 
-void print_stack_usage(void) {
-    for (uint32_t *p = _stack_start; ; ++p) {
-        if (*p != 0xdeadbeef) {
-            Dbprintf("  Max stack usage......... %d / %d bytes", (uint32_t)_stack_end - (uint32_t)p, (uint32_t)_stack_end - (uint32_t)_stack_start);
+// one reading of the stream source in mV
+static uint32_t MeasureAntennaStreamData(uint8_t source) {
+    switch (source) {
+        case ANTENNA_STREAM_LF:
+            return MeasureAntennaTuningLfData();
+        case ANTENNA_STREAM_HF:
+            return MeasureAntennaTuningHfData();
+        case ANTENNA_STREAM_LF_READER:
+            return (MAX_ADC_LF_VOLTAGE * SumAdc(ADC_CHAN_LF, 32)) >> 15;
+        case ANTENNA_STREAM_HF_READER:
+        default:
+            return (MAX_ADC_HF_VOLTAGE * SumAdc(ADC_CHAN_HF, 32)) >> 15;
+    }
+}
+
+// Keeps measuring the antenna,  or an external reader field,  at a fixed rate and sends
+// min / max / mean of every batch.  One frame per batch instead of one round trip per
+// reading,  stops on the button,  on any command from the client or after p->reports
+static void MeasureAntennaStream(const antenna_stream_t *p) {
+
+    if (p->source < ANTENNA_STREAM_LF || p->source > ANTENNA_STREAM_HF_READER || p->batch == 0) {
+        reply_ng(CMD_MEASURE_ANTENNA_STREAM, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    switch (p->source) {
+        case ANTENNA_STREAM_LF:
+            FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_LF_READER | FPGA_LF_ADC_READER_FIELD);
+            FpgaSendCommand(FPGA_CMD_SET_DIVISOR, (p->divisor >= 19) ? p->divisor : LF_DIVISOR_125);
+            break;
+        case ANTENNA_STREAM_HF:
+            FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER);
+            break;
+        default:
+            // we don't want to measure our own signal
+            FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+            FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+            break;
+    }
+    SpinDelay(50);
+    LED_B_ON();
+
+    uint8_t buf[sizeof(antenna_stream_report_t) + ANTENNA_STREAM_MAX_SAMPLES * sizeof(uint16_t)];
+    antenna_stream_report_t *r = (antenna_stream_report_t *)buf;
+    memset(r, 0, sizeof(antenna_stream_report_t));
+    r->source = p->source;
+    // LF voltages go past 65 V
+    r->shift = (p->source == ANTENNA_STREAM_LF || p->source == ANTENNA_STREAM_LF_READER) ? 2 : 0;
+
+    bool with_samples = (p->flags & ANTENNA_STREAM_FLAG_SAMPLES);
+    uint16_t keep = MIN(p->batch, ANTENNA_STREAM_MAX_SAMPLES);
+
+    int res = PM3_SUCCESS;
+    uint32_t next = GetTickCount();
+
+    while (p->reports == 0 || r->seq < p->reports) {
+
+        uint32_t min = UINT32_MAX, max = 0;
+        uint64_t sum = 0;
+        uint16_t n = 0;
+
+        for (; n < p->batch; n++) {
+
+            // fixed rate,  the next reading is due interval_ms after the last was due
+            while (p->interval_ms && (int32_t)(GetTickCount() - next) < 0) {
+                WDT_HIT();
+                if (BUTTON_PRESS() || data_available()) {
+                    res = PM3_EOPABORTED;
+                    break;
+                }
+            }
+            if (res != PM3_SUCCESS || BUTTON_PRESS() || data_available()) {
+                res = PM3_EOPABORTED;
+                break;
+            }
+            next += p->interval_ms;
+            WDT_HIT();
+
+            uint32_t mv = MeasureAntennaStreamData(p->source);
+            min = MIN(min, mv);
+            max = MAX(max, mv);
+            sum += mv;
+
+            // the batch's last readings,  older ones shift out
+            if (with_samples) {
+                uint16_t i = (n < keep) ? n : keep - 1;
+                if (n >= keep) {
+                    memmove(r->samples, r->samples + 1, (keep - 1) * sizeof(uint16_t));
+                }
+                r->samples[i] = MIN(mv >> r->shift, 0xFFFF);
+            }
+        }
+
+        if (n) {
+            r->ticks = GetTickCount();
+            r->count = n;
+            r->nsamples = (with_samples) ? MIN(n, keep) : 0;
+            r->min_mv = min;
+            r->max_mv = max;
+            r->mean_mv = sum / n;
+            reply_ng(CMD_MEASURE_ANTENNA_STREAM, PM3_SUCCESS, buf, sizeof(antenna_stream_report_t) + r->nsamples * sizeof(uint16_t));
+            r->seq++;
+        }
+
+        if (res != PM3_SUCCESS) {
             break;
         }
     }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    reply_ng(CMD_MEASURE_ANTENNA_STREAM, res, NULL, 0);
+}
+
+// deepest stack use seen before the memory profiler repainted the canary
+static uint32_t s_stack_peak = 0;
+
+// stack depth since the canary was painted
+static uint32_t stack_depth(void) {
+    uint32_t *p = _stack_start;
+    while (p < _stack_end && *p == 0xdeadbeef) {
+        ++p;
+    }
+    return (uint32_t)_stack_end - (uint32_t)p;
+}
+
+void print_stack_usage(void) {
+    Dbprintf("  Max stack usage......... %d / %d bytes", MAX(stack_depth(), s_stack_peak), (uint32_t)_stack_end - (uint32_t)_stack_start);
 }
 
 void ReadMem(int addr) {
@@ -394,6 +519,74 @@ static void printConnSpeed(uint32_t wait) {
     }
 }
 
+// Boot time trace,  ms per AppMain() init stage as measured by the RTT.
+// The FPGA image is loaded on the first command instead of at boot,  the T55xx
+// config and the SPIFFS check / garbage collection happen on first use.
+typedef enum {
+    BOOT_STAGE_HW = 0,
+    BOOT_STAGE_LCD,
+    BOOT_STAGE_SMARTCARD,
+    BOOT_STAGE_FLASH,
+    BOOT_STAGE_USART,
+    BOOT_STAGE_USB,
+    BOOT_STAGE_FPGA,        // deferred,  first command
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+static const char *boot_stage_names[BOOT_STAGE_COUNT] = {
+    "hardware setup..........",
+    "lcd.....................",
+    "smartcard i2c...........",
+    "flash unique id.........",
+    "fpc usart...............",
+    "usb enable..............",
+    "fpga image (deferred)...",
+};
+
+static uint32_t boot_stage_at[BOOT_STAGE_COUNT];
+static uint32_t boot_stage_ms[BOOT_STAGE_COUNT];
+static uint8_t boot_stage_ran;
+static uint32_t boot_ready_ms;
+static bool fpga_load_pending = true;
+
+static void boot_stage_start(boot_stage_t stage) {
+    boot_stage_at[stage] = GetTickCount();
+}
+
+static void boot_stage_end(boot_stage_t stage) {
+    boot_stage_ms[stage] = GetTickCountDelta(boot_stage_at[stage]);
+    boot_stage_ran |= (1 << stage);
+}
+
+// the HF image used to be loaded at boot,  now it is loaded before the first command runs
+static void fpga_load_deferred(void) {
+    if (fpga_load_pending == false) {
+        return;
+    }
+    fpga_load_pending = false;
+
+    boot_stage_start(BOOT_STAGE_FPGA);
+    if (FpgaGetCurrent() == 0) {
+        FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+    }
+    boot_stage_end(BOOT_STAGE_FPGA);
+}
+
+static void print_boot_trace(void) {
+    DbpString(_CYAN_("Boot"));
+    for (uint8_t i = 0; i < BOOT_STAGE_COUNT; i++) {
+        if ((boot_stage_ran & (1 << i)) == 0) {
+            continue;
+        }
+        if (i == BOOT_STAGE_FPGA) {
+            Dbprintf("  %s %4u ms, at %u ms", boot_stage_names[i], boot_stage_ms[i], boot_stage_at[i]);
+        } else {
+            Dbprintf("  %s %4u ms", boot_stage_names[i], boot_stage_ms[i]);
+        }
+    }
+    Dbprintf("  ready after............. " _YELLOW_("%4u") " ms", boot_ready_ms);
+}
+
 /**
   * Prints runtime information about the PM3.
 **/
@@ -418,6 +611,7 @@ static void SendStatus(uint32_t wait) {
 
     print_stack_usage();
     print_debug_level();
+    print_boot_trace();
 
     tosend_t *ts = get_tosend();
     Dbprintf("  ToSendMax............... %d", ts->max);
@@ -778,6 +972,82 @@ void ListenReaderField(uint8_t limit) {
         }
     }
 }
+// time spent in PacketReceived per command, see CMD_GET_TIMINGS
+static handler_timing_t handler_timings[HANDLER_TIMING_SLOTS];
+static uint8_t handler_timings_num = 0;
+
+static void handler_timing_add(uint16_t cmd, uint32_t ms) {
+    handler_timing_t *t = NULL;
+    for (uint8_t i = 0; i < handler_timings_num; i++) {
+        if (handler_timings[i].cmd == cmd) {
+            t = &handler_timings[i];
+            break;
+        }
+    }
+    if (t == NULL) {
+        if (handler_timings_num == HANDLER_TIMING_SLOTS) {
+            return;
+        }
+        t = &handler_timings[handler_timings_num++];
+        memset(t, 0, sizeof(handler_timing_t));
+        t->cmd = cmd;
+    }
+    t->count++;
+    t->total_ms += ms;
+    if (ms > t->max_ms) {
+        t->max_ms = MIN(ms, UINT16_MAX);
+    }
+}
+
+// peak stack, peak BigBuf and time per command, see CMD_MEMPROF
+static bool memprof_enabled = false;
+static memprof_entry_t memprof_entries[MEMPROF_SLOTS];
+static uint8_t memprof_num = 0;
+
+// Repaint the stack canary below our own frame,  so the next handler's depth can be measured
+static void memprof_start(void) {
+    uint32_t here = 0;
+    uint32_t *limit = &here - 16;
+
+    s_stack_peak = MAX(stack_depth(), s_stack_peak);
+    for (uint32_t *p = _stack_start; p < limit; ++p) {
+        *p = 0xdeadbeef;
+    }
+    BigBuf_window_reset();
+}
+
+static void memprof_add(uint16_t cmd, uint32_t ms) {
+    uint32_t depth = stack_depth();
+    BigBuf_window_update();
+
+    memprof_entry_t *e = NULL;
+    for (uint8_t i = 0; i < memprof_num; i++) {
+        if (memprof_entries[i].cmd == cmd) {
+            e = &memprof_entries[i];
+            break;
+        }
+    }
+    if (e == NULL) {
+        if (memprof_num == MEMPROF_SLOTS) {
+            return;
+        }
+        e = &memprof_entries[memprof_num++];
+        memset(e, 0, sizeof(memprof_entry_t));
+        e->cmd = cmd;
+    }
+    e->count++;
+    e->total_ms += ms;
+    if (depth > e->peak_stack) {
+        e->peak_stack = MIN(depth, UINT16_MAX);
+    }
+    if (BigBuf_window_peak() > e->peak_bigbuf) {
+        e->peak_bigbuf = BigBuf_window_peak();
+    }
+}
+
+// bytes per reply_raw() call when streaming CMD_DOWNLOAD_BIGBUF_RAW
+#define DOWNLOAD_RAW_CHUNK 4096
+
 static void PacketReceived(PacketCommandNG *packet) {
     /*
     if (packet->ng) {
@@ -936,6 +1206,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             CmdNRZsimTAG(payload->invert, payload->separator, payload->clock, packet->length - sizeof(lf_nrzsim_t), payload->data, true);
             break;
         }
+        case CMD_LF_SIM_BRUTE: {
+            CmdLFSimBrute((lf_simbrute_t *)packet->data.asBytes, packet->length, true);
+            break;
+        }
         case CMD_LF_HID_CLONE: {
             lf_hidsim_t *payload = (lf_hidsim_t *)packet->data.asBytes;
             CopyHIDtoT55x7(payload->hi2, payload->hi, payload->lo, payload->longFMT, payload->Q5, payload->EM, true);
@@ -1038,6 +1312,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             T55xx_ChkPwds(packet->data.asBytes[0] & 0xff, true);
             break;
         }
+        case CMD_LF_T55XX_BRUTE: {
+            T55xx_BruteForce((t55xx_brute_req_t *)packet->data.asBytes, true);
+            break;
+        }
         case CMD_LF_PCF7931_READ: {
             ReadPCF7931(true);
             break;
@@ -1066,9 +1344,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             struct p {
                 uint32_t start_pwd;
                 uint32_t n;
+                uint8_t resume;
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
-            EM4xBruteforce(payload->start_pwd, payload->n, true);
+            bool resume = (packet->length >= sizeof(struct p)) && payload->resume;
+            EM4xBruteforce(payload->start_pwd, payload->n, resume, true);
             break;
         }
         case CMD_LF_EM4X_READWORD: {
@@ -1136,7 +1416,11 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_LF_HITAG_SIMULATE: { // Simulate Hitag tag, args = memory content
-            SimulateHitag2(true);
+            uint16_t collect = 0;
+            if (packet->ng && packet->length >= sizeof(lf_hitag2_sim_t)) {
+                collect = ((lf_hitag2_sim_t *) packet->data.asBytes)->collect;
+            }
+            SimulateHitag2(collect, true);
             break;
         }
         case CMD_LF_HITAG2_CRACK: {
@@ -1304,8 +1588,9 @@ static void PacketReceived(PacketCommandNG *packet) {
             break;
         }
         case CMD_HF_ISO15693_SNIFF: {
-            SniffIso15693(0, NULL, false);
-            reply_ng(CMD_HF_ISO15693_SNIFF, PM3_SUCCESS, NULL, 0);
+            uint8_t param = (packet->length) ? packet->data.asBytes[0] : 0;
+            SniffIso15693(0, NULL, false, param);
+            reply_decoder_stats(CMD_HF_ISO15693_SNIFF, PM3_SUCCESS);
             break;
         }
         case CMD_HF_ISO15693_COMMAND: {
@@ -1325,6 +1610,15 @@ static void PacketReceived(PacketCommandNG *packet) {
             ReaderIso15693(NULL);
             break;
         }
+        case CMD_HF_ISO15693_INVENTORY: {
+            InventoryIso15693(packet->data.asBytes[0]);
+            break;
+        }
+        case CMD_HF_ISO15693_DUMP: {
+            iso15_dump_req_t *payload = (iso15_dump_req_t *)packet->data.asBytes;
+            DumpIso15693(payload);
+            break;
+        }
         case CMD_HF_ISO15693_EML_CLEAR: {
             //-----------------------------------------------------------------------------
             // Note: we call FpgaDownloadAndGo(FPGA_BITSTREAM_HF_15) here although FPGA is not
@@ -1363,12 +1657,13 @@ static void PacketReceived(PacketCommandNG *packet) {
                 return;
             }
 
+            int mark = BigBuf_mark("15 eml getmem");
             uint8_t *buf = BigBuf_malloc(payload->length);
             emlGet(buf, payload->offset, payload->length);
             LED_B_ON();
             reply_ng(CMD_HF_ISO15693_EML_GETMEM, PM3_SUCCESS, buf, payload->length);
             LED_B_OFF();
-            BigBuf_free_keep_EM();
+            BigBuf_release(mark);
             break;
         }
         case CMD_HF_ISO15693_SIMULATE: {
@@ -1517,6 +1812,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             read_14b_st_block(payload->blockno);
             break;
         }
+        case CMD_HF_SRI_DUMP: {
+            struct p {
+                uint8_t lastblock;
+            } PACKED;
+            struct p *payload = (struct p *) packet->data.asBytes;
+            read_14b_srx_dump(payload->lastblock);
+            break;
+        }
         case CMD_HF_ISO14443B_SNIFF: {
             SniffIso14443b();
             reply_ng(CMD_HF_ISO14443B_SNIFF, PM3_SUCCESS, NULL, 0);
@@ -1542,6 +1845,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             felica_sendraw(packet);
             break;
         }
+        case CMD_HF_FELICA_DUMP: {
+            felica_dump((felica_dump_req_t *) packet->data.asBytes);
+            break;
+        }
         case CMD_HF_FELICALITE_SIMULATE: {
             struct p {
                 uint8_t uid[8];
@@ -1615,13 +1922,21 @@ static void PacketReceived(PacketCommandNG *packet) {
         }
         case CMD_HF_ISO14443A_SNIFF: {
             SniffIso14443a(packet->data.asBytes[0]);
-            reply_ng(CMD_HF_ISO14443A_SNIFF, PM3_SUCCESS, NULL, 0);
+            reply_decoder_stats(CMD_HF_ISO14443A_SNIFF, PM3_SUCCESS);
             break;
         }
         case CMD_HF_ISO14443A_READER: {
             ReaderIso14443a(packet);
             break;
         }
+        case CMD_HF_ISO14443A_INVENTORY: {
+            iso14443a_inventory(packet->data.asBytes[0]);
+            break;
+        }
+        case CMD_HF_ISO14443A_APDU_BATCH: {
+            iso14_apdu_batch(packet->data.asBytes, packet->length);
+            break;
+        }
         case CMD_HF_ISO14443A_SIMULATE: {
             struct p {
                 uint8_t tagtype;
@@ -1633,6 +1948,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             SimulateIso14443aTag(payload->tagtype, payload->flags, payload->uid, payload->exitAfter);  // ## Simulate iso14443a tag - pass tag type & UID
             break;
         }
+        case CMD_HF_ISO14443A_REPLAY: {
+            ReplayIso14443aTag((const iso14a_replay_param_t *) packet->data.asBytes);
+            break;
+        }
         case CMD_HF_ISO14443A_ANTIFUZZ: {
             struct p {
                 uint8_t flag;
@@ -1660,9 +1979,10 @@ static void PacketReceived(PacketCommandNG *packet) {
                 uint8_t first_run;
                 uint8_t blockno;
                 uint8_t key_type;
+                uint8_t sets;
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
-            ReaderMifare(payload->first_run, payload->blockno, payload->key_type);
+            ReaderMifare(payload->first_run, payload->blockno, payload->key_type, payload->sets);
             break;
         }
         case CMD_HF_MIFARE_READBL: {
@@ -1702,6 +2022,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareUReadCard(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFAREU_READCARD_FAST: {
+            MifareUReadCardFast((mfu_readcard_t *) packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFAREUC_SETPWD: {
             MifareUSetPwd(packet->oldarg[0], packet->data.asBytes);
             break;
@@ -1710,6 +2034,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareReadSector(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFARE_READCARD: {
+            MifareReadCard(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_WRITEBL: {
             uint8_t block_no = packet->oldarg[0];
             uint8_t key_type = packet->oldarg[1];
@@ -1785,6 +2113,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareChkKeys_fast(packet->oldarg[0], packet->oldarg[1], packet->oldarg[2], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFARE_STATIC_NESTED_CHK: {
+            MifareStaticNestedChk(packet->data.asBytes);
+            break;
+        }
+        case CMD_HF_MIFARE_CHKKEYS_STREAM: {
+            MifareChkKeys_stream(packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_CHKKEYS_FILE: {
             struct p {
                 uint8_t filename[32];
@@ -1843,6 +2179,63 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareECardLoadExt(payload->sectorcnt, payload->keytype);
             break;
         }
+        case CMD_HF_MIFARE_EML_LOAD_BULK: {
+            MifareEMemLoadBulk((eml_bulk_t *) packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_HF_MIFARE_MAGIC_LOAD_BULK: {
+            MifareMagicLoadBulk((eml_bulk_t *) packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_HF_MIFARE_EML_SNAPSHOT: {
+            if (packet->length < sizeof(eml_snapshot_req_t)) {
+                reply_ng(CMD_HF_MIFARE_EML_SNAPSHOT, PM3_EINVARG, NULL, 0);
+                break;
+            }
+            eml_snapshot_req_t *payload = (eml_snapshot_req_t *) packet->data.asBytes;
+
+            int res = PM3_EINVARG;
+            switch (payload->action) {
+                case EML_SNAPSHOT_SAVE:
+                    res = emlSnapshotSave(payload->name, payload->size);
+                    break;
+                case EML_SNAPSHOT_LOAD:
+                    res = emlSnapshotLoad(payload->name);
+                    break;
+                case EML_SNAPSHOT_LIST: {
+                    eml_snapshot_info_t list[EML_SNAPSHOT_MAX];
+                    uint8_t n = emlSnapshotList(list);
+                    reply_ng(CMD_HF_MIFARE_EML_SNAPSHOT, PM3_SUCCESS, (uint8_t *)list, n * sizeof(eml_snapshot_info_t));
+                    return;
+                }
+                case EML_SNAPSHOT_CLEAR:
+                    emlSnapshotClear();
+                    res = PM3_SUCCESS;
+                    break;
+                default:
+                    break;
+            }
+            reply_ng(CMD_HF_MIFARE_EML_SNAPSHOT, res, NULL, 0);
+            break;
+        }
+        case CMD_HF_MIFARE_EML_CRC: {
+            eml_crc_req_t *payload = (eml_crc_req_t *) packet->data.asBytes;
+            if (packet->length < sizeof(eml_crc_req_t) || payload->chunk == 0 ||
+                    (payload->offset + payload->length) > CARD_MEMORY_SIZE ||
+                    ((payload->length + payload->chunk - 1) / payload->chunk) > EML_CRC_MAX_CHUNKS) {
+                reply_ng(CMD_HF_MIFARE_EML_CRC, PM3_EINVARG, NULL, 0);
+                break;
+            }
+
+            const uint8_t *em = BigBuf_get_EM_addr() + payload->offset;
+            uint8_t crcs[EML_CRC_MAX_CHUNKS * 4];
+            uint16_t n = 0;
+            for (uint16_t i = 0; i < payload->length; i += payload->chunk, n++) {
+                crc32_ex(em + i, MIN(payload->chunk, payload->length - i), crcs + (n * 4));
+            }
+            reply_ng(CMD_HF_MIFARE_EML_CRC, PM3_SUCCESS, crcs, n * 4);
+            break;
+        }
         // Gen1a / 1b - "magic Chinese" card
         case CMD_HF_MIFARE_CSETBL: {
             MifareCSetBlock(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
@@ -1950,6 +2343,18 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareSendCommand(packet->data.asBytes);
             break;
         }
+        case CMD_HF_DESFIRE_CHKKEYS: {
+            MifareDesfireCheckKeys(packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_HF_DESFIRE_BRUTEAID: {
+            MifareDesfireBruteAID(packet->data.asBytes, packet->length);
+            break;
+        }
+        case CMD_HF_MIFAREPLUS_CHKKEYS: {
+            MifarePlusCheckKeys(packet->data.asBytes, packet->length);
+            break;
+        }
         case CMD_HF_MIFARE_NACK_DETECT: {
             DetectNACKbug();
             break;
@@ -2001,11 +2406,13 @@ static void PacketReceived(PacketCommandNG *packet) {
         case CMD_HF_ICLASS_SNIFF: {
             struct p {
                 uint8_t jam_search_len;
-                uint8_t jam_search_string[];
+                uint8_t jam_search_string[2];
+                uint8_t param;  // optional
             } PACKED;
             struct p *payload = (struct p *) packet->data.asBytes;
-            SniffIClass(payload->jam_search_len, payload->jam_search_string);
-            reply_ng(CMD_HF_ICLASS_SNIFF, PM3_SUCCESS, NULL, 0);
+            uint8_t param = (packet->length >= sizeof(struct p)) ? payload->param : 0;
+            SniffIClass(payload->jam_search_len, payload->jam_search_string, param);
+            reply_decoder_stats(CMD_HF_ICLASS_SNIFF, PM3_SUCCESS);
             break;
         }
         case CMD_HF_ICLASS_SIMULATE: {
@@ -2117,6 +2524,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             SmartCardRaw((smart_card_raw_t *) packet->data.asBytes);
             break;
         }
+        case CMD_SMART_I2C: {
+            SmartCardI2C((smart_i2c_req_t *) packet->data.asBytes);
+            break;
+        }
         case CMD_SMART_UPLOAD: {
             // upload file from client
             struct p {
@@ -2349,6 +2760,16 @@ static void PacketReceived(PacketCommandNG *packet) {
             }
             break;
         }
+        case CMD_MEASURE_ANTENNA_STREAM: {
+            if (packet->length != sizeof(antenna_stream_t)) {
+                reply_ng(CMD_MEASURE_ANTENNA_STREAM, PM3_EINVARG, NULL, 0);
+                break;
+            }
+            antenna_stream_t p;
+            memcpy(&p, packet->data.asBytes, sizeof(p));
+            MeasureAntennaStream(&p);
+            break;
+        }
         case CMD_LISTEN_READER_FIELD: {
             if (packet->length != sizeof(uint8_t))
                 break;
@@ -2396,6 +2817,8 @@ static void PacketReceived(PacketCommandNG *packet) {
             // flag =
             //    b0  0 skip
             //        1 clear bigbuff
+            //    b1  0 data is one byte per sample
+            //        1 data is run length encoded,  (run, value) pairs
             struct p {
                 uint8_t flag;
                 uint16_t offset;
@@ -2415,10 +2838,33 @@ static void PacketReceived(PacketCommandNG *packet) {
                 reply_ng(CMD_LF_UPLOAD_SIM_SAMPLES, PM3_EOVFLOW, NULL, 0);
                 break;
             }
-            // ensure len bytes copied won't go past end of bigbuf
-            uint16_t len = MIN(BigBuf_get_size() - payload->offset, sizeof(payload->data));
-
             uint8_t *mem = BigBuf_get_addr();
+            uint16_t datalen = MIN(packet->length - sizeof(uint8_t) - sizeof(uint16_t), sizeof(payload->data));
+
+            if ((payload->flag & 0x2) == 0x2) {
+                uint32_t pos = payload->offset;
+                int status = PM3_SUCCESS;
+                for (uint16_t i = 0; i + 1 < datalen; i += 2) {
+                    uint8_t run = payload->data[i];
+                    if (run == 0) {
+                        break;
+                    }
+                    if (pos + run > BigBuf_get_size()) {
+                        run = BigBuf_get_size() - pos;
+                        status = PM3_EOVFLOW;
+                    }
+                    memset(mem + pos, payload->data[i + 1], run);
+                    pos += run;
+                    if (status != PM3_SUCCESS) {
+                        break;
+                    }
+                }
+                reply_ng(CMD_LF_UPLOAD_SIM_SAMPLES, status, NULL, 0);
+                break;
+            }
+
+            // ensure len bytes copied won't go past end of bigbuf
+            uint16_t len = MIN(BigBuf_get_size() - payload->offset, datalen);
 
             memcpy(mem + payload->offset, &payload->data, len);
             reply_ng(CMD_LF_UPLOAD_SIM_SAMPLES, PM3_SUCCESS, NULL, 0);
@@ -2446,6 +2892,60 @@ static void PacketReceived(PacketCommandNG *packet) {
             LED_B_OFF();
             break;
         }
+        case CMD_DOWNLOAD_BIGBUF_RAW: {
+            download_raw_t *payload = (download_raw_t *) packet->data.asBytes;
+
+            uint8_t *mem = (payload->flags & DOWNLOAD_RAW_FLAG_EML) ? BigBuf_get_EM_addr() : BigBuf_get_addr();
+            uint32_t maxlen = (payload->flags & DOWNLOAD_RAW_FLAG_EML) ? CARD_MEMORY_SIZE : BigBuf_get_size();
+
+            if ((payload->startidx > maxlen) || (payload->len > maxlen - payload->startidx)) {
+                // In raw receive mode anything we send now would end up in the client buffer,
+                // stay silent and let it time out.  The compressed path is framed, tell the client.
+                if (payload->flags & DOWNLOAD_RAW_FLAG_LZ4) {
+                    reply_mix(CMD_ACK, 0, 0, 0, 0, 0);
+                }
+                break;
+            }
+
+            LED_B_ON();
+            mem += payload->startidx;
+
+            if (payload->flags & DOWNLOAD_RAW_FLAG_LZ4) {
+                int result = reply_lz4(mem, payload->len);
+                if (result != PM3_SUCCESS) {
+                    Dbprintf("compressed transfer to client failed :: result: %d", result);
+                }
+            } else {
+                // client knows the length it asked for, no need to announce it.
+                // Stream in big chunks, keeping the watchdog happy in between.
+                for (uint32_t i = 0; i < payload->len; i += DOWNLOAD_RAW_CHUNK) {
+                    WDT_HIT();
+                    uint32_t len = MIN(payload->len - i, DOWNLOAD_RAW_CHUNK);
+                    int result = reply_raw(mem + i, len);
+                    if (result != PM3_SUCCESS) {
+                        Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+                        break;
+                    }
+                }
+            }
+
+            // one CRC over the whole transfer instead of one per packet
+            uint8_t first = 0, second = 0;
+            compute_crc(CRC_14443_A, mem, payload->len, &first, &second);
+
+            // Same finish signal as CMD_DOWNLOAD_BIGBUF
+            // arg0 = status of download transfer
+            // arg1 = crc
+            // arg2 = tracelen
+            // asbytes = samplingconfig array
+            if (payload->flags & DOWNLOAD_RAW_FLAG_EML) {
+                reply_mix(CMD_ACK, 1, (first << 8) | second, 0, 0, 0);
+            } else {
+                reply_mix(CMD_ACK, 1, (first << 8) | second, BigBuf_get_traceLen(), getSamplingConfig(), sizeof(sample_config));
+            }
+            LED_B_OFF();
+            break;
+        }
         case CMD_READ_MEM: {
             if (packet->length != sizeof(uint32_t))
                 break;
@@ -2535,6 +3035,7 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             uint32_t size = packet->oldarg[1];
 
+            int mark = BigBuf_mark("spiffs download");
             uint8_t *buff = BigBuf_malloc(size);
             if (buff == NULL) {
                 if (g_dbglevel >= DBG_DEBUG) Dbprintf("Could not allocate buffer");
@@ -2544,18 +3045,24 @@ static void PacketReceived(PacketCommandNG *packet) {
                 rdv40_spiffs_read_as_filetype((char *)filename, (uint8_t *)buff, size, RDV40_SPIFFS_SAFETY_SAFE);
                 // arg0 = filename
                 // arg1 = size
-                // arg2 = RFU
+                // arg2 = flags
 
-                for (size_t i = 0; i < size; i += PM3_CMD_DATA_SIZE) {
-                    size_t len = MIN((size - i), PM3_CMD_DATA_SIZE);
-                    int result = reply_old(CMD_SPIFFS_DOWNLOADED, i, len, 0, buff + i, len);
+                if (packet->oldarg[2] & SPIFFS_DOWNLOAD_FLAG_LZ4) {
+                    int result = reply_lz4(buff, size);
                     if (result != PM3_SUCCESS)
-                        Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+                        Dbprintf("compressed transfer to client failed :: result: %d", result);
+                } else {
+                    for (size_t i = 0; i < size; i += PM3_CMD_DATA_SIZE) {
+                        size_t len = MIN((size - i), PM3_CMD_DATA_SIZE);
+                        int result = reply_old(CMD_SPIFFS_DOWNLOADED, i, len, 0, buff + i, len);
+                        if (result != PM3_SUCCESS)
+                            Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+                    }
                 }
                 // Trigger a finish downloading signal with an ACK frame
                 reply_ng(CMD_SPIFFS_DOWNLOAD, PM3_SUCCESS, NULL, 0);
-                BigBuf_free();
             }
+            BigBuf_release(mark);
             LED_B_OFF();
             break;
         }
@@ -2721,6 +3228,10 @@ static void PacketReceived(PacketCommandNG *packet) {
                 Flash_CheckBusy(BUSY_TIMEOUT);
                 Flash_WriteEnable();
                 Flash_Erase4k(3, 0xB);
+            } else if (payload->startidx == DEFAULT_DICT_INDEX_OFFSET) {
+                Flash_CheckBusy(BUSY_TIMEOUT);
+                Flash_WriteEnable();
+                Flash_Erase4k(3, 0x7);
             } else if (payload->startidx == FLASH_MEM_SIGNATURE_OFFSET) {
                 Flash_CheckBusy(BUSY_TIMEOUT);
                 Flash_WriteEnable();
@@ -2757,6 +3268,7 @@ static void PacketReceived(PacketCommandNG *packet) {
         case CMD_FLASHMEM_DOWNLOAD: {
 
             LED_B_ON();
+            int mark = BigBuf_mark("flash download");
             uint8_t *mem = BigBuf_malloc(PM3_CMD_DATA_SIZE);
             uint32_t startidx = packet->oldarg[0];
             uint32_t numofbytes = packet->oldarg[1];
@@ -2765,6 +3277,7 @@ static void PacketReceived(PacketCommandNG *packet) {
             // arg2 = RFU
 
             if (FlashInit() == false) {
+                BigBuf_release(mark);
                 break;
             }
 
@@ -2782,13 +3295,14 @@ static void PacketReceived(PacketCommandNG *packet) {
             FlashStop();
 
             reply_mix(CMD_ACK, 1, 0, 0, 0, 0);
-            BigBuf_free();
+            BigBuf_release(mark);
             LED_B_OFF();
             break;
         }
         case CMD_FLASHMEM_INFO: {
 
             LED_B_ON();
+            int mark = BigBuf_mark("flash info");
             rdv40_validation_t *info = (rdv40_validation_t *)BigBuf_malloc(sizeof(rdv40_validation_t));
 
             bool isok = Flash_ReadData(FLASH_MEM_SIGNATURE_OFFSET, info->signature, FLASH_MEM_SIGNATURE_LEN);
@@ -2798,7 +3312,7 @@ static void PacketReceived(PacketCommandNG *packet) {
                 FlashStop();
             }
             reply_mix(CMD_ACK, isok, 0, 0, info, sizeof(rdv40_validation_t));
-            BigBuf_free();
+            BigBuf_release(mark);
 
             LED_B_OFF();
             break;
@@ -2873,6 +3387,92 @@ static void PacketReceived(PacketCommandNG *packet) {
             RunMod();
             break;
         }
+        case CMD_BATCH: {
+            // run the sub-commands in order and send all their replies in one go
+            uint8_t count = packet->data.asBytes[0];
+            uint16_t offset = 1;
+
+            reply_capture_start();
+
+            for (uint8_t i = 0; i < count; i++) {
+
+                if (offset + sizeof(batch_cmd_hdr_t) > packet->length) {
+                    break;
+                }
+
+                batch_cmd_hdr_t *hdr = (batch_cmd_hdr_t *)(packet->data.asBytes + offset);
+                if (offset + sizeof(batch_cmd_hdr_t) + hdr->length > packet->length) {
+                    break;
+                }
+                offset += sizeof(batch_cmd_hdr_t) + hdr->length;
+
+                // no nesting
+                if (hdr->cmd == CMD_BATCH) {
+                    continue;
+                }
+
+                PacketCommandNG sub;
+                memset(&sub.data, 0, sizeof(sub.data));
+                sub.cmd = hdr->cmd;
+                sub.ng = hdr->ng;
+                sub.magic = COMMANDNG_PREAMBLE_MAGIC;
+                sub.crc = COMMANDNG_POSTAMBLE_MAGIC;
+
+                if (hdr->ng) {
+                    memcpy(sub.data.asBytes, hdr->data, hdr->length);
+                    sub.length = hdr->length;
+                } else {
+                    uint64_t arg[3] = {0};
+                    if (hdr->length < sizeof(arg)) {
+                        continue;
+                    }
+                    memcpy(arg, hdr->data, sizeof(arg));
+                    sub.oldarg[0] = arg[0];
+                    sub.oldarg[1] = arg[1];
+                    sub.oldarg[2] = arg[2];
+                    memcpy(sub.data.asBytes, hdr->data + sizeof(arg), hdr->length - sizeof(arg));
+                    sub.length = hdr->length - sizeof(arg);
+                }
+
+                PacketReceived(&sub);
+            }
+
+            uint16_t len = 0, dropped = 0;
+            const uint8_t *replies = reply_capture_stop(&len, &dropped);
+            reply_ng(CMD_BATCH, (dropped) ? PM3_EOVFLOW : PM3_SUCCESS, replies, len);
+            break;
+        }
+        case CMD_GET_TIMINGS: {
+            uint8_t flags = packet->data.asBytes[0];
+            reply_ng(CMD_GET_TIMINGS, PM3_SUCCESS, (uint8_t *)handler_timings, handler_timings_num * sizeof(handler_timing_t));
+            if (flags & HANDLER_TIMING_FLAG_RESET) {
+                handler_timings_num = 0;
+            }
+            break;
+        }
+        case CMD_MEMPROF: {
+            uint8_t flags = packet->data.asBytes[0];
+            if (flags & MEMPROF_FLAG_ENABLE) {
+                memprof_enabled = true;
+            }
+            if (flags & MEMPROF_FLAG_DISABLE) {
+                memprof_enabled = false;
+            }
+
+            uint8_t buf[sizeof(memprof_t) + sizeof(memprof_entries)];
+            memprof_t *mp = (memprof_t *)buf;
+            mp->enabled = memprof_enabled;
+            mp->num = memprof_num;
+            mp->stack_size = (uint32_t)_stack_end - (uint32_t)_stack_start;
+            mp->bigbuf_size = BigBuf_get_size();
+            memcpy(mp->entries, memprof_entries, memprof_num * sizeof(memprof_entry_t));
+            reply_ng(CMD_MEMPROF, PM3_SUCCESS, buf, sizeof(memprof_t) + memprof_num * sizeof(memprof_entry_t));
+
+            if (flags & MEMPROF_FLAG_RESET) {
+                memprof_num = 0;
+            }
+            break;
+        }
         case CMD_CAPABILITIES: {
             SendCapabilities();
             break;
@@ -2893,6 +3493,7 @@ static void PacketReceived(PacketCommandNG *packet) {
 #endif
         case CMD_FINISH_WRITE:
         case CMD_HARDWARE_RESET: {
+            reply_tx_flush();
             usb_disable();
 
             // (iceman) why this wait?
@@ -2906,6 +3507,7 @@ static void PacketReceived(PacketCommandNG *packet) {
             if (g_common_area.flags.bootrom_present) {
                 g_common_area.command = COMMON_AREA_COMMAND_ENTER_FLASH_MODE;
             }
+            reply_tx_flush();
             usb_disable();
             AT91C_BASE_RSTC->RSTC_RCR = RST_CONTROL_KEY | AT91C_RSTC_PROCRST;
             // We're going to flash, and the bootrom will take control.
@@ -2930,6 +3532,11 @@ static void PacketReceived(PacketCommandNG *packet) {
 void  __attribute__((noreturn)) AppMain(void) {
 
     SpinDelay(100);
+
+    // RTT based ms counter first, it times the stages below
+    StartTickCount();
+    boot_stage_start(BOOT_STAGE_HW);
+
     BigBuf_initialize();
 
     // Add stack canary
@@ -2957,21 +3564,25 @@ void  __attribute__((noreturn)) AppMain(void) {
     // Configure MUX
     SetAdcMuxFor(GPIO_MUXSEL_HIPKD);
 
-    // Load the FPGA image, which we have stored in our flash.
-    // (the HF version by default)
-    FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+    boot_stage_end(BOOT_STAGE_HW);
 
-    StartTickCount();
+    // The FPGA image, which we have stored in our flash, is loaded by fpga_load_deferred()
+    // before the first command is handled. Standalone modes load the image they need.
 
 #ifdef WITH_LCD
+    boot_stage_start(BOOT_STAGE_LCD);
     LCDInit();
+    boot_stage_end(BOOT_STAGE_LCD);
 #endif
 
 #ifdef WITH_SMARTCARD
+    boot_stage_start(BOOT_STAGE_SMARTCARD);
     I2C_init(false);
+    boot_stage_end(BOOT_STAGE_SMARTCARD);
 #endif
 
 #ifdef WITH_FLASH
+    boot_stage_start(BOOT_STAGE_FLASH);
     if (FlashInit()) {
         uint64_t flash_uniqueID = 0;
         if (!Flash_CheckBusy(BUSY_TIMEOUT)) { // OK because firmware was built for devices with flash
@@ -2980,22 +3591,16 @@ void  __attribute__((noreturn)) AppMain(void) {
         FlashStop();
         usb_update_serial(flash_uniqueID);
     }
-#endif
+    boot_stage_end(BOOT_STAGE_FLASH);
 
-
-#ifdef WITH_FLASH
-    // If flash is not present, BUSY_TIMEOUT kicks in, let's do it after USB
-    loadT55xxConfig();
-
-    //
-    // Enforce a spiffs check/garbage collection at boot so we are likely to never
-    // fall under the 2 contigous free blocks availables
-    // This is a time-consuming process on large flash.
-    rdv40_spiffs_check();
+    // The T55xx config is read from flash by the first T55xx command (see lfops.c),
+    // the spiffs check/garbage collection runs on the first mount (see spiffs.c)
 #endif
 
 #ifdef WITH_FPC_USART
+    boot_stage_start(BOOT_STAGE_USART);
     usart_init(USART_BAUD_RATE, USART_PARITY);
+    boot_stage_end(BOOT_STAGE_USART);
 #endif
 
     allow_send_wtx = true;
@@ -3004,8 +3609,11 @@ void  __attribute__((noreturn)) AppMain(void) {
     // against device such as http://www.hobbytronics.co.uk/usb-host-board-v2
     // In other words, keep the interval between usb_enable() and the main loop as short as possible.
     // (AT91F_CDC_Enumerate() will be called in the main loop)
+    boot_stage_start(BOOT_STAGE_USB);
     usb_disable();
     usb_enable();
+    boot_stage_end(BOOT_STAGE_USB);
+    boot_ready_ms = GetTickCount();
 
     for (;;) {
         WDT_HIT();
@@ -3018,13 +3626,27 @@ void  __attribute__((noreturn)) AppMain(void) {
             while (1);
         }
 
+        // push out what is left of queued replies
+        reply_tx_poll();
+
         // Check if there is a packet available
         PacketCommandNG rx;
         memset(&rx.data, 0, sizeof(rx.data));
 
         int ret = receive_ng(&rx);
         if (ret == PM3_SUCCESS) {
+            fpga_load_deferred();
+            bool profile = memprof_enabled;
+            if (profile) {
+                memprof_start();
+            }
+            uint32_t start = GetTickCount();
             PacketReceived(&rx);
+            uint32_t ms = GetTickCountDelta(start);
+            handler_timing_add(rx.cmd, ms);
+            if (profile) {
+                memprof_add(rx.cmd, ms);
+            }
         } else if (ret != PM3_ENODATA) {
 
             Dbprintf("Error in frame reception: %d %s", ret, (ret == PM3_EIO) ? "PM3_EIO" : "");
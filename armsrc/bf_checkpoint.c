@@ -0,0 +1,194 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Flash checkpoints for the long running LF password brute forces
+//
+// A running search writes its position to SPIFFS every
+// BF_CHECKPOINT_INTERVAL_MS,  a power loss or USB disconnect costs at most
+// that much work.  The new position goes to a .tmp file first which is then
+// renamed over the old one,  a write torn by a power loss leaves the previous
+// checkpoint in place.  Without flash memory all of this is a no-op.
+//-----------------------------------------------------------------------------
+#include "bf_checkpoint.h"
+
+#include "string.h"
+#include "printf.h"
+#include "pm3_cmd.h"
+#include "ticks.h"
+#include "dbprint.h"
+#include "spiffs.h"
+
+static const char *bf_checkpoint_files[] = {
+    [BF_CP_EM4X50] = "lf_em4x50_brute.bin",
+    [BF_CP_EM4X05] = "lf_em4x05_brute.bin",
+    [BF_CP_EM4X70] = "lf_em4x70_brute.bin",
+};
+
+static const char *bf_checkpoint_names[] = {
+    [BF_CP_EM4X50] = "EM4x50",
+    [BF_CP_EM4X05] = "EM4x05",
+    [BF_CP_EM4X70] = "EM4x70",
+};
+
+#define BF_CHECKPOINT_TMP   ".tmp"
+
+static bool bf_checkpoint_kind_ok(uint8_t kind) {
+    return (kind >= BF_CP_EM4X50 && kind <= BF_CP_LAST);
+}
+
+void bf_checkpoint_init(bf_checkpoint_t *cp, uint8_t kind, const void *args, size_t arglen, uint64_t total) {
+    memset(cp, 0, sizeof(bf_checkpoint_t));
+    cp->magic = BF_CHECKPOINT_MAGIC;
+    cp->version = BF_CHECKPOINT_VERSION;
+    cp->kind = kind;
+    cp->total = total;
+    if (args) {
+        memcpy(cp->args, args, MIN(arglen, sizeof(cp->args)));
+    }
+    cp->last_ms = GetTickCount();
+}
+
+#ifdef WITH_FLASH
+static bool bf_checkpoint_read(const char *fn, uint8_t kind, bf_checkpoint_t *cp) {
+    if (exists_in_spiffs(fn) == false || size_in_spiffs(fn) != sizeof(bf_checkpoint_t)) {
+        return false;
+    }
+
+    rdv40_spiffs_read(fn, (uint8_t *)cp, sizeof(bf_checkpoint_t), RDV40_SPIFFS_SAFETY_SAFE);
+    return (cp->magic == BF_CHECKPOINT_MAGIC && cp->version == BF_CHECKPOINT_VERSION && cp->kind == kind);
+}
+#endif
+
+int bf_checkpoint_load(uint8_t kind, bf_checkpoint_t *cp) {
+    if (bf_checkpoint_kind_ok(kind) == false) {
+        return PM3_EINVARG;
+    }
+
+#ifdef WITH_FLASH
+    char tmp[SPIFFS_OBJ_NAME_LEN];
+    sprintf(tmp, "%s" BF_CHECKPOINT_TMP, bf_checkpoint_files[kind]);
+
+    int changed = rdv40_spiffs_lazy_mount();
+
+    // a .tmp only survives on its own when the rename got interrupted
+    bool ok = bf_checkpoint_read(bf_checkpoint_files[kind], kind, cp);
+    if (ok == false) {
+        ok = bf_checkpoint_read(tmp, kind, cp);
+    }
+
+    if (changed) {
+        rdv40_spiffs_lazy_unmount();
+    }
+
+    cp->last_ms = GetTickCount();
+    return ok ? PM3_SUCCESS : PM3_ENODATA;
+#else
+    return PM3_ENOTIMPL;
+#endif
+}
+
+int bf_checkpoint_save(bf_checkpoint_t *cp) {
+    cp->last_ms = GetTickCount();
+
+    if (bf_checkpoint_kind_ok(cp->kind) == false) {
+        return PM3_EINVARG;
+    }
+
+#ifdef WITH_FLASH
+    const char *fn = bf_checkpoint_files[cp->kind];
+    char tmp[SPIFFS_OBJ_NAME_LEN];
+    sprintf(tmp, "%s" BF_CHECKPOINT_TMP, fn);
+
+    int changed = rdv40_spiffs_lazy_mount();
+
+    rdv40_spiffs_write(tmp, (uint8_t *)cp, sizeof(bf_checkpoint_t), RDV40_SPIFFS_SAFETY_SAFE);
+    if (exists_in_spiffs(fn)) {
+        rdv40_spiffs_remove(fn, RDV40_SPIFFS_SAFETY_SAFE);
+    }
+    rdv40_spiffs_rename(tmp, fn, RDV40_SPIFFS_SAFETY_SAFE);
+
+    if (changed) {
+        rdv40_spiffs_lazy_unmount();
+    }
+    return PM3_SUCCESS;
+#else
+    return PM3_ENOTIMPL;
+#endif
+}
+
+void bf_checkpoint_clear(uint8_t kind) {
+    if (bf_checkpoint_kind_ok(kind) == false) {
+        return;
+    }
+
+#ifdef WITH_FLASH
+    char tmp[SPIFFS_OBJ_NAME_LEN];
+    sprintf(tmp, "%s" BF_CHECKPOINT_TMP, bf_checkpoint_files[kind]);
+
+    int changed = rdv40_spiffs_lazy_mount();
+
+    if (exists_in_spiffs(bf_checkpoint_files[kind])) {
+        rdv40_spiffs_remove(bf_checkpoint_files[kind], RDV40_SPIFFS_SAFETY_SAFE);
+    }
+    if (exists_in_spiffs(tmp)) {
+        rdv40_spiffs_remove(tmp, RDV40_SPIFFS_SAFETY_SAFE);
+    }
+
+    if (changed) {
+        rdv40_spiffs_lazy_unmount();
+    }
+#endif
+}
+
+void bf_checkpoint_print(const bf_checkpoint_t *cp, const char *prefix) {
+    if (bf_checkpoint_kind_ok(cp->kind) == false) {
+        return;
+    }
+
+    if (cp->total) {
+        uint32_t permille = (uint32_t)((cp->tried * 1000) / cp->total);
+        Dbprintf("%s %s brute, tried " _YELLOW_("%llu") " of %llu ( " _YELLOW_("%u.%u%%") " ) at 0x%08llx"
+                 , prefix
+                 , bf_checkpoint_names[cp->kind]
+                 , cp->tried
+                 , cp->total
+                 , permille / 10, permille % 10
+                 , cp->gen.current_key
+                );
+    } else {
+        Dbprintf("%s %s brute, tried " _YELLOW_("%llu") " at 0x%08llx"
+                 , prefix
+                 , bf_checkpoint_names[cp->kind]
+                 , cp->tried
+                 , cp->gen.current_key
+                );
+    }
+}
+
+void bf_checkpoint_tick(bf_checkpoint_t *cp) {
+    cp->tried++;
+
+    if (GetTickCountDelta(cp->last_ms) < BF_CHECKPOINT_INTERVAL_MS) {
+        return;
+    }
+
+#ifdef WITH_FLASH
+    bf_checkpoint_save(cp);
+    bf_checkpoint_print(cp, "Checkpoint,");
+#else
+    cp->last_ms = GetTickCount();
+    bf_checkpoint_print(cp, "Progress,");
+#endif
+}
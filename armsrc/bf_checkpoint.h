@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Flash checkpoints for the long running LF password brute forces
+//-----------------------------------------------------------------------------
+#ifndef __BF_CHECKPOINT_H
+#define __BF_CHECKPOINT_H
+
+#include "common.h"
+#include "bruteforce.h"
+
+// how often a running brute force writes its position to flash
+#define BF_CHECKPOINT_INTERVAL_MS   (60 * 1000)
+
+#define BF_CHECKPOINT_MAGIC         0x50434642  // BFCP
+#define BF_CHECKPOINT_VERSION       1
+
+typedef enum {
+    BF_CP_EM4X50 = 1,
+    BF_CP_EM4X05,
+    BF_CP_EM4X70,
+    BF_CP_LAST = BF_CP_EM4X70,
+} bf_checkpoint_kind_t;
+
+typedef struct {
+    uint32_t magic;
+    uint8_t kind;
+    uint8_t version;
+    // keys tried so far and size of the search,  total 0 when unknown
+    uint64_t tried;
+    uint64_t total;
+    // EM4x05 password candidates
+    uint32_t found;
+    // position,  EM4x05 / EM4x70 keep theirs in current_key
+    generator_context_t gen;
+    // the command payload,  enough to restart the search headless
+    uint8_t args[48];
+    // not meaningful on flash
+    uint32_t last_ms;
+} bf_checkpoint_t;
+
+void bf_checkpoint_init(bf_checkpoint_t *cp, uint8_t kind, const void *args, size_t arglen, uint64_t total);
+int bf_checkpoint_load(uint8_t kind, bf_checkpoint_t *cp);
+int bf_checkpoint_save(bf_checkpoint_t *cp);
+void bf_checkpoint_clear(uint8_t kind);
+
+// count one tried key,  saves and prints progress every BF_CHECKPOINT_INTERVAL_MS
+void bf_checkpoint_tick(bf_checkpoint_t *cp);
+void bf_checkpoint_print(const bf_checkpoint_t *cp, const char *prefix);
+
+#endif
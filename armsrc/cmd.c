@@ -14,11 +14,13 @@
 // See LICENSE.txt for the text of the license.
 //-----------------------------------------------------------------------------
 #include "cmd.h"
+#include "proxmark3_arm.h"
 #include "usb_cdc.h"
 #include "usart.h"
 #include "crc16.h"
 #include "string.h"
 #include "BigBuf.h"
+#include "lz4.h"
 
 // Flags to tell where to add CRC on sent replies
 bool g_reply_with_crc_on_usb = false;
@@ -27,7 +29,176 @@ bool g_reply_with_crc_on_fpc = true;
 bool g_reply_via_fpc = false;
 bool g_reply_via_usb = false;
 
+// USB transmit queue.
+// Replies are copied here and fed to the two hardware banks of the IN endpoint as they get free,
+// so a handler doesn't have to wait for each 64 bytes chunk to drain before going back to RF work.
+// The queue is pumped on every new reply, from data_available() and from the main loop.
+#define USB_TX_QUEUE_SIZE (2 * sizeof(PacketResponseNGRaw))
+
+static uint8_t usb_txq[USB_TX_QUEUE_SIZE];
+static uint16_t usb_txq_tail = 0;       // next byte to hand to the UDP
+static uint16_t usb_txq_count = 0;      // bytes waiting
+static bool usb_txq_loaded = false;     // a bank holds bytes which isn't requested yet
+static bool usb_txq_zlp = false;        // last packet was a full one,  terminate it with a ZLP
+
+// Returns true when everything queued has been handed over to the UDP
+static bool usb_txq_pump(void) {
+
+    // someone else is feeding the endpoint FIFO,  don't mix bytes.
+    if (async_usb_write_in_progress()) {
+        return false;
+    }
+
+    while (usb_txq_loaded || usb_txq_count || usb_txq_zlp) {
+
+        if (usb_txq_loaded == false) {
+            uint16_t n = MIN(usb_txq_count, AT91C_USB_EP_IN_SIZE);
+            for (uint16_t i = 0; i < n; i++) {
+                async_usb_write_pushByte(usb_txq[usb_txq_tail]);
+                usb_txq_tail = (usb_txq_tail + 1) % USB_TX_QUEUE_SIZE;
+            }
+            usb_txq_count -= n;
+            usb_txq_zlp = ((n == AT91C_USB_EP_IN_SIZE) && (usb_txq_count == 0));
+            usb_txq_loaded = true;
+        }
+
+        // both banks busy
+        if (async_usb_write_requestWrite() == false) {
+            return false;
+        }
+        usb_txq_loaded = false;
+    }
+    return true;
+}
+
+// Non blocking,  hand as much as possible of the queued replies to the UDP
+void reply_tx_poll(void) {
+    if (usb_txq_loaded || usb_txq_count || usb_txq_zlp) {
+        usb_txq_pump();
+    }
+}
+
+// Free bytes in the USB transmit queue,  a reply of this size is queued without waiting
+size_t reply_tx_room(void) {
+    reply_tx_poll();
+    return USB_TX_QUEUE_SIZE - usb_txq_count;
+}
+
+// Blocks until all queued replies are handed to the UDP
+int reply_tx_flush(void) {
+    while (usb_txq_pump() == false) {
+        if (async_usb_write_in_progress()) {
+            return PM3_EIO;
+        }
+        if (usb_check() == false) {
+            // host is gone,  drop it all
+            usb_txq_count = 0;
+            usb_txq_loaded = false;
+            usb_txq_zlp = false;
+            return PM3_EIO;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+static int usb_write_queued(const uint8_t *data, size_t len) {
+
+    if (usb_check() == false) {
+        return PM3_EIO;
+    }
+
+    while (len) {
+        // make room
+        while (usb_txq_count == USB_TX_QUEUE_SIZE) {
+            usb_txq_pump();
+            if (async_usb_write_in_progress() || (usb_check() == false)) {
+                return PM3_EIO;
+            }
+        }
+
+        uint16_t head = (usb_txq_tail + usb_txq_count) % USB_TX_QUEUE_SIZE;
+        uint16_t n = MIN(len, USB_TX_QUEUE_SIZE - usb_txq_count);
+        n = MIN(n, USB_TX_QUEUE_SIZE - head);
+        memcpy(usb_txq + head, data, n);
+        usb_txq_count += n;
+        data += n;
+        len -= n;
+    }
+
+    usb_txq_pump();
+    return PM3_SUCCESS;
+}
+
+// usb_write() talks to the endpoint directly,  anything queued has to go first
+static int usb_write_sync(const uint8_t *data, size_t len) {
+    int res = reply_tx_flush();
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    return usb_write(data, len);
+}
+
+// CMD_BATCH reply collection.
+// While active, replies are appended to reply_capture_buf instead of being sent.
+static bool reply_capture_active = false;
+static uint8_t reply_capture_buf[PM3_CMD_DATA_SIZE];
+static uint16_t reply_capture_len = 0;
+static uint16_t reply_capture_dropped = 0;
+
+void reply_capture_start(void) {
+    reply_capture_active = true;
+    reply_capture_len = 0;
+    reply_capture_dropped = 0;
+}
+
+// stops collecting, returns the collected replies and the number of replies which didn't fit
+const uint8_t *reply_capture_stop(uint16_t *len, uint16_t *dropped) {
+    reply_capture_active = false;
+    *len = reply_capture_len;
+    *dropped = reply_capture_dropped;
+    return reply_capture_buf;
+}
+
+// debug prints and wtx are meant to get to the client right away
+static bool reply_capture_wanted(uint16_t cmd) {
+    if (reply_capture_active == false) {
+        return false;
+    }
+    switch (cmd) {
+        case CMD_DEBUG_PRINT_STRING:
+        case CMD_DEBUG_PRINT_INTEGERS:
+        case CMD_DEBUG_PRINT_BYTES:
+        case CMD_WTX:
+            return false;
+    }
+    return true;
+}
+
+static int reply_capture(uint16_t cmd, int16_t status, const uint8_t *data, size_t len, bool ng) {
+    if (reply_capture_len + sizeof(batch_reply_hdr_t) + len > sizeof(reply_capture_buf)) {
+        reply_capture_dropped++;
+        return PM3_EOVFLOW;
+    }
+
+    batch_reply_hdr_t *hdr = (batch_reply_hdr_t *)(reply_capture_buf + reply_capture_len);
+    hdr->cmd = cmd;
+    hdr->status = status;
+    hdr->length = len;
+    hdr->ng = ng;
+    if (data && len) {
+        memcpy(hdr->data, data, len);
+    }
+    reply_capture_len += sizeof(batch_reply_hdr_t) + len;
+    return PM3_SUCCESS;
+}
+
 int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+
+    // collected as a MIX reply
+    if (reply_capture_wanted(cmd & 0xFFFF)) {
+        return reply_mix(cmd, arg0, arg1, arg2, data, len);
+    }
+
     PacketResponseOLD txcmd = {CMD_UNKNOWN, {0, 0, 0}, {{0}}};
 
     for (size_t i = 0; i < sizeof(PacketResponseOLD); i++)
@@ -54,7 +225,7 @@ int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const v
     // Send frame and make sure all bytes are transmitted
 
     if (g_reply_via_usb) {
-        resultusb = usb_write((uint8_t *)&txcmd, sizeof(PacketResponseOLD));
+        resultusb = usb_write_sync((uint8_t *)&txcmd, sizeof(PacketResponseOLD));
     }
 
     if (g_reply_via_fpc) {
@@ -73,6 +244,11 @@ int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const v
 }
 
 static int reply_ng_internal(uint16_t cmd, int16_t status, const uint8_t *data, size_t len, bool ng) {
+
+    if (reply_capture_wanted(cmd)) {
+        return reply_capture(cmd, status, data, MIN(len, PM3_CMD_DATA_SIZE), ng);
+    }
+
     PacketResponseNGRaw txBufferNG;
     size_t txBufferNGLen;
 
@@ -114,7 +290,7 @@ static int reply_ng_internal(uint16_t cmd, int16_t status, const uint8_t *data,
     // Send frame and make sure all bytes are transmitted
 
     if (g_reply_via_usb) {
-        resultusb = usb_write((uint8_t *)&txBufferNG, txBufferNGLen);
+        resultusb = usb_write_queued((uint8_t *)&txBufferNG, txBufferNGLen);
     }
     if (g_reply_via_fpc) {
 #ifdef WITH_FPC_USART_HOST
@@ -156,6 +332,72 @@ int reply_mix(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const v
     return reply_ng_internal((cmd & 0xFFFF), status, cmddata, len + sizeof(arg), false);
 }
 
+// Send len bytes as a series of CMD_DOWNLOADED_LZ4 replies.  Each one is an independent LZ4 block
+// filling a whole frame,  so the client needs no state between chunks.  Incompressible data costs
+// the 8 byte chunk header only.
+int reply_lz4(const uint8_t *data, size_t len) {
+
+    if (data == NULL || len == 0) {
+        return PM3_EINVARG;
+    }
+
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+    download_lz4_t *out = (download_lz4_t *)buf;
+
+    size_t pos = 0;
+    while (pos < len) {
+        WDT_HIT();
+        int srclen = len - pos;
+        int dstlen = LZ4_compress_destSize((const char *)data + pos, (char *)out->data, &srclen, sizeof(buf) - sizeof(download_lz4_t));
+        if (dstlen <= 0 || srclen <= 0) {
+            return PM3_ESOFT;
+        }
+
+        out->offset = pos;
+        out->rawlen = srclen;
+        int res = reply_ng(CMD_DOWNLOADED_LZ4, PM3_SUCCESS, buf, sizeof(download_lz4_t) + dstlen);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        pos += srclen;
+    }
+    return PM3_SUCCESS;
+}
+
+// Send unframed bytes, the client must be in raw receive mode to accept them.
+int reply_raw(const uint8_t *data, size_t len) {
+
+    if (data == NULL || len == 0) {
+        return PM3_EINVARG;
+    }
+
+#ifdef WITH_FPC_USART_HOST
+    int resultfpc = PM3_EUNDEF;
+#endif
+    int resultusb = PM3_EUNDEF;
+
+    if (g_reply_via_usb) {
+        resultusb = usb_write_sync(data, len);
+    }
+    if (g_reply_via_fpc) {
+#ifdef WITH_FPC_USART_HOST
+        resultfpc = usart_writebuffer_sync(data, len);
+#else
+        return PM3_EDEVNOTSUPP;
+#endif
+    }
+
+    if (g_reply_via_usb && (resultusb != PM3_SUCCESS)) {
+        return resultusb;
+    }
+#ifdef WITH_FPC_USART_HOST
+    if (g_reply_via_fpc && (resultfpc != PM3_SUCCESS)) {
+        return resultfpc;
+    }
+#endif
+    return PM3_SUCCESS;
+}
+
 static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *data, size_t len), bool usb, bool fpc) {
 
     PacketCommandNGRaw rx_raw;
@@ -30,7 +30,16 @@ extern bool g_reply_via_usb;
 int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
 int reply_ng(uint16_t cmd, int16_t status, const uint8_t *data, size_t len);
 int reply_mix(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
+int reply_raw(const uint8_t *data, size_t len);
+int reply_lz4(const uint8_t *data, size_t len);
 int receive_ng(PacketCommandNG *rx);
 
+void reply_capture_start(void);
+const uint8_t *reply_capture_stop(uint16_t *len, uint16_t *dropped);
+
+void reply_tx_poll(void);
+size_t reply_tx_room(void);
+int reply_tx_flush(void);
+
 #endif // _PROXMARK_CMD_H_
 
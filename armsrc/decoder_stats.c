@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Opt-in timing of the RF sample decoders,  build with DECODER_STATS=1
+//
+// The SSC clock counter uses all three timer counters while decoding,  so times
+// come from the otherwise unused PIT.  One unit is 16 MCK cycles, 1/3 us.
+//-----------------------------------------------------------------------------
+#include "decoder_stats.h"
+
+#include "string.h"
+#include "cmd.h"
+
+#ifdef WITH_DECODER_STATS
+
+#define PIT_CPIV_MASK 0x000FFFFF
+
+decoder_stats_t g_decoder_stats;
+
+void decoder_stats_reset(void) {
+    memset(&g_decoder_stats, 0, sizeof(g_decoder_stats));
+    // free running,  wraps every 0.35s which is plenty for a single sample
+    AT91C_BASE_PITC->PITC_PIMR = AT91C_PITC_PITEN | PIT_CPIV_MASK;
+}
+
+uint32_t RAMFUNC decoder_stats_now(void) {
+    return AT91C_BASE_PITC->PITC_PIIR & PIT_CPIV_MASK;
+}
+
+void RAMFUNC decoder_stats_add(uint8_t id, uint32_t start) {
+    uint32_t delta = (decoder_stats_now() - start) & PIT_CPIV_MASK;
+    decoder_stat_t *s = &g_decoder_stats.dec[id];
+    s->calls++;
+    s->total += delta;
+    if (delta > s->max) {
+        s->max = delta;
+    }
+}
+
+void reply_decoder_stats(uint16_t cmd, int16_t status) {
+    reply_ng(cmd, status, (uint8_t *)&g_decoder_stats, sizeof(g_decoder_stats));
+}
+
+#else
+
+void reply_decoder_stats(uint16_t cmd, int16_t status) {
+    reply_ng(cmd, status, NULL, 0);
+}
+
+#endif
@@ -0,0 +1,55 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Opt-in timing of the RF sample decoders,  build with DECODER_STATS=1
+//-----------------------------------------------------------------------------
+
+#ifndef DECODER_STATS_H
+#define DECODER_STATS_H
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+#ifdef WITH_DECODER_STATS
+
+#include "proxmark3_arm.h"
+
+extern decoder_stats_t g_decoder_stats;
+
+void decoder_stats_reset(void);
+uint32_t RAMFUNC decoder_stats_now(void);
+void RAMFUNC decoder_stats_add(uint8_t id, uint32_t start);
+
+// evaluates to the decoder result expr,  timed against decoder id
+#define DECODER_TIMED(id, expr)  ({ uint32_t _ds_start = decoder_stats_now(); __typeof__(expr) _ds_res = (expr); decoder_stats_add((id), _ds_start); _ds_res; })
+// a sample was overwritten in the SSC receive holding register before we read it
+#define DECODER_SSC_SR(sr)       do { if ((sr) & AT91C_SSC_OVRUN) g_decoder_stats.overruns++; } while (0)
+#define DECODER_DMA_BACKLOG(n)   do { if ((uint32_t)(n) > g_decoder_stats.max_backlog) g_decoder_stats.max_backlog = (n); } while (0)
+#define DECODER_DMA_LOST()       g_decoder_stats.dma_lost++
+
+#else
+
+#define decoder_stats_reset()
+#define DECODER_TIMED(id, expr)  (expr)
+#define DECODER_SSC_SR(sr)       (void)(sr)
+#define DECODER_DMA_BACKLOG(n)
+#define DECODER_DMA_LOST()
+
+#endif
+
+// Final reply of a sniff or simulation.  Carries decoder_stats_t when built with DECODER_STATS=1
+void reply_decoder_stats(uint16_t cmd, int16_t status);
+
+#endif
@@ -28,6 +28,7 @@
 #include "spiffs.h"
 #include "appmain.h" // tear
 #include "bruteforce.h"
+#include "bf_checkpoint.h"
 
 // Sam7s has several timers, we will use the source TIMER_CLOCK1 (aka AT91C_TC_CLKS_TIMER_DIV1_CLOCK)
 // TIMER_CLOCK1 = MCK/2, MCK is running at 48 MHz, Timer is running at 48/2 = 24 MHz
@@ -636,22 +637,34 @@ static int login(uint32_t password) {
 // searching for password using chosen bruteforce algorithm
 static bool brute(const em4x50_data_t *etd, uint32_t *pwd) {
 
-    generator_context_t ctx;
+    bf_checkpoint_t cp;
+    generator_context_t *ctx = &cp.gen;
     bool pwd_found = false;
     int generator_ret = 0;
     int cnt = 0;
 
-    bf_generator_init(&ctx, etd->bruteforce_mode, BF_KEY_SIZE_32);
+    if (etd->bruteforce_resume && bf_checkpoint_load(BF_CP_EM4X50, &cp) == PM3_SUCCESS) {
+        bf_checkpoint_print(&cp, "Resuming");
+    } else {
+        if (etd->bruteforce_resume) {
+            Dbprintf("No EM4x50 brute checkpoint found");
+            return false;
+        }
 
-    if (etd->bruteforce_mode == BF_MODE_CHARSET) {
-        bf_generator_set_charset(&ctx, etd->bruteforce_charset);
-    } else if (etd->bruteforce_mode == BF_MODE_RANGE) {
-        ctx.range_low = etd->password1;
-        ctx.range_high = etd->password2;
+        bf_checkpoint_init(&cp, BF_CP_EM4X50, etd, sizeof(em4x50_data_t), 0);
+        bf_generator_init(ctx, etd->bruteforce_mode, BF_KEY_SIZE_32);
+
+        if (etd->bruteforce_mode == BF_MODE_CHARSET) {
+            bf_generator_set_charset(ctx, etd->bruteforce_charset);
+        } else if (etd->bruteforce_mode == BF_MODE_RANGE) {
+            ctx->range_low = etd->password1;
+            ctx->range_high = etd->password2;
+        }
+        cp.total = bf_generator_count(ctx);
     }
 
-    while ((generator_ret = bf_generate(&ctx)) == BF_GENERATOR_NEXT) {
-        *pwd = bf_get_key32(&ctx);
+    while ((generator_ret = bf_generate(ctx)) == BF_GENERATOR_NEXT) {
+        *pwd = bf_get_key32(ctx);
 
         WDT_HIT();
 
@@ -671,6 +684,8 @@ static bool brute(const em4x50_data_t *etd, uint32_t *pwd) {
                 break;
         }
 
+        bf_checkpoint_tick(&cp);
+
         // print password every 500 iterations
         if ((++cnt % 500) == 0) {
 
@@ -685,15 +700,22 @@ static bool brute(const em4x50_data_t *etd, uint32_t *pwd) {
             Dbprintf("|%8i | 0x%08x | 0x%08x |", cnt, reflect32(*pwd), *pwd);
         }
 
-        if (BUTTON_PRESS())
+        if (BUTTON_PRESS()) {
+            bf_checkpoint_save(&cp);
+            bf_checkpoint_print(&cp, "Interrupted,");
             break;
-
+        }
     }
 
     // print footer
     if (cnt >= 500)
         Dbprintf("|---------+------------+------------|");
 
+    // done with this search,  found or exhausted
+    if (pwd_found || generator_ret != BF_GENERATOR_NEXT) {
+        bf_checkpoint_clear(BF_CP_EM4X50);
+    }
+
     return pwd_found;
 }
 
@@ -23,6 +23,7 @@
 #include "commonutil.h"
 #include "optimized_cipherutils.h"
 #include "em4x70.h"
+#include "bf_checkpoint.h"
 #include "appmain.h" // tear
 
 static em4x70_tag_t tag = { 0 };
@@ -371,7 +372,7 @@ static int set_byte(uint8_t *target, uint16_t value) {
     return c;
 }
 
-static int bruteforce(const uint8_t address, const uint8_t *rnd, const uint8_t *frnd, uint16_t start_key, uint8_t *response) {
+static int bruteforce(const uint8_t address, const uint8_t *rnd, const uint8_t *frnd, uint16_t start_key, uint8_t *response, bf_checkpoint_t *cp) {
 
     uint8_t auth_resp[3] = {0};
     uint8_t rev_rnd[7];
@@ -430,8 +431,14 @@ static int bruteforce(const uint8_t address, const uint8_t *rnd, const uint8_t *
             return PM3_SUCCESS;
         }
 
+        // next one to try,  so a resume continues right after this one
+        cp->gen.current_key = k + 1;
+        bf_checkpoint_tick(cp);
+
         if (BUTTON_PRESS() || data_available()) {
             Dbprintf("EM4x70 Bruteforce Interrupted");
+            bf_checkpoint_save(cp);
+            bf_checkpoint_print(cp, "Interrupted,");
             return PM3_EOPABORTED;
         }
     }
@@ -855,6 +862,25 @@ void em4x70_brute(const em4x70_data_t *etd, bool ledcontrol) {
     int status = PM3_ESOFT;
     uint8_t response[2] = {0};
 
+    // a resume takes address, rnd and frnd from the checkpoint
+    bf_checkpoint_t cp;
+    em4x70_data_t resumed;
+    uint16_t start_key = etd->start_key;
+    if (etd->resume) {
+        if (bf_checkpoint_load(BF_CP_EM4X70, &cp) != PM3_SUCCESS) {
+            Dbprintf("No EM4x70 brute checkpoint found");
+            reply_ng(CMD_LF_EM4X70_BRUTE, PM3_ENODATA, NULL, 0);
+            return;
+        }
+        memcpy(&resumed, cp.args, sizeof(resumed));
+        etd = &resumed;
+        start_key = cp.gen.current_key;
+        bf_checkpoint_print(&cp, "Resuming");
+    } else {
+        bf_checkpoint_init(&cp, BF_CP_EM4X70, etd, sizeof(em4x70_data_t), 0x10000 - etd->start_key);
+        cp.gen.current_key = etd->start_key;
+    }
+
     command_parity = etd->parity;
 
     // Disable to prevent sending corrupted data to the tag.
@@ -871,7 +897,12 @@ void em4x70_brute(const em4x70_data_t *etd, bool ledcontrol) {
     if (get_signalproperties() && find_em4x70_tag()) {
 
         // Bruteforce partial key
-        status = bruteforce(etd->address, etd->rnd, etd->frnd, etd->start_key, response);
+        status = bruteforce(etd->address, etd->rnd, etd->frnd, start_key, response, &cp);
+
+        // found or exhausted,  nothing left to resume
+        if (status == PM3_SUCCESS || status == PM3_ESOFT) {
+            bf_checkpoint_clear(BF_CP_EM4X70);
+        }
     }
 
     StopTicks();
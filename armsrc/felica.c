@@ -617,6 +617,277 @@ void felica_sendraw(const PacketCommandNG *c) {
     return;
 }
 
+//-----------------------------------------------------------------------------
+// Device side dump of FeliCa standard cards.
+//-----------------------------------------------------------------------------
+// Polls every system code,  enumerates the services of each system with Search Service Code
+// and reads the services which need no authentication with as many blocks per Read Without
+// Encryption as the card accepts.  Everything is collected in BigBuf,  the client downloads
+// it in one go.
+#define FELICA_DUMP_RETRIES         3
+#define FELICA_DUMP_POLL_ROUNDS     8
+// 1 len + 1 code + 8 IDm + 2 status + 1 count + 15 * 16 fills the length byte of the answer
+#define FELICA_DUMP_MAX_BLOCKS      15
+#define FELICA_DUMP_MAX_INDEX       0x400
+// status flag 2,  illegal number of blocks
+#define FELICA_SF2_BLOCK_COUNT      0xA2
+
+// command header in frameSpace,  returns the next write position.
+static uint8_t felica_frame_begin(uint8_t cmd, const uint8_t *idm) {
+    uint8_t c = 0;
+    frameSpace[c++] = 0xb2;
+    frameSpace[c++] = 0x4d;
+    c++; // length,  set by felica_frame_exchange
+    frameSpace[c++] = cmd;
+    if (idm) {
+        memcpy(frameSpace + c, idm, 8);
+        c += 8;
+    }
+    return c;
+}
+
+// adds length and CRC to frameSpace,  sends it and waits for an answer with a valid CRC and the expected response code.
+static bool felica_frame_exchange(uint8_t c, uint8_t ack) {
+
+    frameSpace[2] = c - 2;
+    AddCrc(frameSpace + 2, c - 2);
+
+    for (uint8_t i = 0; i < FELICA_DUMP_RETRIES; i++) {
+        TransmitFor18092_AsReader(frameSpace, c + 2, NULL, 1, 0);
+        if (WaitForFelicaReply(1024) &&
+                FelicaFrame.framebytes[3] == ack &&
+                check_crc(CRC_FELICA, FelicaFrame.framebytes + 2, FelicaFrame.len - 2)) {
+            return true;
+        }
+        WDT_HIT();
+    }
+    return false;
+}
+
+static bool felica_poll_system(uint16_t sc, felica_dump_system_t *sys) {
+    uint8_t c = felica_frame_begin(FELICA_POLL_REQ, NULL);
+    frameSpace[c++] = sc >> 8;
+    frameSpace[c++] = sc & 0xFF;
+    frameSpace[c++] = 0x01; // request code,  answer with the system code
+    frameSpace[c++] = 0x00; // timeslot
+    if (felica_frame_exchange(c, FELICA_POLL_ACK) == false) {
+        return false;
+    }
+
+    const uint8_t *fb = FelicaFrame.framebytes;
+    memcpy(sys->IDm, fb + 4, 8);
+    memcpy(sys->PMm, fb + 12, 8);
+    sys->code = sc;
+    // the card tells which system answered a wildcard
+    if (fb[2] >= 20) {
+        sys->code = (fb[20] << 8) | fb[21];
+    }
+    return true;
+}
+
+static int felica_dump_poll(const felica_dump_req_t *req, felica_dump_resp_t *resp) {
+
+    for (uint8_t round = 0; round < FELICA_DUMP_POLL_ROUNDS && resp->count == 0; round++) {
+        WDT_HIT();
+
+        if (req->sc_count) {
+            for (uint8_t i = 0; i < req->sc_count; i++) {
+                if (felica_poll_system(req->sc[i], &resp->systems[resp->count])) {
+                    resp->count++;
+                }
+            }
+            continue;
+        }
+
+        if (felica_poll_system(0xFFFF, &resp->systems[0]) == false) {
+            continue;
+        }
+        resp->count = 1;
+
+        // Request System Code,  one system code per system.  Keep the wildcard answer if the card doesn't support it
+        uint8_t c = felica_frame_begin(FELICA_REQSYSCODE_REQ, resp->systems[0].IDm);
+        if (felica_frame_exchange(c, FELICA_REQSYSCODE_ACK) == false) {
+            break;
+        }
+
+        uint8_t sc[FELICA_DUMP_MAX_SYSTEMS * 2];
+        uint8_t n = MIN(FelicaFrame.framebytes[12], FELICA_DUMP_MAX_SYSTEMS);
+        memcpy(sc, FelicaFrame.framebytes + 13, n * 2);
+
+        // every system has its own IDm
+        resp->count = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            if (felica_poll_system((sc[i * 2] << 8) | sc[i * 2 + 1], &resp->systems[resp->count])) {
+                resp->count++;
+            }
+        }
+    }
+
+    return (resp->count) ? PM3_SUCCESS : PM3_ECARDEXCHANGE;
+}
+
+// reads blocks 0.. of one service into out,  returns the number of blocks read.
+static uint16_t felica_dump_read_service(const uint8_t *idm, uint16_t service, uint8_t *blocks_per_read, uint8_t *out, uint16_t max_blocks, uint8_t *status) {
+
+    uint16_t blk = 0;
+    uint8_t n = *blocks_per_read;
+
+    status[0] = 0;
+    status[1] = 0;
+
+    while (blk < max_blocks) {
+        WDT_HIT();
+
+        n = MIN(n, max_blocks - blk);
+
+        uint8_t c = felica_frame_begin(FELICA_RDBLK_REQ, idm);
+        frameSpace[c++] = 0x01;
+        frameSpace[c++] = service & 0xFF;
+        frameSpace[c++] = service >> 8;
+        frameSpace[c++] = n;
+        for (uint8_t i = 0; i < n; i++) {
+            uint16_t b = blk + i;
+            if (b < 0x100) {
+                frameSpace[c++] = 0x80;
+                frameSpace[c++] = b;
+            } else {
+                // 3 byte block list element,  block number little endian
+                frameSpace[c++] = 0x00;
+                frameSpace[c++] = b & 0xFF;
+                frameSpace[c++] = b >> 8;
+            }
+        }
+
+        if (felica_frame_exchange(c, FELICA_RDBLK_ACK) == false) {
+            status[0] = 0xFF;
+            status[1] = 0xFF;
+            break;
+        }
+
+        const uint8_t *fb = FelicaFrame.framebytes;
+        if (fb[12] != 0 || fb[14] != n || fb[2] < 13 + n * FELICA_DUMP_BLOCK_SIZE) {
+            status[0] = fb[12];
+            status[1] = fb[13];
+            if (n == 1) {
+                // past the last block of the service
+                break;
+            }
+            // too many blocks for the card,  step down once and remember for the following services.
+            // Any other error may be the end of the service within this request
+            if (fb[12] != 0 && fb[13] == FELICA_SF2_BLOCK_COUNT) {
+                n--;
+                *blocks_per_read = n;
+            } else {
+                n /= 2;
+            }
+            continue;
+        }
+
+        memcpy(out + blk * FELICA_DUMP_BLOCK_SIZE, fb + 15, n * FELICA_DUMP_BLOCK_SIZE);
+        blk += n;
+    }
+    return blk;
+}
+
+static int felica_dump_services(uint8_t si, felica_dump_resp_t *resp, uint8_t *dump, uint8_t *blocks_per_read) {
+
+    const uint8_t *idm = resp->systems[si].IDm;
+
+    for (uint16_t idx = 0; idx < FELICA_DUMP_MAX_INDEX; idx++) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            return PM3_EOPABORTED;
+        }
+
+        uint8_t c = felica_frame_begin(FELICA_SRCHSYSCODE_REQ, idm);
+        frameSpace[c++] = idx & 0xFF;
+        frameSpace[c++] = idx >> 8;
+        if (felica_frame_exchange(c, FELICA_SRCHSYSCODE_ACK) == false) {
+            return PM3_ECARDEXCHANGE;
+        }
+
+        const uint8_t *fb = FelicaFrame.framebytes;
+        uint16_t code = fb[12] | (fb[13] << 8);
+        if (code == 0xFFFF) {
+            break;
+        }
+
+        // area code + end service code
+        if (fb[2] - 10 >= 4) {
+            continue;
+        }
+
+        if (resp->bb_len + sizeof(felica_dump_service_t) > FELICA_DUMP_BUF) {
+            resp->truncated = true;
+            break;
+        }
+
+        felica_dump_service_t *svc = (felica_dump_service_t *)(dump + resp->bb_len);
+        svc->system = si;
+        svc->code = code;
+        svc->block_cnt = 0;
+        svc->status[0] = 0;
+        svc->status[1] = 0;
+        resp->bb_len += sizeof(felica_dump_service_t);
+        resp->services++;
+
+        if ((code & 0x01) == 0) {
+            continue;
+        }
+
+        uint16_t max_blocks = (FELICA_DUMP_BUF - resp->bb_len) / FELICA_DUMP_BLOCK_SIZE;
+        svc->block_cnt = felica_dump_read_service(idm, code, blocks_per_read, dump + resp->bb_len, max_blocks, svc->status);
+        resp->bb_len += svc->block_cnt * FELICA_DUMP_BLOCK_SIZE;
+
+        if (svc->block_cnt == max_blocks) {
+            resp->truncated = true;
+            break;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+void felica_dump(const felica_dump_req_t *req) {
+
+    felica_dump_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    if (req->sc_count > FELICA_DUMP_MAX_SYSTEMS) {
+        reply_ng(CMD_HF_FELICA_DUMP, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    clear_trace();
+    set_tracing(true);
+
+    iso18092_setup(FPGA_HF_ISO18092_FLAG_READER | FPGA_HF_ISO18092_FLAG_NOMOD);
+
+    uint8_t *dump = BigBuf_malloc(FELICA_DUMP_BUF);
+    if (dump == NULL) {
+        felica_reset_frame_mode();
+        reply_ng(CMD_HF_FELICA_DUMP, PM3_EMALLOC, NULL, 0);
+        BigBuf_free();
+        return;
+    }
+
+    int res = felica_dump_poll(req, &resp);
+
+    uint8_t blocks_per_read = FELICA_DUMP_MAX_BLOCKS;
+    if ((req->flags & FELICA_DUMP_POLL_ONLY) == 0) {
+        for (uint8_t i = 0; i < resp.count && res == PM3_SUCCESS && resp.truncated == false; i++) {
+            res = felica_dump_services(i, &resp, dump, &blocks_per_read);
+        }
+    }
+    resp.blocks_per_read = blocks_per_read;
+
+    felica_reset_frame_mode();
+
+    resp.bb_offset = dump - BigBuf_get_addr();
+    reply_ng(CMD_HF_FELICA_DUMP, res, (uint8_t *)&resp, sizeof(resp));
+
+    BigBuf_free();
+}
+
 void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip) {
 
     clear_trace();
@@ -20,10 +20,12 @@
 
 #include "common.h"
 #include "cmd.h"
+#include "iso18.h"
 
 void felica_sendraw(const PacketCommandNG *c);
 void felica_sniff(uint32_t samplesToSkip, uint32_t triggersToSkip);
 void felica_sim_lite(const uint8_t *uid);
 void felica_dump_lite_s(void);
+void felica_dump(const felica_dump_req_t *req);
 
 #endif
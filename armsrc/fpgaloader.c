@@ -45,7 +45,9 @@ static int downloaded_bitstream = 0;
 extern uint32_t _binary_obj_fpga_all_bit_z_start[], _binary_obj_fpga_all_bit_z_end[];
 
 static uint8_t *fpga_image_ptr = NULL;
-static uint32_t uncompressed_bytes_cnt;
+// position in the interleaved stream:  bytes left in the current chunk and the bitstream it belongs to
+static uint16_t fpga_chunk_left;
+static int fpga_chunk_img;
 
 //-----------------------------------------------------------------------------
 // Set up the Serial Peripheral Interface as master
@@ -197,42 +199,65 @@ bool FpgaSetupSscDma(uint8_t *buf, uint16_t len) {
 }
 
 //----------------------------------------------------------------------------
-// Uncompress (inflate) the FPGA data. Returns one decompressed byte with each call.
+// Uncompress (inflate) the next block of FPGA data into the ring buffer
 //----------------------------------------------------------------------------
-static int get_from_fpga_combined_stream(lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
-    if (fpga_image_ptr == output_buffer + FPGA_RING_BUFFER_BYTES) { // need more data
-        fpga_image_ptr = output_buffer;
-        int cmp_bytes;
-        memcpy(&cmp_bytes, compressed_fpga_stream->next_in, sizeof(int));
-        compressed_fpga_stream->next_in += 4;
-        compressed_fpga_stream->avail_in -= cmp_bytes + 4;
-        int res = LZ4_decompress_safe_continue(compressed_fpga_stream->lz4StreamDecode,
-                                               compressed_fpga_stream->next_in,
-                                               (char *)output_buffer,
-                                               cmp_bytes,
-                                               FPGA_RING_BUFFER_BYTES);
-        if (res <= 0) {
-            Dbprintf("inflate returned: %d", res);
-            return res;
-        }
-        compressed_fpga_stream->next_in += cmp_bytes;
+static int fill_fpga_ring_buffer(lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
+    fpga_image_ptr = output_buffer;
+    int cmp_bytes;
+    memcpy(&cmp_bytes, compressed_fpga_stream->next_in, sizeof(int));
+    compressed_fpga_stream->next_in += 4;
+    compressed_fpga_stream->avail_in -= cmp_bytes + 4;
+    int res = LZ4_decompress_safe_continue(compressed_fpga_stream->lz4StreamDecode,
+                                           compressed_fpga_stream->next_in,
+                                           (char *)output_buffer,
+                                           cmp_bytes,
+                                           FPGA_RING_BUFFER_BYTES);
+    if (res <= 0) {
+        Dbprintf("inflate returned: %d", res);
+        return res;
     }
-    uncompressed_bytes_cnt++;
-    return *fpga_image_ptr++;
+    compressed_fpga_stream->next_in += cmp_bytes;
+    return res;
+}
+
+static void next_fpga_chunk(void) {
+    fpga_chunk_left = FPGA_INTERLEAVE_SIZE;
+    if (++fpga_chunk_img == g_fpga_bitstream_num)
+        fpga_chunk_img = 0;
 }
 
 //----------------------------------------------------------------------------
 // Undo the interleaving of several FPGA config files. FPGA config files
 // are combined into one big file:
 // 288 bytes from FPGA file 1, followed by 288 bytes from FGPA file 2, etc.
+// Returns one decompressed byte of the wanted file with each call,  the chunks
+// of the other files are skipped in the ring buffer without touching each byte.
 //----------------------------------------------------------------------------
 static int get_from_fpga_stream(int bitstream_version, lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
-    while ((uncompressed_bytes_cnt / FPGA_INTERLEAVE_SIZE) % g_fpga_bitstream_num != (bitstream_version - 1)) {
-        // skip undesired data belonging to other bitstream_versions
-        get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+
+    uint8_t *end = output_buffer + FPGA_RING_BUFFER_BYTES;
+
+    while (fpga_chunk_img != bitstream_version - 1) {
+        if (fpga_image_ptr == end) { // need more data
+            int res = fill_fpga_ring_buffer(compressed_fpga_stream, output_buffer);
+            if (res <= 0)
+                return res;
+        }
+        uint16_t n = MIN(fpga_chunk_left, end - fpga_image_ptr);
+        fpga_image_ptr += n;
+        fpga_chunk_left -= n;
+        if (fpga_chunk_left == 0)
+            next_fpga_chunk();
     }
 
-    return get_from_fpga_combined_stream(compressed_fpga_stream, output_buffer);
+    if (fpga_image_ptr == end) {
+        int res = fill_fpga_ring_buffer(compressed_fpga_stream, output_buffer);
+        if (res <= 0)
+            return res;
+    }
+    if (--fpga_chunk_left == 0)
+        next_fpga_chunk();
+    return *fpga_image_ptr++;
 }
 
 //----------------------------------------------------------------------------
@@ -241,7 +266,8 @@ static int get_from_fpga_stream(int bitstream_version, lz4_streamp_t compressed_
 static bool reset_fpga_stream(int bitstream_version, lz4_streamp_t compressed_fpga_stream, uint8_t *output_buffer) {
     uint8_t header[FPGA_BITSTREAM_FIXED_HEADER_SIZE];
 
-    uncompressed_bytes_cnt = 0;
+    fpga_chunk_left = FPGA_INTERLEAVE_SIZE;
+    fpga_chunk_img = 0;
 
     // initialize z_stream structure for inflate:
     compressed_fpga_stream->next_in = (char *)_binary_obj_fpga_all_bit_z_start;
@@ -284,7 +310,9 @@ static void DownloadFPGA(int bitstream_version, int FpgaImageLen, lz4_streamp_t
     HIGH(GPIO_FPGA_ON);  // ensure everything is powered on
 #endif
 
-    SpinDelay(50);
+    // GPIO_FPGA_ON is never dropped,  only a cold FPGA needs time to power up
+    if (downloaded_bitstream == 0)
+        SpinDelay(50);
 
     LED_D_ON();
 
@@ -328,9 +356,9 @@ static void DownloadFPGA(int bitstream_version, int FpgaImageLen, lz4_streamp_t
     HIGH(GPIO_MOSI);
 #endif
 
-    // enter FPGA configuration mode
+    // enter FPGA configuration mode,  PROGRAM needs a 300ns low pulse,  INIT is polled below
     LOW(GPIO_FPGA_NPROGRAM);
-    SpinDelay(50);
+    SpinDelay((downloaded_bitstream == 0) ? 50 : 1);
     HIGH(GPIO_FPGA_NPROGRAM);
 
     i = 100000;
@@ -603,6 +631,10 @@ void SetAdcMuxFor(uint32_t whichGpio) {
 
 void Fpga_print_status(void) {
     DbpString(_CYAN_("Current FPGA image"));
+    if (downloaded_bitstream == 0) {
+        DbpString("  mode....................not loaded yet");
+        return;
+    }
     Dbprintf("  mode....................%s", g_fpga_version_information[downloaded_bitstream - 1]);
 }
 
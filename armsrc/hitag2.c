@@ -96,6 +96,12 @@ static uint8_t nonce[4];
 static uint8_t key_no;
 static uint64_t cipher_state;
 
+// nR aR collection for the crack5 / crack4 tools
+static uint16_t nrar_collect;
+static uint16_t nrar_collected;
+static bool nrar_pending;
+static uint8_t nrar_last[8];
+
 static int16_t blocknr;
 static size_t flipped_bit = 0;
 static uint32_t byte_value = 0;
@@ -292,6 +298,12 @@ static void hitag2_handle_reader_command(uint8_t *rx, const size_t rxlen, uint8_
                 auth_table_len += 8;
             }
 
+            // a reader retries with a fresh nonce, only new ones are sent to the client
+            if (nrar_collect && memcmp(rx, nrar_last, sizeof(nrar_last)) != 0) {
+                memcpy(nrar_last, rx, sizeof(nrar_last));
+                nrar_pending = true;
+            }
+
             // Reset the cipher state
             ht2_hitag2_cipher_reset(&tag, rx);
 
@@ -1415,7 +1427,18 @@ void SniffHitag2(bool ledcontrol) {
 
 
 // Hitag2 simulation
-void SimulateHitag2(bool ledcontrol) {
+// Send a collected nR aR pair after the tag answer is out,  the reader keeps
+// the field up and retries so there is no need to cycle the field between them
+static void hitag2_send_nrar(void) {
+    lf_hitag2_nrar_t payload;
+    memcpy(payload.uid, tag.sectors[0], sizeof(payload.uid));
+    memcpy(payload.NrAr, nrar_last, sizeof(payload.NrAr));
+    payload.count = ++nrar_collected;
+    nrar_pending = false;
+    reply_ng(CMD_LF_HITAG_SIMULATE, PM3_SUCCESS, (uint8_t *)&payload, sizeof(payload));
+}
+
+void SimulateHitag2(uint16_t collect, bool ledcontrol) {
 
     BigBuf_free();
     BigBuf_Clear_ext(false);
@@ -1431,8 +1454,12 @@ void SimulateHitag2(bool ledcontrol) {
 
     auth_table_len = 0;
     auth_table_pos = 0;
-//    auth_table = BigBuf_malloc(AUTH_TABLE_LENGTH);
-//    memset(auth_table, 0x00, AUTH_TABLE_LENGTH);
+    auth_table = (uint8_t *)BigBuf_calloc(AUTH_TABLE_LENGTH);
+
+    nrar_collect = collect;
+    nrar_collected = 0;
+    nrar_pending = false;
+    memset(nrar_last, 0x00, sizeof(nrar_last));
 
     // Reset the received frame, frame count and timing info
 //    memset(rx, 0x00, sizeof(rx));
@@ -1462,9 +1489,20 @@ void SimulateHitag2(bool ledcontrol) {
     //  int16_t checked = 0;
 
 // SIMULATE
+    int res = PM3_EOPABORTED;
     uint32_t signal_size = 10000;
     while (BUTTON_PRESS() == false) {
 
+        if (nrar_collect) {
+            if (nrar_collected >= nrar_collect) {
+                res = PM3_SUCCESS;
+                break;
+            }
+            if (data_available()) {
+                break;
+            }
+        }
+
         // use malloc
         initSampleBufferEx(&signal_size, true);
 
@@ -1592,8 +1630,9 @@ void SimulateHitag2(bool ledcontrol) {
             }
         }
 
-        // Pack the response into a byte array
-        for (size_t i = 5; i < 37; i++) {
+        // Pack the response into a byte array,  all of the decoded bits so the
+        // 64 bit authentication frames make it through too
+        for (size_t i = 5; i < nrzs && rxlen < (HITAG_FRAME_LEN * 8); i++) {
             uint8_t bit = nrz_samples[i];
             rx[rxlen / 8] |= bit << (7 - (rxlen % 8));
             rxlen++;
@@ -1628,6 +1667,10 @@ void SimulateHitag2(bool ledcontrol) {
             memset(rx, 0x00, sizeof(rx));
             response = 0;
 
+            if (nrar_pending) {
+                hitag2_send_nrar();
+            }
+
             if (ledcontrol) LED_B_OFF();
         }
     }
@@ -1639,6 +1682,11 @@ void SimulateHitag2(bool ledcontrol) {
 
     DbpString("Sim stopped");
 
+    if (nrar_collect) {
+        nrar_collect = 0;
+        reply_ng(CMD_LF_HITAG_SIMULATE, res, NULL, 0);
+    }
+
 //    reply_ng(CMD_LF_HITAG_SIMULATE, (checked == -1) ? PM3_EOPABORTED : PM3_SUCCESS, (uint8_t *)tag.sectors, tag_size);
 }
 
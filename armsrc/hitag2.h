@@ -24,7 +24,7 @@
 
 void SniffHitag2(bool ledcontrol);
 void hitag_sniff(void);
-void SimulateHitag2(bool ledcontrol);
+void SimulateHitag2(uint16_t collect, bool ledcontrol);
 void ReaderHitag(const lf_hitag_data_t *payload, bool ledcontrol);
 void WriterHitag(const lf_hitag_data_t *payload, bool ledcontrol);
 
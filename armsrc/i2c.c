@@ -24,6 +24,8 @@
 #include "dbprint.h"
 #include "util.h"
 #include "string.h"
+#include "commonutil.h"         // ARRAYLEN
+#include "protocols.h"          // ISO7816_GET_RESPONSE
 
 #define GPIO_RST AT91C_PIO_PA1
 #define GPIO_SCL AT91C_PIO_PA5
@@ -44,11 +46,38 @@
 // timer.
 // I2CSpinDelayClk(4) = 12.31us
 // I2CSpinDelayClk(1) = 3.07us
+//
+// Fast speed halves the loop,  the module stretches the clock when it needs more time.
+// The polling loops waiting on SCL keep the normal pace,  so their timeouts stay the same.
+#define I2C_SPIN_NORMAL      2
+#define I2C_SPIN_FAST        1
+#define I2C_READ_WAIT_NORMAL 600
 static volatile uint32_t c;
+static uint16_t s_i2c_spin = I2C_SPIN_NORMAL;
+static uint16_t s_i2c_read_wait_us = I2C_READ_WAIT_NORMAL;
+static uint8_t s_i2c_speed = SMART_I2C_SPEED_NORMAL;
+
 static void __attribute__((optimize("O0"))) I2CSpinDelayClk(uint16_t delay) {
-    for (c = delay * 2; c; c--) {};
+    for (c = delay * s_i2c_spin; c; c--) {};
+}
+
+static void __attribute__((optimize("O0"))) I2CSpinDelayPoll(void) {
+    for (c = I2C_SPIN_NORMAL; c; c--) {};
 }
 
+// exchange statistics,  times in ticks
+static struct {
+    uint32_t exchanges;
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t errors;
+    uint32_t bytes_tx;
+    uint32_t bytes_rx;
+    uint64_t tx_ticks;
+    uint64_t rx_ticks;
+    uint64_t card_ticks;
+} s_i2c_stats;
+
 #define I2C_DELAY_1CLK    I2CSpinDelayClk(1)
 #define I2C_DELAY_2CLK    I2CSpinDelayClk(2)
 #define I2C_DELAY_XCLK(x) I2CSpinDelayClk((x))
@@ -160,7 +189,7 @@ static bool WaitSCL_H_delay(uint32_t delay) {
         if (SCL_read) {
             return true;
         }
-        I2C_DELAY_1CLK;
+        I2CSpinDelayPoll();
     }
     return false;
 }
@@ -176,7 +205,7 @@ static bool WaitSCL_L_delay(uint32_t delay) {
         if (SCL_read == false) {
             return true;
         }
-        I2C_DELAY_1CLK;
+        I2CSpinDelayPoll();
     }
     return false;
 }
@@ -230,8 +259,11 @@ static bool I2C_Start(void) {
 
 static bool I2C_WaitForSim(uint32_t wait) {
 
+    uint32_t start = GetTicks();
+
     // wait for data from card
     if (WaitSCL_L_timeout() == false) {
+        s_i2c_stats.card_ticks += GetTicksDelta(start);
         return false;
     }
 
@@ -243,7 +275,9 @@ static bool I2C_WaitForSim(uint32_t wait) {
 
     // fct WaitSCL_H_delay uses a I2C_DELAY_1CLK in the loop with "wait" as number of iterations.
     // I2C_DELAY_1CLK == I2CSpinDelayClk(1) = 3.07us
-    return WaitSCL_H_delay(wait);
+    bool res = WaitSCL_H_delay(wait);
+    s_i2c_stats.card_ticks += GetTicksDelta(start);
+    return res;
 }
 
 // send i2c STOP
@@ -445,6 +479,8 @@ bool I2C_WriteByte(uint8_t data, uint8_t device_cmd, uint8_t device_address) {
 // Sends array of data (array, length, command to be written , SlaveDevice address)
 // len = uint16 because we need to write up to 256 bytes
 bool I2C_BufferWrite(const uint8_t *data, uint16_t len, uint8_t device_cmd, uint8_t device_address) {
+    uint32_t start = GetTicks();
+    uint16_t n = len;
     bool _break = true;
     do {
         if (I2C_Start() == false) {
@@ -478,7 +514,13 @@ bool I2C_BufferWrite(const uint8_t *data, uint16_t len, uint8_t device_cmd, uint
     } while (false);
 
     I2C_Stop();
+
+    s_i2c_stats.writes++;
+    s_i2c_stats.bytes_tx += (n - len);
+    s_i2c_stats.tx_ticks += GetTicksDelta(start);
+
     if (_break) {
+        s_i2c_stats.errors++;
         if (g_dbglevel > 3) DbpString(I2C_ERROR);
         return false;
     }
@@ -496,9 +538,12 @@ int16_t I2C_BufferRead(uint8_t *data, uint16_t len, uint8_t device_cmd, uint8_t
 
 //    uint8_t *pd = data;
 
+    uint32_t start = GetTicks();
+    s_i2c_stats.reads++;
+
     // extra wait  500us (514us measured)
     // 200us  (xx measured)
-    WaitUS(600);
+    WaitUS(s_i2c_read_wait_us);
 
     bool _break = true;
 
@@ -530,6 +575,8 @@ int16_t I2C_BufferRead(uint8_t *data, uint16_t len, uint8_t device_cmd, uint8_t
 
     if (_break) {
         I2C_Stop();
+        s_i2c_stats.errors++;
+        s_i2c_stats.rx_ticks += GetTicksDelta(start);
         if (g_dbglevel > 3) DbpString(I2C_ERROR);
         return 0;
     }
@@ -541,6 +588,8 @@ int16_t I2C_BufferRead(uint8_t *data, uint16_t len, uint8_t device_cmd, uint8_t
 
         int16_t tmp = I2C_ReadByte();
         if (tmp < 0) {
+            s_i2c_stats.errors++;
+            s_i2c_stats.rx_ticks += GetTicksDelta(start);
             return tmp;
         }
 
@@ -592,6 +641,8 @@ int16_t I2C_BufferRead(uint8_t *data, uint16_t len, uint8_t device_cmd, uint8_t
 
     I2C_Stop();
 
+    s_i2c_stats.rx_ticks += GetTicksDelta(start);
+
 //    Dbprintf("rec len...  %u  readcount... %u", recv_len, readcount);
 //    Dbhexdump(readcount, pd, false);
 
@@ -599,6 +650,8 @@ int16_t I2C_BufferRead(uint8_t *data, uint16_t len, uint8_t device_cmd, uint8_t
         return 0;
     }
 
+    s_i2c_stats.bytes_rx += readcount - 2;
+
     // return bytecount - bytes encoding length
     return readcount - 2;
 }
@@ -733,6 +786,8 @@ void I2C_print_status(void) {
     } else {
         DbpString("  version................. ( " _RED_("fail") " )");
     }
+
+    Dbprintf("  i2c speed............... %s", (s_i2c_speed == SMART_I2C_SPEED_FAST) ? _GREEN_("fast") : "normal");
 }
 
 int I2C_get_version(uint8_t *major, uint8_t *minor) {
@@ -747,14 +802,31 @@ int I2C_get_version(uint8_t *major, uint8_t *minor) {
     return PM3_EDEVNOTSUPP;
 }
 
-// Will read response from smart card module,  retries 3 times to get the data.
-bool sc_rx_bytes(uint8_t *dest, uint16_t *destlen, uint32_t wait) {
+// Send to the smart card and return as soon as the module works on it (SCL held low),
+// without waiting for the answer.  Pick the answer up with sc_rx_bytes_started(),
+// the caller can do other work meanwhile.
+bool sc_tx_bytes_start(const uint8_t *data, uint16_t n) {
+    if (I2C_BufferWrite(data, n, I2C_DEVICE_CMD_SEND_T0, I2C_DEVICE_ADDRESS_MAIN) == false) {
+        return false;
+    }
+    return WaitSCL_L_timeout();
+}
+
+static bool sc_rx_bytes_ext(uint8_t *dest, uint16_t *destlen, uint32_t wait, bool started) {
 
     uint8_t i = 10;
     int16_t len = 0;
     while (i--) {
 
-        I2C_WaitForSim(wait);
+        if (started) {
+            // the module took SCL low already in sc_tx_bytes_start(),  only wait for it to finish
+            uint32_t start = GetTicks();
+            WaitSCL_H_delay(wait);
+            s_i2c_stats.card_ticks += GetTicksDelta(start);
+            started = false;
+        } else {
+            I2C_WaitForSim(wait);
+        }
 
         len = I2C_BufferRead(dest, *destlen, I2C_DEVICE_CMD_READ, I2C_DEVICE_ADDRESS_MAIN);
 
@@ -773,10 +845,21 @@ bool sc_rx_bytes(uint8_t *dest, uint16_t *destlen, uint32_t wait) {
         return false;
     }
 
+    s_i2c_stats.exchanges++;
     *destlen = len;
     return true;
 }
 
+// Will read response from smart card module,  retries 3 times to get the data.
+bool sc_rx_bytes(uint8_t *dest, uint16_t *destlen, uint32_t wait) {
+    return sc_rx_bytes_ext(dest, destlen, wait, false);
+}
+
+// Read the answer to sc_tx_bytes_start()
+bool sc_rx_bytes_started(uint8_t *dest, uint16_t *destlen, uint32_t wait) {
+    return sc_rx_bytes_ext(dest, destlen, wait, true);
+}
+
 bool GetATR(smart_card_atr_t *card_ptr, bool verbose) {
 
     if (card_ptr == NULL) {
@@ -854,14 +937,60 @@ void SmartCardAtr(void) {
 //    StopTicks();
 }
 
+// Follow 61xx / 9Fxx answers with GET RESPONSE until the card is done or resp is full,
+// saving the client a round trip per part.  Returns the total length.
+static uint16_t sc_get_response_chain(uint8_t *resp, uint16_t len, uint16_t size, uint32_t wait) {
+
+    while (len >= 2 && (resp[len - 2] == 0x61 || resp[len - 2] == 0x9F)) {
+
+        uint8_t more = resp[len - 1];
+
+        // keep the data except the SW,  a single byte is the echo of INS
+        uint16_t ofs = len - 2;
+        if (ofs == 1) {
+            ofs = 0;
+        }
+
+        uint16_t want = (more == 0) ? 256 : more;
+        if (ofs + want + 3 > size) {
+            break;
+        }
+
+        uint8_t cmd_getresp[] = {0x00, ISO7816_GET_RESPONSE, 0x00, 0x00, more};
+        LogTrace(cmd_getresp, sizeof(cmd_getresp), 0, 0, NULL, true);
+
+        if (I2C_BufferWrite(cmd_getresp, sizeof(cmd_getresp), I2C_DEVICE_CMD_SEND, I2C_DEVICE_ADDRESS_MAIN) == false) {
+            break;
+        }
+
+        uint16_t part = size - ofs;
+        if (sc_rx_bytes(resp + ofs, &part, wait) == false || part < 2) {
+            break;
+        }
+        LogTrace(resp + ofs, part, 0, 0, NULL, false);
+
+        // drop the ACK byte in front of the data
+        if (part == want + 3 && resp[ofs] == ISO7816_GET_RESPONSE) {
+            part--;
+            memmove(resp + ofs, resp + ofs + 1, part);
+        }
+
+        len = ofs + part;
+    }
+    return len;
+}
+
 void SmartCardRaw(const smart_card_raw_t *p) {
     LED_D_ON();
 
     uint16_t len = 0;
-    uint8_t *resp = BigBuf_malloc(ISO7816_MAX_FRAME);
-    // check if alloacted...
     smartcard_command_t flags = p->flags;
 
+    // chained answers are collected here,  up to a full reply
+    uint16_t resp_size = ((flags & SC_GET_RESPONSE) == SC_GET_RESPONSE) ? PM3_CMD_DATA_SIZE : ISO7816_MAX_FRAME;
+    uint8_t *resp = BigBuf_malloc(resp_size);
+    // check if alloacted...
+
     if ((flags & SC_CLEARLOG) == SC_CLEARLOG)
         clear_trace();
 
@@ -912,6 +1041,10 @@ void SmartCardRaw(const smart_card_raw_t *p) {
         res = sc_rx_bytes(resp, &len, wait);
         if (res) {
             LogTrace(resp, len, 0, 0, NULL, false);
+
+            if ((flags & SC_GET_RESPONSE) == SC_GET_RESPONSE) {
+                len = sc_get_response_chain(resp, len, resp_size, wait);
+            }
         } else {
             len = 0;
         }
@@ -987,6 +1120,83 @@ void SmartCardUpgrade(uint64_t arg0) {
 void SmartCardSetBaud(uint64_t arg0) {
 }
 
+// Switch the module to fast speed and find the shortest wait before reads it copes with.
+// Every step is checked with a version read,  the wait kept is one step above the last one which worked.
+static bool I2C_calibrate_fast(void) {
+
+    static const uint16_t read_waits[] = { 600, 400, 200, 100, 50 };
+
+    s_i2c_spin = I2C_SPIN_FAST;
+
+    uint8_t best = 0xFF;
+    for (uint8_t i = 0; i < ARRAYLEN(read_waits); i++) {
+
+        s_i2c_read_wait_us = read_waits[i];
+
+        bool ok = true;
+        for (uint8_t tries = 0; tries < 3 && ok; tries++) {
+            uint8_t resp[4] = {0};
+            ok = (I2C_BufferRead(resp, sizeof(resp), I2C_DEVICE_CMD_GETVERSION, I2C_DEVICE_ADDRESS_MAIN) > 1);
+        }
+
+        if (ok == false) {
+            break;
+        }
+        best = i;
+    }
+
+    if (best == 0xFF) {
+        return false;
+    }
+
+    s_i2c_read_wait_us = read_waits[(best > 0) ? best - 1 : 0];
+    return true;
+}
+
+void SmartCardI2C(const smart_i2c_req_t *p) {
+    LED_D_ON();
+
+    int res = PM3_SUCCESS;
+
+    if (p->speed != SMART_I2C_SPEED_KEEP) {
+
+        I2C_Reset_EnterMainProgram();
+
+        if (p->speed == SMART_I2C_SPEED_FAST && I2C_calibrate_fast()) {
+            s_i2c_speed = SMART_I2C_SPEED_FAST;
+        } else {
+            if (p->speed == SMART_I2C_SPEED_FAST) {
+                DbpString("module doesn't keep up with fast speed");
+                res = PM3_EFAILED;
+            }
+            s_i2c_spin = I2C_SPIN_NORMAL;
+            s_i2c_read_wait_us = I2C_READ_WAIT_NORMAL;
+            s_i2c_speed = SMART_I2C_SPEED_NORMAL;
+        }
+    }
+
+    if (p->reset_stats) {
+        memset(&s_i2c_stats, 0, sizeof(s_i2c_stats));
+    }
+
+    // ticks run at 1.5MHz
+    smart_i2c_stats_t stats = {
+        .speed = s_i2c_speed,
+        .read_wait_us = s_i2c_read_wait_us,
+        .exchanges = s_i2c_stats.exchanges,
+        .writes = s_i2c_stats.writes,
+        .reads = s_i2c_stats.reads,
+        .errors = s_i2c_stats.errors,
+        .bytes_tx = s_i2c_stats.bytes_tx,
+        .bytes_rx = s_i2c_stats.bytes_rx,
+        .tx_us = (s_i2c_stats.tx_ticks * 2) / 3,
+        .rx_us = (s_i2c_stats.rx_ticks * 2) / 3,
+        .card_us = (s_i2c_stats.card_ticks * 2) / 3,
+    };
+    reply_ng(CMD_SMART_I2C, res, (uint8_t *)&stats, sizeof(stats));
+    LEDsoff();
+}
+
 void SmartCardSetClock(uint64_t arg0) {
     LED_D_ON();
     set_tracing(true);
@@ -58,6 +58,8 @@ int16_t I2C_ReadFW(uint8_t *data, uint8_t len, uint8_t msb, uint8_t lsb, uint8_t
 bool I2C_WriteFW(const uint8_t *data, uint8_t len, uint8_t msb, uint8_t lsb, uint8_t device_address);
 
 bool sc_rx_bytes(uint8_t *dest, uint16_t *destlen, uint32_t wait);
+bool sc_tx_bytes_start(const uint8_t *data, uint16_t n);
+bool sc_rx_bytes_started(uint8_t *dest, uint16_t *destlen, uint32_t wait);
 //
 bool GetATR(smart_card_atr_t *card_ptr, bool verbose);
 
@@ -67,6 +69,7 @@ void SmartCardRaw(const smart_card_raw_t *p);
 void SmartCardUpgrade(uint64_t arg0);
 void SmartCardSetBaud(uint64_t arg0);
 void SmartCardSetClock(uint64_t arg0);
+void SmartCardI2C(const smart_i2c_req_t *p);
 void I2C_print_status(void);
 int I2C_get_version(uint8_t *major, uint8_t *minor);
 
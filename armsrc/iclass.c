@@ -48,6 +48,22 @@ uint8_t get_pagemap(const picopass_hdr_t *hdr) {
 #define ICLASS_16KS_SIZE       0x100 * 8
 #endif
 
+// Per CSN answers of the reader attack (sim 2 / 4).  The whole CSN set is encoded before the
+// attack starts and kept below a BigBuf mark,  so moving on to the next CSN only picks the next entry.
+typedef struct {
+    uint8_t anticoll_data[10];  // rotated CSN + CRC
+    uint8_t csn_data[10];       // CSN + CRC
+    // 22: Takes 2 bytes for SOF/EOF and 10 * 2 = 20 bytes (2 bytes/byte)
+    uint8_t resp_anticoll[22];
+    uint8_t resp_csn[22];
+    uint8_t resp_anticoll_len;
+    uint8_t resp_csn_len;
+} iclass_sim_csn_t;
+
+static iclass_sim_csn_t *s_sim_csns = NULL;   // prepared CSN set,  NULL outside the attack
+static iclass_sim_csn_t *s_sim_csn = NULL;    // entry of the CSN being simulated
+static int s_sim_csns_mark = -1;
+
 /*
 * CARD TO READER
 * in ISO15693-2 mode -  Manchester
@@ -69,8 +85,8 @@ uint8_t get_pagemap(const picopass_hdr_t *hdr) {
 // a `sniffer' for iClass communication
 // Both sides of communication!
 //=============================================================================
-void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string) {
-    SniffIso15693(jam_search_len, jam_search_string, true);
+void SniffIClass(uint8_t jam_search_len, uint8_t *jam_search_string, uint8_t param) {
+    SniffIso15693(jam_search_len, jam_search_string, true, param);
 }
 
 static void rotateCSN(const uint8_t *original_csn, uint8_t *rotated_csn) {
@@ -122,6 +138,66 @@ static void CodeIClassTagSOF(void) {
  *
  */
 
+static void iclass_sim_encode_csn(const uint8_t *csn, iclass_sim_csn_t *out) {
+
+    memcpy(out->csn_data, csn, 8);
+
+    // Construct anticollision-CSN
+    rotateCSN(out->csn_data, out->anticoll_data);
+
+    // Compute CRC on both CSNs
+    AddCrc(out->anticoll_data, 8);
+    AddCrc(out->csn_data, 8);
+
+    tosend_t *ts = get_tosend();
+
+    // Anticollision CSN
+    CodeIso15693AsTag(out->anticoll_data, sizeof(out->anticoll_data));
+    memcpy(out->resp_anticoll, ts->buf, ts->max);
+    out->resp_anticoll_len = ts->max;
+
+    // CSN (block 0)
+    CodeIso15693AsTag(out->csn_data, sizeof(out->csn_data));
+    memcpy(out->resp_csn, ts->buf, ts->max);
+    out->resp_csn_len = ts->max;
+}
+
+// Encode the answers of all CSNs the attack loop will get to.
+// Without room for them each CSN gets encoded when its turn comes,  as before.
+static void iclass_sim_prepare_csns(const uint8_t *csns, uint8_t num_csns, uint16_t mac_size) {
+
+    BigBuf_free_keep_EM();
+
+    uint8_t n = 0;
+    while (n < num_csns && n * mac_size + 8 < PM3_CMD_DATA_SIZE) {
+        n++;
+    }
+
+    s_sim_csns = (iclass_sim_csn_t *)BigBuf_malloc(n * sizeof(iclass_sim_csn_t));
+    if (s_sim_csns == NULL) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        iclass_sim_encode_csn(csns + (i * 8), &s_sim_csns[i]);
+    }
+
+    s_sim_csns_mark = BigBuf_mark("iclass sim csns");
+    if (s_sim_csns_mark < 0) {
+        s_sim_csns = NULL;
+    }
+}
+
+static void iclass_sim_select_csn(uint8_t i) {
+    s_sim_csn = (s_sim_csns) ? &s_sim_csns[i] : NULL;
+}
+
+static void iclass_sim_release_csns(void) {
+    s_sim_csns = NULL;
+    s_sim_csn = NULL;
+    s_sim_csns_mark = -1;
+}
+
 /**
  * @brief SimulateIClass simulates an iClass card.
  * @param arg0 type of simulation
@@ -173,10 +249,13 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
         // in order to collect MAC's from the reader. This can later be used in an offlne-attack
         // in order to obtain the keys, as in the "dismantling iclass"-paper.
 #define EPURSE_MAC_SIZE 16
+        iclass_sim_prepare_csns(datain, num_csns, EPURSE_MAC_SIZE);
+
         int i = 0;
         for (; i < num_csns && i * EPURSE_MAC_SIZE + 8 < PM3_CMD_DATA_SIZE; i++) {
 
             memcpy(emulator, datain + (i * 8), 8);
+            iclass_sim_select_csn(i);
 
             if (do_iclass_simulation(ICLASS_SIM_MODE_EXIT_AFTER_MAC, mac_responses + i * EPURSE_MAC_SIZE)) {
 
@@ -226,11 +305,14 @@ void iclass_simulate(uint8_t sim_type, uint8_t num_csns, bool send_reply, uint8_
 
         // keyroll mode,   reader swaps between old key and new key alternatively when fail a authentication.
         // attack below is same as SIM 2, but we run the CSN twice to collected the mac for both keys.
+        iclass_sim_prepare_csns(datain, num_csns, EPURSE_MAC_SIZE);
+
         int i = 0;
         // The usb data is 512 bytes, fitting 65 8-byte CSNs in there.  iceman fork uses 9 CSNS
         for (; i < num_csns && i * EPURSE_MAC_SIZE + 8 < PM3_CMD_DATA_SIZE; i++) {
 
             memcpy(emulator, datain + (i * 8), 8);
+            iclass_sim_select_csn(i);
 
             // keyroll 1
             if (do_iclass_simulation(ICLASS_SIM_MODE_EXIT_AFTER_MAC, mac_responses + i * EPURSE_MAC_SIZE)) {
@@ -276,6 +358,7 @@ out:
     if (dataout && dataoutlen)
         memcpy(dataout, mac_responses, *dataoutlen);
 
+    iclass_sim_release_csns();
     switch_off();
     BigBuf_free_keep_EM();
 }
@@ -290,8 +373,13 @@ out:
  */
 int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
 
-    // free eventually allocated BigBuf memory
-    BigBuf_free_keep_EM();
+    // free eventually allocated BigBuf memory,  the prepared CSN answers of the attack stay
+    if (s_sim_csn) {
+        BigBuf_release(s_sim_csns_mark);
+        s_sim_csns_mark = BigBuf_mark("iclass sim csns");
+    } else {
+        BigBuf_free_keep_EM();
+    }
 
     uint16_t page_size = 32 * 8;
     uint8_t current_page = 0;
@@ -304,17 +392,15 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
     uint8_t *emulator = BigBuf_get_EM_addr();
     uint8_t *csn = emulator;
 
-    // CSN followed by two CRC bytes
-    uint8_t anticoll_data[10] = { 0 };
-    uint8_t csn_data[10] = { 0 };
-    memcpy(csn_data, csn, sizeof(csn_data));
-
-    // Construct anticollision-CSN
-    rotateCSN(csn_data, anticoll_data);
-
-    // Compute CRC on both CSNs
-    AddCrc(anticoll_data, 8);
-    AddCrc(csn_data, 8);
+    // CSN and anticollision CSN followed by two CRC bytes,  with their answers
+    iclass_sim_csn_t csn_local;
+    iclass_sim_csn_t *sim_csn = s_sim_csn;
+    if (sim_csn == NULL) {
+        iclass_sim_encode_csn(csn, &csn_local);
+        sim_csn = &csn_local;
+    }
+    uint8_t *anticoll_data = sim_csn->anticoll_data;
+    uint8_t *csn_data = sim_csn->csn_data;
 
     uint8_t diversified_kd[8] = { 0 };
     uint8_t diversified_kc[8] = { 0 };
@@ -399,14 +485,12 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
     int resp_sof_len;
 
     // Anticollision CSN (rotated CSN)
-    // 22: Takes 2 bytes for SOF/EOF and 10 * 2 = 20 bytes (2 bytes/byte)
-    uint8_t *resp_anticoll = BigBuf_malloc(22);
-    int resp_anticoll_len;
+    uint8_t *resp_anticoll = sim_csn->resp_anticoll;
+    int resp_anticoll_len = sim_csn->resp_anticoll_len;
 
     // CSN (block 0)
-    // 22: Takes 2 bytes for SOF/EOF and 10 * 2 = 20 bytes (2 bytes/byte)
-    uint8_t *resp_csn = BigBuf_malloc(22);
-    int resp_csn_len;
+    uint8_t *resp_csn = sim_csn->resp_csn;
+    int resp_csn_len = sim_csn->resp_csn_len;
 
     // configuration (blk 1) PICOPASS 2ks
     uint8_t *resp_conf = BigBuf_malloc(22);
@@ -438,16 +522,6 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
     memcpy(resp_sof, ts->buf, ts->max);
     resp_sof_len = ts->max;
 
-    // Anticollision CSN
-    CodeIso15693AsTag(anticoll_data, sizeof(anticoll_data));
-    memcpy(resp_anticoll, ts->buf, ts->max);
-    resp_anticoll_len = ts->max;
-
-    // CSN (block 0)
-    CodeIso15693AsTag(csn_data, sizeof(csn_data));
-    memcpy(resp_csn, ts->buf, ts->max);
-    resp_csn_len = ts->max;
-
     // Configuration (block 1)
     CodeIso15693AsTag(conf_block, sizeof(conf_block));
     memcpy(resp_conf, ts->buf, ts->max);
@@ -520,7 +594,7 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                 modulated_response = resp_anticoll;
                 modulated_response_size = resp_anticoll_len;
                 trace_data = anticoll_data;
-                trace_data_size = sizeof(anticoll_data);
+                trace_data_size = sizeof(sim_csn->anticoll_data);
             }
             goto send;
 
@@ -532,7 +606,7 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                     modulated_response = resp_csn;
                     modulated_response_size = resp_csn_len;
                     trace_data = csn_data;
-                    trace_data_size = sizeof(csn_data);
+                    trace_data_size = sizeof(sim_csn->csn_data);
                     chip_state = SELECTED;
                 } else {
                     chip_state = IDLE;
@@ -543,7 +617,7 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                     modulated_response = resp_csn;
                     modulated_response_size = resp_csn_len;
                     trace_data = csn_data;
-                    trace_data_size = sizeof(csn_data);
+                    trace_data_size = sizeof(sim_csn->csn_data);
                     chip_state = SELECTED;
                 }
             }
@@ -564,7 +638,7 @@ int do_iclass_simulation(int simulationMode, uint8_t *reader_mac_buf) {
                         modulated_response = resp_csn;
                         modulated_response_size = resp_csn_len;
                         trace_data = csn_data;
-                        trace_data_size = sizeof(csn_data);
+                        trace_data_size = sizeof(sim_csn->csn_data);
                         goto send;
                     }
                     case 1: { // configuration (0c 01)
@@ -1652,6 +1726,28 @@ out:
 // then authenticate AA2, and read those blocks by calling this.
 // By the looks at it only 2K cards is supported,  or first page dumps on larger cards.
 // turn off afterwards
+static bool iclass_dump_read_block(uint8_t blockno, uint8_t *dump, uint8_t tries, uint32_t *start_time, uint32_t *eof_time, bool shallow_mod) {
+    uint8_t resp[10];
+    uint8_t c[] = {ICLASS_CMD_READ_OR_IDENTIFY, blockno, 0x00, 0x00};
+    AddCrc(c + 1, 1);
+
+    bool res = iclass_send_cmd_with_retries(c, sizeof(c), resp, sizeof(resp), 10, tries, start_time, ICLASS_READER_TIMEOUT_OTHERS, eof_time, shallow_mod);
+    if (res) {
+        memcpy(dump + (8 * blockno), resp, 8);
+    }
+    return res;
+}
+
+// send dumped blocks to the client while the dump goes on
+static void iclass_dump_stream(const uint8_t *dump, uint8_t start_block, uint8_t count) {
+    uint8_t buf[sizeof(iclass_dump_blocks_t) + (ICLASS_DUMP_STREAM_BLOCKS * 8)];
+    iclass_dump_blocks_t *payload = (iclass_dump_blocks_t *)buf;
+    payload->start_block = start_block;
+    payload->count = count;
+    memcpy(payload->data, dump + (8 * start_block), 8 * count);
+    reply_ng(CMD_HF_ICLASS_DUMP_BLOCKS, PM3_SUCCESS, buf, sizeof(iclass_dump_blocks_t) + (8 * count));
+}
+
 void iClass_Dump(uint8_t *msg) {
 
     BigBuf_free();
@@ -1705,17 +1801,39 @@ void iClass_Dump(uint8_t *msg) {
 
     bool dumpsuccess = true;
 
-    // main read loop
-    uint16_t i;
-    for (i = cmd->start_block; i <= cmd->end_block; i++) {
+    // first pass,  one try per block.  Blocks are streamed to the client as they come in
+    // and the blocks which failed get their remaining tries in one batch afterwards.
+    uint8_t failed[256 / 8] = {0};
+    uint16_t failed_cnt = 0;
+    uint16_t stream_start = cmd->start_block;
+    uint16_t block_cnt = 0;
+
+    for (uint16_t i = cmd->start_block; i <= cmd->end_block; i++) {
 
-        uint8_t resp[10];
-        uint8_t c[] = {ICLASS_CMD_READ_OR_IDENTIFY, i, 0x00, 0x00};
-        AddCrc(c + 1, 1);
+        if (iclass_dump_read_block(i, dataout, 1, &start_time, &eof_time, shallow_mod) == false) {
+            failed[i >> 3] |= (1 << (i & 7));
+            failed_cnt++;
+        }
+        block_cnt++;
+
+        if (req->send_reply && ((i - stream_start + 1) == ICLASS_DUMP_STREAM_BLOCKS || i == cmd->end_block)) {
+            iclass_dump_stream(dataout, stream_start, i - stream_start + 1);
+            stream_start = i + 1;
+        }
+    }
 
-        res = iclass_send_cmd_with_retries(c, sizeof(c), resp, sizeof(resp), 10, 3, &start_time, ICLASS_READER_TIMEOUT_OTHERS, &eof_time, shallow_mod);
-        if (res) {
-            memcpy(dataout + (8 * i), resp, 8);
+    // re-read failed blocks
+    for (uint16_t i = cmd->start_block; failed_cnt && i <= cmd->end_block; i++) {
+
+        if ((failed[i >> 3] & (1 << (i & 7))) == 0) {
+            continue;
+        }
+        failed_cnt--;
+
+        if (iclass_dump_read_block(i, dataout, 2, &start_time, &eof_time, shallow_mod)) {
+            if (req->send_reply) {
+                iclass_dump_stream(dataout, i, 1);
+            }
         } else {
             Dbprintf("failed to read block %u ( 0x%02x)", i, i);
             dumpsuccess = false;
@@ -1726,10 +1844,12 @@ void iClass_Dump(uint8_t *msg) {
 
     // copy diversified key back.
     if (req->do_auth) {
-        if (req->use_credit_key)
-            memcpy(dataout + (8 * 4), hdr.key_c, 8);
-        else
-            memcpy(dataout + (8 * 3), hdr.key_d, 8);
+        uint8_t keyblock = (req->use_credit_key) ? 4 : 3;
+        memcpy(dataout + (8 * keyblock), (req->use_credit_key) ? hdr.key_c : hdr.key_d, 8);
+
+        if (req->send_reply) {
+            iclass_dump_stream(dataout, keyblock, 1);
+        }
     }
 
     if (req->send_reply) {
@@ -1740,7 +1860,7 @@ void iClass_Dump(uint8_t *msg) {
         } PACKED response;
 
         response.isOK = dumpsuccess;
-        response.block_cnt = i - cmd->start_block;
+        response.block_cnt = block_cnt;
         response.bb_offset = dataout - BigBuf_get_addr();
         reply_ng(CMD_HF_ICLASS_DUMP, PM3_SUCCESS, (uint8_t *)&response, sizeof(response));
     }
@@ -2078,7 +2198,7 @@ void iClass_Restore(iclass_restore_req_t *msg) {
         return;
     }
 
-    if (msg->item_cnt == 0) {
+    if (msg->item_cnt == 0 || msg->item_cnt > ICLASS_RESTORE_MAX_ITEMS) {
         if (msg->req.send_reply) {
             reply_ng(CMD_HF_ICLASS_RESTORE, PM3_ESOFT, NULL, 0);
         }
@@ -2086,11 +2206,12 @@ void iClass_Restore(iclass_restore_req_t *msg) {
     }
 
     bool shallow_mod = msg->req.shallow_mod;
+    bool quiet = (msg->flags & ICLASS_RESTORE_QUIET);
 
     LED_A_ON();
     Iso15693InitReader();
 
-    uint16_t written = 0;
+    iclass_restore_resp_t resp = {0};
     uint32_t eof_time = 0;
     picopass_hdr_t hdr = {0};
 
@@ -2112,35 +2233,40 @@ void iClass_Restore(iclass_restore_req_t *msg) {
         }
     }
 
+    // Unsecured tags uses CRC16,  secure tags uses MAC
+    bool use_mac = (get_pagemap(&hdr) != PICOPASS_NON_SECURE_PAGEMODE);
+
     // main loop
-    bool use_mac;
     for (uint8_t i = 0; i < msg->item_cnt; i++) {
 
         iclass_restore_item_t item = msg->blocks[i];
 
-        uint8_t pagemap = get_pagemap(&hdr);
-        if (pagemap == PICOPASS_NON_SECURE_PAGEMODE) {
-            // Unsecured tags uses CRC16
-            use_mac = false;
-        } else {
-            // Secure tags uses MAC
-            use_mac = true;
-            uint8_t wb[9] = {0};
-            wb[0] = item.blockno;
-            memcpy(wb + 1, item.data, 8);
-
-            if (msg->req.use_credit_key)
-                doMAC_N(wb, sizeof(wb), hdr.key_c, mac);
-            else
-                doMAC_N(wb, sizeof(wb), hdr.key_d, mac);
+        if (use_mac) {
+            if (msg->flags & ICLASS_RESTORE_HOST_MAC) {
+                memcpy(mac, item.mac, 4);
+            } else {
+                uint8_t wb[9] = {0};
+                wb[0] = item.blockno;
+                memcpy(wb + 1, item.data, 8);
+
+                if (msg->req.use_credit_key)
+                    doMAC_N(wb, sizeof(wb), hdr.key_c, mac);
+                else
+                    doMAC_N(wb, sizeof(wb), hdr.key_d, mac);
+            }
         }
 
         // data + mac
         if (iclass_writeblock_ext(item.blockno, item.data, mac, use_mac, shallow_mod)) {
-            Dbprintf("Write block [%3d/0x%02X] " _GREEN_("successful"), item.blockno, item.blockno);
-            written++;
+            if (quiet == false) {
+                Dbprintf("Write block [%3d/0x%02X] " _GREEN_("successful"), item.blockno, item.blockno);
+            }
+            resp.ok[i >> 3] |= (1 << (i & 7));
+            resp.written++;
         } else {
-            Dbprintf("Write block [%3d/0x%02X] " _RED_("failed"), item.blockno, item.blockno);
+            if (quiet == false) {
+                Dbprintf("Write block [%3d/0x%02X] " _RED_("failed"), item.blockno, item.blockno);
+            }
         }
     }
 
@@ -2148,7 +2274,7 @@ out:
 
     switch_off();
     if (msg->req.send_reply) {
-        int isOK = (written == msg->item_cnt) ? PM3_SUCCESS : PM3_ESOFT;
-        reply_ng(CMD_HF_ICLASS_RESTORE, isOK, NULL, 0);
+        int isOK = (resp.written == msg->item_cnt) ? PM3_SUCCESS : PM3_ESOFT;
+        reply_ng(CMD_HF_ICLASS_RESTORE, isOK, (uint8_t *)&resp, sizeof(resp));
     }
 }
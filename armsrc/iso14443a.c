@@ -35,6 +35,7 @@
 #include "crc16.h"
 #include "protocols.h"
 #include "generator.h"
+#include "decoder_stats.h"
 
 #define MAX_ISO14A_TIMEOUT 524288
 
@@ -46,6 +47,11 @@ static uint8_t colpos = 0;
 // the block number for the ISO14443-4 PCB
 static uint8_t iso14_pcb_blocknum = 0;
 
+// frame size of the card for ISO14443-4 blocks,  from the ATS
+static uint16_t iso14_fsc = 32;
+
+#define ISO14_APDU_RETRIES      3
+
 //
 // ISO14443 timing:
 //
@@ -649,6 +655,79 @@ static RAMFUNC int ManchesterDecoding_Thinfilm(uint8_t bit) {
 // Both sides of communication!
 //=============================================================================
 
+//-----------------------------------------------------------------------------
+// Timing mode of "hf 14a sniff".  Instead of the trace only the frame edges are
+// kept,  12 bytes a frame in a ring which the idle spots of the sniff loop send
+// to the client.  A session is limited by host memory only.
+//-----------------------------------------------------------------------------
+#define SNIFF_TIMING_RING   1024    // records,  a power of 2
+
+static sniff_timing_t *sniff_timing_ring = NULL;
+static uint16_t sniff_timing_head = 0;
+static uint16_t sniff_timing_count = 0;
+static uint32_t sniff_timing_dropped = 0;
+
+static bool sniff_timing_init(void) {
+    sniff_timing_ring = (sniff_timing_t *)BigBuf_malloc(SNIFF_TIMING_RING * sizeof(sniff_timing_t));
+    sniff_timing_head = 0;
+    sniff_timing_count = 0;
+    sniff_timing_dropped = 0;
+    return (sniff_timing_ring != NULL);
+}
+
+static void RAMFUNC sniff_timing_log(uint32_t sof, uint32_t eof, uint16_t len, uint16_t bits, bool response) {
+    // client too slow,  the oldest goes
+    if (sniff_timing_count == SNIFF_TIMING_RING) {
+        sniff_timing_head = (sniff_timing_head + 1) & (SNIFF_TIMING_RING - 1);
+        sniff_timing_count--;
+        sniff_timing_dropped++;
+    }
+
+    sniff_timing_t *r = &sniff_timing_ring[(sniff_timing_head + sniff_timing_count) & (SNIFF_TIMING_RING - 1)];
+    r->sof = sof;
+    r->eof = eof;
+    r->len = len;
+    r->bits = (bits < 8) ? bits : 0;
+    r->flags = (response) ? SNIFF_TIMING_RESPONSE : 0;
+    sniff_timing_count++;
+}
+
+// Sends one chunk if the USB queue takes it without blocking,  or everything when flushing
+static void sniff_timing_send(bool flush) {
+
+    while (sniff_timing_count && g_reply_via_usb) {
+
+        if (flush) {
+            reply_tx_flush();
+        } else if (reply_tx_room() < sizeof(PacketResponseNGRaw)) {
+            return;
+        }
+
+        uint8_t buf[PM3_CMD_DATA_SIZE];
+        sniff_timing_chunk_t *out = (sniff_timing_chunk_t *)buf;
+        uint16_t n = MIN(sniff_timing_count, SNIFF_TIMING_PER_CHUNK);
+        for (uint16_t i = 0; i < n; i++) {
+            out->rec[i] = sniff_timing_ring[(sniff_timing_head + i) & (SNIFF_TIMING_RING - 1)];
+        }
+        out->count = n;
+        out->dropped = sniff_timing_dropped;
+
+        if (reply_ng(CMD_HF_ISO14443A_SNIFF_TIMING, PM3_SUCCESS, buf, sizeof(sniff_timing_chunk_t) + n * sizeof(sniff_timing_t)) != PM3_SUCCESS) {
+            return;
+        }
+        sniff_timing_head = (sniff_timing_head + n) & (SNIFF_TIMING_RING - 1);
+        sniff_timing_count -= n;
+
+        if (flush == false) {
+            return;
+        }
+    }
+
+    if (flush) {
+        reply_tx_flush();
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Record the sequence of commands sent by the reader to the tag, with
 // triggering so that we start recording at the point that the tag is moved
@@ -660,6 +739,8 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     // param:
     // bit 0 - trigger from first card answer
     // bit 1 - trigger from first reader 7-bit request
+    // SNIFF_PARAM_TRACE_RING / SNIFF_PARAM_TRACE_STREAM - ring trace,  streamed to the client
+    // SNIFF_PARAM_TIMING - frame edges only,  streamed to the client
     iso14443a_setup(FPGA_HF_ISO14443A_SNIFFER);
 
     // Allocate memory from BigBuf for some buffers
@@ -668,6 +749,7 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     BigBuf_Clear_ext(false);
     clear_trace();
     set_tracing(true);
+    decoder_stats_reset();
 
     // The command (reader -> tag) that we're receiving.
     uint8_t *receivedCmd = BigBuf_malloc(MAX_FRAME_SIZE);
@@ -677,6 +759,17 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
     uint8_t *receivedResp = BigBuf_malloc(MAX_FRAME_SIZE);
     uint8_t *receivedRespPar = BigBuf_malloc(MAX_PARITY_SIZE);
 
+    bool timing = (param & SNIFF_PARAM_TIMING);
+    if (timing) {
+        param &= ~(SNIFF_PARAM_TRACE_RING | SNIFF_PARAM_TRACE_STREAM | SNIFF_PARAM_TRACE_COMPACT);
+        set_tracing(false);
+        if (sniff_timing_init() == false) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("Failed to allocate timing buffer");
+            switch_off();
+            return;
+        }
+    }
+
     uint8_t previous_data = 0;
     int maxDataLen = 0, dataLen;
     bool TagIsActive = false;
@@ -710,6 +803,8 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
 
     uint32_t rx_samples = 0;
 
+    trace_sniff_start(param);
+
     // loop and listen
     while (BUTTON_PRESS() == false) {
         WDT_HIT();
@@ -725,18 +820,31 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
         // test for length of buffer
         if (dataLen > maxDataLen) {
             maxDataLen = dataLen;
+            DECODER_DMA_BACKLOG(dataLen);
             if (dataLen > (9 * DMA_BUFFER_SIZE / 10)) {
                 Dbprintf("[!] blew circular buffer! | datalen %u", dataLen);
+                DECODER_DMA_LOST();
                 break;
             }
         }
-        if (dataLen < 1) continue;
+        if (dataLen < 1) {
+            // nothing to decode,  a good moment to push finished records to the client
+            if ((TagIsActive == false) && (ReaderIsActive == false)) {
+                if (timing) {
+                    sniff_timing_send(false);
+                } else {
+                    trace_stream_poll();
+                }
+            }
+            continue;
+        }
 
         // primary buffer was stopped( <-- we lost data!
         if (!AT91C_BASE_PDC_SSC->PDC_RCR) {
             AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
             AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
             Dbprintf("[-] RxEmpty ERROR | data length %d", dataLen); // temporary
+            DECODER_DMA_LOST();
         }
         // secondary buffer sets as primary, secondary buffer was stopped
         if (!AT91C_BASE_PDC_SSC->PDC_RNCR) {
@@ -751,13 +859,19 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
 
             if (TagIsActive == false) {        // no need to try decoding reader data if the tag is sending
                 uint8_t readerdata = (previous_data & 0xF0) | (*data >> 4);
-                if (MillerDecoding(readerdata, (rx_samples - 1) * 4)) {
+                if (DECODER_TIMED(DECODER_STATS_MILLER, MillerDecoding(readerdata, (rx_samples - 1) * 4))) {
                     LED_C_ON();
 
                     // check - if there is a short 7bit request from reader
                     if ((!triggered) && (param & 0x02) && (Uart.len == 1) && (Uart.bitCount == 7)) triggered = true;
 
-                    if (triggered) {
+                    if (triggered && timing) {
+                        sniff_timing_log(Uart.startTime * 16 - DELAY_READER_AIR2ARM_AS_SNIFFER,
+                                         Uart.endTime * 16 - DELAY_READER_AIR2ARM_AS_SNIFFER,
+                                         Uart.len,
+                                         Uart.bitCount,
+                                         false);
+                    } else if (triggered) {
                         if (!LogTrace(receivedCmd,
                                       Uart.len,
                                       Uart.startTime * 16 - DELAY_READER_AIR2ARM_AS_SNIFFER,
@@ -778,15 +892,21 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
             // no need to try decoding tag data if the reader is sending - and we cannot afford the time
             if (ReaderIsActive == false) {
                 uint8_t tagdata = (previous_data << 4) | (*data & 0x0F);
-                if (ManchesterDecoding(tagdata, 0, (rx_samples - 1) * 4)) {
+                if (DECODER_TIMED(DECODER_STATS_MANCHESTER, ManchesterDecoding(tagdata, 0, (rx_samples - 1) * 4))) {
                     LED_B_ON();
 
-                    if (!LogTrace(receivedResp,
-                                  Demod.len,
-                                  Demod.startTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
-                                  Demod.endTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
-                                  Demod.parity,
-                                  false)) break;
+                    if (timing) {
+                        sniff_timing_log(Demod.startTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
+                                         Demod.endTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
+                                         Demod.len,
+                                         Demod.bitCount,
+                                         true);
+                    } else if (!LogTrace(receivedResp,
+                                         Demod.len,
+                                         Demod.startTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
+                                         Demod.endTime * 16 - DELAY_TAG_AIR2ARM_AS_SNIFFER,
+                                         Demod.parity,
+                                         false)) break;
 
                     if ((!triggered) && (param & 0x01)) triggered = true;
 
@@ -811,6 +931,17 @@ void RAMFUNC SniffIso14443a(uint8_t param) {
 
     FpgaDisableTracing();
 
+    if (timing) {
+        sniff_timing_send(true);
+        if (g_dbglevel >= DBG_ERROR) {
+            Dbprintf("timing records lost = " _YELLOW_("%u"), sniff_timing_dropped);
+        }
+        switch_off();
+        return;
+    }
+
+    trace_sniff_stop();
+
     if (g_dbglevel >= DBG_ERROR) {
         Dbprintf("trace len = " _YELLOW_("%d"), BigBuf_get_traceLen());
     }
@@ -827,14 +958,7 @@ static void CodeIso14443aAsTagPar(const uint8_t *cmd, uint16_t len, const uint8_
     tosend_t *ts = get_tosend();
 
     // Correction bit, might be removed when not needed
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(1);  // <-----
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
+    ts->buf[++ts->max] = 0x08; // 00001000
 
     // Send startbit
     ts->buf[++ts->max] = SEC_D;
@@ -895,14 +1019,7 @@ static void Code4bitAnswerAsTag(uint8_t cmd) {
     tosend_t *ts = get_tosend();
 
     // Correction bit, might be removed when not needed
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(1);  // 1
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
-    tosend_stuffbit(0);
+    ts->buf[++ts->max] = 0x08; // 00001000
 
     // Send startbit
     ts->buf[++ts->max] = SEC_D;
@@ -968,9 +1085,11 @@ bool GetIso14443aCommandFromReader(uint8_t *received, uint8_t *par, int *len) {
             checker = 4000;
         }
 
-        if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
+        uint32_t sr = AT91C_BASE_SSC->SSC_SR;
+        DECODER_SSC_SR(sr);
+        if (sr & (AT91C_SSC_RXRDY)) {
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
-            if (MillerDecoding(b, 0)) {
+            if (DECODER_TIMED(DECODER_STATS_MILLER, MillerDecoding(b, 0))) {
                 *len = Uart.len;
                 return true;
             }
@@ -1354,6 +1473,84 @@ bool SimulateIso14443aInit(uint8_t tagType, uint16_t flags, uint8_t *data, tag_r
     return true;
 }
 
+// LRU cache of modulated Ultralight / NTAG READ answers,  kept in BigBuf while simulating.
+// Hot pages are replayed with EmSendPrecompiledCmd() instead of being encoded on every READ.
+#define SIM_READ_CACHE_SLOTS           16
+#define SIM_READ_CACHE_MODULATION_SIZE 192
+
+typedef struct {
+    tag_response_info_t info;
+    uint32_t last_used;
+    uint8_t block;
+    bool valid;
+} sim_read_cache_entry_t;
+
+static sim_read_cache_entry_t *sim_read_cache = NULL;
+static uint32_t sim_read_cache_clock = 0;
+
+static void sim_read_cache_init(void) {
+    sim_read_cache_clock = 0;
+    sim_read_cache = (sim_read_cache_entry_t *)BigBuf_calloc(SIM_READ_CACHE_SLOTS * sizeof(sim_read_cache_entry_t));
+    if (sim_read_cache == NULL) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < SIM_READ_CACHE_SLOTS; i++) {
+        uint8_t *resp = BigBuf_malloc(MAX_MIFARE_FRAME_SIZE);
+        uint8_t *mod = BigBuf_malloc(SIM_READ_CACHE_MODULATION_SIZE);
+        if (resp == NULL || mod == NULL) {
+            // run without cache,  BigBuf is released when the simulation ends
+            sim_read_cache = NULL;
+            return;
+        }
+        sim_read_cache[i].info.response = resp;
+        sim_read_cache[i].info.modulation = mod;
+    }
+}
+
+// emulator memory changed,  drop all cached answers
+static void sim_read_cache_invalidate(void) {
+    if (sim_read_cache == NULL) {
+        return;
+    }
+    for (uint8_t i = 0; i < SIM_READ_CACHE_SLOTS; i++) {
+        sim_read_cache[i].valid = false;
+    }
+}
+
+// Get the modulated answer to a READ of block,  whose 16 bytes start at emulator offset start.
+// On a miss the least recently used slot is encoded.  NULL when there is no cache or encoding failed.
+static tag_response_info_t *sim_read_cache_get(uint8_t block, uint16_t start) {
+    if (sim_read_cache == NULL) {
+        return NULL;
+    }
+
+    sim_read_cache_clock++;
+
+    sim_read_cache_entry_t *victim = &sim_read_cache[0];
+    for (uint8_t i = 0; i < SIM_READ_CACHE_SLOTS; i++) {
+        sim_read_cache_entry_t *e = &sim_read_cache[i];
+        if (e->valid && e->block == block) {
+            e->last_used = sim_read_cache_clock;
+            return &e->info;
+        }
+        if (victim->valid && (e->valid == false || e->last_used < victim->last_used)) {
+            victim = e;
+        }
+    }
+
+    emlGet(victim->info.response, start, 16);
+    AddCrc14A(victim->info.response, 16);
+    victim->info.response_n = MAX_MIFARE_FRAME_SIZE;
+    victim->valid = prepare_tag_modulation(&victim->info, SIM_READ_CACHE_MODULATION_SIZE);
+    if (victim->valid == false) {
+        return NULL;
+    }
+    victim->block = block;
+    victim->last_used = sim_read_cache_clock;
+    return &victim->info;
+}
+
 //-----------------------------------------------------------------------------
 // Main loop of simulated tag: receive commands from reader, decide what
 // response to send, and send it.
@@ -1407,6 +1604,11 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *data, uint8_
         return;
     }
 
+    sim_read_cache = NULL;
+    if (tagType == 7 || tagType == 2) {
+        sim_read_cache_init();
+    }
+
     // We need to listen to the high-frequency, peak-detected path.
     iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
 
@@ -1445,6 +1647,7 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *data, uint8_
 
     clear_trace();
     set_tracing(true);
+    decoder_stats_reset();
     LED_A_ON();
 
     // main loop
@@ -1470,6 +1673,7 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *data, uint8_
             if (isCrcCorrect) {
                 // first blocks of emu are header
                 emlSetMem_xt(receivedCmd, wrblock + MFU_DUMP_PREFIX_LENGTH / 4, 1, 4);
+                sim_read_cache_invalidate();
                 // send ACK
                 EmSend4bit(CARD_ACK);
             } else {
@@ -1575,10 +1779,15 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *data, uint8_
                 } else {
                     // first blocks of emu are header
                     uint16_t start = block * 4 + MFU_DUMP_PREFIX_LENGTH;
-                    uint8_t emdata[MAX_MIFARE_FRAME_SIZE];
-                    emlGet(emdata, start, 16);
-                    AddCrc14A(emdata, 16);
-                    EmSendCmd(emdata, sizeof(emdata));
+                    tag_response_info_t *cached = sim_read_cache_get(block, start);
+                    if (cached) {
+                        EmSendPrecompiledCmd(cached);
+                    } else {
+                        uint8_t emdata[MAX_MIFARE_FRAME_SIZE];
+                        emlGet(emdata, start, 16);
+                        AddCrc14A(emdata, 16);
+                        EmSendCmd(emdata, sizeof(emdata));
+                    }
                     numReads++;  // Increment number of times reader requested a block
 
                     if (exitAfterNReads > 0 && numReads == exitAfterNReads) {
@@ -1627,6 +1836,7 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *data, uint8_
                 } else {
                     // first blocks of emu are header
                     emlSetMem_xt(&receivedCmd[2], block + MFU_DUMP_PREFIX_LENGTH / 4, 1, 4);
+                    sim_read_cache_invalidate();
                     // send ACK
                     EmSend4bit(CARD_ACK);
                 }
@@ -1900,7 +2110,311 @@ void SimulateIso14443aTag(uint8_t tagType, uint16_t flags, uint8_t *data, uint8_
         Dbprintf("-[ Num of moebius tries [%d]", moebius_count);
     }
 
-    reply_ng(CMD_HF_MIFARE_SIMULATE, retval, NULL, 0);
+    reply_decoder_stats(CMD_HF_MIFARE_SIMULATE, retval);
+}
+
+// Frame delay between the end of a reader command and the start of our answer,  both 1/fc as logged,
+// snapped to the n*128+20 / n*128+84 grid the FPGA sends on
+static uint32_t EmExactFdt(uint32_t reader_EndTime, uint32_t tag_StartTime) {
+    uint32_t approx_fdt = tag_StartTime - reader_EndTime;
+    return (approx_fdt - 20 + 32) / 64 * 64 + 20;
+}
+
+//-----------------------------------------------------------------------------
+// Replay the tag side of a recorded trace.  The client loads a script of reader command -> tag answer
+// pairs into emulator memory.  The answers are modulated before the reader shows up and sent at the
+// recorded frame delay.  A command is looked up from the entry after the last match onwards,  so a
+// command seen more than once gets its answers in recorded order.
+// 'hf 14a replay'
+//-----------------------------------------------------------------------------
+
+// BigBuf kept for the trace of the replay,  answers which don't fit next to it are encoded when due
+#define REPLAY_TRACE_RESERVE    4096
+
+typedef struct {
+    iso14a_replay_entry_t *e;   // in emulator memory
+    tag_response_info_t info;   // modulation NULL when the answer is encoded when due
+    iso14a_replay_stat_t stat;
+} replay_slot_t;
+
+static uint8_t *replay_cmd(iso14a_replay_entry_t *e) {
+    return (uint8_t *)e + sizeof(iso14a_replay_entry_t);
+}
+
+static uint8_t *replay_rsp(iso14a_replay_entry_t *e) {
+    return replay_cmd(e) + e->cmd_len;
+}
+
+// ToSend bytes of an answer,  correction / start / stop bit and one per data and parity bit
+static uint32_t replay_modulation_size(const iso14a_replay_entry_t *e) {
+    return (e->flags & ISO14A_REPLAY_4BIT) ? 3 + 4 : 3 + e->rsp_len * 9;
+}
+
+// encode the answer of e into ToSend
+static void replay_encode(iso14a_replay_entry_t *e) {
+    if (e->flags & ISO14A_REPLAY_4BIT) {
+        Code4bitAnswerAsTag(replay_rsp(e)[0]);
+    } else {
+        CodeIso14443aAsTag(replay_rsp(e), e->rsp_len);
+    }
+}
+
+static int replay_load(replay_slot_t **slots, uint16_t *count) {
+    uint8_t *em = BigBuf_get_EM_addr();
+    const iso14a_replay_hdr_t *hdr = (const iso14a_replay_hdr_t *)em;
+
+    if (hdr->magic != ISO14A_REPLAY_MAGIC || hdr->count == 0 || hdr->length > ISO14A_REPLAY_MAX_SIZE) {
+        return PM3_EINVARG;
+    }
+
+    uint32_t size = hdr->count * sizeof(replay_slot_t);
+    *slots = (size <= UINT16_MAX) ? (replay_slot_t *)BigBuf_calloc(size) : NULL;
+    if (*slots == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    uint32_t pos = sizeof(iso14a_replay_hdr_t);
+    for (uint16_t i = 0; i < hdr->count; i++) {
+        if (pos + sizeof(iso14a_replay_entry_t) > hdr->length) {
+            return PM3_EINVARG;
+        }
+
+        iso14a_replay_entry_t *e = (iso14a_replay_entry_t *)(em + pos);
+        pos += sizeof(iso14a_replay_entry_t) + e->cmd_len + e->rsp_len;
+        if (pos > hdr->length || e->cmd_len == 0 || e->cmd_len > MAX_FRAME_SIZE || e->rsp_len > MAX_FRAME_SIZE) {
+            return PM3_EINVARG;
+        }
+        if ((e->flags & ISO14A_REPLAY_4BIT) && e->rsp_len != 1) {
+            return PM3_EINVARG;
+        }
+
+        replay_slot_t *s = &(*slots)[i];
+        s->e = e;
+        s->info.response = replay_rsp(e);
+        s->info.response_n = e->rsp_len;
+        s->stat.err_min = INT32_MAX;
+        s->stat.err_max = INT32_MIN;
+    }
+    *count = hdr->count;
+    return PM3_SUCCESS;
+}
+
+// modulate as many answers as fit in BigBuf,  returns how many did
+static uint16_t replay_precompute(replay_slot_t *slots, uint16_t count) {
+    uint32_t need = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        if (slots[i].e->rsp_len) {
+            need += replay_modulation_size(slots[i].e);
+        }
+    }
+
+    uint32_t room = BigBuf_max_traceLen();
+    room = (room > REPLAY_TRACE_RESERVE) ? room - REPLAY_TRACE_RESERVE : 0;
+    size_t left = MIN(MIN(need, room), UINT16_MAX - 3);
+
+    uint8_t *pool = (left) ? BigBuf_malloc(left) : NULL;
+    if (pool == NULL) {
+        return 0;
+    }
+
+    uint16_t done = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        replay_slot_t *s = &slots[i];
+        if (s->e->rsp_len == 0 || replay_modulation_size(s->e) > left) {
+            continue;
+        }
+
+        if (s->e->flags & ISO14A_REPLAY_4BIT) {
+            replay_encode(s->e);
+            tosend_t *ts = get_tosend();
+            memcpy(pool, ts->buf, ts->max);
+            s->info.modulation = pool;
+            s->info.modulation_n = ts->max;
+            s->info.ProxToAirDuration = LastProxToAirDuration;
+            pool += ts->max;
+            left -= ts->max;
+        } else if (prepare_allocated_tag_modulation(&s->info, &pool, &left) == false) {
+            s->info.modulation = NULL;
+            continue;
+        }
+        done++;
+    }
+    return done;
+}
+
+static int replay_find(const replay_slot_t *slots, uint16_t count, uint16_t next, const uint8_t *cmd, int len) {
+    for (uint16_t n = 0, i = next; n < count; n++, i++) {
+        if (i == count) {
+            i = 0;
+        }
+        iso14a_replay_entry_t *e = slots[i].e;
+        if (e->cmd_len == len && replay_cmd(e)[0] == cmd[0] && memcmp(replay_cmd(e), cmd, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// send the answer of s to the reader command in Uart,  at the recorded frame delay unless asap
+static void replay_answer(replay_slot_t *s, bool asap) {
+    iso14a_replay_entry_t *e = s->e;
+    tag_response_info_t *info = &s->info;
+
+    const uint8_t *mod = info->modulation;
+    uint16_t mod_n = info->modulation_n;
+    uint32_t duration = info->ProxToAirDuration;
+    if (mod == NULL) {
+        replay_encode(e);
+        tosend_t *ts = get_tosend();
+        mod = ts->buf;
+        mod_n = ts->max;
+        duration = LastProxToAirDuration;
+    }
+
+    uint32_t reader_start = Uart.startTime * 16 - DELAY_AIR2ARM_AS_TAG;
+    uint32_t reader_end = Uart.endTime * 16 - DELAY_AIR2ARM_AS_TAG;
+
+    if (asap == false) {
+        // the recorded tag took longer than the minimal frame delay,  hold the answer back.
+        // Sending starts on the next 8 tick boundary after this
+        uint32_t due = (reader_end + e->fdt - DELAY_ARM2AIR_AS_TAG) / 16 - 8;
+        while ((int32_t)(GetCountSspClk() - due) < 0) {
+            WDT_HIT();
+        }
+    }
+
+    EmSendCmd14443aRaw(mod, mod_n);
+
+    uint32_t tag_start = LastTimeProxToAirStart * 16 + DELAY_ARM2AIR_AS_TAG;
+    int32_t err = (int32_t)EmExactFdt(reader_end, tag_start) - (int32_t)e->fdt;
+
+    iso14a_replay_stat_t *st = &s->stat;
+    st->err_min = MIN(st->err_min, err);
+    st->err_max = MAX(st->err_max, err);
+    st->err_sum += err;
+    if (err > ISO14A_REPLAY_LATE) {
+        st->late++;
+    }
+
+    // do the tracing for the reader request and this tag answer:
+    GetParity(info->response, info->response_n, parity_array);
+    EmLogTrace(Uart.output,
+               Uart.len,
+               reader_start,
+               reader_end,
+               Uart.parity,
+               info->response,
+               info->response_n,
+               tag_start,
+               (LastTimeProxToAirStart + duration) * 16 + DELAY_ARM2AIR_AS_TAG,
+               parity_array);
+}
+
+static void replay_send_stats(const replay_slot_t *slots, uint16_t count) {
+    uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+    iso14a_replay_stats_chunk_t *chunk = (iso14a_replay_stats_chunk_t *)buf;
+
+    for (uint16_t first = 0; first < count; first += ISO14A_REPLAY_STATS_PER_CHUNK) {
+        chunk->first = first;
+        chunk->count = MIN(ISO14A_REPLAY_STATS_PER_CHUNK, count - first);
+        for (uint16_t i = 0; i < chunk->count; i++) {
+            memcpy(&chunk->rec[i], &slots[first + i].stat, sizeof(iso14a_replay_stat_t));
+        }
+        reply_ng(CMD_HF_ISO14443A_REPLAY_STATS, PM3_SUCCESS, buf, sizeof(iso14a_replay_stats_chunk_t) + chunk->count * sizeof(iso14a_replay_stat_t));
+    }
+}
+
+void ReplayIso14443aTag(const iso14a_replay_param_t *param) {
+
+    // command buffers
+    uint8_t receivedCmd[MAX_FRAME_SIZE] = { 0x00 };
+    uint8_t receivedCmdPar[MAX_PARITY_SIZE] = { 0x00 };
+
+    iso14a_replay_result_t result = {0};
+
+    // free eventually allocated BigBuf memory but keep Emulator Memory
+    BigBuf_free_keep_EM();
+
+    // take ToSend first,  what is left decides how many answers get modulated up front
+    get_tosend();
+
+    replay_slot_t *slots = NULL;
+    uint16_t count = 0;
+    int retval = replay_load(&slots, &count);
+    if (retval != PM3_SUCCESS) {
+        BigBuf_free_keep_EM();
+        reply_ng(CMD_HF_ISO14443A_REPLAY, retval, (uint8_t *)&result, sizeof(result));
+        return;
+    }
+
+    result.count = count;
+    result.precomputed = replay_precompute(slots, count);
+    if (g_dbglevel >= DBG_INFO) {
+        Dbprintf("Replaying " _YELLOW_("%u") " exchanges, " _YELLOW_("%u") " answers precomputed", result.count, result.precomputed);
+    }
+
+    // We need to listen to the high-frequency, peak-detected path.
+    iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+    LED_A_ON();
+
+    bool asap = (param->flags & ISO14A_REPLAY_ASAP);
+    uint16_t next = 0;
+    int len = 0;
+
+    for (;;) {
+        // BUTTON_PRESS / client check done in GetIso14443aCommandFromReader
+        WDT_HIT();
+
+        if (GetIso14443aCommandFromReader(receivedCmd, receivedCmdPar, &len) == false) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+        result.frames++;
+
+        int i = replay_find(slots, count, next, receivedCmd, len);
+        if (i < 0) {
+            result.unmatched++;
+            LogTrace(receivedCmd, Uart.len, Uart.startTime * 16 - DELAY_AIR2ARM_AS_TAG, Uart.endTime * 16 - DELAY_AIR2ARM_AS_TAG, Uart.parity, true);
+            if (g_dbglevel >= DBG_DEBUG) {
+                Dbprintf("Not in the trace (len=%d):", len);
+                Dbhexdump(len, receivedCmd, false);
+            }
+            continue;
+        }
+
+        replay_slot_t *s = &slots[i];
+        s->stat.count++;
+        next = (i + 1 == count) ? 0 : i + 1;
+
+        if (s->e->rsp_len) {
+            replay_answer(s, asap);
+        } else {
+            // the recorded tag stayed silent
+            LogTrace(receivedCmd, Uart.len, Uart.startTime * 16 - DELAY_AIR2ARM_AS_TAG, Uart.endTime * 16 - DELAY_AIR2ARM_AS_TAG, Uart.parity, true);
+        }
+
+        if (i + 1 == count) {
+            result.passes++;
+            if (param->passes && result.passes >= param->passes) {
+                break;
+            }
+        }
+    }
+
+    switch_off();
+    set_tracing(false);
+
+    if (g_dbglevel >= DBG_EXTENDED) {
+        Dbprintf("-[ Reader frames     [%u]", result.frames);
+        Dbprintf("-[ Not in the trace  [%u]", result.unmatched);
+    }
+
+    replay_send_stats(slots, count);
+    BigBuf_free_keep_EM();
+    reply_ng(CMD_HF_ISO14443A_REPLAY, retval, (uint8_t *)&result, sizeof(result));
 }
 
 // prepare a delayed transfer. This simply shifts ToSend[] by a number
@@ -2139,9 +2653,11 @@ int EmGetCmd(uint8_t *received, uint16_t *len, uint8_t *par) {
         }
 
         // receive and test the miller decoding
-        if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
+        uint32_t sr = AT91C_BASE_SSC->SSC_SR;
+        DECODER_SSC_SR(sr);
+        if (sr & (AT91C_SSC_RXRDY)) {
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
-            if (MillerDecoding(b, 0)) {
+            if (DECODER_TIMED(DECODER_STATS_MILLER, MillerDecoding(b, 0))) {
                 *len = Uart.len;
                 return 0;
             }
@@ -2282,9 +2798,7 @@ bool EmLogTrace(uint8_t *reader_data, uint16_t reader_len, uint32_t reader_Start
     // with n >= 9. The start of the tags answer can be measured and therefore the end of the received command be calculated:
 
     uint16_t reader_modlen = reader_EndTime - reader_StartTime;
-    uint16_t approx_fdt = tag_StartTime - reader_EndTime;
-    uint16_t exact_fdt = (approx_fdt - 20 + 32) / 64 * 64 + 20;
-    reader_EndTime = tag_StartTime - exact_fdt;
+    reader_EndTime = tag_StartTime - EmExactFdt(reader_EndTime, tag_StartTime);
     reader_StartTime = reader_EndTime - reader_modlen;
 
     if (!LogTrace(reader_data, reader_len, reader_StartTime, reader_EndTime, reader_Parity, true))
@@ -2377,9 +2891,11 @@ static int GetIso14443aAnswerFromTag(uint8_t *receivedResponse, uint8_t *receive
     for (;;) {
         WDT_HIT();
 
-        if (AT91C_BASE_SSC->SSC_SR & (AT91C_SSC_RXRDY)) {
+        uint32_t sr = AT91C_BASE_SSC->SSC_SR;
+        DECODER_SSC_SR(sr);
+        if (sr & (AT91C_SSC_RXRDY)) {
             b = (uint8_t)AT91C_BASE_SSC->SSC_RHR;
-            if (ManchesterDecoding(b, offset, 0)) {
+            if (DECODER_TIMED(DECODER_STATS_MANCHESTER, ManchesterDecoding(b, offset, 0))) {
                 NextTransferTime = MAX(NextTransferTime, Demod.endTime - (DELAY_AIR2ARM_AS_READER + DELAY_ARM2AIR_AS_READER) / 16 + FRAME_DELAY_TIME_PICC_TO_PCD);
                 return true;
             } else if (c++ > timeout && Demod.state == DEMOD_14A_UNSYNCD) {
@@ -2849,6 +3365,11 @@ int iso14443a_select_cardEx(uint8_t *uid_ptr, iso14a_card_select_t *p_card, uint
         // reset the PCB block number
         iso14_pcb_blocknum = 0;
 
+        // FSCI from format byte T0,  default 2 when absent.  Our block buffers stop at 256
+        static const uint16_t fsc_table[] = { 16, 24, 32, 40, 48, 64, 96, 128, 256 };
+        uint8_t fsci = (len > 3) ? (resp[1] & 0x0F) : 2;
+        iso14_fsc = fsc_table[MIN(fsci, ARRAYLEN(fsc_table) - 1)];
+
         // set default timeout and delay next transfer based on ATS
         iso14a_set_ATS_times(resp);
     }
@@ -2908,6 +3429,64 @@ int iso14443a_fast_select_card(uint8_t *uid_ptr, uint8_t num_cascades) {
     return 1;
 }
 
+// Every card in the field,  in one go.  Each round a REQA wakes the cards still idle, the
+// anticollision of iso14443a_select_cardEx resolves one of them and a HLTA takes it out of the
+// next rounds.  Stops when nobody answers anymore, on a card that doesn't halt or when the list is full.
+// The field is switched off at the end unless keep_field,  so the cards stay halted.
+void iso14443a_inventory(bool keep_field) {
+    iso14a_inventory_t inv;
+    memset(&inv, 0, sizeof(inv));
+
+    clear_trace();
+    set_tracing(true);
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    while (inv.count < ISO14A_INVENTORY_MAX) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            break;
+        }
+
+        iso14a_card_select_t card;
+        // no RATS, a card in ISO14443-4 state would want DESELECT instead of HLTA
+        int res = iso14443a_select_cardEx(NULL, &card, NULL, true, 0, true, &REQA_POLLING_PARAMETERS);
+        if (res != 1 && res != 2) {
+            break;
+        }
+
+        bool seen = false;
+        for (uint8_t i = 0; i < inv.count; i++) {
+            if (inv.cards[i].uidlen == card.uidlen && memcmp(inv.cards[i].uid, card.uid, card.uidlen) == 0) {
+                seen = true;
+                break;
+            }
+        }
+        if (seen) {
+            if (g_dbglevel >= DBG_INFO) Dbprintf("Card didn't halt, stopping inventory");
+            break;
+        }
+
+        iso14a_inventory_card_t *c = &inv.cards[inv.count++];
+        memcpy(c->uid, card.uid, sizeof(c->uid));
+        c->uidlen = card.uidlen;
+        memcpy(c->atqa, card.atqa, sizeof(c->atqa));
+        c->sak = card.sak;
+
+        uint8_t hlta[4] = { ISO14443A_CMD_HALT, 0x00 };
+        AddCrc14A(hlta, 2);
+        ReaderTransmit(hlta, sizeof(hlta), NULL);
+    }
+    inv.truncated = (inv.count == ISO14A_INVENTORY_MAX);
+
+    FpgaDisableTracing();
+    if (keep_field == false) {
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+        LEDsoff();
+    }
+    reply_ng(CMD_HF_ISO14443A_INVENTORY, PM3_SUCCESS, (uint8_t *)&inv, sizeof(inv));
+}
+
 void iso14443a_setup(uint8_t fpga_minor_mode) {
 
     FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
@@ -3045,6 +3624,238 @@ int iso14_apdu(uint8_t *cmd, uint16_t cmd_len, bool send_chaining, void *data, u
     return len;
 }
 
+// Send one ISO14443-4 block,  the CRC is appended here,  and get the card's block back.
+// WTX requests are answered on the way.
+// returns block length without CRC,  0 when there was no answer or a broken block
+static uint16_t iso14_block_exchange(uint8_t *block, uint16_t len, uint8_t *answer) {
+    AddCrc14A(block, len);
+    ReaderTransmit(block, len + 2, NULL);
+    uint16_t n = ReaderReceive(answer, parity_array);
+
+    // S-Block WTX
+    while (n >= 4 && (answer[0] & 0xF2) == 0xF2) {
+        if (CheckCrc14A(answer, n) == false) {
+            return 0;
+        }
+
+        // byte1 - WTXM [1..59]. command FWT=FWT*WTXM
+        uint8_t wtxm = MAX(answer[1] & 0x3F, 1);
+        uint32_t save_iso14a_timeout = iso14a_get_timeout();
+        iso14a_set_timeout(MIN(wtxm * save_iso14a_timeout, MAX_ISO14A_TIMEOUT));
+
+        uint8_t wtx[4] = { answer[0], wtxm };
+        AddCrc14A(wtx, 2);
+        ReaderTransmit(wtx, sizeof(wtx), NULL);
+        n = ReaderReceive(answer, parity_array);
+
+        iso14a_set_timeout(save_iso14a_timeout);
+    }
+
+    if (n < 3 || CheckCrc14A(answer, n) == false) {
+        return 0;
+    }
+    return n - 2;
+}
+
+static uint16_t iso14_build_iblock(uint8_t *block, const uint8_t *apdu, uint16_t apdu_len, uint16_t *sent) {
+    uint16_t n = MIN(iso14_fsc - 3, apdu_len - *sent);
+    block[0] = 0x02 | iso14_pcb_blocknum;
+    if (*sent + n < apdu_len) {
+        block[0] |= 0x10;
+    }
+    memcpy(block + 1, apdu + *sent, n);
+    *sent += n;
+    return n + 1;
+}
+
+//-----------------------------------------------------------------------------
+// Exchange one APDU with the whole ISO14443-4 block protocol on the device
+//  - the APDU goes out in chained I-blocks of FSC - 3 bytes,  each ACKed by the card
+//  - response I-block chaining is ACKed and the response reassembled
+//  - a block which didn't come or came broken is asked for again with R(NAK) (7.5.4.2 rule 4),
+//    an R(ACK) of the previous block number means the card missed ours,  which gets resent (rule 6)
+// returns response length,  or a negative PM3 error
+//-----------------------------------------------------------------------------
+int iso14_apdu_exchange(const uint8_t *apdu, uint16_t apdu_len, uint8_t *out, uint16_t out_max) {
+
+    uint8_t tx[MAX_FRAME_SIZE];
+    uint8_t rx[MAX_FRAME_SIZE];
+    uint16_t sent = 0;
+    uint16_t out_len = 0;
+    uint8_t errors = 0;
+    bool nak = false;
+
+    uint16_t txlen = iso14_build_iblock(tx, apdu, apdu_len, &sent);
+
+    for (;;) {
+
+        uint16_t n;
+        if (nak) {
+            uint8_t rnak[3] = { 0xB2 | iso14_pcb_blocknum };
+            n = iso14_block_exchange(rnak, 1, rx);
+        } else {
+            n = iso14_block_exchange(tx, txlen, rx);
+        }
+        nak = false;
+
+        if (n == 0) {
+            if (++errors > ISO14_APDU_RETRIES) {
+                return PM3_ECARDEXCHANGE;
+            }
+            nak = true;
+            continue;
+        }
+
+        uint8_t pcb = rx[0];
+
+        // I-block
+        if ((pcb & 0xE2) == 0x02) {
+            if (sent < apdu_len || (pcb & 0x01) != iso14_pcb_blocknum) {
+                return PM3_EWRONGANSWER;
+            }
+            iso14_pcb_blocknum ^= 1;
+            errors = 0;
+
+            if (out_len + n - 1 > out_max) {
+                return PM3_EOVFLOW;
+            }
+            memcpy(out + out_len, rx + 1, n - 1);
+            out_len += n - 1;
+
+            if ((pcb & 0x10) == 0) {
+                return out_len;
+            }
+
+            // card is chaining,  R(ACK) for the next part
+            tx[0] = 0xA2 | iso14_pcb_blocknum;
+            txlen = 1;
+            continue;
+        }
+
+        // R-block
+        if ((pcb & 0xE6) == 0xA2) {
+            if ((pcb & 0x01) != iso14_pcb_blocknum) {
+                if (++errors > ISO14_APDU_RETRIES) {
+                    return PM3_ECARDEXCHANGE;
+                }
+                continue;
+            }
+
+            // ACK of our chained I-block,  on with the next part
+            if ((pcb & 0x10) == 0 && (tx[0] & 0xF2) == 0x12) {
+                iso14_pcb_blocknum ^= 1;
+                errors = 0;
+                txlen = iso14_build_iblock(tx, apdu, apdu_len, &sent);
+                continue;
+            }
+        }
+
+        // S(DESELECT),  a NAK from the card or an ACK out of place
+        return PM3_EWRONGANSWER;
+    }
+}
+
+static bool iso14_apdu_sw_ok(const uint8_t *resp, uint16_t len) {
+    if (len < 2) {
+        return false;
+    }
+    uint8_t sw1 = resp[len - 2];
+    uint8_t sw2 = resp[len - 1];
+    return (sw1 == 0x90 && sw2 == 0x00) || sw1 == 0x61 || (sw1 == 0x91 && (sw2 == 0x00 || sw2 == 0xAF));
+}
+
+//-----------------------------------------------------------------------------
+// Run a list of APDUs without host round trips.  The responses are collected in BigBuf
+// and the client downloads them after the reply.
+// A failed block exchange always ends the batch,  a bad status word only with stop_on_error.
+//-----------------------------------------------------------------------------
+void iso14_apdu_batch(const uint8_t *data, uint16_t datalen) {
+
+    const iso14a_apdu_batch_req_t *req = (const iso14a_apdu_batch_req_t *)data;
+    iso14a_apdu_batch_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    if (datalen < sizeof(iso14a_apdu_batch_req_t)) {
+        reply_ng(CMD_HF_ISO14443A_APDU_BATCH, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    BigBuf_free();
+    uint8_t *buf = BigBuf_malloc(ISO14A_APDU_BATCH_BUF);
+    if (buf == NULL) {
+        reply_ng(CMD_HF_ISO14443A_APDU_BATCH, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    int status = PM3_SUCCESS;
+
+    if ((req->flags & ISO14A_CONNECT) == ISO14A_CONNECT) {
+        clear_trace();
+        set_tracing(true);
+        iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+        if (iso14443a_select_card(NULL, NULL, NULL, true, 0, false) != 1) {
+            status = PM3_ECARDEXCHANGE;
+        }
+    } else {
+        set_tracing(true);
+    }
+
+    uint16_t pos = sizeof(iso14a_apdu_batch_req_t);
+    uint32_t used = 0;
+
+    for (uint8_t i = 0; status == PM3_SUCCESS && i < req->count; i++) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        uint16_t len = 0;
+        if (pos + sizeof(len) > datalen) {
+            status = PM3_EINVARG;
+            break;
+        }
+        memcpy(&len, data + pos, sizeof(len));
+        pos += sizeof(len);
+        if (len == 0 || pos + len > datalen) {
+            status = PM3_EINVARG;
+            break;
+        }
+
+        if (used + sizeof(iso14a_apdu_batch_entry_t) > ISO14A_APDU_BATCH_BUF) {
+            status = PM3_EOVFLOW;
+            break;
+        }
+
+        iso14a_apdu_batch_entry_t *e = (iso14a_apdu_batch_entry_t *)(buf + used);
+        int res = iso14_apdu_exchange(data + pos, len, e->data, ISO14A_APDU_BATCH_BUF - used - sizeof(iso14a_apdu_batch_entry_t));
+        pos += len;
+
+        e->status = (res < 0) ? res : PM3_SUCCESS;
+        e->len = (res < 0) ? 0 : res;
+        used += sizeof(iso14a_apdu_batch_entry_t) + e->len;
+        resp.count++;
+
+        if (res < 0) {
+            status = res;
+        } else if (req->stop_on_error && iso14_apdu_sw_ok(e->data, e->len) == false) {
+            break;
+        }
+    }
+    FpgaDisableTracing();
+
+    if ((req->flags & ISO14A_NO_DISCONNECT) == 0 || status != PM3_SUCCESS) {
+        hf_field_off();
+        set_tracing(false);
+    }
+
+    resp.bb_offset = buf - BigBuf_get_addr();
+    resp.bb_len = used;
+    reply_ng(CMD_HF_ISO14443A_APDU_BATCH, status, (uint8_t *)&resp, sizeof(resp));
+    BigBuf_free();
+}
+
 //-----------------------------------------------------------------------------
 // Read an ISO 14443a tag. Send out commands and store answers.
 //-----------------------------------------------------------------------------
@@ -3225,8 +4036,13 @@ static int32_t dist_nt(uint32_t nt1, uint32_t nt2) {
 // the algorithm described in "The Dark Side of Security by Obscurity and
 // Cloning MiFare Classic Rail and Building Passes, Anywhere, Anytime"
 // (article by Nicolas T. Courtois, 2009)
+//
+// Up to MF_DARKSIDE_MAX_SETS datasets are collected in one call, each with another
+// reader nonce while staying in sync with the tag nonce.
 //-----------------------------------------------------------------------------
-void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
+void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype, uint8_t sets) {
+
+    sets = MAX(1, MIN(sets, MF_DARKSIDE_MAX_SETS));
 
     iso14443a_setup(FPGA_HF_ISO14443A_READER_MOD);
 
@@ -3268,6 +4084,9 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
 
     int return_status = PM3_SUCCESS;
 
+    mf_darkside_t payload;
+    memset(&payload, 0, sizeof(payload));
+
     AddCrc14A(mf_auth, 2);
 
     if (first_try) {
@@ -3461,8 +4280,30 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
 
             // Test if the information is complete
             if (nt_diff == 0x07) {
-                isOK = 1;
-                break;
+
+                mf_darkside_set_t *set = &payload.sets[payload.count++];
+                num_to_bytes(nt, 4, set->nt);
+                memcpy(set->par_list, par_list, sizeof(set->par_list));
+                memcpy(set->ks_list, ks_list, sizeof(set->ks_list));
+                memcpy(set->nr, mf_nr_ar, sizeof(set->nr));
+                set->nr[3] &= 0x1F;
+                memcpy(set->ar, mf_nr_ar + 4, sizeof(set->ar));
+
+                if (payload.count == sets) {
+                    isOK = 1;
+                    break;
+                }
+
+                // next dataset, another READER nonce (first 3 parity bits remain the same)
+                first_try = false;
+                mf_nr_ar3++;
+                mf_nr_ar[3] = mf_nr_ar3;
+                nt_diff = 0;
+                par[0] = par_low;
+                memset(par_list, 0, sizeof(par_list));
+                memset(ks_list, 0, sizeof(ks_list));
+                consecutive_resyncs = 0;
+                continue;
             }
 
             nt_diff = (nt_diff + 1) & 0x07;
@@ -3487,29 +4328,17 @@ void ReaderMifare(bool first_try, uint8_t block, uint8_t keytype) {
         consecutive_resyncs = 0;
     } // end for loop
 
-    mf_nr_ar[3] &= 0x1F;
-
     if (g_dbglevel >= DBG_EXTENDED) Dbprintf("Number of sent auth requests: %u", i);
 
     FpgaDisableTracing();
 
-    struct {
-        int32_t isOK;
-        uint8_t cuid[4];
-        uint8_t nt[4];
-        uint8_t par_list[8];
-        uint8_t ks_list[8];
-        uint8_t nr[4];
-        uint8_t ar[4];
-    } PACKED payload;
+    // the card giving up on later datasets doesn't spoil the ones already collected
+    if (payload.count && isOK < 0 && isOK != -1 && isOK != -6) {
+        isOK = 1;
+    }
 
     payload.isOK = isOK;
     num_to_bytes(cuid, 4, payload.cuid);
-    num_to_bytes(nt, 4, payload.nt);
-    memcpy(payload.par_list, par_list, sizeof(payload.par_list));
-    memcpy(payload.ks_list, ks_list, sizeof(payload.ks_list));
-    memcpy(payload.nr, mf_nr_ar, sizeof(payload.nr));
-    memcpy(payload.ar, mf_nr_ar + 4, sizeof(payload.ar));
 
     reply_ng(CMD_HF_MIFARE_READER, return_status, (uint8_t *)&payload, sizeof(payload));
 
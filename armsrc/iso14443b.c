@@ -185,8 +185,11 @@
 # define ISO14B_BLOCK_SIZE  4
 #endif
 
-// 4sample
-#define SEND4STUFFBIT(x) tosend_stuffbit(!(x));tosend_stuffbit(!(x));tosend_stuffbit(!(x));tosend_stuffbit(!(x));
+// 4sample,  each bit of a nibble (LSB first) as four inverted samples,  ready for tosend_stuffbits()
+static const uint16_t encode14b_tag_nibble[16] = {
+    0xffff, 0x0fff, 0xf0ff, 0x00ff, 0xff0f, 0x0f0f, 0xf00f, 0x000f,
+    0xfff0, 0x0ff0, 0xf0f0, 0x00f0, 0xff00, 0x0f00, 0xf000, 0x0000
+};
 
 static void iso14b_set_timeout(uint32_t timeout_etu);
 static void iso14b_set_maxframesize(uint16_t size);
@@ -361,55 +364,37 @@ static void CodeIso14443bAsTag(const uint8_t *cmd, int len) {
     // 80/fs < TR1 < 200/fs
     // 10 ETU < TR1 < 24 ETU
 
-    int i;
     // Send TR1.
     // 10-11 ETU * 4times samples ONES
-    for (i = 0; i < 10; i++) {
-        SEND4STUFFBIT(1);
-    }
+    tosend_stuffbits(0, 20);
+    tosend_stuffbits(0, 20);
 
     // Send SOF.
     // 10-11 ETU * 4times samples ZEROS
-    for (i = 0; i < 10; i++) {
-        SEND4STUFFBIT(0);
-    }
+    tosend_stuffbits(0xFFFFF, 20);
+    tosend_stuffbits(0xFFFFF, 20);
 
     // 2-3 ETU * 4times samples ONES
-    for (i = 0; i < 2; i++) {
-        SEND4STUFFBIT(1);
-    }
+    tosend_stuffbits(0, 8);
 
     // data
-    for (i = 0; i < len; i++) {
-
-        // Start bit
-        SEND4STUFFBIT(0);
-
-        // Data bits
+    for (int i = 0; i < len; i++) {
         uint8_t b = cmd[i];
-        for (int j = 0; j < 8; j++) {
-            SEND4STUFFBIT(b & 1);
-            b >>= 1;
-        }
 
-        // Stop bit
-        SEND4STUFFBIT(1);
+        // Start bit + low nibble
+        tosend_stuffbits(0xF0000 | encode14b_tag_nibble[b & 0x0F], 20);
+
+        // high nibble + Stop bit
+        tosend_stuffbits((uint32_t)encode14b_tag_nibble[b >> 4] << 4, 20);
 
         // Extra Guard bit
         // For PICC it ranges 0-18us (1etu = 9us)
-        //SEND4STUFFBIT(1);
     }
 
     // Send EOF.
     // 10-11 ETU * 4 sample rate = ZEROS
-    for (i = 0; i < 10; i++) {
-        SEND4STUFFBIT(0);
-    }
-
-    // why this? push out transfers between arm and fpga?
-    //for (i = 0; i < 2; i++) {
-    //    SEND4STUFFBIT(1);
-    //}
+    tosend_stuffbits(0xFFFFF, 20);
+    tosend_stuffbits(0xFFFFF, 20);
 
     tosend_t *ts = get_tosend();
     // Convert from last byte pos to length
@@ -1526,41 +1511,21 @@ static void CodeIso14443bAsReader(const uint8_t *cmd, int len, bool framing) {
                 all commands is 14 ETUs
     *
     */
-    int i;
     tosend_reset();
 
     // add framing enable flag.
     // xerox chips use unframed commands during anticollision
     if (framing) {
         // Send SOF
-        // 10-11 ETUs of ZERO
-        for (i = 0; i < 10; i++) {
-            tosend_stuffbit(0);
-        }
-        // 2-3 ETUs of ONE
-        tosend_stuffbit(1);
-        tosend_stuffbit(1);
+        // 10-11 ETUs of ZERO,  2-3 ETUs of ONE
+        tosend_stuffbits(0x003, 12);
     }
 
     // Sending cmd, LSB
     // from here we add BITS
-    for (i = 0; i < len; i++) {
-        // Start bit
-        tosend_stuffbit(0);
-
-        // Data bits
-        volatile uint8_t b = cmd[i];
-        tosend_stuffbit(b & 1);
-        tosend_stuffbit((b >> 1) & 1);
-        tosend_stuffbit((b >> 2) & 1);
-        tosend_stuffbit((b >> 3) & 1);
-        tosend_stuffbit((b >> 4) & 1);
-        tosend_stuffbit((b >> 5) & 1);
-        tosend_stuffbit((b >> 6) & 1);
-        tosend_stuffbit((b >> 7) & 1);
-
-        // Stop bit
-        tosend_stuffbit(1);
+    for (int i = 0; i < len; i++) {
+        // Start bit,  data bits LSB first,  Stop bit
+        tosend_stuffbits(((uint32_t)reflect8(cmd[i]) << 1) | 1, 10);
         // EGT extra guard time  1 ETU = 9us
         // For PCD it ranges 0-57us === 0 - 6 ETU
         // FOR PICC it ranges 0-19us == 0 - 2 ETU
@@ -1569,9 +1534,7 @@ static void CodeIso14443bAsReader(const uint8_t *cmd, int len, bool framing) {
     if (framing) {
         // Send EOF
         // 10-11 ETUs of ZERO
-        for (i = 0; i < 10; i++) {
-            tosend_stuffbit(0);
-        }
+        tosend_stuffbits(0, 10);
     }
 
     // we can't use padding now
@@ -2256,6 +2219,53 @@ static int iso14443b_select_picopass_card(picopass_hdr_t *hdr) {
     return PM3_SUCCESS;
 }
 
+// Tries all selects in one go with the field left on,  a card ignores the wake up commands of the other variants.
+// Stops at the first card which answers.
+static int iso14443b_probe(iso14b_probe_resp_t *probe, uint32_t *len) {
+
+    for (uint8_t i = 0; i < ISO14B_PROBE_COUNT; i++) {
+        probe->status[i] = PM3_ENODATA;
+    }
+    probe->type = ISO14B_NONE;
+    *len = sizeof(iso14b_probe_resp_t);
+
+    memset(probe->data, 0, sizeof(iso14b_card_select_t));
+    probe->status[ISO14B_PROBE_STD] = iso14443b_select_card((iso14b_card_select_t *)probe->data);
+    if (probe->status[ISO14B_PROBE_STD] == PM3_SUCCESS) {
+        probe->type = ISO14B_STANDARD;
+        *len += sizeof(iso14b_card_select_t);
+        return PM3_SUCCESS;
+    }
+
+    memset(probe->data, 0, sizeof(iso14b_card_select_t));
+    probe->status[ISO14B_PROBE_SR] = iso14443b_select_srx_card((iso14b_card_select_t *)probe->data);
+    if (probe->status[ISO14B_PROBE_SR] == PM3_SUCCESS) {
+        probe->type = ISO14B_SR;
+        *len += sizeof(iso14b_card_select_t);
+        return PM3_SUCCESS;
+    }
+
+    WDT_HIT();
+
+    memset(probe->data, 0, sizeof(picopass_hdr_t));
+    probe->status[ISO14B_PROBE_PICOPASS] = iso14443b_select_picopass_card((picopass_hdr_t *)probe->data);
+    if (probe->status[ISO14B_PROBE_PICOPASS] == PM3_SUCCESS) {
+        probe->type = ISO14B_PICOPASS;
+        *len += sizeof(picopass_hdr_t);
+        return PM3_SUCCESS;
+    }
+
+    memset(probe->data, 0, sizeof(iso14b_cts_card_select_t));
+    probe->status[ISO14B_PROBE_CTS] = iso14443b_select_cts_card((iso14b_cts_card_select_t *)probe->data);
+    if (probe->status[ISO14B_PROBE_CTS] == PM3_SUCCESS) {
+        probe->type = ISO14B_CT;
+        *len += sizeof(iso14b_cts_card_select_t);
+        return PM3_SUCCESS;
+    }
+
+    return PM3_ECARDEXCHANGE;
+}
+
 // Set up ISO 14443 Type B communication (similar to iso14443a_setup)
 // field is setup for "Sending as Reader"
 void iso14443b_setup(void) {
@@ -2363,6 +2373,43 @@ out:
     switch_off();
 }
 
+// Reads blocks 0..lastblock and the system block into BigBuf,  one command for the whole SRx / ST25TB memory.
+void read_14b_srx_dump(uint8_t lastblock) {
+    iso14443b_setup();
+
+    set_tracing(true);
+
+    iso14b_srx_dump_resp_t resp = {0};
+    uint16_t blocks = lastblock + 2;
+    uint8_t *data = BigBuf_calloc(blocks * ISO14B_BLOCK_SIZE);
+
+    iso14b_card_select_t card;
+    int res = iso14443b_select_srx_card(&card);
+
+    while (res == PM3_SUCCESS && resp.blocks < blocks) {
+        WDT_HIT();
+
+        // the system block comes last
+        uint8_t blocknr = (resp.blocks > lastblock) ? 0xFF : resp.blocks;
+        for (uint8_t retry = 0; retry < 3; retry++) {
+            res = read_14b_srx_block(blocknr, data + (resp.blocks * ISO14B_BLOCK_SIZE));
+            if (res == PM3_SUCCESS) {
+                break;
+            }
+        }
+        if (res == PM3_SUCCESS) {
+            resp.blocks++;
+        }
+    }
+
+    resp.bb_offset = data - BigBuf_get_addr();
+    reply_ng(CMD_HF_SRI_DUMP, res, (uint8_t *)&resp, sizeof(resp));
+
+    set_tracing(false);
+    BigBuf_free_keep_EM();
+    switch_off();
+}
+
 //=============================================================================
 // Finally, the `sniffer' combines elements from both the reader and
 // simulated tag, to show both sides of the conversation.
@@ -2590,6 +2637,12 @@ void SendRawCommand14443B(iso14b_raw_cmd_t *p) {
     uint32_t sendlen = sizeof(iso14b_card_select_t);
     iso14b_card_select_t *card = (iso14b_card_select_t *)buf;
 
+    if ((p->flags & ISO14B_SELECT_PROBE) == ISO14B_SELECT_PROBE) {
+        status = iso14443b_probe((iso14b_probe_resp_t *)buf, &sendlen);
+        reply_ng(CMD_HF_ISO14443B_COMMAND, status, buf, sendlen);
+        if (status != PM3_SUCCESS) goto out;
+    }
+
     if ((p->flags & ISO14B_SELECT_STD) == ISO14B_SELECT_STD) {
         status = iso14443b_select_card(card);
         reply_ng(CMD_HF_ISO14443B_COMMAND, status, (uint8_t *)card, sendlen);
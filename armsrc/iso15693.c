@@ -73,6 +73,7 @@
 #include "ticks.h"
 #include "BigBuf.h"
 #include "crc16.h"
+#include "decoder_stats.h"
 
 // Delays in SSP_CLK ticks.
 // SSP_CLK runs at 13,56MHz / 32 = 423.75kHz when simulating a tag
@@ -219,17 +220,16 @@ static void CodeIso15693AsReader256(const uint8_t *cmd, int n) {
     // SOF for 1of256
     ts->buf[++ts->max] = 0x81; //10000001
 
-    // data
+    // data,  every byte is 256 slots of two bits,  where slot cmd[i] is 01 and all others 00.
+    // The SOF leaves us byte aligned,  so a byte is 64 whole bytes of ToSend.
     for (int i = 0; i < n; i++) {
-        for (int j = 0; j <= 255; j++) {
-            if (cmd[i] == j) {
-                tosend_stuffbit(0);
-                tosend_stuffbit(1);
-            } else {
-                tosend_stuffbit(0);
-                tosend_stuffbit(0);
-            }
+        if (ts->max + 64 >= TOSEND_BUFFER_SIZE) {
+            Dbprintf(_RED_("toSend overflow"));
+            break;
         }
+        memset(ts->buf + ts->max + 1, 0x00, 64);
+        ts->buf[ts->max + 1 + (cmd[i] >> 2)] = 0x40 >> ((cmd[i] & 0x03) << 1);
+        ts->max += 64;
     }
 
     // EOF
@@ -1017,6 +1017,8 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
         if (behindBy == 0)
             continue;
 
+        DECODER_DMA_BACKLOG(behindBy);
+
         samples++;
         if (samples == 1) {
             // DMA has transferred the very first data
@@ -1035,6 +1037,7 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
                 if (AT91C_BASE_PDC_SSC->PDC_RCR == false) {
                     AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
                     AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
+                    DECODER_DMA_LOST();
                 }
                 // secondary buffer sets as primary, secondary buffer was stopped
                 if (AT91C_BASE_PDC_SSC->PDC_RNCR == false) {
@@ -1068,13 +1071,14 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
 
             // timeout
             if (samples > timeout && dtf->state < STATE_FSK_RECEIVING_DATA_484) {
-                ret = PM3_ETIMEOUT;
+                // bytes decoded before the decoder lost sync,  i.e. a garbled frame or a collision
+                ret = (dtf->len) ? PM3_ECARDEXCHANGE : PM3_ETIMEOUT;
                 break;
             }
 
         } else {
 
-            if (Handle15693SamplesFromTag(tagdata & 0x3FFF, dt, recv_speed)) {
+            if (DECODER_TIMED(DECODER_STATS_15_TAG, Handle15693SamplesFromTag(tagdata & 0x3FFF, dt, recv_speed))) {
 
                 *eof_time = dma_start_time + (samples * 16) - DELAY_TAG_TO_ARM; // end of EOF
 
@@ -1091,7 +1095,8 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
 
             // timeout
             if (samples > timeout && dt->state < STATE_TAG_RECEIVING_DATA) {
-                ret = PM3_ETIMEOUT;
+                // bytes decoded before the decoder lost sync,  i.e. a garbled frame or a collision
+                ret = (dt->len) ? PM3_ECARDEXCHANGE : PM3_ETIMEOUT;
                 break;
             }
         }
@@ -1510,6 +1515,8 @@ int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eo
         volatile uint16_t behindBy = ((uint8_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
         if (behindBy == 0) continue;
 
+        DECODER_DMA_BACKLOG(behindBy);
+
         if (samples == 0) {
             // DMA has transferred the very first data
             dma_start_time = GetCountSspClk() & 0xfffffff0;
@@ -1520,6 +1527,7 @@ int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eo
             upTo = dma->buf;                                    // start reading the circular buffer from the beginning
             if (behindBy > (9 * DMA_BUFFER_SIZE / 10)) {
                 Dbprintf("About to blow circular buffer - aborted! behindBy %d", behindBy);
+                DECODER_DMA_LOST();
                 break;
             }
         }
@@ -1529,7 +1537,7 @@ int GetIso15693CommandFromReader(uint8_t *received, size_t max_len, uint32_t *eo
         }
 
         for (int i = 7; i >= 0; i--) {
-            if (Handle15693SampleFromReader((b >> i) & 0x01, dr)) {
+            if (DECODER_TIMED(DECODER_STATS_15_READER, Handle15693SampleFromReader((b >> i) & 0x01, dr))) {
                 *eof_time = dma_start_time + samples - DELAY_READER_TO_ARM; // end of EOF
                 gotFrame = true;
                 break;
@@ -1626,7 +1634,8 @@ void AcquireRawAdcSamplesIso15693(void) {
     LEDsoff();
 }
 
-void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass) {
+// param: SNIFF_PARAM_TRACE_RING / SNIFF_PARAM_TRACE_STREAM - ring trace,  streamed to the client
+void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass, uint8_t param) {
 
     LEDsoff();
     LED_A_ON();
@@ -1639,6 +1648,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
     BigBuf_free();
     clear_trace();
     set_tracing(true);
+    decoder_stats_reset();
 
     DecodeTag_t dtag = {0};
     uint8_t response[ISO15693_MAX_RESPONSE_LENGTH] = {0};
@@ -1683,10 +1693,20 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
 
     const uint16_t *upTo = dma->buf;
 
+    trace_sniff_start(param);
+
     for (;;) {
 
         volatile int behind_by = ((uint16_t *)AT91C_BASE_PDC_SSC->PDC_RPR - upTo) & (DMA_BUFFER_SIZE - 1);
-        if (behind_by < 1) continue;
+        if (behind_by < 1) {
+            // nothing to decode,  a good moment to push finished records to the client
+            if ((tag_is_active == false) && (reader_is_active == false)) {
+                trace_stream_poll();
+            }
+            continue;
+        }
+
+        DECODER_DMA_BACKLOG(behind_by);
 
         samples++;
         if (samples == 1) {
@@ -1711,6 +1731,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
                 if (AT91C_BASE_PDC_SSC->PDC_RCR == false) {
                     AT91C_BASE_PDC_SSC->PDC_RPR = (uint32_t) dma->buf;
                     AT91C_BASE_PDC_SSC->PDC_RCR = DMA_BUFFER_SIZE;
+                    DECODER_DMA_LOST();
                 }
                 // secondary buffer sets as primary, secondary buffer was stopped
                 if (AT91C_BASE_PDC_SSC->PDC_RNCR == false) {
@@ -1729,8 +1750,8 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
         if (tag_is_active == false) {
 
             int extra_8s = 1;
-            if (Handle15693SampleFromReader((sniffdata & 0x02) >> 1, &dreader) ||
-                    (++extra_8s && Handle15693SampleFromReader(sniffdata & 0x01, &dreader))) {
+            if (DECODER_TIMED(DECODER_STATS_15_READER, Handle15693SampleFromReader((sniffdata & 0x02) >> 1, &dreader)) ||
+                    (++extra_8s && DECODER_TIMED(DECODER_STATS_15_READER, Handle15693SampleFromReader(sniffdata & 0x01, &dreader)))) {
 
                 if (dreader.byteCount > 0) {
                     // sof/eof_times are in ssp_clk, which is 13.56MHz / 4
@@ -1765,7 +1786,7 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
 
             if (expect_fsk_answer == false) {
                 // single subcarrier tag response
-                if (Handle15693SamplesFromTag((sniffdata >> 4) << 2, &dtag, expect_fast_answer)) {
+                if (DECODER_TIMED(DECODER_STATS_15_TAG, Handle15693SamplesFromTag((sniffdata >> 4) << 2, &dtag, expect_fast_answer))) {
 
                     // sof/eof_times are in ssp_clk, which is 13.56MHz / 4
                     uint32_t eof_time = dma_start_time + (samples * 16) - DELAY_TAG_TO_ARM_SNIFF; // end of EOF
@@ -1832,6 +1853,8 @@ void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool icla
     FpgaDisableTracing();
     switch_off();
 
+    trace_sniff_stop();
+
     DbpString("");
     if (g_dbglevel > DBG_ERROR) {
         DbpString(_CYAN_("Sniff statistics"));
@@ -2094,6 +2117,309 @@ void ReaderIso15693(iso15_card_select_t *p_card) {
     BigBuf_free();
 }
 
+// Encode a 16 slot inventory request,  only tags whose UID ends with the mask_len bits of mask answer.
+// It expects "cmd" to be at least 2 + 1 + 8 + 2 bytes large
+static uint8_t BuildInventory16Request(uint8_t *cmd, uint64_t mask, uint8_t mask_len) {
+    uint8_t len = 0;
+    cmd[len++] = ISO15_REQ_SUBCARRIER_SINGLE | ISO15_REQ_DATARATE_HIGH | ISO15_REQ_INVENTORY | ISO15_REQINV_SLOT16;
+    cmd[len++] = ISO15693_INVENTORY;
+    cmd[len++] = mask_len;
+    for (uint8_t i = 0; i < (mask_len + 7) / 8; i++) {
+        cmd[len++] = (mask >> (i * 8)) & 0xFF;
+    }
+    AddCrc15(cmd, len);
+    return len + 2;
+}
+
+//-----------------------------------------------------------------------------
+// 16 slot inventory,  returns all tags in the field.
+// A slot with a collision gets its own round later,  with the mask extended by the slot number.
+// Tags found are silenced with STAY QUIET and their round runs once more,  since a collision
+// may also look like an empty slot to the decoder.
+//-----------------------------------------------------------------------------
+#define ISO15_INVENTORY_MASKS 32
+
+void InventoryIso15693(bool keep_field) {
+
+    LED_A_ON();
+
+    iso15_inventory_t inv;
+    memset(&inv, 0, sizeof(inv));
+
+    uint8_t *answer = BigBuf_malloc(ISO15693_MAX_RESPONSE_LENGTH);
+    if (answer == NULL) {
+        reply_ng(CMD_HF_ISO15693_INVENTORY, PM3_EMALLOC, NULL, 0);
+        return;
+    }
+
+    // masks still to be run,  as a stack
+    uint64_t masks[ISO15_INVENTORY_MASKS];
+    uint8_t mask_lens[ISO15_INVENTORY_MASKS];
+    uint8_t n_masks = 0;
+
+    masks[n_masks] = 0;
+    mask_lens[n_masks++] = 0;
+
+    clear_trace();
+    Iso15693InitReader();
+
+    uint32_t start_time = GetCountSspClk();
+    uint32_t eof_time = 0;
+    int res = PM3_SUCCESS;
+
+    while (n_masks && inv.count < ISO15_INVENTORY_MAX) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        n_masks--;
+        uint64_t mask = masks[n_masks];
+        uint8_t mask_len = mask_lens[n_masks];
+        uint8_t n_base = n_masks;
+
+        uint8_t cmd[13];
+        uint8_t cmdlen = BuildInventory16Request(cmd, mask, mask_len);
+
+        uint8_t found = inv.count;
+
+        for (uint8_t slot = 0; slot < 16; slot++) {
+
+            uint16_t recvlen = 0;
+            if (slot == 0) {
+                res = SendDataTag(cmd, cmdlen, false, true, answer, ISO15693_MAX_RESPONSE_LENGTH, start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+            } else {
+                res = SendDataTagEOF(answer, ISO15693_MAX_RESPONSE_LENGTH, start_time, ISO15693_READER_TIMEOUT, &eof_time, false, true, &recvlen);
+            }
+            start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+
+            if (res == PM3_ETEAROFF) {
+                break;
+            }
+
+            // empty slot,  a collision comes as a garbled answer or PM3_ECARDEXCHANGE
+            if (res == PM3_ETIMEOUT || (res == PM3_SUCCESS && recvlen == 0)) {
+                res = PM3_SUCCESS;
+                continue;
+            }
+
+            bool valid = (res == PM3_SUCCESS && recvlen == CMD_INV_RESP && CheckCrc15(answer, recvlen) && (answer[0] & ISO15_RES_ERROR) == 0);
+            res = PM3_SUCCESS;
+
+            if (valid == false) {
+                // collision,  resolve it with one more bit of mask + slot number
+                if (mask_len + 4 <= 60 && n_masks < ISO15_INVENTORY_MASKS) {
+                    masks[n_masks] = mask | ((uint64_t)slot << mask_len);
+                    mask_lens[n_masks++] = mask_len + 4;
+                } else {
+                    inv.truncated = true;
+                }
+                continue;
+            }
+
+            bool seen = false;
+            for (uint8_t i = 0; i < inv.count; i++) {
+                if (memcmp(inv.tags[i].uid, answer + 2, 8) == 0) {
+                    seen = true;
+                    break;
+                }
+            }
+
+            if (seen == false && inv.count < ISO15_INVENTORY_MAX) {
+                memcpy(inv.tags[inv.count].uid, answer + 2, 8);
+                inv.tags[inv.count].dsfid = answer[1];
+                inv.count++;
+            }
+        }
+
+        if (res == PM3_ETEAROFF) {
+            break;
+        }
+
+        if (inv.count == found) {
+            continue;
+        }
+
+        // silence the tags of this round and run it once more,  that rerun finds its collisions again
+        for (uint8_t i = found; i < inv.count; i++) {
+            uint8_t quiet[2 + 8 + 2] = { ISO15_REQ_DATARATE_HIGH | ISO15_REQ_ADDRESS, ISO15693_STAYQUIET };
+            memcpy(quiet + 2, inv.tags[i].uid, 8);
+            AddCrc15(quiet, 10);
+
+            uint16_t recvlen = 0;
+            SendDataTag(quiet, sizeof(quiet), false, true, NULL, 0, start_time, 0, &eof_time, &recvlen);
+            start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+        }
+
+        n_masks = n_base;
+        masks[n_masks] = mask;
+        mask_lens[n_masks++] = mask_len;
+    }
+
+    if (inv.count == ISO15_INVENTORY_MAX) {
+        inv.truncated = true;
+    }
+
+    if (g_dbglevel >= DBG_EXTENDED) {
+        Dbprintf("[+] inventory found %u tags", inv.count);
+    }
+
+    if (keep_field == false) {
+        switch_off();
+    }
+
+    reply_ng(CMD_HF_ISO15693_INVENTORY, res, (uint8_t *)&inv, sizeof(inv));
+    BigBuf_free();
+    LED_A_OFF();
+}
+
+//-----------------------------------------------------------------------------
+// Read the tag memory from block 0 into BigBuf,  for the client to download.
+// READ MULTIPLE BLOCKS in chunks of up to ISO15_DUMP_MULTI_BLOCKS,  a chunk the tag
+// refuses is halved down to single READ BLOCK.  Like the client did,  an error at a
+// single block ends the dump (end of memory) and each command gets two tries.
+//-----------------------------------------------------------------------------
+#define ISO15_DUMP_MULTI_BLOCKS 32
+
+void DumpIso15693(const iso15_dump_req_t *req) {
+
+    LED_A_ON();
+    BigBuf_free();
+
+    iso15_dump_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+
+    uint8_t bs = req->block_size;
+    uint16_t block_cnt = MIN(req->block_cnt, 256);
+    if (bs == 0 || bs > 32 || block_cnt == 0) {
+        reply_ng(CMD_HF_ISO15693_DUMP, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    // lock status byte + block data,  like READ MULTIPLE BLOCKS sends it with option flag
+    uint8_t stride = bs + 1;
+    uint8_t *dataout = BigBuf_malloc(block_cnt * stride);
+    uint8_t *answer = BigBuf_malloc(ISO15693_MAX_RESPONSE_LENGTH);
+    if (dataout == NULL || answer == NULL) {
+        reply_ng(CMD_HF_ISO15693_DUMP, PM3_EMALLOC, NULL, 0);
+        BigBuf_free();
+        return;
+    }
+    memset(dataout, 0, block_cnt * stride);
+
+    bool speed = ((req->flags & ISO15_HIGH_SPEED) == ISO15_HIGH_SPEED);
+    bool option = ((req->req_flags & ISO15_REQ_OPTION) == ISO15_REQ_OPTION);
+    uint8_t per_block = (option) ? stride : bs;
+
+    uint8_t cmd[2 + 8 + 2 + 2];
+    uint8_t pos = 0;
+    cmd[pos++] = req->req_flags;
+    cmd[pos++] = ISO15693_READ_MULTI_BLOCK;
+    if ((req->req_flags & ISO15_REQ_ADDRESS) == ISO15_REQ_ADDRESS) {
+        memcpy(cmd + pos, req->uid, 8);
+        pos += 8;
+    }
+
+    if ((req->flags & ISO15_CONNECT) == ISO15_CONNECT) {
+        Iso15693InitReader();
+    }
+
+    uint8_t chunk = MIN(ISO15_DUMP_MULTI_BLOCKS, (ISO15693_MAX_RESPONSE_LENGTH - 3) / per_block);
+    uint32_t start_time = GetCountSspClk();
+    uint32_t eof_time = 0;
+    uint16_t blk = 0;
+    uint8_t tries = 0;
+    int res = PM3_SUCCESS;
+
+    while (blk < block_cnt) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t n = MIN(chunk, block_cnt - blk);
+        uint8_t len = pos;
+        if (n > 1) {
+            cmd[1] = ISO15693_READ_MULTI_BLOCK;
+            cmd[len++] = blk & 0xFF;
+            cmd[len++] = n - 1;
+        } else {
+            cmd[1] = ISO15693_READBLOCK;
+            cmd[len++] = blk & 0xFF;
+        }
+        AddCrc15(cmd, len);
+        len += 2;
+
+        uint16_t recvlen = 0;
+        res = SendDataTag(cmd, len, false, speed, answer, ISO15693_MAX_RESPONSE_LENGTH, start_time, ISO15693_READER_TIMEOUT, &eof_time, &recvlen);
+        start_time = eof_time + DELAY_ISO15693_VICC_TO_VCD_READER;
+
+        if (res == PM3_ETEAROFF) {
+            break;
+        }
+
+        bool crc_ok = (res == PM3_SUCCESS && recvlen >= 3 && CheckCrc15(answer, recvlen));
+        res = PM3_SUCCESS;
+
+        if (crc_ok && (answer[0] & ISO15_RES_ERROR) == ISO15_RES_ERROR) {
+            resp.last_error = answer[1];
+            if (n == 1) {
+                break;
+            }
+            chunk = n / 2;
+            tries = 0;
+            continue;
+        }
+
+        if (crc_ok == false || recvlen != 1 + (n * per_block) + 2) {
+            if (++tries < 2) {
+                continue;
+            }
+            if (n == 1) {
+                break;
+            }
+            chunk = n / 2;
+            tries = 0;
+            continue;
+        }
+
+        for (uint8_t i = 0; i < n; i++) {
+            const uint8_t *p = answer + 1 + (i * per_block);
+            uint8_t *out = dataout + ((blk + i) * stride);
+            if (option) {
+                memcpy(out, p, stride);
+            } else {
+                memcpy(out + 1, p, bs);
+            }
+        }
+
+        resp.multi = MAX(resp.multi, n);
+        resp.last_error = 0;
+        blk += n;
+        tries = 0;
+    }
+
+    if ((req->flags & ISO15_NO_DISCONNECT) == 0) {
+        switch_off();
+    }
+
+    if (g_dbglevel >= DBG_EXTENDED) {
+        Dbprintf("[+] dump read %u blocks,  up to %u per command", blk, resp.multi);
+    }
+
+    resp.block_cnt = blk;
+    resp.block_size = bs;
+    resp.bb_offset = dataout - BigBuf_get_addr();
+    reply_ng(CMD_HF_ISO15693_DUMP, res, (uint8_t *)&resp, sizeof(resp));
+
+    BigBuf_free();
+    LED_A_OFF();
+}
+
 // When SIM: initialize the Proxmark3 as ISO15693 tag
 void Iso15693InitTag(void) {
 
@@ -2142,6 +2468,8 @@ void SimTagIso15693(const uint8_t *uid, uint8_t block_size) {
         return;
     }
 
+    decoder_stats_reset();
+
     if (uid != NULL) {
 
         uint8_t empty[8] = { 0 };
@@ -2600,7 +2928,7 @@ void SimTagIso15693(const uint8_t *uid, uint8_t block_size) {
         DbpString("button pressed");
     }
 
-    reply_ng(CMD_HF_ISO15693_SIMULATE, PM3_SUCCESS, NULL, 0);
+    reply_decoder_stats(CMD_HF_ISO15693_SIMULATE, PM3_SUCCESS);
 }
 
 // Since there is no standardized way of reading the AFI out of a tag, we will brute force it
@@ -46,12 +46,14 @@ int GetIso15693AnswerFromTag(uint8_t *response, uint16_t max_len, uint16_t timeo
 //void RecordRawAdcSamplesIso15693(void);
 void AcquireRawAdcSamplesIso15693(void);
 void ReaderIso15693(iso15_card_select_t *p_card); // ISO15693 reader
+void InventoryIso15693(bool keep_field); // 16 slot inventory of all tags in the field
+void DumpIso15693(const iso15_dump_req_t *req); // read tag memory into BigBuf
 void EmlClearIso15693(void);
 void SimTagIso15693(const uint8_t *uid, uint8_t block_size); // simulate an ISO15693 tag
 void BruteforceIso15693Afi(uint32_t flags); // find an AFI of a tag
 void SendRawCommand15693(iso15_raw_cmd_t *packet); // send arbitrary commands from CLI
 
-void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass);
+void SniffIso15693(uint8_t jam_search_len, uint8_t *jam_search_string, bool iclass, uint8_t param);
 
 int SendDataTag(const uint8_t *send, int sendlen, bool init, bool speed_fast, uint8_t *recv,
                 uint16_t max_recv_len, uint32_t start_time, uint16_t timeout, uint32_t *eof_time, uint16_t *resp_len);
@@ -63,6 +63,8 @@ static uint32_t last_frame_end; /* ts of last bit of previews rx or tx frame */
 
 #define LEGIC_CARD_MEMSIZE 1024 /* The largest Legic Prime card is 1k */
 #define WRITE_LOWERLIMIT      4 /* UID and MCC are not writable */
+#define READ_RETRIES          3 /* reconnects per byte before a read gives up */
+#define RECONNECT_FIELD_OFF 15000 /* 10ms field off, the card only takes a new IV after a power cycle */
 
 static uint32_t input_threshold = 8; /* heuristically determined, lower values */
 /* lead to detecting false ack during write */
@@ -364,6 +366,11 @@ static uint8_t calc_crc4(uint16_t cmd, uint8_t cmd_sz, uint8_t value) {
 static int16_t read_byte(uint16_t index, uint8_t cmd_sz) {
     uint16_t cmd = (index << 1) | LEGIC_READ;
 
+    // the crc covers command and data bits, LSB first. Do the command part
+    // now so only the data bits are left between rx and the next tx slot
+    crc_clear(&legic_crc);
+    crc_update(&legic_crc, cmd, cmd_sz);
+
     // read one byte
     LED_B_ON();
     legic_prng_forward(2);
@@ -377,9 +384,12 @@ static int16_t read_byte(uint16_t index, uint8_t cmd_sz) {
     uint8_t crc = BYTEx(frame, 1);
 
     // check received against calculated crc
-    uint8_t calc_crc = calc_crc4(cmd, cmd_sz, byte);
+    crc_update(&legic_crc, byte, 8);
+    uint8_t calc_crc = crc_finish(&legic_crc);
     if (calc_crc != crc) {
-        Dbprintf("!!! crc mismatch: %x != %x !!!",  calc_crc, crc);
+        if (g_dbglevel >= DBG_DEBUG) {
+            Dbprintf("!!! crc mismatch: %x != %x !!!",  calc_crc, crc);
+        }
         return -1;
     }
 
@@ -407,6 +417,45 @@ static bool write_byte(uint16_t index, uint8_t byte, uint8_t addr_sz) {
     return rx_ack();
 }
 
+// After a crc error reader and card prng are out of step. Power cycle the card
+// and run the setup again, the card must come back with the same type
+static bool reconnect(uint8_t iv) {
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    last_frame_end = GET_TICKS + RECONNECT_FIELD_OFF;
+    while (GET_TICKS < last_frame_end) { };
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_HF_READER | FPGA_HF_READER_SUBCARRIER_212_KHZ | FPGA_HF_READER_MODE_RECEIVE_IQ);
+    return (setup_phase(iv) == card.tagtype);
+}
+
+// Reads len bytes from offset into legic_mem in one pass. A crc error costs
+// a reconnect and the read goes on at the failed byte. Returns bytes read
+static uint16_t read_range(uint16_t offset, uint16_t len, uint8_t iv) {
+    uint16_t i = 0;
+    uint8_t retries = 0;
+    while (i < len) {
+        int16_t byte = read_byte(offset + i, card.cmdsize);
+        if (byte == -1) {
+            if (++retries > READ_RETRIES) {
+                break;
+            }
+            WDT_HIT();
+            if (reconnect(iv) == false) {
+                break;
+            }
+            continue;
+        }
+        retries = 0;
+        legic_mem[i] = byte;
+
+        if (offset + i < 4) {
+            card.uid[offset + i] = byte;
+        }
+        i++;
+    }
+    return i;
+}
+
 //-----------------------------------------------------------------------------
 // Command Line Interface
 //
@@ -472,17 +521,8 @@ int LegicRfReaderEx(uint16_t offset, uint16_t len, uint8_t iv) {
         len = card.cardsize - offset;
     }
 
-    for (uint16_t i = 0; i < len; ++i) {
-        int16_t byte = read_byte(offset + i, card.cmdsize);
-        if (byte == -1) {
-            res = PM3_EOVFLOW;
-            goto OUT;
-        }
-        legic_mem[i] = byte;
-
-        if (i < 4) {
-            card.uid[i] = byte;
-        }
+    if (read_range(offset, len, iv) != len) {
+        res = PM3_EOVFLOW;
     }
 
 OUT:
@@ -507,17 +547,9 @@ void LegicRfReader(uint16_t offset, uint16_t len, uint8_t iv) {
         len = card.cardsize - offset;
     }
 
-    for (uint16_t i = 0; i < len; ++i) {
-        int16_t byte = read_byte(offset + i, card.cmdsize);
-        if (byte == -1) {
-            reply_ng(CMD_HF_LEGIC_READER, PM3_EFAILED, NULL, 0);
-            goto OUT;
-        }
-        legic_mem[i] = byte;
-
-        if (i < 4) {
-            card.uid[i] = byte;
-        }
+    if (read_range(offset, len, iv) != len) {
+        reply_ng(CMD_HF_LEGIC_READER, PM3_EFAILED, NULL, 0);
+        goto OUT;
     }
 
     // OK
@@ -28,8 +28,10 @@
 #include "ticks.h"
 #include "dbprint.h"
 #include "util.h"
+#include "protocols.h"
 
 static uint8_t *legic_mem;      /* card memory, used for sim */
+static uint8_t *legic_crcs;     /* read crc per address, precomputed from the loaded image */
 static legic_card_select_t card;/* metadata of currently selected card */
 static crc_t legic_crc;
 
@@ -408,6 +410,17 @@ static uint8_t calc_crc4(uint16_t cmd, uint8_t cmd_sz, uint8_t value) {
     return crc_finish(&legic_crc);
 }
 
+// The answer to a read is the byte and the crc over read command and byte. Both
+// only depend on the address, so compute all crcs once instead of in the short
+// gap between the end of the read command and our answer. The prng part of the
+// obfuscation depends on the IV of each connection and stays in tx_frame.
+static void precompute_crcs(legic_card_select_t *p_card) {
+    uint16_t addresses = 1 << p_card->addrsize;
+    for (uint16_t addr = 0; addr < addresses; ++addr) {
+        legic_crcs[addr] = calc_crc4((addr << 1) | LEGIC_READ, p_card->cmdsize, legic_mem[addr]);
+    }
+}
+
 static int32_t connected_phase(legic_card_select_t *p_card) {
     uint8_t len = 0;
 
@@ -420,8 +433,9 @@ static int32_t connected_phase(legic_card_select_t *p_card) {
     // check if command is LEGIC_READ
     if (len == p_card->cmdsize) {
         // prepare data
-        uint8_t byte = legic_mem[cmd >> 1];
-        uint8_t crc = calc_crc4(cmd, p_card->cmdsize, byte);
+        uint16_t addr = cmd >> 1;
+        uint8_t byte = legic_mem[addr];
+        uint8_t crc = legic_crcs[addr];
 
         // transmit data
         tx_frame((crc << 8) | byte, 12);
@@ -445,6 +459,7 @@ static int32_t connected_phase(legic_card_select_t *p_card) {
 
         // store data
         legic_mem[addr] = byte;
+        legic_crcs[addr] = calc_crc4((addr << 1) | LEGIC_READ, p_card->cmdsize, byte);
 
         // transmit ack
         tx_ack();
@@ -471,6 +486,13 @@ void LegicRfSimulate(uint8_t tagtype, bool send_reply) {
         goto OUT;
     }
 
+    legic_crcs = BigBuf_malloc(1 << card.addrsize);
+    if (legic_crcs == NULL) {
+        res = PM3_EMALLOC;
+        goto OUT;
+    }
+    precompute_crcs(&card);
+
     LED_A_ON();
 
     Dbprintf("Legic Prime, simulating MCD... " _YELLOW_("%02X") " MSN... " _YELLOW_("%02X%02X%02X"), legic_mem[0], legic_mem[1], legic_mem[2], legic_mem[3]);
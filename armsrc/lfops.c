@@ -38,6 +38,7 @@
 #include "protocols.h"
 #include "pmflash.h"
 #include "flashmem.h" // persistence on flash
+#include "bf_checkpoint.h"
 #include "appmain.h" // print stack
 
 /*
@@ -206,7 +207,17 @@ static uint32_t GetT55xxClockBit(uint8_t clock) {
     }
 }
 
+// read from flash by the first user instead of at boot
+static bool T55xx_Timing_loaded = false;
+
+static void T55xx_Timing_ensure(void) {
+    if (T55xx_Timing_loaded == false) {
+        loadT55xxConfig();
+    }
+}
+
 void printT55xxConfig(void) {
+    T55xx_Timing_ensure();
 
 #define PRN_NA   sprintf(s  + strlen(s), _RED_("n/a") " | ");
 
@@ -288,6 +299,9 @@ void printT55xxConfig(void) {
 }
 
 void setT55xxConfig(uint8_t arg0, const t55xx_configurations_t *c) {
+    // merge with the stored config,  not the defaults
+    T55xx_Timing_ensure();
+
     for (uint8_t i = 0; i < 4; i++) {
         if (c->m[i].start_gap != 0)
             T55xx_Timing.m[i].start_gap = c->m[i].start_gap;
@@ -362,13 +376,15 @@ t55xx_configurations_t *getT55xxConfig(void) {
 }
 
 void loadT55xxConfig(void) {
+    T55xx_Timing_loaded = true;
 #ifdef WITH_FLASH
 
     if (!FlashInit()) {
         return;
     }
 
-    uint8_t *buf = BigBuf_malloc(T55XX_CONFIG_LEN);
+    // may run in the middle of a command,  so stay off BigBuf
+    uint8_t buf[T55XX_CONFIG_LEN];
 
     Flash_CheckBusy(BUSY_TIMEOUT);
     uint16_t isok = Flash_ReadDataCont(T55XX_CONFIG_OFFSET, buf, T55XX_CONFIG_LEN);
@@ -381,7 +397,6 @@ void loadT55xxConfig(void) {
         if (buf[i] == 0x00) cntB--;
     }
     if (!cntA || !cntB) {
-        BigBuf_free();
         return;
     }
 
@@ -391,8 +406,6 @@ void loadT55xxConfig(void) {
     if (isok == T55XX_CONFIG_LEN) {
         if (g_dbglevel > 1) DbpString("T55XX Config load success");
     }
-
-    BigBuf_free();
 #endif
 }
 
@@ -837,7 +850,7 @@ void WriteTItag(uint32_t idhi, uint32_t idlo, uint16_t crc, bool ledcontrol) {
 
 // note:   a call to FpgaDownloadAndGo(FPGA_BITSTREAM_LF) must be done before, but
 //  this may destroy the bigbuf so be sure this is called before calling SimulateTagLowFrequencyEx
-void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles) {
+int SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles) {
 
     // start us timer
     StartTicks();
@@ -872,7 +885,7 @@ void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycl
                 ++x;
             } else {
                 // exit without turning off field
-                return;
+                return PM3_SUCCESS;
             }
         }
 
@@ -923,6 +936,7 @@ OUT:
     StopTicks();
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     if (ledcontrol) LED_D_OFF();
+    return PM3_EOPABORTED;
 }
 
 void SimulateTagLowFrequency(int period, int gap, bool ledcontrol) {
@@ -956,9 +970,46 @@ static void fcAll(uint8_t fc, int *n, uint8_t clock, int16_t *remainder) {
     }
 }
 
+// compose the FSK waveform from the first bit that differs from the previous call,
+// the cells before it,  and their fcAll() remainders,  are still valid in BigBuf
+int lf_fsk_wave_update(lf_fsk_wave_t *wave, uint8_t fchigh, uint8_t fclow, uint8_t clk, uint16_t bitslen, const uint8_t *bits) {
+
+    if (bitslen > LF_FSK_WAVE_MAX_BITS)
+        return -1;
+
+    uint16_t i = 0;
+    if (wave->bitslen == bitslen && wave->fchigh == fchigh && wave->fclow == fclow && wave->clk == clk) {
+        while (i < bitslen && wave->bits[i] == (bits[i] != 0)) {
+            i++;
+        }
+    } else {
+        wave->fchigh = fchigh;
+        wave->fclow = fclow;
+        wave->clk = clk;
+        wave->offset[0] = 0;
+        wave->remainder[0] = 0;
+    }
+
+    int n = wave->offset[i];
+    int16_t remainder = wave->remainder[i];
+    for (; i < bitslen; i++) {
+        wave->bits[i] = (bits[i] != 0);
+        fcAll(wave->bits[i] ? fchigh : fclow, &n, clk, &remainder);
+        wave->offset[i + 1] = n;
+        wave->remainder[i + 1] = remainder;
+    }
+    wave->bitslen = bitslen;
+    return n;
+}
+
 // prepare a waveform pattern in the buffer based on the ID given then
 // simulate a HID tag until the button is pressed
 void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles) {
+    CmdHIDsimTAGWave(NULL, hi2, hi, lo, longFMT, ledcontrol, numcycles);
+}
+
+// as CmdHIDsimTAGEx,  but only re-encodes the bit cells that changed since the last call with `wave`
+void CmdHIDsimTAGWave(lf_fsk_wave_t *wave, uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles) {
 
     /*
      HID tag bitstream format
@@ -1000,7 +1051,7 @@ void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, boo
         manchesterEncodeUint32(hi, 12, bits, &n);
         manchesterEncodeUint32(lo, 32, bits, &n);
     }
-    CmdFSKsimTAGEx(10, 8, 0, 50, bitlen, bits, ledcontrol, numcycles);
+    CmdFSKsimTAGWave(wave, 10, 8, 0, 50, bitlen, bits, ledcontrol, numcycles);
 }
 
 void CmdHIDsimTAG(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol) {
@@ -1012,12 +1063,25 @@ void CmdHIDsimTAG(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool
 // simulate a FSK tag until the button is pressed
 // arg1 contains fcHigh and fcLow, arg2 contains STT marker and clock
 void CmdFSKsimTAGEx(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk, uint16_t bitslen, const uint8_t *bits, bool ledcontrol, int numcycles) {
+    CmdFSKsimTAGWave(NULL, fchigh, fclow, separator, clk, bitslen, bits, ledcontrol, numcycles);
+}
+
+// wave == NULL composes the whole waveform,  else only the cells which changed since the last call
+int CmdFSKsimTAGWave(lf_fsk_wave_t *wave, uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk, uint16_t bitslen, const uint8_t *bits, bool ledcontrol, int numcycles) {
+
+    if (wave && bitslen > LF_FSK_WAVE_MAX_BITS)
+        wave = NULL;
+
+    // a bitstream download decompresses into BigBuf
+    if (wave && FpgaGetCurrent() != FPGA_BITSTREAM_LF)
+        wave->bitslen = 0;
 
     FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
 
     // free eventually allocated BigBuf memory
     BigBuf_free();
-    BigBuf_Clear_ext(false);
+    if (wave == NULL)
+        BigBuf_Clear_ext(false);
     clear_trace();
     set_tracing(false);
 
@@ -1028,20 +1092,26 @@ void CmdFSKsimTAGEx(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t cl
         //int fsktype = ( fchigh == 8 && fclow == 5) ? 1 : 2;
         //fcSTT(&n);
     }
-    for (i = 0; i < bitslen; i++) {
-        if (bits[i])
-            fcAll(fchigh, &n, clk, &remainder);
-        else
-            fcAll(fclow, &n, clk, &remainder);
+    if (wave) {
+        n = lf_fsk_wave_update(wave, fchigh, fclow, clk, bitslen, bits);
+    } else {
+        for (i = 0; i < bitslen; i++) {
+            if (bits[i])
+                fcAll(fchigh, &n, clk, &remainder);
+            else
+                fcAll(fclow, &n, clk, &remainder);
+        }
     }
 
     WDT_HIT();
 
-    Dbprintf("FSK simulating with rf/%d, fc high %d, fc low %d, STT %d, n %d", clk, fchigh, fclow, separator, n);
+    if (wave == NULL || g_dbglevel >= DBG_DEBUG)
+        Dbprintf("FSK simulating with rf/%d, fc high %d, fc low %d, STT %d, n %d", clk, fchigh, fclow, separator, n);
 
     if (ledcontrol) LED_A_ON();
-    SimulateTagLowFrequencyEx(n, 0, ledcontrol, numcycles);
+    int res = SimulateTagLowFrequencyEx(n, 0, ledcontrol, numcycles);
     if (ledcontrol) LED_A_OFF();
+    return res;
 }
 
 // prepare a waveform pattern in the buffer based on the ID given then
@@ -1107,12 +1177,9 @@ static void leadingZeroBiphaseSimBits(int *n, uint8_t clock, uint8_t *phase) {
 */
 
 
-// args clock, ask/man or askraw, invert, transmission separator
-void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t clk,
-                  uint16_t size, const uint8_t *bits, bool ledcontrol) {
-    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
-    set_tracing(false);
-
+// compose the ask waveform in BigBuf,  returns its length
+static int lf_ask_compose(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t clk,
+                          uint16_t size, const uint8_t *bits) {
     int n = 0, i = 0;
 
     if (encoding == 2) { //biphase
@@ -1149,6 +1216,17 @@ void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t c
     else if (separator == 1)
         Dbprintf("sorry but separator option not yet available");
 
+    return n;
+}
+
+// args clock, ask/man or askraw, invert, transmission separator
+void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t clk,
+                  uint16_t size, const uint8_t *bits, bool ledcontrol) {
+    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+    set_tracing(false);
+
+    int n = lf_ask_compose(encoding, invert, separator, clk, size, bits);
+
     WDT_HIT();
 
     Dbprintf("ASK simulating with rf/%d, invert %d, encoding %s (%d), separator %d, n %d"
@@ -1188,21 +1266,27 @@ static void pskSimBit(uint8_t waveLen, int *n, uint8_t clk, uint8_t *curPhase, b
     }
 }
 
-// args clock, carrier, invert,
-void CmdPSKsimTAG(uint8_t carrier, uint8_t invert, uint8_t clk, uint16_t size,
-                  const uint8_t *bits, bool ledcontrol) {
-    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
-    set_tracing(false);
-
-    int n = 0, i = 0;
+// compose the psk waveform in BigBuf,  returns its length
+static int lf_psk_compose(uint8_t carrier, uint8_t clk, uint16_t size, const uint8_t *bits) {
+    int n = 0;
     uint8_t curPhase = 0;
-    for (i = 0; i < size; i++) {
+    for (uint16_t i = 0; i < size; i++) {
         if (bits[i] == curPhase) {
             pskSimBit(carrier, &n, clk, &curPhase, false);
         } else {
             pskSimBit(carrier, &n, clk, &curPhase, true);
         }
     }
+    return n;
+}
+
+// args clock, carrier, invert,
+void CmdPSKsimTAG(uint8_t carrier, uint8_t invert, uint8_t clk, uint16_t size,
+                  const uint8_t *bits, bool ledcontrol) {
+    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+    set_tracing(false);
+
+    int n = lf_psk_compose(carrier, clk, size, bits);
 
     WDT_HIT();
 
@@ -1264,6 +1348,74 @@ void CmdNRZsimTAG(uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size,
     reply_ng(CMD_LF_NRZ_SIMULATE, PM3_EOPABORTED, NULL, 0);
 }
 
+// simulate a batch of candidates from a lf <tag> brute command, <dwell> ms each.
+// FSK candidates only re-encode the bit cells that differ from the previous one.
+// Replies with the number of candidates done,  PM3_EOPABORTED if button or usb stopped it
+void CmdLFSimBrute(const lf_simbrute_t *req, uint16_t len, bool ledcontrol) {
+
+    static lf_fsk_wave_t wave;
+    uint8_t bits[LF_SIM_BRUTE_MAX_BITS];
+    uint16_t bytes = (req->bitslen + 7) / 8;
+    uint8_t done = 0;
+
+    if (len < sizeof(lf_simbrute_t) || req->bitslen == 0 || req->bitslen > LF_SIM_BRUTE_MAX_BITS ||
+            req->count > LF_SIM_BRUTE_MAX_COUNT || len < sizeof(lf_simbrute_t) + req->count * bytes) {
+        reply_ng(CMD_LF_SIM_BRUTE, PM3_EINVARG, &done, sizeof(done));
+        return;
+    }
+
+    FpgaDownloadAndGo(FPGA_BITSTREAM_LF);
+    set_tracing(false);
+
+    // BigBuf was most likely used since the last batch
+    wave.bitslen = 0;
+
+    // one loop of SimulateTagLowFrequencyEx per carrier cycle,  ~125 per ms
+    int numcycles = req->dwell * 125;
+    int res = PM3_SUCCESS;
+
+    if (ledcontrol) LED_A_ON();
+
+    for (; done < req->count; done++) {
+
+        const uint8_t *src = req->data + done * bytes;
+        for (uint16_t i = 0; i < req->bitslen; i++) {
+            bits[i] = (src[i >> 3] >> (7 - (i & 7))) & 1;
+        }
+
+        int n;
+        switch (req->modulation) {
+            case LF_SIM_BRUTE_FSK:
+                res = CmdFSKsimTAGWave(&wave, req->fchigh, req->fclow, req->separator, req->clock, req->bitslen, bits, ledcontrol, numcycles);
+                break;
+            case LF_SIM_BRUTE_ASK:
+                n = lf_ask_compose(req->encoding, req->invert, req->separator, req->clock, req->bitslen, bits);
+                res = SimulateTagLowFrequencyEx(n, 0, ledcontrol, numcycles);
+                break;
+            case LF_SIM_BRUTE_PSK:
+                n = lf_psk_compose(req->carrier, req->clock, req->bitslen, bits);
+                res = SimulateTagLowFrequencyEx(n, 0, ledcontrol, numcycles);
+                break;
+            default:
+                res = PM3_EINVARG;
+                break;
+        }
+
+        if (res != PM3_SUCCESS) {
+            break;
+        }
+    }
+
+    // SimulateTagLowFrequencyEx leaves the field on after numcycles
+    if (res != PM3_EOPABORTED) {
+        StopTicks();
+        FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    }
+
+    if (ledcontrol) LEDsoff();
+    reply_ng(CMD_LF_SIM_BRUTE, res, &done, sizeof(done));
+}
+
 // loop to get raw HID waveform then FSK demodulate the TAG ID from it
 int lf_hid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol) {
 
@@ -1734,6 +1886,7 @@ static uint8_t T55xx_SetBits(uint8_t *bs, uint8_t start_offset, uint32_t data, u
 
 // Send one downlink command to the card
 static void T55xx_SendCMD(uint32_t data, uint32_t pwd, uint16_t arg) {
+    T55xx_Timing_ensure();
 
     /*
     arg bits
@@ -1869,6 +2022,7 @@ void T55xxResetRead(uint8_t flags, bool ledcontrol) {
 }
 
 void T55xxDangerousRawTest(const uint8_t *data, bool ledcontrol) {
+    T55xx_Timing_ensure();
     // supports only default downlink mode
     const t55xx_test_block_t *c = (const t55xx_test_block_t *)data;
 
@@ -2096,10 +2250,21 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
 }
 
 
-void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
-
 #define CHK_SAMPLES_SIGNAL 2048
 
+// signal energy of the last brute_mem read,  an answer differs from the baseline of a failed one
+static uint64_t T55xx_SignalEnergy(const uint8_t *buf) {
+    uint64_t sum = 0;
+    for (uint16_t j = 0; j < CHK_SAMPLES_SIGNAL; ++j) {
+        sum += (buf[j] * buf[j]);
+    }
+    sum *= sum;
+    sum >>= 8;
+    return sum;
+}
+
+void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
+
 #ifdef WITH_FLASH
     DbpString(_CYAN_("T55XX Check pwds using flashmemory starting"));
 #else
@@ -2116,13 +2281,8 @@ void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
     // collect baseline for failed attempt  ( should give me block1 )
     uint8_t x = 32;
     while (x--) {
-        b1 = 0;
         T55xxReadBlock(0, 0, true, 0, 0, downlink_mode, ledcontrol);
-        for (uint16_t j = 0; j < CHK_SAMPLES_SIGNAL; ++j) {
-            b1 += (buf[j] * buf[j]);
-        }
-        b1 *= b1;
-        b1 >>= 8;
+        b1 = T55xx_SignalEnergy(buf);
         baseline_faulty += b1;
     }
     baseline_faulty >>= 5;
@@ -2179,12 +2339,7 @@ void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
 
         T55xxReadBlock(0, true, true, 0, pwd, downlink_mode, ledcontrol);
 
-        uint64_t sum = 0;
-        for (uint16_t j = 0; j < CHK_SAMPLES_SIGNAL; ++j) {
-            sum += (buf[j] * buf[j]);
-        }
-        sum *= sum;
-        sum >>= 8;
+        uint64_t sum = T55xx_SignalEnergy(buf);
 
         int64_t tmp_dist = (baseline_faulty - sum);
         curr = ABS(tmp_dist);
@@ -2213,6 +2368,80 @@ OUT:
     BigBuf_free();
 }
 
+// Password range scan,  page 0 block 0 read with each password.
+// Same energy test as T55xx_ChkPwds,  but against a noise margin instead of the best of a
+// dictionary:  the baseline is 32 reads without password and a candidate has to be further
+// from its mean than twice the largest baseline deviation (plus 1/32 of the mean).
+// Candidates are only a preselection,  the client confirms each one with a full read and demod.
+// Stops early when the candidate list is full,  on button press or when the client sends anything.
+void T55xx_BruteForce(const t55xx_brute_req_t *req, bool ledcontrol) {
+
+    uint8_t *buf = BigBuf_get_addr();
+    uint8_t first_dl = req->flags & 0x03;
+    uint8_t last_dl = (req->flags & T55XX_BRUTE_ALL_DL) ? 3 : first_dl;
+
+    t55xx_brute_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    int res = PM3_SUCCESS;
+
+    uint64_t baseline[4] = {0}, margin[4] = {0};
+    for (uint8_t dl = first_dl; dl <= last_dl; dl++) {
+        uint64_t e[32];
+        uint64_t sum = 0;
+        for (uint8_t x = 0; x < ARRAYLEN(e); x++) {
+            T55xxReadBlock(0, 0, true, 0, 0, dl, ledcontrol);
+            e[x] = T55xx_SignalEnergy(buf);
+            sum += e[x];
+        }
+        baseline[dl] = sum / ARRAYLEN(e);
+
+        uint64_t dev = 0;
+        for (uint8_t x = 0; x < ARRAYLEN(e); x++) {
+            int64_t d = (int64_t)(e[x] - baseline[dl]);
+            dev = MAX(dev, (uint64_t)ABS(d));
+        }
+        margin[dl] = 2 * dev + (baseline[dl] >> 5);
+
+        if (g_dbglevel >= DBG_DEBUG)
+            Dbprintf("Downlink %u baseline " _YELLOW_("%llu") " margin " _YELLOW_("%llu"), dl, baseline[dl], margin[dl]);
+    }
+
+    for (uint32_t i = 0; i < req->count; i++) {
+
+        if ((i & 0x3F) == 0) {
+            WDT_HIT();
+            if (BUTTON_PRESS() || data_available()) {
+                res = PM3_EOPABORTED;
+                break;
+            }
+        }
+
+        uint32_t pwd = req->start_pwd + i;
+        for (uint8_t dl = first_dl; dl <= last_dl; dl++) {
+
+            T55xxReadBlock(0, true, true, 0, pwd, dl, ledcontrol);
+
+            int64_t d = (int64_t)(T55xx_SignalEnergy(buf) - baseline[dl]);
+            if ((uint64_t)ABS(d) > margin[dl]) {
+                resp.candidates[resp.n] = pwd;
+                resp.downlink[resp.n] = dl;
+                resp.n++;
+                break;
+            }
+        }
+        resp.tried = i + 1;
+
+        if (resp.n == T55XX_BRUTE_MAX_CANDIDATES) {
+            break;
+        }
+    }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+    reply_ng(CMD_LF_T55XX_BRUTE, res, (uint8_t *)&resp, sizeof(resp));
+    BigBuf_free();
+}
+
 void T55xxWakeUp(uint32_t pwd, uint8_t flags, bool ledcontrol) {
 
     flags |= 0x01 | 0x40 | 0x20; //Password | Read Call (no data) | reg_read no block
@@ -2629,20 +2858,45 @@ static void EM4xLoginEx(uint32_t pwd) {
     // 0000 0001 fail
 }
 
-void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool ledcontrol) {
+void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool resume, bool ledcontrol) {
     // With current timing, 18.6 ms per test = 53.8 pwds/s
     reply_ng(CMD_LF_EM4X_BF, PM3_SUCCESS, NULL, 0);
+
+    struct {
+        uint32_t start_pwd;
+        uint32_t n;
+    } PACKED args = { start_pwd, n };
+
+    bf_checkpoint_t cp;
+    if (resume && bf_checkpoint_load(BF_CP_EM4X05, &cp) == PM3_SUCCESS) {
+        memcpy(&args, cp.args, sizeof(args));
+        start_pwd = cp.gen.current_key;
+        n = args.n;
+        bf_checkpoint_print(&cp, "Resuming");
+    } else {
+        if (resume) {
+            Dbprintf("No EM4x05 brute checkpoint found");
+            return;
+        }
+        bf_checkpoint_init(&cp, BF_CP_EM4X05, &args, sizeof(args), 0xFFFFFFFF - start_pwd);
+        cp.gen.current_key = start_pwd;
+    }
+
     StartTicks();
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     WaitMS(20);
     if (ledcontrol) LED_A_ON();
     LFSetupFPGAForADC(LF_DIVISOR_125, true);
-    uint32_t candidates_found = 0;
+    uint32_t candidates_found = cp.found;
+    bool done = true;
     for (uint32_t pwd = start_pwd; pwd < 0xFFFFFFFF; pwd++) {
         if (((pwd - start_pwd) & 0x3F) == 0x00) {
             WDT_HIT();
             if (BUTTON_PRESS() || data_available()) {
                 Dbprintf("EM4x05 Bruteforce Interrupted");
+                bf_checkpoint_save(&cp);
+                bf_checkpoint_print(&cp, "Interrupted,");
+                done = false;
                 break;
             }
         }
@@ -2660,17 +2914,30 @@ void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool ledcontrol) {
         WaitUS(400);
         DoPartialAcquisition(0, false, 350, 1000, ledcontrol);
         uint8_t *mem = BigBuf_get_addr();
+
+        // next one to try,  so a resume continues right after this one
+        cp.gen.current_key = (uint64_t)pwd + 1;
+
         if (mem[334] < 128) {
             candidates_found++;
+            cp.found = candidates_found;
             Dbprintf("Password candidate: " _GREEN_("%08X"), pwd);
             if ((n != 0) && (candidates_found == n)) {
                 Dbprintf("EM4x05 Bruteforce Stopped. %i candidate%s found", candidates_found, candidates_found > 1 ? "s" : "");
                 break;
             }
         }
+
+        bf_checkpoint_tick(&cp);
+
         // Beware: if smaller, tag might not have time to be back in listening state yet
         WaitMS(1);
     }
+
+    if (done) {
+        bf_checkpoint_clear(BF_CP_EM4X05);
+    }
+
     StopTicks();
     FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
     if (ledcontrol) LEDsoff();
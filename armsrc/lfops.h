@@ -30,15 +30,33 @@ void WriteTItag(uint32_t idhi, uint32_t idlo, uint16_t crc, bool ledcontrol);
 
 void AcquireTiType(bool ledcontrol);
 void AcquireRawBitsTI(void);
-void SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles);
+int SimulateTagLowFrequencyEx(int period, int gap, bool ledcontrol, int numcycles);
 void SimulateTagLowFrequency(int period, int gap, bool ledcontrol);
 void SimulateTagLowFrequencyBidir(int divisor, int max_bitlen);
 
+// FSK waveform kept in BigBuf between simulations,  see lf_fsk_wave_update().
+// Set bitslen to 0 whenever BigBuf was used for something else.
+#define LF_FSK_WAVE_MAX_BITS (8 + 8 * 2 + 84 * 2)
+typedef struct {
+    uint8_t fchigh;
+    uint8_t fclow;
+    uint8_t clk;
+    uint16_t bitslen;                               // 0 = nothing composed yet
+    uint8_t bits[LF_FSK_WAVE_MAX_BITS];
+    uint16_t offset[LF_FSK_WAVE_MAX_BITS + 1];      // start of each bit cell,  offset[bitslen] = length
+    int16_t remainder[LF_FSK_WAVE_MAX_BITS + 1];    // fcAll() remainder at the start of each cell
+} lf_fsk_wave_t;
+
+int lf_fsk_wave_update(lf_fsk_wave_t *wave, uint8_t fchigh, uint8_t fclow, uint8_t clk, uint16_t bitslen, const uint8_t *bits);
+
+void CmdHIDsimTAGWave(lf_fsk_wave_t *wave, uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles);
 void CmdHIDsimTAGEx(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol, int numcycles);
 void CmdHIDsimTAG(uint32_t hi2, uint32_t hi, uint32_t lo, uint8_t longFMT, bool ledcontrol);
 
 void CmdFSKsimTAGEx(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk, uint16_t bitslen,
                     const uint8_t *bits, bool ledcontrol, int numcycles);
+int CmdFSKsimTAGWave(lf_fsk_wave_t *wave, uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk, uint16_t bitslen,
+                     const uint8_t *bits, bool ledcontrol, int numcycles);
 void CmdFSKsimTAG(uint8_t fchigh, uint8_t fclow, uint8_t separator, uint8_t clk, uint16_t bitslen,
                   const uint8_t *bits, bool ledcontrol);
 void CmdASKsimTAG(uint8_t encoding, uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size,
@@ -47,6 +65,7 @@ void CmdPSKsimTAG(uint8_t carrier, uint8_t invert, uint8_t clk, uint16_t size,
                   const uint8_t *bits, bool ledcontrol);
 void CmdNRZsimTAG(uint8_t invert, uint8_t separator, uint8_t clk, uint16_t size,
                   const uint8_t *bits, bool ledcontrol);
+void CmdLFSimBrute(const lf_simbrute_t *req, uint16_t len, bool ledcontrol);
 
 int lf_hid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol);
 int lf_awid_watch(int findone, uint32_t *high, uint32_t *low, bool ledcontrol); // Realtime demodulation mode for AWID26
@@ -66,13 +85,14 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
                     uint8_t downlink_mode, bool ledcontrol);
 void T55xxWakeUp(uint32_t pwd, uint8_t flags, bool ledcontrol);
 void T55xx_ChkPwds(uint8_t flags, bool ledcontrol);
+void T55xx_BruteForce(const t55xx_brute_req_t *req, bool ledcontrol);
 void T55xxDangerousRawTest(const uint8_t *data, bool ledcontrol);
 
 void turn_read_lf_on(uint32_t delay);
 void turn_read_lf_off(uint32_t delay);
 
 void EM4xLogin(uint32_t pwd, bool ledcontrol);
-void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool ledcontrol);
+void EM4xBruteforce(uint32_t start_pwd, uint32_t n, bool resume, bool ledcontrol);
 void EM4xReadWord(uint8_t addr, uint32_t pwd, uint8_t usepwd, bool ledcontrol);
 void EM4xWriteWord(uint8_t addr, uint32_t data, uint32_t pwd, uint8_t usepwd, bool ledcontrol);
 void EM4xProtectWord(uint32_t data, uint32_t pwd, uint8_t usepwd, bool ledcontrol);
@@ -28,6 +28,7 @@
 #include "string.h"  // memset
 #include "appmain.h" // print stack
 #include "usb_cdc.h" // real-time sampling
+#include "cmd.h"
 
 /*
 Default LF config is set to:
@@ -474,6 +475,9 @@ int ReadLF_realtime(bool reader_field) {
     bool trigger_hit = false;
     int16_t checked = 0;
 
+    // queued replies must be out before we start feeding the endpoint ourself
+    reply_tx_flush();
+
     return_value = async_usb_write_start();
     if (return_value != PM3_SUCCESS) {
         return return_value;
@@ -532,6 +536,7 @@ int ReadLF_realtime(bool reader_field) {
             if (samples.total_saved == size_threshold) {
                 // Request USB transmission and change FIFO bank
                 if (async_usb_write_requestWrite() == false) {
+                    async_usb_write_cancel();
                     return_value = PM3_EIO;
                     goto out;
                 }
@@ -32,6 +32,7 @@
 #include "util.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "crc32.h"
 #include "dbprint.h"
 #include "ticks.h"
 #include "usb_cdc.h"  // usb_poll_validate_length
@@ -44,6 +45,9 @@
 #ifndef HARDNESTED_PRE_AUTHENTICATION_LEADTIME
 # define HARDNESTED_PRE_AUTHENTICATION_LEADTIME 400 // some (non standard) cards need a pause after select before they are ready for first authentication
 #endif
+#ifndef HARDNESTED_FILTERED_BATCH_TIME
+# define HARDNESTED_FILTERED_BATCH_TIME 1500        // ms, a filtered batch fills slower, reply well before the client gives up
+#endif
 
 // send an incomplete dummy response in order to trigger the card's authentication failure timeout
 #ifndef CHK_TIMEOUT
@@ -249,6 +253,190 @@ void MifareReadSector(uint8_t sector_no, uint8_t key_type, uint8_t *key) {
     reply_old(CMD_ACK, retval == PM3_SUCCESS, 0, 0, outbuf, 16 * num_blocks);
 }
 
+// C1C2C3 of an access condition group,  0..2 data blocks,  3 sector trailer
+static uint8_t mf_readcard_acl(const uint8_t *trailer, uint8_t group) {
+    return (((trailer[7] >> (4 + group)) & 1) << 2) | (((trailer[8] >> group) & 1) << 1) | ((trailer[8] >> (4 + group)) & 1);
+}
+
+// could a read of this block succeed with the key type,  as long as the access conditions are unknown try it
+static bool mf_readcard_allowed(const uint8_t *trailer, uint8_t sector_no, uint8_t blk, uint8_t key_type) {
+    if (trailer == NULL) {
+        return true;
+    }
+
+    uint8_t blocks = NumBlocksPerSector(sector_no);
+    if (blk == blocks - 1) {
+        // the access bits of a trailer are readable with key A,  with key B only when it isn't readable data
+        uint8_t ac = mf_readcard_acl(trailer, 3);
+        return (key_type == MF_KEY_A) || (ac == 0x03) || (ac == 0x04) || (ac == 0x05) || (ac == 0x06) || (ac == 0x07);
+    }
+
+    uint8_t ac = mf_readcard_acl(trailer, (blocks == 4) ? blk : blk / 5);
+    if (ac == 0x07) {
+        return false;
+    }
+    return (key_type == MF_KEY_B) || ((ac != 0x03) && (ac != 0x05));
+}
+
+// authenticate,  nested inside the running session if there is one.  A failed auth or read halts the card,
+// only then a new select is needed.
+static bool mf_readcard_auth(struct Crypto1State *pcs, bool *session, bool *selected, uint8_t *uid, uint8_t cascade_levels, uint32_t cuid,
+                             uint8_t block_no, uint8_t key_type, uint64_t key) {
+    if (*session) {
+        if (mifare_classic_authex(pcs, cuid, block_no, key_type, key, AUTH_NESTED, NULL, NULL) == 0) {
+            return true;
+        }
+        *session = false;
+        return false;
+    }
+
+    crypto1_deinit(pcs);
+    if (*selected == false && iso14443a_fast_select_card(uid, cascade_levels) == 0) {
+        return false;
+    }
+    *selected = false;
+
+    if (mifare_classic_authex(pcs, cuid, block_no, key_type, key, AUTH_FIRST, NULL, NULL)) {
+        return false;
+    }
+    *session = true;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Select, Authenticate, Read a whole MIFARE Classic tag.
+// All sectors are read in one session,  every sector costs one nested auth per key used.  The card is only
+// selected again after an auth or read failure.  Sector trailers are read first,  so blocks the access
+// conditions deny for a key aren't tried and don't break the session.
+// Every sector is sent back as soon as it is read, the client writes its dump while the next one is read.
+//-----------------------------------------------------------------------------
+void MifareReadCard(uint8_t *datain) {
+    mf_readcard_t *req = (mf_readcard_t *)datain;
+    uint8_t sectorcnt = MIN(req->sectorcnt, MF_READCARD_MAX_SECTORS);
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs = &mpcs;
+
+    uint8_t uid[10] = {0};
+    uint32_t cuid = 0;
+    uint8_t cascade_levels = 0;
+    iso14a_card_select_t card_info;
+
+    LEDsoff();
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    int retval = PM3_SUCCESS;
+
+    if (iso14443a_select_card(uid, &card_info, &cuid, true, 0, true) == 0) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't select card");
+        retval = PM3_ECARDEXCHANGE;
+        goto OUT;
+    }
+    cascade_levels = (card_info.uidlen == 10) ? 3 : (card_info.uidlen == 7) ? 2 : 1;
+
+    // fresh out of the select,  the first auth still needs AUTH_FIRST
+    bool session = false;
+    bool selected = true;
+
+    uint32_t timeout = iso14a_get_timeout();
+
+    // frame waiting time (FWT) in 1/fc
+    uint32_t fwt = 256 * 16 * (1 << 7);
+    iso14a_set_timeout(fwt / (8 * 16));
+
+    mf_readcard_sector_t sector;
+
+    for (uint8_t s = 0; s < sectorcnt; s++) {
+
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        LED_B_ON();
+        memset(&sector, 0, sizeof(sector));
+        sector.sector = s;
+
+        uint8_t first = FirstBlockOfSector(s);
+        uint8_t blocks = NumBlocksPerSector(s);
+        uint8_t trailer = blocks - 1;
+        uint16_t todo = (blocks == 16) ? 0xFFFF : 0x000F;
+        bool have_acl = false;
+
+        for (uint8_t kt = MF_KEY_A; kt <= MF_KEY_B && todo; kt++) {
+
+            const uint8_t *known = (kt == MF_KEY_A) ? req->known_a : req->known_b;
+            if ((known[s / 8] & (1 << (s % 8))) == 0) {
+                continue;
+            }
+
+            uint64_t key = bytes_to_num(req->keys[s][kt], 6);
+            bool authed = false;
+
+            // trailer first for its access conditions,  then the data blocks
+            for (uint8_t i = 0; i < blocks && todo; i++) {
+                uint8_t b = (i == 0) ? trailer : i - 1;
+
+                if ((todo & (1 << b)) == 0) {
+                    continue;
+                }
+
+                if (mf_readcard_allowed(have_acl ? sector.data + (trailer * 16) : NULL, s, b, kt) == false) {
+                    continue;
+                }
+
+                if (authed == false) {
+                    authed = mf_readcard_auth(pcs, &session, &selected, uid, cascade_levels, cuid, first + trailer, kt, key);
+                    if (authed == false) {
+                        // retry once on a fresh select,  the session might just have been gone
+                        authed = mf_readcard_auth(pcs, &session, &selected, uid, cascade_levels, cuid, first + trailer, kt, key);
+                    }
+                    if (authed == false) {
+                        break;
+                    }
+                }
+
+                if (mifare_classic_readblock(pcs, first + b, sector.data + (b * 16))) {
+                    // the card halted,  the next block needs a new select and auth
+                    memset(sector.data + (b * 16), 0, 16);
+                    session = false;
+                    authed = false;
+                    continue;
+                }
+
+                todo &= ~(1 << b);
+                sector.blocks |= (1 << b);
+                if (b == trailer) {
+                    have_acl = true;
+                }
+            }
+        }
+
+        LED_B_OFF();
+        reply_ng(CMD_HF_MIFARE_READCARD, PM3_SUCCESS, (uint8_t *)&sector, sizeof(sector));
+    }
+
+    if (session) {
+        mifare_classic_halt(pcs);
+    }
+    iso14a_set_timeout(timeout);
+
+OUT:
+    crypto1_deinit(pcs);
+
+    // the final reply carries no sector,  only the status
+    reply_ng(CMD_HF_MIFARE_READCARD, retval, NULL, 0);
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+}
+
 void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes) {
 
     bool turnOffField = (arg0 == 1);
@@ -472,6 +660,144 @@ void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain)
     set_tracing(false);
 }
 
+// FAST_READ answers pages * 4 + CRC bytes,  that has to fit the 14a receive buffer
+#define MFU_FASTREAD_MAX_PAGES  ((MAX_FRAME_SIZE - 2) / 4)
+
+static int mfu_readcard_select(const mfu_readcard_t *req) {
+    if (iso14443a_select_card(NULL, NULL, NULL, true, 0, true) == 0) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't select card");
+        return PM3_ECARDEXCHANGE;
+    }
+
+    if (req->keytype == MFU_READCARD_KEY_ULC) {
+        uint8_t key[16] = {0x00};
+        memcpy(key, req->key, sizeof(key));
+        if (mifare_ultra_auth(key) == 0) {
+            return PM3_EWRONGANSWER;
+        }
+    } else if (req->keytype == MFU_READCARD_KEY_PWD) {
+        uint8_t pwd[4] = {0x00};
+        memcpy(pwd, req->key, sizeof(pwd));
+        uint8_t pack[4] = {0, 0, 0, 0};
+        if (mifare_ul_ev1_auth(pwd, pack) == 0) {
+            return PM3_EWRONGANSWER;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+static int mifare_ultra_fastread(uint8_t first, uint8_t count, uint8_t *out) {
+    uint8_t range[2] = {first, first + count - 1};
+    uint8_t resp[MAX_FRAME_SIZE] = {0x00};
+    uint8_t resp_par[MAX_PARITY_SIZE] = {0x00};
+
+    uint16_t len = mifare_sendcmd(MIFARE_ULEV1_FASTREAD, range, sizeof(range), resp, resp_par, NULL);
+    if (len != (count * 4) + 2) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("FAST_READ %d..%d error. len: %d", range[0], range[1], len);
+        return PM3_EWRONGANSWER;
+    }
+
+    if (CheckCrc14A(resp, len) == false) {
+        if (g_dbglevel >= DBG_ERROR) Dbprintf("FAST_READ CRC response error.");
+        return PM3_ECRC;
+    }
+
+    memcpy(out, resp, count * 4);
+    return PM3_SUCCESS;
+}
+
+// Dump with FAST_READ in frames as large as the receive buffer allows,  every frame goes
+// back to the client as soon as it is read.  A tag that doesn't take FAST_READ twice in a
+// row gets selected again and the rest is read with READ,  4 new pages per command
+void MifareUReadCardFast(const mfu_readcard_t *req) {
+    LEDsoff();
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    uint8_t buf[sizeof(mfu_readcard_chunk_t) + (MFU_FASTREAD_MAX_PAGES * 4)];
+    mfu_readcard_chunk_t *chunk = (mfu_readcard_chunk_t *)buf;
+    chunk->flags = 0;
+
+    uint16_t done = 0;
+    uint8_t fast_fails = (req->fast) ? 0 : 2;
+    bool partial = false;
+
+    int res = PM3_EINVARG;
+    if (req->pages > 0 && (req->start + req->pages) <= 0x100) {
+        res = mfu_readcard_select(req);
+    }
+
+    while (res == PM3_SUCCESS && done < req->pages && partial == false) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint8_t page = req->start + done;
+        uint8_t count = MIN(req->pages - done, MFU_FASTREAD_MAX_PAGES);
+
+        if (fast_fails < 2) {
+            if (mifare_ultra_fastread(page, count, chunk->data) != PM3_SUCCESS) {
+                // a NACK leaves the tag idle,  pick it up again before the next try
+                if (++fast_fails == 2) {
+                    chunk->flags |= MFU_READCARD_FALLBACK;
+                }
+                res = mfu_readcard_select(req);
+                continue;
+            }
+            fast_fails = 0;
+        } else {
+            uint8_t got = 0;
+            while (got < count) {
+                uint8_t block[16] = {0x00};
+                if (mifare_ultra_readblock(page + got, block)) {
+                    if (g_dbglevel >= DBG_ERROR) Dbprintf("Read block %d error", page + got);
+                    break;
+                }
+                // READ rolls over at the end of memory,  only keep the pages asked for
+                uint8_t n = MIN(4, count - got);
+                memcpy(chunk->data + (got * 4), block, n * 4);
+                got += n;
+            }
+
+            if (got == 0) {
+                // if no blocks read - error out,  else return what we got
+                if (done == 0) {
+                    res = PM3_EWRONGANSWER;
+                }
+                break;
+            }
+            partial = (got < count);
+            count = got;
+        }
+
+        chunk->page = page;
+        chunk->count = count;
+        reply_ng(CMD_HF_MIFAREU_READCARD_FAST, PM3_SUCCESS, buf, sizeof(mfu_readcard_chunk_t) + (count * 4));
+        done += count;
+    }
+
+    if (res == PM3_SUCCESS) {
+        mifare_ultra_halt();
+    }
+
+    if (g_dbglevel >= DBG_EXTENDED) Dbprintf("Pages read %d", done);
+
+    chunk->flags |= MFU_READCARD_DONE;
+    chunk->page = done;
+    chunk->count = 0;
+    reply_ng(CMD_HF_MIFAREU_READCARD_FAST, res, buf, sizeof(mfu_readcard_chunk_t));
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+}
+
 void MifareValue(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain) {
     // params
     uint8_t blockNo = arg0;
@@ -911,6 +1237,8 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
     bool initialize = flags & 0x0001;
     bool slow = flags & 0x0002;
     bool field_off = flags & 0x0004;
+    // bitmask of encrypted first bytes the client has no use for anymore
+    const uint8_t *skip_first_bytes = (flags & 0x0008) ? datain + 6 : NULL;
     bool have_uid = false;
 
     LED_A_ON();
@@ -928,6 +1256,7 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
 
     uint8_t prev_enc_nt[] = {0, 0, 0, 0};
     uint8_t prev_counter = 0;
+    uint32_t start_time = GetTickCount();
 
     for (uint16_t i = 0; i <= PM3_CMD_DATA_SIZE - 9;) {
 
@@ -938,6 +1267,11 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
             break;
         }
 
+        // return what we have, nonces go out in pairs
+        if (skip_first_bytes && (num_nonces % 2) == 0 && GetTickCount() - start_time > HARDNESTED_FILTERED_BATCH_TIME) {
+            break;
+        }
+
         if (have_uid == false) { // need a full select cycle to get the uid first
             iso14a_card_select_t card_info;
             if (iso14443a_select_card(uid, &card_info, &cuid, true, 0, true) == 0) {
@@ -985,18 +1319,6 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
             continue;
         }
 
-        num_nonces++;
-        if (num_nonces % 2) {
-            memcpy(buf + i, receivedAnswer, 4);
-            nt_par_enc = par_enc[0] & 0xf0;
-        } else {
-            nt_par_enc |= par_enc[0] >> 4;
-            memcpy(buf + i + 4, receivedAnswer, 4);
-            memcpy(buf + i + 8, &nt_par_enc, 1);
-            i += 9;
-        }
-
-
         if (prev_enc_nt[0] == receivedAnswer[0] &&
                 prev_enc_nt[1] == receivedAnswer[1] &&
                 prev_enc_nt[2] == receivedAnswer[2] &&
@@ -1016,6 +1338,21 @@ void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags,
             break;
         }
 
+        // still costs the authentication, but keeps the batch for nonces that add information
+        if (skip_first_bytes && (skip_first_bytes[receivedAnswer[0] >> 3] & (1 << (receivedAnswer[0] & 0x07)))) {
+            continue;
+        }
+
+        num_nonces++;
+        if (num_nonces % 2) {
+            memcpy(buf + i, receivedAnswer, 4);
+            nt_par_enc = par_enc[0] & 0xf0;
+        } else {
+            nt_par_enc |= par_enc[0] >> 4;
+            memcpy(buf + i + 4, receivedAnswer, 4);
+            memcpy(buf + i + 8, &nt_par_enc, 1);
+            i += 9;
+        }
     }
 
     LED_C_OFF();
@@ -1287,15 +1624,12 @@ void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8
     set_tracing(false);
 }
 
-void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, uint8_t *key) {
-
-    LEDsoff();
+// collects the encrypted nonces of the target sector,  which are predictable on static nonce cards
+static int MifareStaticCollect(uint8_t blockNo, uint8_t keyType, uint64_t ui64Key, uint8_t targetBlockNo, uint8_t targetKeyType, uint32_t *cuid, uint32_t *target_nt, uint32_t *target_ks) {
 
-    uint64_t ui64Key = bytes_to_num(key, 6);
     uint16_t len;
     uint8_t uid[10] = { 0x00 };
-    uint32_t cuid = 0, nt1 = 0, nt2 = 0, nt3 = 0;
-    uint32_t target_nt[2] = {0x00}, target_ks[2] = {0x00};
+    uint32_t nt1 = 0, nt2 = 0, nt3 = 0;
     uint8_t par[1] = { 0x00 };
     uint8_t receivedAnswer[10] = { 0x00 };
 
@@ -1303,15 +1637,6 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
     struct Crypto1State *pcs;
     pcs = &mpcs;
 
-    LED_A_ON();
-    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
-
-    // free eventually allocated BigBuf memory
-    BigBuf_free();
-    BigBuf_Clear_ext(false);
-    clear_trace();
-    set_tracing(true);
-
     int16_t isOK = PM3_ESOFT;
     LED_C_ON();
 
@@ -1322,12 +1647,12 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
             continue;
         }
 
-        if (iso14443a_select_card(uid, NULL, &cuid, true, 0, true) == false) {
+        if (iso14443a_select_card(uid, NULL, cuid, true, 0, true) == false) {
             continue;
         };
 
         // first collection
-        if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
+        if (mifare_classic_authex(pcs, *cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
             continue;
         };
 
@@ -1353,15 +1678,15 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
             continue;
         }
 
-        if (iso14443a_select_card(uid, NULL, &cuid, true, 0, true) == false) {
+        if (iso14443a_select_card(uid, NULL, cuid, true, 0, true) == false) {
             continue;
         };
 
-        if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
+        if (mifare_classic_authex(pcs, *cuid, blockNo, keyType, ui64Key, AUTH_FIRST, &nt1, NULL)) {
             continue;
         };
 
-        if (mifare_classic_authex(pcs, cuid, blockNo, keyType, ui64Key, AUTH_NESTED, NULL, NULL)) {
+        if (mifare_classic_authex(pcs, *cuid, blockNo, keyType, ui64Key, AUTH_NESTED, NULL, NULL)) {
             continue;
         };
 
@@ -1379,6 +1704,27 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
     LED_C_OFF();
 
     crypto1_deinit(pcs);
+    return isOK;
+}
+
+void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, uint8_t *key) {
+
+    LEDsoff();
+
+    uint64_t ui64Key = bytes_to_num(key, 6);
+    uint32_t cuid = 0;
+    uint32_t target_nt[2] = {0x00}, target_ks[2] = {0x00};
+
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    // free eventually allocated BigBuf memory
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+    clear_trace();
+    set_tracing(true);
+
+    int16_t isOK = MifareStaticCollect(blockNo, keyType, ui64Key, targetBlockNo, targetKeyType, &cuid, target_nt, target_ks);
 
     struct p {
         uint8_t block;
@@ -1405,32 +1751,149 @@ void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo,
     set_tracing(false);
 }
 
-//-----------------------------------------------------------------------------
-// MIFARE check keys. key count up to 85.
-//
-//-----------------------------------------------------------------------------
-typedef struct sector_t {
-    uint8_t keyA[6];
-    uint8_t keyB[6];
-} sector_t;
+/**
+ * @brief Static nested attack without the host.  The nonces of the target sector are predictable,  so every
+ * candidate key is tested against the collected keystream offline,  only matches get a real authentication.
+ * Usable from standalone modes,  ks is collected when MF_STATIC_CHK_KEYSTREAM isn't set and handed back
+ * for the next call.
+ *
+ * @return PM3_SUCCESS and the key in found,  PM3_ESOFT if no candidate matched
+ */
+int MifareStaticNestedKeys(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t targetBlockNo, uint8_t targetKeyType,
+                           uint8_t flags, mf_static_keystream_t *ks, const uint8_t *keys, uint16_t keycnt,
+                           uint64_t *found, uint16_t *survivors) {
 
-typedef struct chk_t {
-    uint64_t key;
-    uint32_t cuid;
-    uint8_t cl;
-    uint8_t block;
-    uint8_t keyType;
-    uint8_t *uid;
+    uint32_t cuid = 0;
+    uint32_t target_nt[2] = {0x00}, target_ks[2] = {0x00};
+
+    *survivors = 0;
+
+    if (flags & MF_STATIC_CHK_KEYSTREAM) {
+        cuid = bytes_to_num(ks->cuid, 4);
+        target_nt[0] = bytes_to_num(ks->nt_a, 4);
+        target_ks[0] = bytes_to_num(ks->ks_a, 4);
+        target_nt[1] = bytes_to_num(ks->nt_b, 4);
+        target_ks[1] = bytes_to_num(ks->ks_b, 4);
+    } else {
+        int res = MifareStaticCollect(blockNo, keyType, bytes_to_num(key, 6), targetBlockNo, targetKeyType, &cuid, target_nt, target_ks);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        num_to_bytes(cuid, 4, ks->cuid);
+        num_to_bytes(target_nt[0], 4, ks->nt_a);
+        num_to_bytes(target_ks[0], 4, ks->ks_a);
+        num_to_bytes(target_nt[1], 4, ks->nt_b);
+        num_to_bytes(target_ks[1], 4, ks->ks_b);
+    }
+
+    struct Crypto1State mpcs = { 0, 0 };
     struct Crypto1State *pcs;
-} chk_t;
+    pcs = &mpcs;
 
-// checks one key.
-// fast select,  tries 5 times to select
-//
-// return:
-//  2 = failed to select.
-//  1 = wrong key
-//  0 = correct key
+    uint8_t uid[10] = { 0x00 };
+    uint32_t cuid_sel = 0;
+
+    for (uint16_t i = 0; i < keycnt; i++) {
+
+        if ((i & 0x3F) == 0) {
+            WDT_HIT();
+            if (BUTTON_PRESS()) {
+                return PM3_EOPABORTED;
+            }
+        }
+
+        uint64_t candidate = bytes_to_num(keys + (i * 6), 6);
+
+        // the tag encrypts its nested nonce with the first keystream word
+        crypto1_init(pcs, candidate);
+        if (crypto1_word(pcs, cuid ^ target_nt[0], 0) != target_ks[0]) {
+            continue;
+        }
+
+        crypto1_init(pcs, candidate);
+        if (crypto1_word(pcs, cuid ^ target_nt[1], 0) != target_ks[1]) {
+            continue;
+        }
+
+        (*survivors)++;
+
+        // 64 bits of keystream leave false positives only on a broken nonce prediction
+        mifare_classic_halt(NULL);
+        if (iso14443a_select_card(uid, NULL, &cuid_sel, true, 0, true) == false) {
+            continue;
+        }
+
+        if (mifare_classic_authex(pcs, cuid_sel, targetBlockNo, targetKeyType, candidate, AUTH_FIRST, NULL, NULL) == 0) {
+            crypto1_deinit(pcs);
+            *found = candidate;
+            return PM3_SUCCESS;
+        }
+    }
+
+    crypto1_deinit(pcs);
+    return PM3_ESOFT;
+}
+
+void MifareStaticNestedChk(uint8_t *datain) {
+
+    mf_static_nested_chk_t *req = (mf_static_nested_chk_t *)datain;
+
+    mf_static_nested_chk_resp_t resp;
+    memset(&resp, 0x00, sizeof(resp));
+    memcpy(&resp.ks, &req->ks, sizeof(resp.ks));
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    BigBuf_free();
+    BigBuf_Clear_ext(false);
+    clear_trace();
+    set_tracing(false);
+
+    uint64_t key64 = 0;
+    int res = MifareStaticNestedKeys(req->block, req->keytype, req->key, req->target_block, req->target_keytype,
+                                     req->flags, &resp.ks, req->keys, MIN(req->keycnt, MF_STATIC_CHK_MAX_KEYS),
+                                     &key64, &resp.survivors);
+
+    if (res == PM3_SUCCESS) {
+        resp.found = true;
+        num_to_bytes(key64, 6, resp.key);
+    }
+
+    LED_B_ON();
+    reply_ng(CMD_HF_MIFARE_STATIC_NESTED_CHK, res, (uint8_t *)&resp, sizeof(resp));
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+}
+
+//-----------------------------------------------------------------------------
+// MIFARE check keys. key count up to 85.
+//
+//-----------------------------------------------------------------------------
+typedef struct sector_t {
+    uint8_t keyA[6];
+    uint8_t keyB[6];
+} sector_t;
+
+typedef struct chk_t {
+    uint64_t key;
+    uint32_t cuid;
+    uint8_t cl;
+    uint8_t block;
+    uint8_t keyType;
+    uint8_t *uid;
+    struct Crypto1State *pcs;
+} chk_t;
+
+// checks one key.
+// fast select,  tries 5 times to select
+//
+// return:
+//  2 = failed to select.
+//  1 = wrong key
+//  0 = correct key
 static uint8_t chkKey(struct chk_t *c) {
     uint8_t i = 0, res = 2;
     while (i < 5) {
@@ -1513,36 +1976,106 @@ static void chkKey_scanB(struct chk_t *c, struct sector_t *k_sector, uint8_t *fo
     }
 }
 
-// loop all A keys,
-// when A is found but not B,  try to read B.
-static void chkKey_loopBonly(struct chk_t *c, struct sector_t *k_sector, uint8_t *found, uint8_t *sectorcnt, uint8_t *foundkeys) {
+// a key that opened one sector is tried on every open sector, as key A and B.
+// With key A known, the sector trailer is read for key B where the access bits allow it,
+// each key B read that way is reused the same way.  Every distinct key is tried once.
+static void chkKey_reuse(struct chk_t *c, struct sector_t *k_sector, uint8_t *found, uint8_t *trailer_read, uint8_t *sectorcnt, uint8_t *foundkeys) {
 
-    // read Block B, if A is found.
-    for (uint8_t s = 0; s < *sectorcnt; ++s) {
+    uint8_t allkeys = *sectorcnt << 1;
+    uint64_t dict_key = c->key;
 
-        if (found[(s * 2)] && found[(s * 2) + 1])
-            continue;
+    // the found key and one key B per sector at most
+    uint64_t keys[MIFARE_4K_MAXSECTOR + 1];
+    uint8_t keycnt = 0;
+    keys[keycnt++] = c->key;
+
+    for (uint8_t k = 0; k < keycnt && *foundkeys != allkeys; k++) {
+
+        c->key = keys[k];
+        c->keyType = 0;
+        chkKey_scanA(c, k_sector, found, sectorcnt, foundkeys);
+        c->keyType = 1;
+        chkKey_scanB(c, k_sector, found, sectorcnt, foundkeys);
 
-        c->block = (FirstBlockOfSector(s) + NumBlocksPerSector(s) - 1);
+        // A but not B,  read B from the trailer.  Only once per sector, its key A doesn't change
+        for (uint8_t s = 0; s < *sectorcnt; s++) {
 
-        // A but not B
-        if (found[(s * 2)]  &&  !found[(s * 2) + 1]) {
+            if (found[(s * 2)] == 0 || found[(s * 2) + 1] || trailer_read[s])
+                continue;
+
+            trailer_read[s] = 1;
+
+            c->block = (FirstBlockOfSector(s) + NumBlocksPerSector(s) - 1);
             c->key = bytes_to_num(k_sector[s].keyA, 6);
-            uint8_t status = chkKey_readb(c, k_sector[s].keyB);
-            if (status == 0) {
-                found[(s * 2) + 1] = 1;
-                ++*foundkeys;
+            if (chkKey_readb(c, k_sector[s].keyB) != 0)
+                continue;
+
+            found[(s * 2) + 1] = 1;
+            ++*foundkeys;
 
-                if (g_dbglevel >= 3) Dbprintf("ChkKeys_fast: Reading B found (%d)", c->block);
+            if (g_dbglevel >= 3) Dbprintf("ChkKeys_fast: Reading B found (%d)", c->block);
 
-                // try quick find all B?
-                // assume: keys comes in groups. Find one B, test against all B.
-                c->key = bytes_to_num(k_sector[s].keyB, 6);
-                c->keyType = 1;
-                chkKey_scanB(c, k_sector, found, sectorcnt, foundkeys);
+            // assume: keys comes in groups.
+            uint64_t keyb = bytes_to_num(k_sector[s].keyB, 6);
+            bool seen = false;
+            for (uint8_t j = 0; j < keycnt; j++) {
+                if (keys[j] == keyb) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (seen == false && keycnt < ARRAYLEN(keys)) {
+                keys[keycnt++] = keyb;
             }
         }
     }
+
+    c->key = dict_key;
+}
+
+// pipelined mode,  the client sends key chunk N+1 while chunk N is being checked.
+// It is received into one of two BigBuf slots,  the other one may hold the keys in use.
+static PacketCommandNG *chk_fast_slots = NULL;
+static PacketCommandNG *chk_fast_current = NULL;
+static PacketCommandNG *chk_fast_next = NULL;
+static uint32_t chk_fast_next_arg[3];
+
+// should the check of the current key chunk stop
+static bool chkKeys_fast_abort(bool pipelined) {
+    if (BUTTON_PRESS()) {
+        return true;
+    }
+
+    if (data_available() == false) {
+        return false;
+    }
+
+    if (pipelined == false) {
+        return true;
+    }
+
+    // one chunk in reserve is enough,  the client waits for a reply before sending another one
+    if (chk_fast_next != NULL) {
+        return false;
+    }
+
+    PacketCommandNG *slot = (chk_fast_current == &chk_fast_slots[0]) ? &chk_fast_slots[1] : &chk_fast_slots[0];
+    int res = receive_ng(slot);
+    if (res == PM3_ENODATA) {
+        return false;
+    }
+
+    if (res == PM3_SUCCESS && slot->cmd == CMD_HF_MIFARE_CHKKEYS_FAST) {
+        // the slot content doesn't survive the BigBuf_free of a final reply,  keep the arguments
+        chk_fast_next_arg[0] = slot->oldarg[0];
+        chk_fast_next_arg[1] = slot->oldarg[1];
+        chk_fast_next_arg[2] = slot->oldarg[2];
+        chk_fast_next = slot;
+        return false;
+    }
+
+    // anything else stops the check,  same as in the plain mode
+    return true;
 }
 
 // get Chunks of keys, to test authentication against card.
@@ -1551,7 +2084,8 @@ static void chkKey_loopBonly(struct chk_t *c, struct sector_t *k_sector, uint8_t
 // arg1 = clear trace
 // arg2 = antal nycklar i keychunk
 // datain = keys as array
-void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain) {
+// returns false once there is nothing left to check for the following chunks
+static bool chkKeys_fast_chunk(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain) {
 
     // first call or
     uint8_t sectorcnt = arg0 & 0xFF; // 16;
@@ -1559,8 +2093,10 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     uint8_t lastchunk = (arg0 >> 12) & 0xF;
     uint8_t strategy = arg1 & 0xFF;
     uint8_t use_flashmem = (arg1 >> 8) & 0xFF;
+    bool pipelined = (arg1 & MF_CHKKEYS_FAST_PIPELINED) && (use_flashmem == 0);
     uint16_t keyCount = arg2 & 0xFF;
     uint8_t status = 0;
+    bool aborted = false;
 
     struct Crypto1State mpcs = {0, 0};
     struct Crypto1State *pcs;
@@ -1574,6 +2110,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
     static uint8_t foundkeys = 0;
     static sector_t k_sector[80];
     static uint8_t found[80];
+    static uint8_t trailer_read[MIFARE_4K_MAXSECTOR];
     static uint8_t *uid;
 
     int oldbg = g_dbglevel;
@@ -1615,6 +2152,13 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
             goto OUT;
     }
 
+    if (pipelined && (chk_fast_slots == NULL || (firstchunk && chk_fast_current == NULL))) {
+        chk_fast_slots = (PacketCommandNG *)BigBuf_malloc(2 * sizeof(PacketCommandNG));
+    }
+    if (chk_fast_slots == NULL) {
+        pipelined = false;
+    }
+
     iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
 
     LEDsoff();
@@ -1626,6 +2170,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
 
         memset(k_sector, 0x00, 480 + 10);
         memset(found, 0x00, sizeof(found));
+        memset(trailer_read, 0x00, sizeof(trailer_read));
         foundkeys = 0;
 
         iso14a_card_select_t card_info;
@@ -1678,7 +2223,8 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
             for (uint16_t i = s_point; i < keyCount; ++i) {
 
                 // Allow button press / usb cmd to interrupt device
-                if (BUTTON_PRESS() || data_available()) {
+                if (chkKeys_fast_abort(pipelined)) {
+                    aborted = true;
                     goto OUT;
                 }
 
@@ -1703,13 +2249,8 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
                         found[(s * 2)] = 1;
                         ++foundkeys;
 
-                        chkKey_scanA(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
-
-                        // read Block B, if A is found.
-                        chkKey_loopBonly(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
-
-                        chk_data.keyType = 1;
-                        chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
+                        // try it everywhere and read B keys before going on with the dictionary
+                        chkKey_reuse(&chk_data, k_sector, found, trailer_read, &sectorcnt, &foundkeys);
 
                         chk_data.keyType = 0;
                         chk_data.block = FirstBlockOfSector(s);
@@ -1735,7 +2276,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
                         found[(s * 2) + 1] = 1;
                         ++foundkeys;
 
-                        chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
+                        chkKey_reuse(&chk_data, k_sector, found, trailer_read, &sectorcnt, &foundkeys);
 
                         if (use_flashmem) {
                             if (lastpos != i && lastpos != 0) {
@@ -1770,7 +2311,10 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
         for (uint16_t i = 0; i < keyCount; i++) {
 
             // Allow button press / usb cmd to interrupt device
-            if (BUTTON_PRESS() || data_available()) break;
+            if (chkKeys_fast_abort(pipelined)) {
+                aborted = true;
+                break;
+            }
 
             // found all keys?
             if (foundkeys == allkeys)
@@ -1803,10 +2347,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
                         found[(s * 2)] = 1;
                         ++foundkeys;
 
-                        chkKey_scanA(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
-
-                        // read Block B, if A is found.
-                        chkKey_loopBonly(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
+                        chkKey_reuse(&chk_data, k_sector, found, trailer_read, &sectorcnt, &foundkeys);
 
                         chk_data.block = FirstBlockOfSector(s);
                     }
@@ -1821,7 +2362,7 @@ void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *da
                         found[(s * 2) + 1] = 1;
                         ++foundkeys;
 
-                        chkKey_scanB(&chk_data, k_sector, found, &sectorcnt, &foundkeys);
+                        chkKey_reuse(&chk_data, k_sector, found, trailer_read, &sectorcnt, &foundkeys);
                     }
                 }
             } // end loop sectors
@@ -1852,12 +2393,14 @@ OUT:
         tmp[488] = bar & 0xFF;
         tmp[489] = bar >> 8 & 0xFF;
 
-        reply_old(CMD_ACK, foundkeys, 0, 0, tmp, 480 + 10);
+        // arg1 tells the client the firmware takes pipelined chunks
+        reply_old(CMD_ACK, foundkeys, pipelined, 0, tmp, 480 + 10);
 
         set_tracing(false);
         FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
         BigBuf_free();
         BigBuf_Clear_ext(false);
+        chk_fast_slots = NULL;
 
         // special trick ecfill
         if (use_flashmem && foundkeys == allkeys) {
@@ -1885,10 +2428,29 @@ OUT:
         }
     } else {
         // partial/none keys found
-        reply_mix(CMD_ACK, foundkeys, 0, 0, 0, 0);
+        reply_mix(CMD_ACK, foundkeys, pipelined, 0, 0, 0);
     }
 
     g_dbglevel = oldbg;
+    return (foundkeys != allkeys && lastchunk == 0 && aborted == false);
+}
+
+void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain) {
+    chk_fast_current = NULL;
+    chk_fast_next = NULL;
+
+    bool more = chkKeys_fast_chunk(arg0, arg1, arg2, datain);
+
+    // the client sent the next chunk while the last one was being checked
+    while (chk_fast_next != NULL) {
+        chk_fast_current = chk_fast_next;
+        chk_fast_next = NULL;
+
+        // every chunk gets its reply,  once there is nothing left to check it's answered as an empty chunk
+        uint32_t keys = more ? chk_fast_next_arg[2] : 0;
+        more = chkKeys_fast_chunk(chk_fast_next_arg[0], chk_fast_next_arg[1], keys, chk_fast_current->data.asBytes);
+    }
+    chk_fast_current = NULL;
 }
 
 void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem) {
@@ -1994,6 +2556,156 @@ void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem) {
     g_dbglevel = oldbg;
 }
 
+// streamed key check.  The client keeps the next key chunk in flight, it's received into a BigBuf
+// slot while the current one is checked, so the card sees authentication attempts back-to-back.
+// Every chunk gets its reply.  A hit ends the stream, chunks still on their way are answered unchecked.
+static bool chk_stream_done = false;
+
+void MifareChkKeys_stream(uint8_t *datain) {
+
+    struct {
+        uint8_t key[6];
+        bool found;
+    } PACKED keyresult, nokey;
+    memset(&keyresult, 0x00, sizeof(keyresult));
+    memset(&nokey, 0x00, sizeof(nokey));
+
+    mf_chkkeys_stream_t *chunk = (mf_chkkeys_stream_t *)datain;
+
+    if (chunk->flags & MF_CHKKEYS_STREAM_FIRST)
+        chk_stream_done = false;
+
+    // leftovers of a stream which already had its hit
+    if (chk_stream_done) {
+        reply_ng(CMD_HF_MIFARE_CHKKEYS_STREAM, PM3_SUCCESS, (uint8_t *)&nokey, sizeof(nokey));
+        return;
+    }
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+
+    PacketCommandNG *slots = (PacketCommandNG *)BigBuf_malloc(2 * sizeof(PacketCommandNG));
+    PacketCommandNG *next = NULL;
+    uint8_t slot = 0;
+
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs;
+    pcs = &mpcs;
+
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0;
+    uint8_t cascade_levels = 0;
+    bool have_uid = false;
+    int status = PM3_SUCCESS;
+
+    LEDsoff();
+    LED_A_ON();
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    if (chunk->flags & MF_CHKKEYS_STREAM_CLEARTRACE)
+        clear_trace();
+
+    int oldbg = g_dbglevel;
+    g_dbglevel = DBG_NONE;
+
+    set_tracing(false);
+
+    while (chunk != NULL) {
+
+        uint8_t key_count = MIN(chunk->keycnt, MF_CHKKEYS_STREAM_MAX_KEYS);
+
+        for (uint8_t i = 0; i < key_count; i++) {
+
+            WDT_HIT();
+
+            if (BUTTON_PRESS()) {
+                status = PM3_EOPABORTED;
+                break;
+            }
+
+            // stage the next chunk,  any other command stops the stream
+            if (next == NULL && data_available()) {
+                if (slots == NULL) {
+                    status = PM3_EOPABORTED;
+                    break;
+                }
+
+                int res = receive_ng(&slots[slot]);
+                if (res == PM3_SUCCESS && slots[slot].cmd == CMD_HF_MIFARE_CHKKEYS_STREAM) {
+                    next = &slots[slot];
+                    slot ^= 1;
+                } else if (res != PM3_ENODATA) {
+                    status = PM3_EOPABORTED;
+                    break;
+                }
+            }
+
+            if (have_uid == false) { // need a full select cycle to get the uid first
+                iso14a_card_select_t card_info;
+                if (iso14443a_select_card(uid, &card_info, &cuid, true, 0, true) == false) {
+                    --i; // try same key once again
+                    continue;
+                }
+                switch (card_info.uidlen) {
+                    case 4 :
+                        cascade_levels = 1;
+                        break;
+                    case 7 :
+                        cascade_levels = 2;
+                        break;
+                    case 10:
+                        cascade_levels = 3;
+                        break;
+                    default:
+                        break;
+                }
+                have_uid = true;
+            } else { // no need for anticollision. We can directly select the card
+                if (iso14443a_select_card(uid, NULL, NULL, false, cascade_levels, true) == false) {
+                    --i; // try same key once again
+                    continue;
+                }
+            }
+
+            uint64_t key = bytes_to_num(chunk->keys + i * 6, 6);
+            if (mifare_classic_auth(pcs, cuid, chunk->blockno, chunk->keytype, key, AUTH_FIRST)) {
+                continue;
+            }
+
+            memcpy(keyresult.key, chunk->keys + i * 6, 6);
+            keyresult.found = true;
+            break;
+        }
+
+        reply_ng(CMD_HF_MIFARE_CHKKEYS_STREAM, status, (uint8_t *)&keyresult, sizeof(keyresult));
+
+        // hit or abort,  the staged chunk is answered unchecked and so are those still on their way
+        if (keyresult.found || status != PM3_SUCCESS) {
+            chk_stream_done = true;
+            if (next != NULL) {
+                reply_ng(CMD_HF_MIFARE_CHKKEYS_STREAM, status, (uint8_t *)&nokey, sizeof(nokey));
+            }
+            break;
+        }
+
+        if (chunk->flags & MF_CHKKEYS_STREAM_LAST)
+            break;
+
+        // nothing staged,  the client has no more chunks in flight
+        chunk = (next != NULL) ? (mf_chkkeys_stream_t *)next->data.asBytes : NULL;
+        next = NULL;
+    }
+
+    LED_B_ON();
+    crypto1_deinit(pcs);
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+    BigBuf_free_keep_EM();
+    g_dbglevel = oldbg;
+}
+
 void MifareChkKeys_file(uint8_t *fn) {
 
 #ifdef WITH_FLASH
@@ -2109,6 +2821,278 @@ void MifareEMemGet(uint8_t blockno, uint8_t blockcnt) {
     BigBuf_free_keep_EM();
 }
 
+// staging state for CMD_HF_MIFARE_EML_LOAD_BULK
+static uint8_t *eml_bulk_buf = NULL;
+static uint16_t eml_bulk_len = 0;
+static int eml_bulk_mark = -1;
+static int eml_bulk_status = PM3_SUCCESS;
+
+// the staging buffer is gone if something freed BigBuf between our frames
+static bool eml_bulk_valid(void) {
+    return (eml_bulk_buf != NULL) && (BigBuf_get_addr() + BigBuf_get_hi() <= eml_bulk_buf);
+}
+
+static void eml_bulk_drop(void) {
+    if (eml_bulk_valid()) {
+        BigBuf_release(eml_bulk_mark);
+    }
+    eml_bulk_buf = NULL;
+    eml_bulk_len = 0;
+}
+
+// BEGIN and DATA frames of a bulk image,  shared by the emulator and magic card loads
+static void mf_bulk_stage(const eml_bulk_t *req, uint16_t len) {
+
+    switch (req->phase) {
+        case EML_BULK_BEGIN: {
+            eml_bulk_drop();
+            eml_bulk_status = PM3_SUCCESS;
+
+            if (req->length == 0 || req->length > CARD_MEMORY_SIZE) {
+                eml_bulk_status = PM3_EINVARG;
+                break;
+            }
+
+            // make sure the emulator memory exists before the staging buffer is taken below it
+            BigBuf_get_EM_addr();
+
+            eml_bulk_mark = BigBuf_mark("eml bulk");
+            eml_bulk_buf = BigBuf_malloc(req->length);
+            if (eml_bulk_buf == NULL) {
+                BigBuf_release(eml_bulk_mark);
+                eml_bulk_status = PM3_EMALLOC;
+                break;
+            }
+            eml_bulk_len = req->length;
+            break;
+        }
+        case EML_BULK_DATA: {
+            if (eml_bulk_status != PM3_SUCCESS) {
+                break;
+            }
+            if (eml_bulk_valid() == false) {
+                eml_bulk_status = PM3_EOPABORTED;
+                break;
+            }
+            if ((len - sizeof(eml_bulk_t)) < req->length || (req->offset + req->length) > eml_bulk_len) {
+                eml_bulk_status = PM3_EOUTOFBOUND;
+                break;
+            }
+            memcpy(eml_bulk_buf + req->offset, req->data, req->length);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// COMMIT frame,  PM3_SUCCESS when the staged image is complete and its CRC32 matches
+static int mf_bulk_check(const eml_bulk_t *req) {
+    int res = eml_bulk_status;
+    if (res == PM3_SUCCESS && eml_bulk_valid() == false) {
+        res = PM3_EOPABORTED;
+    }
+    if (res == PM3_SUCCESS && req->length != eml_bulk_len) {
+        res = PM3_ELENGTH;
+    }
+    if (res == PM3_SUCCESS) {
+        uint8_t crc[4] = {0};
+        crc32_ex(eml_bulk_buf, eml_bulk_len, crc);
+        if (memcmp(crc, req->crc, sizeof(crc)) != 0) {
+            res = PM3_ECRC;
+        }
+    }
+    return res;
+}
+
+void MifareEMemLoadBulk(const eml_bulk_t *req, uint16_t len) {
+
+    if (len < sizeof(eml_bulk_t)) {
+        return;
+    }
+
+    if (req->phase != EML_BULK_COMMIT) {
+        mf_bulk_stage(req, len);
+        return;
+    }
+
+    int res = mf_bulk_check(req);
+    if (res == PM3_SUCCESS) {
+        FpgaDownloadAndGo(FPGA_BITSTREAM_HF);
+        emlSet(eml_bulk_buf, 0, eml_bulk_len);
+    }
+
+    eml_bulk_drop();
+    reply_ng(CMD_HF_MIFARE_EML_LOAD_BULK, res, NULL, 0);
+}
+
+// gen1a backdoor,  falls back to gen1b when the second wakeup isn't answered
+static bool mf_gen1a_wakeup(uint8_t *rx, uint8_t *rxpar) {
+    ReaderTransmitBitsPar(wupC1, 7, NULL, NULL);
+    if (ReaderReceive(rx, rxpar) == 0 || rx[0] != 0x0a) {
+        return false;
+    }
+
+    ReaderTransmit(wupC2, sizeof(wupC2), NULL);
+    if (ReaderReceive(rx, rxpar) == 0 || rx[0] != 0x0a) {
+        if (g_dbglevel >= DBG_INFO) Dbprintf("Assuming Magic Gen 1B tag. [wupC2 failed]");
+        ReaderTransmitBitsPar(wupC1, 7, NULL, NULL);
+        return (ReaderReceive(rx, rxpar) != 0 && rx[0] == 0x0a);
+    }
+    return true;
+}
+
+static bool mf_gen1a_write(uint8_t blockno, const uint8_t *data, uint8_t *rx, uint8_t *rxpar) {
+    if ((mifare_sendcmd_short(NULL, CRYPT_NONE, ISO14443A_CMD_WRITEBLOCK, blockno, rx, rxpar, NULL) != 1) || (rx[0] != 0x0a)) {
+        return false;
+    }
+
+    uint8_t frame[MIFARE_BLOCK_SIZE + 2];
+    memcpy(frame, data, MIFARE_BLOCK_SIZE);
+    AddCrc14A(frame, MIFARE_BLOCK_SIZE);
+    ReaderTransmit(frame, sizeof(frame), NULL);
+    return (ReaderReceive(rx, rxpar) == 1) && (rx[0] == 0x0a);
+}
+
+static bool mf_gen1a_read(uint8_t blockno, uint8_t *rx, uint8_t *rxpar) {
+    return (mifare_sendcmd_short(NULL, CRYPT_NONE, ISO14443A_CMD_READBLOCK, blockno, rx, rxpar, NULL) == MAX_MIFARE_FRAME_SIZE);
+}
+
+static bool mf_gen4_write(const uint8_t *pwd, uint8_t blockno, const uint8_t *data, uint8_t *rx, uint8_t *rxpar) {
+    uint8_t cmd[7 + MIFARE_BLOCK_SIZE + 2] = { GEN_4GTU_CMD, 0x00, 0x00, 0x00, 0x00, GEN_4GTU_WRITE, blockno };
+    memcpy(cmd + 1, pwd, 4);
+    memcpy(cmd + 7, data, MIFARE_BLOCK_SIZE);
+    AddCrc14A(cmd, sizeof(cmd) - 2);
+
+    ReaderTransmit(cmd, sizeof(cmd), NULL);
+    return (ReaderReceive(rx, rxpar) == 4) && (memcmp(rx, "\x90\x00\xfd\x07", 4) == 0);
+}
+
+static bool mf_gen4_read(const uint8_t *pwd, uint8_t blockno, uint8_t *rx, uint8_t *rxpar) {
+    uint8_t cmd[] = { GEN_4GTU_CMD, 0x00, 0x00, 0x00, 0x00, GEN_4GTU_READ, blockno, 0x00, 0x00 };
+    memcpy(cmd + 1, pwd, 4);
+    AddCrc14A(cmd, sizeof(cmd) - 2);
+
+    ReaderTransmit(cmd, sizeof(cmd), NULL);
+    return (ReaderReceive(rx, rxpar) == MAX_MIFARE_FRAME_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+// Write a staged image to a gen1a or gen4 GTU card,  all blocks in one session
+// and then read back in a second pass over the same session
+//-----------------------------------------------------------------------------
+void MifareMagicLoadBulk(const eml_bulk_t *req, uint16_t len) {
+
+    if (len < sizeof(eml_bulk_t)) {
+        return;
+    }
+
+    if (req->phase != EML_BULK_COMMIT) {
+        mf_bulk_stage(req, len);
+        return;
+    }
+
+    mf_magic_bulk_resp_t resp = {0};
+    const mf_magic_bulk_t *cfg = (const mf_magic_bulk_t *)req->data;
+
+    int res = mf_bulk_check(req);
+    if (res == PM3_SUCCESS && len < sizeof(eml_bulk_t) + sizeof(mf_magic_bulk_t)) {
+        res = PM3_EINVARG;
+    }
+    if (res == PM3_SUCCESS && (cfg->start > cfg->end || cfg->end > UINT8_MAX || (cfg->end + 1) * MIFARE_BLOCK_SIZE > eml_bulk_len)) {
+        res = PM3_EOUTOFBOUND;
+    }
+    if (res != PM3_SUCCESS) {
+        eml_bulk_drop();
+        reply_ng(CMD_HF_MIFARE_MAGIC_LOAD_BULK, res, (uint8_t *)&resp, sizeof(resp));
+        return;
+    }
+
+    uint8_t rx[MAX_MIFARE_FRAME_SIZE] = {0x00};
+    uint8_t rxpar[MAX_MIFARE_PARITY_SIZE] = {0x00};
+
+    LEDsoff();
+    LED_A_ON();
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    clear_trace();
+    set_tracing(true);
+
+    // magic cards are slow,  gen4 writes are still slower
+    uint32_t timeout = iso14a_get_timeout();
+    if (cfg->type == MF_MAGIC_BULK_GEN4) {
+        iso14a_set_timeout(13560000 / 1000 / (8 * 16) * 1000); // 2 seconds timeout
+    } else {
+        iso14a_set_timeout((256 * 16 * (1 << 7)) / (8 * 16));
+    }
+
+    bool session;
+    switch (cfg->type) {
+        case MF_MAGIC_BULK_GEN1A:
+            session = mf_gen1a_wakeup(rx, rxpar);
+            break;
+        case MF_MAGIC_BULK_GEN4:
+            session = iso14443a_select_card(NULL, NULL, NULL, true, 0, true);
+            break;
+        default:
+            res = PM3_EINVARG;
+            session = false;
+            break;
+    }
+
+    if (session == false) {
+        if (res == PM3_SUCCESS) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't open magic session");
+            res = PM3_ECARDEXCHANGE;
+        }
+        goto OUT;
+    }
+
+    LED_B_ON();
+    for (uint16_t blockno = cfg->start; blockno <= cfg->end; blockno++) {
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            goto OUT;
+        }
+
+        const uint8_t *data = eml_bulk_buf + blockno * MIFARE_BLOCK_SIZE;
+        bool ok = (cfg->type == MF_MAGIC_BULK_GEN1A) ? mf_gen1a_write(blockno, data, rx, rxpar) : mf_gen4_write(cfg->pwd, blockno, data, rx, rxpar);
+        if (ok == false) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("write block %u error", blockno);
+            resp.block = blockno;
+            res = PM3_ESOFT;
+            goto OUT;
+        }
+        resp.written++;
+    }
+    LED_B_OFF();
+
+    LED_C_ON();
+    for (uint16_t blockno = cfg->start; blockno <= cfg->end; blockno++) {
+        WDT_HIT();
+
+        bool ok = (cfg->type == MF_MAGIC_BULK_GEN1A) ? mf_gen1a_read(blockno, rx, rxpar) : mf_gen4_read(cfg->pwd, blockno, rx, rxpar);
+        if (ok == false || memcmp(rx, eml_bulk_buf + blockno * MIFARE_BLOCK_SIZE, MIFARE_BLOCK_SIZE) != 0) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("verify block %u error", blockno);
+            resp.block = blockno;
+            res = PM3_EFAILED;
+            goto OUT;
+        }
+        resp.verified++;
+    }
+
+    if (cfg->type == MF_MAGIC_BULK_GEN1A) {
+        mifare_classic_halt(NULL);
+    }
+
+OUT:
+    iso14a_set_timeout(timeout);
+    eml_bulk_drop();
+    reply_ng(CMD_HF_MIFARE_MAGIC_LOAD_BULK, res, (uint8_t *)&resp, sizeof(resp));
+    OnSuccessMagic();
+}
+
 //-----------------------------------------------------------------------------
 // Load a card into the emulator memory
 //
@@ -23,6 +23,7 @@
 int16_t mifare_cmd_readblocks(MifareWakeupType wakeup, uint8_t key_auth_cmd, uint8_t *key, uint8_t read_cmd, uint8_t block_no, uint8_t count, uint8_t *block_data);
 int16_t mifare_cmd_writeblocks(MifareWakeupType wakeup, uint8_t key_auth_cmd, uint8_t *key, uint8_t write_cmd, uint8_t block_no, uint8_t count, uint8_t *block_data);
 void MifareReadSector(uint8_t sector_no, uint8_t key_type, uint8_t *key);
+void MifareReadCard(uint8_t *datain);
 void MifareValue(uint8_t arg0, uint8_t arg1, uint8_t arg2, uint8_t *datain);
 
 void MifareUReadBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
@@ -30,20 +31,27 @@ void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes);
 void MifareUL_AES_Auth(bool turn_off_field, uint8_t keyno, uint8_t *keybytes);
 
 void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain);
+void MifareUReadCardFast(const mfu_readcard_t *req);
 void MifareUWriteBlockCompat(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 void MifareUWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 
 void MifareNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, bool calibrate, uint8_t *key);
 void MifareStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t targetBlockNo, uint8_t targetKeyType, uint8_t *key);
+void MifareStaticNestedChk(uint8_t *datain);
+int MifareStaticNestedKeys(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t targetBlockNo, uint8_t targetKeyType,
+                           uint8_t flags, mf_static_keystream_t *ks, const uint8_t *keys, uint16_t keycnt,
+                           uint64_t *found, uint16_t *survivors);
 
 void MifareAcquireEncryptedNonces(uint32_t arg0, uint32_t arg1, uint32_t flags, uint8_t *datain);
 void MifareAcquireNonces(uint32_t arg0, uint32_t flags);
 void MifareChkKeys(uint8_t *datain, uint8_t reserved_mem);
+void MifareChkKeys_stream(uint8_t *datain);
 void MifareChkKeys_fast(uint32_t arg0, uint32_t arg1, uint32_t arg2, uint8_t *datain);
 void MifareChkKeys_file(uint8_t *fn);
 
 void MifareEMemClr(void);
 void MifareEMemGet(uint8_t blockno, uint8_t blockcnt);
+void MifareEMemLoadBulk(const eml_bulk_t *req, uint16_t len);
 int MifareECardLoad(uint8_t sectorcnt, uint8_t keytype);
 int MifareECardLoadExt(uint8_t sectorcnt, uint8_t keytype);
 
@@ -51,6 +59,7 @@ int MifareECardLoadExt(uint8_t sectorcnt, uint8_t keytype);
 void MifareCSetBlock(uint32_t arg0, uint32_t arg1, uint8_t *datain);  // Work with "magic Chinese" card
 void MifareCGetBlock(uint32_t arg0, uint32_t arg1, uint8_t *datain);
 void MifareCIdent(bool is_mfc, uint8_t keytype, uint8_t *key);  // is "magic chinese" card?
+void MifareMagicLoadBulk(const eml_bulk_t *req, uint16_t len);   // gen1a / gen4 GTU image in one session
 void MifareHasStaticNonce(void);  // Has the tag a static nonce?
 void MifareHasStaticEncryptedNonce(uint8_t block_no, uint8_t key_type, uint8_t *key); // Has the tag a static encrypted nonce?
 
@@ -17,6 +17,7 @@
 
 #include "common.h"
 #include "proxmark3_arm.h"
+#include "appmain.h"
 #include "string.h"
 #include "BigBuf.h"
 #include "mifareutil.h"
@@ -657,6 +658,305 @@ void MifareDES_Auth1(uint8_t *datain) {
     LED_B_OFF();
 }
 
+static void MifareDesfireChkCBC(uint8_t algo, const uint8_t *key, uint8_t *iv, uint8_t *in, uint8_t *out, size_t len, bool encipher) {
+    if (algo == MFDES_ALGO_AES) {
+        if (encipher)
+            aes128_nxp_send(in, out, len, key, iv);
+        else
+            aes128_nxp_receive(in, out, len, key, iv);
+    } else {
+        int keymode = (algo == MFDES_ALGO_3K3DES) ? 3 : 2;
+        if (encipher)
+            tdes_nxp_send(in, out, len, key, iv, keymode);
+        else
+            tdes_nxp_receive(in, out, len, key, iv, keymode);
+    }
+}
+
+// Key check,  authentication rounds back to back in the ISO-DEP session the client opened.
+// The challenge is answered with each key,  the card accepting the answer is the hit.
+// The card stays selected after a refused answer,  the next round starts right away.
+void MifareDesfireCheckKeys(const uint8_t *datain, uint16_t datalen) {
+    const mfdes_chk_req_t *req = (const mfdes_chk_req_t *)datain;
+    mfdes_chk_resp_t rpayload = {0, -1, 0};
+
+    if (datalen < sizeof(mfdes_chk_req_t) || req->authcmdlen > sizeof(req->authcmd) ||
+            datalen < sizeof(mfdes_chk_req_t) + req->count * req->keylen ||
+            (req->algo != MFDES_ALGO_3DES && req->algo != MFDES_ALGO_3K3DES && req->algo != MFDES_ALGO_AES)) {
+        reply_ng(CMD_HF_DESFIRE_CHKKEYS, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    size_t rndlen = (req->algo == MFDES_ALGO_3DES) ? 8 : 16;
+    uint8_t resp[RECEIVE_SIZE] = {0};
+    uint8_t cmd[5 + 32 + 1] = {0x90, MFDES_ADDITIONAL_FRAME, 0x00, 0x00, rndlen * 2};
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+    set_tracing(true);
+
+    for (uint8_t i = 0; i < req->count; i++) {
+        WDT_HIT();
+        if (BUTTON_PRESS()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+        const uint8_t *key = &req->keys[i * req->keylen];
+
+        // challenge,  ek(RndB)
+        int len = iso14_apdu_exchange(req->authcmd, req->authcmdlen, resp, sizeof(resp));
+        if (len < 0) {
+            status = len;
+            break;
+        }
+        rpayload.checked++;
+
+        uint16_t sw = (len >= 2) ? ((resp[len - 2] << 8) | resp[len - 1]) : 0;
+        // EV2 may put a zero byte in front
+        size_t rpos = (len == rndlen + 3 && resp[0] == 0x00) ? 1 : 0;
+        if (sw != 0x91AF || len != rndlen + 2 + rpos) {
+            rpayload.sw = (sw) ? sw : 0xFFFF;
+            break;
+        }
+
+        uint8_t iv[16] = {0};
+        uint8_t rndb[16] = {0};
+        MifareDesfireChkCBC(req->algo, key, iv, &resp[rpos], rndb, rndlen, false);
+        if (req->chain_iv == false)
+            memset(iv, 0, sizeof(iv));
+
+        // ek(RndA || RndB')
+        uint8_t tmp[32] = {0};
+        memcpy(tmp, req->rnda, rndlen);
+        memcpy(tmp + rndlen, rndb, rndlen);
+        rol(tmp + rndlen, rndlen);
+        MifareDesfireChkCBC(req->algo, key, iv, tmp, &cmd[5], rndlen * 2, true);
+        cmd[5 + rndlen * 2] = 0x00;
+
+        len = iso14_apdu_exchange(cmd, 5 + rndlen * 2 + 1, resp, sizeof(resp));
+        if (len < 0) {
+            status = len;
+            break;
+        }
+        if (len >= 2 && resp[len - 2] == 0x91 && resp[len - 1] == 0x00) {
+            rpayload.found = i;
+            break;
+        }
+    }
+
+    if (status != PM3_SUCCESS) {
+        hf_field_off();
+    }
+    LED_A_OFF();
+    reply_ng(CMD_HF_DESFIRE_CHKKEYS, status, (uint8_t *)&rpayload, sizeof(rpayload));
+}
+
+// AID search,  SelectApplication rounds back to back in the ISO-DEP session the client opened.
+// Found AIDs are streamed as they come,  with a progress reply every MFDES_BRUTEAID_PROGRESS AIDs.
+#define MFDES_BRUTEAID_PROGRESS 64
+
+void MifareDesfireBruteAID(const uint8_t *datain, uint16_t datalen) {
+    const mfdes_bruteaid_req_t *req = (const mfdes_bruteaid_req_t *)datain;
+    mfdes_bruteaid_resp_t rpayload;
+    memset(&rpayload, 0, sizeof(rpayload));
+
+    if (datalen < sizeof(mfdes_bruteaid_req_t) || req->step == 0 || req->start > req->end) {
+        rpayload.done = true;
+        reply_ng(CMD_HF_DESFIRE_BRUTEAID, PM3_EINVARG, (uint8_t *)&rpayload, sizeof(rpayload));
+        return;
+    }
+
+    uint8_t cmd[] = {0x90, MFDES_SELECT_APPLICATION, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00};
+    uint8_t resp[RECEIVE_SIZE] = {0};
+    uint32_t found = 0;
+    uint32_t sent = 0;
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+
+    uint32_t aid = req->start;
+    while (true) {
+        WDT_HIT();
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        // AID goes LSB first
+        cmd[5] = aid & 0xFF;
+        cmd[6] = (aid >> 8) & 0xFF;
+        cmd[7] = (aid >> 16) & 0xFF;
+        int len = iso14_apdu_exchange(cmd, sizeof(cmd), resp, sizeof(resp));
+        if (len < 0) {
+            status = len;
+            break;
+        }
+        sent++;
+
+        bool hit = (len >= 2 && resp[len - 2] == 0x91 && resp[len - 1] == 0x00);
+        if (hit) {
+            rpayload.aids[rpayload.count++] = aid;
+            found++;
+        }
+
+        bool last = (req->end - aid < req->step) || (req->maxfound && found >= req->maxfound);
+        aid += req->step;
+        rpayload.next = aid;
+        if (last)
+            break;
+
+        if (hit || rpayload.count == MFDES_BRUTEAID_REPLY_AIDS || (sent % MFDES_BRUTEAID_PROGRESS) == 0) {
+            reply_ng(CMD_HF_DESFIRE_BRUTEAID, PM3_SUCCESS, (uint8_t *)&rpayload, sizeof(rpayload));
+            rpayload.count = 0;
+        }
+    }
+
+    if (status != PM3_SUCCESS && status != PM3_EOPABORTED) {
+        hf_field_off();
+    }
+    LED_A_OFF();
+    rpayload.done = true;
+    reply_ng(CMD_HF_DESFIRE_BRUTEAID, status, (uint8_t *)&rpayload, sizeof(rpayload));
+}
+
+static bool MifarePlusChkSelect(void) {
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+    return iso14443a_select_card(NULL, NULL, NULL, true, 0, false);
+}
+
+// SL3 first authentication with one key,  same steps as MifareAuth4() in the client.
+// returns PM3_SUCCESS when the card answered,  *hit tells if the key is right.
+// *cardres gets the card error to the first step,  that one doesn't depend on the key
+static int MifarePlusChkAuth(uint16_t keynum, const uint8_t *key, const uint8_t *rnda, bool *hit, uint8_t *cardres) {
+    uint8_t resp[RECEIVE_SIZE] = {0};
+    uint8_t iv[16] = {0};
+    *hit = false;
+    *cardres = 0;
+
+    // 0x70 keynum (LSB first) lenCap,  answer is 0x90 ek(RndB)
+    uint8_t cmd1[] = {0x70, keynum & 0xFF, keynum >> 8, 0x00};
+    int len = iso14_apdu_exchange(cmd1, sizeof(cmd1), resp, sizeof(resp));
+    if (len < 0)
+        return len;
+
+    if (len < 1)
+        return PM3_EWRONGANSWER;
+
+    if (resp[0] != 0x90) {
+        *cardres = resp[0];
+        return PM3_SUCCESS;
+    }
+
+    if (len != 17)
+        return PM3_EWRONGANSWER;
+
+    uint8_t rndb[16] = {0};
+    aes128_nxp_receive(&resp[1], rndb, 16, key, iv);
+
+    // 0x72 ek(RndA || RndB')
+    uint8_t tmp[32] = {0};
+    memcpy(tmp, rnda, 16);
+    memcpy(tmp + 16, rndb, 16);
+    rol(tmp + 16, 16);
+
+    uint8_t cmd2[33] = {0x72};
+    memset(iv, 0, sizeof(iv));
+    aes128_nxp_send(tmp, &cmd2[1], 32, key, iv);
+
+    len = iso14_apdu_exchange(cmd2, sizeof(cmd2), resp, sizeof(resp));
+    if (len < 0)
+        return len;
+
+    // 0x90 ek(TI || RndA' || PICCcap2 || PCDcap2)
+    if (len != 33 || resp[0] != 0x90)
+        return PM3_SUCCESS;
+
+    memset(iv, 0, sizeof(iv));
+    aes128_nxp_receive(&resp[1], tmp, 32, key, iv);
+
+    uint8_t rnda_rot[16];
+    memcpy(rnda_rot, rnda, 16);
+    rol(rnda_rot, 16);
+    *hit = (memcmp(&tmp[4], rnda_rot, 16) == 0);
+    return PM3_SUCCESS;
+}
+
+// MIFARE Plus SL3 key check of one sector.
+// No round trip to the client per key,  the card gets selected again after a hit
+// and on exchange errors,  up to 4 tries per key as in the client.
+void MifarePlusCheckKeys(const uint8_t *datain, uint16_t datalen) {
+    const mfp_chk_req_t *req = (const mfp_chk_req_t *)datain;
+    mfp_chk_resp_t rpayload = {0, {-1, -1}, {0, 0}};
+
+    if (datalen < sizeof(mfp_chk_req_t) || datalen < sizeof(mfp_chk_req_t) + req->count * 16 ||
+            req->count > MFP_CHK_KEYS_MAX || (req->keyab & 0x03) == 0 || req->sector > 127) {
+        reply_ng(CMD_HF_MIFAREPLUS_CHKKEYS, PM3_EINVARG, NULL, 0);
+        return;
+    }
+
+    int status = PM3_SUCCESS;
+
+    LED_A_ON();
+    set_tracing(true);
+    bool selected = MifarePlusChkSelect();
+
+    for (uint8_t keyab = 0; keyab < 2 && status == PM3_SUCCESS; keyab++) {
+        if ((req->keyab & (1 << keyab)) == 0)
+            continue;
+
+        uint16_t keynum = 0x4000 + req->sector * 2 + keyab;
+
+        for (uint8_t i = 0; i < req->count; i++) {
+            WDT_HIT();
+            if (BUTTON_PRESS()) {
+                status = PM3_EOPABORTED;
+                break;
+            }
+
+            bool hit = false;
+            uint8_t cardres = 0;
+            int res = PM3_ECARDEXCHANGE;
+            for (int retry = 0; retry < 4; retry++) {
+                if (selected) {
+                    res = MifarePlusChkAuth(keynum, &req->keys[i * 16], req->rnda, &hit, &cardres);
+                    if (res == PM3_SUCCESS)
+                        break;
+                }
+
+                hf_field_off();
+                SpinDelay(100);
+                selected = MifarePlusChkSelect();
+            }
+
+            if (res != PM3_SUCCESS) {
+                status = PM3_ECARDEXCHANGE;
+                break;
+            }
+            rpayload.checked++;
+
+            // the key number isn't there or is locked,  no key will do
+            if (cardres) {
+                rpayload.error[keyab] = cardres;
+                break;
+            }
+
+            if (hit) {
+                rpayload.found[keyab] = i;
+
+                // the card is in an authenticated state now
+                hf_field_off();
+                SpinDelay(50);
+                selected = MifarePlusChkSelect();
+                break;
+            }
+        }
+    }
+
+    hf_field_off();
+    LED_A_OFF();
+    reply_ng(CMD_HF_MIFAREPLUS_CHKKEYS, status, (uint8_t *)&rpayload, sizeof(rpayload));
+}
+
 // 3 different ISO ways to send data to a DESFIRE (direct, capsuled, capsuled ISO)
 // cmd  =  cmd bytes to send
 // cmd_len = length of cmd
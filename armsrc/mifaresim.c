@@ -46,141 +46,146 @@
 #include "dbprint.h"
 #include "ticks.h"
 
-static bool IsKeyBReadable(uint8_t blockNo) {
-    uint8_t sector_trailer[16];
-    emlGetMem(sector_trailer, SectorTrailer(blockNo), 1);
-    uint8_t AC = ((sector_trailer[7] >> 5) & 0x04)
-                 | ((sector_trailer[8] >> 2) & 0x02)
-                 | ((sector_trailer[8] >> 7) & 0x01);
-    return (AC == 0x00 || AC == 0x01 || AC == 0x02);
-}
-
-static bool IsTrailerAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
-    uint8_t sector_trailer[16];
-    emlGetMem(sector_trailer, blockNo, 1);
-    uint8_t AC = ((sector_trailer[7] >> 5) & 0x04)
-                 | ((sector_trailer[8] >> 2) & 0x02)
-                 | ((sector_trailer[8] >> 7) & 0x01);
+// Access conditions of every sector,  decoded from the sector trailers at sim start and
+// again whenever a trailer changes,  so a command costs a table lookup instead of a trailer
+// decode while the reader waits. allow[group][keytype] has bit <action> set for the allowed
+// actions,  groups 0..2 are the data block groups and 3 is the trailer
+typedef struct {
+    uint8_t allow[4][2];
+    bool keyb_readable;
+} sim_acl_t;
+
+static sim_acl_t sim_acl[MIFARE_4K_MAXSECTOR];
+
+static bool TrailerAccessAllowed(uint8_t AC, uint8_t keytype, uint8_t action) {
     switch (action) {
-        case AC_KEYA_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYA_READ");
+        case AC_KEYA_READ:
             return false;
-        }
-        case AC_KEYA_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYA_WRITE");
+        case AC_KEYA_WRITE:
             return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x01))
                     || (keytype == AUTHKEYB && (AC == 0x04 || AC == 0x03)));
-        }
-        case AC_KEYB_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYB_READ");
+        case AC_KEYB_READ:
             return (keytype == AUTHKEYA && (AC == 0x00 || AC == 0x02 || AC == 0x01));
-        }
-        case AC_KEYB_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_KEYB_WRITE");
+        case AC_KEYB_WRITE:
             return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x01))
                     || (keytype == AUTHKEYB && (AC == 0x04 || AC == 0x03)));
-        }
-        case AC_AC_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_AC_READ");
+        case AC_AC_READ:
             return ((keytype == AUTHKEYA)
                     || (keytype == AUTHKEYB && !(AC == 0x00 || AC == 0x02 || AC == 0x01)));
-        }
-        case AC_AC_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsTrailerAccessAllowed: AC_AC_WRITE");
+        case AC_AC_WRITE:
             return ((keytype == AUTHKEYA && (AC == 0x01))
                     || (keytype == AUTHKEYB && (AC == 0x03 || AC == 0x05)));
-        }
         default:
             return false;
     }
 }
 
-static bool IsDataAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
-
-    uint8_t sector_trailer[16];
-    emlGetMem(sector_trailer, SectorTrailer(blockNo), 1);
-
-    uint8_t sector_block;
-    if (blockNo <= MIFARE_2K_MAXBLOCK) {
-        sector_block = blockNo & 0x03;
-    } else {
-        sector_block = (blockNo & 0x0f) / 5;
-    }
-
-    uint8_t AC;
-    switch (sector_block) {
-        case 0x00: {
-            AC = ((sector_trailer[7] >> 2) & 0x04)
-                 | ((sector_trailer[8] << 1) & 0x02)
-                 | ((sector_trailer[8] >> 4) & 0x01);
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: case 0x00 - %02x", AC);
-            break;
-        }
-        case 0x01: {
-            AC = ((sector_trailer[7] >> 3) & 0x04)
-                 | ((sector_trailer[8] >> 0) & 0x02)
-                 | ((sector_trailer[8] >> 5) & 0x01);
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: case 0x01 - %02x", AC);
-            break;
-        }
-        case 0x02: {
-            AC = ((sector_trailer[7] >> 4) & 0x04)
-                 | ((sector_trailer[8] >> 1) & 0x02)
-                 | ((sector_trailer[8] >> 6) & 0x01);
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: case 0x02  - %02x", AC);
-            break;
-        }
-        default:
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed: Error");
-            return false;
-    }
-
+static bool DataAccessAllowed(uint8_t AC, uint8_t keytype, uint8_t action) {
     switch (action) {
-        case AC_DATA_READ: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed - AC_DATA_READ: OK");
+        case AC_DATA_READ:
             return ((keytype == AUTHKEYA && !(AC == 0x03 || AC == 0x05 || AC == 0x07))
                     || (keytype == AUTHKEYB && !(AC == 0x07)));
-        }
-        case AC_DATA_WRITE: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed - AC_DATA_WRITE: OK");
+        case AC_DATA_WRITE:
             return ((keytype == AUTHKEYA && (AC == 0x00))
                     || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x04 || AC == 0x06 || AC == 0x03)));
-        }
-        case AC_DATA_INC: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("IsDataAccessAllowed - AC_DATA_INC: OK");
+        case AC_DATA_INC:
             return ((keytype == AUTHKEYA && (AC == 0x00))
                     || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x06)));
-        }
-        case AC_DATA_DEC_TRANS_REST: {
-            if (g_dbglevel >= DBG_EXTENDED)
-                Dbprintf("AC_DATA_DEC_TRANS_REST: OK");
+        case AC_DATA_DEC_TRANS_REST:
             return ((keytype == AUTHKEYA && (AC == 0x00 || AC == 0x06 || AC == 0x01))
                     || (keytype == AUTHKEYB && (AC == 0x00 || AC == 0x06 || AC == 0x01)));
+        default:
+            return false;
+    }
+}
+
+static void MifareSimAclUpdate(uint8_t sector) {
+    uint8_t sector_trailer[16];
+    emlGetMem(sector_trailer, SectorTrailer(FirstBlockOfSector(sector)), 1);
+
+    // C1 C2 C3 of block group g sit in bit 4+g of byte 7 and bits g,  4+g of byte 8
+    uint8_t AC[4];
+    for (uint8_t g = 0; g < 4; g++) {
+        AC[g] = (((sector_trailer[7] >> (4 + g)) & 0x01) << 2)
+                | (((sector_trailer[8] >> g) & 0x01) << 1)
+                | ((sector_trailer[8] >> (4 + g)) & 0x01);
+    }
+
+    sim_acl_t *acl = &sim_acl[sector];
+    memset(acl, 0, sizeof(sim_acl_t));
+    for (uint8_t keytype = AUTHKEYA; keytype <= AUTHKEYB; keytype++) {
+        for (uint8_t action = AC_DATA_READ; action <= AC_DATA_DEC_TRANS_REST; action++) {
+            for (uint8_t g = 0; g < 3; g++) {
+                if (DataAccessAllowed(AC[g], keytype, action)) {
+                    acl->allow[g][keytype] |= (1 << action);
+                }
+            }
+        }
+        for (uint8_t action = AC_KEYA_READ; action <= AC_AC_WRITE; action++) {
+            if (TrailerAccessAllowed(AC[3], keytype, action)) {
+                acl->allow[3][keytype] |= (1 << action);
+            }
         }
     }
+    acl->keyb_readable = (AC[3] == 0x00 || AC[3] == 0x01 || AC[3] == 0x02);
+}
+
+static void MifareSimAclUpdateAll(void) {
+    for (uint8_t sector = 0; sector < MIFARE_4K_MAXSECTOR; sector++) {
+        MifareSimAclUpdate(sector);
+    }
+}
 
-    return false;
+static bool IsKeyBReadable(uint8_t blockNo) {
+    return sim_acl[MifareBlockToSector(blockNo)].keyb_readable;
 }
 
 static bool IsAccessAllowed(uint8_t blockNo, uint8_t keytype, uint8_t action) {
+    if (keytype > AUTHKEYB) {
+        return false;
+    }
+
+    uint8_t group;
     if (IsSectorTrailer(blockNo)) {
-        return IsTrailerAccessAllowed(blockNo, keytype, action);
+        group = 3;
+    } else if (blockNo <= MIFARE_2K_MAXBLOCK) {
+        group = blockNo & 0x03;
     } else {
-        return IsDataAccessAllowed(blockNo, keytype, action);
+        group = (blockNo & 0x0f) / 5;
     }
+
+    bool allowed = (sim_acl[MifareBlockToSector(blockNo)].allow[group][keytype] >> action) & 0x01;
+    if (g_dbglevel >= DBG_EXTENDED)
+        Dbprintf("IsAccessAllowed: block %d key %c group %d action %d - %s", blockNo, (keytype == AUTHKEYA) ? 'A' : 'B', group, action, allowed ? "OK" : "denied");
+    return allowed;
+}
+
+// stream mode,  the client pushes recovered keys into emulator memory while we simulate.
+// Returns true when the simulation should go on,  any other command stops it
+static bool MifareSimStreamPoll(void) {
+    static PacketCommandNG rx;
+    int res = receive_ng(&rx);
+    if (res == PM3_ENODATA) {
+        return true;
+    }
+
+    if (res != PM3_SUCCESS || rx.cmd != CMD_HF_MIFARE_EML_MEMSET) {
+        return false;
+    }
+
+    struct p {
+        uint8_t blockno;
+        uint8_t blockcnt;
+        uint8_t blockwidth;
+        uint8_t data[];
+    } PACKED;
+    struct p *payload = (struct p *) rx.data.asBytes;
+    if (payload->blockwidth == 0)
+        payload->blockwidth = 16;
+
+    emlSetMem_xt(payload->data, payload->blockno, payload->blockcnt, payload->blockwidth);
+    MifareSimAclUpdateAll();
+    return true;
 }
 
 static bool MifareSimInit(uint16_t flags, uint8_t *datain, uint16_t atqa, uint8_t sak, tag_response_info_t **responses, uint32_t *cuid, uint8_t *uid_len, uint8_t **rats, uint8_t *rats_len) {
@@ -459,6 +464,7 @@ static bool MifareSimInit(uint16_t flags, uint8_t *datain, uint16_t atqa, uint8_
 * FLAG_7B_UID_IN_DATA - means that there is a 7-byte UID in the data-section, we're expected to use that
 * FLAG_10B_UID_IN_DATA - use 10-byte UID in the data-section not finished
 * FLAG_NR_AR_ATTACK - means we should collect NR_AR responses for bruteforcing later
+* FLAG_NR_AR_STREAM - send every failed reader auth to the client as it happens and accept emulator memory writes while simulating
 *@param exitAfterNReads, exit simulation after n blocks have been read, 0 is infinite ...
 * (unless reader attack mode enabled then it runs util it gets enough nonces to recover all keys attmpted)
 */
@@ -522,6 +528,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
     uint8_t rAUTH_NT[4] = {0, 0, 0, 1};
     uint8_t rAUTH_NT_keystream[4];
     uint32_t nonce = 0;
+    uint32_t nonce_ar = 0, nonce_at = 0;   // prng_successor(nonce, 64 / 96)
 
     const tUart14a *uart = GetUart14a();
 
@@ -533,6 +540,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
         return;
     }
 
+    MifareSimAclUpdateAll();
+
     // We need to listen to the high-frequency, peak-detected path.
     iso14443a_setup(FPGA_HF_ISO14443A_TAGSIM_LISTEN);
 
@@ -554,6 +563,10 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
 
         if (counter == 3000) {
             if (data_available()) {
+                if (((flags & FLAG_NR_AR_STREAM) == FLAG_NR_AR_STREAM) && MifareSimStreamPoll()) {
+                    counter = 0;
+                    continue;
+                }
                 Dbprintf("----------- " _GREEN_("BREAKING") " ----------");
                 break;
             }
@@ -594,6 +607,9 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
             continue;
         } else if (res == 1) { // button pressed
             FpgaDisableTracing();
+            if (((flags & FLAG_NR_AR_STREAM) == FLAG_NR_AR_STREAM) && (BUTTON_PRESS() == false) && MifareSimStreamPoll()) {
+                continue;
+            }
             button_pushed = true;
             if (g_dbglevel >= DBG_EXTENDED)
                 Dbprintf("Button pressed");
@@ -794,16 +810,18 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                     // first authentication
                     crypto1_deinit(pcs);
 
-                    // Load key into crypto
-                    crypto1_init(pcs, emlGetKey(cardAUTHSC, cardAUTHKEY));
-
                     if (!encrypted_data) {
+                        // rAUTH_NT contains prepared nonce for authenticate,  it goes out first.
+                        // The reader waits at least FDT PCD min (6780/fc, ~500us) before {nr}{ar},
+                        // plenty to load the key and run UID ^ NONCE through the cipher
+                        EmSendCmd(rAUTH_NT, sizeof(rAUTH_NT));
+                        FpgaDisableTracing();
+
+                        // Load key into crypto
+                        crypto1_init(pcs, emlGetKey(cardAUTHSC, cardAUTHKEY));
                         // Receive Cmd in clear txt
                         // Update crypto state (UID ^ NONCE)
                         crypto1_word(pcs, cuid ^ nonce, 0);
-                        // rAUTH_NT contains prepared nonce for authenticate
-                        EmSendCmd(rAUTH_NT, sizeof(rAUTH_NT));
-                        FpgaDisableTracing();
 
                         if (g_dbglevel >= DBG_EXTENDED) {
                             Dbprintf("[MFEMUL_WORK] Reader authenticating for block %d (0x%02x) with key %c - nonce: %08X - cuid: %08X",
@@ -820,6 +838,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                         ans = nonce ^ crypto1_word(pcs, cuid ^ nonce, 0);
                         num_to_bytes(ans, 4, rAUTH_AT);
                         */
+                        // Load key into crypto
+                        crypto1_init(pcs, emlGetKey(cardAUTHSC, cardAUTHKEY));
                         // rAUTH_NT, rAUTH_NT_keystream contains prepared nonce and keystream for nested authentication
                         // we need calculate parity bits for non-encrypted sequence
                         mf_crypto1_encryptEx(pcs, rAUTH_NT, rAUTH_NT_keystream, response, 4, response_par);
@@ -835,6 +855,10 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                         }
                     }
 
+                    // expected reader answer and our own,  worked out while the reader computes {nr}{ar}
+                    nonce_ar = prng_successor(nonce, 64);
+                    nonce_at = prng_successor(nonce, 96);
+
                     cardSTATE = MFEMUL_AUTH1;
                     if (g_dbglevel >= DBG_EXTENDED) Dbprintf("[MFEMUL_WORK] cardSTATE = MFEMUL_AUTH1 - rAUTH_NT: %02X", rAUTH_NT);
                     break;
@@ -1195,6 +1219,8 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                                                 gettingMoebius = true;
                                                 mM = ATTACK_KEY_COUNT;
                                                 nonce = nonce * 7;
+                                                nonce_ar = prng_successor(nonce, 64);
+                                                nonce_at = prng_successor(nonce, 96);
                                                 break;
                                             }
                                         } else {
@@ -1218,7 +1244,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                 cardRr = ar ^ crypto1_word(pcs, 0, 0);
 
                 // test if auth KO
-                if (cardRr != prng_successor(nonce, 64)) {
+                if (cardRr != nonce_ar) {
                     if (g_dbglevel >= DBG_EXTENDED) {
                         Dbprintf("[MFEMUL_AUTH1] AUTH FAILED for sector %d with key %c. [nr=%08x  cardRr=%08x] [nt=%08x succ=%08x]"
                                  , cardAUTHSC
@@ -1226,9 +1252,21 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                                  , nr
                                  , cardRr
                                  , nonce // nt
-                                 , prng_successor(nonce, 64)
+                                 , nonce_ar
                                 );
                     }
+                    // the reader waits for an answer that never comes,  time enough to hand the nonce over
+                    if ((flags & FLAG_NR_AR_STREAM) == FLAG_NR_AR_STREAM) {
+                        nonces_t n = {0};
+                        n.cuid = cuid;
+                        n.sector = cardAUTHSC;
+                        n.keytype = cardAUTHKEY;
+                        n.nonce = nonce;
+                        n.nr = nr;
+                        n.ar = ar;
+                        n.state = FIRST;
+                        reply_ng(CMD_HF_MIFARE_SIMULATE, PM3_SUCCESS, (uint8_t *)&n, sizeof(n));
+                    }
                     cardAUTHKEY = AUTHKEYNONE; // not authenticated
                     cardSTATE_TO_IDLE();
                     // Really tags not respond NACK on invalid authentication
@@ -1236,7 +1274,7 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                     break;
                 }
 
-                ans = prng_successor(nonce, 96);
+                ans = nonce_at;
                 num_to_bytes(ans, 4, response);
                 mf_crypto1_encrypt(pcs, response, 4, response_par);
                 EmSendCmdPar(response, 4, response_par);
@@ -1278,6 +1316,9 @@ void Mifare1ksim(uint16_t flags, uint8_t exitAfterNReads, uint8_t *datain, uint1
                         }
                         emlSetMem_xt(receivedCmd_dec, cardWRBL, 1, 16);
                         EmSend4bit(mf_crypto1_encrypt4bit(pcs, CARD_ACK)); // always ACK?
+                        if (IsSectorTrailer(cardWRBL)) {
+                            MifareSimAclUpdate(MifareBlockToSector(cardWRBL));
+                        }
                         FpgaDisableTracing();
 
                         cardSTATE = MFEMUL_WORK;
@@ -30,28 +30,21 @@
 #include "optimized_cipher.h"
 #include "fpgaloader.h"
 
-static int sam_rxtx(const uint8_t *data, uint16_t n, uint8_t *resp, uint16_t *resplen) {
-
-    StartTicks();
-
-    bool res = I2C_BufferWrite(data, n, I2C_DEVICE_CMD_SEND_T0, I2C_DEVICE_ADDRESS_MAIN);
-    if (res == false) {
-        DbpString("failed to send to SIM CARD");
-        goto out;
-    }
+// Receive the SAM answer and fetch the rest of it with GET RESPONSE.  Ticks must be running.
+// started:  the APDU was sent with sam_tx_start()
+static bool sam_rx_answer(uint8_t *resp, uint16_t *resplen, bool started) {
 
     *resplen = ISO7816_MAX_FRAME;
 
-    res = sc_rx_bytes(resp, resplen, SIM_WAIT_DELAY);
+    bool res = (started) ? sc_rx_bytes_started(resp, resplen, SIM_WAIT_DELAY) : sc_rx_bytes(resp, resplen, SIM_WAIT_DELAY);
     if (res == false) {
         DbpString("failed to receive from SIM CARD");
-        goto out;
+        return false;
     }
 
     if (*resplen < 2) {
         DbpString("received too few bytes from SIM CARD");
-        res = false;
-        goto out;
+        return false;
     }
 
     uint16_t more_len = 0;
@@ -60,7 +53,7 @@ static int sam_rxtx(const uint8_t *data, uint16_t n, uint8_t *resp, uint16_t *re
         more_len = resp[*resplen - 1];
     } else {
         // we done, return
-        goto out;
+        return true;
     }
 
     // Don't discard data we already received except the SW code.
@@ -75,7 +68,7 @@ static int sam_rxtx(const uint8_t *data, uint16_t n, uint8_t *resp, uint16_t *re
     res = I2C_BufferWrite(cmd_getresp, sizeof(cmd_getresp), I2C_DEVICE_CMD_SEND_T0, I2C_DEVICE_ADDRESS_MAIN);
     if (res == false) {
         DbpString("failed to send to SIM CARD 2");
-        goto out;
+        return false;
     }
 
     more_len = 255 - *resplen;
@@ -83,16 +76,52 @@ static int sam_rxtx(const uint8_t *data, uint16_t n, uint8_t *resp, uint16_t *re
     res = sc_rx_bytes(resp + *resplen, &more_len, SIM_WAIT_DELAY);
     if (res == false) {
         DbpString("failed to receive from SIM CARD 2");
-        goto out;
+        return false;
     }
 
     *resplen += more_len;
+    return true;
+}
+
+static int sam_rxtx(const uint8_t *data, uint16_t n, uint8_t *resp, uint16_t *resplen) {
+
+    StartTicks();
+
+    bool res = I2C_BufferWrite(data, n, I2C_DEVICE_CMD_SEND_T0, I2C_DEVICE_ADDRESS_MAIN);
+    if (res == false) {
+        DbpString("failed to send to SIM CARD");
+        goto out;
+    }
+
+    res = sam_rx_answer(resp, resplen, false);
 
 out:
     StopTicks();
     return res;
 }
 
+// Send an APDU to the SAM and return while the SAM works on it,  so the card can be
+// talked to meanwhile.  Collect the answer with sam_rx_finish().
+static bool sam_tx_start(const uint8_t *data, uint16_t n) {
+
+    StartTicks();
+
+    bool res = sc_tx_bytes_start(data, n);
+    if (res == false) {
+        DbpString("failed to send to SIM CARD");
+    }
+
+    StopTicks();
+    return res;
+}
+
+static bool sam_rx_finish(uint8_t *resp, uint16_t *resplen) {
+    StartTicks();
+    bool res = sam_rx_answer(resp, resplen, true);
+    StopTicks();
+    return res;
+}
+
 // using HID SAM to authenticate w PICOPASS
 int sam_picopass_get_pacs(void) {
 
@@ -118,6 +147,13 @@ int sam_picopass_get_pacs(void) {
 
     uint8_t *resp = BigBuf_calloc(ISO7816_MAX_FRAME);
 
+    // SAM comms
+    size_t sam_len = 0;
+    uint8_t *sam_apdu = BigBuf_calloc(ISO7816_MAX_FRAME);
+    uint8_t *sam_resp = BigBuf_calloc(ISO7816_MAX_FRAME);
+    uint16_t sam_resp_len = 0;
+    bool sam_pending = false;
+
     bool shallow_mod = false;
     uint16_t resp_len = 0;
     int res;
@@ -163,8 +199,25 @@ int sam_picopass_get_pacs(void) {
     // store CSN
     memcpy(hdr.csn, resp, sizeof(hdr.csn));
 
+    // -----------------------------------------------------------------------------
+    // first
+    // a0 da 02 63 1a 44 0a 44 00 00 00 a0 12 ad 10 a0 0e 80 02 00 04 81 08 9b fc a4 00 fb ff 12 e0
+    // It only needs the CSN,  so the SAM works on it while the rest of the card is read
+    hexstr_to_byte_array("a0da02631a440a44000000a012ad10a00e800200048108", sam_apdu, &sam_len);
+    memcpy(sam_apdu + sam_len, hdr.csn, sizeof(hdr.csn));
+    sam_len += sizeof(hdr.csn);
+
+    if (sam_tx_start(sam_apdu, sam_len) == false) {
+        res = PM3_ECARDEXCHANGE;
+        goto out;
+    }
+    sam_pending = true;
+
+    // start ssp clock again...
+    StartCountSspClk();
+
     // card selected, now read config (block1) (only 8 bytes no CRC)
-    start_time = eof_time + DELAY_ICLASS_VICC_TO_VCD_READER;
+    start_time = GetCountSspClk();
     iclass_send_as_reader(read_conf, sizeof(read_conf), &start_time, &eof_time, shallow_mod);
 
     // expect a 8-byte response here
@@ -214,21 +267,14 @@ int sam_picopass_get_pacs(void) {
     // -----------------------------------------------------------------------------
     // SAM comms
     // -----------------------------------------------------------------------------
-    size_t sam_len = 0;
-    uint8_t *sam_apdu = BigBuf_calloc(ISO7816_MAX_FRAME);
-
-    // -----------------------------------------------------------------------------
-    // first
-    // a0 da 02 63 1a 44 0a 44 00 00 00 a0 12 ad 10 a0 0e 80 02 00 04 81 08 9b fc a4 00 fb ff 12 e0
-    hexstr_to_byte_array("a0da02631a440a44000000a012ad10a00e800200048108", sam_apdu, &sam_len);
-    memcpy(sam_apdu + sam_len, hdr.csn, sizeof(hdr.csn));
-    sam_len += sizeof(hdr.csn);
 
-    if (sam_rxtx(sam_apdu, sam_len, resp, &resp_len) == false) {
+    // answer to the first
+    sam_pending = false;
+    if (sam_rx_finish(sam_resp, &sam_resp_len) == false) {
         res = PM3_ECARDEXCHANGE;
         goto out;
     }
-    print_dbg("-- 1", resp, resp_len);
+    print_dbg("-- 1", sam_resp, sam_resp_len);
 
     // -----------------------------------------------------------------------------
     // second
@@ -435,6 +481,10 @@ int sam_picopass_get_pacs(void) {
     goto off;
 
 out:
+    // don't leave the SAM with an answer nobody picks up
+    if (sam_pending) {
+        sam_rx_finish(sam_resp, &sam_resp_len);
+    }
     reply_ng(CMD_HF_SAM_PICOPASS, res, NULL, 0);
 
 off:
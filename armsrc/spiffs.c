@@ -37,6 +37,12 @@
 
 #define RDV40_LLERASE_BLOCKSIZE (64*1024)
 
+// Sequential read prefetch.  While read_from_spiffs() runs,  a window taken from free BigBuf
+// is filled with one flash burst as soon as the reads turn out to be sequential.
+#define RDV40_SPIFFS_PREFETCH_MAX     (16 * 1024)
+#define RDV40_SPIFFS_PREFETCH_MIN     (LOG_PAGE_SIZE * 2)
+#define RDV40_SPIFFS_PREFETCH_RESERVE (1024)    // left in BigBuf for whatever else runs
+
 #define RDV40_SPIFFS_LAZY_HEADER                                                                                       \
     int changed = 0;                                                                                                   \
     if ((level == RDV40_SPIFFS_SAFETY_LAZY) || (level == RDV40_SPIFFS_SAFETY_SAFE)) {                                  \
@@ -58,9 +64,74 @@
 #include "BigBuf.h"
 #include "dbprint.h"
 
+static struct {
+    u8_t *buf;      // NULL when prefetch is off
+    u32_t size;
+    u32_t addr;     // flash address of buf[0]
+    u32_t len;      // valid bytes in buf
+    u32_t last;     // end of the previous read,  to spot sequential access
+} prefetch;
+
+static int prefetch_start(u32_t size) {
+    if (size < RDV40_SPIFFS_PREFETCH_MIN)
+        return -1;
+
+    u32_t avail = BigBuf_get_hi() - BigBuf_get_traceLen();
+    if (avail < RDV40_SPIFFS_PREFETCH_MIN + RDV40_SPIFFS_PREFETCH_RESERVE)
+        return -1;
+
+    // no point in bursting past the file,  its data pages carry a small header each
+    u32_t window = MIN(avail - RDV40_SPIFFS_PREFETCH_RESERVE, RDV40_SPIFFS_PREFETCH_MAX);
+    window = MIN(window, size + LOG_PAGE_SIZE * 2);
+    window &= ~(LOG_PAGE_SIZE - 1);
+
+    int mark = BigBuf_mark("spiffs prefetch");
+    if (mark < 0)
+        return -1;
+
+    prefetch.buf = BigBuf_malloc(window);
+    if (prefetch.buf == NULL) {
+        BigBuf_release(mark);
+        return -1;
+    }
+    prefetch.size = window;
+    prefetch.len = 0;
+    prefetch.last = 0xFFFFFFFF;
+    return mark;
+}
+
+static void prefetch_stop(int mark) {
+    if (mark < 0)
+        return;
+    prefetch.buf = NULL;
+    prefetch.len = 0;
+    BigBuf_release(mark);
+}
+
 ///// FLASH LEVEL R/W/E operations  for feeding SPIFFS Driver/////////////////
 static s32_t rdv40_spiffs_llread(u32_t addr, u32_t size, u8_t *dst) {
 
+    if (prefetch.buf) {
+        bool sequential = (addr == prefetch.last);
+        prefetch.last = addr + size;
+
+        if (addr >= prefetch.addr && addr + size <= prefetch.addr + prefetch.len) {
+            memcpy(dst, prefetch.buf + (addr - prefetch.addr), size);
+            return SPIFFS_OK;
+        }
+
+        if (sequential && size <= prefetch.size) {
+            u32_t len = MIN(prefetch.size, SPIFFS_CFG_PHYS_SZ - addr);
+            if (len >= size && Flash_ReadData(addr, prefetch.buf, len) == len) {
+                prefetch.addr = addr;
+                prefetch.len = len;
+                memcpy(dst, prefetch.buf, size);
+                return SPIFFS_OK;
+            }
+            prefetch.len = 0;
+        }
+    }
+
     if (!Flash_ReadData(addr, dst, size)) {
         return 128;
     }
@@ -69,6 +140,8 @@ static s32_t rdv40_spiffs_llread(u32_t addr, u32_t size, u8_t *dst) {
 
 static s32_t rdv40_spiffs_llwrite(u32_t addr, u32_t size, u8_t *src) {
 
+    prefetch.len = 0;
+
     if (FlashInit() == false) {
         return 129;
     }
@@ -77,6 +150,9 @@ static s32_t rdv40_spiffs_llwrite(u32_t addr, u32_t size, u8_t *src) {
 }
 
 static s32_t rdv40_spiffs_llerase(u32_t addr, u32_t size) {
+
+    prefetch.len = 0;
+
     if (FlashInit() == false) {
         return 130;
     }
@@ -121,6 +197,8 @@ static enum spiffs_mount_status {
     RDV40_SPIFFS_UNKNOWN
 } RDV40_SPIFFS_MOUNT_STATUS;
 
+static bool spiffs_checked = false;
+
 static int rdv40_spiffs_mounted(void) {
     int ret = 0;
 
@@ -164,6 +242,13 @@ int rdv40_spiffs_mount(void) {
 
     if (ret == SPIFFS_OK) {
         RDV40_SPIFFS_MOUNT_STATUS = RDV40_SPIFFS_MOUNTED;
+
+        // The check/garbage collection, to make it likely we never fall under the 2 contigous
+        // free blocks available, is time-consuming on large flash. It used to run at boot,
+        // now it runs once on the first mount.
+        if (spiffs_checked == false) {
+            rdv40_spiffs_check();
+        }
     }
     return ret;
 }
@@ -185,6 +270,7 @@ int rdv40_spiffs_unmount(void) {
 }
 
 int rdv40_spiffs_check(void) {
+    spiffs_checked = true;
     rdv40_spiffs_lazy_mount();
     SPIFFS_check(&fs);
     SPIFFS_gc_quick(&fs, 0);
@@ -215,11 +301,13 @@ void append_to_spiffs(const char *filename, const uint8_t *src, uint32_t size) {
 }
 
 void read_from_spiffs(const char *filename, uint8_t *dst, uint32_t size) {
+    int mark = prefetch_start(size);
     spiffs_file fd = SPIFFS_open(&fs, filename, SPIFFS_RDWR, 0);
     if (SPIFFS_read(&fs, fd, dst, size) < 0) {
         Dbprintf("errno %i\n", SPIFFS_errno(&fs));
     }
     SPIFFS_close(&fs, fd);
+    prefetch_stop(mark);
 }
 
 static void rename_in_spiffs(const char *old_filename, const char *new_filename) {
@@ -603,6 +691,122 @@ int rdv40_spiffs_read_as_filetype(const char *filename, uint8_t *dst, uint32_t s
 
 ////////////////////////////////////////////////////////////////////////////////
 
+///////// BUFFERED LOG FILES ///////////////////////////////////////////////////
+// Records are collected in a RAM buffer and written out a full buffer at a time,
+// so a standalone mode logging small records pays one mount / append / unmount
+// cycle per buffer instead of per record, and appends whole pages.
+// The active file is always <name>. When it would grow beyond max_size it is
+// rotated logrotate style, <name> -> <name>.1 -> ... -> <name>.<files - 1>, the
+// oldest one being removed, which bounds the space the log takes in flash.
+// Whatever is still buffered is lost if power goes away before a flush.
+
+static void log_name(char *dst, const char *name, uint8_t n) {
+    if (n == 0) {
+        sprintf(dst, "%s", name);
+    } else {
+        sprintf(dst, "%s.%u", name, n);
+    }
+}
+
+static void log_rotate(rdv40_spiffs_log_t *log) {
+    char src[SPIFFS_OBJ_NAME_LEN];
+    char dst[SPIFFS_OBJ_NAME_LEN];
+
+    log_name(dst, log->name, log->files - 1);
+    if (exists_in_spiffs(dst)) {
+        remove_from_spiffs(dst);
+    }
+
+    for (uint8_t n = log->files - 1; n > 0; n--) {
+        log_name(src, log->name, n - 1);
+        log_name(dst, log->name, n);
+        if (exists_in_spiffs(src)) {
+            rename_in_spiffs(src, dst);
+        }
+    }
+    log->size = 0;
+}
+
+int rdv40_spiffs_log_open(rdv40_spiffs_log_t *log, const char *name, uint8_t files, uint32_t max_size,
+                          uint8_t *buf, uint16_t cap) {
+
+    // room for ".9" in the file name
+    if (name == NULL || strlen(name) == 0 || strlen(name) > SPIFFS_OBJ_NAME_LEN - 3) {
+        return SPIFFS_ERR_NAME_TOO_LONG;
+    }
+    if (buf == NULL || cap == 0) {
+        return SPIFFS_ERR_INTERNAL;
+    }
+
+    memset(log, 0, sizeof(rdv40_spiffs_log_t));
+    strncpy(log->name, name, sizeof(log->name) - 1);
+    log->files = (files == 0) ? 1 : MIN(files, 10);
+    log->max_size = max_size;
+    log->buf = buf;
+    // flush whole pages as long as the buffer holds at least one
+    log->cap = (cap >= LOG_PAGE_SIZE) ? (cap - (cap % LOG_PAGE_SIZE)) : cap;
+
+    RDV40SpiFFSSafetyLevel level = RDV40_SPIFFS_SAFETY_SAFE;
+    RDV40_SPIFFS_SAFE_FUNCTION(
+        if (exists_in_spiffs(log->name)) {
+        log->size = size_in_spiffs(log->name);
+        }
+    )
+}
+
+int rdv40_spiffs_log_flush(rdv40_spiffs_log_t *log) {
+    if (log->len == 0) {
+        return SPIFFS_OK;
+    }
+
+    RDV40SpiFFSSafetyLevel level = RDV40_SPIFFS_SAFETY_SAFE;
+    RDV40_SPIFFS_SAFE_FUNCTION(
+        if (log->max_size && log->size && (log->size + log->len > log->max_size)) {
+        log_rotate(log);
+        }
+        if (log->size == 0 && exists_in_spiffs(log->name) == false) {
+        write_to_spiffs(log->name, log->buf, log->len);
+        } else {
+            append_to_spiffs(log->name, log->buf, log->len);
+        }
+        log->size += log->len;
+        log->flushes++;
+        log->len = 0;
+    )
+}
+
+int rdv40_spiffs_log_write(rdv40_spiffs_log_t *log, const uint8_t *src, uint16_t size) {
+    if (size > log->cap) {
+        log->dropped++;
+        return SPIFFS_ERR_FULL;
+    }
+
+    int res = SPIFFS_OK;
+    if (log->len + size > log->cap) {
+        res = rdv40_spiffs_log_flush(log);
+    }
+
+    memcpy(log->buf + log->len, src, size);
+    log->len += size;
+
+    if (log->len == log->cap) {
+        res = rdv40_spiffs_log_flush(log);
+    }
+    return res;
+}
+
+int rdv40_spiffs_log_close(rdv40_spiffs_log_t *log) {
+    int res = rdv40_spiffs_log_flush(log);
+    if (log->dropped) {
+        Dbprintf("log %s, dropped %u records", log->name, log->dropped);
+    }
+    log->buf = NULL;
+    log->cap = 0;
+    return res;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ///////// MISC HIGH LEVEL FUNCTIONS ////////////////////////////////////////////
 #define SPIFFS_BANNER  DbpString(_CYAN_("Flash Memory FileSystem tree (SPIFFS)"));
 
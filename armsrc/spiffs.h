@@ -75,6 +75,25 @@ int exists_in_spiffs(const char *filename);
 
 void rdv40_spiffs_safe_wipe(void);
 
+// buffered, rotating log file, see spiffs.c
+typedef struct rdv40_spiffs_log {
+    char name[SPIFFS_OBJ_NAME_LEN];
+    uint8_t files;          // <name>, <name>.1 .. <name>.<files - 1>
+    uint32_t max_size;      // per file, 0 = never rotate
+    uint32_t size;          // of the active file
+    uint8_t *buf;
+    uint16_t cap;
+    uint16_t len;
+    uint32_t flushes;
+    uint32_t dropped;
+} rdv40_spiffs_log_t;
+
+int rdv40_spiffs_log_open(rdv40_spiffs_log_t *log, const char *name, uint8_t files, uint32_t max_size,
+                          uint8_t *buf, uint16_t cap);
+int rdv40_spiffs_log_write(rdv40_spiffs_log_t *log, const uint8_t *src, uint16_t size);
+int rdv40_spiffs_log_flush(rdv40_spiffs_log_t *log);
+int rdv40_spiffs_log_close(rdv40_spiffs_log_t *log);
+
 #define SPIFFS_OK                       0
 #define SPIFFS_ERR_NOT_MOUNTED          -10000
 #define SPIFFS_ERR_FULL                 -10001
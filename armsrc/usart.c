@@ -231,6 +231,36 @@ int usart_writebuffer_sync(uint8_t *data, size_t len) {
     return PM3_SUCCESS;
 }
 
+// Hands data to the PDC and returns,  the transfer runs from DMA while the caller goes on.
+// Waits only while both PDC banks are taken.  data has to stay untouched until usart_tx_idle(),
+// or until two later transfers got queued,  e.g. a ring of preallocated frames.
+int usart_writebuffer_async(const uint8_t *data, size_t len) {
+
+    while (pUS1->US_TNCR) {};
+
+    if (pUS1->US_TCR == 0) {
+        pUS1->US_TPR = (uint32_t)data;
+        pUS1->US_TCR = len;
+        return PM3_SUCCESS;
+    }
+
+    pUS1->US_TNPR = (uint32_t)data;
+    pUS1->US_TNCR = len;
+
+    // current bank ran out just before the next one was set,  the PDC stopped without
+    // picking it up.  Nothing moves by itself any more,  start it by hand
+    if (pUS1->US_TCR == 0 && pUS1->US_TNCR) {
+        pUS1->US_TNCR = 0;
+        pUS1->US_TPR = (uint32_t)data;
+        pUS1->US_TCR = len;
+    }
+    return PM3_SUCCESS;
+}
+
+bool usart_tx_idle(void) {
+    return (pUS1->US_TNCR == 0 && pUS1->US_TCR == 0);
+}
+
 void usart_init(uint32_t baudrate, uint8_t parity) {
 
     if (baudrate != 0) {
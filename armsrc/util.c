@@ -25,6 +25,7 @@
 #include "string.h"
 #include "usb_cdc.h"
 #include "usart.h"
+#include "cmd.h"
 
 size_t nbytes(size_t nbits) {
     return (nbits >> 3) + ((nbits % 8) > 0);
@@ -347,6 +348,8 @@ int BUTTON_HELD(int ms) {
 // This function returns false if no data is available or
 // the USB connection is invalid.
 bool data_available(void) {
+    // good place to push queued replies out, we are not in a time critical part.
+    reply_tx_poll();
 #ifdef WITH_FPC_USART_HOST
     return usb_poll_validate_length() || (usart_rxdata_available() > 0);
 #else
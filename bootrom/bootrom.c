@@ -19,6 +19,7 @@
 
 #include "clocks.h"
 #include "usb_cdc.h"
+#include "crc32.h"
 
 #ifdef WITH_FLASH
 #include "flashmem.h"
@@ -136,7 +137,8 @@ static void UsbPacketReceived(uint8_t *packet) {
                    DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH |
                    DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO |
                    DEVICE_INFO_FLAG_UNDERSTANDS_VERSION |
-                   DEVICE_INFO_FLAG_UNDERSTANDS_READ_MEM;
+                   DEVICE_INFO_FLAG_UNDERSTANDS_READ_MEM |
+                   DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC;
             if (g_common_area.flags.osimage_present)
                 arg0 |= DEVICE_INFO_FLAG_OSIMAGE_PRESENT;
 
@@ -153,7 +155,7 @@ static void UsbPacketReceived(uint8_t *packet) {
 
         case CMD_BL_VERSION: {
             ack = false;
-            arg0 = BL_VERSION_1_0_0;
+            arg0 = BL_VERSION_1_1_0;
             reply_old(CMD_BL_VERSION, arg0, 0, 0, 0, 0);
         }
         break;
@@ -209,6 +211,29 @@ static void UsbPacketReceived(uint8_t *packet) {
             break;
         }
 
+        // lets the flasher skip blocks which already hold what it would write
+        case CMD_BL_FLASH_CRC: {
+            ack = false;
+            uint32_t addr = arg0;
+            uint32_t blocks = MIN((uint32_t)c->arg[1], BL_FLASH_CRC_MAX_BLOCKS);
+            uint32_t block_size = (uint32_t)c->arg[2];
+
+            if ((block_size == 0) ||
+                    (addr < (uint32_t)_flash_start) ||
+                    (addr + blocks * block_size > (uint32_t)_flash_start + get_flash_size())) {
+                reply_old(CMD_NACK, 0, 0, 0, 0, 0);
+                break;
+            }
+
+            uint8_t crcs[BL_FLASH_CRC_MAX_BLOCKS * sizeof(uint32_t)];
+            for (uint32_t i = 0; i < blocks; i++) {
+                WDT_HIT();
+                crc32_ex((const uint8_t *)(addr + i * block_size), block_size, &crcs[i * sizeof(uint32_t)]);
+            }
+            reply_old(CMD_BL_FLASH_CRC, blocks, 0, 0, crcs, blocks * sizeof(uint32_t));
+        }
+        break;
+
         case CMD_FINISH_WRITE: {
 #if defined ICOPYX
             if (c->arg[1] == 0xff && c->arg[2] == 0x1fd) {
@@ -6,6 +6,7 @@
  */
 
 #include "amiibo.h"
+#include <sys/stat.h>
 #include "md.h"
 #include "aes.h"
 #include "commonutil.h"
@@ -23,10 +24,35 @@ static void nfc3d_amiibo_calc_seed(const uint8_t *dump, uint8_t *key) {
     memcpy(key + 0x20, dump + 0x1E8, 0x20);
 }
 
-static void nfc3d_amiibo_keygen(const nfc3d_keygen_masterkeys_t *masterKeys, const uint8_t *dump, nfc3d_keygen_derivedkeys_t *derivedKeys) {
+// data and tag keys of a dump,  both come from the same seed
+static void nfc3d_amiibo_keygen(nfc3d_amiibo_ctx_t *ctx, const uint8_t *dump, nfc3d_keygen_derivedkeys_t *dataKeys, nfc3d_keygen_derivedkeys_t *tagKeys) {
     uint8_t seed[NFC3D_KEYGEN_SEED_SIZE] = {0};
     nfc3d_amiibo_calc_seed(dump, seed);
-    nfc3d_keygen(masterKeys, seed, derivedKeys);
+
+    for (size_t i = 0; i < NFC3D_AMIIBO_CACHE_SIZE; i++) {
+        nfc3d_amiibo_cache_t *e = &ctx->cache[i];
+        if (e->valid && memcmp(e->seed, seed, sizeof(seed)) == 0) {
+            memcpy(dataKeys, &e->data, sizeof(*dataKeys));
+            memcpy(tagKeys, &e->tag, sizeof(*tagKeys));
+            return;
+        }
+    }
+
+    nfc3d_keygen_prepared(&ctx->data, seed, dataKeys);
+    nfc3d_keygen_prepared(&ctx->tag, seed, tagKeys);
+
+    nfc3d_amiibo_cache_t *e = &ctx->cache[ctx->cache_next];
+    ctx->cache_next = (ctx->cache_next + 1) % NFC3D_AMIIBO_CACHE_SIZE;
+    memcpy(e->seed, seed, sizeof(seed));
+    memcpy(&e->data, dataKeys, sizeof(e->data));
+    memcpy(&e->tag, tagKeys, sizeof(e->tag));
+    e->valid = true;
+}
+
+void nfc3d_amiibo_ctx_init(nfc3d_amiibo_ctx_t *ctx, const nfc3d_amiibo_keys_t *amiiboKeys) {
+    memset(ctx, 0, sizeof(*ctx));
+    nfc3d_keygen_prepare(&amiiboKeys->data, &ctx->data);
+    nfc3d_keygen_prepare(&amiiboKeys->tag, &ctx->tag);
 }
 
 static void nfc3d_amiibo_cipher(const nfc3d_keygen_derivedkeys_t *keys, const uint8_t *in, uint8_t *out) {
@@ -69,6 +95,12 @@ static void nfc3d_amiibo_internal_to_tag(const uint8_t *intl, uint8_t *tag) {
 }
 
 bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *tag, uint8_t *plain) {
+    nfc3d_amiibo_ctx_t ctx;
+    nfc3d_amiibo_ctx_init(&ctx, amiiboKeys);
+    return nfc3d_amiibo_unpack_ctx(&ctx, tag, plain);
+}
+
+bool nfc3d_amiibo_unpack_ctx(nfc3d_amiibo_ctx_t *ctx, const uint8_t *tag, uint8_t *plain) {
 
     uint8_t internal[NFC3D_AMIIBO_SIZE] = {0};
 
@@ -79,8 +111,7 @@ bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *t
     nfc3d_amiibo_tag_to_internal(tag, internal);
 
     // Generate keys
-    nfc3d_amiibo_keygen(&amiiboKeys->data, internal, &dataKeys);
-    nfc3d_amiibo_keygen(&amiiboKeys->tag, internal, &tagKeys);
+    nfc3d_amiibo_keygen(ctx, internal, &dataKeys, &tagKeys);
 
     // Decrypt
     nfc3d_amiibo_cipher(&dataKeys, internal, plain);
@@ -108,13 +139,18 @@ bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *t
 }
 
 void nfc3d_amiibo_pack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *plain, uint8_t *tag) {
+    nfc3d_amiibo_ctx_t ctx;
+    nfc3d_amiibo_ctx_init(&ctx, amiiboKeys);
+    nfc3d_amiibo_pack_ctx(&ctx, plain, tag);
+}
+
+void nfc3d_amiibo_pack_ctx(nfc3d_amiibo_ctx_t *ctx, const uint8_t *plain, uint8_t *tag) {
     uint8_t cipher[NFC3D_AMIIBO_SIZE] = {0};
     nfc3d_keygen_derivedkeys_t tagKeys;
     nfc3d_keygen_derivedkeys_t dataKeys;
 
     // Generate keys
-    nfc3d_amiibo_keygen(&amiiboKeys->tag, plain, &tagKeys);
-    nfc3d_amiibo_keygen(&amiiboKeys->data, plain, &dataKeys);
+    nfc3d_amiibo_keygen(ctx, plain, &dataKeys, &tagKeys);
 
     // Generate tag HMAC
     mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256)
@@ -126,20 +162,20 @@ void nfc3d_amiibo_pack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *pla
                    );
 
     // Init mbedtls HMAC context
-    mbedtls_md_context_t ctx;
-    mbedtls_md_init(&ctx);
-    mbedtls_md_setup(&ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
+    mbedtls_md_context_t hmac_ctx;
+    mbedtls_md_init(&hmac_ctx);
+    mbedtls_md_setup(&hmac_ctx, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1);
 
     // Generate data HMAC
-    mbedtls_md_hmac_starts(&ctx, dataKeys.hmacKey, sizeof(dataKeys.hmacKey));
-    mbedtls_md_hmac_update(&ctx, plain + 0x029, 0x18B);   // Data
-    mbedtls_md_hmac_update(&ctx, cipher + HMAC_POS_TAG, 0x20);   // Tag HMAC
-    mbedtls_md_hmac_update(&ctx, plain + 0x1D4, 0x34);   // Here be dragons
+    mbedtls_md_hmac_starts(&hmac_ctx, dataKeys.hmacKey, sizeof(dataKeys.hmacKey));
+    mbedtls_md_hmac_update(&hmac_ctx, plain + 0x029, 0x18B);   // Data
+    mbedtls_md_hmac_update(&hmac_ctx, cipher + HMAC_POS_TAG, 0x20);   // Tag HMAC
+    mbedtls_md_hmac_update(&hmac_ctx, plain + 0x1D4, 0x34);   // Here be dragons
 
-    mbedtls_md_hmac_finish(&ctx, cipher + HMAC_POS_DATA);
+    mbedtls_md_hmac_finish(&hmac_ctx, cipher + HMAC_POS_DATA);
 
     // HMAC cleanup
-    mbedtls_md_free(&ctx);
+    mbedtls_md_free(&hmac_ctx);
 
     // Encrypt
     nfc3d_amiibo_cipher(&dataKeys, plain, cipher);
@@ -148,16 +184,42 @@ void nfc3d_amiibo_pack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *pla
     nfc3d_amiibo_internal_to_tag(cipher, tag);
 }
 
+// the key file is read once,  again only when it changed
+static struct {
+    char *path;
+    time_t mtime;
+    off_t size;
+    nfc3d_amiibo_keys_t keys;
+} amiibo_keys_cache;
+
 bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys_t *amiiboKeys) {
 
+    char *path = NULL;
+    struct stat st;
+    if (searchFile(&path, RESOURCES_SUBDIR, AMIBOO_KEY_FN, "", true) == PM3_SUCCESS && stat(path, &st) != 0) {
+        free(path);
+        path = NULL;
+    }
+
+    if (path) {
+        if (amiibo_keys_cache.path && strcmp(amiibo_keys_cache.path, path) == 0 &&
+                amiibo_keys_cache.mtime == st.st_mtime && amiibo_keys_cache.size == st.st_size) {
+            memcpy(amiiboKeys, &amiibo_keys_cache.keys, sizeof(*amiiboKeys));
+            free(path);
+            return true;
+        }
+    }
+
     uint8_t *dump = NULL;
     size_t bytes_read = 0;
     if (loadFile_safe(AMIBOO_KEY_FN, "", (void **)&dump, &bytes_read) != PM3_SUCCESS) {
+        free(path);
         return false;
     }
 
     if (bytes_read != sizeof(*amiiboKeys)) {
         free(dump);
+        free(path);
         return false;
     }
 
@@ -165,9 +227,17 @@ bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys_t *amiiboKeys) {
     free(dump);
 
     if ((amiiboKeys->data.magicBytesSize > 16) || (amiiboKeys->tag.magicBytesSize > 16)) {
+        free(path);
         return false;
     }
 
+    free(amiibo_keys_cache.path);
+    amiibo_keys_cache.path = path;
+    if (path) {
+        amiibo_keys_cache.mtime = st.st_mtime;
+        amiibo_keys_cache.size = st.st_size;
+        memcpy(&amiibo_keys_cache.keys, amiiboKeys, sizeof(*amiiboKeys));
+    }
     return true;
 }
 
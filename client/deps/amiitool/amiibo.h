@@ -23,6 +23,28 @@ typedef struct {
 } nfc3d_amiibo_keys_t;
 #pragma pack()
 
+// derived keys of the last dumps,  unpack and pack of the same dump derive them once
+#define NFC3D_AMIIBO_CACHE_SIZE 4
+
+typedef struct {
+    bool valid;
+    uint8_t seed[NFC3D_KEYGEN_SEED_SIZE];
+    nfc3d_keygen_derivedkeys_t data;
+    nfc3d_keygen_derivedkeys_t tag;
+} nfc3d_amiibo_cache_t;
+
+// one per thread
+typedef struct {
+    nfc3d_keygen_prepared_t data;
+    nfc3d_keygen_prepared_t tag;
+    nfc3d_amiibo_cache_t cache[NFC3D_AMIIBO_CACHE_SIZE];
+    size_t cache_next;
+} nfc3d_amiibo_ctx_t;
+
+void nfc3d_amiibo_ctx_init(nfc3d_amiibo_ctx_t *ctx, const nfc3d_amiibo_keys_t *amiiboKeys);
+bool nfc3d_amiibo_unpack_ctx(nfc3d_amiibo_ctx_t *ctx, const uint8_t *tag, uint8_t *plain);
+void nfc3d_amiibo_pack_ctx(nfc3d_amiibo_ctx_t *ctx, const uint8_t *plain, uint8_t *tag);
+
 bool nfc3d_amiibo_unpack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *tag, uint8_t *plain);
 void nfc3d_amiibo_pack(const nfc3d_amiibo_keys_t *amiiboKeys, const uint8_t *plain, uint8_t *tag);
 bool nfc3d_amiibo_load_keys(nfc3d_amiibo_keys_t *amiiboKeys);
@@ -76,3 +76,57 @@ void nfc3d_drbg_generate_bytes(const uint8_t *hmacKey, size_t hmacKeySize, const
 
     nfc3d_drbg_cleanup(&rngCtx);
 }
+
+void nfc3d_drbg_hmac_init(nfc3d_drbg_hmac_t *hmac, const uint8_t *hmacKey, size_t hmacKeySize) {
+    assert(hmac != NULL);
+    assert(hmacKey != NULL);
+    assert(hmacKeySize <= 64);
+
+    uint8_t ipad[64], opad[64];
+    memset(ipad, 0x36, sizeof(ipad));
+    memset(opad, 0x5C, sizeof(opad));
+    for (size_t i = 0; i < hmacKeySize; i++) {
+        ipad[i] ^= hmacKey[i];
+        opad[i] ^= hmacKey[i];
+    }
+
+    mbedtls_sha256_init(&hmac->inner);
+    mbedtls_sha256_starts_ret(&hmac->inner, 0);
+    mbedtls_sha256_update_ret(&hmac->inner, ipad, sizeof(ipad));
+
+    mbedtls_sha256_init(&hmac->outer);
+    mbedtls_sha256_starts_ret(&hmac->outer, 0);
+    mbedtls_sha256_update_ret(&hmac->outer, opad, sizeof(opad));
+}
+
+// same output as nfc3d_drbg_generate_bytes() with the key of hmac
+void nfc3d_drbg_generate_bytes_hmac(const nfc3d_drbg_hmac_t *hmac, const uint8_t *seed, size_t seedSize, uint8_t *output, size_t outputSize) {
+    assert(hmac != NULL);
+    assert(seed != NULL);
+    assert(seedSize <= NFC3D_DRBG_MAX_SEED_SIZE);
+
+    uint8_t buffer[sizeof(uint16_t) + NFC3D_DRBG_MAX_SEED_SIZE];
+    memcpy(buffer + sizeof(uint16_t), seed, seedSize);
+
+    for (uint16_t iteration = 0; outputSize > 0; iteration++) {
+        uint8_t temp[NFC3D_DRBG_OUTPUT_SIZE];
+
+        // Store counter in big endian
+        buffer[0] = iteration >> 8;
+        buffer[1] = iteration >> 0;
+
+        mbedtls_sha256_context sha;
+        mbedtls_sha256_clone(&sha, &hmac->inner);
+        mbedtls_sha256_update_ret(&sha, buffer, sizeof(uint16_t) + seedSize);
+        mbedtls_sha256_finish_ret(&sha, temp);
+
+        mbedtls_sha256_clone(&sha, &hmac->outer);
+        mbedtls_sha256_update_ret(&sha, temp, sizeof(temp));
+        mbedtls_sha256_finish_ret(&sha, temp);
+
+        size_t n = (outputSize < NFC3D_DRBG_OUTPUT_SIZE) ? outputSize : NFC3D_DRBG_OUTPUT_SIZE;
+        memcpy(output, temp, n);
+        output += n;
+        outputSize -= n;
+    }
+}
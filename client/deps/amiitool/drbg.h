@@ -11,6 +11,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include "mbedtls/md.h"
+#include "mbedtls/sha256.h"
 
 #define NFC3D_DRBG_MAX_SEED_SIZE 480 /* Hardcoded max size in 3DS NFC module */
 #define NFC3D_DRBG_OUTPUT_SIZE   32  /* Every iteration generates 32 bytes */
@@ -24,10 +25,19 @@ typedef struct {
     size_t bufferSize;
 } nfc3d_drbg_ctx;
 
+// HMAC-SHA256 with the ipad / opad blocks already hashed,  for a key used over and over
+typedef struct {
+    mbedtls_sha256_context inner;
+    mbedtls_sha256_context outer;
+} nfc3d_drbg_hmac_t;
+
 void nfc3d_drbg_init(nfc3d_drbg_ctx *ctx, const uint8_t *hmacKey, size_t hmacKeySize, const uint8_t *seed, size_t seedSize);
 void nfc3d_drbg_step(nfc3d_drbg_ctx *ctx, uint8_t *output);
 void nfc3d_drbg_cleanup(nfc3d_drbg_ctx *ctx);
 void nfc3d_drbg_generate_bytes(const uint8_t *hmacKey, size_t hmacKeySize, const uint8_t *seed, size_t seedSize, uint8_t *output, size_t outputSize);
 
+void nfc3d_drbg_hmac_init(nfc3d_drbg_hmac_t *hmac, const uint8_t *hmacKey, size_t hmacKeySize);
+void nfc3d_drbg_generate_bytes_hmac(const nfc3d_drbg_hmac_t *hmac, const uint8_t *seed, size_t seedSize, uint8_t *output, size_t outputSize);
+
 #endif
 
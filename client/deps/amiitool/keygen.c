@@ -52,3 +52,16 @@ void nfc3d_keygen(const nfc3d_keygen_masterkeys_t *baseKeys, const uint8_t *base
     nfc3d_keygen_prepare_seed(baseKeys, baseSeed, preparedSeed, &preparedSeedSize);
     nfc3d_drbg_generate_bytes(baseKeys->hmacKey, sizeof(baseKeys->hmacKey), preparedSeed, preparedSeedSize, (uint8_t *) derivedKeys, sizeof(*derivedKeys));
 }
+
+void nfc3d_keygen_prepare(const nfc3d_keygen_masterkeys_t *baseKeys, nfc3d_keygen_prepared_t *prepared) {
+    memcpy(&prepared->keys, baseKeys, sizeof(prepared->keys));
+    nfc3d_drbg_hmac_init(&prepared->hmac, baseKeys->hmacKey, sizeof(baseKeys->hmacKey));
+}
+
+void nfc3d_keygen_prepared(const nfc3d_keygen_prepared_t *prepared, const uint8_t *baseSeed, nfc3d_keygen_derivedkeys_t *derivedKeys) {
+    uint8_t preparedSeed[NFC3D_DRBG_MAX_SEED_SIZE];
+    size_t preparedSeedSize;
+
+    nfc3d_keygen_prepare_seed(&prepared->keys, baseSeed, preparedSeed, &preparedSeedSize);
+    nfc3d_drbg_generate_bytes_hmac(&prepared->hmac, preparedSeed, preparedSeedSize, (uint8_t *) derivedKeys, sizeof(*derivedKeys));
+}
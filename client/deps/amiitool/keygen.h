@@ -9,6 +9,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "drbg.h"
 
 #define NFC3D_KEYGEN_SEED_SIZE 64
 
@@ -29,6 +30,14 @@ typedef struct {
 } nfc3d_keygen_derivedkeys_t;
 #pragma pack()
 
+// master keys with their HMAC ready,  for deriving keys of many dumps
+typedef struct {
+    nfc3d_keygen_masterkeys_t keys;
+    nfc3d_drbg_hmac_t hmac;
+} nfc3d_keygen_prepared_t;
+
 void nfc3d_keygen(const nfc3d_keygen_masterkeys_t *baseKeys, const uint8_t *baseSeed, nfc3d_keygen_derivedkeys_t *derivedKeys);
+void nfc3d_keygen_prepare(const nfc3d_keygen_masterkeys_t *baseKeys, nfc3d_keygen_prepared_t *prepared);
+void nfc3d_keygen_prepared(const nfc3d_keygen_prepared_t *prepared, const uint8_t *baseSeed, nfc3d_keygen_derivedkeys_t *derivedKeys);
 
 #endif
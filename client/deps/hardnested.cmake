@@ -16,8 +16,9 @@ target_compile_definitions(pm3rrg_rdv4_hardnested_nosimd PRIVATE NOSIMD_BUILD)
 ## These are mostly for x86-based architectures, which is not useful for many Android devices.
 ## Mingw platforms: AMD64
 set(X86_CPUS x86 x86_64 i686 AMD64)
-set(ARM64_CPUS arm64 aarch64)
-set(ARM32_CPUS armel armhf armv7-a)
+## Windows on ARM: ARM64,  Raspberry Pi OS and other 32 bit Linux: armv6l armv7l
+set(ARM64_CPUS arm64 aarch64 ARM64)
+set(ARM32_CPUS armel armhf armv7-a armv6l armv7l)
 
 message(STATUS "CMAKE_SYSTEM_PROCESSOR := ${CMAKE_SYSTEM_PROCESSOR}")
 
@@ -162,5 +163,6 @@ target_include_directories(pm3rrg_rdv4_hardnested PRIVATE
         ../../include
         ../include
         ../src
+        hardnested
         jansson)
 target_include_directories(pm3rrg_rdv4_hardnested INTERFACE hardnested)
@@ -65,7 +65,16 @@ THE SOFTWARE.
 #if defined(__arm64__) || defined(__aarch64__)
 #define COMPILER_HAS_SIMD_NEON
 #define arm_has_neon() (true)
-// ARMv7 or older, NEON is optional and autodetection is difficult
+// ARMv7 or older, NEON is optional. The NEON objects are built with -mfpu=neon while the
+// dispatcher isn't,  so on Linux ask the kernel through the hwcaps instead of relying on __ARM_NEON
+#elif defined(__arm__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#define COMPILER_HAS_SIMD_NEON
+#define arm_has_neon() ((getauxval(AT_HWCAP) & HWCAP_NEON) != 0)
+// elsewhere autodetection is difficult
 #elif defined(__ARM_NEON)
 #define COMPILER_HAS_SIMD_NEON
 #define arm_has_neon() (false)
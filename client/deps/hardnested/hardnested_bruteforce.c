@@ -67,6 +67,8 @@ THE SOFTWARE.
 #include "parity.h"
 #include "fileutils.h"
 #include "pm3_cmd.h"
+#include "hardnested_opencl.h"
+#include "hardnesteddist.h"
 
 #define NUM_BRUTE_FORCE_THREADS         (num_CPUs())
 #define DEFAULT_BRUTE_FORCE_RATE        (120000000.0) // if benchmark doesn't succeed
@@ -79,6 +81,8 @@ THE SOFTWARE.
 // #define DEBUG_BRUTE_FORCE
 
 #define MIN_BUCKETS_SIZE                128
+#define WORK_PARTS_PER_THREAD           16            // split the buckets into about this many work parts per thread
+#define MIN_WORK_ODD_STATES             64            // but don't cut parts with less odd states, each part bitslices its even states again
 
 typedef enum {
     EVEN_STATE = 0,
@@ -95,6 +99,17 @@ static statelist_t **buckets = NULL;
 static uint32_t keys_found = 0;
 static uint64_t num_keys_tested;
 static uint64_t found_bs_key = 0;
+static bool brute_force_gpu = false;
+static uint16_t brute_force_dist_port = 0;
+
+// a range of odd states of a bucket,  sharing the bucket's even states
+typedef struct {
+    statelist_t part;
+    uint64_t size;
+} bf_work_t;
+static bf_work_t *work = NULL;
+static uint32_t work_count = 0;
+static uint32_t work_next = 0;
 
 uint8_t trailing_zeros(uint8_t byte) {
     static const uint8_t trailing_zeros_LUT[256] = {
@@ -160,39 +175,41 @@ crack_states_thread(void *x) {
         uint8_t *best_first_bytes;
     } *thread_arg;
 
-    const int num_brute_force_threads = NUM_BRUTE_FORCE_THREADS;
     thread_arg = (struct arg *)x;
+#if defined (DEBUG_BRUTE_FORCE)
     const int thread_id = thread_arg->thread_ID;
-    uint32_t current_bucket = thread_id;
-    while (current_bucket < bucket_count) {
-        statelist_t *bucket = buckets[current_bucket];
-        if (bucket) {
+#endif
+    // the parts are sorted largest first and handed out one by one, a thread which is done early takes the next one
+    while (keys_found == 0) {
+        uint32_t current_work = __atomic_fetch_add(&work_next, 1, __ATOMIC_SEQ_CST);
+        if (current_work >= work_count) {
+            break;
+        }
+        statelist_t *bucket = &work[current_work].part;
 #if defined (DEBUG_BRUTE_FORCE)
-            PrintAndLogEx(INFO, "Thread " _YELLOW_("%u") " starts working on bucket " _YELLOW_("%u") "\n", thread_id, current_bucket);
+        PrintAndLogEx(INFO, "Thread " _YELLOW_("%u") " starts working on part " _YELLOW_("%u") "\n", thread_id, current_work);
 #endif
-            const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
-            if (key != -1) {
-                __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
-                __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
-
+        const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
+        if (key != -1) {
+            __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
+
+            char progress_text[80];
+            char keystr[19];
+            snprintf(keystr, sizeof(keystr), "%012" PRIX64 "  ", key);
+            snprintf(progress_text, sizeof(progress_text), "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
+            hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
+            break;
+        } else if (keys_found) {
+            break;
+        } else {
+            if (!thread_arg->silent) {
                 char progress_text[80];
-                char keystr[19];
-                snprintf(keystr, sizeof(keystr), "%012" PRIX64 "  ", key);
-                snprintf(progress_text, sizeof(progress_text), "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
-                hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
-                break;
-            } else if (keys_found) {
-                break;
-            } else {
-                if (!thread_arg->silent) {
-                    char progress_text[80];
-                    snprintf(progress_text, sizeof(progress_text), "Brute force phase: %6.02f%%  ", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
-                    float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
-                    hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
-                }
+                snprintf(progress_text, sizeof(progress_text), "Brute force phase: %6.02f%%  ", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
+                float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
+                hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
             }
         }
-        current_bucket += num_brute_force_threads;
     }
     return NULL;
 }
@@ -298,6 +315,142 @@ static void write_benchfile(statelist_t *candidates) {
 #endif
 
 
+void brute_force_use_gpu(bool enable) {
+    brute_force_gpu = enable;
+}
+
+// 0 = off,  else remote workers may take parts of the brute force, see hardnesteddist.c
+void brute_force_distribute(uint16_t port) {
+    brute_force_dist_port = port;
+}
+
+// next part for a remote worker,  taken from the same queue as the local threads
+bool brute_force_next_part(statelist_t *part) {
+    if (keys_found) {
+        return false;
+    }
+    uint32_t current_work = __atomic_fetch_add(&work_next, 1, __ATOMIC_SEQ_CST);
+    if (current_work >= work_count) {
+        return false;
+    }
+    *part = work[current_work].part;
+    return true;
+}
+
+void brute_force_part_done(uint64_t tested, uint64_t key) {
+    __atomic_fetch_add(&num_keys_tested, tested, __ATOMIC_SEQ_CST);
+    if (key != -1) {
+        __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
+    }
+}
+
+bool brute_force_key_found(void) {
+    return (keys_found != 0);
+}
+
+// crack a part here when its remote worker went away
+uint64_t brute_force_crack_part(statelist_t *part, uint32_t cuid, noncelist_t *nonces, uint8_t *best_first_bytes) {
+    return crack_states_bitsliced(cuid, best_first_bytes, part, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, nonces);
+}
+
+// one bucket after the other on the OpenCL device,  the device runs the states of a bucket in parallel
+static int brute_force_opencl(uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes) {
+    int res = hardnested_opencl_init();
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    res = hardnested_opencl_set_tests(bf_test_nonce, bf_test_nonce_par, nonces_to_bruteforce);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    for (uint32_t i = 0; i < bucket_count; i++) {
+        uint64_t key = -1;
+        res = hardnested_opencl_crack(buckets[i], cuid, nonces, best_first_bytes, &num_keys_tested, &key);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+
+        if (key != -1) {
+            keys_found = 1;
+            found_bs_key = key;
+
+            char progress_text[80];
+            char keystr[19];
+            snprintf(keystr, sizeof(keystr), "%012" PRIX64 "  ", key);
+            snprintf(progress_text, sizeof(progress_text), "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
+            hardnested_print_progress(num_acquired_nonces, progress_text, 0.0, 0);
+            break;
+        }
+
+        char progress_text[80];
+        snprintf(progress_text, sizeof(progress_text), "Brute force phase: %6.02f%%  ", 100.0 * (float)num_keys_tested / (float)(maximum_states));
+        float remaining_bruteforce = nonces[best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
+        hardnested_print_progress(num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
+    }
+    return PM3_SUCCESS;
+}
+
+
+static int work_cmp(const void *a, const void *b) {
+    const bf_work_t *x = a;
+    const bf_work_t *y = b;
+    if (x->size == y->size) {
+        return 0;
+    }
+    return (x->size > y->size) ? -1 : 1;
+}
+
+// cut the buckets into parts of similar size, so no thread is left alone with a huge bucket at the end
+static bool prepare_work(int num_threads) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < bucket_count; i++) {
+        total += (uint64_t)buckets[i]->len[ODD_STATE] * buckets[i]->len[EVEN_STATE];
+    }
+    uint64_t part_size = total / ((uint64_t)num_threads * WORK_PARTS_PER_THREAD);
+    if (part_size == 0) {
+        part_size = 1;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        count = 0;
+        for (uint32_t i = 0; i < bucket_count; i++) {
+            statelist_t *bucket = buckets[i];
+            const uint32_t odd_len = bucket->len[ODD_STATE];
+            uint64_t size = (uint64_t)odd_len * bucket->len[EVEN_STATE];
+            uint32_t odd_per_part = MAX(MIN_WORK_ODD_STATES, (uint32_t)MIN(odd_len, (part_size + bucket->len[EVEN_STATE] - 1) / bucket->len[EVEN_STATE]));
+            if (size <= part_size) {
+                odd_per_part = odd_len;
+            }
+            for (uint32_t start = 0; start < odd_len; start += odd_per_part) {
+                if (pass) {
+                    bf_work_t *w = &work[count];
+                    w->part = *bucket;
+                    w->part.states[ODD_STATE] = bucket->states[ODD_STATE] + start;
+                    w->part.len[ODD_STATE] = MIN(odd_per_part, odd_len - start);
+                    w->part.next = NULL;
+                    w->size = (uint64_t)w->part.len[ODD_STATE] * bucket->len[EVEN_STATE];
+                }
+                count++;
+            }
+        }
+        if (pass == 0) {
+            work = calloc(count ? count : 1, sizeof(bf_work_t));
+            if (work == NULL) {
+                return false;
+            }
+        }
+    }
+
+    qsort(work, count, sizeof(bf_work_t), work_cmp);
+    work_count = count;
+    work_next = 0;
+    return true;
+}
+
+
 static bool ensure_buckets_alloc(size_t need_buckets) {
     if (need_buckets > buckets_allocated) {
         size_t alloc_sz = ((buckets_allocated == 0) ? MIN_BUCKETS_SIZE : (buckets_allocated * 2));
@@ -349,11 +502,40 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 
     uint64_t start_time = msclock();
 
+    // the benchmark (bf_rate set) always measures the CPU cores
+    if (brute_force_gpu && silent == false) {
+        int res = brute_force_opencl(cuid, num_acquired_nonces, maximum_states, nonces, best_first_bytes);
+        if (res == PM3_SUCCESS) {
+            free(buckets);
+            buckets = NULL;
+            buckets_allocated = 0;
+            if (keys_found > 0)
+                *found_key = found_bs_key;
+            return (keys_found != 0);
+        }
+        PrintAndLogEx(WARNING, "OpenCL brute force failed, falling back to CPU");
+        num_keys_tested = 0;
+    }
+
 #if defined(__linux__) ||  defined(__APPLE__)
     if (NUM_BRUTE_FORCE_THREADS < 0)
         return false;
 #endif
 
+    if (prepare_work(num_brute_force_threads) == false) {
+        PrintAndLogEx(ERR, "Can't allocate brute force work, abort!");
+        free(buckets);
+        buckets = NULL;
+        buckets_allocated = 0;
+        return false;
+    }
+
+    // the benchmark never waits for remote workers
+    bool distributed = false;
+    if (brute_force_dist_port && silent == false) {
+        distributed = (hardnested_dist_start(brute_force_dist_port, cuid, nonces, best_first_bytes) == PM3_SUCCESS);
+    }
+
     pthread_t threads[num_brute_force_threads];
     struct args {
         bool silent;
@@ -379,6 +561,14 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
         pthread_join(threads[i], 0);
     }
 
+    // parts still out on remote workers may hold the key
+    if (distributed) {
+        hardnested_dist_stop();
+    }
+
+    free(work);
+    work = NULL;
+    work_count = 0;
     free(buckets);
     buckets = NULL;
     buckets_allocated = 0;
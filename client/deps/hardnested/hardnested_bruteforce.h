@@ -54,6 +54,12 @@ typedef struct {
 } statelist_t;
 
 void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte);
+void brute_force_use_gpu(bool enable);
+void brute_force_distribute(uint16_t port);
+bool brute_force_next_part(statelist_t *part);
+void brute_force_part_done(uint64_t tested, uint64_t key);
+bool brute_force_key_found(void);
+uint64_t brute_force_crack_part(statelist_t *part, uint32_t cuid, noncelist_t *nonces, uint8_t *best_first_bytes);
 bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key);
 float brute_force_benchmark(void);
 uint8_t trailing_zeros(uint8_t byte);
@@ -198,6 +198,51 @@ bool id48lib_key_recovery_next(
     ID48LIB_KEY *potential_key_output
 );
 
+/// <summary>
+/// id48lib_key_recovery_partition() splits the search for K₄₇..K₀₀
+/// into this many independent partitions, one for each value of K₄₇..K₄₀.
+/// </summary>
+#define ID48LIB_RECOVERY_PARTITIONS (256u)
+/// <summary>
+/// Re-entrant alternative to id48lib_key_recovery_init() and
+/// id48lib_key_recovery_next().  Finds all potential keys where
+/// K₄₇..K₄₀ equals `partition`.  No state is kept between calls,
+/// so different partitions can be searched on different threads,
+/// and the results of all ID48LIB_RECOVERY_PARTITIONS partitions
+/// (in ascending order) match the keys returned by repeated calls to
+/// id48lib_key_recovery_next().
+/// </summary>
+/// <param name="partition">
+/// The value of K₄₇..K₄₀ to search.
+/// </param>
+/// <param name="potential_keys_output">
+/// Caller-provided storage for up to `max_potential_keys` keys.
+/// Keys are stored in ascending order.
+/// </param>
+/// <param name="max_potential_keys">
+/// Count of keys that fit into potential_keys_output.
+/// </param>
+/// <param name="abort_search">
+/// Optional (may be NULL).  When the pointed-to value becomes true
+/// (e.g., another thread found too many keys) the search stops early,
+/// and the returned count is incomplete.
+/// </param>
+/// <returns>
+/// Count of potential keys found in this partition.  This may be
+/// larger than max_potential_keys, in which case only the first
+/// max_potential_keys were stored.
+/// </returns>
+size_t id48lib_key_recovery_partition(
+    const ID48LIB_KEY *input_partial_key,
+    const ID48LIB_NONCE *input_nonce,
+    const ID48LIB_FRN *input_frn,
+    const ID48LIB_GRN *input_grn,
+    uint8_t partition,
+    ID48LIB_KEY *potential_keys_output,
+    size_t max_potential_keys,
+    const volatile bool *abort_search
+);
+
 #if defined(__cplusplus)
 }
 #endif
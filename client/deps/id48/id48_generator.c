@@ -855,6 +855,115 @@ static void retro_generator_impl(
     return;
 }
 
+#pragma region    // successor state for several registers at once
+// Same transition as calculate_successor_state(), written without branches
+// so that each lane of a vector holds one state register.  The bit positions
+// are the ones of the unstable register, i.e. after the `<< 1` step.
+#if defined(__AVX512F__)
+#define ID48LIBX_LANES 8
+#elif defined(__AVX2__)
+#define ID48LIBX_LANES 4
+#else
+#define ID48LIBX_LANES 2
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+typedef uint64_t __attribute__((vector_size(ID48LIBX_LANES * 8))) ID48LIBX_VEC;
+#else
+// no vector extension, one lane is still correct
+#undef  ID48LIBX_LANES
+#define ID48LIBX_LANES 1
+typedef uint64_t ID48LIBX_VEC;
+#endif
+
+#define VBIT(v, n) (((v) >> (n)) & 1u)
+
+static inline ID48LIBX_VEC calculate_successor_state_vec(ID48LIBX_VEC ssr, uint64_t i, ID48LIBX_VEC *output_index) {
+    // 1. ssr_new = ssr_old << 1;
+    const ID48LIBX_VEC u = ssr << 1;
+
+    // 3. temporaries, see calculate_temporaries()
+    const ID48LIBX_VEC h00 =
+        (VBIT(u, SSR_UNSTABLE_OLD_BIT_H01) & VBIT(u, SSR_UNSTABLE_OLD_BIT_H08)) ^
+        (VBIT(u, SSR_UNSTABLE_OLD_BIT_H09) & VBIT(u, SSR_UNSTABLE_OLD_BIT_H11)) ^
+        VBIT(~u, SSR_UNSTABLE_OLD_BIT_H12);
+
+    ID48LIBX_VEC x0 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G00);
+    ID48LIBX_VEC x1 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G04);
+    ID48LIBX_VEC x2 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G06);
+    ID48LIBX_VEC x3 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G13);
+    ID48LIBX_VEC x4 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G18);
+    ID48LIBX_VEC x5 = VBIT(u, SSR_UNSTABLE_OLD_BIT_H03);
+    const ID48LIBX_VEC a =
+        ((~x0 & ~x2 &  x3) | (x2 &  x4 & ~x5) | (x0 & ~x1 & ~x4) | (x1 & ~x3 &  x5)) ^
+        VBIT(u, SSR_UNSTABLE_OLD_BIT_G22) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_R02) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_R06);
+
+    x0 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G01);
+    x1 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G05);
+    x2 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G10);
+    x3 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G15);
+    x4 = VBIT(u, SSR_UNSTABLE_OLD_BIT_H00);
+    x5 = VBIT(u, SSR_UNSTABLE_OLD_BIT_H07);
+    const ID48LIBX_VEC b =
+        ((x1 & ~x2 & ~x4) | (x0 &  x2 & ~x3) | (~x1 &  x3 &  x5) | (~x0 &  x4 & ~x5)) ^
+        VBIT(u, SSR_UNSTABLE_OLD_BIT_L00) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_L03) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_L06);
+
+    x0 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G02);
+    x1 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G03) ^ i;
+    x2 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G09);
+    x3 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G14);
+    x4 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G16);
+    x5 = VBIT(u, SSR_UNSTABLE_OLD_BIT_H01);
+    const ID48LIBX_VEC c =
+        ((x1 &  x3 & ~x5) | (x2 & ~x3 & ~x4) | (~x0 & ~x2 &  x5) | (x0 & ~x1 &  x4)) ^
+        VBIT(u, SSR_UNSTABLE_OLD_BIT_M00) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_M03) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_M06);
+
+    const ID48LIBX_VEC j =
+        VBIT(u, SSR_UNSTABLE_OLD_BIT_L01) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_M06) ^
+        VBIT(u, SSR_UNSTABLE_OLD_BIT_H02) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_H08) ^ VBIT(u, SSR_UNSTABLE_OLD_BIT_H12);
+
+    // 4. output index, see calculate_output_index()
+    *output_index = (a << 19) | (b << 18) | (c << 17) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_L00) << 16) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_L02) << 15) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_L03) << 14) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_L04) << 13) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_L05) << 12) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_L06) << 11) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_M00) << 10) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_M01) <<  9) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_M03) <<  8) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_M05) <<  7) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R00) <<  6) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R01) <<  5) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R02) <<  4) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R03) <<  3) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R04) <<  2) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R05) <<  1) |
+                    (VBIT(u, SSR_UNSTABLE_OLD_BIT_R06) <<  0);
+
+    // 5. to 8. G(g, i, j), then l, m and r take a, b and c
+    //     G_XOR_MASK is the taps of g_successor() without g₀₀, which is set from j below
+    static const uint64_t G_XOR_MASK = 0x0000000240D00000ull;
+    static const uint64_t KEEP_MASK  = SSR_BITMASK_REG_ALL & ~(
+                                           (1ull << SSR_BIT_H00) |
+                                           (1ull << SSR_BIT_G00) |
+                                           (1ull << SSR_BIT_L00) |
+                                           (1ull << SSR_BIT_M00) |
+                                           (1ull << SSR_BIT_R00)
+                                       );
+    const ID48LIBX_VEC g22 = VBIT(u, SSR_UNSTABLE_OLD_BIT_G22);
+    return ((u & KEEP_MASK) ^ ((-g22) & G_XOR_MASK) ^ (i << SSR_BIT_G04)) |
+           (h00 << SSR_BIT_H00) |
+           ((j ^ g22) << SSR_BIT_G00) |
+           (a << SSR_BIT_L00) |
+           (b << SSR_BIT_M00) |
+           (c << SSR_BIT_R00) |
+           1u;
+}
+#undef VBIT
+#pragma endregion // successor state for several registers at once
+
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ******************************************************************************************************************** //
@@ -887,6 +996,40 @@ ID48LIBX_STATE_REGISTERS  id48libx_retro003_init(const ID48LIB_KEY *key, const I
     result.Raw = ssr.Raw;
     return result;
 }
+// internal function
+void id48libx_retro003_successor_batch(
+    const ID48LIBX_STATE_REGISTERS *initial_states,
+    ID48LIBX_STATE_REGISTERS *successor_states,
+    uint8_t *output_bits,
+    size_t count,
+    uint8_t input_bit
+) {
+    ASSERT(initial_states != nullptr);
+    ASSERT(successor_states != nullptr);
+    ASSERT(output_bits != nullptr);
+    const uint64_t i = !!input_bit;
+    for (size_t n = 0; n < count; n += ID48LIBX_LANES) {
+        const size_t lanes = (count - n < ID48LIBX_LANES) ? (count - n) : ID48LIBX_LANES;
+
+        // unused lanes of the last vector get a copy of the first state
+        uint64_t ssr[ID48LIBX_LANES];
+        for (size_t l = 0; l < ID48LIBX_LANES; l++) {
+            ssr[l] = initial_states[n + ((l < lanes) ? l : 0)].Raw;
+        }
+
+        ID48LIBX_VEC v, v_index;
+        memcpy(&v, ssr, sizeof(v));
+        v = calculate_successor_state_vec(v, i, &v_index);
+
+        uint64_t output_index[ID48LIBX_LANES];
+        memcpy(ssr, &v, sizeof(v));
+        memcpy(output_index, &v_index, sizeof(v_index));
+        for (size_t l = 0; l < lanes; l++) {
+            successor_states[n + l].Raw = ssr[l];
+            output_bits[n + l] = id48libx_output_lookup((uint32_t)output_index[l]);
+        }
+    }
+}
 
 // public API
 void id48lib_generator(
@@ -196,6 +196,17 @@ static bool get_expected_output_bit(const RECOVERY_STATE *recovery_state, uint8_
     return !!(shifted & 0x1u); // return the single bit result
 }
 
+/// <summary>
+/// As get_expected_output_bit(), for callers that only keep the expected output bits.
+/// </summary>
+static bool test_expected_output_bit(const EXPECTED_OUTPUT_BITS *expected_output_bits, uint8_t current_state_index) {
+    ASSERT(expected_output_bits != nullptr);
+    ASSERT(current_state_index >= 7);
+    ASSERT(current_state_index <= 55);
+    uint64_t shifted = expected_output_bits->Raw >> (current_state_index - 7u);
+    return !!(shifted & 0x1u); // return the single bit result
+}
+
 static void restart_and_calculate_s00(RECOVERY_STATE *s, const KEY_BITS_K47_TO_K00 *k_low) {
     ASSERT(s != nullptr);
     ASSERT(k_low != nullptr);
@@ -412,6 +423,126 @@ static bool get_next_potential_key(
 
 
 
+#pragma region    // partitioned (re-entrant) key recovery
+/// <summary>
+/// Parent states are stepped this many at a time.  Each parent with
+/// a key bit left to guess has two children, so the child buffer
+/// for the next level is twice as large.  Bounds the stack used by
+/// search_partition_level() to roughly 56 levels of these buffers.
+/// </summary>
+#define RECOVERY_BATCH_PARENTS (32u)
+
+typedef struct _RECOVERY_PARTITION {
+    /// <summary>
+    /// What are the 48 expected output bits?
+    /// Stored as 0¹⁶·O₄₇..O₀₀.
+    /// </summary>
+    EXPECTED_OUTPUT_BITS expected_output_bits;
+    /// <summary>
+    /// The 48-bit partial key to recover the remaining 48 bits of.
+    /// </summary>
+    ID48LIB_KEY known_k95_to_k48;
+    /// <summary>
+    /// Caller-provided storage for the potential keys.
+    /// Keys beyond max_potential_keys are counted, but not stored.
+    /// </summary>
+    ID48LIB_KEY *potential_keys_output;
+    size_t max_potential_keys;
+    size_t potential_key_count;
+    /// <summary>
+    /// Optional, set by another thread to stop the search early.
+    /// </summary>
+    const volatile bool *abort_search;
+} RECOVERY_PARTITION;
+
+static void store_potential_key(RECOVERY_PARTITION *p, const KEY_BITS_K47_TO_K00 *k_low) {
+    if (p->potential_key_count < p->max_potential_keys) {
+        ID48LIB_KEY *potential_key_output = &(p->potential_keys_output[p->potential_key_count]);
+        potential_key_output->k[ 0] = p->known_k95_to_k48.k[0];
+        potential_key_output->k[ 1] = p->known_k95_to_k48.k[1];
+        potential_key_output->k[ 2] = p->known_k95_to_k48.k[2];
+        potential_key_output->k[ 3] = p->known_k95_to_k48.k[3];
+        potential_key_output->k[ 4] = p->known_k95_to_k48.k[4];
+        potential_key_output->k[ 5] = p->known_k95_to_k48.k[5];
+        potential_key_output->k[ 6] = (uint8_t)(k_low->Raw >> (8 * 5));
+        potential_key_output->k[ 7] = (uint8_t)(k_low->Raw >> (8 * 4));
+        potential_key_output->k[ 8] = (uint8_t)(k_low->Raw >> (8 * 3));
+        potential_key_output->k[ 9] = (uint8_t)(k_low->Raw >> (8 * 2));
+        potential_key_output->k[10] = (uint8_t)(k_low->Raw >> (8 * 1));
+        potential_key_output->k[11] = (uint8_t)(k_low->Raw >> (8 * 0));
+    }
+    ++(p->potential_key_count);
+}
+
+/// <summary>
+/// Same search as get_next_potential_key(), but breadth first over small
+/// groups of states, so that all states of a group are stepped together
+/// by id48libx_retro003_successor_batch().  Children are kept in the order
+/// (input 0, input 1) of each parent, so potential keys are found in the
+/// same (ascending) order as the depth first search.
+/// </summary>
+/// <param name="src_idx">index of the parent states, s₀₀..s₅₅</param>
+static void search_partition_level(
+    RECOVERY_PARTITION *p,
+    uint8_t src_idx,
+    const ID48LIBX_STATE_REGISTERS *states,
+    const KEY_BITS_K47_TO_K00 *keys,
+    size_t count
+) {
+    ASSERT(src_idx <= 55);
+    if (src_idx == 55) {
+        // s₄₀..s₅₄ all matched with zero input bits ... potential keys!
+        for (size_t i = 0; i < count; ++i) {
+            store_potential_key(p, &(keys[i]));
+        }
+        return;
+    }
+    if ((p->abort_search != nullptr) && *(p->abort_search)) {
+        return;
+    }
+
+    // K₃₉..K₀₀ are the inputs for s₀₀..s₃₉, followed by fifteen zero bits.
+    // Output bits are not exposed before s₀₇, so those transitions are unconditional.
+    const bool    two_inputs    = src_idx < 40;
+    const bool    check_output  = src_idx >= 7;
+    const uint8_t key_bit_shift = two_inputs ? (uint8_t)(39 - src_idx) : 0;
+    const bool    expected      = check_output ? test_expected_output_bit(&(p->expected_output_bits), src_idx) : false;
+
+    ID48LIBX_STATE_REGISTERS next0[RECOVERY_BATCH_PARENTS];
+    ID48LIBX_STATE_REGISTERS next1[RECOVERY_BATCH_PARENTS];
+    uint8_t                  out0[RECOVERY_BATCH_PARENTS];
+    uint8_t                  out1[RECOVERY_BATCH_PARENTS];
+    ID48LIBX_STATE_REGISTERS children[2 * RECOVERY_BATCH_PARENTS];
+    KEY_BITS_K47_TO_K00      children_keys[2 * RECOVERY_BATCH_PARENTS];
+
+    for (size_t first = 0; first < count; first += RECOVERY_BATCH_PARENTS) {
+        const size_t n = ((count - first) < RECOVERY_BATCH_PARENTS) ? (count - first) : RECOVERY_BATCH_PARENTS;
+
+        id48libx_retro003_successor_batch(&(states[first]), next0, out0, n, 0);
+        if (two_inputs) {
+            id48libx_retro003_successor_batch(&(states[first]), next1, out1, n, 1);
+        }
+
+        size_t c = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (!check_output || ((!!out0[i]) == expected)) {
+                children[c] = next0[i];
+                children_keys[c] = keys[first + i];
+                ++c;
+            }
+            if (two_inputs && (!check_output || ((!!out1[i]) == expected))) {
+                children[c] = next1[i];
+                children_keys[c].Raw = keys[first + i].Raw | (1ull << key_bit_shift);
+                ++c;
+            }
+        }
+        if (c != 0) {
+            search_partition_level(p, (uint8_t)(src_idx + 1), children, children_keys, c);
+        }
+    }
+}
+#pragma endregion // partitioned (re-entrant) key recovery
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ******************************************************************************************************************** //
 // *** Everything above this line in the file is declared static,                                                   *** //
@@ -435,3 +566,36 @@ bool id48lib_key_recovery_next(
 ) {
     return get_next_potential_key(potential_key_output);
 }
+size_t id48lib_key_recovery_partition(
+    const ID48LIB_KEY    *input_partial_key,
+    const ID48LIB_NONCE *input_nonce,
+    const ID48LIB_FRN    *input_frn,
+    const ID48LIB_GRN    *input_grn,
+    uint8_t               partition,
+    ID48LIB_KEY          *potential_keys_output,
+    size_t                max_potential_keys,
+    const volatile bool  *abort_search
+) {
+    // all state is on the stack, so this can run on many threads at once
+    RECOVERY_PARTITION p;
+    memset(&p, 0, sizeof(RECOVERY_PARTITION));
+    p.known_k95_to_k48.k[0] = input_partial_key->k[0];
+    p.known_k95_to_k48.k[1] = input_partial_key->k[1];
+    p.known_k95_to_k48.k[2] = input_partial_key->k[2];
+    p.known_k95_to_k48.k[3] = input_partial_key->k[3];
+    p.known_k95_to_k48.k[4] = input_partial_key->k[4];
+    p.known_k95_to_k48.k[5] = input_partial_key->k[5];
+    p.expected_output_bits = create_expected_output_bits(input_frn, input_grn);
+    p.potential_keys_output = potential_keys_output;
+    p.max_potential_keys = (potential_keys_output != nullptr) ? max_potential_keys : 0;
+    p.abort_search = abort_search;
+
+    // the partition is K₄₇..K₄₀, which selects s₀₀
+    KEY_BITS_K47_TO_K00 k_low;
+    k_low.Raw = ((uint64_t)partition) << 40;
+    const ID48LIB_KEY start_56b_key = create_partial_key56(&(p.known_k95_to_k48), partition);
+    const ID48LIBX_STATE_REGISTERS s00 = init_fn(&start_56b_key, input_nonce);
+
+    search_partition_level(&p, 0, &s00, &k_low, 1);
+    return p.potential_key_count;
+}
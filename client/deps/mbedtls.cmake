@@ -1,5 +1,6 @@
 add_library(pm3rrg_rdv4_mbedtls STATIC
         ../../common/mbedtls/aes.c
+        ../../common/mbedtls/aesni.c
         ../../common/mbedtls/asn1parse.c
         ../../common/mbedtls/asn1write.c
         ../../common/mbedtls/base64.c
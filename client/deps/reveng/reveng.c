@@ -49,16 +49,34 @@
  */
 
 #include <stdlib.h>
+#include <pthread.h>
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <unistd.h>
+#endif
 
 #define FILE void
 #include "reveng.h"
 
+/* Polys tested per work unit of the threaded search, divides R_SPMASK + 1 */
+#define R_CHUNK 16384UL
+/* Work units finished but not yet handed to the main thread */
+#define R_RING 64
+/* 0 = one worker per CPU */
+#ifndef REVENG_THREADS
+#  define REVENG_THREADS 0
+#endif
+
 static poly_t *modpol(const poly_t init, int rflags, int args, const poly_t *argpolys);
 static void engini(int *resc, model_t **result, const poly_t divisor, int flags, int args, const poly_t *argpolys);
 static void calout(int *resc, model_t **result, const poly_t divisor, const poly_t init, int flags, int args, const poly_t *argpolys);
 static void calini(int *resc, model_t **result, const poly_t divisor, int flags, const poly_t xorout, int args, const poly_t *argpolys);
 static void chkres(int *resc, model_t **result, const poly_t divisor, const poly_t init, int flags, const poly_t xorout, int args, const poly_t *argpolys);
 
+static void candid(int *resc, model_t **result, const poly_t gpoly, const model_t *guess, int rflags, int args, const poly_t *argpolys);
+static int polysrch(int *resc, model_t **result, const poly_t gpoly, const model_t *guess, const poly_t qpoly, int rflags, int args, const poly_t *argpolys, const poly_t *pworks);
+
 static const poly_t pzero = PZERO;
 
 model_t *
@@ -87,6 +105,10 @@ reveng(const model_t *guess, const poly_t qpoly, int rflags, int args, const pol
         if (plen(gpoly))
             pshift(&gpoly, gpoly, 0UL, 0UL, plen(gpoly) - 1UL, 1UL);
 
+        /* split the poly range over several threads if we can */
+        if (polysrch(&resc, &result, gpoly, guess, qpoly, rflags, args, argpolys, pworks))
+            goto srchdone;
+
         while (piter(&gpoly) && (~rflags & R_HAVEQ || pcmp(&gpoly, &qpoly) < 0)) {
             /* For each possible poly of this size, try
              * dividing all the differences in the list.
@@ -109,18 +131,12 @@ reveng(const model_t *guess, const poly_t qpoly, int rflags, int args, const pol
              */
             if (!plen(*wptr)) {
                 /* gpoly is a candidate poly */
-                if (rflags & R_HAVEI && rflags & R_HAVEX)
-                    chkres(&resc, &result, gpoly, guess->init, guess->flags, guess->xorout, args, argpolys);
-                else if (rflags & R_HAVEI)
-                    calout(&resc, &result, gpoly, guess->init, guess->flags, args, argpolys);
-                else if (rflags & R_HAVEX)
-                    calini(&resc, &result, gpoly, guess->flags, guess->xorout, args, argpolys);
-                else
-                    engini(&resc, &result, gpoly, guess->flags, args, argpolys);
+                candid(&resc, &result, gpoly, guess, rflags, args, argpolys);
             }
             if (!piter(&gpoly))
                 break;
         }
+srchdone:
         /* Finished with gpoly and the differences list, free them.
          */
         pfree(&gpoly);
@@ -157,6 +173,251 @@ requit:
     return (result);
 }
 
+static void
+candid(int *resc, model_t **result, const poly_t gpoly, const model_t *guess, int rflags, int args, const poly_t *argpolys) {
+    /* gpoly divides all the differences.  Search for an Init value
+     * for this poly or if Init is known, log the result.
+     */
+    if (rflags & R_HAVEI && rflags & R_HAVEX)
+        chkres(resc, result, gpoly, guess->init, guess->flags, guess->xorout, args, argpolys);
+    else if (rflags & R_HAVEI)
+        calout(resc, result, gpoly, guess->init, guess->flags, args, argpolys);
+    else if (rflags & R_HAVEX)
+        calini(resc, result, gpoly, guess->flags, guess->xorout, args, argpolys);
+    else
+        engini(resc, result, gpoly, guess->flags, args, argpolys);
+}
+
+/* Threaded poly search.  Workers only test which polys divide all the
+ * differences, an ascending range of R_CHUNK odd polys at a time.  The
+ * calling thread takes the finished ranges in order and completes each
+ * candidate, so results and callbacks come exactly as with one thread.
+ */
+typedef struct {
+    bmp_t *cands;
+    unsigned long count;
+    unsigned long size;
+    int ready;
+} srchunit_t;
+
+typedef struct {
+    const poly_t *pworks;
+    unsigned long length;     /* poly width */
+    bmp_t first;              /* first odd poly, right justified */
+    unsigned long units;
+    unsigned long total;      /* polys to test */
+    unsigned long claim;      /* next unit to test */
+    unsigned long done;       /* next unit for the calling thread */
+    int failed;
+    srchunit_t ring[R_RING];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} srchctx_t;
+
+static void
+srchset(poly_t *poly, const srchctx_t *ctx, bmp_t value) {
+    poly->bitmap[0] = value << (BMP_BIT - ctx->length);
+}
+
+static void *
+srchwork(void *arg) {
+    srchctx_t *ctx = (srchctx_t *) arg;
+    poly_t gpoly = PZERO, rem;
+    const poly_t *wptr;
+
+    palloc(&gpoly, ctx->length);
+    if (!plen(gpoly)) {
+        pthread_mutex_lock(&ctx->lock);
+        ctx->failed = 1;
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+        return (NULL);
+    }
+
+    for (;;) {
+        unsigned long unit, iter, end;
+        srchunit_t *up;
+
+        pthread_mutex_lock(&ctx->lock);
+        while (!ctx->failed && ctx->claim < ctx->units && ctx->claim >= ctx->done + R_RING)
+            pthread_cond_wait(&ctx->cond, &ctx->lock);
+        if (ctx->failed || ctx->claim >= ctx->units) {
+            pthread_mutex_unlock(&ctx->lock);
+            break;
+        }
+        unit = ctx->claim++;
+        pthread_mutex_unlock(&ctx->lock);
+
+        up = &ctx->ring[unit % R_RING];
+        up->count = 0UL;
+        iter = unit * R_CHUNK;
+        end = iter + R_CHUNK;
+        if (end > ctx->total)
+            end = ctx->total;
+
+        for (; iter < end; ++iter) {
+            srchset(&gpoly, ctx, ctx->first + ((bmp_t) iter << 1));
+            for (wptr = ctx->pworks; plen(*wptr); ++wptr) {
+                /* straight divide message by poly, don't multiply by x^n */
+                rem = pcrc(*wptr, gpoly, pzero, pzero, 0);
+                if (ptst(rem)) {
+                    pfree(&rem);
+                    break;
+                } else
+                    pfree(&rem);
+            }
+            if (plen(*wptr))
+                continue;
+
+            if (up->count == up->size) {
+                bmp_t *tmp = realloc(up->cands, (up->size + 64UL) * sizeof(bmp_t));
+                if (!tmp) {
+                    uerror("cannot reallocate candidate list");
+                    pthread_mutex_lock(&ctx->lock);
+                    ctx->failed = 1;
+                    pthread_cond_broadcast(&ctx->cond);
+                    pthread_mutex_unlock(&ctx->lock);
+                    pfree(&gpoly);
+                    return (NULL);
+                }
+                up->cands = tmp;
+                up->size += 64UL;
+            }
+            up->cands[up->count++] = ctx->first + ((bmp_t) iter << 1);
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        up->ready = 1;
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+
+    pfree(&gpoly);
+    return (NULL);
+}
+
+static int
+srchthreads(void) {
+    int threads = REVENG_THREADS;
+    if (threads <= 0) {
+#ifdef _WIN32
+        SYSTEM_INFO sysinfo;
+        GetSystemInfo(&sysinfo);
+        threads = (int) sysinfo.dwNumberOfProcessors;
+#else
+        threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    }
+    return (threads > 64) ? 64 : threads;
+}
+
+static int
+polysrch(int *resc, model_t **result, const poly_t gpoly, const model_t *guess, const poly_t qpoly, int rflags, int args, const poly_t *argpolys, const poly_t *pworks) {
+    /* Returns zero if the search wasn't done here, the caller does it
+     * with one thread then.  gpoly is the start poly with the least
+     * significant term cleared.
+     */
+    srchctx_t *ctx;
+    pthread_t tids[64];
+    poly_t cpoly;
+    bmp_t limit;
+    unsigned long unit, seq = 0UL;
+    int threads = srchthreads(), started = 0, t;
+
+    /* one word polys only, anything wider can't be searched anyway */
+    if (threads < 2 || !plen(gpoly) || plen(gpoly) >= (unsigned long) BMP_BIT || plen(gpoly) > 63UL)
+        return (0);
+    if (rflags & R_HAVEQ && plen(qpoly) != plen(gpoly))
+        return (0);
+
+    limit = (BMP_C(1) << plen(gpoly)) - BMP_C(1);
+    if (rflags & R_HAVEQ) {
+        /* test while gpoly < qpoly */
+        bmp_t q = qpoly.bitmap[0] >> (BMP_BIT - plen(qpoly));
+        if (q == BMP_C(0))
+            return (0);
+        if (q - BMP_C(1) < limit)
+            limit = q - BMP_C(1);
+    }
+
+    if (!(ctx = calloc(1, sizeof(srchctx_t)))) {
+        uerror("cannot allocate memory for search");
+        return (0);
+    }
+    ctx->pworks = pworks;
+    ctx->length = plen(gpoly);
+    ctx->first = (gpoly.bitmap[0] >> (BMP_BIT - ctx->length)) | BMP_C(1);
+    ctx->total = (limit >= ctx->first) ? (unsigned long)((limit - ctx->first) >> 1) + 1UL : 0UL;
+    ctx->units = (ctx->total + R_CHUNK - 1UL) / R_CHUNK;
+
+    /* too few polys to be worth it */
+    if (ctx->units < 2UL) {
+        free(ctx);
+        return (0);
+    }
+
+    pthread_mutex_init(&ctx->lock, NULL);
+    pthread_cond_init(&ctx->cond, NULL);
+    cpoly = pclone(gpoly);
+
+    if ((unsigned long) threads > ctx->units)
+        threads = (int) ctx->units;
+    for (t = 0; t < threads; ++t) {
+        if (pthread_create(&tids[started], NULL, srchwork, ctx) == 0)
+            ++started;
+    }
+
+    for (unit = 0UL; started && unit < ctx->units; ++unit) {
+        srchunit_t *up = &ctx->ring[unit % R_RING];
+        unsigned long i;
+
+        /* same progress reports as the single thread search */
+        if (!((unit * R_CHUNK) & R_SPMASK)) {
+            srchset(&cpoly, ctx, ctx->first + ((bmp_t)(unit * R_CHUNK) << 1));
+            uprog(cpoly, guess->flags, seq++);
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        while (!up->ready && !ctx->failed)
+            pthread_cond_wait(&ctx->cond, &ctx->lock);
+        pthread_mutex_unlock(&ctx->lock);
+        if (!up->ready)
+            break;
+
+        for (i = 0UL; i < up->count; ++i) {
+            srchset(&cpoly, ctx, up->cands[i]);
+            candid(resc, result, cpoly, guess, rflags, args, argpolys);
+        }
+
+        pthread_mutex_lock(&ctx->lock);
+        up->ready = 0;
+        ++ctx->done;
+        pthread_cond_broadcast(&ctx->cond);
+        pthread_mutex_unlock(&ctx->lock);
+    }
+
+    /* no thread at all, or a failure, stops the workers */
+    pthread_mutex_lock(&ctx->lock);
+    if (unit < ctx->units)
+        ctx->failed = 1;
+    pthread_cond_broadcast(&ctx->cond);
+    pthread_mutex_unlock(&ctx->lock);
+
+    for (t = 0; t < started; ++t)
+        pthread_join(tids[t], NULL);
+
+    for (t = 0; t < R_RING; ++t)
+        free(ctx->ring[t].cands);
+    pfree(&cpoly);
+    pthread_mutex_destroy(&ctx->lock);
+    pthread_cond_destroy(&ctx->cond);
+    t = started;
+    free(ctx);
+
+    /* without threads the caller searches the whole range again */
+    return (t != 0);
+}
+
 static poly_t *
 modpol(const poly_t init, int rflags, int args, const poly_t *argpolys) {
     /* Produce, in ascending length order, a list of differences
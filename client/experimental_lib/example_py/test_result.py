@@ -0,0 +1,14 @@
+#!/usr/bin/env python3
+
+import json
+import pm3
+
+p=pm3.pm3("/dev/ttyACM0")
+print("Device:", p.name)
+# nothing printed, read back what the command found
+p.console_quiet("hf 14a reader")
+res = json.loads(p.result)
+if "uid" in res:
+    print("UID:", res["uid"], "SAK:", res["sak"])
+else:
+    print("no card")
@@ -16,10 +16,30 @@
 #ifndef LIBPM3_H
 #define LIBPM3_H
 
+#include <stddef.h>
+
 typedef struct pm3_device pm3;
 
+// view on client memory,  see pm3_graph_get()
+typedef struct {
+    void *data;
+    size_t size;
+} pm3_buffer_t;
+
 pm3 *pm3_open(const char *port);
 int pm3_console(pm3 *dev, const char *cmd);
+int pm3_console_quiet(pm3 *dev, const char *cmd);
+// JSON object with the structured result of the last console command
+const char *pm3_result_get(pm3 *dev);
+int pm3_send_queued(pm3 *dev, int cmd, const char *data);
+int pm3_send_queued_raw(pm3 *dev, int cmd, const void *data, size_t len);
+const char *pm3_poll_queued(pm3 *dev, int seq);
+pm3_buffer_t pm3_poll_queued_raw(pm3 *dev, int seq);
+void pm3_clear_queued(pm3 *dev);
+// valid until the next command,  no copy is made
+pm3_buffer_t pm3_graph_get(pm3 *dev);
+pm3_buffer_t pm3_demod_get(pm3 *dev);
+pm3_buffer_t pm3_bigbuf_get(pm3 *dev, int offset, int len);
 const char *pm3_name_get(pm3 *dev);
 void pm3_close(pm3 *dev);
 pm3 *pm3_get_current_dev(void);
@@ -160,24 +160,13 @@ function Command:sendMIX( ignore_response, timeout, use_cmd_ack)
     local packed = bin.pack("LLLLH", cmd, arg1, arg2, arg3, data)
     return packed, nil;
 end
-function Command:sendNG( ignore_response, timeout )
-    if timeout == nil then timeout = TIMEOUT end
-    local data = self.data
-    local cmd = self.cmd
-    local err, msg = core.SendCommandNG(cmd, data)
-    if err == nil then return nil, msg end
 
-    if ignore_response then return true, nil end
-    local response, msg = core.WaitForResponseTimeout(cmd, timeout)
-    if response == nil then
-        return nil, 'Error, waiting for response timed out :: '..msg
-    end
-
-    data = nil
-    cmd = nil
-    local count, length, magic, status, crc, arg0, arg1, arg2
+-- unpack a NG response string, as returned by core.WaitForResponseTimeout
+local function parseNG(response)
+    local count, cmd, length, magic, status, crc, arg0, arg1, arg2, data, ng, bytes
 
     count, cmd, length, magic, status, crc, arg0, arg1, arg2 = bin.unpack('SSIsSLLL', response)
+    bytes = response:sub(count, count + length - 1)
     count, data, ng = bin.unpack('H'..length..'C', response, count)
 
 --[[  uncomment if you want to debug
@@ -203,8 +192,69 @@ function Command:sendNG( ignore_response, timeout )
             Oldarg1 = arg1,
             Oldarg2 = arg2,
             Data = data,
+            Bytes = bytes,   -- Data as a binary string
             Ng = ng
     }
 end
 
+function Command:sendNG( ignore_response, timeout )
+    if timeout == nil then timeout = TIMEOUT end
+    local data = self.data
+    local cmd = self.cmd
+    local err, msg = core.SendCommandNG(cmd, data)
+    if err == nil then return nil, msg end
+
+    if ignore_response then return true, nil end
+    local response, msg = core.WaitForResponseTimeout(cmd, timeout)
+    if response == nil then
+        return nil, 'Error, waiting for response timed out :: '..msg
+    end
+
+    return parseNG(response)
+end
+
+-- Send without waiting for the reply, it is collected with Command:await().
+-- Several commands can be in flight at once, their replies can be awaited in any order.
+function Command:sendNGQueued()
+    local seq, msg = core.SendCommandQueued(self.cmd, self.data or '')
+    if seq == nil then return nil, msg end
+    self.seq = seq
+    return seq, nil
+end
+
+-- Non blocking,  the reply of sendNGQueued as sendNG returns it,  or false while the device is busy
+function Command:poll()
+    if self.seq == nil then return nil, 'Error, command was not queued' end
+    local response, msg = core.PollQueuedResponse(self.seq)
+    if response == nil then
+        self.seq = nil
+        return nil, msg
+    end
+    if response == false then return false, nil end
+    self.seq = nil
+    return parseNG(response)
+end
+
+-- Wait for the reply of sendNGQueued.  Inside a coroutine it yields between polls,  so a
+-- script can resume other coroutines (more commands, host side work) while the device is busy.
+function Command:await( timeout )
+    if timeout == nil then timeout = TIMEOUT end
+    local start = core.msclock()
+    while true do
+        local response, msg = self:poll()
+        if response ~= false then return response, msg end
+        if core.msclock() - start > timeout then
+            -- later replies can't be matched any more,  forget all queued commands
+            core.clearCommandQueue()
+            self.seq = nil
+            return nil, 'Error, waiting for response timed out'
+        end
+        if coroutine.isyieldable() then
+            coroutine.yield()
+        else
+            core.msleep(1)
+        end
+    end
+end
+
 return _commands
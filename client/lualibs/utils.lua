@@ -1,6 +1,8 @@
 --[[
     This may be moved to a separate library at some point (Holiman)
 --]]
+local bin = require('bin')
+
 local Utils =
 {
     -- Asks the user for Yes or No
@@ -281,19 +283,7 @@ local Utils =
     ConvertBytesToHex = function(bytes, reverse)
         if bytes == nil then return '' end
         if #bytes == 0 then return '' end
-        local s={}
-        if reverse then
-            local j=1
-            for i = #bytes, 1, -1 do
-                s[i] = string.format("%02X", bytes[j])
-                j = j + 1
-            end
-        else
-            for i = 1, #bytes do
-                s[i] = string.format("%02X", bytes[i])
-            end
-        end
-        return table.concat(s)
+        return bin.bytestohex(bytes, reverse)
     end,
     -- Convert byte array to string with ascii
     ConvertBytesToAscii = function(bytes)
@@ -306,13 +296,8 @@ local Utils =
         return table.concat(s)
     end,
     ConvertHexToBytes = function(s)
-        local t={}
-        if s == nil then return t end
-        if #s == 0 then return t end
-        for k in s:gmatch"(%x%x)" do
-            table.insert(t,tonumber(k,16))
-        end
-        return t
+        if s == nil then return {} end
+        return bin.hextobytes(s)
     end,
     ConvertAsciiToBytes = function(s, reverse)
         local t = {}
@@ -339,29 +324,17 @@ local Utils =
     ConvertHexToAscii = function(s, useSafechars)
         if s == nil then return '' end
         if #s == 0 then return '' end
-        local t={}
-        for k in s:gmatch"(%x%x)" do
-
-            local n = tonumber(k,16)
-            local c
-            if useSafechars and ( (n < 32) or (n == 127) ) then
-                c = '.';
-            else
-                c = string.char(n)
-            end
-            table.insert(t,c)
+        local t = bin.fromhex(s)
+        if useSafechars then
+            t = t:gsub('[%z\1-\31\127]', '.')
         end
-        return table.concat(t)
+        return t
     end,
 
     ConvertAsciiToHex = function(s)
         if s == nil then return '' end
         if #s == 0 then return '' end
-        local t={}
-        for k in s:gmatch"(.)" do
-            table.insert(t, string.format("%02X", string.byte(k)))
-        end
-        return table.concat(t)
+        return bin.tohex(s)
     end,
 
     hexlify = function(s)
@@ -71,7 +71,31 @@ class pm3(object):
 
     def console(self, cmd):
         return _pm3.pm3_console(self, cmd)
+
+    def console_quiet(self, cmd):
+        return _pm3.pm3_console_quiet(self, cmd)
+
+    def send_queued(self, cmd, data):
+        return _pm3.pm3_send_queued(self, cmd, data)
+
+    def send_queued_raw(self, cmd, data):
+        return _pm3.pm3_send_queued_raw(self, cmd, data)
+
+    def poll_queued(self, seq):
+        return _pm3.pm3_poll_queued(self, seq)
+
+    def poll_queued_raw(self, seq):
+        return _pm3.pm3_poll_queued_raw(self, seq)
+
+    def clear_queued(self):
+        return _pm3.pm3_clear_queued(self)
+
+    def bigbuf_get(self, offset, len):
+        return _pm3.pm3_bigbuf_get(self, offset, len)
     name = property(_pm3.pm3_name_get)
+    result = property(_pm3.pm3_result_get)
+    graph = property(_pm3.pm3_graph_get)
+    demod = property(_pm3.pm3_demod_get)
 
 # Register pm3 in _pm3:
 _pm3.pm3_swigregister(pm3)
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""
+asyncio helpers on top of the libpm3 queued commands
+
+    import asyncio, pm3, pm3_async
+
+    CMD_PING = 0x0109
+
+    async def main():
+        a = pm3.pm3("/dev/ttyACM0")
+        b = pm3.pm3("/dev/ttyACM1")
+        # both devices are busy at the same time
+        ra, rb = await asyncio.gather(pm3_async.command(a, CMD_PING),
+                                      pm3_async.command(b, CMD_PING))
+
+    asyncio.run(main())
+
+The device is polled from the event loop thread, other coroutines keep running
+while it is busy. Don't mix with p.console() on the same device while commands
+are outstanding, console commands flush the reply buffer.
+"""
+
+import asyncio
+import struct
+
+# interval between polls, in seconds
+POLL_INTERVAL = 0.001
+
+
+class Pm3Error(IOError):
+    def __init__(self, code, msg="command failed"):
+        super().__init__("%s ( %d )" % (msg, code))
+        self.code = code
+
+
+async def command(dev, cmd, data=b'', timeout=2.0):
+    """
+    Send a NG command and wait for its reply without blocking the event loop.
+    Returns a dict with cmd, status and data (bytes).
+    """
+    seq = dev.send_queued_raw(cmd, bytes(data))
+    if seq < 0:
+        raise Pm3Error(seq, "failed to queue command")
+
+    loop = asyncio.get_running_loop()
+    deadline = loop.time() + timeout
+    while True:
+        res = dev.poll_queued_raw(seq)
+        if res is not None:
+            # uint16 cmd, int16 status, data.  cmd 0 carries an error
+            rcmd, status = struct.unpack_from("<Hh", res)
+            if rcmd == 0:
+                raise Pm3Error(status)
+            return {"cmd": rcmd, "status": status, "data": bytes(res[4:])}
+
+        if loop.time() > deadline:
+            # later replies can't be matched any more
+            dev.clear_queued()
+            raise asyncio.TimeoutError()
+
+        await asyncio.sleep(POLL_INTERVAL)
+
+
+def command_future(dev, cmd, data=b'', timeout=2.0, callback=None):
+    """
+    Schedule command() on the running loop, returns the asyncio future.
+    callback, when given, is called with the future once the reply is in.
+    """
+    fut = asyncio.ensure_future(command(dev, cmd, data, timeout))
+    if callback:
+        fut.add_done_callback(callback)
+    return fut
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+Client for the `daemon` command of the Proxmark3 client
+
+    # in the client:  proxmark3 /dev/ttyACM0 -c daemon
+    import pm3_daemon
+
+    d = pm3_daemon.Daemon()                     # ~/.proxmark3/daemon.sock
+    r = d.console("hf 14a reader")
+    print(r["status"], r["result"], r["output"])
+
+    d = pm3_daemon.Daemon(host="127.0.0.1", port=9211)   # daemon -p 9211
+
+Any number of processes may hold a session at the same time, the daemon runs
+their commands one at a time, taking turns.
+"""
+
+import itertools
+import json
+import os
+import socket
+
+DEFAULT_SOCKET = os.path.join(os.path.expanduser("~"), ".proxmark3", "daemon.sock")
+
+
+class DaemonError(IOError):
+    def __init__(self, code, msg):
+        super().__init__("%s ( %d )" % (msg, code))
+        self.code = code
+
+
+class Daemon:
+    def __init__(self, path=None, host=None, port=9211, timeout=None):
+        if host:
+            self._sock = socket.create_connection((host, port), timeout)
+        else:
+            self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self._sock.settimeout(timeout)
+            self._sock.connect(path or DEFAULT_SOCKET)
+        self._file = self._sock.makefile("rwb")
+        self._ids = itertools.count(1)
+
+    def close(self):
+        self._file.close()
+        self._sock.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def call(self, method, **params):
+        """ JSON-RPC call, returns its result or raises DaemonError """
+        rid = next(self._ids)
+        req = {"jsonrpc": "2.0", "id": rid, "method": method, "params": params}
+        self._file.write(json.dumps(req).encode() + b"\n")
+        self._file.flush()
+
+        line = self._file.readline()
+        if not line:
+            raise ConnectionError("daemon closed the session")
+        rep = json.loads(line)
+        if "error" in rep:
+            raise DaemonError(rep["error"]["code"], rep["error"]["message"])
+        return rep["result"]
+
+    def console(self, cmd, quiet=False):
+        """
+        Run a console command. Returns a dict with status (PM3_E* code),
+        result (what the command stored), output (unless quiet), queued_ms
+        and run_ms
+        """
+        return self.call("console", cmd=cmd, quiet=quiet)
+
+    def metrics(self):
+        return self.call("metrics")
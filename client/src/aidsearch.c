@@ -58,13 +58,20 @@ static int closeAIDFile(json_t *root) {
     return PM3_SUCCESS;
 }
 
+// aidlist.json is parsed once and kept,  every caller gets its own reference
+static json_t *aid_root = NULL;
+
 json_t *AIDSearchInit(bool verbose) {
-    json_t *root = NULL;
-    int res = openAIDFile(&root, verbose);
-    if (res != PM3_SUCCESS)
-        return NULL;
+    if (aid_root == NULL) {
+        int res = openAIDFile(&aid_root, verbose);
+        if (res != PM3_SUCCESS) {
+            json_decref(aid_root);
+            aid_root = NULL;
+            return NULL;
+        }
+    }
 
-    return root;
+    return json_incref(aid_root);
 }
 
 json_t *AIDSearchGetElm(json_t *root, size_t elmindx) {
@@ -97,15 +104,58 @@ static const char *jsonStrGet(json_t *data, const char *name) {
     return cstr;
 }
 
-static bool aidCompare(const char *aidlarge, const char *aidsmall) {
-    if (strcmp(aidlarge, aidsmall) == 0)
+// AID strings of the cached list, sorted, for the longest prefix lookup
+typedef struct {
+    const char *aid;
+    size_t len;
+    size_t order;
+    json_t *elm;
+} aid_index_t;
+
+static aid_index_t *aid_index = NULL;
+static size_t aid_index_cnt = 0;
+static json_t *aid_index_root = NULL;
+
+static int aidIndexCompare(const void *a, const void *b) {
+    const aid_index_t *ia = (const aid_index_t *)a;
+    const aid_index_t *ib = (const aid_index_t *)b;
+    int res = strcmp(ia->aid, ib->aid);
+    // same AID twice, the first one in the list wins
+    return (res) ? res : (ia->order > ib->order) - (ia->order < ib->order);
+}
+
+static bool aidIndexBuild(json_t *root) {
+    if (aid_index_root == root) {
         return true;
+    }
+
+    free(aid_index);
+    aid_index = calloc(json_array_size(root) + 1, sizeof(aid_index_t));
+    aid_index_cnt = 0;
+    aid_index_root = NULL;
+    if (aid_index == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return false;
+    }
 
-    if (strlen(aidlarge) > strlen(aidsmall))
-        if (strncmp(aidlarge, aidsmall, strlen(aidsmall)) == 0)
-            return true;
+    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
+        json_t *data = AIDSearchGetElm(root, elmindx);
+        if (data == NULL)
+            continue;
+        const char *dictaid = jsonStrGet(data, "AID");
+        if (dictaid == NULL)
+            continue;
+
+        aid_index[aid_index_cnt].aid = dictaid;
+        aid_index[aid_index_cnt].len = strlen(dictaid);
+        aid_index[aid_index_cnt].order = elmindx;
+        aid_index[aid_index_cnt].elm = data;
+        aid_index_cnt++;
+    }
+    qsort(aid_index, aid_index_cnt, sizeof(aid_index_t), aidIndexCompare);
 
-    return false;
+    aid_index_root = root;
+    return true;
 }
 
 bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
@@ -121,6 +171,30 @@ bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
     return true;
 }
 
+// longest AID of the list that is a prefix of aid,  dictaid may be less length than requested aid
+static json_t *aidIndexFind(json_t *root, const char *aid) {
+    if (aidIndexBuild(root) == false)
+        return NULL;
+
+    // every prefix is tried, longest first. First entry of the AIDs equal to the prefix
+    for (size_t plen = strlen(aid); plen > 0; plen--) {
+        size_t lo = 0, hi = aid_index_cnt;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            int res = strncmp(aid_index[mid].aid, aid, plen);
+            if (res < 0 || (res == 0 && aid_index[mid].len < plen)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo < aid_index_cnt && aid_index[lo].len == plen && strncmp(aid_index[lo].aid, aid, plen) == 0) {
+            return aid_index[lo].elm;
+        }
+    }
+    return NULL;
+}
+
 int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
     int retval = PM3_SUCCESS;
 
@@ -130,21 +204,7 @@ int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
     if (root == NULL)
         goto out;
 
-    json_t *elm = NULL;
-    size_t maxaidlen = 0;
-    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
-        json_t *data = AIDSearchGetElm(root, elmindx);
-        if (data == NULL)
-            continue;
-        const char *dictaid = jsonStrGet(data, "AID");
-        if (aidCompare(aid, dictaid)) {  // dictaid may be less length than requested aid
-            if (maxaidlen < strlen(dictaid) && strlen(dictaid) <= strlen(aid)) {
-                maxaidlen = strlen(dictaid);
-                elm = data;
-            }
-        }
-    }
-
+    json_t *elm = aidIndexFind(root, aid);
     if (elm == NULL)
         goto out;
 
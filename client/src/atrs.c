@@ -18,48 +18,95 @@
 #include "atrs.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "commonutil.h" // ARRAYLEN
 #include "ui.h"         // PrintAndLogEx
 
 // get a ATR description based on the atr bytes
 // returns description of the best match
-const char *getAtrInfo(const char *atr_str) {
-    size_t slen = strlen(atr_str);
-    int match = -1;
+// The table is large and scanned on every lookup, so split it once at first use:
+// exact entries sorted for a binary search and the wildcard ones, in table order.
+static uint16_t *atr_exact = NULL;
+static uint16_t *atr_wild = NULL;
+static size_t atr_exact_cnt = 0;
+static size_t atr_wild_cnt = 0;
+
+static int atr_cmp(const void *a, const void *b) {
+    uint16_t ia = *(const uint16_t *)a;
+    uint16_t ib = *(const uint16_t *)b;
+    int res = strcmp(AtrTable[ia].bytes, AtrTable[ib].bytes);
+    // keep table order among duplicates, the first one wins
+    return (res) ? res : (ia > ib) - (ia < ib);
+}
+
+static bool atr_index(void) {
+    if (atr_exact) {
+        return true;
+    }
+
     // skip last element of AtrTable
-    for (int i = 0; i < ARRAYLEN(AtrTable) - 1; ++i) {
+    size_t n = ARRAYLEN(AtrTable) - 1;
+    atr_exact = calloc(n, sizeof(uint16_t));
+    atr_wild = calloc(n, sizeof(uint16_t));
+    if (atr_exact == NULL || atr_wild == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        free(atr_exact);
+        free(atr_wild);
+        atr_exact = NULL;
+        atr_wild = NULL;
+        return false;
+    }
 
-        if (strlen(AtrTable[i].bytes) != slen)
-            continue;
+    for (size_t i = 0; i < n; i++) {
+        if (strchr(AtrTable[i].bytes, '.')) {
+            atr_wild[atr_wild_cnt++] = i;
+        } else {
+            atr_exact[atr_exact_cnt++] = i;
+        }
+    }
+    qsort(atr_exact, atr_exact_cnt, sizeof(uint16_t), atr_cmp);
+    return true;
+}
 
-        if (strstr(AtrTable[i].bytes, ".") != NULL) {
-            char *tmp_atr = calloc(slen, sizeof(uint8_t));
-            if (tmp_atr == NULL) {
-                PrintAndLogEx(FAILED, "failed to allocate memory");
-                return NULL;
-            }
+static bool atr_wild_match(const char *pattern, const char *atr_str, size_t slen) {
+    for (size_t j = 0; j < slen; j++) {
+        if (pattern[j] != '.' && pattern[j] != atr_str[j]) {
+            return false;
+        }
+    }
+    return pattern[slen] == '\0';
+}
 
-            for (int j = 0; j < slen; j++) {
-                tmp_atr[j] = (AtrTable[i].bytes[j] == '.') ? '.' : atr_str[j];
-            }
+const char *getAtrInfo(const char *atr_str) {
 
-            if (strncmp(tmp_atr, AtrTable[i].bytes, slen) == 0) {
-                // record partial match but continue looking for full match
-                match = i;
-            }
-            free(tmp_atr);
+    if (atr_index() == false) {
+        return NULL;
+    }
 
+    // lowest index of an exact match
+    size_t lo = 0, hi = atr_exact_cnt;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strcmp(AtrTable[atr_exact[mid]].bytes, atr_str) < 0) {
+            lo = mid + 1;
         } else {
-            if (strncmp(atr_str, AtrTable[i].bytes, slen) == 0) {
-                return AtrTable[i].desc;
-            }
+            hi = mid;
         }
     }
+    if (lo < atr_exact_cnt && strcmp(AtrTable[atr_exact[lo]].bytes, atr_str) == 0) {
+        return AtrTable[atr_exact[lo]].desc;
+    }
 
-    if (match >= 0) {
-        return AtrTable[match].desc;
-    } else {
-        //No match, return default = last element of AtrTable
-        return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
+    // a partial match,  the last one in the table as before
+    size_t slen = strlen(atr_str);
+    for (size_t i = atr_wild_cnt; i > 0; i--) {
+        const char *pattern = AtrTable[atr_wild[i - 1]].bytes;
+        if (atr_wild_match(pattern, atr_str, slen)) {
+            return AtrTable[atr_wild[i - 1]].desc;
+        }
     }
+
+    //No match, return default = last element of AtrTable
+    return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
 }
@@ -0,0 +1,152 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Checkpoint files of long running attacks
+//
+// Attacks save their state to ~/.proxmark3/checkpoints/<name>.json while
+// they run, so a `--resume` after a client crash or a lost USB link picks up
+// where they stopped.  The file is written next to the old one and renamed
+// over it,  a crash while saving leaves the previous checkpoint intact.
+//
+// {
+//   "Created": "proxmark3",
+//   "FileType": "checkpoint",
+//   "Command": "hf mf autopwn",
+//   "State": { ... command specific ... }
+// }
+//-----------------------------------------------------------------------------
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ui.h"             // PrintAndLog, searchHomeFilePath
+#include "fileutils.h"      // fileExists
+
+static char *checkpoint_path(const char *name) {
+    char fn[FILE_PATH_SIZE] = {0};
+    snprintf(fn, sizeof(fn), "%s.json", name);
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, CHECKPOINTS_SUBDIR, fn, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return path;
+}
+
+/**
+ * @brief Load the state of an earlier run
+ *
+ * @param name checkpoint name,  e.g. hf-mf-autopwn-<UID>
+ * @param command the command which has to have written it
+ * @return state object,  to be released with json_decref,  or NULL if there is no checkpoint
+ */
+json_t *checkpoint_load(const char *name, const char *command) {
+    char *path = checkpoint_path(name);
+    if (path == NULL) {
+        return NULL;
+    }
+
+    if (fileExists(path) == false) {
+        PrintAndLogEx(INFO, "no checkpoint " _YELLOW_("%s") " to resume from", path);
+        free(path);
+        return NULL;
+    }
+
+    json_error_t error;
+    json_t *root = json_load_file(path, 0, &error);
+    if (root == NULL) {
+        PrintAndLogEx(WARNING, "checkpoint " _YELLOW_("%s") " is broken, line %d: %s", path, error.line, error.text);
+        free(path);
+        return NULL;
+    }
+
+    const char *cmd = json_string_value(json_object_get(root, "Command"));
+    json_t *state = json_object_get(root, "State");
+    if (cmd == NULL || strcmp(cmd, command) != 0 || json_is_object(state) == false) {
+        PrintAndLogEx(WARNING, "checkpoint " _YELLOW_("%s") " wasn't written by " _YELLOW_("%s"), path, command);
+        json_decref(root);
+        free(path);
+        return NULL;
+    }
+
+    PrintAndLogEx(SUCCESS, "resuming from checkpoint " _YELLOW_("%s"), path);
+    json_incref(state);
+    json_decref(root);
+    free(path);
+    return state;
+}
+
+/**
+ * @brief Replace the checkpoint with the current state
+ */
+int checkpoint_save(const char *name, const char *command, json_t *state) {
+    char *path = checkpoint_path(name);
+    if (path == NULL) {
+        return PM3_EFILE;
+    }
+
+    size_t tmplen = strlen(path) + 5;
+    char *tmp = calloc(tmplen, sizeof(char));
+    if (tmp == NULL) {
+        free(path);
+        return PM3_EMALLOC;
+    }
+    snprintf(tmp, tmplen, "%s.tmp", path);
+
+    json_t *root = json_object();
+    json_object_set_new(root, "Created", json_string("proxmark3"));
+    json_object_set_new(root, "FileType", json_string("checkpoint"));
+    json_object_set_new(root, "Command", json_string(command));
+    json_object_set(root, "State", state);
+
+    int res = PM3_SUCCESS;
+    if (json_dump_file(root, tmp, JSON_INDENT(2)) != 0) {
+        PrintAndLogEx(WARNING, "could not write checkpoint " _YELLOW_("%s"), tmp);
+        res = PM3_EFILE;
+    } else {
+#ifdef _WIN32
+        // rename doesn't replace existing files on Windows
+        remove(path);
+#endif
+        if (rename(tmp, path) != 0) {
+            PrintAndLogEx(WARNING, "could not write checkpoint " _YELLOW_("%s"), path);
+            res = PM3_EFILE;
+        } else {
+            PrintAndLogEx(DEBUG, "saved checkpoint " _YELLOW_("%s"), path);
+        }
+    }
+
+    json_decref(root);
+    free(tmp);
+    free(path);
+    return res;
+}
+
+/**
+ * @brief Drop the checkpoint once an attack is done
+ */
+void checkpoint_remove(const char *name) {
+    char *path = checkpoint_path(name);
+    if (path == NULL) {
+        return;
+    }
+
+    if (fileExists(path) && remove(path) == 0) {
+        PrintAndLogEx(DEBUG, "removed checkpoint " _YELLOW_("%s"), path);
+    }
+    free(path);
+}
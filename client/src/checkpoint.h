@@ -0,0 +1,29 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Checkpoint files of long running attacks
+//-----------------------------------------------------------------------------
+
+#ifndef CHECKPOINT_H__
+#define CHECKPOINT_H__
+
+#include "common.h"
+#include "jansson.h"
+
+json_t *checkpoint_load(const char *name, const char *command);
+int checkpoint_save(const char *name, const char *command, json_t *state);
+void checkpoint_remove(const char *name);
+
+#endif
@@ -185,6 +185,197 @@ static uint16_t calcXORchecksum(uint8_t *bytes, uint8_t len, uint32_t mask) {
     return 0xFF - calcSumByteXor(bytes, len, mask);
 }
 
+// Checksum search over a set of frames.  Every family is tried on every byte range,  with the
+// checksum being the family value plus,  minus or xor a constant,  limited by a mask.  The sub
+// and ones' complement variants above are the minus relation with constant 0 and the mask.
+#define CHKFIND_MAX_FRAMES  32
+#define CHKFIND_MAX_LEN     100
+#define CHKFIND_TOP         10
+
+enum {
+    CHK_BYTE_ADD,
+    CHK_NIBBLE_ADD,
+    CHK_CRUMB_ADD,
+    CHK_BYTE_XOR,
+    CHK_NIBBLE_XOR,
+    CHK_CRUMB_XOR,
+    CHK_BSD8,
+    CHK_BSD4,
+    CHK_FAMILIES
+};
+
+static const char *chk_family_names[CHK_FAMILIES] = {
+    "byte add", "nibble add", "crumb add", "byte xor", "nibble xor", "crumb xor", "BSD 8bit", "BSD 4bit"
+};
+
+enum {
+    CHK_REL_ADD,    // chk = F + k
+    CHK_REL_SUB,    // chk = k - F
+    CHK_REL_XOR,    // chk = F ^ k
+    CHK_RELATIONS
+};
+
+typedef struct {
+    uint8_t count;
+    uint8_t family;
+    uint8_t relation;
+    uint8_t start;      // first byte
+    uint8_t skip;       // bytes left out before the checksum
+    uint16_t mask;
+    uint16_t k;
+    bool little_endian;
+} chk_candidate_t;
+
+// one byte more of family f,  same arithmetic as the calcSum / calcBSD functions above
+static uint32_t chk_step(uint8_t f, uint32_t acc, uint8_t b) {
+    switch (f) {
+        case CHK_BYTE_ADD:
+            return acc + b;
+        case CHK_NIBBLE_ADD:
+            return acc + NIBBLE_LOW(b) + NIBBLE_HIGH(b);
+        case CHK_CRUMB_ADD:
+            return acc + CRUMB(b, 0) + CRUMB(b, 2) + CRUMB(b, 4) + CRUMB(b, 6);
+        case CHK_BYTE_XOR:
+            return acc ^ b;
+        case CHK_NIBBLE_XOR:
+            return acc ^ NIBBLE_LOW(b) ^ NIBBLE_HIGH(b);
+        case CHK_CRUMB_XOR:
+            return acc ^ CRUMB(b, 0) ^ CRUMB(b, 2) ^ CRUMB(b, 4) ^ CRUMB(b, 6);
+        case CHK_BSD8:
+            acc = ((acc & 0xFF) >> 1) | ((acc & 0x1) << 7);
+            return (acc + b) & 0xFF;
+        case CHK_BSD4:
+            acc = ((acc & 0xF) >> 1) | ((acc & 0x1) << 3);
+            acc = (acc + NIBBLE_HIGH(b)) & 0xF;
+            acc = ((acc & 0xF) >> 1) | ((acc & 0x1) << 3);
+            return (acc + NIBBLE_LOW(b)) & 0xF;
+    }
+    return acc;
+}
+
+// better first: more frames match,  then no constant,  then the longer range
+static bool chk_better(const chk_candidate_t *a, const chk_candidate_t *b) {
+    if (a->count != b->count) {
+        return a->count > b->count;
+    }
+    if ((a->k == 0) != (b->k == 0)) {
+        return a->k == 0;
+    }
+    return (a->start + a->skip) < (b->start + b->skip);
+}
+
+static void chk_keep(chk_candidate_t *top, uint8_t *ntop, const chk_candidate_t *c) {
+    if (*ntop == CHKFIND_TOP && chk_better(c, &top[CHKFIND_TOP - 1]) == false) {
+        return;
+    }
+
+    uint8_t i = (*ntop < CHKFIND_TOP) ? (*ntop)++ : CHKFIND_TOP - 1;
+    while (i > 0 && chk_better(c, &top[i - 1])) {
+        top[i] = top[i - 1];
+        i--;
+    }
+    top[i] = *c;
+}
+
+/**
+ * @brief Rank checksum candidates for a set of frames.
+ *
+ * @param frames frames with their checksum in the last `width` bytes
+ * @param lens frame lengths
+ * @param n number of frames
+ * @param width checksum bytes, 1 or 2
+ * @param top best candidates, CHKFIND_TOP entries
+ * @return number of candidates in top
+ */
+static uint8_t chk_find(uint8_t frames[][CHKFIND_MAX_LEN], const int *lens, uint8_t n, uint8_t width, chk_candidate_t *top) {
+    static const uint16_t masks1[] = { 0xFF, 0x0F };
+    static const uint16_t masks2[] = { 0xFFFF };
+    const uint16_t *masks = (width == 1) ? masks1 : masks2;
+    uint8_t nmasks = (width == 1) ? ARRAYLEN(masks1) : ARRAYLEN(masks2);
+
+    int minlen = CHKFIND_MAX_LEN;
+    for (uint8_t i = 0; i < n; i++) {
+        minlen = MIN(minlen, lens[i] - width);
+    }
+
+    // family value of data[start .. end) for every end,  per frame
+    uint32_t (*vals)[CHKFIND_MAX_LEN + 1] = calloc(n, sizeof(*vals));
+    uint16_t *counts = calloc(0x10000, sizeof(uint16_t));
+    if (vals == NULL || counts == NULL) {
+        free(vals);
+        free(counts);
+        return 0;
+    }
+
+    uint8_t ntop = 0;
+    uint16_t ks[CHKFIND_MAX_FRAMES];
+
+    for (uint8_t f = 0; f < CHK_FAMILIES; f++) {
+        for (int start = 0; start < minlen; start++) {
+
+            for (uint8_t i = 0; i < n; i++) {
+                uint32_t acc = 0;
+                for (int end = start; end < lens[i] - width; end++) {
+                    acc = chk_step(f, acc, frames[i][end]);
+                    vals[i][end + 1] = acc;
+                }
+            }
+
+            for (uint8_t le = 0; le < width; le++) {
+                for (int skip = 0; start + skip < minlen; skip++) {
+                    // a narrower mask only adds what the wider one didn't match
+                    uint8_t wide[CHK_RELATIONS] = {0};
+                    for (uint8_t m = 0; m < nmasks; m++) {
+                        for (uint8_t r = 0; r < CHK_RELATIONS; r++) {
+
+                            uint8_t best = 0;
+                            uint16_t bestk = 0;
+                            for (uint8_t i = 0; i < n; i++) {
+                                int clen = lens[i] - width;
+                                uint32_t v = vals[i][clen - skip];
+                                uint32_t chk = (width == 1) ? frames[i][clen] :
+                                               (le) ? (frames[i][clen] | (frames[i][clen + 1] << 8)) :
+                                               ((frames[i][clen] << 8) | frames[i][clen + 1]);
+                                uint16_t k;
+                                if (r == CHK_REL_ADD) {
+                                    k = (chk - v) & masks[m];
+                                } else if (r == CHK_REL_SUB) {
+                                    k = (chk + v) & masks[m];
+                                } else {
+                                    k = (chk ^ v) & masks[m];
+                                }
+                                ks[i] = k;
+                                if (++counts[k] > best) {
+                                    best = counts[k];
+                                    bestk = k;
+                                }
+                            }
+                            for (uint8_t i = 0; i < n; i++) {
+                                counts[ks[i]] = 0;
+                            }
+
+                            if (m == 0) {
+                                wide[r] = best;
+                            } else if (best <= wide[r]) {
+                                continue;
+                            }
+
+                            chk_candidate_t c = {
+                                .count = best, .family = f, .relation = r, .start = start, .skip = skip,
+                                .mask = masks[m], .k = bestk, .little_endian = le
+                            };
+                            chk_keep(top, &ntop, &c);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    free(vals);
+    free(counts);
+    return ntop;
+}
 
 //2148050707DB0A0E000001C4000000
 
@@ -471,6 +662,90 @@ static int CmdAnalyseCHKSUM(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdAnalyseCHKFIND(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "analyse chkfind",
+                  "Search the checksum of a set of frames ending with their checksum.\n"
+                  "Tries byte / nibble / crumb add and xor and BSD checksums over every byte range,\n"
+                  "with the checksum being the value plus, minus or xor a constant, and ranks them by\n"
+                  "how many frames agree.  The more frames,  the fewer false hits.",
+                  "analyse chkfind -d 433BAF6D1B7A67 -d 503973E9E3E659 -d B8F282726078E5\n"
+                  "analyse chkfind -w 2 -d E7EEE7615EF3A216 -d 5F30E49B482EB814 -d 15CAE75007207114"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_strn("d", "data", "<hex>", 1, CHKFIND_MAX_FRAMES, "frame with checksum, one per -d"),
+        arg_int0("w", "width", "<1|2>", "checksum bytes, default 1"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    struct arg_str *frames_arg = arg_get_str(ctx, 1);
+    uint8_t width = arg_get_int_def(ctx, 2, 1);
+
+    if (width != 1 && width != 2) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(FAILED, "Checksum width must be 1 or 2");
+        return PM3_EINVARG;
+    }
+
+    uint8_t n = frames_arg->count;
+    uint8_t (*frames)[CHKFIND_MAX_LEN] = calloc(CHKFIND_MAX_FRAMES, sizeof(*frames));
+    int lens[CHKFIND_MAX_FRAMES] = {0};
+    if (frames == NULL) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        if (param_gethex_to_eol(frames_arg->sval[i], 0, frames[i], CHKFIND_MAX_LEN, &lens[i]) || lens[i] <= width) {
+            CLIParserFree(ctx);
+            free(frames);
+            PrintAndLogEx(FAILED, "Frame %u must be hex,  longer than the checksum and at most %u bytes", i + 1, CHKFIND_MAX_LEN);
+            return PM3_EINVARG;
+        }
+    }
+    CLIParserFree(ctx);
+
+    if (n < 3) {
+        PrintAndLogEx(WARNING, "With less than 3 frames most candidates match by chance");
+    }
+
+    chk_candidate_t top[CHKFIND_TOP];
+    uint8_t ntop = chk_find(frames, lens, n, width, top);
+    free(frames);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "frames | family     | bytes        | checksum");
+    PrintAndLogEx(INFO, "-------+------------+--------------+-------------------------------");
+    for (uint8_t i = 0; i < ntop; i++) {
+        const chk_candidate_t *c = &top[i];
+
+        char range[20];
+        if (c->skip) {
+            snprintf(range, sizeof(range), "%u .. chk-%u", c->start, c->skip + 1);
+        } else {
+            snprintf(range, sizeof(range), "%u .. chk-1", c->start);
+        }
+
+        char rel[40];
+        const char *op = (c->relation == CHK_REL_ADD) ? "F + " : (c->relation == CHK_REL_SUB) ? "" : "F ^ ";
+        if (c->relation == CHK_REL_SUB) {
+            snprintf(rel, sizeof(rel), "(0x%X - F) & 0x%X", c->k, c->mask);
+        } else {
+            snprintf(rel, sizeof(rel), "(%s0x%X) & 0x%X", op, c->k, c->mask);
+        }
+
+        PrintAndLogEx(INFO, " " _YELLOW_("%2u") "/%-2u | %-10s | %-12s | %s%s",
+                      c->count, n, chk_family_names[c->family], range, rel,
+                      (width == 2) ? ((c->little_endian) ? ", LE" : ", BE") : "");
+    }
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
 static int CmdAnalyseDates(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "analyse dates",
@@ -1174,6 +1449,7 @@ static command_t CommandTable[] = {
     {"lcr",     CmdAnalyseLCR,      AlwaysAvailable, "Generate final byte for XOR LRC"},
     {"crc",     CmdAnalyseCRC,      AlwaysAvailable, "Stub method for CRC evaluations"},
     {"chksum",  CmdAnalyseCHKSUM,   AlwaysAvailable, "Checksum with adding, masking and one's complement"},
+    {"chkfind", CmdAnalyseCHKFIND,  AlwaysAvailable, "Search the checksum of a set of frames"},
     {"dates",   CmdAnalyseDates,    AlwaysAvailable, "Look for datestamps in a given array of bytes"},
     {"lfsr",    CmdAnalyseLfsr,     AlwaysAvailable, "LFSR tests"},
     {"a",       CmdAnalyseA,        AlwaysAvailable, "num bits test"},
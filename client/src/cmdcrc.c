@@ -410,6 +410,49 @@ static char *SwapEndianStr(const char *inStr, const size_t len, const uint8_t bl
     return tmp;
 }
 
+// matches of the last frames searched,  a repeated frame is answered from here
+#define SEARCH_CACHE            16
+#define SEARCH_CACHE_MATCHES    16
+
+#define SEARCH_REVERSED         1
+#define SEARCH_SWAPPED          2
+
+typedef struct {
+    char model[40];
+    char value[50 + 1];
+    uint8_t flags;
+} search_match_t;
+
+typedef struct {
+    char hex[256];
+    uint8_t count;
+    search_match_t matches[SEARCH_CACHE_MATCHES];
+} search_cache_t;
+
+static search_cache_t search_cache[SEARCH_CACHE];
+static uint8_t search_cache_next = 0;
+
+static void search_print(const search_match_t *m) {
+    PrintAndLogEx(SUCCESS, "model%s... " _YELLOW_("%s"), (m->flags & SEARCH_REVERSED) ? " reversed" : "", m->model);
+    PrintAndLogEx(SUCCESS, "value%s... %s\n", (m->flags & SEARCH_SWAPPED) ? " endian swapped" : "", m->value);
+}
+
+// print the match and keep it for the cache entry,  an entry that overflows isn't used
+static void search_found(search_cache_t *entry, const char *model, const char *value, uint8_t flags) {
+    search_match_t m = {0};
+    snprintf(m.model, sizeof(m.model), "%s", model);
+    snprintf(m.value, sizeof(m.value), "%s", value);
+    m.flags = flags;
+    search_print(&m);
+
+    if (entry->count < SEARCH_CACHE_MATCHES) {
+        entry->matches[entry->count] = m;
+    }
+    if (entry->count < UINT8_MAX) {
+        entry->count++;
+    }
+}
+
 // takes hex string in and searches for a matching result (hex string must include checksum)
 static int CmdrevengSearch(const char *Cmd) {
 
@@ -419,6 +462,25 @@ static int CmdrevengSearch(const char *Cmd) {
     int dataLen = param_getstr(Cmd, 0, inHexStr, sizeof(inHexStr));
     if (dataLen < 4) return 0;
 
+    str_lower(inHexStr);
+
+    for (uint8_t i = 0; i < SEARCH_CACHE; i++) {
+        const search_cache_t *c = &search_cache[i];
+        if (c->hex[0] == '\0' || strcmp(c->hex, inHexStr) != 0) {
+            continue;
+        }
+        for (uint8_t j = 0; j < c->count; j++) {
+            search_print(&c->matches[j]);
+        }
+        if (c->count == 0) {
+            PrintAndLogEx(FAILED, "\nno matches found\n");
+        }
+        return PM3_SUCCESS;
+    }
+
+    search_cache_t entry;
+    memset(&entry, 0, sizeof(entry));
+
     // these two arrays, must match preset size.
     char *Models[NMODELS];
     uint8_t width[NMODELS] = {0};
@@ -435,8 +497,6 @@ static int CmdrevengSearch(const char *Cmd) {
         return 0;
     }
 
-    str_lower(inHexStr);
-
     // try each model and get result
     for (int i = 0; i < count; i++) {
         /*if (found) {
@@ -486,16 +546,14 @@ static int CmdrevengSearch(const char *Cmd) {
 
             // test for match
             if (memcmp(result, inCRC, crcChars) == 0) {
-                PrintAndLogEx(SUCCESS, "model... " _YELLOW_("%s"), Models[i]);
-                PrintAndLogEx(SUCCESS, "value... %s\n", result);
+                search_found(&entry, Models[i], result, 0);
                 //optional - stop searching if found...
                 found = true;
             } else {
                 if (crcChars > 2) {
                     char *swapEndian = SwapEndianStr(result, crcChars, crcChars);
                     if (memcmp(swapEndian, inCRC, crcChars) == 0) {
-                        PrintAndLogEx(SUCCESS, "model... " _YELLOW_("%s"), Models[i]);
-                        PrintAndLogEx(SUCCESS, "value endian swapped... %s\n", swapEndian);
+                        search_found(&entry, Models[i], swapEndian, SEARCH_SWAPPED);
                         // optional - stop searching if found...
                         found = true;
                     }
@@ -509,16 +567,14 @@ static int CmdrevengSearch(const char *Cmd) {
 
             // test for match
             if (memcmp(revResult, inCRC, crcChars) == 0) {
-                PrintAndLogEx(SUCCESS, "model reversed... " _YELLOW_("%s"), Models[i]);
-                PrintAndLogEx(SUCCESS, "value... %s\n", revResult);
+                search_found(&entry, Models[i], revResult, SEARCH_REVERSED);
                 // optional - stop searching if found...
                 found = true;
             } else {
                 if (crcChars > 2) {
                     char *swapEndian = SwapEndianStr(revResult, crcChars, crcChars);
                     if (memcmp(swapEndian, inCRC, crcChars) == 0) {
-                        PrintAndLogEx(SUCCESS, "model reversed... " _YELLOW_("%s"), Models[i]);
-                        PrintAndLogEx(SUCCESS, "value endian swapped... %s\n", swapEndian);
+                        search_found(&entry, Models[i], swapEndian, SEARCH_REVERSED | SEARCH_SWAPPED);
                         // optional - stop searching if found...
                         found = true;
                     }
@@ -534,6 +590,12 @@ static int CmdrevengSearch(const char *Cmd) {
     if (found == false) {
         PrintAndLogEx(FAILED, "\nno matches found\n");
     }
+
+    if (entry.count <= SEARCH_CACHE_MATCHES) {
+        snprintf(entry.hex, sizeof(entry.hex), "%s", inHexStr);
+        search_cache[search_cache_next] = entry;
+        search_cache_next = (search_cache_next + 1) % SEARCH_CACHE;
+    }
     return PM3_SUCCESS;
 }
 
@@ -18,7 +18,6 @@
 #include "cmddata.h"
 #include <stdio.h>
 #include <string.h>
-#include <limits.h>              // for CmdNorm INT_MIN && INT_MAX
 #include <math.h>                // pow
 #include <ctype.h>               // tolower
 #include <locale.h>              // number formatter..
@@ -27,11 +26,18 @@
 #include "ui.h"                  // for show graph controls
 #include "proxgui.h"
 #include "graph.h"               // for graph data
+#include "graphdsp.h"            // graph filter kernels
 #include "comms.h"
 #include "lfdemod.h"             // for demod code
 #include "loclass/cipherutils.h" // for decimating samples in getsamples
 #include "cmdlfem410x.h"         // askem410xdecode
 #include "fileutils.h"           // searchFile
+#include "lfstream.h"            // batch decoding
+#include "scandir.h"
+#include "util.h"                // num_CPUs
+#include "util_posix.h"          // msclock
+#include "jansson.h"
+#include <pthread.h>
 #include "cliparser.h"
 #include "cmdlft55xx.h"          // print...
 #include "crypto/asn1utils.h"    // ASN1 decode / print
@@ -42,12 +48,6 @@
 #include "atrs.h"                // ATR lookup
 #include "crypto/libpcrypto.h"   // Cryptography
 
-
-uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN] = { 0x00 };
-size_t g_DemodBufferLen = 0;
-int32_t g_DemodStartIdx = 0;
-int g_DemodClock = 0;
-
 static int CmdHelp(const char *Cmd);
 
 
@@ -149,7 +149,7 @@ static double median_uint8(uint8_t *src, size_t size) {
 }
 */
 // function to compute mean for a series
-static double compute_mean(const int *data, size_t n) {
+static double compute_mean(const int16_t *data, size_t n) {
     double mean = 0.0;
     for (size_t i = 0; i < n; i++)
         mean += data[i];
@@ -158,7 +158,7 @@ static double compute_mean(const int *data, size_t n) {
 }
 
 //  function to compute variance for a series
-static double compute_variance(const int *data, size_t n) {
+static double compute_variance(const int16_t *data, size_t n) {
     double variance = 0.0;
     double mean = compute_mean(data, n);
 
@@ -173,7 +173,7 @@ static double compute_variance(const int *data, size_t n) {
 //  Author: Kenneth J. Christensen
 //  - Corrected divide by n to divide (n - lag) from Tobias Mueller
 /*
-static double compute_autoc(const int *data, size_t n, int lag) {
+static double compute_autoc(const int16_t *data, size_t n, int lag) {
     double autocv = 0.0;    // Autocovariance value
     double ac_value;        // Computed autocorrelation value to be returned
     double variance;        // Computed variance
@@ -843,7 +843,126 @@ static int Cmdaskrawdemod(const char *Cmd) {
     return ASKDemod_ext(clk, invert, max_err, max_len, amplify, true, false, 0, &st);
 }
 
-int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
+// in place radix-2 FFT,  n must be a power of two
+static void fft_radix2(double *re, double *im, size_t n, bool inverse) {
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            double t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (size_t step = 2; step <= n; step <<= 1) {
+        size_t half = step >> 1;
+        double ang = (inverse ? 2.0 : -2.0) * M_PI / step;
+        for (size_t k = 0; k < half; k++) {
+            double wr = cos(ang * k);
+            double wi = sin(ang * k);
+            for (size_t i = k; i < n; i += step) {
+                size_t j = i + half;
+                double tr = re[j] * wr - im[j] * wi;
+                double ti = re[j] * wi + im[j] * wr;
+                re[j] = re[i] - tr;
+                im[j] = im[i] - ti;
+                re[i] += tr;
+                im[i] += ti;
+            }
+        }
+    }
+}
+
+// lag sums S[i] = sum (in[j] - mean) * (in[j + i] - mean) for i < lags.
+// Large inputs go through an FFT (Wiener-Khinchin),  which gives every lag at once.
+// lf search asks again for the same samples with growing windows,  the last FFT is kept.
+static __thread double *lagsum_cache = NULL;
+static __thread int16_t *lagsum_input = NULL;
+static __thread size_t lagsum_len = 0;
+
+static double *autocorr_lagsums(const int16_t *in, size_t len, double mean, size_t lags) {
+
+    if (lagsum_cache && lagsum_len == len && memcmp(lagsum_input, in, len * sizeof(int16_t)) == 0) {
+        return lagsum_cache;
+    }
+
+    size_t n = 1;
+    uint8_t logn = 0;
+    while (n < 2 * len) {
+        n <<= 1;
+        logn++;
+    }
+
+    // number of multiply-adds, the direct sums against two transforms and the spectrum
+    double direct = (double)lags * len - ((double)lags * lags) / 2;
+    double fft = 6.0 * n * logn;
+
+    if (direct <= fft) {
+        double *sums = calloc(lags + 1, sizeof(double));
+        if (sums == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < lags; i++) {
+            double acc = 0.0;
+            for (size_t j = 0; j < (len - i); j++) {
+                acc += (in[j] - mean) * (in[j + i] - mean);
+            }
+            sums[i] = acc;
+        }
+        // not cached, it only holds the lags for this window
+        return sums;
+    }
+
+    double *re = calloc(n, sizeof(double));
+    double *im = calloc(n, sizeof(double));
+    int16_t *copy = calloc(len, sizeof(int16_t));
+    if (re == NULL || im == NULL || copy == NULL) {
+        free(re);
+        free(im);
+        free(copy);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        re[i] = in[i] - mean;
+    }
+
+    // zero padded to 2*len, so the circular correlation equals the linear one
+    fft_radix2(re, im, n, false);
+    for (size_t i = 0; i < n; i++) {
+        re[i] = re[i] * re[i] + im[i] * im[i];
+        im[i] = 0.0;
+    }
+    fft_radix2(re, im, n, true);
+
+    for (size_t i = 0; i < len; i++) {
+        re[i] /= n;
+    }
+    free(im);
+
+    double *sums = realloc(re, len * sizeof(double));
+    if (sums == NULL) {
+        sums = re;
+    }
+    memcpy(copy, in, len * sizeof(int16_t));
+
+    free(lagsum_cache);
+    free(lagsum_input);
+    lagsum_cache = sums;
+    lagsum_input = copy;
+    lagsum_len = len;
+    return sums;
+}
+
+int AutoCorrelate(const int16_t *in, int16_t *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
     // sanity check
     if (window > len) {
         window = len;
@@ -859,16 +978,23 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     // Computed variance
     double variance = compute_variance(in, len);
 
-    int *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    double *sums = autocorr_lagsums(in, len, mean, len - window);
+    int32_t *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int32_t));
+    if (sums == NULL || correl_buf == NULL) {
+        if (sums != lagsum_cache) {
+            free(sums);
+        }
+        free(correl_buf);
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return -1;
+    }
 
     uint8_t peak_cnt = 0;
     size_t peaks[10] = {0};
 
     for (size_t i = 0; i < len - window; ++i) {
 
-        for (size_t j = 0; j < (len - i); j++) {
-            autocv += (in[j] - mean) * (in[j + i] - mean);
-        }
+        autocv += sums[i];
         autocv = (1.0 / (len - i)) * autocv;
 
         correl_buf[i] = autocv;
@@ -914,17 +1040,26 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
         }
     } else {
         PrintAndLogEx(HINT, "No repeating pattern found, try increasing window size");
+        if (sums != lagsum_cache) {
+            free(sums);
+        }
+        free(correl_buf);
         // return value -1, indication to increase window size
         return -1;
     }
 
     if (SaveGrph) {
         //g_GraphTraceLen = g_GraphTraceLen - window;
-        memcpy(out, correl_buf, len * sizeof(int));
+        for (size_t i = 0; i < len; i++) {
+            out[i] = clampGraphSample(correl_buf[i]);
+        }
         setClockGrid(distance, 0);
         g_DemodBufferLen = 0;
         RepaintGraphWindow();
     }
+    if (sums != lagsum_cache) {
+        free(sums);
+    }
     free(correl_buf);
     return distance;
 }
@@ -1038,10 +1173,12 @@ static int CmdDecimate(const char *Cmd) {
     int n = arg_get_int_def(ctx, 1, 2);
     CLIParserFree(ctx);
 
-    for (size_t i = 0; i < (g_GraphTraceLen / n); ++i)
-        g_GraphBuffer[i] = g_GraphBuffer[i * n];
+    if (n < 1) {
+        PrintAndLogEx(WARNING, "decimation factor must be 1 or more");
+        return PM3_EINVARG;
+    }
 
-    g_GraphTraceLen /= n;
+    g_GraphTraceLen = dsp_decimate(g_GraphBuffer, g_GraphBuffer, (g_GraphTraceLen / n) * n, n);
     PrintAndLogEx(SUCCESS, "decimated by " _GREEN_("%u"), n);
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -1071,7 +1208,7 @@ static int CmdUndecimate(const char *Cmd) {
     CLIParserFree(ctx);
 
     //We have memory, don't we?
-    int *swap = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    int32_t *swap = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int32_t));
     if (swap == NULL) {
         PrintAndLogEx(FAILED, "failed to allocate memory");
         return PM3_EMALLOC;
@@ -1089,8 +1226,7 @@ static int CmdUndecimate(const char *Cmd) {
         g_index++;
     }
 
-    memcpy(g_GraphBuffer, swap, s_index * sizeof(int));
-    g_GraphTraceLen = s_index;
+    setGraphBufferS32(swap, s_index);
     RepaintGraphWindow();
     free(swap);
     return PM3_SUCCESS;
@@ -1127,7 +1263,7 @@ static int CmdGraphShiftZero(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-int AskEdgeDetect(const int *in, int *out, int len, int threshold) {
+int AskEdgeDetect(const int16_t *in, int16_t *out, int len, int threshold) {
     int last = 0;
     for (int i = 1; i < len; i++) {
         if (in[i] - in[i - 1] >= threshold) //large jump up
@@ -1952,12 +2088,50 @@ static int CmdSamples(const char *Cmd) {
 }
 
 
+// one sample per line,  like atoi() on each line
+static size_t load_pm3_text(const mapped_file_t *m, int16_t *dst, size_t max) {
+    const uint8_t *p = m->data;
+    const uint8_t *end = m->data + m->size;
+    size_t n = 0;
+
+    while (p < end && n < max) {
+        while (p < end && (*p == ' ' || *p == '\t')) {
+            p++;
+        }
+
+        bool neg = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            neg = (*p == '-');
+            p++;
+        }
+
+        int32_t v = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (v < 0x1000000) {
+                v = v * 10 + (*p - '0');
+            }
+            p++;
+        }
+        dst[n++] = clampGraphSample(neg ? -v : v);
+
+        while (p < end && *p != '\n') {
+            p++;
+        }
+        p++;
+    }
+    return n;
+}
+
 static int CmdLoad(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "data load",
-                  "This command loads the contents of a pm3 file into graph window\n",
-                  "data load -f myfilename"
+                  "This command loads the contents of a pm3 file into graph window\n"
+                  "A .pm3b file, see `data save --pm3b`, is loaded as is\n"
+                  "A .wav file, 8 or 16 bit PCM, is loaded from its first channel",
+                  "data load -f myfilename\n"
+                  "data load -f myfilename.pm3b\n"
+                  "data load -f myfilename.wav"
                  );
 
     void *argtable[] = {
@@ -1983,41 +2157,42 @@ static int CmdLoad(const char *Cmd) {
         }
     }
 
-    FILE *f;
-    if (is_bin)
-        f = fopen(path, "rb");
-    else
-        f = fopen(path, "r");
-
-    if (f == NULL) {
-        PrintAndLogEx(WARNING, "couldn't open '%s'", path);
+    if (str_endswith(path, ".pm3b")) {
+        size_t n = 0;
+        int res = loadFilePM3B(path, g_GraphBuffer, MAX_GRAPH_TRACE_LEN, &n);
         free(path);
-        return PM3_EFILE;
-    }
-    free(path);
-
-    g_GraphTraceLen = 0;
-
-    if (is_bin) {
-        uint8_t val[2];
-        while (fread(val, 1, 1, f)) {
-            g_GraphBuffer[g_GraphTraceLen] = val[0] - 127;
-            g_GraphTraceLen++;
-
-            if (g_GraphTraceLen >= MAX_GRAPH_TRACE_LEN)
-                break;
+        if (res != PM3_SUCCESS) {
+            return res;
         }
+        g_GraphTraceLen = n;
+    } else if (str_endswith(path, ".wav")) {
+        size_t n = 0;
+        int res = loadFileWAVE(path, g_GraphBuffer, MAX_GRAPH_TRACE_LEN, &n);
+        free(path);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        g_GraphTraceLen = n;
     } else {
-        char line[80];
-        while (fgets(line, sizeof(line), f)) {
-            g_GraphBuffer[g_GraphTraceLen] = atoi(line);
-            g_GraphTraceLen++;
+        mapped_file_t m;
+        if (mapFile(path, &m) != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "couldn't open '%s'", path);
+            free(path);
+            return PM3_EFILE;
+        }
+        free(path);
 
-            if (g_GraphTraceLen >= MAX_GRAPH_TRACE_LEN)
-                break;
+        if (is_bin) {
+            size_t n = MIN(m.size, MAX_GRAPH_TRACE_LEN);
+            for (size_t i = 0; i < n; i++) {
+                g_GraphBuffer[i] = m.data[i] - 127;
+            }
+            g_GraphTraceLen = n;
+        } else {
+            g_GraphTraceLen = load_pm3_text(&m, g_GraphBuffer, MAX_GRAPH_TRACE_LEN);
         }
+        releaseFileMapped(&m);
     }
-    fclose(f);
 
     PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%s") " samples", commaprint(g_GraphTraceLen));
 
@@ -2041,6 +2216,409 @@ static int CmdLoad(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// --------------------------------------------------------------------------------------------------
+// data decode - batch decoding of sample files
+//
+// Every file is decoded into its own lfstream context on a worker thread,  the signal properties
+// and detector caches in lfdemod are per thread,  so no graph / demod buffer globals are touched.
+
+#define DECODE_MAX_FILES    4096
+
+typedef struct {
+    char *path;
+    size_t samples;
+    int status;
+    uint8_t id_count;
+    lfstream_id_t ids[LFSTREAM_MAX_IDS];
+} decode_result_t;
+
+typedef struct {
+    decode_result_t *results;
+    size_t count;
+    size_t next;
+} decode_job_t;
+
+static uint16_t decode_le16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t decode_le32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// PCM wav, 8 bit unsigned or 16 bit signed,  only the first channel is used
+static size_t decode_load_wav(FILE *f, uint8_t *dest, size_t maxlen) {
+    uint8_t hdr[12];
+    if (fread(hdr, 1, sizeof(hdr), f) != sizeof(hdr) || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        return 0;
+    }
+
+    uint16_t channels = 0, bits = 0;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+        uint32_t len = decode_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            uint8_t fmt[16];
+            if (len < sizeof(fmt) || fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt)) {
+                return 0;
+            }
+            if (decode_le16(fmt) != 1) { // PCM only
+                return 0;
+            }
+            channels = decode_le16(fmt + 2);
+            bits = decode_le16(fmt + 14);
+            len -= sizeof(fmt);
+
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (channels == 0 || (bits != 8 && bits != 16)) {
+                return 0;
+            }
+
+            size_t frame = channels * (bits / 8);
+            uint8_t buf[64];
+            size_t n = 0;
+            while (n < maxlen && len >= frame && fread(buf, 1, frame, f) == frame) {
+                if (bits == 8) {
+                    dest[n++] = buf[0];
+                } else {
+                    dest[n++] = (uint8_t)(((int16_t)decode_le16(buf) >> 8) + 128);
+                }
+                len -= frame;
+            }
+            return n;
+        }
+
+        // skip chunk, they are word aligned
+        if (fseek(f, len + (len & 1), SEEK_CUR) != 0) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// pm3 text trace, one sample per line
+static size_t decode_load_pm3(FILE *f, uint8_t *dest, size_t maxlen) {
+    char line[80];
+    size_t n = 0;
+    while (n < maxlen && fgets(line, sizeof(line), f)) {
+        int v = atoi(line);
+        if (v > 127) v = 127;
+        if (v < -127) v = -127;
+        dest[n++] = (uint8_t)(v + 128);
+    }
+    return n;
+}
+
+static void decode_file(decode_result_t *r, uint8_t *samples, lfstream_t *stream) {
+
+    FILE *f = fopen(r->path, "rb");
+    if (f == NULL) {
+        r->status = PM3_EFILE;
+        return;
+    }
+
+    if (str_endswith(r->path, ".wav")) {
+        r->samples = decode_load_wav(f, samples, MAX_GRAPH_TRACE_LEN);
+    } else {
+        r->samples = decode_load_pm3(f, samples, MAX_GRAPH_TRACE_LEN);
+    }
+    fclose(f);
+
+    if (r->samples == 0) {
+        r->status = PM3_EFILE;
+        return;
+    }
+
+    // same preparation as `data load`
+    removeSignalOffset(samples, r->samples);
+
+    lfstream_init(stream, 8);
+    stream->quiet = true;
+
+    // step sized chunks, a single push only scans the window it ends with
+    for (size_t off = 0; off < r->samples; off += LFSTREAM_STEP) {
+        lfstream_push(stream, samples + off, MIN(LFSTREAM_STEP, r->samples - off));
+    }
+
+    r->id_count = stream->id_count;
+    memcpy(r->ids, stream->ids, sizeof(lfstream_id_t) * stream->id_count);
+    r->status = PM3_SUCCESS;
+}
+
+static void *decode_worker(void *arg) {
+    decode_job_t *job = (decode_job_t *)arg;
+
+    uint8_t *samples = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    lfstream_t *stream = calloc(1, sizeof(lfstream_t));
+
+    if (samples && stream) {
+        for (;;) {
+            size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+            if (i >= job->count) {
+                break;
+            }
+            decode_file(&job->results[i], samples, stream);
+        }
+    }
+
+    free(stream);
+    free(samples);
+    lfdemod_thread_free();
+    return NULL;
+}
+
+// minimal '*' and '?' matching for file names
+static bool decode_match(const char *pattern, const char *name) {
+    if (*pattern == '\0') {
+        return (*name == '\0');
+    }
+    if (*pattern == '*') {
+        return decode_match(pattern + 1, name) || (*name && decode_match(pattern, name + 1));
+    }
+    if (*name && (*pattern == '?' || *pattern == *name)) {
+        return decode_match(pattern + 1, name + 1);
+    }
+    return false;
+}
+
+static size_t decode_collect(const char *search, decode_result_t *results, size_t max) {
+
+    char dir[FILE_PATH_SIZE] = {0};
+    const char *pattern = NULL;
+
+    if (is_directory(search)) {
+        snprintf(dir, sizeof(dir), "%s", search);
+    } else if (strpbrk(search, "*?") == NULL) {
+        results[0].path = strdup(search);
+        return (results[0].path) ? 1 : 0;
+    } else {
+        const char *slash = strrchr(search, '/');
+        if (slash) {
+            snprintf(dir, sizeof(dir), "%.*s", (int)(slash - search), search);
+            pattern = slash + 1;
+        } else {
+            snprintf(dir, sizeof(dir), ".");
+            pattern = search;
+        }
+    }
+
+    struct dirent **namelist;
+    int n = scandir(dir, &namelist, NULL, alphasort);
+    if (n < 0) {
+        return 0;
+    }
+
+    size_t cnt = 0;
+    for (int i = 0; i < n; i++) {
+        const char *name = namelist[i]->d_name;
+
+        bool use;
+        if (pattern) {
+            use = decode_match(pattern, name);
+        } else {
+            use = str_endswith(name, ".pm3") || str_endswith(name, ".wav");
+        }
+
+        if (use && cnt < max) {
+            size_t len = strlen(dir) + strlen(name) + 2;
+            results[cnt].path = calloc(len, sizeof(char));
+            if (results[cnt].path) {
+                snprintf(results[cnt].path, len, "%s/%s", dir, name);
+                if (is_directory(results[cnt].path) == false) {
+                    cnt++;
+                } else {
+                    free(results[cnt].path);
+                    results[cnt].path = NULL;
+                }
+            }
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return cnt;
+}
+
+static int decode_save_csv(const char *fn, const decode_result_t *results, size_t count) {
+    FILE *f = fopen(fn, "w");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open '%s'", fn);
+        return PM3_EFILE;
+    }
+
+    fprintf(f, "file,samples,tag,id,sample\n");
+    for (size_t i = 0; i < count; i++) {
+        const decode_result_t *r = &results[i];
+        if (r->id_count == 0) {
+            fprintf(f, "%s,%zu,,,\n", r->path, r->samples);
+        }
+        for (uint8_t j = 0; j < r->id_count; j++) {
+            fprintf(f, "%s,%zu,%s,%s,%" PRIu64 "\n", r->path, r->samples, lfstream_name(r->ids[j].type), r->ids[j].raw, r->ids[j].sample);
+        }
+    }
+    fclose(f);
+    return PM3_SUCCESS;
+}
+
+// one record per file, written as soon as it is built
+static int decode_save_json(const char *fn, const decode_result_t *results, size_t count) {
+    json_stream_t js;
+    int res = JsonStreamOpen(&js, fn, true, false, true);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    for (size_t i = 0; i < count && res == PM3_SUCCESS; i++) {
+        const decode_result_t *r = &results[i];
+
+        json_t *ids = json_array();
+        for (uint8_t j = 0; j < r->id_count; j++) {
+            json_array_append_new(ids, json_pack("{s:s, s:s, s:I}",
+                                                 "tag", lfstream_name(r->ids[j].type),
+                                                 "id", r->ids[j].raw,
+                                                 "sample", (json_int_t)r->ids[j].sample));
+        }
+        res = JsonStreamAdd(&js, NULL, json_pack("{s:s, s:I, s:o}",
+                                                 "file", r->path,
+                                                 "samples", (json_int_t)r->samples,
+                                                 "ids", ids));
+    }
+
+    if (JsonStreamClose(&js) != PM3_SUCCESS || res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "couldn't save '%s'", fn);
+        return PM3_EFILE;
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdDecode(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data decode",
+                  "Decode EM410x / HID / AWID / Indala ids from a directory, wildcard or single .pm3 / .wav file.\n"
+                  "Files are decoded in parallel and do not touch the graph window",
+                  "data decode -f traces/                   --> all .pm3 / .wav files in traces\n"
+                  "data decode -f traces/lf_EM*.pm3 -o r.csv --> save results as CSV\n"
+                  "data decode -f traces/ -o r.json --json   --> save results as JSON"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "directory, wildcard or file to decode"),
+        arg_str0("o", "out", "<fn>", "save results to file (CSV)"),
+        arg_lit0(NULL, "json", "save results as JSON instead of CSV"),
+        arg_int0("t", "threads", "<dec>", "number of worker threads (def all cpus)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int outlen = 0;
+    char outfn[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)outfn, FILE_PATH_SIZE, &outlen);
+
+    bool use_json = arg_get_lit(ctx, 3);
+    int threads = arg_get_int_def(ctx, 4, num_CPUs());
+    CLIParserFree(ctx);
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    decode_result_t *results = calloc(DECODE_MAX_FILES, sizeof(decode_result_t));
+    if (results == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    size_t count = decode_collect(filename, results, DECODE_MAX_FILES);
+    if (count == 0) {
+        PrintAndLogEx(WARNING, "no files found for " _YELLOW_("%s"), filename);
+        free(results);
+        return PM3_EFILE;
+    }
+
+    if ((size_t)threads > count) {
+        threads = count;
+    }
+
+    PrintAndLogEx(INFO, "Decoding " _YELLOW_("%zu") " files using " _YELLOW_("%d") " threads", count, threads);
+
+    decode_job_t job = { .results = results, .count = count, .next = 0 };
+    pthread_t *pool = calloc(threads, sizeof(pthread_t));
+    if (pool == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        free(results);
+        return PM3_EMALLOC;
+    }
+
+    // computeSignalProperties / removeSignalOffset sort a copy of the samples on the stack,
+    // the default thread stack is too small for that on some platforms
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, MAX_GRAPH_TRACE_LEN * 4);
+
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&pool[started], &attr, decode_worker, &job)) {
+            PrintAndLogEx(WARNING, "Failed to create pthreads");
+            break;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    // the calling thread helps out if no worker could be started
+    if (started == 0) {
+        decode_worker(&job);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    free(pool);
+
+    size_t found = 0;
+    PrintAndLogEx(NORMAL, "");
+    for (size_t i = 0; i < count; i++) {
+        const decode_result_t *r = &results[i];
+        if (r->status != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "%s - " _RED_("failed to load"), r->path);
+            continue;
+        }
+        if (r->id_count == 0) {
+            PrintAndLogEx(INFO, "%s - no id", r->path);
+            continue;
+        }
+        found++;
+        for (uint8_t j = 0; j < r->id_count; j++) {
+            PrintAndLogEx(SUCCESS, "%s - %s " _GREEN_("%s"), r->path, lfstream_name(r->ids[j].type), r->ids[j].raw);
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "Found ids in " _YELLOW_("%zu") " of " _YELLOW_("%zu") " files", found, count);
+
+    int res = PM3_SUCCESS;
+    if (outlen) {
+        if (use_json) {
+            res = decode_save_json(outfn, results, count);
+        } else {
+            res = decode_save_csv(outfn, results, count);
+        }
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Saved results to " _YELLOW_("%s"), outfn);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        free(results[i].path);
+    }
+    free(results);
+    return res;
+}
+
 // trim graph from the end
 int CmdLtrim(const char *Cmd) {
     CLIParserContext *ctx;
@@ -2154,18 +2732,15 @@ int CmdNorm(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
-    int max = INT_MIN, min = INT_MAX;
-
-    // Find local min, max
-    for (uint32_t i = 10; i < g_GraphTraceLen; ++i) {
-        if (g_GraphBuffer[i] > max) max = g_GraphBuffer[i];
-        if (g_GraphBuffer[i] < min) min = g_GraphBuffer[i];
-    }
+    if (g_GraphTraceLen > 10) {
+        // Find local min, max
+        int16_t min, max;
+        dsp_minmax(g_GraphBuffer + 10, g_GraphTraceLen - 10, &min, &max);
 
-    if ((g_GraphTraceLen > 10) && (max != min)) {
-        for (uint32_t i = 0; i < g_GraphTraceLen; ++i) {
-            g_GraphBuffer[i] = ((long)(g_GraphBuffer[i] - ((max + min) / 2)) * 256) / (max - min);
-            //marshmelow: adjusted *1000 to *256 to make +/- 128 so demod commands still work
+        //marshmelow: adjusted *1000 to *256 to make +/- 128 so demod commands still work
+        if (max != min) {
+            // the first samples aren't part of min/max and may land outside +/-128
+            dsp_norm(g_GraphBuffer, g_GraphTraceLen, (max + min) / 2, max - min);
         }
     }
 
@@ -2208,18 +2783,21 @@ int CmdSave(const char *Cmd) {
                   "This is a text file with number -127 to 127.  With the option `w` you can save it as wave file\n"
                   "Filename should be without file extension",
                   "data save -f myfilename         -> save graph buffer to file\n"
-                  "data save --wave -f myfilename  -> save graph buffer to wave file"
+                  "data save --wave -f myfilename  -> save graph buffer to wave file\n"
+                  "data save --pm3b -f myfilename  -> save graph buffer to binary file, fast to load"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("w", "wave", "save as wave format (.wav)"),
         arg_str1("f", "file", "<fn w/o ext>", "save file name"),
+        arg_lit0(NULL, "pm3b", "save as binary samples (.pm3b)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
 
     bool as_wave = arg_get_lit(ctx, 1);
+    bool as_pm3b = arg_get_lit(ctx, 3);
 
     int fnlen = 0;
     char filename[FILE_PATH_SIZE] = {0};
@@ -2232,8 +2810,15 @@ int CmdSave(const char *Cmd) {
         return PM3_SUCCESS;
     }
 
+    if (as_wave && as_pm3b) {
+        PrintAndLogEx(WARNING, "select only one of " _YELLOW_("--wave --pm3b"));
+        return PM3_EINVARG;
+    }
+
     if (as_wave)
         return saveFileWAVE(filename, g_GraphBuffer, g_GraphTraceLen);
+    else if (as_pm3b)
+        return saveFilePM3B(filename, g_GraphBuffer, g_GraphTraceLen);
     else
         return saveFilePM3(filename, g_GraphBuffer, g_GraphTraceLen);
 }
@@ -2269,32 +2854,10 @@ static int CmdTimeScale(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-int directionalThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down) {
-
-    int lastValue = in[0];
-
-    // Will be changed at the end, but init 0 as we adjust to last samples
-    // value if no threshold kicks in.
-    out[0] = 0;
-
-    for (size_t i = 1; i < len; ++i) {
-        // Apply first threshold to samples heading up
-        if (in[i] >= up && in[i] > lastValue) {
-            lastValue = out[i]; // Buffer last value as we overwrite it.
-            out[i] = 1;
-        }
-        // Apply second threshold to samples heading down
-        else if (in[i] <= down && in[i] < lastValue) {
-            lastValue = out[i]; // Buffer last value as we overwrite it.
-            out[i] = -1;
-        } else {
-            lastValue = out[i]; // Buffer last value as we overwrite it.
-            out[i] = out[i - 1];
-        }
-    }
-
-    // Align with first edited sample.
-    out[0] = out[1];
+int directionalThreshold(const int16_t *in, int16_t *out, size_t len, int8_t up, int8_t down) {
+    // outputs 0 until the first threshold kicks in, the first output is aligned with the second
+    dsp_dirthreshold_t state = {0};
+    dsp_dirthreshold(in, out, len, up, down, &state);
     return PM3_SUCCESS;
 }
 
@@ -2356,11 +2919,11 @@ static int CmdZerocrossings(const char *Cmd) {
         if (g_GraphBuffer[i] * sign >= 0) {
             // No change in sign, reproduce the previous sample count.
             zc++;
-            g_GraphBuffer[i] = lastZc;
+            g_GraphBuffer[i] = clampGraphSample(lastZc);
         } else {
             // Change in sign, reset the sample count.
             sign = -sign;
-            g_GraphBuffer[i] = lastZc;
+            g_GraphBuffer[i] = clampGraphSample(lastZc);
             if (sign > 0) {
                 lastZc = zc;
                 zc = 0;
@@ -2474,7 +3037,7 @@ static void GetHiLoTone(int *LowTone, int *HighTone, int clk, int LowToneFC, int
 
 //old CmdFSKdemod adapted by marshmellow
 //converts FSK to clear NRZ style wave.  (or demodulates)
-static int FSKToNRZ(int *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC, uint8_t HighToneFC) {
+static int FSKToNRZ(int32_t *data, size_t *dataLen, uint8_t clk, uint8_t LowToneFC, uint8_t HighToneFC) {
     uint8_t ans = 0;
     if (clk == 0 || LowToneFC == 0 || HighToneFC == 0) {
         int firstClockEdge = 0;
@@ -2559,7 +3122,16 @@ static int CmdFSKToNRZ(const char *Cmd) {
 
     setClockGrid(0, 0);
     g_DemodBufferLen = 0;
-    int ans = FSKToNRZ(g_GraphBuffer, &g_GraphTraceLen, clk, fc_low, fc_high);
+    // the tone sums are packed two per sample,  needs the 32 bit working copy
+    size_t len = 0;
+    int32_t *data = getGraphBufferS32(&len);
+    if (data == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    int ans = FSKToNRZ(data, &len, clk, fc_low, fc_high);
+    setGraphBufferS32(data, len);
+    free(data);
     CmdNorm("");
     RepaintGraphWindow();
     return ans;
@@ -2710,7 +3282,7 @@ static int try_detect_modulation(void) {
         clk = GetPskClock("", false);
         if (clk > 0) {
             // allow undo
-            buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
+            buffer_savestate_t saveState = save_bufferS16(g_GraphBuffer, g_GraphTraceLen);
             saveState.offset = g_GridOffset;
             // skip first 160 samples to allow antenna to settle in (psk gets inverted occasionally otherwise)
             CmdLtrim("-i 160");
@@ -2723,7 +3295,7 @@ static int try_detect_modulation(void) {
                 tests[hits].carrier = GetPskCarrier(false);
             }
             //undo trim samples
-            restore_bufferS32(saveState, g_GraphBuffer);
+            restore_bufferS16(saveState, g_GraphBuffer);
             g_GridOffset = saveState.offset;
         }
     }
@@ -2789,6 +3361,354 @@ static int CmdAsn1Decoder(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdDictCompile(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data dictcompile",
+                  "Compile a text dictionary (.dic) into a binary dictionary (.dicb).  Duplicate keys are removed.\n"
+                  "Commands loading `name` or `name.dic` (hf mf chk/fchk, hf iclass chk, lf t55xx chk, hf mfdes chk ...)\n"
+                  "use `name.dicb` instead when it is found and not older than the text file,  which saves parsing\n"
+                  "big dictionaries on every run.  By default the output goes to the user dictionaries folder.",
+                  "data dictcompile -f mfc_default_keys                 --> 6 byte MIFARE keys\n"
+                  "data dictcompile -f iclass_default_keys -l 8\n"
+                  "data dictcompile -f t55xx_default_pwds -l 4 --sort\n"
+                  "data dictcompile -f my.dic -o ./my.dicb"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file",   "<fn>", "text dictionary"),
+        arg_str0("o", "out",    "<fn>", "compiled dictionary (def <user dictionaries>/<name>.dicb)"),
+        arg_int0("l", "keylen", "<dec>", "key length in bytes (def 6)"),
+        arg_lit0(NULL, "sort",  "sort the keys (def keep the order of the file)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int outlen = 0;
+    char outfn[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)outfn, FILE_PATH_SIZE, &outlen);
+
+    int keylen = arg_get_int_def(ctx, 3, 6);
+    bool sort = arg_get_lit(ctx, 4);
+    CLIParserFree(ctx);
+
+    if (keylen < 1 || keylen > DICTIONARY_MAX_KEY_LEN) {
+        PrintAndLogEx(WARNING, "Key length must be 1 - %u bytes", DICTIONARY_MAX_KEY_LEN);
+        return PM3_EINVARG;
+    }
+
+    if (str_endswith(filename, ".dicb")) {
+        PrintAndLogEx(WARNING, "Input must be a text dictionary");
+        return PM3_EINVARG;
+    }
+
+    char *out = NULL;
+    if (outlen) {
+        out = strdup(outfn);
+    } else {
+        // <name>.dicb,  without the directories and the .dic suffix of the input
+        const char *base = filename;
+        for (const char *c = filename; *c; c++) {
+            if (*c == '/' || *c == '\\') {
+                base = c + 1;
+            }
+        }
+        char bname[FILE_PATH_SIZE] = {0};
+        snprintf(bname, sizeof(bname), "%s", base);
+        if (str_endswith(bname, ".dic")) {
+            bname[strlen(bname) - 4] = '\0';
+        }
+        strncat(bname, ".dicb", sizeof(bname) - strlen(bname) - 1);
+
+        if (searchHomeFilePath(&out, DICTIONARIES_SUBDIR, bname, true) != PM3_SUCCESS) {
+            return PM3_EFILE;
+        }
+    }
+    if (out == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    uint64_t t1 = msclock();
+    uint32_t keycnt = 0, dupcnt = 0;
+    int res = compileFileDICTIONARY(filename, out, (uint8_t)keylen, sort, &keycnt, &dupcnt);
+    t1 = msclock() - t1;
+
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Wrote " _GREEN_("%u") " keys to `" _YELLOW_("%s") "`,  removed " _YELLOW_("%u") " duplicates ( %.1f s )"
+                      , keycnt, out, dupcnt, (float)t1 / 1000.0);
+    }
+    free(out);
+    return res;
+}
+
+static int CmdDump2Json(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data dump2json",
+                  "Write the JSON file of a pm3dump file,  the same one the dump command would have saved.\n"
+                  "Dumps are saved as pm3dump instead of JSON after `prefs set dumpformat --pm3dump`",
+                  "data dump2json -f hf-15-E004010203040506-dump.pm3dump\n"
+                  "data dump2json -f hf-mf-01020304-dump.pm3dump -o mycard"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "pm3dump file"),
+        arg_str0("o", "out",  "<fn>", "JSON file (def name of the pm3dump file)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int outlen = 0;
+    char outfn[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)outfn, FILE_PATH_SIZE, &outlen);
+    CLIParserFree(ctx);
+
+    if (outlen == 0) {
+        memcpy(outfn, filename, sizeof(outfn));
+        if (str_endswith(outfn, ".pm3dump")) {
+            outfn[strlen(outfn) - strlen(".pm3dump")] = '\0';
+        }
+    }
+
+    return pm3_export_dump_json(filename, outfn);
+}
+
+#define DUMPCONV_MAX_DEPTH  8
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t next;
+    size_t done;
+    size_t failed;
+    DumpFileType_t to;
+    JSONFileType jsft;
+} dumpconv_job_t;
+
+static const char *dumpconv_exts[] = {".bin", ".eml", ".json", ".mct", ".nfc", ".picopass", ".pm3dump"};
+
+static bool dumpconv_is_dump(const char *name, DumpFileType_t to) {
+    for (size_t i = 0; i < ARRAYLEN(dumpconv_exts); i++) {
+        if (str_endswith(name, dumpconv_exts[i])) {
+            // already in the wanted format
+            return (get_filetype(name) != to);
+        }
+    }
+    return false;
+}
+
+static int dumpconv_add(dumpconv_job_t *job, size_t *size, const char *path) {
+    if (job->count == *size) {
+        size_t n = (*size) ? *size * 2 : 256;
+        char **tmp = realloc(job->paths, n * sizeof(char *));
+        if (tmp == NULL) {
+            return PM3_EMALLOC;
+        }
+        job->paths = tmp;
+        *size = n;
+    }
+
+    job->paths[job->count] = strdup(path);
+    if (job->paths[job->count] == NULL) {
+        return PM3_EMALLOC;
+    }
+    job->count++;
+    return PM3_SUCCESS;
+}
+
+// dumps below dir,  sorted by name inside each directory
+static int dumpconv_collect(dumpconv_job_t *job, size_t *size, const char *dir, int depth) {
+
+    struct dirent **namelist;
+    int n = scandir(dir, &namelist, NULL, alphasort);
+    if (n < 0) {
+        PrintAndLogEx(WARNING, "could not read directory " _YELLOW_("%s"), dir);
+        return PM3_EFILE;
+    }
+
+    int res = PM3_SUCCESS;
+    for (int i = 0; i < n; i++) {
+        const char *name = namelist[i]->d_name;
+        if (res == PM3_SUCCESS && name[0] != '.') {
+
+            char path[FILE_PATH_SIZE];
+            snprintf(path, sizeof(path), "%s%s%s", dir, str_endswith(dir, PATHSEP) ? "" : PATHSEP, name);
+
+            if (is_directory(path)) {
+                if (depth < DUMPCONV_MAX_DEPTH) {
+                    res = dumpconv_collect(job, size, path, depth + 1);
+                }
+            } else if (dumpconv_is_dump(name, job->to)) {
+                res = dumpconv_add(job, size, path);
+            }
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return res;
+}
+
+static void *dumpconv_worker(void *arg) {
+    dumpconv_job_t *job = (dumpconv_job_t *)arg;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+        if (i >= job->count) {
+            break;
+        }
+
+        const char *path = job->paths[i];
+
+        // same name without the extension,  pm3_convert_dump adds the new one
+        char outfn[FILE_PATH_SIZE];
+        snprintf(outfn, sizeof(outfn), "%s", path);
+        char *dot = strrchr(outfn, '.');
+        char *sep = strrchr(outfn, PATHSEP[0]);
+        if (dot && (sep == NULL || dot > sep)) {
+            *dot = '\0';
+        }
+
+        int res = pm3_convert_dump(path, outfn, job->to, job->jsft, false);
+
+        size_t done = __atomic_add_fetch(&job->done, 1, __ATOMIC_SEQ_CST);
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "[%zu/%zu] %s", done, job->count, path);
+        } else {
+            __atomic_add_fetch(&job->failed, 1, __ATOMIC_SEQ_CST);
+            PrintAndLogEx(WARNING, "[%zu/%zu] %s - " _RED_("failed"), done, job->count, path);
+        }
+    }
+    return NULL;
+}
+
+static int CmdDumpConvert(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data dumpconv",
+                  "Convert every dump file in a directory tree to another format,  in parallel.\n"
+                  "Reads bin / eml / json / mct / nfc / picopass / pm3dump, writes bin / json / pm3dump next to the source.\n"
+                  "Existing files are kept,  the new one gets a free name.\n"
+                  "The layout of bin / eml / json / mct dumps comes from the options,  nfc and pm3dump files bring their own",
+                  "data dumpconv -f archive/ --json            --> MIFARE Classic dumps to json\n"
+                  "data dumpconv -f archive/ --json --mfu      --> Ultralight / NTAG dumps to json\n"
+                  "data dumpconv -f hf-mf-01020304-dump.json --bin"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "directory or dump file"),
+        arg_lit0(NULL, "bin", "convert to binary"),
+        arg_lit0(NULL, "json", "convert to JSON"),
+        arg_lit0(NULL, "pm3dump", "convert to pm3dump"),
+        arg_lit0(NULL, "mfu", "dumps are MIFARE Ultralight / NTAG"),
+        arg_lit0(NULL, "iclass", "dumps are iCLASS / Picopass"),
+        arg_lit0(NULL, "raw", "dumps are raw data"),
+        arg_int0("t", "threads", "<dec>", "number of worker threads (def all cpus)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    bool to_bin = arg_get_lit(ctx, 2);
+    bool to_json = arg_get_lit(ctx, 3);
+    bool to_pm3dump = arg_get_lit(ctx, 4);
+    bool is_mfu = arg_get_lit(ctx, 5);
+    bool is_iclass = arg_get_lit(ctx, 6);
+    bool is_raw = arg_get_lit(ctx, 7);
+    int threads = arg_get_int_def(ctx, 8, num_CPUs());
+    CLIParserFree(ctx);
+
+    if ((to_bin + to_json + to_pm3dump) != 1) {
+        PrintAndLogEx(WARNING, "select one of " _YELLOW_("--bin --json --pm3dump"));
+        return PM3_EINVARG;
+    }
+
+    if ((is_mfu + is_iclass + is_raw) > 1) {
+        PrintAndLogEx(WARNING, "select only one of " _YELLOW_("--mfu --iclass --raw"));
+        return PM3_EINVARG;
+    }
+
+    dumpconv_job_t job = {0};
+    job.to = (to_bin) ? BIN : (to_json) ? JSON : PM3DUMP;
+    job.jsft = (is_mfu) ? jsfMfuMemory : (is_iclass) ? jsfIclass : (is_raw) ? jsfRaw : jsfMfc_v2;
+
+    size_t size = 0;
+    int res;
+    if (is_directory(filename)) {
+        res = dumpconv_collect(&job, &size, filename, 0);
+    } else {
+        res = dumpconv_add(&job, &size, filename);
+    }
+
+    if (res == PM3_SUCCESS && job.count == 0) {
+        PrintAndLogEx(WARNING, "no dump files found for " _YELLOW_("%s"), filename);
+        res = PM3_EFILE;
+    }
+
+    if (res != PM3_SUCCESS) {
+        for (size_t i = 0; i < job.count; i++) {
+            free(job.paths[i]);
+        }
+        free(job.paths);
+        return res;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > job.count) {
+        threads = job.count;
+    }
+
+    PrintAndLogEx(INFO, "Converting " _YELLOW_("%zu") " files using " _YELLOW_("%d") " threads", job.count, threads);
+
+    uint64_t t1 = msclock();
+
+    pthread_t *pool = calloc(threads, sizeof(pthread_t));
+    int started = 0;
+    if (pool) {
+        for (; started < threads; started++) {
+            if (pthread_create(&pool[started], NULL, dumpconv_worker, &job)) {
+                PrintAndLogEx(WARNING, "Failed to create pthreads");
+                break;
+            }
+        }
+    }
+
+    // the calling thread does the work if no worker could be started
+    if (started == 0) {
+        dumpconv_worker(&job);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    free(pool);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "Converted " _YELLOW_("%zu") " of " _YELLOW_("%zu") " files in " _YELLOW_("%.1f") " s"
+                  , job.count - job.failed, job.count, (float)(msclock() - t1) / 1000.0);
+
+    for (size_t i = 0; i < job.count; i++) {
+        free(job.paths[i]);
+    }
+    free(job.paths);
+    return (job.failed) ? PM3_ESOFT : PM3_SUCCESS;
+}
+
 static int CmdDiff(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -3263,26 +4183,12 @@ cleanup:
     return PM3_SUCCESS;
 }
 
-int centerThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down) {
+int centerThreshold(const int16_t *in, int16_t *out, size_t len, int8_t up, int8_t down) {
     if (len < 5) {
         return PM3_EINVARG;
     }
 
-    for (size_t i = 0; i < len; ++i) {
-        if ((in[i] <= up) && (in[i] >= down)) {
-            out[i] = 0;
-        }
-    }
-
-    // clean out spikes.
-    for (size_t i = 2; i < len - 2; ++i) {
-
-        int a = out[i - 2] + out[i - 1];
-        int b = out[i + 2] + out[i + 1];
-        if (a == 0 && b == 0) {
-            out[i] = 0;
-        }
-    }
+    dsp_cthreshold(in, out, len, up, down);
     return PM3_SUCCESS;
 }
 
@@ -3321,7 +4227,7 @@ static int CmdCenterThreshold(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-static int envelope_square(const int *in, int *out, size_t len) {
+static int envelope_square(const int16_t *in, int16_t *out, size_t len) {
     if (len < 10) {
         return PM3_EINVARG;
     }
@@ -3371,6 +4277,62 @@ static int CmdEnvelope(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdFilterChain(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data filter",
+                  "Run a chain of graph filters in one pass over the graph buffer.\n"
+                  "Stages are separated by commas, stage arguments by colons.\n"
+                  "  hpf                    - remove DC offset, same as `data hpf`\n"
+                  "  norm                   - normalize to +/-128, same as `data norm`\n"
+                  "  iir:<k>                - IIR low pass filter, same as `data iir -n <k>`\n"
+                  "  decimate[:<n>]         - keep every n'th sample (default 2)\n"
+                  "  dirthreshold:<up>:<dn> - same as `data dirthreshold`\n"
+                  "  cthreshold:<up>:<dn>   - same as `data cthreshold`",
+                  "data filter -c hpf,norm\n"
+                  "data filter -c hpf,iir:4,decimate:2,norm\n"
+                  "data filter -c \"hpf,dirthreshold:10:-10\""
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("c", "chain", "<str>", "comma separated filter stages"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    char chain[256] = {0};
+    int clen = 0;
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)chain, sizeof(chain) - 1, &clen);
+    CLIParserFree(ctx);
+
+    dsp_stage_t stages[DSP_MAX_STAGES];
+    size_t count = 0;
+    int res = dsp_chain_parse(chain, stages, &count);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    if (g_GraphTraceLen == 0) {
+        PrintAndLogEx(WARNING, "GraphBuffer is empty");
+        return PM3_ENODATA;
+    }
+
+    res = dsp_chain_run(g_GraphBuffer, &g_GraphTraceLen, stages, count);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    size_t size = getFromGraphBuffer(bits);
+    // set signal properties low/high/mean/amplitude and is_noice detection
+    computeSignalProperties(bits, size);
+    free(bits);
+    RepaintGraphWindow();
+    return PM3_SUCCESS;
+}
+
 static int CmdAtrLookup(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "data atr",
@@ -3839,6 +4801,7 @@ static command_t CommandTable[] = {
     {"help",             CmdHelp,                 AlwaysAvailable,  "This help"},
     {"-----------",      CmdHelp,                 AlwaysAvailable, "------------------------- " _CYAN_("General") "-------------------------"},
     {"clear",            CmdBuffClear,            AlwaysAvailable,  "Clears various buffers used by the graph window"},
+    {"decode",           CmdDecode,               AlwaysAvailable,  "Batch decode tag ids from sample files"},
     {"hide",             CmdHide,                 AlwaysAvailable,  "Hide the graph window"},
     {"load",             CmdLoad,                 AlwaysAvailable,  "Load contents of file into graph window"},
     {"num",              CmdNumCon,               AlwaysAvailable,  "Converts dec/hex/bin"},
@@ -3864,6 +4827,7 @@ static command_t CommandTable[] = {
     {"dirthreshold",     CmdDirectionalThreshold, AlwaysAvailable,  "Max rising higher up-thres/ Min falling lower down-thres"},
     {"decimate",         CmdDecimate,             AlwaysAvailable,  "Decimate samples"},
     {"envelope",         CmdEnvelope,             AlwaysAvailable,  "Generate square envelope of samples"},
+    {"filter",           CmdFilterChain,          AlwaysAvailable,  "Run a chain of graph filters in one pass"},
     {"grid",             CmdGrid,                 AlwaysAvailable,  "overlay grid on graph window"},
     {"getbitstream",     CmdGetBitStream,         AlwaysAvailable,  "Convert GraphBuffer's >=1 values to 1 and <1 to 0"},
     {"hpf",              CmdHpf,                  AlwaysAvailable,  "Remove DC offset from trace"},
@@ -3884,7 +4848,10 @@ static command_t CommandTable[] = {
     {"bitsamples",       CmdBitsamples,           IfPm3Present,     "Get raw samples as bitstring"},
     {"bmap",             CmdBinaryMap,            AlwaysAvailable,  "Convert hex value according a binary template"},
     {"crypto",           CmdCryptography,         AlwaysAvailable,  "Encrypt and decrypt data"},
+    {"dictcompile",      CmdDictCompile,          AlwaysAvailable,  "Compile a text dictionary into a binary dictionary"},
     {"diff",             CmdDiff,                 AlwaysAvailable,  "Diff of input files"},
+    {"dump2json",        CmdDump2Json,            AlwaysAvailable,  "Write the JSON file of a pm3dump file"},
+    {"dumpconv",         CmdDumpConvert,          AlwaysAvailable,  "Convert dump files of a directory tree to another format"},
     {"hexsamples",       CmdHexsamples,           IfPm3Present,     "Dump big buffer as hex bytes"},
     {"samples",          CmdSamples,              IfPm3Present,     "Get raw samples for graph window ( GraphBuffer )"},
 
@@ -21,6 +21,7 @@
 
 #include "common.h"
 #include <stdbool.h>
+#include "lfdemodctx.h"     // g_DemodBuffer
 
 #ifdef __cplusplus
 extern "C" {
@@ -81,23 +82,18 @@ int printDemodBuff(uint8_t offset, bool strip_leading, bool invert, bool print_h
 
 void setDemodBuff(const uint8_t *buff, size_t size, size_t start_idx);
 bool getDemodBuff(uint8_t *buff, size_t *size);
-int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose);
+int AutoCorrelate(const int16_t *in, int16_t *out, size_t len, size_t window, bool SaveGrph, bool verbose);
 
 int getSamples(uint32_t n, bool verbose);
 int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_config);
 int getSamplesFromBufEx(uint8_t *data, size_t sample_num, uint8_t bits_per_sample, bool verbose);
 
 void setClockGrid(uint32_t clk, int offset);
-int directionalThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down);
-int centerThreshold(const int *in, int *out, size_t len, int8_t up, int8_t down);
-int AskEdgeDetect(const int *in, int *out, int len, int threshold);
+int directionalThreshold(const int16_t *in, int16_t *out, size_t len, int8_t up, int8_t down);
+int centerThreshold(const int16_t *in, int16_t *out, size_t len, int8_t up, int8_t down);
+int AskEdgeDetect(const int16_t *in, int16_t *out, int len, int threshold);
 
-#define MAX_DEMOD_BUF_LEN (1024*128)
-extern uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN];
-extern size_t g_DemodBufferLen;
-
-extern int g_DemodClock;
-extern int32_t g_DemodStartIdx;
+// g_DemodBuffer, g_DemodBufferLen, g_DemodClock and g_DemodStartIdx are part of the demod context
 
 #ifdef __cplusplus
 }
@@ -26,6 +26,7 @@
 #include "rsa.h"
 #include "sha1.h"
 #include "pk.h"                // PEM key load functions
+#include "mifare/mfkeystats.h"  // dictionary hit statistics
 
 #define MCK 48000000
 #define FLASH_MINFAST 24000000 //33000000
@@ -155,13 +156,130 @@ static int CmdFlashmemSpiBaud(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int flashmem_write(uint32_t offset, const uint8_t *data, size_t datalen) {
+
+    uint32_t bytes_sent = 0;
+    uint32_t bytes_remaining = datalen;
+
+    // fast push mode
+    g_conn.block_after_ACK = true;
+
+    while (bytes_remaining > 0) {
+        uint32_t bytes_in_packet = MIN(FLASH_MEM_BLOCK_SIZE, bytes_remaining);
+
+        clearCommandBuffer();
+
+        flashmem_old_write_t payload = {
+            .startidx = offset + bytes_sent,
+            .len = bytes_in_packet,
+        };
+        memcpy(payload.data,  data + bytes_sent, bytes_in_packet);
+        SendCommandNG(CMD_FLASHMEM_WRITE, (uint8_t *)&payload, sizeof(payload));
+
+        bytes_remaining -= bytes_in_packet;
+        bytes_sent += bytes_in_packet;
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_FLASHMEM_WRITE, &resp, 2000) == false) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            g_conn.block_after_ACK = false;
+            return PM3_ETIMEOUT;
+        }
+
+        if (resp.status != PM3_SUCCESS) {
+            g_conn.block_after_ACK = false;
+            PrintAndLogEx(FAILED, "Flash write fail [offset %u]", bytes_sent);
+            return PM3_EFLASH;
+        }
+    }
+
+    g_conn.block_after_ACK = false;
+    return PM3_SUCCESS;
+}
+
+// drop repeated keys, the first one of them stays where it was
+static uint32_t flashmem_dict_dedup(uint8_t *keys, uint32_t keycount, uint8_t keylen) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < keycount; i++) {
+        const uint8_t *key = keys + (i * keylen);
+        bool dup = false;
+        for (uint32_t j = 0; j < n; j++) {
+            if (memcmp(keys + (j * keylen), key, keylen) == 0) {
+                dup = true;
+                break;
+            }
+        }
+        if (dup == false) {
+            if (n != i) {
+                memmove(keys + (n * keylen), key, keylen);
+            }
+            n++;
+        }
+    }
+    return n;
+}
+
+static int flashmem_dict_index_get(flash_dict_index_t *idx) {
+    if (GetFromDevice(FLASH_MEM, (uint8_t *)idx, sizeof(flash_dict_index_t), DEFAULT_DICT_INDEX_OFFSET, NULL, 0, NULL, -1, false) == false) {
+        return PM3_EFLASH;
+    }
+
+    if (idx->magic != FLASH_DICT_MAGIC || idx->version != FLASH_DICT_VERSION) {
+        return PM3_ENODATA;
+    }
+    return PM3_SUCCESS;
+}
+
+static int flashmem_dict_index_set(flash_dict_family_t family, const flash_dict_section_t *sec) {
+    flash_dict_index_t idx;
+    if (flashmem_dict_index_get(&idx) != PM3_SUCCESS) {
+        memset(&idx, 0, sizeof(idx));
+        idx.magic = FLASH_DICT_MAGIC;
+        idx.version = FLASH_DICT_VERSION;
+        idx.sections = FLASH_DICT_SECTIONS;
+    }
+    memcpy(&idx.section[family], sec, sizeof(flash_dict_section_t));
+    return flashmem_write(DEFAULT_DICT_INDEX_OFFSET, (uint8_t *)&idx, sizeof(idx));
+}
+
+/**
+ * @brief Get the index entry of a key dictionary section in flash memory
+ *
+ * @return PM3_SUCCESS if the section was written with an index which still matches it
+ */
+int flashmem_dict_section_get(flash_dict_family_t family, flash_dict_section_t *sec) {
+    flash_dict_index_t idx;
+    int res = flashmem_dict_index_get(&idx);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    memcpy(sec, &idx.section[family], sizeof(flash_dict_section_t));
+    sec->name[sizeof(sec->name) - 1] = '\0';
+    if (sec->keylen == 0 || sec->name[0] == '\0') {
+        return PM3_ENODATA;
+    }
+
+    // the section was loaded again without index
+    uint8_t count[2] = {0};
+    if (GetFromDevice(FLASH_MEM, count, sizeof(count), sec->offset, NULL, 0, NULL, -1, false) == false) {
+        return PM3_EFLASH;
+    }
+    if (((count[1] << 8) | count[0]) != sec->count) {
+        return PM3_ENODATA;
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdFlashMemLoad(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "mem load",
                   "Loads binary file into flash memory on device\n"
                   "Warning: mem area to be written must have been wiped first\n"
-                  "( this is already taken care when loading dictionaries )",
+                  "( this is already taken care when loading dictionaries )\n"
+                  "Dictionaries are stored without duplicate keys, MIFARE keys with recorded hits first\n"
+                  "( see `hf mf fchk --stats` ), loading one again updates the order",
                   "mem load -f myfile                 -> upload file myfile values at default offset 0\n"
                   "mem load -f myfile -o 1024         -> upload file myfile values at offset 1024\n"
                   "mem load -f mfc_default_keys -m    -> upload MFC keys\n"
@@ -205,61 +323,28 @@ static int CmdFlashMemLoad(const char *Cmd) {
     uint32_t keycount = 0;
     int res = 0;
     uint8_t keylen = 0;
+    uint32_t keymax = 0;
+    flash_dict_family_t family = FLASH_DICT_MFC;
     uint8_t *data = calloc(FLASH_MEM_MAX_SIZE, sizeof(uint8_t));
 
     switch (d) {
         case DICTIONARY_MIFARE:
             offset = DEFAULT_MF_KEYS_OFFSET;
             keylen = 6;
-            res = loadFileDICTIONARY(filename, data + 2, &datalen, keylen, &keycount);
-            if (res || !keycount) {
-                free(data);
-                return PM3_EFILE;
-            }
-            // limited space on flash mem
-            if (keycount > DEFAULT_MF_KEYS_MAX) {
-                keycount = DEFAULT_MF_KEYS_MAX;
-                datalen = keycount * keylen;
-            }
-
-            data[0] = (keycount >> 0) & 0xFF;
-            data[1] = (keycount >> 8) & 0xFF;
-            datalen += 2;
+            keymax = DEFAULT_MF_KEYS_MAX;
+            family = FLASH_DICT_MFC;
             break;
         case DICTIONARY_T55XX:
             offset = DEFAULT_T55XX_KEYS_OFFSET;
             keylen = 4;
-            res = loadFileDICTIONARY(filename, data + 2, &datalen, keylen, &keycount);
-            if (res || !keycount) {
-                free(data);
-                return PM3_EFILE;
-            }
-            // limited space on flash mem
-            if (keycount > DEFAULT_T55XX_KEYS_MAX) {
-                keycount = DEFAULT_T55XX_KEYS_MAX;
-                datalen = keycount * keylen;
-            }
-
-            data[0] = (keycount >> 0) & 0xFF;
-            data[1] = (keycount >> 8) & 0xFF;
-            datalen += 2;
+            keymax = DEFAULT_T55XX_KEYS_MAX;
+            family = FLASH_DICT_T55XX;
             break;
         case DICTIONARY_ICLASS:
             offset = DEFAULT_ICLASS_KEYS_OFFSET;
-            res = loadFileDICTIONARY(filename, data + 2, &datalen, keylen, &keycount);
-            if (res || !keycount) {
-                free(data);
-                return PM3_EFILE;
-            }
-            // limited space on flash mem
-            if (keycount > DEFAULT_ICLASS_KEYS_MAX) {
-                keycount = DEFAULT_ICLASS_KEYS_MAX;
-                datalen = keycount * keylen;
-            }
-
-            data[0] = (keycount >> 0) & 0xFF;
-            data[1] = (keycount >> 8) & 0xFF;
-            datalen += 2;
+            keylen = 8;
+            keymax = DEFAULT_ICLASS_KEYS_MAX;
+            family = FLASH_DICT_ICLASS;
             break;
         case DICTIONARY_NONE:
             res = loadFile_safe(filename, ".bin", (void **)&data, &datalen);
@@ -276,58 +361,76 @@ static int CmdFlashMemLoad(const char *Cmd) {
             break;
     }
 
-    // ICEMAN: not needed when we transite to loadxxxx_safe methods
-    uint8_t *newdata = realloc(data, datalen);
-    if (newdata == NULL) {
-        free(data);
-        return PM3_EMALLOC;
-    } else {
-        data = newdata;
-    }
-
-    //Send to device
-    uint32_t bytes_sent = 0;
-    uint32_t bytes_remaining = datalen;
-
-
-    // fast push mode
-    g_conn.block_after_ACK = true;
+    flash_dict_section_t sec = {0};
+    if (d != DICTIONARY_NONE) {
+        res = loadFileDICTIONARY(filename, data + 2, &datalen, keylen, &keycount);
+        if (res || !keycount) {
+            free(data);
+            return PM3_EFILE;
+        }
 
-    while (bytes_remaining > 0) {
-        uint32_t bytes_in_packet = MIN(FLASH_MEM_BLOCK_SIZE, bytes_remaining);
+        uint32_t loaded = keycount;
+        keycount = flashmem_dict_dedup(data + 2, keycount, keylen);
+        if (keycount != loaded) {
+            PrintAndLogEx(INFO, "removed " _YELLOW_("%u") " duplicate keys", loaded - keycount);
+        }
 
-        clearCommandBuffer();
+        sec.flags = FLASH_DICT_DEDUP;
+
+        // most hit keys first, before cutting the list to what fits
+        if (d == DICTIONARY_MIFARE) {
+            mfc_keystats_t stats = {0};
+            if (mfc_keystats_load(&stats, filename) == PM3_SUCCESS) {
+                uint32_t ranked = mfc_keystats_order(&stats, data + 2, keycount, -1);
+                sec.ranked = (ranked > keymax) ? keymax : ranked;
+                sec.flags |= FLASH_DICT_SORTED;
+                if (ranked) {
+                    PrintAndLogEx(INFO, "moved " _YELLOW_("%u") " keys with recorded hits to the front", ranked);
+                }
+            }
+            mfc_keystats_free(&stats);
+        }
 
-        flashmem_old_write_t payload = {
-            .startidx = offset + bytes_sent,
-            .len = bytes_in_packet,
-        };
-        memcpy(payload.data,  data + bytes_sent, bytes_in_packet);
-        SendCommandNG(CMD_FLASHMEM_WRITE, (uint8_t *)&payload, sizeof(payload));
+        // limited space on flash mem
+        if (keycount > keymax) {
+            PrintAndLogEx(WARNING, "dictionary has %u keys, only the first " _YELLOW_("%u") " fit", keycount, keymax);
+            keycount = keymax;
+        }
+        datalen = keycount * keylen;
 
-        bytes_remaining -= bytes_in_packet;
-        bytes_sent += bytes_in_packet;
+        data[0] = (keycount >> 0) & 0xFF;
+        data[1] = (keycount >> 8) & 0xFF;
+        datalen += 2;
 
-        PacketResponseNG resp;
-        if (WaitForResponseTimeout(CMD_FLASHMEM_WRITE, &resp, 2000) == false) {
-            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
-            g_conn.block_after_ACK = false;
-            free(data);
-            return PM3_ETIMEOUT;
-        }
+        sec.offset = offset;
+        sec.count = keycount;
+        sec.keylen = keylen;
 
-        if (resp.status != PM3_SUCCESS) {
-            g_conn.block_after_ACK = false;
-            PrintAndLogEx(FAILED, "Flash write fail [offset %u]", bytes_sent);
-            free(data);
-            return PM3_EFLASH;
+        // same name as the key statistics store
+        const char *base = filename;
+        for (const char *c = filename; *c; c++) {
+            if (*c == '/' || *c == '\\') {
+                base = c + 1;
+            }
         }
+        snprintf(sec.name, sizeof(sec.name), "%s", base);
     }
 
-    g_conn.block_after_ACK = false;
+    res = flashmem_write(offset, data, datalen);
     free(data);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
     PrintAndLogEx(SUCCESS, "Wrote "_GREEN_("%zu")" bytes to offset "_GREEN_("%u"), datalen, offset);
-    return PM3_SUCCESS;
+
+    if (d != DICTIONARY_NONE) {
+        res = flashmem_dict_index_set(family, &sec);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "failed to update the dictionary index");
+        }
+    }
+    return res;
 }
 
 static int CmdFlashMemDump(const char *Cmd) {
@@ -32,4 +32,5 @@ typedef enum {
 int CmdFlashMem(const char *Cmd);
 int rdv4_get_signature(rdv40_validation_t *out);
 int rdv4_validate(rdv40_validation_t *mem);
+int flashmem_dict_section_get(flash_dict_family_t family, flash_dict_section_t *sec);
 #endif
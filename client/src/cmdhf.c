@@ -59,229 +59,156 @@
 #include "cmddata.h"
 #include "graph.h"
 #include "fpga.h"
+#include "commonutil.h"   // ARRAYLEN
+#include "util_posix.h"   // msclock
+#include "pm3_result.h"
+#include "cmdhw.h"        // antenna_stream
 
 static int CmdHelp(const char *Cmd);
 
-int CmdHFSearch(const char *Cmd) {
+static int hf_search_thinfilm(bool verbose) {
+    return infoThinFilm(false);
+}
 
-    CLIParserContext *ctx;
-    CLIParserInit(&ctx, "hf search",
-                  "Will try to find a HF read out of the unknown tag.\n"
-                  "Continues to search for all different HF protocols.",
-                  "hf search"
-                 );
-    void *argtable[] = {
-        arg_param_begin,
-        arg_lit0("v", "verbose", "verbose output"),
-        arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, true);
+static int hf_search_topaz(bool verbose) {
+    return readTopazUid(false, false);
+}
 
-    bool verbose = arg_get_lit(ctx, 1);
+static int hf_search_lto(bool verbose) {
+    return reader_lto(false, false);
+}
 
-    CLIParserFree(ctx);
+static int hf_search_14a(bool verbose) {
+    int sel_state = infoHF14A(false, false, false);
+    if (sel_state <= 0)
+        return PM3_ESOFT;
 
-    int res = PM3_ESOFT;
+    PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO 14443-A tag") " found\n");
+    pm3_result_append("tags", json_string("ISO 14443-A tag"));
+    if (sel_state == 1)
+        infoHF14A4Applications(verbose);
+    return PM3_SUCCESS;
+}
 
-    uint8_t success[20] = {0};
+static int hf_search_legic(bool verbose) {
+    return readLegicUid(false, false);
+}
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for ThinFilm tag...");
-    if (IfPm3NfcBarcode()) {
-        if (infoThinFilm(false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Thinfilm tag") " found\n");
-            success[THINFILM] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+static int hf_search_texkom(bool verbose) {
+    return read_texkom_uid(false, false);
+}
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for Topaz tag...");
-    if (IfPm3Iso14443a()) {
-        if (readTopazUid(false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Topaz tag") " found\n");
-            success[TOPAZ] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+static int hf_search_xerox(bool verbose) {
+    return read_xerox_uid(false, false);
+}
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for LTO-CM tag...");
-    if (IfPm3Iso14443a()) {
-        if (reader_lto(false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("LTO-CM tag") " found\n");
-            success[LTO] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+static int hf_search_14b(bool verbose) {
+    return readHF14B(false, false, false);
+}
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for ISO14443-A tag...");
-    if (IfPm3Iso14443a()) {
-        int sel_state = infoHF14A(false, false, false);
-        if (sel_state > 0) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO 14443-A tag") " found\n");
-            success[ISO_14443A] = true;
-            res = PM3_SUCCESS;
+static int hf_search_15(bool verbose) {
+    if (readHF15Uid(false, true) == false)
+        return PM3_ESOFT;
 
-            if (sel_state == 1)
-                infoHF14A4Applications(verbose);
-        }
-    }
+    PrintAndLogEx(SUCCESS, "Valid " _GREEN_("ISO 15693 tag") " found\n");
+    pm3_result_append("tags", json_string("ISO 15693 tag"));
+    return PM3_SUCCESS;
+}
 
-    /*
-        // ICT
-    if (IfPm3Iso14443a()) {
-        int sel_state = infoHF14A(false, false, false);
-        if (sel_state > 0) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO 14443-A tag") " found\n");
-            success[ISO_14443A] = true;
-            res = PM3_SUCCESS;
+static int hf_search_iclass(bool verbose) {
+    return read_iclass_csn(false, false, false);
+}
 
-            if (sel_state == 1)
-                infoHF14A4Applications(verbose);
-        }
-    }
-    */
+static int hf_search_felica(bool verbose) {
+    return read_felica_uid(false, false);
+}
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for LEGIC tag...");
-    if (IfPm3Legicrf()) {
-        if (readLegicUid(false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("LEGIC Prime tag") " found\n");
-            success[LEGIC] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+// Default order of `hf search`.  14b is the longest test,  15 and FeliCa
+// trigger a swap to their own FPGA bitstream == 1.5sec delay each.
+// A NULL found text means the probe prints its own result.
+const hf_search_probe_t hf_search_probes[] = {
+    {"thinfilm", "ThinFilm",          "Thinfilm tag",              "hf thinfilm", IfPm3NfcBarcode, hf_search_thinfilm},
+    {"topaz",    "Topaz",             "Topaz tag",                 "hf topaz",    IfPm3Iso14443a,  hf_search_topaz},
+    {"lto",      "LTO-CM",            "LTO-CM tag",                "hf lto",      IfPm3Iso14443a,  hf_search_lto},
+    // no need to print 14A hints,  since it will print itself
+    {"14a",      "ISO14443-A",        NULL,                        NULL,          IfPm3Iso14443a,  hf_search_14a},
+    {"legic",    "LEGIC",             "LEGIC Prime tag",           "hf legic",    IfPm3Legicrf,    hf_search_legic},
+    {"texkom",   "TEXKOM",            "TEXKOM tag",                "hf texkom",   AlwaysAvailable, hf_search_texkom},
+    {"xerox",    "Fuji/Xerox",        "Fuji/Xerox tag",            "hf xerox",    IfPm3Iso14443b,  hf_search_xerox},
+    {"14b",      "ISO14443-B",        "ISO 14443-B tag",           "hf 14b",      IfPm3Iso14443b,  hf_search_14b},
+    {"15",       "ISO15693",          NULL,                        "hf 15",       IfPm3Iso15693,   hf_search_15},
+    {"iclass",   "iCLASS / PicoPass", "iCLASS tag / PicoPass tag", "hf iclass",   IfPm3Iclass,     hf_search_iclass},
+    {"felica",   "FeliCa",            "ISO 18092 / FeliCa tag",    "hf felica",   IfPm3Felica,     hf_search_felica},
+//  {"cryptorf", "CryptoRF",          "CryptoRF tag",              "hf cryptorf", IfPm3Iso14443b,  hf_search_cryptorf},
+};
+const size_t hf_search_probes_len = ARRAYLEN(hf_search_probes);
 
-    // texkom
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for TEXKOM tag...");
-    if (read_texkom_uid(false, false) == PM3_SUCCESS) {
-        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("TEXKOM tag") " found\n");
-        success[PROTO_TEXKOM] = true;
-        res = PM3_SUCCESS;
-    }
+int hf_search_probe(size_t idx, bool verbose, uint32_t *elapsed) {
 
-    // xerox
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for Fuji/Xerox tag...");
-    if (IfPm3Iso14443b()) {
-        if (read_xerox_uid(false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Fuji/Xerox tag") " found\n");
-            success[PROTO_XEROX] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+    const hf_search_probe_t *p = &hf_search_probes[idx];
+    if (p->available() == false)
+        return PM3_ENOTIMPL;
 
-    // 14b is the longest test
     PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for ISO14443-B tag...");
-    if (IfPm3Iso14443b()) {
-        if (readHF14B(false, false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO 14443-B tag") " found\n");
-            success[ISO_14443B] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+    PrintAndLogEx(INPLACE, " Searching for %s tag...", p->desc);
 
-    // OBS!  This triggers a swap to FPGA_BITSTREAM_HF_15 == 1.5sec delay
+    uint64_t t = msclock();
+    int res = p->probe(verbose);
+    if (elapsed)
+        *elapsed = (uint32_t)(msclock() - t);
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for ISO15693 tag...");
-    if (IfPm3Iso15693()) {
-        if (readHF15Uid(false, true)) {
-            PrintAndLogEx(SUCCESS, "Valid " _GREEN_("ISO 15693 tag") " found\n");
-            success[ISO_15693] = true;
-            res = PM3_SUCCESS;
-        }
+    if (res != PM3_SUCCESS)
+        return PM3_ESOFT;
+
+    if (p->found) {
+        PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("%s") " found\n", p->found);
+        pm3_result_append("tags", json_string(p->found));
     }
+    return PM3_SUCCESS;
+}
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for iCLASS / PicoPass tag...");
-    if (IfPm3Iclass()) {
-        if (read_iclass_csn(false, false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("iCLASS tag / PicoPass tag") " found\n");
-            success[ICLASS] = true;
-            res = PM3_SUCCESS;
+void hf_search_hints(const uint8_t *found) {
+    for (size_t i = 0; i < ARRAYLEN(hf_search_probes); i++) {
+        if (found[i] && hf_search_probes[i].hint) {
+            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`%s`") " commands\n", hf_search_probes[i].hint);
         }
     }
+}
 
-    // OBS!  This triggers a swap to FPGA_BITSTREAM_HF_FELICA == 1.5sec delay
+int CmdHFSearch(const char *Cmd) {
 
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for FeliCa tag...");
-    if (IfPm3Felica()) {
-        if (read_felica_uid(false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("ISO 18092 / FeliCa tag") " found\n");
-            success[FELICA] = true;
-            res = PM3_SUCCESS;
-        }
-    }
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf search",
+                  "Will try to find a HF read out of the unknown tag.\n"
+                  "Continues to search for all different HF protocols.",
+                  "hf search"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("v", "verbose", "verbose output"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
 
-    /*
-    PROMPT_CLEARLINE;
-    PrintAndLogEx(INPLACE, " Searching for CryptoRF tag...");
-    if (IfPm3Iso14443b()) {
-        if (readHFCryptoRF(false, false) == PM3_SUCCESS) {
-            PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("CryptoRF tag") " found\n");
-            success[CRYPTORF] = true;
+    bool verbose = arg_get_lit(ctx, 1);
+
+    CLIParserFree(ctx);
+
+    int res = PM3_ESOFT;
+    uint8_t found[ARRAYLEN(hf_search_probes)] = {0};
+
+    for (size_t i = 0; i < ARRAYLEN(hf_search_probes); i++) {
+        if (hf_search_probe(i, verbose, NULL) == PM3_SUCCESS) {
+            found[i] = true;
             res = PM3_SUCCESS;
         }
     }
-    */
 
     PROMPT_CLEARLINE;
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, _RED_("No known/supported 13.56 MHz tags found"));
-        res = PM3_ESOFT;
     } else {
-
-        // no need to print 14A hints,  since it will print itself
-
-        if (success[THINFILM]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf thinfilm`") " commands\n");
-        }
-
-        if (success[LTO]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf lto`") " commands\n");
-        }
-
-        if (success[LEGIC]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf legic`") " commands\n");
-        }
-
-        if (success[TOPAZ]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf topaz`") " commands\n");
-        }
-
-        if (success[PROTO_TEXKOM]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf texkom`") " commands\n");
-        }
-
-        if (success[PROTO_XEROX]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf xerox`") " commands\n");
-        }
-
-        if (success[ISO_14443B]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf 14b`") " commands\n");
-        }
-
-        if (success[ISO_15693]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf 15`") " commands\n");
-        }
-
-        if (success[ICLASS]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf iclass`") " commands\n");
-        }
-
-        if (success[FELICA]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf felica`") " commands\n");
-        }
-
-        if (success[PROTO_CRYPTORF]) {
-            PrintAndLogEx(HINT, "Hint: try " _YELLOW_("`hf cryptorf`") " commands\n");
-        }
+        hf_search_hints(found);
     }
 
     DropField();
@@ -295,16 +222,24 @@ int CmdHFTune(const char *Cmd) {
                   "Continuously measure HF antenna tuning.\n"
                   "Press pm3 button or <Enter> to interrupt.",
                   "hf tune\n"
-                  "hf tune --mix"
+                  "hf tune --mix\n"
+                  "hf tune --stream --interval 100 --batch 10    -> one report a second\n"
+                  "hf tune --stream --field -f hf_field.csv      -> log an external reader field"
                  );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_u64_0("n", "iter", "<dec>", "number of iterations (default: 0=infinite)"),
+        arg_u64_0("n", "iter", "<dec>", "number of iterations, reports with --stream (default: 0=infinite)"),
         arg_lit0(NULL, "bar", "bar style"),
         arg_lit0(NULL, "mix", "mixed style"),
         arg_lit0(NULL, "value", "values style"),
         arg_lit0("v", "verbose", "verbose output"),
+        arg_lit0(NULL, "stream", "device measures on its own and sends batched reports"),
+        arg_u64_0(NULL, "interval", "<ms>", "stream, time between readings (default: 10)"),
+        arg_u64_0(NULL, "batch", "<dec>", "stream, readings per report (default: 10)"),
+        arg_lit0(NULL, "samples", "stream, include the readings in each report"),
+        arg_lit0(NULL, "field", "stream, measure an external reader field instead of our antenna"),
+        arg_str0("f", "file", "<fn>", "stream, append reports to CSV file"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -313,6 +248,14 @@ int CmdHFTune(const char *Cmd) {
     bool is_mix = arg_get_lit(ctx, 3);
     bool is_value = arg_get_lit(ctx, 4);
     bool verbose = arg_get_lit(ctx, 5);
+    bool stream = arg_get_lit(ctx, 6);
+    uint32_t interval = arg_get_u32_def(ctx, 7, 10);
+    uint32_t batch = arg_get_u32_def(ctx, 8, 10);
+    bool samples = arg_get_lit(ctx, 9);
+    bool field = arg_get_lit(ctx, 10);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 11), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     if ((is_bar + is_mix + is_value) > 1) {
@@ -320,6 +263,26 @@ int CmdHFTune(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (stream) {
+        if (interval > 0xFFFF || batch == 0 || batch > 0xFFFF) {
+            PrintAndLogEx(ERR, "interval must be 0 - 65535 ms and batch 1 - 65535");
+            return PM3_EINVARG;
+        }
+        antenna_stream_t req = {
+            .source = (field) ? ANTENNA_STREAM_HF_READER : ANTENNA_STREAM_HF,
+            .flags = (samples) ? ANTENNA_STREAM_FLAG_SAMPLES : 0,
+            .interval_ms = interval,
+            .batch = batch,
+            .reports = iter,
+        };
+        return antenna_stream(&req, filename, verbose);
+    }
+
+    if (samples || field || fnlen) {
+        PrintAndLogEx(ERR, "`--samples`, `--field` and `-f` need `--stream`");
+        return PM3_EINVARG;
+    }
+
     barMode_t style = g_session.bar_mode;
     if (is_bar)
         style = STYLE_BAR;
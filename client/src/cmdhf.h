@@ -21,6 +21,24 @@
 
 #include "common.h"
 
+// one `hf search` probe
+typedef struct {
+    const char *key;              // name in the auto search statistics
+    const char *desc;             // " Searching for <desc> tag..."
+    const char *found;            // "Valid <found> found",  NULL if the probe prints it
+    const char *hint;             // command family to hint at,  NULL for none
+    bool (*available)(void);
+    int (*probe)(bool verbose);   // PM3_SUCCESS when a tag answered
+} hf_search_probe_t;
+
+extern const hf_search_probe_t hf_search_probes[];
+extern const size_t hf_search_probes_len;
+
+// runs one probe,  PM3_ENOTIMPL when the firmware lacks its protocol
+int hf_search_probe(size_t idx, bool verbose, uint32_t *elapsed);
+// found[] is indexed like hf_search_probes
+void hf_search_hints(const uint8_t *found);
+
 int CmdHF(const char *Cmd);
 int CmdHFTune(const char *Cmd);
 int CmdHFSearch(const char *Cmd);
@@ -42,7 +42,9 @@
 #include "desfire.h"             // desfire enums
 #include "mifare/desfirecore.h"  // desfire context
 #include "mifare/mifaredefault.h"
+#include "cmdhw.h"               // PrintDecoderStats
 #include "preferences.h"         // get/set device debug level
+#include "pm3_result.h"
 
 static bool g_apdu_in_framing_enable = true;
 bool Get_apdu_in_framing(void) {
@@ -623,6 +625,13 @@ static int CmdHF14AReader(const char *Cmd) {
                 PrintAndLogEx(SUCCESS, " UID: " _GREEN_("%s"), sprint_hex(card.uid, card.uidlen));
             }
 
+            pm3_result_set_hex("uid", card.uid, card.uidlen);
+            pm3_result_set_hex("atqa", (uint8_t[]) {card.atqa[1], card.atqa[0]}, 2);
+            pm3_result_set_int("sak", card.sak);
+            if (card.ats_len >= 3) {
+                pm3_result_set_hex("ats", card.ats, MIN(card.ats_len, sizeof(card.ats)));
+            }
+
             if (!(silent && continuous)) {
                 PrintAndLogEx(SUCCESS, "ATQA: " _GREEN_("%02X %02X"), card.atqa[1], card.atqa[0]);
                 PrintAndLogEx(SUCCESS, " SAK: " _GREEN_("%02X [%" PRIu64 "]"), card.sak, resp.oldarg[0]);
@@ -750,6 +759,67 @@ static int CmdHF14ACUIDs(const char *Cmd) {
     return 1;
 }
 
+static int CmdHF14AInventory(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 14a inventory",
+                  "List every ISO14443-a card in the field in one go.\n"
+                  "The device selects one card at a time with the anticollision and halts it,\n"
+                  "until no card answers anymore.  Without RATS, so ATS are not collected",
+                  "hf 14a inventory\n"
+                  "hf 14a inventory -k    --> keep field on, the cards stay halted"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("k", "keep", "keep the field on afterwards"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint8_t keep_field = arg_get_lit(ctx, 1);
+    CLIParserFree(ctx);
+
+    uint64_t t1 = msclock();
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_INVENTORY, &keep_field, sizeof(keep_field));
+
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_ISO14443A_INVENTORY, &resp, 5000) == false) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(iso14a_inventory_t)) {
+        PrintAndLogEx(WARNING, "inventory failed");
+        return PM3_ESOFT;
+    }
+
+    const iso14a_inventory_t *inv = (const iso14a_inventory_t *)resp.data.asBytes;
+    if (inv->count == 0) {
+        PrintAndLogEx(WARNING, "no card found");
+        return PM3_ECARDEXCHANGE;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "  # | UID                    | ATQA  | SAK");
+    PrintAndLogEx(INFO, "----+------------------------+-------+-----");
+    for (uint8_t i = 0; i < inv->count && i < ISO14A_INVENTORY_MAX; i++) {
+        const iso14a_inventory_card_t *c = &inv->cards[i];
+        PrintAndLogEx(SUCCESS, " %2u | " _GREEN_("%-22s") " | %02X %02X |  %02X",
+                      i + 1,
+                      sprint_hex_inrow(c->uid, MIN(c->uidlen, sizeof(c->uid))),
+                      c->atqa[1], c->atqa[0],
+                      c->sak
+                     );
+    }
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, _YELLOW_("%u") " card%s in %" PRIu64 " ms", inv->count, (inv->count > 1) ? "s" : "", msclock() - t1);
+    if (inv->truncated) {
+        PrintAndLogEx(WARNING, "list is full,  there may be more cards");
+    }
+    return PM3_SUCCESS;
+}
+
 // ## simulate iso14443a tag
 int CmdHF14ASim(const char *Cmd) {
     CLIParserContext *ctx;
@@ -869,6 +939,10 @@ int CmdHF14ASim(const char *Cmd) {
         keypress = kbd_enter_pressed();
     }
 
+    if (resp.cmd == CMD_HF_MIFARE_SIMULATE) {
+        PrintDecoderStats(resp.data.asBytes, resp.length);
+    }
+
     if (keypress) {
         if ((flags & FLAG_NR_AR_ATTACK) == FLAG_NR_AR_ATTACK) {
             // inform device to break the sim loop since client has exited
@@ -885,18 +959,338 @@ int CmdHF14ASim(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// entries of a replay script,  when each is the smallest possible
+#define HF14A_REPLAY_MAX_ENTRIES    (ISO14A_REPLAY_MAX_SIZE / (sizeof(iso14a_replay_entry_t) + 1))
+
+typedef struct {
+    uint8_t data[ISO14A_REPLAY_MAX_SIZE];
+    uint16_t len;
+    uint16_t count;
+    uint16_t offset[HF14A_REPLAY_MAX_ENTRIES];   // of each entry in data
+} hf14a_replay_script_t;
+
+static iso14a_replay_entry_t *hf14a_replay_entry(hf14a_replay_script_t *rs, uint16_t i) {
+    return (iso14a_replay_entry_t *)(rs->data + rs->offset[i]);
+}
+
+static bool hf14a_replay_same(hf14a_replay_script_t *rs, const tracelog_hdr_t *cmd, const tracelog_hdr_t *rsp) {
+    uint16_t rsp_len = (rsp) ? rsp->data_len : 0;
+    for (uint16_t i = 0; i < rs->count; i++) {
+        const iso14a_replay_entry_t *e = hf14a_replay_entry(rs, i);
+        const uint8_t *d = (const uint8_t *)e + sizeof(iso14a_replay_entry_t);
+        if (e->cmd_len == cmd->data_len && e->rsp_len == rsp_len &&
+                memcmp(d, cmd->frame, e->cmd_len) == 0 &&
+                (rsp_len == 0 || memcmp(d + e->cmd_len, rsp->frame, rsp_len) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Turn each reader frame of a trace and the tag frame following it into a script entry,
+// with dedup an exchange identical to an earlier one is left out.  False when the script outgrows emulator memory
+static bool hf14a_replay_build(const uint8_t *trace, const uint32_t *index, uint32_t count, bool dedup, hf14a_replay_script_t *rs) {
+    rs->len = sizeof(iso14a_replay_hdr_t);
+    rs->count = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const tracelog_hdr_t *cmd = (const tracelog_hdr_t *)(trace + index[i]);
+        if (cmd->isResponse || cmd->data_len == 0 || cmd->data_len > ISO14A_REPLAY_MAX_FRAME) {
+            continue;
+        }
+
+        const tracelog_hdr_t *rsp = NULL;
+        if (i + 1 < count) {
+            rsp = (const tracelog_hdr_t *)(trace + index[i + 1]);
+            if (rsp->isResponse == false || rsp->data_len == 0 || rsp->data_len > ISO14A_REPLAY_MAX_FRAME) {
+                rsp = NULL;
+            }
+        }
+
+        if (dedup && hf14a_replay_same(rs, cmd, rsp)) {
+            continue;
+        }
+
+        uint16_t rsp_len = (rsp) ? rsp->data_len : 0;
+        size_t need = sizeof(iso14a_replay_entry_t) + cmd->data_len + rsp_len;
+        if (rs->len + need > sizeof(rs->data) || rs->count == HF14A_REPLAY_MAX_ENTRIES) {
+            return false;
+        }
+
+        iso14a_replay_entry_t *e = (iso14a_replay_entry_t *)(rs->data + rs->len);
+        e->cmd_len = cmd->data_len;
+        e->rsp_len = rsp_len;
+        e->flags = 0;
+        e->fdt = 0;
+        uint8_t *d = rs->data + rs->len + sizeof(iso14a_replay_entry_t);
+        memcpy(d, cmd->frame, cmd->data_len);
+
+        if (rsp) {
+            memcpy(d + cmd->data_len, rsp->frame, rsp_len);
+            // 1/fc,  a garbled trace with overlapping frames answers at once
+            int64_t fdt = (int64_t)rsp->timestamp - ((int64_t)cmd->timestamp + cmd->duration);
+            e->fdt = (fdt > 0) ? (uint32_t)fdt : 0;
+            // ACK / NACK,  the trace holds the 4 bits in a byte
+            if (rsp_len == 1 && (rsp->frame[0] & 0xF0) == 0) {
+                e->flags |= ISO14A_REPLAY_4BIT;
+            }
+        }
+
+        rs->offset[rs->count++] = rs->len;
+        rs->len += need;
+    }
+
+    iso14a_replay_hdr_t *hdr = (iso14a_replay_hdr_t *)rs->data;
+    hdr->magic = ISO14A_REPLAY_MAGIC;
+    hdr->count = rs->count;
+    hdr->length = rs->len;
+    return true;
+}
+
+static void hf14a_replay_print(hf14a_replay_script_t *rs, const iso14a_replay_stat_t *stats, const iso14a_replay_result_t *result, bool verbose) {
+
+    uint32_t answered = 0, silent = 0, late = 0;
+    int32_t err_min = INT32_MAX, err_max = INT32_MIN;
+    int64_t err_sum = 0;
+    for (uint16_t i = 0; i < rs->count; i++) {
+        const iso14a_replay_entry_t *e = hf14a_replay_entry(rs, i);
+        const iso14a_replay_stat_t *st = &stats[i];
+        if (e->rsp_len == 0) {
+            silent += st->count;
+            continue;
+        }
+        answered += st->count;
+        if (st->count) {
+            late += st->late;
+            err_min = MIN(err_min, st->err_min);
+            err_max = MAX(err_max, st->err_max);
+            err_sum += st->err_sum;
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Replay") " ---------------------------");
+    PrintAndLogEx(INFO, "Reader frames........ " _YELLOW_("%u"), result->frames);
+    PrintAndLogEx(INFO, "Answered............. " _YELLOW_("%u"), answered);
+    PrintAndLogEx(INFO, "Silent as recorded... %u", silent);
+    PrintAndLogEx(INFO, "Not in trace......... " _YELLOW_("%u"), result->unmatched);
+    PrintAndLogEx(INFO, "Passes............... %u", result->passes);
+    PrintAndLogEx(INFO, "Precomputed answers.. %u", result->precomputed);
+    if (answered) {
+        PrintAndLogEx(INFO, "Delay error us....... min %.1f  avg %.1f  max %.1f",
+                      (float)err_min / 13.56, (float)err_sum / answered / 13.56, (float)err_max / 13.56);
+        if (late) {
+            PrintAndLogEx(INFO, "Late answers......... " _RED_("%u") " ( more than %.1f us after the recording )", late, (float)ISO14A_REPLAY_LATE / 13.56);
+        } else {
+            PrintAndLogEx(INFO, "Late answers......... " _GREEN_("0"));
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Answer delay,  recorded and sent minus recorded,  us");
+    PrintAndLogEx(INFO, "    # | count |  late | recorded |   min   |   avg   |   max   | command");
+    PrintAndLogEx(INFO, "------+-------+-------+----------+---------+---------+---------+---------------");
+    for (uint16_t i = 0; i < rs->count; i++) {
+        iso14a_replay_entry_t *e = hf14a_replay_entry(rs, i);
+        const iso14a_replay_stat_t *st = &stats[i];
+        if (verbose == false && st->count == 0) {
+            continue;
+        }
+
+        const uint8_t *cmd = (const uint8_t *)e + sizeof(iso14a_replay_entry_t);
+        char cmdstr[40] = {0};
+        snprintf(cmdstr, sizeof(cmdstr), "%s%s", sprint_hex_inrow(cmd, MIN(e->cmd_len, 12)), (e->cmd_len > 12) ? "..." : "");
+
+        if (e->rsp_len == 0) {
+            PrintAndLogEx(INFO, " %4u | %5u |       |   silent |         |         |         | %s", i, st->count, cmdstr);
+        } else if (st->count == 0) {
+            PrintAndLogEx(INFO, " %4u | %5u |       | %8.1f |         |         |         | %s", i, st->count, (float)e->fdt / 13.56, cmdstr);
+        } else {
+            PrintAndLogEx(INFO, " %4u | %5u | %5u | %8.1f | %7.1f | %7.1f | %7.1f | %s"
+                          , i
+                          , st->count
+                          , st->late
+                          , (float)e->fdt / 13.56
+                          , (float)st->err_min / 13.56
+                          , (float)st->err_sum / st->count / 13.56
+                          , (float)st->err_max / 13.56
+                          , cmdstr
+                         );
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+}
+
+static int CmdHF14AReplay(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 14a replay",
+                  "Answer a reader the way the tag of a recorded trace did.\n"
+                  "Each reader frame of the trace and the tag frame after it become one exchange,  the answers are\n"
+                  "modulated before the reader shows up and sent at the recorded frame delay.  A reader command is\n"
+                  "looked up in recording order,  from the exchange after the last match on.\n"
+                  "Commands not in the trace are left unanswered,  so are random reader nonces of an encrypted session.\n"
+                  "The trace is loaded into emulator memory.  Use `hf 14a list` to view the replayed session.",
+                  "hf 14a replay -f hf_14a_mfu.trace\n"
+                  "hf 14a replay -f hf_14a_reader_4b.trace -n 100     -> stop after the trace was replayed 100 times\n"
+                  "hf 14a replay -f hf_14a_mfu.trace --asap           -> answer at the minimal frame delay"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "Trace file to replay"),
+        arg_int0("n", "num", "<dec>", "Exit after the last exchange of the trace was replayed <num> times. 0 = infinite"),
+        arg_lit0(NULL, "asap", "Answer at the minimal frame delay instead of the recorded one"),
+        arg_lit0("v", "verbose", "List exchanges the reader never sent too"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    iso14a_replay_param_t param = {
+        .passes = arg_get_u32_def(ctx, 2, 0),
+        .flags = (arg_get_lit(ctx, 3)) ? ISO14A_REPLAY_ASAP : 0,
+    };
+    bool verbose = arg_get_lit(ctx, 4);
+    CLIParserFree(ctx);
+
+    uint8_t *trace = NULL;
+    uint32_t trace_len = 0, *index = NULL, count = 0;
+    int res = LoadTraceFile(filename, &trace, &trace_len, &index, &count);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    hf14a_replay_script_t *rs = calloc(1, sizeof(hf14a_replay_script_t));
+    if (rs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(trace);
+        free(index);
+        return PM3_EMALLOC;
+    }
+
+    bool fits = hf14a_replay_build(trace, index, count, false, rs);
+    if (fits == false) {
+        // polling loops repeat the same exchanges,  one of each answers them just as well
+        fits = hf14a_replay_build(trace, index, count, true, rs);
+        if (fits) {
+            PrintAndLogEx(INFO, "Repeated exchanges left out to fit emulator memory");
+        }
+    }
+    free(trace);
+    free(index);
+
+    if (fits == false) {
+        PrintAndLogEx(FAILED, "Trace too large,  its exchanges need more than " _YELLOW_("%u") " bytes of emulator memory", ISO14A_REPLAY_MAX_SIZE);
+        free(rs);
+        return PM3_EOVFLOW;
+    }
+    if (rs->count == 0) {
+        PrintAndLogEx(FAILED, "No reader frames in trace");
+        free(rs);
+        return PM3_ENODATA;
+    }
+
+    PrintAndLogEx(INFO, "Replaying " _YELLOW_("%u") " exchanges,  " _YELLOW_("%u") " bytes", rs->count, rs->len);
+
+    res = mfEmlSetMemBulk(rs->data, rs->len);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Loading the trace into emulator memory failed ( " _RED_("%d") " )", res);
+        free(rs);
+        return res;
+    }
+
+    iso14a_replay_stat_t *stats = calloc(rs->count, sizeof(iso14a_replay_stat_t));
+    if (stats == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(rs);
+        return PM3_EMALLOC;
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_REPLAY, (uint8_t *)&param, sizeof(param));
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort replay");
+
+    PacketResponseNG resp;
+    bool aborted = false;
+    res = PM3_SUCCESS;
+    for (;;) {
+        if (IsCommunicationThreadDead()) {
+            res = PM3_EIO;
+            break;
+        }
+
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+
+        if (WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 250, false) == false) {
+            continue;
+        }
+
+        if (resp.cmd == CMD_HF_ISO14443A_REPLAY) {
+            res = resp.status;
+            break;
+        }
+
+        const iso14a_replay_stats_chunk_t *chunk = (const iso14a_replay_stats_chunk_t *)resp.data.asBytes;
+        if (resp.cmd != CMD_HF_ISO14443A_REPLAY_STATS || resp.length < sizeof(iso14a_replay_stats_chunk_t) ||
+                resp.length != sizeof(iso14a_replay_stats_chunk_t) + chunk->count * sizeof(iso14a_replay_stat_t) ||
+                chunk->first + chunk->count > rs->count) {
+            continue;
+        }
+        memcpy(&stats[chunk->first], chunk->rec, chunk->count * sizeof(iso14a_replay_stat_t));
+    }
+
+    if (res == PM3_SUCCESS || res == PM3_EOPABORTED) {
+        iso14a_replay_result_t result = {0};
+        memcpy(&result, resp.data.asBytes, MIN(resp.length, sizeof(result)));
+        hf14a_replay_print(rs, stats, &result, verbose);
+        res = PM3_SUCCESS;
+    } else if (res == PM3_EMALLOC) {
+        PrintAndLogEx(FAILED, "Not enough device memory for " _YELLOW_("%u") " exchanges", rs->count);
+    } else if (res != PM3_EIO) {
+        PrintAndLogEx(FAILED, "Device rejected the replay script ( " _RED_("%d") " )", res);
+    }
+
+    free(stats);
+    free(rs);
+    PrintAndLogEx(INFO, "Done!");
+    return res;
+}
+
 int CmdHF14ASniff(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14a sniff",
                   "Sniff the communication between Hitag reader and tag.\n"
-                  "Use `hf 14a list` to view collected data.",
-                  " hf 14a sniff -c -r"
+                  "Use `hf 14a list` to view collected data.\n"
+                  "With --ring the oldest frames are overwritten when device memory is full,\n"
+                  "with --stream frames are also sent to the client while sniffing,  limited by host memory / disk only.\n"
+                  "--live shows the streamed frames as they come,  annotated like `hf 14a list`.\n"
+                  "--compact stores frames in a compact encoding,  to fit more of them in device memory.\n"
+                  "--timing keeps no payload,  only start / end of each frame and its length,  streamed\n"
+                  "to the client for response time distributions over long sessions.",
+                  " hf 14a sniff -c -r\n"
+                  " hf 14a sniff --ring\n"
+                  " hf 14a sniff --stream -f mysniff\n"
+                  " hf 14a sniff --live\n"
+                  " hf 14a sniff --timing -u -f reader_timing     -> frame edges to reader_timing.csv"
                  );
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("c", "card", "triggered by first data from card"),
         arg_lit0("r", "reader", "triggered by first 7-bit request from reader (REQ, WUP)"),
         arg_lit0("i", "interactive", "Console will not be returned until sniff finishes or is aborted"),
+        arg_lit0(NULL, "ring", "overwrite oldest frames when the trace is full"),
+        arg_lit0(NULL, "stream", "stream frames to the client while sniffing (implies -i, USB only)"),
+        arg_str0("f", "file", "<fn>", "save streamed trace to file, .pcapng for a pcap-ng capture, CSV with --timing"),
+        arg_lit0(NULL, "live", "show frames while sniffing (implies --stream)"),
+        arg_lit0(NULL, "compact", "compact trace encoding"),
+        arg_lit0(NULL, "timing", "frame timing only, no payload, streamed (USB only)"),
+        arg_lit0("u", NULL, "timing, display times in microseconds instead of clock cycles"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -912,16 +1306,71 @@ int CmdHF14ASniff(const char *Cmd) {
     }
 
     bool interactive = arg_get_lit(ctx, 3);
+
+    if (arg_get_lit(ctx, 4)) {
+        param |= SNIFF_PARAM_TRACE_RING;
+    }
+
+    bool live = arg_get_lit(ctx, 7);
+    bool stream = arg_get_lit(ctx, 5) || live;
+    if (stream) {
+        param |= SNIFF_PARAM_TRACE_STREAM;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 6), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    if (arg_get_lit(ctx, 8)) {
+        param |= SNIFF_PARAM_TRACE_COMPACT;
+    }
+
+    bool timing = arg_get_lit(ctx, 9);
+    bool use_us = arg_get_lit(ctx, 10);
     CLIParserFree(ctx);
 
+    if (timing) {
+        if (param & (SNIFF_PARAM_TRACE_RING | SNIFF_PARAM_TRACE_STREAM | SNIFF_PARAM_TRACE_COMPACT)) {
+            PrintAndLogEx(WARNING, "--timing can't be combined with --ring / --stream / --live / --compact");
+            return PM3_EINVARG;
+        }
+        param |= SNIFF_PARAM_TIMING;
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_ISO14443A_SNIFF, (uint8_t *)&param, sizeof(uint8_t));
+        PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " to abort sniffing");
+
+        int res = ReceiveSniffTiming(CMD_HF_ISO14443A_SNIFF, filename, use_us);
+        PrintAndLogEx(INFO, "Done!");
+        return res;
+    }
+
+    if ((param & SNIFF_PARAM_TRACE_COMPACT) && (param & (SNIFF_PARAM_TRACE_RING | SNIFF_PARAM_TRACE_STREAM))) {
+        PrintAndLogEx(WARNING, "--compact can't be combined with --ring / --stream / --live");
+        return PM3_EINVARG;
+    }
+
+    if (fnlen && (stream == false)) {
+        PrintAndLogEx(WARNING, "--file needs --stream,  use `trace save` after a normal sniff");
+        return PM3_EINVARG;
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ISO14443A_SNIFF, (uint8_t *)&param, sizeof(uint8_t));
 
     PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " to abort sniffing");
 
+    if (stream) {
+        int res = ReceiveTraceStream(CMD_HF_ISO14443A_SNIFF, filename, live, ISO_14443A);
+        PrintAndLogEx(INFO, "Done!");
+        PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 14a list -1")"` to view the streamed tracelog");
+        return res;
+    }
+
     if (interactive) {
         PacketResponseNG resp;
         WaitForResponse(CMD_HF_ISO14443A_SNIFF, &resp);
+        PrintDecoderStats(resp.data.asBytes, resp.length);
         PrintAndLogEx(INFO, "Done!");
         PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 14a list")"` to view captured tracelog");
         PrintAndLogEx(HINT, "Try `" _YELLOW_("trace save -h") "` to save tracelog for later analysing");
@@ -1289,6 +1738,71 @@ int ExchangeAPDU14a(const uint8_t *datain, int datainlen, bool activateField, bo
     return PM3_SUCCESS;
 }
 
+// Runs a list of APDUs on the device without host round trips,  the ISO14443-4 block
+// protocol (chaining, WTX, retransmission) is all done there.
+// apdus holds count times [uint16_t len][APDU],  dataout gets count iso14a_apdu_batch_entry_t.
+int ExchangeAPDU14aBatch(const uint8_t *apdus, int apdus_len, uint8_t count, bool activateField, bool leaveSignalON, bool stop_on_error,
+                         uint8_t *dataout, int maxdataoutlen, int *dataoutlen, uint8_t *done) {
+    *dataoutlen = 0;
+    *done = 0;
+
+    if (apdus_len + sizeof(iso14a_apdu_batch_req_t) > PM3_CMD_DATA_SIZE) {
+        PrintAndLogEx(ERR, "APDU batch too large, %d bytes", apdus_len);
+        return PM3_EINVARG;
+    }
+
+    uint8_t pkt[PM3_CMD_DATA_SIZE] = {0};
+    iso14a_apdu_batch_req_t *req = (iso14a_apdu_batch_req_t *)pkt;
+    req->flags = ISO14A_NO_DISCONNECT;
+    if (activateField) {
+        req->flags |= ISO14A_CONNECT;
+    }
+    req->stop_on_error = stop_on_error;
+    req->count = count;
+    memcpy(req->data, apdus, apdus_len);
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443A_APDU_BATCH, pkt, sizeof(iso14a_apdu_batch_req_t) + apdus_len);
+
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_ISO14443A_APDU_BATCH, &resp, 2000 + (count * 1500)) == false) {
+        PrintAndLogEx(DEBUG, "ERR: APDU: Reply timeout");
+        DropField();
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.length != sizeof(iso14a_apdu_batch_resp_t)) {
+        PrintAndLogEx(DEBUG, "ERR: APDU: batch failed ( %d )", resp.status);
+        DropField();
+        return (resp.status != PM3_SUCCESS) ? resp.status : PM3_EAPDU_FAIL;
+    }
+
+    iso14a_apdu_batch_resp_t br;
+    memcpy(&br, resp.data.asBytes, sizeof(br));
+
+    if (br.bb_len > (uint32_t)maxdataoutlen) {
+        PrintAndLogEx(DEBUG, "ERR: APDU: Buffer too small(%d), needs %u bytes", maxdataoutlen, br.bb_len);
+        DropField();
+        return PM3_EAPDU_FAIL;
+    }
+
+    if (br.bb_len && GetFromDevice(BIG_BUF, dataout, br.bb_len, br.bb_offset, NULL, 0, NULL, 2500, false) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        DropField();
+        return PM3_ETIMEOUT;
+    }
+
+    *dataoutlen = br.bb_len;
+    *done = br.count;
+
+    if (resp.status == PM3_SUCCESS && leaveSignalON) {
+        SetISODEPState(ISODEP_NFCA);
+    } else {
+        DropField();
+    }
+    return resp.status;
+}
+
 // ISO14443-4. 7. Half-duplex block transmission protocol
 static int CmdHF14AAPDU(const char *Cmd) {
     CLIParserContext *ctx;
@@ -1417,6 +1931,109 @@ static int CmdHF14AAPDU(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+#define APDU_BATCH_MAX 32
+
+static int CmdHF14AAPDUBatch(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 14a apdubatch",
+                  "Sends a list of ISO 7816-4 APDUs in one device command.\n"
+                  "The device does the ISO 14443-4 block protocol itself,  I-block chaining,  WTX and\n"
+                  "R-block retransmission,  and returns all responses together",
+                  "hf 14a apdubatch -s -d 00A404000E325041592E5359532E444446303100 -d 00B2010C00\n"
+                  "hf 14a apdubatch -se -d 9060000000 -d 90AF000000 -d 90AF000000   -> stop at first error status\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("s",  "select",   "activate field and select card"),
+        arg_lit0("k",  "keep",     "keep signal field ON after receive"),
+        arg_lit0("e",  "stop",     "stop at the first status word which isn't 9000, 61xx, 9100 or 91AF"),
+        arg_strx1("d", "data",     "<hex>", "APDU,  repeat for more"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    bool activateField = arg_get_lit(ctx, 1);
+    bool leaveSignalON = arg_get_lit(ctx, 2);
+    bool stop_on_error = arg_get_lit(ctx, 3);
+    struct arg_str *apdu_arg = arg_get_str(ctx, 4);
+
+    if (apdu_arg->count > APDU_BATCH_MAX) {
+        PrintAndLogEx(FAILED, "At most %u APDUs", APDU_BATCH_MAX);
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    uint8_t count = apdu_arg->count;
+    uint8_t apdus[PM3_CMD_DATA_SIZE] = {0};
+    int apdus_len = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+        uint8_t apdu[PM3_CMD_DATA_SIZE] = {0};
+        int len = 0;
+        if (param_gethex_to_eol(apdu_arg->sval[i], 0, apdu, sizeof(apdu), &len) || len == 0) {
+            PrintAndLogEx(FAILED, "APDU %u must be hex", i + 1);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        if (apdus_len + 2 + len + sizeof(iso14a_apdu_batch_req_t) > PM3_CMD_DATA_SIZE) {
+            PrintAndLogEx(FAILED, "APDUs don't fit in one command,  at most %zu bytes", PM3_CMD_DATA_SIZE - sizeof(iso14a_apdu_batch_req_t));
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        uint16_t len16 = len;
+        memcpy(apdus + apdus_len, &len16, sizeof(len16));
+        memcpy(apdus + apdus_len + 2, apdu, len);
+        apdus_len += 2 + len;
+    }
+    CLIParserFree(ctx);
+
+    uint64_t t1 = msclock();
+
+    uint8_t *out = calloc(1, ISO14A_APDU_BATCH_BUF);
+    if (out == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    int outlen = 0;
+    uint8_t done = 0;
+    int res = ExchangeAPDU14aBatch(apdus, apdus_len, count, activateField, leaveSignalON, stop_on_error, out, ISO14A_APDU_BATCH_BUF, &outlen, &done);
+
+    const uint8_t *p = apdus;
+    int pos = 0;
+    for (uint8_t i = 0; i < done && pos + sizeof(iso14a_apdu_batch_entry_t) <= (size_t)outlen; i++) {
+        iso14a_apdu_batch_entry_t e;
+        memcpy(&e, out + pos, sizeof(e));
+        const uint8_t *data = out + pos + sizeof(e);
+        pos += sizeof(e) + e.len;
+        if (pos > outlen) {
+            break;
+        }
+
+        uint16_t len16 = 0;
+        memcpy(&len16, p, sizeof(len16));
+        PrintAndLogEx(SUCCESS, ">>> %s", sprint_hex_inrow(p + 2, len16));
+        p += 2 + len16;
+
+        if (e.status != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "<<< exchange failed ( %d )", e.status);
+            continue;
+        }
+        PrintAndLogEx(SUCCESS, "<<< %s", sprint_hex_inrow(data, e.len));
+        if (e.len >= 2) {
+            PrintAndLogEx(SUCCESS, "<<< status: %02X %02X - %s", data[e.len - 2], data[e.len - 1], GetAPDUCodeDescription(data[e.len - 2], data[e.len - 1]));
+        }
+    }
+    free(out);
+
+    PrintAndLogEx(INFO, "%u of %u APDUs in %" PRIu64 " ms", done, count, msclock() - t1);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "APDU batch failed ( %d )", res);
+    }
+    return res;
+}
+
 static int CmdHF14ACmdRaw(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 14a raw",
@@ -3611,12 +4228,15 @@ static command_t CommandTable[] = {
     {"config",      CmdHf14AConfig,       IfPm3Iso14443a,  "Configure 14a settings (use with caution)"},
     {"cuids",       CmdHF14ACUIDs,        IfPm3Iso14443a,  "Collect n>0 ISO14443-a UIDs in one go"},
     {"info",        CmdHF14AInfo,         IfPm3Iso14443a,  "Tag information"},
+    {"inventory",   CmdHF14AInventory,    IfPm3Iso14443a,  "List all ISO 14443-a cards in the field"},
     {"sim",         CmdHF14ASim,          IfPm3Iso14443a,  "Simulate ISO 14443-a tag"},
     {"sniff",       CmdHF14ASniff,        IfPm3Iso14443a,  "sniff ISO 14443-a traffic"},
     {"raw",         CmdHF14ACmdRaw,       IfPm3Iso14443a,  "Send raw hex data to tag"},
     {"reader",      CmdHF14AReader,       IfPm3Iso14443a,  "Act like an ISO14443-a reader"},
+    {"replay",      CmdHF14AReplay,       IfPm3Iso14443a,  "Answer a reader as the tag of a recorded trace did"},
     {"-----------", CmdHelp,              IfPm3Iso14443a,  "------------------------- " _CYAN_("APDU") " -------------------------"},
     {"apdu",        CmdHF14AAPDU,         IfPm3Iso14443a,  "Send ISO 14443-4 APDU to tag"},
+    {"apdubatch",   CmdHF14AAPDUBatch,    IfPm3Iso14443a,  "Send a list of ISO 14443-4 APDUs in one device command"},
     {"apdufind",    CmdHf14AFindapdu,     IfPm3Iso14443a,  "Enumerate APDUs - CLA/INS/P1P2"},
     {"chaining",    CmdHF14AChaining,     IfPm3Iso14443a,  "Control ISO 14443-4 input chaining"},
     {"-----------", CmdHelp,              IfPm3Iso14443a,  "------------------------- " _CYAN_("NDEF") " -------------------------"},
@@ -319,6 +319,29 @@ static bool wait_cmd_14b(bool verbose, bool is_select, uint32_t timeout) {
     return true;
 }
 
+// one firmware call which tries all 14B selects,  see ISO14B_SELECT_PROBE
+static bool probe_14b(PacketResponseNG *resp, bool verbose) {
+    iso14b_raw_cmd_t packet = {
+        .flags = (ISO14B_CONNECT | ISO14B_SELECT_PROBE | ISO14B_DISCONNECT),
+        .timeout = 0,
+        .rawlen = 0,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
+    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, resp, TIMEOUT) == false) {
+        if (verbose) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply");
+        }
+        return false;
+    }
+
+    if (resp->length < sizeof(iso14b_probe_resp_t)) {
+        return false;
+    }
+    return true;
+}
+
 static bool get_14b_UID(uint8_t *d, iso14b_type_t *found_type) {
 
     // sanity checks
@@ -328,19 +351,15 @@ static bool get_14b_UID(uint8_t *d, iso14b_type_t *found_type) {
 
     *found_type = ISO14B_NONE;
 
-    iso14b_raw_cmd_t packet = {
-        .flags = (ISO14B_CONNECT | ISO14B_SELECT_SR | ISO14B_DISCONNECT),
-        .timeout = 0,
-        .rawlen = 0,
-    };
-
     PacketResponseNG resp;
-    clearCommandBuffer();
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT)) {
+    if (probe_14b(&resp, true) == false) {
+        return false;
+    }
 
-        if (resp.status == PM3_SUCCESS) {
-            memcpy(d, resp.data.asBytes, sizeof(iso14b_card_select_t));
+    const iso14b_probe_resp_t *probe = (const iso14b_probe_resp_t *)resp.data.asBytes;
+    switch (probe->type) {
+        case ISO14B_SR: {
+            memcpy(d, probe->data, sizeof(iso14b_card_select_t));
 
             iso14b_card_select_t *card = (iso14b_card_select_t *)d;
             uint8_t empty[] =  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
@@ -350,37 +369,19 @@ static bool get_14b_UID(uint8_t *d, iso14b_type_t *found_type) {
             *found_type = ISO14B_SR;
             return true;
         }
-    }
-
-    // test 14b standard
-    packet.flags = (ISO14B_CONNECT | ISO14B_SELECT_STD | ISO14B_DISCONNECT);
-
-    clearCommandBuffer();
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT)) {
-
-        if (resp.status == PM3_SUCCESS) {
-            memcpy(d, resp.data.asBytes, sizeof(iso14b_card_select_t));
+        case ISO14B_STANDARD: {
+            memcpy(d, probe->data, sizeof(iso14b_card_select_t));
             *found_type = ISO14B_STANDARD;
             return true;
         }
-    }
-
-    // test CT
-    packet.flags = (ISO14B_CONNECT | ISO14B_SELECT_CTS | ISO14B_DISCONNECT);
-    clearCommandBuffer();
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT)) {
-
-        if (resp.status == PM3_SUCCESS) {
-            memcpy(d, resp.data.asBytes, sizeof(iso14b_cts_card_select_t));
+        case ISO14B_CT: {
+            memcpy(d, probe->data, sizeof(iso14b_cts_card_select_t));
             *found_type = ISO14B_CT;
             return true;
         }
+        default:
+            return false;
     }
-
-    PrintAndLogEx(WARNING, "timeout while waiting for reply");
-    return false;
 }
 
 /* extract uid from filename
@@ -1255,29 +1256,14 @@ static int write_sr_block(uint8_t blockno, uint8_t datalen, uint8_t *data) {
     return PM3_SUCCESS;
 }
 
-static bool HF14B_st_reader(bool verbose) {
-
-    iso14b_raw_cmd_t packet = {
-        .flags = (ISO14B_CONNECT | ISO14B_SELECT_SR | ISO14B_DISCONNECT),
-        .timeout = 0,
-        .rawlen = 0,
-    };
+// the HF14B_*_reader print the result of one variant of the probe
+static bool HF14B_st_reader(bool verbose, const iso14b_probe_resp_t *probe) {
 
     // SRx get and print general info about SRx chip from UID
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT) == false) {
-        if (verbose) {
-            PrintAndLogEx(WARNING, "timeout while waiting for reply");
-        }
-        return false;
-    }
-
-    switch (resp.status) {
+    switch (probe->status[ISO14B_PROBE_SR]) {
         case PM3_SUCCESS: {
             iso14b_card_select_t card;
-            memcpy(&card, (iso14b_card_select_t *)resp.data.asBytes, sizeof(iso14b_card_select_t));
+            memcpy(&card, probe->data, sizeof(iso14b_card_select_t));
 
             uint8_t empty[] =  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
             if ((card.uidlen != 8) || (memcmp(card.uid, empty, card.uidlen) == 0)) {
@@ -1302,28 +1288,13 @@ static bool HF14B_st_reader(bool verbose) {
     return false;
 }
 
-static bool HF14B_std_reader(bool verbose) {
-    iso14b_raw_cmd_t packet = {
-        .flags = (ISO14B_CONNECT | ISO14B_SELECT_STD | ISO14B_DISCONNECT),
-        .timeout = 0,
-        .rawlen = 0,
-    };
+static bool HF14B_std_reader(bool verbose, const iso14b_probe_resp_t *probe) {
 
     // 14b get and print UID only (general info)
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT) == false) {
-        if (verbose) {
-            PrintAndLogEx(WARNING, "timeout while waiting for reply");
-        }
-        return false;
-    }
-
-    switch (resp.status) {
+    switch (probe->status[ISO14B_PROBE_STD]) {
         case PM3_SUCCESS: {
             iso14b_card_select_t card;
-            memcpy(&card, (iso14b_card_select_t *)resp.data.asBytes, sizeof(iso14b_card_select_t));
+            memcpy(&card, probe->data, sizeof(iso14b_card_select_t));
 
             uint8_t empty[] =  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
             if (memcmp(card.uid, empty, card.uidlen) == 0) {
@@ -1352,26 +1323,12 @@ static bool HF14B_std_reader(bool verbose) {
     return false;
 }
 
-static bool HF14B_ask_ct_reader(bool verbose) {
-
-    iso14b_raw_cmd_t packet = {
-        .flags = (ISO14B_CONNECT | ISO14B_SELECT_CTS | ISO14B_DISCONNECT),
-        .timeout = 0,
-        .rawlen = 0,
-    };
+static bool HF14B_ask_ct_reader(bool verbose, const iso14b_probe_resp_t *probe) {
 
     // 14b get and print UID only (general info)
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT) == false) {
-        if (verbose) PrintAndLogEx(WARNING, "timeout while waiting for reply");
-        return false;
-    }
-
-    switch (resp.status) {
+    switch (probe->status[ISO14B_PROBE_CTS]) {
         case PM3_SUCCESS: {
-            print_ct_general_info(resp.data.asBytes);
+            print_ct_general_info((void *)probe->data);
             return true;
         }
         case PM3_ELENGTH: {
@@ -1390,24 +1347,10 @@ static bool HF14B_ask_ct_reader(bool verbose) {
     return false;
 }
 
-static bool HF14B_picopass_reader(bool verbose) {
-
-    iso14b_raw_cmd_t packet = {
-        .flags = (ISO14B_CONNECT | ISO14B_SELECT_PICOPASS | ISO14B_DISCONNECT),
-        .timeout = 0,
-        .rawlen = 0,
-    };
+static bool HF14B_picopass_reader(bool verbose, const iso14b_probe_resp_t *probe) {
 
     // 14b get and print UID only (general info)
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)&packet, sizeof(iso14b_raw_cmd_t));
-    if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, TIMEOUT) == false) {
-        if (verbose) PrintAndLogEx(WARNING, "timeout while waiting for reply");
-        return false;
-    }
-
-    switch (resp.status) {
+    switch (probe->status[ISO14B_PROBE_PICOPASS]) {
         case PM3_SUCCESS: {
 
             picopass_hdr_t *card = calloc(1, sizeof(picopass_hdr_t));
@@ -1415,7 +1358,7 @@ static bool HF14B_picopass_reader(bool verbose) {
                 PrintAndLogEx(FAILED, "failed to allocate memory");
                 return false;
             }
-            memcpy(card, resp.data.asBytes, sizeof(picopass_hdr_t));
+            memcpy(card, probe->data, sizeof(picopass_hdr_t));
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(SUCCESS, "iCLASS / Picopass CSN: " _GREEN_("%s"), sprint_hex(card->csn, sizeof(card->csn)));
             free(card);
@@ -1770,86 +1713,32 @@ static int CmdHF14BDump(const char *Cmd) {
         // detect blocksize from card :)
         PrintAndLogEx(INFO, "reading tag memory");
 
-        iso14b_raw_cmd_t *packet = (iso14b_raw_cmd_t *)calloc(1, sizeof(iso14b_raw_cmd_t) + 2);
-        if (packet == NULL) {
-            PrintAndLogEx(FAILED, "failed to allocate memory");
-            return PM3_EMALLOC;
-        }
-        packet->flags = (ISO14B_CONNECT | ISO14B_SELECT_SR);
-        packet->timeout = 0;
-        packet->rawlen = 0;
+        // all blocks and the system block in one firmware call
+        struct {
+            uint8_t lastblock;
+        } PACKED payload = { lastblock };
 
         clearCommandBuffer();
-        SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)packet, sizeof(iso14b_raw_cmd_t));
+        SendCommandNG(CMD_HF_SRI_DUMP, (uint8_t *)&payload, sizeof(payload));
         PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_SRI_DUMP, &resp, 2500) == false) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply");
+            return PM3_ETIMEOUT;
+        }
 
-        // select SR tag
-        if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, 2000)) {
-            if (resp.status != PM3_SUCCESS) {
-                PrintAndLogEx(FAILED, "failed to select ( " _RED_("%d") " )", resp.status);
-                free(packet);
-                return switch_off_field_14b();
-            }
+        if (resp.status != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "dump failed ( " _RED_("%d") " )", resp.status);
+            return PM3_ESOFT;
         }
 
-        PrintAndLogEx(INFO, "." NOLF);
+        iso14b_srx_dump_resp_t dump;
+        memcpy(&dump, resp.data.asBytes, sizeof(dump));
 
         uint8_t data[cardsize];
         memset(data, 0, sizeof(data));
-        uint16_t blocknum = 0;
-
-        for (int retry = 0; retry < 3; retry++) {
-
-            // set up the read command
-            packet->flags = (ISO14B_APPEND_CRC | ISO14B_RAW);
-            packet->rawlen = 2;
-            packet->raw[0] = ISO14443B_READ_BLK;
-            packet->raw[1] = blocknum & 0xFF;
-
-            clearCommandBuffer();
-            SendCommandNG(CMD_HF_ISO14443B_COMMAND, (uint8_t *)packet, sizeof(iso14b_raw_cmd_t) + 2);
-            if (WaitForResponseTimeout(CMD_HF_ISO14443B_COMMAND, &resp, 2000)) {
-
-                if (resp.status != PM3_SUCCESS) {
-                    PrintAndLogEx(FAILED, "retrying one more time");
-                    continue;
-                }
-
-                uint8_t *recv = resp.data.asBytes;
-
-                if (check_crc(CRC_14443_B, recv, resp.length) == false) {
-                    PrintAndLogEx(FAILED, "crc fail, retrying one more time");
-                    continue;
-                }
-
-                // last read
-                if (blocknum == 0xFF) {
-                    // we reserved space for this block after 0x0F and 0x7F,  ie 0x10, 0x80
-                    memcpy(data + ((lastblock + 1) * ST25TB_SR_BLOCK_SIZE), recv, ST25TB_SR_BLOCK_SIZE);
-                    break;
-                }
-                memcpy(data + (blocknum * ST25TB_SR_BLOCK_SIZE), recv, ST25TB_SR_BLOCK_SIZE);
-
-
-                retry = 0;
-                blocknum++;
-                if (blocknum > lastblock) {
-                    // read config block
-                    blocknum = 0xFF;
-                }
-
-                PrintAndLogEx(NORMAL, "." NOLF);
-                fflush(stdout);
-            }
-        }
-        free(packet);
-
-        PrintAndLogEx(NORMAL, "");
-        switch_off_field_14b();
-
-        if (blocknum != 0xFF) {
-            PrintAndLogEx(FAILED, "dump failed");
-            return PM3_ESOFT;
+        if (GetFromDevice(BIG_BUF, data, (lastblock + 2) * ST25TB_SR_BLOCK_SIZE, dump.bb_offset, NULL, 0, NULL, 2500, false) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            return PM3_ETIMEOUT;
         }
 
         print_sr_blocks(data, cardsize, card.uid, dense_output);
@@ -2936,23 +2825,15 @@ int readHF14B(bool loop, bool verbose, bool read_plot) {
     do {
         found = false;
 
-        // try std 14b (atqb)
-        found |= HF14B_std_reader(verbose);
-        if (found)
-            goto plot;
-
-        // try ST Microelectronics 14b
-        found |= HF14B_st_reader(verbose);
-        if (found)
-            goto plot;
-
-        // Picopass
-        found |= HF14B_picopass_reader(verbose);
-        if (found)
-            goto plot;
-
-        // try ASK CT 14b
-        found |= HF14B_ask_ct_reader(verbose);
+        // std 14b (atqb),  ST Microelectronics 14b,  Picopass and ASK CT 14b in one go
+        PacketResponseNG resp;
+        if (probe_14b(&resp, verbose)) {
+            const iso14b_probe_resp_t *probe = (const iso14b_probe_resp_t *)resp.data.asBytes;
+            found = HF14B_std_reader(verbose, probe) ||
+                    HF14B_st_reader(verbose, probe) ||
+                    HF14B_picopass_reader(verbose, probe) ||
+                    HF14B_ask_ct_reader(verbose, probe);
+        }
         if (found)
             goto plot;
 
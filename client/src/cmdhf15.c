@@ -41,6 +41,7 @@
 #include "cmddata.h"            // getsamples
 #include "fileutils.h"          // pm3_save_dump
 #include "cliparser.h"
+#include "cmdhw.h"              // PrintDecoderStats
 #include "util_posix.h"         // msleep
 #include "iso15.h"              // typedef structs / enum
 
@@ -1127,24 +1128,129 @@ static int CmdHF15Info(const char *Cmd) {
 }
 
 // Sniff Activity without enabling carrier
+static int CmdHF15Inventory(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf 15 inventory",
+                  "List every ISO-15693 tag in the field in one go.\n"
+                  "The device runs 16 slot inventory rounds and resolves collisions with the mask,\n"
+                  "found tags are sent STAY QUIET until the field is switched off",
+                  "hf 15 inventory\n"
+                  "hf 15 inventory -k    --> keep field on, the tags stay quiet"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("k", "keep", "keep the field on afterwards"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint8_t keep_field = arg_get_lit(ctx, 1);
+    CLIParserFree(ctx);
+
+    uint64_t t1 = msclock();
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_INVENTORY, &keep_field, sizeof(keep_field));
+
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_HF_ISO15693_INVENTORY, &resp, 5000) == false) {
+        PrintAndLogEx(WARNING, "timeout while waiting for reply");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.status != PM3_SUCCESS || resp.length != sizeof(iso15_inventory_t)) {
+        PrintAndLogEx(WARNING, "inventory failed ( %d )", resp.status);
+        return PM3_ESOFT;
+    }
+
+    const iso15_inventory_t *inv = (const iso15_inventory_t *)resp.data.asBytes;
+    if (inv->count == 0) {
+        PrintAndLogEx(WARNING, "no tag found");
+        return PM3_ECARDEXCHANGE;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "  # | UID                     | DSFID");
+    PrintAndLogEx(INFO, "----+-------------------------+-------");
+    for (uint8_t i = 0; i < inv->count && i < ISO15_INVENTORY_MAX; i++) {
+        uint8_t uid[HF15_UID_LENGTH];
+        memcpy(uid, inv->tags[i].uid, sizeof(uid));
+        PrintAndLogEx(SUCCESS, " %2u | " _GREEN_("%s") " |  %02X", i + 1, iso15693_sprintUID(NULL, uid), inv->tags[i].dsfid);
+    }
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, _YELLOW_("%u") " tag%s in %" PRIu64 " ms", inv->count, (inv->count > 1) ? "s" : "", msclock() - t1);
+    if (inv->truncated) {
+        PrintAndLogEx(WARNING, "list is full or collisions are left,  there may be more tags");
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdHF15Sniff(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf 15 sniff",
-                  "Sniff activity without enabling carrier",
-                  "hf 15 sniff\n");
+                  "Sniff activity without enabling carrier\n"
+                  "With --ring the oldest frames are overwritten when device memory is full,\n"
+                  "with --stream frames are also sent to the client while sniffing,  limited by host memory / disk only.\n"
+                  "--live shows the streamed frames as they come,  annotated like `hf 15 list`.\n"
+                  "--compact stores frames in a compact encoding,  to fit more of them in device memory.",
+                  "hf 15 sniff\n"
+                  "hf 15 sniff --stream -f mysniff\n"
+                  "hf 15 sniff --live\n");
 
     void *argtable[] = {
         arg_param_begin,
+        arg_lit0(NULL, "ring", "overwrite oldest frames when the trace is full"),
+        arg_lit0(NULL, "stream", "stream frames to the client while sniffing (USB only)"),
+        arg_lit0(NULL, "live", "show frames while sniffing (implies --stream)"),
+        arg_str0("f", "file", "<fn>", "save streamed trace to file, .pcapng for a pcap-ng capture"),
+        arg_lit0(NULL, "compact", "compact trace encoding"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    uint8_t param = 0;
+    if (arg_get_lit(ctx, 1)) {
+        param |= SNIFF_PARAM_TRACE_RING;
+    }
+
+    bool live = arg_get_lit(ctx, 3);
+    bool stream = arg_get_lit(ctx, 2) || live;
+    if (stream) {
+        param |= SNIFF_PARAM_TRACE_STREAM;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    if (arg_get_lit(ctx, 5)) {
+        param |= SNIFF_PARAM_TRACE_COMPACT;
+    }
     CLIParserFree(ctx);
 
+    if ((param & SNIFF_PARAM_TRACE_COMPACT) && (param & (SNIFF_PARAM_TRACE_RING | SNIFF_PARAM_TRACE_STREAM))) {
+        PrintAndLogEx(WARNING, "--compact can't be combined with --ring / --stream / --live");
+        return PM3_EINVARG;
+    }
+
+    if (fnlen && (stream == false)) {
+        PrintAndLogEx(WARNING, "--file needs --stream,  use `trace save` after a normal sniff");
+        return PM3_EINVARG;
+    }
+
     PacketResponseNG resp;
     clearCommandBuffer();
-    SendCommandNG(CMD_HF_ISO15693_SNIFF, NULL, 0);
+    SendCommandNG(CMD_HF_ISO15693_SNIFF, &param, sizeof(param));
+
+    if (stream) {
+        int res = ReceiveTraceStream(CMD_HF_ISO15693_SNIFF, filename, live, ISO_15693);
+        PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 15 list -1") "` to view the streamed tracelog");
+        PrintAndLogEx(INFO, "Done!");
+        return res;
+    }
 
     WaitForResponse(CMD_HF_ISO15693_SNIFF, &resp);
+    PrintDecoderStats(resp.data.asBytes, resp.length);
 
     PrintAndLogEx(HINT, "Try `" _YELLOW_("hf 15 list") "` to view captured tracelog");
     PrintAndLogEx(HINT, "Try `" _YELLOW_("trace save -h") "` to save tracelog for later analysing");
@@ -1531,6 +1637,7 @@ static int CmdHF15Sim(const char *Cmd) {
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ISO15693_SIMULATE, (uint8_t *)&payload, sizeof(payload));
     WaitForResponse(CMD_HF_ISO15693_SIMULATE, &resp);
+    PrintDecoderStats(resp.data.asBytes, resp.length);
     PrintAndLogEx(INFO, "Done!");
     return PM3_SUCCESS;
 }
@@ -1941,70 +2048,59 @@ static int CmdHF15Dump(const char *Cmd) {
         tag->ic = d[dCpt++];
     }
 
-    // add lenght for blockno (1)
-    packet->rawlen++;
-    packet->raw[0] |= ISO15_REQ_OPTION; // Add option to dump lock status
-    packet->raw[1] = ISO15693_READBLOCK;
-
-    packet->flags = (ISO15_READ_RESPONSE | ISO15_NO_DISCONNECT);
+    // the device reads the memory in one go,  READ MULTIPLE BLOCKS where the tag supports it
+    iso15_dump_req_t req = {
+        .flags = ISO15_NO_DISCONNECT,
+        .req_flags = packet->raw[0] | ISO15_REQ_OPTION, // Add option to dump lock status
+        .block_cnt = MIN(tag->pagesCount, ISO15693_TAG_MAX_PAGES),
+        .block_size = tag->bytesPerPage,
+    };
     if (fast) {
-        packet->flags |= ISO15_HIGH_SPEED;
+        req.flags |= ISO15_HIGH_SPEED;
+    }
+    if (used_uid) {
+        memcpy(req.uid, packet->raw + 2, sizeof(req.uid));
+    }
+    if (req.block_cnt * req.block_size > ISO15693_TAG_MAX_SIZE) {
+        req.block_cnt = ISO15693_TAG_MAX_SIZE / req.block_size;
+    }
+    if (req.block_cnt < tag->pagesCount) {
+        PrintAndLogEx(WARNING, "Tag has %u blocks,  dump format holds " _YELLOW_("%u"), tag->pagesCount, req.block_cnt);
     }
 
     PrintAndLogEx(SUCCESS, "Reading memory");
 
-    int blocknum = 0;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_ISO15693_DUMP, (uint8_t *)&req, sizeof(req));
 
-    for (int retry = 0; (retry < 2 && blocknum < tag->pagesCount); retry++) {
-        if (used_uid) {
-            packet->raw[10] = (uint8_t)blocknum & 0xFF;
-            AddCrc15(packet->raw, 11);
+    int blocknum = 0;
+    if (WaitForResponseTimeout(CMD_HF_ISO15693_DUMP, &resp, 2000 + (req.block_cnt * 40)) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+    } else if (resp.status != PM3_SUCCESS || resp.length != sizeof(iso15_dump_resp_t)) {
+        PrintAndLogEx(FAILED, "iso15693 dump failed ( %d )", resp.status);
+    } else {
+        iso15_dump_resp_t dump;
+        memcpy(&dump, resp.data.asBytes, sizeof(dump));
+
+        uint8_t stride = dump.block_size + 1;
+        uint16_t cnt = MIN(dump.block_cnt, req.block_cnt);
+        uint8_t *blocks = calloc(cnt + 1, stride);
+        if (blocks == NULL) {
+            PrintAndLogEx(FAILED, "failed to allocate memory");
+        } else if (cnt && GetFromDevice(BIG_BUF, blocks, cnt * stride, dump.bb_offset, NULL, 0, NULL, 2500, false) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
         } else {
-            packet->raw[2] = (uint8_t)blocknum & 0xFF;
-            AddCrc15(packet->raw, 3);
-        }
-
-        clearCommandBuffer();
-        SendCommandNG(CMD_HF_ISO15693_COMMAND, (uint8_t *)packet, ISO15_RAW_LEN(packet->rawlen));
-
-        if (WaitForResponseTimeout(CMD_HF_ISO15693_COMMAND, &resp, 2000)) {
-
-            if (resp.length < 2) {
-                PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(FAILED, "iso15693 command failed");
-                continue;
+            for (blocknum = 0; blocknum < cnt; blocknum++) {
+                tag->locks[blocknum] = blocks[blocknum * stride];
+                memcpy(&tag->data[blocknum * tag->bytesPerPage], blocks + (blocknum * stride) + 1, tag->bytesPerPage);
             }
 
-            d = resp.data.asBytes;
-
-            if (CheckCrc15(d, resp.length) == false) {
-                PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(FAILED, "crc ( " _RED_("fail") " )");
-                continue;
+            if (dump.last_error && dump.last_error != 0x0F && dump.last_error != 0x10) {
+                PrintAndLogEx(FAILED, "Tag returned Error %i: %s", dump.last_error, TagErrorStr(dump.last_error));
             }
-
-            if ((d[0] & ISO15_RES_ERROR) == ISO15_RES_ERROR) {
-
-                // heuristic determine end of available memory
-                if (d[1] == 0x0F || d[1] == 0x10) {
-                    break;
-                }
-
-                PrintAndLogEx(NORMAL, "");
-                PrintAndLogEx(FAILED, "Tag returned Error %i: %s", d[1], TagErrorStr(d[1]));
-                break;
-            }
-
-            tag->locks[blocknum] = d[1];
-
-            // copy read data
-            memcpy(&tag->data[blocknum * tag->bytesPerPage], d + 2, tag->bytesPerPage);
-
-            retry = 0;
-            blocknum++;
-
-            PrintAndLogEx(INPLACE, "blk %3d", blocknum);
+            PrintAndLogEx(SUCCESS, "Read " _YELLOW_("%d") " blocks,  up to %u per command", blocknum, dump.multi);
         }
+        free(blocks);
     }
 
     free(packet);
@@ -3490,6 +3586,7 @@ static command_t CommandTable[] = {
     {"demod",               CmdHF15Demod,             AlwaysAvailable, "Demodulate ISO-15693 from tag"},
     {"dump",                CmdHF15Dump,              IfPm3Iso15693,   "Read all memory pages of an ISO-15693 tag, save to file"},
     {"info",                CmdHF15Info,              IfPm3Iso15693,   "Tag information"},
+    {"inventory",           CmdHF15Inventory,         IfPm3Iso15693,   "List all ISO-15693 tags in the field"},
     {"sniff",               CmdHF15Sniff,             IfPm3Iso15693,   "Sniff ISO-15693 traffic"},
     {"raw",                 CmdHF15Raw,               IfPm3Iso15693,   "Send raw hex data to tag"},
     {"rdbl",                CmdHF15Readblock,         IfPm3Iso15693,   "Read a block"},
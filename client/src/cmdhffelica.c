@@ -31,6 +31,7 @@
 #include "des.h"
 #include "cliparser.h"   // cliparser
 #include "util_posix.h"  // msleep
+#include "fileutils.h"    // saveFileJSONrootEx
 
 #define AddCrc(data, len) compute_crc(CRC_FELICA, (data), (len), (data)+(len)+1, (data)+(len))
 
@@ -2109,6 +2110,198 @@ static int CmdHFFelicaDumpLite(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHFFelicaDump(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf felica dump",
+                  "Dump a FeliCa Standard card on the device.\n"
+                  "Polls each system,  lists the services with Search Service Code and reads every service\n"
+                  "which needs no authentication with as many blocks per Read Without Encryption as the card takes.\n"
+                  "Without system codes the card is asked for its systems with Request System Code.",
+                  "hf felica dump\n"
+                  "hf felica dump --sc 0003 --sc FE00     -> poll two systems and dump them\n"
+                  "hf felica dump --sc 0003 --sc FE00 -p  -> poll only\n"
+                  "hf felica dump -f mycard"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_strx0("s", "sc", "<hex>", "system code to poll,  repeat for more"),
+        arg_lit0("p", "poll", "poll the systems only"),
+        arg_str0("f", "file", "<fn>", "save dump to JSON file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    felica_dump_req_t payload;
+    memset(&payload, 0, sizeof(payload));
+
+    struct arg_str *sc_arg = arg_get_str(ctx, 1);
+    if (sc_arg->count > FELICA_DUMP_MAX_SYSTEMS) {
+        PrintAndLogEx(FAILED, "At most %u system codes", FELICA_DUMP_MAX_SYSTEMS);
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
+
+    for (int i = 0; i < sc_arg->count; i++) {
+        uint8_t sc[2] = {0};
+        int len = 0;
+        if (param_gethex_to_eol(sc_arg->sval[i], 0, sc, sizeof(sc), &len) || len != 2) {
+            PrintAndLogEx(FAILED, "System code must be 2 hex bytes");
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        payload.sc[payload.sc_count++] = (sc[0] << 8) | sc[1];
+    }
+
+    if (arg_get_lit(ctx, 2)) {
+        payload.flags |= FELICA_DUMP_POLL_ONLY;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    CLIParserFree(ctx);
+
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort dumping");
+
+    uint64_t t1 = msclock();
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_FELICA_DUMP, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    while (WaitForResponseTimeout(CMD_HF_FELICA_DUMP, &resp, 2000) == false) {
+        if (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(DEBUG, "User aborted");
+            WaitForResponseTimeout(CMD_HF_FELICA_DUMP, &resp, 2000);
+            return PM3_EOPABORTED;
+        }
+    }
+
+    if (resp.length < sizeof(felica_dump_resp_t)) {
+        PrintAndLogEx(WARNING, "Dump failed ( %d )", resp.status);
+        return (resp.status == PM3_SUCCESS) ? PM3_ESOFT : resp.status;
+    }
+
+    felica_dump_resp_t dump;
+    memcpy(&dump, resp.data.asBytes, sizeof(dump));
+
+    if (dump.count == 0) {
+        PrintAndLogEx(WARNING, "No FeliCa card answered");
+        return PM3_ECARDEXCHANGE;
+    }
+
+    uint8_t *data = NULL;
+    if (dump.bb_len) {
+        data = calloc(dump.bb_len, sizeof(uint8_t));
+        if (data == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return PM3_EMALLOC;
+        }
+        if (GetFromDevice(BIG_BUF, data, dump.bb_len, dump.bb_offset, NULL, 0, NULL, 2500, false) == false) {
+            PrintAndLogEx(WARNING, "command execution time out");
+            free(data);
+            return PM3_ETIMEOUT;
+        }
+    }
+
+    json_t *root = json_object();
+    json_object_set_new(root, "Created", json_string("proxmark3"));
+    json_object_set_new(root, "FileType", json_string("felica"));
+    json_t *systems = json_array();
+
+    uint32_t blocks = 0;
+    uint32_t pos = 0;
+    for (uint8_t i = 0; i < dump.count; i++) {
+        const felica_dump_system_t *sys = &dump.systems[i];
+
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "--- " _CYAN_("System %u") " code " _YELLOW_("%04X") " ------------------------------", i, sys->code);
+        PrintAndLogEx(SUCCESS, "IDm: %s", sprint_hex_inrow(sys->IDm, sizeof(sys->IDm)));
+        PrintAndLogEx(SUCCESS, "PMm: %s", sprint_hex_inrow(sys->PMm, sizeof(sys->PMm)));
+
+        json_t *jsys = json_object();
+        char s[8];
+        snprintf(s, sizeof(s), "%04X", sys->code);
+        json_object_set_new(jsys, "code", json_string(s));
+        json_object_set_new(jsys, "IDm", json_string(sprint_hex_inrow(sys->IDm, sizeof(sys->IDm))));
+        json_object_set_new(jsys, "PMm", json_string(sprint_hex_inrow(sys->PMm, sizeof(sys->PMm))));
+        json_t *services = json_array();
+
+        while (pos + sizeof(felica_dump_service_t) <= dump.bb_len) {
+            const felica_dump_service_t *svc = (felica_dump_service_t *)(data + pos);
+            if (svc->system != i) {
+                break;
+            }
+            uint32_t svc_len = sizeof(felica_dump_service_t) + svc->block_cnt * FELICA_DUMP_BLOCK_SIZE;
+            if (pos + svc_len > dump.bb_len) {
+                break;
+            }
+            const uint8_t *svc_data = data + pos + sizeof(felica_dump_service_t);
+            pos += svc_len;
+
+            json_t *jsvc = json_object();
+            snprintf(s, sizeof(s), "%04X", svc->code);
+            json_object_set_new(jsvc, "code", json_string(s));
+
+            if ((svc->code & 0x01) == 0) {
+                PrintAndLogEx(INFO, "Service " _YELLOW_("%04X") "  needs authentication", svc->code);
+                json_object_set_new(jsvc, "auth", json_true());
+                json_array_append_new(services, jsvc);
+                continue;
+            }
+
+            PrintAndLogEx(INFO, "Service " _YELLOW_("%04X") "  %u blocks", svc->code, svc->block_cnt);
+            if (svc->status[0] == 0xFF && svc->status[1] == 0xFF) {
+                PrintAndLogEx(WARNING, "  card stopped answering");
+            }
+
+            json_t *jblocks = json_array();
+            for (uint16_t b = 0; b < svc->block_cnt; b++) {
+                const uint8_t *blk = svc_data + b * FELICA_DUMP_BLOCK_SIZE;
+                PrintAndLogEx(INFO, "  %04X | %s", b, sprint_hex(blk, FELICA_DUMP_BLOCK_SIZE));
+                json_array_append_new(jblocks, json_string(sprint_hex_inrow(blk, FELICA_DUMP_BLOCK_SIZE)));
+            }
+            json_object_set_new(jsvc, "blocks", jblocks);
+            json_array_append_new(services, jsvc);
+            blocks += svc->block_cnt;
+        }
+
+        json_object_set_new(jsys, "services", services);
+        json_array_append_new(systems, jsys);
+    }
+    json_object_set_new(root, "systems", systems);
+
+    PrintAndLogEx(NORMAL, "");
+    if ((payload.flags & FELICA_DUMP_POLL_ONLY) == 0) {
+        PrintAndLogEx(SUCCESS, "Read " _YELLOW_("%u") " blocks of %u services,  up to %u blocks per read,  in %" PRIu64 " ms"
+                      , blocks
+                      , dump.services
+                      , dump.blocks_per_read
+                      , msclock() - t1
+                     );
+    }
+    if (dump.truncated) {
+        PrintAndLogEx(WARNING, "Dump truncated,  the device buffer is full");
+    }
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "Aborted,  partial dump");
+    } else if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Card exchange failed,  partial dump");
+    }
+
+    int res = resp.status;
+    if (fnlen) {
+        int sres = saveFileJSONrootEx(filename, root, JSON_INDENT(2), true, false);
+        if (res == PM3_SUCCESS) {
+            res = sres;
+        }
+    }
+    json_decref(root);
+    free(data);
+    return res;
+}
+
 static int CmdHFFelicaCmdRaw(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2203,7 +2396,7 @@ static command_t CommandTable[] = {
     {"sniff",           CmdHFFelicaSniff,                 IfPm3Felica,     "Sniff ISO 18092/FeliCa traffic"},
     {"wrbl",            CmdHFFelicaWritePlain,            IfPm3Felica,     "write block data to an authentication-not-required Service."},
     {"-----------",     CmdHelp,                          AlwaysAvailable, "----------------------- " _CYAN_("FeliCa Standard") " -----------------------"},
-    //{"dump",          CmdHFFelicaDump,                    IfPm3Felica,     "Wait for and try dumping FeliCa"},
+    {"dump",            CmdHFFelicaDump,                  IfPm3Felica,     "Dump all systems and services which need no authentication"},
     {"rqservice",       CmdHFFelicaRequestService,        IfPm3Felica,     "verify the existence of Area and Service, and to acquire Key Version."},
     {"rqresponse",      CmdHFFelicaRequestResponse,       IfPm3Felica,     "verify the existence of a card and its Mode."},
     {"scsvcode",        CmdHFFelicaNotImplementedYet,     IfPm3Felica,     "acquire Area Code and Service Code."},
@@ -18,6 +18,12 @@
 
 #include "cmdhficlass.h"
 #include <ctype.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "cliparser.h"
 #include "cmdparser.h"              // command_t
 #include "commonutil.h"             // ARRAYLEN
@@ -27,6 +33,7 @@
 #include "des.h"
 #include "loclass/cipherutils.h"
 #include "loclass/cipher.h"
+#include "loclass/cipher_bs.h"
 #include "loclass/ikeys.h"
 #include "loclass/elite_crack.h"
 #include "fileutils.h"
@@ -39,6 +46,10 @@
 #include "iclass_cmd.h"
 #include "crypto/asn1utils.h"       // ASN1 decoder
 #include "preferences.h"
+#include "cmdhw.h"                  // PrintDecoderStats
+#include "bruteforce.h"             // key generators for lookup
+#include "threadpool.h"
+#include "pm3metrics.h"
 
 
 #define NUM_CSNS               9
@@ -710,21 +721,60 @@ static int CmdHFiClassSniff(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass sniff",
-                  "Sniff the communication reader and tag",
+                  "Sniff the communication reader and tag\n"
+                  "With --ring the oldest frames are overwritten when device memory is full,\n"
+                  "with --stream frames are also sent to the client while sniffing,  limited by host memory / disk only.\n"
+                  "--live shows the streamed frames as they come,  annotated like `hf iclass list`.\n"
+                  "--compact stores frames in a compact encoding,  to fit more of them in device memory.",
                   "hf iclass sniff\n"
                   "hf iclass sniff -j    --> jam e-purse updates\n"
+                  "hf iclass sniff --live\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("j",  "jam",    "Jam (prevent) e-purse updates"),
+        arg_lit0(NULL, "ring",   "overwrite oldest frames when the trace is full"),
+        arg_lit0(NULL, "stream", "stream frames to the client while sniffing (USB only)"),
+        arg_lit0(NULL, "live",   "show frames while sniffing (implies --stream)"),
+        arg_str0("f",  "file",   "<fn>", "save streamed trace to file, .pcapng for a pcap-ng capture"),
+        arg_lit0(NULL, "compact", "compact trace encoding"),
         arg_param_end
     };
 
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     bool jam_epurse_update = arg_get_lit(ctx, 1);
+
+    uint8_t param = 0;
+    if (arg_get_lit(ctx, 2)) {
+        param |= SNIFF_PARAM_TRACE_RING;
+    }
+
+    bool live = arg_get_lit(ctx, 4);
+    bool stream = arg_get_lit(ctx, 3) || live;
+    if (stream) {
+        param |= SNIFF_PARAM_TRACE_STREAM;
+    }
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    if (arg_get_lit(ctx, 6)) {
+        param |= SNIFF_PARAM_TRACE_COMPACT;
+    }
     CLIParserFree(ctx);
 
+    if ((param & SNIFF_PARAM_TRACE_COMPACT) && (param & (SNIFF_PARAM_TRACE_RING | SNIFF_PARAM_TRACE_STREAM))) {
+        PrintAndLogEx(WARNING, "--compact can't be combined with --ring / --stream / --live");
+        return PM3_EINVARG;
+    }
+
+    if (fnlen && (stream == false)) {
+        PrintAndLogEx(WARNING, "--file needs --stream,  use `trace save` after a normal sniff");
+        return PM3_EINVARG;
+    }
+
     if (jam_epurse_update) {
         PrintAndLogEx(INFO, "Sniff with jam of iCLASS e-purse updates...");
     }
@@ -732,6 +782,7 @@ static int CmdHFiClassSniff(const char *Cmd) {
     struct {
         uint8_t jam_search_len;
         uint8_t jam_search_string[2];
+        uint8_t param;
     } PACKED payload;
 
     memset(&payload, 0, sizeof(payload));
@@ -742,11 +793,20 @@ static int CmdHFiClassSniff(const char *Cmd) {
         memcpy(payload.jam_search_string, update_epurse_sequence, sizeof(payload.jam_search_string));
     }
 
+    payload.param = param;
+
     PacketResponseNG resp;
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ICLASS_SNIFF, (uint8_t *)&payload, sizeof(payload));
 
+    if (stream) {
+        int res = ReceiveTraceStream(CMD_HF_ICLASS_SNIFF, filename, live, ICLASS);
+        PrintAndLogEx(HINT, "Try `" _YELLOW_("hf iclass list -1") "` to view the streamed tracelog");
+        return res;
+    }
+
     WaitForResponse(CMD_HF_ICLASS_SNIFF, &resp);
+    PrintDecoderStats(resp.data.asBytes, resp.length);
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(HINT, "Try `" _YELLOW_("hf iclass list") "` to view captured tracelog");
@@ -1797,6 +1857,57 @@ static bool select_only(uint8_t *CSN, uint8_t *CCNR, bool verbose, bool shallow_
     return true;
 }
 
+// Wait for the CMD_HF_ICLASS_DUMP reply,  collecting the blocks the device streams meanwhile.
+// got[] marks the blocks which arrived.
+static int iclass_dump_wait(uint8_t *dump, size_t dumpsize, bool *got, PacketResponseNG *resp) {
+    while (true) {
+
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            DropField();
+            return PM3_EOPABORTED;
+        }
+
+        if (WaitForResponseTimeoutW(CMD_UNKNOWN, resp, 2000, false) == false) {
+            PrintAndLogEx(NORMAL, "." NOLF);
+            continue;
+        }
+
+        if (resp->cmd == CMD_HF_ICLASS_DUMP) {
+            PrintAndLogEx(NORMAL, "");
+            return PM3_SUCCESS;
+        }
+
+        if (resp->cmd != CMD_HF_ICLASS_DUMP_BLOCKS || resp->length < sizeof(iclass_dump_blocks_t)) {
+            continue;
+        }
+
+        const iclass_dump_blocks_t *blocks = (const iclass_dump_blocks_t *)resp->data.asBytes;
+        size_t offset = blocks->start_block * PICOPASS_BLOCK_SIZE;
+        size_t len = blocks->count * PICOPASS_BLOCK_SIZE;
+        if (resp->length < sizeof(iclass_dump_blocks_t) + len || offset + len > dumpsize) {
+            continue;
+        }
+
+        memcpy(dump + offset, blocks->data, len);
+        memset(got + blocks->start_block, true, blocks->count);
+        PrintAndLogEx(NORMAL, "." NOLF);
+    }
+}
+
+// True when all of the dumped blocks came in streamed,  no need to download BigBuf then.
+static bool iclass_dump_streamed(const bool *got, uint8_t keyblock, uint8_t start_block, uint16_t count) {
+    if (keyblock && got[keyblock] == false) {
+        return false;
+    }
+    for (uint16_t i = start_block; i < start_block + count; i++) {
+        if (got[i] == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static int CmdHFiClassDump(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass dump",
@@ -2022,23 +2133,17 @@ static int CmdHFiClassDump(const char *Cmd) {
         payload.start_block = 5;
     }
 
+    uint8_t tempbuf[0x100 * 8];
+    bool got[0x100] = {false};
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_ICLASS_DUMP, (uint8_t *)&payload, sizeof(payload));
 
-    while (true) {
-
-        PrintAndLogEx(NORMAL, "." NOLF);
-        if (kbd_enter_pressed()) {
-            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-            DropField();
-            return PM3_EOPABORTED;
-        }
-
-        if (WaitForResponseTimeout(CMD_HF_ICLASS_DUMP, &resp, 2000))
-            break;
+    int res = iclass_dump_wait(tempbuf, sizeof(tempbuf), got, &resp);
+    if (res != PM3_SUCCESS) {
+        return res;
     }
 
-    PrintAndLogEx(NORMAL, "");
     if (resp.status != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "failed to communicate with card");
         return resp.status;
@@ -2059,10 +2164,9 @@ static int CmdHFiClassDump(const char *Cmd) {
     uint32_t startindex = packet->bb_offset;
     uint32_t blocks_read = packet->block_cnt;
 
-    uint8_t tempbuf[0x100 * 8];
-
-    // response ok - now get bigbuf content of the dump
-    if (!GetFromDevice(BIG_BUF, tempbuf, sizeof(tempbuf), startindex, NULL, 0, NULL, 2500, false)) {
+    // response ok - get bigbuf content of the dump,  unless all of it came streamed
+    if (iclass_dump_streamed(got, payload.req.do_auth ? 3 : 0, payload.start_block, blocks_read) == false &&
+            GetFromDevice(BIG_BUF, tempbuf, sizeof(tempbuf), startindex, NULL, 0, NULL, 2500, false) == false) {
         PrintAndLogEx(WARNING, "command execution time out");
         return PM3_ETIMEOUT;
     }
@@ -2092,21 +2196,16 @@ static int CmdHFiClassDump(const char *Cmd) {
         payload.end_block = app_limit2;
         payload.req.do_auth = true;
 
+        memset(got, false, sizeof(got));
+
         clearCommandBuffer();
         SendCommandNG(CMD_HF_ICLASS_DUMP, (uint8_t *)&payload, sizeof(payload));
 
-        while (true) {
-            PrintAndLogEx(NORMAL, "." NOLF);
-            if (kbd_enter_pressed()) {
-                PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-                DropField();
-                return PM3_EOPABORTED;
-            }
-
-            if (WaitForResponseTimeout(CMD_HF_ICLASS_DUMP, &resp, 2000))
-                break;
+        res = iclass_dump_wait(tempbuf, sizeof(tempbuf), got, &resp);
+        if (res != PM3_SUCCESS) {
+            return res;
         }
-        PrintAndLogEx(NORMAL, "");
+
         if (resp.status != PM3_SUCCESS) {
             PrintAndLogEx(ERR, "failed to communicate with card");
             goto write_dump;
@@ -2126,8 +2225,9 @@ static int CmdHFiClassDump(const char *Cmd) {
             blocks_read = (sizeof(tag_data) - bytes_got) / 8;
         }
 
-        // get dumped data from bigbuf
-        if (!GetFromDevice(BIG_BUF, tempbuf, sizeof(tempbuf), startindex, NULL, 0, NULL, 2500, false)) {
+        // get dumped data from bigbuf,  unless all of it came streamed
+        if (iclass_dump_streamed(got, 4, payload.start_block, blocks_read) == false &&
+                GetFromDevice(BIG_BUF, tempbuf, sizeof(tempbuf), startindex, NULL, 0, NULL, 2500, false) == false) {
             PrintAndLogEx(WARNING, "command execution time out");
             goto write_dump;
         }
@@ -2472,6 +2572,7 @@ static int CmdHFiClassRestore(const char *Cmd) {
         arg_lit0(NULL, "raw", "no computations applied to key"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0(NULL, "shallow", "use shallow (ASK) reader modulation instead of OOK"),
+        arg_lit0(NULL, "fast", "keep the next block batch queued on the device while one is written"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -2522,6 +2623,7 @@ static int CmdHFiClassRestore(const char *Cmd) {
     bool rawkey = arg_get_lit(ctx, 8);
     bool verbose = arg_get_lit(ctx, 9);
     bool shallow_mod = arg_get_lit(ctx, 10);
+    bool fast = arg_get_lit(ctx, 11);
 
     CLIParserFree(ctx);
 
@@ -2535,10 +2637,8 @@ static int CmdHFiClassRestore(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    uint32_t payload_size = sizeof(iclass_restore_req_t) + (sizeof(iclass_restore_item_t) * (endblock - startblock + 1));
-
-    if (payload_size > PM3_CMD_DATA_SIZE) {
-        PrintAndLogEx(NORMAL, "Trying to write too many blocks at once.  Max: %d", PM3_CMD_DATA_SIZE / 8);
+    if (endblock < startblock || endblock > 0xFF) {
+        PrintAndLogEx(ERR, "block range ( " _RED_("%d..%d")" ) is invalid", startblock, endblock);
         return PM3_EINVARG;
     }
 
@@ -2564,7 +2664,63 @@ static int CmdHFiClassRestore(const char *Cmd) {
         return PM3_EFILE;
     }
 
-    iclass_restore_req_t *payload = calloc(1, payload_size);
+    uint16_t item_cnt = (endblock - startblock + 1);
+    iclass_restore_item_t *items = calloc(item_cnt, sizeof(iclass_restore_item_t));
+    if (items == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(dump);
+        return PM3_EMALLOC;
+    }
+
+    for (uint16_t i = 0; i < item_cnt; i++) {
+        items[i].blockno = startblock + i;
+        memcpy(items[i].data, dump + (startblock * 8) + (i * 8), sizeof(items[i].data));
+    }
+
+    free(dump);
+
+    // Compute all block MACs here once,  the device then only has to write.
+    // Without a CSN the device computes them itself.
+    uint8_t flags = ICLASS_RESTORE_QUIET;
+    uint8_t csn[8] = {0};
+    if (select_only(csn, NULL, false, shallow_mod)) {
+
+        uint8_t div_key[8] = {0};
+        if (rawkey) {
+            memcpy(div_key, key, 8);
+        } else {
+            HFiClassCalcDivKey(csn, key, div_key, elite);
+        }
+
+        for (uint16_t i = 0; i < item_cnt; i++) {
+            uint8_t wb[9] = {0};
+            wb[0] = items[i].blockno;
+            memcpy(wb + 1, items[i].data, 8);
+            doMAC_N(wb, sizeof(wb), div_key, items[i].mac);
+        }
+        flags |= ICLASS_RESTORE_HOST_MAC;
+    }
+
+    if (verbose) {
+        PrintAndLogEx(INFO, "Preparing to restore block range %02d..%02d", startblock, endblock);
+
+        PrintAndLogEx(INFO, "---------+----------------------+-------------");
+        PrintAndLogEx(INFO, " block#  | data                 | mac");
+        PrintAndLogEx(INFO, "---------+----------------------+-------------");
+
+        for (uint16_t i = 0; i < item_cnt; i++) {
+            iclass_restore_item_t *item = &items[i];
+            PrintAndLogEx(INFO, "%3d/0x%02X | %s | %s", item->blockno, item->blockno
+                          , sprint_hex_inrow(item->data, sizeof(item->data))
+                          , (flags & ICLASS_RESTORE_HOST_MAC) ? sprint_hex_inrow(item->mac, sizeof(item->mac)) : "device"
+                         );
+        }
+    }
+
+    PrintAndLogEx(INFO, "restore started...");
+
+    uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+    iclass_restore_req_t *payload = (iclass_restore_req_t *)buf;
     payload->req.use_raw = rawkey;
     payload->req.use_elite = elite;
     payload->req.use_credit_key = use_credit_key;
@@ -2573,57 +2729,86 @@ static int CmdHFiClassRestore(const char *Cmd) {
     payload->req.send_reply = true;
     payload->req.do_auth = true;
     payload->req.shallow_mod = shallow_mod;
+    payload->flags = flags;
     memcpy(payload->req.key, key, 8);
 
-    payload->item_cnt = (endblock - startblock + 1);
+    // Blocks go in batches of ICLASS_RESTORE_MAX_ITEMS.  With fast,  the next batch is already
+    // queued on the device while one is written and the results are checked as the replies come.
+    struct {
+        uint16_t first;
+        uint8_t count;
+    } queued[2];
+    uint8_t nqueued = 0;
+    uint8_t max_queued = (fast) ? 2 : 1;
+    uint16_t sent = 0;
+    uint16_t written = 0;
+    bool stop = false;
+    res = PM3_SUCCESS;
 
-    // read data from file from block 6 --- 19
-    // we will use this struct [data 8 bytes][MAC 4 bytes] for each block calculate all mac number for each data
-    // then copy to usbcommand->asbytes;
-    // max is 32 - 6 = 28 block.  28 x 12 bytes gives 336 bytes
+    clearCommandBuffer();
 
-    for (uint8_t i = 0; i < payload->item_cnt; i++) {
-        payload->blocks[i].blockno = startblock + i;
-        memcpy(payload->blocks[i].data, dump + (startblock * 8) + (i * 8), sizeof(payload->blocks[i].data));
-    }
+    while (true) {
 
-    free(dump);
+        while (stop == false && nqueued < max_queued && sent < item_cnt) {
+            uint8_t count = MIN(item_cnt - sent, ICLASS_RESTORE_MAX_ITEMS);
+            payload->item_cnt = count;
+            memcpy(payload->blocks, items + sent, count * sizeof(iclass_restore_item_t));
+            SendCommandNG(CMD_HF_ICLASS_RESTORE, buf, sizeof(iclass_restore_req_t) + (count * sizeof(iclass_restore_item_t)));
 
-    if (verbose) {
-        PrintAndLogEx(INFO, "Preparing to restore block range %02d..%02d", startblock, endblock);
+            queued[nqueued].first = sent;
+            queued[nqueued].count = count;
+            nqueued++;
+            sent += count;
+        }
 
-        PrintAndLogEx(INFO, "---------+----------------------");
-        PrintAndLogEx(INFO, " block#  | data");
-        PrintAndLogEx(INFO, "---------+----------------------");
+        if (nqueued == 0) {
+            break;
+        }
 
-        for (uint8_t i = 0; i < payload->item_cnt; i++) {
-            iclass_restore_item_t item = payload->blocks[i];
-            PrintAndLogEx(INFO, "%3d/0x%02X | %s", item.blockno, item.blockno, sprint_hex_inrow(item.data, sizeof(item.data)));
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_ICLASS_RESTORE, &resp, 2500 + (queued[0].count * 50)) == false) {
+            PrintAndLogEx(WARNING, "command execute timeout");
+            DropField();
+            res = PM3_ETIMEOUT;
+            break;
         }
-    }
 
-    PrintAndLogEx(INFO, "restore started...");
+        const iclass_restore_resp_t *r = (const iclass_restore_resp_t *)resp.data.asBytes;
+        bool have_results = (resp.length >= sizeof(iclass_restore_resp_t));
 
-    PacketResponseNG resp;
-    clearCommandBuffer();
-    SendCommandNG(CMD_HF_ICLASS_RESTORE, (uint8_t *)payload, payload_size);
+        for (uint8_t i = 0; i < queued[0].count; i++) {
+            const iclass_restore_item_t *item = &items[queued[0].first + i];
+            if (have_results && (r->ok[i >> 3] & (1 << (i & 7)))) {
+                PrintAndLogEx(SUCCESS, "Write block [%3d/0x%02X] " _GREEN_("successful"), item->blockno, item->blockno);
+                written++;
+            } else {
+                PrintAndLogEx(FAILED, "Write block [%3d/0x%02X] " _RED_("failed"), item->blockno, item->blockno);
+            }
+        }
 
-    if (WaitForResponseTimeout(CMD_HF_ICLASS_RESTORE, &resp, 2500) == 0) {
-        PrintAndLogEx(WARNING, "command execute timeout");
-        DropField();
-        free(payload);
-        return PM3_ETIMEOUT;
+        // without fast,  stop at the first batch which failed
+        if (resp.status != PM3_SUCCESS && fast == false) {
+            stop = true;
+        }
+
+        queued[0] = queued[1];
+        nqueued--;
     }
 
-    if (resp.status == PM3_SUCCESS) {
+    free(items);
+
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    if (written == item_cnt) {
         PrintAndLogEx(SUCCESS, "iCLASS restore " _GREEN_("successful"));
         PrintAndLogEx(HINT, "Try `" _YELLOW_("hf iclass rdbl") "` to verify data on card");
-    } else {
-        PrintAndLogEx(WARNING, "iCLASS restore " _RED_("failed"));
+        return PM3_SUCCESS;
     }
 
-    free(payload);
-    return resp.status;
+    PrintAndLogEx(WARNING, "iCLASS restore " _RED_("failed") ", %u of %u blocks written", written, item_cnt);
+    return PM3_ESOFT;
 }
 
 static int iclass_read_block(uint8_t *KEY, uint8_t blockno, uint8_t keyType, bool elite, bool rawkey, bool replay, bool verbose, bool auth, bool shallow_mod, uint8_t *out) {
@@ -2871,6 +3056,7 @@ static int CmdHFiClass_loclass(const char *Cmd) {
     if (test || longtest) {
         int errors = testCipherUtils();
         errors += testMAC();
+        errors += testMAC_bs();
         errors += doKeyTests();
         errors += testElite(longtest);
 
@@ -3242,20 +3428,25 @@ static int CmdHFiClassView(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// elite diversification from a hash2 key table and the card's hash1 index
+static void iclass_elite_div_key(uint8_t *CSN, const uint8_t *keytable, const uint8_t *key_index, uint8_t *div_key) {
+    uint8_t key_sel[8] = { 0 };
+    uint8_t key_sel_p[8] = { 0 };
+    for (uint8_t i = 0; i < 8 ; i++)
+        key_sel[i] = keytable[key_index[i]];
+
+    //Permute from iclass format to standard format
+    permutekey_rev(key_sel, key_sel_p);
+    diversifyKey(CSN, key_sel_p, div_key);
+}
+
 void HFiClassCalcDivKey(uint8_t *CSN, uint8_t *KEY, uint8_t *div_key, bool elite) {
     if (elite) {
         uint8_t keytable[128] = {0};
         uint8_t key_index[8] = {0};
-        uint8_t key_sel[8] = { 0 };
-        uint8_t key_sel_p[8] = { 0 };
         hash2(KEY, keytable);
         hash1(CSN, key_index);
-        for (uint8_t i = 0; i < 8 ; i++)
-            key_sel[i] = keytable[key_index[i]];
-
-        //Permute from iclass format to standard format
-        permutekey_rev(key_sel, key_sel_p);
-        diversifyKey(CSN, key_sel_p, div_key);
+        iclass_elite_div_key(CSN, keytable, key_index, div_key);
     } else {
         diversifyKey(CSN, KEY, div_key);
     }
@@ -3576,6 +3767,189 @@ static void add_key(uint8_t *key) {
     }
 }
 
+// Elite key tables,  hash2() of every dictionary key.  They don't depend on the card,
+// so they are cached per dictionary and only hash1 / diversification / MAC run per card
+#define ICLASS_ELITE_CACHE_MAGIC   "PM3ELITE"
+#define ICLASS_ELITE_CACHE_MIN     100      // smaller dictionaries hash faster than a file lookup
+#define ICLASS_ELITE_TABLE_SIZE    128
+
+typedef struct {
+    char magic[8];
+    uint32_t keycnt;
+    uint32_t table_size;
+} PACKED iclass_elite_cache_header_t;
+// followed by keycnt keys (8 bytes) and keycnt key tables (ICLASS_ELITE_TABLE_SIZE bytes)
+
+typedef struct {
+    const uint8_t *tables;
+    uint8_t *map;
+    size_t map_size;
+    uint8_t *buf;
+} iclass_elite_tables_t;
+
+#ifndef _WIN32
+static char *iclass_elite_cache_path(const uint8_t *keys, uint32_t keycnt) {
+    // FNV-1a over the dictionary,  the file itself still holds the keys for a full compare
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < (size_t)keycnt * 8; i++) {
+        h = (h ^ keys[i]) * 0x100000001b3ULL;
+    }
+
+    char fn[40];
+    snprintf(fn, sizeof(fn), "iclass_elite_%016" PRIx64 ".bin", h);
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, CACHE_SUBDIR, fn, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return path;
+}
+#endif
+
+// map the cached key tables,  false if there is none or it was made from another dictionary
+static bool iclass_elite_cache_map(iclass_elite_tables_t *t, const uint8_t *keys, uint32_t keycnt) {
+#ifdef _WIN32
+    return false;
+#else
+    char *path = iclass_elite_cache_path(keys, keycnt);
+    if (path == NULL) {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t size = sizeof(iclass_elite_cache_header_t) + ((size_t)keycnt * (8 + ICLASS_ELITE_TABLE_SIZE));
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+        close(fd);
+        return false;
+    }
+
+    uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const iclass_elite_cache_header_t *hdr = (const iclass_elite_cache_header_t *)map;
+    const uint8_t *cached_keys = map + sizeof(iclass_elite_cache_header_t);
+    if (memcmp(hdr->magic, ICLASS_ELITE_CACHE_MAGIC, sizeof(hdr->magic)) != 0
+            || hdr->keycnt != keycnt
+            || hdr->table_size != ICLASS_ELITE_TABLE_SIZE
+            || memcmp(cached_keys, keys, (size_t)keycnt * 8) != 0) {
+        munmap(map, size);
+        return false;
+    }
+
+    t->map = map;
+    t->map_size = size;
+    t->tables = cached_keys + ((size_t)keycnt * 8);
+    return true;
+#endif
+}
+
+// write the key tables to the cache,  through a temporary file so a concurrent client never maps half of it
+static void iclass_elite_cache_write(const uint8_t *keys, uint32_t keycnt, const uint8_t *tables) {
+#ifndef _WIN32
+    char *path = iclass_elite_cache_path(keys, keycnt);
+    if (path == NULL) {
+        return;
+    }
+
+    size_t tmplen = strlen(path) + 16;
+    char *tmp = calloc(tmplen, sizeof(char));
+    if (tmp == NULL) {
+        free(path);
+        return;
+    }
+    snprintf(tmp, tmplen, "%s.%d", path, (int)getpid());
+
+    iclass_elite_cache_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, ICLASS_ELITE_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.keycnt = keycnt;
+    hdr.table_size = ICLASS_ELITE_TABLE_SIZE;
+
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(DEBUG, "could not write iclass elite cache " _YELLOW_("%s"), tmp);
+        free(tmp);
+        free(path);
+        return;
+    }
+
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+    if (ok) {
+        ok = (fwrite(keys, 8, keycnt, f) == keycnt);
+    }
+    if (ok) {
+        ok = (fwrite(tables, ICLASS_ELITE_TABLE_SIZE, keycnt, f) == keycnt);
+    }
+
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+
+    if (ok && rename(tmp, path) == 0) {
+        PrintAndLogEx(DEBUG, "wrote iclass elite cache " _YELLOW_("%s"), path);
+    } else {
+        PrintAndLogEx(DEBUG, "could not write iclass elite cache " _YELLOW_("%s"), path);
+        remove(tmp);
+    }
+    free(tmp);
+    free(path);
+#else
+    (void)keys;
+    (void)keycnt;
+    (void)tables;
+#endif
+}
+
+// get the elite key tables for a dictionary,  from the cache when possible
+static bool iclass_elite_tables_get(iclass_elite_tables_t *t, const uint8_t *keys, uint32_t keycnt) {
+    memset(t, 0, sizeof(iclass_elite_tables_t));
+
+    bool use_cache = (keycnt >= ICLASS_ELITE_CACHE_MIN);
+    if (use_cache && iclass_elite_cache_map(t, keys, keycnt)) {
+        PrintAndLogEx(DEBUG, "using cached iclass elite key tables");
+        return true;
+    }
+
+    t->buf = calloc(keycnt, ICLASS_ELITE_TABLE_SIZE);
+    if (t->buf == NULL) {
+        return false;
+    }
+
+    // hash2 shares a DES context,  keep this single threaded
+    uint8_t key[8];
+    for (uint32_t i = 0; i < keycnt; i++) {
+        memcpy(key, keys + (8 * i), sizeof(key));
+        hash2(key, t->buf + ((size_t)i * ICLASS_ELITE_TABLE_SIZE));
+    }
+    t->tables = t->buf;
+
+    if (use_cache) {
+        iclass_elite_cache_write(keys, keycnt, t->tables);
+    }
+    return true;
+}
+
+static void iclass_elite_tables_free(iclass_elite_tables_t *t) {
+#ifndef _WIN32
+    if (t->map) {
+        munmap(t->map, t->map_size);
+    }
+#endif
+    free(t->buf);
+    memset(t, 0, sizeof(iclass_elite_tables_t));
+}
+
+static void generate_mac_chunk(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, const uint8_t *elite_tables, iclass_premac_t *list);
+
 static int CmdHFiClassCheckKeys(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass chk",
@@ -3661,7 +4035,10 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
     if (use_raw)
         PrintAndLogEx(NORMAL, "using " _YELLOW_("raw mode"));
 
-    GenerateMacFrom(CSN, CCNR, use_raw, use_elite, keyBlock, keycount, pre);
+    // the card independent elite stage for the whole dictionary,  the MACs follow per chunk
+    iclass_elite_tables_t elite = {0};
+    if (use_elite && use_raw == false)
+        iclass_elite_tables_get(&elite, keyBlock, keycount);
 
     PrintAndLogEx(SUCCESS, "Searching for " _YELLOW_("%s") " key...", (use_credit_key) ? "CREDIT" : "DEBIT");
 
@@ -3676,50 +4053,70 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
     g_conn.block_after_ACK = true;
 
     // keep track of position of found key
-    uint32_t chunk_offset = 0;
-    uint8_t found_offset = 0;
+    uint32_t found_idx = 0;
     bool found_key = false;
+    bool aborted = false;
 
     // We have
     //  - a list of keys.
-    //  - a list of precalculated macs that corresponds to the key list
-    // We send a chunk of macs to the device each time
+    //  - a list of macs,  generated chunk by chunk
+    // Up to two chunks are outstanding.  While the device tests chunk N,  the macs of
+    // chunk N+1 are generated and uploaded,  so it is waiting on the device when N ends
+    // and the RF loop never waits for the host.  A hit in chunk N still lets the device
+    // run chunk N+1,  its reply is drained before leaving.
+    uint32_t chunk_offset = 0;
+    uint32_t queued[2] = {0, 0};
+    uint8_t nqueued = 0;
+
+    clearCommandBuffer();
 
     // main keychunk loop
-    for (chunk_offset = 0; chunk_offset < keycount; chunk_offset += max_chunk_size) {
+    while (true) {
 
-        if (kbd_enter_pressed()) {
+        if (aborted == false && found_key == false && kbd_enter_pressed()) {
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(WARNING, "aborted via keyboard!");
-            goto out;
+            aborted = true;
         }
 
-        uint32_t curr_chunk_cnt = keycount - chunk_offset;
-        if ((keycount - chunk_offset)  > max_chunk_size) {
-            curr_chunk_cnt = max_chunk_size;
-        }
+        while (aborted == false && found_key == false && nqueued < ARRAYLEN(queued) && chunk_offset < keycount) {
 
-        // last chunk?
-        if (curr_chunk_cnt == keycount - chunk_offset) {
-            // Disable fast mode on last command
-            g_conn.block_after_ACK = false;
-        }
+            uint32_t curr_chunk_cnt = keycount - chunk_offset;
+            if ((keycount - chunk_offset)  > max_chunk_size) {
+                curr_chunk_cnt = max_chunk_size;
+            }
 
-        uint32_t tmp_plen = sizeof(iclass_chk_t) + (4 * curr_chunk_cnt);
-        iclass_chk_t *packet = calloc(tmp_plen,  sizeof(uint8_t));
-        if (packet == NULL) {
-            PrintAndLogEx(WARNING, "failed to allocate memory");
-            break;
+            // last chunk?
+            if (curr_chunk_cnt == keycount - chunk_offset) {
+                // Disable fast mode on last command
+                g_conn.block_after_ACK = false;
+            }
+
+            const uint8_t *tables = (elite.tables) ? elite.tables + ((size_t)chunk_offset * ICLASS_ELITE_TABLE_SIZE) : NULL;
+            generate_mac_chunk(CSN, CCNR, use_raw, use_elite, keyBlock + (chunk_offset * 8), curr_chunk_cnt, tables, pre + chunk_offset);
+
+            uint32_t tmp_plen = sizeof(iclass_chk_t) + (4 * curr_chunk_cnt);
+            iclass_chk_t *packet = calloc(tmp_plen,  sizeof(uint8_t));
+            if (packet == NULL) {
+                PrintAndLogEx(WARNING, "failed to allocate memory");
+                aborted = true;
+                break;
+            }
+            packet->use_credit_key = use_credit_key;
+            packet->count = curr_chunk_cnt;
+            packet->shallow_mod = shallow_mod;
+            // copy chunk of pre calculated macs to packet
+            memcpy(packet->items, (pre + chunk_offset), (4 * curr_chunk_cnt));
+
+            SendCommandNG(CMD_HF_ICLASS_CHKKEYS, (uint8_t *)packet, tmp_plen);
+            free(packet);
+
+            queued[nqueued++] = chunk_offset;
+            chunk_offset += curr_chunk_cnt;
         }
-        packet->use_credit_key = use_credit_key;
-        packet->count = curr_chunk_cnt;
-        packet->shallow_mod = shallow_mod;
-        // copy chunk of pre calculated macs to packet
-        memcpy(packet->items, (pre + chunk_offset), (4 * curr_chunk_cnt));
 
-        clearCommandBuffer();
-        SendCommandNG(CMD_HF_ICLASS_CHKKEYS, (uint8_t *)packet, tmp_plen);
-        free(packet);
+        if (nqueued == 0)
+            break;
 
         bool looped = false;
         uint8_t timeout = 0;
@@ -3738,33 +4135,44 @@ static int CmdHFiClassCheckKeys(const char *Cmd) {
         if (looped)
             PrintAndLogEx(NORMAL, "");
 
+        uint32_t resp_offset = queued[0];
+        queued[0] = queued[1];
+        nqueued--;
+
+        // only draining the chunk queued behind a hit / abort
+        if (found_key || aborted)
+            continue;
+
         if (resp.status == PM3_SUCCESS) {
-            found_offset = resp.data.asBytes[0];
+            found_idx = resp_offset + resp.data.asBytes[0];
             found_key = true;
             PrintAndLogEx(NORMAL, "");
             PrintAndLogEx(SUCCESS,
                           "Found valid key " _GREEN_("%s")
-                          , sprint_hex(keyBlock + (chunk_offset + found_offset) * 8, 8)
+                          , sprint_hex(keyBlock + found_idx * 8, 8)
                          );
-            break;
         } else {
-            PrintAndLogEx(INPLACE, "Chunk [%03d/%d]", chunk_offset, keycount);
+            PrintAndLogEx(INPLACE, "Chunk [%03d/%d]", resp_offset, keycount);
             fflush(stdout);
         }
     }
 
 out:
     t1 = msclock() - t1;
+    pm3_metrics_keys_checked("iclass", (found_key) ? found_idx + 1 : chunk_offset, t1);
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(SUCCESS, "time in iclass chk " _YELLOW_("%.1f") " seconds", (float)t1 / 1000.0);
     DropField();
 
+    g_conn.block_after_ACK = false;
+
     if (found_key) {
-        uint8_t *key = keyBlock + (chunk_offset + found_offset) * 8;
+        uint8_t *key = keyBlock + found_idx * 8;
         add_key(key);
     }
 
+    iclass_elite_tables_free(&elite);
     free(pre);
     free(keyBlock);
     PrintAndLogEx(NORMAL, "");
@@ -3774,22 +4182,286 @@ out:
 
 // this method tries to identify in which configuration mode a iCLASS / iCLASS SE reader is in.
 // Standard or Elite / HighSecurity mode.  It uses a default key dictionary list in order to work.
+// Key generator for hf iclass lookup.  Every worker runs its own slice of the
+// generator,  split up front,  and only takes the lock to report.  DES ignores bit 0 of every key byte,  so a standard key has 256
+// equivalents: ranges walk the 56 DES bits only,  charsets drop letters that only differ
+// in bit 0,  everything else is reduced to one key per class before its MAC is computed.
+// Elite keys go through hash2 with all 64 bits and raw keys are the MAC key,  no pruning.
+#define ICLASS_BF_BATCH         (ICLASS_BS_SLICES * 8)
+#define ICLASS_BF_MAX_HITS      16
+#define ICLASS_DES_PARITY_MASK  0x0101010101010101ULL
+
+typedef struct {
+    pthread_mutex_t lock;
+    generator_context_t gen;
+    bool compact;               // generator runs over the 56 DES key bits
+    bool prune;                 // standard keys,  one key per parity class
+    bool use_raw;
+    bool use_elite;
+    bool error;
+    bool abort;
+    uint32_t parts;             // one generator slice per worker task
+    uint64_t total;
+    uint8_t csn[8];
+    uint8_t cc_nr[12];
+    uint8_t mac[4];
+    uint8_t key_index[8];
+    uint64_t generated;
+    uint64_t tested;
+    uint32_t hits;
+    uint8_t hit_keys[ICLASS_BF_MAX_HITS * 8];
+} iclass_bf_t;
+
+// 56 DES key bits to a key with all parity bits cleared,  and back
+static uint64_t iclass_des_expand(uint64_t v) {
+    uint64_t key = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        key |= ((v >> (7 * i)) & 0x7F) << (8 * i + 1);
+    }
+    return key;
+}
+
+static uint64_t iclass_des_compact(uint64_t key) {
+    uint64_t v = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        v |= ((key >> (8 * i + 1)) & 0x7F) << (7 * i);
+    }
+    return v;
+}
+
+static int cmp_uint64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// charset bytes that only differ in a parity bit are the same DES key byte
+static void iclass_bf_prune_charset(generator_context_t *gen) {
+    uint8_t len = 0;
+    for (uint8_t i = 0; i < gen->charset_length; i++) {
+        uint8_t c = gen->charset[i] & 0xFE;
+        if (memchr(gen->charset, c, len) == NULL) {
+            gen->charset[len++] = c;
+        }
+    }
+    gen->charset_length = len;
+}
+
+static uint32_t iclass_bf_next(iclass_bf_t *bf, generator_context_t *gen, uint64_t *keys, uint32_t max) {
+
+    pthread_mutex_lock(&bf->lock);
+    bool abort = bf->abort;
+    pthread_mutex_unlock(&bf->lock);
+    if (abort) {
+        return 0;
+    }
+
+    uint32_t n = 0;
+    int res = BF_GENERATOR_NEXT;
+    while (n < max) {
+        res = bf_generate(gen);
+        if (res != BF_GENERATOR_NEXT) {
+            break;
+        }
+        uint64_t key = bf_get_key64(gen);
+        keys[n++] = (bf->compact) ? iclass_des_expand(key) : key;
+    }
+
+    pthread_mutex_lock(&bf->lock);
+    bf->generated += n;
+    if (res == BF_GENERATOR_ERROR) {
+        bf->error = true;
+    }
+    pthread_mutex_unlock(&bf->lock);
+    return n;
+}
+
+static void iclass_bf_worker(threadpool_job_t *job, void *arg, uint32_t index) {
+    iclass_bf_t *bf = (iclass_bf_t *)arg;
+
+    generator_context_t gen;
+    if (bf_generator_split(&bf->gen, bf->parts, index, &gen) != BF_GENERATOR_NEXT) {
+        pthread_mutex_lock(&bf->lock);
+        bf->error = true;
+        pthread_mutex_unlock(&bf->lock);
+        return;
+    }
+
+    uint64_t keys[ICLASS_BF_BATCH];
+    uint8_t div_keys[ICLASS_BS_SLICES * 8];
+    uint8_t macs[ICLASS_BS_SLICES * 4];
+    uint8_t keytable[ICLASS_ELITE_TABLE_SIZE];
+    uint8_t key[8];
+
+    uint32_t n;
+    while ((n = iclass_bf_next(bf, &gen, keys, ICLASS_BF_BATCH)) > 0) {
+
+        if (bf->prune) {
+            for (uint32_t i = 0; i < n; i++) {
+                keys[i] &= ~ICLASS_DES_PARITY_MASK;
+            }
+            qsort(keys, n, sizeof(uint64_t), cmp_uint64);
+            uint32_t u = 1;
+            for (uint32_t i = 1; i < n; i++) {
+                if (keys[i] != keys[u - 1]) {
+                    keys[u++] = keys[i];
+                }
+            }
+            n = u;
+        }
+
+        for (uint32_t start = 0; start < n; start += ICLASS_BS_SLICES) {
+
+            uint32_t cnt = MIN(n - start, ICLASS_BS_SLICES);
+            for (uint32_t i = 0; i < cnt; i++) {
+                uint8_t *div_key = div_keys + (8 * i);
+                num_to_bytes(keys[start + i], 8, key);
+
+                if (bf->use_raw) {
+                    memcpy(div_key, key, 8);
+                } else if (bf->use_elite) {
+                    hash2(key, keytable);
+                    iclass_elite_div_key(bf->csn, keytable, bf->key_index, div_key);
+                } else {
+                    diversifyKey(bf->csn, key, div_key);
+                }
+            }
+
+            doMAC_bs(bf->cc_nr, div_keys, cnt, macs);
+
+            for (uint32_t i = 0; i < cnt; i++) {
+                if (memcmp(macs + (4 * i), bf->mac, 4)) {
+                    continue;
+                }
+                pthread_mutex_lock(&bf->lock);
+                if (bf->hits < ICLASS_BF_MAX_HITS) {
+                    num_to_bytes(keys[start + i], 8, bf->hit_keys + (8 * bf->hits));
+                }
+                bf->hits++;
+                pthread_mutex_unlock(&bf->lock);
+            }
+        }
+
+        pthread_mutex_lock(&bf->lock);
+        bf->tested += n;
+        pthread_mutex_unlock(&bf->lock);
+        threadpool_add_done(job, n);
+    }
+}
+
+static bool iclass_bf_progress(threadpool_job_t *job, void *arg, uint64_t done) {
+    (void)job;
+    (void)done;
+    iclass_bf_t *bf = (iclass_bf_t *)arg;
+    if (kbd_enter_pressed()) {
+        pthread_mutex_lock(&bf->lock);
+        bf->abort = true;
+        pthread_mutex_unlock(&bf->lock);
+    }
+    if (bf->total) {
+        pthread_mutex_lock(&bf->lock);
+        uint64_t generated = bf->generated;
+        pthread_mutex_unlock(&bf->lock);
+        print_progress(generated, bf->total, STYLE_BAR);
+    }
+    return true;
+}
+
+// run the generator on the client thread pool,  total is 0 when the key count isn't known up front
+static int iclass_lookup_generate(iclass_bf_t *bf, uint64_t total) {
+
+    hash1(bf->csn, bf->key_index);
+
+    uint32_t tc = threadpool_size();
+    bf->parts = tc;
+    bf->total = total;
+
+    PrintAndLogEx(INFO, "Generating keys using " _YELLOW_("%u") " threads, press " _GREEN_("<Enter>") " to abort", tc);
+    if (total) {
+        PrintAndLogEx(INFO, "Key space... " _YELLOW_("%" PRIu64) "%s", total, (bf->prune) ? " DES keys" : "");
+    }
+
+    uint64_t t1 = msclock();
+    // every slice runs dry or gets aborted,  the workers stop on their own
+    if (threadpool_wait(threadpool_submit(iclass_bf_worker, bf, tc), iclass_bf_progress, bf, 250) == PM3_EMALLOC) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    t1 = msclock() - t1;
+
+    if (total && bf->abort == false) {
+        print_progress(total, total, STYLE_BAR);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (bf->error) {
+        PrintAndLogEx(ERR, "Internal bruteforce generator error");
+        return PM3_ESOFT;
+    }
+
+    uint64_t skipped = bf->generated - bf->tested;
+    PrintAndLogEx(SUCCESS, "Tested " _YELLOW_("%" PRIu64) " keys in " _YELLOW_("%.1f") " seconds ( %.0f keys/s )"
+                  , bf->tested
+                  , (float)t1 / 1000.0
+                  , (t1) ? (double)bf->tested * 1000.0 / t1 : 0.0
+                 );
+    if (skipped) {
+        PrintAndLogEx(INFO, "Pruned " _YELLOW_("%" PRIu64) " equivalent keys", skipped);
+    }
+
+    if (bf->abort) {
+        PrintAndLogEx(WARNING, "aborted via keyboard!");
+    }
+
+    if (bf->hits == 0) {
+        PrintAndLogEx(FAILED, "No matching key found");
+        return (bf->abort) ? PM3_EOPABORTED : PM3_ESOFT;
+    }
+
+    for (uint32_t i = 0; i < MIN(bf->hits, ICLASS_BF_MAX_HITS); i++) {
+        PrintAndLogEx(SUCCESS, "Found valid key " _GREEN_("%s"), sprint_hex(bf->hit_keys + (8 * i), 8));
+    }
+    if (bf->hits > ICLASS_BF_MAX_HITS) {
+        PrintAndLogEx(INFO, "... and %u more", bf->hits - ICLASS_BF_MAX_HITS);
+    }
+
+    if (bf->prune) {
+        PrintAndLogEx(HINT, "Keys which only differ in bit 0 of a byte are the same DES key");
+    }
+
+    // one MAC pair has 32 bits,  larger key spaces give false matches
+    if (bf->tested > 0xFFFFFFFFULL || bf->hits > 1) {
+        PrintAndLogEx(HINT, "One MAC can't tell all keys apart,  verify with a second trace");
+    }
+
+    add_key(bf->hit_keys);
+    return PM3_SUCCESS;
+}
+
 static int CmdHFiClassLookUp(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf iclass lookup",
                   "This command take sniffed trace data and try to recovery a iCLASS Standard or iCLASS Elite key.",
                   "hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f iclass_default_keys.dic\n"
-                  "hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f iclass_default_keys.dic --elite"
+                  "hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f iclass_default_keys.dic --elite\n"
+                  "hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b --elite --mode smart\n"
+                  "hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b --elite --mode charset --digits\n"
+                  "hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b --mode range --begin 0000000000000000 --end 00000000ffffffff"
                  );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_str1("f", "file", "<fn>", "Dictionary file with default iclass keys"),
+        arg_str0("f", "file", "<fn>", "Dictionary file with default iclass keys"),
         arg_str1(NULL, "csn", "<hex>", "Specify CSN as 8 hex bytes"),
         arg_str1(NULL, "epurse", "<hex>", "Specify ePurse as 8 hex bytes"),
         arg_str1(NULL, "macs", "<hex>", "MACs"),
         arg_lit0(NULL, "elite", "Elite computations applied to key"),
         arg_lit0(NULL, "raw", "no computations applied to key"),
+        arg_str0(NULL, "mode", "<str>", "Generate keys instead of a dictionary (range|charset|smart)"),
+        arg_str0(NULL, "begin", "<hex>", "Range mode - first key, 8 hex bytes"),
+        arg_str0(NULL, "end", "<hex>", "Range mode - last key, 8 hex bytes"),
+        arg_lit0(NULL, "digits", "Charset mode - include ASCII codes for digits"),
+        arg_lit0(NULL, "uppercase", "Charset mode - include ASCII codes for uppercase letters"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -3837,8 +4509,53 @@ static int CmdHFiClassLookUp(const char *Cmd) {
     bool use_elite = arg_get_lit(ctx, 5);
     bool use_raw = arg_get_lit(ctx, 6);
 
+    int mode_len = 0;
+    char mode[16] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 7), (uint8_t *)mode, sizeof(mode) - 1, &mode_len);
+
+    int begin_len = 0;
+    uint8_t begin[8] = {0};
+    CLIGetHexWithReturn(ctx, 8, begin, &begin_len);
+
+    int end_len = 0;
+    uint8_t end[8] = {0};
+    CLIGetHexWithReturn(ctx, 9, end, &end_len);
+
+    bool use_digits = arg_get_lit(ctx, 10);
+    bool use_uppercase = arg_get_lit(ctx, 11);
+
     CLIParserFree(ctx);
 
+    if ((fnlen > 0) == (mode_len > 0)) {
+        PrintAndLogEx(ERR, "Use either a dictionary file or a generator mode");
+        return PM3_EINVARG;
+    }
+
+    uint8_t bf_mode = 0;
+    if (mode_len) {
+        if (strcmp(mode, "range") == 0) {
+            bf_mode = BF_MODE_RANGE;
+        } else if (strcmp(mode, "charset") == 0) {
+            bf_mode = BF_MODE_CHARSET;
+        } else if (strcmp(mode, "smart") == 0) {
+            bf_mode = BF_MODE_SMART;
+        } else {
+            PrintAndLogEx(FAILED, "Unknown bruteforce mode: %s", mode);
+            return PM3_EINVARG;
+        }
+    }
+
+    if (bf_mode == BF_MODE_RANGE && (begin_len != 8 || end_len != 8)) {
+        PrintAndLogEx(FAILED, "Range mode needs 8 byte 'begin' and 'end' keys");
+        return PM3_EINVARG;
+    }
+
+    if (bf_mode == BF_MODE_CHARSET && use_digits == false && use_uppercase == false) {
+        PrintAndLogEx(FAILED, "Please enable at least one charset when using charset bruteforce mode.");
+        return PM3_EINVARG;
+    }
+
+    int res = PM3_SUCCESS;
     uint8_t CCNR[12];
     uint8_t MAC_TAG[4] = { 0, 0, 0, 0 };
 
@@ -3853,6 +4570,56 @@ static int CmdHFiClassLookUp(const char *Cmd) {
     PrintAndLogEx(SUCCESS, "   CCNR: " _GREEN_("%s"), sprint_hex(CCNR, sizeof(CCNR)));
     PrintAndLogEx(SUCCESS, "TAG MAC: %s", sprint_hex(MAC_TAG, sizeof(MAC_TAG)));
 
+    if (bf_mode) {
+        if (use_elite)
+            PrintAndLogEx(INFO, "Using " _YELLOW_("elite algo"));
+        if (use_raw)
+            PrintAndLogEx(INFO, "Using " _YELLOW_("raw mode"));
+
+        iclass_bf_t *bf = calloc(1, sizeof(iclass_bf_t));
+        if (bf == NULL) {
+            return PM3_EMALLOC;
+        }
+        pthread_mutex_init(&bf->lock, NULL);
+        bf->use_raw = use_raw;
+        bf->use_elite = use_elite;
+        bf->prune = (use_raw == false && use_elite == false);
+        memcpy(bf->csn, csn, sizeof(bf->csn));
+        memcpy(bf->cc_nr, CCNR, sizeof(bf->cc_nr));
+        memcpy(bf->mac, MAC_TAG, sizeof(bf->mac));
+
+        bf_generator_init(&bf->gen, bf_mode, BF_KEY_SIZE_64);
+
+        if (bf_mode == BF_MODE_RANGE) {
+            uint64_t lo = bytes_to_num(begin, 8);
+            uint64_t hi = bytes_to_num(end, 8);
+            if (lo > hi) {
+                uint64_t t = lo;
+                lo = hi;
+                hi = t;
+            }
+            // standard keys,  walk the DES bits only
+            bf->compact = bf->prune;
+            if (bf->compact) {
+                lo = iclass_des_compact(lo);
+                hi = iclass_des_compact(hi);
+            }
+            bf->gen.range_low = lo;
+            bf->gen.range_high = hi;
+        } else if (bf_mode == BF_MODE_CHARSET) {
+            bf_generator_set_charset(&bf->gen, (use_digits ? BF_CHARSET_DIGITS : 0) | (use_uppercase ? BF_CHARSET_UPPERCASE : 0));
+            if (bf->prune) {
+                iclass_bf_prune_charset(&bf->gen);
+            }
+        }
+
+        res = iclass_lookup_generate(bf, bf_generator_count(&bf->gen));
+        pthread_mutex_destroy(&bf->lock);
+        free(bf);
+        PrintAndLogEx(NORMAL, "");
+        return res;
+    }
+
     // run time
     uint64_t t1 = msclock();
 
@@ -3860,7 +4627,7 @@ static int CmdHFiClassLookUp(const char *Cmd) {
     uint32_t keycount = 0;
 
     // load keys
-    int res = loadFileDICTIONARY_safe(filename, (void **)&keyBlock, 8, &keycount);
+    res = loadFileDICTIONARY_safe(filename, (void **)&keyBlock, 8, &keycount);
     if (res != PM3_SUCCESS || keycount == 0) {
         free(keyBlock);
         return res;
@@ -3909,156 +4676,149 @@ static int CmdHFiClassLookUp(const char *Cmd) {
 }
 
 typedef struct {
-    uint8_t thread_idx;
     uint8_t use_raw;
     uint8_t use_elite;
     uint32_t keycnt;
     uint8_t csn[8];
     uint8_t cc_nr[12];
+    uint8_t key_index[8];
     uint8_t *keys;
+    const uint8_t *elite_tables;
     union {
         iclass_premac_t *premac;
         iclass_prekey_t *prekey;
     } list;
 } PACKED iclass_thread_arg_t;
 
-static size_t iclass_tc = 1;
-
 static pthread_mutex_t generator_mutex = PTHREAD_MUTEX_INITIALIZER;
-static void *bf_generate_mac(void *thread_arg) {
 
-    iclass_thread_arg_t *targ = (iclass_thread_arg_t *)thread_arg;
-    const uint8_t idx = targ->thread_idx;
-    const uint8_t use_raw = targ->use_raw;
-    const uint8_t use_elite = targ->use_elite;
-    const uint32_t keycnt = targ->keycnt;
+// diversified keys of keys[start .. start + cnt - 1]
+static void bf_generate_div_keys(iclass_thread_arg_t *targ, uint32_t start, uint32_t cnt, uint8_t *div_keys) {
+    for (uint32_t i = start; i < start + cnt; i++) {
 
-    uint8_t *keys = targ->keys;
-    iclass_premac_t *list = targ->list.premac;
-
-    uint8_t csn[8];
-    uint8_t cc_nr[12];
-    memcpy(csn, targ->csn, sizeof(csn));
-    memcpy(cc_nr, targ->cc_nr, sizeof(cc_nr));
+        uint8_t *key = targ->keys + 8 * i;
+        uint8_t *div_key = div_keys + 8 * (i - start);
 
-    uint8_t key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-    uint8_t div_key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
-
-    for (uint32_t i = idx; i < keycnt; i += iclass_tc) {
-
-        memcpy(key, keys + 8 * i, 8);
+        // precomputed key tables need no hash2,  the rest is thread safe
+        if (targ->elite_tables) {
+            iclass_elite_div_key(targ->csn, targ->elite_tables + ((size_t)i * ICLASS_ELITE_TABLE_SIZE), targ->key_index, div_key);
+            continue;
+        }
 
-        pthread_mutex_lock(&generator_mutex);
-        if (use_raw)
+        if (targ->use_raw) {
             memcpy(div_key, key, 8);
-        else
-            HFiClassCalcDivKey(csn, key, div_key, use_elite);
+            continue;
+        }
 
-        doMAC(cc_nr, div_key, list[i].mac);
+        pthread_mutex_lock(&generator_mutex);
+        HFiClassCalcDivKey(targ->csn, key, div_key, targ->use_elite);
         pthread_mutex_unlock(&generator_mutex);
     }
-    return NULL;
 }
 
-// precalc diversified keys and their MAC
-void GenerateMacFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_premac_t *list) {
+// each index is a batch of ICLASS_BS_SLICES keys,  the MACs of a batch are computed in one bitsliced pass
+static void bf_generate_mac(threadpool_job_t *job, void *arg, uint64_t first, uint64_t last) {
+    (void)job;
+    iclass_thread_arg_t *targ = (iclass_thread_arg_t *)arg;
+    iclass_premac_t *list = targ->list.premac;
 
-    pthread_mutex_init(&generator_mutex, NULL);
+    uint8_t div_keys[ICLASS_BS_SLICES * 8];
 
-    iclass_tc = num_CPUs();
-    pthread_t threads[iclass_tc];
-    iclass_thread_arg_t args[iclass_tc];
-    // init thread arguments
-    for (size_t i = 0; i < iclass_tc; i++) {
-        args[i].thread_idx = i;
-        args[i].use_raw = use_raw;
-        args[i].use_elite = use_elite;
-        args[i].keycnt = keycnt;
-        args[i].keys = keys;
-        args[i].list.premac = list;
+    for (uint64_t batch = first; batch < last; batch++) {
 
-        memcpy(args[i].csn, CSN, sizeof(args[i].csn));
-        memcpy(args[i].cc_nr, CCNR, sizeof(args[i].cc_nr));
-    }
+        uint32_t start = batch * ICLASS_BS_SLICES;
+        uint32_t cnt = MIN(targ->keycnt - start, ICLASS_BS_SLICES);
+        bf_generate_div_keys(targ, start, cnt, div_keys);
 
-    for (int i = 0; i < iclass_tc; i++) {
-        int res = pthread_create(&threads[i], NULL, bf_generate_mac, (void *)&args[i]);
-        if (res) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
-            return;
-        }
+        // iclass_premac_t is just the packed MAC
+        doMAC_bs(targ->cc_nr, div_keys, cnt, (uint8_t *)(list + start));
     }
-
-    for (int i = 0; i < iclass_tc; i++)
-        pthread_join(threads[i], NULL);
 }
 
-static void *bf_generate_mackey(void *thread_arg) {
+static void bf_generate_mackey(threadpool_job_t *job, void *arg, uint64_t first, uint64_t last) {
+    (void)job;
+    iclass_thread_arg_t *targ = (iclass_thread_arg_t *)arg;
+    iclass_prekey_t *list = targ->list.prekey;
 
-    iclass_thread_arg_t *targ = (iclass_thread_arg_t *)thread_arg;
-    const uint8_t idx = targ->thread_idx;
-    const uint8_t use_raw = targ->use_raw;
-    const uint8_t use_elite = targ->use_elite;
-    const uint32_t keycnt = targ->keycnt;
+    uint8_t div_keys[ICLASS_BS_SLICES * 8];
+    uint8_t macs[ICLASS_BS_SLICES * 4];
 
-    uint8_t *keys = targ->keys;
-    iclass_prekey_t *list = targ->list.prekey;
+    for (uint64_t batch = first; batch < last; batch++) {
 
-    uint8_t csn[8];
-    uint8_t cc_nr[12];
-    memcpy(csn, targ->csn, sizeof(csn));
-    memcpy(cc_nr, targ->cc_nr, sizeof(cc_nr));
+        uint32_t start = batch * ICLASS_BS_SLICES;
+        uint32_t cnt = MIN(targ->keycnt - start, ICLASS_BS_SLICES);
+        bf_generate_div_keys(targ, start, cnt, div_keys);
+        doMAC_bs(targ->cc_nr, div_keys, cnt, macs);
 
-    uint8_t div_key[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+        for (uint32_t i = 0; i < cnt; i++) {
+            memcpy(list[start + i].key, targ->keys + 8 * (start + i), 8);
+            memcpy(list[start + i].mac, macs + 4 * i, 4);
+        }
+    }
+}
 
-    for (uint32_t i = idx; i < keycnt; i += iclass_tc) {
+// batches of keys handed out per take,  small enough to balance the hash2 fallback
+#define ICLASS_GEN_CHUNK    4
+
+static void generate_mac_init(iclass_thread_arg_t *targ, uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, const uint8_t *elite_tables) {
+    memset(targ, 0, sizeof(*targ));
+    targ->use_raw = use_raw;
+    targ->use_elite = use_elite;
+    targ->keycnt = keycnt;
+    targ->keys = keys;
+    targ->elite_tables = elite_tables;
+    memcpy(targ->csn, CSN, sizeof(targ->csn));
+    memcpy(targ->cc_nr, CCNR, sizeof(targ->cc_nr));
+    if (elite_tables) {
+        hash1(targ->csn, targ->key_index);
+    }
+}
 
-        memcpy(list[i].key, keys + 8 * i, 8);
+// diversified keys and MACs of one run of keys,  elite_tables (hash2 of these keys) is optional
+static void generate_mac_chunk(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, const uint8_t *elite_tables, iclass_premac_t *list) {
 
-        pthread_mutex_lock(&generator_mutex);
-        if (use_raw)
-            memcpy(div_key, list[i].key, 8);
-        else
-            HFiClassCalcDivKey(csn, list[i].key, div_key, use_elite);
+    iclass_thread_arg_t targ;
+    generate_mac_init(&targ, CSN, CCNR, use_raw, use_elite, keys, keycnt, elite_tables);
+    targ.list.premac = list;
 
-        doMAC(cc_nr, div_key, list[i].mac);
-        pthread_mutex_unlock(&generator_mutex);
+    uint32_t batches = (keycnt + ICLASS_BS_SLICES - 1) / ICLASS_BS_SLICES;
+    if (threadpool_for(batches, ICLASS_GEN_CHUNK, bf_generate_mac, &targ, NULL, NULL, 0) != PM3_SUCCESS) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
     }
-    return NULL;
+}
+
+// precalc diversified keys and their MAC
+void GenerateMacFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_premac_t *list) {
+
+    iclass_elite_tables_t elite = {0};
+    // without tables (no memory) the threads fall back to the locked hash2 path
+    if (use_elite && use_raw == false)
+        iclass_elite_tables_get(&elite, keys, keycnt);
+
+    generate_mac_chunk(CSN, CCNR, use_raw, use_elite, keys, keycnt, elite.tables, list);
+
+    iclass_elite_tables_free(&elite);
 }
 
 void GenerateMacKeyFrom(uint8_t *CSN, uint8_t *CCNR, bool use_raw, bool use_elite, uint8_t *keys, uint32_t keycnt, iclass_prekey_t *list) {
 
-    pthread_mutex_init(&generator_mutex, NULL);
-    iclass_tc = num_CPUs();
-    pthread_t threads[iclass_tc];
-    iclass_thread_arg_t args[iclass_tc];
-    // init thread arguments
-    for (size_t i = 0; i < iclass_tc; i++) {
-        args[i].thread_idx = i;
-        args[i].use_raw = use_raw;
-        args[i].use_elite = use_elite;
-        args[i].keycnt = keycnt;
-        args[i].keys = keys;
-        args[i].list.prekey = list;
-
-        memcpy(args[i].csn, CSN, sizeof(args[i].csn));
-        memcpy(args[i].cc_nr, CCNR, sizeof(args[i].cc_nr));
-    }
-
-    for (size_t i = 0; i < iclass_tc; i++) {
-        int res = pthread_create(&threads[i], NULL, bf_generate_mackey, (void *)&args[i]);
-        if (res) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
-            return;
-        }
-    }
+    iclass_elite_tables_t elite = {0};
+    // without tables (no memory) the threads fall back to the locked hash2 path
+    if (use_elite && use_raw == false)
+        iclass_elite_tables_get(&elite, keys, keycnt);
 
-    for (int i = 0; i < iclass_tc; i++)
-        pthread_join(threads[i], NULL);
+    iclass_thread_arg_t targ;
+    generate_mac_init(&targ, CSN, CCNR, use_raw, use_elite, keys, keycnt, elite.tables);
+    targ.list.prekey = list;
+
+    uint32_t batches = (keycnt + ICLASS_BS_SLICES - 1) / ICLASS_BS_SLICES;
+    if (threadpool_for(batches, ICLASS_GEN_CHUNK, bf_generate_mackey, &targ, NULL, NULL, 0) != PM3_SUCCESS) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+    }
 
+    iclass_elite_tables_free(&elite);
 }
 
 // print diversified keys
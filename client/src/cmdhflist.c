@@ -21,6 +21,7 @@
 #include <inttypes.h>
 #include <string.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include "commonutil.h"  // ARRAYLEN
 #include "mifare/mifarehost.h"
@@ -30,6 +31,7 @@
 #include "crapto1/crapto1.h"
 #include "protocols.h"
 #include "cmdhficlass.h"
+#include "util.h"           // num_CPUs
 
 enum MifareAuthSeq {
     masNone,
@@ -52,6 +54,39 @@ void ClearAuthData(void) {
     AuthData.ks3 = 0;
 }
 
+// keys recovered so far in this trace, tried first on the next nested auth of the same card
+#define MF_KEY_CACHE_SIZE   64
+
+typedef struct {
+    uint32_t uid;
+    uint64_t key;
+} mf_cached_key_t;
+
+static mf_cached_key_t mfKeyCache[MF_KEY_CACHE_SIZE];
+static size_t mfKeyCacheCnt = 0;
+static size_t mfKeyCacheNext = 0;
+
+void ClearAuthKeyCache(void) {
+    mfKeyCacheCnt = 0;
+    mfKeyCacheNext = 0;
+}
+
+static void key_cache_add(uint32_t uid, uint64_t key) {
+    for (size_t i = 0; i < mfKeyCacheCnt; i++) {
+        if (mfKeyCache[i].uid == uid && mfKeyCache[i].key == key) {
+            return;
+        }
+    }
+
+    // full, the oldest one goes
+    mfKeyCache[mfKeyCacheNext].uid = uid;
+    mfKeyCache[mfKeyCacheNext].key = key;
+    mfKeyCacheNext = (mfKeyCacheNext + 1) % MF_KEY_CACHE_SIZE;
+    if (mfKeyCacheCnt < MF_KEY_CACHE_SIZE) {
+        mfKeyCacheCnt++;
+    }
+}
+
 
 static int gs_ntag_i2c_state = 0;
 static int gs_mfuc_state = 0;
@@ -2148,6 +2183,7 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
             AuthData.ks3 = AuthData.at_enc ^ prng_successor(AuthData.nt, 96);
 
             mfLastKey = GetCrypto1ProbableKey(&AuthData);
+            key_cache_add(AuthData.uid, mfLastKey);
             PrintAndLogEx(NORMAL, "            |            |  *  |%49s " _GREEN_("%012" PRIX64) " prng %s |     |",
                           "key",
                           mfLastKey,
@@ -2170,16 +2206,27 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
                 };
             }
 
+            // check keys already found for this card
+            for (size_t i = 0; !traceCrypto1 && i < mfKeyCacheCnt; i++) {
+                if (mfKeyCache[i].uid != AuthData.uid || mfKeyCache[i].key == mfLastKey)
+                    continue;
+
+                if (NestedCheckKey(mfKeyCache[i].key, &AuthData, cmd, cmdsize, parity)) {
+                    PrintAndLogEx(NORMAL, "            |            |  *  |%60s " _GREEN_("%012" PRIX64) "|     |", "cached key", mfKeyCache[i].key);
+                    mfLastKey = mfKeyCache[i].key;
+                    traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
+                }
+            }
+
             // check default keys
             if (!traceCrypto1 && dicKeys != NULL && dicKeysCount > 0) {
-                for (int i = 0; i < dicKeysCount; i++) {
-                    if (NestedCheckKey(dicKeys[i], &AuthData, cmd, cmdsize, parity)) {
-                        PrintAndLogEx(NORMAL, "            |            |  *  |%60s " _GREEN_("%012" PRIX64) "|     |", "key", dicKeys[i]);
+                uint32_t i = DictCheckKeys(dicKeys, dicKeysCount, &AuthData, cmd, cmdsize, parity);
+                if (i < dicKeysCount && NestedCheckKey(dicKeys[i], &AuthData, cmd, cmdsize, parity)) {
+                    PrintAndLogEx(NORMAL, "            |            |  *  |%60s " _GREEN_("%012" PRIX64) "|     |", "key", dicKeys[i]);
 
-                        mfLastKey = dicKeys[i];
-                        traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
-                        break;
-                    };
+                    mfLastKey = dicKeys[i];
+                    key_cache_add(AuthData.uid, mfLastKey);
+                    traceCrypto1 = lfsr_recovery64(AuthData.ks2, AuthData.ks3);
                 }
             }
 
@@ -2202,6 +2249,7 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
                             AuthData.ks3 = ks3;
                             AuthData.nt = ntx;
                             mfLastKey = GetCrypto1ProbableKey(&AuthData);
+                            key_cache_add(AuthData.uid, mfLastKey);
                             PrintAndLogEx(NORMAL, "            |            |  *  | nested probable key: " _GREEN_("%012" PRIX64) "     ks2:%08x ks3:%08x |     |",
                                           mfLastKey,
                                           AuthData.ks2,
@@ -2277,7 +2325,7 @@ bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isRes
     return *mfDataLen > 0;
 }
 
-bool NTParityChk(AuthData_t *ad, uint32_t ntx) {
+bool NTParityChk(const AuthData_t *ad, uint32_t ntx) {
     if (
         (oddparity8(ntx >> 8 & 0xff) ^ (ntx & 0x01) ^ ((ad->nt_enc_par >> 5) & 0x01) ^ (ad->nt_enc & 0x01)) ||
         (oddparity8(ntx >> 16 & 0xff) ^ (ntx >> 8 & 0x01) ^ ((ad->nt_enc_par >> 6) & 0x01) ^ (ad->nt_enc >> 8 & 0x01)) ||
@@ -2305,31 +2353,32 @@ bool NTParityChk(AuthData_t *ad, uint32_t ntx) {
     return true;
 }
 
-bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+// key test without side effects, safe to run from several threads
+static bool nested_check_key(uint64_t key, const AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize, const uint8_t *parity, uint32_t *nt) {
     uint8_t buf[32] = {0};
-    struct Crypto1State *pcs;
+    struct Crypto1State pcs;
 
-    AuthData.ks2 = 0;
-    AuthData.ks3 = 0;
+    crypto1_init(&pcs, key);
+    uint32_t nt1 = crypto1_word(&pcs, ad->nt_enc ^ ad->uid, 1) ^ ad->nt_enc;
+
+    // the nt, ar and at parity bits only depend on nt1,  this drops almost every wrong key
+    // before the reader and tag words are clocked
+    if (!NTParityChk(ad, nt1))
+        return false;
 
-    pcs = crypto1_create(key);
-    uint32_t nt1 = crypto1_word(pcs, ad->nt_enc ^ ad->uid, 1) ^ ad->nt_enc;
     uint32_t ar = prng_successor(nt1, 64);
     uint32_t at = prng_successor(nt1, 96);
 
-    crypto1_word(pcs, ad->nr_enc, 1);
-//   uint32_t nr1 = crypto1_word(pcs, ad->nr_enc, 1) ^ ad->nr_enc;  // if needs deciphered nr
-    uint32_t ar1 = crypto1_word(pcs, 0, 0) ^ ad->ar_enc;
-    uint32_t at1 = crypto1_word(pcs, 0, 0) ^ ad->at_enc;
+    crypto1_word(&pcs, ad->nr_enc, 1);
+//   uint32_t nr1 = crypto1_word(&pcs, ad->nr_enc, 1) ^ ad->nr_enc;  // if needs deciphered nr
+    uint32_t ar1 = crypto1_word(&pcs, 0, 0) ^ ad->ar_enc;
+    uint32_t at1 = crypto1_word(&pcs, 0, 0) ^ ad->at_enc;
 
-    if (!(ar == ar1 && at == at1 && NTParityChk(ad, nt1))) {
-        crypto1_destroy(pcs);
+    if (!(ar == ar1 && at == at1))
         return false;
-    }
 
     memcpy(buf, cmd, cmdsize);
-    mf_crypto1_decrypt(pcs, buf, cmdsize, 0);
-    crypto1_destroy(pcs);
+    mf_crypto1_decrypt(&pcs, buf, cmdsize, 0);
 
     if (!CheckCrypto1Parity(cmd, cmdsize, buf, parity))
         return false;
@@ -2337,12 +2386,93 @@ bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize,
     if (!check_crc(CRC_14443_A, buf, cmdsize))
         return false;
 
+    *nt = nt1;
+    return true;
+}
+
+bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity) {
+    AuthData.ks2 = 0;
+    AuthData.ks3 = 0;
+
+    uint32_t nt1 = 0;
+    if (!nested_check_key(key, ad, cmd, cmdsize, parity, &nt1))
+        return false;
+
     AuthData.nt = nt1;
-    AuthData.ks2 = AuthData.ar_enc ^ ar;
-    AuthData.ks3 = AuthData.at_enc ^ at;
+    AuthData.ks2 = AuthData.ar_enc ^ prng_successor(nt1, 64);
+    AuthData.ks3 = AuthData.at_enc ^ prng_successor(nt1, 96);
     return true;
 }
 
+// dictionary test on a pool of num_CPUs() threads, small dictionaries aren't worth the threads
+#define DICT_CHUNK          256
+#define DICT_PARALLEL_MIN   (4 * DICT_CHUNK)
+
+typedef struct {
+    const uint64_t *keys;
+    uint32_t count;
+    uint32_t next;
+    uint32_t found;
+    const AuthData_t *ad;
+    const uint8_t *cmd;
+    uint8_t cmdsize;
+    const uint8_t *parity;
+} dict_check_t;
+
+static void *dict_check_worker(void *arg) {
+    dict_check_t *d = (dict_check_t *)arg;
+
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&d->next, DICT_CHUNK, __ATOMIC_RELAXED);
+        if (i >= d->count || i >= __atomic_load_n(&d->found, __ATOMIC_RELAXED))
+            break;
+
+        uint32_t end = MIN(d->count, i + DICT_CHUNK);
+        for (; i < end; i++) {
+            uint32_t nt = 0;
+            if (!nested_check_key(d->keys[i], d->ad, d->cmd, d->cmdsize, d->parity, &nt))
+                continue;
+
+            // keep the lowest index, the result doesn't depend on thread timing
+            uint32_t found = __atomic_load_n(&d->found, __ATOMIC_RELAXED);
+            while (i < found && !__atomic_compare_exchange_n(&d->found, &found, i, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+uint32_t DictCheckKeys(const uint64_t *keys, uint32_t count, const AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize, const uint8_t *parity) {
+    dict_check_t d = {
+        .keys = keys,
+        .count = count,
+        .next = 0,
+        .found = count,
+        .ad = ad,
+        .cmd = cmd,
+        .cmdsize = cmdsize,
+        .parity = parity,
+    };
+
+    size_t tc = (count < DICT_PARALLEL_MIN) ? 1 : num_CPUs();
+    pthread_t threads[tc];
+    size_t started = 0;
+    for (; tc > 1 && started < tc; started++) {
+        if (pthread_create(&threads[started], NULL, dict_check_worker, &d))
+            break;
+    }
+
+    // no threads, or a small dictionary, do it here
+    if (started == 0)
+        dict_check_worker(&d);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    return d.found;
+}
+
 bool CheckCrypto1Parity(const uint8_t *cmd_enc, uint8_t cmdsize, uint8_t *cmd, const uint8_t *parity_enc) {
     for (int i = 0; i < cmdsize - 1; i++) {
         if (oddparity8(cmd[i]) ^ (cmd[i + 1] & 0x01) ^ ((parity_enc[i / 8] >> (7 - i % 8)) & 0x01) ^ (cmd_enc[i + 1] & 0x01))
@@ -37,6 +37,7 @@ typedef struct {
 } AuthData_t;
 
 void ClearAuthData(void);
+void ClearAuthKeyCache(void);
 
 uint8_t iso14443A_CRC_check(bool isResponse, uint8_t *d, uint8_t n);
 uint8_t iso14443B_CRC_check(uint8_t *d, uint8_t n);
@@ -69,8 +70,10 @@ void annotateCryptoRF(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize);
 void annotateSeos(char *exp, size_t size, uint8_t *cmd, uint8_t cmdsize);
 
 bool DecodeMifareData(uint8_t *cmd, uint8_t cmdsize, uint8_t *parity, bool isResponse, uint8_t *mfData, size_t *mfDataLen, const uint64_t *dicKeys, uint32_t dicKeysCount);
-bool NTParityChk(AuthData_t *ad, uint32_t ntx);
+bool NTParityChk(const AuthData_t *ad, uint32_t ntx);
 bool NestedCheckKey(uint64_t key, AuthData_t *ad, uint8_t *cmd, uint8_t cmdsize, uint8_t *parity);
+// index of the first dictionary key that decrypts the auth, count if none
+uint32_t DictCheckKeys(const uint64_t *keys, uint32_t count, const AuthData_t *ad, const uint8_t *cmd, uint8_t cmdsize, const uint8_t *parity);
 bool CheckCrypto1Parity(const uint8_t *cmd_enc, uint8_t cmdsize, uint8_t *cmd, const uint8_t *parity_enc);
 uint64_t GetCrypto1ProbableKey(AuthData_t *ad);
 
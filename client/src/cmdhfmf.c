@@ -24,10 +24,13 @@
 #include "commonutil.h"            // ARRAYLEN
 #include "comms.h"                 // clearCommandBuffer
 #include "fileutils.h"
+#include "dumpstore.h"           // dumps by uid
 #include "cmdtrace.h"
 #include "mifare/mifaredefault.h"  // mifare default key array
 #include "cliparser.h"             // argtable
 #include "hardnested_bf_core.h"    // SetSIMDInstr
+#include "hardnested_bruteforce.h" // brute_force_use_gpu
+#include "hardnested_opencl.h"
 #include "mifare/mad.h"
 #include "nfc/ndef.h"
 #include "protocols.h"
@@ -43,7 +46,15 @@
 #include "proxendian.h"
 #include "preferences.h"
 #include "mifare/gen4.h"
+#include "mifare/mfkeystats.h"      // key hit statistics
+#include "cmdflashmem.h"             // flash memory dictionary index
+#include "checkpoint.h"              // resume long running attacks
+#include "hardnestedserver.h"        // hf mf hardserve
+#include "hardnesteddist.h"          // hf mf hardworker
 #include "generator.h"              // keygens.
+#include "pm3_result.h"
+#include "scriptpipe.h"              // pipelined wrbl
+#include "threadpool.h"              // hf mf sim --stream
 
 static int CmdHelp(const char *Cmd);
 
@@ -615,14 +626,115 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
         return PM3_ESOFT;
     }
 
+    uint8_t rights[40][4] = {0};
+    bool rights_ok[40] = {0};
+
+    // whole card in one request,  only blocks it couldn't read go through the block by block path below
+    uint16_t read_ok[40] = {0};
+    PrintAndLogEx(INFO, "Dumping all sectors from card...");
+    int res = mfReadCard(numSectors, keyA, keyB, carddata, read_ok);
+    PrintAndLogEx(NORMAL, "");
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(DEBUG, "whole card read failed ( %d ),  reading block by block", res);
+        memset(read_ok, 0, sizeof(read_ok));
+    }
+
+    bool complete = true;
+    for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+        uint8_t blocks = mfNumBlocksPerSector(sectorNo);
+        uint8_t trailer = blocks - 1;
+        if ((read_ok[sectorNo] & (1 << trailer)) == 0) {
+            complete = false;
+            continue;
+        }
+
+        uint8_t *data = carddata + (MFBLOCK_SIZE * (mfFirstBlockOfSector(sectorNo) + trailer));
+        rights[sectorNo][0] = ((data[7] & 0x10) >> 2) | ((data[8] & 0x1) << 1) | ((data[8] & 0x10) >> 4); // C1C2C3 for data area 0
+        rights[sectorNo][1] = ((data[7] & 0x20) >> 3) | ((data[8] & 0x2) << 0) | ((data[8] & 0x20) >> 5); // C1C2C3 for data area 1
+        rights[sectorNo][2] = ((data[7] & 0x40) >> 4) | ((data[8] & 0x4) >> 1) | ((data[8] & 0x40) >> 6); // C1C2C3 for data area 2
+        rights[sectorNo][3] = ((data[7] & 0x80) >> 5) | ((data[8] & 0x8) >> 2) | ((data[8] & 0x80) >> 7); // C1C2C3 for sector trailer
+        rights_ok[sectorNo] = true;
+
+        // sector trailer. Fill in the keys.
+        memcpy(data, keyA + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        memcpy(data + 10, keyB + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+
+        // blocks the access rights deny to every key won't ever be read
+        for (uint8_t blockNo = 0; blockNo < trailer; blockNo++) {
+            uint8_t data_area = (sectorNo < 32) ? blockNo : blockNo / 5;
+            if ((read_ok[sectorNo] & (1 << blockNo)) == 0 && rights[sectorNo][data_area] != 0x07) {
+                complete = false;
+            }
+        }
+    }
+
+    if (complete) {
+        free(fptr);
+        free(keyA);
+        free(keyB);
+        PrintAndLogEx(SUCCESS, "Succeeded in dumping all blocks");
+        return PM3_SUCCESS;
+    }
+
     PrintAndLogEx(INFO, "Reading sector access bits...");
     PrintAndLogEx(INFO, "." NOLF);
 
-    uint8_t rights[40][4] = {0};
-
     mf_readblock_t payload;
+
+    // first pass, keep several sector trailer reads with key A in flight.
+    // sectors which fails here gets the usual retry loop below.
+    // trailers the whole card read got aren't asked for again.
+    uint8_t todo[40] = {0};
+    uint8_t todo_cnt = 0;
+    for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+        if (rights_ok[sectorNo] == false) {
+            todo[todo_cnt++] = sectorNo;
+        }
+    }
+
+    uint32_t seqs[40] = {0};
+    uint8_t sent = 0, collected = 0;
+    clearCommandQueue();
+    while (collected < todo_cnt) {
+
+        while (sent < todo_cnt && GetCommandQueueCount() < CMD_QUEUE_SIZE) {
+            uint8_t sectorNo = todo[sent];
+            payload.blockno = mfFirstBlockOfSector(sectorNo) + mfNumBlocksPerSector(sectorNo) - 1;
+            payload.keytype = MF_KEY_A;
+            memcpy(payload.key, keyA + (sectorNo * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+            if (SendCommandNGQueued(CMD_HF_MIFARE_READBL, (uint8_t *)&payload, sizeof(mf_readblock_t), CMD_HF_MIFARE_READBL, &seqs[sent]) != PM3_SUCCESS) {
+                break;
+            }
+            sent++;
+        }
+
+        if (WaitForQueuedResponse(seqs[collected], &resp, 1500) == false) {
+            // out of sync, let the slow path handle the rest
+            clearCommandQueue();
+            break;
+        }
+
+        if (resp.status == PM3_SUCCESS) {
+            uint8_t sectorNo = todo[collected];
+            uint8_t *data = resp.data.asBytes;
+            rights[sectorNo][0] = ((data[7] & 0x10) >> 2) | ((data[8] & 0x1) << 1) | ((data[8] & 0x10) >> 4); // C1C2C3 for data area 0
+            rights[sectorNo][1] = ((data[7] & 0x20) >> 3) | ((data[8] & 0x2) << 0) | ((data[8] & 0x20) >> 5); // C1C2C3 for data area 1
+            rights[sectorNo][2] = ((data[7] & 0x40) >> 4) | ((data[8] & 0x4) >> 1) | ((data[8] & 0x40) >> 6); // C1C2C3 for data area 2
+            rights[sectorNo][3] = ((data[7] & 0x80) >> 5) | ((data[8] & 0x8) >> 2) | ((data[8] & 0x80) >> 7); // C1C2C3 for sector trailer
+            rights_ok[sectorNo] = true;
+            PrintAndLogEx(NORMAL, "." NOLF);
+            fflush(stdout);
+        }
+        collected++;
+    }
+
     uint8_t current_key;
     for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
+
+        if (rights_ok[sectorNo]) {
+            continue;
+        }
+
         current_key = MF_KEY_A;
         for (uint8_t tries = 0; tries < MIFARE_SECTOR_RETRY; tries++) {
             PrintAndLogEx(NORMAL, "." NOLF);
@@ -676,6 +788,10 @@ static int mfc_read_tag(iso14a_card_select_t *card, uint8_t *carddata, uint8_t n
 
     for (uint8_t sectorNo = 0; sectorNo < numSectors; sectorNo++) {
         for (uint8_t blockNo = 0; blockNo < mfNumBlocksPerSector(sectorNo); blockNo++) {
+            if (read_ok[sectorNo] & (1 << blockNo)) {
+                continue;
+            }
+
             bool received = false;
             current_key = MF_KEY_A;
             uint8_t data_area = (sectorNo < 32) ? blockNo : blockNo / 5;
@@ -833,6 +949,86 @@ static int mf_load_keys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey
     return PM3_SUCCESS;
 }
 
+// try the keys with most recorded hits first,  user supplied keys stay in front
+static void mf_order_keys(const mfc_keystats_t *stats, uint8_t *keyBlock, uint32_t keycnt, int userkeylen, int sector) {
+    uint32_t skip = userkeylen / MIFARE_KEY_SIZE;
+    if (skip >= keycnt) {
+        return;
+    }
+
+    uint32_t n = mfc_keystats_order(stats, keyBlock + (skip * MIFARE_KEY_SIZE), keycnt - skip, sector);
+    if (n && sector < 0) {
+        PrintAndLogEx(SUCCESS, "trying " _GREEN_("%u") " keys with recorded hits first", n);
+    }
+}
+
+// checkpoint state of a key recovery,  "Keys": [ { "Sector": 0, "KeyA": "FFFFFFFFFFFF", "KeyB": ... }, ... ]
+static int mf_checkpoint_save_keys(const char *name, const char *command, const sector_t *e_sector, uint8_t sectorcnt) {
+    json_t *state = json_object();
+    json_t *keys = json_array();
+    for (uint8_t i = 0; i < sectorcnt; i++) {
+        if (e_sector[i].foundKey[MF_KEY_A] == 0 && e_sector[i].foundKey[MF_KEY_B] == 0) {
+            continue;
+        }
+
+        json_t *e = json_object();
+        json_object_set_new(e, "Sector", json_integer(i));
+        for (uint8_t j = MF_KEY_A; j <= MF_KEY_B; j++) {
+            if (e_sector[i].foundKey[j]) {
+                char hex[(MIFARE_KEY_SIZE * 2) + 1];
+                snprintf(hex, sizeof(hex), "%012" PRIX64, e_sector[i].Key[j]);
+                json_object_set_new(e, (j == MF_KEY_A) ? "KeyA" : "KeyB", json_string(hex));
+            }
+        }
+        json_array_append_new(keys, e);
+    }
+    json_object_set_new(state, "Sectors", json_integer(sectorcnt));
+    json_object_set_new(state, "Keys", keys);
+
+    int res = checkpoint_save(name, command, state);
+    json_decref(state);
+    return res;
+}
+
+// keys of a checkpoint go in front of the key list,  they are verified by the dictionary attack
+static int mf_checkpoint_load_keys(const char *name, const char *command, uint8_t **pkeyBlock, uint32_t *pkeycnt) {
+    json_t *state = checkpoint_load(name, command);
+    if (state == NULL) {
+        return PM3_ENODATA;
+    }
+
+    json_t *keys = json_object_get(state, "Keys");
+    size_t n = json_array_size(keys);
+
+    uint8_t *p = realloc(*pkeyBlock, (*pkeycnt + (n * 2)) * MIFARE_KEY_SIZE);
+    if (p == NULL) {
+        json_decref(state);
+        return PM3_EMALLOC;
+    }
+    *pkeyBlock = p;
+    memmove(p + (n * 2 * MIFARE_KEY_SIZE), p, *pkeycnt * MIFARE_KEY_SIZE);
+
+    uint32_t cnt = 0;
+    for (size_t i = 0; i < n; i++) {
+        json_t *e = json_array_get(keys, i);
+        for (uint8_t j = MF_KEY_A; j <= MF_KEY_B; j++) {
+            const char *hex = json_string_value(json_object_get(e, (j == MF_KEY_A) ? "KeyA" : "KeyB"));
+            int len = 0;
+            if (hex && param_gethex_to_eol(hex, 0, p + (cnt * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE, &len) == 0 && len == MIFARE_KEY_SIZE) {
+                cnt++;
+            }
+        }
+    }
+
+    // close the gap of missing keys
+    memmove(p + (cnt * MIFARE_KEY_SIZE), p + (n * 2 * MIFARE_KEY_SIZE), *pkeycnt * MIFARE_KEY_SIZE);
+    *pkeycnt += cnt;
+
+    PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%u") " keys from checkpoint", cnt);
+    json_decref(state);
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14AMfAcl(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf acl",
@@ -931,6 +1127,14 @@ static int CmdHF14AMfDarkside(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int mf_wrbl_check(const PacketResponseNG *resp) {
+    int status = resp->oldarg[0];
+    if (status > 0) {
+        return PM3_SUCCESS;
+    }
+    return (status == PM3_ETEAROFF) ? PM3_ETEAROFF : PM3_ESOFT;
+}
+
 static int CmdHF14AMfWrBl(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1017,6 +1221,12 @@ static int CmdHF14AMfWrBl(const char *Cmd) {
     uint8_t data[26];
     memcpy(data, key, sizeof(key));
     memcpy(data + 10, block, sizeof(block));
+
+    // pipelined script,  the outcome is checked later
+    if (scriptpipe_active()) {
+        return scriptpipe_queue_mix(CMD_HF_MIFARE_WRITEBL, blockno, keytype, 0, data, sizeof(data), CMD_ACK, mf_wrbl_check);
+    }
+
     clearCommandBuffer();
     SendCommandMIX(CMD_HF_MIFARE_WRITEBL, blockno, keytype, 0, data, sizeof(data));
 
@@ -1311,6 +1521,14 @@ static int CmdHF14AMfDump(const char *Cmd) {
         mf_analyse_acl(block_cnt, mem);
     }
 
+    if (pm3_result_collecting()) {
+        pm3_result_set_hex("uid", card.uid, card.uidlen);
+        pm3_result_set_int("blocks", block_cnt);
+        for (uint16_t i = 0; i < block_cnt; i++) {
+            pm3_result_append("data", pm3_result_hex(mem + (i * MFBLOCK_SIZE), MFBLOCK_SIZE));
+        }
+    }
+
     // Skip saving card data to file
     if (nosave) {
         PrintAndLogEx(INFO, "Called with no save option");
@@ -1331,6 +1549,7 @@ static int CmdHF14AMfDump(const char *Cmd) {
     }
 
     pm3_save_mf_dump(dataFilename, mem, bytes, jsfCardMemory);
+    pm3_result_set_str("filename", dataFilename);
     free(mem);
     return PM3_SUCCESS;
 }
@@ -1347,6 +1566,7 @@ static int CmdHF14AMfRestore(const char *Cmd) {
                   "\n"
                   "`--uid` param is used for filename templates `hf-mf-<uid>-dump.bin` and `hf-mf-<uid>-key.bin.\n"
                   "          if not specified, it will read the card uid instead.\n"
+                  "          without `-f`,  a dump of this uid in the dump store is used before the template.\n"
                   " `--ka` param you can indicate that the key file should be used for authentication instead.\n"
                   "          if so we also try both B/A keys\n"
                   "`--force` param is used to override warnings and allow bad ACL block writes.\n"
@@ -1417,6 +1637,12 @@ static int CmdHF14AMfRestore(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    // a stored dump of the uid comes before the file template
+    bool from_store = false;
+    if (uidlen && datafnlen == 0 && dumpstore_has(uid)) {
+        from_store = true;
+    }
+
     // if user specified UID,  use it in file templates
     if (uidlen) {
 
@@ -1425,7 +1651,7 @@ static int CmdHF14AMfRestore(const char *Cmd) {
             keyfnlen = strlen(keyfilename);
         }
 
-        if (datafnlen == 0) {
+        if (datafnlen == 0 && from_store == false) {
             snprintf(datafilename, FILE_PATH_SIZE, "hf-mf-%s-dump.bin", uid);
             datafnlen = strlen(datafilename);
         }
@@ -1451,7 +1677,7 @@ static int CmdHF14AMfRestore(const char *Cmd) {
     PrintAndLogEx(INFO, "Using key file `" _YELLOW_("%s") "`", keyfilename);
 
     // try reading card uid and create filename
-    if (datafnlen == 0) {
+    if (datafnlen == 0 && from_store == false) {
         char *fptr = GenerateFilename("hf-mf-", "-dump.bin");
         if (fptr == NULL) {
             if (keyA) {
@@ -1469,7 +1695,12 @@ static int CmdHF14AMfRestore(const char *Cmd) {
     // read dump file
     uint8_t *dump = NULL;
     size_t bytes_read = 0;
-    int res = pm3_load_dump(datafilename, (void **)&dump, &bytes_read, (MFBLOCK_SIZE * MIFARE_4K_MAXBLOCK));
+    int res;
+    if (from_store) {
+        res = dumpstore_get(uid, &dump, &bytes_read);
+    } else {
+        res = pm3_load_dump(datafilename, (void **)&dump, &bytes_read, (MFBLOCK_SIZE * MIFARE_4K_MAXBLOCK));
+    }
     if (res != PM3_SUCCESS) {
         free(keyA);
         free(keyB);
@@ -1929,6 +2160,37 @@ jumptoend:
     return PM3_SUCCESS;
 }
 
+// keys found so far come first,  cards tend to reuse them across sectors.  Then the dictionary
+static uint32_t mf_static_candidates(const sector_t *e_sector, uint8_t sectorcnt, const uint8_t *dict, uint32_t dictcnt, uint8_t *out) {
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < sectorcnt; i++) {
+        for (uint8_t j = MF_KEY_A; j <= MF_KEY_B; j++) {
+            if (e_sector[i].foundKey[j] == 0) {
+                continue;
+            }
+
+            uint8_t k[MIFARE_KEY_SIZE];
+            num_to_bytes(e_sector[i].Key[j], MIFARE_KEY_SIZE, k);
+
+            bool dup = false;
+            for (uint32_t m = 0; m < n && dup == false; m++) {
+                dup = (memcmp(out + (m * MIFARE_KEY_SIZE), k, MIFARE_KEY_SIZE) == 0);
+            }
+
+            if (dup == false) {
+                memcpy(out + (n * MIFARE_KEY_SIZE), k, MIFARE_KEY_SIZE);
+                n++;
+            }
+        }
+    }
+
+    if (dictcnt) {
+        memcpy(out + (n * MIFARE_KEY_SIZE), dict, dictcnt * MIFARE_KEY_SIZE);
+        n += dictcnt;
+    }
+    return n;
+}
+
 static int CmdHF14AMfNestedStatic(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf staticnested",
@@ -1937,7 +2199,8 @@ static int CmdHF14AMfNestedStatic(const char *Cmd) {
                   "hf mf staticnested --mini --blk 0 -a -k FFFFFFFFFFFF\n"
                   "hf mf staticnested --1k --blk 0 -a -k FFFFFFFFFFFF\n"
                   "hf mf staticnested --2k --blk 0 -a -k FFFFFFFFFFFF\n"
-                  "hf mf staticnested --4k --blk 0 -a -k FFFFFFFFFFFF\n");
+                  "hf mf staticnested --4k --blk 0 -a -k FFFFFFFFFFFF\n"
+                  "hf mf staticnested --1k --blk 0 -a -k FFFFFFFFFFFF -f mfc_default_keys\n");
 
     void *argtable[] = {
         arg_param_begin,
@@ -1951,6 +2214,7 @@ static int CmdHF14AMfNestedStatic(const char *Cmd) {
         arg_lit0("b", NULL, "Input key specified is keyB"),
         arg_lit0("e", "emukeys", "Fill simulator keys from found keys"),
         arg_lit0(NULL, "dumpkeys", "Dump found keys to file"),
+        arg_str0("f", "file", "<fn>", "Dictionary file, keys are tested on device against the static nonce"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -1978,6 +2242,10 @@ static int CmdHF14AMfNestedStatic(const char *Cmd) {
 
     bool transferToEml = arg_get_lit(ctx, 9);
     bool createDumpFile = arg_get_lit(ctx, 10);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 11), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     //validations
@@ -2029,11 +2297,32 @@ static int CmdHF14AMfNestedStatic(const char *Cmd) {
         PrintAndLogEx(INFO, "RDV4 with flashmemory supported detected.");
     }
 
+    uint8_t *dict = NULL;
+    uint32_t dictcnt = 0;
+    if (fnlen > 0) {
+        int res = loadFileDICTIONARY_safe(filename, (void **) &dict, MIFARE_KEY_SIZE, &dictcnt);
+        if (res != PM3_SUCCESS || dictcnt == 0) {
+            PrintAndLogEx(FAILED, "An error occurred while loading the dictionary!");
+            free(dict);
+            return PM3_EFILE;
+        }
+    }
+
+    // found keys and the dictionary,  see mf_static_candidates
+    uint8_t *candidates = calloc(dictcnt + (2 * SectorsCnt), MIFARE_KEY_SIZE);
+    if (candidates == NULL) {
+        free(dict);
+        return PM3_EMALLOC;
+    }
+
     uint64_t t1 = msclock();
 
     e_sector = calloc(SectorsCnt, sizeof(sector_t));
-    if (e_sector == NULL)
+    if (e_sector == NULL) {
+        free(candidates);
+        free(dict);
         return PM3_EMALLOC;
+    }
 
     // add our known key
     e_sector[mfSectorNum(blockNo)].foundKey[keyType] = 1;
@@ -2067,7 +2356,16 @@ static int CmdHF14AMfNestedStatic(const char *Cmd) {
 
                 if (e_sector[sectorNo].foundKey[trgKeyType]) continue;
 
-                int16_t isOK = mfStaticNested(blockNo, keyType, key, mfFirstBlockOfSector(sectorNo), trgKeyType, keyBlock);
+                // candidates are tested on device without authentications,  recovery is the fallback
+                int16_t isOK = PM3_ESOFT;
+                uint32_t candcnt = mf_static_candidates(e_sector, SectorsCnt, dict, dictcnt, candidates);
+                if (candcnt) {
+                    isOK = mfStaticNestedChk(blockNo, keyType, key, mfFirstBlockOfSector(sectorNo), trgKeyType, candcnt, candidates, keyBlock);
+                }
+
+                if (isOK == PM3_ESOFT) {
+                    isOK = mfStaticNested(blockNo, keyType, key, mfFirstBlockOfSector(sectorNo), trgKeyType, keyBlock);
+                }
                 switch (isOK) {
                     case PM3_ETIMEOUT :
                         PrintAndLogEx(ERR, "Command execute timeout");
@@ -2087,6 +2385,8 @@ static int CmdHF14AMfNestedStatic(const char *Cmd) {
                         PrintAndLogEx(ERR, "unknown error.\n");
                 }
                 free(e_sector);
+                free(candidates);
+                free(dict);
                 return PM3_ESOFT;
             }
         }
@@ -2168,12 +2468,16 @@ jumptoend:
         if (createMfcKeyDump(fptr, SectorsCnt, e_sector) != PM3_SUCCESS) {
             PrintAndLogEx(ERR, "Failed to save keys to file");
             free(e_sector);
+            free(candidates);
+            free(dict);
             free(fptr);
             return PM3_EFILE;
         }
         free(fptr);
     }
     free(e_sector);
+    free(candidates);
+    free(dict);
 
     return PM3_SUCCESS;
 }
@@ -2194,9 +2498,13 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   "hf mf hardnested --tblk 4 --ta     --> works for MFC EV1\n"
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta\n"
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -w\n"
+                  "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta --resume\n"
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -f nonces.bin -w -s\n"
                   "hf mf hardnested -r\n"
                   "hf mf hardnested -r --tk a0a1a2a3a4a5\n"
+                  "hf mf hardnested -r --remote 192.168.1.10:9210\n"
+                  "hf mf hardnested -r --gpu\n"
+                  "hf mf hardnested -r --dist 9211             --> let `hf mf hardworker` on other hosts help\n"
                   "hf mf hardnested -t --tk a0a1a2a3a4a5\n"
                   "hf mf hardnested --blk 0 -a -k a0a1a2a3a4a5 --tblk 4 --ta --tk FFFFFFFFFFFF\n"
                  );
@@ -2217,6 +2525,10 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         arg_lit0("s",  "slow",           "Slower acquisition (required by some non standard cards)"),
         arg_lit0("t",  "tests",          "Run tests"),
         arg_lit0("w",  "wr",             "Acquire nonces and UID, and write them to file `hf-mf-<UID>-nonces.bin`"),
+        arg_lit0(NULL, "resume",         "Continue an interrupted `-w` acquisition with the nonces already in the file"),
+        arg_str0(NULL, "remote", "<host[:port]>", "Send the nonce file of `-r` to a `hf mf hardserve` crack server"),
+        arg_lit0(NULL, "gpu",            "Brute force on an OpenCL device instead of the CPU"),
+        arg_int0(NULL, "dist",   "<port>", "Hand out brute force parts to `hf mf hardworker` clients connecting on port"),
 
         arg_lit0(NULL, "in", "None (use CPU regular instruction set)"),
 #if defined(COMPILER_HAS_SIMD_X86)
@@ -2277,22 +2589,42 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     bool slow = arg_get_lit(ctx, 12);
     bool tests = arg_get_lit(ctx, 13);
     bool nonce_file_write = arg_get_lit(ctx, 14);
+    bool resume = arg_get_lit(ctx, 15);
 
-    bool in = arg_get_lit(ctx, 15);
+    int remotelen = 0;
+    char remote[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 16), (uint8_t *)remote, sizeof(remote), &remotelen);
+
+    bool gpu = arg_get_lit(ctx, 17);
+    uint32_t dist_port = arg_get_u32_def(ctx, 18, 0);
+
+    bool in = arg_get_lit(ctx, 19);
 #if defined(COMPILER_HAS_SIMD_X86)
-    bool im = arg_get_lit(ctx, 16);
-    bool is = arg_get_lit(ctx, 17);
-    bool ia = arg_get_lit(ctx, 18);
-    bool i2 = arg_get_lit(ctx, 19);
+    bool im = arg_get_lit(ctx, 20);
+    bool is = arg_get_lit(ctx, 21);
+    bool ia = arg_get_lit(ctx, 22);
+    bool i2 = arg_get_lit(ctx, 23);
 #endif
 #if defined(COMPILER_HAS_SIMD_AVX512)
-    bool i5 = arg_get_lit(ctx, 20);
+    bool i5 = arg_get_lit(ctx, 24);
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
-    bool ie = arg_get_lit(ctx, 16);
+    bool ie = arg_get_lit(ctx, 20);
 #endif
     CLIParserFree(ctx);
 
+    if (dist_port > 0xFFFF) {
+        PrintAndLogEx(WARNING, "Port must be 1 - 65535");
+        return PM3_EINVARG;
+    }
+
+    if (gpu && hardnested_opencl_available() == false) {
+        PrintAndLogEx(WARNING, "Client was built without OpenCL support, `--gpu` isn't available");
+        return PM3_ENOTIMPL;
+    }
+    brute_force_use_gpu(gpu);
+    brute_force_distribute(dist_port);
+
     // set SIM instructions
     SetSIMDInstr(SIMD_AUTO);
 
@@ -2332,7 +2664,7 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         free(fptr);
     }
 
-    if (nonce_file_write) {
+    if (nonce_file_write || resume) {
         char *fptr = GenerateFilename("hf-mf-", "-nonces.bin");
         if (fptr == NULL) {
             return PM3_EFILE;
@@ -2371,6 +2703,29 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         }
     }
 
+    if (remotelen) {
+        if (nonce_file_read == false) {
+            PrintAndLogEx(WARNING, "`--remote` sends the nonce file of `-r`");
+            return PM3_EINVARG;
+        }
+
+        uint16_t port = HARDNESTED_SERVER_PORT;
+        char *colon = strrchr(remote, ':');
+        if (colon != NULL && strchr(remote, ':') == colon) {
+            *colon = '\0';
+            port = strtoul(colon + 1, NULL, 10);
+        }
+
+        uint64_t foundkey = 0;
+        int res = hardnested_remote(remote, port, filename, &foundkey);
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Found key " _GREEN_("%012" PRIX64), foundkey);
+        } else if (res == PM3_EFAILED) {
+            PrintAndLogEx(FAILED, "\nFailed to recover a key...");
+        }
+        return res;
+    }
+
     PrintAndLogEx(INFO, "Target block no " _YELLOW_("%3d") ", target key type: " _YELLOW_("%c") ", known target key: " _YELLOW_("%02x%02x%02x%02x%02x%02x%s"),
                   trg_blockno,
                   (trg_keytype == MF_KEY_B) ? 'B' : 'A',
@@ -2378,12 +2733,13 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   known_target_key ? "" : " (not set)"
                  );
     PrintAndLogEx(INFO, "File action: " _YELLOW_("%s") ", Slow: " _YELLOW_("%s") ", Tests: " _YELLOW_("%d"),
-                  nonce_file_write ? "write" : nonce_file_read ? "read" : "none",
+                  resume ? "resume" : nonce_file_write ? "write" : nonce_file_read ? "read" : "none",
                   slow ? "Yes" : "No",
                   tests);
 
     uint64_t foundkey = 0;
-    int16_t isOK = mfnestedhard(blockno, keytype, key, trg_blockno, trg_keytype, known_target_key ? trg_key : NULL, nonce_file_read, nonce_file_write, slow, tests, &foundkey, filename);
+    int16_t isOK = mfnestedhard(blockno, keytype, key, trg_blockno, trg_keytype, known_target_key ? trg_key : NULL, nonce_file_read, nonce_file_write, resume, slow, tests, &foundkey, filename);
+    brute_force_distribute(0);
     switch (isOK) {
         case PM3_ETIMEOUT :
             PrintAndLogEx(ERR, "Error: No response from Proxmark3\n");
@@ -2408,6 +2764,145 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     return isOK;
 }
 
+static int CmdHF14AMfHardServe(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf hardserve",
+                  "Hardnested crack server.  Keeps the hardnested tables in memory and cracks the nonce files\n"
+                  "other clients send with `hf mf hardnested -r --remote`,  one job at a time in arrival order.\n"
+                  "Only the first job pays for building the tables.",
+                  "hf mf hardserve\n"
+                  "hf mf hardserve --bind 0.0.0.0 -p 9210     --> accept jobs from other hosts"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0(NULL, "bind", "<addr>", "Address to listen on (def 127.0.0.1)"),
+        arg_int0("p",  "port", "<dec>",  "TCP port (def 9210)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int addrlen = 0;
+    char addr[64] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)addr, sizeof(addr), &addrlen);
+    uint32_t port = arg_get_u32_def(ctx, 2, HARDNESTED_SERVER_PORT);
+    CLIParserFree(ctx);
+
+    if (addrlen == 0) {
+        strcpy(addr, "127.0.0.1");
+    }
+
+    if (port == 0 || port > 0xFFFF) {
+        PrintAndLogEx(WARNING, "Port must be 1 - 65535");
+        return PM3_EINVARG;
+    }
+
+    return hardnested_serve(addr, port);
+}
+
+static int CmdHF14AMfHardWorker(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf hardworker",
+                  "Brute force worker for `hf mf hardnested --dist`.  Waits for the coordinator to reach its\n"
+                  "brute force phase,  then cracks parts of its candidate states with all local threads.\n"
+                  "Keeps coming back for the next attack until <Enter> is pressed.",
+                  "hf mf hardworker -c 192.168.1.10\n"
+                  "hf mf hardworker -c 192.168.1.10:9300 --gpu"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("c",  "connect", "<host[:port]>", "Coordinator (def port 9211)"),
+        arg_lit0(NULL, "gpu",     "Brute force on an OpenCL device instead of the CPU"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int hostlen = 0;
+    char host[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)host, sizeof(host), &hostlen);
+    bool gpu = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    if (gpu && hardnested_opencl_available() == false) {
+        PrintAndLogEx(WARNING, "Client was built without OpenCL support, `--gpu` isn't available");
+        return PM3_ENOTIMPL;
+    }
+
+    uint32_t port = HARDNESTED_DIST_PORT;
+    char *colon = strrchr(host, ':');
+    if (colon != NULL && strchr(host, ':') == colon) {
+        *colon = '\0';
+        port = strtoul(colon + 1, NULL, 10);
+    }
+
+    if (port == 0 || port > 0xFFFF) {
+        PrintAndLogEx(WARNING, "Port must be 1 - 65535");
+        return PM3_EINVARG;
+    }
+
+    return hardnested_work(host, port, gpu);
+}
+
+static int CmdHF14AMfHardBench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf hardbench",
+                  "Benchmark the hardnested attack on fixed nonce sets and time each phase:  table load,\n"
+                  "sum estimation, candidate generation and brute force.\n"
+                  "The easy, medium and hard sets are written to `~/.proxmark3/hardbench/` on first use\n"
+                  "and are the same on every platform,  so results can be compared between hosts and releases.",
+                  "hf mf hardbench\n"
+                  "hf mf hardbench -c hard --all -j bench.json    --> hard set on every SIMD back end\n"
+                  "hf mf hardbench -f hf-mf-01020304-nonces.bin   --> own nonce file"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("c", "class", "<easy|medium|hard>", "Nonce set to run (def all)"),
+        arg_str0("f", "file",  "<fn>", "Nonce file to run instead of the built in sets"),
+        arg_lit0(NULL, "all",          "Run every SIMD back end this CPU supports"),
+        arg_lit0(NULL, "gpu",          "Add a run on the OpenCL back end"),
+        arg_str0("j", "json",  "<fn>", "Save the results as JSON"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int classlen = 0;
+    char class_name[16] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)class_name, sizeof(class_name), &classlen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    bool all_simd = arg_get_lit(ctx, 3);
+    bool gpu = arg_get_lit(ctx, 4);
+
+    int jsonlen = 0;
+    char json_filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)json_filename, FILE_PATH_SIZE, &jsonlen);
+    CLIParserFree(ctx);
+
+    if (gpu && hardnested_opencl_available() == false) {
+        PrintAndLogEx(WARNING, "Client was built without OpenCL support, `--gpu` isn't available");
+        return PM3_ENOTIMPL;
+    }
+
+    return mfnestedhard_bench(class_name, filename, all_simd, gpu, json_filename);
+}
+
+// the first unknown key after the given one,  in the order autopwn goes through them
+static bool mf_next_unknown_key(const sector_t *e_sector, uint8_t sector_cnt, uint8_t sector, uint8_t keytype, uint8_t *next_sector, uint8_t *next_keytype) {
+    for (uint16_t i = (sector * 2) + keytype + 1; i < (sector_cnt * 2); i++) {
+        if (e_sector[i / 2].foundKey[i % 2] == 0) {
+            *next_sector = i / 2;
+            *next_keytype = i % 2;
+            return true;
+        }
+    }
+    return false;
+}
+
 static int CmdHF14AMfAutoPWN(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2419,7 +2914,8 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
                   "hf mf autopwn -s 0 -a -k FFFFFFFFFFFF     --> target MFC 1K card, Sector 0 with known key A 'FFFFFFFFFFFF'\n"
                   "hf mf autopwn --1k -f mfc_default_keys    --> target MFC 1K card, default dictionary\n"
                   "hf mf autopwn --1k -s 0 -a -k FFFFFFFFFFFF -f mfc_default_keys  --> combo of the two above samples\n"
-                  "hf mf autopwn --1k -s 0 -a -k FFFFFFFFFFFF -k a0a1a2a3a4a5      --> multiple user supplied keys"
+                  "hf mf autopwn --1k -s 0 -a -k FFFFFFFFFFFF -k a0a1a2a3a4a5      --> multiple user supplied keys\n"
+                  "hf mf autopwn --1k --resume               --> continue an interrupted run on the same card"
                  );
 
     void *argtable[] = {
@@ -2432,6 +2928,8 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         arg_lit0(NULL,  "slow",            "Slower acquisition (required by some non standard cards)"),
         arg_lit0("l",  "legacy",          "legacy mode (use the slow `hf mf chk`)"),
         arg_lit0("v",  "verbose",         "verbose output"),
+        arg_lit0(NULL, "stats",           "Try dictionary keys by recorded hits and record new hits"),
+        arg_lit0(NULL, "resume",          "Resume from the checkpoint of an interrupted run on this card"),
 
         arg_lit0(NULL, "mini", "MIFARE Classic Mini / S20"),
         arg_lit0(NULL, "1k", "MIFARE Classic 1k / S50 (default)"),
@@ -2477,24 +2975,26 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     bool slow = arg_get_lit(ctx, 6);
     bool legacy_mfchk = arg_get_lit(ctx, 7);
     bool verbose = arg_get_lit(ctx, 8);
+    bool use_stats = arg_get_lit(ctx, 9);
+    bool resume = arg_get_lit(ctx, 10);
 
-    bool m0 = arg_get_lit(ctx, 9);
-    bool m1 = arg_get_lit(ctx, 10);
-    bool m2 = arg_get_lit(ctx, 11);
-    bool m4 = arg_get_lit(ctx, 12);
+    bool m0 = arg_get_lit(ctx, 11);
+    bool m1 = arg_get_lit(ctx, 12);
+    bool m2 = arg_get_lit(ctx, 13);
+    bool m4 = arg_get_lit(ctx, 14);
 
-    bool in = arg_get_lit(ctx, 13);
+    bool in = arg_get_lit(ctx, 15);
 #if defined(COMPILER_HAS_SIMD_X86)
-    bool im = arg_get_lit(ctx, 14);
-    bool is = arg_get_lit(ctx, 15);
-    bool ia = arg_get_lit(ctx, 16);
-    bool i2 = arg_get_lit(ctx, 17);
+    bool im = arg_get_lit(ctx, 16);
+    bool is = arg_get_lit(ctx, 17);
+    bool ia = arg_get_lit(ctx, 18);
+    bool i2 = arg_get_lit(ctx, 19);
 #endif
 #if defined(COMPILER_HAS_SIMD_AVX512)
-    bool i5 = arg_get_lit(ctx, 18);
+    bool i5 = arg_get_lit(ctx, 20);
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
-    bool ie = arg_get_lit(ctx, 14);
+    bool ie = arg_get_lit(ctx, 16);
 #endif
 
     CLIParserFree(ctx);
@@ -2530,6 +3030,7 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
 
     // set SIM instructions
     SetSIMDInstr(SIMD_AUTO);
+    brute_force_use_gpu(false);
 
 #if defined(COMPILER_HAS_SIMD_AVX512)
     if (i5)
@@ -2559,6 +3060,8 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     // Nested and Hardnested parameter
     uint64_t key64 = 0;
     bool calibrate = true;
+    int16_t next_block = -1;
+    uint8_t next_sector = 0, next_keytype = 0;
 
     // Attack key storage variables
     uint8_t *keyBlock = NULL;
@@ -2664,6 +3167,10 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     // read uid to generate a filename for the key file
     char *fptr = GenerateFilename("hf-mf-", "-key.bin");
 
+    // found keys are saved as they come in,  for --resume
+    char checkpoint[64] = {0};
+    snprintf(checkpoint, sizeof(checkpoint), "hf-mf-autopwn-%s", sprint_hex_inrow(card.uid, card.uidlen));
+
     // check if tag doesn't have static nonce
     int has_staticnonce = detect_classic_static_nonce();
 
@@ -2714,6 +3221,16 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         return ret;
     }
 
+    if (resume) {
+        mf_checkpoint_load_keys(checkpoint, "hf mf autopwn", &keyBlock, &key_cnt);
+    }
+
+    mfc_keystats_t stats = {0};
+    if (use_stats) {
+        mfc_keystats_load(&stats, filename);
+        mf_order_keys(&stats, keyBlock, key_cnt, in_keys_len, -1);
+    }
+
     int32_t res = PM3_SUCCESS;
 
     // Use the dictionary to find sector keys on the card
@@ -2778,6 +3295,12 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         } // end strategy
     }
 
+    if (use_stats) {
+        mfc_keystats_record(&stats, e_sector, sector_cnt);
+        mfc_keystats_save(&stats);
+        mfc_keystats_free(&stats);
+    }
+
     // Analyse the dictionary attack
     uint8_t num_found_keys = 0;
     for (int i = 0; i < sector_cnt; i++) {
@@ -2816,6 +3339,8 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
         goto all_found;
     }
 
+    mf_checkpoint_save_keys(checkpoint, "hf mf autopwn", e_sector, sector_cnt);
+
     // Check if at least one sector key was found
     if (known_key == false) {
 
@@ -2971,17 +3496,26 @@ skipReadBKey:
                                           (current_key_type_i == MF_KEY_B) ? 'B' : 'A');
                         }
 tryNested:
-                        isOK = mfnested(mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i, tmp_key, calibrate);
+                        // the device collects the nonces of the next unknown key while this one is cracked
+                        next_block = -1;
+                        if (mf_next_unknown_key(e_sector, sector_cnt, current_sector_i, current_key_type_i, &next_sector, &next_keytype)) {
+                            next_block = mfFirstBlockOfSector(next_sector);
+                        }
+
+                        isOK = mfnested_ex(mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i,
+                                           next_block, next_keytype, tmp_key, calibrate);
 
                         switch (isOK) {
                             case PM3_ETIMEOUT: {
                                 PrintAndLogEx(ERR, "\nError: No response from Proxmark3.");
+                                mfnested_prefetch_drop();
                                 free(e_sector);
                                 free(fptr);
                                 return isOK;
                             }
                             case PM3_EOPABORTED: {
                                 PrintAndLogEx(WARNING, "\nButton pressed. Aborted.");
+                                mfnested_prefetch_drop();
                                 free(e_sector);
                                 free(fptr);
                                 return isOK;
@@ -3007,6 +3541,7 @@ tryNested:
                             }
                             case PM3_ESTATIC_NONCE: {
                                 PrintAndLogEx(ERR, "Error: Static encrypted nonce detected. Aborted\n");
+                                mfnested_prefetch_drop();
 
                                 e_sector[current_sector_i].Key[current_key_type_i] = 0xffffffffffff;;
                                 e_sector[current_sector_i].foundKey[current_key_type_i] = false;
@@ -3027,6 +3562,7 @@ tryNested:
                             }
                             default: {
                                 PrintAndLogEx(ERR, "unknown Error.\n");
+                                mfnested_prefetch_drop();
                                 free(e_sector);
                                 free(fptr);
                                 return isOK;
@@ -3035,6 +3571,7 @@ tryNested:
 
                     } else {
 tryHardnested: // If the nested attack fails then we try the hardnested attack
+                        mfnested_prefetch_drop();
                         if (verbose) {
                             PrintAndLogEx(INFO, "======================= " _YELLOW_("START HARDNESTED ATTACK") " =======================");
                             PrintAndLogEx(INFO, "sector no %3d, target key type %c, Slow %s",
@@ -3044,7 +3581,7 @@ tryHardnested: // If the nested attack fails then we try the hardnested attack
                         }
 
                         foundkey = 0;
-                        isOK = mfnestedhard(mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i, NULL, false, false, slow, 0, &foundkey, NULL);
+                        isOK = mfnestedhard(mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i, NULL, false, false, false, slow, 0, &foundkey, NULL);
                         DropField();
                         if (isOK != PM3_SUCCESS) {
                             switch (isOK) {
@@ -3130,14 +3667,31 @@ tryStaticnested:
                                       (current_key_type_i == MF_KEY_B) ? 'B' : 'A',
                                       sprint_hex_inrow(tmp_key, sizeof(tmp_key))
                                      );
+                        mf_checkpoint_save_keys(checkpoint, "hf mf autopwn", e_sector, sector_cnt);
                     }
                 }
             }
         }
     }
 
+    // nonces collected ahead for a key found by other means
+    mfnested_prefetch_drop();
+
 all_found:
 
+    // only a complete key table ends the attack
+    bool complete = true;
+    for (int i = 0; i < sector_cnt; i++) {
+        complete &= (e_sector[i].foundKey[MF_KEY_A] && e_sector[i].foundKey[MF_KEY_B]);
+    }
+
+    if (complete) {
+        checkpoint_remove(checkpoint);
+    } else {
+        mf_checkpoint_save_keys(checkpoint, "hf mf autopwn", e_sector, sector_cnt);
+        PrintAndLogEx(HINT, "Hint: Run `" _YELLOW_("hf mf autopwn --resume") "` to continue the key recovery later");
+    }
+
     // Show the results to the user
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(SUCCESS, _GREEN_("found keys:"));
@@ -3218,15 +3772,19 @@ all_found:
 static int CmdHF14AMfChk_fast(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf fchk",
-                  "This is a improved checkkeys method speedwise. It checks MIFARE Classic tags sector keys against a dictionary file with keys",
+                  "This is a improved checkkeys method speedwise. It checks MIFARE Classic tags sector keys against a dictionary file with keys\n"
+                  "With more devices attached (`hw attach`) the dictionary is split across them, each needs the card on its antenna",
                   "hf mf fchk --mini -k FFFFFFFFFFFF              --> Key recovery against MIFARE Mini\n"
                   "hf mf fchk --1k -k FFFFFFFFFFFF                --> Key recovery against MIFARE Classic 1k\n"
                   "hf mf fchk --2k -k FFFFFFFFFFFF                --> Key recovery against MIFARE 2k\n"
                   "hf mf fchk --4k -k FFFFFFFFFFFF                --> Key recovery against MIFARE 4k\n"
                   "hf mf fchk --1k -f mfc_default_keys.dic        --> Target 1K using default dictionary file\n"
+                  "hf mf fchk --1k -f big_keys.dic.lz4            --> Target 1K using a lz4 compressed dictionary file\n"
                   "hf mf fchk --1k --emu                          --> Target 1K, write keys to emulator memory\n"
                   "hf mf fchk --1k --dump                         --> Target 1K, write keys to file\n"
-                  "hf mf fchk --1k --mem                          --> Target 1K, use dictionary from flash memory");
+                  "hf mf fchk --1k --mem                          --> Target 1K, use dictionary from flash memory\n"
+                  "hf mf fchk --1k -f mfc_default_keys --stats     --> Target 1K, try keys with most recorded hits first\n"
+                  "hf mf fchk --1k --mem --stats                  --> Target 1K, record hits of the flash memory dictionary");
 
     void *argtable[] = {
         arg_param_begin,
@@ -3239,6 +3797,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         arg_lit0(NULL, "dump", "Dump found keys to binary file"),
         arg_lit0(NULL, "mem", "Use dictionary from flashmemory"),
         arg_str0("f", "file", "<fn>", "filename of dictionary"),
+        arg_lit0(NULL, "stats", "Try keys by recorded hits and record new hits"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -3260,6 +3819,9 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
     char filename[FILE_PATH_SIZE] = {0};
     CLIParamStrToBuf(arg_get_str(ctx, 9), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
 
+    // the flash memory dictionary is checked on device, its hits are only recorded
+    bool use_stats = arg_get_lit(ctx, 10);
+
     CLIParserFree(ctx);
 
     //validations
@@ -3285,23 +3847,49 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    // one device checking from the host,  the dictionary is parsed while the device checks.
+    // --stats orders the whole dictionary first,  so it is loaded
+    dictionary_stream_t *stream = NULL;
+    if (fnlen > 0 && use_stats == false && use_flashmemory == false && GetDeviceCount() <= 1) {
+        if (dictionary_stream_open(&stream, filename, MIFARE_KEY_SIZE) != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "An error occurred while loading the dictionary!");
+            return PM3_EFILE;
+        }
+        fnlen = 0;
+    }
+
     uint8_t *keyBlock = NULL;
     uint32_t keycnt = 0;
     int ret = mf_load_keys(&keyBlock, &keycnt, key, keylen, filename, fnlen);
     if (ret != PM3_SUCCESS) {
+        dictionary_stream_close(stream);
         return ret;
     }
 
+    mfc_keystats_t stats = {0};
+    if (use_stats && use_flashmemory) {
+        // count the hits against the dictionary the flash memory section was made from
+        flash_dict_section_t sec;
+        if (flashmem_dict_section_get(FLASH_DICT_MFC, &sec) == PM3_SUCCESS) {
+            mfc_keystats_load(&stats, sec.name);
+        } else {
+            PrintAndLogEx(WARNING, "no index for the dictionary in flash memory, load it again with " _YELLOW_("`mem load -m`") " to record hits");
+            use_stats = false;
+        }
+    } else if (use_stats) {
+        mfc_keystats_load(&stats, filename);
+        mf_order_keys(&stats, keyBlock, keycnt, keylen, -1);
+    }
+
     // create/initialize key storage structure
     sector_t *e_sector = NULL;
     if (initSectorTable(&e_sector, sectorsCnt) != PM3_SUCCESS) {
+        mfc_keystats_free(&stats);
+        dictionary_stream_close(stream);
         free(keyBlock);
         return PM3_EMALLOC;
     }
 
-    uint32_t chunksize = keycnt > (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE) ? (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE) : keycnt;
-    bool firstChunk = true, lastChunk = false;
-
     int i = 0;
 
     // time
@@ -3310,44 +3898,41 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
     if (use_flashmemory) {
         PrintAndLogEx(SUCCESS, "Using dictionary in flash memory");
         mfCheckKeys_fast(sectorsCnt, true, true, 1, 0, keyBlock, e_sector, use_flashmemory, false);
+    } else if (GetDeviceCount() > 1) {
+        // more devices attached,  each one takes a part of the dictionary
+        mfCheckKeys_fast_multi(sectorsCnt, keycnt, keyBlock, e_sector);
     } else {
 
         // strategys. 1= deep first on sector 0 AB,  2= width first on all sectors
         for (uint8_t strategy = 1; strategy < 3; strategy++) {
             PrintAndLogEx(INFO, "Running strategy %u", strategy);
 
-            // main keychunk loop
-            for (i = 0; i < keycnt; i += chunksize) {
-
-                if (kbd_enter_pressed()) {
-                    PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-                    goto out;
-                }
-
-                uint32_t size = ((keycnt - i)  > chunksize) ? chunksize : keycnt - i;
-
-                // last chunk?
-                if (size == keycnt - i)
-                    lastChunk = true;
-
-                int res = mfCheckKeys_fast(sectorsCnt, firstChunk, lastChunk, strategy, size, keyBlock + (i * MIFARE_KEY_SIZE), e_sector, false, false);
-
-                if (firstChunk)
-                    firstChunk = false;
+            // key chunks are uploaded while the device checks the previous one
+            int res;
+            if (stream) {
+                res = mfCheckKeys_fast_stream(sectorsCnt, strategy, keycnt, keyBlock, stream, e_sector, false);
+                PrintAndLogEx(INFO, "checked " _YELLOW_("%u") " keys from the dictionary", dictionary_stream_count(stream));
+            } else {
+                res = mfCheckKeys_fast_pipelined(sectorsCnt, strategy, keycnt, keyBlock, e_sector, false);
+            }
 
-                // all keys,  aborted
-                if (res == PM3_SUCCESS || res == 2)
-                    goto out;
+            // all keys,  aborted
+            if (res == PM3_SUCCESS || res == PM3_EOPABORTED || res == PM3_ETIMEOUT)
+                goto out;
 
-            } // end chunks of keys
-            firstChunk = true;
-            lastChunk = false;
         } // end strategy
     }
 out:
+    dictionary_stream_close(stream);
     t1 = msclock() - t1;
     PrintAndLogEx(INFO, "time in checkkeys (fast) " _YELLOW_("%.1fs") "\n", (float)(t1 / 1000.0));
 
+    if (use_stats) {
+        mfc_keystats_record(&stats, e_sector, sectorsCnt);
+        mfc_keystats_save(&stats);
+        mfc_keystats_free(&stats);
+    }
+
     // check..
     uint8_t found_keys = 0;
     for (i = 0; i < sectorsCnt; ++i) {
@@ -3631,7 +4216,8 @@ static int CmdHF14AMfChk(const char *Cmd) {
                   "hf mf chk --4k -k FFFFFFFFFFFF                --> Check all sectors, all keys against MIFARE 4k\n"
                   "hf mf chk --1k --emu                          --> Check all sectors, all keys, 1K, and write to emulator memory\n"
                   "hf mf chk --1k --dump                         --> Check all sectors, all keys, 1K, and write to file\n"
-                  "hf mf chk -a --tblk 0 -f mfc_default_keys.dic --> Check dictionary against block 0, key A");
+                  "hf mf chk -a --tblk 0 -f mfc_default_keys.dic --> Check dictionary against block 0, key A\n"
+                  "hf mf chk --1k -f mfc_default_keys --stats     --> Check all sectors, keys which opened a sector before first");
 
     void *argtable[] = {
         arg_param_begin,
@@ -3647,6 +4233,7 @@ static int CmdHF14AMfChk(const char *Cmd) {
         arg_lit0(NULL, "emu", "Fill simulator keys from found keys"),
         arg_lit0(NULL, "dump", "Dump found keys to binary file"),
         arg_str0("f", "file", "<fn>", "Filename of dictionary"),
+        arg_lit0(NULL, "stats", "Try keys by recorded hits per sector and record new hits"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -3679,6 +4266,8 @@ static int CmdHF14AMfChk(const char *Cmd) {
     char filename[FILE_PATH_SIZE] = {0};
     CLIParamStrToBuf(arg_get_str(ctx, 12), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
 
+    bool use_stats = arg_get_lit(ctx, 13);
+
     CLIParserFree(ctx);
 
     bool singleSector = (blockNo > -1);
@@ -3742,11 +4331,18 @@ static int CmdHF14AMfChk(const char *Cmd) {
         return ret;
     }
 
+    mfc_keystats_t stats = {0};
+    if (use_stats) {
+        mfc_keystats_load(&stats, filename);
+        mf_order_keys(&stats, keyBlock, keycnt, keylen, -1);
+    }
+
     uint64_t key64 = 0;
 
     // create/initialize key storage structure
     sector_t *e_sector = NULL;
     if (initSectorTable(&e_sector, sectors_cnt) != PM3_SUCCESS) {
+        mfc_keystats_free(&stats);
         free(keyBlock);
         return PM3_EMALLOC;
     }
@@ -3776,6 +4372,11 @@ static int CmdHF14AMfChk(const char *Cmd) {
             // skip already found keys.
             if (e_sector[i].foundKey[trgKeyType]) continue;
 
+            // keys which opened this sector before go first
+            if (use_stats) {
+                mf_order_keys(&stats, keyBlock, keycnt, keylen, i);
+            }
+
             for (uint32_t c = 0; c < keycnt; c += max_keys) {
 
                 PrintAndLogEx(NORMAL, "." NOLF);
@@ -3792,6 +4393,9 @@ static int CmdHF14AMfChk(const char *Cmd) {
                     e_sector[i].Key[trgKeyType] = key64;
                     e_sector[i].foundKey[trgKeyType] = true;
                     clearLog = false;
+                    if (use_stats) {
+                        mfc_keystats_hit(&stats, key64, i);
+                    }
                     break;
                 }
                 clearLog = false;
@@ -3850,6 +4454,11 @@ static int CmdHF14AMfChk(const char *Cmd) {
     }
 
 out:
+    if (use_stats) {
+        mfc_keystats_save(&stats);
+        mfc_keystats_free(&stats);
+    }
+
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(SUCCESS, _GREEN_("found keys:"));
 
@@ -3952,6 +4561,239 @@ void readerAttack(sector_t *k_sector, size_t k_sectors_cnt, nonces_t data, bool
     free(k_sector);
 }
 
+// hf mf sim --stream,  every new reader nonce gets paired with the last few ones
+// of the same sector / key type,  readers cycling through their keys still meet
+// a pair made with the same key soon enough
+#define MF_SIM_STREAM_HISTORY 4
+
+typedef struct {
+    nonces_t pair;
+    uint64_t key;
+    bool found;
+    bool done;
+    threadpool_job_t *job;
+} mf_sim_crack_t;
+
+typedef struct {
+    sector_t *k_sector;
+    size_t k_sectors_cnt;
+    uint8_t (*trailers)[MFBLOCK_SIZE];   // emulator sector trailers,  NULL without -e
+    nonces_t (*seen)[2][MF_SIM_STREAM_HISTORY];
+    uint8_t (*seen_cnt)[2];
+    mf_sim_crack_t **cracks;
+    size_t cracks_cnt;
+    size_t cracks_max;
+    uint32_t nonces;
+    uint32_t pairs;
+    bool verbose;
+} mf_sim_stream_t;
+
+static void mf_sim_crack_task(threadpool_job_t *job, void *arg, uint32_t index) {
+    (void)job;
+    (void)index;
+    mf_sim_crack_t *c = (mf_sim_crack_t *)arg;
+    c->found = mfkey32_moebius(&c->pair, &c->key);
+    __atomic_store_n(&c->done, true, __ATOMIC_SEQ_CST);
+}
+
+// does a key we already know explain this failed auth,  same check as the simulator does
+static bool mf_sim_stream_known(const mf_sim_stream_t *st, const nonces_t *n) {
+    if (st->k_sector[n->sector].foundKey[n->keytype] == false) {
+        return false;
+    }
+
+    struct Crypto1State *pcs = crypto1_create(st->k_sector[n->sector].Key[n->keytype]);
+    if (pcs == NULL) {
+        return false;
+    }
+    crypto1_word(pcs, n->cuid ^ n->nonce, 0);
+    crypto1_word(pcs, n->nr, 1);
+    uint32_t rr = n->ar ^ crypto1_word(pcs, 0, 0);
+    crypto1_destroy(pcs);
+    return (rr == prng_successor(n->nonce, 64));
+}
+
+static void mf_sim_stream_key(mf_sim_stream_t *st, const mf_sim_crack_t *c) {
+    uint8_t sector = c->pair.sector;
+    uint8_t keytype = c->pair.keytype;
+
+    if (st->k_sector[sector].foundKey[keytype] && st->k_sector[sector].Key[keytype] == c->key) {
+        return;
+    }
+
+    PrintAndLogEx(SUCCESS, "Reader is trying authenticate with: Key %s, sector %02d: [" _GREEN_("%012" PRIx64) "]"
+                  , (keytype == MF_KEY_B) ? "B" : "A"
+                  , sector
+                  , c->key
+                 );
+
+    st->k_sector[sector].Key[keytype] = c->key;
+    st->k_sector[sector].foundKey[keytype] = true;
+
+    if (st->trailers == NULL) {
+        return;
+    }
+
+    // only the key bytes change,  access conditions stay the ones of the loaded dump
+    uint8_t *trailer = st->trailers[sector];
+    num_to_bytes(c->key, MIFARE_KEY_SIZE, trailer + ((keytype == MF_KEY_B) ? 10 : 0));
+    uint8_t blockno = mfSectorTrailerOfSector(sector);
+    PrintAndLogEx(INFO, "Setting Emulator Memory Block %02d: [%s]", blockno, sprint_hex(trailer, MFBLOCK_SIZE));
+    mfEmlSetMem(trailer, blockno, 1);
+}
+
+// collect finished cracks,  or all of them when wait is set
+static void mf_sim_stream_collect(mf_sim_stream_t *st, bool wait) {
+    size_t i = 0;
+    while (i < st->cracks_cnt) {
+        mf_sim_crack_t *c = st->cracks[i];
+        if (wait == false && __atomic_load_n(&c->done, __ATOMIC_SEQ_CST) == false) {
+            i++;
+            continue;
+        }
+
+        threadpool_wait(c->job, NULL, NULL, 0);
+        if (c->found) {
+            mf_sim_stream_key(st, c);
+        }
+        free(c);
+        st->cracks[i] = st->cracks[--st->cracks_cnt];
+    }
+}
+
+static void mf_sim_stream_nonce(mf_sim_stream_t *st, const nonces_t *n) {
+
+    if (n->sector >= st->k_sectors_cnt || n->keytype > MF_KEY_B) {
+        return;
+    }
+
+    st->nonces++;
+
+    if (st->verbose) {
+        PrintAndLogEx(INFO, "sector %02d key %c  nt %08x  nr %08x  ar %08x"
+                      , n->sector
+                      , (n->keytype == MF_KEY_B) ? 'B' : 'A'
+                      , n->nonce
+                      , n->nr
+                      , n->ar
+                     );
+    }
+
+    if (mf_sim_stream_known(st, n)) {
+        return;
+    }
+
+    nonces_t *seen = st->seen[n->sector][n->keytype];
+    uint8_t *cnt = &st->seen_cnt[n->sector][n->keytype];
+    uint8_t used = MIN(*cnt, MF_SIM_STREAM_HISTORY);
+
+    for (uint8_t i = 0; i < used; i++) {
+        if (seen[i].ar == n->ar) {
+            return;
+        }
+    }
+
+    for (uint8_t i = 0; i < used; i++) {
+
+        if (st->cracks_cnt == st->cracks_max) {
+            size_t max = (st->cracks_max) ? st->cracks_max * 2 : 16;
+            mf_sim_crack_t **tmp = realloc(st->cracks, max * sizeof(mf_sim_crack_t *));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "failed to allocate memory");
+                return;
+            }
+            st->cracks = tmp;
+            st->cracks_max = max;
+        }
+
+        mf_sim_crack_t *c = calloc(1, sizeof(mf_sim_crack_t));
+        if (c == NULL) {
+            PrintAndLogEx(WARNING, "failed to allocate memory");
+            return;
+        }
+
+        c->pair = seen[i];
+        c->pair.nonce2 = n->nonce;
+        c->pair.nr2 = n->nr;
+        c->pair.ar2 = n->ar;
+        c->pair.state = SECOND;
+
+        c->job = threadpool_submit(mf_sim_crack_task, c, 1);
+        if (c->job == NULL) {
+            free(c);
+            return;
+        }
+        st->cracks[st->cracks_cnt++] = c;
+        st->pairs++;
+    }
+
+    seen[*cnt % MF_SIM_STREAM_HISTORY] = *n;
+    (*cnt)++;
+}
+
+// runs until the simulation ends,  Enter stops it
+static int mf_sim_stream(sector_t *k_sector, size_t k_sectors_cnt, uint8_t (*trailers)[MFBLOCK_SIZE], bool verbose) {
+
+    mf_sim_stream_t st = {
+        .k_sector = k_sector,
+        .k_sectors_cnt = k_sectors_cnt,
+        .trailers = trailers,
+        .verbose = verbose,
+    };
+
+    st.seen = calloc(k_sectors_cnt, sizeof(*st.seen));
+    st.seen_cnt = calloc(k_sectors_cnt, sizeof(*st.seen_cnt));
+    if (st.seen == NULL || st.seen_cnt == NULL) {
+        PrintAndLogEx(WARNING, "failed to allocate memory");
+        free(st.seen);
+        free(st.seen_cnt);
+        SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort simulation");
+
+    uint64_t stop_sent = 0;
+    for (;;) {
+
+        if (stop_sent == 0 && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            stop_sent = msclock();
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_UNKNOWN, &resp, 100)) {
+
+            if (resp.cmd == CMD_HF_MIFARE_SIMULATE && resp.length == sizeof(nonces_t)) {
+                nonces_t n;
+                memcpy(&n, resp.data.asBytes, sizeof(n));
+                mf_sim_stream_nonce(&st, &n);
+            } else if (resp.cmd == CMD_ACK && (resp.oldarg[0] & 0xffff) == CMD_HF_MIFARE_SIMULATE) {
+                break;
+            }
+        }
+
+        mf_sim_stream_collect(&st, false);
+
+        if (stop_sent && (msclock() - stop_sent) > 2000) {
+            PrintAndLogEx(WARNING, "no reply from device after stopping the simulation");
+            break;
+        }
+    }
+
+    if (st.cracks_cnt) {
+        PrintAndLogEx(INFO, "waiting for " _YELLOW_("%zu") " pending key recoveries", st.cracks_cnt);
+    }
+    mf_sim_stream_collect(&st, true);
+
+    PrintAndLogEx(INFO, "Collected " _YELLOW_("%u") " reader nonces,  tried " _YELLOW_("%u") " pairs", st.nonces, st.pairs);
+
+    free(st.cracks);
+    free(st.seen);
+    free(st.seen_cnt);
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14AMfSim(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf sim",
@@ -3964,6 +4806,7 @@ static int CmdHF14AMfSim(const char *Cmd) {
                   "hf mf sim --1k -u 0a0a0a0a          --> MIFARE Classic 1k with 4b UID\n"
                   "hf mf sim --1k -u 11223344556677    --> MIFARE Classic 1k with 7b UID\n"
                   "hf mf sim --1k -u 11223344 -i -x    --> Perform reader attack in interactive mode\n"
+                  "hf mf sim --1k --stream -e          --> Recover reader keys live and answer with them\n"
                   "hf mf sim --2k                      --> MIFARE 2k\n"
                   "hf mf sim --4k                      --> MIFARE 4k"
                  );
@@ -3983,6 +4826,7 @@ static int CmdHF14AMfSim(const char *Cmd) {
         arg_lit0("e", "emukeys", "Fill simulator keys from found keys"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0(NULL, "cve", "trigger CVE 2021_0430"),
+        arg_lit0(NULL, "stream", "Stream reader nonces and recover keys while simulating (implies -i)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -4044,8 +4888,18 @@ static int CmdHF14AMfSim(const char *Cmd) {
     if (arg_get_lit(ctx, 13)) {
         flags |= FLAG_CVE21_0430;
     }
+
+    bool stream = arg_get_lit(ctx, 14);
     CLIParserFree(ctx);
 
+    if (stream) {
+        if ((flags & FLAG_NR_AR_ATTACK) == FLAG_NR_AR_ATTACK) {
+            PrintAndLogEx(WARNING, "Use either -x or --stream");
+            return PM3_EINVARG;
+        }
+        flags |= (FLAG_INTERACTIVE | FLAG_NR_AR_STREAM);
+    }
+
     //Validations
     if (atqalen > 0) {
         if (atqalen != 2) {
@@ -4122,6 +4976,39 @@ static int CmdHF14AMfSim(const char *Cmd) {
     payload.atqa = (atqa[1] << 8) | atqa[0];
     payload.sak = sak[0];
 
+    if (stream) {
+        sector_t *k_sector = NULL;
+        if (initSectorTable(&k_sector, k_sectors_cnt) != PM3_SUCCESS) {
+            return PM3_EMALLOC;
+        }
+
+        // recovered keys get patched into the trailers of the loaded dump,  read them while we still can
+        uint8_t (*trailers)[MFBLOCK_SIZE] = NULL;
+        if (setEmulatorMem) {
+            trailers = calloc(k_sectors_cnt, MFBLOCK_SIZE);
+            if (trailers == NULL) {
+                free(k_sector);
+                return PM3_EMALLOC;
+            }
+
+            for (size_t i = 0; i < k_sectors_cnt; i++) {
+                if (mfEmlGetMem(trailers[i], mfSectorTrailerOfSector(i), 1) != PM3_SUCCESS) {
+                    PrintAndLogEx(WARNING, "Failed to read emulator memory");
+                    free(trailers);
+                    free(k_sector);
+                    return PM3_ETIMEOUT;
+                }
+            }
+        }
+
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFARE_SIMULATE, (uint8_t *)&payload, sizeof(payload));
+        int res = mf_sim_stream(k_sector, k_sectors_cnt, trailers, verbose);
+        free(trailers);
+        showSectorTable(k_sector, k_sectors_cnt);
+        return res;
+    }
+
     clearCommandBuffer();
     SendCommandNG(CMD_HF_MIFARE_SIMULATE, (uint8_t *)&payload, sizeof(payload));
     PacketResponseNG resp;
@@ -4264,6 +5151,21 @@ void printKeyTableEx(size_t sectorscnt, sector_t *e_sector, uint8_t start_sector
                       , strB, resB
                       , extra
                      );
+
+        if (pm3_result_collecting()) {
+            json_t *jsec = json_object();
+            json_object_set_new(jsec, "sector", json_integer(s));
+            for (uint8_t kt = 0; kt < 2; kt++) {
+                if (e_sector[i].foundKey[kt]) {
+                    uint8_t key[MIFARE_KEY_SIZE];
+                    num_to_bytes(e_sector[i].Key[kt], sizeof(key), key);
+                    json_object_set_new(jsec, kt ? "keyB" : "keyA", pm3_result_hex(key, sizeof(key)));
+                } else {
+                    json_object_set_new(jsec, kt ? "keyB" : "keyA", json_null());
+                }
+            }
+            pm3_result_append("sectors", jsec);
+        }
     }
 
     PrintAndLogEx(SUCCESS, "-----+-----+--------------+---+--------------+----");
@@ -4445,6 +5347,7 @@ int CmdHF14AMfELoad(const char *Cmd) {
                   "Load emulator memory with data from (bin/eml/json) dump file",
                   "hf mf eload -f hf-mf-01020304.bin\n"
                   "hf mf eload --4k -f hf-mf-01020304.eml\n"
+                  "hf mf eload --4k --delta -f hf-mf-01020304.bin  -> only upload changed blocks\n"
                  );
     void *argtable[] = {
         arg_param_begin,
@@ -4457,6 +5360,7 @@ int CmdHF14AMfELoad(const char *Cmd) {
         arg_lit0("m", "mem",  "use RDV4 spiffs"),
         arg_int0("q", "qty", "<dec>", "manually set number of blocks (overrides)"),
         arg_lit0("v", "verbose", "verbose output"),
+        arg_lit0(NULL, "delta", "only upload blocks which differ from device emulator memory"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -4474,8 +5378,14 @@ int CmdHF14AMfELoad(const char *Cmd) {
     bool use_spiffs = arg_get_lit(ctx, 7);
     int numblks = arg_get_int_def(ctx, 8, -1);
     bool verbose = arg_get_lit(ctx, 9);
+    bool delta = arg_get_lit(ctx, 10);
     CLIParserFree(ctx);
 
+    if (use_spiffs && delta) {
+        PrintAndLogEx(WARNING, "Delta upload can't be used with spiffs");
+        return PM3_EINVARG;
+    }
+
     // validations
     if ((m0 + m1 + m2 + m4 + mu) > 1) {
         PrintAndLogEx(WARNING, "Only specify one MIFARE Type");
@@ -4579,40 +5489,66 @@ int CmdHF14AMfELoad(const char *Cmd) {
         PrintAndLogEx(INFO, "MIFARE Ultralight override, will use %d blocks ( %u bytes )", block_cnt, block_cnt * block_width);
     }
 
-    PrintAndLogEx(INFO, "Uploading to emulator memory");
-    PrintAndLogEx(INFO, "." NOLF);
+    if (delta) {
+        size_t len = MIN(bytes_read, (size_t)block_cnt * block_width);
+        size_t sent = 0;
+        res = mfEmlSetMemDelta(data, len, block_width, &sent);
+        free(data);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "Delta upload to emulator memory failed ( %d )", res);
+            return res;
+        }
+        PrintAndLogEx(SUCCESS, "Uploaded " _YELLOW_("%zu") " of %zu bytes to emulator memory", sent, len);
+        return PM3_SUCCESS;
+    }
 
-    // fast push mode
-    g_conn.block_after_ACK = true;
+    PrintAndLogEx(INFO, "Uploading to emulator memory");
 
-    size_t offset = 0;
     int cnt = 0;
 
-    // 12 is the size of the struct the fct mfEmlSetMem_xt uses to transfer to device
-    uint16_t max_avail_blocks = ((PM3_CMD_DATA_SIZE - 12) / block_width) * block_width;
+    size_t len = MIN(bytes_read, (size_t)block_cnt * block_width);
+    res = mfEmlSetMemBulk(data, len);
+    if (res == PM3_SUCCESS) {
+        cnt = len / block_width;
+    } else if (res != PM3_ETIMEOUT) {
+        PrintAndLogEx(FAILED, "Bulk upload to emulator memory failed ( %d )", res);
+        free(data);
+        return res;
+    } else {
+        // firmware without bulk upload
+        PrintAndLogEx(INFO, "." NOLF);
+
+        // fast push mode
+        g_conn.block_after_ACK = true;
 
-    while (bytes_read && cnt < block_cnt) {
-        if (bytes_read == block_width) {
-            // Disable fast mode on last packet
-            g_conn.block_after_ACK = false;
-        }
+        size_t offset = 0;
 
-        uint16_t chunk_size = MIN(max_avail_blocks, bytes_read);
-        uint16_t blocks_to_send = chunk_size / block_width;
+        // 12 is the size of the struct the fct mfEmlSetMem_xt uses to transfer to device
+        uint16_t max_avail_blocks = ((PM3_CMD_DATA_SIZE - 12) / block_width) * block_width;
 
-        if (mfEmlSetMem_xt(data + offset, cnt, blocks_to_send, block_width) != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "Can't set emulator mem at block: %3d", cnt);
-            free(data);
-            return PM3_ESOFT;
+        while (bytes_read && cnt < block_cnt) {
+            if (bytes_read == block_width) {
+                // Disable fast mode on last packet
+                g_conn.block_after_ACK = false;
+            }
+
+            uint16_t chunk_size = MIN(max_avail_blocks, bytes_read);
+            uint16_t blocks_to_send = chunk_size / block_width;
+
+            if (mfEmlSetMem_xt(data + offset, cnt, blocks_to_send, block_width) != PM3_SUCCESS) {
+                PrintAndLogEx(FAILED, "Can't set emulator mem at block: %3d", cnt);
+                free(data);
+                return PM3_ESOFT;
+            }
+            cnt += blocks_to_send;
+            offset += chunk_size;
+            bytes_read -= chunk_size;
+            PrintAndLogEx(NORMAL, "." NOLF);
+            fflush(stdout);
         }
-        cnt += blocks_to_send;
-        offset += chunk_size;
-        bytes_read -= chunk_size;
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
+        PrintAndLogEx(NORMAL, "");
     }
     free(data);
-    PrintAndLogEx(NORMAL, "");
 
     if (block_width == MFU_BLOCK_SIZE) {
         PrintAndLogEx(HINT, "You are ready to simulate. See " _YELLOW_("`hf mfu sim -h`"));
@@ -4633,6 +5569,133 @@ int CmdHF14AMfELoad(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdHF14AMfESnap(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mf esnap",
+                  "Keep named snapshots of emulator memory in device RAM and swap between them.\n"
+                  "Snapshots take BigBuf space away from traces until cleared.",
+                  "hf mf esnap --save -n card1 --4k   -> copy 4k of emulator memory into snapshot `card1`\n"
+                  "hf mf esnap --load -n card1        -> copy snapshot `card1` back into emulator memory\n"
+                  "hf mf esnap                        -> list snapshots\n"
+                  "hf mf esnap --clear                -> drop all snapshots"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("n", "name", "<str>", "snapshot name, max 16 chars"),
+        arg_lit0(NULL, "save", "save emulator memory into snapshot"),
+        arg_lit0(NULL, "load", "load snapshot into emulator memory"),
+        arg_lit0(NULL, "clear", "drop all snapshots"),
+        arg_lit0(NULL, "mini", "MIFARE Classic Mini / S20"),
+        arg_lit0(NULL, "1k", "MIFARE Classic 1k / S50 (def)"),
+        arg_lit0(NULL, "2k", "MIFARE Classic/Plus 2k"),
+        arg_lit0(NULL, "4k", "MIFARE Classic 4k / S70"),
+        arg_lit0(NULL, "ul", "MIFARE Ultralight family"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int namelen = 0;
+    char name[EML_SNAPSHOT_NAME_LEN + 1] = {0};
+    int res = CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)name, EML_SNAPSHOT_NAME_LEN, &namelen);
+    bool save = arg_get_lit(ctx, 2);
+    bool load = arg_get_lit(ctx, 3);
+    bool clear = arg_get_lit(ctx, 4);
+    bool m0 = arg_get_lit(ctx, 5);
+    bool m1 = arg_get_lit(ctx, 6);
+    bool m2 = arg_get_lit(ctx, 7);
+    bool m4 = arg_get_lit(ctx, 8);
+    bool mu = arg_get_lit(ctx, 9);
+    CLIParserFree(ctx);
+
+    if (res) {
+        PrintAndLogEx(WARNING, "Snapshot name too long, max %u chars", EML_SNAPSHOT_NAME_LEN);
+        return PM3_EINVARG;
+    }
+
+    if ((save + load + clear) > 1) {
+        PrintAndLogEx(WARNING, "Only specify one of --save, --load or --clear");
+        return PM3_EINVARG;
+    }
+
+    if ((m0 + m1 + m2 + m4 + mu) > 1) {
+        PrintAndLogEx(WARNING, "Only specify one MIFARE Type");
+        return PM3_EINVARG;
+    }
+
+    if ((save || load) && namelen == 0) {
+        PrintAndLogEx(WARNING, "Missing snapshot name");
+        return PM3_EINVARG;
+    }
+
+    uint16_t size = MIFARE_1K_MAXBLOCK * MFBLOCK_SIZE;
+    if (m0) {
+        size = MIFARE_MINI_MAXBLOCK * MFBLOCK_SIZE;
+    } else if (m2) {
+        size = MIFARE_2K_MAXBLOCK * MFBLOCK_SIZE;
+    } else if (m4) {
+        size = MIFARE_4K_MAXBLOCK * MFBLOCK_SIZE;
+    } else if (mu) {
+        size = MFU_MAX_BLOCKS * MFU_BLOCK_SIZE + MFU_DUMP_PREFIX_LENGTH;
+    }
+
+    PacketResponseNG resp;
+    if (save) {
+        res = mfEmlSnapshot(EML_SNAPSHOT_SAVE, name, size, &resp);
+        if (res == PM3_EMALLOC) {
+            PrintAndLogEx(FAILED, "Not enough device memory for another snapshot");
+        } else if (res == PM3_EOVFLOW) {
+            PrintAndLogEx(FAILED, "All %u snapshots in use", EML_SNAPSHOT_MAX);
+        } else if (res == PM3_EINVARG) {
+            PrintAndLogEx(FAILED, "Snapshot " _YELLOW_("%s") " exists with another size, clear first", name);
+        } else if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " bytes of emulator memory as " _YELLOW_("%s"), size, name);
+        } else {
+            PrintAndLogEx(FAILED, "Saving snapshot failed ( %d )", res);
+        }
+        return res;
+    }
+
+    if (load) {
+        res = mfEmlSnapshot(EML_SNAPSHOT_LOAD, name, 0, &resp);
+        if (res == PM3_ENODATA) {
+            PrintAndLogEx(FAILED, "No snapshot named " _YELLOW_("%s"), name);
+        } else if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Loaded snapshot " _YELLOW_("%s") " into emulator memory", name);
+        } else {
+            PrintAndLogEx(FAILED, "Loading snapshot failed ( %d )", res);
+        }
+        return res;
+    }
+
+    if (clear) {
+        res = mfEmlSnapshot(EML_SNAPSHOT_CLEAR, NULL, 0, &resp);
+        if (res == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Snapshots cleared");
+        }
+        return res;
+    }
+
+    res = mfEmlSnapshot(EML_SNAPSHOT_LIST, NULL, 0, &resp);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Listing snapshots failed ( %d )", res);
+        return res;
+    }
+
+    size_t n = resp.length / sizeof(eml_snapshot_info_t);
+    if (n == 0) {
+        PrintAndLogEx(INFO, "No snapshots");
+        return PM3_SUCCESS;
+    }
+
+    const eml_snapshot_info_t *list = (const eml_snapshot_info_t *)resp.data.asBytes;
+    PrintAndLogEx(INFO, " # | name             | bytes");
+    PrintAndLogEx(INFO, "---+------------------+-------");
+    for (size_t i = 0; i < n; i++) {
+        PrintAndLogEx(INFO, "%2zu | %-16.16s | %5u", i, list[i].name, list[i].size);
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdHF14AMfESave(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -5200,110 +6263,55 @@ static int CmdHF14AMfCLoad(const char *Cmd) {
     }
 
 
-    if (fill_from_emulator) {
-
-        PrintAndLogEx(INFO, "Start upload to emulator memory");
-        PrintAndLogEx(INFO, "." NOLF);
-
-        for (int b = 0; b < block_cnt; b++) {
-            int flags = 0;
-            uint8_t buf8[MFBLOCK_SIZE] = {0x00};
-
-            // read from emul memory
-            if (mfEmlGetMem(buf8, b, 1)) {
-                PrintAndLogEx(WARNING, "Can't read from emul block: %d", b);
-                return PM3_ESOFT;
-            }
-
-            // switch on field and send magic sequence
-            if (b == 0) {
-                flags = MAGIC_INIT + MAGIC_WUPC;
-            }
-
-            // just write
-            if (b == 1) {
-                flags = 0;
-            }
-
-            // Done. Magic Halt and switch off field.
-            if (b == (block_cnt - 1)) {
-                flags = MAGIC_HALT + MAGIC_OFF;
-            }
+    uint8_t *data = NULL;
+    size_t bytes_read = 0;
 
-            // write to card
-            if (mfCSetBlock(b, buf8, NULL, flags)) {
-                PrintAndLogEx(WARNING, "Can't set magic card block: %d", b);
-                return PM3_ESOFT;
-            }
-            PrintAndLogEx(NORMAL, "." NOLF);
-            fflush(stdout);
+    if (fill_from_emulator) {
+        data = calloc(block_cnt * MFBLOCK_SIZE, sizeof(uint8_t));
+        if (data == NULL) {
+            PrintAndLogEx(WARNING, "Fail, cannot allocate memory");
+            return PM3_EMALLOC;
         }
-        PrintAndLogEx(NORMAL, "");
-        return PM3_SUCCESS;
-    }
 
-    // reserve memory
-    uint8_t *data = NULL;
-    size_t bytes_read = 0;
-    int res = pm3_load_dump(filename, (void **)&data, &bytes_read, (MFBLOCK_SIZE * block_cnt));
-    if (res != PM3_SUCCESS) {
-        return res;
+        PrintAndLogEx(INFO, "downloading emulator memory");
+        if (GetFromDevice(BIG_BUF_EML, data, block_cnt * MFBLOCK_SIZE, 0, NULL, 0, NULL, 2500, false) == false) {
+            PrintAndLogEx(WARNING, "Fail, transfer from device time-out");
+            free(data);
+            return PM3_ETIMEOUT;
+        }
+        bytes_read = block_cnt * MFBLOCK_SIZE;
+    } else {
+        int res = pm3_load_dump(filename, (void **)&data, &bytes_read, (MFBLOCK_SIZE * block_cnt));
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
     }
 
+    // confirm number written blocks. Must be 20, 64 or 256 blocks
     if (bytes_read != (block_cnt * MFBLOCK_SIZE)) {
-        PrintAndLogEx(ERR, "File content error. Read %zu bytes", bytes_read);
+        PrintAndLogEx(ERR, "File content error. Read %zu bytes, there must be %d blocks", bytes_read, block_cnt);
         free(data);
         return PM3_EFILE;
     }
 
     PrintAndLogEx(INFO, "Copying to magic gen1a card");
-    PrintAndLogEx(INFO, "." NOLF);
-
-    int blockno = 0;
-    int flags = 0;
-    while (bytes_read) {
-
-        // switch on field and send magic sequence
-        if (blockno == 0) {
-            flags = MAGIC_INIT + MAGIC_WUPC;
-        }
-
-        // write
-        if (blockno == 1) {
-            flags = 0;
-        }
-
-        // switch off field
-        if (blockno == (block_cnt - 1)) {
-            flags = MAGIC_HALT + MAGIC_OFF;
-        }
-
-        if (mfCSetBlock(blockno, data + (MFBLOCK_SIZE * blockno), NULL, flags)) {
-            PrintAndLogEx(WARNING, "Can't set magic card block: %d", blockno);
-            free(data);
-            return PM3_ESOFT;
-        }
-
-        bytes_read -= MFBLOCK_SIZE;
-
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
-
-        blockno++;
-
-        if (blockno >= block_cnt) break;
-    }
-    PrintAndLogEx(NORMAL, "\n");
 
+    // the device writes all blocks in one backdoor session and reads them back
+    uint16_t failed = 0;
+    int res = mfMagicLoadBulk(MF_MAGIC_BULK_GEN1A, NULL, data, block_cnt, 0, block_cnt - 1, &failed);
     free(data);
 
-    // confirm number written blocks. Must be 20, 64 or 256 blocks
-    if (blockno != block_cnt) {
-        PrintAndLogEx(ERR, "File content error. There must be %d blocks", block_cnt);
-        return PM3_EFILE;
+    if (res == PM3_EFAILED) {
+        PrintAndLogEx(WARNING, "Verify failed at magic card block: %d", failed);
+        return PM3_ESOFT;
+    }
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Can't set magic card block: %d. error=%d", failed, res);
+        return PM3_ESOFT;
     }
 
-    PrintAndLogEx(SUCCESS, "Card loaded " _YELLOW_("%d") " blocks from file", block_cnt);
+    PrintAndLogEx(SUCCESS, "Card loaded " _YELLOW_("%d") " blocks from %s", block_cnt,
+                  (fill_from_emulator ? "emulator memory" : "file"));
     PrintAndLogEx(INFO, "Done!");
     return PM3_SUCCESS;
 }
@@ -7046,18 +8054,47 @@ static int CmdHf14AGen3Freeze(const char *Cmd) {
 }
 
 #define FURUI_MAX_TRACES    8
+#define FURUI_MAX_PAIRS     (FURUI_MAX_TRACES * (FURUI_MAX_TRACES - 1) / 2)
+
+// crack all trace pairs at once, then report the first key found for every trace
+static void mfc_trace_pairs_recovery(nonces_t *data, const uint8_t *owner, uint32_t pairs, uint8_t tracedata[FURUI_MAX_TRACES][18]) {
+    uint64_t keys[FURUI_MAX_PAIRS];
+    bool found[FURUI_MAX_PAIRS];
+
+    mfkey32_moebius_batch(data, pairs, keys, found);
+
+    int last = -1;
+    for (uint32_t k = 0; k < pairs; k++) {
+        if (found[k] == false || owner[k] == last) {
+            continue;
+        }
+        last = owner[k];
+
+        PrintAndLogEx(SUCCESS, "UID: %s Sector %02x key %c [ "_GREEN_("%012" PRIX64) " ]",
+                      sprint_hex_inrow(tracedata[owner[k]], 4),
+                      data[k].sector,
+                      (data[k].keytype == 0x60) ? 'A' : 'B',
+                      keys[k]
+                     );
+    }
+}
+
 static int mfc_furui_recovery(uint8_t items, uint8_t tracedata[FURUI_MAX_TRACES][18]) {
+    nonces_t data[FURUI_MAX_PAIRS];
+    uint8_t owner[FURUI_MAX_PAIRS];
+    uint32_t pairs = 0;
+
     // recover key from collected traces
     // outer loop
     for (uint8_t i = 0; i < items; i++) {
 
         // first
-        nonces_t data;
-        data.cuid = bytes_to_num(tracedata[i], 4);
-        data.nonce = bytes_to_num(tracedata[i] + 6, 4);
-        data.nr = bytes_to_num(tracedata[i] + 10, 4);
-        data.ar = bytes_to_num(tracedata[i] + 14, 4);
-        data.at = 0;
+        nonces_t first;
+        first.cuid = bytes_to_num(tracedata[i], 4);
+        first.nonce = bytes_to_num(tracedata[i] + 6, 4);
+        first.nr = bytes_to_num(tracedata[i] + 10, 4);
+        first.ar = bytes_to_num(tracedata[i] + 14, 4);
+        first.at = 0;
 
         // inner loop
         for (uint8_t j = i + 1; j < items; j++) {
@@ -7070,42 +8107,40 @@ static int mfc_furui_recovery(uint8_t items, uint8_t tracedata[FURUI_MAX_TRACES]
             uint8_t s = mfSectorNum(tracedata[i][4]);
             if (mfSectorNum(p[4]) == s) {
 
-                data.nonce2 = bytes_to_num(p + 6, 4);
-                data.nr2 = bytes_to_num(p + 10, 4);
-                data.ar2 = bytes_to_num(p + 14, 4);
-                data.sector = s;
-                data.keytype = tracedata[i][5];
-                data.state = FIRST;
-
-                uint64_t key64 = -1;
-                if (mfkey32_moebius(&data, &key64)) {
-                    PrintAndLogEx(SUCCESS, "UID: %s Sector %02x key %c [ "_GREEN_("%012" PRIX64) " ]",
-                                  sprint_hex_inrow(tracedata[i], 4),
-                                  data.sector,
-                                  (data.keytype == 0x60) ? 'A' : 'B',
-                                  key64
-                                 );
-                    break;
-                }
+                nonces_t *d = &data[pairs];
+                *d = first;
+                d->nonce2 = bytes_to_num(p + 6, 4);
+                d->nr2 = bytes_to_num(p + 10, 4);
+                d->ar2 = bytes_to_num(p + 14, 4);
+                d->sector = s;
+                d->keytype = tracedata[i][5];
+                d->state = FIRST;
+                owner[pairs++] = i;
             }
         }
     }
+
+    mfc_trace_pairs_recovery(data, owner, pairs, tracedata);
     return PM3_SUCCESS;
 }
 
 static int mfc_supercard_gen2_recovery(uint8_t items, uint8_t tracedata[FURUI_MAX_TRACES][18]) {
+    nonces_t data[FURUI_MAX_PAIRS];
+    uint8_t owner[FURUI_MAX_PAIRS];
+    uint32_t pairs = 0;
+
     for (uint8_t i = 0; i < items; i++) {
         uint8_t *tmp = tracedata[i];
 
         // first
         uint16_t NT0 = (tmp[6] << 8) | tmp[7];
 
-        nonces_t data;
-        data.cuid = bytes_to_num(tmp, 4);
-        data.nonce = prng_successor(NT0, 31);
-        data.nr = bytes_to_num(tmp + 8, 4);
-        data.ar = bytes_to_num(tmp + 12, 4);
-        data.at = 0;
+        nonces_t first;
+        first.cuid = bytes_to_num(tmp, 4);
+        first.nonce = prng_successor(NT0, 31);
+        first.nr = bytes_to_num(tmp + 8, 4);
+        first.ar = bytes_to_num(tmp + 12, 4);
+        first.at = 0;
 
         // second
         for (uint8_t j = i + 1; j < items; j++) {
@@ -7118,26 +8153,20 @@ static int mfc_supercard_gen2_recovery(uint8_t items, uint8_t tracedata[FURUI_MA
 
                 NT0 = (p[6] << 8) | p[7];
 
-                data.nonce2 = prng_successor(NT0, 31);
-                data.nr2 = bytes_to_num(p + 8, 4);
-                data.ar2 = bytes_to_num(p + 12, 4);
-                data.sector = s;
-                data.keytype = tmp[4];
-                data.state = FIRST;
-
-                uint64_t key64 = -1;
-                if (mfkey32_moebius(&data, &key64)) {
-                    PrintAndLogEx(SUCCESS, "UID: %s Sector %02x key %c [ "_GREEN_("%012" PRIX64) " ]",
-                                  sprint_hex_inrow(tmp, 4),
-                                  data.sector,
-                                  (data.keytype == 0x60) ? 'A' : 'B',
-                                  key64
-                                 );
-                    break;
-                }
+                nonces_t *d = &data[pairs];
+                *d = first;
+                d->nonce2 = prng_successor(NT0, 31);
+                d->nr2 = bytes_to_num(p + 8, 4);
+                d->ar2 = bytes_to_num(p + 12, 4);
+                d->sector = s;
+                d->keytype = tmp[4];
+                d->state = FIRST;
+                owner[pairs++] = i;
             }
         }
     }
+
+    mfc_trace_pairs_recovery(data, owner, pairs, tracedata);
     return PM3_SUCCESS;
 }
 
@@ -7565,31 +8594,49 @@ static int CmdHF14AMfView(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf view",
-                  "Print a MIFARE Classic dump file (bin/eml/json)",
-                  "hf mf view -f hf-mf-01020304-dump.bin"
+                  "Print a MIFARE Classic dump file (bin/eml/json) or a dump from the dump store",
+                  "hf mf view -f hf-mf-01020304-dump.bin\n"
+                  "hf mf view --uid 01020304              -> from the dump store"
                  );
     void *argtable[] = {
         arg_param_begin,
-        arg_str1("f", "file", "<fn>", "Specify a filename for dump file"),
+        arg_str0("f", "file", "<fn>", "Specify a filename for dump file"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0(NULL, "sk", "Save extracted keys to binary file"),
+        arg_str0("u", "uid", "<hex>", "load the dump of this uid from the dump store"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
     int fnlen = 0;
-    char filename[FILE_PATH_SIZE];
+    char filename[FILE_PATH_SIZE] = {0};
     CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     bool verbose = arg_get_lit(ctx, 2);
     bool save_keys = arg_get_lit(ctx, 3);
+    int uidlen = 0;
+    char uid[21] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)uid, sizeof(uid) - 1, &uidlen);
     CLIParserFree(ctx);
 
+    if ((fnlen == 0) == (uidlen == 0)) {
+        PrintAndLogEx(WARNING, "specify one of " _YELLOW_("-f") " or " _YELLOW_("--uid"));
+        return PM3_EINVARG;
+    }
+
     // read dump file
     uint8_t *dump = NULL;
     size_t bytes_read = 0;
-    int res = pm3_load_dump(filename, (void **)&dump, &bytes_read, MIFARE_4K_MAX_BYTES);
+    int res;
+    if (uidlen) {
+        res = dumpstore_get(uid, &dump, &bytes_read);
+    } else {
+        res = pm3_load_dump(filename, (void **)&dump, &bytes_read, MIFARE_4K_MAX_BYTES);
+    }
     if (res != PM3_SUCCESS) {
         return res;
     }
+    if (bytes_read > MIFARE_4K_MAX_BYTES) {
+        bytes_read = MIFARE_4K_MAX_BYTES;
+    }
 
     uint16_t block_cnt = MIN(MIFARE_1K_MAXBLOCK, (bytes_read / MFBLOCK_SIZE));
     if (bytes_read == MIFARE_MINI_MAX_BYTES)
@@ -8115,33 +9162,20 @@ static int CmdHF14AGen4Load(const char *cmd) {
     PrintAndLogEx(INFO, "Copying to magic gen4 GTU MIFARE Classic " _GREEN_("%s"), s);
     PrintAndLogEx(INFO, "Starting block: %d. Ending block: %d.", start, end);
 
-    // copy to card
-    for (uint16_t blockno = start; blockno <= end; blockno++) {
-
-        // 4k writes can be long, so we split status each 64 block boundary.
-        if (blockno % 64 == 0 || blockno == start) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(INFO, "" NOLF) ;
-        }
-        PrintAndLogEx(NORMAL, "." NOLF);
-        fflush(stdout);
-
-        // write block
-        uint8_t flags = 0 ;
-        if (blockno == start) flags |= MAGIC_INIT ;
-        if (blockno == end)   flags |= MAGIC_OFF ;
+    // the device writes all blocks in one session and reads them back
+    uint16_t failed = 0;
+    int res = mfMagicLoadBulk(MF_MAGIC_BULK_GEN4, pwd, data, block_cnt, start, end, &failed);
+    free(data);
 
-        int res = mfG4SetBlock(pwd, blockno, data + (blockno * MFBLOCK_SIZE), flags);
-        if (res !=  PM3_SUCCESS) {
-            PrintAndLogEx(WARNING, "Can't set magic card block: %d. error=%d", blockno, res);
-            PrintAndLogEx(HINT, "Verify your card size, and try again or try another tag position");
-            free(data);
-            return PM3_ESOFT;
-        }
+    if (res == PM3_EFAILED) {
+        PrintAndLogEx(WARNING, "Verify failed at magic card block: %d", failed);
+        return PM3_ESOFT;
+    }
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Can't set magic card block: %d. error=%d", failed, res);
+        PrintAndLogEx(HINT, "Verify your card size, and try again or try another tag position");
+        return PM3_ESOFT;
     }
-    PrintAndLogEx(NORMAL, "\n");
-
-    if (data != NULL) free(data);
 
     PrintAndLogEx(SUCCESS, "Card loaded " _YELLOW_("%d") " blocks from %s", end - start + 1,
                   (fill_from_emulator ? "emulator memory" : "file"));
@@ -9548,6 +10582,9 @@ static command_t CommandTable[] = {
     {"darkside",    CmdHF14AMfDarkside,     IfPm3Iso14443a,  "Darkside attack"},
     {"nested",      CmdHF14AMfNested,       IfPm3Iso14443a,  "Nested attack"},
     {"hardnested",  CmdHF14AMfNestedHard,   AlwaysAvailable, "Nested attack for hardened MIFARE Classic cards"},
+    {"hardbench",   CmdHF14AMfHardBench,    AlwaysAvailable, "Benchmark the hardnested attack on fixed nonce sets"},
+    {"hardserve",   CmdHF14AMfHardServe,    AlwaysAvailable, "Hardnested crack server for nonce files of other clients"},
+    {"hardworker",  CmdHF14AMfHardWorker,   AlwaysAvailable, "Brute force worker for `hf mf hardnested --dist`"},
     {"staticnested", CmdHF14AMfNestedStatic, IfPm3Iso14443a, "Nested attack against static nonce MIFARE Classic cards"},
     {"brute",       CmdHF14AMfSmartBrute,   IfPm3Iso14443a,  "Smart bruteforce to exploit weak key generators"},
     {"autopwn",     CmdHF14AMfAutoPWN,      IfPm3Iso14443a,  "Automatic key recovery tool for MIFARE Classic"},
@@ -9581,6 +10618,7 @@ static command_t CommandTable[] = {
     {"eload",       CmdHF14AMfELoad,        IfPm3Iso14443a,  "Upload file into emulator memory"},
     {"esave",       CmdHF14AMfESave,        IfPm3Iso14443a,  "Save emulator memory to file"},
     {"esetblk",     CmdHF14AMfESet,         IfPm3Iso14443a,  "Set emulator memory block"},
+    {"esnap",       CmdHF14AMfESnap,        IfPm3Iso14443a,  "Named emulator memory snapshots in device RAM"},
     {"eview",       CmdHF14AMfEView,        IfPm3Iso14443a,  "View emulator memory"},
     {"-----------", CmdHelp,                IfPm3Iso14443a,  "----------------------- " _CYAN_("magic gen1") " -----------------------"},
     {"cgetblk",     CmdHF14AMfCGetBlk,      IfPm3Iso14443a,  "Read block from card"},
@@ -969,6 +969,33 @@ static void DesFill2bPattern(
     (*startPattern)++;
 }
 
+// Tries the keys on keyno.  Returns PM3_SUCCESS with the index of the key found or -1,  PM3_ESOFT when
+// the card didn't start authentications with the key number / type at all.
+static int AuthCheckDesfireKeys(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, uint8_t keyno, DesfireCryptoAlgorithm keyType,
+                                uint8_t *keys, size_t keylen, uint32_t keysCount, int32_t *found) {
+    *found = -1;
+
+    // the device runs the authentication rounds itself where it can
+    dctx->keyNum = keyno;
+    int res = DesfireCheckKeys(dctx, secureChannel, keyType, keys, keylen, keysCount, found);
+    if (res == PM3_SUCCESS || res == PM3_EOPABORTED)
+        return res;
+    if (res != PM3_ENOTIMPL)
+        return PM3_ESOFT;
+
+    for (uint32_t curkey = 0; curkey < keysCount; curkey++) {
+        DesfireSetKeyNoClear(dctx, keyno, keyType, &keys[curkey * keylen]);
+        res = DesfireAuthenticate(dctx, secureChannel, false);
+        if (res == PM3_SUCCESS) {
+            *found = curkey;
+            return PM3_SUCCESS;
+        } else if (res < 7) {
+            return PM3_ESOFT;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 static int AuthCheckDesfire(DesfireContext_t *dctx,
                             DesfireSecureChannel secureChannel,
                             const uint8_t *aid,
@@ -1058,34 +1085,28 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         PrintAndLogEx(NORMAL, "");
     }
 
-    bool badlen = false;
-
     if (des) {
 
         for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
 
             if (usedkeys[keyno] == 1 && foundKeys[0][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < deskeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_DES, deskeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found DES Key %02u          : " _GREEN_("%s"), curaid, keyno, sprint_hex(deskeyList[curkey], 8));
-                        foundKeys[0][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[0][keyno][1], deskeyList[curkey], 8);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
+                int32_t found = -1;
+                res = AuthCheckDesfireKeys(dctx, secureChannel, keyno, T_DES, deskeyList[0], 8, deskeyListLen, &found);
+                if (res == PM3_EOPABORTED) {
+                    DropField();
+                    return res;
                 }
-                if (badlen == true) {
-                    badlen = false;
+                if (res == PM3_SUCCESS && found >= 0) {
+                    PrintAndLogEx(SUCCESS, "AID 0x%06X, Found DES Key %02u          : " _GREEN_("%s"), curaid, keyno, sprint_hex(deskeyList[found], 8));
+                    foundKeys[0][keyno][0] = 0x01;
+                    *result = true;
+                    memcpy(&foundKeys[0][keyno][1], deskeyList[found], 8);
+                } else if (res != PM3_SUCCESS) {
+                    DropField();
+                    res = DesfireSelectAIDHex(dctx, curaid, false, 0);
+                    if (res != PM3_SUCCESS) {
+                        return res;
+                    }
                     break;
                 }
             }
@@ -1097,27 +1118,23 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
 
             if (usedkeys[keyno] == 1 && foundKeys[1][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < aeskeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_3DES, aeskeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 2TDEA Key %02u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[curkey], 16));
-                        foundKeys[1][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[1][keyno][1], aeskeyList[curkey], 16);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
+                int32_t found = -1;
+                res = AuthCheckDesfireKeys(dctx, secureChannel, keyno, T_3DES, aeskeyList[0], 16, aeskeyListLen, &found);
+                if (res == PM3_EOPABORTED) {
+                    DropField();
+                    return res;
                 }
-                if (badlen == true) {
-                    badlen = false;
+                if (res == PM3_SUCCESS && found >= 0) {
+                    PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 2TDEA Key %02u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[found], 16));
+                    foundKeys[1][keyno][0] = 0x01;
+                    *result = true;
+                    memcpy(&foundKeys[1][keyno][1], aeskeyList[found], 16);
+                } else if (res != PM3_SUCCESS) {
+                    DropField();
+                    res = DesfireSelectAIDHex(dctx, curaid, false, 0);
+                    if (res != PM3_SUCCESS) {
+                        return res;
+                    }
                     break;
                 }
             }
@@ -1129,27 +1146,23 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
 
             if (usedkeys[keyno] == 1 && foundKeys[2][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < aeskeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_AES, aeskeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found AES Key %02u          : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[curkey], 16));
-                        foundKeys[2][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[2][keyno][1], aeskeyList[curkey], 16);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
+                int32_t found = -1;
+                res = AuthCheckDesfireKeys(dctx, secureChannel, keyno, T_AES, aeskeyList[0], 16, aeskeyListLen, &found);
+                if (res == PM3_EOPABORTED) {
+                    DropField();
+                    return res;
                 }
-                if (badlen == true) {
-                    badlen = false;
+                if (res == PM3_SUCCESS && found >= 0) {
+                    PrintAndLogEx(SUCCESS, "AID 0x%06X, Found AES Key %02u          : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[found], 16));
+                    foundKeys[2][keyno][0] = 0x01;
+                    *result = true;
+                    memcpy(&foundKeys[2][keyno][1], aeskeyList[found], 16);
+                } else if (res != PM3_SUCCESS) {
+                    DropField();
+                    res = DesfireSelectAIDHex(dctx, curaid, false, 0);
+                    if (res != PM3_SUCCESS) {
+                        return res;
+                    }
                     break;
                 }
             }
@@ -1161,32 +1174,29 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
 
             if (usedkeys[keyno] == 1 && foundKeys[3][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < k3kkeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_3K3DES, k3kkeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 3TDEA Key %02u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(k3kkeyList[curkey], 24));
-                        foundKeys[3][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[3][keyno][1], k3kkeyList[curkey], 16);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
+                int32_t found = -1;
+                res = AuthCheckDesfireKeys(dctx, secureChannel, keyno, T_3K3DES, k3kkeyList[0], 24, k3kkeyListLen, &found);
+                if (res == PM3_EOPABORTED) {
+                    DropField();
+                    return res;
                 }
-
-                if (badlen == true) {
+                if (res == PM3_SUCCESS && found >= 0) {
+                    PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 3TDEA Key %02u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(k3kkeyList[found], 24));
+                    foundKeys[3][keyno][0] = 0x01;
+                    *result = true;
+                    memcpy(&foundKeys[3][keyno][1], k3kkeyList[found], 16);
+                } else if (res != PM3_SUCCESS) {
+                    DropField();
+                    res = DesfireSelectAIDHex(dctx, curaid, false, 0);
+                    if (res != PM3_SUCCESS) {
+                        return res;
+                    }
                     break;
                 }
             }
         }
     }
+
     DropField();
     return PM3_SUCCESS;
 }
@@ -2098,6 +2108,53 @@ static int CmdHF14ADesSelectApp(const char *Cmd) {
     return res;
 }
 
+// the select loop runs on the device,  found AIDs and progress come streamed
+static int DesfireBruteAppsDevice(uint32_t idStart, uint32_t idEnd, uint32_t idIncrement, uint8_t maxfound) {
+    mfdes_bruteaid_req_t payload = {
+        .start = idStart,
+        .end = idEnd,
+        .step = idIncrement,
+        .maxfound = maxfound,
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_DESFIRE_BRUTEAID, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    bool aborted = false;
+    while (true) {
+        if (WaitForResponseTimeout(CMD_HF_DESFIRE_BRUTEAID, &resp, 3000) == false) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(WARNING, "timeout while waiting for reply.");
+            return PM3_ETIMEOUT;
+        }
+
+        const mfdes_bruteaid_resp_t *r = (const mfdes_bruteaid_resp_t *)resp.data.asBytes;
+        for (uint8_t i = 0; i < r->count && i < MFDES_BRUTEAID_REPLY_AIDS; i++) {
+            printf("\33[2K\r"); // clear current line before printing
+            PrintAndLogEx(SUCCESS, "Got new APPID %06X", r->aids[i]);
+        }
+
+        if (r->done)
+            break;
+
+        int progress = (idEnd > idStart) ? ((uint64_t)(r->next - idStart) * 100) / (idEnd - idStart) : 100;
+        PrintAndLogEx(INPLACE, "Progress: %d %%, current AID: %06X", progress, r->next);
+
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            aborted = true;
+        }
+    }
+
+    if (resp.status == PM3_EOPABORTED) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "Aborted at AID %06X", ((const mfdes_bruteaid_resp_t *)resp.data.asBytes)->next);
+        return PM3_SUCCESS;
+    }
+    return resp.status;
+}
+
 static int CmdHF14ADesBruteApps(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfdes bruteaid",
@@ -2156,8 +2213,42 @@ static int CmdHF14ADesBruteApps(const char *Cmd) {
         PrintAndLogEx(ERR, "Start should be lower than end. start: %06x end: %06x", idStart, idEnd);
         return PM3_EINVARG;
     }
+    if (idIncrement == 0) {
+        PrintAndLogEx(ERR, "Step must not be zero");
+        return PM3_EINVARG;
+    }
+
+    // when the card lists its applications,  the search stops once it found all of those in the range
+    uint8_t buf[250] = {0};
+    size_t buflen = 0;
+    int maxfound = -1;
+    if (DesfireGetAIDList(&dctx, buf, &buflen) == PM3_SUCCESS) {
+        maxfound = 0;
+        for (size_t i = 0; i + 3 <= buflen; i += 3) {
+            uint32_t aid = DesfireAIDByteToUint(&buf[i]);
+            if (aid >= idStart && aid <= idEnd && ((aid - idStart) % idIncrement) == 0)
+                maxfound++;
+        }
+        PrintAndLogEx(INFO, "Card lists " _YELLOW_("%zu") " applications, %d of them in the range", buflen / 3, maxfound);
+        if (maxfound == 0) {
+            PrintAndLogEx(SUCCESS, _GREEN_("Done"));
+            DropField();
+            return PM3_SUCCESS;
+        }
+    }
+
     PrintAndLogEx(INFO, "Bruteforce from %06x to %06x", idStart, idEnd);
     PrintAndLogEx(INFO, "Enumerating through all AIDs manually, this will take a while!");
+
+    if (dctx.cmdSet == DCCNativeISO) {
+        res = DesfireBruteAppsDevice(idStart, idEnd, idIncrement, (maxfound > 0) ? MIN(maxfound, UINT8_MAX) : 0);
+        PrintAndLogEx(NORMAL, "");
+        if (res == PM3_SUCCESS)
+            PrintAndLogEx(SUCCESS, _GREEN_("Done"));
+        DropField();
+        return res;
+    }
+
     for (uint32_t id = idStart; id <= idEnd && id >= idStart; id += idIncrement) {
         if (kbd_enter_pressed()) break;
 
@@ -2169,6 +2260,8 @@ static int CmdHF14ADesBruteApps(const char *Cmd) {
         if (res == PM3_SUCCESS) {
             printf("\33[2K\r"); // clear current line before printing
             PrintAndLogEx(SUCCESS, "Got new APPID %06X", id);
+            if (maxfound > 0 && --maxfound == 0)
+                break;
         }
     }
 
@@ -4782,10 +4875,33 @@ static int DesfileReadISOFileAndPrint(DesfireContext_t *dctx,
     return PM3_SUCCESS;
 }
 
-static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
-                                   uint8_t fnum, int filetype,
-                                   uint32_t offset, uint32_t length,
-                                   uint32_t maxdatafilelength, bool noauth, bool verbose) {
+// file content read ahead by the dump batch
+typedef struct {
+    int res;            // PM3_ENODATA when not read ahead
+    uint8_t *data;
+    size_t len;
+    uint32_t value;
+} DesfireFilePrefetch_t;
+
+static DesfireCommunicationMode DesfireFileReadCommMode(DesfireContext_t *dctx, FileSettings_t *fsettings, int filetype) {
+    DesfireCommunicationMode commMode = fsettings->commMode;
+    // lrp needs to point exact mode
+    if (dctx->secureChannel == DACLRP) {
+        // read right == free
+        if (fsettings->rAccess == 0xe)
+            commMode = DCMPlain;
+        // get value access == free
+        if (filetype == RFTValue && (fsettings->limitedCredit & 0x02) != 0)
+            commMode = DCMPlain;
+    }
+    return commMode;
+}
+
+static int DesfileReadFileAndPrintEx(DesfireContext_t *dctx,
+                                     uint8_t fnum, int filetype,
+                                     uint32_t offset, uint32_t length,
+                                     uint32_t maxdatafilelength, bool noauth, bool verbose,
+                                     FileSettings_t *known, DesfireFilePrefetch_t *pre) {
 
     int res;
     // length of record for record file
@@ -4799,9 +4915,14 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
         FileSettings_t fsettings;
 
         DesfireCommunicationMode commMode = dctx->commMode;
-        DesfireSetCommMode(dctx, DCMMACed);
-        res = DesfireFileSettingsStruct(dctx, fnum, &fsettings);
-        DesfireSetCommMode(dctx, commMode);
+        if (known) {
+            fsettings = *known;
+            res = PM3_SUCCESS;
+        } else {
+            DesfireSetCommMode(dctx, DCMMACed);
+            res = DesfireFileSettingsStruct(dctx, fnum, &fsettings);
+            DesfireSetCommMode(dctx, commMode);
+        }
 
         if (res == PM3_SUCCESS) {
             switch (fsettings.fileType) {
@@ -4829,16 +4950,7 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
                 }
             }
 
-            commMode = fsettings.commMode;
-            // lrp needs to point exact mode
-            if (dctx->secureChannel == DACLRP) {
-                // read right == free
-                if (fsettings.rAccess == 0xe)
-                    commMode = DCMPlain;
-                // get value access == free
-                if (filetype == RFTValue && (fsettings.limitedCredit & 0x02) != 0)
-                    commMode = DCMPlain;
-            }
+            commMode = DesfireFileReadCommMode(dctx, &fsettings, filetype);
 
             // calc max length
             if (filetype == RFTData && maxdatafilelength && (maxdatafilelength < fsettings.fileSize)) {
@@ -4878,8 +4990,17 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
     }
     size_t resplen = 0;
 
+    if (pre && pre->res != PM3_ENODATA) {
+        res = pre->res;
+        if (res == PM3_SUCCESS && filetype == RFTData) {
+            memcpy(resp, pre->data, pre->len);
+            resplen = pre->len;
+        }
+    }
+
     if (filetype == RFTData) {
-        res = DesfireReadFile(dctx, fnum, offset, length, resp, &resplen);
+        if (pre == NULL || pre->res == PM3_ENODATA)
+            res = DesfireReadFile(dctx, fnum, offset, length, resp, &resplen);
         if (res != PM3_SUCCESS) {
             PrintAndLogEx(ERR, "Desfire ReadFile command " _RED_("error") ". Result: %d", res);
             DropField();
@@ -4897,7 +5018,10 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
 
     if (filetype == RFTValue) {
         uint32_t value = 0;
-        res = DesfireValueFileOperations(dctx, fnum, MFDES_GET_VALUE, &value);
+        if (pre && pre->res != PM3_ENODATA)
+            value = pre->value;
+        else
+            res = DesfireValueFileOperations(dctx, fnum, MFDES_GET_VALUE, &value);
         if (res != PM3_SUCCESS) {
             PrintAndLogEx(ERR, "Desfire GetValue operation " _RED_("error") ". Result: %d", res);
             DropField();
@@ -4989,6 +5113,138 @@ static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
     return PM3_SUCCESS;
 }
 
+static int DesfileReadFileAndPrint(DesfireContext_t *dctx,
+                                   uint8_t fnum, int filetype,
+                                   uint32_t offset, uint32_t length,
+                                   uint32_t maxdatafilelength, bool noauth, bool verbose) {
+    return DesfileReadFileAndPrintEx(dctx, fnum, filetype, offset, length, maxdatafilelength, noauth, verbose, NULL, NULL);
+}
+
+static void DesfireDumpPrefetchFree(DesfireFilePrefetch_t *pre, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(pre[i].data);
+        pre[i].data = NULL;
+    }
+}
+
+// Reads data and value files from FileList[from] on in one batch,  up to the first file which has to be
+// read the usual way.  Returns the index after the last file planned.
+static size_t DesfireDumpPrefetch(DesfireContext_t *dctx, FileList_t FileList, size_t filescount, size_t from,
+                                  uint32_t maxdatafilelength, bool noauth, DesfireFilePrefetch_t *pre) {
+
+    // iso chaining works in the lrp mode
+    dctx->isoChaining |= (dctx->secureChannel == DACLRP);
+
+    size_t ncmds = 0;
+    size_t to = from;
+    for (; to < filescount; to++) {
+        FileSettings_t *fs = &FileList[to].fileSettings;
+        free(pre[to].data);
+        pre[to].data = NULL;
+        pre[to].len = 0;
+        pre[to].res = PM3_ENODATA;
+
+        int filetype = (fs->fileType == 0x02) ? RFTValue : RFTData;
+        if (fs->fileType > 0x02)
+            break;
+
+        // files which will fail anyway go the usual way,  a failing command stops the batch
+        bool freeread = (fs->rAccess == 0x0e || fs->rwAccess == 0x0e);
+        if (noauth && freeread == false)
+            break;
+        if (freeread == false && fs->rAccess != dctx->keyNum && fs->rwAccess != dctx->keyNum)
+            break;
+        if (DesfireBatchAvailable(dctx, DesfireFileReadCommMode(dctx, fs, filetype)) == false)
+            break;
+
+        if (filetype == RFTValue) {
+            ncmds++;
+            continue;
+        }
+
+        size_t len = fs->fileSize;
+        if (maxdatafilelength && maxdatafilelength < len)
+            len = maxdatafilelength;
+        if (len == 0 || len > DESFIRE_BUFFER_SIZE)
+            break;
+        ncmds += (len + DESFIRE_BATCH_READ_CHUNK - 1) / DESFIRE_BATCH_READ_CHUNK;
+    }
+
+    if (ncmds == 0)
+        return from + 1;
+
+    DesfireBatchCmd_t *cmds = calloc(ncmds, sizeof(DesfireBatchCmd_t));
+    if (cmds == NULL)
+        return from + 1;
+
+    size_t n = 0;
+    for (size_t i = from; i < to; i++) {
+        FileSettings_t *fs = &FileList[i].fileSettings;
+        if (fs->fileType == 0x02) {
+            cmds[n].cmd = MFDES_GET_VALUE;
+            cmds[n].data[0] = FileList[i].fileNum;
+            cmds[n].datalen = 1;
+            cmds[n].commMode = DesfireFileReadCommMode(dctx, fs, RFTValue);
+            n++;
+            continue;
+        }
+
+        pre[i].len = fs->fileSize;
+        if (maxdatafilelength && maxdatafilelength < pre[i].len)
+            pre[i].len = maxdatafilelength;
+        pre[i].data = calloc(pre[i].len, sizeof(uint8_t));
+        if (pre[i].data == NULL) {
+            to = i;
+            break;
+        }
+
+        for (size_t offset = 0; offset < pre[i].len; offset += DESFIRE_BATCH_READ_CHUNK) {
+            size_t len = MIN(pre[i].len - offset, DESFIRE_BATCH_READ_CHUNK);
+            cmds[n].cmd = (dctx->isoChaining) ? MFDES_READ_DATA2 : MFDES_READ_DATA;
+            cmds[n].data[0] = FileList[i].fileNum;
+            Uint3byteToMemLe(&cmds[n].data[1], offset);
+            Uint3byteToMemLe(&cmds[n].data[4], len);
+            cmds[n].datalen = 7;
+            cmds[n].commMode = DesfireFileReadCommMode(dctx, fs, RFTData);
+            n++;
+        }
+    }
+
+    DesfireExchangeBatch(dctx, cmds, n);
+
+    // a file is read ahead when all its commands went well,  the first failed one keeps its error
+    n = 0;
+    for (size_t i = from; i < to; i++) {
+        FileSettings_t *fs = &FileList[i].fileSettings;
+        if (fs->fileType == 0x02) {
+            pre[i].res = cmds[n].res;
+            if (cmds[n].res == PM3_SUCCESS && cmds[n].resplen == 4)
+                pre[i].value = MemLeToUint4byte(cmds[n].resp);
+            else if (cmds[n].res == PM3_SUCCESS)
+                pre[i].res = PM3_ENODATA;
+            n++;
+            continue;
+        }
+
+        pre[i].res = PM3_SUCCESS;
+        for (size_t offset = 0; offset < pre[i].len; offset += DESFIRE_BATCH_READ_CHUNK) {
+            size_t len = MIN(pre[i].len - offset, DESFIRE_BATCH_READ_CHUNK);
+            if (pre[i].res == PM3_SUCCESS) {
+                if (cmds[n].res != PM3_SUCCESS)
+                    pre[i].res = cmds[n].res;
+                else if (cmds[n].resplen != len)
+                    pre[i].res = PM3_ENODATA;
+                else
+                    memcpy(&pre[i].data[offset], cmds[n].resp, len);
+            }
+            n++;
+        }
+    }
+
+    free(cmds);
+    return MAX(to, from + 1);
+}
+
 static int CmdHF14ADesReadData(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfdes read",
@@ -5727,17 +5983,28 @@ static int CmdHF14ADesDump(const char *Cmd) {
         return res;
     }
 
+    // data and value files are read in batches,  planned again after each re-authentication
+    DesfireFilePrefetch_t prefetch[ARRAYLEN(FileList)] = {0};
+    for (int i = 0; i < ARRAYLEN(prefetch); i++)
+        prefetch[i].res = PM3_ENODATA;
+    size_t prefetched = 0;
+
     res = PM3_SUCCESS;
     for (int i = 0; i < filescount; i++) {
         if (res != PM3_SUCCESS) {
             DesfireSetCommMode(&dctx, DCMPlain);
             res = DesfireSelectAndAuthenticateAppW(&dctx, securechann, selectway, id, noauth, verbose);
             if (res != PM3_SUCCESS) {
+                DesfireDumpPrefetchFree(prefetch, filescount);
                 DropField();
                 return res;
             }
+            prefetched = i;
         }
 
+        if (i >= prefetched)
+            prefetched = DesfireDumpPrefetch(&dctx, FileList, filescount, i, maxlength, noauth, prefetch);
+
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(INFO, "--------------------------------- " _CYAN_("File %02x") " ----------------------------------", FileList[i].fileNum);
         PrintAndLogEx(SUCCESS, "File ID         : " _GREEN_("%02x"), FileList[i].fileNum);
@@ -5749,9 +6016,13 @@ static int CmdHF14ADesDump(const char *Cmd) {
         }
         DesfirePrintFileSettingsExtended(&FileList[i].fileSettings);
 
-        res = DesfileReadFileAndPrint(&dctx, FileList[i].fileNum, RFTAuto, 0, 0, maxlength, noauth, verbose);
+        if (prefetch[i].res != PM3_ENODATA)
+            res = DesfileReadFileAndPrintEx(&dctx, FileList[i].fileNum, RFTAuto, 0, 0, maxlength, noauth, verbose, &FileList[i].fileSettings, &prefetch[i]);
+        else
+            res = DesfileReadFileAndPrint(&dctx, FileList[i].fileNum, RFTAuto, 0, 0, maxlength, noauth, verbose);
     }
 
+    DesfireDumpPrefetchFree(prefetch, filescount);
     DropField();
     return PM3_SUCCESS;
 }
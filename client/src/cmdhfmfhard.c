@@ -32,6 +32,12 @@
 #include <time.h> // MingW
 #include <lz4frame.h>
 #include <bzlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "commonutil.h"  // ARRAYLEN
 #include "comms.h"
@@ -44,9 +50,13 @@
 #include "hardnested_bf_core.h"
 #include "hardnested_bitarray_core.h"
 #include "fileutils.h"
+#include "util.h"          // kbd_enter_pressed
+#include "jansson.h"
+#include "threadpool.h"
+#include "pm3metrics.h"
 
-#define NUM_CHECK_BITFLIPS_THREADS      (num_CPUs())
-#define NUM_REDUCTION_WORKING_THREADS   (num_CPUs())
+#define NUM_CHECK_BITFLIPS_THREADS      (threadpool_size())
+#define NUM_REDUCTION_WORKING_THREADS   (threadpool_size())
 
 // ignore bitflip arrays which have nearly only valid states
 #define IGNORE_BITFLIP_THRESHOLD        0.9901
@@ -56,6 +66,13 @@
 #define STATE_FILE_TEMPLATE_LZ4         "bitflip_%d_%03" PRIx16 "_states.bin.lz4"
 #define STATE_FILE_TEMPLATE_BZ2         "bitflip_%d_%03" PRIx16 "_states.bin.bz2"
 
+// all effective tables decompressed into one file in the user cache directory,  mapped read-only
+// so concurrent clients share them through the page cache.  Delete it to rebuild it from the tables.
+#define STATE_CACHE_FILE                "hardnested_tables.bin"
+#define STATE_CACHE_MAGIC               "PM3HNTB1"
+#define STATE_CACHE_ALIGN               4096
+#define STATE_BITARRAY_SIZE             (sizeof(uint32_t) * (1 << 19))
+
 #define DEBUG_KEY_ELIMINATION
 // #define DEBUG_REDUCTION
 
@@ -227,6 +244,30 @@ static inline uint32_t next_state(uint32_t *bitarray, uint32_t state) {
 static uint32_t *bitflip_bitarrays[2][0x400];
 static uint32_t count_bitflip_bitarrays[2][0x400];
 
+// crack server mode,  the precomputed tables survive between mfnestedhard() runs
+static bool tables_keep_warm = false;
+static bool tables_warm = false;
+
+typedef struct {
+    char magic[8];
+    uint32_t bitarray_size;
+    uint32_t threshold;         // IGNORE_BITFLIP_THRESHOLD in ppm
+    uint32_t num_tables;
+    uint32_t data_offset;
+} PACKED state_cache_header_t;
+
+typedef struct {
+    uint16_t odd_even;
+    uint16_t bitflip;
+    uint32_t count;
+    uint64_t offset;
+} PACKED state_cache_entry_t;
+
+#ifndef _WIN32
+static uint8_t *state_cache_map = NULL;
+static size_t state_cache_size = 0;
+#endif
+
 static int compare_count_bitflip_bitarrays(const void *b1, const void *b2) {
     uint64_t count1 = (uint64_t)count_bitflip_bitarrays[ODD_STATE][*(uint16_t *)b1] * count_bitflip_bitarrays[EVEN_STATE][*(uint16_t *)b1];
     uint64_t count2 = (uint64_t)count_bitflip_bitarrays[ODD_STATE][*(uint16_t *)b2] * count_bitflip_bitarrays[EVEN_STATE][*(uint16_t *)b2];
@@ -254,7 +295,177 @@ static void init_bunzip2(bz_stream *compressed_stream, char *input_buffer, uint3
 
 }
 
-static void init_bitflip_bitarrays(void) {
+#ifndef _WIN32
+static char *state_cache_path(void) {
+    char *path = NULL;
+    if (searchHomeFilePath(&path, CACHE_SUBDIR, STATE_CACHE_FILE, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return path;
+}
+#endif
+
+// map the table cache,  false if there is none or it doesn't match this build
+static bool map_bitflip_cache(void) {
+#ifdef _WIN32
+    return false;
+#else
+    char *path = state_cache_path();
+    if (path == NULL) {
+        return false;
+    }
+
+    int fd = open(path, O_RDONLY);
+    free(path);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(state_cache_header_t)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const state_cache_header_t *hdr = (const state_cache_header_t *)map;
+    const state_cache_entry_t *entries = (const state_cache_entry_t *)(map + sizeof(state_cache_header_t));
+
+    if (memcmp(hdr->magic, STATE_CACHE_MAGIC, sizeof(hdr->magic)) != 0
+            || hdr->bitarray_size != STATE_BITARRAY_SIZE
+            || hdr->threshold != (uint32_t)(IGNORE_BITFLIP_THRESHOLD * 1000000)
+            || hdr->num_tables == 0
+            || hdr->num_tables > 2 * 0x400
+            || hdr->data_offset < sizeof(state_cache_header_t) + (hdr->num_tables * sizeof(state_cache_entry_t))
+            || (uint64_t)hdr->data_offset + ((uint64_t)hdr->num_tables * STATE_BITARRAY_SIZE) > size) {
+        munmap(map, size);
+        return false;
+    }
+
+    uint32_t per_state[2] = {0, 0};
+    for (uint32_t i = 0; i < hdr->num_tables; i++) {
+        if (entries[i].odd_even > ODD_STATE || entries[i].bitflip == 0 || entries[i].bitflip >= 0x400
+                || ++per_state[entries[i].odd_even] >= 0x400
+                || (entries[i].offset % STATE_CACHE_ALIGN) || entries[i].offset + STATE_BITARRAY_SIZE > size) {
+            munmap(map, size);
+            return false;
+        }
+    }
+
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        num_effective_bitflips[odd_even] = 0;
+        for (uint16_t bitflip = 0x001; bitflip < 0x400; bitflip++) {
+            bitflip_bitarrays[odd_even][bitflip] = NULL;
+            count_bitflip_bitarrays[odd_even][bitflip] = 1 << 24;
+        }
+    }
+
+    // entries are stored in load order,  even tables first and ascending bitflips
+    for (uint32_t i = 0; i < hdr->num_tables; i++) {
+        odd_even_t odd_even = entries[i].odd_even;
+        uint16_t bitflip = entries[i].bitflip;
+        effective_bitflip[odd_even][num_effective_bitflips[odd_even]++] = bitflip;
+        bitflip_bitarrays[odd_even][bitflip] = (uint32_t *)(map + entries[i].offset);
+        count_bitflip_bitarrays[odd_even][bitflip] = entries[i].count;
+    }
+    effective_bitflip[EVEN_STATE][num_effective_bitflips[EVEN_STATE]] = 0x400; // EndOfList marker
+    effective_bitflip[ODD_STATE][num_effective_bitflips[ODD_STATE]] = 0x400; // EndOfList marker
+
+    state_cache_map = map;
+    state_cache_size = size;
+    return true;
+#endif
+}
+
+// write the loaded tables to the cache,  through a temporary file so a concurrent client never maps half of it
+static void write_bitflip_cache(void) {
+#ifndef _WIN32
+    // no tables found,  don't cache that
+    if (num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE] == 0) {
+        return;
+    }
+
+    char *path = state_cache_path();
+    if (path == NULL) {
+        return;
+    }
+
+    size_t tmplen = strlen(path) + 16;
+    char *tmp = calloc(tmplen, sizeof(char));
+    if (tmp == NULL) {
+        free(path);
+        return;
+    }
+    snprintf(tmp, tmplen, "%s.%d", path, (int)getpid());
+
+    state_cache_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, STATE_CACHE_MAGIC, sizeof(hdr.magic));
+    hdr.bitarray_size = STATE_BITARRAY_SIZE;
+    hdr.threshold = (uint32_t)(IGNORE_BITFLIP_THRESHOLD * 1000000);
+    hdr.num_tables = num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE];
+
+    uint32_t index_end = sizeof(state_cache_header_t) + (hdr.num_tables * sizeof(state_cache_entry_t));
+    hdr.data_offset = ((index_end + STATE_CACHE_ALIGN - 1) / STATE_CACHE_ALIGN) * STATE_CACHE_ALIGN;
+
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(DEBUG, "could not write hardnested table cache " _YELLOW_("%s"), tmp);
+        free(tmp);
+        free(path);
+        return;
+    }
+
+    bool ok = (fwrite(&hdr, sizeof(hdr), 1, f) == 1);
+
+    uint64_t offset = hdr.data_offset;
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE && ok; odd_even++) {
+        for (uint16_t i = 0; i < num_effective_bitflips[odd_even] && ok; i++) {
+            uint16_t bitflip = effective_bitflip[odd_even][i];
+            state_cache_entry_t e = {
+                .odd_even = odd_even,
+                .bitflip = bitflip,
+                .count = count_bitflip_bitarrays[odd_even][bitflip],
+                .offset = offset,
+            };
+            ok = (fwrite(&e, sizeof(e), 1, f) == 1);
+            offset += STATE_BITARRAY_SIZE;
+        }
+    }
+
+    uint8_t pad[STATE_CACHE_ALIGN] = {0};
+    if (ok) {
+        ok = (fwrite(pad, 1, hdr.data_offset - index_end, f) == hdr.data_offset - index_end);
+    }
+
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE && ok; odd_even++) {
+        for (uint16_t i = 0; i < num_effective_bitflips[odd_even] && ok; i++) {
+            ok = (fwrite(bitflip_bitarrays[odd_even][effective_bitflip[odd_even][i]], 1, STATE_BITARRAY_SIZE, f) == STATE_BITARRAY_SIZE);
+        }
+    }
+
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+
+    if (ok && rename(tmp, path) == 0) {
+        PrintAndLogEx(DEBUG, "wrote hardnested table cache " _YELLOW_("%s"), path);
+    } else {
+        PrintAndLogEx(DEBUG, "could not write hardnested table cache " _YELLOW_("%s"), path);
+        remove(tmp);
+    }
+    free(tmp);
+    free(path);
+#endif
+}
+
+static void load_bitflip_bitarrays(void) {
 #if defined (DEBUG_REDUCTION)
     uint8_t line = 0;
 #endif
@@ -490,6 +701,20 @@ static void init_bitflip_bitarrays(void) {
         snprintf(progress_text, sizeof(progress_text), "Loaded %u RAW / %u LZ4 / %u BZ2 in %"PRIu64" ms", nraw, nlz4, nbz2, msclock() - init_bitflip_bitarrays_starttime);
         hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
     }
+}
+
+static void init_bitflip_bitarrays(void) {
+    uint64_t init_bitflip_bitarrays_starttime = msclock();
+
+    if (map_bitflip_cache()) {
+        char progress_text[80];
+        snprintf(progress_text, sizeof(progress_text), "Mapped %u tables from cache in %"PRIu64" ms", num_effective_bitflips[EVEN_STATE] + num_effective_bitflips[ODD_STATE], msclock() - init_bitflip_bitarrays_starttime);
+        hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
+    } else {
+        load_bitflip_bitarrays();
+        write_bitflip_cache();
+    }
+
     uint16_t i = 0;
     uint16_t j = 0;
     num_all_effective_bitflips = 0;
@@ -532,6 +757,19 @@ static void init_bitflip_bitarrays(void) {
 }
 
 static void free_bitflip_bitarrays(void) {
+    // kept for the next run
+    if (tables_warm) {
+        return;
+    }
+#ifndef _WIN32
+    if (state_cache_map != NULL) {
+        munmap(state_cache_map, state_cache_size);
+        state_cache_map = NULL;
+        state_cache_size = 0;
+        memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
+        return;
+    }
+#endif
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
         free_bitarray(bitflip_bitarrays[ODD_STATE][bitflip]);
     }
@@ -613,6 +851,10 @@ static void init_part_sum_bitarrays(void) {
 }
 
 static void free_part_sum_bitarrays(void) {
+    // kept for the next run
+    if (tables_warm) {
+        return;
+    }
     for (int16_t part_sum_a8 = (NUM_PART_SUMS - 1); part_sum_a8 >= 0; part_sum_a8--) {
         free_bitarray(part_sum_a8_bitarrays[ODD_STATE][part_sum_a8]);
     }
@@ -651,12 +893,78 @@ static void init_sum_bitarrays(void) {
 }
 
 static void free_sum_bitarrays(void) {
+    // kept for the next run
+    if (tables_warm) {
+        return;
+    }
     for (int8_t sum_a0 = NUM_SUMS - 1; sum_a0 >= 0; sum_a0--) {
         free_bitarray(sum_a0_bitarrays[ODD_STATE][sum_a0]);
         free_bitarray(sum_a0_bitarrays[EVEN_STATE][sum_a0]);
     }
 }
 
+// the part sum bitarrays get reduced during a run,  a warm start begins from a copy
+static uint32_t *part_sum_a0_pristine[2][NUM_PART_SUMS];
+static uint32_t *part_sum_a8_pristine[2][NUM_PART_SUMS];
+
+static void init_tables(void) {
+    if (tables_warm) {
+        for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+            for (uint8_t i = 0; i < NUM_PART_SUMS; i++) {
+                memcpy(part_sum_a0_bitarrays[odd_even][i], part_sum_a0_pristine[odd_even][i], STATE_BITARRAY_SIZE);
+                memcpy(part_sum_a8_bitarrays[odd_even][i], part_sum_a8_pristine[odd_even][i], STATE_BITARRAY_SIZE);
+            }
+        }
+        return;
+    }
+
+    init_bitflip_bitarrays();
+    init_part_sum_bitarrays();
+    init_sum_bitarrays();
+
+    if (tables_keep_warm == false) {
+        return;
+    }
+
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint8_t i = 0; i < NUM_PART_SUMS; i++) {
+            part_sum_a0_pristine[odd_even][i] = (uint32_t *)malloc_bitarray(STATE_BITARRAY_SIZE);
+            part_sum_a8_pristine[odd_even][i] = (uint32_t *)malloc_bitarray(STATE_BITARRAY_SIZE);
+            if (part_sum_a0_pristine[odd_even][i] == NULL || part_sum_a8_pristine[odd_even][i] == NULL) {
+                PrintAndLogEx(ERR, "Out of memory error in init_tables(). Aborting...\n");
+                exit(4);
+            }
+            memcpy(part_sum_a0_pristine[odd_even][i], part_sum_a0_bitarrays[odd_even][i], STATE_BITARRAY_SIZE);
+            memcpy(part_sum_a8_pristine[odd_even][i], part_sum_a8_bitarrays[odd_even][i], STATE_BITARRAY_SIZE);
+        }
+    }
+    tables_warm = true;
+}
+
+/**
+ * @brief Keep the bitflip,  part sum and sum tables between mfnestedhard() runs,  the first run builds them.
+ * Switching it off frees them again.
+ */
+void mfnestedhard_keep_warm(bool keep) {
+    tables_keep_warm = keep;
+    if (keep || tables_warm == false) {
+        return;
+    }
+
+    tables_warm = false;
+    free_bitflip_bitarrays();
+    free_sum_bitarrays();
+    free_part_sum_bitarrays();
+    for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+        for (uint8_t i = 0; i < NUM_PART_SUMS; i++) {
+            free_bitarray(part_sum_a0_pristine[odd_even][i]);
+            free_bitarray(part_sum_a8_pristine[odd_even][i]);
+            part_sum_a0_pristine[odd_even][i] = NULL;
+            part_sum_a8_pristine[odd_even][i] = NULL;
+        }
+    }
+}
+
 #ifdef DEBUG_KEY_ELIMINATION
 static char failstr[250] = "";
 #endif
@@ -1198,52 +1506,56 @@ static void estimate_sum_a8(void) {
     }
 }
 
-static int read_nonce_file(char *filename) {
+// partial files of an interrupted acquisition are accepted when partial is set,  the header target goes to trgBlockNo / trgKeyType
+static int read_nonce_file(char *filename, bool partial, uint8_t *trgBlockNo, uint8_t *trgKeyType) {
 
     if (filename == NULL) {
         PrintAndLogEx(WARNING, "Filename is NULL");
         return PM3_EINVARG;
     }
-    FILE *fnonces = NULL;
     char progress_text[80] = "";
-    uint8_t read_buf[9];
+    mapped_file_t m;
 
     num_acquired_nonces = 0;
-    if ((fnonces = fopen(filename, "rb")) == NULL) {
+    if (mapFile(filename, &m) != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, "Could not open file " _YELLOW_("%s"), filename);
         return PM3_EFILE;
     }
 
     snprintf(progress_text, 80, "Reading nonces from file " _YELLOW_("%s"), filename);
     hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-    size_t bytes_read = fread(read_buf, 1, 6, fnonces);
-    if (bytes_read != 6) {
+    if (m.size < 6) {
         PrintAndLogEx(ERR, "File reading error.");
-        fclose(fnonces);
+        releaseFileMapped(&m);
         return PM3_EFILE;
     }
-    cuid = bytes_to_num(read_buf, 4);
-    uint8_t trgBlockNo = bytes_to_num(read_buf + 4, 1);
-    uint8_t trgKeyType = bytes_to_num(read_buf + 5, 1);
+    cuid = bytes_to_num(m.data, 4);
+    *trgBlockNo = bytes_to_num(m.data + 4, 1);
+    *trgKeyType = bytes_to_num(m.data + 5, 1);
 
-    bytes_read = fread(read_buf, 1, 9, fnonces);
-    while (bytes_read == 9) {
-        uint32_t nt_enc1 = bytes_to_num(read_buf, 4);
-        uint32_t nt_enc2 = bytes_to_num(read_buf + 4, 4);
-        uint8_t par_enc = bytes_to_num(read_buf + 8, 1);
+    // 9 bytes per pair of nonces,  a partial record at the end is ignored
+    for (size_t pos = 6; pos + 9 <= m.size; pos += 9) {
+        const uint8_t *rec = m.data + pos;
+        uint32_t nt_enc1 = bytes_to_num(rec, 4);
+        uint32_t nt_enc2 = bytes_to_num(rec + 4, 4);
+        uint8_t par_enc = rec[8];
         add_nonce(nt_enc1, par_enc >> 4);
         add_nonce(nt_enc2, par_enc & 0x0f);
         num_acquired_nonces += 2;
-        bytes_read = fread(read_buf, 1, 9, fnonces);
     }
-    fclose(fnonces);
+    releaseFileMapped(&m);
 
     char progress_string[80];
     snprintf(progress_string, sizeof(progress_string), "Read %u nonces from file. cuid = %08x", num_acquired_nonces, cuid);
     hardnested_print_progress(num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
-    snprintf(progress_string, sizeof(progress_string), "Target Block=%d, Keytype=%c", trgBlockNo, trgKeyType == 0 ? 'A' : 'B');
+    snprintf(progress_string, sizeof(progress_string), "Target Block=%d, Keytype=%c", *trgBlockNo, *trgKeyType == 0 ? 'A' : 'B');
     hardnested_print_progress(num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
 
+    // the acquisition checks the sum once all first bytes are in
+    if (partial && first_byte_num < 256) {
+        return PM3_SUCCESS;
+    }
+
     bool got_match = false;
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
         if (first_byte_Sum == sums[i]) {
@@ -1275,13 +1587,10 @@ static bool timeout(void) {
 }
 
 
-static void
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-*check_for_BitFlipProperties_thread(void *args) {
+// args is one uint8_t[3] per task:  first byte, last byte, time budget
+static void check_for_BitFlipProperties_thread(threadpool_job_t *job, void *arg, uint32_t index) {
+    (void)job;
+    uint8_t *args = (uint8_t *)arg + 3 * index;
     uint8_t first_byte = ((uint8_t *)args)[0];
     uint8_t last_byte = ((uint8_t *)args)[1];
     uint8_t time_budget = ((uint8_t *)args)[2];
@@ -1294,7 +1603,7 @@ __attribute__((force_align_arg_pointer))
 #if defined (DEBUG_REDUCTION)
                 PrintAndLogEx(INFO, "break at bitflip_idx " _YELLOW_("%d") " ...", bitflip_idx);
 #endif
-                return NULL;
+                return;
             }
             for (uint16_t i = first_byte; i <= last_byte; i++) {
 
@@ -1336,7 +1645,7 @@ __attribute__((force_align_arg_pointer))
 #if defined (DEBUG_REDUCTION)
                 PrintAndLogEx(INFO, "break at bitflip_idx " _YELLOW_("%d") " ...", bitflip_idx);
 #endif
-                return NULL;
+                return;
             }
             for (uint16_t i = first_byte; i <= last_byte; i++) {
                 // Check for Bit Flip Property of 2nd bytes
@@ -1369,14 +1678,11 @@ __attribute__((force_align_arg_pointer))
             }
         }
     }
-
-    return NULL;
 }
 
 static void check_for_BitFlipProperties(bool time_budget) {
     // create and run worker threads
     const size_t num_check_bitflip_threads = NUM_CHECK_BITFLIPS_THREADS;
-    pthread_t thread_id[num_check_bitflip_threads];
 
     uint8_t args[num_check_bitflip_threads][3];
     uint16_t bytes_per_thread = (256 + (num_check_bitflip_threads / 2)) / num_check_bitflip_threads;
@@ -1388,15 +1694,8 @@ static void check_for_BitFlipProperties(bool time_budget) {
     // args[][] is uint8_t so max 255, no need to check it
     // args[num_check_bitflip_threads - 1][1] = MAX(args[num_check_bitflip_threads - 1][1], 255);
 
-    // start threads
-    for (uint32_t i = 0; i < num_check_bitflip_threads; i++) {
-        pthread_create(&thread_id[i], NULL, check_for_BitFlipProperties_thread, args[i]);
-    }
-
-    // wait for threads to terminate:
-    for (uint32_t i = 0; i < num_check_bitflip_threads; i++) {
-        pthread_join(thread_id[i], NULL);
-    }
+    // run them on the thread pool
+    threadpool_run(check_for_BitFlipProperties_thread, args, num_check_bitflip_threads);
 
     if (hardnested_stage & CHECK_2ND_BYTES) {
         hardnested_stage &= ~CHECK_1ST_BYTES; // we are done with 1st stage, except...
@@ -1434,7 +1733,7 @@ static void apply_sum_a0(void) {
     }
 }
 
-static void simulate_MFplus_RNG(uint32_t test_cuid, uint64_t test_key, uint32_t *nt_enc, uint8_t *par_enc) {
+static void simulate_MFplus_nonce(uint32_t test_cuid, uint64_t test_key, uint32_t nt, uint32_t *nt_enc, uint8_t *par_enc) {
 
     struct Crypto1State sim_cs = {0, 0};
 
@@ -1445,7 +1744,6 @@ static void simulate_MFplus_RNG(uint32_t test_cuid, uint64_t test_key, uint32_t
     }
 
     *par_enc = 0;
-    uint32_t nt = (rand() & 0xff) << 24 | (rand() & 0xff) << 16 | (rand() & 0xff) << 8 | (rand() & 0xff);
 
     for (int8_t byte_pos = 3; byte_pos >= 0; byte_pos--) {
 
@@ -1464,6 +1762,11 @@ static void simulate_MFplus_RNG(uint32_t test_cuid, uint64_t test_key, uint32_t
     }
 }
 
+static void simulate_MFplus_RNG(uint32_t test_cuid, uint64_t test_key, uint32_t *nt_enc, uint8_t *par_enc) {
+    uint32_t nt = (rand() & 0xff) << 24 | (rand() & 0xff) << 16 | (rand() & 0xff) << 8 | (rand() & 0xff);
+    simulate_MFplus_nonce(test_cuid, test_key, nt, nt_enc, par_enc);
+}
+
 static int simulate_acquire_nonces(void) {
     time_t time1 = time(NULL);
     last_sample_clock = 0;
@@ -1546,11 +1849,40 @@ static int simulate_acquire_nonces(void) {
     return PM3_SUCCESS;
 }
 
-static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
+// a first byte stops adding information once all its 2nd bytes are seen,  or once its Sum(a8) is as good as known
+#define SATURATED_SUM_A8_PROB 0.9999
+
+static bool first_byte_saturated(uint16_t first_byte) {
+    if (nonces[first_byte].num == 256) {
+        return true;
+    }
+    return (first_byte_num == 256
+            && nonces[first_byte].sum_a8_guess_dirty == false
+            && nonces[first_byte].sum_a8_guess[0].prob >= SATURATED_SUM_A8_PROB);
+}
+
+// bitmask of the first bytes the device can drop, returns the number of bits set
+static uint16_t get_skip_first_bytes(uint8_t *mask) {
+    uint16_t n = 0;
+    memset(mask, 0, 32);
+    for (uint16_t i = 0; i < 256; i++) {
+        if (first_byte_saturated(i)) {
+            mask[i >> 3] |= 1 << (i & 0x07);
+            n++;
+        }
+    }
+    return n;
+}
+
+// resume continues with the nonces read from an earlier partial nonce file,  new ones are appended to it
+static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename, bool resume) {
 
     last_sample_clock = msclock();
-    hardnested_stage = CHECK_1ST_BYTES;
-    num_acquired_nonces = 0;
+    if (resume == false) {
+        hardnested_stage = CHECK_1ST_BYTES;
+        num_acquired_nonces = 0;
+    }
+    uint32_t file_cuid = cuid;
 
     // initial rough estimate. Will be refined.
     sample_period = 2000;
@@ -1588,12 +1920,19 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
             break;
         }
 
+        // key, followed by the first bytes we don't need more nonces of
+        uint8_t payload[6 + 32];
+        memcpy(payload, key, 6);
+        uint16_t num_skip = get_skip_first_bytes(payload + 6);
+
         uint32_t flags = 0;
         flags |= initialize ? 0x0001 : 0;
         flags |= slow ? 0x0002 : 0;
         flags |= field_off ? 0x0004 : 0;
+        // with every first byte masked the device would only time out
+        flags |= (num_skip && num_skip < 256) ? 0x0008 : 0;
         clearCommandBuffer();
-        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, flags, key, 6);
+        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, flags, payload, (flags & 0x0008) ? sizeof(payload) : 6);
 
         if (initialize) {
 
@@ -1609,21 +1948,29 @@ static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_
             }
 
             cuid = resp.oldarg[1];
+            if (resume && cuid != file_cuid) {
+                PrintAndLogEx(WARNING, "Nonce file " _YELLOW_("%s") " is of another card (cuid %08x)", filename, file_cuid);
+                DropField();
+                return PM3_EINVARG;
+            }
+
             if (nonce_file_write && fnonces == NULL) {
 
-                if ((fnonces = fopen(filename, "wb")) == NULL) {
+                if ((fnonces = fopen(filename, resume ? "ab" : "wb")) == NULL) {
                     PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
                     DropField();
                     return PM3_EFILE;
                 }
 
-                snprintf(progress_text, 80, "Writing acquired nonces to binary file " _YELLOW_("%s"), filename);
+                snprintf(progress_text, 80, "%s acquired nonces to binary file " _YELLOW_("%s"), resume ? "Appending" : "Writing", filename);
                 hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-                num_to_bytes(cuid, 4, write_buf);
-                fwrite(write_buf, 1, 4, fnonces);
-                fwrite(&trgBlockNo, 1, 1, fnonces);
-                fwrite(&trgKeyType, 1, 1, fnonces);
-                fflush(fnonces);
+                if (resume == false) {
+                    num_to_bytes(cuid, 4, write_buf);
+                    fwrite(write_buf, 1, 4, fnonces);
+                    fwrite(&trgBlockNo, 1, 1, fnonces);
+                    fwrite(&trgKeyType, 1, 1, fnonces);
+                    fflush(fnonces);
+                }
             }
         }
 
@@ -2066,14 +2413,10 @@ static void init_book_of_work(void) {
     }
 }
 
-static void
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-*generate_candidates_worker_thread(void *args) {
-    uint16_t *sum_args = (uint16_t *)args;
+static void generate_candidates_worker_thread(threadpool_job_t *job, void *arg, uint32_t index) {
+    (void)job;
+    (void)index;
+    uint16_t *sum_args = (uint16_t *)arg;
     uint16_t sum_a0 = sums[sum_args[0]];
     uint16_t sum_a8 = sums[sum_args[1]];
     // uint16_t my_thread_number = sums[2];
@@ -2208,8 +2551,6 @@ __attribute__((force_align_arg_pointer))
             }
         }
     } while (there_might_be_more_work);
-
-    return NULL;
 }
 
 
@@ -2223,21 +2564,10 @@ static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
     init_book_of_work();
 
     // create and run worker threads
+    // the workers take their work from the book of work
     const size_t num_reduction_working_threads = NUM_REDUCTION_WORKING_THREADS;
-    pthread_t thread_id[num_reduction_working_threads];
-
-    uint16_t sums1[num_reduction_working_threads][3];
-    for (uint32_t i = 0; i < num_reduction_working_threads; i++) {
-        sums1[i][0] = sum_a0_idx;
-        sums1[i][1] = sum_a8_idx;
-        sums1[i][2] = i + 1;
-        pthread_create(thread_id + i, NULL, generate_candidates_worker_thread, sums1[i]);
-    }
-
-    // wait for threads to terminate:
-    for (uint32_t i = 0; i < num_reduction_working_threads; i++) {
-        pthread_join(thread_id[i], NULL);
-    }
+    uint16_t sums1[2] = {sum_a0_idx, sum_a8_idx};
+    threadpool_run(generate_candidates_worker_thread, sums1, num_reduction_working_threads);
 
     maximum_states = 0;
     for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
@@ -2371,10 +2701,6 @@ static void init_it_all(void) {
     candidates = NULL;
     num_acquired_nonces = 0;
     start_time = 0;
-    num_effective_bitflips[0] = 0;
-    num_effective_bitflips[1] = 0;
-    num_all_effective_bitflips = 0;
-    num_1st_byte_effective_bitflips = 0;
     hardnested_stage = CHECK_1ST_BYTES;
     known_target_key = 0;
     test_state[0] = 0;
@@ -2383,6 +2709,14 @@ static void init_it_all(void) {
     init_book_of_work();
     real_sum_a8 = 0;
 
+    if (tables_warm) {
+        return;
+    }
+
+    num_effective_bitflips[0] = 0;
+    num_effective_bitflips[1] = 0;
+    num_all_effective_bitflips = 0;
+    num_1st_byte_effective_bitflips = 0;
     memset(effective_bitflip, 0, sizeof(effective_bitflip));
     memset(all_effective_bitflip, 0, sizeof(all_effective_bitflip));
     memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
@@ -2392,7 +2726,7 @@ static void init_it_all(void) {
     memset(sum_a0_bitarrays, 0, sizeof(sum_a0_bitarrays));
 }
 
-int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename) {
+int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool resume, bool slow, int tests, uint64_t *foundkey, char *filename) {
     char progress_text[80];
     char instr_set[12] = {0};
 
@@ -2403,7 +2737,12 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
     init_it_all();
 
     srand((unsigned) time(NULL));
-    brute_force_per_second = brute_force_benchmark();
+    static float warm_brute_force_per_second = 0;
+    if (tables_warm && warm_brute_force_per_second > 0) {
+        brute_force_per_second = warm_brute_force_per_second;
+    } else {
+        brute_force_per_second = warm_brute_force_per_second = brute_force_benchmark();
+    }
     write_stats = false;
 
     if (tests) {
@@ -2429,9 +2768,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
                 known_target_key = -1;
             }
 
-            init_bitflip_bitarrays();
-            init_part_sum_bitarrays();
-            init_sum_bitarrays();
+            init_tables();
             init_allbitflips_array();
             init_nonce_memory();
             update_reduction_rate(0.0, true);
@@ -2535,16 +2872,18 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
         print_progress_header();
         snprintf(progress_text, sizeof(progress_text), "Brute force benchmark: %1.0f million (2^%1.1f) keys/s", brute_force_per_second / 1000000, log(brute_force_per_second) / log(2.0));
         hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-        init_bitflip_bitarrays();
-        init_part_sum_bitarrays();
-        init_sum_bitarrays();
+        uint64_t t = msclock();
+        init_tables();
         init_allbitflips_array();
         init_nonce_memory();
         update_reduction_rate(0.0, true);
+        pm3_metrics_phase("hardnested", "tables", msclock() - t);
 
+        t = msclock();
         int res;
         if (nonce_file_read) {  // use pre-acquired data from file nonces.bin
-            res = read_nonce_file(filename);
+            uint8_t file_blockno = 0, file_keytype = 0;
+            res = read_nonce_file(filename, false, &file_blockno, &file_keytype);
             if (res != PM3_SUCCESS) {
                 free_bitflip_bitarrays();
                 free_nonces_memory();
@@ -2559,7 +2898,34 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
             float brute_force_depth;
             shrink_key_space(&brute_force_depth);
         } else { // acquire nonces.
-            res = acquire_nonces(blockNo, keyType, key, trgBlockNo, trgKeyType, nonce_file_write, slow, filename);
+            // an interrupted acquisition left its nonces in the file,  continue with them
+            bool resumed = false;
+            if (resume && fileExists(filename)) {
+                uint8_t file_blockno = 0, file_keytype = 0;
+                res = read_nonce_file(filename, true, &file_blockno, &file_keytype);
+                if (res == PM3_SUCCESS && (file_blockno != trgBlockNo || file_keytype != trgKeyType)) {
+                    PrintAndLogEx(WARNING, "Nonce file " _YELLOW_("%s") " is of another target", filename);
+                    res = PM3_EINVARG;
+                }
+                if (res != PM3_SUCCESS) {
+                    free_bitflip_bitarrays();
+                    free_nonces_memory();
+                    free_bitarray(all_bitflips_bitarray[ODD_STATE]);
+                    free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
+                    free_sum_bitarrays();
+                    free_part_sum_bitarrays();
+                    return res;
+                }
+
+                hardnested_stage = CHECK_1ST_BYTES;
+                if (first_byte_num == 256) {
+                    hardnested_stage |= CHECK_2ND_BYTES;
+                    apply_sum_a0();
+                }
+                resumed = true;
+            }
+
+            res = acquire_nonces(blockNo, keyType, key, trgBlockNo, trgKeyType, nonce_file_write || resume, slow, filename, resumed);
             if (res != PM3_SUCCESS) {
                 free_bitflip_bitarrays();
                 free_nonces_memory();
@@ -2571,6 +2937,8 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
             }
         }
 
+        pm3_metrics_phase("hardnested", (nonce_file_read) ? "nonce_file" : "acquire", msclock() - t);
+
         if (trgkey != NULL) {
             known_target_key = bytes_to_num(trgkey, 6);
             set_test_state(best_first_bytes[0]);
@@ -2581,6 +2949,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
         Tests();
 
         free_bitflip_bitarrays();
+        uint64_t t_candidates = 0, t_brute = 0;
         bool key_found = false;
         num_keys_tested = 0;
         uint32_t num_odd = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
@@ -2590,6 +2959,7 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 
         if (expected_brute_force1 < expected_brute_force2) {
             hardnested_print_progress(num_acquired_nonces, "(Ignoring Sum(a8) properties)", expected_brute_force1, 0);
+            t = msclock();
             set_test_state(best_first_byte_smallest_bitarray);
             add_bitflip_candidates(best_first_byte_smallest_bitarray);
             Tests2();
@@ -2602,16 +2972,21 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
             best_first_bytes[0] = best_first_byte_smallest_bitarray;
             pre_XOR_nonces();
             prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+            t_candidates = msclock() - t;
 
+            t = msclock();
             key_found = brute_force(foundkey);
+            t_brute = msclock() - t;
             free(candidates->states[ODD_STATE]);
             free(candidates->states[EVEN_STATE]);
             free_candidates_memory(candidates);
             candidates = NULL;
         } else {
 
+            t = msclock();
             pre_XOR_nonces();
             prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+            t_candidates = msclock() - t;
 
             for (uint8_t j = 0; j < NUM_SUMS && !key_found; j++) {
                 float expected_brute_force = nonces[best_first_bytes[0]].expected_num_brute_force;
@@ -2623,8 +2998,13 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
                     hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
                 }
 
+                t = msclock();
                 generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
+                t_candidates += msclock() - t;
+
+                t = msclock();
                 key_found = brute_force(foundkey);
+                t_brute += msclock() - t;
                 free_statelist_cache();
                 free_candidates_memory(candidates);
                 candidates = NULL;
@@ -2638,6 +3018,9 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
             }
         }
 
+        pm3_metrics_phase("hardnested", "candidates", t_candidates);
+        pm3_metrics_phase("hardnested", "brute_force", t_brute);
+
         free_nonces_memory();
         free_bitarray(all_bitflips_bitarray[ODD_STATE]);
         free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
@@ -2649,3 +3032,373 @@ int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBloc
 
     return PM3_SUCCESS;
 }
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// benchmark
+//
+// The nonce sets are generated with a fixed PRNG instead of rand(),  so every platform and every release attacks
+// exactly the same nonces.  Fewer distinct nonces leave more states for the brute force.
+
+typedef struct {
+    const char *name;
+    uint32_t cuid;
+    uint64_t key;
+    uint32_t seed;
+    uint16_t num_nonces;    // distinct nonces, as counted by add_nonce()
+} hardbench_set_t;
+
+static const hardbench_set_t hardbench_sets[] = {
+    { "easy",   0x2D4165C9, 0x4A37E5C10F92, 0x6D2B79F5, 6000 },
+    { "medium", 0x91B3A7E4, 0xC2F7608B13DA, 0x1B873593, 3500 },
+    { "hard",   0x5E0C92AF, 0x7138DA42BC05, 0xCC9E2D51, 2000 },
+};
+
+typedef struct {
+    const char *set;
+    char backend[12];
+    uint32_t nonces;
+    uint64_t table_load;        // ms
+    uint64_t sum_estimation;    // ms
+    uint64_t candidates;        // ms
+    uint64_t brute_force;       // ms
+    uint64_t keys_tested;
+    float expected_states;
+    float bf_rate;              // brute_force_benchmark(),  keys/s
+    bool key_found;
+    bool key_correct;
+} hardbench_result_t;
+
+static uint32_t hardbench_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// same layout as the files `hf mf hardnested -w` writes,  target block 0 key A
+static int hardbench_write_set(const hardbench_set_t *set, const char *filename) {
+
+    uint8_t *seen = calloc(65536 / 8, sizeof(uint8_t));
+    if (seen == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    FILE *f = fopen(filename, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
+        free(seen);
+        return PM3_EFILE;
+    }
+
+    uint8_t buf[9] = {0};
+    num_to_bytes(set->cuid, 4, buf);
+    fwrite(buf, 1, 6, f);
+
+    uint32_t state = set->seed;
+    uint32_t distinct = 0;
+    while (distinct < set->num_nonces) {
+        uint32_t nt_enc[2] = {0};
+        uint8_t par_enc[2] = {0};
+        for (uint8_t i = 0; i < 2; i++) {
+            simulate_MFplus_nonce(set->cuid, set->key, hardbench_rand(&state), &nt_enc[i], &par_enc[i]);
+            uint16_t idx = nt_enc[i] >> 16;
+            if ((seen[idx >> 3] & (1 << (idx & 0x07))) == 0) {
+                seen[idx >> 3] |= 1 << (idx & 0x07);
+                distinct++;
+            }
+        }
+        num_to_bytes(nt_enc[0], 4, buf);
+        num_to_bytes(nt_enc[1], 4, buf + 4);
+        buf[8] = (par_enc[0] << 4) | (par_enc[1] & 0x0f);
+        fwrite(buf, 1, 9, f);
+    }
+
+    fclose(f);
+    free(seen);
+    return PM3_SUCCESS;
+}
+
+static void hardbench_free(void) {
+    free_nonces_memory();
+    free_bitarray(all_bitflips_bitarray[ODD_STATE]);
+    free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
+    free_sum_bitarrays();
+    free_part_sum_bitarrays();
+}
+
+// one attack on a nonce file,  like `hf mf hardnested -r` but with every phase timed
+static int hardbench_run(char *filename, uint64_t expected_key, hardbench_result_t *r) {
+
+    memset(part_sum_count, 0, sizeof(part_sum_count));
+    init_it_all();
+    known_target_key = -1;
+
+    brute_force_per_second = r->bf_rate = brute_force_benchmark();
+
+    start_time = msclock();
+    print_progress_header();
+
+    uint64_t t = msclock();
+    init_tables();
+    init_allbitflips_array();
+    init_nonce_memory();
+    update_reduction_rate(0.0, true);
+    r->table_load = msclock() - t;
+
+    t = msclock();
+    uint8_t file_blockno = 0, file_keytype = 0;
+    int res = read_nonce_file(filename, false, &file_blockno, &file_keytype);
+    if (res != PM3_SUCCESS) {
+        free_bitflip_bitarrays();
+        hardbench_free();
+        return res;
+    }
+    hardnested_stage = CHECK_1ST_BYTES | CHECK_2ND_BYTES;
+    update_nonce_data(false);
+    float brute_force_depth;
+    shrink_key_space(&brute_force_depth);
+    r->sum_estimation = msclock() - t;
+    r->nonces = num_acquired_nonces;
+
+    free_bitflip_bitarrays();
+
+    uint64_t foundkey = 0;
+    bool key_found = false;
+    num_keys_tested = 0;
+    uint32_t num_odd = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
+    uint32_t num_even = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE];
+    float expected_brute_force1 = (float)num_odd * num_even / 2.0;
+    float expected_brute_force2 = nonces[best_first_bytes[0]].expected_num_brute_force;
+
+    if (expected_brute_force1 < expected_brute_force2) {
+        r->expected_states = expected_brute_force1;
+
+        t = msclock();
+        add_bitflip_candidates(best_first_byte_smallest_bitarray);
+        maximum_states = 0;
+        for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
+            maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
+        }
+        best_first_bytes[0] = best_first_byte_smallest_bitarray;
+        pre_XOR_nonces();
+        prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+        r->candidates = msclock() - t;
+
+        t = msclock();
+        key_found = brute_force(&foundkey);
+        r->brute_force = msclock() - t;
+
+        free(candidates->states[ODD_STATE]);
+        free(candidates->states[EVEN_STATE]);
+        free_candidates_memory(candidates);
+        candidates = NULL;
+    } else {
+        r->expected_states = expected_brute_force2;
+
+        t = msclock();
+        pre_XOR_nonces();
+        prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+        r->candidates = msclock() - t;
+
+        for (uint8_t j = 0; j < NUM_SUMS && key_found == false; j++) {
+            t = msclock();
+            generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
+            r->candidates += msclock() - t;
+
+            t = msclock();
+            key_found = brute_force(&foundkey);
+            r->brute_force += msclock() - t;
+
+            free_statelist_cache();
+            free_candidates_memory(candidates);
+            candidates = NULL;
+            if (key_found == false) {
+                nonces[best_first_bytes[0]].sum_a8_guess[j].prob = 0;
+                nonces[best_first_bytes[0]].sum_a8_guess[j].num_states = 0;
+                update_expected_brute_force(best_first_bytes[0]);
+            }
+        }
+    }
+
+    hardbench_free();
+
+    r->keys_tested = num_keys_tested;
+    r->key_found = key_found;
+    r->key_correct = key_found && (expected_key == (uint64_t) -1 || foundkey == expected_key);
+    return PM3_SUCCESS;
+}
+
+static int hardbench_save_json(const char *filename, const hardbench_result_t *results, size_t count) {
+    json_t *runs = json_array();
+    for (size_t i = 0; i < count; i++) {
+        const hardbench_result_t *r = &results[i];
+        json_array_append_new(runs, json_pack("{s:s, s:s, s:i, s:I, s:I, s:I, s:I, s:I, s:f, s:f, s:b, s:b}",
+                                              "set", r->set,
+                                              "backend", r->backend,
+                                              "nonces", (int)r->nonces,
+                                              "table_load_ms", (json_int_t)r->table_load,
+                                              "sum_estimation_ms", (json_int_t)r->sum_estimation,
+                                              "candidates_ms", (json_int_t)r->candidates,
+                                              "brute_force_ms", (json_int_t)r->brute_force,
+                                              "keys_tested", (json_int_t)r->keys_tested,
+                                              "expected_states", (double)r->expected_states,
+                                              "benchmark_keys_per_s", (double)r->bf_rate,
+                                              "key_found", r->key_found,
+                                              "key_correct", r->key_correct));
+    }
+
+    json_t *root = json_pack("{s:i, s:o}", "threads", (int)num_CPUs(), "runs", runs);
+    int res = json_dump_file(root, filename, JSON_INDENT(2));
+    json_decref(root);
+    if (res) {
+        PrintAndLogEx(WARNING, "couldn't save '%s'", filename);
+        return PM3_EFILE;
+    }
+    PrintAndLogEx(SUCCESS, "saved benchmark results to " _YELLOW_("%s"), filename);
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Time the phases of the hardnested attack on fixed nonce sets
+ *
+ * @param set_name built in set to run,  NULL or empty for all of them
+ * @param filename nonce file to run instead of the built in sets,  NULL or empty for none
+ * @param all_simd run every SIMD back end this CPU supports,  otherwise only the automatic choice
+ * @param gpu add a run on the OpenCL back end
+ * @param json_filename machine readable results,  NULL or empty for none
+ */
+int mfnestedhard_bench(const char *set_name, const char *filename, bool all_simd, bool gpu, const char *json_filename) {
+
+    // the runs to do
+    char *set_files[ARRAYLEN(hardbench_sets) + 1] = {NULL};
+    const char *set_names[ARRAYLEN(hardbench_sets) + 1] = {NULL};
+    uint64_t set_keys[ARRAYLEN(hardbench_sets) + 1] = {0};
+    size_t num_sets = 0;
+    int res = PM3_SUCCESS;
+
+    if (filename != NULL && filename[0] != '\0') {
+        set_files[0] = strdup(filename);
+        set_names[0] = filename;
+        set_keys[0] = (uint64_t) -1;
+        num_sets = 1;
+    } else {
+        for (size_t i = 0; i < ARRAYLEN(hardbench_sets); i++) {
+            const hardbench_set_t *set = &hardbench_sets[i];
+            if (set_name != NULL && set_name[0] != '\0' && strcmp(set_name, set->name) != 0) {
+                continue;
+            }
+
+            char fn[32];
+            snprintf(fn, sizeof(fn), "hardbench-%s.bin", set->name);
+            char *path = NULL;
+            res = searchHomeFilePath(&path, HARDBENCH_SUBDIR, fn, true);
+            if (res != PM3_SUCCESS) {
+                goto out;
+            }
+
+            // the files never change,  only write them once
+            if (fileExists(path) == false) {
+                PrintAndLogEx(INFO, "writing nonce set " _YELLOW_("%s") " to " _YELLOW_("%s"), set->name, path);
+                res = hardbench_write_set(set, path);
+                if (res != PM3_SUCCESS) {
+                    free(path);
+                    goto out;
+                }
+            }
+            set_files[num_sets] = path;
+            set_names[num_sets] = set->name;
+            set_keys[num_sets] = set->key;
+            num_sets++;
+        }
+
+        if (num_sets == 0) {
+            PrintAndLogEx(WARNING, "Unknown nonce set " _YELLOW_("%s") ", use easy, medium or hard", set_name);
+            return PM3_EINVARG;
+        }
+    }
+
+    // the back ends,  an x86 CPU runs every instruction set below the best one it supports
+    SIMDExecInstr backends[SIMD_NONE + 2];
+    size_t num_backends = 0;
+    SetSIMDInstr(SIMD_AUTO);
+    for (SIMDExecInstr instr = GetSIMDInstrAuto(); instr <= SIMD_NONE; instr++) {
+        backends[num_backends++] = instr;
+        if (all_simd == false) {
+            break;
+        }
+    }
+
+    size_t max_results = num_sets * (num_backends + (gpu ? 1 : 0));
+    hardbench_result_t *results = calloc(max_results, sizeof(hardbench_result_t));
+    if (results == NULL) {
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    size_t num_results = 0;
+    for (size_t i = 0; i < num_sets; i++) {
+        for (size_t j = 0; j < num_backends + (gpu ? 1 : 0); j++) {
+            hardbench_result_t *r = &results[num_results];
+            r->set = set_names[i];
+
+            if (j < num_backends) {
+                SetSIMDInstr(backends[j]);
+                brute_force_use_gpu(false);
+                get_SIMD_instruction_set(r->backend);
+            } else {
+                SetSIMDInstr(SIMD_AUTO);
+                brute_force_use_gpu(true);
+                strcpy(r->backend, "OpenCL");
+            }
+
+            PrintAndLogEx(INFO, "--- nonce set " _YELLOW_("%s") ", " _YELLOW_("%s") " back end", r->set, r->backend);
+            res = hardbench_run(set_files[i], set_keys[i], r);
+            if (res != PM3_SUCCESS) {
+                break;
+            }
+            num_results++;
+
+            if (kbd_enter_pressed()) {
+                PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+                res = PM3_EOPABORTED;
+                break;
+            }
+        }
+        if (res != PM3_SUCCESS) {
+            break;
+        }
+    }
+
+    SetSIMDInstr(SIMD_AUTO);
+    brute_force_use_gpu(false);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "Hardnested benchmark, " _YELLOW_("%d") " threads, times in ms", num_CPUs());
+    PrintAndLogEx(INFO, "---------+---------+--------+---------+--------+-----------+-------------+----------+------");
+    PrintAndLogEx(INFO, " set     | backend | nonces | tables  | sums   | candidates| brute force | Mkeys/s  | key");
+    PrintAndLogEx(INFO, "---------+---------+--------+---------+--------+-----------+-------------+----------+------");
+    for (size_t i = 0; i < num_results; i++) {
+        const hardbench_result_t *r = &results[i];
+        float rate = (r->brute_force) ? (float)r->keys_tested / r->brute_force / 1000.0 : 0.0;
+        PrintAndLogEx(INFO, " %-7.7s | %-7s | %6u | %7" PRIu64 " | %6" PRIu64 " | %9" PRIu64 " | %11" PRIu64 " | %8.1f | %s",
+                      r->set, r->backend, r->nonces, r->table_load, r->sum_estimation, r->candidates, r->brute_force, rate,
+                      r->key_correct ? _GREEN_("ok") : (r->key_found ? _RED_("wrong") : _RED_("fail")));
+    }
+    PrintAndLogEx(INFO, "---------+---------+--------+---------+--------+-----------+-------------+----------+------");
+
+    if (json_filename != NULL && json_filename[0] != '\0' && num_results) {
+        int jres = hardbench_save_json(json_filename, results, num_results);
+        if (res == PM3_SUCCESS) {
+            res = jres;
+        }
+    }
+    free(results);
+
+out:
+    for (size_t i = 0; i < num_sets; i++) {
+        free(set_files[i]);
+    }
+    return res;
+}
@@ -21,7 +21,9 @@
 
 #include "common.h"
 
-int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename);
+int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool resume, bool slow, int tests, uint64_t *foundkey, char *filename);
+void mfnestedhard_keep_warm(bool keep);
+int mfnestedhard_bench(const char *set_name, const char *filename, bool all_simd, bool gpu, const char *json_filename);
 void hardnested_print_progress(uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time);
 
 #endif
@@ -1327,86 +1327,137 @@ static int CmdHFMFPChConf(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// one sector goes to the device with up to MFP_CHK_KEYS_MAX keys per request.
+// Keys found on other sectors are tried first,  sectors with keys already found are skipped
 static int plus_key_check(uint8_t startSector, uint8_t endSector, uint8_t startKeyAB, uint8_t endKeyAB,
                           uint8_t keyList[MAX_AES_KEYS_LIST_LEN][AES_KEY_LEN], size_t keyListLen, uint8_t foundKeys[2][64][AES_KEY_LEN + 1],
                           bool verbose) {
-    int res;
-    bool selectCard = true;
-    uint8_t keyn[2] = {0};
+
+    const uint8_t *candidates[2 * 64 + MAX_AES_KEYS_LIST_LEN];
+    uint8_t data[sizeof(mfp_chk_req_t) + MFP_CHK_KEYS_MAX * AES_KEY_LEN] = {0};
+    mfp_chk_req_t *req = (mfp_chk_req_t *)data;
+    // same RndA as MifareAuth4
+    for (int i = 0; i < sizeof(req->rnda); i++) {
+        req->rnda[i] = i;
+    }
 
     // sector number from 0
     for (uint8_t sector = startSector; sector <= endSector; sector++) {
+
         // 0-keyA 1-keyB
+        uint8_t keyab = 0;
         for (uint8_t keyAB = startKeyAB; keyAB <= endKeyAB; keyAB++) {
-            // main cycle with key check
-            for (int i = 0; i < keyListLen; i++) {
+            if (foundKeys[keyAB][sector][0] == 0) {
+                keyab |= 1 << keyAB;
+            }
+        }
 
-                // allow client abort every iteration
-                if (kbd_enter_pressed()) {
-                    PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
-                    DropField();
-                    return PM3_EOPABORTED;
+        if (keyab == 0) {
+            continue;
+        }
+
+        // keys of other sectors,  then the list
+        size_t count = 0;
+        for (uint8_t s = 0; s < 64; s++) {
+            for (uint8_t k = 0; k < 2; k++) {
+                if (foundKeys[k][s][0] == 0) {
+                    continue;
                 }
 
-                if (i % 10 == 0) {
-                    if (verbose == false) {
-                        PrintAndLogEx(NORMAL, "." NOLF);
-                    }
+                bool dup = false;
+                for (size_t i = 0; i < count && dup == false; i++) {
+                    dup = (memcmp(candidates[i], &foundKeys[k][s][1], AES_KEY_LEN) == 0);
                 }
 
-                uint16_t uKeyNum = 0x4000 + sector * 2 + keyAB;
-                keyn[0] = uKeyNum >> 8;
-                keyn[1] = uKeyNum & 0xff;
+                if (dup == false) {
+                    candidates[count++] = &foundKeys[k][s][1];
+                }
+            }
+        }
 
-                for (int retry = 0; retry < 4; retry++) {
-                    res = MifareAuth4(NULL, keyn, keyList[i], selectCard, true, false, false, true);
-                    if (res == PM3_SUCCESS || res == PM3_EWRONGANSWER)
-                        break;
+        size_t reused = count;
+        for (size_t i = 0; i < keyListLen; i++) {
+            bool dup = false;
+            for (size_t j = 0; j < reused && dup == false; j++) {
+                dup = (memcmp(candidates[j], keyList[i], AES_KEY_LEN) == 0);
+            }
 
-                    if (verbose)
-                        PrintAndLogEx(WARNING, "\nretried[%d]...", retry);
-                    else
-                        PrintAndLogEx(NORMAL, "R" NOLF);
+            if (dup == false) {
+                candidates[count++] = keyList[i];
+            }
+        }
 
-                    DropField();
-                    selectCard = true;
-                    msleep(100);
-                }
+        for (size_t first = 0; first < count && keyab; first += MFP_CHK_KEYS_MAX) {
 
-                // key for [sector,keyAB] found
-                if (res == PM3_SUCCESS) {
-                    if (verbose)
-                        PrintAndLogEx(INFO, "\nFound key for sector %d key %s [%s]", sector, keyAB == 0 ? "A" : "B", sprint_hex_inrow(keyList[i], 16));
-                    else
-                        PrintAndLogEx(NORMAL, "+" NOLF);
+            // allow client abort every request
+            if (kbd_enter_pressed()) {
+                PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+                DropField();
+                return PM3_EOPABORTED;
+            }
 
-                    foundKeys[keyAB][sector][0] = 0x01;
-                    memcpy(&foundKeys[keyAB][sector][1], keyList[i], AES_KEY_LEN);
-                    DropField();
-                    selectCard = true;
-                    msleep(50);
+            if (verbose == false) {
+                PrintAndLogEx(NORMAL, "." NOLF);
+            }
 
-                    // break out from keylist check loop,
-                    break;
-                }
+            req->sector = sector;
+            req->keyab = keyab;
+            req->count = MIN(count - first, MFP_CHK_KEYS_MAX);
+            for (size_t i = 0; i < req->count; i++) {
+                memcpy(&req->keys[i * AES_KEY_LEN], candidates[first + i], AES_KEY_LEN);
+            }
+
+            clearCommandBuffer();
+            SendCommandNG(CMD_HF_MIFAREPLUS_CHKKEYS, data, sizeof(mfp_chk_req_t) + req->count * AES_KEY_LEN);
+
+            PacketResponseNG resp;
+            if (WaitForResponseTimeout(CMD_HF_MIFAREPLUS_CHKKEYS, &resp, 10000) == false) {
+                PrintAndLogEx(WARNING, "\ncommand execution time out");
+                DropField();
+                return PM3_ETIMEOUT;
+            }
+
+            if (resp.status == PM3_EOPABORTED) {
+                PrintAndLogEx(WARNING, "\naborted via button!\n");
+                return PM3_EOPABORTED;
+            }
 
+            if (resp.status != PM3_SUCCESS) {
                 if (verbose)
-                    PrintAndLogEx(WARNING, "\nsector %02d key %d [%s] res: %d", sector, keyAB, sprint_hex_inrow(keyList[i], 16), res);
+                    PrintAndLogEx(ERR, "\nExchange error. Aborted.");
+                else
+                    PrintAndLogEx(NORMAL, "E" NOLF);
 
-                // RES can be:
-                // PM3_ERFTRANS     -7
-                // PM3_EWRONGANSWER -16
-                if (res == PM3_ERFTRANS) {
+                DropField();
+                return PM3_ECARDEXCHANGE;
+            }
+
+            const mfp_chk_resp_t *rpayload = (const mfp_chk_resp_t *)resp.data.asBytes;
+            for (uint8_t keyAB = 0; keyAB < 2; keyAB++) {
+                if ((keyab & (1 << keyAB)) == 0) {
+                    continue;
+                }
+
+                if (rpayload->error[keyAB]) {
                     if (verbose)
-                        PrintAndLogEx(ERR, "\nExchange error. Aborted.");
-                    else
-                        PrintAndLogEx(NORMAL, "E" NOLF);
+                        PrintAndLogEx(WARNING, "\nsector %02d key %d card error %02x %s", sector, keyAB, rpayload->error[keyAB], mfpGetErrorDescription(rpayload->error[keyAB]));
 
-                    DropField();
-                    return PM3_ECARDEXCHANGE;
+                    keyab &= ~(1 << keyAB);
+                    continue;
                 }
 
-                selectCard = false;
+                // key for [sector,keyAB] found
+                if (rpayload->found[keyAB] >= 0 && rpayload->found[keyAB] < req->count) {
+                    const uint8_t *key = &req->keys[rpayload->found[keyAB] * AES_KEY_LEN];
+                    if (verbose)
+                        PrintAndLogEx(INFO, "\nFound key for sector %d key %s [%s]", sector, keyAB == 0 ? "A" : "B", sprint_hex_inrow(key, 16));
+                    else
+                        PrintAndLogEx(NORMAL, "+" NOLF);
+
+                    foundKeys[keyAB][sector][0] = 0x01;
+                    memcpy(&foundKeys[keyAB][sector][1], key, AES_KEY_LEN);
+                    keyab &= ~(1 << keyAB);
+                }
             }
         }
     }
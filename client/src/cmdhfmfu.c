@@ -35,6 +35,10 @@
 #include "fileutils.h"      // saveFile
 #include "cmdtrace.h"       // trace list
 #include "preferences.h"    // setDeviceDebugLevel
+#include "scriptpipe.h"     // pipelined wrbl
+#include "scandir.h"
+#include "util.h"           // num_CPUs
+#include <pthread.h>
 
 #define MAX_UL_BLOCKS       0x0F
 #define MAX_ULC_BLOCKS      0x2F
@@ -1238,30 +1242,30 @@ static int ulev1_print_counters(void) {
     return len;
 }
 
-static int ulev1_print_signature(uint64_t tagtype, uint8_t *uid, uint8_t *signature, size_t signature_len) {
-
 #define PUBLIC_ECDA_KEYLEN 33
 #define PUBLIC_ECDA_192_KEYLEN 49
-    // known public keys for the originality check (source: https://github.com/alexbatalov/node-nxp-originality-verifier)
-    // ref: AN11350 NTAG 21x Originality Signature Validation
-    // ref: AN11341 MIFARE Ultralight EV1 Originality Signature Validation
-    const ecdsa_publickey_t nxp_mfu_public_keys[] = {
-        {"NXP MIFARE Classic MFC1C14_x",   "044F6D3F294DEA5737F0F46FFEE88A356EED95695DD7E0C27A591E6F6F65962BAF"},
-        {"MIFARE Classic / QL88",          "046F70AC557F5461CE5052C8E4A7838C11C7A236797E8A0730A101837C004039C2"},
-        {"NXP ICODE DNA, ICODE SLIX2",     "048878A2A2D3EEC336B4F261A082BD71F9BE11C4E2E896648B32EFA59CEA6E59F0"},
-        {"NXP Public key",                 "04A748B6A632FBEE2C0897702B33BEA1C074998E17B84ACA04FF267E5D2C91F6DC"},
-        {"NXP Ultralight Ev1",             "0490933BDCD6E99B4E255E3DA55389A827564E11718E017292FAF23226A96614B8"},
-        {"NXP NTAG21x (2013)",             "04494E1A386D3D3CFE3DC10E5DE68A499B1C202DB5B132393E89ED19FE5BE8BC61"},
-        {"MIKRON Public key",              "04F971EDA742A4A80D32DCF6A814A707CC3DC396D35902F72929FDCD698B3468F2"},
-        {"VivoKey Spark1 Public key",      "04D64BB732C0D214E7EC580736ACF847284B502C25C0F7F2FA86AACE1DADA4387A"},
-        {"TruST25 (ST) key 01?",           "041D92163650161A2548D33881C235D0FB2315C2C31A442F23C87ACF14497C0CBA"},
-        {"TruST25 (ST) key 04?",           "04101E188A8B4CDDBC62D5BC3E0E6850F0C2730E744B79765A0E079907FBDB01BC"},
-    };
+// known public keys for the originality check (source: https://github.com/alexbatalov/node-nxp-originality-verifier)
+// ref: AN11350 NTAG 21x Originality Signature Validation
+// ref: AN11341 MIFARE Ultralight EV1 Originality Signature Validation
+static const ecdsa_publickey_t nxp_mfu_public_keys[] = {
+    {"NXP MIFARE Classic MFC1C14_x",   "044F6D3F294DEA5737F0F46FFEE88A356EED95695DD7E0C27A591E6F6F65962BAF"},
+    {"MIFARE Classic / QL88",          "046F70AC557F5461CE5052C8E4A7838C11C7A236797E8A0730A101837C004039C2"},
+    {"NXP ICODE DNA, ICODE SLIX2",     "048878A2A2D3EEC336B4F261A082BD71F9BE11C4E2E896648B32EFA59CEA6E59F0"},
+    {"NXP Public key",                 "04A748B6A632FBEE2C0897702B33BEA1C074998E17B84ACA04FF267E5D2C91F6DC"},
+    {"NXP Ultralight Ev1",             "0490933BDCD6E99B4E255E3DA55389A827564E11718E017292FAF23226A96614B8"},
+    {"NXP NTAG21x (2013)",             "04494E1A386D3D3CFE3DC10E5DE68A499B1C202DB5B132393E89ED19FE5BE8BC61"},
+    {"MIKRON Public key",              "04F971EDA742A4A80D32DCF6A814A707CC3DC396D35902F72929FDCD698B3468F2"},
+    {"VivoKey Spark1 Public key",      "04D64BB732C0D214E7EC580736ACF847284B502C25C0F7F2FA86AACE1DADA4387A"},
+    {"TruST25 (ST) key 01?",           "041D92163650161A2548D33881C235D0FB2315C2C31A442F23C87ACF14497C0CBA"},
+    {"TruST25 (ST) key 04?",           "04101E188A8B4CDDBC62D5BC3E0E6850F0C2730E744B79765A0E079907FBDB01BC"},
+};
 
-    // https://www.nxp.com/docs/en/application-note/AN13452.pdf
-    const ecdsa_publickey_t nxp_mfu_192_public_keys[] = {
-        {"NXP Ultralight AES", "0453BF8C49B7BD9FE3207A91513B9C1D238ECAB07186B772104AB535F7D3AE63CF7C7F3DD0D169DA3E99E43C6399621A86"},
-    };
+// https://www.nxp.com/docs/en/application-note/AN13452.pdf
+static const ecdsa_publickey_t nxp_mfu_192_public_keys[] = {
+    {"NXP Ultralight AES", "0453BF8C49B7BD9FE3207A91513B9C1D238ECAB07186B772104AB535F7D3AE63CF7C7F3DD0D169DA3E99E43C6399621A86"},
+};
+
+static int ulev1_print_signature(uint64_t tagtype, uint8_t *uid, uint8_t *signature, size_t signature_len) {
 
     /*
         uint8_t nxp_mfu_public_keys[6][PUBLIC_ECDA_KEYLEN] = {
@@ -1482,6 +1486,59 @@ static char *mfu_generate_filename(const char *prefix, const char *suffix) {
     return fptr;
 }
 
+// read pages over CMD_HF_MIFAREU_READCARD_FAST,  the device sends them in chunks while it reads.
+// bytes_read gets what came back,  a partial read still returns PM3_SUCCESS
+static int mfu_read_card(uint8_t start, uint16_t pages, uint8_t keytype, const uint8_t *key, uint8_t keylen, bool fast, uint8_t *data, uint16_t maxbytes, uint16_t *bytes_read) {
+
+    mfu_readcard_t payload = {
+        .start = start,
+        .pages = pages,
+        .keytype = keytype,
+        .fast = fast,
+    };
+    if (key != NULL) {
+        memcpy(payload.key, key, MIN(keylen, sizeof(payload.key)));
+    }
+
+    *bytes_read = 0;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFAREU_READCARD_FAST, (uint8_t *)&payload, sizeof(payload));
+
+    bool fallback = false;
+    for (;;) {
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_MIFAREU_READCARD_FAST, &resp, 2500) == false) {
+            PrintAndLogEx(WARNING, "Command execute time-out");
+            return PM3_ETIMEOUT;
+        }
+
+        if (resp.length < sizeof(mfu_readcard_chunk_t)) {
+            return PM3_ESOFT;
+        }
+
+        const mfu_readcard_chunk_t *chunk = (const mfu_readcard_chunk_t *)resp.data.asBytes;
+        fallback = ((chunk->flags & MFU_READCARD_FALLBACK) == MFU_READCARD_FALLBACK);
+
+        if ((chunk->flags & MFU_READCARD_DONE) == MFU_READCARD_DONE) {
+            if (fallback) {
+                PrintAndLogEx(DEBUG, "FAST_READ failed,  read with READ");
+            }
+            return resp.status;
+        }
+
+        uint32_t offset = (chunk->page - start) * MFU_BLOCK_SIZE;
+        uint32_t n = chunk->count * MFU_BLOCK_SIZE;
+        if (chunk->page < start || offset + n > maxbytes || sizeof(mfu_readcard_chunk_t) + n > resp.length) {
+            PrintAndLogEx(FAILED, "Data exceeded buffer size!");
+            continue;
+        }
+
+        memcpy(data + offset, chunk->data, n);
+        *bytes_read = MAX(*bytes_read, offset + n);
+    }
+}
+
 static int mfu_dump_tag(uint16_t pages, void **pdata, uint16_t *len) {
 
     // read uid
@@ -1506,35 +1563,11 @@ static int mfu_dump_tag(uint16_t pages, void **pdata, uint16_t *len) {
     uint8_t key[4] = {0};
     num_to_bytes(ul_ev1_pwdgenB(card.uid), 4, key);
 
-    clearCommandBuffer();
-    SendCommandMIX(CMD_HF_MIFAREU_READCARD, 0, pages, keytype, key, 4);
-    PacketResponseNG resp;
-    if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false) {
-        PrintAndLogEx(WARNING, "Command execute time-out");
-        free(*pdata);
-        res = PM3_ETIMEOUT;
-        goto out;
-    }
-
-    if (resp.oldarg[0] != 1) {
+    uint16_t buffer_size = 0;
+    res = mfu_read_card(0, pages, keytype, key, sizeof(key), true, *pdata, maxbytes, &buffer_size);
+    if (res != PM3_SUCCESS) {
         PrintAndLogEx(WARNING, "Failed reading card");
         free(*pdata);
-        res = PM3_ESOFT;
-        goto out;
-    }
-
-    // read all memory
-    uint32_t startindex = resp.oldarg[2];
-    uint32_t buffer_size = resp.oldarg[1];
-    if (buffer_size > maxbytes) {
-        PrintAndLogEx(FAILED, "Data exceeded buffer size!");
-        buffer_size = maxbytes;
-    }
-
-    if (GetFromDevice(BIG_BUF, *pdata, buffer_size, startindex, NULL, 0, NULL, 2500, false) == false) {
-        PrintAndLogEx(WARNING, "command execution time out");
-        free(*pdata);
-        res = PM3_ETIMEOUT;
         goto out;
     }
 
@@ -1872,6 +1905,10 @@ out:
     return res;
 }
 
+static int mfu_write_check(const PacketResponseNG *resp) {
+    return (resp->oldarg[0] & 0xFF) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
 static int mfu_write_block(uint8_t *data, uint8_t datalen, bool has_auth_key,  bool has_pwd, uint8_t *auth_key_ptr, uint8_t blockno) {
 
     // 4 or 16.
@@ -1893,12 +1930,15 @@ static int mfu_write_block(uint8_t *data, uint8_t datalen, bool has_auth_key,  b
         cmdlen += 4;
     }
 
-    clearCommandBuffer();
-    if (datalen == 16) {
-        SendCommandMIX(CMD_HF_MIFAREU_WRITEBL_COMPAT, blockno, keytype, 0, cmd, cmdlen);
-    } else {
-        SendCommandMIX(CMD_HF_MIFAREU_WRITEBL, blockno, keytype, 0, cmd, cmdlen);
+    uint64_t wrcmd = (datalen == 16) ? CMD_HF_MIFAREU_WRITEBL_COMPAT : CMD_HF_MIFAREU_WRITEBL;
+
+    // pipelined script,  the outcome is checked later
+    if (scriptpipe_active()) {
+        return scriptpipe_queue_mix(wrcmd, blockno, keytype, 0, cmd, cmdlen, CMD_ACK, mfu_write_check);
     }
+
+    clearCommandBuffer();
+    SendCommandMIX(wrcmd, blockno, keytype, 0, cmd, cmdlen);
     PacketResponseNG resp;
     if (WaitForResponseTimeout(CMD_ACK, &resp, 1500) == false) {
         return PM3_ETIMEOUT;
@@ -2515,8 +2555,23 @@ static int CmdHF14AMfUWrBl(const char *Cmd) {
 
     uint8_t *auth_key_ptr = authenticationkey;
 
-    // starting with getting tagtype
-    uint64_t tagtype = GetHF14AMfU_Type();
+    // starting with getting tagtype,  a pipelined script only asks the card once between barriers
+    static uint64_t piped_tagtype = MFU_TT_UL_ERROR;
+    static uint32_t piped_gen = 0;
+    uint64_t tagtype;
+    if (scriptpipe_active() && piped_gen == scriptpipe_generation()) {
+        tagtype = piped_tagtype;
+    } else {
+        // no queued replies may be around while talking to the card
+        if (scriptpipe_active()) {
+            scriptpipe_flush();
+        }
+        tagtype = GetHF14AMfU_Type();
+        if (scriptpipe_active()) {
+            piped_tagtype = tagtype;
+            piped_gen = scriptpipe_generation();
+        }
+    }
     if (tagtype == MFU_TT_UL_ERROR)
         return PM3_ESOFT;
 
@@ -2552,6 +2607,9 @@ static int CmdHF14AMfUWrBl(const char *Cmd) {
 
     // Send write Block
     int res = mfu_write_block(data, datalen, has_auth_key, has_pwd, auth_key_ptr, blockno);
+    if (scriptpipe_active()) {
+        return res;
+    }
     switch (res) {
         case PM3_SUCCESS: {
             PrintAndLogEx(SUCCESS, "Write ( " _GREEN_("ok") " )");
@@ -2987,35 +3045,19 @@ static int CmdHF14AMfUDump(const char *Cmd) {
         return PM3_ESOFT;
     }
 
-    clearCommandBuffer();
-    SendCommandMIX(CMD_HF_MIFAREU_READCARD, start_page, pages, keytype, authKeyPtr, ak_len);
-    PacketResponseNG resp;
-    if (WaitForResponseTimeout(CMD_ACK, &resp, 2500) == false) {
-        PrintAndLogEx(WARNING, "Command execute time-out");
-        return PM3_ETIMEOUT;
-    }
-
-    if (resp.oldarg[0] != 1) {
-        PrintAndLogEx(WARNING, "Failed dumping card");
-        return PM3_ESOFT;
-    }
-
-    setDeviceDebugLevel(dbg_curr, false);
-
     // read all memory
     uint8_t data[1024] = {0x00};
-    memset(data, 0x00, sizeof(data));
+    uint16_t buffer_size = 0;
 
-    uint32_t startindex = resp.oldarg[2];
-    uint32_t buffer_size = resp.oldarg[1];
-    if (buffer_size > sizeof(data)) {
-        PrintAndLogEx(FAILED, "Data exceeded buffer size!");
-        buffer_size = sizeof(data);
-    }
+    // std UL, UL-C and my-d don't know FAST_READ,  the device would fall back after two tries anyway
+    bool fast = !(tagtype & MFU_TT_UL_C || tagtype & MFU_TT_UL || tagtype & MFU_TT_MY_D_MOVE || tagtype & MFU_TT_MY_D_MOVE_LEAN);
+    int res = mfu_read_card(start_page, pages, keytype, authKeyPtr, ak_len, fast, data, sizeof(data), &buffer_size);
 
-    if (GetFromDevice(BIG_BUF, data, buffer_size, startindex, NULL, 0, NULL, 2500, false) == false) {
-        PrintAndLogEx(WARNING, "command execution time out");
-        return PM3_ETIMEOUT;
+    setDeviceDebugLevel(dbg_curr, false);
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Failed dumping card");
+        return res;
     }
 
     bool is_partial = (pages != buffer_size / 4);
@@ -5155,26 +5197,390 @@ static int CmdHF14AMfuView(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+typedef struct {
+    char *path;
+    int status;
+    bool has_signature;
+    uint8_t uid[7];
+    uint8_t signature[32];
+} mfu_sigcheck_t;
+
+// bin or json dump file,  converted to the current dump format
+static int mfu_load_dump_file(const char *path, uint8_t **pdump, size_t *plen) {
+    uint8_t *dump = NULL;
+    size_t bytes_read = 0;
+    int res;
+
+    if (str_endswith(path, ".json")) {
+        dump = calloc(MFU_MAX_BYTES + MFU_DUMP_PREFIX_LENGTH, sizeof(uint8_t));
+        if (dump == NULL) {
+            return PM3_EMALLOC;
+        }
+        res = loadFileJSONex(path, dump, MFU_MAX_BYTES + MFU_DUMP_PREFIX_LENGTH, &bytes_read, false, NULL);
+    } else {
+        res = loadFile_safeEx(path, ".bin", (void **)&dump, &bytes_read, false);
+    }
+
+    if (res == PM3_SUCCESS && bytes_read < MFU_DUMP_PREFIX_LENGTH + 8) {
+        res = PM3_ESOFT;
+    }
+
+    if (res == PM3_SUCCESS) {
+        res = convert_mfu_dump_format(&dump, &bytes_read, false);
+    }
+
+    if (res != PM3_SUCCESS) {
+        free(dump);
+        return res;
+    }
+
+    *pdump = dump;
+    *plen = bytes_read;
+    return PM3_SUCCESS;
+}
+
+static void mfu_sigcheck_load(mfu_sigcheck_t *e) {
+    uint8_t *dump = NULL;
+    size_t bytes_read = 0;
+
+    e->status = mfu_load_dump_file(e->path, &dump, &bytes_read);
+    if (e->status == PM3_SUCCESS) {
+        mfu_dump_t *card = (mfu_dump_t *)dump;
+        // uid0-2 in page 0,  block check byte in between
+        memcpy(e->uid, card->data, 3);
+        memcpy(e->uid + 3, card->data + 4, 4);
+        memcpy(e->signature, card->signature, sizeof(e->signature));
+
+        uint8_t empty[sizeof(e->signature)] = {0};
+        e->has_signature = (memcmp(e->signature, empty, sizeof(empty)) != 0);
+    }
+    free(dump);
+}
+
+static size_t mfu_sigcheck_collect(const char *search, mfu_sigcheck_t **pentries) {
+    *pentries = NULL;
+
+    if (is_directory(search) == false) {
+        *pentries = calloc(1, sizeof(mfu_sigcheck_t));
+        if (*pentries == NULL) {
+            return 0;
+        }
+        (*pentries)[0].path = strdup(search);
+        return ((*pentries)[0].path) ? 1 : 0;
+    }
+
+    struct dirent **namelist;
+    int n = scandir(search, &namelist, NULL, alphasort);
+    if (n < 0) {
+        return 0;
+    }
+
+    mfu_sigcheck_t *entries = calloc(n, sizeof(mfu_sigcheck_t));
+    size_t cnt = 0;
+    for (int i = 0; i < n; i++) {
+        const char *name = namelist[i]->d_name;
+        if (entries && (str_endswith(name, ".bin") || str_endswith(name, ".json"))) {
+            size_t len = strlen(search) + strlen(name) + 2;
+            char *path = calloc(len, sizeof(char));
+            if (path) {
+                snprintf(path, len, "%s%s%s", search, str_endswith(search, PATHSEP) ? "" : PATHSEP, name);
+                if (is_directory(path) == false) {
+                    entries[cnt++].path = path;
+                } else {
+                    free(path);
+                }
+            }
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+
+    *pentries = entries;
+    return cnt;
+}
+
+static int CmdHF14AMfuSigCheck(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf mfu sigcheck",
+                  "Verify the originality signature of MIFARE Ultralight / NTAG dump files (bin/json)\n"
+                  "against the known public keys. A directory checks all its dumps in parallel",
+                  "hf mfu sigcheck -f hf-mfu-04579DB27C4880-dump.bin\n"
+                  "hf mfu sigcheck -f dumps/          --> all .bin / .json dumps in dumps\n"
+                  "hf mfu sigcheck -f dumps/ -t 4     --> use 4 threads"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "dump file or directory of dump files"),
+        arg_int0("t", "threads", "<dec>", "number of worker threads (def all cpus)"),
+        arg_lit0("v", "verbose", "list valid dumps too"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    int threads = arg_get_int_def(ctx, 2, num_CPUs());
+    bool verbose = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    mfu_sigcheck_t *entries = NULL;
+    size_t count = mfu_sigcheck_collect(filename, &entries);
+    if (count == 0) {
+        PrintAndLogEx(WARNING, "no dump files found for " _YELLOW_("%s"), filename);
+        free(entries);
+        return PM3_EFILE;
+    }
+
+    ecdsa_batch_item_t *items = calloc(count, sizeof(ecdsa_batch_item_t));
+    uint8_t *keys = calloc(ARRAYLEN(nxp_mfu_public_keys), PUBLIC_ECDA_KEYLEN);
+    if (items == NULL || keys == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        free(keys);
+        free(items);
+        for (size_t i = 0; i < count; i++) {
+            free(entries[i].path);
+        }
+        free(entries);
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0; i < ARRAYLEN(nxp_mfu_public_keys); i++) {
+        int dl = 0;
+        param_gethex_to_eol(nxp_mfu_public_keys[i].value, 0, keys + i * PUBLIC_ECDA_KEYLEN, PUBLIC_ECDA_KEYLEN, &dl);
+    }
+
+    // dumps keep the 32 byte signature only,  that is secp128r1 with the uid as message
+    size_t nitems = 0;
+    for (size_t i = 0; i < count; i++) {
+        mfu_sigcheck_load(&entries[i]);
+        if (entries[i].status == PM3_SUCCESS && entries[i].has_signature) {
+            items[nitems].input = entries[i].uid;
+            items[nitems].length = sizeof(entries[i].uid);
+            items[nitems].r_s = entries[i].signature;
+            items[nitems].r_s_len = sizeof(entries[i].signature);
+            nitems++;
+        }
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    PrintAndLogEx(INFO, "Checking " _YELLOW_("%zu") " signatures from " _YELLOW_("%zu") " files using " _YELLOW_("%d") " threads", nitems, count, MIN(threads, (int)MAX(nitems, 1)));
+
+    int res = ecdsa_signature_r_s_verify_batch(MBEDTLS_ECP_DP_SECP128R1, keys, ARRAYLEN(nxp_mfu_public_keys), items, nitems, false, threads);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "signature check failed");
+    }
+
+    size_t valid = 0, invalid = 0, nosig = 0, failed = 0;
+    PrintAndLogEx(NORMAL, "");
+    for (size_t i = 0, j = 0; i < count; i++) {
+        const mfu_sigcheck_t *e = &entries[i];
+        if (e->status != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "%s - " _RED_("failed to load"), e->path);
+            failed++;
+            continue;
+        }
+        if (e->has_signature == false) {
+            PrintAndLogEx(INFO, "%s - %s no signature", e->path, sprint_hex_inrow(e->uid, sizeof(e->uid)));
+            nosig++;
+            continue;
+        }
+
+        // items are in entry order
+        const ecdsa_batch_item_t *item = &items[j++];
+        if (item->key < 0) {
+            PrintAndLogEx(FAILED, "%s - %s signature ( " _RED_("fail") " )", e->path, sprint_hex_inrow(e->uid, sizeof(e->uid)));
+            invalid++;
+            continue;
+        }
+        if (verbose) {
+            PrintAndLogEx(SUCCESS, "%s - %s " _GREEN_("%s"), e->path, sprint_hex_inrow(e->uid, sizeof(e->uid)), nxp_mfu_public_keys[item->key].desc);
+        }
+        valid++;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "Valid " _GREEN_("%zu") ", failed " _RED_("%zu") ", no signature %zu, not loaded %zu of " _YELLOW_("%zu") " files", valid, invalid, nosig, failed, count);
+
+    free(keys);
+    free(items);
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].path);
+    }
+    free(entries);
+    return res;
+}
+
 static int CmdHF14AMfuList(const char *Cmd) {
     return CmdTraceListAlias(Cmd, "hf 14a", "14a -c");
 }
 
+typedef struct {
+    const nfc3d_amiibo_keys_t *keys;
+    uint8_t (*images)[NFC3D_AMIIBO_SIZE];
+    int *status;
+    size_t count;
+    size_t next;
+} mfu_amiibo_job_t;
+
+static void *mfu_amiibo_worker(void *arg) {
+    mfu_amiibo_job_t *job = (mfu_amiibo_job_t *)arg;
+
+    // master key HMACs get prepared once per thread
+    nfc3d_amiibo_ctx_t *actx = calloc(1, sizeof(nfc3d_amiibo_ctx_t));
+    if (actx == NULL) {
+        return NULL;
+    }
+    nfc3d_amiibo_ctx_init(actx, job->keys);
+
+    for (;;) {
+        size_t n = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+        if (n >= job->count) {
+            break;
+        }
+
+        if (job->status[n] != PM3_SUCCESS) {
+            continue;
+        }
+
+        uint8_t decrypted[NFC3D_AMIIBO_SIZE] = {0};
+        if (nfc3d_amiibo_unpack_ctx(actx, job->images[n], decrypted) == false) {
+            job->status[n] = PM3_ESOFT;
+        }
+    }
+
+    free(actx);
+    return NULL;
+}
+
+// decrypt and check the signatures of all amiibo dumps in a directory
+static int mfu_amiibo_verify_dir(const char *dir, const nfc3d_amiibo_keys_t *keys, int threads, bool verbose) {
+
+    mfu_sigcheck_t *entries = NULL;
+    size_t count = mfu_sigcheck_collect(dir, &entries);
+    if (count == 0) {
+        PrintAndLogEx(WARNING, "no dump files found for " _YELLOW_("%s"), dir);
+        free(entries);
+        return PM3_EFILE;
+    }
+
+    int res = PM3_SUCCESS;
+    uint8_t (*images)[NFC3D_AMIIBO_SIZE] = calloc(count, NFC3D_AMIIBO_SIZE);
+    int *status = calloc(count, sizeof(int));
+    int *loaded = calloc(count, sizeof(int));
+    pthread_t *pool = NULL;
+    if (images == NULL || status == NULL || loaded == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *dump = NULL;
+        size_t dumplen = 0;
+        loaded[i] = mfu_load_dump_file(entries[i].path, &dump, &dumplen);
+        if (loaded[i] == PM3_SUCCESS && dumplen < MFU_DUMP_PREFIX_LENGTH + NFC3D_AMIIBO_SIZE) {
+            loaded[i] = PM3_ESOFT;
+        }
+        if (loaded[i] == PM3_SUCCESS) {
+            memcpy(images[i], ((mfu_dump_t *)dump)->data, NFC3D_AMIIBO_SIZE);
+        }
+        status[i] = loaded[i];
+        free(dump);
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > count) {
+        threads = count;
+    }
+    PrintAndLogEx(INFO, "Checking " _YELLOW_("%zu") " files using " _YELLOW_("%d") " threads", count, threads);
+
+    mfu_amiibo_job_t job = {
+        .keys = keys,
+        .images = images,
+        .status = status,
+        .count = count,
+        .next = 0
+    };
+
+    pool = calloc(threads, sizeof(pthread_t));
+    if (pool == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&pool[started], NULL, mfu_amiibo_worker, &job)) {
+            break;
+        }
+    }
+
+    // the calling thread does the work if no worker could be started
+    if (started == 0) {
+        mfu_amiibo_worker(&job);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+
+    size_t valid = 0, invalid = 0, failed = 0;
+    PrintAndLogEx(NORMAL, "");
+    for (size_t i = 0; i < count; i++) {
+        if (loaded[i] != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "%s - " _RED_("failed to load"), entries[i].path);
+            failed++;
+        } else if (status[i] != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "%s - tag signature ( " _RED_("fail") " )", entries[i].path);
+            invalid++;
+        } else {
+            if (verbose) {
+                PrintAndLogEx(SUCCESS, "%s - tag signature ( " _GREEN_("ok") " )", entries[i].path);
+            }
+            valid++;
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(SUCCESS, "Valid " _GREEN_("%zu") ", failed " _RED_("%zu") ", not loaded %zu of " _YELLOW_("%zu") " files", valid, invalid, failed, count);
+
+out:
+    free(pool);
+    free(loaded);
+    free(status);
+    free(images);
+    for (size_t i = 0; i < count; i++) {
+        free(entries[i].path);
+    }
+    free(entries);
+    return res;
+}
+
 static int CmdHF14AAmiibo(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfu amiibo",
                   "Tries to read all memory from amiibo tag and decrypt it",
                   "hf mfu amiiboo --dec -f hf-mfu-04579DB27C4880-dump.bin  --> decrypt file\n"
-                  "hf mfu amiiboo -v --dec                                 --> decrypt tag"
+                  "hf mfu amiiboo -v --dec                                 --> decrypt tag\n"
+                  "hf mfu amiiboo --dec -i dumps/ -t 4                     --> check all dumps in dumps, 4 threads"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0(NULL, "dec", "Decrypt memory"),
         arg_lit0(NULL, "enc", "Encrypt memory"),
-        arg_str0("i", "in", "<fn>", "Specify a filename for input dump file"),
+        arg_str0("i", "in", "<fn>", "Specify a filename for input dump file, or a directory of dumps to check"),
         arg_str0("o", "out", "<fn>", "Specify a filename for output dump file"),
         arg_lit0("v", "verbose", "Verbose output"),
+        arg_int0("t", "threads", "<dec>", "number of worker threads for a directory (def all cpus)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -5191,6 +5597,7 @@ static int CmdHF14AAmiibo(const char *Cmd) {
     CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)outfilename, FILE_PATH_SIZE, &outfnlen);
 
     bool verbose = arg_get_lit(ctx, 5);
+    int threads = arg_get_int_def(ctx, 6, num_CPUs());
     CLIParserFree(ctx);
 
     // sanity checks
@@ -5206,6 +5613,14 @@ static int CmdHF14AAmiibo(const char *Cmd) {
         return PM3_EFILE;
     }
 
+    if (infnlen > 0 && is_directory(infilename)) {
+        return mfu_amiibo_verify_dir(infilename, &amiibo_keys, threads, verbose);
+    }
+
+    // unpack and pack of the same dump share the derived keys
+    nfc3d_amiibo_ctx_t amiibo_ctx;
+    nfc3d_amiibo_ctx_init(&amiibo_ctx, &amiibo_keys);
+
     int res = PM3_ESOFT;
 
     uint8_t original[NFC3D_AMIIBO_SIZE] = {0};
@@ -5252,7 +5667,7 @@ static int CmdHF14AAmiibo(const char *Cmd) {
 
     uint8_t decrypted[NFC3D_AMIIBO_SIZE] = {0};
     if (shall_decrypt) {
-        if (nfc3d_amiibo_unpack(&amiibo_keys, original, decrypted) == false) {
+        if (nfc3d_amiibo_unpack_ctx(&amiibo_ctx, original, decrypted) == false) {
             PrintAndLogEx(INFO, "Tag signature ( " _RED_("fail") " )");
             return PM3_ESOFT;
         }
@@ -5266,7 +5681,7 @@ static int CmdHF14AAmiibo(const char *Cmd) {
 
     if (shall_encrypt) {
         uint8_t encrypted[NFC3D_AMIIBO_SIZE] = {0};
-        nfc3d_amiibo_pack(&amiibo_keys, decrypted, encrypted);
+        nfc3d_amiibo_pack_ctx(&amiibo_ctx, decrypted, encrypted);
         // print
         if (verbose) {
             for (uint8_t i = 0; i < (NFC3D_AMIIBO_SIZE / 16); i++) {
@@ -5468,6 +5883,7 @@ static command_t CommandTable[] = {
     {"ndefread", CmdHF14MfuNDEFRead,        IfPm3Iso14443a,  "Prints NDEF records from card"},
     {"rdbl",     CmdHF14AMfURdBl,           IfPm3Iso14443a,  "Read block"},
     {"restore",  CmdHF14AMfURestore,        IfPm3Iso14443a,  "Restore a dump file onto a tag"},
+    {"sigcheck", CmdHF14AMfuSigCheck,       AlwaysAvailable, "Verify originality signature of dump files"},
     {"tamper",   CmdHF14MfUTamper,          IfPm3Iso14443a,  "NTAG 213TT - Configure the tamper feature"},
     {"view",     CmdHF14AMfuView,           AlwaysAvailable, "Display content from tag dump file"},
     {"wipe",     CmdHF14AMfuWipe,           IfPm3Iso14443a,  "Wipe card to zeros and default key"},
@@ -21,6 +21,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "cmdparser.h"      // command_t
 #include "cliparser.h"
@@ -40,9 +41,16 @@
 #include "flash.h"          // reboot to bootloader mode
 #include "proxgui.h"
 #include "graph.h"          // for graph data
+#include "jansson.h"
+#include "mifare/mifarehost.h" // hw bench workloads
+#include "mifare/mifaredefault.h"
+#include "pm3metrics.h"
 
 static int CmdHelp(const char *Cmd);
 
+// keys per chkkeys command,  5 header bytes and 6 bytes per key
+#define HW_BENCH_MAX_KEYS ((PM3_CMD_DATA_SIZE - 5) / 6)
+
 static void lookup_chipid_short(uint32_t iChipID, uint32_t mem_used) {
     const char *asBuff;
     switch (iChipID) {
@@ -955,6 +963,7 @@ static int CmdTune(const char *Cmd) {
     } PACKED;
 
     struct p *package = (struct p *)resp.data.asBytes;
+    pm3_metrics_antenna(package->v_lf125, package->v_lf134, package->v_hf);
 
     if (package->v_lf125 > NON_VOLTAGE)
         PrintAndLogEx(SUCCESS, "%.2f kHz ........... " _YELLOW_("%5.2f") " V", LF_DIV2FREQ(LF_DIVISOR_125), (package->v_lf125 * ANTENNA_ERROR) / 1000.0);
@@ -1340,6 +1349,761 @@ static int CmdPing(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdComms(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw comms",
+                  "Show statistics of the client side reply buffer",
+                  "hw comms\n"
+                  "hw comms --reset"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("r", "reset", "reset counters after showing them"),
+        arg_param_end
+    };
+
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool reset = arg_get_lit(ctx, 1);
+    CLIParserFree(ctx);
+
+    comms_stats_t stats;
+    GetCommunicationStats(&stats);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Reply buffer") " ----------------------");
+    PrintAndLogEx(INFO, "  Replies received....... %u", stats.stored);
+    PrintAndLogEx(INFO, "  Max depth.............. %u", stats.max_depth);
+    PrintAndLogEx(INFO, "  Capacity............... %u ( max %u )", stats.capacity, CMD_BUFFER_MAX_SIZE);
+    PrintAndLogEx(INFO, "  Grown.................. %u", stats.grows);
+    PrintAndLogEx(INFO, "  Dropped................ %s", (stats.overflows) ? _RED_("yes") : _GREEN_("none"));
+    if (stats.overflows) {
+        PrintAndLogEx(INFO, "  Dropped replies........ " _RED_("%u"), stats.overflows);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (reset) {
+        ResetCommunicationStats();
+        PrintAndLogEx(SUCCESS, "Counters reset");
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdTimings(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw timings",
+                  "Show per command round trip times measured by the client,\n"
+                  "and the time the device spent handling each command.\n"
+                  "Client times are from sending a command until its first reply.",
+                  "hw timings\n"
+                  "hw timings --reset\n"
+                  "hw timings -f timings.json"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("r", "reset", "reset timings after showing them"),
+        arg_str0("f", "file", "<fn>", "save timings as JSON to file"),
+        arg_param_end
+    };
+
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool reset = arg_get_lit(ctx, 1);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    CLIParserFree(ctx);
+
+    cmd_timing_t timings[CMD_TIMING_SLOTS];
+    size_t n = GetCommandTimings(timings, ARRAYLEN(timings));
+
+    // device side
+    handler_timing_t dev[HANDLER_TIMING_SLOTS];
+    size_t dev_n = 0;
+    bool dev_ok = false;
+    if (g_session.pm3_present) {
+        uint8_t flags = (reset) ? HANDLER_TIMING_FLAG_RESET : 0;
+        PacketResponseNG resp;
+        clearCommandBuffer();
+        SendCommandNG(CMD_GET_TIMINGS, &flags, sizeof(flags));
+        if (WaitForResponseTimeout(CMD_GET_TIMINGS, &resp, 2000) && resp.status == PM3_SUCCESS) {
+            dev_n = MIN(resp.length / sizeof(handler_timing_t), ARRAYLEN(dev));
+            memcpy(dev, resp.data.asBytes, dev_n * sizeof(handler_timing_t));
+            dev_ok = true;
+        } else {
+            PrintAndLogEx(WARNING, "Device didn't answer, firmware might be too old");
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Client round trip") " -----------------------------------------");
+    PrintAndLogEx(INFO, "  cmd  |  sent  | replied |  min ms  |  avg ms  |  max ms");
+    PrintAndLogEx(INFO, "-------+--------+---------+----------+----------+---------");
+    for (size_t i = 0; i < n; i++) {
+        cmd_timing_t *t = &timings[i];
+        if (t->replied) {
+            PrintAndLogEx(INFO, " %04x  | %6u | %7u | %8.1f | %8.1f | %8.1f"
+                          , t->cmd
+                          , t->sent
+                          , t->replied
+                          , t->min_us / 1000.0
+                          , (t->total_us / t->replied) / 1000.0
+                          , t->max_us / 1000.0
+                         );
+        } else {
+            PrintAndLogEx(INFO, " %04x  | %6u | %7u |        - |        - |        -", t->cmd, t->sent, t->replied);
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Client round trip histogram") " ( ms ) ---------------------");
+    char line[200] = {0};
+    int pos = snprintf(line, sizeof(line), "  cmd  |");
+    for (uint8_t b = 0; b < CMD_TIMING_BUCKETS - 1; b++) {
+        pos += snprintf(line + pos, sizeof(line) - pos, " <%-4u", GetCommandTimingBucketLimit(b));
+    }
+    snprintf(line + pos, sizeof(line) - pos, " more");
+    PrintAndLogEx(INFO, "%s", line);
+    for (size_t i = 0; i < n; i++) {
+        pos = snprintf(line, sizeof(line), " %04x  |", timings[i].cmd);
+        for (uint8_t b = 0; b < CMD_TIMING_BUCKETS; b++) {
+            pos += snprintf(line + pos, sizeof(line) - pos, " %5u", timings[i].hist[b]);
+        }
+        PrintAndLogEx(INFO, "%s", line);
+    }
+
+    if (dev_ok) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(INFO, "--- " _CYAN_("Device handler") " --------------------------------------------");
+        PrintAndLogEx(INFO, "  cmd  |  count  |  avg ms  |  max ms");
+        PrintAndLogEx(INFO, "-------+---------+----------+---------");
+        for (size_t i = 0; i < dev_n; i++) {
+            PrintAndLogEx(INFO, " %04x  | %7u | %8.1f | %7u"
+                          , dev[i].cmd
+                          , dev[i].count
+                          , (dev[i].count) ? (double)dev[i].total_ms / dev[i].count : 0.0
+                          , dev[i].max_ms
+                         );
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (fnlen) {
+        json_t *root = json_object();
+        json_t *buckets = json_array();
+        for (uint8_t b = 0; b < CMD_TIMING_BUCKETS - 1; b++) {
+            json_array_append_new(buckets, json_integer(GetCommandTimingBucketLimit(b)));
+        }
+        json_object_set_new(root, "buckets_ms", buckets);
+
+        json_t *client = json_array();
+        for (size_t i = 0; i < n; i++) {
+            cmd_timing_t *t = &timings[i];
+            json_t *e = json_object();
+            json_object_set_new(e, "cmd", json_integer(t->cmd));
+            json_object_set_new(e, "sent", json_integer(t->sent));
+            json_object_set_new(e, "replied", json_integer(t->replied));
+            if (t->replied) {
+                json_object_set_new(e, "min_us", json_integer(t->min_us));
+                json_object_set_new(e, "avg_us", json_integer(t->total_us / t->replied));
+                json_object_set_new(e, "max_us", json_integer(t->max_us));
+            }
+            json_t *hist = json_array();
+            for (uint8_t b = 0; b < CMD_TIMING_BUCKETS; b++) {
+                json_array_append_new(hist, json_integer(t->hist[b]));
+            }
+            json_object_set_new(e, "histogram", hist);
+            json_array_append_new(client, e);
+        }
+        json_object_set_new(root, "client", client);
+
+        if (dev_ok) {
+            json_t *device = json_array();
+            for (size_t i = 0; i < dev_n; i++) {
+                json_t *e = json_object();
+                json_object_set_new(e, "cmd", json_integer(dev[i].cmd));
+                json_object_set_new(e, "count", json_integer(dev[i].count));
+                json_object_set_new(e, "total_ms", json_integer(dev[i].total_ms));
+                json_object_set_new(e, "max_ms", json_integer(dev[i].max_ms));
+                json_array_append_new(device, e);
+            }
+            json_object_set_new(root, "device", device);
+        }
+
+        int res = json_dump_file(root, filename, JSON_INDENT(2));
+        json_decref(root);
+        if (res) {
+            PrintAndLogEx(ERR, "Can't save the file: %s", filename);
+            return PM3_EFILE;
+        }
+        PrintAndLogEx(SUCCESS, "Saved to " _YELLOW_("%s"), filename);
+    }
+
+    if (reset) {
+        ResetCommandTimings();
+        PrintAndLogEx(SUCCESS, "Timings reset");
+    }
+    return PM3_SUCCESS;
+}
+
+// hw bench workloads,  each op is timed from the client
+typedef enum {
+    HWB_PING = 0,
+    HWB_SELECT,
+    HWB_AUTH,
+    HWB_READ,
+    HWB_CHKKEYS,
+    HWB_NUM
+} hw_bench_op_t;
+
+static const char *hw_bench_names[HWB_NUM] = {"ping", "select", "auth", "read", "chkkeys"};
+static const uint16_t hw_bench_cmds[HWB_NUM] = {
+    CMD_PING,
+    CMD_HF_ISO14443A_READER,
+    CMD_HF_MIFARE_CHKKEYS,
+    CMD_HF_MIFARE_READBL,
+    CMD_HF_MIFARE_CHKKEYS
+};
+
+typedef struct {
+    uint32_t ok;
+    uint32_t fail;
+    uint64_t total_us;
+    uint32_t p50_us;
+    uint32_t p90_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    double dev_avg_ms;
+    bool dev_ok;
+} hw_bench_result_t;
+
+typedef struct {
+    uint8_t blockno;
+    uint8_t keytype;
+    uint8_t key[6];
+    // chkkeys batch,  wrong keys first and the right one last
+    uint8_t keys[6 * HW_BENCH_MAX_KEYS];
+    uint8_t keycnt;
+} hw_bench_target_t;
+
+static int hw_bench_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int hw_bench_op(hw_bench_op_t op, const hw_bench_target_t *t) {
+    PacketResponseNG resp;
+    uint64_t key = 0;
+    switch (op) {
+        case HWB_PING: {
+            uint8_t data[32] = {0};
+            clearCommandBuffer();
+            SendCommandNG(CMD_PING, data, sizeof(data));
+            if (WaitForResponseTimeout(CMD_PING, &resp, 1000) == false) {
+                return PM3_ETIMEOUT;
+            }
+            return PM3_SUCCESS;
+        }
+        case HWB_SELECT: {
+            clearCommandBuffer();
+            SendCommandMIX(CMD_HF_ISO14443A_READER, ISO14A_CONNECT | ISO14A_NO_RATS, 0, 0, NULL, 0);
+            if (WaitForResponseTimeout(CMD_ACK, &resp, 1000) == false) {
+                return PM3_ETIMEOUT;
+            }
+            // 0: couldn't read
+            return (resp.oldarg[0] == 0) ? PM3_ECARDEXCHANGE : PM3_SUCCESS;
+        }
+        case HWB_AUTH: {
+            return mfCheckKeys(t->blockno, t->keytype, true, 1, (uint8_t *)t->key, &key);
+        }
+        case HWB_READ: {
+            uint8_t data[MFBLOCK_SIZE];
+            return mfReadBlock(t->blockno, t->keytype, t->key, data);
+        }
+        case HWB_CHKKEYS: {
+            return mfCheckKeys(t->blockno, t->keytype, true, t->keycnt, (uint8_t *)t->keys, &key);
+        }
+        case HWB_NUM:
+        default:
+            return PM3_EINVARG;
+    }
+}
+
+// average device handler time of one command since the last reset
+static bool hw_bench_device_ms(uint16_t cmd, bool reset, double *avg_ms) {
+    uint8_t flags = (reset) ? HANDLER_TIMING_FLAG_RESET : 0;
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_GET_TIMINGS, &flags, sizeof(flags));
+    if (WaitForResponseTimeout(CMD_GET_TIMINGS, &resp, 2000) == false || resp.status != PM3_SUCCESS) {
+        return false;
+    }
+    if (avg_ms == NULL) {
+        return true;
+    }
+
+    *avg_ms = 0;
+    size_t n = MIN(resp.length / sizeof(handler_timing_t), HANDLER_TIMING_SLOTS);
+    const handler_timing_t *dev = (const handler_timing_t *)resp.data.asBytes;
+    for (size_t i = 0; i < n; i++) {
+        if (dev[i].cmd == cmd && dev[i].count) {
+            *avg_ms = (double)dev[i].total_ms / dev[i].count;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int hw_bench_run(hw_bench_op_t op, const hw_bench_target_t *t, uint32_t n, uint32_t *lat, hw_bench_result_t *r) {
+    memset(r, 0, sizeof(*r));
+
+    // the reply of CMD_GET_TIMINGS is counted too,  start from clean slots
+    bool dev = hw_bench_device_ms(0, true, NULL);
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!");
+            return PM3_EOPABORTED;
+        }
+
+        uint64_t t0 = usclock();
+        int res = hw_bench_op(op, t);
+        uint64_t dt = usclock() - t0;
+
+        if (res == PM3_ETIMEOUT && r->ok == 0) {
+            // nothing answers,  no point in waiting for the rest
+            r->fail = n;
+            return res;
+        }
+        if (res == PM3_SUCCESS) {
+            lat[r->ok++] = (uint32_t)MIN(dt, UINT32_MAX);
+            r->total_us += dt;
+        } else {
+            r->fail++;
+        }
+    }
+
+    if (r->ok) {
+        qsort(lat, r->ok, sizeof(uint32_t), hw_bench_cmp_u32);
+        r->p50_us = lat[(r->ok - 1) * 50 / 100];
+        r->p90_us = lat[(r->ok - 1) * 90 / 100];
+        r->p99_us = lat[(r->ok - 1) * 99 / 100];
+        r->max_us = lat[r->ok - 1];
+    }
+
+    if (dev) {
+        r->dev_ok = hw_bench_device_ms(hw_bench_cmds[op], false, &r->dev_avg_ms);
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdBench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw bench",
+                  "Run a fixed RF workload against a known target and report the transaction rates.\n"
+                  "The target is a reference MIFARE Classic card, or a second Proxmark3 running `hf mf sim`.\n"
+                  "Every op is timed by the client from sending the command until its reply,\n"
+                  "device time is the average time the device spent handling the command (ms resolution),\n"
+                  "the difference is the USB and client overhead.\n"
+                  "The workload is N pings, N selects, N auths, N block reads and N key checks of <cnt> keys",
+                  "hw bench                              -> 100 ops each, key A FFFFFFFFFFFF on block 0\n"
+                  "hw bench -n 1000 --blk 4 -k a0a1a2a3a4a5\n"
+                  "hw bench -n 500 -f bench.json         -> save results as JSON"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_u64_0("n", "num", "<dec>", "number of ops per workload (def 100)"),
+        arg_int0(NULL, "blk", "<dec>", "block number (def 0)"),
+        arg_lit0("a", NULL, "input key type is key A (def)"),
+        arg_lit0("b", NULL, "input key type is key B"),
+        arg_str0("k", "key", "<hex>", "key, 6 hex bytes (def FFFFFFFFFFFF)"),
+        arg_u64_0("c", "cnt", "<dec>", "keys per key check, the right one last (def 32, max 84)"),
+        arg_lit0(NULL, "no-rf", "only measure the USB baseline (ping)"),
+        arg_str0("f", "file", "<fn>", "save results as JSON to file"),
+        arg_param_end
+    };
+
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint32_t n = arg_get_u32_def(ctx, 1, 100);
+    hw_bench_target_t target = {
+        .blockno = arg_get_int_def(ctx, 2, 0),
+        .keytype = MF_KEY_A,
+    };
+    if (arg_get_lit(ctx, 3) && arg_get_lit(ctx, 4)) {
+        CLIParserFree(ctx);
+        PrintAndLogEx(WARNING, "Input key type must be A or B");
+        return PM3_EINVARG;
+    } else if (arg_get_lit(ctx, 4)) {
+        target.keytype = MF_KEY_B;
+    }
+
+    int keylen = 0;
+    uint8_t key[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    CLIGetHexWithReturn(ctx, 5, key, &keylen);
+    uint32_t keycnt = arg_get_u32_def(ctx, 6, 32);
+    bool no_rf = arg_get_lit(ctx, 7);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 8), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    CLIParserFree(ctx);
+
+    if (keylen && keylen != 6) {
+        PrintAndLogEx(WARNING, "Key must be 6 hex bytes");
+        return PM3_EINVARG;
+    }
+    if (n == 0) {
+        PrintAndLogEx(WARNING, "Number of ops must be larger than zero");
+        return PM3_EINVARG;
+    }
+    if (keycnt == 0 || keycnt > HW_BENCH_MAX_KEYS) {
+        PrintAndLogEx(WARNING, "Keys per key check must be 1 - %u", HW_BENCH_MAX_KEYS);
+        return PM3_EINVARG;
+    }
+
+    memcpy(target.key, key, sizeof(target.key));
+    target.keycnt = keycnt;
+    for (uint32_t i = 0; i < keycnt - 1; i++) {
+        // wrong keys,  flipping the last byte keeps them away from the right one
+        uint64_t k = bytes_to_num(key, sizeof(key)) ^ (((uint64_t)(i + 1) << 8) | 0xA5);
+        num_to_bytes(k, 6, target.keys + i * 6);
+    }
+    memcpy(target.keys + (keycnt - 1) * 6, key, 6);
+
+    uint32_t *lat = calloc(n, sizeof(uint32_t));
+    if (lat == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "Running " _YELLOW_("%u") " ops per workload, press " _GREEN_("<Enter>") " to abort", n);
+
+    hw_bench_result_t results[HWB_NUM] = {0};
+    hw_bench_op_t last = (no_rf) ? HWB_SELECT : HWB_NUM;
+    int res = PM3_SUCCESS;
+    for (hw_bench_op_t op = HWB_PING; op < last; op++) {
+        res = hw_bench_run(op, &target, n, lat, &results[op]);
+        if (res == PM3_EOPABORTED) {
+            break;
+        }
+        if (res == PM3_ETIMEOUT) {
+            PrintAndLogEx(WARNING, "%s timed out, is the target in the field?", hw_bench_names[op]);
+        }
+        if (op == HWB_SELECT && results[op].ok == 0) {
+            PrintAndLogEx(WARNING, "No card selected, skipping the MIFARE workloads");
+            last = HWB_AUTH;
+        }
+    }
+    free(lat);
+    if (no_rf == false) {
+        DropField();
+    }
+    if (res == PM3_EOPABORTED) {
+        return res;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Bench results") " ( latency in ms ) ------------------------------------------");
+    PrintAndLogEx(INFO, " op      |   ok  | fail |   ops/s  |   p50  |   p90  |   p99  |   max  | device | overhead");
+    PrintAndLogEx(INFO, "---------+-------+------+----------+--------+--------+--------+--------+--------+---------");
+    for (hw_bench_op_t op = HWB_PING; op < last; op++) {
+        hw_bench_result_t *r = &results[op];
+        if (r->ok == 0) {
+            PrintAndLogEx(INFO, " %-7s | %5u | %4u |        - |      - |      - |      - |      - |      - |       -", hw_bench_names[op], r->ok, r->fail);
+            continue;
+        }
+        double avg_ms = (double)r->total_us / r->ok / 1000.0;
+        char dev_str[16] = "     -";
+        char ovh_str[16] = "      -";
+        if (r->dev_ok) {
+            snprintf(dev_str, sizeof(dev_str), "%6.2f", r->dev_avg_ms);
+            snprintf(ovh_str, sizeof(ovh_str), "%7.2f", avg_ms - r->dev_avg_ms);
+        }
+        PrintAndLogEx(INFO, " %-7s | %5u | %4u | %8.1f | %6.2f | %6.2f | %6.2f | %6.2f | %s | %s"
+                      , hw_bench_names[op]
+                      , r->ok
+                      , r->fail
+                      , 1000.0 / avg_ms
+                      , r->p50_us / 1000.0
+                      , r->p90_us / 1000.0
+                      , r->p99_us / 1000.0
+                      , r->max_us / 1000.0
+                      , dev_str
+                      , ovh_str
+                     );
+    }
+    if (last > HWB_CHKKEYS && results[HWB_CHKKEYS].ok) {
+        double s = (double)results[HWB_CHKKEYS].total_us / 1000000.0;
+        PrintAndLogEx(INFO, "Key check rate... " _YELLOW_("%.1f") " keys/s", (double)results[HWB_CHKKEYS].ok * keycnt / s);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (fnlen) {
+        json_t *root = json_object();
+        json_object_set_new(root, "num", json_integer(n));
+        json_object_set_new(root, "block", json_integer(target.blockno));
+        json_object_set_new(root, "keys_per_check", json_integer(keycnt));
+        json_t *runs = json_array();
+        for (hw_bench_op_t op = HWB_PING; op < last; op++) {
+            hw_bench_result_t *r = &results[op];
+            json_t *e = json_object();
+            json_object_set_new(e, "op", json_string(hw_bench_names[op]));
+            json_object_set_new(e, "ok", json_integer(r->ok));
+            json_object_set_new(e, "fail", json_integer(r->fail));
+            if (r->ok) {
+                json_object_set_new(e, "avg_us", json_integer(r->total_us / r->ok));
+                json_object_set_new(e, "p50_us", json_integer(r->p50_us));
+                json_object_set_new(e, "p90_us", json_integer(r->p90_us));
+                json_object_set_new(e, "p99_us", json_integer(r->p99_us));
+                json_object_set_new(e, "max_us", json_integer(r->max_us));
+            }
+            if (r->dev_ok) {
+                json_object_set_new(e, "device_avg_ms", json_real(r->dev_avg_ms));
+            }
+            json_array_append_new(runs, e);
+        }
+        json_object_set_new(root, "runs", runs);
+
+        int jres = json_dump_file(root, filename, JSON_INDENT(2));
+        json_decref(root);
+        if (jres) {
+            PrintAndLogEx(ERR, "Can't save the file: %s", filename);
+            return PM3_EFILE;
+        }
+        PrintAndLogEx(SUCCESS, "Saved to " _YELLOW_("%s"), filename);
+    }
+    return PM3_SUCCESS;
+}
+
+static int CmdMemProf(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw memprof",
+                  "Device side memory profiler.  When enabled, the device records peak stack depth,\n"
+                  "peak BigBuf use (allocations plus trace) and time spent for every command it handles.\n"
+                  "Without options the recorded table is shown.",
+                  "hw memprof --on\n"
+                  "hw memprof\n"
+                  "hw memprof --off --reset"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "on", "enable profiling"),
+        arg_lit0(NULL, "off", "disable profiling"),
+        arg_lit0("r", "reset", "reset the table after showing it"),
+        arg_param_end
+    };
+
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool on = arg_get_lit(ctx, 1);
+    bool off = arg_get_lit(ctx, 2);
+    bool reset = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (on && off) {
+        PrintAndLogEx(ERR, "Select only one of --on or --off");
+        return PM3_EINVARG;
+    }
+
+    uint8_t flags = 0;
+    if (on) flags |= MEMPROF_FLAG_ENABLE;
+    if (off) flags |= MEMPROF_FLAG_DISABLE;
+    if (reset) flags |= MEMPROF_FLAG_RESET;
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_MEMPROF, &flags, sizeof(flags));
+    if (WaitForResponseTimeout(CMD_MEMPROF, &resp, 2000) == false) {
+        PrintAndLogEx(WARNING, "Device didn't answer, firmware might be too old");
+        return PM3_ETIMEOUT;
+    }
+    if (resp.status != PM3_SUCCESS || resp.length < sizeof(memprof_t)) {
+        PrintAndLogEx(ERR, "Invalid memory profile reply");
+        return PM3_ESOFT;
+    }
+
+    const memprof_t *mp = (const memprof_t *)resp.data.asBytes;
+    size_t n = MIN(mp->num, (resp.length - sizeof(memprof_t)) / sizeof(memprof_entry_t));
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Device memory profile") " -------------------------------------");
+    PrintAndLogEx(INFO, "Profiling... %s", (mp->enabled) ? _GREEN_("enabled") : "disabled");
+    PrintAndLogEx(INFO, "Stack....... %u bytes", mp->stack_size);
+    PrintAndLogEx(INFO, "BigBuf...... %u bytes", mp->bigbuf_size);
+    if (n) {
+        PrintAndLogEx(INFO, "  cmd  |  count  | stack peak  |  BigBuf peak   |  avg ms  ");
+        PrintAndLogEx(INFO, "-------+---------+-------------+----------------+----------");
+        for (size_t i = 0; i < n; i++) {
+            const memprof_entry_t *e = &mp->entries[i];
+            PrintAndLogEx(INFO, " %04x  | %7u | %5u ( %2u%% ) | %6u ( %3u%% ) | %8.1f"
+                          , e->cmd
+                          , e->count
+                          , e->peak_stack
+                          , (mp->stack_size) ? (e->peak_stack * 100) / mp->stack_size : 0
+                          , e->peak_bigbuf
+                          , (mp->bigbuf_size) ? (uint32_t)(((uint64_t)e->peak_bigbuf * 100) / mp->bigbuf_size) : 0
+                          , (e->count) ? (double)e->total_ms / e->count : 0.0
+                         );
+        }
+    } else if (mp->enabled == false) {
+        PrintAndLogEx(HINT, "Hint: Try `" _YELLOW_("hw memprof --on") "` to start profiling");
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (on) {
+        PrintAndLogEx(SUCCESS, "Memory profiling enabled");
+    }
+    if (off) {
+        PrintAndLogEx(SUCCESS, "Memory profiling disabled");
+    }
+    if (reset) {
+        PrintAndLogEx(SUCCESS, "Memory profile reset");
+    }
+    return PM3_SUCCESS;
+}
+
+// Final reply of sniff / sim,  only carries a payload when the firmware was built with DECODER_STATS=1
+void PrintDecoderStats(const uint8_t *data, size_t len) {
+    if (data == NULL || len != sizeof(decoder_stats_t)) {
+        return;
+    }
+
+    static const char *names[DECODER_STATS_NUM] = {
+        "14a Miller",
+        "14a Manchester",
+        "15 tag",
+        "15 reader",
+    };
+
+    const decoder_stats_t *ds = (const decoder_stats_t *)data;
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Decoder statistics") " -----------------------------------");
+    PrintAndLogEx(INFO, "     decoder     |   calls    |  avg us  |  max us  ");
+    PrintAndLogEx(INFO, "-----------------+------------+----------+----------");
+    for (int i = 0; i < DECODER_STATS_NUM; i++) {
+        const decoder_stat_t *d = &ds->dec[i];
+        if (d->calls == 0) {
+            continue;
+        }
+        // PIT ticks are 16 MCK cycles,  3 per us
+        PrintAndLogEx(INFO, " %-15s | %10u | %8.2f | %8.2f"
+                      , names[i]
+                      , d->calls
+                      , ((double)d->total / d->calls) / 3.0
+                      , (double)d->max / 3.0
+                     );
+    }
+    PrintAndLogEx(INFO, "SSC overruns...... %u", ds->overruns);
+    PrintAndLogEx(INFO, "DMA lost.......... %u", ds->dma_lost);
+    PrintAndLogEx(INFO, "Max DMA backlog... %u samples", ds->max_backlog);
+    PrintAndLogEx(NORMAL, "");
+}
+
+static int CmdAttach(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw attach",
+                  "Open an additional Proxmark3 next to the main one.\n"
+                  "Commands which can split their work, like `hf mf fchk`, use all attached devices",
+                  "hw attach -p "SERIAL_PORT_EXAMPLE_H"\n"
+                  "hw attach -p "SERIAL_PORT_EXAMPLE_H" -b 115200"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("p", "port", NULL, "Serial port of the device"),
+        arg_u64_0("b", "baud", "<dec>", "Baudrate"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int p_len = FILE_PATH_SIZE;
+    char port[FILE_PATH_SIZE] = {0};
+    CLIGetStrWithReturn(ctx, 1, (uint8_t *)port, &p_len);
+    uint32_t baudrate = arg_get_u32_def(ctx, 2, USART_BAUD_RATE);
+    CLIParserFree(ctx);
+
+    if (baudrate == 0) {
+        PrintAndLogEx(WARNING, "Baudrate can't be zero");
+        return PM3_EINVARG;
+    }
+
+    if (g_session.pm3_present == false) {
+        PrintAndLogEx(WARNING, "Connect the main device first, see " _YELLOW_("`hw connect`"));
+        return PM3_ENOTTY;
+    }
+
+    int res = AttachProxmark(port, baudrate);
+    if (res == PM3_EOVFLOW) {
+        PrintAndLogEx(WARNING, "Can't drive more than %u devices", PM3_MAX_DEVICES);
+        return res;
+    }
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark3 on " _YELLOW_("%s"), port);
+        return res;
+    }
+    PrintAndLogEx(SUCCESS, "Attached as device " _GREEN_("%u"), GetDeviceCount() - 1);
+    return PM3_SUCCESS;
+}
+
+static int CmdDetach(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw detach",
+                  "Close an additional Proxmark3 opened with `hw attach`",
+                  "hw detach -i 1"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_u64_1("i", "idx", "<dec>", "device index, see `hw devices`"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    uint32_t idx = arg_get_u32_def(ctx, 1, 0);
+    CLIParserFree(ctx);
+
+    if (idx == 0 || idx > 0xFF || DetachProxmark(idx) != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "No attached device with index %u", idx);
+        return PM3_EINVARG;
+    }
+    PrintAndLogEx(SUCCESS, "Device %u detached", idx);
+    return PM3_SUCCESS;
+}
+
+static int CmdDevices(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw devices",
+                  "List the devices this client drives, the main one is index 0",
+                  "hw devices"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+
+    uint8_t n = GetDeviceCount();
+    if (n == 0) {
+        PrintAndLogEx(INFO, "No device connected");
+        return PM3_SUCCESS;
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    for (uint8_t i = 0; i < n; i++) {
+        pm3_device_t *dev = GetDevice(i);
+        if (dev == NULL) {
+            continue;
+        }
+        PrintAndLogEx(INFO, " %u %s " _YELLOW_("%s"), i, (i == 0) ? "main" : "    ", dev->conn->serial_port_name);
+    }
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
 static int CmdConnect(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1431,6 +2195,139 @@ static int CmdBootloader(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static const char *antenna_stream_name(uint8_t source) {
+    switch (source) {
+        case ANTENNA_STREAM_LF:
+            return "LF antenna";
+        case ANTENNA_STREAM_HF:
+            return "HF antenna";
+        case ANTENNA_STREAM_LF_READER:
+            return "LF reader field";
+        case ANTENNA_STREAM_HF_READER:
+            return "HF reader field";
+        default:
+            return "?";
+    }
+}
+
+// Streaming tune,  the device measures on its own schedule and sends one report per
+// batch until <Enter>,  the button or req->reports.  Reports are optionally appended
+// to a CSV file,  antenna means also feed the metrics endpoint
+int antenna_stream(const antenna_stream_t *req, const char *filename, bool verbose) {
+
+    FILE *f = NULL;
+    if (filename && strlen(filename)) {
+        f = fopen(filename, "a");
+        if (f == NULL) {
+            PrintAndLogEx(ERR, "could not open " _YELLOW_("%s"), filename);
+            return PM3_EFILE;
+        }
+        // new file,  header first
+        if (ftell(f) == 0) {
+            fprintf(f, "time,seq,device_ms,source,count,min_mv,mean_mv,max_mv%s\n", (req->flags & ANTENNA_STREAM_FLAG_SAMPLES) ? ",samples_mv" : "");
+        }
+    }
+
+    PrintAndLogEx(INFO, "Streaming " _YELLOW_("%s") ", %u ms interval, %u readings per report"
+                  , antenna_stream_name(req->source)
+                  , req->interval_ms
+                  , req->batch
+                 );
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_MEASURE_ANTENNA_STREAM, (uint8_t *)req, sizeof(antenna_stream_t));
+
+    // a batch takes interval * batch on the device,  allow for it before giving up
+    uint64_t batch_ms = (uint64_t)req->interval_ms * req->batch;
+    uint64_t last = msclock();
+    uint32_t reports = 0;
+    bool stopping = false;
+    int res = PM3_SUCCESS;
+
+    for (;;) {
+        if (stopping == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(DEBUG, _GREEN_("<Enter>") " pressed");
+            stopping = true;
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_STREAM, &resp, 500) == false) {
+            if (msclock() - last > batch_ms + 2000) {
+                PrintAndLogEx(WARNING, "Timeout while waiting for antenna report, aborting");
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                res = PM3_ETIMEOUT;
+                break;
+            }
+            continue;
+        }
+        last = msclock();
+
+        // the empty frame ends the stream
+        if (resp.length == 0) {
+            if (resp.status != PM3_SUCCESS && resp.status != PM3_EOPABORTED) {
+                PrintAndLogEx(ERR, "Antenna stream failed ( %d )", resp.status);
+                res = resp.status;
+            }
+            break;
+        }
+
+        const antenna_stream_report_t *r = (const antenna_stream_report_t *)resp.data.asBytes;
+        if (resp.length < sizeof(antenna_stream_report_t) ||
+                resp.length != sizeof(antenna_stream_report_t) + r->nsamples * sizeof(uint16_t)) {
+            PrintAndLogEx(WARNING, "Wrong antenna report length %u", resp.length);
+            continue;
+        }
+        reports++;
+
+        PrintAndLogEx(SUCCESS, "#%-5u %8u ms  min " _YELLOW_("%6.2f") " V  mean " _GREEN_("%6.2f") " V  max " _YELLOW_("%6.2f") " V  ( %u )"
+                      , r->seq
+                      , r->ticks
+                      , (r->min_mv / 1000.0)
+                      , (r->mean_mv / 1000.0)
+                      , (r->max_mv / 1000.0)
+                      , r->count
+                     );
+
+        if (verbose && r->nsamples) {
+            char line[ANTENNA_STREAM_MAX_SAMPLES * 7 + 1] = {0};
+            size_t n = 0;
+            for (uint16_t i = 0; i < r->nsamples; i++) {
+                n += snprintf(line + n, sizeof(line) - n, "%u ", r->samples[i] << r->shift);
+            }
+            PrintAndLogEx(INFO, "   %s", line);
+        }
+
+        if (f) {
+            fprintf(f, "%ld,%u,%u,%u,%u,%u,%u,%u", (long)time(NULL), r->seq, r->ticks, r->source, r->count, r->min_mv, r->mean_mv, r->max_mv);
+            if (req->flags & ANTENNA_STREAM_FLAG_SAMPLES) {
+                fprintf(f, ",");
+                for (uint16_t i = 0; i < r->nsamples; i++) {
+                    fprintf(f, "%s%u", (i) ? " " : "", r->samples[i] << r->shift);
+                }
+            }
+            fprintf(f, "\n");
+            fflush(f);
+        }
+
+        if (r->source == ANTENNA_STREAM_HF) {
+            pm3_metrics_antenna(0, 0, r->mean_mv);
+        } else if (r->source == ANTENNA_STREAM_LF && req->divisor == LF_DIVISOR_125) {
+            pm3_metrics_antenna(r->mean_mv, 0, 0);
+        } else if (r->source == ANTENNA_STREAM_LF && req->divisor == LF_DIVISOR_134) {
+            pm3_metrics_antenna(0, r->mean_mv, 0);
+        }
+    }
+
+    if (f) {
+        fclose(f);
+        PrintAndLogEx(SUCCESS, "appended %u reports to " _YELLOW_("%s"), reports, filename);
+    }
+    PrintAndLogEx(INFO, "Done!");
+    return res;
+}
+
 int set_fpga_mode(uint8_t mode) {
     if (mode < FPGA_BITSTREAM_LF || mode > FPGA_BITSTREAM_HF_15) {
         return PM3_EINVARG;
@@ -1458,13 +2355,19 @@ static command_t CommandTable[] = {
     {"timeout",       CmdTimeout,      AlwaysAvailable,  "Set the communication timeout on the client side"},
     {"version",       CmdVersion,      AlwaysAvailable,  "Show version information about the client and Proxmark3"},
     {"-------------", CmdHelp,         AlwaysAvailable,  "----------------------- " _CYAN_("Hardware") " -----------------------"},
+    {"attach",        CmdAttach,       IfPm3Present,     "Open an additional device, used to split work across devices"},
+    {"bench",         CmdBench,        IfPm3Present,     "Benchmark RF transaction rates against a known target"},
     {"break",         CmdBreak,        IfPm3Present,     "Send break loop usb command"},
     {"bootloader",    CmdBootloader,   IfPm3Present,     "Reboot into bootloader mode"},
+    {"comms",         CmdComms,        AlwaysAvailable,  "Show client side reply buffer statistics"},
     {"connect",       CmdConnect,      AlwaysAvailable,  "Connect to the device via serial port"},
     {"dbg",           CmdDbg,          IfPm3Present,     "Set device side debug level"},
+    {"detach",        CmdDetach,       IfPm3Present,     "Close an additional device"},
+    {"devices",       CmdDevices,      AlwaysAvailable,  "List the devices in use"},
     {"fpgaoff",       CmdFPGAOff,      IfPm3Present,     "Turn off FPGA on device"},
     {"lcd",           CmdLCD,          IfPm3Lcd,         "Send command/data to LCD"},
     {"lcdreset",      CmdLCDReset,     IfPm3Lcd,         "Hardware reset LCD"},
+    {"memprof",       CmdMemProf,      IfPm3Present,     "Profile device stack, BigBuf and time per command"},
     {"ping",          CmdPing,         IfPm3Present,     "Test if the Proxmark3 is responsive"},
     {"readmem",       CmdReadmem,      IfPm3Present,     "Read from MCU flash"},
     {"reset",         CmdReset,        IfPm3Present,     "Reset the device"},
@@ -1473,6 +2376,7 @@ static command_t CommandTable[] = {
     {"setmux",        CmdSetMux,       IfPm3Present,     "Set the ADC mux to a specific value"},
     {"standalone",    CmdStandalone,   IfPm3Present,     "Start installed standalone mode on device"},
     {"tia",           CmdTia,          IfPm3Present,     "Trigger a Timing Interval Acquisition to re-adjust the RealTimeCounter divider"},
+    {"timings",       CmdTimings,      AlwaysAvailable,  "Show per command round trip and device handler timings"},
     {"tune",          CmdTune,         IfPm3Present,     "Measure tuning of device antenna"},
     {NULL, NULL, NULL, NULL}
 };
@@ -28,4 +28,6 @@ int handle_tearoff(tearoff_params_t *params, bool verbose);
 void pm3_version(bool verbose, bool oneliner);
 void pm3_version_short(void);
 int set_fpga_mode(uint8_t mode);
+void PrintDecoderStats(const uint8_t *data, size_t len);
+int antenna_stream(const antenna_stream_t *req, const char *filename, bool verbose);
 #endif
@@ -30,6 +30,8 @@
 #include "proxgui.h"
 #include "cliparser.h"      // args parsing
 #include "graph.h"          // for graph data
+#include "lfstream.h"       // live demod of real-time samples
+#include "fileutils.h"      // wave export
 #include "cmddata.h"        // for `lf search`
 #include "cmdhw.h"          // for setting FPGA image
 #include "cmdlfawid.h"      // for awid menu
@@ -67,6 +69,8 @@
 #include "cmdlfzx8211.h"    // for ZX8211 menu
 #include "crc.h"
 #include "pm3_cmd.h"        // for LF_CMDREAD_MAX_EXTRA_SYMBOLS
+#include "pm3_result.h"
+#include "util_posix.h"     // msclock
 
 static int CmdHelp(const char *Cmd);
 
@@ -96,6 +100,102 @@ int lfsim_wait_check(uint32_t cmd) {
     return PM3_SUCCESS;
 }
 
+void lfsim_brute_init(lfsim_brute_t *b, const lf_simbrute_t *cfg, bool verbose) {
+    memset(b, 0, sizeof(lfsim_brute_t));
+    lf_simbrute_t *payload = (lf_simbrute_t *)b->buf;
+    memcpy(payload, cfg, sizeof(lf_simbrute_t));
+    payload->count = 0;
+
+    uint16_t bytes = (payload->bitslen + 7) / 8;
+    b->max = MIN(LF_SIM_BRUTE_MAX_COUNT, (sizeof(b->buf) - sizeof(lf_simbrute_t)) / bytes);
+    b->verbose = verbose;
+}
+
+// queue one candidate,  the batch goes to the device once it is full
+int lfsim_brute_add(lfsim_brute_t *b, const uint8_t *bits, const char *label) {
+    lf_simbrute_t *payload = (lf_simbrute_t *)b->buf;
+    uint16_t bytes = (payload->bitslen + 7) / 8;
+
+    uint8_t *dst = payload->data + payload->count * bytes;
+    memset(dst, 0, bytes);
+    for (uint16_t i = 0; i < payload->bitslen; i++) {
+        if (bits[i]) {
+            dst[i >> 3] |= 1 << (7 - (i & 7));
+        }
+    }
+    strncpy(b->label[payload->count], label, sizeof(b->label[0]) - 1);
+    payload->count++;
+
+    if (payload->count == b->max) {
+        return lfsim_brute_flush(b);
+    }
+    return PM3_SUCCESS;
+}
+
+// simulate the queued candidates and wait for the device to walk them,  <Enter> aborts
+int lfsim_brute_flush(lfsim_brute_t *b) {
+    lf_simbrute_t *payload = (lf_simbrute_t *)b->buf;
+    if (payload->count == 0) {
+        return PM3_SUCCESS;
+    }
+
+    uint16_t bytes = (payload->bitslen + 7) / 8;
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_SIM_BRUTE, b->buf, sizeof(lf_simbrute_t) + payload->count * bytes);
+
+    // every candidate costs ~20ms of field setup on top of its dwell
+    uint64_t timeout = (uint64_t)payload->count * (payload->dwell + 100) + 3000;
+    uint64_t t1 = msclock();
+    bool kbd = false;
+
+    PacketResponseNG resp;
+    while (WaitForResponseTimeout(CMD_LF_SIM_BRUTE, &resp, 100) == false) {
+
+        if (g_session.pm3_present == false) {
+            PrintAndLogEx(WARNING, "Device offline\n");
+            return PM3_ENODATA;
+        }
+
+        if (kbd == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            kbd = true;
+        }
+
+        if (msclock() - t1 > timeout) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply");
+            return PM3_ETIMEOUT;
+        }
+    }
+
+    uint8_t done = (resp.length) ? MIN(resp.data.asBytes[0], payload->count) : 0;
+    if (b->verbose) {
+        for (uint8_t i = 0; i < done; i++) {
+            PrintAndLogEx(INFO, "Tried %s", b->label[i]);
+        }
+    }
+    b->tried += done;
+    uint8_t count = payload->count;
+    payload->count = 0;
+
+    if (resp.status == PM3_EOPABORTED) {
+        if (kbd) {
+            PrintAndLogEx(WARNING, "aborted via keyboard!");
+        } else {
+            PrintAndLogEx(INFO, "Button pressed, user aborted");
+        }
+        if (done < count) {
+            PrintAndLogEx(INFO, "Simulating %s when stopped", b->label[done]);
+        }
+        PrintAndLogEx(INFO, "Tried " _YELLOW_("%u") " candidates", b->tried);
+        return PM3_EOPABORTED;
+    }
+
+    if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "Failed to simulate candidates ( %d )", resp.status);
+    }
+    return resp.status;
+}
+
 static int CmdLFTune(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -103,20 +203,28 @@ static int CmdLFTune(const char *Cmd) {
                   "Continuously measure LF antenna tuning.\n"
                   "Press button or <Enter> to interrupt.",
                   "lf tune\n"
-                  "lf tune --mix"
+                  "lf tune --mix\n"
+                  "lf tune --stream --interval 100 --batch 10    -> one report a second\n"
+                  "lf tune --stream --field -f lf_field.csv      -> log an external reader field"
                  );
 
     char q_str[60];
     snprintf(q_str, sizeof(q_str), "Frequency divisor. %d -> 134 kHz, %d -> 125 kHz", LF_DIVISOR_134, LF_DIVISOR_125);
     void *argtable[] = {
         arg_param_begin,
-        arg_u64_0("n", "iter", "<dec>", "number of iterations (default: 0=infinite)"),
+        arg_u64_0("n", "iter", "<dec>", "number of iterations, reports with --stream (default: 0=infinite)"),
         arg_u64_0("q", "divisor", "<dec>", q_str),
         arg_dbl0("f", "freq", "<float>", "Frequency in kHz"),
         arg_lit0(NULL, "bar", "bar style"),
         arg_lit0(NULL, "mix", "mixed style"),
         arg_lit0(NULL, "value", "values style"),
         arg_lit0("v", "verbose", "verbose output"),
+        arg_lit0(NULL, "stream", "device measures on its own and sends batched reports"),
+        arg_u64_0(NULL, "interval", "<ms>", "stream, time between readings (default: 10)"),
+        arg_u64_0(NULL, "batch", "<dec>", "stream, readings per report (default: 10)"),
+        arg_lit0(NULL, "samples", "stream, include the readings in each report"),
+        arg_lit0(NULL, "field", "stream, measure an external reader field instead of our antenna"),
+        arg_str0("f", "file", "<fn>", "stream, append reports to CSV file"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -128,6 +236,14 @@ static int CmdLFTune(const char *Cmd) {
     bool is_mix = arg_get_lit(ctx, 5);
     bool is_value = arg_get_lit(ctx, 6);
     bool verbose = arg_get_lit(ctx, 7);
+    bool stream = arg_get_lit(ctx, 8);
+    uint32_t interval = arg_get_u32_def(ctx, 9, 10);
+    uint32_t batch = arg_get_u32_def(ctx, 10, 10);
+    bool samples = arg_get_lit(ctx, 11);
+    bool field = arg_get_lit(ctx, 12);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 13), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     if (divisor < 19) {
@@ -154,6 +270,30 @@ static int CmdLFTune(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (stream) {
+        if (interval > 0xFFFF || batch == 0 || batch > 0xFFFF) {
+            PrintAndLogEx(ERR, "interval must be 0 - 65535 ms and batch 1 - 65535");
+            return PM3_EINVARG;
+        }
+        antenna_stream_t req = {
+            .source = (field) ? ANTENNA_STREAM_LF_READER : ANTENNA_STREAM_LF,
+            .divisor = divisor,
+            .flags = (samples) ? ANTENNA_STREAM_FLAG_SAMPLES : 0,
+            .interval_ms = interval,
+            .batch = batch,
+            .reports = iter,
+        };
+        if (field == false) {
+            PrintAndLogEx(INFO, "Measuring LF antenna at " _YELLOW_("%.2f") " kHz", LF_DIV2FREQ(divisor));
+        }
+        return antenna_stream(&req, filename, verbose);
+    }
+
+    if (samples || field || fnlen) {
+        PrintAndLogEx(ERR, "`--samples`, `--field` and `-f` need `--stream`");
+        return PM3_EINVARG;
+    }
+
     barMode_t style = g_session.bar_mode;
     if (is_bar) {
         style = STYLE_BAR;
@@ -457,12 +597,11 @@ int CmdFlexdemod(const char *Cmd) {
 #endif
     int i, j, start, bit, sum;
 
-    int *data = calloc(g_GraphTraceLen, sizeof(int));
+    int32_t *data = getGraphBufferS32(NULL);
     if (data == NULL) {
         PrintAndLogEx(FAILED, "failed to allocate memory");
         return PM3_EMALLOC;
     }
-    memcpy(data, g_GraphBuffer, g_GraphTraceLen);
 
     size_t size = g_GraphTraceLen;
 
@@ -725,7 +864,7 @@ int CmdLFConfig(const char *Cmd) {
     return lf_config(&config);
 }
 
-static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
+static int lf_read_internal(bool realtime, bool verbose, uint64_t samples, lfstream_t *live) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
     lf_sample_payload_t payload = {0};
@@ -761,15 +900,24 @@ static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
             return result;
         }
 
+        // live decoding, the progress output would drown the found ids
+        raw_data_cb_t cb = NULL;
+        bool show = true;
+        if (live) {
+            lfstream_restart(live, bits_per_sample);
+            cb = lfstream_push_cb;
+            show = false;
+        }
+
         SendCommandNG(CMD_LF_ACQ_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
         if (is_trigger_threshold_set) {
             size_t first_receive_len = 32;
             // Wait until a bunch of data arrives
-            first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true);
+            first_receive_len = WaitForRawDataTimeoutEx(realtimeBuf, first_receive_len, -1, false, cb, live);
+            sample_bytes = WaitForRawDataTimeoutEx(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, show, cb, live);
             sample_bytes += first_receive_len;
         } else {
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf, sample_bytes, 1000, true);
+            sample_bytes = WaitForRawDataTimeoutEx(realtimeBuf, sample_bytes, 1000, show, cb, live);
         }
         samples = sample_bytes * 8 / bits_per_sample;
         PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
@@ -799,7 +947,7 @@ static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
 }
 
 int lf_read(bool verbose, uint64_t samples) {
-    return lf_read_internal(false, verbose, samples);
+    return lf_read_internal(false, verbose, samples, NULL);
 }
 
 int CmdLFRead(const char *Cmd) {
@@ -812,6 +960,7 @@ int CmdLFRead(const char *Cmd) {
                   _CYAN_("it will try to use the real-time sampling mode."),
                   "lf read -v -s 12000   --> collect 12000 samples\n"
                   "lf read -s 3000 -@    --> oscilloscope style \n"
+                  "lf read -s 500000 --live -@   --> report EM410x / HID / AWID / Indala ids while sampling\n"
                  );
 
     void *argtable[] = {
@@ -819,29 +968,51 @@ int CmdLFRead(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous reading mode"),
+        arg_lit0(NULL, "live", "decode tag ids while sampling (real-time mode only)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint64_t samples = arg_get_u64_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    bool use_live = arg_get_lit(ctx, 4);
     CLIParserFree(ctx);
 
     // the 40000 there should be the result of BigBuf_max_traceLen(),
     // but IDK how to get it.
     bool realtime = samples > 40000;
 
+    if (use_live && realtime == false) {
+        PrintAndLogEx(WARNING, "live decoding needs real-time mode, use more than 40000 samples");
+        return PM3_EINVARG;
+    }
+
     if (g_session.pm3_present == false)
         return PM3_ENOTTY;
 
+    lfstream_t *live = NULL;
+    if (use_live) {
+        live = calloc(1, sizeof(lfstream_t));
+        if (live == NULL) {
+            PrintAndLogEx(FAILED, "failed to allocate memory");
+            return PM3_EMALLOC;
+        }
+        lfstream_init(live, 8);
+    }
+
     if (cm || realtime) {
         PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
     }
     int ret = PM3_SUCCESS;
     do {
-        ret = lf_read_internal(realtime, verbose, samples);
+        ret = lf_read_internal(realtime, verbose, samples, live);
     } while (cm && kbd_enter_pressed() == false);
 
+    if (live) {
+        lfstream_summary(live);
+        free(live);
+    }
+
     if (ret == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "Got " _YELLOW_("%zu") " samples", g_GraphTraceLen);
 
@@ -852,7 +1023,7 @@ int CmdLFRead(const char *Cmd) {
     return ret;
 }
 
-int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
+int lf_sniff(bool realtime, bool verbose, uint64_t samples, const char *wavfn) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
     lf_sample_payload_t payload = {0};
@@ -888,18 +1059,31 @@ int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
             return result;
         }
 
+        // write the samples to disk as they arrive
+        wave_stream_t ws;
+        raw_data_cb_t cb = NULL;
+        if (wavfn) {
+            uint32_t rate = LF_DIV2FREQ(current_config.divisor) * 1000 / MAX(current_config.decimation, 1);
+            if (WaveStreamOpen(&ws, wavfn, rate, bits_per_sample) == PM3_SUCCESS) {
+                cb = WaveStreamWrite_cb;
+            }
+        }
+
         SendCommandNG(CMD_LF_SNIFF_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
         if (is_trigger_threshold_set) {
             size_t first_receive_len = 32;
             // Wait until a bunch of data arrives
-            first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true);
+            first_receive_len = WaitForRawDataTimeoutEx(realtimeBuf, first_receive_len, -1, false, cb, &ws);
+            sample_bytes = WaitForRawDataTimeoutEx(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true, cb, &ws);
             sample_bytes += first_receive_len;
         } else {
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf, sample_bytes, 1000, true);
+            sample_bytes = WaitForRawDataTimeoutEx(realtimeBuf, sample_bytes, 1000, true, cb, &ws);
         }
         samples = sample_bytes * 8 / bits_per_sample;
         PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
+        if (cb) {
+            WaveStreamClose(&ws);
+        }
         if (samples != 0) {
             getSamplesFromBufEx(realtimeBuf, samples, bits_per_sample, verbose);
         }
@@ -920,6 +1104,9 @@ int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
         // response is number of bits read
         uint32_t size = (resp.data.asDwords[0] / bits_per_sample);
         getSamples(size, verbose);
+        if (wavfn) {
+            saveFileWAVE(wavfn, g_GraphBuffer, g_GraphTraceLen);
+        }
     }
 
     return PM3_SUCCESS;
@@ -938,6 +1125,7 @@ int CmdLFSniff(const char *Cmd) {
                   _CYAN_("it will try to use the real-time sampling mode."),
                   "lf sniff -v\n"
                   "lf sniff -s 3000 -@    --> oscilloscope style \n"
+                  "lf sniff -s 2000000 --wav sniff    --> real-time sniff written to sniff.wav\n"
                  );
 
     void *argtable[] = {
@@ -945,12 +1133,16 @@ int CmdLFSniff(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous sniffing mode"),
+        arg_str0(NULL, "wav", "<fn>", "save samples to wave file, streamed while sniffing in real-time mode"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint64_t samples = arg_get_u64_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     // the 40000 there should be the result of BigBuf_max_traceLen(),
@@ -965,7 +1157,7 @@ int CmdLFSniff(const char *Cmd) {
     }
     int ret = PM3_SUCCESS;
     do {
-        ret = lf_sniff(realtime, verbose, samples);
+        ret = lf_sniff(realtime, verbose, samples, (fnlen) ? filename : NULL);
     } while (cm && kbd_enter_pressed() == false);
     return ret;
 }
@@ -982,6 +1174,25 @@ static void lf_chk_bitstream(void) {
 }
 
 // Uploads g_GraphBuffer to device, in order to be used for LF SIM.
+// run length encode samples from <start> into pairs of (run, value),  run 1..255.
+// Stops when <out> is full,  returns the number of samples covered and sets <outlen>
+static size_t lfsim_rle_encode(size_t start, uint8_t *out, size_t outsize, size_t *outlen) {
+    size_t i = start;
+    size_t n = 0;
+    while (i < g_GraphTraceLen && n + 2 <= outsize) {
+        uint8_t v = (uint8_t)g_GraphBuffer[i];
+        uint8_t run = 1;
+        while (run < 0xFF && (i + run) < g_GraphTraceLen && (uint8_t)g_GraphBuffer[i + run] == v) {
+            run++;
+        }
+        out[n++] = run;
+        out[n++] = v;
+        i += run;
+    }
+    *outlen = n;
+    return i - start;
+}
+
 int lfsim_upload_gb(void) {
     PrintAndLogEx(DEBUG, "DEBUG: Uploading %zu bytes", g_GraphTraceLen);
 
@@ -994,6 +1205,8 @@ int lfsim_upload_gb(void) {
     // flag =
     //    b0  0
     //        1 clear bigbuff
+    //    b1  0 data is one byte per sample
+    //        1 data is run length encoded,  (run, value) pairs
     payload_up.flag = 0x1;
 
     // fast push mode
@@ -1001,18 +1214,32 @@ int lfsim_upload_gb(void) {
 
     PacketResponseNG resp;
 
-    //can send only 512 bits at a time (1 byte sent per bit...)
+    // LF waveforms are long runs of the same value,  every chunk goes run length
+    // encoded unless that covers less samples than a plain chunk would
     PrintAndLogEx(INFO, "." NOLF);
-    for (size_t i = 0; i < g_GraphTraceLen; i += PM3_CMD_DATA_SIZE - 3) {
+    size_t packets = 0;
+    for (size_t i = 0; i < g_GraphTraceLen;) {
 
-        size_t len = MIN((g_GraphTraceLen - i), PM3_CMD_DATA_SIZE - 3);
         clearCommandBuffer();
         payload_up.offset = i;
 
-        for (size_t j = 0; j < len; j++)
-            payload_up.data[j] = g_GraphBuffer[i + j];
+        size_t len = MIN((g_GraphTraceLen - i), sizeof(payload_up.data));
+        size_t rle_len = 0;
+        size_t rle_samples = lfsim_rle_encode(i, payload_up.data, sizeof(payload_up.data), &rle_len);
+
+        uint16_t datalen;
+        if (rle_samples > len || (rle_samples == len && rle_len < len)) {
+            payload_up.flag |= 0x2;
+            datalen = rle_len;
+            len = rle_samples;
+        } else {
+            payload_up.flag &= ~0x2;
+            for (size_t j = 0; j < len; j++)
+                payload_up.data[j] = g_GraphBuffer[i + j];
+            datalen = len;
+        }
 
-        SendCommandNG(CMD_LF_UPLOAD_SIM_SAMPLES, (uint8_t *)&payload_up, sizeof(struct pupload));
+        SendCommandNG(CMD_LF_UPLOAD_SIM_SAMPLES, (uint8_t *)&payload_up, 3 + datalen);
         WaitForResponse(CMD_LF_UPLOAD_SIM_SAMPLES, &resp);
         if (resp.status != PM3_SUCCESS) {
             PrintAndLogEx(INFO, "Bigbuf is full");
@@ -1021,8 +1248,11 @@ int lfsim_upload_gb(void) {
         PrintAndLogEx(NORMAL, "." NOLF);
         fflush(stdout);
         payload_up.flag = 0;
+        packets++;
+        i += len;
     }
     PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(DEBUG, "DEBUG: Uploaded in %zu packets", packets);
 
     // Disable fast mode before last command
     g_conn.block_after_ACK = false;
@@ -1538,7 +1768,7 @@ static bool check_chiptype(bool getDeviceData) {
     if (!getDeviceData) return retval;
 
     //Save the state of the Graph and Demod Buffers
-    buffer_savestate_t saveState_gb = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
+    buffer_savestate_t saveState_gb = save_bufferS16(g_GraphBuffer, g_GraphTraceLen);
     saveState_gb.offset = g_GridOffset;
     buffer_savestate_t saveState_db = save_buffer8(g_DemodBuffer, g_DemodBufferLen);
     saveState_db.clock = g_DemodClock;
@@ -1585,7 +1815,7 @@ out:
     g_DemodClock = saveState_db.clock;
     g_DemodStartIdx = saveState_db.offset;
 
-    restore_bufferS32(saveState_gb, g_GraphBuffer);
+    restore_bufferS16(saveState_gb, g_GraphBuffer);
     g_GridOffset = saveState_gb.offset;
 
     return retval;
@@ -1680,6 +1910,7 @@ int CmdLFfind(const char *Cmd) {
         if (IfPm3Hitag()) {
             if (readHitagUid() == PM3_SUCCESS) {
                 PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Hitag") " found!");
+                pm3_result_append("tags", json_string("Hitag"));
                 if (search_cont) {
                     found++;
                 } else {
@@ -1692,6 +1923,7 @@ int CmdLFfind(const char *Cmd) {
         if (IfPm3EM4x50()) {
             if (read_em4x50_uid() == PM3_SUCCESS) {
                 PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("EM4x50 ID") " found!");
+                pm3_result_append("tags", json_string("EM4x50 ID"));
                 if (search_cont) {
                     found++;
                 } else {
@@ -1708,6 +1940,7 @@ int CmdLFfind(const char *Cmd) {
             PrintAndLogEx(INPLACE, "Searching for MOTOROLA tag...");
             if (readMotorolaUid()) {
                 PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Motorola FlexPass ID") " found!");
+                pm3_result_append("tags", json_string("Motorola FlexPass ID"));
                 if (search_cont) {
                     found++;
                 } else {
@@ -1718,6 +1951,7 @@ int CmdLFfind(const char *Cmd) {
             PrintAndLogEx(INPLACE, "Searching for COTAG tag...");
             if (readCOTAGUid()) {
                 PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("COTAG ID") " found!");
+                pm3_result_append("tags", json_string("COTAG ID"));
                 if (search_cont) {
                     found++;
                 } else {
@@ -1740,6 +1974,7 @@ int CmdLFfind(const char *Cmd) {
     // ask / man
     if (demodEM410x(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("EM410x ID") " found!");
+        pm3_result_append("tags", json_string("EM410x ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1748,6 +1983,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodDestron(true) == PM3_SUCCESS) { // to do before HID
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-A FECAVA Destron ID") " found!");
+        pm3_result_append("tags", json_string("FDX-A FECAVA Destron ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1756,6 +1992,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodGallagher(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("GALLAGHER ID") " found!");
+        pm3_result_append("tags", json_string("GALLAGHER ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1764,6 +2001,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodNoralsy(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Noralsy ID") " found!");
+        pm3_result_append("tags", json_string("Noralsy ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1772,6 +2010,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodPresco(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Presco ID") " found!");
+        pm3_result_append("tags", json_string("Presco ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1780,6 +2019,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodSecurakey(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Securakey ID") " found!");
+        pm3_result_append("tags", json_string("Securakey ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1788,6 +2028,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodViking(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Viking ID") " found!");
+        pm3_result_append("tags", json_string("Viking ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1796,6 +2037,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodVisa2k(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Visa2000 ID") " found!");
+        pm3_result_append("tags", json_string("Visa2000 ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1806,6 +2048,7 @@ int CmdLFfind(const char *Cmd) {
     // ask / bi
     if (demodFDXB(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("FDX-B ID") " found!");
+        pm3_result_append("tags", json_string("FDX-B ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1814,6 +2057,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodJablotron(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Jablotron ID") " found!");
+        pm3_result_append("tags", json_string("Jablotron ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1822,6 +2066,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodGuard(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Guardall G-Prox II ID") " found!");
+        pm3_result_append("tags", json_string("Guardall G-Prox II ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1830,6 +2075,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodNedap(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NEDAP ID") " found!");
+        pm3_result_append("tags", json_string("NEDAP ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1840,6 +2086,7 @@ int CmdLFfind(const char *Cmd) {
     // nrz
     if (demodPac(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("PAC/Stanley ID") " found!");
+        pm3_result_append("tags", json_string("PAC/Stanley ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1850,6 +2097,7 @@ int CmdLFfind(const char *Cmd) {
     // fsk
     if (demodHID(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("HID Prox ID") " found!");
+        pm3_result_append("tags", json_string("HID Prox ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1858,6 +2106,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodAWID(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("AWID ID") " found!");
+        pm3_result_append("tags", json_string("AWID ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1866,6 +2115,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodIOProx(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("IO Prox ID") " found!");
+        pm3_result_append("tags", json_string("IO Prox ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1874,6 +2124,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodPyramid(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Pyramid ID") " found!");
+        pm3_result_append("tags", json_string("Pyramid ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1882,6 +2133,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodParadox(true, false) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Paradox ID") " found!");
+        pm3_result_append("tags", json_string("Paradox ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1892,6 +2144,7 @@ int CmdLFfind(const char *Cmd) {
     // psk
     if (demodIdteck(NULL, true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Idteck ID") " found!");
+        pm3_result_append("tags", json_string("Idteck ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1900,6 +2153,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodKeri(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("KERI ID") " found!");
+        pm3_result_append("tags", json_string("KERI ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1908,6 +2162,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodNexWatch(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("NexWatch ID") " found!");
+        pm3_result_append("tags", json_string("NexWatch ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1916,6 +2171,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodIndala(true) == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Indala ID") " found!");
+        pm3_result_append("tags", json_string("Indala ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1925,6 +2181,7 @@ int CmdLFfind(const char *Cmd) {
     /*
     if (demodTI() == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Texas Instrument ID") " found!");
+        pm3_result_append("tags", json_string("Texas Instrument ID"));
         if (search_cont) {
             found++;
         } else {
@@ -1933,6 +2190,7 @@ int CmdLFfind(const char *Cmd) {
     }
     if (demodFermax() == PM3_SUCCESS) {
         PrintAndLogEx(SUCCESS, "\nValid " _GREEN_("Fermax ID") " found!");
+        pm3_result_append("tags", json_string("Fermax ID"));
         if (search_cont) {
             found++;
         } else {
@@ -24,6 +24,16 @@
 
 #define T55XX_WRITE_TIMEOUT 1500
 
+// candidates of a lf <tag> brute command,  sent in batches of CMD_LF_SIM_BRUTE
+#define LFSIM_BRUTE_LABEL_LEN 64
+typedef struct {
+    uint8_t buf[PM3_CMD_DATA_SIZE];                           // lf_simbrute_t and the packed bitstreams
+    char label[LF_SIM_BRUTE_MAX_COUNT][LFSIM_BRUTE_LABEL_LEN]; // candidate description for the messages
+    uint8_t max;                                              // candidates per batch
+    uint32_t tried;
+    bool verbose;
+} lfsim_brute_t;
+
 int CmdLF(const char *Cmd);
 
 int CmdLFConfig(const char *Cmd);
@@ -41,11 +51,15 @@ int CmdVchDemod(const char *Cmd);
 int CmdLFfind(const char *Cmd);
 
 int lf_read(bool verbose, uint64_t samples);
-int lf_sniff(bool realtime, bool verbose, uint64_t samples);
+int lf_sniff(bool realtime, bool verbose, uint64_t samples, const char *wavfn);
 int lf_config(sample_config *config);
 int lf_getconfig(sample_config *config);
 int lfsim_upload_gb(void);
 int lfsim_wait_check(uint32_t cmd);
 
+void lfsim_brute_init(lfsim_brute_t *b, const lf_simbrute_t *cfg, bool verbose);
+int lfsim_brute_add(lfsim_brute_t *b, const uint8_t *bits, const char *label);
+int lfsim_brute_flush(lfsim_brute_t *b);
+
 int lf_config_savereset(sample_config *config);
 #endif
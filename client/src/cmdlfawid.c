@@ -36,41 +36,16 @@
 
 static int CmdHelp(const char *Cmd);
 
-static int sendPing(void) {
-    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-    SendCommandNG(CMD_PING, NULL, 0);
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    if (WaitForResponseTimeout(CMD_PING, &resp, 1000) == false) {
-        return PM3_ETIMEOUT;
-    }
-    return PM3_SUCCESS;
-}
-
-static int sendTry(uint8_t fmtlen, uint32_t fc, uint32_t cn, uint32_t delay, uint8_t *bits, size_t bs_len, bool verbose) {
-
-    if (verbose) {
-        PrintAndLogEx(INFO, "Trying FC: " _YELLOW_("%u") " CN: " _YELLOW_("%u"), fc, cn);
-    }
+static int sendTry(lfsim_brute_t *b, uint8_t fmtlen, uint32_t fc, uint32_t cn, uint8_t *bits) {
 
     if (getAWIDBits(fmtlen, fc, cn, bits) != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Error with tag bitstream generation.");
         return PM3_ESOFT;
     }
 
-    lf_fsksim_t *payload = calloc(1, sizeof(lf_fsksim_t) + bs_len);
-    payload->fchigh = 10;
-    payload->fclow = 8;
-    payload->separator = 1;
-    payload->clock = 50;
-    memcpy(payload->data, bits, bs_len);
-
-    clearCommandBuffer();
-    SendCommandNG(CMD_LF_FSK_SIMULATE, (uint8_t *)payload,  sizeof(lf_fsksim_t) + bs_len);
-    free(payload);
-
-    msleep(delay);
-    return sendPing();
+    char label[LFSIM_BRUTE_LABEL_LEN];
+    snprintf(label, sizeof(label), "FC: %u CN: %u", fc, cn);
+    return lfsim_brute_add(b, bits, label);
 }
 
 static void verify_values(uint8_t *fmtlen, uint32_t *fc, uint32_t *cn) {
@@ -551,38 +526,53 @@ static int CmdAWIDBrute(const char *Cmd) {
     uint16_t down = cn;
 
     uint8_t bits[96];
-    size_t size = sizeof(bits);
-    memset(bits, 0x00, size);
+    memset(bits, 0x00, sizeof(bits));
+
+    // AWID uses: FSK2a fcHigh: 10, fcLow: 8, clk: 50,  the device walks the candidates
+    lf_simbrute_t cfg = {
+        .modulation = LF_SIM_BRUTE_FSK,
+        .fchigh = 10,
+        .fclow = 8,
+        .separator = 1,
+        .clock = 50,
+        .dwell = MIN(delay, 0xFFFF),
+        .bitslen = sizeof(bits),
+    };
+    lfsim_brute_t *b = calloc(1, sizeof(lfsim_brute_t));
+    if (b == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    lfsim_brute_init(b, &cfg, verbose);
 
     // main loop
-    for (;;) {
+    int res = PM3_SUCCESS;
+    while (res == PM3_SUCCESS) {
 
-        if (!g_session.pm3_present) {
-            PrintAndLogEx(WARNING, "Device offline\n");
-            return PM3_ENODATA;
-        }
-        if (kbd_enter_pressed()) {
-            PrintAndLogEx(WARNING, "aborted via keyboard!");
-            return sendPing();
-        }
+        bool more = false;
 
         // Do one up
         if (up < 0xFFFF) {
-            if (sendTry(fmtlen, fc, up++, delay, bits, size, verbose) != PM3_SUCCESS) {
-                return PM3_ESOFT;
-            }
+            res = sendTry(b, fmtlen, fc, up++, bits);
+            more = true;
         }
 
         // Do one down  (if cardnumber is given)
-        if (cn > 1) {
-            if (down > 1) {
-                if (sendTry(fmtlen, fc, --down, delay, bits, size, verbose) != PM3_SUCCESS) {
-                    return PM3_ESOFT;
-                }
-            }
+        if (res == PM3_SUCCESS && cn > 1 && down > 1) {
+            res = sendTry(b, fmtlen, fc, --down, bits);
+            more = true;
+        }
+
+        if (more == false) {
+            break;
         }
     }
-    return PM3_SUCCESS;
+
+    if (res == PM3_SUCCESS) {
+        res = lfsim_brute_flush(b);
+    }
+    free(b);
+    return res;
 }
 
 static command_t CommandTable[] = {
@@ -53,18 +53,17 @@ static int CmdHelp(const char *Cmd);
  */
 
 // Construct the graph for emulating an EM410X tag
-static void em410x_construct_emul_graph(uint8_t *uid, uint8_t clock, uint8_t gap) {
-
-    // clear our graph
-    ClearGraph(true);
+// EM410x bitstream with <gap> leading zeros,  returns the length (gap + 64)
+static uint16_t em410x_sim_bits(const uint8_t *uid, uint8_t gap, uint8_t *bits) {
+    uint16_t n = 0;
 
     // write 16 zero bit sledge
     for (uint8_t i = 0; i < gap; i++)
-        AppendGraph(false, clock, 0);
+        bits[n++] = 0;
 
     // write 9 start bits
     for (uint8_t i = 0; i < 9; i++)
-        AppendGraph(false, clock, 1);
+        bits[n++] = 1;
 
     uint8_t bs[8], parity[8];
     memset(parity, 0, sizeof(parity));
@@ -78,13 +77,13 @@ static void em410x_construct_emul_graph(uint8_t *uid, uint8_t clock, uint8_t gap
 
         for (uint8_t j = 0; j < 2; j++) {
             // append each bit
-            AppendGraph(false, clock, bs[0 + (4 * j)]);
-            AppendGraph(false, clock, bs[1 + (4 * j)]);
-            AppendGraph(false, clock, bs[2 + (4 * j)]);
-            AppendGraph(false, clock, bs[3 + (4 * j)]);
+            bits[n++] = bs[0 + (4 * j)];
+            bits[n++] = bs[1 + (4 * j)];
+            bits[n++] = bs[2 + (4 * j)];
+            bits[n++] = bs[3 + (4 * j)];
 
             // append parity bit
-            AppendGraph(false, clock, bs[0 + (4 * j)] ^ bs[1 + (4 * j)] ^ bs[2 + (4 * j)] ^ bs[3 + (4 * j)]);
+            bits[n++] = bs[0 + (4 * j)] ^ bs[1 + (4 * j)] ^ bs[2 + (4 * j)] ^ bs[3 + (4 * j)];
 
             // keep track of column parity
             parity[0] ^= bs[0 + (4 * j)];
@@ -95,13 +94,26 @@ static void em410x_construct_emul_graph(uint8_t *uid, uint8_t clock, uint8_t gap
     }
 
     // parity columns
-    AppendGraph(false, clock, parity[0]);
-    AppendGraph(false, clock, parity[1]);
-    AppendGraph(false, clock, parity[2]);
-    AppendGraph(false, clock, parity[3]);
+    bits[n++] = parity[0];
+    bits[n++] = parity[1];
+    bits[n++] = parity[2];
+    bits[n++] = parity[3];
 
     // stop bit
-    AppendGraph(true, clock, 0);
+    bits[n++] = 0;
+    return n;
+}
+
+static void em410x_construct_emul_graph(uint8_t *uid, uint8_t clock, uint8_t gap) {
+
+    uint8_t bits[UINT8_MAX + 64];
+    uint16_t n = em410x_sim_bits(uid, gap, bits);
+
+    // clear our graph
+    ClearGraph(true);
+
+    for (uint16_t i = 0; i < n; i++)
+        AppendGraph(i == n - 1, clock, bits[i]);
 }
 
 // print 64 bit EM410x ID in multiple formats
@@ -510,7 +522,7 @@ static int CmdEM410xBrute(const char *Cmd) {
 
     // clock default 64 in EM410x
     uint32_t clk = arg_get_u32_def(ctx, 1, 64);
-    int gap = arg_get_u32_def(ctx, 4, 20);
+    int gap = MIN(arg_get_u32_def(ctx, 4, 20), LF_SIM_BRUTE_MAX_BITS - 64);
     // default pause time: 1 second
     uint32_t delay = arg_get_u32_def(ctx, 2, 1000);
 
@@ -588,48 +600,43 @@ static int CmdEM410xBrute(const char *Cmd) {
     }
 
     PrintAndLogEx(SUCCESS, "Loaded "_YELLOW_("%d")" EM Tag IDs from "_YELLOW_("%s")", pause delay:"_YELLOW_("%d")" ms", uidcnt, filename, delay);
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort simulation");
+
+    // ASK/Manchester,  the device walks the IDs
+    lf_simbrute_t cfg = {
+        .modulation = LF_SIM_BRUTE_ASK,
+        .encoding = 1,
+        .clock = clk,
+        .dwell = MIN(delay, 0xFFFF),
+        .bitslen = gap + 64,
+    };
+    lfsim_brute_t *b = calloc(1, sizeof(lfsim_brute_t));
+    if (b == NULL) {
+        PrintAndLogEx(ERR, "Error: can't allocate memory");
+        free(uidblock);
+        return PM3_EMALLOC;
+    }
+    lfsim_brute_init(b, &cfg, true);
 
     // loop
-    uint8_t testuid[5];
-    for (uint32_t c = 0; c < uidcnt; ++c) {
-        if (kbd_enter_pressed()) {
-            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-            PrintAndLogEx(WARNING, "aborted via keyboard!\n");
-            free(uidblock);
-            return PM3_EOPABORTED;
-        }
-
-        memcpy(testuid, uidblock + 5 * c, 5);
-        PrintAndLogEx(INFO, "Bruteforce %d / %u: simulating EM Tag ID " _YELLOW_("%s")
-                      , c + 1
-                      , uidcnt
-                      , sprint_hex_inrow(testuid, sizeof(testuid))
-                     );
+    int res = PM3_SUCCESS;
+    uint8_t bits[LF_SIM_BRUTE_MAX_BITS];
+    for (uint32_t c = 0; c < uidcnt && res == PM3_SUCCESS; ++c) {
 
-        em410x_construct_emul_graph(testuid, clk, gap);
+        const uint8_t *testuid = uidblock + 5 * c;
+        em410x_sim_bits(testuid, gap, bits);
 
-        lfsim_upload_gb();
-
-        struct p {
-            uint16_t len;
-            uint16_t gap;
-        } PACKED payload;
-        payload.len = g_GraphTraceLen;
-        payload.gap = 0;
-
-        clearCommandBuffer();
-        SendCommandNG(CMD_LF_SIMULATE, (uint8_t *)&payload, sizeof(payload));
+        char label[LFSIM_BRUTE_LABEL_LEN];
+        snprintf(label, sizeof(label), "%u / %u: EM Tag ID %s", c + 1, uidcnt, sprint_hex_inrow(testuid, 5));
+        res = lfsim_brute_add(b, bits, label);
+    }
 
-        PacketResponseNG resp;
-        if (WaitForResponseTimeout(CMD_LF_SIMULATE, &resp, delay)) {
-            if (resp.status == PM3_EOPABORTED) {
-                PrintAndLogEx(INFO, "Button pressed, user aborted");
-                break;
-            }
-        }
+    if (res == PM3_SUCCESS) {
+        res = lfsim_brute_flush(b);
     }
+    free(b);
     free(uidblock);
-    return PM3_SUCCESS;
+    return res;
 }
 
 //currently only supports manchester modulations
@@ -1804,13 +1804,15 @@ int CmdEM4x05Brute(const char *Cmd) {
                   "Note: if you get many false positives, change position on the antenna"
                   "lf em 4x05 brute\n"
                   "lf em 4x05 brute -n 1            -> stop after first candidate found\n"
-                  "lf em 4x05 brute -s 000022AA     -> start at 000022AA"
+                  "lf em 4x05 brute -s 000022AA     -> start at 000022AA\n"
+                  "lf em 4x05 brute --resume        -> continue from the flash checkpoint (RDV4)"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("s", "start", "<hex>", "Start bruteforce enumeration from this password value"),
         arg_u64_0("n", NULL, "<dec>", "Stop after having found n candidates. Default: 0 (infinite)"),
+        arg_lit0(NULL, "resume", "Continue the interrupted bruteforce from its flash checkpoint"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1823,17 +1825,25 @@ int CmdEM4x05Brute(const char *Cmd) {
     }
 
     uint32_t n = arg_get_u32_def(ctx, 2, 0);
+    bool resume = arg_get_lit(ctx, 3);
     CLIParserFree(ctx);
 
+    if (resume && IfPm3Flash() == false) {
+        PrintAndLogEx(WARNING, "no flash memory available");
+        return PM3_EFLASH;
+    }
+
     PrintAndLogEx(NORMAL, "");
 
     struct {
         uint32_t start_pwd;
         uint32_t n;
+        uint8_t resume;
     } PACKED payload;
 
     payload.start_pwd = start_pwd;
     payload.n = n;
+    payload.resume = resume;
 
     clearCommandBuffer();
     SendCommandNG(CMD_LF_EM4X_BF, (uint8_t *)&payload, sizeof(payload));
@@ -2264,7 +2274,7 @@ int CmdEM4x05Unlock(const char *Cmd) {
     return exit_code;
 }
 
-static size_t em4x05_Sniff_GetNextBitStart(size_t idx, size_t sc, const int *data, size_t *pulsesamples) {
+static size_t em4x05_Sniff_GetNextBitStart(size_t idx, size_t sc, const int16_t *data, size_t *pulsesamples) {
     while ((idx < sc) && (data[idx] <= 10)) // find a going high
         idx++;
 
@@ -19,7 +19,6 @@
 #include "cliparser.h"
 #include "cmdlfem4x50.h"
 #include <ctype.h>
-#include <math.h>
 #include "cmdparser.h"    // command_t
 #include "util_posix.h"  // msclock
 #include "fileutils.h"
@@ -360,15 +359,17 @@ static int CmdEM4x50Brute(const char *Cmd) {
                   "lf em 4x50 brute --mode range --begin 12330000 --end 12340000 -> tries pwds from 0x12330000 to 0x12340000\n"
                   "lf em 4x50 brute --mode charset --digits --uppercase -> tries all combinations of ASCII codes for digits and uppercase letters\n"
                   "lf em 4x50 brute --mode smart -> enable 'smart' pattern key cracking\n"
+                  "lf em 4x50 brute --resume -> continue from the flash checkpoint (RDV4)\n"
                  );
 
     void *argtable[] = {
         arg_param_begin,
-        arg_str1(NULL, "mode", "<str>", "Bruteforce mode (range|charset|smart)"),
+        arg_str0(NULL, "mode", "<str>", "Bruteforce mode (range|charset|smart)"),
         arg_str0(NULL, "begin", "<hex>",   "Range mode - start of the key range"),
         arg_str0(NULL, "end", "<hex>",   "Range mode - end of the key range"),
         arg_lit0(NULL, "digits",  "Charset mode - include ASCII codes for digits"),
         arg_lit0(NULL, "uppercase",  "Charset mode - include ASCII codes for uppercase letters"),
+        arg_lit0(NULL, "resume",  "Continue the interrupted bruteforce from its flash checkpoint"),
         arg_param_end
     };
 
@@ -377,9 +378,38 @@ static int CmdEM4x50Brute(const char *Cmd) {
     em4x50_data_t etd;
     memset(&etd, 0, sizeof(etd));
 
+    etd.bruteforce_resume = arg_get_lit(ctx, 6);
+    if (etd.bruteforce_resume) {
+        CLIParserFree(ctx);
+
+        if (IfPm3Flash() == false) {
+            PrintAndLogEx(WARNING, "no flash memory available");
+            return PM3_EFLASH;
+        }
+
+        PrintAndLogEx(INFO, "Resuming from the flash checkpoint, press " _GREEN_("pm3 button") " to interrupt");
+
+        clearCommandBuffer();
+        PacketResponseNG resp;
+        SendCommandNG(CMD_LF_EM4X50_BRUTE, (uint8_t *)&etd, sizeof(etd));
+        WaitForResponse(CMD_LF_EM4X50_BRUTE, &resp);
+
+        if (resp.status == PM3_SUCCESS)
+            PrintAndLogEx(SUCCESS, "found valid password [ " _GREEN_("%08"PRIX32) " ]", resp.data.asDwords[0]);
+        else
+            PrintAndLogEx(WARNING, "brute pwd failed");
+
+        return PM3_SUCCESS;
+    }
+
     int mode_len = 64;
-    char mode[64];
+    char mode[64] = {0};
     CLIGetStrWithReturn(ctx, 1, (uint8_t *) mode, &mode_len);
+    if (mode_len == 0) {
+        PrintAndLogEx(FAILED, "Please specify a bruteforce mode, or --resume");
+        CLIParserFree(ctx);
+        return PM3_EINVARG;
+    }
     PrintAndLogEx(INFO, "Chosen mode: %s", mode);
 
     if (strcmp(mode, "range") == 0) {
@@ -442,29 +472,26 @@ static int CmdEM4x50Brute(const char *Cmd) {
 
     // 27 passwords/second (empirical value)
     const int speed = 27;
-    int no_iter = 0;
+    generator_context_t gen;
+    bf_generator_init(&gen, etd.bruteforce_mode, BF_KEY_SIZE_32);
+    if (etd.bruteforce_mode == BF_MODE_CHARSET) {
+        bf_generator_set_charset(&gen, etd.bruteforce_charset);
+    } else if (etd.bruteforce_mode == BF_MODE_RANGE) {
+        gen.range_low = etd.password1;
+        gen.range_high = etd.password2;
+    }
+    uint64_t no_iter = (etd.bruteforce_resume) ? 0 : bf_generator_count(&gen);
 
-    if (etd.bruteforce_mode == BF_MODE_RANGE) {
-        no_iter = etd.password2 - etd.password1 + 1;
-        PrintAndLogEx(INFO, "Trying " _YELLOW_("%i") " passwords in range [0x%08x, 0x%08x]"
+    if (etd.bruteforce_mode == BF_MODE_RANGE && no_iter) {
+        PrintAndLogEx(INFO, "Trying " _YELLOW_("%" PRIu64) " passwords in range [0x%08x, 0x%08x]"
                       , no_iter
                       , etd.password1
                       , etd.password2
                      );
-    } else if (etd.bruteforce_mode == BF_MODE_CHARSET) {
-        unsigned int digits = 0;
-
-        if (etd.bruteforce_charset & BF_CHARSET_DIGITS)
-            digits += BF_CHARSET_DIGITS_SIZE;
-
-        if (etd.bruteforce_charset & BF_CHARSET_UPPERCASE)
-            digits += BF_CHARSET_UPPERCASE_SIZE;
-
-        no_iter = pow(digits, 4);
     }
 
     // print some information
-    int dur_s = no_iter / speed;
+    int dur_s = (int)(no_iter / speed);
     int dur_h = dur_s / 3600;
     int dur_m = (dur_s - dur_h * 3600) / 60;
 
@@ -25,7 +25,9 @@
 #include "em4x70.h"
 #include "id48.h"
 #include "time.h"
-#include "util_posix.h" // msleep()
+#include "util.h"       // num_CPUs()
+#include "util_posix.h" // msleep(), msclock()
+#include <pthread.h>
 
 #define LOCKBIT_0 BITMASK(6)
 #define LOCKBIT_1 BITMASK(7)
@@ -96,6 +98,7 @@ typedef struct _em4x70_cmd_input_brute_t {
     ID48LIB_FRN frn;
     uint8_t block;
     uint8_t partial_key_start[2];
+    bool resume;
 } em4x70_cmd_input_brute_t;
 
 typedef struct _em4x70_cmd_output_brute_t {
@@ -147,6 +150,7 @@ typedef struct _em4x70_cmd_input_recover_t {
     ID48LIB_GRN   grn;
     bool parity; // if true, add parity bit to commands sent to tag
     bool verify; // if true, tag must be present
+    int threads; // threads used for the search, 0 for one per CPU
 } em4x70_cmd_input_recover_t;
 
 // largest seen "in the wild" was 6
@@ -321,6 +325,7 @@ static int brute_em4x70(const em4x70_cmd_input_brute_t *opts, em4x70_cmd_output_
     // (yes, this is a bit of a mess, but it is what it is for now...)
     uint16_t start_key_be = (opts->partial_key_start[0] << 8) | opts->partial_key_start[1];
     etd.start_key = start_key_be;
+    etd.resume = opts->resume;
 
     clearCommandBuffer();
     PacketResponseNG resp;
@@ -394,25 +399,85 @@ static int setpin_em4x70(const em4x70_cmd_input_setpin_t *opts, em4x70_tag_info_
     return resp.status;
 }
 
+// Shared by all threads of recover_em4x70().  Each thread takes the
+// next partition (K47..K40) of the search, so a slow partition
+// doesn't hold back the others.
+typedef struct _em4x70_recover_worker_t {
+    const em4x70_cmd_input_recover_t *opts;
+    uint32_t next_partition;
+    size_t total_key_count;
+    volatile bool abort; // found more keys than fit, all threads stop early
+    size_t key_count[ID48LIB_RECOVERY_PARTITIONS];
+    ID48LIB_KEY keys[ID48LIB_RECOVERY_PARTITIONS][MAXIMUM_ID48_RECOVERED_KEY_COUNT];
+} em4x70_recover_worker_t;
+
+static void *recover_em4x70_worker(void *arg) {
+    em4x70_recover_worker_t *w = (em4x70_recover_worker_t *)arg;
+    const em4x70_cmd_input_recover_t *opts = w->opts;
+
+    while (w->abort == false) {
+        uint32_t partition = __atomic_fetch_add(&w->next_partition, 1, __ATOMIC_RELAXED);
+        if (partition >= ID48LIB_RECOVERY_PARTITIONS) {
+            break;
+        }
+
+        size_t found = id48lib_key_recovery_partition(
+                           &opts->key, &opts->nonce, &opts->frn, &opts->grn,
+                           (uint8_t)partition,
+                           w->keys[partition], MAXIMUM_ID48_RECOVERED_KEY_COUNT,
+                           &w->abort
+                       );
+        w->key_count[partition] = found;
+
+        if (found && __atomic_add_fetch(&w->total_key_count, found, __ATOMIC_RELAXED) > MAXIMUM_ID48_RECOVERED_KEY_COUNT) {
+            w->abort = true;
+        }
+    }
+    return NULL;
+}
+
 static int recover_em4x70(const em4x70_cmd_input_recover_t *opts, em4x70_cmd_output_recover_t *data_out) {
     memset(data_out, 0, sizeof(em4x70_cmd_output_recover_t));
 
-    // The library is stateful.  First must initialize its internal context.
-    id48lib_key_recovery_init(&opts->key, &opts->nonce, &opts->frn, &opts->grn);
+    em4x70_recover_worker_t *w = calloc(1, sizeof(em4x70_recover_worker_t));
+    if (w == NULL) {
+        return PM3_EMALLOC;
+    }
+    w->opts = opts;
 
-    // repeatedly call id48lib_key_recovery_next() to get the next potential key
-    ID48LIB_KEY q;
-    int result = PM3_SUCCESS;
+    int threads = (opts->threads > 0) ? opts->threads : num_CPUs();
+    threads = MAX(1, MIN(threads, (int)ID48LIB_RECOVERY_PARTITIONS));
 
-    while ((PM3_SUCCESS == result) && id48lib_key_recovery_next(&q)) {
+    pthread_t thread_ids[ID48LIB_RECOVERY_PARTITIONS];
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&thread_ids[started], NULL, recover_em4x70_worker, w) == 0) {
+            started++;
+        }
+    }
 
-        if (data_out->potential_key_count >= MAXIMUM_ID48_RECOVERED_KEY_COUNT) {
-            result = PM3_EOVFLOW;
-        } else {
-            data_out->potential_keys[data_out->potential_key_count] = q;
-            ++data_out->potential_key_count;
+    // no thread at all, search here
+    if (started == 0) {
+        recover_em4x70_worker(w);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(thread_ids[i], NULL);
+    }
+
+    int result = PM3_SUCCESS;
+    if (w->total_key_count > MAXIMUM_ID48_RECOVERED_KEY_COUNT) {
+        result = PM3_EOVFLOW;
+    } else {
+        // partitions in ascending order give the same key order as id48lib_key_recovery_next()
+        for (uint32_t p = 0; p < ID48LIB_RECOVERY_PARTITIONS; p++) {
+            for (size_t i = 0; i < w->key_count[p]; i++) {
+                data_out->potential_keys[data_out->potential_key_count] = w->keys[p][i];
+                ++data_out->potential_key_count;
+            }
         }
     }
+    free(w);
 
     if ((PM3_SUCCESS == result) && (data_out->potential_key_count == 0)) {
         result = PM3_EFAILED;
@@ -532,6 +597,21 @@ static int CmdEM4x70Write(const char *Cmd) {
     return result;
 }
 
+static int brute_em4x70_print(int result, const em4x70_cmd_output_brute_t *data) {
+    if (result == PM3_EOPABORTED) {
+        PrintAndLogEx(DEBUG, "User aborted");
+    } else if (result == PM3_ETIMEOUT) {
+        PrintAndLogEx(WARNING, "\nNo response from Proxmark3. Aborting...");
+    } else if (result == PM3_SUCCESS) {
+        PrintAndLogEx(INFO, "Partial Key Response... %02X %02X", data->partial_key[0], data->partial_key[1]);
+    } else if (result == PM3_ENODATA) {
+        PrintAndLogEx(FAILED, "No EM4x70 brute checkpoint in flash");
+    } else {
+        PrintAndLogEx(FAILED, "Bruteforce of partial key ( "  _RED_("fail") " )");
+    }
+    return result;
+}
+
 static int CmdEM4x70Brute(const char *Cmd) {
 
     // From paper "Dismantling Megamos Crypto", Roel Verdult, Flavio D. Garcia and Barıs¸ Ege.
@@ -545,18 +625,37 @@ static int CmdEM4x70Brute(const char *Cmd) {
                   "lf em 4x70 brute -b 9 --rnd 45F54ADA252AAC --frn 4866BB70    --> bruteforcing key bits k95...k80 (pm3 test key)\n"
                   "lf em 4x70 brute -b 8 --rnd 3FFE1FB6CC513F --frn F355F1A0    --> bruteforcing key bits k79...k64 (research paper key)\n"
                   "lf em 4x70 brute -b 7 --rnd 7D5167003571F8 --frn 982DBCC0    --> bruteforcing key bits k63...k48 (autorecovery test key)\n"
+                  "lf em 4x70 brute --resume                                    --> continue from the flash checkpoint (RDV4)\n"
                  );
     void *argtable[] = {
         arg_param_begin,
         arg_lit0(NULL, "par", "Add parity bit when sending commands"),
-        arg_int1("b",  "block",  "<dec>", "block/word address, dec"),
-        arg_str1(NULL, "rnd", "<hex>", "Random 56-bit"),
-        arg_str1(NULL, "frn", "<hex>", "F(RN) 28-bit as 4 hex bytes"),
+        arg_int0("b",  "block",  "<dec>", "block/word address, dec"),
+        arg_str0(NULL, "rnd", "<hex>", "Random 56-bit"),
+        arg_str0(NULL, "frn", "<hex>", "F(RN) 28-bit as 4 hex bytes"),
         arg_str0("s", "start", "<hex>", "Start bruteforce enumeration from this key value"),
+        arg_lit0(NULL, "resume", "Continue the interrupted bruteforce from its flash checkpoint"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
+    em4x70_cmd_output_brute_t data;
+
+    // block, rnd, frn and start come from the checkpoint
+    if (arg_get_lit(ctx, 6)) {
+        CLIParserFree(ctx);
+
+        if (IfPm3Flash() == false) {
+            PrintAndLogEx(WARNING, "no flash memory available");
+            return PM3_EFLASH;
+        }
+
+        em4x70_cmd_input_brute_t resume_opts = { .resume = true };
+        PrintAndLogEx(INFO, "Resuming from the flash checkpoint");
+        PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
+        return brute_em4x70_print(brute_em4x70(&resume_opts, &data), &data);
+    }
+
     em4x70_cmd_input_brute_t opts = {
         .use_parity = arg_get_lit(ctx, 1),
         .block = arg_get_int_def(ctx, 2, 0),
@@ -604,18 +703,7 @@ static int CmdEM4x70Brute(const char *Cmd) {
 
     // Client command line parsing and validation complete ... now use the helper function
     PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to exit");
-    em4x70_cmd_output_brute_t data;
-    int result = brute_em4x70(&opts, &data);
-    if (result == PM3_EOPABORTED) {
-        PrintAndLogEx(DEBUG, "User aborted");
-    } else if (result == PM3_ETIMEOUT) {
-        PrintAndLogEx(WARNING, "\nNo response from Proxmark3. Aborting...");
-    } else if (result == PM3_SUCCESS) {
-        PrintAndLogEx(INFO, "Partial Key Response... %02X %02X", data.partial_key[0], data.partial_key[1]);
-    } else {
-        PrintAndLogEx(FAILED, "Bruteforce of partial key ( "  _RED_("fail") " )");
-    }
-    return result;
+    return brute_em4x70_print(brute_em4x70(&opts, &data), &data);
 }
 
 static int CmdEM4x70Unlock(const char *Cmd) {
@@ -907,6 +995,7 @@ static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_
         arg_str1(NULL, "rnd",    "<hex>", "Random 56-bit"),
         arg_str1(NULL, "frn",    "<hex>", "F(RN) 28-bit as 4 hex bytes"),
         arg_str1(NULL, "grn",    "<hex>", "G(RN) 20-bit as 3 hex bytes"),
+        arg_int0("t",  "threads", "<dec>", "Threads used for the search (def one per CPU)"),
         //arg_lit0(NULL, "verify", "automatically use tag for validation"),
         arg_param_end
     };
@@ -937,7 +1026,8 @@ static int CmdEM4x70Recover_ParseArgs(const char *Cmd, em4x70_cmd_input_recover_
         if (CLIParamHexToBuf(arg_get_str(ctx, 5), &(out_results->grn.grn[0]), 3, &grn_len)) {
             result = PM3_ESOFT;
         }
-        //out_results->verify = arg_get_lit(ctx, 6);
+        out_results->threads = arg_get_int_def(ctx, 6, 0);
+        //out_results->verify = arg_get_lit(ctx, 7);
     }
 
     // if all OK so far, do additional parameter validation
@@ -1526,6 +1616,127 @@ static int CmdEM4x70Calc(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// the example sets from `lf em 4x70 recover --help`, with the keys they must recover
+static const struct {
+    const char *name;
+    const char *key;
+    const char *rnd;
+    const char *frn;
+    const char *grn;
+} em4x70_bench_sets[] = {
+    { "pm3 test key",          "F32AA98CF5BE", "45F54ADA252AAC", "4866BB70", "9BD180" },
+    { "research paper key",    "A090A0A02080", "3FFE1FB6CC513F", "F355F1A0", "609D60" },
+    { "autorecovery test key", "022A028C02BE", "7D5167003571F8", "982DBCC0", "36C0E0" },
+};
+
+// the stateful init()/next() search, as used before the partitioned one
+static int recover_em4x70_serial(const em4x70_cmd_input_recover_t *opts, em4x70_cmd_output_recover_t *data_out) {
+    memset(data_out, 0, sizeof(em4x70_cmd_output_recover_t));
+    id48lib_key_recovery_init(&opts->key, &opts->nonce, &opts->frn, &opts->grn);
+
+    ID48LIB_KEY q;
+    while (id48lib_key_recovery_next(&q)) {
+        if (data_out->potential_key_count >= MAXIMUM_ID48_RECOVERED_KEY_COUNT) {
+            return PM3_EOVFLOW;
+        }
+        data_out->potential_keys[data_out->potential_key_count++] = q;
+    }
+    return (data_out->potential_key_count) ? PM3_SUCCESS : PM3_EFAILED;
+}
+
+static int CmdEM4x70Bench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "lf em 4x70 bench",
+                  "Benchmark the recovery of key bits 47..00 (`lf em 4x70 recover`) on the built in example sets.\n"
+                  "Each set is recovered with the single threaded search and with the partitioned search on\n"
+                  "one and on all threads.  All runs must recover the same potential keys.\n"
+                  "Does not need a tag.",
+                  "lf em 4x70 bench\n"
+                  "lf em 4x70 bench -t 4 -n 10   --> 4 threads, best of 10 runs"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_int0("t", "threads", "<dec>", "Threads used for the partitioned search (def one per CPU)"),
+        arg_int0("n", "runs",    "<dec>", "Runs per set, the best time is shown (def 3)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    int threads = arg_get_int_def(ctx, 1, num_CPUs());
+    int runs = arg_get_int_def(ctx, 2, 3);
+    CLIParserFree(ctx);
+
+    threads = MAX(1, MIN(threads, (int)ID48LIB_RECOVERY_PARTITIONS));
+    runs = MAX(1, runs);
+
+    const int thread_counts[] = { 0, 1, threads };
+    const char *engine_names[] = { "serial", "partitioned", "partitioned" };
+
+    PrintAndLogEx(INFO, "Best of " _YELLOW_("%d") " run%s per set", runs, (runs > 1) ? "s" : "");
+    PrintAndLogEx(INFO, "");
+    PrintAndLogEx(INFO, "set                    | keys | search      | threads |    ms");
+    PrintAndLogEx(INFO, "-----------------------+------+-------------+---------+-------");
+
+    int result = PM3_SUCCESS;
+    for (size_t s = 0; s < ARRAYLEN(em4x70_bench_sets); s++) {
+        em4x70_cmd_input_recover_t opts = {0};
+        int len = 0;
+        if (param_gethex_to_eol(em4x70_bench_sets[s].key, 0, opts.key.k, 6, &len) ||
+                param_gethex_to_eol(em4x70_bench_sets[s].rnd, 0, opts.nonce.rn, 7, &len) ||
+                param_gethex_to_eol(em4x70_bench_sets[s].frn, 0, opts.frn.frn, 4, &len) ||
+                param_gethex_to_eol(em4x70_bench_sets[s].grn, 0, opts.grn.grn, 3, &len)) {
+            return PM3_ESOFT;
+        }
+
+        em4x70_cmd_output_recover_t reference = {0};
+        for (size_t e = 0; e < ARRAYLEN(thread_counts); e++) {
+            // the thread count for all CPUs can be 1, no need to run that twice
+            if (e == 2 && threads == 1) {
+                continue;
+            }
+
+            opts.threads = thread_counts[e];
+            em4x70_cmd_output_recover_t data = {0};
+            uint64_t best = UINT64_MAX;
+            int res = PM3_SUCCESS;
+            for (int r = 0; r < runs && res == PM3_SUCCESS; r++) {
+                uint64_t t1 = msclock();
+                res = (e == 0) ? recover_em4x70_serial(&opts, &data) : recover_em4x70(&opts, &data);
+                best = MIN(best, msclock() - t1);
+            }
+
+            if (res != PM3_SUCCESS) {
+                PrintAndLogEx(FAILED, "%-22s | recovery failed ( %d )", em4x70_bench_sets[s].name, res);
+                result = res;
+                break;
+            }
+
+            if (e == 0) {
+                reference = data;
+            }
+            bool same = (data.potential_key_count == reference.potential_key_count) &&
+                        (memcmp(data.potential_keys, reference.potential_keys, reference.potential_key_count * sizeof(ID48LIB_KEY)) == 0);
+
+            PrintAndLogEx(INFO, "%-22s | %4u | %-11s | %7d | %5" PRIu64 "%s",
+                          em4x70_bench_sets[s].name,
+                          data.potential_key_count,
+                          engine_names[e],
+                          (e == 0) ? 1 : thread_counts[e],
+                          best,
+                          (same) ? "" : "  " _RED_("keys differ")
+                         );
+            if (same == false) {
+                result = PM3_ESOFT;
+            }
+        }
+    }
+    PrintAndLogEx(INFO, "");
+    if (result == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "All searches recovered the same keys ( " _GREEN_("ok") " )");
+    }
+    return result;
+}
+
 // Must be declared to be used in the table,
 // but cannot be defined yet because it uses the table.
 static int CmdHelp(const char *Cmd);
@@ -1541,6 +1752,7 @@ static command_t CommandTable[] = {
     {"setkey",      CmdEM4x70SetKey,       IfPm3EM4x70,     "Write key"},
     {"calc",        CmdEM4x70Calc,         AlwaysAvailable, "Calculate EM4x70 challenge and response"},
     {"recover",     CmdEM4x70Recover,      AlwaysAvailable, "Recover remaining key from partial key"},
+    {"bench",       CmdEM4x70Bench,        AlwaysAvailable, "Benchmark recovery of remaining key from partial key"},
     {"autorecover", CmdEM4x70AutoRecover,  IfPm3EM4x70,     "Recover entire key from writable tag"},
     {NULL, NULL, NULL, NULL}
 };
@@ -52,17 +52,25 @@
 
 static int CmdHelp(const char *Cmd);
 
-// sending three times.  Didn't seem to break the previous sim?
-static int sendPing(void) {
-    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-    SendCommandNG(CMD_PING, NULL, 0);
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    if (!WaitForResponseTimeout(CMD_PING, &resp, 1000))
-        return PM3_ETIMEOUT;
-    return PM3_SUCCESS;
+// HID FSK bitstream as the device composes it for CMD_LF_HID_SIMULATE,  returns the length
+static uint16_t hid_sim_bits(const wiegand_message_t *packed, uint8_t *bits) {
+    // special start of frame marker containing invalid Manchester bit sequences
+    const uint8_t sof[] = { 0, 0, 0, 1, 1, 1, 0, 1 };
+    memcpy(bits, sof, sizeof(sof));
+    uint16_t n = sizeof(sof);
+
+    if (packed->Mid > 0xFFF) {
+        // 9E: long format identifier
+        manchesterEncodeUint32(packed->Top | 0x9E00000, 16 + 12, bits, &n);
+        manchesterEncodeUint32(packed->Mid, 32, bits, &n);
+    } else {
+        manchesterEncodeUint32(packed->Mid, 12, bits, &n);
+    }
+    manchesterEncodeUint32(packed->Bot, 32, bits, &n);
+    return n;
 }
-static int sendTry(uint8_t format_idx, wiegand_card_t *card, uint32_t delay, bool verbose) {
+
+static int sendTry(lfsim_brute_t *b, uint8_t format_idx, wiegand_card_t *card) {
 
     wiegand_message_t packed;
     memset(&packed, 0, sizeof(wiegand_message_t));
@@ -72,35 +80,26 @@ static int sendTry(uint8_t format_idx, wiegand_card_t *card, uint32_t delay, boo
         return PM3_ESOFT;
     }
 
-    if (verbose) {
-        PrintAndLogEx(INFO, "Trying FC: " _YELLOW_("%u") " CN: " _YELLOW_("%"PRIu64) " Issue level: " _YELLOW_("%u") " OEM: " _YELLOW_("%u")
-                      , card->FacilityCode
-                      , card->CardNumber
-                      , card->IssueLevel
-                      , card->OEM
-                     );
+    if (packed.Top > 0xFFFFF) {
+        PrintAndLogEx(WARNING, "Tags can only have 84 bits.");
+        return PM3_ESOFT;
     }
 
-    lf_hidsim_t payload = {
-        .EM = false,
-        .Q5 = false,
-        .hi2 = packed.Top,
-        .hi = packed.Mid,
-        .lo = packed.Bot,
-        .longFMT = (packed.Mid > 0xFFF)
-    };
-
-    clearCommandBuffer();
+    uint8_t bits[8 + 8 * 2 + 84 * 2];
+    lf_simbrute_t *payload = (lf_simbrute_t *)b->buf;
+    if (hid_sim_bits(&packed, bits) != payload->bitslen) {
+        PrintAndLogEx(WARNING, "All candidates must have the same length.");
+        return PM3_ESOFT;
+    }
 
-    SendCommandNG(CMD_LF_HID_SIMULATE, (uint8_t *)&payload,  sizeof(payload));
-    /*
-        PacketResponseNG resp;
-        WaitForResponse(CMD_LF_HID_SIMULATE, &resp);
-        if (resp.status == PM3_EOPABORTED)
-            return resp.status;
-    */
-    msleep(delay);
-    return sendPing();
+    char label[LFSIM_BRUTE_LABEL_LEN];
+    snprintf(label, sizeof(label), "FC: %u CN: %" PRIu64 " Issue level: %u OEM: %u"
+             , card->FacilityCode
+             , card->CardNumber
+             , card->IssueLevel
+             , card->OEM
+            );
+    return lfsim_brute_add(b, bits, label);
 }
 
 //by marshmellow (based on existing demod + holiman's refactor)
@@ -596,26 +595,41 @@ static int CmdHIDBrute(const char *Cmd) {
     // copy values to low.
     card_low = card_hi;
 
+    // the candidates are simulated by the device,  one batch at a time
+    wiegand_message_t packed;
+    memset(&packed, 0, sizeof(wiegand_message_t));
+    if (HIDPack(format_idx, &card_hi, &packed, true) == false) {
+        PrintAndLogEx(WARNING, "The card data could not be encoded in the selected format.");
+        return PM3_ESOFT;
+    }
+
+    lf_simbrute_t cfg = {
+        .modulation = LF_SIM_BRUTE_FSK,
+        .fchigh = 10,
+        .fclow = 8,
+        .clock = 50,
+        .dwell = MIN(delay, 0xFFFF),
+        .bitslen = (packed.Mid > 0xFFF) ? 8 + 8 * 2 + 84 * 2 : 8 + 44 * 2,
+    };
+    lfsim_brute_t *b = calloc(1, sizeof(lfsim_brute_t));
+    if (b == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    lfsim_brute_init(b, &cfg, verbose);
+
     // main loop
+    int res = PM3_SUCCESS;
     bool exitloop = false;
     bool fin_hi, fin_low;
     fin_hi = fin_low = false;
     do {
 
-        if (g_session.pm3_present == false) {
-            PrintAndLogEx(WARNING, "Device offline\n");
-            return PM3_ENODATA;
-        }
-
-        if (kbd_enter_pressed()) {
-            PrintAndLogEx(WARNING, "aborted via keyboard!");
-            return sendPing();
-        }
-
         // do one up
         if (direction != 2 && fin_hi != true) {
-            if (sendTry(format_idx, &card_hi, delay, verbose) != PM3_SUCCESS) {
-                return PM3_ESOFT;
+            res = sendTry(b, format_idx, &card_hi);
+            if (res != PM3_SUCCESS) {
+                break;
             }
             if (strcmp(field, "fc") == 0) {
                 if (card_hi.FacilityCode < 0xFF) {
@@ -634,8 +648,9 @@ static int CmdHIDBrute(const char *Cmd) {
 
         // do one down
         if (direction != 1 && fin_low != true) {
-            if (sendTry(format_idx, &card_low, delay, verbose) != PM3_SUCCESS) {
-                return PM3_ESOFT;
+            res = sendTry(b, format_idx, &card_low);
+            if (res != PM3_SUCCESS) {
+                break;
             }
             if (strcmp(field, "fc") == 0) {
                 if (card_low.FacilityCode > 0) {
@@ -670,6 +685,15 @@ static int CmdHIDBrute(const char *Cmd) {
 
     } while (exitloop == false);
 
+    if (res == PM3_SUCCESS) {
+        res = lfsim_brute_flush(b);
+    }
+    free(b);
+
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "Bruteforcing finished");
     return PM3_SUCCESS;
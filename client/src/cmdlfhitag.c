@@ -31,6 +31,7 @@
 #include "cmddata.h"    // setDemodBuff
 #include "pm3_cmd.h"    // return codes
 #include "hitag2/hitag2_crypto.h"
+#include "hitag2/hitag2_bs.h"
 #include "util_posix.h"             // msclock
 
 static int CmdHelp(const char *Cmd);
@@ -452,25 +453,23 @@ static bool ht2_check_cryptokeys(const uint64_t *keys, const uint32_t keycount,
     uint32_t iv = REV32((nrar[3] << 24) + (nrar[2] << 16) + (nrar[1] << 8) + nrar[0]);
     uint32_t ar = (nrar[4] << 24) + (nrar[5] << 16) + (nrar[6] << 8) + nrar[7];
 
-    bool found = false;
-    for (uint32_t i = 0; i < keycount; i++) {
-
-        uint64_t key = keys[i];
-        key = BSWAP_48(key);
-        key = REV64(key);
+    // test in batches of HITAG2_BS_SLICES keys with the bitsliced cipher
+    uint64_t batch[HITAG2_BS_SLICES];
+    for (uint32_t off = 0; off < keycount; off += HITAG2_BS_SLICES) {
 
-        hitag_state_t hs2;
-        ht2_hitag2_init_ex(&hs2, key, _ht2state.uid, iv);
+        uint32_t n = MIN(keycount - off, HITAG2_BS_SLICES);
+        for (uint32_t i = 0; i < n; i++) {
+            batch[i] = REV64(BSWAP_48(keys[off + i]));
+        }
 
-        uint32_t tbits = ht2_hitag2_nstep(&hs2, 32);
-        if ((ar ^ tbits) == 0xFFFFFFFF) {
+        int idx = hitag2_bs_check_keys(batch, n, _ht2state.uid, iv, ar);
+        if (idx >= 0) {
             _ht2state.found_key = true;
-            _ht2state.key = key;
-            found = true;
-            break;
+            _ht2state.key = batch[idx];
+            return true;
         }
     }
-    return found;
+    return false;
 }
 
 static int ht2_check_dictionary(uint32_t key_count, uint8_t *keys,  uint8_t keylen, uint32_t *found_idx) {
@@ -1793,12 +1792,138 @@ static int CmdLFHitagEview(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Runs the Hitag 2 sim until <collect> reader authentications are gathered.
+// Every pair goes to the file as it arrives,  one "nR aR" per line, the format
+// ht2crack3 / ht2crack4 read.  ht2crack5 takes the first two on its command line
+static int ht2_sim_collect(uint16_t collect, const char *filename) {
+
+    lf_hitag2_sim_t payload = { .collect = collect };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_HITAG_SIMULATE, (uint8_t *)&payload, sizeof(payload));
+
+    PrintAndLogEx(INFO, "Collecting " _YELLOW_("%u") " nR aR pairs,  hold the pm3 to the reader", collect);
+    PrintAndLogEx(INFO, "Press " _GREEN_("pm3 button") " or " _GREEN_("<Enter>") " to abort");
+
+    FILE *f = NULL;
+    char *fn = NULL;
+    uint8_t uid[4] = {0};
+    uint8_t first[2][8] = {{0}};
+    uint16_t count = 0;
+    int res = PM3_SUCCESS;
+
+    for (;;) {
+
+        if (kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(DEBUG, "User aborted");
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_LF_HITAG_SIMULATE, &resp, 1000) == false) {
+            continue;
+        }
+
+        // final reply,  no payload
+        if (resp.length < sizeof(lf_hitag2_nrar_t)) {
+            res = resp.status;
+            break;
+        }
+
+        const lf_hitag2_nrar_t *pair = (const lf_hitag2_nrar_t *)resp.data.asBytes;
+
+        if (f == NULL) {
+            memcpy(uid, pair->uid, sizeof(uid));
+
+            char prefname[FILE_PATH_SIZE] = {0};
+            if (strlen(filename)) {
+                snprintf(prefname, sizeof(prefname), "%s", filename);
+            } else {
+                char *fptr = prefname;
+                fptr += snprintf(prefname, sizeof(prefname), "lf-hitag-");
+                FillFileNameByUID(fptr, uid, "-nrar", sizeof(uid));
+            }
+
+            fn = newfilenamemcopyEx(prefname, ".txt", spDump);
+            if (fn == NULL) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                res = PM3_EMALLOC;
+                break;
+            }
+
+            f = fopen(fn, "w");
+            if (f == NULL) {
+                PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+                res = PM3_EFILE;
+                break;
+            }
+        }
+
+        if (count < ARRAYLEN(first)) {
+            memcpy(first[count], pair->NrAr, sizeof(first[0]));
+        }
+        count++;
+
+        fprintf(f, "0x%02X%02X%02X%02X 0x%02X%02X%02X%02X\n"
+                , pair->NrAr[0], pair->NrAr[1], pair->NrAr[2], pair->NrAr[3]
+                , pair->NrAr[4], pair->NrAr[5], pair->NrAr[6], pair->NrAr[7]
+               );
+        fflush(f);
+
+        PrintAndLogEx(SUCCESS, "%3u/%u  nR: " _GREEN_("%s") " aR: " _GREEN_("%s")
+                      , pair->count
+                      , collect
+                      , sprint_hex_inrow(pair->NrAr, 4)
+                      , sprint_hex_inrow(pair->NrAr + 4, 4)
+                     );
+    }
+
+    // wait out the final reply when we stopped early
+    if (res == PM3_EMALLOC || res == PM3_EFILE) {
+        PacketResponseNG resp;
+        while (WaitForResponseTimeout(CMD_LF_HITAG_SIMULATE, &resp, 2000) && resp.length) {};
+    }
+
+    if (f) {
+        fclose(f);
+    }
+
+    if (count) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " nR aR pairs to `" _YELLOW_("%s") "`", count, fn);
+    }
+
+    if (count >= 2) {
+        char struid[9], nr1[9], ar1[9], nr2[9], ar2[9];
+        snprintf(struid, sizeof(struid), "%s", sprint_hex_inrow(uid, 4));
+        snprintf(nr1, sizeof(nr1), "%s", sprint_hex_inrow(first[0], 4));
+        snprintf(ar1, sizeof(ar1), "%s", sprint_hex_inrow(first[0] + 4, 4));
+        snprintf(nr2, sizeof(nr2), "%s", sprint_hex_inrow(first[1], 4));
+        snprintf(ar2, sizeof(ar2), "%s", sprint_hex_inrow(first[1] + 4, 4));
+        PrintAndLogEx(HINT, "try `" _YELLOW_("tools/hitag2crack/crack5opencl/ht2crack5opencl %s %s %s %s %s") "`", struid, nr1, ar1, nr2, ar2);
+        PrintAndLogEx(HINT, "or  `" _YELLOW_("tools/hitag2crack/crack5/ht2crack5 %s %s %s %s %s") "`", struid, nr1, ar1, nr2, ar2);
+    }
+    if (count >= 16) {
+        PrintAndLogEx(HINT, "or  `" _YELLOW_("tools/hitag2crack/crack4/ht2crack4 -u %s -n %s") "`", sprint_hex_inrow(uid, 4), fn);
+    }
+
+    free(fn);
+
+    if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(INFO, "Aborted after " _YELLOW_("%u") " pairs", count);
+    }
+    return res;
+}
+
 static int CmdLFHitagSim(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf hitag sim",
                   "Simulate Hitag transponder\n"
-                  "You need to `lf hitag eload` first",
-                  "lf hitag sim -2"
+                  "You need to `lf hitag eload` first\n"
+                  "With --collect the Hitag 2 sim gathers reader nR aR pairs for the hitag2crack tools",
+                  "lf hitag sim -2\n"
+                  "lf hitag sim -2 --collect 2          -> two pairs for ht2crack5\n"
+                  "lf hitag sim -2 --collect 32 -f rdr  -> 32 pairs for ht2crack4, saved to rdr.txt"
                  );
 
     void *argtable[] = {
@@ -1806,6 +1931,8 @@ static int CmdLFHitagSim(const char *Cmd) {
         arg_lit0("1", "ht1", "simulate Hitag 1"),
         arg_lit0("2", "ht2", "simulate Hitag 2"),
         arg_lit0("s", "hts", "simulate Hitag S"),
+        arg_u64_0(NULL, "collect", "<dec>", "Hitag 2, number of reader nR aR pairs to collect"),
+        arg_str0("f", "file", "<fn>", "file name for the collected nR aR pairs"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1814,6 +1941,11 @@ static int CmdLFHitagSim(const char *Cmd) {
     bool use_ht2 = arg_get_lit(ctx, 2);
     bool use_hts = arg_get_lit(ctx, 3);
     bool use_htm = false; // not implemented yet
+    uint32_t collect = arg_get_u32_def(ctx, 4, 0);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
     if ((use_ht1 + use_ht2 + use_hts + use_htm) > 1) {
@@ -1825,6 +1957,25 @@ static int CmdLFHitagSim(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if ((collect || fnlen) && use_ht2 == false) {
+        PrintAndLogEx(ERR, "error, --collect is only available for Hitag 2");
+        return PM3_EINVARG;
+    }
+
+    if (collect > 0xFFFF) {
+        PrintAndLogEx(ERR, "error, --collect max is 65535");
+        return PM3_EINVARG;
+    }
+
+    if (fnlen && collect == 0) {
+        PrintAndLogEx(ERR, "error, -f needs --collect");
+        return PM3_EINVARG;
+    }
+
+    if (collect) {
+        return ht2_sim_collect(collect, filename);
+    }
+
     uint16_t cmd = CMD_LF_HITAG_SIMULATE;
 //    if (use_ht1)
 //        cmd = CMD_LF_HITAG1_SIMULATE;
@@ -2194,28 +2345,22 @@ static int CmdLFHitag2Lookup(const char *Cmd) {
         return res;
     }
 
-    bool found = false;
-    for (uint32_t i = 0; i < key_count; i++) {
+    PrintAndLogEx(DEBUG, "testing %u keys, " HITAG2_BS_ENGINE " engine, %u keys per pass", key_count, HITAG2_BS_SLICES);
 
-        uint8_t *pkey = keys + (i * HITAG_CRYPTOKEY_SIZE);
-        uint64_t mykey = MemLeToUint6byte(pkey);
-        mykey = REV64(mykey);
+    bool found = false;
+    uint64_t batch[HITAG2_BS_SLICES];
+    for (uint32_t off = 0; off < key_count && found == false; off += HITAG2_BS_SLICES) {
 
-        hitag_state_t hs2;
-        ht2_hitag2_init_ex(&hs2, mykey, uid, iv);
+        uint32_t n = MIN(key_count - off, HITAG2_BS_SLICES);
+        for (uint32_t i = 0; i < n; i++) {
+            batch[i] = REV64(MemLeToUint6byte(keys + ((off + i) * HITAG_CRYPTOKEY_SIZE)));
+        }
 
-        uint32_t tbits = ht2_hitag2_nstep(&hs2, 32);
-        if ((ar ^ tbits) == 0xFFFFFFFF) {
+        int idx = hitag2_bs_check_keys(batch, n, uid, iv, ar);
+        if (idx >= 0) {
+            uint8_t *pkey = keys + ((off + idx) * HITAG_CRYPTOKEY_SIZE);
             PrintAndLogEx(SUCCESS, "Found valid key [ " _GREEN_("%s")" ]", sprint_hex_inrow(pkey, HITAG_CRYPTOKEY_SIZE));
             found = true;
-            break;
-        }
-
-        if (g_debugMode) {
-            PrintAndLogEx(DEBUG, " tbits... %08" PRIx32 " Known ar... %08" PRIx32, tbits, ar);
-            PrintAndLogEx(DEBUG, " 0xFFFFFFFF ^ tbits... %08" PRIx32, tbits ^ 0xFFFFFFFF);
-            PrintAndLogEx(DEBUG, " 0xFFFFFFFF ^ ar...... %08" PRIx32, ar ^ 0xFFFFFFFF);
-            PrintAndLogEx(DEBUG, " tbits ^ ar........... %08" PRIx32 " ( 0xFFFFFFFF )",  ar ^ tbits);
         }
     }
 
@@ -123,19 +123,7 @@ static void decodeHeden2L(uint8_t *bits) {
     PrintAndLogEx(SUCCESS, "  Heden-2L...... %u", cardnumber);
 }
 
-// sending three times.  Didn't seem to break the previous sim?
-static int sendPing(void) {
-    SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
-    SendCommandNG(CMD_PING, NULL, 0);
-    clearCommandBuffer();
-    PacketResponseNG resp;
-    if (WaitForResponseTimeout(CMD_PING, &resp, 1000) == false) {
-        return PM3_ETIMEOUT;
-    }
-    return PM3_SUCCESS;
-}
-
-static int sendTry(uint8_t fc, uint16_t cn, uint32_t delay, bool fmt4041x, bool verbose) {
+static int sendTry(lfsim_brute_t *b, uint8_t fc, uint16_t cn, bool fmt4041x) {
 
     // convert to fc / cn to binarray
     uint8_t bs[64];
@@ -154,38 +142,14 @@ static int sendTry(uint8_t fc, uint16_t cn, uint32_t delay, bool fmt4041x, bool
         return res;
     }
 
-    if (verbose) {
-
-        uint8_t raw[8];
-        raw[0] = bytebits_to_byte(bs, 8);
-        raw[1] = bytebits_to_byte(bs + 8, 8);
-        raw[2] = bytebits_to_byte(bs + 16, 8);
-        raw[3] = bytebits_to_byte(bs + 24, 8);
-        raw[4] = bytebits_to_byte(bs + 32, 8);
-        raw[5] = bytebits_to_byte(bs + 40, 8);
-        raw[6] = bytebits_to_byte(bs + 48, 8);
-        raw[7] = bytebits_to_byte(bs + 56, 8);
-
-        PrintAndLogEx(INFO, "Trying FC: " _YELLOW_("%u") " CN: " _YELLOW_("%u") " Raw: " _YELLOW_("%s")
-                      , fc
-                      , cn
-                      , sprint_hex_inrow(raw, sizeof(raw))
-                     );
+    uint8_t raw[8];
+    for (uint8_t i = 0; i < sizeof(raw); i++) {
+        raw[i] = bytebits_to_byte(bs + (i * 8), 8);
     }
 
-    // indala PSK,  clock 32, carrier 0
-    lf_psksim_t *payload = calloc(1, sizeof(lf_psksim_t) + sizeof(bs));
-    payload->carrier = 2;
-    payload->invert = 0;
-    payload->clock = 32;
-    memcpy(payload->data, bs, sizeof(bs));
-
-    clearCommandBuffer();
-    SendCommandNG(CMD_LF_PSK_SIMULATE, (uint8_t *)payload,  sizeof(lf_psksim_t) + sizeof(bs));
-    free(payload);
-
-    msleep(delay);
-    return sendPing();
+    char label[LFSIM_BRUTE_LABEL_LEN];
+    snprintf(label, sizeof(label), "FC: %u CN: %u Raw: %s", fc, cn, sprint_hex_inrow(raw, sizeof(raw)));
+    return lfsim_brute_add(b, bs, label);
 }
 
 
@@ -1025,26 +989,33 @@ static int CmdIndalaBrute(const char *Cmd) {
     uint16_t cn_hi = cn;
     uint16_t cn_low = cn;
 
+    // indala PSK,  clock 32, carrier 2,  the device walks the candidates
+    lf_simbrute_t cfg = {
+        .modulation = LF_SIM_BRUTE_PSK,
+        .carrier = 2,
+        .clock = 32,
+        .dwell = MIN(delay, 0xFFFF),
+        .bitslen = 64,
+    };
+    lfsim_brute_t *b = calloc(1, sizeof(lfsim_brute_t));
+    if (b == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    lfsim_brute_init(b, &cfg, verbose);
+
+    int res = PM3_SUCCESS;
     bool exitloop = false;
     bool fin_hi, fin_low;
     fin_hi = fin_low = false;
     do {
 
-        if (g_session.pm3_present == false) {
-            PrintAndLogEx(WARNING, "Device offline\n");
-            return PM3_ENODATA;
-        }
-
-        if (kbd_enter_pressed()) {
-            PrintAndLogEx(WARNING, "aborted via keyboard!");
-            return sendPing();
-        }
-
         // do one up
         if (direction != 2) {
             if (cn_hi < 0xFFFF) {
-                if (sendTry(fc_hi, cn_hi, delay, fmt4041x, verbose) != PM3_SUCCESS) {
-                    return PM3_ESOFT;
+                res = sendTry(b, fc_hi, cn_hi, fmt4041x);
+                if (res != PM3_SUCCESS) {
+                    break;
                 }
                 cn_hi++;
             } else {
@@ -1056,8 +1027,9 @@ static int CmdIndalaBrute(const char *Cmd) {
         if (direction != 1) {
             if (cn_low > 0) {
                 cn_low--;
-                if (sendTry(fc_low, cn_low, delay, fmt4041x, verbose) != PM3_SUCCESS) {
-                    return PM3_ESOFT;
+                res = sendTry(b, fc_low, cn_low, fmt4041x);
+                if (res != PM3_SUCCESS) {
+                    break;
                 }
             } else {
                 fin_low = true;
@@ -1082,6 +1054,15 @@ static int CmdIndalaBrute(const char *Cmd) {
 
     } while (exitloop == false);
 
+    if (res == PM3_SUCCESS) {
+        res = lfsim_brute_flush(b);
+    }
+    free(b);
+
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
     PrintAndLogEx(INFO, "Brute forcing finished");
     return PM3_SUCCESS;
 }
@@ -1321,7 +1302,7 @@ out:
     *size = found_size;
 
     if (found_size < 64) {
-        PrintAndLogEx(INFO, "DEBUG: detectindala | %zu", found_size);
+        PrintAndLogEx(DEBUG, "DEBUG: detectindala | %zu", found_size);
         return -5;
     }
 
@@ -38,6 +38,7 @@
 #include "cmdlf.h"        // for lf sniff
 #include "generator.h"
 #include "cliparser.h"    // cliparsing
+#include "checkpoint.h"   // resume bruteforce
 
 // Some defines for readability
 #define T55XX_DLMODE_FIXED         0 // Default Mode
@@ -66,6 +67,64 @@ static t55xx_conf_block_t config = {
 };
 
 static t55xx_memory_item_t cardmem[T55x7_BLOCK_COUNT] = {{0}};
+
+// Downlink modes that worked,  per configuration block and the last one overall.
+// Commands trying all four modes start with the cached one,  a station handling a batch of
+// same tags then needs one attempt instead of up to four.
+#define T55XX_DL_CACHE_SIZE 16
+
+typedef struct {
+    uint32_t block0;
+    uint8_t downlink_mode;
+} t55xx_dl_cache_t;
+
+static t55xx_dl_cache_t dl_cache[T55XX_DL_CACHE_SIZE];
+static uint8_t dl_cache_count = 0;
+static uint8_t dl_cache_next = 0;
+static uint8_t dl_last = refFixedBit;
+
+static void t55xx_dl_hit(uint32_t block0, uint8_t downlink_mode) {
+    downlink_mode &= 3;
+    dl_last = downlink_mode;
+    if (block0 == 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < dl_cache_count; i++) {
+        if (dl_cache[i].block0 == block0) {
+            dl_cache[i].downlink_mode = downlink_mode;
+            return;
+        }
+    }
+
+    // round robin once full
+    dl_cache[dl_cache_next].block0 = block0;
+    dl_cache[dl_cache_next].downlink_mode = downlink_mode;
+    dl_cache_next = (dl_cache_next + 1) % T55XX_DL_CACHE_SIZE;
+    if (dl_cache_count < T55XX_DL_CACHE_SIZE) {
+        dl_cache_count++;
+    }
+}
+
+// all four downlink modes,  the one cached for block0 (0 when unknown) or the last that worked first
+static void t55xx_dl_order(uint32_t block0, uint8_t order[4]) {
+    uint8_t first = dl_last;
+    for (uint8_t i = 0; block0 && i < dl_cache_count; i++) {
+        if (dl_cache[i].block0 == block0) {
+            first = dl_cache[i].downlink_mode;
+            break;
+        }
+    }
+
+    uint8_t n = 0;
+    order[n++] = first;
+    for (uint8_t m = refFixedBit; m <= ref1of4; m++) {
+        if (m != first) {
+            order[n++] = m;
+        }
+    }
+    PrintAndLogEx(DEBUG, "downlink mode order %u %u %u %u", order[0], order[1], order[2], order[3]);
+}
 /*
 #define DC(x)  ((x) + 128)
 
@@ -551,7 +610,10 @@ bool t55xxAcquireAndCompareBlock0(bool usepwd, uint32_t password, uint32_t known
     if (verbose)
         PrintAndLogEx(INFO, "Block0 write detected, running `detect` to see if validation is possible");
 
-    for (uint8_t m = 0; m < 4; m++) {
+    uint8_t order[4];
+    t55xx_dl_order(known_block0, order);
+    for (uint8_t k = 0; k < 4; k++) {
+        uint8_t m = order[k];
         if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, usepwd, password, m) == false) {
             continue;
         }
@@ -565,6 +627,7 @@ bool t55xxAcquireAndCompareBlock0(bool usepwd, uint32_t password, uint32_t known
             if (tmp == known_block0) {
                 config.offset = i;
                 config.downlink_mode = m;
+                t55xx_dl_hit(known_block0, m);
                 return true;
             }
         }
@@ -577,7 +640,10 @@ bool t55xxAcquireAndDetect(bool usepwd, uint32_t password, uint32_t known_block0
     if (verbose)
         PrintAndLogEx(INFO, "Block0 write detected, running `detect` to see if validation is possible");
 
-    for (uint8_t m = 0; m < 4; m++) {
+    uint8_t order[4];
+    t55xx_dl_order(known_block0, order);
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t m = order[i];
         if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, usepwd, password, m) == false)
             continue;
 
@@ -1232,8 +1298,11 @@ static int CmdT55xxDetect(const char *Cmd) {
             // do ... while to check without password then loop back if password supplied
             do {
                 if (try_all_dl_modes) {
-                    // Loop from 1st d/l mode refFixedBit to the last d/l mode ref1of4
-                    for (uint8_t m = refFixedBit; m <= ref1of4; m++) {
+                    // all d/l modes,  the last one that worked first
+                    uint8_t order[4];
+                    t55xx_dl_order(0, order);
+                    for (uint8_t i = 0; i < 4; i++) {
+                        uint8_t m = order[i];
                         if (usewake) {
                             // call wake
                             if (try_with_pwd)
@@ -1410,7 +1479,7 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
         clk = GetPskClock("", false);
         if (clk > 0) {
             // allow undo
-            buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
+            buffer_savestate_t saveState = save_bufferS16(g_GraphBuffer, g_GraphTraceLen);
             saveState.offset = g_GridOffset;
             // skip first 160 samples to allow antenna to settle in (psk gets inverted occasionally otherwise)
             CmdLtrim("-i 160");
@@ -1460,7 +1529,7 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
                 }
             } // inverse waves does not affect this demod
             //undo trim samples
-            restore_bufferS32(saveState, g_GraphBuffer);
+            restore_bufferS16(saveState, g_GraphBuffer);
             g_GridOffset = saveState.offset;
             // t55xx_search_config_psk(g_GraphBuffer, 1);
             // t55xx_search_config_psk(g_GraphBuffer, 2);
@@ -1484,6 +1553,7 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
         if (print_config)
             printConfiguration(config);
 
+        t55xx_dl_hit(config.block0, config.downlink_mode);
         return true;
     }
 
@@ -1521,6 +1591,9 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
                 printConfiguration(tests[i]);
         }
     }
+    if (retval) {
+        t55xx_dl_hit(config.block0, config.downlink_mode);
+    }
     return retval;
 }
 
@@ -3446,14 +3519,16 @@ static int CmdT55xxChkPwds(const char *Cmd) {
         goto out;
     }
 
-    // to try each downlink mode for each password
-    int dl_mode;
+    // to try each downlink mode for each password,  the last one that worked first
+    uint8_t dl_order[4];
 
     // try calculated password
     if (use_calc_password) {
 
         PrintAndLogEx(INFO, "testing %08"PRIX32" generated ", card_password);
-        for (dl_mode = downlink_mode; dl_mode <= 3; dl_mode++) {
+        t55xx_dl_order(0, dl_order);
+        for (uint8_t i = 0; i < 4; i++) {
+            uint8_t dl_mode = (ra) ? dl_order[i] : downlink_mode;
 
             if (!AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, card_password, dl_mode)) {
                 continue;
@@ -3501,7 +3576,9 @@ static int CmdT55xxChkPwds(const char *Cmd) {
             uint32_t curr_password = bytes_to_num(keyblock + 4 * c, 4);
 
             PrintAndLogEx(INFO, "testing %08"PRIX32, curr_password);
-            for (dl_mode = downlink_mode; dl_mode <= 3; dl_mode++) {
+            t55xx_dl_order(0, dl_order);
+            for (uint8_t i = 0; i < 4; i++) {
+                uint8_t dl_mode = (ra) ? dl_order[i] : downlink_mode;
                 // If acquire fails, then we still need to check if we are only trying a single downlink mode.
                 // If we continue on fail, it will skip that test and try the next downlink mode; thus slowing down the check
                 // when on a single downlink mode is wanted.
@@ -3529,23 +3606,85 @@ out:
     return PM3_SUCCESS;
 }
 
+// passwords between two bruteforce checkpoints
+// passwords per device scan,  the checkpoint is saved after each one
+#define T55XX_BRUTE_CHUNK       256
+
+// scan count passwords from start on the device,  candidates are confirmed here with a full read and demod.
+// Returns the passwords done in *tried,  1 + (downlink << 1) in *found for a confirmed one
+static int t55xx_brute_chunk(uint32_t start, uint32_t count, uint8_t downlink_mode, bool try_all_dl_modes, uint32_t *tried, uint8_t *found, uint32_t *password) {
+    t55xx_brute_req_t req = {
+        .start_pwd = start,
+        .count = count,
+        .flags = (downlink_mode & 3) | ((try_all_dl_modes) ? T55XX_BRUTE_ALL_DL : 0),
+    };
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_LF_T55XX_BRUTE, (uint8_t *)&req, sizeof(req));
+
+    // about 40 ms per read,  each downlink mode is a read
+    uint64_t timeout = msclock() + 3000 + (uint64_t)count * ((try_all_dl_modes) ? 4 : 1) * 100;
+    PacketResponseNG resp;
+    bool aborted = false;
+    while (WaitForResponseTimeout(CMD_LF_T55XX_BRUTE, &resp, 500) == false) {
+        if (aborted == false && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            aborted = true;
+        }
+        if (msclock() > timeout) {
+            PrintAndLogEx(WARNING, "timeout while waiting for reply");
+            return PM3_ETIMEOUT;
+        }
+    }
+
+    if (resp.length != sizeof(t55xx_brute_resp_t)) {
+        PrintAndLogEx(WARNING, "wrong reply length,  firmware and client out of sync?");
+        return PM3_ESOFT;
+    }
+
+    const t55xx_brute_resp_t *r = (const t55xx_brute_resp_t *)resp.data.asBytes;
+    *tried = r->tried;
+    *found = 0;
+
+    for (uint8_t i = 0; i < r->n && i < T55XX_BRUTE_MAX_CANDIDATES; i++) {
+        PrintAndLogEx(NORMAL, "");
+        *found = t55xx_try_one_password(r->candidates[i], r->downlink[i], false);
+        if (*found) {
+            *password = r->candidates[i];
+            // nothing after the hit counts as tried
+            *tried = r->candidates[i] - start + 1;
+            return PM3_SUCCESS;
+        }
+    }
+
+    if (aborted || resp.status == PM3_EOPABORTED) {
+        return PM3_EOPABORTED;
+    }
+    return resp.status;
+}
+
 // Bruteforce - incremental password range search
 static int CmdT55xxBruteForce(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf t55xx bruteforce",
                   "This command uses bruteforce to scan a number range.\n"
+                  "The device scans the range and preselects passwords by signal,  only those are\n"
+                  "read and demodulated here to confirm them.\n"
                   "Try reading Page 0, block 7 before.\n\n"
                   _RED_("WARNING") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx bruteforce --r2 -s aaaaaa77 -e aaaaaa99\n"
+                  "lf t55xx bruteforce --r2 -s aaaaaa77 -e aaaaaa99 --resume\n"
                  );
 
-    // 1 (help) + 2 (two user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[3 + 6] = {
+    // 1 (help) + 3 (three user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[4 + 6] = {
         arg_param_begin,
         arg_str1("s", "start", "<hex>", "search start password (4 hex bytes)"),
         arg_str1("e", "end", "<hex>", "search end password (4 hex bytes)"),
+        arg_lit0(NULL, "resume", "continue an interrupted search of this range"),
     };
-    uint8_t idx = 3;
+    uint8_t idx = 4;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3565,11 +3704,12 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 3);
-    bool r1 = arg_get_lit(ctx, 4);
-    bool r2 = arg_get_lit(ctx, 5);
-    bool r3 = arg_get_lit(ctx, 6);
-    bool ra = arg_get_lit(ctx, 7);
+    bool resume = arg_get_lit(ctx, 3);
+    bool r0 = arg_get_lit(ctx, 4);
+    bool r1 = arg_get_lit(ctx, 5);
+    bool r2 = arg_get_lit(ctx, 6);
+    bool r3 = arg_get_lit(ctx, 7);
+    bool ra = arg_get_lit(ctx, 8);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3597,38 +3737,71 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
-    PrintAndLogEx(INFO, "Search password range [%08X -> %08X]", start_password, end_password);
+    // the search position is saved after every device scan,  for --resume
+    char checkpoint[64] = {0};
+    snprintf(checkpoint, sizeof(checkpoint), "lf-t55xx-bruteforce-%08X-%08X-%u%s", start_password, end_password, downlink_mode, ra ? "a" : "");
 
-    uint64_t t1 = msclock();
     curr = start_password;
+    if (resume) {
+        json_t *state = checkpoint_load(checkpoint, "lf t55xx bruteforce");
+        if (state) {
+            uint32_t next = (uint32_t)json_integer_value(json_object_get(state, "Next"));
+            if (next > start_password && next <= end_password) {
+                curr = next;
+            }
+            json_decref(state);
+        }
+    }
 
-    while (found == 0) {
+    PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
+    PrintAndLogEx(INFO, "Search password range [%08X -> %08X]", curr, end_password);
 
-        PrintAndLogEx(NORMAL, "." NOLF);
+    uint64_t t1 = msclock();
+    uint64_t done = 0;
+    uint32_t password = 0;
+    bool last = false;
 
-        if (IsCancelled()) {
-            return PM3_EOPABORTED;
+    while (found == 0 && last == false) {
+
+        uint32_t count = MIN(end_password - curr, T55XX_BRUTE_CHUNK - 1) + 1;
+        uint32_t tried = 0;
+        res = t55xx_brute_chunk(curr, count, downlink_mode, ra, &tried, &found, &password);
+        if (res == PM3_SUCCESS && tried == 0) {
+            res = PM3_ESOFT;
         }
 
-        found = t55xx_try_one_password(curr, downlink_mode, ra);
+        done += tried;
+        last = (found == 0 && res == PM3_SUCCESS && tried == count && curr + tried - 1 == end_password);
+        curr += tried;
 
-        if (curr == end_password)
+        if (found || last) {
             break;
+        }
+
+        json_t *state = json_object();
+        json_object_set_new(state, "Next", json_integer(curr));
+        checkpoint_save(checkpoint, "lf t55xx bruteforce", state);
+        json_decref(state);
 
-        curr++;
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(HINT, "Hint: run the same command with `" _YELLOW_("--resume") "` to continue at %08X", curr);
+            return res;
+        }
+
+        uint64_t ms = msclock() - t1;
+        PrintAndLogEx(INPLACE, "next " _YELLOW_("%08X") "  %.1f pwds/s", curr, (ms) ? (float)done * 1000 / ms : 0.0);
     }
 
     PrintAndLogEx(NORMAL, "");
 
+    checkpoint_remove(checkpoint);
+
     if (found) {
-        if (curr != end_password) {
-            PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr - 1);
-        } else
-            PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr);
+        PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", password);
         T55xx_Print_DownlinkMode((found >> 1) & 3);
     } else
-        PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", curr);
+        PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", end_password);
 
     t1 = msclock() - t1;
     PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
@@ -3642,8 +3815,11 @@ uint8_t t55xx_try_one_password(uint32_t password, uint8_t downlink_mode,  bool t
     // ensure 0-3
     downlink_mode = (downlink_mode & 3);
 
-    // check if dl mode 4 and loop if needed
-    for (uint8_t dl_mode = downlink_mode; dl_mode < 4; dl_mode++) {
+    // check if dl mode 4 and loop if needed,  the last one that worked first
+    uint8_t order[4];
+    t55xx_dl_order(0, order);
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t dl_mode = (try_all_dl_modes) ? order[i] : downlink_mode;
 
         if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, password, dl_mode)) {
             //  if (getSignalProperties()->isnoise == false) {
@@ -4044,7 +4220,10 @@ static int CmdT55xxDetectPage1(const char *Cmd) {
     uint8_t found_mode = 0;
 
     if (use_graphbuf == false) {
-        for (uint8_t dl_mode = downlink_mode; dl_mode < 4; dl_mode++) {
+        uint8_t order[4];
+        t55xx_dl_order(0, order);
+        for (uint8_t i = 0; i < 4; i++) {
+            uint8_t dl_mode = (try_all_dl_modes) ? order[i] : downlink_mode;
 
             if (AcquireData(T55x7_PAGE1, T55x7_TRACE_BLOCK1, usepwd, password, dl_mode) == false)
                 continue;
@@ -4052,6 +4231,7 @@ static int CmdT55xxDetectPage1(const char *Cmd) {
             if (tryDetectP1(false)) {
                 found = true;
                 found_mode = dl_mode;
+                t55xx_dl_hit(0, dl_mode);
                 break;
             } else {
                 found = false;
@@ -89,7 +89,7 @@ int demodTI(bool verbose) {
         1, 1, 1, 1, 1, 1, 1, 1
     };
 
-    buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
+    buffer_savestate_t saveState = save_bufferS16(g_GraphBuffer, g_GraphTraceLen);
     saveState.offset = g_GridOffset;
 
     int lowLen = ARRAYLEN(LowTone);
@@ -103,22 +103,29 @@ int demodTI(bool verbose) {
     if (g_GraphTraceLen < convLen) {
         return retval;
     }
+
+    int32_t *acc = getGraphBufferS32(NULL);
+    if (acc == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
     for (i = 0; i < g_GraphTraceLen - convLen; i++) {
         lowSum = 0;
         highSum = 0;
 
         for (j = 0; j < lowLen; j++) {
-            lowSum += LowTone[j] * g_GraphBuffer[i + j];
+            lowSum += LowTone[j] * acc[i + j];
         }
         for (j = 0; j < highLen; j++) {
-            highSum += HighTone[j] * g_GraphBuffer[i + j];
+            highSum += HighTone[j] * acc[i + j];
         }
         lowSum = abs((100 * lowSum) / lowLen);
         highSum = abs((100 * highSum) / highLen);
         lowSum = (lowSum < 0) ? -lowSum : lowSum;
         highSum = (highSum < 0) ? -highSum : highSum;
 
-        g_GraphBuffer[i] = (highSum << 16) | lowSum;
+        acc[i] = (highSum << 16) | lowSum;
     }
 
     for (i = 0; i < g_GraphTraceLen - convLen - 16; i++) {
@@ -126,15 +133,16 @@ int demodTI(bool verbose) {
         highTot = 0;
         // 16 and 15 are f_s divided by f_l and f_h, rounded
         for (j = 0; j < 16; j++) {
-            lowTot += (g_GraphBuffer[i + j] & 0xffff);
+            lowTot += (acc[i + j] & 0xffff);
         }
         for (j = 0; j < 15; j++) {
-            highTot += (g_GraphBuffer[i + j] >> 16);
+            highTot += (acc[i + j] >> 16);
         }
-        g_GraphBuffer[i] = lowTot - highTot;
+        acc[i] = lowTot - highTot;
     }
 
-    g_GraphTraceLen -= (convLen + 16);
+    // the tone sums outgrow the 16 bit graph, keep decoding on the 32 bit copy
+    setGraphBufferS32(acc, g_GraphTraceLen - (convLen + 16));
 
     RepaintGraphWindow();
 
@@ -156,11 +164,11 @@ int demodTI(bool verbose) {
         int dec = 0;
         // searching 17 consecutive lows
         for (j = 0; j < 17 * lowLen; j++) {
-            dec -= g_GraphBuffer[i + j];
+            dec -= acc[i + j];
         }
         // searching 7 consecutive highs
         for (; j < 17 * lowLen + 6 * highLen; j++) {
-            dec += g_GraphBuffer[i + j];
+            dec += acc[i + j];
         }
         if (dec > max) {
             max = dec;
@@ -193,10 +201,10 @@ int demodTI(bool verbose) {
     for (i = 0; i < ARRAYLEN(bits) - 1; i++) {
         int high = 0, low = 0;
         for (j = 0; j < lowLen; j++) {
-            low -= g_GraphBuffer[maxPos + j];
+            low -= acc[maxPos + j];
         }
         for (j = 0; j < highLen; j++) {
-            high += g_GraphBuffer[maxPos + j];
+            high += acc[maxPos + j];
         }
 
         if (high > low) {
@@ -277,8 +285,9 @@ int demodTI(bool verbose) {
     }
 
 out:
+    free(acc);
     if (retval != PM3_SUCCESS) {
-        restore_bufferS32(saveState, g_GraphBuffer);
+        restore_bufferS16(saveState, g_GraphBuffer);
         g_GridOffset = saveState.offset;
     }
 
@@ -41,7 +41,7 @@ static int CmdHelp(const char *Cmd);
 // see ASKDemod for what args are accepted
 int demodzx(bool verbose) {
     (void) verbose; // unused so far
-    buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
+    buffer_savestate_t saveState = save_bufferS16(g_GraphBuffer, g_GraphTraceLen);
     saveState.offset = g_GridOffset;
 
     // CmdAskEdgeDetect("");
@@ -50,7 +50,7 @@ int demodzx(bool verbose) {
     bool st = true;
     if (ASKDemod_ext(64, 0, 0, 0, false, false, false, 1, &st) != PM3_SUCCESS) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - ZX: ASK/Manchester Demod failed");
-        restore_bufferS32(saveState, g_GraphBuffer);
+        restore_bufferS16(saveState, g_GraphBuffer);
         g_GridOffset = saveState.offset;
         return PM3_ESOFT;
     }
@@ -66,7 +66,7 @@ int demodzx(bool verbose) {
         else
             PrintAndLogEx(DEBUG, "DEBUG: Error - ZX: ans: %d", ans);
 
-        restore_bufferS32(saveState, g_GraphBuffer);
+        restore_bufferS16(saveState, g_GraphBuffer);
         g_GridOffset = saveState.offset;
         return PM3_ESOFT;
     }
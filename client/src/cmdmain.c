@@ -26,6 +26,7 @@
 #include <ctype.h>
 #include <time.h>    // MingW
 #include <stdlib.h>  // calloc
+#include <math.h>    // sqrt
 
 #include "comms.h"
 #include "cmdhf.h"
@@ -43,11 +44,13 @@
 #include "cmdsmartcard.h" // rdv40 smart card ISO7816 commands
 #include "cmdusart.h"     // rdv40 FPC USART commands
 #include "cmdwiegand.h"   // wiegand commands
+#include "pm3daemon.h"
 #include "ui.h"
 #include "util_posix.h"
 #include "commonutil.h"   // ARRAYLEN
 #include "preferences.h"
 #include "cliparser.h"
+#include "jansson.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -129,31 +132,368 @@ static int lf_search_plus(const char *Cmd) {
     return retval;
 }
 
+// `auto --sched`: runs the LF search and the HF probes by likelihood instead of in a fixed order.
+//
+// Each probe keeps hits / runs / time spent,  the probes are run by decreasing
+// P(hit) / mean time,  which minimizes the expected time to the first hit.
+// A quick `lf tune` / `hf tune` reading is compared with the readings taken when
+// that band had no tag.  A band whose antenna is clearly loaded goes first,  a band
+// that reads like an empty field while the other one is loaded is deferred and only
+// searched when nothing else was found.  The statistics live in the user directory.
+#define AUTO_STATS_FILE      "auto_stats.json"
+#define AUTO_STATS_MAX_HF    16
+#define AUTO_STATS_DECAY     256   // halve the counters above this many runs
+#define AUTO_FIELD_MIN_N     5     // empty field readings needed before trusting them
+#define AUTO_FIELD_LOADED    3.0   // z-score of a loaded antenna
+#define AUTO_FIELD_EMPTY     2.0   // z-score still consistent with no tag
+#define AUTO_DEFAULT_MS      500
+#define AUTO_LF              0xFF
+
+typedef struct {
+    uint32_t hits;
+    uint32_t runs;
+    uint64_t ms;
+} auto_probe_stat_t;
+
+// Welford running mean / variance
+typedef struct {
+    uint32_t n;
+    double mean;
+    double m2;
+} auto_field_stat_t;
+
+typedef struct {
+    auto_probe_stat_t lf;
+    auto_probe_stat_t hf[AUTO_STATS_MAX_HF];
+    auto_field_stat_t lf_empty;
+    auto_field_stat_t hf_empty;
+} auto_stats_t;
+
+typedef enum {
+    BAND_LOADED = 0,
+    BAND_UNKNOWN,
+    BAND_EMPTY,
+} auto_band_t;
+
+typedef struct {
+    uint8_t idx;      // hf_search_probes index or AUTO_LF
+    uint8_t tier;     // auto_band_t of its band
+    double score;
+} auto_item_t;
+
+static void auto_probe_from_json(json_t *o, auto_probe_stat_t *st) {
+    if (json_is_object(o) == false)
+        return;
+    st->hits = json_integer_value(json_object_get(o, "hits"));
+    st->runs = json_integer_value(json_object_get(o, "runs"));
+    st->ms = json_integer_value(json_object_get(o, "ms"));
+    if (st->hits > st->runs)
+        st->hits = st->runs;
+}
+
+static json_t *auto_probe_to_json(const auto_probe_stat_t *st) {
+    return json_pack("{sIsIsI}", "hits", (json_int_t)st->hits, "runs", (json_int_t)st->runs, "ms", (json_int_t)st->ms);
+}
+
+static void auto_field_from_json(json_t *o, auto_field_stat_t *st) {
+    if (json_is_object(o) == false)
+        return;
+    st->n = json_integer_value(json_object_get(o, "n"));
+    st->mean = json_number_value(json_object_get(o, "mean"));
+    st->m2 = json_number_value(json_object_get(o, "m2"));
+}
+
+static json_t *auto_field_to_json(const auto_field_stat_t *st) {
+    return json_pack("{sIsfsf}", "n", (json_int_t)st->n, "mean", st->mean, "m2", st->m2);
+}
+
+static void auto_stats_load(auto_stats_t *stats) {
+    memset(stats, 0, sizeof(auto_stats_t));
+
+    char *path = NULL;
+    if (searchHomeFilePath(&path, NULL, AUTO_STATS_FILE, false) != PM3_SUCCESS)
+        return;
+
+    json_error_t error;
+    json_t *root = json_load_file(path, 0, &error);
+    free(path);
+    if (json_is_object(root) == false) {
+        json_decref(root);
+        return;
+    }
+
+    auto_probe_from_json(json_object_get(root, "lf"), &stats->lf);
+
+    json_t *hf = json_object_get(root, "hf");
+    for (size_t i = 0; i < hf_search_probes_len && i < AUTO_STATS_MAX_HF; i++) {
+        auto_probe_from_json(json_object_get(hf, hf_search_probes[i].key), &stats->hf[i]);
+    }
+
+    json_t *field = json_object_get(root, "field");
+    auto_field_from_json(json_object_get(field, "lf"), &stats->lf_empty);
+    auto_field_from_json(json_object_get(field, "hf"), &stats->hf_empty);
+    json_decref(root);
+}
+
+static void auto_stats_save(const auto_stats_t *stats) {
+    char *path = NULL;
+    if (searchHomeFilePath(&path, NULL, AUTO_STATS_FILE, true) != PM3_SUCCESS)
+        return;
+
+    json_t *root = json_object();
+    json_object_set_new(root, "lf", auto_probe_to_json(&stats->lf));
+
+    json_t *hf = json_object();
+    for (size_t i = 0; i < hf_search_probes_len && i < AUTO_STATS_MAX_HF; i++) {
+        json_object_set_new(hf, hf_search_probes[i].key, auto_probe_to_json(&stats->hf[i]));
+    }
+    json_object_set_new(root, "hf", hf);
+
+    json_t *field = json_object();
+    json_object_set_new(field, "lf", auto_field_to_json(&stats->lf_empty));
+    json_object_set_new(field, "hf", auto_field_to_json(&stats->hf_empty));
+    json_object_set_new(root, "field", field);
+
+    if (json_dump_file(root, path, JSON_INDENT(2)) != 0) {
+        PrintAndLogEx(WARNING, "Failed to save search statistics to " _YELLOW_("%s"), path);
+    }
+    json_decref(root);
+    free(path);
+}
+
+static void auto_probe_update(auto_probe_stat_t *st, bool hit, uint32_t ms) {
+    if (st->runs >= AUTO_STATS_DECAY) {
+        st->hits /= 2;
+        st->runs /= 2;
+        st->ms /= 2;
+    }
+    st->runs++;
+    st->ms += ms;
+    if (hit)
+        st->hits++;
+}
+
+static void auto_field_update(auto_field_stat_t *st, uint32_t mv) {
+    if (st->n >= AUTO_STATS_DECAY) {
+        st->m2 *= (double)(st->n / 2) / st->n;
+        st->n /= 2;
+    }
+    st->n++;
+    double d = mv - st->mean;
+    st->mean += d / st->n;
+    st->m2 += d * (mv - st->mean);
+}
+
+// how far below the empty field reading the antenna voltage is
+static auto_band_t auto_field_band(const auto_field_stat_t *st, uint32_t mv, double *z) {
+    *z = 0;
+    if (mv == 0 || st->n < AUTO_FIELD_MIN_N)
+        return BAND_UNKNOWN;
+
+    // 1% floor,  the readings of an idle antenna hardly change
+    double sd = MAX(sqrt(st->m2 / (st->n - 1)), st->mean / 100);
+    *z = (st->mean - mv) / sd;
+    if (*z >= AUTO_FIELD_LOADED)
+        return BAND_LOADED;
+    if (*z < AUTO_FIELD_EMPTY)
+        return BAND_EMPTY;
+    return BAND_UNKNOWN;
+}
+
+static double auto_probe_score(const auto_probe_stat_t *st) {
+    // Laplace smoothed,  so a cold start keeps a cheap probe ahead of an expensive one
+    double p = (st->hits + 1.0) / (st->runs + 2.0);
+    double ms = (st->runs) ? (double)st->ms / st->runs : AUTO_DEFAULT_MS;
+    return p / MAX(ms, 1.0);
+}
+
+static int auto_item_cmp(const void *a, const void *b) {
+    const auto_item_t *x = a;
+    const auto_item_t *y = b;
+    if (x->tier != y->tier)
+        return x->tier - y->tier;
+    if (x->score != y->score)
+        return (x->score < y->score) ? 1 : -1;
+    return x->idx - y->idx;
+}
+
+static uint32_t auto_measure_hf(void) {
+    PacketResponseNG resp;
+    uint8_t mode[] = {1};
+    clearCommandBuffer();
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_HF, mode, sizeof(mode));
+    if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_HF, &resp, 1000) == false)
+        return 0;
+
+    uint32_t mv = 0;
+    mode[0] = 2;
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_HF, mode, sizeof(mode));
+    if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_HF, &resp, 1000) &&
+            resp.status == PM3_SUCCESS && resp.length == sizeof(uint16_t)) {
+        mv = resp.data.asDwords[0] & 0xFFFF;
+    }
+
+    mode[0] = 3;
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_HF, mode, sizeof(mode));
+    WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_HF, &resp, 1000);
+    return mv;
+}
+
+static uint32_t auto_measure_lf(void) {
+    PacketResponseNG resp;
+    uint8_t params[] = {1, LF_DIVISOR_125};
+    clearCommandBuffer();
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_LF, params, sizeof(params));
+    if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_LF, &resp, 1000) == false)
+        return 0;
+
+    uint32_t mv = 0;
+    params[0] = 2;
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_LF, params, sizeof(params));
+    if (WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_LF, &resp, 1000) &&
+            resp.status == PM3_SUCCESS && resp.length == sizeof(uint32_t)) {
+        mv = resp.data.asDwords[0];
+    }
+
+    params[0] = 3;
+    SendCommandNG(CMD_MEASURE_ANTENNA_TUNING_LF, params, sizeof(params));
+    WaitForResponseTimeout(CMD_MEASURE_ANTENNA_TUNING_LF, &resp, 1000);
+    return mv;
+}
+
+static int auto_sched_search(bool exit_first) {
+
+    if (hf_search_probes_len > AUTO_STATS_MAX_HF) {
+        PrintAndLogEx(ERR, "Too many hf search probes for the statistics");
+        return PM3_ESOFT;
+    }
+
+    auto_stats_t stats;
+    auto_stats_load(&stats);
+
+    uint32_t lf_mv = auto_measure_lf();
+    uint32_t hf_mv = auto_measure_hf();
+
+    double lf_z, hf_z;
+    auto_band_t lf_band = auto_field_band(&stats.lf_empty, lf_mv, &lf_z);
+    auto_band_t hf_band = auto_field_band(&stats.hf_empty, hf_mv, &hf_z);
+
+    // only defer a band when the other one explains the tag
+    if (lf_band == BAND_EMPTY && hf_band != BAND_LOADED)
+        lf_band = BAND_UNKNOWN;
+    if (hf_band == BAND_EMPTY && lf_band != BAND_LOADED)
+        hf_band = BAND_UNKNOWN;
+
+    static const char *band_str[] = {"loaded", "unknown", "empty"};
+    PrintAndLogEx(INFO, "LF field " _YELLOW_("%u") " mV ( %s, z %.1f )  HF field " _YELLOW_("%u") " mV ( %s, z %.1f )",
+                  lf_mv, band_str[lf_band], lf_z, hf_mv, band_str[hf_band], hf_z);
+
+    auto_item_t items[AUTO_STATS_MAX_HF + 1];
+    size_t n = 0;
+    items[n++] = (auto_item_t) {AUTO_LF, lf_band, auto_probe_score(&stats.lf)};
+    for (size_t i = 0; i < hf_search_probes_len; i++) {
+        items[n++] = (auto_item_t) {i, hf_band, auto_probe_score(&stats.hf[i])};
+    }
+    qsort(items, n, sizeof(auto_item_t), auto_item_cmp);
+
+    char order[256] = {0};
+    for (size_t i = 0; i < n; i++) {
+        const char *key = (items[i].idx == AUTO_LF) ? "lf" : hf_search_probes[items[i].idx].key;
+        snprintf(order + strlen(order), sizeof(order) - strlen(order), "%s%s%s",
+                 (i) ? ", " : "", key, (items[i].tier == BAND_EMPTY) ? "*" : "");
+    }
+    PrintAndLogEx(INFO, "Search order... %s", order);
+
+    uint8_t found[AUTO_STATS_MAX_HF] = {0};
+    bool lf_found = false, hf_found = false;
+    bool lf_done = false, hf_all = true;
+    int res = PM3_ESOFT;
+
+    for (size_t i = 0; i < n; i++) {
+
+        if (res == PM3_SUCCESS && (exit_first || items[i].tier == BAND_EMPTY)) {
+            if (items[i].idx != AUTO_LF)
+                hf_all = false;
+            continue;
+        }
+
+        uint32_t ms = 0;
+        if (items[i].idx == AUTO_LF) {
+            PrintAndLogEx(INFO, "lf search");
+            uint64_t t = msclock();
+            lf_found = (CmdLFfind("") == PM3_SUCCESS);
+            ms = (uint32_t)(msclock() - t);
+            auto_probe_update(&stats.lf, lf_found, ms);
+            lf_done = true;
+            if (lf_found)
+                res = PM3_SUCCESS;
+            continue;
+        }
+
+        int ret = hf_search_probe(items[i].idx, false, &ms);
+        if (ret == PM3_ENOTIMPL)
+            continue;
+
+        found[items[i].idx] = (ret == PM3_SUCCESS);
+        auto_probe_update(&stats.hf[items[i].idx], found[items[i].idx], ms);
+        if (ret == PM3_SUCCESS) {
+            hf_found = true;
+            res = PM3_SUCCESS;
+        }
+    }
+    PROMPT_CLEARLINE;
+    DropField();
+
+    if (hf_found)
+        hf_search_hints(found);
+
+    // a band only tells what an empty field reads like once it was fully searched
+    if (lf_done && lf_found == false && lf_mv)
+        auto_field_update(&stats.lf_empty, lf_mv);
+    if (hf_all && hf_found == false && hf_mv)
+        auto_field_update(&stats.hf_empty, hf_mv);
+
+    auto_stats_save(&stats);
+    return res;
+}
+
 static int CmdAuto(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "auto",
-                  "Run LF SEARCH / HF SEARCH / DATA PLOT / DATA SAVE",
-                  "auto"
+                  "Run LF SEARCH / HF SEARCH / DATA PLOT / DATA SAVE\n"
+                  "With --sched the searches are ordered by a quick LF / HF field reading and by past hits,\n"
+                  "statistics are kept in `" AUTO_STATS_FILE "` in the user directory",
+                  "auto\n"
+                  "auto --sched"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("c", NULL, "Continue searching even after a first hit"),
+        arg_lit0("s", "sched", "Schedule searches by likelihood and learn from the result"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     bool exit_first = (arg_get_lit(ctx, 1) == false);
+    bool sched = arg_get_lit(ctx, 2);
     CLIParserFree(ctx);
 
-    PrintAndLogEx(INFO, "lf search");
-    int ret = CmdLFfind("");
-    if (ret == PM3_SUCCESS && exit_first)
-        return ret;
-
-    PrintAndLogEx(INFO, "hf search");
-    ret = CmdHFSearch("");
-    if (ret == PM3_SUCCESS && exit_first)
-        return ret;
+    int ret;
+    if (sched) {
+        ret = auto_sched_search(exit_first);
+        if (ret == PM3_SUCCESS && exit_first)
+            return ret;
+    } else {
+        PrintAndLogEx(INFO, "lf search");
+        ret = CmdLFfind("");
+        if (ret == PM3_SUCCESS && exit_first)
+            return ret;
+
+        PrintAndLogEx(INFO, "hf search");
+        ret = CmdHFSearch("");
+        if (ret == PM3_SUCCESS && exit_first)
+            return ret;
+    }
 
     PrintAndLogEx(INFO, "lf search - unknown");
     ret = lf_search_plus("");
@@ -271,6 +611,82 @@ static int CmdMsleep(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdDaemon(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "daemon",
+                  "Serve console commands to other processes,  over JSON-RPC 2.0 one request per line.\n"
+                  "The client keeps its device connection and loaded tables between requests,  commands\n"
+                  "of concurrent sessions run one at a time, taking turns.  Press <Enter> to stop.\n"
+                  "  {\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"console\",\"params\":{\"cmd\":\"hw version\"}}\n"
+                  "See pyscripts/pm3_daemon.py for a client",
+                  "daemon                       --> listen on ~/.proxmark3/" PM3DAEMON_SOCKET "\n"
+                  "daemon --socket /tmp/pm3.sock\n"
+                  "daemon -p 9211               --> listen on TCP 127.0.0.1:9211\n"
+                  "daemon --metrics 9212        --> also serve http://127.0.0.1:9212/metrics\n"
+                  "daemon --metrics 9212 --health 300  --> and run `hw tune` every 5 minutes when idle\n"
+                  "proxmark3 /dev/ttyACM0 -c daemon"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0(NULL, "socket", "<path>", "Unix socket to listen on"),
+        arg_str0(NULL, "bind",   "<addr>", "Listen on TCP instead,  address (def 127.0.0.1)"),
+        arg_int0("p",  "port",   "<dec>",  "Listen on TCP instead,  port (def 9211)"),
+        arg_int0(NULL, "metrics", "<dec>", "Serve Prometheus metrics over HTTP on this port"),
+        arg_int0(NULL, "health", "<sec>", "Measure the antennas for the metrics every <sec> when idle"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int pathlen = 0;
+    char path[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)path, sizeof(path), &pathlen);
+    int addrlen = 0;
+    char addr[64] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)addr, sizeof(addr), &addrlen);
+    bool use_tcp = (addrlen || arg_get_int_count(ctx, 3));
+    uint32_t port = arg_get_u32_def(ctx, 3, PM3DAEMON_PORT);
+    uint32_t metrics_port = arg_get_u32_def(ctx, 4, 0);
+    uint32_t health_s = arg_get_u32_def(ctx, 5, 0);
+    CLIParserFree(ctx);
+
+    if (metrics_port > 0xFFFF) {
+        PrintAndLogEx(WARNING, "Metrics port must be 1 - 65535");
+        return PM3_EINVARG;
+    }
+    if (health_s && metrics_port == 0) {
+        PrintAndLogEx(WARNING, "`--health` needs `--metrics`");
+        return PM3_EINVARG;
+    }
+
+    if (use_tcp) {
+        if (pathlen) {
+            PrintAndLogEx(WARNING, "Use either a unix socket or TCP");
+            return PM3_EINVARG;
+        }
+        if (port == 0 || port > 0xFFFF) {
+            PrintAndLogEx(WARNING, "Port must be 1 - 65535");
+            return PM3_EINVARG;
+        }
+        if (addrlen == 0) {
+            strcpy(addr, "127.0.0.1");
+        }
+        return daemon_serve(NULL, addr, port, metrics_port, health_s);
+    }
+
+    if (pathlen) {
+        return daemon_serve(path, NULL, 0, metrics_port, health_s);
+    }
+
+    char *fn = NULL;
+    if (searchHomeFilePath(&fn, NULL, PM3DAEMON_SOCKET, true) != PM3_SUCCESS) {
+        PrintAndLogEx(ERR, "No user directory for the socket,  use `--socket`");
+        return PM3_EFILE;
+    }
+    int res = daemon_serve(fn, NULL, 0, metrics_port, health_s);
+    free(fn);
+    return res;
+}
+
 static int CmdQuit(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "quit",
@@ -343,6 +759,7 @@ static command_t CommandTable[] = {
     {"--------",     CmdHelp,      AlwaysAvailable,         "----------------------- " _CYAN_("General") " -----------------------"},
     {"auto",         CmdAuto,      IfPm3Present,            "Automated detection process for unknown tags"},
     {"clear",        CmdClear,     AlwaysAvailable,         "Clear screen"},
+    {"daemon",       CmdDaemon,    AlwaysAvailable,         "Serve console commands to other processes"},
     {"hints",        CmdHints,     AlwaysAvailable,         "Turn hints on / off"},
     {"msleep",       CmdMsleep,    AlwaysAvailable,         "Add a pause in milliseconds"},
     {"rem",          CmdRem,       AlwaysAvailable,         "Add a text line in log file"},
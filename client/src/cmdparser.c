@@ -19,11 +19,14 @@
 #include "cmdparser.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "ui.h"
 #include "comms.h"
 #include "util_posix.h" // msleep
+#include "util.h"       // g_debugMode
+#include "commonutil.h" // ARRAYLEN
 
 
 #define MAX_PM3_INPUT_ARGS_LENGTH    4096
@@ -219,6 +222,214 @@ void CmdsHelp(const command_t Commands[]) {
     PrintAndLogEx(NORMAL, "");
 }
 
+// Lookup index of a command table,  built the first time the table gets parsed.
+// Names go through a perfect hash,  the seed is searched until no two names share a
+// slot,  so a lookup costs one hash and one strcmp.  Availability of every entry is
+// cached and only asked again when the state the IfPm3* helpers look at changes
+typedef struct {
+    const command_t *table;
+    uint32_t seed;
+    uint32_t mask;          // slots - 1
+    uint16_t *slots;        // command index + 1,  0 is empty
+    uint16_t count;
+    uint8_t *avail;         // per command,  0 not asked yet,  1 not available,  2 available
+    uint32_t avail_gen;
+} cmd_index_t;
+
+typedef struct {
+    uint8_t debug;
+    bool pm3_present;
+    bool help_dump_mode;
+    bool send_via_fpc_usart;
+    capabilities_t capabilities;
+} cmd_avail_state_t;
+
+static cmd_index_t **cmd_indexes = NULL;
+static size_t cmd_indexes_max = 0;
+static size_t cmd_indexes_cnt = 0;
+
+static cmd_avail_state_t cmd_avail_state;
+static uint32_t cmd_avail_gen = 0;
+
+static bool (*const cmd_avail_cacheable[])(void) = {
+    AlwaysAvailable, IfClientDebugEnabled, IfPm3Present, IfPm3Rdv4Fw, IfPm3Flash, IfPm3Smartcard,
+    IfPm3FpcUsart, IfPm3FpcUsartHost, IfPm3FpcUsartHostFromUsb, IfPm3FpcUsartDevFromUsb,
+    IfPm3FpcUsartFromUsb, IfPm3Lf, IfPm3Hitag, IfPm3EM4x50, IfPm3EM4x70, IfPm3Hfsniff, IfPm3Hfplot,
+    IfPm3Iso14443a, IfPm3Iso14443b, IfPm3Iso14443, IfPm3Iso15693, IfPm3Felica, IfPm3Legicrf,
+    IfPm3Iclass, IfPm3NfcBarcode, IfPm3Lcd, IfPm3Zx8211,
+};
+
+static uint32_t cmd_hash(uint32_t seed, const char *name) {
+    // FNV-1a
+    uint32_t h = 2166136261u ^ seed;
+    while (*name) {
+        h ^= (uint8_t) * name++;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// bump the generation when anything the availability helpers read has changed
+static void cmd_avail_refresh(void) {
+    cmd_avail_state_t now;
+    memset(&now, 0, sizeof(now));
+    now.debug = g_debugMode;
+    now.pm3_present = g_session.pm3_present;
+    now.help_dump_mode = g_session.help_dump_mode;
+    now.send_via_fpc_usart = g_conn.send_via_fpc_usart;
+    memcpy(&now.capabilities, &g_pm3_capabilities, sizeof(capabilities_t));
+
+    if (cmd_avail_gen == 0 || memcmp(&now, &cmd_avail_state, sizeof(now)) != 0) {
+        memcpy(&cmd_avail_state, &now, sizeof(now));
+        cmd_avail_gen++;
+    }
+}
+
+static bool cmd_index_fill(cmd_index_t *idx) {
+    for (uint32_t seed = 0; seed < 64; seed++) {
+        memset(idx->slots, 0, (idx->mask + 1) * sizeof(uint16_t));
+
+        bool collision = false;
+        for (uint16_t i = 0; i < idx->count && collision == false; i++) {
+            uint32_t s = cmd_hash(seed, idx->table[i].Name) & idx->mask;
+            if (idx->slots[s] == 0) {
+                idx->slots[s] = i + 1;
+            } else if (strcmp(idx->table[idx->slots[s] - 1].Name, idx->table[i].Name) != 0) {
+                collision = true;
+            }
+            // same name twice,  the first one wins as with a linear search
+        }
+
+        if (collision == false) {
+            idx->seed = seed;
+            return true;
+        }
+    }
+    return false;
+}
+
+static cmd_index_t *cmd_index_build(const command_t *table) {
+    cmd_index_t *idx = calloc(1, sizeof(cmd_index_t));
+    if (idx == NULL) {
+        return NULL;
+    }
+    idx->table = table;
+
+    while (table[idx->count].Name && idx->count < UINT16_MAX - 1) {
+        idx->count++;
+    }
+
+    idx->avail = calloc(idx->count + 1, sizeof(uint8_t));
+
+    // start at twice the names,  grow until a seed works
+    for (uint32_t slots = 4; slots <= (1 << 16); slots <<= 1) {
+        if (slots < (uint32_t)idx->count * 2) {
+            continue;
+        }
+
+        free(idx->slots);
+        idx->slots = calloc(slots, sizeof(uint16_t));
+        if (idx->slots == NULL || idx->avail == NULL) {
+            break;
+        }
+
+        idx->mask = slots - 1;
+        if (cmd_index_fill(idx)) {
+            return idx;
+        }
+    }
+
+    free(idx->slots);
+    free(idx->avail);
+    free(idx);
+    return NULL;
+}
+
+// open addressing on the table address
+static cmd_index_t *cmd_index_get(const command_t *table) {
+
+    if (cmd_indexes_cnt * 4 >= cmd_indexes_max * 3) {
+        size_t max = (cmd_indexes_max) ? cmd_indexes_max * 2 : 256;
+        cmd_index_t **tmp = calloc(max, sizeof(cmd_index_t *));
+        if (tmp == NULL) {
+            return NULL;
+        }
+        for (size_t i = 0; i < cmd_indexes_max; i++) {
+            if (cmd_indexes[i] == NULL) {
+                continue;
+            }
+            size_t s = ((uintptr_t)cmd_indexes[i]->table >> 4) & (max - 1);
+            while (tmp[s]) {
+                s = (s + 1) & (max - 1);
+            }
+            tmp[s] = cmd_indexes[i];
+        }
+        free(cmd_indexes);
+        cmd_indexes = tmp;
+        cmd_indexes_max = max;
+    }
+
+    size_t s = ((uintptr_t)table >> 4) & (cmd_indexes_max - 1);
+    while (cmd_indexes[s]) {
+        if (cmd_indexes[s]->table == table) {
+            return cmd_indexes[s];
+        }
+        s = (s + 1) & (cmd_indexes_max - 1);
+    }
+
+    cmd_index_t *idx = cmd_index_build(table);
+    if (idx) {
+        cmd_indexes[s] = idx;
+        cmd_indexes_cnt++;
+    }
+    return idx;
+}
+
+// index of <name> in the table,  the index of the NULL terminator when not found
+static int cmd_index_find(const cmd_index_t *idx, const command_t Commands[], const char *name) {
+    if (idx == NULL) {
+        int i = 0;
+        while (Commands[i].Name && strcmp(Commands[i].Name, name) != 0) {
+            ++i;
+        }
+        return i;
+    }
+
+    uint16_t slot = idx->slots[cmd_hash(idx->seed, name) & idx->mask];
+    if (slot && strcmp(idx->table[slot - 1].Name, name) == 0) {
+        return slot - 1;
+    }
+    return idx->count;
+}
+
+static bool cmd_index_available(cmd_index_t *idx, const command_t Commands[], int i) {
+    if (idx == NULL) {
+        return Commands[i].IsAvailable();
+    }
+
+    bool cacheable = false;
+    for (size_t j = 0; j < ARRAYLEN(cmd_avail_cacheable); j++) {
+        if (Commands[i].IsAvailable == cmd_avail_cacheable[j]) {
+            cacheable = true;
+            break;
+        }
+    }
+
+    if (cacheable == false) {
+        return Commands[i].IsAvailable();
+    }
+
+    if (idx->avail_gen != cmd_avail_gen) {
+        memset(idx->avail, 0, idx->count + 1);
+        idx->avail_gen = cmd_avail_gen;
+    }
+
+    if (idx->avail[i] == 0) {
+        idx->avail[i] = (Commands[i].IsAvailable()) ? 2 : 1;
+    }
+    return (idx->avail[i] == 2);
+}
+
 int CmdsParse(const command_t Commands[], const char *Cmd) {
 
     if (g_session.client_exe_delay != 0) {
@@ -298,19 +509,16 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
 
     bool request_help = (strcmp(Cmd + tmplen, "-h") == 0) || (strcmp(Cmd + tmplen, "--help") == 0);
 
-    int i = 0;
-    while (Commands[i].Name) {
-        if (0 == strcmp(Commands[i].Name, cmd_name)) {
-            if ((Commands[i].Help[0] == '{') ||  // always allow parsing categories
-                    request_help ||              // always allow requesting help
-                    Commands[i].IsAvailable()) {
-                break;
-            } else {
-                PrintAndLogEx(WARNING, "This command is " _YELLOW_("not available") " in this mode");
-                return PM3_ENOTIMPL;
-            }
-        }
-        ++i;
+    cmd_avail_refresh();
+    cmd_index_t *idx = cmd_index_get(Commands);
+
+    int i = cmd_index_find(idx, Commands, cmd_name);
+    if (Commands[i].Name &&
+            (Commands[i].Help[0] != '{') &&         // always allow parsing categories
+            (request_help == false) &&              // always allow requesting help
+            (cmd_index_available(idx, Commands, i) == false)) {
+        PrintAndLogEx(WARNING, "This command is " _YELLOW_("not available") " in this mode");
+        return PM3_ENOTIMPL;
     }
 
     /* try to find exactly one prefix-match */
@@ -319,7 +527,7 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
         int matches = 0;
 
         for (i = 0; Commands[i].Name; i++) {
-            if (!strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) && Commands[i].IsAvailable()) {
+            if (!strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) && cmd_index_available(idx, Commands, i)) {
                 last_match = i;
                 matches++;
             }
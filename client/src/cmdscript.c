@@ -336,7 +336,7 @@ static int CmdScriptRun(const char *Cmd) {
 #ifdef HAVE_LUA_SWIG
         luaL_requiref(lua_state, "pm3", luaopen_pm3, 1);
 #endif
-        error = luaL_loadfile(lua_state, script_path);
+        error = pm3_lua_loadfile(lua_state, script_path);
         free(script_path);
         if (!error) {
             lua_pushstring(lua_state, arguments);
@@ -479,6 +479,8 @@ static int CmdSmartRaw(const char *Cmd) {
             payload->flags |= SC_RAW_T0;
         else
             payload->flags |= SC_RAW;
+
+        payload->flags |= SC_GET_RESPONSE;
     }
 
     uint8_t *buf = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
@@ -829,6 +831,88 @@ static int CmdSmartReader(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int CmdSmartI2C(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "smart i2c",
+                  "Set the I2C bus speed to the sim module and show transport statistics.\n"
+                  "Fast mode shortens the bit timing and the wait before each read,  it is probed on the module\n"
+                  "and falls back to normal if the module does not keep up.",
+                  "smart i2c             -> show statistics\n"
+                  "smart i2c --fast      -> use fast bus timing\n"
+                  "smart i2c --normal -r -> use normal bus timing,  reset statistics"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "fast", "fast bus timing"),
+        arg_lit0(NULL, "normal", "normal bus timing"),
+        arg_lit0("r", "reset", "reset statistics"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool fast = arg_get_lit(ctx, 1);
+    bool normal = arg_get_lit(ctx, 2);
+    bool reset = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (fast && normal) {
+        PrintAndLogEx(WARNING, "Only one bus speed can be used at a time");
+        return PM3_EINVARG;
+    }
+
+    smart_i2c_req_t payload = {
+        .speed = SMART_I2C_SPEED_KEEP,
+        .reset_stats = reset,
+    };
+    if (fast)
+        payload.speed = SMART_I2C_SPEED_FAST;
+    else if (normal)
+        payload.speed = SMART_I2C_SPEED_NORMAL;
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_SMART_I2C, (uint8_t *)&payload, sizeof(payload));
+    PacketResponseNG resp;
+    if (WaitForResponseTimeout(CMD_SMART_I2C, &resp, 2500) == false) {
+        PrintAndLogEx(WARNING, "command execution time out");
+        return PM3_ETIMEOUT;
+    }
+
+    if (resp.length != sizeof(smart_i2c_stats_t)) {
+        PrintAndLogEx(WARNING, "wrong response length");
+        return PM3_ESOFT;
+    }
+
+    const smart_i2c_stats_t *st = (smart_i2c_stats_t *)resp.data.asBytes;
+
+    if (resp.status == PM3_EFAILED) {
+        PrintAndLogEx(WARNING, "sim module did not keep up with fast timing,  using " _YELLOW_("normal"));
+    } else if (resp.status != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "sim module not responding");
+        return resp.status;
+    }
+
+    PrintAndLogEx(INFO, "--- " _CYAN_("I2C transport") " ---------------------------");
+    PrintAndLogEx(INFO, "Speed........... %s", (st->speed == SMART_I2C_SPEED_FAST) ? _GREEN_("fast") : "normal");
+    PrintAndLogEx(INFO, "Read wait....... %u us", st->read_wait_us);
+    PrintAndLogEx(INFO, "Exchanges....... %u", st->exchanges);
+    PrintAndLogEx(INFO, "Writes / reads.. %u / %u", st->writes, st->reads);
+    if (st->errors)
+        PrintAndLogEx(INFO, "Errors.......... " _RED_("%u"), st->errors);
+    else
+        PrintAndLogEx(INFO, "Errors.......... 0");
+    PrintAndLogEx(INFO, "Bytes tx / rx... %u / %u", st->bytes_tx, st->bytes_rx);
+    PrintAndLogEx(INFO, "Bus tx / rx..... %u / %u us", st->tx_us, st->rx_us);
+    PrintAndLogEx(INFO, "Card wait....... %u us", st->card_us);
+    if (st->exchanges) {
+        PrintAndLogEx(INFO, "Per exchange.... %u us bus,  %u us card"
+                      , (st->tx_us + st->rx_us) / st->exchanges
+                      , st->card_us / st->exchanges
+                     );
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdSmartSetClock(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1449,6 +1533,7 @@ static command_t CommandTable[] = {
     {"raw",        CmdSmartRaw,           IfPm3Smartcard,  "Send raw hex data to tag"},
     {"upgrade",    CmdSmartUpgrade,       AlwaysAvailable, "Upgrade sim module firmware"},
     {"setclock",   CmdSmartSetClock,      IfPm3Smartcard,  "Set clock speed"},
+    {"i2c",        CmdSmartI2C,           IfPm3Smartcard,  "Set I2C bus speed, show transport statistics"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -1468,7 +1553,20 @@ int ExchangeAPDUSC(bool verbose, uint8_t *datain, int datainlen, bool activateCa
     *dataoutlen = 0;
 
     smart_card_raw_t *payload = calloc(1, sizeof(smart_card_raw_t) + datainlen);
-    payload->flags = (SC_RAW_T0 | SC_LOG);
+    if (payload == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    // the device follows 61xx itself,  so the answer can be longer than one frame
+    uint8_t *buf = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
+    if (buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(payload);
+        return PM3_EMALLOC;
+    }
+
+    payload->flags = (SC_RAW_T0 | SC_LOG | SC_GET_RESPONSE);
     if (activateCard) {
         payload->flags |= (SC_SELECT | SC_CONNECT);
     }
@@ -1479,31 +1577,42 @@ int ExchangeAPDUSC(bool verbose, uint8_t *datain, int datainlen, bool activateCa
     clearCommandBuffer();
     SendCommandNG(CMD_SMART_RAW, (uint8_t *)payload, sizeof(smart_card_raw_t) + datainlen);
 
-    int len = smart_responseEx(dataout, maxdataoutlen, verbose);
+    int len = smart_responseEx(buf, PM3_CMD_DATA_SIZE, verbose);
     if (len < 0) {
         free(payload);
+        free(buf);
         return PM3_ESOFT;
     }
 
     // retry
-    if (len > 1 && dataout[len - 2] == 0x6c && datainlen > 4) {
+    if (len > 1 && buf[len - 2] == 0x6c && datainlen > 4) {
 
-        payload->flags = SC_RAW_T0;
+        payload->flags = (SC_RAW_T0 | SC_GET_RESPONSE);
         payload->len = 5;
         // transfer length via T=0
-        datain[4] = dataout[len - 1];
+        datain[4] = buf[len - 1];
         memcpy(payload->data, datain, 5);
         clearCommandBuffer();
         SendCommandNG(CMD_SMART_RAW, (uint8_t *)payload, sizeof(smart_card_raw_t) + 5);
         datain[4] = 0;
-        len = smart_responseEx(dataout, maxdataoutlen, verbose);
+        len = smart_responseEx(buf, PM3_CMD_DATA_SIZE, verbose);
         if (len < 0) {
             free(payload);
+            free(buf);
             return PM3_ESOFT;
         }
     }
 
     free(payload);
+
+    if (len > maxdataoutlen) {
+        if (verbose) PrintAndLogEx(ERR, "Response too large. Got %d, expected %d", len, maxdataoutlen);
+        free(buf);
+        return PM3_EOVFLOW;
+    }
+
+    memcpy(dataout, buf, len);
+    free(buf);
     *dataoutlen = len;
     return PM3_SUCCESS;
 }
@@ -30,23 +30,149 @@
 #include "cmdlfhitag.h"         // annotate hitag
 #include "pm3_cmd.h"            // tracelog_hdr_t
 #include "cliparser.h"          // args..
+#include "util_posix.h"         // msleep
 
 static int CmdHelp(const char *Cmd);
 
 // trace pointer
 static uint8_t *gs_trace;
-static uint16_t gs_traceLen = 0;
+static uint32_t gs_traceLen = 0;
 
-static bool is_last_record(uint16_t tracepos, uint16_t traceLen) {
+static bool is_last_record(uint32_t tracepos, uint32_t traceLen) {
     return ((tracepos + TRACELOG_HDR_LEN) >= traceLen);
 }
 
-static bool next_record_is_response(uint16_t tracepos, uint8_t *trace) {
+// Record offsets of gs_trace, built on first use after a load, so a window of a big trace
+// can be listed without walking it.  Annotations of protocols whose annotators keep no state
+// are cached per record next to it.
+typedef struct {
+    bool valid;
+    char text[60];
+} trace_annot_t;
+
+static uint32_t *gs_traceIndex = NULL;
+static uint32_t gs_traceIndexCnt = 0;
+static const uint8_t *gs_traceIndexBuf = NULL;
+static uint32_t gs_traceIndexLen = 0;
+static trace_annot_t *gs_traceAnnot = NULL;
+static uint8_t gs_traceAnnotProtocol = 0;
+
+static void trace_index_reset(void) {
+    free(gs_traceIndex);
+    free(gs_traceAnnot);
+    gs_traceIndex = NULL;
+    gs_traceAnnot = NULL;
+    gs_traceIndexCnt = 0;
+    gs_traceIndexBuf = NULL;
+    gs_traceIndexLen = 0;
+}
+
+// record offsets of any trace buffer,  *index is allocated
+static bool trace_index_records(const uint8_t *trace, uint32_t len, uint32_t **index, uint32_t *count) {
+    uint32_t cnt = 0, size = 0;
+    uint32_t pos = 0;
+    *index = NULL;
+    *count = 0;
+
+    // same stop conditions as printTraceLine
+    while (is_last_record(pos, len) == false) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + pos);
+        uint32_t next = pos + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (next > len) {
+            break;
+        }
+
+        if (cnt == size) {
+            size = MAX(2 * size, 1024);
+            uint32_t *tmp = realloc(*index, size * sizeof(uint32_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(FAILED, "Cannot allocate memory for trace index");
+                free(*index);
+                *index = NULL;
+                return false;
+            }
+            *index = tmp;
+        }
+        (*index)[cnt++] = pos;
+        pos = next;
+    }
+    *count = cnt;
+    return true;
+}
+
+static bool trace_index_build(void) {
+    if (gs_traceIndex && gs_traceIndexBuf == gs_trace && gs_traceIndexLen == gs_traceLen) {
+        return true;
+    }
+    trace_index_reset();
+
+    uint32_t cnt = 0;
+    if (trace_index_records(gs_trace, gs_traceLen, &gs_traceIndex, &cnt) == false) {
+        return false;
+    }
+
+    gs_traceAnnot = calloc(MAX(cnt, 1), sizeof(trace_annot_t));
+    if (gs_traceAnnot == NULL) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace index");
+        trace_index_reset();
+        return false;
+    }
+
+    gs_traceIndexCnt = cnt;
+    gs_traceIndexBuf = gs_trace;
+    gs_traceIndexLen = gs_traceLen;
+    return true;
+}
+
+// annotation slot of a record, NULL when the protocol annotators depend on earlier records
+static trace_annot_t *trace_annot_get(uint32_t rec, uint8_t protocol, bool stateless) {
+    if (stateless == false || gs_traceAnnot == NULL || rec >= gs_traceIndexCnt) {
+        return NULL;
+    }
+
+    if (gs_traceAnnotProtocol != protocol) {
+        memset(gs_traceAnnot, 0, gs_traceIndexCnt * sizeof(trace_annot_t));
+        gs_traceAnnotProtocol = protocol;
+    }
+    return &gs_traceAnnot[rec];
+}
+
+// records of these can be annotated on their own, the others track auth or crypto state,
+// or merge frames (topaz)
+static bool trace_protocol_is_stateless(uint8_t protocol) {
+    switch (protocol) {
+        case ISO_14443B:
+        case ISO_15693:
+        case MFDES:
+        case FELICA:
+        case LEGIC:
+        case LTO:
+        case PROTO_CRYPTORF:
+        case SEOS:
+        case THINFILM:
+        case (uint8_t) -1:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// end of transmission of a record, as printTraceLine keeps it for relative times
+static uint32_t trace_record_eot(uint32_t rec, uint8_t protocol) {
+    const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[rec]);
+    uint32_t duration = hdr->duration;
+    if (protocol == ICLASS || protocol == ISO_15693) {
+        duration *= 32;
+    }
+    return hdr->timestamp + duration;
+}
+
+static bool next_record_is_response(uint32_t tracepos, uint8_t *trace) {
     const tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
     return (hdr->isResponse);
 }
 
-static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint16_t *tracepos, uint16_t traceLen,
+static bool merge_topaz_reader_frames(uint32_t timestamp, uint32_t *duration, uint32_t *tracepos, uint32_t traceLen,
                                       uint8_t *trace, const uint8_t *frame, uint8_t *topaz_reader_command, uint16_t *data_len) {
 
 #define MAX_TOPAZ_READER_CMD_LEN 16
@@ -91,9 +217,119 @@ static uint8_t calc_pos(const uint8_t *d) {
     return pos;
 }
 
+static bool trace_get_varint(const uint8_t *src, uint32_t len, uint32_t *pos, uint32_t *value) {
+    *value = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        if (*pos >= len) {
+            return false;
+        }
+        uint8_t b = src[(*pos)++];
+        *value |= (uint32_t)(b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decode a compact trace (see TRACELOG_COMPACT_*) into tracelog_hdr_t records.
+// With dst == NULL only the decoded size is computed.  Returns false on a malformed trace.
+static bool trace_decode_compact(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t *dstlen) {
+    uint32_t pos = TRACELOG_COMPACT_MAGIC_LEN;
+    uint32_t out = 0;
+    uint32_t timestamp = 0;
+
+    while (pos < len) {
+        uint8_t flags = src[pos++];
+
+        uint32_t delta = 0, duration = 0;
+        uint32_t data_len = flags & TRACELOG_COMPACT_LEN_MASK;
+        if (trace_get_varint(src, len, &pos, &delta) == false ||
+                trace_get_varint(src, len, &pos, &duration) == false) {
+            return false;
+        }
+        if (data_len == TRACELOG_COMPACT_LEN_VARINT && trace_get_varint(src, len, &pos, &data_len) == false) {
+            return false;
+        }
+        if (data_len > 0x7FFF || duration > 0xFFFF) {
+            return false;
+        }
+
+        uint8_t par_mode = flags & TRACELOG_COMPACT_PAR_MASK;
+        uint32_t num_paritybytes = (data_len == 0) ? 1 : ((data_len - 1) / 8 + 1);
+        uint32_t stored = data_len + ((par_mode == TRACELOG_COMPACT_PAR_RAW) ? num_paritybytes : 0);
+        if (stored > len - pos) {
+            return false;
+        }
+
+        timestamp += delta;
+
+        if (dst) {
+            tracelog_hdr_t *hdr = (tracelog_hdr_t *)(dst + out);
+            hdr->timestamp = timestamp;
+            hdr->duration = duration;
+            hdr->data_len = data_len;
+            hdr->isResponse = (flags & TRACELOG_COMPACT_RESPONSE) ? true : false;
+            memcpy(hdr->frame, src + pos, data_len);
+
+            uint8_t *par = hdr->frame + data_len;
+            if (par_mode == TRACELOG_COMPACT_PAR_RAW) {
+                memcpy(par, src + pos + data_len, num_paritybytes);
+            } else {
+                memset(par, 0x00, num_paritybytes);
+                if (par_mode == TRACELOG_COMPACT_PAR_ODD) {
+                    for (uint32_t i = 0; i < data_len; i++) {
+                        par[i >> 3] |= oddparity8(hdr->frame[i]) << (7 - (i & 0x07));
+                    }
+                }
+            }
+        }
+
+        pos += stored;
+        out += TRACELOG_HDR_LEN + data_len + num_paritybytes;
+    }
+
+    *dstlen = out;
+    return true;
+}
+
+// A downloaded or loaded trace in compact encoding is expanded,  everything else in the client
+// works on plain tracelog_hdr_t records.
+static void trace_expand(uint8_t **trace, uint32_t *trace_len) {
+    if (*trace == NULL || *trace_len < TRACELOG_COMPACT_MAGIC_LEN) {
+        return;
+    }
+    if (memcmp(*trace, TRACELOG_COMPACT_MAGIC, TRACELOG_COMPACT_MAGIC_LEN) != 0) {
+        return;
+    }
+
+    uint32_t len = 0;
+    if (trace_decode_compact(*trace, *trace_len, NULL, &len) == false) {
+        PrintAndLogEx(WARNING, "Compact trace is corrupt");
+        return;
+    }
+
+    uint8_t *expanded = calloc(MAX(len, 1), sizeof(uint8_t));
+    if (expanded == NULL) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace");
+        return;
+    }
+    trace_decode_compact(*trace, *trace_len, expanded, &len);
+
+    PrintAndLogEx(DEBUG, "compact trace " _YELLOW_("%u") " bytes,  expanded " _YELLOW_("%u") " bytes", *trace_len, len);
+    free(*trace);
+    *trace = expanded;
+    *trace_len = len;
+}
+
+static void trace_expand_compact(void) {
+    trace_index_reset();
+    trace_expand(&gs_trace, &gs_traceLen);
+}
+
 // Copy an existing buffer into client trace buffer
 // I think this is cleaner than further globalizing gs_trace, and may lend itself to more modularity later?
-bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len) {
+bool ImportTraceBuffer(const uint8_t *trace_src, uint32_t trace_len) {
     if (trace_len == 0 || trace_src == NULL) return (false);
     if (gs_trace) {
         free(gs_trace);
@@ -105,6 +341,7 @@ bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len) {
     }
     memcpy(gs_trace, trace_src, trace_len);
     gs_traceLen = trace_len;
+    trace_expand_compact();
     return (true);
 }
 
@@ -114,7 +351,7 @@ static uint8_t extract_epurse[8] = {0};
 
 #define SKIP_TO_NEXT(a)  (TRACELOG_HDR_LEN + (a)->data_len + TRACELOG_PARITY_LEN((a)))
 
-static uint16_t extractChall_ev2(uint16_t tracepos, uint8_t *trace, uint8_t cmdpos, uint8_t long_jmp) {
+static uint32_t extractChall_ev2(uint32_t tracepos, uint8_t *trace, uint8_t cmdpos, uint8_t long_jmp) {
     tracelog_hdr_t *next_hdr = (tracelog_hdr_t *)(trace + tracepos);
     if (next_hdr->data_len != 21) {
         return 0;
@@ -135,7 +372,7 @@ static uint16_t extractChall_ev2(uint16_t tracepos, uint8_t *trace, uint8_t cmdp
     return tracepos;
 }
 
-static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t *trace) {
+static uint32_t extractChallenges(uint32_t tracepos, uint32_t traceLen, uint8_t *trace) {
 
     // sanity check
     if (is_last_record(tracepos, traceLen)) {
@@ -404,7 +641,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
             }
             case MFDES_AUTHENTICATE_EV2F: {
                 PrintAndLogEx(INFO, "AUTH EV2 First");
-                uint16_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
+                uint32_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
                 if (tmp == 0)
                     break;
                 else
@@ -413,7 +650,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
             }
             case MFDES_AUTHENTICATE_EV2NF: {
                 PrintAndLogEx(INFO, "AUTH EV2 Non First");
-                uint16_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
+                uint32_t tmp = extractChall_ev2(tracepos, trace, pos, long_jmp);
                 if (tmp == 0)
                     break;
                 else
@@ -425,7 +662,7 @@ static uint16_t extractChallenges(uint16_t tracepos, uint16_t traceLen, uint8_t
     return tracepos;
 }
 
-static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol) {
+static uint32_t printHexLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol) {
     // sanity check
     if (is_last_record(tracepos, traceLen)) return traceLen;
 
@@ -491,56 +728,16 @@ static uint16_t printHexLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trac
     return ret;
 }
 
-static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
-                               const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
-    // sanity check
-    if (is_last_record(tracepos, traceLen)) {
-        PrintAndLogEx(DEBUG, "last record triggered.  t-pos: %u  t-len %u", tracepos, traceLen);
-        return traceLen;
-    }
-
-    uint32_t end_of_transmission_timestamp = 0;
-    uint8_t topaz_reader_command[9];
-    char explanation[60] = {0};
-    tracelog_hdr_t *first_hdr = (tracelog_hdr_t *)(trace);
-    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
-
-    uint32_t duration = hdr->duration;
-    uint16_t data_len = hdr->data_len;
-
-    if (tracepos + TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr) > traceLen) {
-        PrintAndLogEx(DEBUG, "trace pos offset %"PRIu64 " larger than reported tracelen %u",
-                      tracepos + TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr),
-                      traceLen
-                     );
-        return traceLen;
-    }
-
-    // adjust for different time scales
-    if (protocol == ICLASS || protocol == ISO_15693) {
-        duration *= 32;
-    }
-
-    uint8_t *frame = hdr->frame;
-    uint8_t *parityBytes = hdr->frame + data_len;
-
-    tracepos += TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr);
-
-    if (protocol == TOPAZ && !hdr->isResponse) {
-        // topaz reader commands come in 1 or 9 separate frames with 7 or 8 Bits each.
-        // merge them:
-        if (merge_topaz_reader_frames(hdr->timestamp, &duration, &tracepos, traceLen, trace, frame, topaz_reader_command, &data_len)) {
-            frame = topaz_reader_command;
-        }
-    }
-
-    //Check the CRC status
+//0 CRC-command, CRC not ok
+//1 CRC-command, CRC ok
+//2 Not crc-command
+static uint8_t trace_crc_status(uint8_t protocol, bool isResponse, uint8_t *frame, uint16_t data_len, const uint8_t *parityBytes) {
     uint8_t crcStatus = 2;
 
     if (data_len > 2) {
         switch (protocol) {
             case ICLASS:
-                crcStatus = iclass_CRC_check(hdr->isResponse, frame, data_len);
+                crcStatus = iclass_CRC_check(isResponse, frame, data_len);
                 break;
             case ISO_14443B:
             case TOPAZ:
@@ -551,16 +748,16 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 break;
             case PROTO_MIFARE:
             case PROTO_MFPLUS:
-                crcStatus = mifare_CRC_check(hdr->isResponse, frame, data_len);
+                crcStatus = mifare_CRC_check(isResponse, frame, data_len);
                 break;
             case ISO_14443A:
             case MFDES:
             case LTO:
             case SEOS:
-                crcStatus = iso14443A_CRC_check(hdr->isResponse, frame, data_len);
+                crcStatus = iso14443A_CRC_check(isResponse, frame, data_len);
                 break;
             case ISO_7816_4:
-                crcStatus = iso14443A_CRC_check(hdr->isResponse, frame, data_len) == 1 ? 3 : 0;
+                crcStatus = iso14443A_CRC_check(isResponse, frame, data_len) == 1 ? 3 : 0;
                 crcStatus = iso14443B_CRC_check(frame, data_len) == 1 ? 4 : crcStatus;
                 break;
             case THINFILM:
@@ -584,6 +781,123 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
                 break;
         }
     }
+    return crcStatus;
+}
+
+static void trace_annotate(char *explanation, size_t size, uint8_t protocol, bool isResponse, uint8_t *frame, uint16_t data_len, const uint8_t *parityBytes,
+                           const uint64_t *mfDicKeys, uint32_t mfDicKeysCount) {
+    // Always annotate these protocols both reader/tag messages
+    switch (protocol) {
+        case ISO_14443A:
+        case ISO_7816_4:
+            annotateIso14443a(explanation, size, frame, data_len, isResponse);
+            break;
+        case PROTO_MIFARE:
+        case PROTO_MFPLUS:
+            annotateMifare(explanation, size, frame, data_len, parityBytes, (data_len - 1) / 8 + 1, isResponse);
+            break;
+        case PROTO_HITAG1:
+            annotateHitag1(explanation, size, frame, data_len, isResponse);
+            break;
+        case PROTO_HITAG2:
+            annotateHitag2(explanation, size, frame, data_len, parityBytes[0], isResponse, mfDicKeys, mfDicKeysCount, false);
+            break;
+        case PROTO_HITAGS:
+            annotateHitagS(explanation, size, frame, data_len, isResponse);
+            break;
+        case ICLASS:
+            annotateIclass(explanation, size, frame, data_len, isResponse);
+            break;
+        default:
+            break;
+    }
+
+    if (isResponse == false) {
+        switch (protocol) {
+            case LEGIC:
+                annotateLegic(explanation, size, frame, data_len);
+                break;
+            case MFDES:
+                annotateMfDesfire(explanation, size, frame, data_len);
+                break;
+            case PROTO_MFPLUS:
+                annotateMfPlus(explanation, size, frame, data_len);
+                break;
+            case ISO_14443B:
+                annotateIso14443b(explanation, size, frame, data_len);
+                break;
+            case TOPAZ:
+                annotateTopaz(explanation, size, frame, data_len);
+                break;
+            case ISO_7816_4:
+                annotateIso7816(explanation, size, frame, data_len);
+                break;
+            case ISO_15693:
+                annotateIso15693(explanation, size, frame, data_len);
+                break;
+            case FELICA:
+                annotateFelica(explanation, size, frame, data_len);
+                break;
+            case LTO:
+                annotateLTO(explanation, size, frame, data_len);
+                break;
+            case PROTO_CRYPTORF:
+                annotateCryptoRF(explanation, size, frame, data_len);
+                break;
+            case SEOS:
+                annotateSeos(explanation, size, frame, data_len);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static uint32_t printTraceLine(uint32_t tracepos, uint32_t traceLen, uint8_t *trace, uint8_t protocol, bool showWaitCycles, bool markCRCBytes, uint32_t *prev_eot, bool use_us,
+                               const uint64_t *mfDicKeys, uint32_t mfDicKeysCount, trace_annot_t *annot) {
+    // sanity check
+    if (is_last_record(tracepos, traceLen)) {
+        PrintAndLogEx(DEBUG, "last record triggered.  t-pos: %u  t-len %u", tracepos, traceLen);
+        return traceLen;
+    }
+
+    uint32_t end_of_transmission_timestamp = 0;
+    uint8_t topaz_reader_command[9];
+    char explanation[60] = {0};
+    tracelog_hdr_t *first_hdr = (tracelog_hdr_t *)(trace);
+    tracelog_hdr_t *hdr = (tracelog_hdr_t *)(trace + tracepos);
+
+    uint32_t duration = hdr->duration;
+    uint16_t data_len = hdr->data_len;
+
+    if (tracepos + TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr) > traceLen) {
+        PrintAndLogEx(DEBUG, "trace pos offset %"PRIu64 " larger than reported tracelen %u",
+                      tracepos + TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr),
+                      traceLen
+                     );
+        return traceLen;
+    }
+
+    // adjust for different time scales
+    if (protocol == ICLASS || protocol == ISO_15693) {
+        duration *= 32;
+    }
+
+    uint8_t *frame = hdr->frame;
+    uint8_t *parityBytes = hdr->frame + data_len;
+
+    tracepos += TRACELOG_HDR_LEN + data_len + TRACELOG_PARITY_LEN(hdr);
+
+    if (protocol == TOPAZ && !hdr->isResponse) {
+        // topaz reader commands come in 1 or 9 separate frames with 7 or 8 Bits each.
+        // merge them:
+        if (merge_topaz_reader_frames(hdr->timestamp, &duration, &tracepos, traceLen, trace, frame, topaz_reader_command, &data_len)) {
+            frame = topaz_reader_command;
+        }
+    }
+
+    //Check the CRC status
+    uint8_t crcStatus = trace_crc_status(protocol, hdr->isResponse, frame, data_len, parityBytes);
     //0 CRC-command, CRC not ok
     //1 CRC-command, CRC ok
     //2 Not crc-command
@@ -775,72 +1089,20 @@ static uint16_t printTraceLine(uint16_t tracepos, uint16_t traceLen, uint8_t *tr
         *prev_eot = end_of_transmission_timestamp;
     }
 
-    // Always annotate these protocols both reader/tag messages
-    switch (protocol) {
-        case ISO_14443A:
-        case ISO_7816_4:
-            annotateIso14443a(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
-        case PROTO_MIFARE:
-        case PROTO_MFPLUS:
-            annotateMifare(explanation, sizeof(explanation), frame, data_len, parityBytes, TRACELOG_PARITY_LEN(hdr), hdr->isResponse);
-            break;
-        case PROTO_HITAG1:
-            annotateHitag1(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
-        case PROTO_HITAG2:
-            annotateHitag2(explanation, sizeof(explanation), frame, data_len, parityBytes[0], hdr->isResponse, mfDicKeys, mfDicKeysCount, false);
-            break;
-        case PROTO_HITAGS:
-            annotateHitagS(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
-        case ICLASS:
-            annotateIclass(explanation, sizeof(explanation), frame, data_len, hdr->isResponse);
-            break;
-        default:
-            break;
+    if (annot && annot->valid) {
+        memcpy(explanation, annot->text, sizeof(explanation));
+        goto annotated;
     }
 
-    if (hdr->isResponse == false) {
-        switch (protocol) {
-            case LEGIC:
-                annotateLegic(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case MFDES:
-                annotateMfDesfire(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case PROTO_MFPLUS:
-                annotateMfPlus(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case ISO_14443B:
-                annotateIso14443b(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case TOPAZ:
-                annotateTopaz(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case ISO_7816_4:
-                annotateIso7816(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case ISO_15693:
-                annotateIso15693(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case FELICA:
-                annotateFelica(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case LTO:
-                annotateLTO(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case PROTO_CRYPTORF:
-                annotateCryptoRF(explanation, sizeof(explanation), frame, data_len);
-                break;
-            case SEOS:
-                annotateSeos(explanation, sizeof(explanation), frame, data_len);
-                break;
-            default:
-                break;
-        }
+    trace_annotate(explanation, sizeof(explanation), protocol, hdr->isResponse, frame, data_len, parityBytes, mfDicKeys, mfDicKeysCount);
+
+    if (annot) {
+        memcpy(annot->text, explanation, sizeof(annot->text));
+        annot->valid = true;
     }
 
+annotated:
+    ;
     int str_padder = 72;
     int num_lines = MIN((data_len - 1) / TRACE_MAX_HEX_BYTES + 1, TRACE_MAX_HEX_BYTES);
 
@@ -1116,6 +1378,7 @@ static int download_trace(void) {
             return PM3_ETIMEOUT;
         }
     }
+    trace_expand_compact();
     return PM3_SUCCESS;
 }
 
@@ -1162,7 +1425,7 @@ static int CmdTraceExtract(const char *Cmd) {
         return PM3_SUCCESS;
     }
 
-    uint16_t tracepos = 0;
+    uint32_t tracepos = 0;
 
     while (tracepos < gs_traceLen) {
         tracepos = extractChallenges(tracepos, gs_traceLen, gs_trace);
@@ -1208,43 +1471,1525 @@ static int CmdTraceLoad(const char *Cmd) {
     }
 
     gs_traceLen = (long)len;
+    trace_expand_compact();
 
     PrintAndLogEx(SUCCESS, "Recorded Activity (TraceLen = " _YELLOW_("%u") " bytes)", gs_traceLen);
     PrintAndLogEx(HINT, "try " _YELLOW_("`trace list -1 -t ...`") " to view trace.  Remember the " _YELLOW_("`-1`") " param");
     return PM3_SUCCESS;
 }
 
-static int CmdTraceSave(const char *Cmd) {
-
-    CLIParserContext *ctx;
-    CLIParserInit(&ctx, "trace save",
+// protocol of a `-t` name, empty is raw
+static int trace_protocol_from_str(const char *type, uint8_t *protocol) {
+    if (strcmp(type, "14a") == 0)           *protocol = ISO_14443A;
+    else if (strcmp(type, "14b") == 0)      *protocol = ISO_14443B;
+    else if (strcmp(type, "15") == 0)       *protocol = ISO_15693;
+    else if (strcmp(type, "7816") == 0)     *protocol = ISO_7816_4;
+    else if (strcmp(type, "cryptorf") == 0) *protocol = PROTO_CRYPTORF;
+    else if (strcmp(type, "des") == 0)      *protocol = MFDES;
+    else if (strcmp(type, "felica") == 0)   *protocol = FELICA;
+    else if (strcmp(type, "hitag1") == 0)   *protocol = PROTO_HITAG1;
+    else if (strcmp(type, "hitag2") == 0)   *protocol = PROTO_HITAG2;
+    else if (strcmp(type, "hitags") == 0)   *protocol = PROTO_HITAGS;
+    else if (strcmp(type, "iclass") == 0)   *protocol = ICLASS;
+    else if (strcmp(type, "legic") == 0)    *protocol = LEGIC;
+    else if (strcmp(type, "lto") == 0)      *protocol = LTO;
+    else if (strcmp(type, "mf") == 0)       *protocol = PROTO_MIFARE;
+    else if (strcmp(type, "raw") == 0)      *protocol = -1;
+    else if (strcmp(type, "seos") == 0)     *protocol = SEOS;
+    else if (strcmp(type, "thinfilm") == 0) *protocol = THINFILM;
+    else if (strcmp(type, "topaz") == 0)    *protocol = TOPAZ;
+    else if (strcmp(type, "mfp") == 0)      *protocol = PROTO_MFPLUS;
+    else if (strcmp(type, "") == 0)         *protocol = -1;
+    else {
+        PrintAndLogEx(FAILED, "Unknown protocol \"%s\"", type);
+        return PM3_EINVARG;
+    }
+    return PM3_SUCCESS;
+}
+
+// clean annotation state before a trace is walked from the start
+static void trace_reset_annotators(uint8_t protocol) {
+    // clean authentication data used with the mifare classic decrypt fct
+    if (protocol == ISO_14443A || protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS) {
+        ClearAuthData();
+        ClearAuthKeyCache();
+    }
+
+    // reset hitag state  machine
+    if (protocol == PROTO_HITAG1 || protocol == PROTO_HITAG2 || protocol == PROTO_HITAGS) {
+        annotateHitag2_init();
+    }
+}
+
+// one record per trace entry, the trace can be a lot bigger than a json tree of it should be
+static int trace_save_json(const char *filename) {
+    json_stream_t js;
+    int res = JsonStreamOpen(&js, filename, false, true, false);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    JsonStreamAdd(&js, "Created", json_string("proxmark3"));
+    JsonStreamAdd(&js, "FileType", json_string("trace"));
+    JsonStreamAdd(&js, "TraceLen", json_integer(gs_traceLen));
+    JsonStreamBegin(&js, "records", true);
+
+    uint32_t tracepos = 0;
+    while (res == PM3_SUCCESS && tracepos + TRACELOG_HDR_LEN <= gs_traceLen) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
+        if (hdr->data_len == 0 || tracepos + SKIP_TO_NEXT(hdr) > gs_traceLen) {
+            break;
+        }
+
+        // parity is never longer than the data
+        char data[hdr->data_len * 2 + 1];
+        json_t *rec = json_object();
+        json_object_set_new(rec, "timestamp", json_integer(hdr->timestamp));
+        json_object_set_new(rec, "duration", json_integer(hdr->duration));
+        json_object_set_new(rec, "src", json_string(hdr->isResponse ? "tag" : "reader"));
+        memset(data, 0, sizeof(data));
+        hex_to_buffer((uint8_t *)data, hdr->frame, hdr->data_len, hdr->data_len, 0, 0, true);
+        json_object_set_new(rec, "data", json_string(data));
+        memset(data, 0, sizeof(data));
+        hex_to_buffer((uint8_t *)data, hdr->frame + hdr->data_len, TRACELOG_PARITY_LEN(hdr), hdr->data_len, 0, 0, true);
+        json_object_set_new(rec, "parity", json_string(data));
+        res = JsonStreamAdd(&js, NULL, rec);
+
+        tracepos += SKIP_TO_NEXT(hdr);
+    }
+
+    int cres = JsonStreamClose(&js);
+    return (res != PM3_SUCCESS) ? res : cres;
+}
+
+// pcap-ng export,  https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-02.html
+//
+// One section with one interface per file,  records become enhanced packet blocks with
+// nanosecond timestamps and the direction in epb_flags.  ISO14443 A/B frames use
+// LINKTYPE_ISO_14443 (264) and its 4 byte pseudo header,  https://www.kaiser.cx/pcap-iso14443.html
+// Wireshark has no link type for the others,  they are raw frames as DLT_USER 1 (15693 / iCLASS),
+// DLT_USER 2 (FeliCa) and DLT_USER 0 (everything else).
+#define PCAPNG_SHB              0x0A0D0D0A
+#define PCAPNG_IDB              0x00000001
+#define PCAPNG_EPB              0x00000006
+#define PCAPNG_BYTE_ORDER       0x1A2B3C4D
+
+#define PCAP_LINKTYPE_USER0     147
+#define PCAP_LINKTYPE_USER1     148
+#define PCAP_LINKTYPE_USER2     149
+#define PCAP_LINKTYPE_ISO_14443 264
+
+#define PCAP_ISO14443_PCD       0xFE
+#define PCAP_ISO14443_PICC      0xFF
+
+#define PCAP_WRITE_BUFFER       (256 * 1024)
+
+typedef struct {
+    FILE *f;
+    char *buf;
+    uint16_t linktype;
+    // trace tick in nanoseconds,  as a fraction
+    uint32_t tick_num;
+    uint32_t tick_den;
+    uint64_t epoch;
+    uint32_t last_ts;
+    uint32_t pos;
+    uint32_t packets;
+    bool error;
+} trace_pcap_t;
+
+static uint16_t trace_pcap_linktype(uint8_t protocol) {
+    switch (protocol) {
+        case ISO_14443A:
+        case ISO_14443B:
+        case ISO_7816_4:
+        case PROTO_MIFARE:
+        case PROTO_MFPLUS:
+        case MFDES:
+        case TOPAZ:
+        case PROTO_CRYPTORF:
+        case SEOS:
+            return PCAP_LINKTYPE_ISO_14443;
+        case ISO_15693:
+        case ICLASS:
+            return PCAP_LINKTYPE_USER1;
+        case FELICA:
+            return PCAP_LINKTYPE_USER2;
+        default:
+            return PCAP_LINKTYPE_USER0;
+    }
+}
+
+// see trace_print_legend
+static void trace_pcap_tick(trace_pcap_t *p, uint8_t protocol) {
+    switch (protocol) {
+        case PROTO_HITAG1:
+        case PROTO_HITAG2:
+        case PROTO_HITAGS:
+            // ETU of 8 us
+            p->tick_num = 8000;
+            p->tick_den = 1;
+            break;
+        case LEGIC:
+            // 1.5 ticks per us
+            p->tick_num = 2000;
+            p->tick_den = 3;
+            break;
+        case ISO_7816_4:
+        case (uint8_t) -1:
+            // no time base,  take 1 us
+            p->tick_num = 1000;
+            p->tick_den = 1;
+            break;
+        default:
+            // 1 / 13.56 MHz
+            p->tick_num = 25000;
+            p->tick_den = 339;
+            break;
+    }
+}
+
+static void trace_pcap_block(trace_pcap_t *p, uint32_t type, const void *body, uint32_t body_len, const void *data, uint32_t data_len, const void *opts, uint32_t opts_len) {
+    static const uint8_t pad[4] = {0};
+    uint32_t data_pad = (4 - (data_len % 4)) % 4;
+    uint32_t total = 12 + body_len + data_len + data_pad + opts_len;
+
+    bool ok = fwrite(&type, 4, 1, p->f) == 1
+              && fwrite(&total, 4, 1, p->f) == 1
+              && (body_len == 0 || fwrite(body, body_len, 1, p->f) == 1)
+              && (data_len == 0 || fwrite(data, data_len, 1, p->f) == 1)
+              && (data_pad == 0 || fwrite(pad, data_pad, 1, p->f) == 1)
+              && (opts_len == 0 || fwrite(opts, opts_len, 1, p->f) == 1)
+              && fwrite(&total, 4, 1, p->f) == 1;
+    if (ok == false) {
+        p->error = true;
+    }
+}
+
+// one option,  value padded to 32 bits.  Returns the bytes written to opts
+static uint32_t trace_pcap_opt(uint8_t *opts, uint16_t code, const void *value, uint16_t len) {
+    memcpy(opts, &code, 2);
+    memcpy(opts + 2, &len, 2);
+    memcpy(opts + 4, value, len);
+    uint32_t padded = (len + 3) & ~3u;
+    memset(opts + 4 + len, 0, padded - len);
+    return 4 + padded;
+}
+
+static int trace_pcap_open(trace_pcap_t *p, const char *filename, uint8_t protocol) {
+    memset(p, 0, sizeof(trace_pcap_t));
+    p->f = fopen(filename, "wb");
+    if (p->f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", filename);
+        return PM3_EFILE;
+    }
+    p->buf = malloc(PCAP_WRITE_BUFFER);
+    if (p->buf) {
+        setvbuf(p->f, p->buf, _IOFBF, PCAP_WRITE_BUFFER);
+    }
+    p->linktype = trace_pcap_linktype(protocol);
+    trace_pcap_tick(p, protocol);
+
+    uint8_t opts[64];
+    uint32_t olen;
+
+    // section header,  length unknown
+    struct {
+        uint32_t byte_order;
+        uint16_t major;
+        uint16_t minor;
+        int64_t section_len;
+    } PACKED shb = { PCAPNG_BYTE_ORDER, 1, 0, -1 };
+    olen = trace_pcap_opt(opts, 4, "proxmark3", 9);              // shb_userappl
+    olen += trace_pcap_opt(opts + olen, 0, NULL, 0);            // opt_endofopt
+    trace_pcap_block(p, PCAPNG_SHB, &shb, sizeof(shb), NULL, 0, opts, olen);
+
+    struct {
+        uint16_t linktype;
+        uint16_t reserved;
+        uint32_t snaplen;
+    } PACKED idb = { p->linktype, 0, 0 };
+    uint8_t tsresol = 9;
+    olen = trace_pcap_opt(opts, 2, "proxmark3", 9);              // if_name
+    olen += trace_pcap_opt(opts + olen, 9, &tsresol, 1);        // if_tsresol, nanoseconds
+    olen += trace_pcap_opt(opts + olen, 0, NULL, 0);
+    trace_pcap_block(p, PCAPNG_IDB, &idb, sizeof(idb), NULL, 0, opts, olen);
+
+    return (p->error) ? PM3_EFILE : PM3_SUCCESS;
+}
+
+// write the complete records of trace from p->pos on,  a partly received one is left for the next call
+static int trace_pcap_write(trace_pcap_t *p, const uint8_t *trace, uint32_t trace_len) {
+    bool written = false;
+    while (p->error == false && is_last_record(p->pos, trace_len) == false) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(trace + p->pos);
+        uint32_t next = p->pos + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (next > trace_len) {
+            break;
+        }
+        p->pos = next;
+        written = true;
+
+        // 32 bit ticks wrap on long captures
+        if (p->packets && hdr->timestamp < p->last_ts && p->last_ts - hdr->timestamp > 0x80000000) {
+            p->epoch += 0x100000000ULL;
+        }
+        p->last_ts = hdr->timestamp;
+        uint64_t ns = ((p->epoch + hdr->timestamp) * p->tick_num) / p->tick_den;
+
+        uint8_t pseudo[4];
+        uint32_t pseudo_len = 0;
+        if (p->linktype == PCAP_LINKTYPE_ISO_14443) {
+            pseudo[0] = 0;
+            pseudo[1] = (hdr->isResponse) ? PCAP_ISO14443_PICC : PCAP_ISO14443_PCD;
+            pseudo[2] = hdr->data_len >> 8;
+            pseudo[3] = hdr->data_len & 0xFF;
+            pseudo_len = sizeof(pseudo);
+        }
+
+        uint32_t caplen = pseudo_len + hdr->data_len;
+        uint8_t packet[4 + UINT16_MAX];
+        memcpy(packet, pseudo, pseudo_len);
+        memcpy(packet + pseudo_len, hdr->frame, hdr->data_len);
+
+        struct {
+            uint32_t interface;
+            uint32_t ts_high;
+            uint32_t ts_low;
+            uint32_t caplen;
+            uint32_t len;
+        } PACKED epb = { 0, (uint32_t)(ns >> 32), (uint32_t)ns, caplen, caplen };
+
+        // epb_flags direction,  1 inbound (tag),  2 outbound (reader)
+        uint8_t opts[16];
+        uint32_t flags = (hdr->isResponse) ? 1 : 2;
+        uint32_t olen = trace_pcap_opt(opts, 2, &flags, 4);
+        olen += trace_pcap_opt(opts + olen, 0, NULL, 0);
+        trace_pcap_block(p, PCAPNG_EPB, &epb, sizeof(epb), packet, caplen, opts, olen);
+        p->packets++;
+    }
+
+    if (written && p->error == false && fflush(p->f) != 0) {
+        p->error = true;
+    }
+    return (p->error) ? PM3_EFILE : PM3_SUCCESS;
+}
+
+static int trace_pcap_close(trace_pcap_t *p) {
+    int res = PM3_SUCCESS;
+    if (p->f && fclose(p->f) != 0) {
+        res = PM3_EFILE;
+    }
+    free(p->buf);
+    p->f = NULL;
+    p->buf = NULL;
+    return (p->error) ? PM3_EFILE : res;
+}
+
+static int trace_save_pcap(const char *filename, uint8_t protocol) {
+    char *fn = newfilenamemcopy(filename, ".pcapng");
+    if (fn == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    trace_pcap_t p;
+    int res = trace_pcap_open(&p, fn, protocol);
+    if (res == PM3_SUCCESS) {
+        res = trace_pcap_write(&p, gs_trace, gs_traceLen);
+    }
+    int cres = trace_pcap_close(&p);
+    if (res == PM3_SUCCESS) {
+        res = cres;
+    }
+
+    if (res == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " packets to pcap-ng file `" _YELLOW_("%s") "`", p.packets, fn);
+    } else {
+        PrintAndLogEx(FAILED, "Failed to write `" _YELLOW_("%s") "`", fn);
+    }
+    free(fn);
+    return res;
+}
+
+// Columnar export for data tools,  see tools/pm3_tracecol.py
+//
+// A file header followed by row groups of up to TRACE_COL_GROUP records, so it is written
+// as the trace is walked.  Each group header is followed by its columns, every one padded
+// to 8 bytes, little endian:
+//   timestamp     u32[rows]
+//   duration      u32[rows]      same time scale as timestamp
+//   is_response   u8[rows]
+//   crc           u8[rows]       0 bad,  1 ok,  2 none,  3 / 4 ok as 14a / 14b (7816)
+//   data_offset   u32[rows + 1]  into data,  as Arrow variable length columns
+//   data          u8[data_size]
+//   annot_offset  u32[rows + 1]  into annot
+//   annot         u8[annot_size] annotation text, no color codes
+#define TRACE_COL_MAGIC     "PM3C"
+#define TRACE_COL_GMAGIC    "PM3G"
+#define TRACE_COL_VERSION   1
+#define TRACE_COL_GROUP     4096
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t protocol;
+    uint16_t rfu;
+    uint32_t groups;    // 0 when it couldn't be patched in,  read to the end of file
+    uint32_t rows;
+} PACKED trace_col_header_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t rows;
+    uint32_t data_size;
+    uint32_t annot_size;
+} PACKED trace_col_group_t;
+
+typedef struct {
+    uint32_t rows;
+    uint32_t timestamp[TRACE_COL_GROUP];
+    uint32_t duration[TRACE_COL_GROUP];
+    uint8_t is_response[TRACE_COL_GROUP];
+    uint8_t crc[TRACE_COL_GROUP];
+    uint32_t data_offset[TRACE_COL_GROUP + 1];
+    uint32_t annot_offset[TRACE_COL_GROUP + 1];
+    uint8_t *data;
+    uint32_t data_size;
+    uint32_t data_cap;
+    char *annot;
+    uint32_t annot_size;
+    uint32_t annot_cap;
+} trace_col_t;
+
+static bool trace_col_append(uint8_t **buf, uint32_t *size, uint32_t *cap, const void *src, uint32_t len) {
+    if (*size + len > *cap) {
+        uint32_t new_cap = MAX(2 * *cap, *size + len + 1024);
+        uint8_t *tmp = realloc(*buf, new_cap);
+        if (tmp == NULL) {
+            return false;
+        }
+        *buf = tmp;
+        *cap = new_cap;
+    }
+    memcpy(*buf + *size, src, len);
+    *size += len;
+    return true;
+}
+
+static bool trace_col_write(FILE *f, const void *col, size_t len) {
+    static const uint8_t pad[8] = {0};
+    return fwrite(col, 1, len, f) == len && fwrite(pad, 1, (8 - (len % 8)) % 8, f) == (8 - (len % 8)) % 8;
+}
+
+static bool trace_col_flush(FILE *f, trace_col_t *c) {
+    if (c->rows == 0) {
+        return true;
+    }
+
+    trace_col_group_t g = {
+        .magic = TRACE_COL_GMAGIC,
+        .rows = c->rows,
+        .data_size = c->data_size,
+        .annot_size = c->annot_size,
+    };
+    bool ok = fwrite(&g, sizeof(g), 1, f) == 1
+              && trace_col_write(f, c->timestamp, c->rows * sizeof(uint32_t))
+              && trace_col_write(f, c->duration, c->rows * sizeof(uint32_t))
+              && trace_col_write(f, c->is_response, c->rows)
+              && trace_col_write(f, c->crc, c->rows)
+              && trace_col_write(f, c->data_offset, (c->rows + 1) * sizeof(uint32_t))
+              && trace_col_write(f, c->data, c->data_size)
+              && trace_col_write(f, c->annot_offset, (c->rows + 1) * sizeof(uint32_t))
+              && trace_col_write(f, c->annot, c->annot_size);
+
+    c->rows = 0;
+    c->data_size = 0;
+    c->annot_size = 0;
+    return ok;
+}
+
+// annotations carry ansi color codes for the console
+static uint32_t trace_strip_colors(char *s) {
+    char *out = s;
+    for (char *p = s; *p; p++) {
+        if (*p == '\x1b' && p[1] == '[') {
+            p += 2;
+            while (*p && (*p < '@' || *p > '~')) {
+                p++;
+            }
+            if (*p == '\0') {
+                break;
+            }
+            continue;
+        }
+        *out++ = *p;
+    }
+    *out = '\0';
+    return out - s;
+}
+
+static int trace_save_columns(const char *filename, uint8_t protocol) {
+
+    char *fn = newfilenamemcopy(filename, ".pm3col");
+    if (fn == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    FILE *f = fopen(fn, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+        free(fn);
+        return PM3_EFILE;
+    }
+
+    trace_col_t *c = calloc(1, sizeof(trace_col_t));
+    if (c == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        fclose(f);
+        free(fn);
+        return PM3_EMALLOC;
+    }
+
+    trace_col_header_t fh = {
+        .magic = TRACE_COL_MAGIC,
+        .version = TRACE_COL_VERSION,
+        .protocol = protocol,
+    };
+    bool ok = fwrite(&fh, sizeof(fh), 1, f) == 1;
+
+    const uint64_t *dicKeys = NULL;
+    uint32_t dicKeysCount = 0;
+    if (protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS) {
+        dicKeys = g_mifare_default_keys;
+        dicKeysCount = ARRAYLEN(g_mifare_default_keys);
+    }
+
+    // the annotators are shared with trace list and some of them print,  keep them quiet
+    uint8_t old_printAndLog = g_printAndLog;
+    g_printAndLog = 0;
+    trace_reset_annotators(protocol);
+
+    uint32_t tracepos = 0;
+    while (ok && is_last_record(tracepos, gs_traceLen) == false) {
+        tracelog_hdr_t *hdr = (tracelog_hdr_t *)(gs_trace + tracepos);
+        if (tracepos + SKIP_TO_NEXT(hdr) > gs_traceLen) {
+            break;
+        }
+
+        uint16_t data_len = hdr->data_len;
+        uint8_t *parityBytes = hdr->frame + data_len;
+        uint32_t duration = hdr->duration;
+        if (protocol == ICLASS || protocol == ISO_15693) {
+            duration *= 32;
+        }
+
+        char explanation[60] = {0};
+        uint8_t crc = 2;
+        if (protocol != (uint8_t) -1) {
+            crc = trace_crc_status(protocol, hdr->isResponse, hdr->frame, data_len, parityBytes);
+            trace_annotate(explanation, sizeof(explanation), protocol, hdr->isResponse, hdr->frame, data_len, parityBytes, dicKeys, dicKeysCount);
+        }
+
+        // decrypted crypto1 frames are annotated from the plain text
+        if (protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS) {
+            uint8_t mfData[32] = {0};
+            size_t mfDataLen = 0;
+            if (DecodeMifareData(hdr->frame, data_len, parityBytes, hdr->isResponse, mfData, &mfDataLen, dicKeys, dicKeysCount)) {
+                memset(explanation, 0x00, sizeof(explanation));
+                if (protocol == PROTO_MFPLUS) {
+                    annotateMfPlus(explanation, sizeof(explanation), mfData, mfDataLen);
+                } else {
+                    annotateIso14443a(explanation, sizeof(explanation), mfData, mfDataLen, hdr->isResponse);
+                }
+            }
+        }
+
+        uint32_t row = c->rows;
+        c->timestamp[row] = hdr->timestamp;
+        c->duration[row] = duration;
+        c->is_response[row] = hdr->isResponse;
+        c->crc[row] = crc;
+        c->data_offset[row] = c->data_size;
+        c->annot_offset[row] = c->annot_size;
+        ok = trace_col_append(&c->data, &c->data_size, &c->data_cap, hdr->frame, data_len)
+             && trace_col_append((uint8_t **)&c->annot, &c->annot_size, &c->annot_cap, explanation, trace_strip_colors(explanation));
+        c->rows++;
+        c->data_offset[c->rows] = c->data_size;
+        c->annot_offset[c->rows] = c->annot_size;
+        fh.rows++;
+
+        if (ok && c->rows == TRACE_COL_GROUP) {
+            ok = trace_col_flush(f, c);
+            fh.groups++;
+        }
+
+        tracepos += SKIP_TO_NEXT(hdr);
+    }
+
+    if (ok && c->rows) {
+        ok = trace_col_flush(f, c);
+        fh.groups++;
+    }
+
+    g_printAndLog = old_printAndLog;
+
+    // counts are for readers that want to size their arrays up front,  not there on a pipe
+    if (ok && fseek(f, 0, SEEK_SET) == 0) {
+        ok = fwrite(&fh, sizeof(fh), 1, f) == 1;
+    }
+    if (fclose(f) != 0) {
+        ok = false;
+    }
+
+    if (ok) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " records to columns file `" _YELLOW_("%s") "`", fh.rows, fn);
+    } else {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", fn);
+    }
+
+    free(c->data);
+    free(c->annot);
+    free(c);
+    free(fn);
+    return (ok) ? PM3_SUCCESS : PM3_EFILE;
+}
+
+static int CmdTraceSave(const char *Cmd) {
+
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "trace save",
                   "Save protocol data from trace buffer to binary file\n"
-                  "File extension is <.trace>",
-                  "trace save -f mytracefile    -> w/o file extension"
+                  "File extension is <.trace>, <.json> with --json, <.pm3col> with --col or <.pcapng> with --pcap\n"
+                  "--col writes timestamp, duration, direction, data, CRC status and annotation as columns,\n"
+                  "see tools/pm3_tracecol.py to load them\n"
+                  "--pcap writes a Wireshark capture,  ISO14443 A/B as link type 264.  15693 / iCLASS are DLT_USER 1,\n"
+                  "FeliCa DLT_USER 2 and the others DLT_USER 0,  to be mapped to a dissector in Wireshark",
+                  "trace save -f mytracefile          -> w/o file extension\n"
+                  "trace save -f mytracefile --json   -> one json record per frame\n"
+                  "trace save -f mytracefile --col -t 14a   -> columns, annotated as ISO14443-A\n"
+                  "trace save -f mytracefile --pcap -t 14a  -> pcap-ng with ISO14443-A timing"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1("f", "file", "<fn>", "Specify trace file to save"),
+        arg_lit0("j", "json", "save as JSON"),
+        arg_lit0(NULL, "col", "save as columns (.pm3col)"),
+        arg_str0("t", "type", NULL, "protocol to annotate the columns with, or of the pcap-ng link type, see `trace list -h`"),
+        arg_lit0(NULL, "pcap", "save as pcap-ng (.pcapng)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool use_json = arg_get_lit(ctx, 2);
+    bool use_col = arg_get_lit(ctx, 3);
+
+    int tlen = 0;
+    char type[10] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)type, sizeof(type), &tlen);
+    str_lower(type);
+    bool use_pcap = arg_get_lit(ctx, 5);
+    CLIParserFree(ctx);
+
+    if (use_json + use_col + use_pcap > 1) {
+        PrintAndLogEx(WARNING, "select only one of " _YELLOW_("--json --col --pcap"));
+        return PM3_EINVARG;
+    }
+
+    uint8_t protocol = -1;
+    if (trace_protocol_from_str(type, &protocol) != PM3_SUCCESS) {
+        return PM3_EINVARG;
+    }
+
+    if (gs_traceLen == 0) {
+        download_trace();
+        if (gs_traceLen == 0) {
+            PrintAndLogEx(WARNING, "trace is empty, nothing to save");
+            return PM3_SUCCESS;
+        }
+    }
+
+    if (use_json) {
+        return trace_save_json(filename);
+    }
+
+    if (use_col) {
+        return trace_save_columns(filename, protocol);
+    }
+
+    if (use_pcap) {
+        return trace_save_pcap(filename, protocol);
+    }
+
+    saveFile(filename, ".trace", gs_trace, gs_traceLen);
+    return PM3_SUCCESS;
+}
+
+#define TRACE_STATS_MAX_CMDS    64
+#define TRACE_STATS_NAME_LEN    24
+
+typedef struct {
+    char name[TRACE_STATS_NAME_LEN];
+    uint32_t count;
+    uint32_t answered;
+    uint32_t retries;
+    uint32_t crc_bad;
+} trace_stats_cmd_t;
+
+typedef struct {
+    uint32_t *v;
+    uint32_t count;
+    uint32_t size;
+} trace_stats_times_t;
+
+static bool trace_stats_times_add(trace_stats_times_t *t, uint32_t value) {
+    if (t->count == t->size) {
+        uint32_t size = MAX(2 * t->size, 1024);
+        uint32_t *tmp = realloc(t->v, size * sizeof(uint32_t));
+        if (tmp == NULL) {
+            return false;
+        }
+        t->v = tmp;
+        t->size = size;
+    }
+    t->v[t->count++] = value;
+    return true;
+}
+
+static int trace_stats_cmp(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest rank,  v is sorted
+static uint32_t trace_stats_percentile(const trace_stats_times_t *t, uint8_t p) {
+    if (t->count == 0) {
+        return 0;
+    }
+    uint32_t rank = (uint32_t)(((uint64_t)p * t->count + 99) / 100);
+    return t->v[MAX(rank, 1) - 1];
+}
+
+// command name of a reader frame,  the annotation up to its arguments or the first byte
+static void trace_stats_name(char *name, const char *explanation, const uint8_t *frame, uint16_t data_len) {
+    size_t n = strcspn(explanation, " (:-");
+    // keep AUTH-A / AUTH-B apart
+    if (explanation[n] == '-' && explanation[n + 1] && explanation[n + 1] != ' ') {
+        n += 1 + strcspn(explanation + n + 1, " (:");
+    }
+    if (n) {
+        snprintf(name, TRACE_STATS_NAME_LEN, "%.*s", (int)n, explanation);
+    } else if (data_len) {
+        snprintf(name, TRACE_STATS_NAME_LEN, "0x%02X", frame[0]);
+    } else {
+        snprintf(name, TRACE_STATS_NAME_LEN, "(empty)");
+    }
+}
+
+static trace_stats_cmd_t *trace_stats_cmd(trace_stats_cmd_t *cmds, uint8_t *ncmds, const char *name) {
+    for (uint8_t i = 0; i < *ncmds; i++) {
+        if (strcmp(cmds[i].name, name) == 0) {
+            return &cmds[i];
+        }
+    }
+    // table full,  count the rest together
+    if (*ncmds == TRACE_STATS_MAX_CMDS - 1) {
+        name = "(other)";
+        for (uint8_t i = 0; i < *ncmds; i++) {
+            if (strcmp(cmds[i].name, name) == 0) {
+                return &cmds[i];
+            }
+        }
+    }
+    trace_stats_cmd_t *c = &cmds[(*ncmds)++];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    return c;
+}
+
+static int trace_stats_cmd_cmp(const void *a, const void *b) {
+    const trace_stats_cmd_t *x = (const trace_stats_cmd_t *)a;
+    const trace_stats_cmd_t *y = (const trace_stats_cmd_t *)b;
+    return (y->count > x->count) - (y->count < x->count);
+}
+
+static json_t *trace_stats_times_json(const trace_stats_times_t *t) {
+    json_t *o = json_object();
+    json_object_set_new(o, "count", json_integer(t->count));
+    if (t->count) {
+        json_object_set_new(o, "min", json_integer(t->v[0]));
+        json_object_set_new(o, "p50", json_integer(trace_stats_percentile(t, 50)));
+        json_object_set_new(o, "p90", json_integer(trace_stats_percentile(t, 90)));
+        json_object_set_new(o, "p99", json_integer(trace_stats_percentile(t, 99)));
+        json_object_set_new(o, "max", json_integer(t->v[t->count - 1]));
+    }
+    return o;
+}
+
+static void trace_stats_times_print(const char *what, const trace_stats_times_t *t, bool use_us) {
+    if (t->count == 0) {
+        PrintAndLogEx(INFO, "%-16s none", what);
+        return;
+    }
+    uint32_t v[5] = { t->v[0], trace_stats_percentile(t, 50), trace_stats_percentile(t, 90), trace_stats_percentile(t, 99), t->v[t->count - 1] };
+    if (use_us) {
+        PrintAndLogEx(INFO, "%-16s %8.1f %8.1f %8.1f %8.1f %8.1f   (%u)", what,
+                      (float)v[0] / 13.56, (float)v[1] / 13.56, (float)v[2] / 13.56, (float)v[3] / 13.56, (float)v[4] / 13.56, t->count);
+    } else {
+        PrintAndLogEx(INFO, "%-16s %8u %8u %8u %8u %8u   (%u)", what, v[0], v[1], v[2], v[3], v[4], t->count);
+    }
+}
+
+static int CmdTraceStats(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "trace stats",
+                  "Walk the trace once and count reader commands, named by the protocol annotations,\n"
+                  "with their retries, answers and CRC errors, and give percentiles of the response\n"
+                  "time (reader frame end to tag frame start) and of the reader frame gaps",
+                  "trace stats -t 14a            -> download the trace from the device\n"
+                  "trace stats -1 -t mf -u       -> trace buffer, times in microseconds\n"
+                  "trace stats -1 -t 15 -j stats -> also save to stats.json"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0("1", "buffer", "use data from trace buffer"),
+        arg_str0("t", "type", NULL, "protocol to annotate the trace, see `trace list -h`"),
+        arg_lit0("u", NULL, "display times in microseconds instead of clock cycles"),
+        arg_str0("j", "json", "<fn>", "save the statistics to a JSON file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    bool use_buffer = arg_get_lit(ctx, 1);
+
+    int tlen = 0;
+    char type[10] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)type, sizeof(type), &tlen);
+    str_lower(type);
+
+    bool use_us = arg_get_lit(ctx, 3);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    CLIParserFree(ctx);
+
+    uint8_t protocol = -1;
+    if (trace_protocol_from_str(type, &protocol) != PM3_SUCCESS) {
+        return PM3_EINVARG;
+    }
+
+    if (use_buffer == false) {
+        download_trace();
+    } else if (gs_traceLen == 0) {
+        PrintAndLogEx(FAILED, "You requested trace stats in offline mode but there is no trace.");
+        PrintAndLogEx(FAILED, "Consider using `" _YELLOW_("trace load") "` or removing parameter `" _YELLOW_("-1") "`");
+        return PM3_EINVARG;
+    }
+
+    if (gs_traceLen == 0) {
+        PrintAndLogEx(WARNING, "trace is empty");
+        return PM3_SUCCESS;
+    }
+
+    // only the 13.56 MHz protocols count in carrier periods
+    if (use_us && (protocol == LEGIC || protocol == ISO_7816_4 || protocol == PROTO_HITAG1 || protocol == PROTO_HITAG2 || protocol == PROTO_HITAGS)) {
+        PrintAndLogEx(WARNING, "no microseconds for this protocol, showing trace ticks");
+        use_us = false;
+    }
+
+    trace_stats_cmd_t *cmds = calloc(TRACE_STATS_MAX_CMDS, sizeof(trace_stats_cmd_t));
+    trace_stats_times_t response = {0}, gap = {0};
+    if (cmds == NULL) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace stats");
+        return PM3_EMALLOC;
+    }
+
+    uint8_t ncmds = 0;
+    uint32_t frames[2] = {0}, crc_ok[2] = {0}, crc_bad[2] = {0};
+    uint32_t retries = 0;
+
+    trace_stats_cmd_t *last = NULL;
+    const tracelog_hdr_t *last_rdr = NULL;
+    uint32_t last_rdr_eot = 0;
+    bool answered = false;
+    bool ok = true;
+
+    trace_reset_annotators(protocol);
+
+    uint32_t tracepos = 0;
+    while (ok && is_last_record(tracepos, gs_traceLen) == false) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + tracepos);
+        uint32_t next = tracepos + TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (next > gs_traceLen) {
+            break;
+        }
+        tracepos = next;
+
+        uint16_t data_len = hdr->data_len;
+        uint8_t *frame = (uint8_t *)hdr->frame;
+        const uint8_t *parityBytes = hdr->frame + data_len;
+        uint32_t duration = hdr->duration;
+        if (protocol == ICLASS || protocol == ISO_15693) {
+            duration *= 32;
+        }
+        bool rsp = hdr->isResponse;
+        frames[rsp]++;
+
+        uint8_t crc = 2;
+        if (protocol != (uint8_t) -1) {
+            crc = trace_crc_status(protocol, rsp, frame, data_len, parityBytes);
+        }
+        if (crc == 0) {
+            crc_bad[rsp]++;
+        } else if (crc != 2) {
+            crc_ok[rsp]++;
+        }
+
+        // annotators keep protocol state,  run them on every frame
+        char explanation[60] = {0};
+        if (protocol != (uint8_t) -1) {
+            trace_annotate(explanation, sizeof(explanation), protocol, rsp, frame, data_len, parityBytes, NULL, 0);
+            trace_strip_colors(explanation);
+        }
+
+        if (rsp) {
+            if (last_rdr && answered == false) {
+                answered = true;
+                last->answered++;
+                if (hdr->timestamp >= last_rdr_eot) {
+                    ok = trace_stats_times_add(&response, hdr->timestamp - last_rdr_eot);
+                }
+            }
+            continue;
+        }
+
+        char name[TRACE_STATS_NAME_LEN];
+        trace_stats_name(name, explanation, frame, data_len);
+        trace_stats_cmd_t *c = trace_stats_cmd(cmds, &ncmds, name);
+        c->count++;
+        if (crc == 0) {
+            c->crc_bad++;
+        }
+
+        // the same reader frame again is a retry,  answered or not
+        if (last_rdr && last_rdr->data_len == data_len && memcmp(last_rdr->frame, frame, data_len) == 0) {
+            c->retries++;
+            retries++;
+        }
+
+        if (last_rdr && hdr->timestamp >= last_rdr_eot) {
+            ok = trace_stats_times_add(&gap, hdr->timestamp - last_rdr_eot);
+        }
+
+        last = c;
+        last_rdr = hdr;
+        last_rdr_eot = hdr->timestamp + duration;
+        answered = false;
+    }
+
+    if (ok == false) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace stats");
+        free(cmds);
+        free(response.v);
+        free(gap.v);
+        return PM3_EMALLOC;
+    }
+
+    qsort(response.v, response.count, sizeof(uint32_t), trace_stats_cmp);
+    qsort(gap.v, gap.count, sizeof(uint32_t), trace_stats_cmp);
+    qsort(cmds, ncmds, sizeof(trace_stats_cmd_t), trace_stats_cmd_cmp);
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Frames") " ------------------------------------------");
+    PrintAndLogEx(INFO, "reader " _YELLOW_("%u") "  tag " _YELLOW_("%u") "  retries " _YELLOW_("%u") " ( %.1f%% )",
+                  frames[0], frames[1], retries, (frames[0]) ? 100.0 * retries / frames[0] : 0.0);
+    for (uint8_t i = 0; i < 2; i++) {
+        uint32_t checked = crc_ok[i] + crc_bad[i];
+        PrintAndLogEx(INFO, "%-6s CRC ok " _GREEN_("%u") "  bad " _RED_("%u") " ( %.1f%% of %u checked )",
+                      (i) ? "tag" : "reader", crc_ok[i], crc_bad[i], (checked) ? 100.0 * crc_bad[i] / checked : 0.0, checked);
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Commands") " ----------------------------------------");
+    PrintAndLogEx(INFO, "%-24s %8s %8s %8s %8s", "name", "count", "answered", "retries", "crc bad");
+    for (uint8_t i = 0; i < ncmds; i++) {
+        PrintAndLogEx(INFO, "%-24s %8u %8u %8u %8u", cmds[i].name, cmds[i].count, cmds[i].answered, cmds[i].retries, cmds[i].crc_bad);
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Timing") " in %-13s ---------------------------", (use_us) ? "microseconds" : "trace ticks");
+    PrintAndLogEx(INFO, "%-16s %8s %8s %8s %8s %8s", "", "min", "p50", "p90", "p99", "max");
+    trace_stats_times_print("tag response", &response, use_us);
+    trace_stats_times_print("reader gap", &gap, use_us);
+    PrintAndLogEx(NORMAL, "");
+
+    int res = PM3_SUCCESS;
+    if (fnlen) {
+        json_t *root = json_object();
+        json_object_set_new(root, "Created", json_string("proxmark3"));
+        json_object_set_new(root, "FileType", json_string("tracestats"));
+        json_object_set_new(root, "protocol", json_string((tlen) ? type : "raw"));
+        json_object_set_new(root, "unit", json_string("ticks"));
+        json_object_set_new(root, "reader_frames", json_integer(frames[0]));
+        json_object_set_new(root, "tag_frames", json_integer(frames[1]));
+        json_object_set_new(root, "retries", json_integer(retries));
+
+        json_t *crc = json_object();
+        for (uint8_t i = 0; i < 2; i++) {
+            json_t *o = json_object();
+            json_object_set_new(o, "ok", json_integer(crc_ok[i]));
+            json_object_set_new(o, "bad", json_integer(crc_bad[i]));
+            json_object_set_new(crc, (i) ? "tag" : "reader", o);
+        }
+        json_object_set_new(root, "crc", crc);
+
+        json_t *arr = json_array();
+        for (uint8_t i = 0; i < ncmds; i++) {
+            json_t *o = json_object();
+            json_object_set_new(o, "name", json_string(cmds[i].name));
+            json_object_set_new(o, "count", json_integer(cmds[i].count));
+            json_object_set_new(o, "answered", json_integer(cmds[i].answered));
+            json_object_set_new(o, "retries", json_integer(cmds[i].retries));
+            json_object_set_new(o, "crc_bad", json_integer(cmds[i].crc_bad));
+            json_array_append_new(arr, o);
+        }
+        json_object_set_new(root, "commands", arr);
+        json_object_set_new(root, "response_time", trace_stats_times_json(&response));
+        json_object_set_new(root, "reader_gap", trace_stats_times_json(&gap));
+
+        res = saveFileJSONrootEx(filename, root, JSON_INDENT(2), true, false);
+        json_decref(root);
+    }
+
+    free(cmds);
+    free(response.v);
+    free(gap.v);
+    return res;
+}
+
+// a trace file loaded next to the trace buffer,  for merge and diff
+typedef struct {
+    uint8_t *trace;
+    uint32_t len;
+    uint32_t *index;
+    uint32_t count;
+} trace_session_t;
+
+static void trace_session_free(trace_session_t *ts) {
+    free(ts->trace);
+    free(ts->index);
+    memset(ts, 0, sizeof(trace_session_t));
+}
+
+// Load a trace file,  compact ones expanded,  and index its records.  free() trace and index
+int LoadTraceFile(const char *filename, uint8_t **trace, uint32_t *trace_len, uint32_t **index, uint32_t *count) {
+    *trace = NULL;
+    *index = NULL;
+    *trace_len = 0;
+    *count = 0;
+
+    size_t len = 0;
+    if (loadFile_safe(filename, ".trace", (void **)trace, &len) != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Could not open file " _YELLOW_("%s"), filename);
+        return PM3_EIO;
+    }
+    *trace_len = (uint32_t)len;
+    trace_expand(trace, trace_len);
+
+    if (trace_index_records(*trace, *trace_len, index, count) == false) {
+        free(*trace);
+        *trace = NULL;
+        *trace_len = 0;
+        return PM3_EMALLOC;
+    }
+    return PM3_SUCCESS;
+}
+
+static int trace_session_load(const char *filename, trace_session_t *ts) {
+    memset(ts, 0, sizeof(trace_session_t));
+    return LoadTraceFile(filename, &ts->trace, &ts->len, &ts->index, &ts->count);
+}
+
+static uint32_t trace_record_len(const tracelog_hdr_t *hdr) {
+    return TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+}
+
+#define TRACE_MERGE_MAX_FILES   8
+
+static int CmdTraceMerge(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "trace merge",
+                  "Merge trace files into the trace buffer, ordered by timestamp.\n"
+                  "Records with the same timestamp keep the order of the files.\n"
+                  "With --seq every file is appended after the end of the previous one instead",
+                  "trace merge -f sniff1 -f sniff2            -> interleave two captures\n"
+                  "trace merge -f day1 -f day2 --seq -o all   -> one session after the other, saved to all.trace"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_strn("f", "file", "<fn>", 2, TRACE_MERGE_MAX_FILES, "trace file to merge, one per -f"),
+        arg_lit0(NULL, "seq", "append the files one after the other"),
+        arg_str0("o", "out", "<fn>", "save the merged trace to file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    struct arg_str *files_arg = arg_get_str(ctx, 1);
+    int nfiles = files_arg->count;
+    char filenames[TRACE_MERGE_MAX_FILES][FILE_PATH_SIZE] = {{0}};
+    for (int i = 0; i < nfiles; i++) {
+        strncpy(filenames[i], files_arg->sval[i], FILE_PATH_SIZE - 1);
+    }
+    bool sequential = arg_get_lit(ctx, 2);
+
+    int outlen = 0;
+    char outname[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)outname, FILE_PATH_SIZE, &outlen);
+    CLIParserFree(ctx);
+
+    trace_session_t ts[TRACE_MERGE_MAX_FILES] = {0};
+    uint64_t total = 0;
+    for (int i = 0; i < nfiles; i++) {
+        int res = trace_session_load(filenames[i], &ts[i]);
+        if (res != PM3_SUCCESS) {
+            for (int j = 0; j < i; j++) {
+                trace_session_free(&ts[j]);
+            }
+            return res;
+        }
+        total += ts[i].len;
+    }
+
+    uint8_t *merged = NULL;
+    if (total > UINT32_MAX || (merged = calloc(MAX(total, 1), sizeof(uint8_t))) == NULL) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace");
+        for (int i = 0; i < nfiles; i++) {
+            trace_session_free(&ts[i]);
+        }
+        return PM3_EMALLOC;
+    }
+
+    uint32_t pos = 0, records = 0;
+    if (sequential) {
+        // shift every session to start where the previous one ended
+        uint32_t offset = 0;
+        for (int i = 0; i < nfiles; i++) {
+            uint32_t eot = offset;
+            for (uint32_t r = 0; r < ts[i].count; r++) {
+                tracelog_hdr_t *hdr = (tracelog_hdr_t *)(ts[i].trace + ts[i].index[r]);
+                uint32_t rlen = trace_record_len(hdr);
+                memcpy(merged + pos, hdr, rlen);
+                tracelog_hdr_t *out = (tracelog_hdr_t *)(merged + pos);
+                out->timestamp = hdr->timestamp + offset;
+                eot = MAX(eot, out->timestamp + out->duration);
+                pos += rlen;
+            }
+            records += ts[i].count;
+            offset = eot;
+        }
+    } else {
+        // k-way merge,  each step takes the earliest head record
+        uint32_t next[TRACE_MERGE_MAX_FILES] = {0};
+        for (;;) {
+            int best = -1;
+            uint32_t best_ts = 0;
+            for (int i = 0; i < nfiles; i++) {
+                if (next[i] == ts[i].count) {
+                    continue;
+                }
+                const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(ts[i].trace + ts[i].index[next[i]]);
+                if (best == -1 || hdr->timestamp < best_ts) {
+                    best = i;
+                    best_ts = hdr->timestamp;
+                }
+            }
+            if (best == -1) {
+                break;
+            }
+
+            const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(ts[best].trace + ts[best].index[next[best]]);
+            uint32_t rlen = trace_record_len(hdr);
+            memcpy(merged + pos, hdr, rlen);
+            pos += rlen;
+            next[best]++;
+            records++;
+        }
+    }
+
+    for (int i = 0; i < nfiles; i++) {
+        PrintAndLogEx(INFO, "%-40s " _YELLOW_("%u") " records", filenames[i], ts[i].count);
+        trace_session_free(&ts[i]);
+    }
+
+    free(gs_trace);
+    trace_index_reset();
+    gs_trace = merged;
+    gs_traceLen = pos;
+
+    PrintAndLogEx(SUCCESS, "Merged " _YELLOW_("%u") " records (TraceLen = " _YELLOW_("%u") " bytes)", records, gs_traceLen);
+
+    if (outlen) {
+        saveFile(outname, ".trace", gs_trace, gs_traceLen);
+    }
+    PrintAndLogEx(HINT, "try " _YELLOW_("`trace list -1 -t ...`") " to view trace.  Remember the " _YELLOW_("`-1`") " param");
+    return PM3_SUCCESS;
+}
+
+// one side of a diff,  the records taking part and a hash of each
+typedef struct {
+    const uint8_t *trace;
+    uint32_t *rec;          // record number in the file
+    uint32_t *off;          // record offset
+    uint64_t *hash;
+    uint32_t count;
+} trace_diff_side_t;
+
+typedef enum {
+    TRACE_DIFF_SAME,
+    TRACE_DIFF_DEL,
+    TRACE_DIFF_INS,
+} trace_diff_op_t;
+
+typedef struct {
+    const trace_diff_side_t *a;
+    const trace_diff_side_t *b;
+    int32_t *v;             // forward and reverse paths of the bisection
+    uint8_t *ops;
+    uint32_t nops;
+} trace_diff_t;
+
+// edit distance explored by one bisection before the block is reported as replaced
+#define TRACE_DIFF_MAX_D    4096
+
+static uint64_t trace_frame_hash(const tracelog_hdr_t *hdr) {
+    // FNV-1a over direction, length and data,  timestamps never match between sessions
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = (h ^ hdr->isResponse) * 0x100000001b3ULL;
+    h = (h ^ (hdr->data_len & 0xFF)) * 0x100000001b3ULL;
+    h = (h ^ (hdr->data_len >> 8)) * 0x100000001b3ULL;
+    for (uint16_t i = 0; i < hdr->data_len; i++) {
+        h = (h ^ hdr->frame[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static bool trace_diff_side_init(trace_diff_side_t *side, const trace_session_t *ts, bool reader_only) {
+    memset(side, 0, sizeof(trace_diff_side_t));
+    side->trace = ts->trace;
+    side->rec = calloc(MAX(ts->count, 1), sizeof(uint32_t));
+    side->off = calloc(MAX(ts->count, 1), sizeof(uint32_t));
+    side->hash = calloc(MAX(ts->count, 1), sizeof(uint64_t));
+    if (side->rec == NULL || side->off == NULL || side->hash == NULL) {
+        return false;
+    }
+
+    for (uint32_t r = 0; r < ts->count; r++) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(ts->trace + ts->index[r]);
+        if (reader_only && hdr->isResponse) {
+            continue;
+        }
+        side->rec[side->count] = r;
+        side->off[side->count] = ts->index[r];
+        side->hash[side->count] = trace_frame_hash(hdr);
+        side->count++;
+    }
+    return true;
+}
+
+static void trace_diff_side_free(trace_diff_side_t *side) {
+    free(side->rec);
+    free(side->off);
+    free(side->hash);
+}
+
+static bool trace_diff_eq(const trace_diff_t *d, uint32_t i, uint32_t j) {
+    if (d->a->hash[i] != d->b->hash[j]) {
+        return false;
+    }
+    const tracelog_hdr_t *ha = (const tracelog_hdr_t *)(d->a->trace + d->a->off[i]);
+    const tracelog_hdr_t *hb = (const tracelog_hdr_t *)(d->b->trace + d->b->off[j]);
+    return ha->isResponse == hb->isResponse && ha->data_len == hb->data_len && memcmp(ha->frame, hb->frame, ha->data_len) == 0;
+}
+
+static void trace_diff_emit(trace_diff_t *d, trace_diff_op_t op, uint32_t n) {
+    memset(d->ops + d->nops, op, n);
+    d->nops += n;
+}
+
+// middle snake of a[a0..a1) and b[b0..b1),  Myers' linear space variant.
+// False when no snake was found within TRACE_DIFF_MAX_D edits.
+static bool trace_diff_bisect(trace_diff_t *d, uint32_t a0, uint32_t a1, uint32_t b0, uint32_t b1, uint32_t *xs, uint32_t *ys) {
+    int32_t n = a1 - a0, m = b1 - b0;
+    int32_t max_d = MIN((n + m + 1) / 2, TRACE_DIFF_MAX_D);
+    int32_t v_offset = max_d + 1;
+    int32_t v_length = 2 * max_d + 3;
+    int32_t *v1 = d->v;
+    int32_t *v2 = d->v + v_length;
+
+    for (int32_t i = 0; i < v_length; i++) {
+        v1[i] = -1;
+        v2[i] = -1;
+    }
+    v1[v_offset + 1] = 0;
+    v2[v_offset + 1] = 0;
+
+    int32_t delta = n - m;
+    // odd delta,  the forward path meets the reverse one
+    bool front = (delta % 2 != 0);
+    int32_t k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+    for (int32_t e = 0; e < max_d; e++) {
+        for (int32_t k1 = -e + k1start; k1 <= e - k1end; k1 += 2) {
+            int32_t k1_offset = v_offset + k1;
+            int32_t x1;
+            if (k1 == -e || (k1 != e && v1[k1_offset - 1] < v1[k1_offset + 1])) {
+                x1 = v1[k1_offset + 1];
+            } else {
+                x1 = v1[k1_offset - 1] + 1;
+            }
+            int32_t y1 = x1 - k1;
+            while (x1 < n && y1 < m && trace_diff_eq(d, a0 + x1, b0 + y1)) {
+                x1++;
+                y1++;
+            }
+            v1[k1_offset] = x1;
+            if (x1 > n) {
+                k1end += 2;
+            } else if (y1 > m) {
+                k1start += 2;
+            } else if (front) {
+                int32_t k2_offset = v_offset + delta - k1;
+                if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1) {
+                    if (x1 >= n - v2[k2_offset]) {
+                        *xs = a0 + x1;
+                        *ys = b0 + y1;
+                        return true;
+                    }
+                }
+            }
+        }
+
+        for (int32_t k2 = -e + k2start; k2 <= e - k2end; k2 += 2) {
+            int32_t k2_offset = v_offset + k2;
+            int32_t x2;
+            if (k2 == -e || (k2 != e && v2[k2_offset - 1] < v2[k2_offset + 1])) {
+                x2 = v2[k2_offset + 1];
+            } else {
+                x2 = v2[k2_offset - 1] + 1;
+            }
+            int32_t y2 = x2 - k2;
+            while (x2 < n && y2 < m && trace_diff_eq(d, a0 + n - x2 - 1, b0 + m - y2 - 1)) {
+                x2++;
+                y2++;
+            }
+            v2[k2_offset] = x2;
+            if (x2 > n) {
+                k2end += 2;
+            } else if (y2 > m) {
+                k2start += 2;
+            } else if (front == false) {
+                int32_t k1_offset = v_offset + delta - k2;
+                if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1) {
+                    int32_t x1 = v1[k1_offset];
+                    int32_t y1 = v_offset + x1 - k1_offset;
+                    if (x1 >= n - x2) {
+                        *xs = a0 + x1;
+                        *ys = b0 + y1;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static void trace_diff_run(trace_diff_t *d, uint32_t a0, uint32_t a1, uint32_t b0, uint32_t b1) {
+    // common head and tail first,  for sessions of the same card that is most of it
+    uint32_t head = 0;
+    while (a0 + head < a1 && b0 + head < b1 && trace_diff_eq(d, a0 + head, b0 + head)) {
+        head++;
+    }
+    trace_diff_emit(d, TRACE_DIFF_SAME, head);
+    a0 += head;
+    b0 += head;
+
+    uint32_t tail = 0;
+    while (a0 < a1 - tail && b0 < b1 - tail && trace_diff_eq(d, a1 - tail - 1, b1 - tail - 1)) {
+        tail++;
+    }
+    a1 -= tail;
+    b1 -= tail;
+
+    uint32_t xs = 0, ys = 0;
+    if (a0 == a1 || b0 == b1 || trace_diff_bisect(d, a0, a1, b0, b1, &xs, &ys) == false) {
+        trace_diff_emit(d, TRACE_DIFF_DEL, a1 - a0);
+        trace_diff_emit(d, TRACE_DIFF_INS, b1 - b0);
+    } else {
+        trace_diff_run(d, a0, xs, b0, ys);
+        trace_diff_run(d, xs, a1, ys, b1);
+    }
+
+    trace_diff_emit(d, TRACE_DIFF_SAME, tail);
+}
+
+static void trace_diff_print_record(char sign, const trace_diff_side_t *side, uint32_t i) {
+    const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(side->trace + side->off[i]);
+    const char *src = (hdr->isResponse) ? "Tag" : "Rdr";
+    const char *hex = sprint_hex_inrow(hdr->frame, hdr->data_len);
+    if (sign == '-') {
+        PrintAndLogEx(NORMAL, _RED_("- %6u  %s  %s"), side->rec[i], src, hex);
+    } else if (sign == '+') {
+        PrintAndLogEx(NORMAL, _GREEN_("+ %6u  %s  %s"), side->rec[i], src, hex);
+    } else {
+        PrintAndLogEx(NORMAL, "  %6u  %s  %s", side->rec[i], src, hex);
+    }
+}
+
+static int CmdTraceDiff(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "trace diff",
+                  "Compare the frames of two trace files.\n"
+                  "Records match on direction and data,  timing is ignored.\n"
+                  "Lines are record numbers of the two files,  `-` only in the first,  `+` only in the second",
+                  "trace diff -f before -f after       -> all frames\n"
+                  "trace diff -f before -f after -r    -> reader frames only\n"
+                  "trace diff -f before -f after -c 2  -> two equal records around each change"
                  );
 
-    void *argtable[] = {
-        arg_param_begin,
-        arg_str1("f", "file", "<fn>", "Specify trace file to save"),
-        arg_param_end
-    };
-    CLIExecWithReturn(ctx, Cmd, argtable, false);
+    void *argtable[] = {
+        arg_param_begin,
+        arg_strn("f", "file", "<fn>", 2, 2, "trace file, one per -f"),
+        arg_lit0("r", "reader", "compare reader frames only"),
+        arg_u64_0("c", "context", "<dec>", "equal records shown around each change (def 0)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    struct arg_str *files_arg = arg_get_str(ctx, 1);
+    bool reader_only = arg_get_lit(ctx, 2);
+    uint32_t context = arg_get_u32_def(ctx, 3, 0);
+    char filenames[2][FILE_PATH_SIZE] = {{0}};
+    for (int i = 0; i < 2; i++) {
+        strncpy(filenames[i], files_arg->sval[i], FILE_PATH_SIZE - 1);
+    }
+    CLIParserFree(ctx);
+
+    trace_session_t ts[2] = {0};
+    for (int i = 0; i < 2; i++) {
+        int res = trace_session_load(filenames[i], &ts[i]);
+        if (res != PM3_SUCCESS) {
+            trace_session_free(&ts[0]);
+            return res;
+        }
+    }
+
+    int res = PM3_SUCCESS;
+    trace_diff_side_t a, b;
+    trace_diff_t d = { .a = &a, .b = &b };
+    bool ok = trace_diff_side_init(&a, &ts[0], reader_only);
+    ok &= trace_diff_side_init(&b, &ts[1], reader_only);
+    if (ok) {
+        uint32_t max_d = MIN((a.count + b.count + 1) / 2, TRACE_DIFF_MAX_D);
+        d.v = calloc(2 * (2 * max_d + 3), sizeof(int32_t));
+        d.ops = calloc(MAX(a.count + b.count, 1), sizeof(uint8_t));
+        ok = (d.v != NULL && d.ops != NULL);
+    }
+    if (ok == false) {
+        PrintAndLogEx(FAILED, "Cannot allocate memory for trace diff");
+        res = PM3_EMALLOC;
+        goto out;
+    }
+
+    trace_diff_run(&d, 0, a.count, 0, b.count);
+
+    PrintAndLogEx(NORMAL, "");
+    uint32_t same = 0, only_a = 0, only_b = 0;
+    uint32_t ia = 0, ib = 0, shown = 0;
+    for (uint32_t k = 0; k < d.nops;) {
+        if (d.ops[k] == TRACE_DIFF_SAME) {
+            k++;
+            ia++;
+            ib++;
+            same++;
+            continue;
+        }
+
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            res = PM3_EOPABORTED;
+            goto out;
+        }
+
+        // one hunk,  changes separated by at most twice the context stay together
+        uint32_t end = k, gap = 0;
+        for (uint32_t j = k; j < d.nops; j++) {
+            if (d.ops[j] == TRACE_DIFF_SAME) {
+                if (++gap > 2 * context) {
+                    break;
+                }
+            } else {
+                gap = 0;
+                end = j + 1;
+            }
+        }
 
-    int fnlen = 0;
-    char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
-    CLIParserFree(ctx);
+        uint32_t pre = MIN(context, ia - shown);
+        uint32_t ca = ia - pre, cb = ib - pre;
+        PrintAndLogEx(NORMAL, _CYAN_("@@ A %u  B %u @@"), (ca < a.count) ? a.rec[ca] : ts[0].count, (cb < b.count) ? b.rec[cb] : ts[1].count);
+        for (uint32_t j = 0; j < pre; j++) {
+            trace_diff_print_record(' ', &a, ca + j);
+        }
 
-    if (gs_traceLen == 0) {
-        download_trace();
-        if (gs_traceLen == 0) {
-            PrintAndLogEx(WARNING, "trace is empty, nothing to save");
-            return PM3_SUCCESS;
+        for (; k < end; k++) {
+            switch (d.ops[k]) {
+                case TRACE_DIFF_DEL:
+                    trace_diff_print_record('-', &a, ia++);
+                    only_a++;
+                    break;
+                case TRACE_DIFF_INS:
+                    trace_diff_print_record('+', &b, ib++);
+                    only_b++;
+                    break;
+                default:
+                    trace_diff_print_record(' ', &a, ia++);
+                    ib++;
+                    same++;
+                    break;
+            }
+        }
+
+        for (uint32_t j = 0; j < context && k < d.nops && d.ops[k] == TRACE_DIFF_SAME; j++, k++) {
+            trace_diff_print_record(' ', &a, ia++);
+            ib++;
+            same++;
         }
+        shown = ia;
     }
 
-    saveFile(filename, ".trace", gs_trace, gs_traceLen);
-    return PM3_SUCCESS;
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "A %s, " _YELLOW_("%u") " records", filenames[0], a.count);
+    PrintAndLogEx(INFO, "B %s, " _YELLOW_("%u") " records", filenames[1], b.count);
+    if (only_a == 0 && only_b == 0) {
+        PrintAndLogEx(SUCCESS, "Frames are " _GREEN_("identical"));
+    } else {
+        PrintAndLogEx(INFO, "equal " _YELLOW_("%u") ",  only in A " _RED_("%u") ",  only in B " _GREEN_("%u"), same, only_a, only_b);
+    }
+
+out:
+    free(d.v);
+    free(d.ops);
+    trace_diff_side_free(&a);
+    trace_diff_side_free(&b);
+    trace_session_free(&ts[0]);
+    trace_session_free(&ts[1]);
+    return res;
 }
 
 int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol) {
@@ -1274,6 +3019,11 @@ int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol)
         arg_lit0("x", NULL, "show hexdump to convert to pcap(ng)\n"
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_str0("f", "file", "<fn>", "filename of dictionary"),
+        arg_u64_0(NULL, "start", "<dec>", "first record to show (0 based)"),
+        arg_u64_0("n", "count", "<dec>", "number of records to show, default all or 100 with --page"),
+        arg_u64_0(NULL, "page", "<dec>", "page of `count` records to show (1 based)"),
+        arg_str0(NULL, "cmd", "<hex>", "only reader frames starting with this byte, and the tag answers to them"),
+        arg_str0(NULL, "follow", "<fn>", "list a trace file while a sniff with `--stream -f` writes it, like tail -f"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1285,6 +3035,219 @@ int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol)
     return CmdTraceList(args);
 }
 
+static void trace_print_legend(uint8_t protocol, bool use_relative, bool use_us) {
+    if (use_relative) {
+        PrintAndLogEx(INFO, _YELLOW_("gap") " = time between transfers. " _YELLOW_("duration") " = duration of data transfer. " _YELLOW_("src") " = source of transfer.");
+    } else {
+        PrintAndLogEx(INFO, _YELLOW_("start") " = start of start frame. " _YELLOW_("end") " = end of frame. " _YELLOW_("src") " = source of transfer.");
+    }
+
+    if (protocol == ISO_14443A || protocol == PROTO_MIFARE || protocol == MFDES || protocol == PROTO_MFPLUS || protocol == TOPAZ || protocol == LTO) {
+        if (use_us)
+            PrintAndLogEx(INFO, _YELLOW_("ISO14443A") " - all times are in microseconds");
+        else
+            PrintAndLogEx(INFO, _YELLOW_("ISO14443A") " - all times are in carrier periods (1/13.56MHz)");
+    }
+
+    if (protocol == THINFILM) {
+        if (use_us)
+            PrintAndLogEx(INFO, _YELLOW_("Thinfilm") " - all times are in microseconds");
+        else
+            PrintAndLogEx(INFO, _YELLOW_("Thinfilm") " - all times are in carrier periods (1/13.56MHz)");
+    }
+
+    if (protocol == ICLASS || protocol == ISO_15693) {
+        if (use_us)
+            PrintAndLogEx(INFO, _YELLOW_("ISO15693 / iCLASS") " - all times are in microseconds");
+        else
+            PrintAndLogEx(INFO, _YELLOW_("ISO15693 / iCLASS") " - all times are in carrier periods (1/13.56MHz)");
+    }
+
+    if (protocol == LEGIC)
+        PrintAndLogEx(INFO, _YELLOW_("LEGIC") " - Reader Mode: Timings are in ticks (1us == 1.5ticks)\n"
+                      "        Tag Mode: Timings are in sub carrier periods (1/212 kHz == 4.7us)");
+
+    if (protocol == ISO_14443B || protocol == PROTO_CRYPTORF) {
+        if (use_us)
+            PrintAndLogEx(INFO, _YELLOW_("ISO14443B") " - all times are in microseconds");
+        else
+            PrintAndLogEx(INFO, _YELLOW_("ISO14443B") " - all times are in carrier periods (1/13.56MHz)");
+    }
+
+    if (protocol == ISO_7816_4)
+        PrintAndLogEx(INFO, _YELLOW_("ISO7816-4 / Smartcard") " - Timings N/A");
+
+    if (protocol == PROTO_HITAG1 || protocol == PROTO_HITAG2 || protocol == PROTO_HITAGS) {
+        PrintAndLogEx(INFO, _YELLOW_("Hitag1 / Hitag2 / HitagS") " - Timings in ETU (8us)");
+    }
+
+    if (protocol == FELICA) {
+        if (use_us)
+            PrintAndLogEx(INFO, _YELLOW_("ISO18092 / FeliCa") " - all times are in microseconds");
+        else
+            PrintAndLogEx(INFO, _YELLOW_("ISO18092 / FeliCa") " - all times are in carrier periods (1/13.56MHz)");
+    }
+}
+
+static void trace_print_table_header(uint8_t protocol, bool use_relative) {
+    PrintAndLogEx(NORMAL, "");
+    if (use_relative) {
+        PrintAndLogEx(NORMAL, "        Gap |   Duration | Src | Data (! denotes parity error, ' denotes short bytes)                    | CRC | Annotation");
+    } else {
+        PrintAndLogEx(NORMAL, "      Start |        End | Src | Data (! denotes parity error)                                           | CRC | Annotation");
+    }
+    PrintAndLogEx(NORMAL, "------------+------------+-----+-------------------------------------------------------------------------+-----+--------------------");
+
+    trace_reset_annotators(protocol);
+}
+
+// A listing of a trace that still grows.  Only complete records are printed and what
+// printTraceLine carries from one record to the next is kept between calls.
+typedef struct {
+    uint8_t protocol;
+    bool show_wait_cycles;
+    bool mark_crc;
+    bool use_relative;
+    bool use_us;
+    const uint64_t *keys;
+    uint32_t keys_count;
+    int filter_len;
+    uint8_t filter_cmd;
+    bool in_match;
+    uint32_t tracepos;
+    uint32_t prev_eot;
+    uint32_t shown;
+} trace_follow_t;
+
+static void trace_follow_init(trace_follow_t *tf, uint8_t protocol) {
+    memset(tf, 0, sizeof(trace_follow_t));
+    tf->protocol = protocol;
+    tf->in_match = true;
+}
+
+// end of the complete records in gs_trace from tracepos on
+static uint32_t trace_follow_end(uint32_t tracepos, uint8_t protocol, bool flush) {
+    uint32_t end = tracepos;
+    uint32_t last_response = tracepos;
+    while (tracepos + TRACELOG_HDR_LEN <= gs_traceLen) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + tracepos);
+        tracepos += TRACELOG_HDR_LEN + hdr->data_len + TRACELOG_PARITY_LEN(hdr);
+        if (tracepos > gs_traceLen) {
+            break;
+        }
+        end = tracepos;
+        if (hdr->isResponse) {
+            last_response = tracepos;
+        }
+    }
+
+    // topaz reader commands come in several frames,  wait for the tag answer before merging them
+    if (protocol == TOPAZ && flush == false) {
+        return last_response;
+    }
+    return end;
+}
+
+// print the records added since the last call,  flush when the trace is complete
+static void trace_follow_print(trace_follow_t *tf, bool flush) {
+    uint32_t end = trace_follow_end(tf->tracepos, tf->protocol, flush);
+    uint32_t *prev_eot = (tf->use_relative) ? &tf->prev_eot : NULL;
+
+    while (tf->tracepos < end) {
+        const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + tf->tracepos);
+        if (hdr->isResponse == false) {
+            tf->in_match = (tf->filter_len == 0) || (hdr->data_len && hdr->frame[0] == tf->filter_cmd);
+        }
+
+        uint8_t old_printAndLog = g_printAndLog;
+        if (tf->in_match == false) {
+            g_printAndLog = 0;
+        }
+        uint32_t next = printTraceLine(tf->tracepos, end, gs_trace, tf->protocol, tf->show_wait_cycles, tf->mark_crc, prev_eot, tf->use_us, tf->keys, tf->keys_count, NULL);
+        g_printAndLog = old_printAndLog;
+        tf->shown += tf->in_match;
+
+        if (next <= tf->tracepos) {
+            break;
+        }
+        tf->tracepos = next;
+    }
+}
+
+// append to gs_trace,  growing it as needed
+static bool trace_append(const uint8_t *data, uint32_t len, uint32_t *trace_size) {
+    if (gs_traceLen + len > *trace_size) {
+        uint32_t new_size = MAX(2 * *trace_size, gs_traceLen + len + PM3_CMD_DATA_SIZE);
+        uint8_t *tmp = realloc(gs_trace, new_size);
+        if (tmp == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return false;
+        }
+        gs_trace = tmp;
+        *trace_size = new_size;
+    }
+    memcpy(gs_trace + gs_traceLen, data, len);
+    gs_traceLen += len;
+    return true;
+}
+
+// Like tail -f,  list a trace file while a streaming sniff (`--stream -f`) writes it.  The file
+// ends up in the trace buffer.
+static int trace_follow_file(const char *filename, trace_follow_t *tf) {
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", filename);
+        return PM3_EFILE;
+    }
+
+    trace_index_reset();
+    free(gs_trace);
+    gs_trace = NULL;
+    gs_traceLen = 0;
+    uint32_t trace_size = 0;
+
+    PrintAndLogEx(INFO, "Following `" _YELLOW_("%s") "`,  press " _GREEN_("<Enter>") " to stop", filename);
+
+    int res = PM3_SUCCESS;
+    bool checked = false;
+    uint8_t buf[4096];
+    while (kbd_enter_pressed() == false) {
+
+        size_t n = fread(buf, 1, sizeof(buf), f);
+        if (n == 0) {
+            // at the end for now,  the writer may add more
+            clearerr(f);
+            msleep(50);
+            continue;
+        }
+
+        if (trace_append(buf, n, &trace_size) == false) {
+            res = PM3_EMALLOC;
+            break;
+        }
+
+        if (checked == false && gs_traceLen >= TRACELOG_COMPACT_MAGIC_LEN) {
+            if (memcmp(gs_trace, TRACELOG_COMPACT_MAGIC, TRACELOG_COMPACT_MAGIC_LEN) == 0) {
+                PrintAndLogEx(FAILED, "Compact traces can't be followed,  use `" _YELLOW_("trace load") "`");
+                res = PM3_EFILE;
+                break;
+            }
+            checked = true;
+        }
+
+        trace_follow_print(tf, false);
+    }
+    fclose(f);
+
+    if (res == PM3_SUCCESS) {
+        trace_follow_print(tf, true);
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(SUCCESS, "Followed " _YELLOW_("%u") " bytes,  " _YELLOW_("%u") " records shown", gs_traceLen, tf->shown);
+        PrintAndLogEx(HINT, "the trace is in the trace buffer,  see " _YELLOW_("`trace list -1 -t ...`"));
+    }
+    return res;
+}
+
 int CmdTraceList(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "trace list",
@@ -1313,7 +3276,11 @@ int CmdTraceList(const char *Cmd) {
                   "\n"
                   "trace list -t mf -f mfc_default_keys.dic     -> use default dictionary file\n"
                   "trace list -t 14a --frame                    -> show frame delay times\n"
-                  "trace list -t 14a -1                         -> use trace buffer "
+                  "trace list -t 14a -1                         -> use trace buffer\n"
+                  "trace list -t 14b -1 --start 1000 -n 50      -> records 1000 to 1049\n"
+                  "trace list -t 15 -1 -n 100 --page 3          -> third page of 100 records\n"
+                  "trace list -t 14a -1 --cmd 30                -> only READ commands and their answers\n"
+                  "trace list -t 14a --follow sniff.trace       -> follow `hf 14a sniff --stream -f sniff` of another client"
                  );
 
     void *argtable[] = {
@@ -1327,6 +3294,11 @@ int CmdTraceList(const char *Cmd) {
                  "                                   or to import into Wireshark using encapsulation type \"ISO 14443\""),
         arg_str0("t", "type", NULL, "protocol to annotate the trace"),
         arg_str0("f", "file", "<fn>", "filename of dictionary"),
+        arg_u64_0(NULL, "start", "<dec>", "first record to show (0 based)"),
+        arg_u64_0("n", "count", "<dec>", "number of records to show, default all or 100 with --page"),
+        arg_u64_0(NULL, "page", "<dec>", "page of `count` records to show (1 based)"),
+        arg_str0(NULL, "cmd", "<hex>", "only reader frames starting with this byte, and the tag answers to them"),
+        arg_str0(NULL, "follow", "<fn>", "list a trace file while a sniff with `--stream -f` writes it, like tail -f"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1350,40 +3322,43 @@ int CmdTraceList(const char *Cmd) {
         diclen = 0;
     }
 
+    uint64_t rec_start = arg_get_u64_def(ctx, 9, 0);
+    uint64_t rec_count = arg_get_u64_def(ctx, 10, 0);
+    uint64_t rec_page = arg_get_u64_def(ctx, 11, 0);
+
+    uint8_t filter_cmd[1] = {0};
+    int filter_len = 0;
+    CLIGetHexWithReturn(ctx, 12, filter_cmd, &filter_len);
+
+    int followlen = 0;
+    char follow[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 13), (uint8_t *)follow, FILE_PATH_SIZE, &followlen);
+
     CLIParserFree(ctx);
 
+    if (followlen && (show_hex || rec_start || rec_count || rec_page)) {
+        PrintAndLogEx(WARNING, "--follow can't be combined with -x / --start / --count / --page");
+        return PM3_EINVARG;
+    }
+
+    if (rec_page) {
+        if (rec_count == 0) {
+            rec_count = 100;
+        }
+        rec_start += (rec_page - 1) * rec_count;
+    }
+
     clearCommandBuffer();
 
     // no crc, no annotations
     uint8_t protocol = -1;
-
-    // validate type of output
-    if (strcmp(type, "14a") == 0)      protocol = ISO_14443A;
-    else if (strcmp(type, "14b") == 0)      protocol = ISO_14443B;
-    else if (strcmp(type, "15") == 0)       protocol = ISO_15693;
-    else if (strcmp(type, "7816") == 0)     protocol = ISO_7816_4;
-    else if (strcmp(type, "cryptorf") == 0) protocol = PROTO_CRYPTORF;
-    else if (strcmp(type, "des") == 0)      protocol = MFDES;
-    else if (strcmp(type, "felica") == 0)   protocol = FELICA;
-    else if (strcmp(type, "hitag1") == 0)   protocol = PROTO_HITAG1;
-    else if (strcmp(type, "hitag2") == 0)   protocol = PROTO_HITAG2;
-    else if (strcmp(type, "hitags") == 0)   protocol = PROTO_HITAGS;
-    else if (strcmp(type, "iclass") == 0)   protocol = ICLASS;
-    else if (strcmp(type, "legic") == 0)    protocol = LEGIC;
-    else if (strcmp(type, "lto") == 0)      protocol = LTO;
-    else if (strcmp(type, "mf") == 0)       protocol = PROTO_MIFARE;
-    else if (strcmp(type, "raw") == 0)      protocol = -1;
-    else if (strcmp(type, "seos") == 0)     protocol = SEOS;
-    else if (strcmp(type, "thinfilm") == 0) protocol = THINFILM;
-    else if (strcmp(type, "topaz") == 0)    protocol = TOPAZ;
-    else if (strcmp(type, "mfp") == 0)      protocol = PROTO_MFPLUS;
-    else if (strcmp(type, "") == 0)         protocol = -1;
-    else {
-        PrintAndLogEx(FAILED, "Unknown protocol \"%s\"", type);
+    if (trace_protocol_from_str(type, &protocol) != PM3_SUCCESS) {
         return PM3_EINVARG;
     }
 
-    if (use_buffer == false) {
+    if (followlen) {
+        // the trace comes from the file
+    } else if (use_buffer == false) {
         download_trace();
     } else if (gs_traceLen == 0 || gs_trace == NULL) {
         PrintAndLogEx(FAILED, "You requested a trace list in offline mode but there is no trace.");
@@ -1391,12 +3366,14 @@ int CmdTraceList(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    PrintAndLogEx(SUCCESS,  "Recorded activity ( " _YELLOW_("%u") " bytes )", gs_traceLen);
-    if (gs_traceLen == 0) {
-        return PM3_SUCCESS;
+    if (followlen == 0) {
+        PrintAndLogEx(SUCCESS,  "Recorded activity ( " _YELLOW_("%u") " bytes )", gs_traceLen);
+        if (gs_traceLen == 0) {
+            return PM3_SUCCESS;
+        }
     }
 
-    uint16_t tracepos = 0;
+    uint32_t tracepos = 0;
 
     /*
     if (protocol == FELICA) {
@@ -1409,58 +3386,7 @@ int CmdTraceList(const char *Cmd) {
         }
     } else {
 
-        if (use_relative) {
-            PrintAndLogEx(INFO, _YELLOW_("gap") " = time between transfers. " _YELLOW_("duration") " = duration of data transfer. " _YELLOW_("src") " = source of transfer.");
-        } else {
-            PrintAndLogEx(INFO, _YELLOW_("start") " = start of start frame. " _YELLOW_("end") " = end of frame. " _YELLOW_("src") " = source of transfer.");
-        }
-
-        if (protocol == ISO_14443A || protocol == PROTO_MIFARE || protocol == MFDES || protocol == PROTO_MFPLUS || protocol == TOPAZ || protocol == LTO) {
-            if (use_us)
-                PrintAndLogEx(INFO, _YELLOW_("ISO14443A") " - all times are in microseconds");
-            else
-                PrintAndLogEx(INFO, _YELLOW_("ISO14443A") " - all times are in carrier periods (1/13.56MHz)");
-        }
-
-        if (protocol == THINFILM) {
-            if (use_us)
-                PrintAndLogEx(INFO, _YELLOW_("Thinfilm") " - all times are in microseconds");
-            else
-                PrintAndLogEx(INFO, _YELLOW_("Thinfilm") " - all times are in carrier periods (1/13.56MHz)");
-        }
-
-        if (protocol == ICLASS || protocol == ISO_15693) {
-            if (use_us)
-                PrintAndLogEx(INFO, _YELLOW_("ISO15693 / iCLASS") " - all times are in microseconds");
-            else
-                PrintAndLogEx(INFO, _YELLOW_("ISO15693 / iCLASS") " - all times are in carrier periods (1/13.56MHz)");
-        }
-
-        if (protocol == LEGIC)
-            PrintAndLogEx(INFO, _YELLOW_("LEGIC") " - Reader Mode: Timings are in ticks (1us == 1.5ticks)\n"
-                          "        Tag Mode: Timings are in sub carrier periods (1/212 kHz == 4.7us)");
-
-        if (protocol == ISO_14443B || protocol == PROTO_CRYPTORF) {
-            if (use_us)
-                PrintAndLogEx(INFO, _YELLOW_("ISO14443B") " - all times are in microseconds");
-            else
-                PrintAndLogEx(INFO, _YELLOW_("ISO14443B") " - all times are in carrier periods (1/13.56MHz)");
-        }
-
-        if (protocol == ISO_7816_4)
-            PrintAndLogEx(INFO, _YELLOW_("ISO7816-4 / Smartcard") " - Timings N/A");
-
-        if (protocol == PROTO_HITAG1 || protocol == PROTO_HITAG2 || protocol == PROTO_HITAGS) {
-            PrintAndLogEx(INFO, _YELLOW_("Hitag1 / Hitag2 / HitagS") " - Timings in ETU (8us)");
-        }
-
-        if (protocol == FELICA) {
-            if (use_us)
-                PrintAndLogEx(INFO, _YELLOW_("ISO18092 / FeliCa") " - all times are in microseconds");
-            else
-                PrintAndLogEx(INFO, _YELLOW_("ISO18092 / FeliCa") " - all times are in carrier periods (1/13.56MHz)");
-        }
-
+        trace_print_legend(protocol, use_relative, use_us);
 
         const uint64_t *dicKeys = NULL;
         uint32_t dicKeysCount = 0;
@@ -1514,23 +3440,7 @@ int CmdTraceList(const char *Cmd) {
             }
         }
 
-        PrintAndLogEx(NORMAL, "");
-        if (use_relative) {
-            PrintAndLogEx(NORMAL, "        Gap |   Duration | Src | Data (! denotes parity error, ' denotes short bytes)                    | CRC | Annotation");
-        } else {
-            PrintAndLogEx(NORMAL, "      Start |        End | Src | Data (! denotes parity error)                                           | CRC | Annotation");
-        }
-        PrintAndLogEx(NORMAL, "------------+------------+-----+-------------------------------------------------------------------------+-----+--------------------");
-
-        // clean authentication data used with the mifare classic decrypt fct
-        if (protocol == ISO_14443A || protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS) {
-            ClearAuthData();
-        }
-
-        // reset hitag state  machine
-        if (protocol == PROTO_HITAG1 || protocol == PROTO_HITAG2 || protocol == PROTO_HITAGS) {
-            annotateHitag2_init();
-        }
+        trace_print_table_header(protocol, use_relative);
 
         uint32_t previous_EOT = 0;
         uint32_t *prev_EOT = NULL;
@@ -1538,11 +3448,80 @@ int CmdTraceList(const char *Cmd) {
             prev_EOT = &previous_EOT;
         }
 
-        while (tracepos < gs_traceLen) {
-            tracepos = printTraceLine(tracepos, gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount);
+        bool windowed = (rec_start || rec_count || filter_len);
+        if (followlen) {
+            trace_follow_t tf;
+            trace_follow_init(&tf, protocol);
+            tf.show_wait_cycles = show_wait_cycles;
+            tf.mark_crc = mark_crc;
+            tf.use_relative = use_relative;
+            tf.use_us = use_us;
+            tf.keys = dicKeys;
+            tf.keys_count = dicKeysCount;
+            tf.filter_len = filter_len;
+            tf.filter_cmd = filter_cmd[0];
+            trace_follow_file(follow, &tf);
+        } else if (windowed && trace_index_build()) {
+
+            uint32_t first = MIN(rec_start, gs_traceIndexCnt);
+            uint32_t last = (rec_count) ? MIN(first + rec_count, gs_traceIndexCnt) : gs_traceIndexCnt;
+
+            // records before the window are skipped when their annotation doesn't depend on them,
+            // otherwise they still go through printTraceLine,  silently
+            bool stateless = trace_protocol_is_stateless(protocol);
+            uint32_t rec = (stateless) ? first : 0;
+            if (rec && prev_EOT) {
+                previous_EOT = trace_record_eot(rec - 1, protocol);
+            }
 
-            if (kbd_enter_pressed()) {
-                break;
+            bool in_match = false;
+            uint32_t shown = 0;
+            while (rec < last) {
+                const tracelog_hdr_t *hdr = (const tracelog_hdr_t *)(gs_trace + gs_traceIndex[rec]);
+                if (hdr->isResponse == false) {
+                    in_match = (filter_len == 0) || (hdr->data_len && hdr->frame[0] == filter_cmd[0]);
+                }
+                bool show = (rec >= first) && in_match;
+
+                if (show == false && stateless) {
+                    if (prev_EOT) {
+                        previous_EOT = trace_record_eot(rec, protocol);
+                    }
+                    rec++;
+                    continue;
+                }
+
+                uint8_t old_printAndLog = g_printAndLog;
+                if (show == false) {
+                    g_printAndLog = 0;
+                }
+                tracepos = printTraceLine(gs_traceIndex[rec], gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount, trace_annot_get(rec, protocol, stateless));
+                g_printAndLog = old_printAndLog;
+                shown += show;
+
+                // topaz frames can be merged, continue after the last one used
+                while (rec < gs_traceIndexCnt && gs_traceIndex[rec] < tracepos) {
+                    rec++;
+                }
+
+                if (kbd_enter_pressed()) {
+                    break;
+                }
+            }
+
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(INFO, "records " _YELLOW_("%u") " - " _YELLOW_("%u") " of " _YELLOW_("%u") ",  " _YELLOW_("%u") " shown",
+                          first, (last) ? last - 1 : 0, gs_traceIndexCnt, shown);
+            if (last < gs_traceIndexCnt) {
+                PrintAndLogEx(HINT, "next records with " _YELLOW_("`--start %u`"), last);
+            }
+        } else {
+            while (tracepos < gs_traceLen) {
+                tracepos = printTraceLine(tracepos, gs_traceLen, gs_trace, protocol, show_wait_cycles, mark_crc, prev_EOT, use_us, dicKeys, dicKeysCount, NULL);
+
+                if (kbd_enter_pressed()) {
+                    break;
+                }
             }
         }
 
@@ -1558,12 +3537,252 @@ int CmdTraceList(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Collect the CMD_TRACE_STREAM records of a streaming sniff until its done_cmd reply arrives.
+// Records are appended to the client trace buffer,  and to filename (.trace) if given,  so the
+// session isn't limited by device memory.  A filename ending in .pcapng gets a pcap-ng capture instead.  With live,  records are annotated as with `trace list -t <protocol>`
+// as soon as they arrive.
+int ReceiveTraceStream(uint16_t done_cmd, const char *filename, bool live, uint8_t protocol) {
+
+    trace_index_reset();
+    free(gs_trace);
+    gs_trace = NULL;
+    gs_traceLen = 0;
+    uint32_t trace_size = 0;
+
+    FILE *f = NULL;
+    char *fn = NULL;
+    bool use_pcap = false;
+    trace_pcap_t pcap;
+    if (filename != NULL && strlen(filename)) {
+        use_pcap = str_endswith(filename, ".pcapng");
+        fn = newfilenamemcopy(filename, (use_pcap) ? ".pcapng" : ".trace");
+        if (fn == NULL) {
+            return PM3_EMALLOC;
+        }
+        if (use_pcap) {
+            if (trace_pcap_open(&pcap, fn, protocol) != PM3_SUCCESS) {
+                trace_pcap_close(&pcap);
+                free(fn);
+                return PM3_EFILE;
+            }
+        } else {
+            f = fopen(fn, "wb");
+            if (f == NULL) {
+                PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+                free(fn);
+                return PM3_EFILE;
+            }
+        }
+    }
+
+    trace_follow_t tf;
+    trace_follow_init(&tf, protocol);
+    if (live) {
+        if (protocol == PROTO_MIFARE || protocol == PROTO_MFPLUS) {
+            tf.keys = g_mifare_default_keys;
+            tf.keys_count = ARRAYLEN(g_mifare_default_keys);
+        }
+        trace_print_legend(protocol, false, false);
+        trace_print_table_header(protocol, false);
+    }
+
+    int res = PM3_SUCCESS;
+    uint32_t dropped = 0;
+    PacketResponseNG resp;
+    while (true) {
+
+        if (IsCommunicationThreadDead()) {
+            res = PM3_EIO;
+            break;
+        }
+
+        if (WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 250, false) == false) {
+            continue;
+        }
+
+        if (resp.cmd == done_cmd) {
+            break;
+        }
+
+        if (resp.cmd != CMD_TRACE_STREAM || resp.length < sizeof(trace_stream_t)) {
+            continue;
+        }
+
+        const trace_stream_t *chunk = (const trace_stream_t *)resp.data.asBytes;
+        uint32_t len = resp.length - sizeof(trace_stream_t);
+
+        if (chunk->dropped != dropped) {
+            PrintAndLogEx(WARNING, "device dropped " _RED_("%u") " records,  client too slow", chunk->dropped - dropped);
+            dropped = chunk->dropped;
+        }
+
+        if (trace_append(chunk->data, len, &trace_size) == false) {
+            res = PM3_EMALLOC;
+            break;
+        }
+
+        if (f) {
+            // flushed,  so `trace list --follow` in another client sees it straight away
+            fwrite(chunk->data, 1, len, f);
+            fflush(f);
+        }
+
+        if (use_pcap && trace_pcap_write(&pcap, gs_trace, gs_traceLen) != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "Failed to write `" _YELLOW_("%s") "`", fn);
+            res = PM3_EFILE;
+            break;
+        }
+
+        if (live) {
+            trace_follow_print(&tf, false);
+        } else {
+            PrintAndLogEx(INPLACE, "Streamed " _YELLOW_("%u") " bytes", gs_traceLen);
+        }
+    }
+    if (live) {
+        trace_follow_print(&tf, true);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (f) {
+        fclose(f);
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " bytes to binary file `" _YELLOW_("%s") "`", gs_traceLen, fn);
+    }
+    if (use_pcap) {
+        if (trace_pcap_close(&pcap) == PM3_SUCCESS) {
+            PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " packets to pcap-ng file `" _YELLOW_("%s") "`", pcap.packets, fn);
+        } else if (res == PM3_SUCCESS) {
+            res = PM3_EFILE;
+        }
+    }
+    free(fn);
+    return res;
+}
+
+// Receives the frame edges of a timing sniff until done_cmd,  optionally as CSV,
+// and prints the response time distributions.  Times are carrier periods (1/fc),
+// the 32 bit device clock wraps after ~5 minutes so the CSV extends it to 64 bits
+int ReceiveSniffTiming(uint16_t done_cmd, const char *filename, bool use_us) {
+
+    FILE *f = NULL;
+    char *fn = NULL;
+    if (filename != NULL && strlen(filename)) {
+        fn = newfilenamemcopy(filename, ".csv");
+        if (fn == NULL) {
+            return PM3_EMALLOC;
+        }
+        f = fopen(fn, "w");
+        if (f == NULL) {
+            PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fn);
+            free(fn);
+            return PM3_EFILE;
+        }
+        fprintf(f, "sof,eof,direction,len,bits,gap\n");
+    }
+
+    // reader EOF -> tag SOF,  and tag EOF -> next reader SOF
+    trace_stats_times_t response = {0}, reader = {0};
+    uint32_t frames[2] = {0};
+    uint64_t high = 0;
+    uint32_t last_sof = 0, last_eof = 0;
+    bool have_last = false, last_rsp = false;
+
+    int res = PM3_SUCCESS;
+    uint32_t dropped = 0;
+    PacketResponseNG resp;
+    while (res == PM3_SUCCESS) {
+
+        if (IsCommunicationThreadDead()) {
+            res = PM3_EIO;
+            break;
+        }
+
+        if (WaitForResponseTimeoutW(CMD_UNKNOWN, &resp, 250, false) == false) {
+            continue;
+        }
+
+        if (resp.cmd == done_cmd) {
+            break;
+        }
+
+        const sniff_timing_chunk_t *chunk = (const sniff_timing_chunk_t *)resp.data.asBytes;
+        if (resp.cmd != CMD_HF_ISO14443A_SNIFF_TIMING || resp.length < sizeof(sniff_timing_chunk_t) ||
+                resp.length != sizeof(sniff_timing_chunk_t) + chunk->count * sizeof(sniff_timing_t)) {
+            continue;
+        }
+
+        if (chunk->dropped != dropped) {
+            PrintAndLogEx(WARNING, "device dropped " _RED_("%u") " records,  client too slow", chunk->dropped - dropped);
+            dropped = chunk->dropped;
+            have_last = false;
+        }
+
+        for (uint16_t i = 0; i < chunk->count && res == PM3_SUCCESS; i++) {
+            const sniff_timing_t *r = &chunk->rec[i];
+            bool rsp = (r->flags & SNIFF_TIMING_RESPONSE);
+            frames[rsp]++;
+
+            if (have_last && r->sof < last_sof) {
+                high += 0x100000000ULL;
+            }
+
+            uint32_t gap = (have_last) ? r->sof - last_eof : 0;
+            if (have_last && rsp != last_rsp && (int32_t)gap >= 0) {
+                if (trace_stats_times_add((rsp) ? &response : &reader, gap) == false) {
+                    res = PM3_EMALLOC;
+                }
+            }
+
+            if (f) {
+                fprintf(f, "%" PRIu64 ",%" PRIu64 ",%s,%u,%u,%u\n"
+                        , high + r->sof
+                        , high + r->sof + (uint32_t)(r->eof - r->sof)
+                        , (rsp) ? "tag" : "reader"
+                        , r->len
+                        , r->bits
+                        , gap
+                       );
+            }
+
+            last_sof = r->sof;
+            last_eof = r->eof;
+            last_rsp = rsp;
+            have_last = true;
+        }
+
+        PrintAndLogEx(INPLACE, "Frames " _YELLOW_("%u") " reader, " _YELLOW_("%u") " tag", frames[0], frames[1]);
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    if (f) {
+        fclose(f);
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%u") " frames to `" _YELLOW_("%s") "`", frames[0] + frames[1], fn);
+    }
+    free(fn);
+
+    qsort(response.v, response.count, sizeof(uint32_t), trace_stats_cmp);
+    qsort(reader.v, reader.count, sizeof(uint32_t), trace_stats_cmp);
+
+    PrintAndLogEx(INFO, "--- " _CYAN_("Timing") " in %-13s ---------------------------", (use_us) ? "microseconds" : "trace ticks");
+    PrintAndLogEx(INFO, "%-16s %8s %8s %8s %8s %8s", "", "min", "p50", "p90", "p99", "max");
+    trace_stats_times_print("tag response", &response, use_us);
+    trace_stats_times_print("reader response", &reader, use_us);
+    PrintAndLogEx(NORMAL, "");
+
+    free(response.v);
+    free(reader.v);
+    return res;
+}
+
 static command_t CommandTable[] = {
     {"help",    CmdHelp,          AlwaysAvailable, "This help"},
+    {"diff",    CmdTraceDiff,     AlwaysAvailable, "Compare the frames of two trace files"},
     {"extract", CmdTraceExtract,  AlwaysAvailable, "Extract authentication challenges found in trace"},
     {"list",    CmdTraceList,     AlwaysAvailable, "List protocol data in trace buffer"},
     {"load",    CmdTraceLoad,     AlwaysAvailable, "Load trace from file"},
+    {"merge",   CmdTraceMerge,    AlwaysAvailable, "Merge trace files by timestamp"},
     {"save",    CmdTraceSave,     AlwaysAvailable, "Save trace buffer to file"},
+    {"stats",   CmdTraceStats,    AlwaysAvailable, "Command counts and timing percentiles of the trace"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -24,6 +24,9 @@
 int CmdTrace(const char *Cmd);
 int CmdTraceList(const char *Cmd);
 int CmdTraceListAlias(const char *Cmd, const char *alias, const char *protocol);
-bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len);
+bool ImportTraceBuffer(const uint8_t *trace_src, uint32_t trace_len);
+int LoadTraceFile(const char *filename, uint8_t **trace, uint32_t *trace_len, uint32_t **index, uint32_t *count);
+int ReceiveTraceStream(uint16_t done_cmd, const char *filename, bool live, uint8_t protocol);
+int ReceiveSniffTiming(uint16_t done_cmd, const char *filename, bool use_us);
 
 #endif
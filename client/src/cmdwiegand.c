@@ -111,18 +111,121 @@ int CmdWiegandEncode(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// one line per message,  the first format with a good parity wins
+static void wiegand_print_bulk(const char *raw, const wiegand_decode_t *res) {
+    if (res->count == 0) {
+        PrintAndLogEx(INFO, "%-26s " _RED_("no matching format"), raw);
+        return;
+    }
+
+    uint8_t best = 0;
+    for (uint8_t i = 0; i < res->count; i++) {
+        cardformat_t fmt = HIDGetCardFormat(res->format_idx[i]);
+        if (fmt.Fields.hasParity && res->card[i].ParityValid) {
+            best = i;
+            break;
+        }
+    }
+
+    cardformat_t fmt = HIDGetCardFormat(res->format_idx[best]);
+    const wiegand_card_t *card = &res->card[best];
+    PrintAndLogEx(SUCCESS, "%-26s [%-8s] FC: " _GREEN_("%u") "  CN: " _GREEN_("%" PRIu64) "%s%s"
+                  , raw
+                  , fmt.Name
+                  , card->FacilityCode
+                  , card->CardNumber
+                  , (fmt.Fields.hasParity == false) ? "" : (card->ParityValid) ? "  parity ( ok )" : "  parity ( " _RED_("fail") " )"
+                  , (res->count > 1) ? "  +more" : ""
+                 );
+}
+
+#define WIEGAND_BULK_CHUNK 256
+
+static int wiegand_decode_file(const char *filename) {
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", filename);
+        return PM3_EFILE;
+    }
+
+    wiegand_message_t *packed = calloc(WIEGAND_BULK_CHUNK, sizeof(wiegand_message_t));
+    wiegand_decode_t *res = calloc(WIEGAND_BULK_CHUNK, sizeof(wiegand_decode_t));
+    char (*raw)[40] = calloc(WIEGAND_BULK_CHUNK, 40);
+    if (packed == NULL || res == NULL || raw == NULL) {
+        PrintAndLogEx(WARNING, "failed to allocate memory");
+        free(packed);
+        free(res);
+        free(raw);
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    size_t total = 0, matched = 0, n = 0;
+    uint32_t lineno = 0;
+    char line[256];
+    bool eof = false;
+    while (eof == false) {
+
+        eof = (fgets(line, sizeof(line), f) == NULL);
+        if (eof == false) {
+            lineno++;
+
+            // strip comments,  whitespace and line endings
+            char *p = line;
+            while (*p == ' ' || *p == '\t') {
+                p++;
+            }
+            size_t len = strcspn(p, " \t\r\n#");
+            p[len] = '\0';
+            if (len == 0) {
+                continue;
+            }
+
+            uint32_t top = 0, mid = 0, bot = 0;
+            if (len >= sizeof(raw[0]) || hexstring_to_u96(&top, &mid, &bot, p) != (int)len) {
+                PrintAndLogEx(WARNING, "line %u, not a raw hex value `%s`", lineno, p);
+                continue;
+            }
+
+            packed[n] = initialize_message_object(top, mid, bot, 0);
+            memcpy(raw[n], p, len + 1);
+            n++;
+        }
+
+        if (n == WIEGAND_BULK_CHUNK || (eof && n)) {
+            matched += HIDDecodeBatch(packed, n, res);
+            for (size_t i = 0; i < n; i++) {
+                wiegand_print_bulk(raw[i], &res[i]);
+            }
+            total += n;
+            n = 0;
+        }
+    }
+    fclose(f);
+
+    free(packed);
+    free(res);
+    free(raw);
+
+    PrintAndLogEx(INFO, "Decoded " _YELLOW_("%zu") " of " _YELLOW_("%zu") " values", matched, total);
+    return PM3_SUCCESS;
+}
+
 int CmdWiegandDecode(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "wiegand decode",
-                  "Decode raw hex or binary to wiegand format",
-                  "wiegand decode --raw 2006f623ae"
+                  "Decode raw hex or binary to wiegand format.\n"
+                  "A file with one raw hex value per line gets bulk decoded,  one line per value",
+                  "wiegand decode --raw 2006f623ae\n"
+                  "wiegand decode -f badges.txt"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("r", "raw", "<hex>", "raw hex to be decoded"),
         arg_str0("b", "bin", "<bin>", "binary string to be decoded"),
+        arg_str0("f", "file", "<fn>", "file with raw hex values to be decoded"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -133,8 +236,16 @@ int CmdWiegandDecode(const char *Cmd) {
     int blen = 0;
     uint8_t binarr[100] = {0x00};
     int res = CLIParamBinToBuf(arg_get_str(ctx, 2), binarr, sizeof(binarr), &blen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     CLIParserFree(ctx);
 
+    if (fnlen) {
+        return wiegand_decode_file(filename);
+    }
+
     if (res) {
         PrintAndLogEx(FAILED, "Error parsing binary string");
         return PM3_EINVARG;
@@ -22,6 +22,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <lz4.h>
 
 #include "uart/uart.h"
 #include "ui.h"
@@ -30,55 +33,134 @@
 #include "util_posix.h" // msclock
 #include "util_darwin.h" // en/dis-ableNapp();
 #include "usart_defs.h"
+#include "commonutil.h"  // ARRAYLEN
+#include "pm3metrics.h"
 
 // #define COMMS_DEBUG
 // #define COMMS_DEBUG_RAW
 
-// Serial port that we are communicating with the PM3 on.
-static serial_port sp = NULL;
-
-communication_arg_t g_conn;
-capabilities_t g_pm3_capabilities;
-
-static pthread_t communication_thread;
-static pthread_t reconnect_thread;
-
-static bool reconnect_ok = false;
-
-static bool comm_thread_dead = false;
-static bool comm_raw_mode = false;
-static uint8_t *comm_raw_data = NULL;
-static size_t comm_raw_len = 0;
-static size_t comm_raw_pos = 0;
-
-// Transmit buffer.
-static PacketCommandOLD txBuffer;
-static PacketCommandNGRaw txBufferNG;
-static size_t txBufferNGLen;
-static bool txBuffer_pending = false;
-static pthread_mutex_t txBufferMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t txBufferSig = PTHREAD_COND_INITIALIZER;
-
 // Used by PacketResponseReceived as a ring buffer for messages that are yet to be
 // processed by a command handler (WaitForResponse{,Timeout})
-static PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
+//
+// Single producer (uart_communication) / single consumer (main thread), lock free.
+// head is only written by the producer, tail only by the consumer.
+// When a ring fills up,  the producer links a new ring twice as big and moves over to it.
+// The consumer follows once the old ring is drained, and frees it.
+typedef struct rx_ring_s {
+    PacketResponseNG *slots;
+    uint32_t size;
+    uint32_t head;              // free running,  slot = head % size
+    uint32_t tail;              // free running,  slot = tail % size
+    struct rx_ring_s *next;     // set by the producer when it moved to a bigger ring
+    bool is_static;
+} rx_ring_t;
+
+// Slot of the pipelined command queue,  see SendCommandNGQueued
+typedef struct {
+    bool in_use;
+    bool done;
+    uint32_t seq;
+    uint16_t resp_cmd;
+    PacketResponseNG resp;
+} cmd_queue_entry_t;
+
+// Round trip timings,  command sent -> first matching reply received.
+typedef struct {
+    cmd_timing_t stats;
+    uint64_t sent_us;      // time of the last send still waiting for its reply
+    bool pending;
+} cmd_timing_slot_t;
+
+// Everything needed to talk to one device.
+// The main device lives in comms_main,  more can be attached with AttachProxmark.
+// Functions without a device argument work on the device selected for the calling
+// thread with SetCurrentDevice,  the main device by default.
+struct comms_ctx_s {
+    // Serial port that we are communicating with the PM3 on.
+    serial_port sp;
+    communication_arg_t conn;
+    pthread_t communication_thread;
+
+    bool comm_thread_dead;
+    bool comm_raw_mode;
+    uint8_t *comm_raw_data;
+    size_t comm_raw_len;
+    size_t comm_raw_pos;
+    // leave raw mode by itself once the raw buffer is full, so the next framed packet isn't lost
+    bool comm_raw_autostop;
+
+    // Transmit buffer.
+    PacketCommandOLD txBuffer;
+    PacketCommandNGRaw txBufferNG;
+    size_t txBufferNGLen;
+    bool txBuffer_pending;
+    pthread_mutex_t txBufferMutex;
+    pthread_cond_t txBufferSig;
+
+    // ring written by the producer / read by the consumer
+    rx_ring_t rx_ring_first;
+    rx_ring_t *rx_ring_write;
+    rx_ring_t *rx_ring_read;
+    comms_stats_t rx_stats;
+
+    // signaled by the communication thread whenever something arrived (reply or raw data)
+    // waiters make a note of rx_event_gen before looking, so no wake up gets lost.
+    // The mutex is only taken by the producer when someone is actually waiting.
+    pthread_mutex_t rxBufferMutex;
+    pthread_cond_t rxBufferSig;
+    uint32_t rx_event_gen;
+    uint32_t rx_waiters;
+
+    // start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
+    // as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
+    uint64_t timeout_start_time;
+    uint64_t last_packet_time;
+
+    cmd_queue_entry_t cmd_queue[CMD_QUEUE_SIZE];
+    uint32_t cmd_queue_seq;
+
+    // written from both the sending thread and the communication thread
+    pthread_mutex_t timingMutex;
+    cmd_timing_slot_t cmd_timings[CMD_TIMING_SLOTS];
+    uint8_t cmd_timings_num;
+    int16_t cmd_timing_last;
+};
 
-// Points to the next empty position to write to
-static int cmd_head = 0;
+static PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
 
-// Points to the position of the last unread command
-static int cmd_tail = 0;
+static comms_ctx_t comms_main = {
+    .sp = NULL,
+    .txBufferMutex = PTHREAD_MUTEX_INITIALIZER,
+    .txBufferSig = PTHREAD_COND_INITIALIZER,
+    .rx_ring_first = { rxBuffer, CMD_BUFFER_SIZE, 0, 0, NULL, true },
+    .rx_ring_write = &comms_main.rx_ring_first,
+    .rx_ring_read = &comms_main.rx_ring_first,
+    .rxBufferMutex = PTHREAD_MUTEX_INITIALIZER,
+    .rxBufferSig = PTHREAD_COND_INITIALIZER,
+    .timingMutex = PTHREAD_MUTEX_INITIALIZER,
+    .cmd_timing_last = -1,
+};
+
+// device used by the calling thread,  NULL means the main device
+static __thread comms_ctx_t *comms_current = NULL;
+
+static comms_ctx_t *comms_ctx(void) {
+    return (comms_current) ? comms_current : &comms_main;
+}
 
-// to lock rxBuffer operations from different threads
-static pthread_mutex_t rxBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+capabilities_t g_pm3_capabilities;
 
-// Global start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
-// as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
-static uint64_t timeout_start_time;
+static pthread_t reconnect_thread;
+static bool reconnect_ok = false;
 
-static uint64_t last_packet_time;
+// max time to sleep in one go while waiting,  so timeouts and a dead thread are still noticed
+#define COMM_EVENT_WAIT_SLICE_MS 100
 
 static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd);
+static bool dl_raw(uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t flags, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+static bool dl_lz4(uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t flags, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+static bool dl_check_ack(const uint8_t *dest, uint32_t bytes, const PacketResponseNG *response);
+static bool dl_use_lz4(void);
 
 // Simple alias to track usages linked to the Bootloader, these commands must not be migrated.
 // - commands sent to enter bootloader mode as we might have to talk to old firmwares
@@ -87,7 +169,140 @@ void SendCommandBL(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, vo
     SendCommandOLD(cmd, arg0, arg1, arg2, data, len);
 }
 
+// upper limit (exclusive) of each histogram bucket, in ms.  Last bucket takes the rest
+static const uint32_t cmd_timing_limits[CMD_TIMING_BUCKETS] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, UINT32_MAX};
+
+static int16_t cmd_timing_find(uint16_t cmd, bool create) {
+    comms_ctx_t *ctx = comms_ctx();
+    for (uint8_t i = 0; i < ctx->cmd_timings_num; i++) {
+        if (ctx->cmd_timings[i].stats.cmd == cmd) {
+            return i;
+        }
+    }
+    if (create == false || ctx->cmd_timings_num == CMD_TIMING_SLOTS) {
+        return -1;
+    }
+    memset(&ctx->cmd_timings[ctx->cmd_timings_num], 0, sizeof(ctx->cmd_timings[0]));
+    ctx->cmd_timings[ctx->cmd_timings_num].stats.cmd = cmd;
+    ctx->cmd_timings[ctx->cmd_timings_num].stats.min_us = UINT32_MAX;
+    return ctx->cmd_timings_num++;
+}
+
+static void cmd_timing_sent(uint16_t cmd) {
+    comms_ctx_t *ctx = comms_ctx();
+    pthread_mutex_lock(&ctx->timingMutex);
+    int16_t i = cmd_timing_find(cmd, true);
+    if (i >= 0) {
+        ctx->cmd_timings[i].stats.sent++;
+        ctx->cmd_timings[i].sent_us = usclock();
+        ctx->cmd_timings[i].pending = true;
+    }
+    ctx->cmd_timing_last = i;
+    pthread_mutex_unlock(&ctx->timingMutex);
+}
+
+// device statuses for a failed exchange with the card,  not for "nothing found"
+static bool cmd_status_rf_error(int16_t status) {
+    switch (status) {
+        case PM3_ETIMEOUT:
+        case PM3_ERFTRANS:
+        case PM3_EIO:
+        case PM3_EWRONGANSWER:
+        case PM3_ECARDEXCHANGE:
+        case PM3_ECRC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void cmd_timing_replied(uint16_t cmd, int16_t status) {
+    comms_ctx_t *ctx = comms_ctx();
+    uint64_t now = usclock();
+    pthread_mutex_lock(&ctx->timingMutex);
+
+    int16_t i = cmd_timing_find(cmd, false);
+    if (i < 0 || ctx->cmd_timings[i].pending == false) {
+        // old style commands answers with ACK/NACK,  account it to the last command sent
+        if ((cmd == CMD_ACK || cmd == CMD_NACK) && ctx->cmd_timing_last >= 0) {
+            i = ctx->cmd_timing_last;
+        } else {
+            i = -1;
+        }
+    }
+
+    if (i >= 0 && ctx->cmd_timings[i].pending) {
+        cmd_timing_t *t = &ctx->cmd_timings[i].stats;
+        uint64_t d = now - ctx->cmd_timings[i].sent_us;
+        uint32_t us = (d > UINT32_MAX) ? UINT32_MAX : (uint32_t)d;
+        ctx->cmd_timings[i].pending = false;
+
+        t->replied++;
+        if (cmd_status_rf_error(status)) {
+            t->errors++;
+        }
+        t->total_us += us;
+        if (us < t->min_us) {
+            t->min_us = us;
+        }
+        if (us > t->max_us) {
+            t->max_us = us;
+        }
+
+        uint8_t b = 0;
+        while (b < CMD_TIMING_BUCKETS - 1 && us / 1000 >= cmd_timing_limits[b]) {
+            b++;
+        }
+        t->hist[b]++;
+    }
+    pthread_mutex_unlock(&ctx->timingMutex);
+}
+
+static void cmd_timing_timeout(uint32_t cmd) {
+    comms_ctx_t *ctx = comms_ctx();
+    pthread_mutex_lock(&ctx->timingMutex);
+    int16_t i = cmd_timing_find(cmd, false);
+    if (i >= 0) {
+        ctx->cmd_timings[i].stats.timeouts++;
+    }
+    pthread_mutex_unlock(&ctx->timingMutex);
+}
+
+/**
+ * @brief Copies the collected per command timings
+ * @param timings array to copy to
+ * @param n number of entries in the array
+ * @return number of entries copied
+ */
+size_t GetCommandTimings(cmd_timing_t *timings, size_t n) {
+    comms_ctx_t *ctx = comms_ctx();
+    pthread_mutex_lock(&ctx->timingMutex);
+    size_t cnt = MIN(n, ctx->cmd_timings_num);
+    for (size_t i = 0; i < cnt; i++) {
+        memcpy(&timings[i], &ctx->cmd_timings[i].stats, sizeof(cmd_timing_t));
+    }
+    pthread_mutex_unlock(&ctx->timingMutex);
+    return cnt;
+}
+
+uint32_t GetCommandTimingBucketLimit(uint8_t bucket) {
+    if (bucket >= CMD_TIMING_BUCKETS) {
+        return UINT32_MAX;
+    }
+    return cmd_timing_limits[bucket];
+}
+
+void ResetCommandTimings(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    pthread_mutex_lock(&ctx->timingMutex);
+    memset(ctx->cmd_timings, 0, sizeof(ctx->cmd_timings));
+    ctx->cmd_timings_num = 0;
+    ctx->cmd_timing_last = -1;
+    pthread_mutex_unlock(&ctx->timingMutex);
+}
+
 void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+    comms_ctx_t *ctx = comms_ctx();
     PacketCommandOLD c = {CMD_UNKNOWN, {0, 0, 0}, {{0}}};
     c.cmd = cmd;
     c.arg[0] = arg0;
@@ -110,28 +325,30 @@ void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
         return;
     }
 
-    pthread_mutex_lock(&txBufferMutex);
+    pthread_mutex_lock(&ctx->txBufferMutex);
     /**
     This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
     but comm thread just spins here. Not good.../holiman
     **/
-    while (txBuffer_pending) {
+    while (ctx->txBuffer_pending) {
         // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+        pthread_cond_wait(&ctx->txBufferSig, &ctx->txBufferMutex);
     }
 
-    txBuffer = c;
-    txBuffer_pending = true;
+    ctx->txBuffer = c;
+    ctx->txBuffer_pending = true;
+    cmd_timing_sent(cmd);
 
     // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    pthread_cond_signal(&ctx->txBufferSig);
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&ctx->txBufferMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
 
 static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool ng) {
+    comms_ctx_t *ctx = comms_ctx();
 #ifdef COMMS_DEBUG
     PrintAndLogEx(INFO, "Sending %s", ng ? "NG" : "MIX");
 #endif
@@ -145,52 +362,54 @@ static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool
         return;
     }
 
-    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&txBufferNG + sizeof(PacketCommandNGPreamble) + len);
+    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&ctx->txBufferNG + sizeof(PacketCommandNGPreamble) + len);
 
-    pthread_mutex_lock(&txBufferMutex);
+    pthread_mutex_lock(&ctx->txBufferMutex);
     /**
     This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
     but comm thread just spins here. Not good.../holiman
     **/
-    while (txBuffer_pending) {
+    while (ctx->txBuffer_pending) {
         // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
+        pthread_cond_wait(&ctx->txBufferSig, &ctx->txBufferMutex);
     }
 
-    txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
-    txBufferNG.pre.ng = ng;
-    txBufferNG.pre.length = len;
-    txBufferNG.pre.cmd = cmd;
+    ctx->txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
+    ctx->txBufferNG.pre.ng = ng;
+    ctx->txBufferNG.pre.length = len;
+    ctx->txBufferNG.pre.cmd = cmd;
     if (len > 0 && data) {
-        memcpy(&txBufferNG.data, data, len);
+        memcpy(&ctx->txBufferNG.data, data, len);
     }
 
-    if ((g_conn.send_via_fpc_usart && g_conn.send_with_crc_on_fpc) || ((!g_conn.send_via_fpc_usart) && g_conn.send_with_crc_on_usb)) {
+    if ((ctx->conn.send_via_fpc_usart && ctx->conn.send_with_crc_on_fpc) || ((!ctx->conn.send_via_fpc_usart) && ctx->conn.send_with_crc_on_usb)) {
         uint8_t first = 0, second = 0;
-        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
+        compute_crc(CRC_14443_A, (uint8_t *)&ctx->txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
         tx_post->crc = (first << 8) + second;
     } else {
         tx_post->crc = COMMANDNG_POSTAMBLE_MAGIC;
     }
 
-    txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+    ctx->txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+
+    cmd_timing_sent(cmd);
 
 #ifdef COMMS_DEBUG_RAW
-    print_hex_break((uint8_t *)&txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
+    print_hex_break((uint8_t *)&ctx->txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
     if (ng) {
-        print_hex_break((uint8_t *)&txBufferNG.data, len, 32);
+        print_hex_break((uint8_t *)&ctx->txBufferNG.data, len, 32);
     } else {
-        print_hex_break((uint8_t *)&txBufferNG.data, 3 * sizeof(uint64_t), 32);
-        print_hex_break((uint8_t *)&txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&ctx->txBufferNG.data, 3 * sizeof(uint64_t), 32);
+        print_hex_break((uint8_t *)&ctx->txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
     }
     print_hex_break((uint8_t *)tx_post, sizeof(PacketCommandNGPostamble), 32);
 #endif
-    txBuffer_pending = true;
+    ctx->txBuffer_pending = true;
 
     // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    pthread_cond_signal(&ctx->txBufferSig);
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&ctx->txBufferMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
@@ -213,6 +432,33 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
 }
 
 
+// consumer side,  move over to the next ring if the current one is drained
+static rx_ring_t *rx_ring_get_readable(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    while (true) {
+        rx_ring_t *r = ctx->rx_ring_read;
+        if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != r->tail) {
+            return r;
+        }
+
+        rx_ring_t *next = __atomic_load_n(&r->next, __ATOMIC_ACQUIRE);
+        if (next == NULL) {
+            return NULL;
+        }
+
+        // producer doesn't touch r anymore once next is set,  look one last time
+        if (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != r->tail) {
+            return r;
+        }
+
+        ctx->rx_ring_read = next;
+        if (r->is_static == false) {
+            free(r->slots);
+            free(r);
+        }
+    }
+}
+
 /**
  * @brief This method should be called when sending a new command to the pm3. In case any old
  *  responses from previous commands are stored in the buffer, a call to this method should clear them.
@@ -220,52 +466,161 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
  *  operation. Right now we'll just have to live with this.
  */
 void clearCommandBuffer(void) {
-    //This is a very simple operation
-    pthread_mutex_lock(&rxBufferMutex);
-    cmd_tail = cmd_head;
-    pthread_mutex_unlock(&rxBufferMutex);
+    rx_ring_t *r;
+    while ((r = rx_ring_get_readable()) != NULL) {
+        __atomic_store_n(&r->tail, __atomic_load_n(&r->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        // the ring the producer is writing into,  we are done
+        if (__atomic_load_n(&r->next, __ATOMIC_ACQUIRE) == NULL) {
+            break;
+        }
+    }
 }
+
+static void signalCommEvent(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    __atomic_add_fetch(&ctx->rx_event_gen, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ctx->rx_waiters, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&ctx->rxBufferMutex);
+        pthread_cond_broadcast(&ctx->rxBufferSig);
+        pthread_mutex_unlock(&ctx->rxBufferMutex);
+    }
+}
+
 /**
  * @brief storeCommand stores a USB command in a circular buffer
  * @param UC
  */
 static void storeReply(const PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
-    if ((cmd_head + 1) % CMD_BUFFER_SIZE == cmd_tail) {
-        //If these two are equal, we're about to overwrite in the
-        // circular buffer.
-        PrintAndLogEx(FAILED, "WARNING: Command buffer about to overwrite command! This needs to be fixed!");
-        fflush(stdout);
+    comms_ctx_t *ctx = comms_ctx();
+    rx_ring_t *r = ctx->rx_ring_write;
+    uint32_t head = r->head;
+
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >= r->size) {
+        // full,  grow if we can
+        uint32_t newsize = r->size * 2;
+        rx_ring_t *n = NULL;
+        if (newsize <= CMD_BUFFER_MAX_SIZE) {
+            n = calloc(1, sizeof(rx_ring_t));
+            if (n) {
+                n->slots = calloc(newsize, sizeof(PacketResponseNG));
+                if (n->slots == NULL) {
+                    free(n);
+                    n = NULL;
+                }
+            }
+        }
+
+        if (n == NULL) {
+            __atomic_add_fetch(&ctx->rx_stats.overflows, 1, __ATOMIC_RELAXED);
+            PrintAndLogEx(FAILED, "WARNING: Command buffer full, dropping reply 0x%04x", packet->cmd);
+            fflush(stdout);
+            return;
+        }
+
+        n->size = newsize;
+        __atomic_store_n(&ctx->rx_stats.capacity, newsize, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&ctx->rx_stats.grows, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&r->next, n, __ATOMIC_RELEASE);
+        ctx->rx_ring_write = n;
+        r = n;
+        head = 0;
     }
+
     //Store the command at the 'head' location
-    PacketResponseNG *destination = &rxBuffer[cmd_head];
-    memcpy(destination, packet, sizeof(PacketResponseNG));
+    memcpy(&r->slots[head % r->size], packet, sizeof(PacketResponseNG));
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
 
-    //increment head and wrap
-    cmd_head = (cmd_head + 1) % CMD_BUFFER_SIZE;
-    pthread_mutex_unlock(&rxBufferMutex);
+    __atomic_add_fetch(&ctx->rx_stats.stored, 1, __ATOMIC_RELAXED);
+    uint32_t depth = head + 1 - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if (depth > __atomic_load_n(&ctx->rx_stats.max_depth, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&ctx->rx_stats.max_depth, depth, __ATOMIC_RELAXED);
+    }
+
+    signalCommEvent();
 }
+
+static uint32_t getCommEventGen(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    return __atomic_load_n(&ctx->rx_event_gen, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Sleeps until the communication thread signals an event newer than gen, or ms_wait has elapsed
+ */
+static void waitForCommEvent(uint32_t gen, uint32_t ms_wait) {
+    comms_ctx_t *ctx = comms_ctx();
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    uint64_t nsec = (uint64_t)now.tv_usec * 1000 + (uint64_t)ms_wait * 1000000;
+    struct timespec ts = {
+        .tv_sec = now.tv_sec + (nsec / 1000000000),
+        .tv_nsec = nsec % 1000000000,
+    };
+
+    pthread_mutex_lock(&ctx->rxBufferMutex);
+    __atomic_add_fetch(&ctx->rx_waiters, 1, __ATOMIC_SEQ_CST);
+    while (gen == __atomic_load_n(&ctx->rx_event_gen, __ATOMIC_SEQ_CST)) {
+        if (pthread_cond_timedwait(&ctx->rxBufferSig, &ctx->rxBufferMutex, &ts) == ETIMEDOUT) {
+            break;
+        }
+    }
+    __atomic_sub_fetch(&ctx->rx_waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ctx->rxBufferMutex);
+}
+
+// how long to wait for the next event,  given when the timeout started
+static uint32_t commEventWaitTime(size_t ms_timeout, uint64_t start_clk) {
+    if (ms_timeout == (size_t) - 1) {
+        return COMM_EVENT_WAIT_SLICE_MS;
+    }
+    uint64_t elapsed = msclock() - start_clk;
+    if (elapsed >= ms_timeout) {
+        return 1;
+    }
+    return MIN(ms_timeout - elapsed, COMM_EVENT_WAIT_SLICE_MS);
+}
+
 /**
  * @brief getCommand gets a command from an internal circular buffer.
  * @param response location to write command
  * @return 1 if response was returned, 0 if nothing has been received
  */
 static int getReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
+    rx_ring_t *r = rx_ring_get_readable();
     //If head == tail, there's nothing to read, or if we just got initialized
-    if (cmd_head == cmd_tail)  {
-        pthread_mutex_unlock(&rxBufferMutex);
+    if (r == NULL) {
         return 0;
     }
 
     //Pick out the next unread command
-    memcpy(packet, &rxBuffer[cmd_tail], sizeof(PacketResponseNG));
+    memcpy(packet, &r->slots[r->tail % r->size], sizeof(PacketResponseNG));
+    __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
 
-    //Increment tail - this is a circular buffer, so modulo buffer size
-    cmd_tail = (cmd_tail + 1) % CMD_BUFFER_SIZE;
+/**
+ * @brief Returns a snapshot of the reply buffer statistics
+ */
+void GetCommunicationStats(comms_stats_t *stats) {
+    comms_ctx_t *ctx = comms_ctx();
+    stats->stored = __atomic_load_n(&ctx->rx_stats.stored, __ATOMIC_RELAXED);
+    stats->overflows = __atomic_load_n(&ctx->rx_stats.overflows, __ATOMIC_RELAXED);
+    stats->grows = __atomic_load_n(&ctx->rx_stats.grows, __ATOMIC_RELAXED);
+    stats->max_depth = __atomic_load_n(&ctx->rx_stats.max_depth, __ATOMIC_RELAXED);
+    stats->capacity = __atomic_load_n(&ctx->rx_stats.capacity, __ATOMIC_RELAXED);
+    if (stats->capacity == 0) {
+        stats->capacity = CMD_BUFFER_SIZE;
+    }
+}
 
-    pthread_mutex_unlock(&rxBufferMutex);
-    return 1;
+void ResetCommunicationStats(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    __atomic_store_n(&ctx->rx_stats.stored, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctx->rx_stats.overflows, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctx->rx_stats.grows, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ctx->rx_stats.max_depth, 0, __ATOMIC_RELAXED);
 }
 
 //-----------------------------------------------------------------------------
@@ -273,12 +628,13 @@ static int getReply(PacketResponseNG *packet) {
 // that we weren't necessarily expecting, for example a debug print.
 //-----------------------------------------------------------------------------
 static void PacketResponseReceived(PacketResponseNG *packet) {
+    comms_ctx_t *ctx = comms_ctx();
 
     // we got a packet, reset WaitForResponseTimeout timeout
-    uint64_t prev_clk = __atomic_load_n(&last_packet_time, __ATOMIC_SEQ_CST);
+    uint64_t prev_clk = __atomic_load_n(&ctx->last_packet_time, __ATOMIC_SEQ_CST);
     uint64_t clk = msclock();
-    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&last_packet_time, clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->last_packet_time, clk, __ATOMIC_SEQ_CST);
     (void) prev_clk;
 //    PrintAndLogEx(NORMAL, "[%07"PRIu64"] RECV %s magic %08x length %04x status %04x crc %04x cmd %04x",
 //                clk - prev_clk, packet->ng ? "NG" : "OLD", packet->magic, packet->length, packet->status, packet->crc, packet->cmd);
@@ -341,6 +697,10 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
         // CMD_DOWNLOAD_BIGBUF packages which is not dealt with. I wonder if simply ignoring them will
         // work. lets try it.
         default: {
+            cmd_timing_replied(packet->cmd, packet->status);
+            if (cmd_status_rf_error(packet->status)) {
+                pm3_metrics_rf_error();
+            }
             storeReply(packet);
             break;
         }
@@ -387,8 +747,9 @@ void *uart_reconnect(void *targ) {
     return NULL;
 }
 
+// only the main device reconnects by itself
 void StartReconnectProxmark(void) {
-    pthread_create(&reconnect_thread, NULL, &uart_reconnect, &g_conn);
+    pthread_create(&reconnect_thread, NULL, &uart_reconnect, &comms_main.conn);
 }
 
 bool IsReconnectedOk(void) {
@@ -406,7 +767,10 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *uart_communication(void *targ) {
-    const communication_arg_t *connection = (communication_arg_t *)targ;
+    comms_ctx_t *ctx = (comms_ctx_t *)targ;
+    const communication_arg_t *connection = &ctx->conn;
+    // storeReply & co work on the current device
+    comms_current = ctx;
     uint32_t rxlen;
     bool commfailed = false;
     PacketResponseNG rx;
@@ -428,29 +792,34 @@ __attribute__((force_align_arg_pointer))
         // Signal to main thread that communications seems off.
         // main thread will kill and restart this thread.
         if (commfailed) {
-            if (g_conn.last_command != CMD_HARDWARE_RESET) {
+            if (ctx->conn.last_command != CMD_HARDWARE_RESET) {
                 PrintAndLogEx(WARNING, "\nCommunicating with Proxmark3 device " _RED_("failed"));
             }
-            __atomic_test_and_set(&comm_thread_dead, __ATOMIC_SEQ_CST);
+            __atomic_test_and_set(&ctx->comm_thread_dead, __ATOMIC_SEQ_CST);
+            signalCommEvent();
             break;
         }
 
-        bool is_receiving_raw = __atomic_load_n(&comm_raw_mode, __ATOMIC_SEQ_CST);
+        bool is_receiving_raw = __atomic_load_n(&ctx->comm_raw_mode, __ATOMIC_SEQ_CST);
 
         if (is_receiving_raw) {
-            uint8_t *bufferData = __atomic_load_n(&comm_raw_data, __ATOMIC_SEQ_CST); // read only
-            size_t bufferLen = __atomic_load_n(&comm_raw_len, __ATOMIC_SEQ_CST); // read only
-            size_t bufferPos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
+            uint8_t *bufferData = __atomic_load_n(&ctx->comm_raw_data, __ATOMIC_SEQ_CST); // read only
+            size_t bufferLen = __atomic_load_n(&ctx->comm_raw_len, __ATOMIC_SEQ_CST); // read only
+            size_t bufferPos = __atomic_load_n(&ctx->comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
             if (bufferPos < bufferLen) {
                 size_t rxMaxLen = bufferLen - bufferPos;
 
                 rxMaxLen = MIN(COMM_RAW_RECEIVE_LEN, rxMaxLen);
 
-                res = uart_receive(sp, bufferData + bufferPos, rxMaxLen, &rxlen);
+                res = uart_receive(ctx->sp, bufferData + bufferPos, rxMaxLen, &rxlen);
                 if (res == PM3_SUCCESS) {
                     uint64_t clk = msclock();
-                    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-                    __atomic_store_n(&comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&ctx->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&ctx->comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
+                    if ((bufferPos + rxlen >= bufferLen) && __atomic_load_n(&ctx->comm_raw_autostop, __ATOMIC_SEQ_CST)) {
+                        __atomic_store_n(&ctx->comm_raw_mode, false, __ATOMIC_SEQ_CST);
+                    }
+                    signalCommEvent();
                 } else if (res != PM3_ENODATA) {
                     PrintAndLogEx(WARNING, "Error when reading raw data: %zu/%zu, %d", bufferPos, bufferLen, res);
                     error = true;
@@ -462,7 +831,7 @@ __attribute__((force_align_arg_pointer))
                 // Ignore data when bufferPos >= bufferLen and is_receiving_raw has not been set to false
                 uint8_t dummyData[64];
                 uint32_t dummyLen;
-                uart_receive(sp, dummyData, sizeof(dummyData), &dummyLen);
+                uart_receive(ctx->sp, dummyData, sizeof(dummyData), &dummyLen);
             }
         } else {
             if (is_receiving_raw_last) {
@@ -470,9 +839,9 @@ __attribute__((force_align_arg_pointer))
 
                 // Set the buffer as undefined
                 // comm_raw_data == NULL is used in SetCommunicationReceiveMode()
-                __atomic_store_n(&comm_raw_data, NULL, __ATOMIC_SEQ_CST);
+                __atomic_store_n(&ctx->comm_raw_data, NULL, __ATOMIC_SEQ_CST);
             }
-            res = uart_receive(sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
+            res = uart_receive(ctx->sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
 
             if ((res == PM3_SUCCESS) && (rxlen == sizeof(PacketResponseNGPreamble))) {
 
@@ -491,7 +860,7 @@ __attribute__((force_align_arg_pointer))
 
                     if ((!error) && (length > 0)) { // Get the variable length payload
 
-                        res = uart_receive(sp, (uint8_t *)&rx_raw.data, length, &rxlen);
+                        res = uart_receive(ctx->sp, (uint8_t *)&rx_raw.data, length, &rxlen);
 
                         if ((res != PM3_SUCCESS) || (rxlen != length)) {
 
@@ -504,7 +873,7 @@ __attribute__((force_align_arg_pointer))
 
                                 memcpy(&rx.data, &rx_raw.data, length);
                                 rx.length = length;
-                                if ((rx.cmd == g_conn.last_command) && (rx.status == PM3_SUCCESS)) {
+                                if ((rx.cmd == ctx->conn.last_command) && (rx.status == PM3_SUCCESS)) {
                                     ACK_received = true;
                                 }
 
@@ -542,7 +911,7 @@ __attribute__((force_align_arg_pointer))
                     }
 
                     if (!error) {                        // Get the postamble
-                        res = uart_receive(sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
+                        res = uart_receive(ctx->sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
                         if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseNGPostamble))) {
                             PrintAndLogEx(WARNING, "Received packet frame without postamble");
                             error = true;
@@ -578,7 +947,7 @@ __attribute__((force_align_arg_pointer))
                     PacketResponseOLD rx_old;
                     memcpy(&rx_old, &rx_raw.pre, sizeof(PacketResponseNGPreamble));
 
-                    res = uart_receive(sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
+                    res = uart_receive(ctx->sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
                     if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble))) {
                         PrintAndLogEx(WARNING, "Received packet OLD frame with payload too short? %d/%zu", rxlen, sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble));
                         error = true;
@@ -622,7 +991,7 @@ __attribute__((force_align_arg_pointer))
         is_receiving_raw_last = is_receiving_raw;
         // TODO if error, shall we resync ?
 
-        pthread_mutex_lock(&txBufferMutex);
+        pthread_mutex_lock(&ctx->txBufferMutex);
 
         if (connection->block_after_ACK) {
             // if we just received an ACK, wait here until a new command is to be transmitted
@@ -631,43 +1000,43 @@ __attribute__((force_align_arg_pointer))
 #ifdef COMMS_DEBUG
                 PrintAndLogEx(NORMAL, "Received ACK, fast TX mode: ignoring other RX till TX");
 #endif
-                while (!txBuffer_pending) {
-                    pthread_cond_wait(&txBufferSig, &txBufferMutex);
+                while (!ctx->txBuffer_pending) {
+                    pthread_cond_wait(&ctx->txBufferSig, &ctx->txBufferMutex);
                 }
             }
         }
 
-        if (txBuffer_pending) {
+        if (ctx->txBuffer_pending) {
 
-            if (txBufferNGLen) { // NG packet
-                res = uart_send(sp, (uint8_t *) &txBufferNG, txBufferNGLen);
+            if (ctx->txBufferNGLen) { // NG packet
+                res = uart_send(ctx->sp, (uint8_t *) &ctx->txBufferNG, ctx->txBufferNGLen);
                 if (res == PM3_EIO) {
                     commfailed = true;
                 }
-                g_conn.last_command = txBufferNG.pre.cmd;
-                txBufferNGLen = 0;
+                ctx->conn.last_command = ctx->txBufferNG.pre.cmd;
+                ctx->txBufferNGLen = 0;
             } else {
-                res = uart_send(sp, (uint8_t *) &txBuffer, sizeof(PacketCommandOLD));
+                res = uart_send(ctx->sp, (uint8_t *) &ctx->txBuffer, sizeof(PacketCommandOLD));
                 if (res == PM3_EIO) {
                     commfailed = true;
                 }
-                g_conn.last_command = txBuffer.cmd;
+                ctx->conn.last_command = ctx->txBuffer.cmd;
             }
 
-            txBuffer_pending = false;
+            ctx->txBuffer_pending = false;
 
             // main thread doesn't know send failed...
 
             // tell main thread that txBuffer is empty
-            pthread_cond_signal(&txBufferSig);
+            pthread_cond_signal(&ctx->txBufferSig);
         }
 
-        pthread_mutex_unlock(&txBufferMutex);
+        pthread_mutex_unlock(&ctx->txBufferMutex);
     }
 
     // when thread dies, we close the serial port.
-    uart_close(sp);
-    sp = NULL;
+    uart_close(ctx->sp);
+    ctx->sp = NULL;
 
 #if defined(__MACH__) && defined(__APPLE__)
     enableAppNap();
@@ -678,7 +1047,8 @@ __attribute__((force_align_arg_pointer))
 }
 
 bool IsCommunicationThreadDead(void) {
-    bool ret = __atomic_load_n(&comm_thread_dead, __ATOMIC_SEQ_CST);
+    comms_ctx_t *ctx = comms_ctx();
+    bool ret = __atomic_load_n(&ctx->comm_thread_dead, __ATOMIC_SEQ_CST);
     return ret;
 }
 
@@ -702,128 +1072,207 @@ bool IsCommunicationThreadDead(void) {
 // SetCommunicationRawReceiveBuffer() and GetCommunicationRawReceiveNum()
 
 bool SetCommunicationReceiveMode(bool isRawMode) {
+    comms_ctx_t *ctx = comms_ctx();
     if (isRawMode) {
-        const uint8_t *buffer = __atomic_load_n(&comm_raw_data, __ATOMIC_SEQ_CST);
+        const uint8_t *buffer = __atomic_load_n(&ctx->comm_raw_data, __ATOMIC_SEQ_CST);
         if (buffer == NULL) {
             PrintAndLogEx(ERR, "Buffer for raw data is not set");
             return false;
         }
     }
-    __atomic_store_n(&comm_raw_mode, isRawMode, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->comm_raw_mode, isRawMode, __ATOMIC_SEQ_CST);
     return true;
 }
 
 void SetCommunicationRawReceiveBuffer(uint8_t *buffer, size_t len) {
-    __atomic_store_n(&comm_raw_data,  buffer, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&comm_raw_len,  len, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&comm_raw_pos,  0, __ATOMIC_SEQ_CST);
+    comms_ctx_t *ctx = comms_ctx();
+    __atomic_store_n(&ctx->comm_raw_data,  buffer, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->comm_raw_len,  len, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->comm_raw_pos,  0, __ATOMIC_SEQ_CST);
 }
 
 size_t GetCommunicationRawReceiveNum(void) {
-    return __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+    comms_ctx_t *ctx = comms_ctx();
+    return __atomic_load_n(&ctx->comm_raw_pos, __ATOMIC_SEQ_CST);
+}
+
+static comms_ctx_t *comms_ctx_new(void) {
+    comms_ctx_t *ctx = calloc(1, sizeof(comms_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->rx_ring_first.slots = calloc(CMD_BUFFER_SIZE, sizeof(PacketResponseNG));
+    if (ctx->rx_ring_first.slots == NULL) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->rx_ring_first.size = CMD_BUFFER_SIZE;
+    ctx->rx_ring_first.is_static = true;
+    ctx->rx_ring_write = &ctx->rx_ring_first;
+    ctx->rx_ring_read = &ctx->rx_ring_first;
+    ctx->cmd_timing_last = -1;
+    pthread_mutex_init(&ctx->txBufferMutex, NULL);
+    pthread_cond_init(&ctx->txBufferSig, NULL);
+    pthread_mutex_init(&ctx->rxBufferMutex, NULL);
+    pthread_cond_init(&ctx->rxBufferSig, NULL);
+    pthread_mutex_init(&ctx->timingMutex, NULL);
+    return ctx;
+}
+
+static void comms_ctx_free(comms_ctx_t *ctx) {
+    if (ctx == NULL || ctx == &comms_main) {
+        return;
+    }
+    rx_ring_t *r = ctx->rx_ring_first.next;
+    while (r) {
+        rx_ring_t *next = r->next;
+        free(r->slots);
+        free(r);
+        r = next;
+    }
+    free(ctx->rx_ring_first.slots);
+    pthread_mutex_destroy(&ctx->txBufferMutex);
+    pthread_cond_destroy(&ctx->txBufferSig);
+    pthread_mutex_destroy(&ctx->rxBufferMutex);
+    pthread_cond_destroy(&ctx->rxBufferSig);
+    pthread_mutex_destroy(&ctx->timingMutex);
+    free(ctx);
+}
+
+// g_session.current_device is the main device,  any other gets its own context on first open
+static comms_ctx_t *comms_ctx_get(pm3_device_t **dev) {
+    if (*dev == NULL) {
+        *dev = calloc(sizeof(pm3_device_t), sizeof(uint8_t));
+        if (*dev == NULL) {
+            return NULL;
+        }
+    }
+    if ((*dev)->ctx == NULL) {
+        (*dev)->ctx = (dev == &g_session.current_device) ? &comms_main : comms_ctx_new();
+        if ((*dev)->ctx == NULL) {
+            return NULL;
+        }
+    }
+    (*dev)->conn = &(*dev)->ctx->conn;
+    return (*dev)->ctx;
+}
+
+// make ctx the current device of the calling thread,  returns the previous one to restore afterwards
+static comms_ctx_t *comms_select(comms_ctx_t *ctx) {
+    comms_ctx_t *prev = comms_current;
+    comms_current = ctx;
+    return prev;
+}
+
+communication_arg_t *GetCurrentConnection(void) {
+    return &comms_ctx()->conn;
+}
+
+/**
+ * @brief Selects the device used by the calling thread for all calls without a device argument
+ * (SendCommand*, WaitForResponse*, GetFromDevice, ...).
+ * @param dev the device,  NULL for the main device
+ */
+void SetCurrentDevice(pm3_device_t *dev) {
+    comms_current = (dev) ? dev->ctx : NULL;
+}
+
+static void comms_start(comms_ctx_t *ctx, const char *port, bool flash_mode) {
+    // start the communication thread
+    if (port != ctx->conn.serial_port_name) {
+        uint16_t len = MIN(strlen(port), FILE_PATH_SIZE - 1);
+        memset(ctx->conn.serial_port_name, 0, FILE_PATH_SIZE);
+        memcpy(ctx->conn.serial_port_name, port, len);
+    }
+    ctx->conn.run = true;
+    ctx->conn.block_after_ACK = flash_mode;
+    // Flags to tell where to add CRC on sent replies
+    ctx->conn.send_with_crc_on_usb = false;
+    ctx->conn.send_with_crc_on_fpc = true;
+    // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
+    ctx->conn.send_via_fpc_usart = false;
+
+    pthread_create(&ctx->communication_thread, NULL, &uart_communication, ctx);
+    __atomic_clear(&ctx->comm_thread_dead, __ATOMIC_SEQ_CST);
+
+    if (ctx == &comms_main) {
+        g_session.pm3_present = true;
+    }
 }
 
 bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed) {
+    comms_ctx_t *ctx = comms_ctx_get(dev);
+    if (ctx == NULL) {
+        return false;
+    }
 
-    sp = uart_open(port, speed, true);
+    // uart_open fills in the connection settings of the current device
+    comms_ctx_t *prev = comms_select(ctx);
+    ctx->sp = uart_open(port, speed, true);
+    comms_select(prev);
 
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
-        sp = NULL;
+    if (ctx->sp == INVALID_SERIAL_PORT) {
+        ctx->sp = NULL;
         return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
-        sp = NULL;
+    } else if (ctx->sp == CLAIMED_SERIAL_PORT) {
+        ctx->sp = NULL;
         return false;
     } else {
-        // start the communication thread
-        if (port != g_conn.serial_port_name) {
-            uint16_t len = MIN(strlen(port), FILE_PATH_SIZE - 1);
-            memset(g_conn.serial_port_name, 0, FILE_PATH_SIZE);
-            memcpy(g_conn.serial_port_name, port, len);
-        }
-        g_conn.run = true;
-        g_conn.block_after_ACK = false;
-        // Flags to tell where to add CRC on sent replies
-        g_conn.send_with_crc_on_usb = false;
-        g_conn.send_with_crc_on_fpc = true;
-        // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
-        g_conn.send_via_fpc_usart = false;
-
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
+        comms_start(ctx, port, false);
         __atomic_clear(&reconnect_ok, __ATOMIC_SEQ_CST);
-
-        g_session.pm3_present = true; // TODO support for multiple devices
-
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(sizeof(pm3_device_t), sizeof(uint8_t));
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
 
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed) {
+    comms_ctx_t *ctx = comms_ctx_get(dev);
+    if (ctx == NULL) {
+        return false;
+    }
+
+    // uart_open fills in the connection settings of the current device
+    comms_ctx_t *prev = comms_select(ctx);
 
     if (wait_for_port == false) {
         PrintAndLogEx(SUCCESS, "Using UART port " _GREEN_("%s"), port);
-        sp = uart_open(port, speed, false);
+        ctx->sp = uart_open(port, speed, false);
     } else {
         PrintAndLogEx(SUCCESS, "Waiting for Proxmark3 to appear on " _YELLOW_("%s"), port);
         fflush(stdout);
         int openCount = 0;
         PrintAndLogEx(INPLACE, "% 3i", timeout);
         do {
-            sp = uart_open(port, speed, false);
+            ctx->sp = uart_open(port, speed, false);
             msleep(500);
             PrintAndLogEx(INPLACE, "% 3i", timeout - openCount - 1);
 
-        } while (++openCount < timeout && (sp == INVALID_SERIAL_PORT || sp == CLAIMED_SERIAL_PORT));
+        } while (++openCount < timeout && (ctx->sp == INVALID_SERIAL_PORT || ctx->sp == CLAIMED_SERIAL_PORT));
     }
 
+    comms_select(prev);
+
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
+    if (ctx->sp == INVALID_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " invalid serial port " _YELLOW_("%s"), port);
         PrintAndLogEx(HINT, "Try the shell script " _YELLOW_("`./pm3 --list`") " to get a list of possible serial ports");
-        sp = NULL;
+        ctx->sp = NULL;
         return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
+    } else if (ctx->sp == CLAIMED_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " serial port " _YELLOW_("%s") " is claimed by another process", port);
         PrintAndLogEx(HINT, "Try the shell script " _YELLOW_("`./pm3 --list`") " to get a list of possible serial ports");
 
-        sp = NULL;
+        ctx->sp = NULL;
         return false;
     } else {
-        // start the communication thread
-        if (port != g_conn.serial_port_name) {
-            uint16_t len = MIN(strlen(port), FILE_PATH_SIZE - 1);
-            memset(g_conn.serial_port_name, 0, FILE_PATH_SIZE);
-            memcpy(g_conn.serial_port_name, port, len);
-        }
-        g_conn.run = true;
-        g_conn.block_after_ACK = flash_mode;
-        // Flags to tell where to add CRC on sent replies
-        g_conn.send_with_crc_on_usb = false;
-        g_conn.send_with_crc_on_fpc = true;
-        // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
-        g_conn.send_via_fpc_usart = false;
-
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
-        g_session.pm3_present = true; // TODO support for multiple devices
-
+        comms_start(ctx, port, flash_mode);
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(sizeof(pm3_device_t), sizeof(uint8_t));
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
 
-// check if we can communicate with Pm3
-int TestProxmark(pm3_device_t *dev) {
+static int TestProxmark_internal(comms_ctx_t *ctx) {
 
     uint16_t len = 32;
     uint8_t data[len];
@@ -831,7 +1280,7 @@ int TestProxmark(pm3_device_t *dev) {
         data[i] = i & 0xFF;
     }
 
-    __atomic_store_n(&last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
     clearCommandBuffer();
     SendCommandNG(CMD_PING, data, len);
 
@@ -868,24 +1317,24 @@ int TestProxmark(pm3_device_t *dev) {
     }
 
     memcpy(&g_pm3_capabilities, resp.data.asBytes, sizeof(capabilities_t));
-    g_conn.send_via_fpc_usart = g_pm3_capabilities.via_fpc;
-    g_conn.uart_speed = g_pm3_capabilities.baudrate;
+    ctx->conn.send_via_fpc_usart = g_pm3_capabilities.via_fpc;
+    ctx->conn.uart_speed = g_pm3_capabilities.baudrate;
 
-    bool is_tcp_conn = (g_conn.send_via_ip == PM3_TCPv4 || g_conn.send_via_ip == PM3_TCPv6);
-    bool is_bt_conn = (memcmp(g_conn.serial_port_name, "bt:", 3) == 0);
-    bool is_udp_conn = (g_conn.send_via_ip == PM3_UDPv4 || g_conn.send_via_ip == PM3_UDPv6);
+    bool is_tcp_conn = (ctx->conn.send_via_ip == PM3_TCPv4 || ctx->conn.send_via_ip == PM3_TCPv6);
+    bool is_bt_conn = (memcmp(ctx->conn.serial_port_name, "bt:", 3) == 0);
+    bool is_udp_conn = (ctx->conn.send_via_ip == PM3_UDPv4 || ctx->conn.send_via_ip == PM3_UDPv6);
 
     PrintAndLogEx(SUCCESS, "Communicating with PM3 over %s%s%s%s",
-                  (g_conn.send_via_fpc_usart) ? _GREEN_("FPC UART") : _GREEN_("USB-CDC"),
+                  (ctx->conn.send_via_fpc_usart) ? _GREEN_("FPC UART") : _GREEN_("USB-CDC"),
                   (is_tcp_conn) ? " over " _GREEN_("TCP") : "",
                   (is_bt_conn) ? " over " _GREEN_("BT") : "",
                   (is_udp_conn) ? " over " _GREEN_("UDP") : ""
                  );
-    if (g_conn.send_via_fpc_usart) {
-        PrintAndLogEx(SUCCESS, "PM3 UART serial baudrate: " _GREEN_("%u") "\n", g_conn.uart_speed);
+    if (ctx->conn.send_via_fpc_usart) {
+        PrintAndLogEx(SUCCESS, "PM3 UART serial baudrate: " _GREEN_("%u") "\n", ctx->conn.uart_speed);
     } else {
         int res;
-        if (g_conn.send_via_local_ip) {
+        if (ctx->conn.send_via_local_ip) {
             // (g_conn.send_via_local_ip == true) -> ((is_tcp_conn || is_udp_conn) == true)
             res = uart_reconfigure_timeouts(is_tcp_conn ? UART_TCP_LOCAL_CLIENT_RX_TIMEOUT_MS : UART_UDP_LOCAL_CLIENT_RX_TIMEOUT_MS);
         } else if (is_tcp_conn || is_udp_conn) {
@@ -900,32 +1349,148 @@ int TestProxmark(pm3_device_t *dev) {
     return PM3_SUCCESS;
 }
 
+// check if we can communicate with Pm3
+int TestProxmark(pm3_device_t *dev) {
+    if (dev == NULL || dev->ctx == NULL) {
+        return PM3_EINVARG;
+    }
+    comms_ctx_t *prev = comms_select(dev->ctx);
+    int res = TestProxmark_internal(dev->ctx);
+    comms_select(prev);
+    return res;
+}
+
 void CloseProxmark(pm3_device_t *dev) {
-    dev->g_conn->run = false;
+    if (dev == NULL || dev->ctx == NULL) {
+        return;
+    }
+    comms_ctx_t *ctx = dev->ctx;
+    ctx->conn.run = false;
 
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        pthread_join(communication_thread, NULL);
+    if (ctx->communication_thread != 0) {
+        pthread_join(ctx->communication_thread, NULL);
     }
 #else
-    pthread_join(communication_thread, NULL);
+    pthread_join(ctx->communication_thread, NULL);
 #endif
 
-    if (sp) {
-        uart_close(sp);
+    if (ctx->sp) {
+        uart_close(ctx->sp);
     }
 
     // Clean up our state
-    sp = NULL;
+    ctx->sp = NULL;
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        memset(&communication_thread, 0, sizeof(pthread_t));
+    if (ctx->communication_thread != 0) {
+        memset(&ctx->communication_thread, 0, sizeof(pthread_t));
     }
 #else
-    memset(&communication_thread, 0, sizeof(pthread_t));
+    memset(&ctx->communication_thread, 0, sizeof(pthread_t));
 #endif
 
-    g_session.pm3_present = false;
+    if (ctx == &comms_main) {
+        g_session.pm3_present = false;
+    }
+}
+
+// Additional devices,  the main device is g_session.current_device
+static pm3_device_t *comms_devices[PM3_MAX_DEVICES - 1];
+
+/**
+ * @brief Opens an additional device next to the main one.
+ * @return PM3_SUCCESS, PM3_EOVFLOW when PM3_MAX_DEVICES are in use, PM3_EIO if it can't be opened
+ */
+int AttachProxmark(const char *port, uint32_t speed) {
+    int8_t slot = -1;
+    for (uint8_t i = 0; i < ARRAYLEN(comms_devices); i++) {
+        if (comms_devices[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return PM3_EOVFLOW;
+    }
+
+    pm3_device_t *dev = NULL;
+    if (OpenProxmark(&dev, port, false, 0, false, speed) == false) {
+        if (dev) {
+            comms_ctx_free(dev->ctx);
+            free(dev);
+        }
+        return PM3_EIO;
+    }
+
+    int res = TestProxmark(dev);
+    if (res != PM3_SUCCESS) {
+        CloseProxmark(dev);
+        comms_ctx_free(dev->ctx);
+        free(dev);
+        return res;
+    }
+
+    comms_devices[slot] = dev;
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Closes an additional device
+ * @param idx device index as used by GetDevice,  the main device (0) can't be detached
+ */
+int DetachProxmark(uint8_t idx) {
+    if (idx == 0) {
+        return PM3_EINVARG;
+    }
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < ARRAYLEN(comms_devices); i++) {
+        if (comms_devices[i] == NULL) {
+            continue;
+        }
+        if (++n == idx) {
+            CloseProxmark(comms_devices[i]);
+            comms_ctx_free(comms_devices[i]->ctx);
+            free(comms_devices[i]);
+            comms_devices[i] = NULL;
+            return PM3_SUCCESS;
+        }
+    }
+    return PM3_EINVARG;
+}
+
+/**
+ * @brief Number of devices which can be used,  the main device included
+ */
+uint8_t GetDeviceCount(void) {
+    if (g_session.pm3_present == false) {
+        return 0;
+    }
+    uint8_t n = 1;
+    for (uint8_t i = 0; i < ARRAYLEN(comms_devices); i++) {
+        if (comms_devices[i]) {
+            n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Returns a device,  0 is the main device, followed by the attached ones
+ */
+pm3_device_t *GetDevice(uint8_t idx) {
+    if (g_session.pm3_present == false) {
+        return NULL;
+    }
+    if (idx == 0) {
+        return g_session.current_device;
+    }
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < ARRAYLEN(comms_devices); i++) {
+        if (comms_devices[i] && ++n == idx) {
+            return comms_devices[i];
+        }
+    }
+    return NULL;
 }
 
 // Gives a rough estimate of the communication delay based on channel & baudrate
@@ -938,9 +1503,10 @@ void CloseProxmark(pm3_device_t *dev) {
 //           ~ = 12000000 / USART_BAUD_RATE
 // Let's take 2x (maybe we need more for BT link?)
 static size_t communication_delay(void) {
+    comms_ctx_t *ctx = comms_ctx();
     // needed also for Windows USB USART??
-    if (g_conn.send_via_fpc_usart) {
-        return 2 * (12000000 / g_conn.uart_speed);
+    if (ctx->conn.send_via_fpc_usart) {
+        return 2 * (12000000 / ctx->conn.uart_speed);
     }
     return 0;
 }
@@ -956,14 +1522,27 @@ static size_t communication_delay(void) {
  * @return the number of received bytes
  */
 size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process) {
+    return WaitForRawDataTimeoutEx(buffer, len, ms_timeout, show_process, NULL, NULL);
+}
+
+/**
+ * @brief Same as WaitForRawDataTimeout, but hands every newly arrived chunk to a callback
+ *
+ * @param callback called from this thread with the bytes received since the previous call, can be NULL
+ * @param arg passed through to the callback
+ * @return the number of received bytes
+ */
+size_t WaitForRawDataTimeoutEx(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process, raw_data_cb_t callback, void *arg) {
+    comms_ctx_t *ctx = comms_ctx();
     uint8_t print_counter = 0;
     size_t last_pos = 0;
+    size_t reported = 0;
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1) {
         ms_timeout += communication_delay();
     }
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     SetCommunicationRawReceiveBuffer(buffer, len);
     SetCommunicationReceiveMode(true);
@@ -971,6 +1550,8 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
     size_t pos = 0;
     while (pos < len) {
 
+        uint32_t gen = getCommEventGen();
+
         if (kbd_enter_pressed()) {
             // Send anything to stop the transfer
             PrintAndLogEx(INFO, "Stopping");
@@ -983,11 +1564,11 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
             }
         }
 
-        pos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+        pos = __atomic_load_n(&ctx->comm_raw_pos, __ATOMIC_SEQ_CST);
 
         // Check the timeout if pos is not updated
         if (last_pos == pos) {
-            uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+            uint64_t tmp_clk = __atomic_load_n(&ctx->timeout_start_time, __ATOMIC_SEQ_CST);
             // If ms_timeout == -1, the loop can only be breaked by pressing Enter or receiving enough data
             if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
                 break;
@@ -999,9 +1580,16 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
             }
         }
 
+        if (callback && pos > reported) {
+            callback(buffer + reported, pos - reported, arg);
+            reported = pos;
+        }
+
         print_counter++;
         last_pos = pos;
-        msleep(10);
+        if (pos < len) {
+            waitForCommEvent(gen, commEventWaitTime(ms_timeout, __atomic_load_n(&ctx->timeout_start_time, __ATOMIC_SEQ_CST)));
+        }
     }
     if (pos == len && (ms_timeout != (size_t) - 1)) {
         // If ms_timeout != -1, when the desired data is received, tell the arm side
@@ -1013,7 +1601,10 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
         msleep(ms_timeout);
     }
     SetCommunicationReceiveMode(false);
-    pos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+    pos = __atomic_load_n(&ctx->comm_raw_pos, __ATOMIC_SEQ_CST);
+    if (callback && pos > reported) {
+        callback(buffer + reported, pos - reported, arg);
+    }
     return pos;
 }
 
@@ -1028,6 +1619,7 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
  * @return true if command was returned, otherwise false
  */
 bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    comms_ctx_t *ctx = comms_ctx();
 
     PacketResponseNG resp;
     // init to ZERO
@@ -1050,7 +1642,7 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
     if (ms_timeout != (size_t) - 1)
         ms_timeout += communication_delay();
 
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Wait until the command is received
     while (true) {
@@ -1060,6 +1652,8 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             break;
         }
 
+        uint32_t gen = getCommEventGen();
+
         while (getReply(response)) {
             if (cmd == CMD_UNKNOWN || response->cmd == cmd) {
                 return true;
@@ -1074,8 +1668,10 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t tmp_clk = __atomic_load_n(&ctx->timeout_start_time, __ATOMIC_SEQ_CST);
         if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
+            cmd_timing_timeout(cmd);
+            pm3_metrics_rf_timeout();
             break;
         }
 
@@ -1084,8 +1680,9 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
             show_warning = false;
         }
-        // just to avoid CPU busy loop:
-        msleep(1);
+
+        // sleep until next packet arrives
+        waitForCommEvent(gen, commEventWaitTime(ms_timeout, tmp_clk));
     }
     return false;
 }
@@ -1098,6 +1695,376 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response) {
     return WaitForResponseTimeoutW(cmd, response, -1, true);
 }
 
+// Pipelined command queue.
+//
+// The device handles commands strictly in the order they arrive, and replies to them in that
+// same order.  That lets the client keep several commands in flight and match each reply back
+// to the command which caused it, by looking for the oldest outstanding entry expecting that
+// reply command.  Replies belonging to other outstanding entries are parked in their slots
+// instead of being dropped, like WaitForResponseTimeout would do.
+//
+// Only to be used from the thread talking to the device,  each device has its own queue.
+
+static cmd_queue_entry_t *cmd_queue_find(uint32_t seq) {
+    comms_ctx_t *ctx = comms_ctx();
+    for (uint8_t i = 0; i < CMD_QUEUE_SIZE; i++) {
+        if (ctx->cmd_queue[i].in_use && ctx->cmd_queue[i].seq == seq) {
+            return &ctx->cmd_queue[i];
+        }
+    }
+    return NULL;
+}
+
+static cmd_queue_entry_t *cmd_queue_oldest_waiting(uint16_t resp_cmd) {
+    comms_ctx_t *ctx = comms_ctx();
+    cmd_queue_entry_t *oldest = NULL;
+    for (uint8_t i = 0; i < CMD_QUEUE_SIZE; i++) {
+        cmd_queue_entry_t *e = &ctx->cmd_queue[i];
+        if (e->in_use == false || e->done || e->resp_cmd != resp_cmd) {
+            continue;
+        }
+        // sequence numbers are allowed to wrap
+        if (oldest == NULL || (int32_t)(e->seq - oldest->seq) < 0) {
+            oldest = e;
+        }
+    }
+    return oldest;
+}
+
+// Hand every reply received so far to the queue entry it belongs to.
+// A Waiting Time eXtension is added to ms_timeout, when there is one
+static void cmd_queue_collect(size_t *ms_timeout) {
+    PacketResponseNG rx;
+    while (getReply(&rx)) {
+
+        if (rx.cmd == CMD_WTX && rx.length == sizeof(uint16_t)) {
+            uint16_t wtx = rx.data.asDwords[0] & 0xFFFF;
+            PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
+            if (ms_timeout && *ms_timeout != (size_t) - 1) {
+                *ms_timeout += wtx;
+            }
+            continue;
+        }
+
+        cmd_queue_entry_t *owner = cmd_queue_oldest_waiting(rx.cmd);
+        if (owner) {
+            memcpy(&owner->resp, &rx, sizeof(PacketResponseNG));
+            owner->done = true;
+        }
+    }
+}
+
+/**
+ * @brief Forget about all outstanding queued commands, and flush the reply buffer.
+ */
+void clearCommandQueue(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    memset(ctx->cmd_queue, 0, sizeof(ctx->cmd_queue));
+    clearCommandBuffer();
+}
+
+/**
+ * @brief Returns the number of queued commands which have not been collected yet
+ */
+uint8_t GetCommandQueueCount(void) {
+    comms_ctx_t *ctx = comms_ctx();
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < CMD_QUEUE_SIZE; i++) {
+        if (ctx->cmd_queue[i].in_use) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// take a free queue slot for a command about to be sent
+static int cmd_queue_reserve(uint16_t resp_cmd, uint32_t *seq) {
+    comms_ctx_t *ctx = comms_ctx();
+
+    if (g_session.pm3_present == false) {
+        return PM3_ENOTTY;
+    }
+
+    cmd_queue_entry_t *e = NULL;
+    for (uint8_t i = 0; i < CMD_QUEUE_SIZE; i++) {
+        if (ctx->cmd_queue[i].in_use == false) {
+            e = &ctx->cmd_queue[i];
+            break;
+        }
+    }
+
+    if (e == NULL) {
+        return PM3_EOVFLOW;
+    }
+
+    e->in_use = true;
+    e->done = false;
+    e->seq = ctx->cmd_queue_seq++;
+    e->resp_cmd = resp_cmd;
+
+    if (seq) {
+        *seq = e->seq;
+    }
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Sends a NG command without waiting for its reply.
+ *
+ * @param cmd command to send
+ * @param data payload
+ * @param len payload length
+ * @param resp_cmd the reply command expected for this command (usually the same as cmd)
+ * @param seq returns the sequence ID to use with WaitForQueuedResponse
+ * @return PM3_SUCCESS, or PM3_EOVFLOW if CMD_QUEUE_SIZE commands are already outstanding
+ */
+int SendCommandNGQueued(uint16_t cmd, uint8_t *data, size_t len, uint16_t resp_cmd, uint32_t *seq) {
+    int res = cmd_queue_reserve(resp_cmd, seq);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    SendCommandNG(cmd, data, len);
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief As SendCommandNGQueued,  for commands taking the old style arguments.
+ * Their reply usually is CMD_ACK.
+ * @return PM3_SUCCESS, PM3_EOVFLOW if CMD_QUEUE_SIZE commands are already outstanding
+ *  or PM3_EINVARG when the payload doesn't fit a MIX frame
+ */
+int SendCommandMIXQueued(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len, uint16_t resp_cmd, uint32_t *seq) {
+    if (len > PM3_CMD_DATA_SIZE_MIX) {
+        return PM3_EINVARG;
+    }
+    int res = cmd_queue_reserve(resp_cmd, seq);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    SendCommandMIX(cmd, arg0, arg1, arg2, data, len);
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Waits for the reply of a command sent with SendCommandNGQueued.
+ * Replies can be collected in any order, the slot is released once collected, or on timeout.
+ *
+ * @param seq sequence ID returned by SendCommandNGQueued
+ * @param response struct to copy received command into
+ * @param ms_timeout the maximum timeout
+ * @return true if the reply was received, otherwise false.
+ *  After a timeout, later replies can't be trusted to match, call clearCommandQueue()
+ */
+bool WaitForQueuedResponse(uint32_t seq, PacketResponseNG *response, size_t ms_timeout) {
+    comms_ctx_t *ctx = comms_ctx();
+
+    cmd_queue_entry_t *e = cmd_queue_find(seq);
+    if (e == NULL) {
+        return false;
+    }
+
+    // Add delay depending on the communication channel & speed
+    if (ms_timeout != (size_t) - 1) {
+        ms_timeout += communication_delay();
+    }
+
+    __atomic_store_n(&ctx->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+
+    while (e->done == false) {
+
+        if (IsCommunicationThreadDead()) {
+            break;
+        }
+
+        uint32_t gen = getCommEventGen();
+
+        cmd_queue_collect(&ms_timeout);
+
+        if (e->done) {
+            break;
+        }
+
+        uint64_t tmp_clk = __atomic_load_n(&ctx->timeout_start_time, __ATOMIC_SEQ_CST);
+        if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
+            cmd_timing_timeout(e->resp_cmd);
+            pm3_metrics_rf_timeout();
+            break;
+        }
+
+        waitForCommEvent(gen, commEventWaitTime(ms_timeout, tmp_clk));
+    }
+
+    bool res = e->done;
+    if (res && response) {
+        memcpy(response, &e->resp, sizeof(PacketResponseNG));
+    }
+
+    e->in_use = false;
+    e->done = false;
+    return res;
+}
+
+/**
+ * @brief Non blocking check for the reply of a command sent with SendCommandNGQueued.
+ * Lets a caller do other work, or drive a script coroutine, while the device is busy.
+ * Timeouts are up to the caller,  give up on a command with clearCommandQueue()
+ *
+ * @param seq sequence ID returned by SendCommandNGQueued
+ * @param response struct to copy received command into
+ * @return PM3_SUCCESS when the reply is in, the slot is then released.
+ *  PM3_ENODATA when it is still outstanding, PM3_EINVARG for an unknown sequence ID
+ *  and PM3_EIO when the communication thread died.
+ */
+int PollQueuedResponse(uint32_t seq, PacketResponseNG *response) {
+
+    cmd_queue_entry_t *e = cmd_queue_find(seq);
+    if (e == NULL) {
+        return PM3_EINVARG;
+    }
+
+    if (e->done == false) {
+        if (IsCommunicationThreadDead()) {
+            e->in_use = false;
+            return PM3_EIO;
+        }
+
+        cmd_queue_collect(NULL);
+
+        if (e->done == false) {
+            return PM3_ENODATA;
+        }
+    }
+
+    if (response) {
+        memcpy(response, &e->resp, sizeof(PacketResponseNG));
+    }
+
+    e->in_use = false;
+    e->done = false;
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Starts a new, empty, CMD_BATCH.
+ * A batch packs several small commands in one packet, the device runs them in order
+ * and returns all their replies in a single CMD_BATCH reply.
+ */
+void BatchInit(pm3_batch_t *batch) {
+    memset(batch, 0, sizeof(pm3_batch_t));
+    // first byte holds the number of sub-commands
+    batch->len = 1;
+}
+
+static int batch_add(pm3_batch_t *batch, uint16_t cmd, bool ng, const uint8_t *hdata, size_t hlen, const uint8_t *data, size_t len) {
+
+    if (cmd == CMD_BATCH || batch->count == 0xFF) {
+        return PM3_EINVARG;
+    }
+
+    if (batch->len + sizeof(batch_cmd_hdr_t) + hlen + len > sizeof(batch->buf)) {
+        return PM3_EOVFLOW;
+    }
+
+    batch_cmd_hdr_t *hdr = (batch_cmd_hdr_t *)(batch->buf + batch->len);
+    hdr->cmd = cmd;
+    hdr->length = hlen + len;
+    hdr->ng = ng;
+    if (hlen) {
+        memcpy(hdr->data, hdata, hlen);
+    }
+    if (data && len) {
+        memcpy(hdr->data + hlen, data, len);
+    }
+
+    batch->len += sizeof(batch_cmd_hdr_t) + hlen + len;
+    batch->count++;
+    batch->buf[0] = batch->count;
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Appends a NG command to a batch.
+ * @return PM3_SUCCESS, or PM3_EOVFLOW if it doesn't fit anymore
+ */
+int BatchAddNG(pm3_batch_t *batch, uint16_t cmd, const uint8_t *data, size_t len) {
+    return batch_add(batch, cmd, true, NULL, 0, data, len);
+}
+
+/**
+ * @brief Appends a MIX command to a batch.
+ * @return PM3_SUCCESS, or PM3_EOVFLOW if it doesn't fit anymore
+ */
+int BatchAddMIX(pm3_batch_t *batch, uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+    uint64_t arg[3] = {arg0, arg1, arg2};
+    return batch_add(batch, cmd, false, (uint8_t *)arg, sizeof(arg), data, len);
+}
+
+/**
+ * @brief Sends a batch and waits for the combined reply.
+ * Use BatchGetReply to walk through the individual replies.
+ *
+ * @return PM3_SUCCESS, PM3_EOVFLOW if some replies didn't fit in the reply and were dropped,
+ *  PM3_ETIMEOUT if no reply was received.
+ */
+int SendBatch(pm3_batch_t *batch, PacketResponseNG *response, size_t ms_timeout) {
+    if (batch->count == 0) {
+        return PM3_EINVARG;
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_BATCH, batch->buf, batch->len);
+    if (WaitForResponseTimeout(CMD_BATCH, response, ms_timeout) == false) {
+        return PM3_ETIMEOUT;
+    }
+    return response->status;
+}
+
+/**
+ * @brief Extracts the next reply from a CMD_BATCH reply.
+ * MIX replies get their args unpacked into oldarg like regular replies.
+ *
+ * @param response the CMD_BATCH reply
+ * @param offset position in the reply, start with 0
+ * @param reply struct to copy the extracted reply into
+ * @return true if a reply was extracted, false when there is none left
+ */
+bool BatchGetReply(const PacketResponseNG *response, uint16_t *offset, PacketResponseNG *reply) {
+
+    if (*offset + sizeof(batch_reply_hdr_t) > response->length) {
+        return false;
+    }
+
+    const batch_reply_hdr_t *hdr = (const batch_reply_hdr_t *)(response->data.asBytes + *offset);
+    if (*offset + sizeof(batch_reply_hdr_t) + hdr->length > response->length) {
+        return false;
+    }
+    *offset += sizeof(batch_reply_hdr_t) + hdr->length;
+
+    memset(reply, 0, sizeof(PacketResponseNG));
+    reply->cmd = hdr->cmd;
+    reply->status = hdr->status;
+    reply->ng = hdr->ng;
+    reply->magic = RESPONSENG_PREAMBLE_MAGIC;
+    reply->crc = RESPONSENG_POSTAMBLE_MAGIC;
+
+    if (hdr->ng) {
+        reply->length = hdr->length;
+        memcpy(reply->data.asBytes, hdr->data, hdr->length);
+    } else {
+        uint64_t arg[3] = {0};
+        if (hdr->length < sizeof(arg)) {
+            return false;
+        }
+        memcpy(arg, hdr->data, sizeof(arg));
+        reply->oldarg[0] = arg[0];
+        reply->oldarg[1] = arg[1];
+        reply->oldarg[2] = arg[2];
+        reply->length = hdr->length - sizeof(arg);
+        memcpy(reply->data.asBytes, hdr->data + sizeof(arg), reply->length);
+    }
+    return true;
+}
+
 /**
 * Data transfer from Proxmark to client. This method times out after
 * ms_timeout milliseconds.
@@ -1142,15 +2109,19 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
 
     switch (memtype) {
         case BIG_BUF: {
-            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
+            if (dl_use_lz4()) {
+                return dl_lz4(dest, bytes, start_index, 0, response, ms_timeout, show_warning);
+            }
+            return dl_raw(dest, bytes, start_index, 0, response, ms_timeout, show_warning);
         }
         case BIG_BUF_EML: {
-            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
+            if (dl_use_lz4()) {
+                return dl_lz4(dest, bytes, start_index, DOWNLOAD_RAW_FLAG_EML, response, ms_timeout, show_warning);
+            }
+            return dl_raw(dest, bytes, start_index, DOWNLOAD_RAW_FLAG_EML, response, ms_timeout, show_warning);
         }
         case SPIFFS: {
-            SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, 0, data, datalen);
+            SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, dl_use_lz4() ? SPIFFS_DOWNLOAD_FLAG_LZ4 : 0, data, datalen);
             return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED);
         }
         case FLASH_MEM: {
@@ -1177,9 +2148,10 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
 }
 
 static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd) {
+    comms_ctx_t *ctx = comms_ctx();
 
     uint32_t bytes_completed = 0;
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&ctx->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1)
@@ -1187,6 +2159,8 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
 
     while (true) {
 
+        uint32_t gen = getCommEventGen();
+
         if (getReply(response)) {
 
             if (response->cmd == CMD_ACK)
@@ -1197,11 +2171,26 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             if (response->cmd == CMD_SPIFFS_DOWNLOAD || response->cmd == CMD_FPGAMEM_DOWNLOAD)
                 return true;
 
-            // sample_buf is a array pointer, located in data.c
-            // arg0 = offset in transfer. Startindex of this chunk
-            // arg1 = length bytes to transfer
-            // arg2 = bigbuff tracelength (?)
-            if (response->cmd == rec_cmd) {
+            if (response->cmd == CMD_DOWNLOADED_LZ4 && response->length >= sizeof(download_lz4_t)) {
+
+                // compressed chunk,  independent LZ4 block holding rawlen bytes at offset
+                const download_lz4_t *chunk = (const download_lz4_t *)response->data.asBytes;
+                if ((chunk->offset > bytes) || (chunk->rawlen > bytes - chunk->offset)) {
+                    PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | buf_size %u", chunk->offset, chunk->rawlen, bytes);
+                    break;
+                }
+
+                int n = LZ4_decompress_safe((const char *)chunk->data, (char *)dest + chunk->offset, response->length - sizeof(download_lz4_t), chunk->rawlen);
+                if (n != (int)chunk->rawlen) {
+                    PrintAndLogEx(FAILED, "ERROR: Corrupted compressed data when downloading from device,  offset %u | got %d of %u bytes", chunk->offset, n, chunk->rawlen);
+                    break;
+                }
+                bytes_completed += n;
+            } else if (response->cmd == rec_cmd) {
+                // sample_buf is a array pointer, located in data.c
+                // arg0 = offset in transfer. Startindex of this chunk
+                // arg1 = length bytes to transfer
+                // arg2 = bigbuff tracelength (?)
 
                 uint32_t offset = response->oldarg[0];
                 uint32_t copy_bytes = MIN(bytes - bytes_completed, response->oldarg[1]);
@@ -1227,7 +2216,7 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t tmp_clk = __atomic_load_n(&ctx->timeout_start_time, __ATOMIC_SEQ_CST);
         if (msclock() - tmp_clk > ms_timeout) {
             PrintAndLogEx(FAILED, "Timed out while trying to download data from device");
             break;
@@ -1239,6 +2228,119 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
             show_warning = false;
         }
+
+        if (IsCommunicationThreadDead()) {
+            break;
+        }
+
+        waitForCommEvent(gen, commEventWaitTime(ms_timeout, tmp_clk));
     }
     return false;
 }
+
+// Streaming download. The device sends the requested bytes unframed, which are written straight
+// into dest by the communication thread, followed by the usual CMD_ACK holding a CRC of the whole transfer.
+static bool dl_raw(uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t flags, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    comms_ctx_t *ctx = comms_ctx();
+
+    // Add delay depending on the communication channel & speed
+    if (ms_timeout != (size_t) - 1) {
+        ms_timeout += communication_delay();
+    }
+
+    download_raw_t payload = {
+        .startidx = start_index,
+        .len = bytes,
+        .flags = flags,
+    };
+
+    // raw mode must be armed before the device starts to send
+    __atomic_store_n(&ctx->comm_raw_autostop, true, __ATOMIC_SEQ_CST);
+    SetCommunicationRawReceiveBuffer(dest, bytes);
+    SetCommunicationReceiveMode(true);
+    __atomic_store_n(&ctx->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+
+    SendCommandNG(CMD_DOWNLOAD_BIGBUF_RAW, (uint8_t *)&payload, sizeof(payload));
+
+    bool done = false;
+    while (true) {
+
+        if (IsCommunicationThreadDead()) {
+            break;
+        }
+
+        uint32_t gen = getCommEventGen();
+
+        if (__atomic_load_n(&ctx->comm_raw_pos, __ATOMIC_SEQ_CST) >= bytes) {
+            done = true;
+            break;
+        }
+
+        uint64_t tmp_clk = __atomic_load_n(&ctx->timeout_start_time, __ATOMIC_SEQ_CST);
+        if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
+            PrintAndLogEx(FAILED, "Timed out while trying to download data from device");
+            break;
+        }
+
+        if (msclock() - tmp_clk > 3000 && show_warning) {
+            // 3 seconds elapsed (but this doesn't mean the timeout was exceeded)
+            PrintAndLogEx(INFO, "Waiting for a response from the Proxmark3...");
+            PrintAndLogEx(INFO, "You can cancel this operation by pressing the pm3 button");
+            show_warning = false;
+        }
+
+        waitForCommEvent(gen, commEventWaitTime(ms_timeout, tmp_clk));
+    }
+
+    SetCommunicationReceiveMode(false);
+    __atomic_store_n(&ctx->comm_raw_autostop, false, __ATOMIC_SEQ_CST);
+
+    if (done == false) {
+        return false;
+    }
+
+    if (WaitForResponseTimeoutW(CMD_ACK, response, ms_timeout, false) == false) {
+        PrintAndLogEx(FAILED, "Timed out while waiting for end of download from device");
+        return false;
+    }
+
+    return dl_check_ack(dest, bytes, response);
+}
+
+// The final CMD_ACK of a CMD_DOWNLOAD_BIGBUF_RAW transfer holds the status and a CRC over all bytes.
+static bool dl_check_ack(const uint8_t *dest, uint32_t bytes, const PacketResponseNG *response) {
+    if (response->oldarg[0] != 1) {
+        return false;
+    }
+
+    uint8_t first = 0, second = 0;
+    compute_crc(CRC_14443_A, dest, bytes, &first, &second);
+    if (((first << 8) | second) != (response->oldarg[1] & 0xFFFF)) {
+        PrintAndLogEx(FAILED, "ERROR: CRC mismatch when downloading from device %02X%02X <> %04" PRIX64, first, second, response->oldarg[1]);
+        return false;
+    }
+    return true;
+}
+
+// On the FPC USART (and BT add-on) the link is the bottleneck,  so it pays to let the device
+// compress.  USB-CDC is faster than the device can compress and keeps the raw stream.
+static bool dl_use_lz4(void) {
+    return comms_ctx()->conn.send_via_fpc_usart;
+}
+
+// Compressed download. The device sends framed CMD_DOWNLOADED_LZ4 chunks,  which dl_it unpacks into dest,
+// and finishes with the same CMD_ACK as the raw stream.
+static bool dl_lz4(uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t flags, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+
+    download_raw_t payload = {
+        .startidx = start_index,
+        .len = bytes,
+        .flags = flags | DOWNLOAD_RAW_FLAG_LZ4,
+    };
+    SendCommandNG(CMD_DOWNLOAD_BIGBUF_RAW, (uint8_t *)&payload, sizeof(payload));
+
+    if (dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_LZ4) == false) {
+        return false;
+    }
+    return dl_check_ack(dest, bytes, response);
+}
@@ -45,8 +45,18 @@ extern "C" {
 #define CMD_BUFFER_SIZE 100
 #endif
 
+// The ring buffer grows up to this many replies during bursts
+#ifndef CMD_BUFFER_MAX_SIZE
+#define CMD_BUFFER_MAX_SIZE (CMD_BUFFER_SIZE * 64)
+#endif
+
 #define COMM_RAW_RECEIVE_LEN (1024)
 
+// Max number of commands kept in flight by SendCommandNGQueued
+#ifndef CMD_QUEUE_SIZE
+#define CMD_QUEUE_SIZE 8
+#endif
+
 typedef enum {
     BIG_BUF,
     BIG_BUF_EML,
@@ -84,13 +94,30 @@ typedef struct {
     char serial_port_name[FILE_PATH_SIZE];
 } communication_arg_t;
 
-extern communication_arg_t g_conn;
+// Connection settings of the device the calling thread talks to,  see SetCurrentDevice
+communication_arg_t *GetCurrentConnection(void);
+#define g_conn (*GetCurrentConnection())
+
+// Reply buffer statistics,  see `hw comms`
+typedef struct {
+    uint32_t stored;       // replies put in the buffer
+    uint32_t overflows;    // replies dropped since the buffer couldn't grow anymore
+    uint32_t grows;        // number of times the buffer was grown
+    uint32_t max_depth;    // highest number of replies waiting at once
+    uint32_t capacity;     // size of the current ring
+} comms_stats_t;
+
+typedef struct comms_ctx_s comms_ctx_t;
 
 typedef struct pm3_device {
-    communication_arg_t *g_conn;
+    communication_arg_t *conn;
     int script_embedded;
+    comms_ctx_t *ctx;
 } pm3_device_t;
 
+// Max number of devices driven at once,  main device included
+#define PM3_MAX_DEVICES 8
+
 
 void *uart_reconnect(void *targ);
 
@@ -109,17 +136,68 @@ bool SetCommunicationReceiveMode(bool isRawMode);
 void SetCommunicationRawReceiveBuffer(uint8_t *buffer, size_t len);
 size_t GetCommunicationRawReceiveNum(void);
 
+// CMD_BATCH builder, see BatchInit
+typedef struct {
+    uint8_t count;
+    uint16_t len;
+    uint8_t buf[PM3_CMD_DATA_SIZE];
+} pm3_batch_t;
+
+// Per command round trip timings,  see `hw timings`
+#define CMD_TIMING_SLOTS   64
+#define CMD_TIMING_BUCKETS 12
+typedef struct {
+    uint16_t cmd;
+    uint32_t sent;         // commands sent
+    uint32_t replied;      // replies matched to a sent command
+    uint32_t errors;       // of those,  replies with an RF error status
+    uint32_t timeouts;     // waits for its reply that timed out
+    uint64_t total_us;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t hist[CMD_TIMING_BUCKETS];
+} cmd_timing_t;
+
+void GetCommunicationStats(comms_stats_t *stats);
+void ResetCommunicationStats(void);
+size_t GetCommandTimings(cmd_timing_t *timings, size_t n);
+uint32_t GetCommandTimingBucketLimit(uint8_t bucket);
+void ResetCommandTimings(void);
+
 bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed);
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed);
 int TestProxmark(pm3_device_t *dev);
 void CloseProxmark(pm3_device_t *dev);
+
+void SetCurrentDevice(pm3_device_t *dev);
+int AttachProxmark(const char *port, uint32_t speed);
+int DetachProxmark(uint8_t idx);
+uint8_t GetDeviceCount(void);
+pm3_device_t *GetDevice(uint8_t idx);
 void StartReconnectProxmark(void);
 
+// called with each chunk of raw data as it arrives
+typedef void (*raw_data_cb_t)(const uint8_t *data, size_t len, void *arg);
+
 size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process);
+size_t WaitForRawDataTimeoutEx(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process, raw_data_cb_t callback, void *arg);
 bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool WaitForResponseTimeout(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout);
 bool WaitForResponse(uint32_t cmd, PacketResponseNG *response);
 
+int SendCommandNGQueued(uint16_t cmd, uint8_t *data, size_t len, uint16_t resp_cmd, uint32_t *seq);
+int SendCommandMIXQueued(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len, uint16_t resp_cmd, uint32_t *seq);
+bool WaitForQueuedResponse(uint32_t seq, PacketResponseNG *response, size_t ms_timeout);
+int PollQueuedResponse(uint32_t seq, PacketResponseNG *response);
+uint8_t GetCommandQueueCount(void);
+void clearCommandQueue(void);
+
+void BatchInit(pm3_batch_t *batch);
+int BatchAddNG(pm3_batch_t *batch, uint16_t cmd, const uint8_t *data, size_t len);
+int BatchAddMIX(pm3_batch_t *batch, uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
+int SendBatch(pm3_batch_t *batch, PacketResponseNG *response, size_t ms_timeout);
+bool BatchGetReply(const PacketResponseNG *response, uint16_t *offset, PacketResponseNG *reply);
+
 //bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 
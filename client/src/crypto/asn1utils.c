@@ -96,10 +96,10 @@ static void asn1_print_cb(void *data, const struct tlv *tlv, int level, bool is_
 
 int asn1_print(uint8_t *asn1buf, size_t asn1buflen, const char *indent) {
 
-    struct tlvdb *t = tlvdb_parse_multi(asn1buf, asn1buflen);
+    struct tlvdb_arena *t = tlvdb_arena_parse(asn1buf, asn1buflen, true);
     if (t) {
-        tlvdb_visit(t, asn1_print_cb, NULL, 0);
-        tlvdb_free(t);
+        tlvdb_visit(tlvdb_arena_root(t), asn1_print_cb, NULL, 0);
+        tlvdb_arena_free(t);
     } else {
         PrintAndLogEx(ERR, "Can't parse data as TLV tree");
         return PM3_ESOFT;
@@ -39,6 +39,7 @@
 #include "util.h"
 #include "ui.h"
 #include "math.h"
+#include <pthread.h>
 
 void des_encrypt(void *out, const void *in, const void *key) {
     mbedtls_des_context ctx;
@@ -513,6 +514,243 @@ int ecdsa_signature_r_s_verify(mbedtls_ecp_group_id curveid, uint8_t *key_xy, ui
 }
 
 
+// Batched originality checks.
+// mbedtls keeps the comb table of the group base point once it is computed, the
+// table of the public key is thrown away after every multiplication. Every key gets
+// a copy of the group with the key itself as base point, so both tables are built
+// once per worker thread and R = u1 G + u2 Q is two table multiplications.
+typedef struct {
+    bool valid;
+    mbedtls_ecp_point Q;
+    mbedtls_ecp_group qgrp;
+} ecdsa_batch_key_t;
+
+typedef struct {
+    mbedtls_ecp_group_id curveid;
+    const uint8_t *keys_xy;
+    size_t keys_count;
+    ecdsa_batch_item_t *items;
+    size_t items_count;
+    bool hash;
+    size_t next;
+} ecdsa_batch_job_t;
+
+// same curve as src with G as base point. A loaded group points into the curve
+// constants, this one owns its numbers so G can be replaced and everything freed
+static int ecdsa_group_with_base(mbedtls_ecp_group *dst, const mbedtls_ecp_group *src, const mbedtls_ecp_point *G) {
+    int ret = MBEDTLS_ERR_ERROR_CORRUPTION_DETECTED;
+
+    mbedtls_ecp_group_init(dst);
+    dst->id = src->id;
+    dst->pbits = src->pbits;
+    dst->nbits = src->nbits;
+    dst->modp = src->modp;
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&dst->P, &src->P));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&dst->A, &src->A));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&dst->B, &src->B));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_copy(&dst->N, &src->N));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_copy(&dst->G, G));
+
+cleanup:
+    if (ret) {
+        mbedtls_ecp_group_free(dst);
+    }
+    return ret;
+}
+
+// mbedtls_ecdsa_verify() with the u2 Q multiplication on the group of the key
+static int ecdsa_batch_verify(mbedtls_ecp_group *grp, ecdsa_batch_key_t *key, const uint8_t *buf, size_t blen, const mbedtls_mpi *r, const mbedtls_mpi *s) {
+    if (mbedtls_mpi_cmp_int(r, 1) < 0 || mbedtls_mpi_cmp_mpi(r, &grp->N) >= 0 ||
+            mbedtls_mpi_cmp_int(s, 1) < 0 || mbedtls_mpi_cmp_mpi(s, &grp->N) >= 0) {
+        return MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+    int ret = MBEDTLS_ERR_ERROR_CORRUPTION_DETECTED;
+    mbedtls_mpi e, s_inv, u1, u2, one;
+    mbedtls_ecp_point R, R1, R2;
+    mbedtls_mpi_init(&e);
+    mbedtls_mpi_init(&s_inv);
+    mbedtls_mpi_init(&u1);
+    mbedtls_mpi_init(&u2);
+    mbedtls_mpi_init(&one);
+    mbedtls_ecp_point_init(&R);
+    mbedtls_ecp_point_init(&R1);
+    mbedtls_ecp_point_init(&R2);
+
+    // message truncated to the size of the order
+    size_t n_size = (grp->nbits + 7) / 8;
+    size_t use_size = MIN(blen, n_size);
+    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&e, buf, use_size));
+    if (use_size * 8 > grp->nbits) {
+        MBEDTLS_MPI_CHK(mbedtls_mpi_shift_r(&e, use_size * 8 - grp->nbits));
+    }
+    if (mbedtls_mpi_cmp_mpi(&e, &grp->N) >= 0) {
+        MBEDTLS_MPI_CHK(mbedtls_mpi_sub_mpi(&e, &e, &grp->N));
+    }
+
+    // u1 = e / s mod n, u2 = r / s mod n
+    MBEDTLS_MPI_CHK(mbedtls_mpi_inv_mod(&s_inv, s, &grp->N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&u1, &e, &s_inv));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&u1, &u1, &grp->N));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mul_mpi(&u2, r, &s_inv));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&u2, &u2, &grp->N));
+
+    // R = u1 G + u2 Q,  muladd by one is just the point addition
+    MBEDTLS_MPI_CHK(mbedtls_ecp_mul(grp, &R1, &u1, &grp->G, NULL, NULL));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_mul(&key->qgrp, &R2, &u2, &key->qgrp.G, NULL, NULL));
+    MBEDTLS_MPI_CHK(mbedtls_mpi_lset(&one, 1));
+    MBEDTLS_MPI_CHK(mbedtls_ecp_muladd(grp, &R, &one, &R1, &one, &R2));
+
+    if (mbedtls_ecp_is_zero(&R)) {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+        goto cleanup;
+    }
+
+    MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&R.X, &R.X, &grp->N));
+    if (mbedtls_mpi_cmp_mpi(&R.X, r) != 0) {
+        ret = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+    }
+
+cleanup:
+    mbedtls_ecp_point_free(&R);
+    mbedtls_ecp_point_free(&R1);
+    mbedtls_ecp_point_free(&R2);
+    mbedtls_mpi_free(&e);
+    mbedtls_mpi_free(&s_inv);
+    mbedtls_mpi_free(&u1);
+    mbedtls_mpi_free(&u2);
+    mbedtls_mpi_free(&one);
+    return ret;
+}
+
+static void *ecdsa_batch_worker(void *arg) {
+    ecdsa_batch_job_t *job = (ecdsa_batch_job_t *)arg;
+
+    mbedtls_ecp_group grp;
+    mbedtls_ecp_group_init(&grp);
+
+    ecdsa_batch_key_t *keys = calloc(job->keys_count, sizeof(ecdsa_batch_key_t));
+    if (keys == NULL) {
+        return NULL;
+    }
+
+    if (mbedtls_ecp_group_load(&grp, job->curveid) == 0) {
+
+        // same key length as ecdsa_init()
+        size_t keylen = (grp.nbits + 7) / 8;
+        for (size_t i = 0; i < job->keys_count; i++) {
+            mbedtls_ecp_point_init(&keys[i].Q);
+            mbedtls_ecp_group_init(&keys[i].qgrp);
+
+            const uint8_t *xy = job->keys_xy + i * (keylen * 2 + 1);
+            keys[i].valid = (mbedtls_ecp_point_read_binary(&grp, &keys[i].Q, xy, keylen * 2 + 1) == 0) &&
+                            (mbedtls_ecp_check_pubkey(&grp, &keys[i].Q) == 0) &&
+                            (ecdsa_group_with_base(&keys[i].qgrp, &grp, &keys[i].Q) == 0);
+        }
+
+        for (;;) {
+            size_t n = __atomic_fetch_add(&job->next, 1, __ATOMIC_SEQ_CST);
+            if (n >= job->items_count) {
+                break;
+            }
+
+            ecdsa_batch_item_t *item = &job->items[n];
+
+            const uint8_t *buf = item->input;
+            size_t blen = item->length;
+            uint8_t shahash[32] = {0};
+            if (job->hash) {
+                if (sha256hash((uint8_t *)item->input, item->length, shahash)) {
+                    continue;
+                }
+                buf = shahash;
+                blen = sizeof(shahash);
+            }
+
+            mbedtls_mpi r, s;
+            mbedtls_mpi_init(&r);
+            mbedtls_mpi_init(&s);
+            if (mbedtls_mpi_read_binary(&r, item->r_s, item->r_s_len / 2) == 0 &&
+                    mbedtls_mpi_read_binary(&s, item->r_s + item->r_s_len / 2, item->r_s_len / 2) == 0) {
+
+                for (size_t i = 0; i < job->keys_count; i++) {
+                    if (keys[i].valid && ecdsa_batch_verify(&grp, &keys[i], buf, blen, &r, &s) == 0) {
+                        item->key = i;
+                        break;
+                    }
+                }
+            }
+            mbedtls_mpi_free(&r);
+            mbedtls_mpi_free(&s);
+        }
+
+        for (size_t i = 0; i < job->keys_count; i++) {
+            mbedtls_ecp_group_free(&keys[i].qgrp);
+            mbedtls_ecp_point_free(&keys[i].Q);
+        }
+    }
+
+    free(keys);
+    mbedtls_ecp_group_free(&grp);
+    return NULL;
+}
+
+int ecdsa_signature_r_s_verify_batch(mbedtls_ecp_group_id curveid, const uint8_t *keys_xy, size_t keys_count, ecdsa_batch_item_t *items, size_t items_count, bool hash, int threads) {
+    if (keys_xy == NULL || items == NULL) {
+        return PM3_EINVARG;
+    }
+
+    for (size_t i = 0; i < items_count; i++) {
+        items[i].key = -1;
+    }
+
+    if (items_count == 0 || keys_count == 0) {
+        return PM3_SUCCESS;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > items_count) {
+        threads = items_count;
+    }
+
+    ecdsa_batch_job_t job = {
+        .curveid = curveid,
+        .keys_xy = keys_xy,
+        .keys_count = keys_count,
+        .items = items,
+        .items_count = items_count,
+        .hash = hash,
+        .next = 0
+    };
+
+    pthread_t *pool = calloc(threads, sizeof(pthread_t));
+    if (pool == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    int started = 0;
+    for (; started < threads; started++) {
+        if (pthread_create(&pool[started], NULL, ecdsa_batch_worker, &job)) {
+            break;
+        }
+    }
+
+    // the calling thread does the work if no worker could be started
+    if (started == 0) {
+        ecdsa_batch_worker(&job);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    free(pool);
+    return PM3_SUCCESS;
+}
+
+
 #define T_PRIVATE_KEY "C477F9F65C22CCE20657FAA5B2D1D8122336F851A508A1ED04E479C34985BF96"
 #define T_Q_X         "B7E08AFDFE94BAD3F1DC8C734798BA1C62B3A0AD1E9EA2A38201CD0889BC7A19"
 #define T_Q_Y         "3603F747959DBF7A4BB226E41928729063ADC7AE43529E61B563BBC606CC5E09"
@@ -51,6 +51,18 @@ int ecdsa_signature_create(mbedtls_ecp_group_id curveid, uint8_t *key_d, uint8_t
 int ecdsa_signature_verify(mbedtls_ecp_group_id curveid, uint8_t *key_xy, uint8_t *input, int length, uint8_t *signature, size_t signaturelen, bool hash);
 int ecdsa_signature_r_s_verify(mbedtls_ecp_group_id curveid, uint8_t *key_xy, uint8_t *input, int length, uint8_t *r_s, size_t r_s_len, bool hash);
 
+// one signature of a batch, checked against every key until one verifies it
+typedef struct {
+    const uint8_t *input;
+    int length;
+    const uint8_t *r_s;
+    size_t r_s_len;
+    int key;            // out: index of the key that verified the signature, -1 when none did
+} ecdsa_batch_item_t;
+
+// keys_xy: keys_count uncompressed public keys of the curve, back to back (04 || x || y)
+int ecdsa_signature_r_s_verify_batch(mbedtls_ecp_group_id curveid, const uint8_t *keys_xy, size_t keys_count, ecdsa_batch_item_t *items, size_t items_count, bool hash, int threads);
+
 char *ecdsa_get_error(int ret);
 
 int ecdsa_nist_test(bool verbose);
@@ -0,0 +1,429 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Dump store,  MIFARE Classic dumps kept as references to deduplicated blocks
+//
+// <store>/blocks.pm3s holds every distinct 16 byte block once,  append only.
+// A dump is a small <store>/uid/<UID>.pm3ref file with the index of each of
+// its blocks,  so dumps sharing keys, trailers and empty blocks share storage
+// and a UID is loaded without looking at any other dump.  Blocks no longer
+// used by any dump are not removed.
+//-----------------------------------------------------------------------------
+
+#include "dumpstore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include "ui.h"
+#include "util.h"
+#include "fileutils.h"
+
+#define DUMPSTORE_BLOCKS_FILE   "blocks.pm3s"
+#define DUMPSTORE_UID_DIR       "uid"
+
+// blocks of the store in memory,  with a hash table of their positions (+1, 0 is empty)
+static struct {
+    char *path;
+    uint8_t *blocks;
+    uint32_t count;
+    uint32_t size;
+    uint32_t *table;
+    uint32_t mask;
+} ds_cache;
+
+static void ds_cache_free(void) {
+    free(ds_cache.path);
+    free(ds_cache.blocks);
+    free(ds_cache.table);
+    memset(&ds_cache, 0, sizeof(ds_cache));
+}
+
+static uint32_t ds_hash(const uint8_t *block) {
+    uint32_t h = 0x811C9DC5;
+    for (int i = 0; i < DUMPSTORE_BLOCK_SIZE; i++) {
+        h = (h ^ block[i]) * 0x01000193;
+    }
+    return h;
+}
+
+static void ds_table_insert(uint32_t idx) {
+    uint32_t slot = ds_hash(ds_cache.blocks + ((size_t)idx * DUMPSTORE_BLOCK_SIZE)) & ds_cache.mask;
+    while (ds_cache.table[slot]) {
+        slot = (slot + 1) & ds_cache.mask;
+    }
+    ds_cache.table[slot] = idx + 1;
+}
+
+// keep the table at most half full
+static int ds_table_grow(uint32_t count) {
+    if (ds_cache.table && (count * 2) <= ds_cache.mask) {
+        return PM3_SUCCESS;
+    }
+
+    uint32_t n = 1024;
+    while (n < count * 2 + 2) {
+        n <<= 1;
+    }
+
+    uint32_t *table = calloc(n, sizeof(uint32_t));
+    if (table == NULL) {
+        return PM3_EMALLOC;
+    }
+    free(ds_cache.table);
+    ds_cache.table = table;
+    ds_cache.mask = n - 1;
+
+    for (uint32_t i = 0; i < ds_cache.count; i++) {
+        ds_table_insert(i);
+    }
+    return PM3_SUCCESS;
+}
+
+static int ds_join(char *out, size_t outlen, const char *a, const char *b) {
+    int n = snprintf(out, outlen, "%s%s%s", a, str_endswith(a, PATHSEP) ? "" : PATHSEP, b);
+    return (n < 0 || (size_t)n >= outlen) ? PM3_EOVFLOW : PM3_SUCCESS;
+}
+
+static int ds_mkdir(const char *path) {
+    if (is_directory(path)) {
+        return PM3_SUCCESS;
+    }
+#ifdef _WIN32
+    int res = _mkdir(path);
+#else
+    int res = mkdir(path, 0700);
+#endif
+    if (res != 0) {
+        PrintAndLogEx(WARNING, "could not create directory " _YELLOW_("%s"), path);
+        return PM3_EFILE;
+    }
+    return PM3_SUCCESS;
+}
+
+static const char *ds_root(void) {
+    const char *root = g_session.defaultPaths[spStore];
+    if (root == NULL || strlen(root) == 0) {
+        PrintAndLogEx(WARNING, "no dump store path, see " _YELLOW_("`prefs set savepaths --store`"));
+        return NULL;
+    }
+    return root;
+}
+
+// (re)load the block file when it isn't the one in memory,  another client may have added to it
+static int ds_cache_load(const char *root) {
+
+    char fn[FILE_PATH_SIZE];
+    int res = ds_join(fn, sizeof(fn), root, DUMPSTORE_BLOCKS_FILE);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    struct stat st;
+    uint64_t fsize = (stat(fn, &st) == 0) ? (uint64_t)st.st_size : 0;
+
+    if (ds_cache.path && strcmp(ds_cache.path, root) == 0 && fsize == (uint64_t)ds_cache.count * DUMPSTORE_BLOCK_SIZE) {
+        return PM3_SUCCESS;
+    }
+
+    ds_cache_free();
+
+    if (fsize % DUMPSTORE_BLOCK_SIZE || fsize / DUMPSTORE_BLOCK_SIZE >= UINT32_MAX / 2) {
+        PrintAndLogEx(WARNING, "dump store block file is damaged " _YELLOW_("%s"), fn);
+        return PM3_EFILE;
+    }
+
+    ds_cache.path = strdup(root);
+    ds_cache.count = fsize / DUMPSTORE_BLOCK_SIZE;
+    ds_cache.size = ds_cache.count + 256;
+    ds_cache.blocks = calloc(ds_cache.size, DUMPSTORE_BLOCK_SIZE);
+    if (ds_cache.path == NULL || ds_cache.blocks == NULL) {
+        ds_cache_free();
+        return PM3_EMALLOC;
+    }
+
+    if (fsize) {
+        FILE *f = fopen(fn, "rb");
+        if (f == NULL || fread(ds_cache.blocks, DUMPSTORE_BLOCK_SIZE, ds_cache.count, f) != ds_cache.count) {
+            PrintAndLogEx(WARNING, "could not read " _YELLOW_("%s"), fn);
+            if (f) {
+                fclose(f);
+            }
+            ds_cache_free();
+            return PM3_EFILE;
+        }
+        fclose(f);
+    }
+
+    res = ds_table_grow(ds_cache.count);
+    if (res != PM3_SUCCESS) {
+        ds_cache_free();
+    }
+    return res;
+}
+
+// index of the block,  added at the end of the cache when new
+static int ds_block_index(const uint8_t *block, uint32_t *idx) {
+
+    uint32_t slot = ds_hash(block) & ds_cache.mask;
+    while (ds_cache.table[slot]) {
+        uint32_t i = ds_cache.table[slot] - 1;
+        if (memcmp(ds_cache.blocks + ((size_t)i * DUMPSTORE_BLOCK_SIZE), block, DUMPSTORE_BLOCK_SIZE) == 0) {
+            *idx = i;
+            return PM3_SUCCESS;
+        }
+        slot = (slot + 1) & ds_cache.mask;
+    }
+
+    if (ds_cache.count == ds_cache.size) {
+        uint32_t n = ds_cache.size * 2;
+        uint8_t *tmp = realloc(ds_cache.blocks, (size_t)n * DUMPSTORE_BLOCK_SIZE);
+        if (tmp == NULL) {
+            return PM3_EMALLOC;
+        }
+        ds_cache.blocks = tmp;
+        ds_cache.size = n;
+    }
+
+    int res = ds_table_grow(ds_cache.count + 1);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    *idx = ds_cache.count;
+    memcpy(ds_cache.blocks + ((size_t)ds_cache.count * DUMPSTORE_BLOCK_SIZE), block, DUMPSTORE_BLOCK_SIZE);
+    ds_cache.count++;
+    ds_table_insert(*idx);
+    return PM3_SUCCESS;
+}
+
+// uppercase hex UID,  the name of its ref file
+static int ds_uid_name(const char *uid, char *out, size_t outlen) {
+    size_t n = strlen(uid);
+    if (n == 0 || n % 2 || n > 20 || n >= outlen) {
+        return PM3_EINVARG;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (isxdigit((unsigned char)uid[i]) == 0) {
+            return PM3_EINVARG;
+        }
+        out[i] = toupper((unsigned char)uid[i]);
+    }
+    out[n] = '\0';
+    return PM3_SUCCESS;
+}
+
+static int ds_ref_path(const char *root, const char *uidname, char *out, size_t outlen) {
+    char dir[FILE_PATH_SIZE];
+    char name[48];
+    int res = ds_join(dir, sizeof(dir), root, DUMPSTORE_UID_DIR);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    snprintf(name, sizeof(name), "%s.pm3ref", uidname);
+    return ds_join(out, outlen, dir, name);
+}
+
+int dumpstore_put(const uint8_t *uid, uint8_t uidlen, const uint8_t *dump, size_t dumplen, bool verbose) {
+
+    if (uid == NULL || uidlen == 0 || uidlen > 10 || dump == NULL || dumplen == 0 ||
+            dumplen % DUMPSTORE_BLOCK_SIZE || dumplen / DUMPSTORE_BLOCK_SIZE > UINT16_MAX) {
+        return PM3_EINVARG;
+    }
+
+    const char *root = ds_root();
+    if (root == NULL) {
+        return PM3_EINVARG;
+    }
+
+    char dir[FILE_PATH_SIZE];
+    int res = ds_join(dir, sizeof(dir), root, DUMPSTORE_UID_DIR);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    res = ds_mkdir(root);
+    if (res == PM3_SUCCESS) {
+        res = ds_mkdir(dir);
+    }
+    if (res == PM3_SUCCESS) {
+        res = ds_cache_load(root);
+    }
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    uint16_t blocks = dumplen / DUMPSTORE_BLOCK_SIZE;
+    uint32_t *refs = calloc(blocks, sizeof(uint32_t));
+    if (refs == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    uint32_t first_new = ds_cache.count;
+    for (uint16_t i = 0; i < blocks && res == PM3_SUCCESS; i++) {
+        res = ds_block_index(dump + (i * DUMPSTORE_BLOCK_SIZE), &refs[i]);
+    }
+
+    char fn[FILE_PATH_SIZE];
+    if (res == PM3_SUCCESS) {
+        res = ds_join(fn, sizeof(fn), root, DUMPSTORE_BLOCKS_FILE);
+    }
+
+    // the new blocks go to disk before any dump refers to them
+    uint32_t added = ds_cache.count - first_new;
+    if (res == PM3_SUCCESS && added) {
+        FILE *f = fopen(fn, "ab");
+        if (f == NULL || fwrite(ds_cache.blocks + ((size_t)first_new * DUMPSTORE_BLOCK_SIZE), DUMPSTORE_BLOCK_SIZE, added, f) != added) {
+            PrintAndLogEx(WARNING, "could not write " _YELLOW_("%s"), fn);
+            res = PM3_EFILE;
+        }
+        if (f && fclose(f) != 0) {
+            res = PM3_EFILE;
+        }
+    }
+
+    if (res != PM3_SUCCESS) {
+        // the cache no longer matches the file,  read it again next time
+        ds_cache_free();
+        free(refs);
+        return res;
+    }
+
+    dumpstore_ref_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DUMPSTORE_REF_MAGIC, sizeof(hdr.magic));
+    hdr.version = DUMPSTORE_REF_VERSION;
+    hdr.uidlen = uidlen;
+    hdr.blocks = blocks;
+    memcpy(hdr.uid, uid, uidlen);
+
+    char uidname[32];
+    ds_uid_name(sprint_hex_inrow(uid, uidlen), uidname, sizeof(uidname));
+    res = ds_ref_path(root, uidname, fn, sizeof(fn));
+    if (res != PM3_SUCCESS) {
+        free(refs);
+        return res;
+    }
+
+    FILE *f = fopen(fn, "wb");
+    if (f == NULL || fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(refs, sizeof(uint32_t), blocks, f) != blocks) {
+        PrintAndLogEx(WARNING, "could not write " _YELLOW_("%s"), fn);
+        res = PM3_EFILE;
+    }
+    if (f && fclose(f) != 0) {
+        res = PM3_EFILE;
+    }
+    free(refs);
+
+    if (res == PM3_SUCCESS && verbose) {
+        PrintAndLogEx(SUCCESS, "Stored dump of UID " _YELLOW_("%s") ", " _YELLOW_("%u") " of " _YELLOW_("%u") " blocks new", uidname, added, blocks);
+    }
+    return res;
+}
+
+bool dumpstore_has(const char *uid) {
+    char uidname[32];
+    char fn[FILE_PATH_SIZE];
+    const char *root = g_session.defaultPaths[spStore];
+
+    if (uid == NULL || root == NULL || strlen(root) == 0 ||
+            ds_uid_name(uid, uidname, sizeof(uidname)) != PM3_SUCCESS ||
+            ds_ref_path(root, uidname, fn, sizeof(fn)) != PM3_SUCCESS) {
+        return false;
+    }
+    return fileExists(fn);
+}
+
+int dumpstore_get(const char *uid, uint8_t **pdump, size_t *dumplen) {
+
+    char uidname[32];
+    if (uid == NULL || ds_uid_name(uid, uidname, sizeof(uidname)) != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "invalid UID");
+        return PM3_EINVARG;
+    }
+
+    const char *root = ds_root();
+    if (root == NULL) {
+        return PM3_EINVARG;
+    }
+
+    char fn[FILE_PATH_SIZE];
+    int res = ds_ref_path(root, uidname, fn, sizeof(fn));
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    FILE *f = fopen(fn, "rb");
+    if (f == NULL) {
+        PrintAndLogEx(FAILED, "UID " _YELLOW_("%s") " is not in the dump store", uidname);
+        return PM3_EFILE;
+    }
+
+    dumpstore_ref_t hdr;
+    uint32_t *refs = NULL;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, DUMPSTORE_REF_MAGIC, sizeof(hdr.magic)) ||
+            hdr.version != DUMPSTORE_REF_VERSION || hdr.blocks == 0) {
+        res = PM3_ESOFT;
+    } else {
+        refs = calloc(hdr.blocks, sizeof(uint32_t));
+        if (refs == NULL) {
+            res = PM3_EMALLOC;
+        } else if (fread(refs, sizeof(uint32_t), hdr.blocks, f) != hdr.blocks) {
+            res = PM3_ESOFT;
+        }
+    }
+    fclose(f);
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "damaged dump store file " _YELLOW_("%s"), fn);
+        free(refs);
+        return res;
+    }
+
+    uint8_t *dump = calloc(hdr.blocks, DUMPSTORE_BLOCK_SIZE);
+    res = ds_join(fn, sizeof(fn), root, DUMPSTORE_BLOCKS_FILE);
+    f = (dump && res == PM3_SUCCESS) ? fopen(fn, "rb") : NULL;
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "could not open " _YELLOW_("%s"), fn);
+        free(dump);
+        free(refs);
+        return (dump) ? PM3_EFILE : PM3_EMALLOC;
+    }
+
+    for (uint16_t i = 0; i < hdr.blocks && res == PM3_SUCCESS; i++) {
+        if (fseek(f, (long)refs[i] * DUMPSTORE_BLOCK_SIZE, SEEK_SET) != 0 ||
+                fread(dump + (i * DUMPSTORE_BLOCK_SIZE), DUMPSTORE_BLOCK_SIZE, 1, f) != 1) {
+            PrintAndLogEx(WARNING, "dump store block file is damaged " _YELLOW_("%s"), fn);
+            res = PM3_EFILE;
+        }
+    }
+    fclose(f);
+    free(refs);
+
+    if (res != PM3_SUCCESS) {
+        free(dump);
+        return res;
+    }
+
+    PrintAndLogEx(SUCCESS, "Loaded " _YELLOW_("%u") " blocks of UID " _YELLOW_("%s") " from the dump store", hdr.blocks, uidname);
+    *pdump = dump;
+    *dumplen = (size_t)hdr.blocks * DUMPSTORE_BLOCK_SIZE;
+    return PM3_SUCCESS;
+}
@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Dump store,  MIFARE Classic dumps kept as references to deduplicated blocks
+//-----------------------------------------------------------------------------
+
+#ifndef DUMPSTORE_H__
+#define DUMPSTORE_H__
+
+#include "common.h"
+
+// default location below the .proxmark3 folder, `prefs set savepaths --store` changes it
+#define DUMPSTORE_SUBDIR        "dumpstore"
+#define DUMPSTORE_BLOCK_SIZE    16
+
+#define DUMPSTORE_REF_MAGIC     "PM3R"
+#define DUMPSTORE_REF_VERSION   1
+
+// <store>/uid/<UID>.pm3ref,  followed by one uint32_t block index per dump block
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t uidlen;
+    uint16_t blocks;
+    uint8_t uid[10];
+    uint8_t rfu[2];
+} PACKED dumpstore_ref_t;
+
+/**
+ * @brief Add a dump to the store,  replacing an older one with the same UID.
+ * Only blocks the store doesn't hold yet are written.
+ *
+ * @param uid card UID
+ * @param uidlen 4, 7 or 10
+ * @param dump dump data,  a multiple of 16 bytes
+ * @param dumplen
+ * @param verbose
+ * @return PM3_SUCCESS if OK
+ */
+int dumpstore_put(const uint8_t *uid, uint8_t uidlen, const uint8_t *dump, size_t dumplen, bool verbose);
+
+// true if the store holds a dump of this UID (hex string)
+bool dumpstore_has(const char *uid);
+
+/**
+ * @brief Load the dump of a UID from the store.
+ *
+ * @param uid UID as hex string
+ * @param pdump allocated buffer with the dump,  caller frees it
+ * @param dumplen
+ * @return PM3_SUCCESS if OK,  PM3_EFILE if the UID isn't stored
+ */
+int dumpstore_get(const char *uid, uint8_t **pdump, size_t *dumplen);
+
+#endif
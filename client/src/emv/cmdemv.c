@@ -38,6 +38,7 @@
 #include <mbedtls/des.h>    // DES
 #include "crypto/libpcrypto.h"
 #include "iso4217.h"        // currency lookup
+#include "util.h"           // num_CPUs
 
 
 static int CmdHelp(const char *Cmd);
@@ -1535,12 +1536,26 @@ static int CmdEMVExec(const char *Cmd) {
         PrintAndLogEx(WARNING, "WARNING: AFL not found.");
     }
 
+    // all records of the AFL go to the card in one go,  then get processed in order
+    emv_record_t *records = NULL;
+    uint8_t *records_entry = NULL;
+    uint8_t offline[0x100 / 4] = {0};
+    size_t records_count = 0;
+
     while (AFL && AFL->len) {
-        if (AFL->len % 4) {
+        if ((AFL->len % 4) || (AFL->len > sizeof(offline) * 4)) {
             PrintAndLogEx(WARNING, "Warning: Wrong AFL length: %zu", AFL->len);
             break;
         }
 
+        // an AFL entry covers up to 255 records
+        records = calloc((AFL->len / 4) * 0xff, sizeof(emv_record_t));
+        records_entry = calloc((AFL->len / 4) * 0xff, sizeof(uint8_t));
+        if (records == NULL || records_entry == NULL) {
+            PrintAndLogEx(ERR, "failed to allocate memory");
+            break;
+        }
+
         for (int i = 0; i < AFL->len / 4; i++) {
             uint8_t SFI = AFL->value[i * 4 + 0] >> 3;
             uint8_t SFIstart = AFL->value[i * 4 + 1];
@@ -1554,44 +1569,59 @@ static int CmdEMVExec(const char *Cmd) {
             }
 
             for (int n = SFIstart; n <= SFIend; n++) {
-                PrintAndLogEx(INFO, "* * * SFI[%02x] %d", SFI, n);
+                records[records_count].sfi = SFI;
+                records[records_count].rec = n;
+                records_entry[records_count] = i;
+                records_count++;
+            }
+            offline[i] = SFIoffline;
+        }
 
-                res = EMVReadRecord(channel, true, SFI, n, buf, sizeof(buf), &len, &sw, tlvRoot);
-                if (res) {
-                    PrintAndLogEx(WARNING, "Error SFI[%02x]. APDU error %4x", SFI, sw);
-                    continue;
-                }
+        EMVReadRecords(channel, true, records, records_count, tlvRoot);
 
-                if (decodeTLV) {
-                    TLVPrintFromBuffer(buf, len);
-                    PrintAndLogEx(NORMAL, "");
-                }
+        for (size_t i = 0; i < records_count; i++) {
+            uint8_t SFI = records[i].sfi;
+            uint8_t *rbuf = records[i].data;
+            size_t rlen = records[i].len;
 
-                // Build Input list for Offline Data Authentication
-                // EMV 4.3 book3 10.3, page 96
-                if (SFIoffline > 0) {
-                    if (SFI < 11) {
-                        const unsigned char *abuf = buf;
-                        size_t elmlen = len;
-                        struct tlv e;
-                        if (tlv_parse_tl(&abuf, &elmlen, &e)) {
-                            memcpy(&ODAiList[ODAiListLen], &buf[len - elmlen], elmlen);
-                            ODAiListLen += elmlen;
-                        } else {
-                            PrintAndLogEx(WARNING, "Error SFI[%02x]. Creating input list for Offline Data Authentication error.", SFI);
-                        }
+            PrintAndLogEx(INFO, "* * * SFI[%02x] %d", SFI, records[i].rec);
+
+            if (records[i].res) {
+                PrintAndLogEx(WARNING, "Error SFI[%02x]. APDU error %4x", SFI, records[i].sw);
+                continue;
+            }
+
+            if (decodeTLV) {
+                TLVPrintFromBuffer(rbuf, rlen);
+                PrintAndLogEx(NORMAL, "");
+            }
+
+            // Build Input list for Offline Data Authentication
+            // EMV 4.3 book3 10.3, page 96
+            if (offline[records_entry[i]] > 0) {
+                if (SFI < 11) {
+                    const unsigned char *abuf = rbuf;
+                    size_t elmlen = rlen;
+                    struct tlv e;
+                    if (tlv_parse_tl(&abuf, &elmlen, &e)) {
+                        memcpy(&ODAiList[ODAiListLen], &rbuf[rlen - elmlen], elmlen);
+                        ODAiListLen += elmlen;
                     } else {
-                        memcpy(&ODAiList[ODAiListLen], buf, len);
-                        ODAiListLen += len;
+                        PrintAndLogEx(WARNING, "Error SFI[%02x]. Creating input list for Offline Data Authentication error.", SFI);
                     }
-
-                    SFIoffline--;
+                } else {
+                    memcpy(&ODAiList[ODAiListLen], rbuf, rlen);
+                    ODAiListLen += rlen;
                 }
+
+                offline[records_entry[i]]--;
             }
         }
 
         break;
     }
+    free(records_entry);
+    free(records);
 
     // copy Input list for Offline Data Authentication
     if (ODAiListLen) {
@@ -2415,12 +2445,106 @@ static int CmdEMVTest(const char *Cmd) {
     return ExecuteCryptoTests(true, ignoreTimeTest, runSlowTests);
 }
 
+// text file,  one hex modulus per line,  '#' starts a comment line
+static int emv_roca_file(const char *filename) {
+    char *data = NULL;
+    size_t datalen = 0;
+    int res = loadFile_safe(filename, "", (void **)&data, &datalen);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    // moduli are half the size of their hex text
+    uint8_t *moduli = calloc(datalen / 2 + 1, sizeof(uint8_t));
+    char *text = calloc(datalen + 1, sizeof(char));
+    size_t items_max = 64;
+    roca_bulk_item_t *items = calloc(items_max, sizeof(roca_bulk_item_t));
+    size_t *lines = calloc(items_max, sizeof(size_t));
+    if (moduli == NULL || text == NULL || items == NULL || lines == NULL) {
+        PrintAndLogEx(ERR, "failed to allocate memory");
+        res = PM3_EMALLOC;
+        goto out;
+    }
+    memcpy(text, data, datalen);
+
+    size_t count = 0;
+    size_t used = 0;
+    size_t lineno = 0;
+    for (char *line = text; line && *line;) {
+        char *next = strchr(line, '\n');
+        if (next) {
+            *next++ = 0;
+        }
+        line[strcspn(line, "\r")] = 0;
+        lineno++;
+
+        int len = 0;
+        if (line[0] != '#' && strspn(line, " \t") != strlen(line)) {
+            len = hex_to_bytes(line, moduli + used, datalen / 2 + 1 - used);
+            if (len <= 0) {
+                PrintAndLogEx(WARNING, "line %zu, not a hex modulus. Skipped", lineno);
+                len = 0;
+            }
+        }
+
+        if (len) {
+            if (count == items_max) {
+                items_max *= 2;
+                roca_bulk_item_t *ni = realloc(items, items_max * sizeof(roca_bulk_item_t));
+                size_t *nl = realloc(lines, items_max * sizeof(size_t));
+                if (ni) {
+                    items = ni;
+                }
+                if (nl) {
+                    lines = nl;
+                }
+                if (ni == NULL || nl == NULL) {
+                    PrintAndLogEx(ERR, "failed to allocate memory");
+                    res = PM3_EMALLOC;
+                    goto out;
+                }
+            }
+            items[count].modulus = moduli + used;
+            items[count].len = len;
+            lines[count] = lineno;
+            used += len;
+            count++;
+        }
+
+        line = next;
+    }
+
+    res = emv_rocacheck_bulk(items, count, num_CPUs());
+    if (res != PM3_SUCCESS) {
+        goto out;
+    }
+
+    size_t weak = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].weak) {
+            PrintAndLogEx(SUCCESS, "line %zu, %zu bits modulus is " _RED_("subject") " to ROCA vulnerability", lines[i], items[i].len * 8);
+            weak++;
+        }
+    }
+
+    PrintAndLogEx(INFO, "Checked " _YELLOW_("%zu") " moduli, " _YELLOW_("%zu") " weak", count, weak);
+
+out:
+    free(lines);
+    free(items);
+    free(text);
+    free(moduli);
+    free(data);
+    return res;
+}
+
 static int CmdEMVRoca(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "emv roca",
                   "Tries to extract public keys and run the ROCA test against them.\n",
                   "emv roca -w  -> select --CONTACT-- card and run test\n"
                   "emv roca     -> select --CONTACTLESS-- card and run test\n"
+                  "emv roca -f moduli.txt -> check all moduli in file\n"
                  );
 
     void *argtable[] = {
@@ -2428,6 +2552,7 @@ static int CmdEMVRoca(const char *Cmd) {
         arg_lit0("t",  "selftest", "Self test"),
         arg_lit0("a",  "apdu",     "Show APDU requests and responses"),
         arg_lit0("w",  "wired",    "Send data via contact (iso7816) interface. (def: Contactless interface)"),
+        arg_str0("f",  "file",     "<fn>", "Check RSA moduli from text file, one hex modulus per line"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -2437,6 +2562,14 @@ static int CmdEMVRoca(const char *Cmd) {
         return roca_self_test();
     }
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    if (fnlen) {
+        CLIParserFree(ctx);
+        return emv_roca_file(filename);
+    }
+
     bool show_apdu = arg_get_lit(ctx, 2);
 
     Iso7816CommandChannel channel = CC_CONTACTLESS;
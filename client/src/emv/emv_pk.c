@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #include "ui.h"
 #include "crypto.h"
@@ -414,6 +415,22 @@ void emv_pk_free(struct emv_pk *pk) {
     free(pk);
 }
 
+struct emv_pk *emv_pk_copy(const struct emv_pk *pk) {
+    if (!pk)
+        return NULL;
+
+    struct emv_pk *copy = emv_pk_new(pk->mlen, pk->elen);
+    if (!copy)
+        return NULL;
+
+    unsigned char *modulus = copy->modulus;
+    memcpy(copy, pk, sizeof(*copy));
+    copy->modulus = modulus;
+    memcpy(copy->modulus, pk->modulus, pk->mlen);
+
+    return copy;
+}
+
 static struct emv_pk *emv_pk_get_ca_pk_from_file(const char *fname,
                                                  const unsigned char *rid,
                                                  unsigned char idx) {
@@ -487,6 +504,139 @@ char *emv_pk_get_ca_pk_rid_file(const char *dirname, const unsigned char *rid) {
     return filename;
 }
 
+// capk.txt gets parsed once,  lookups go through a table sorted by rid and index.
+// The table is rebuilt when the file found by searchFile changes.
+typedef struct {
+    struct emv_pk *pk;
+    size_t line;
+    int verified;  // -1 not checked yet
+} emv_pk_index_entry_t;
+
+static struct {
+    char *path;
+    time_t mtime;
+    off_t size;
+    emv_pk_index_entry_t *entries;
+    size_t count;
+} capk_index;
+
+static int emv_pk_index_cmp(const void *a, const void *b) {
+    const emv_pk_index_entry_t *ea = a;
+    const emv_pk_index_entry_t *eb = b;
+
+    int res = memcmp(ea->pk->rid, eb->pk->rid, sizeof(ea->pk->rid));
+    if (res)
+        return res;
+
+    if (ea->pk->index != eb->pk->index)
+        return (ea->pk->index < eb->pk->index) ? -1 : 1;
+
+    // same key listed twice,  file order decides
+    if (ea->line != eb->line)
+        return (ea->line < eb->line) ? -1 : 1;
+
+    return 0;
+}
+
+static void emv_pk_index_free(void) {
+    for (size_t i = 0; i < capk_index.count; i++)
+        emv_pk_free(capk_index.entries[i].pk);
+
+    free(capk_index.entries);
+    free(capk_index.path);
+    memset(&capk_index, 0, sizeof(capk_index));
+}
+
+static bool emv_pk_index_load(const char *fname) {
+    struct stat st;
+    if (stat(fname, &st))
+        return false;
+
+    if (capk_index.path && !strcmp(capk_index.path, fname) &&
+            capk_index.mtime == st.st_mtime && capk_index.size == st.st_size)
+        return true;
+
+    emv_pk_index_free();
+
+    FILE *f = fopen(fname, "r");
+    if (!f) {
+        PrintAndLogEx(ERR, "Error: can't open file %s.", fname);
+        return false;
+    }
+
+    size_t allocated = 0;
+    size_t line = 0;
+    while (!feof(f)) {
+        char buf[2048];
+        if (fgets(buf, sizeof(buf), f) == NULL)
+            break;
+        line++;
+
+        struct emv_pk *pk = emv_pk_parse_pk(buf, sizeof(buf));
+        if (!pk)
+            continue;
+
+        if (capk_index.count == allocated) {
+            allocated = allocated ? allocated * 2 : 64;
+            emv_pk_index_entry_t *entries = realloc(capk_index.entries, allocated * sizeof(emv_pk_index_entry_t));
+            if (!entries) {
+                emv_pk_free(pk);
+                fclose(f);
+                emv_pk_index_free();
+                return false;
+            }
+            capk_index.entries = entries;
+        }
+
+        capk_index.entries[capk_index.count].pk = pk;
+        capk_index.entries[capk_index.count].line = line;
+        capk_index.entries[capk_index.count].verified = -1;
+        capk_index.count++;
+    }
+    fclose(f);
+
+    qsort(capk_index.entries, capk_index.count, sizeof(emv_pk_index_entry_t), emv_pk_index_cmp);
+
+    // only the first key of the file with a given rid and index is ever used
+    size_t n = 0;
+    for (size_t i = 0; i < capk_index.count; i++) {
+        if (n && !memcmp(capk_index.entries[n - 1].pk->rid, capk_index.entries[i].pk->rid, 5) &&
+                capk_index.entries[n - 1].pk->index == capk_index.entries[i].pk->index) {
+            emv_pk_free(capk_index.entries[i].pk);
+            continue;
+        }
+        capk_index.entries[n++] = capk_index.entries[i];
+    }
+    capk_index.count = n;
+
+    capk_index.path = strdup(fname);
+    capk_index.mtime = st.st_mtime;
+    capk_index.size = st.st_size;
+    return true;
+}
+
+static emv_pk_index_entry_t *emv_pk_index_find(const unsigned char *rid, unsigned char idx) {
+    size_t lo = 0;
+    size_t hi = capk_index.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct emv_pk *pk = capk_index.entries[mid].pk;
+
+        int res = memcmp(pk->rid, rid, 5);
+        if (!res)
+            res = (pk->index == idx) ? 0 : ((pk->index < idx) ? -1 : 1);
+
+        if (!res)
+            return &capk_index.entries[mid];
+
+        if (res < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
 struct emv_pk *emv_pk_get_ca_pk(const unsigned char *rid, unsigned char idx) {
     struct emv_pk *pk = NULL;
 
@@ -510,13 +660,27 @@ struct emv_pk *emv_pk_get_ca_pk(const unsigned char *rid, unsigned char idx) {
     if (searchFile(&path, RESOURCES_SUBDIR, "capk", ".txt", false) != PM3_SUCCESS) {
         return NULL;
     }
-    pk = emv_pk_get_ca_pk_from_file(path, rid, idx);
+
+    emv_pk_index_entry_t *entry = NULL;
+    if (emv_pk_index_load(path)) {
+        entry = emv_pk_index_find(rid, idx);
+        pk = entry ? emv_pk_copy(entry->pk) : NULL;
+    } else {
+        pk = emv_pk_get_ca_pk_from_file(path, rid, idx);
+    }
     free(path);
 
     if (!pk)
         return NULL;
 
-    bool isok = emv_pk_verify(pk);
+    bool isok;
+    if (entry) {
+        if (entry->verified < 0)
+            entry->verified = emv_pk_verify(pk);
+        isok = entry->verified;
+    } else {
+        isok = emv_pk_verify(pk);
+    }
 
     PrintAndLogEx(INFO, "Verifying CA PK for %02hhx:%02hhx:%02hhx:%02hhx:%02hhx IDX %02hhx %zu bits.  ( %s )",
                   pk->rid[0],
@@ -159,6 +159,27 @@ static unsigned char emv_cn_get(const struct tlv *tlv, unsigned pos) {
         return c >> 4;
 }
 
+static bool emv_pki_check_pan(unsigned char msgtype, const struct tlv *pan_tlv, const struct tlv *pan2_tlv) {
+    unsigned pan_len = emv_cn_length(pan_tlv);
+    unsigned pan2_len = emv_cn_length(pan2_tlv);
+
+    if (((msgtype == 2) && (pan2_len < 4 || pan2_len > pan_len)) ||
+            ((msgtype == 4) && (pan2_len != pan_len))) {
+        PrintAndLogEx(WARNING, "ERROR: Invalid PAN lengths");
+        return false;
+    }
+
+    for (unsigned i = 0; i < pan2_len; i++)
+        if (emv_cn_get(pan_tlv, i) != emv_cn_get(pan2_tlv, i)) {
+            PrintAndLogEx(WARNING, "ERROR: PAN data mismatch");
+            PrintAndLogEx(WARNING, "tlv  pan " _YELLOW_("%s"), sprint_hex(pan_tlv->value, pan_tlv->len));
+            PrintAndLogEx(WARNING, "cert pan " _YELLOW_("%s"), sprint_hex(pan2_tlv->value, pan2_tlv->len));
+            return false;
+        }
+
+    return true;
+}
+
 static struct emv_pk *emv_pki_decode_key_ex(const struct emv_pk *enc_pk,
                                             unsigned char msgtype,
                                             const struct tlv *pan_tlv,
@@ -214,28 +235,11 @@ static struct emv_pk *emv_pki_decode_key_ex(const struct emv_pk *enc_pk,
         .len = pan_length,
         .value = &data[2],
     };
-    unsigned pan_len = emv_cn_length(pan_tlv);
-    unsigned pan2_len = emv_cn_length(&pan2_tlv);
-
-    if (((msgtype == 2) && (pan2_len < 4 || pan2_len > pan_len)) ||
-            ((msgtype == 4) && (pan2_len != pan_len))) {
-        PrintAndLogEx(WARNING, "ERROR: Invalid PAN lengths");
+    if (!emv_pki_check_pan(msgtype, pan_tlv, &pan2_tlv)) {
         free(data);
-
         return NULL;
     }
 
-    unsigned i;
-    for (i = 0; i < pan2_len; i++)
-        if (emv_cn_get(pan_tlv, i) != emv_cn_get(&pan2_tlv, i)) {
-            PrintAndLogEx(WARNING, "ERROR: PAN data mismatch");
-            PrintAndLogEx(WARNING, "tlv  pan " _YELLOW_("%s"), sprint_hex(pan_tlv->value, pan_tlv->len));
-            PrintAndLogEx(WARNING, "cert pan " _YELLOW_("%s"), sprint_hex(pan2_tlv.value, pan2_tlv.len));
-            free(data);
-
-            return NULL;
-        }
-
     pk_len = data[9 + pan_length];
     if (pk_len > data_len - 11 - pan_length + rem_tlv->len) {
         PrintAndLogEx(WARNING, "ERROR: Invalid pk length");
@@ -283,14 +287,121 @@ static struct emv_pk *emv_pki_decode_key(const struct emv_pk *enc_pk,
     return emv_pki_decode_key_ex(enc_pk, msgtype, pan_tlv, cert_tlv, exp_tlv, rem_tlv, add_tlv, sdatl_tlv, false);
 }
 
+// Issuer keys recovered from the same certificate are kept.  All cards of an issuer
+// PAN range carry the same issuer certificate,  only the PAN check is done again.
+// Filled in strict mode only,  so a cached key always had a valid hash.
+#define EMV_PKI_ISSUER_CACHE_SIZE 4
+
+typedef struct {
+    struct emv_pk *ca_pk;
+    struct tlv *cert;
+    struct tlv *exp;
+    struct tlv *rem;
+    struct emv_pk *pk;
+} emv_pki_issuer_cache_t;
+
+static emv_pki_issuer_cache_t issuer_cache[EMV_PKI_ISSUER_CACHE_SIZE];
+static size_t issuer_cache_next;
+
+static bool emv_pki_tlv_equal(const struct tlv *a, const struct tlv *b) {
+    if (!a || !b)
+        return a == b;
+
+    return a->len == b->len && !memcmp(a->value, b->value, a->len);
+}
+
+static struct tlv *emv_pki_tlv_dup(const struct tlv *tlv) {
+    if (!tlv)
+        return NULL;
+
+    struct tlv *res = calloc(1, sizeof(struct tlv) + tlv->len);
+    if (!res)
+        return NULL;
+
+    res->tag = tlv->tag;
+    res->len = tlv->len;
+    res->value = (unsigned char *)(res + 1);
+    memcpy((unsigned char *)(res + 1), tlv->value, tlv->len);
+    return res;
+}
+
+static void emv_pki_issuer_cache_clear(emv_pki_issuer_cache_t *e) {
+    emv_pk_free(e->ca_pk);
+    free(e->cert);
+    free(e->exp);
+    free(e->rem);
+    emv_pk_free(e->pk);
+    memset(e, 0, sizeof(*e));
+}
+
+static emv_pki_issuer_cache_t *emv_pki_issuer_cache_find(const struct emv_pk *ca_pk, const struct tlv *cert_tlv, const struct tlv *exp_tlv, const struct tlv *rem_tlv) {
+    for (size_t i = 0; i < EMV_PKI_ISSUER_CACHE_SIZE; i++) {
+        emv_pki_issuer_cache_t *e = &issuer_cache[i];
+        if (!e->pk)
+            continue;
+
+        if (memcmp(e->ca_pk->rid, ca_pk->rid, 5) || e->ca_pk->index != ca_pk->index ||
+                e->ca_pk->mlen != ca_pk->mlen || memcmp(e->ca_pk->modulus, ca_pk->modulus, ca_pk->mlen) ||
+                e->ca_pk->elen != ca_pk->elen || memcmp(e->ca_pk->exp, ca_pk->exp, ca_pk->elen))
+            continue;
+
+        if (emv_pki_tlv_equal(e->cert, cert_tlv) && emv_pki_tlv_equal(e->exp, exp_tlv) && emv_pki_tlv_equal(e->rem, rem_tlv))
+            return e;
+    }
+    return NULL;
+}
+
+static void emv_pki_issuer_cache_add(const struct emv_pk *ca_pk, const struct tlv *cert_tlv, const struct tlv *exp_tlv, const struct tlv *rem_tlv, const struct emv_pk *pk) {
+    emv_pki_issuer_cache_t *e = &issuer_cache[issuer_cache_next];
+    issuer_cache_next = (issuer_cache_next + 1) % EMV_PKI_ISSUER_CACHE_SIZE;
+
+    emv_pki_issuer_cache_clear(e);
+    e->ca_pk = emv_pk_copy(ca_pk);
+    e->cert = emv_pki_tlv_dup(cert_tlv);
+    e->exp = emv_pki_tlv_dup(exp_tlv);
+    e->rem = emv_pki_tlv_dup(rem_tlv);
+    e->pk = emv_pk_copy(pk);
+
+    if (!e->ca_pk || !e->cert || !e->exp || (rem_tlv && !e->rem) || !e->pk)
+        emv_pki_issuer_cache_clear(e);
+}
+
 struct emv_pk *emv_pki_recover_issuer_cert(const struct emv_pk *pk, struct tlvdb *db) {
-    return emv_pki_decode_key(pk, 2,
-                              tlvdb_get(db, 0x5a, NULL),
-                              tlvdb_get(db, 0x90, NULL),
-                              tlvdb_get(db, 0x9f32, NULL),
-                              tlvdb_get(db, 0x92, NULL),
-                              NULL,
-                              NULL);
+    const struct tlv *pan_tlv = tlvdb_get(db, 0x5a, NULL);
+    const struct tlv *cert_tlv = tlvdb_get(db, 0x90, NULL);
+    const struct tlv *exp_tlv = tlvdb_get(db, 0x9f32, NULL);
+    const struct tlv *rem_tlv = tlvdb_get(db, 0x92, NULL);
+
+    if (!pk || !cert_tlv || !exp_tlv || !pan_tlv)
+        return NULL;
+
+    if (strictExecution) {
+        emv_pki_issuer_cache_t *e = emv_pki_issuer_cache_find(pk, cert_tlv, exp_tlv, rem_tlv);
+        if (e) {
+            struct tlv pan2_tlv = {
+                .tag = 0x5a,
+                .len = 4,
+                .value = e->pk->pan,
+            };
+            if (!emv_pki_check_pan(2, pan_tlv, &pan2_tlv))
+                return NULL;
+
+            return emv_pk_copy(e->pk);
+        }
+    }
+
+    struct emv_pk *issuer_pk = emv_pki_decode_key(pk, 2,
+                                                  pan_tlv,
+                                                  cert_tlv,
+                                                  exp_tlv,
+                                                  rem_tlv,
+                                                  NULL,
+                                                  NULL);
+
+    if (issuer_pk && strictExecution)
+        emv_pki_issuer_cache_add(pk, cert_tlv, exp_tlv, rem_tlv, issuer_pk);
+
+    return issuer_pk;
 }
 
 struct emv_pk *emv_pki_recover_icc_cert(const struct emv_pk *pk, struct tlvdb *db, const struct tlv *sda_tlv) {
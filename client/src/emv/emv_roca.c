@@ -21,124 +21,167 @@
 
 #include "emv_roca.h"
 
+#include <pthread.h>
+#include <stdlib.h>
+
 #include "ui.h"  // Print...
 #include "bignum.h"
+#include "pm3_cmd.h"  // PM3_*
+
+// fingerprint of residue r mod primes[i] is bit r of prints[i]
+static const uint8_t primes[ROCA_PRINTS_LENGTH] = {
+    11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
+};
+
+static const char *prints_dec[ROCA_PRINTS_LENGTH] = {
+    "1026",
+    "5658",
+    "107286",
+    "199410",
+    "67109890",
+    "5310023542746834",
+    "1455791217086302986",
+    "20052041432995567486",
+    "6041388139249378920330",
+    "207530445072488465666",
+    "79228162521181866724264247298",
+    "1760368345969468176824550810518",
+    "50079290986288516948354744811034",
+    "473022961816146413042658758988474",
+    "144390480366845522447407333004847678774",
+    "1800793591454480341970779146165214289059119882",
+    "126304807362733370595828809000324029340048915994",
+};
+
+// the largest prime is 157,  three words hold every print
+static uint64_t prints[ROCA_PRINTS_LENGTH][3];
+static bool prints_loaded = false;
+
+static bool rocacheck_init(void) {
+    if (prints_loaded)
+        return true;
+
+    bool ok = true;
+    for (int i = 0; i < ROCA_PRINTS_LENGTH && ok; i++) {
+        mbedtls_mpi t_print;
+        mbedtls_mpi_init(&t_print);
+
+        ok = (mbedtls_mpi_read_string(&t_print, 10, prints_dec[i]) == 0);
+        for (size_t j = 0; ok && j < mbedtls_mpi_bitlen(&t_print); j++) {
+            if (mbedtls_mpi_get_bit(&t_print, j))
+                prints[i][j / 64] |= (uint64_t)1 << (j % 64);
+        }
+        mbedtls_mpi_free(&t_print);
+    }
 
-static void rocacheck_init(mbedtls_mpi *prints) {
-
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
-        mbedtls_mpi_init(&prints[i]);
-
-    mbedtls_mpi_read_string(&prints[0], 10, "1026");
-    mbedtls_mpi_read_string(&prints[1], 10, "5658");
-    mbedtls_mpi_read_string(&prints[2], 10, "107286");
-    mbedtls_mpi_read_string(&prints[3], 10, "199410");
-    mbedtls_mpi_read_string(&prints[4], 10, "67109890");
-    mbedtls_mpi_read_string(&prints[5], 10, "5310023542746834");
-    mbedtls_mpi_read_string(&prints[6], 10, "1455791217086302986");
-    mbedtls_mpi_read_string(&prints[7], 10, "20052041432995567486");
-    mbedtls_mpi_read_string(&prints[8], 10, "6041388139249378920330");
-    mbedtls_mpi_read_string(&prints[9], 10, "207530445072488465666");
-    mbedtls_mpi_read_string(&prints[10], 10, "79228162521181866724264247298");
-    mbedtls_mpi_read_string(&prints[11], 10, "1760368345969468176824550810518");
-    mbedtls_mpi_read_string(&prints[12], 10, "50079290986288516948354744811034");
-    mbedtls_mpi_read_string(&prints[13], 10, "473022961816146413042658758988474");
-    mbedtls_mpi_read_string(&prints[14], 10, "144390480366845522447407333004847678774");
-    mbedtls_mpi_read_string(&prints[15], 10, "1800793591454480341970779146165214289059119882");
-    mbedtls_mpi_read_string(&prints[16], 10, "126304807362733370595828809000324029340048915994");
-}
-
-static void rocacheck_cleanup(mbedtls_mpi *prints) {
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
-        mbedtls_mpi_free(&prints[i]);
+    prints_loaded = ok;
+    return ok;
 }
 
-static int bitand_is_zero(mbedtls_mpi *a, mbedtls_mpi *b) {
+// modulus mod p,  big endian,  32 bits at a time
+static uint32_t rocacheck_residue(const unsigned char *buf, size_t buflen, uint32_t p) {
+    uint64_t r = 0;
+    size_t i = 0;
 
-    for (int i = 0; i < mbedtls_mpi_bitlen(a); i++) {
+    size_t head = buflen % 4;
+    for (; i < head; i++)
+        r = ((r << 8) | buf[i]) % p;
 
-        if (mbedtls_mpi_get_bit(a, i) && mbedtls_mpi_get_bit(b, i))
-            return 0;
+    for (; i < buflen; i += 4) {
+        uint32_t w = ((uint32_t)buf[i] << 24) | ((uint32_t)buf[i + 1] << 16) | ((uint32_t)buf[i + 2] << 8) | buf[i + 3];
+        r = ((r << 32) | w) % p;
     }
-    return 1;
+    return r;
 }
 
-
-static mbedtls_mpi_uint mpi_get_uint(const mbedtls_mpi *X) {
-
-    if (X->n == 1 && X->s > 0) {
-        return X->p[0];
+static bool rocacheck_modulus(const unsigned char *buf, size_t buflen) {
+    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+        uint32_t r = rocacheck_residue(buf, buflen, primes[i]);
+        if ((prints[i][r / 64] & ((uint64_t)1 << (r % 64))) == 0)
+            return false;
     }
-
-    PrintAndLogEx(WARNING, "ZERRRRO!!!\n");
-    return 0;
+    return true;
 }
 
-/*
-static void print_mpi(const char *msg, int radix, const mbedtls_mpi *X) {
-
-    char Xchar[400] = {0};
-    size_t len = 0;
-
-    mbedtls_mpi_write_string(X, radix, Xchar, sizeof(Xchar), &len);
-    PrintAndLogEx(INFO, "%s[%zu] %s\n", msg, len, Xchar);
-}
-*/
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
 
-    mbedtls_mpi t_modulus;
-    mbedtls_mpi_init(&t_modulus);
-
-    bool ret = false;
-    mbedtls_mpi prints[ROCA_PRINTS_LENGTH];
-    uint8_t primes[ROCA_PRINTS_LENGTH] = {
-        11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
-    };
-
-    rocacheck_init(prints);
-
-    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t_modulus, buf, buflen));
-
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+    if (rocacheck_init() == false)
+        return false;
 
-        mbedtls_mpi t_temp;
-        mbedtls_mpi t_prime;
-        mbedtls_mpi g_one;
+    bool ret = rocacheck_modulus(buf, buflen);
 
-        mbedtls_mpi_init(&t_temp);
-        mbedtls_mpi_init(&t_prime);
-        mbedtls_mpi_init(&g_one);
-
-        MBEDTLS_MPI_CHK(mbedtls_mpi_read_string(&g_one, 10, "1"));
+    if (verbose) {
+        if (ret)
+            PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+        else
+            PrintAndLogEx(FAILED, "No fingerprint found.\n");
+    }
+    return ret;
+}
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(&t_prime, &t_prime, primes[i]));
+typedef struct {
+    roca_bulk_item_t *items;
+    size_t count;
+    size_t next;
+} roca_bulk_job_t;
+
+static void *rocacheck_worker(void *arg) {
+    roca_bulk_job_t *job = (roca_bulk_job_t *)arg;
+
+    // keys are cheap to check,  take them in chunks
+    for (;;) {
+        size_t n = __atomic_fetch_add(&job->next, ROCA_BULK_CHUNK, __ATOMIC_SEQ_CST);
+        if (n >= job->count)
+            break;
+
+        size_t end = MIN(n + ROCA_BULK_CHUNK, job->count);
+        for (; n < end; n++) {
+            roca_bulk_item_t *item = &job->items[n];
+            item->weak = rocacheck_modulus(item->modulus, item->len);
+        }
+    }
+    return NULL;
+}
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_temp, &t_modulus, &t_prime));
+int emv_rocacheck_bulk(roca_bulk_item_t *items, size_t count, int threads) {
+    if (items == NULL && count)
+        return PM3_EINVARG;
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_shift_l(&g_one, mpi_get_uint(&t_temp)));
+    if (rocacheck_init() == false)
+        return PM3_ESOFT;
 
-        mbedtls_mpi_free(&t_temp);
-        mbedtls_mpi_free(&t_prime);
+    roca_bulk_job_t job = {
+        .items = items,
+        .count = count,
+        .next = 0
+    };
 
-        if (bitand_is_zero(&g_one, &prints[i])) {
-            if (verbose) {
-                PrintAndLogEx(FAILED, "No fingerprint found.\n");
-            }
-            mbedtls_mpi_free(&g_one);
-            goto cleanup;
-        }
-        mbedtls_mpi_free(&g_one);
+    size_t chunks = (count + ROCA_BULK_CHUNK - 1) / ROCA_BULK_CHUNK;
+    if (threads < 1)
+        threads = 1;
+    if ((size_t)threads > chunks)
+        threads = chunks;
+
+    pthread_t *pool = calloc(threads ? threads : 1, sizeof(pthread_t));
+    if (pool == NULL)
+        return PM3_EMALLOC;
+
+    // no point in a thread for a single chunk
+    int started = 0;
+    for (; threads > 1 && started < threads; started++) {
+        if (pthread_create(&pool[started], NULL, rocacheck_worker, &job))
+            break;
     }
 
-    ret = true;
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+    // the calling thread does the work if no worker was started
+    if (started == 0)
+        rocacheck_worker(&job);
 
-cleanup:
-    mbedtls_mpi_free(&t_modulus);
+    for (int i = 0; i < started; i++)
+        pthread_join(pool[i], NULL);
 
-    rocacheck_cleanup(prints);
-    return ret;
+    free(pool);
+    return PM3_SUCCESS;
 }
 
 int roca_self_test(void) {
@@ -26,7 +26,18 @@
 
 #define ROCA_PRINTS_LENGTH 17
 
+// moduli handed to one worker thread at a time in bulk mode
+#define ROCA_BULK_CHUNK 256
+
+typedef struct {
+    const unsigned char *modulus;
+    size_t len;
+    bool weak;              // out
+} roca_bulk_item_t;
+
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose);
+// checks all items,  spread over threads
+int emv_rocacheck_bulk(roca_bulk_item_t *items, size_t count, int threads);
 int roca_self_test(void);
 
 #endif
@@ -163,12 +163,12 @@ static void emv_print_cb(void *data, const struct tlv *tlv, int level, bool is_l
 }
 
 bool TLVPrintFromBuffer(uint8_t *data, int datalen) {
-    struct tlvdb *t = tlvdb_parse_multi(data, datalen);
+    struct tlvdb_arena *t = tlvdb_arena_parse(data, datalen, true);
     if (t) {
         PrintAndLogEx(INFO, "-------------------- " _CYAN_("TLV decoded") " --------------------");
 
-        tlvdb_visit(t, emv_print_cb, NULL, 0);
-        tlvdb_free(t);
+        tlvdb_visit(tlvdb_arena_root(t), emv_print_cb, NULL, 0);
+        tlvdb_arena_free(t);
         return true;
     } else {
         PrintAndLogEx(WARNING, "TLV ERROR: Can't parse response as TLV tree.");
@@ -586,6 +586,124 @@ int EMVReadRecord(Iso7816CommandChannel channel, bool LeaveFieldON, uint8_t SFI,
     return res;
 }
 
+// records of one batch,  and how many answers fit in the device batch area
+#define EMV_RECORDS_BATCH   (ISO14A_APDU_BATCH_BUF / (sizeof(iso14a_apdu_batch_entry_t) + APDU_RES_LEN))
+
+// the answer of one batched READ RECORD,  handled the way EMVReadRecord() handles it
+static void EMVReadRecordsDecode(Iso7816CommandChannel channel, emv_record_t *r, const iso14a_apdu_batch_entry_t *e, struct tlvdb *tlv) {
+    r->len = 0;
+    r->sw = 0;
+
+    if (e->status != PM3_SUCCESS) {
+        r->res = e->status;
+        return;
+    }
+
+    if (GetAPDULogging()) {
+        PrintAndLogEx(SUCCESS, "<<<< %s", sprint_hex(e->data, e->len));
+    }
+
+    if (e->len < 2 || e->len > APDU_RES_LEN) {
+        r->res = 200;
+        return;
+    }
+
+    r->len = e->len - 2;
+    memcpy(r->data, e->data, r->len);
+    r->sw = (e->data[r->len] << 8) | e->data[r->len + 1];
+    r->res = PM3_SUCCESS;
+
+    if (r->sw != ISO7816_OK && GetAPDULogging()) {
+        if (r->sw >> 8 == 0x61) {
+            PrintAndLogEx(ERR, "APDU chaining len " _RED_("%02x"), r->sw & 0xFF);
+        } else {
+            PrintAndLogEx(ERR, "APDU (%02x%02x) ERROR... " _RED_("%4X") " - %s", 0x00, 0xb2, r->sw, GetAPDUCodeDescription(r->sw >> 8, r->sw & 0xFF));
+            r->res = 5;
+        }
+    }
+
+    if (r->res == PM3_SUCCESS && tlv) {
+        struct tlvdb *t = tlvdb_parse_multi(r->data, r->len);
+        tlvdb_add(tlv, t);
+    }
+
+    if (r->sw == 0x6700 || r->sw == 0x6f00) {
+        PrintAndLogEx(INFO, ">>> trying to reissue command without Le...");
+        r->res = EMVExchangeEx(channel, false, true, (sAPDU_t) {0x00, 0xb2, r->rec, (r->sfi << 3) | 0x04, 0, NULL}, false, r->data, sizeof(r->data), &r->len, &r->sw, tlv);
+    }
+}
+
+// READ RECORD of a list of records.  On ISO14443-A they go to the card in CMD_HF_ISO14443A_APDU_BATCH
+// exchanges instead of one host round trip each,  other channels and whatever a failed batch left
+// are read one by one.  Results and tlv end up as with EMVReadRecord() in a loop.
+int EMVReadRecords(Iso7816CommandChannel channel, bool LeaveFieldON, emv_record_t *records, size_t count, struct tlvdb *tlv) {
+    size_t pos = 0;
+
+    if (channel == CC_CONTACTLESS && GetISODEPState() == ISODEP_NFCA) {
+        uint8_t *out = calloc(ISO14A_APDU_BATCH_BUF, sizeof(uint8_t));
+
+        while (out && pos < count) {
+            uint8_t apdus[PM3_CMD_DATA_SIZE - sizeof(iso14a_apdu_batch_req_t)];
+            int apdus_len = 0;
+            size_t n = 0;
+            while (pos + n < count && n < EMV_RECORDS_BATCH) {
+                emv_record_t *r = &records[pos + n];
+                sAPDU_t apdu = {0x00, 0xb2, r->rec, (r->sfi << 3) | 0x04, 0, NULL};
+                uint8_t data[APDU_RES_LEN] = {0};
+                int datalen = 0;
+                if (APDUEncodeS(&apdu, false, 0x100, data, &datalen) || apdus_len + 2 + datalen > (int)sizeof(apdus)) {
+                    break;
+                }
+
+                if (GetAPDULogging()) {
+                    PrintAndLogEx(SUCCESS, ">>>> %s", sprint_hex(data, datalen));
+                }
+
+                uint16_t len16 = datalen;
+                memcpy(apdus + apdus_len, &len16, sizeof(len16));
+                memcpy(apdus + apdus_len + 2, data, datalen);
+                apdus_len += 2 + datalen;
+                n++;
+            }
+            if (n == 0) {
+                break;
+            }
+
+            int outlen = 0;
+            uint8_t done = 0;
+            int res = ExchangeAPDU14aBatch(apdus, apdus_len, n, false, true, false, out, ISO14A_APDU_BATCH_BUF, &outlen, &done);
+
+            int opos = 0;
+            for (uint8_t i = 0; i < done; i++) {
+                const iso14a_apdu_batch_entry_t *e = (const iso14a_apdu_batch_entry_t *)(out + opos);
+                if (opos + (int)sizeof(iso14a_apdu_batch_entry_t) > outlen || opos + (int)sizeof(iso14a_apdu_batch_entry_t) + e->len > outlen) {
+                    done = i;
+                    break;
+                }
+                opos += sizeof(iso14a_apdu_batch_entry_t) + e->len;
+                EMVReadRecordsDecode(channel, &records[pos + i], e, tlv);
+            }
+            pos += done;
+
+            if (res != PM3_SUCCESS) {
+                PrintAndLogEx(DEBUG, "READ RECORD batch stopped after %u of %zu records ( %d )", done, n, res);
+                break;
+            }
+        }
+        free(out);
+    }
+
+    for (; pos < count; pos++) {
+        emv_record_t *r = &records[pos];
+        r->res = EMVReadRecord(channel, true, r->sfi, r->rec, r->data, sizeof(r->data), &r->len, &r->sw, tlv);
+    }
+
+    if (LeaveFieldON == false) {
+        DropFieldEx(channel);
+    }
+    return PM3_SUCCESS;
+}
+
 int EMVGetData(Iso7816CommandChannel channel, bool LeaveFieldON, uint16_t foo, uint8_t *Result, size_t MaxResultLen, size_t *ResultLen, uint16_t *sw, struct tlvdb *tlv) {
     return EMVExchangeEx(channel, false, LeaveFieldON, (sAPDU_t) {0x80, 0xCA, ((foo >> 8) & 0xFF), (foo & 0xFF), 0, NULL}, true, Result, MaxResultLen, ResultLen, sw, tlv);
 }
@@ -72,6 +72,17 @@ int EMVSelectApplication(struct tlvdb *tlv, uint8_t *AID, size_t *AIDlen);
 int EMVGPO(Iso7816CommandChannel channel, bool LeaveFieldON, uint8_t *PDOL, size_t PDOLLen, uint8_t *Result, size_t MaxResultLen, size_t *ResultLen, uint16_t *sw, struct tlvdb *tlv);
 int EMVReadRecord(Iso7816CommandChannel channel, bool LeaveFieldON, uint8_t SFI, uint8_t SFIrec, uint8_t *Result, size_t MaxResultLen, size_t *ResultLen, uint16_t *sw, struct tlvdb *tlv);
 
+// one record of EMVReadRecords()
+typedef struct {
+    uint8_t sfi;
+    uint8_t rec;
+    int res;
+    uint16_t sw;
+    size_t len;
+    uint8_t data[APDU_RES_LEN];
+} emv_record_t;
+int EMVReadRecords(Iso7816CommandChannel channel, bool LeaveFieldON, emv_record_t *records, size_t count, struct tlvdb *tlv);
+
 // Emv override get data
 int EMVGetData(Iso7816CommandChannel channel, bool LeaveFieldON, uint16_t foo, uint8_t *Result, size_t MaxResultLen, size_t *ResultLen, uint16_t *sw, struct tlvdb *tlv);
 // AC
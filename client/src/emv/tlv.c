@@ -548,6 +548,216 @@ const struct tlv *tlvdb_get_tlv(const struct tlvdb *tlvdb) {
         return NULL;
 }
 
+#define TLVDB_ARENA_ALIGN(x)    (((x) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+#define TLVDB_ARENA_NONE        ((uint32_t)~0)
+
+struct tlvdb_arena {
+    struct tlvdb *nodes;        // document order
+    size_t count;
+    uint32_t *next_same;        // next node with the same tag
+    uint32_t *buckets;          // first node of a tag,  open addressing
+    size_t buckets_mask;
+    bool allocated;
+};
+
+static size_t tlvdb_arena_buckets(size_t count) {
+    size_t n = 8;
+    while (n < count * 2)
+        n <<= 1;
+    return n;
+}
+
+static size_t tlvdb_arena_bucket(tlv_tag_t tag, size_t mask) {
+    return (tag * 2654435761u) & mask;
+}
+
+// same rules as tlvdb_parse_one / tlvdb_parse_children.  Without arena->nodes only counts
+static bool tlvdb_arena_fill(struct tlvdb_arena *arena, struct tlvdb *parent, const unsigned char *buf, size_t left, struct tlvdb **first) {
+    struct tlvdb *prev = NULL;
+
+    while (left != 0) {
+        struct tlv tlv;
+        if (!tlv_parse_tl(&buf, &left, &tlv) || tlv.len > left)
+            return false;
+        tlv.value = buf;
+
+        buf += tlv.len;
+        left -= tlv.len;
+
+        struct tlvdb *node = NULL;
+        if (arena->nodes) {
+            node = &arena->nodes[arena->count];
+            node->tag = tlv;
+            node->parent = parent;
+            node->next = node->children = NULL;
+
+            if (prev)
+                prev->next = node;
+            else
+                *first = node;
+            prev = node;
+        }
+        arena->count++;
+
+        if (tlv_is_constructed(&tlv) && (tlv.len != 0)) {
+            struct tlvdb *children = NULL;
+            if (!tlvdb_arena_fill(arena, node, tlv.value, tlv.len, &children))
+                return false;
+
+            if (node)
+                node->children = children;
+        }
+    }
+
+    return true;
+}
+
+static bool tlvdb_arena_layout(const unsigned char *buf, size_t len, bool zero_copy, size_t *count, size_t *size) {
+    struct tlvdb_arena arena = {0};
+    struct tlvdb *first = NULL;
+
+    if (!len || !buf || !tlvdb_arena_fill(&arena, NULL, buf, len, &first))
+        return false;
+
+    *count = arena.count;
+    *size = TLVDB_ARENA_ALIGN(sizeof(struct tlvdb_arena)) +
+            TLVDB_ARENA_ALIGN(arena.count * sizeof(struct tlvdb)) +
+            TLVDB_ARENA_ALIGN(arena.count * sizeof(uint32_t)) +
+            TLVDB_ARENA_ALIGN(tlvdb_arena_buckets(arena.count) * sizeof(uint32_t)) +
+            (zero_copy ? 0 : len);
+    return true;
+}
+
+// bytes needed by tlvdb_arena_parse_into,  0 if buf isn't a valid TLV list
+size_t tlvdb_arena_size(const unsigned char *buf, size_t len, bool zero_copy) {
+    size_t count, size;
+    if (!tlvdb_arena_layout(buf, len, zero_copy, &count, &size))
+        return 0;
+    return size;
+}
+
+struct tlvdb_arena *tlvdb_arena_parse_into(void *mem, size_t memlen, const unsigned char *buf, size_t len, bool zero_copy) {
+    size_t count, size;
+    if (!mem || !tlvdb_arena_layout(buf, len, zero_copy, &count, &size) || size > memlen)
+        return NULL;
+
+    unsigned char *p = mem;
+    struct tlvdb_arena *arena = (struct tlvdb_arena *)p;
+    p += TLVDB_ARENA_ALIGN(sizeof(struct tlvdb_arena));
+
+    memset(arena, 0, sizeof(*arena));
+    arena->nodes = (struct tlvdb *)p;
+    p += TLVDB_ARENA_ALIGN(count * sizeof(struct tlvdb));
+
+    arena->next_same = (uint32_t *)p;
+    p += TLVDB_ARENA_ALIGN(count * sizeof(uint32_t));
+
+    size_t nbuckets = tlvdb_arena_buckets(count);
+    arena->buckets = (uint32_t *)p;
+    arena->buckets_mask = nbuckets - 1;
+    p += TLVDB_ARENA_ALIGN(nbuckets * sizeof(uint32_t));
+
+    if (!zero_copy) {
+        memcpy(p, buf, len);
+        buf = p;
+    }
+
+    struct tlvdb *first = NULL;
+    if (!tlvdb_arena_fill(arena, NULL, buf, len, &first))
+        return NULL;
+
+    // tag index,  chains keep document order
+    memset(arena->buckets, 0xff, nbuckets * sizeof(uint32_t));
+    for (size_t i = count; i-- > 0;) {
+        tlv_tag_t tag = arena->nodes[i].tag.tag;
+        size_t b = tlvdb_arena_bucket(tag, arena->buckets_mask);
+        while (arena->buckets[b] != TLVDB_ARENA_NONE && arena->nodes[arena->buckets[b]].tag.tag != tag)
+            b = (b + 1) & arena->buckets_mask;
+
+        arena->next_same[i] = arena->buckets[b];
+        arena->buckets[b] = i;
+    }
+
+    return arena;
+}
+
+struct tlvdb_arena *tlvdb_arena_parse(const unsigned char *buf, size_t len, bool zero_copy) {
+    size_t size = tlvdb_arena_size(buf, len, zero_copy);
+    if (size == 0)
+        return NULL;
+
+    void *mem = malloc(size);
+    if (mem == NULL)
+        return NULL;
+
+    struct tlvdb_arena *arena = tlvdb_arena_parse_into(mem, size, buf, len, zero_copy);
+    if (arena == NULL) {
+        free(mem);
+        return NULL;
+    }
+
+    arena->allocated = true;
+    return arena;
+}
+
+void tlvdb_arena_free(struct tlvdb_arena *arena) {
+    if (arena && arena->allocated)
+        free(arena);
+}
+
+struct tlvdb *tlvdb_arena_root(struct tlvdb_arena *arena) {
+    if (arena == NULL || arena->count == 0)
+        return NULL;
+    return &arena->nodes[0];
+}
+
+size_t tlvdb_arena_count(const struct tlvdb_arena *arena) {
+    return arena ? arena->count : 0;
+}
+
+// first node with the tag in document order,  same as tlvdb_find_full on the root
+struct tlvdb *tlvdb_arena_find(struct tlvdb_arena *arena, tlv_tag_t tag) {
+    if (arena == NULL || arena->count == 0)
+        return NULL;
+
+    size_t b = tlvdb_arena_bucket(tag, arena->buckets_mask);
+    while (arena->buckets[b] != TLVDB_ARENA_NONE) {
+        struct tlvdb *node = &arena->nodes[arena->buckets[b]];
+        if (node->tag.tag == tag)
+            return node;
+        b = (b + 1) & arena->buckets_mask;
+    }
+    return NULL;
+}
+
+// same results as tlvdb_get on the root
+const struct tlv *tlvdb_arena_get(struct tlvdb_arena *arena, tlv_tag_t tag, const struct tlv *prev) {
+    if (prev == NULL) {
+        struct tlvdb *node = tlvdb_arena_find(arena, tag);
+        return node ? &node->tag : NULL;
+    }
+
+    const struct tlvdb *node = (const struct tlvdb *)prev;
+    if (arena == NULL || node < arena->nodes || node >= arena->nodes + arena->count)
+        return NULL;
+
+    // tlvdb_get looks for the requested tag after prev,  whatever tag prev has
+    size_t i = node - arena->nodes;
+    if (node->tag.tag == tag) {
+        uint32_t next = arena->next_same[i];
+        return (next == TLVDB_ARENA_NONE) ? NULL : &arena->nodes[next].tag;
+    }
+
+    for (struct tlvdb *n = tlvdb_arena_find(arena, tag); n; ) {
+        size_t j = n - arena->nodes;
+        if (j > i)
+            return &n->tag;
+        uint32_t next = arena->next_same[j];
+        n = (next == TLVDB_ARENA_NONE) ? NULL : &arena->nodes[next];
+    }
+    return NULL;
+}
+
 unsigned char *tlv_encode(const struct tlv *tlv, size_t *len) {
     size_t size = tlv->len;
     unsigned char *data;
@@ -76,6 +76,22 @@ const struct tlv *tlvdb_get(const struct tlvdb *tlvdb, tlv_tag_t tag, const stru
 const struct tlv *tlvdb_get_inchild(const struct tlvdb *tlvdb, tlv_tag_t tag, const struct tlv *prev);
 const struct tlv *tlvdb_get_tlv(const struct tlvdb *tlvdb);
 
+// Read only TLV tree,  all nodes and the tag index live in one memory block.
+// Nodes are plain struct tlvdb in document order,  tlvdb_visit / tlvdb_get / tlvdb_find_*
+// work on them,  but they must not be freed with tlvdb_free or linked into other trees.
+// With zero_copy the values point into the source buffer,  it has to outlive the arena.
+struct tlvdb_arena;
+
+size_t tlvdb_arena_size(const unsigned char *buf, size_t len, bool zero_copy);
+struct tlvdb_arena *tlvdb_arena_parse_into(void *mem, size_t memlen, const unsigned char *buf, size_t len, bool zero_copy);
+struct tlvdb_arena *tlvdb_arena_parse(const unsigned char *buf, size_t len, bool zero_copy);
+void tlvdb_arena_free(struct tlvdb_arena *arena);
+
+struct tlvdb *tlvdb_arena_root(struct tlvdb_arena *arena);
+size_t tlvdb_arena_count(const struct tlvdb_arena *arena);
+struct tlvdb *tlvdb_arena_find(struct tlvdb_arena *arena, tlv_tag_t tag);
+const struct tlv *tlvdb_arena_get(struct tlvdb_arena *arena, tlv_tag_t tag, const struct tlv *prev);
+
 bool tlv_parse_tl(const unsigned char **buf, size_t *len, struct tlv *tlv);
 unsigned char *tlv_encode(const struct tlv *tlv, size_t *len);
 bool tlv_is_constructed(const struct tlv *tlv);
@@ -21,6 +21,8 @@
 
 #include <dirent.h>
 #include <ctype.h>
+#include <pthread.h>
+#include <lz4frame.h>
 
 #include "pm3_cmd.h"
 #include "commonutil.h"
@@ -29,10 +31,16 @@
 #include "cmdhficlass.h"  // pagemap
 #include "iclass_cmd.h"
 #include "iso15.h"
+#include "crc32.h"
+#include "dumpstore.h"
 
 #ifdef _WIN32
 #include "scandir.h"
 #include <direct.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #endif
 
 #define PATH_MAX_LENGTH 200
@@ -91,6 +99,8 @@ DumpFileType_t get_filetype(const char *filename) {
             o = FLIPPER;
         } else if (str_endswith(s, "picopass")) {
             o = FLIPPER;
+        } else if (str_endswith(s, "pm3dump")) {
+            o = PM3DUMP;
         } else {
             // mfd, trc, trace is binary
             o = BIN;
@@ -123,7 +133,7 @@ int fileExists(const char *filename) {
  * @param filename
  * @return
  */
-static bool is_directory(const char *filename) {
+bool is_directory(const char *filename) {
 #ifdef _WIN32
     struct _stat st;
     if (_stat(filename, &st) == -1)
@@ -285,6 +295,51 @@ int saveFile(const char *preferredName, const char *suffix, const void *data, si
     return PM3_SUCCESS;
 }
 
+int saveFilePM3DUMP(const char *preferredName, JSONFileType ftype, const uint8_t *data, size_t datalen, bool verbose) {
+    return saveFilePM3DUMPex(preferredName, ftype, data, datalen, verbose, spDump);
+}
+int saveFilePM3DUMPex(const char *preferredName, JSONFileType ftype, const uint8_t *data, size_t datalen, bool verbose, savePaths_t e_save_path) {
+
+    if (data == NULL || datalen == 0 || datalen > UINT32_MAX) {
+        return PM3_EINVARG;
+    }
+
+    pm3dump_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PM3DUMP_MAGIC, sizeof(hdr.magic));
+    hdr.version = PM3DUMP_VERSION;
+    hdr.ftype = ftype;
+    hdr.hdrlen = sizeof(hdr);
+    hdr.datalen = datalen;
+    crc32_ex(data, datalen, hdr.crc);
+    hdr.created = (uint64_t)time(NULL);
+
+    char *fileName = newfilenamemcopyEx(preferredName, ".pm3dump", e_save_path);
+    if (fileName == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    FILE *f = fopen(fileName, "wb");
+    if (!f) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fileName);
+        free(fileName);
+        return PM3_EFILE;
+    }
+
+    int res = PM3_SUCCESS;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 || fwrite(data, 1, datalen, f) != datalen) {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", fileName);
+        res = PM3_EFILE;
+    }
+    fclose(f);
+
+    if (res == PM3_SUCCESS && verbose) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to pm3dump file `" _YELLOW_("%s") "`", datalen, fileName);
+    }
+    free(fileName);
+    return res;
+}
+
 // dump file (normally,  we also got preference file, etc)
 int saveFileJSON(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, void (*callback)(json_t *)) {
     return saveFileJSONex(preferredName, ftype, data, datalen, true, callback, spDump);
@@ -775,10 +830,160 @@ int saveFileJSONrootEx(const char *preferredName, const void *root, size_t flags
     return PM3_EFILE;
 }
 
+static void json_stream_indent(json_stream_t *js) {
+    fprintf(js->f, "\n%*s", js->depth * 2, "");
+}
+
+// separator, indent and key of the next member at the current level
+static int json_stream_member(json_stream_t *js, const char *key) {
+    if (js->f == NULL || js->depth == 0)
+        return PM3_EINVARG;
+
+    bool inarray = js->array[js->depth - 1];
+    if (inarray == false && key == NULL)
+        return PM3_EINVARG;
+
+    if (js->empty[js->depth - 1] == false)
+        fputc(',', js->f);
+
+    js->empty[js->depth - 1] = false;
+    json_stream_indent(js);
+
+    if (inarray == false) {
+        json_t *k = json_string(key);
+        if (k == NULL)
+            return PM3_EMALLOC;
+
+        json_dumpf(k, js->f, JSON_ENCODE_ANY);
+        json_decref(k);
+        fputs(": ", js->f);
+    }
+    return PM3_SUCCESS;
+}
+
+int JsonStreamOpen(json_stream_t *js, const char *preferredName, bool array, bool verbose, bool overwrite) {
+    memset(js, 0, sizeof(json_stream_t));
+
+    if (overwrite)
+        js->filename = filenamemcopy(preferredName, ".json");
+    else
+        js->filename = newfilenamemcopyEx(preferredName, ".json", spDump);
+
+    if (js->filename == NULL)
+        return PM3_EMALLOC;
+
+    js->f = fopen(js->filename, "wb");
+    if (js->f == NULL) {
+        PrintAndLogEx(FAILED, "error, can't save the file `" _YELLOW_("%s") "`", js->filename);
+        free(js->filename);
+        js->filename = NULL;
+        return PM3_EFILE;
+    }
+
+    struct stat st;
+    js->flush = (fstat(fileno(js->f), &st) != 0 || S_ISREG(st.st_mode) == 0);
+    js->verbose = verbose;
+
+    fputc(array ? '[' : '{', js->f);
+    js->depth = 1;
+    js->array[0] = array;
+    js->empty[0] = true;
+    return PM3_SUCCESS;
+}
+
+int JsonStreamBegin(json_stream_t *js, const char *key, bool array) {
+    if (js->depth >= JSON_STREAM_MAX_DEPTH)
+        return PM3_EOVFLOW;
+
+    int res = json_stream_member(js, key);
+    if (res != PM3_SUCCESS)
+        return res;
+
+    fputc(array ? '[' : '{', js->f);
+    js->array[js->depth] = array;
+    js->empty[js->depth] = true;
+    js->depth++;
+    return PM3_SUCCESS;
+}
+
+int JsonStreamAdd(json_stream_t *js, const char *key, json_t *value) {
+    if (value == NULL)
+        return PM3_EMALLOC;
+
+    int res = json_stream_member(js, key);
+    if (res == PM3_SUCCESS) {
+        if (json_dumpf(value, js->f, JSON_COMPACT | JSON_ENCODE_ANY) != 0)
+            res = PM3_EFILE;
+        else if (js->flush)
+            fflush(js->f);
+    }
+    json_decref(value);
+    return res;
+}
+
+int JsonStreamEnd(json_stream_t *js) {
+    if (js->f == NULL || js->depth == 0)
+        return PM3_EINVARG;
+
+    js->depth--;
+    if (js->empty[js->depth] == false)
+        json_stream_indent(js);
+
+    fputc(js->array[js->depth] ? ']' : '}', js->f);
+    if (js->flush)
+        fflush(js->f);
+    return PM3_SUCCESS;
+}
+
+int JsonStreamClose(json_stream_t *js) {
+    if (js->f == NULL)
+        return PM3_EINVARG;
+
+    while (js->depth)
+        JsonStreamEnd(js);
+
+    fputc('\n', js->f);
+
+    int res = ferror(js->f) ? PM3_EFILE : PM3_SUCCESS;
+    if (fclose(js->f) != 0)
+        res = PM3_EFILE;
+
+    if (res == PM3_SUCCESS) {
+        if (js->verbose)
+            PrintAndLogEx(SUCCESS, "Saved to json file " _YELLOW_("%s"), js->filename);
+    } else {
+        PrintAndLogEx(FAILED, "error, can't save the file `" _YELLOW_("%s") "`", js->filename);
+    }
+
+    free(js->filename);
+    js->filename = NULL;
+    js->f = NULL;
+    return res;
+}
+
+#define WAVE_BLOCK  4096
+
+static void wave_header(struct wave_info_t *w, uint32_t rate, size_t samples) {
+    memset(w, 0, sizeof(struct wave_info_t));
+    memcpy(w->signature, "RIFF", 4);
+    w->filesize = sizeof(struct wave_info_t) - sizeof(w->signature) - sizeof(w->filesize) + samples;
+    memcpy(w->type, "WAVE", 4);
+    memcpy(w->format.tag, "fmt ", 4);
+    w->format.size = sizeof(w->format) - sizeof(w->format.tag) - sizeof(w->format.size);
+    w->format.codec = 1; // PCM
+    w->format.nb_channel = 1;
+    w->format.sample_per_sec = rate;
+    w->format.byte_per_sec = rate;
+    w->format.block_align = 1;
+    w->format.bit_per_sample = 8;
+    memcpy(w->audio_data.tag, "data", 4);
+    w->audio_data.size = samples;
+}
+
 // wave file of trace,
-int saveFileWAVE(const char *preferredName, const int *data, size_t datalen) {
+int saveFileWAVE(const char *preferredName, const int16_t *data, size_t datalen) {
 
-    if (data == NULL || datalen == 0) {
+    if (data == NULL || datalen == 0 || datalen > UINT32_MAX - sizeof(struct wave_info_t)) {
         return PM3_EINVARG;
     }
 
@@ -789,21 +994,8 @@ int saveFileWAVE(const char *preferredName, const int *data, size_t datalen) {
 
     int retval = PM3_SUCCESS;
 
-    struct wave_info_t wave_info = {
-        .signature = "RIFF",
-        .filesize = sizeof(wave_info) - sizeof(wave_info.signature) - sizeof(wave_info.filesize) + datalen,
-        .type = "WAVE",
-        .format.tag = "fmt ",
-        .format.size = sizeof(wave_info.format) - sizeof(wave_info.format.tag) - sizeof(wave_info.format.size),
-        .format.codec = 1, // PCM
-        .format.nb_channel = 1,
-        .format.sample_per_sec = 125000,  // TODO update for other tag types
-        .format.byte_per_sec = 125000,    // TODO update for other tag types
-        .format.block_align = 1,
-        .format.bit_per_sample = 8,
-        .audio_data.tag = "data",
-        .audio_data.size = datalen,
-    };
+    struct wave_info_t wave_info;
+    wave_header(&wave_info, 125000, datalen);  // TODO update for other tag types
 
     FILE *wave_file = fopen(fileName, "wb");
     if (!wave_file) {
@@ -812,24 +1004,217 @@ int saveFileWAVE(const char *preferredName, const int *data, size_t datalen) {
         goto out;
     }
 
-    fwrite(&wave_info, sizeof(wave_info), 1, wave_file);
+    if (fwrite(&wave_info, sizeof(wave_info), 1, wave_file) != 1) {
+        retval = PM3_EFILE;
+    }
 
-    for (int i = 0; i < datalen; i++) {
-        uint8_t sample = data[i] + 128;
-        fwrite(&sample, 1, 1, wave_file);
+    // a block at a time,  the conversion loop vectorises
+    uint8_t buf[WAVE_BLOCK];
+    for (size_t i = 0; i < datalen && retval == PM3_SUCCESS; i += WAVE_BLOCK) {
+        size_t n = MIN(datalen - i, WAVE_BLOCK);
+        for (size_t j = 0; j < n; j++) {
+            buf[j] = (uint8_t)(data[i + j] + 128);
+        }
+        if (fwrite(buf, 1, n, wave_file) != n) {
+            retval = PM3_EFILE;
+        }
     }
 
     fclose(wave_file);
 
-    PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to wave file `" _YELLOW_("%s") "`", 2 * datalen, fileName);
+    if (retval == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to wave file `" _YELLOW_("%s") "`", datalen, fileName);
+    } else {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", fileName);
+    }
 
 out:
     free(fileName);
     return retval;
 }
 
+int loadFileWAVE(const char *path, int16_t *data, size_t maxdatalen, size_t *datalen) {
+
+    mapped_file_t m;
+    int res = mapFile(path, &m);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "couldn't open '%s'", path);
+        return res;
+    }
+
+    res = PM3_EFILE;
+    if (m.size < 12 || memcmp(m.data, "RIFF", 4) || memcmp(m.data + 8, "WAVE", 4)) {
+        goto out;
+    }
+
+    uint16_t channels = 0, bits = 0;
+    size_t pos = 12;
+    while (pos + 8 <= m.size) {
+        const uint8_t *chunk = m.data + pos;
+        uint32_t len = MemLeToUint4byte(chunk + 4);
+        pos += 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (len < 16 || pos + 16 > m.size || MemLeToUint2byte(m.data + pos) != 1) { // PCM only
+                goto out;
+            }
+            channels = MemLeToUint2byte(m.data + pos + 2);
+            bits = MemLeToUint2byte(m.data + pos + 14);
+
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (channels == 0 || (bits != 8 && bits != 16)) {
+                goto out;
+            }
+
+            len = MIN(len, m.size - pos);
+            size_t frame = channels * (bits / 8);
+            size_t n = MIN(len / frame, maxdatalen);
+            const uint8_t *p = m.data + pos;
+
+            // first channel only,  scaled to the 8 bit range of the graph like saveFileWAVE writes it
+            if (bits == 8) {
+                for (size_t i = 0; i < n; i++) {
+                    data[i] = (int16_t)p[i * frame] - 128;
+                }
+            } else {
+                for (size_t i = 0; i < n; i++) {
+                    data[i] = (int16_t)(p[i * frame] | (p[i * frame + 1] << 8)) >> 8;
+                }
+            }
+            *datalen = n;
+            res = PM3_SUCCESS;
+            goto out;
+        }
+
+        // chunks are word aligned
+        pos += len + (len & 1);
+    }
+
+out:
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` is not a 8 or 16 bit PCM wave file", path);
+    }
+    releaseFileMapped(&m);
+    return res;
+}
+
+int WaveStreamOpen(wave_stream_t *ws, const char *preferredName, uint32_t rate, uint8_t bits_per_sample) {
+
+    memset(ws, 0, sizeof(wave_stream_t));
+    ws->rate = rate;
+    ws->bits_per_sample = (bits_per_sample == 0 || bits_per_sample > 8) ? 8 : bits_per_sample;
+
+    ws->filename = newfilenamemcopyEx(preferredName, ".wav", spTrace);
+    if (ws->filename == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    ws->f = fopen(ws->filename, "wb");
+    if (ws->f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", ws->filename);
+        free(ws->filename);
+        ws->filename = NULL;
+        return PM3_EFILE;
+    }
+
+    // sizes are filled in on close
+    struct wave_info_t wave_info;
+    wave_header(&wave_info, ws->rate, 0);
+    if (fwrite(&wave_info, sizeof(wave_info), 1, ws->f) != 1) {
+        ws->error = true;
+    }
+    return PM3_SUCCESS;
+}
+
+void WaveStreamWrite(wave_stream_t *ws, const uint8_t *data, size_t len) {
+    if (ws->f == NULL || ws->error) {
+        return;
+    }
+
+    if (ws->bits_per_sample == 8) {
+        if (fwrite(data, 1, len, ws->f) != len) {
+            ws->error = true;
+        }
+        ws->samples += len;
+        return;
+    }
+
+    // samples are MSB first and may straddle byte boundaries,  as in lfstream
+    uint8_t buf[WAVE_BLOCK];
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        for (int8_t b = 7; b >= 0; b--) {
+            ws->acc |= ((data[i] >> b) & 1) << (7 - ws->acc_bits);
+            if (++ws->acc_bits == ws->bits_per_sample) {
+                buf[n++] = ws->acc;
+                ws->acc = 0;
+                ws->acc_bits = 0;
+                if (n == sizeof(buf)) {
+                    ws->error |= (fwrite(buf, 1, n, ws->f) != n);
+                    ws->samples += n;
+                    n = 0;
+                }
+            }
+        }
+    }
+    ws->error |= (fwrite(buf, 1, n, ws->f) != n);
+    ws->samples += n;
+}
+
+// raw_data_cb_t adaptor, arg is the wave_stream_t
+void WaveStreamWrite_cb(const uint8_t *data, size_t len, void *arg) {
+    WaveStreamWrite((wave_stream_t *)arg, data, len);
+}
+
+int WaveStreamClose(wave_stream_t *ws) {
+    if (ws->f == NULL) {
+        return PM3_EINVARG;
+    }
+
+    struct wave_info_t wave_info;
+    wave_header(&wave_info, ws->rate, ws->samples);
+    if (fseek(ws->f, 0, SEEK_SET) != 0 || fwrite(&wave_info, sizeof(wave_info), 1, ws->f) != 1) {
+        ws->error = true;
+    }
+    if (fclose(ws->f) != 0) {
+        ws->error = true;
+    }
+
+    int res = PM3_SUCCESS;
+    if (ws->error) {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", ws->filename);
+        res = PM3_EFILE;
+    } else {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%" PRIu64) " samples to wave file `" _YELLOW_("%s") "`", ws->samples, ws->filename);
+    }
+    free(ws->filename);
+    memset(ws, 0, sizeof(wave_stream_t));
+    return res;
+}
+
+// decimal text of a sample,  returns the length
+static size_t pm3_format_sample(char *out, int16_t v) {
+    char tmp[8];
+    size_t n = 0;
+    uint32_t u = (v < 0) ? (uint32_t)(-(int32_t)v) : (uint32_t)v;
+    do {
+        tmp[n++] = '0' + (u % 10);
+        u /= 10;
+    } while (u);
+
+    size_t len = 0;
+    if (v < 0) {
+        out[len++] = '-';
+    }
+    while (n) {
+        out[len++] = tmp[--n];
+    }
+    out[len++] = '\n';
+    return len;
+}
+
 // Signal trace file, PM3
-int saveFilePM3(const char *preferredName, int *data, size_t datalen) {
+int saveFilePM3(const char *preferredName, int16_t *data, size_t datalen) {
 
     if (data == NULL || datalen == 0) {
         return PM3_EINVARG;
@@ -849,19 +1234,113 @@ int saveFilePM3(const char *preferredName, int *data, size_t datalen) {
         goto out;
     }
 
-    for (uint32_t i = 0; i < datalen; i++) {
-        fprintf(f, "%d\n", data[i]);
+    // at most 7 characters per sample,  "-32768\n"
+    char buf[WAVE_BLOCK * 7];
+    for (size_t i = 0; i < datalen && retval == PM3_SUCCESS; i += WAVE_BLOCK) {
+        size_t n = MIN(datalen - i, WAVE_BLOCK);
+        size_t len = 0;
+        for (size_t j = 0; j < n; j++) {
+            len += pm3_format_sample(buf + len, data[i + j]);
+        }
+        if (fwrite(buf, 1, len, f) != len) {
+            retval = PM3_EFILE;
+        }
     }
 
     fflush(f);
     fclose(f);
-    PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to PM3 file `" _YELLOW_("%s") "`", datalen, fileName);
+    if (retval == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to PM3 file `" _YELLOW_("%s") "`", datalen, fileName);
+    } else {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", fileName);
+    }
 
 out:
     free(fileName);
     return retval;
 }
 
+int saveFilePM3B(const char *preferredName, const int16_t *data, size_t datalen) {
+
+    if (data == NULL || datalen == 0 || datalen > UINT32_MAX) {
+        return PM3_EINVARG;
+    }
+
+    char *fileName = newfilenamemcopyEx(preferredName, ".pm3b", spTrace);
+    if (fileName == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    FILE *f = fopen(fileName, "wb");
+    if (!f) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", fileName);
+        free(fileName);
+        return PM3_EFILE;
+    }
+
+    pm3b_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PM3B_MAGIC, sizeof(hdr.magic));
+    hdr.version = PM3B_VERSION;
+    hdr.bits = 16;
+    hdr.samples = datalen;
+
+    int retval = PM3_SUCCESS;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+        retval = PM3_EFILE;
+    }
+
+    uint8_t buf[2 * 4096];
+    for (size_t i = 0; i < datalen && retval == PM3_SUCCESS; i += 4096) {
+        size_t n = MIN(datalen - i, 4096);
+        for (size_t j = 0; j < n; j++) {
+            buf[2 * j] = (uint16_t)data[i + j] & 0xFF;
+            buf[2 * j + 1] = (uint16_t)data[i + j] >> 8;
+        }
+        if (fwrite(buf, 2, n, f) != n) {
+            retval = PM3_EFILE;
+        }
+    }
+    fclose(f);
+
+    if (retval == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " samples to PM3B file `" _YELLOW_("%s") "`", datalen, fileName);
+    } else {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", fileName);
+    }
+    free(fileName);
+    return retval;
+}
+
+int loadFilePM3B(const char *path, int16_t *data, size_t maxdatalen, size_t *datalen) {
+
+    mapped_file_t m;
+    int res = mapFile(path, &m);
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "couldn't open '%s'", path);
+        return res;
+    }
+
+    const pm3b_header_t *hdr = (const pm3b_header_t *)m.data;
+    if (m.size < sizeof(pm3b_header_t) || memcmp(hdr->magic, PM3B_MAGIC, sizeof(hdr->magic)) != 0 ||
+            hdr->version != PM3B_VERSION || hdr->bits != 16 ||
+            (uint64_t)hdr->samples * 2 > m.size - sizeof(pm3b_header_t)) {
+        PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` is not a valid PM3B file", path);
+        releaseFileMapped(&m);
+        return PM3_EFILE;
+    }
+
+    size_t n = MIN(hdr->samples, maxdatalen);
+    const uint8_t *p = m.data + sizeof(pm3b_header_t);
+    for (size_t i = 0; i < n; i++) {
+        data[i] = (int16_t)(p[2 * i] | (p[2 * i + 1] << 8));
+    }
+    *datalen = n;
+
+    releaseFileMapped(&m);
+    return PM3_SUCCESS;
+}
+
 // key file dump
 int createMfcKeyDump(const char *preferredName, uint8_t sectorsCnt, const sector_t *e_sector) {
 
@@ -961,47 +1440,197 @@ int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata,
     return PM3_SUCCESS;
 }
 
-int loadFileEML_safe(const char *preferredName, void **pdata, size_t *datalen) {
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, "", false);
-    if (res != PM3_SUCCESS) {
+int mapFile(const char *path, mapped_file_t *m) {
+
+    memset(m, 0, sizeof(mapped_file_t));
+
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
         return PM3_EFILE;
     }
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", path);
-        free(path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
         return PM3_EFILE;
     }
-    free(path);
 
-    // get filesize in order to malloc memory
+    m->size = (size_t)st.st_size;
+    m->data = mmap(NULL, m->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m->data != MAP_FAILED) {
+        m->mapped = true;
+        return PM3_SUCCESS;
+    }
+    m->data = NULL;
+#endif
+
+    // no mmap,  read it in one go
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return PM3_EFILE;
+    }
     fseek(f, 0, SEEK_END);
     long fsize = ftell(f);
     fseek(f, 0, SEEK_SET);
-
     if (fsize <= 0) {
-        PrintAndLogEx(FAILED, "error, when getting filesize");
         fclose(f);
         return PM3_EFILE;
     }
 
-    *pdata = calloc(fsize, sizeof(uint8_t));
-    if (!*pdata) {
-        PrintAndLogEx(FAILED, "error, cannot allocate memory");
+    m->size = (size_t)fsize;
+    m->data = calloc(m->size, sizeof(uint8_t));
+    if (m->data == NULL) {
         fclose(f);
         return PM3_EMALLOC;
     }
+    if (fread(m->data, 1, m->size, f) != m->size) {
+        fclose(f);
+        releaseFileMapped(m);
+        return PM3_EFILE;
+    }
+    fclose(f);
+    return PM3_SUCCESS;
+}
 
-    // 128 + 2 newline chars + 1 null terminator
-    char line[131];
-    memset(line, 0, sizeof(line));
-    uint8_t buf[64] = {0x00};
-    size_t counter = 0;
-    int retval = PM3_SUCCESS, hexlen = 0;
-
-    uint8_t *tmp = (uint8_t *)*pdata;
+int loadFileMapped_safe(const char *preferredName, const char *suffix, mapped_file_t *m, bool verbose) {
+
+    char *path;
+    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, suffix, false);
+    if (res != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    res = mapFile(path, m);
+    if (res == PM3_EMALLOC) {
+        PrintAndLogEx(FAILED, "error, cannot allocate memory");
+    } else if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "file not found, empty or locked `" _YELLOW_("%s") "`", path);
+    } else if (verbose) {
+        PrintAndLogEx(SUCCESS, "Loaded " _YELLOW_("%zu") " bytes from binary file `" _YELLOW_("%s") "`", m->size, preferredName);
+    }
+    free(path);
+    return res;
+}
+
+void releaseFileMapped(mapped_file_t *m) {
+    if (m->data == NULL) {
+        return;
+    }
+#ifndef _WIN32
+    if (m->mapped) {
+        munmap(m->data, m->size);
+    } else
+#endif
+        free(m->data);
+    memset(m, 0, sizeof(mapped_file_t));
+}
+
+int loadFilePM3DUMP_safe(const char *preferredName, void **pdata, size_t *datalen, JSONFileType *ftype) {
+
+    char *path;
+    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, ".pm3dump", false);
+    if (res != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", path);
+        free(path);
+        return PM3_EFILE;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // a later version may have a longer header,  the fields known here stay where they are
+    pm3dump_header_t hdr;
+    if (fsize < (long)sizeof(hdr)
+            || fread(&hdr, sizeof(hdr), 1, f) != 1
+            || memcmp(hdr.magic, PM3DUMP_MAGIC, sizeof(hdr.magic)) != 0
+            || hdr.hdrlen < sizeof(hdr)
+            || hdr.datalen == 0
+            || (uint64_t)hdr.hdrlen + hdr.datalen != (uint64_t)fsize) {
+        PrintAndLogEx(FAILED, "`" _YELLOW_("%s") "` is not a valid pm3dump file", path);
+        fclose(f);
+        free(path);
+        return PM3_EFILE;
+    }
+
+    uint8_t *data = calloc(hdr.datalen, sizeof(uint8_t));
+    if (data == NULL) {
+        PrintAndLogEx(FAILED, "error, cannot allocate memory");
+        fclose(f);
+        free(path);
+        return PM3_EMALLOC;
+    }
+
+    bool ok = (fseek(f, hdr.hdrlen, SEEK_SET) == 0) && (fread(data, 1, hdr.datalen, f) == hdr.datalen);
+    fclose(f);
+
+    uint8_t crc[4];
+    crc32_ex(data, hdr.datalen, crc);
+    if (ok == false || memcmp(crc, hdr.crc, sizeof(crc)) != 0) {
+        PrintAndLogEx(FAILED, "`" _YELLOW_("%s") "` is damaged, crc mismatch", path);
+        free(data);
+        free(path);
+        return PM3_ECRC;
+    }
+
+    *pdata = data;
+    *datalen = hdr.datalen;
+    if (ftype) {
+        *ftype = hdr.ftype;
+    }
+    PrintAndLogEx(SUCCESS, "Loaded " _YELLOW_("%u") " bytes from pm3dump file `" _YELLOW_("%s") "`", hdr.datalen, path);
+    free(path);
+    return PM3_SUCCESS;
+}
+
+int loadFileEML_safe(const char *preferredName, void **pdata, size_t *datalen) {
+    char *path;
+    int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, "", false);
+    if (res != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", path);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    // get filesize in order to malloc memory
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    if (fsize <= 0) {
+        PrintAndLogEx(FAILED, "error, when getting filesize");
+        fclose(f);
+        return PM3_EFILE;
+    }
+
+    *pdata = calloc(fsize, sizeof(uint8_t));
+    if (!*pdata) {
+        PrintAndLogEx(FAILED, "error, cannot allocate memory");
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    // 128 + 2 newline chars + 1 null terminator
+    char line[131];
+    memset(line, 0, sizeof(line));
+    uint8_t buf[64] = {0x00};
+    size_t counter = 0;
+    int retval = PM3_SUCCESS, hexlen = 0;
+
+    uint8_t *tmp = (uint8_t *)*pdata;
 
     while (!feof(f)) {
 
@@ -2159,6 +2788,199 @@ int loadFileDICTIONARY(const char *preferredName, void *data, size_t *datalen, u
     return loadFileDICTIONARYEx(preferredName, data, 0, datalen, keylen, keycnt, 0, NULL, true);
 }
 
+// A valid key is the first keylen * 2 characters of a line,  a shorter line or a comment is skipped
+static bool dictionary_parse_line(char *line, uint8_t keylen, uint8_t *key) {
+
+    // add null terminator
+    line[keylen << 1] = 0;
+
+    // smaller keys than expected is skipped
+    if (strlen(line) < ((size_t)keylen << 1))
+        return false;
+
+    // The line start with # is comment, skip
+    if (line[0] == '#')
+        return false;
+
+    if (!CheckStringIsHEXValue(line))
+        return false;
+
+    return (hex_to_bytes(line, key, keylen) == keylen);
+}
+
+static int dictionary_load_text(const char *path, uint8_t keylen, uint8_t **pkeys, uint32_t *keycnt) {
+
+    *pkeys = NULL;
+    *keycnt = 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", path);
+        return PM3_EFILE;
+    }
+
+    // grow by doubling,  multi-million key files would realloc for ever in small steps
+    size_t mem_keys = 64;
+    uint8_t *keys = calloc(mem_keys, keylen);
+    if (keys == NULL) {
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    char line[255];
+    uint32_t cnt = 0;
+    while (fgets(line, sizeof(line), f)) {
+
+        if (cnt == mem_keys) {
+            uint8_t *tmp = realloc(keys, mem_keys * 2 * keylen);
+            if (tmp == NULL) {
+                free(keys);
+                fclose(f);
+                return PM3_EMALLOC;
+            }
+            keys = tmp;
+            mem_keys *= 2;
+        }
+
+        if (dictionary_parse_line(line, keylen, keys + ((size_t)cnt * keylen))) {
+            cnt++;
+        }
+    }
+    fclose(f);
+
+    *pkeys = keys;
+    *keycnt = cnt;
+    return PM3_SUCCESS;
+}
+
+// Compiled dictionary (.dicb),  a header followed by keycnt keys of keylen bytes each
+#define DICTIONARY_BINARY_MAGIC     "DICB"
+#define DICTIONARY_BINARY_VERSION   1
+#define DICTIONARY_BINARY_DEDUP     0x01
+#define DICTIONARY_BINARY_SORTED    0x02
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t keylen;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t keycnt;
+    uint32_t reserved2;
+} PACKED dictionary_binary_header_t;
+
+typedef struct {
+    mapped_file_t file;
+    const dictionary_binary_header_t *hdr;
+    const uint8_t *keys;
+} dictionary_binary_t;
+
+static void dictionary_binary_close(dictionary_binary_t *d) {
+    releaseFileMapped(&d->file);
+    memset(d, 0, sizeof(dictionary_binary_t));
+}
+
+static int dictionary_binary_open(const char *path, dictionary_binary_t *d) {
+
+    memset(d, 0, sizeof(dictionary_binary_t));
+
+    int res = mapFile(path, &d->file);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    if (d->file.size < sizeof(dictionary_binary_header_t)) {
+        dictionary_binary_close(d);
+        return PM3_EFILE;
+    }
+
+    d->hdr = (const dictionary_binary_header_t *)d->file.data;
+    d->keys = d->file.data + sizeof(dictionary_binary_header_t);
+
+    if (memcmp(d->hdr->magic, DICTIONARY_BINARY_MAGIC, sizeof(d->hdr->magic)) != 0
+            || d->hdr->version != DICTIONARY_BINARY_VERSION
+            || d->hdr->keylen == 0
+            || d->hdr->keylen > DICTIONARY_MAX_KEY_LEN
+            || (uint64_t)d->hdr->keycnt * d->hdr->keylen != d->file.size - sizeof(dictionary_binary_header_t)) {
+        PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` is not a valid compiled dictionary", path);
+        dictionary_binary_close(d);
+        return PM3_EFILE;
+    }
+    return PM3_SUCCESS;
+}
+
+static bool file_is_older(const char *a, const char *b) {
+    struct stat sa, sb;
+    if (stat(a, &sa) != 0 || stat(b, &sb) != 0) {
+        return false;
+    }
+    return sa.st_mtime < sb.st_mtime;
+}
+
+// Find the dictionary and open its compiled form when there is one.
+// `name.dicb` is used as asked for.  For any other name a `name.dicb` next to
+// or instead of `name.dic` is used,  unless it is older than the text file or was
+// compiled for another key length.  When d->file.data is NULL on return,  *path is a text file.
+static int dictionary_open(const char *preferredName, uint8_t keylen, char **path, dictionary_binary_t *d) {
+
+    memset(d, 0, sizeof(dictionary_binary_t));
+    *path = NULL;
+
+    if (str_endswith(preferredName, ".dicb")) {
+        if (searchFile(path, DICTIONARIES_SUBDIR, preferredName, ".dicb", false) != PM3_SUCCESS) {
+            return PM3_EFILE;
+        }
+        int res = dictionary_binary_open(*path, d);
+        if (res != PM3_SUCCESS) {
+            free(*path);
+            *path = NULL;
+            return res;
+        }
+        // a longer key is used by its prefix,  the same as the text file does
+        if (d->hdr->keylen < keylen) {
+            PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` holds %u byte keys, %u needed", *path, d->hdr->keylen, keylen);
+            dictionary_binary_close(d);
+            free(*path);
+            *path = NULL;
+            return PM3_EFILE;
+        }
+        return PM3_SUCCESS;
+    }
+
+    char *text = NULL;
+    char *binary = NULL;
+    bool has_text = (searchFile(&text, DICTIONARIES_SUBDIR, preferredName, ".dic", true) == PM3_SUCCESS);
+
+    size_t blen = strlen(preferredName) + 6;
+    char *bname = calloc(blen, sizeof(char));
+    if (bname == NULL) {
+        free(text);
+        return PM3_EMALLOC;
+    }
+    snprintf(bname, blen, "%s%s", preferredName, str_endswith(preferredName, ".dic") ? "b" : ".dicb");
+    bool has_binary = (searchFile(&binary, DICTIONARIES_SUBDIR, bname, ".dicb", true) == PM3_SUCCESS);
+    free(bname);
+
+    if (has_binary && (has_text == false || file_is_older(binary, text) == false)) {
+        if (dictionary_binary_open(binary, d) == PM3_SUCCESS) {
+            if (d->hdr->keylen == keylen) {
+                free(text);
+                *path = binary;
+                return PM3_SUCCESS;
+            }
+            dictionary_binary_close(d);
+        }
+    }
+    free(binary);
+
+    if (has_text == false) {
+        // once more,  to print the usual message
+        return searchFile(path, DICTIONARIES_SUBDIR, preferredName, ".dic", false);
+    }
+    *path = text;
+    return PM3_SUCCESS;
+}
+
 int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, uint8_t keylen, uint32_t *keycnt,
                          size_t startFilePosition, size_t *endFilePosition, bool verbose) {
 
@@ -2168,16 +2990,40 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
         *endFilePosition = 0;
 
     char *path;
-    if (searchFile(&path, DICTIONARIES_SUBDIR, preferredName, ".dic", false) != PM3_SUCCESS)
+    dictionary_binary_t dict;
+    if (dictionary_open(preferredName, keylen, &path, &dict) != PM3_SUCCESS)
         return PM3_EFILE;
 
-    // double up since its chars
-    keylen <<= 1;
-
-    char line[255];
     uint32_t vkeycnt = 0;
     size_t counter = 0;
     int retval = PM3_SUCCESS;
+    uint8_t *udata = (uint8_t *)data;
+
+    if (dict.file.data) {
+        // compiled,  the file position is the offset of a key
+        const size_t stride = dict.hdr->keylen;
+        size_t i = 0;
+        if (startFilePosition > sizeof(dictionary_binary_header_t)) {
+            i = (startFilePosition - sizeof(dictionary_binary_header_t)) / stride;
+        }
+
+        for (; i < dict.hdr->keycnt; i++) {
+            // cant store more data
+            if (maxdatalen && (counter + keylen > maxdatalen)) {
+                retval = 1;
+                if (endFilePosition)
+                    *endFilePosition = sizeof(dictionary_binary_header_t) + (i * stride);
+                break;
+            }
+            memcpy(udata + counter, dict.keys + (i * stride), keylen);
+            vkeycnt++;
+            counter += keylen;
+        }
+        dictionary_binary_close(&dict);
+        goto done;
+    }
+
+    char line[255];
 
     FILE *f = fopen(path, "r");
     if (!f) {
@@ -2194,8 +3040,6 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
         }
     }
 
-    uint8_t *udata = (uint8_t *)data;
-
     // read file
     while (!feof(f)) {
         long filepos = ftell(f);
@@ -2206,36 +3050,24 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
             break;
         }
 
-        // add null terminator
-        line[keylen] = 0;
-
-        // smaller keys than expected is skipped
-        if (strlen(line) < keylen)
-            continue;
-
-        // The line start with # is comment, skip
-        if (line[0] == '#')
-            continue;
-
-        if (!CheckStringIsHEXValue(line))
-            continue;
-
         // cant store more data
-        if (maxdatalen && (counter + (keylen >> 1) > maxdatalen)) {
+        if (maxdatalen && (counter + keylen > maxdatalen)) {
             retval = 1;
             if (endFilePosition)
                 *endFilePosition = filepos;
             break;
         }
 
-        if (hex_to_bytes(line, udata + counter, keylen >> 1) != (keylen >> 1))
+        if (dictionary_parse_line(line, keylen, udata + counter) == false)
             continue;
 
         vkeycnt++;
         memset(line, 0, sizeof(line));
-        counter += (keylen >> 1);
+        counter += keylen;
     }
     fclose(f);
+
+done:
     if (verbose)
         PrintAndLogEx(SUCCESS, "Loaded " _GREEN_("%2d") " keys from dictionary file `" _YELLOW_("%s") "`", vkeycnt, path);
 
@@ -2250,12 +3082,6 @@ out:
 
 int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t keylen, uint32_t *keycnt) {
 
-    int retval = PM3_SUCCESS;
-
-    char *path;
-    if (searchFile(&path, DICTIONARIES_SUBDIR, preferredName, ".dic", false) != PM3_SUCCESS)
-        return PM3_EFILE;
-
     // t5577 == 4bytes
     // mifare == 6 bytes
     // mf plus == 16 bytes
@@ -2266,75 +3092,513 @@ int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t key
         keylen = 6;
     }
 
-    size_t mem_size;
-    size_t block_size = 10 * keylen;
-
-    // double up since its chars
-    keylen <<= 1;
-
-    char line[255];
-
-    // allocate some space for the dictionary
-    *pdata = calloc(block_size, sizeof(uint8_t));
-    if (*pdata == NULL) {
-        free(path);
+    char *path;
+    dictionary_binary_t dict;
+    if (dictionary_open(preferredName, keylen, &path, &dict) != PM3_SUCCESS)
         return PM3_EFILE;
+
+    int retval = PM3_SUCCESS;
+    uint8_t *keys = NULL;
+    uint32_t cnt = 0;
+
+    if (dict.file.data) {
+        // callers own and free *pdata,  so the keys are copied out of the mapping
+        cnt = dict.hdr->keycnt;
+        keys = calloc(MAX(cnt, 1), keylen);
+        if (keys == NULL) {
+            retval = PM3_EMALLOC;
+        } else if (dict.hdr->keylen == keylen) {
+            memcpy(keys, dict.keys, (size_t)cnt * keylen);
+        } else {
+            for (uint32_t i = 0; i < cnt; i++) {
+                memcpy(keys + ((size_t)i * keylen), dict.keys + ((size_t)i * dict.hdr->keylen), keylen);
+            }
+        }
+        dictionary_binary_close(&dict);
+    } else {
+        retval = dictionary_load_text(path, keylen, &keys, &cnt);
     }
-    mem_size = block_size;
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", path);
-        retval = PM3_EFILE;
-        goto out;
+    if (retval != PM3_SUCCESS) {
+        free(keys);
+        free(path);
+        return retval;
     }
 
-    // read file
-    while (fgets(line, sizeof(line), f)) {
+    *pdata = keys;
+    *keycnt = cnt;
+    PrintAndLogEx(SUCCESS, "Loaded " _GREEN_("%2d") " keys from dictionary file `" _YELLOW_("%s") "`", *keycnt, path);
+    free(path);
+    return retval;
+}
 
-        // check if we have enough space (if not allocate more)
-        if ((*keycnt * (keylen >> 1)) >= mem_size) {
+// key order for the dedup sort,  qsort has no context pointer
+static const uint8_t *dedup_keys;
+static uint8_t dedup_keylen;
 
-            mem_size += block_size;
-            *pdata = realloc(*pdata, mem_size);
+static int dictionary_dedup_cmp(const void *a, const void *b) {
+    uint32_t ia = *(const uint32_t *)a;
+    uint32_t ib = *(const uint32_t *)b;
+    int res = memcmp(dedup_keys + ((size_t)ia * dedup_keylen), dedup_keys + ((size_t)ib * dedup_keylen), dedup_keylen);
+    if (res) {
+        return res;
+    }
+    // equal keys stay in file order,  the first one is kept
+    return (ia > ib) - (ia < ib);
+}
 
-            if (*pdata == NULL) {
-                retval = PM3_EFILE;
-                fclose(f);
-                goto out;
-            } else {
-                memset((uint8_t *)*pdata + (mem_size - block_size), 0, block_size);
-            }
-        }
+int compileFileDICTIONARY(const char *preferredName, const char *outName, uint8_t keylen, bool sort, uint32_t *keycnt, uint32_t *dupcnt) {
 
-        // add null terminator
-        line[keylen] = 0;
+    *keycnt = 0;
+    *dupcnt = 0;
 
-        // smaller keys than expected is skipped
-        if (strlen(line) < keylen)
-            continue;
+    if (keylen == 0 || keylen > DICTIONARY_MAX_KEY_LEN) {
+        return PM3_EINVARG;
+    }
 
-        // The line start with # is comment, skip
-        if (line[0] == '#')
-            continue;
+    // always the text file,  never an older compiled one
+    char *path;
+    if (searchFile(&path, DICTIONARIES_SUBDIR, preferredName, ".dic", false) != PM3_SUCCESS) {
+        return PM3_EFILE;
+    }
 
-        if (!CheckStringIsHEXValue(line))
-            continue;
+    uint8_t *keys = NULL;
+    uint32_t cnt = 0;
+    int res = dictionary_load_text(path, keylen, &keys, &cnt);
+    if (res != PM3_SUCCESS) {
+        free(path);
+        return res;
+    }
+    PrintAndLogEx(INFO, "Read " _YELLOW_("%u") " keys from `" _YELLOW_("%s") "`", cnt, path);
+    free(path);
 
-        uint64_t key = strtoull(line, NULL, 16);
+    uint32_t *order = calloc(MAX(cnt, 1), sizeof(uint32_t));
+    bool *dup = calloc(MAX(cnt, 1), sizeof(bool));
+    if (order == NULL || dup == NULL) {
+        free(order);
+        free(dup);
+        free(keys);
+        return PM3_EMALLOC;
+    }
 
-        num_to_bytes(key, keylen >> 1, (uint8_t *)*pdata + (*keycnt * (keylen >> 1)));
+    for (uint32_t i = 0; i < cnt; i++) {
+        order[i] = i;
+    }
 
-        (*keycnt)++;
+    dedup_keys = keys;
+    dedup_keylen = keylen;
+    qsort(order, cnt, sizeof(uint32_t), dictionary_dedup_cmp);
 
-        memset(line, 0, sizeof(line));
+    uint32_t dups = 0;
+    for (uint32_t i = 1; i < cnt; i++) {
+        if (memcmp(keys + ((size_t)order[i] * keylen), keys + ((size_t)order[i - 1] * keylen), keylen) == 0) {
+            dup[order[i]] = true;
+            dups++;
+        }
     }
-    fclose(f);
-    PrintAndLogEx(SUCCESS, "Loaded " _GREEN_("%2d") " keys from dictionary file `" _YELLOW_("%s") "`", *keycnt, path);
 
-out:
-    free(path);
-    return retval;
+    dictionary_binary_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DICTIONARY_BINARY_MAGIC, sizeof(hdr.magic));
+    hdr.version = DICTIONARY_BINARY_VERSION;
+    hdr.keylen = keylen;
+    hdr.flags = DICTIONARY_BINARY_DEDUP | ((sort) ? DICTIONARY_BINARY_SORTED : 0);
+    hdr.keycnt = cnt - dups;
+
+    // sorted, or in the order of the text file which usually puts the common keys first
+    uint8_t *out = calloc(MAX(hdr.keycnt, 1), keylen);
+    if (out == NULL) {
+        free(order);
+        free(dup);
+        free(keys);
+        return PM3_EMALLOC;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < cnt; i++) {
+        uint32_t k = (sort) ? order[i] : i;
+        if (dup[k] == false) {
+            memcpy(out + ((size_t)n * keylen), keys + ((size_t)k * keylen), keylen);
+            n++;
+        }
+    }
+    free(order);
+    free(dup);
+    free(keys);
+
+    FILE *f = fopen(outName, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "could not create file `" _YELLOW_("%s") "`", outName);
+        free(out);
+        return PM3_EFILE;
+    }
+
+    res = PM3_SUCCESS;
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1
+            || (n && fwrite(out, keylen, n, f) != n)) {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", outName);
+        res = PM3_EFILE;
+    }
+    fclose(f);
+    free(out);
+
+    // it may have gone into an indexed dictionary dir
+    searchFileFlushIndex();
+
+    if (res == PM3_SUCCESS) {
+        *keycnt = n;
+        *dupcnt = dups;
+    }
+    return res;
+}
+
+// Dictionary stream,  a parser thread fills a ring of key blocks while the caller
+// takes keys out of it.  Fed by a text, compiled or lz4 compressed dictionary.
+#define DICTIONARY_STREAM_BLOCKS        4
+#define DICTIONARY_STREAM_BLOCK_KEYS    4096
+#define DICTIONARY_STREAM_IO_SIZE       (64 * 1024)
+
+struct dictionary_stream_s {
+    char *path;
+    uint8_t keylen;
+
+    // source,  a compiled dictionary when dict.file.data is set,  else a text file
+    dictionary_binary_t dict;
+    uint32_t next_key;
+    FILE *f;
+    bool lz4;
+    LZ4F_decompressionContext_t dctx;
+    uint8_t *in;
+    size_t in_len, in_pos;
+    char *out;
+    size_t out_len, out_pos;
+    bool frame_done;
+
+    // ring,  slots head - tail are filled.  Only the parser writes head,  only the reader tail
+    uint8_t *keys;
+    uint32_t cnt[DICTIONARY_STREAM_BLOCKS];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t pos;           // keys already taken from the tail block
+    uint32_t taken;
+    bool eof;
+    bool stop;
+
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+// next piece of decompressed text.  1 when there is some,  0 at the end of the file,  -1 on error
+static int dictionary_stream_inflate(dictionary_stream_t *s) {
+    s->out_pos = 0;
+    s->out_len = 0;
+
+    while (s->out_len == 0) {
+        if (s->in_pos == s->in_len) {
+            s->in_pos = 0;
+            s->in_len = fread(s->in, 1, DICTIONARY_STREAM_IO_SIZE, s->f);
+            if (s->in_len == 0) {
+                if (ferror(s->f) || s->frame_done == false) {
+                    PrintAndLogEx(WARNING, "lz4 dictionary `" _YELLOW_("%s") "` is truncated", s->path);
+                    return -1;
+                }
+                return 0;
+            }
+        }
+
+        size_t out_size = DICTIONARY_STREAM_IO_SIZE;
+        size_t in_size = s->in_len - s->in_pos;
+        size_t hint = LZ4F_decompress(s->dctx, s->out, &out_size, s->in + s->in_pos, &in_size, NULL);
+        if (LZ4F_isError(hint)) {
+            PrintAndLogEx(WARNING, "lz4 dictionary `" _YELLOW_("%s") "` %s", s->path, LZ4F_getErrorName(hint));
+            return -1;
+        }
+        s->in_pos += in_size;
+        s->out_len = out_size;
+        // a finished frame may be followed by another one
+        s->frame_done = (hint == 0);
+    }
+    return 1;
+}
+
+// fgets() on the dictionary text.  1 for a line,  0 at the end of the file,  -1 on error
+static int dictionary_stream_getline(dictionary_stream_t *s, char *line, size_t size) {
+
+    if (s->lz4 == false) {
+        if (fgets(line, size, s->f)) {
+            return 1;
+        }
+        return (ferror(s->f)) ? -1 : 0;
+    }
+
+    size_t len = 0;
+    while (len + 1 < size) {
+        if (s->out_pos == s->out_len) {
+            int res = dictionary_stream_inflate(s);
+            if (res < 0) {
+                return -1;
+            }
+            if (res == 0) {
+                break;
+            }
+        }
+        char c = s->out[s->out_pos++];
+        line[len++] = c;
+        if (c == '\n') {
+            break;
+        }
+    }
+    line[len] = 0;
+    return (len) ? 1 : 0;
+}
+
+// parse up to max keys,  fewer only at the end of the dictionary
+static uint32_t dictionary_stream_fill(dictionary_stream_t *s, uint8_t *dst, uint32_t max) {
+    uint32_t n = 0;
+
+    if (s->dict.file.data) {
+        const size_t stride = s->dict.hdr->keylen;
+        for (; n < max && s->next_key < s->dict.hdr->keycnt; n++, s->next_key++) {
+            memcpy(dst + ((size_t)n * s->keylen), s->dict.keys + ((size_t)s->next_key * stride), s->keylen);
+        }
+        return n;
+    }
+
+    char line[255];
+    while (n < max) {
+        int res = dictionary_stream_getline(s, line, sizeof(line));
+        if (res <= 0) {
+            if (res < 0 && s->lz4 == false) {
+                PrintAndLogEx(WARNING, "error reading dictionary `" _YELLOW_("%s") "`", s->path);
+            }
+            break;
+        }
+        if (dictionary_parse_line(line, s->keylen, dst + ((size_t)n * s->keylen))) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static void *dictionary_stream_parser(void *arg) {
+    dictionary_stream_t *s = (dictionary_stream_t *)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&s->lock);
+        while (s->stop == false && (s->head - s->tail) == DICTIONARY_STREAM_BLOCKS) {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+        bool stop = s->stop;
+        uint32_t slot = s->head % DICTIONARY_STREAM_BLOCKS;
+        pthread_mutex_unlock(&s->lock);
+
+        if (stop) {
+            break;
+        }
+
+        // the slot is free,  the reader doesn't look at it until head moves on
+        uint8_t *block = s->keys + ((size_t)slot * DICTIONARY_STREAM_BLOCK_KEYS * s->keylen);
+        uint32_t n = dictionary_stream_fill(s, block, DICTIONARY_STREAM_BLOCK_KEYS);
+
+        pthread_mutex_lock(&s->lock);
+        if (n) {
+            s->cnt[slot] = n;
+            s->head++;
+        }
+        s->eof = (n < DICTIONARY_STREAM_BLOCK_KEYS);
+        bool eof = s->eof;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+
+        if (eof) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+static void dictionary_stream_stop(dictionary_stream_t *s) {
+    if (s->running) {
+        pthread_mutex_lock(&s->lock);
+        s->stop = true;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        pthread_join(s->thread, NULL);
+        s->running = false;
+    }
+
+    if (s->f) {
+        fclose(s->f);
+        s->f = NULL;
+    }
+    if (s->dctx) {
+        LZ4F_freeDecompressionContext(s->dctx);
+        s->dctx = NULL;
+    }
+}
+
+// (re)start parsing at the first key
+static int dictionary_stream_start(dictionary_stream_t *s) {
+
+    s->head = 0;
+    s->tail = 0;
+    s->pos = 0;
+    s->taken = 0;
+    s->eof = false;
+    s->stop = false;
+    s->next_key = 0;
+
+    if (s->dict.file.data == NULL) {
+        s->f = fopen(s->path, (s->lz4) ? "rb" : "r");
+        if (s->f == NULL) {
+            PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", s->path);
+            return PM3_EFILE;
+        }
+    }
+
+    if (s->lz4) {
+        LZ4F_errorCode_t res = LZ4F_createDecompressionContext(&s->dctx, LZ4F_VERSION);
+        if (LZ4F_isError(res)) {
+            PrintAndLogEx(WARNING, "lz4 dictionary `" _YELLOW_("%s") "` %s", s->path, LZ4F_getErrorName(res));
+            s->dctx = NULL;
+            dictionary_stream_stop(s);
+            return PM3_ESOFT;
+        }
+        s->in_len = 0;
+        s->in_pos = 0;
+        s->out_len = 0;
+        s->out_pos = 0;
+        s->frame_done = false;
+    }
+
+    if (pthread_create(&s->thread, NULL, dictionary_stream_parser, s) != 0) {
+        dictionary_stream_stop(s);
+        return PM3_ESOFT;
+    }
+    s->running = true;
+    return PM3_SUCCESS;
+}
+
+int dictionary_stream_open(dictionary_stream_t **pstream, const char *preferredName, uint8_t keylen) {
+
+    *pstream = NULL;
+
+    if (keylen == 0 || keylen > DICTIONARY_MAX_KEY_LEN) {
+        return PM3_EINVARG;
+    }
+
+    // no zlib in the client
+    if (str_endswith(preferredName, ".gz")) {
+        PrintAndLogEx(WARNING, "gzip compressed dictionaries are not supported, use lz4 instead");
+        return PM3_ENOTIMPL;
+    }
+
+    dictionary_stream_t *s = calloc(1, sizeof(dictionary_stream_t));
+    if (s == NULL) {
+        return PM3_EMALLOC;
+    }
+    s->keylen = keylen;
+
+    if (str_endswith(preferredName, ".lz4")) {
+        if (searchFile(&s->path, DICTIONARIES_SUBDIR, preferredName, ".lz4", false) != PM3_SUCCESS) {
+            free(s);
+            return PM3_EFILE;
+        }
+        s->lz4 = true;
+        s->in = calloc(DICTIONARY_STREAM_IO_SIZE, sizeof(uint8_t));
+        s->out = calloc(DICTIONARY_STREAM_IO_SIZE, sizeof(char));
+    } else if (dictionary_open(preferredName, keylen, &s->path, &s->dict) != PM3_SUCCESS) {
+        free(s);
+        return PM3_EFILE;
+    }
+
+    s->keys = calloc((size_t)DICTIONARY_STREAM_BLOCKS * DICTIONARY_STREAM_BLOCK_KEYS, keylen);
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+
+    if (s->keys == NULL || (s->lz4 && (s->in == NULL || s->out == NULL))) {
+        dictionary_stream_close(s);
+        return PM3_EMALLOC;
+    }
+
+    int res = dictionary_stream_start(s);
+    if (res != PM3_SUCCESS) {
+        dictionary_stream_close(s);
+        return res;
+    }
+
+    PrintAndLogEx(SUCCESS, "Streaming keys from dictionary file `" _YELLOW_("%s") "`", s->path);
+    *pstream = s;
+    return PM3_SUCCESS;
+}
+
+uint32_t dictionary_stream_read(dictionary_stream_t *s, uint8_t *keys, uint32_t maxkeys) {
+    uint32_t n = 0;
+
+    pthread_mutex_lock(&s->lock);
+    while (n < maxkeys) {
+        while (s->head == s->tail && s->eof == false) {
+            pthread_cond_wait(&s->cond, &s->lock);
+        }
+        if (s->head == s->tail) {
+            break;
+        }
+
+        uint32_t slot = s->tail % DICTIONARY_STREAM_BLOCKS;
+        uint32_t take = MIN(maxkeys - n, s->cnt[slot] - s->pos);
+        memcpy(keys + ((size_t)n * s->keylen), s->keys + (((size_t)slot * DICTIONARY_STREAM_BLOCK_KEYS + s->pos) * s->keylen), (size_t)take * s->keylen);
+        n += take;
+        s->pos += take;
+
+        // block used up,  the parser may refill it
+        if (s->pos == s->cnt[slot]) {
+            s->pos = 0;
+            s->tail++;
+            pthread_cond_broadcast(&s->cond);
+        }
+    }
+    s->taken += n;
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+bool dictionary_stream_eof(dictionary_stream_t *s) {
+    pthread_mutex_lock(&s->lock);
+    while (s->head == s->tail && s->eof == false) {
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+    bool eof = (s->head == s->tail);
+    pthread_mutex_unlock(&s->lock);
+    return eof;
+}
+
+uint32_t dictionary_stream_count(dictionary_stream_t *s) {
+    pthread_mutex_lock(&s->lock);
+    uint32_t n = s->taken;
+    pthread_mutex_unlock(&s->lock);
+    return n;
+}
+
+int dictionary_stream_rewind(dictionary_stream_t *s) {
+    dictionary_stream_stop(s);
+    return dictionary_stream_start(s);
+}
+
+void dictionary_stream_close(dictionary_stream_t *s) {
+    if (s == NULL) {
+        return;
+    }
+    dictionary_stream_stop(s);
+    dictionary_binary_close(&s->dict);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    free(s->keys);
+    free(s->in);
+    free(s->out);
+    free(s->path);
+    free(s);
 }
 
 int loadFileBinaryKey(const char *preferredName, const char *suffix, void **keya, void **keyb, size_t *alen, size_t *blen) {
@@ -2732,6 +3996,218 @@ int searchAndList(const char *pm3dir, const char *ext) {
     return PM3_SUCCESS;
 }
 
+// Files below the resource and dictionary directories of the user, the client and the
+// installation,  listed once instead of probed with a stat on every search.  The working
+// directory and the preference save paths come first and are still checked every time.
+typedef struct {
+    char *name;     // pm3dir followed by the path below it
+    char *path;     // the first one in search order
+} search_index_entry_t;
+
+static search_index_entry_t *search_index = NULL;
+static size_t search_index_size = 0;    // slots,  a power of two
+static size_t search_index_count = 0;
+static bool search_index_built = false;
+static pthread_mutex_t search_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define SEARCH_INDEX_DEPTH  4
+
+static bool search_index_covers(const char *pm3dir) {
+    return (strcmp(RESOURCES_SUBDIR, pm3dir) == 0) || (strcmp(DICTIONARIES_SUBDIR, pm3dir) == 0);
+}
+
+static size_t search_index_hash(const char *pm3dir, const char *name) {
+    // FNV-1a
+    uint32_t h = 0x811c9dc5;
+    for (const char *p = pm3dir; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 0x01000193;
+    }
+    for (const char *p = name; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 0x01000193;
+    }
+    return h;
+}
+
+static search_index_entry_t *search_index_slot(const char *pm3dir, const char *name) {
+    size_t dlen = strlen(pm3dir);
+    size_t i = search_index_hash(pm3dir, name) & (search_index_size - 1);
+    while (search_index[i].name) {
+        if (strncmp(search_index[i].name, pm3dir, dlen) == 0 && strcmp(search_index[i].name + dlen, name) == 0) {
+            break;
+        }
+        i = (i + 1) & (search_index_size - 1);
+    }
+    return &search_index[i];
+}
+
+static void search_index_free(void) {
+    for (size_t i = 0; i < search_index_size; i++) {
+        free(search_index[i].name);
+        free(search_index[i].path);
+    }
+    free(search_index);
+    search_index = NULL;
+    search_index_size = 0;
+    search_index_count = 0;
+    search_index_built = false;
+}
+
+static int search_index_grow(void) {
+    search_index_entry_t *old = search_index;
+    size_t old_size = search_index_size;
+
+    search_index_size = (old_size) ? old_size * 2 : 1024;
+    search_index = calloc(search_index_size, sizeof(search_index_entry_t));
+    if (search_index == NULL) {
+        search_index = old;
+        search_index_size = old_size;
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (old[i].name == NULL) {
+            continue;
+        }
+        // the hash runs over pm3dir and name in a row,  the stored name is both
+        size_t j = search_index_hash(old[i].name, "") & (search_index_size - 1);
+        while (search_index[j].name) {
+            j = (j + 1) & (search_index_size - 1);
+        }
+        search_index[j] = old[i];
+    }
+    free(old);
+    return PM3_SUCCESS;
+}
+
+// earlier directories are added first,  a name already there is shadowing this one
+static int search_index_add(const char *pm3dir, const char *name, const char *path) {
+    if ((search_index_count + 1) * 2 > search_index_size) {
+        if (search_index_grow() != PM3_SUCCESS) {
+            return PM3_EMALLOC;
+        }
+    }
+
+    search_index_entry_t *e = search_index_slot(pm3dir, name);
+    if (e->name) {
+        return PM3_SUCCESS;
+    }
+
+    size_t nlen = strlen(pm3dir) + strlen(name) + 1;
+    e->name = calloc(nlen, sizeof(char));
+    e->path = strdup(path);
+    if (e->name == NULL || e->path == NULL) {
+        free(e->name);
+        free(e->path);
+        e->name = NULL;
+        e->path = NULL;
+        return PM3_EMALLOC;
+    }
+    snprintf(e->name, nlen, "%s%s", pm3dir, name);
+    search_index_count++;
+    return PM3_SUCCESS;
+}
+
+// base ends with a slash,  rel is the part below the pm3dir,  empty or ending with a slash
+static int search_index_scan(const char *pm3dir, const char *base, const char *rel, uint8_t depth) {
+    char dir[FILE_PATH_SIZE * 2];
+    snprintf(dir, sizeof(dir), "%s%s", base, rel);
+
+    struct dirent **namelist;
+    int n = scandir(dir, &namelist, NULL, alphasort);
+    if (n < 0) {
+        return PM3_SUCCESS;
+    }
+
+    int res = PM3_SUCCESS;
+    for (int i = 0; i < n; i++) {
+        const char *d_name = namelist[i]->d_name;
+        if (res == PM3_SUCCESS && strcmp(d_name, ".") != 0 && strcmp(d_name, "..") != 0) {
+            char name[FILE_PATH_SIZE * 2];
+            char path[FILE_PATH_SIZE * 4];
+            snprintf(name, sizeof(name), "%s%s", rel, d_name);
+            snprintf(path, sizeof(path), "%s%s", base, name);
+
+            // directories too,  fileExists() is true for them
+            res = search_index_add(pm3dir, name, path);
+
+            if (res == PM3_SUCCESS && depth < SEARCH_INDEX_DEPTH && is_directory(path)) {
+                char sub[FILE_PATH_SIZE * 2];
+                snprintf(sub, sizeof(sub), "%s%s", name, PATHSEP);
+                res = search_index_scan(pm3dir, base, sub, depth + 1);
+            }
+        }
+        free(namelist[i]);
+    }
+    free(namelist);
+    return res;
+}
+
+// same directories and order as searchFinalFile()
+static int search_index_build(void) {
+    const char *dirs[] = { RESOURCES_SUBDIR, DICTIONARIES_SUBDIR };
+    const char *user_path = get_my_user_directory();
+    const char *exec_path = get_my_executable_directory();
+
+    search_index_free();
+    int res = search_index_grow();
+
+    for (size_t i = 0; (res == PM3_SUCCESS) && (i < ARRAYLEN(dirs)); i++) {
+        char base[FILE_PATH_SIZE * 2];
+        if (user_path) {
+            snprintf(base, sizeof(base), "%s%s%s", user_path, PM3_USER_DIRECTORY, dirs[i]);
+            res = search_index_scan(dirs[i], base, "", 0);
+        }
+        if (res == PM3_SUCCESS && exec_path) {
+            snprintf(base, sizeof(base), "%s%s", exec_path, dirs[i]);
+            res = search_index_scan(dirs[i], base, "", 0);
+        }
+        if (res == PM3_SUCCESS && exec_path) {
+            snprintf(base, sizeof(base), "%s%s%s", exec_path, PM3_SHARE_RELPATH, dirs[i]);
+            res = search_index_scan(dirs[i], base, "", 0);
+        }
+    }
+
+    if (res != PM3_SUCCESS) {
+        search_index_free();
+        return res;
+    }
+    search_index_built = true;
+    PrintAndLogEx(DEBUG, "Indexed %zu resource and dictionary files", search_index_count);
+    return PM3_SUCCESS;
+}
+
+// copy of the indexed path,  NULL when it isn't there or there is no index
+static char *search_index_lookup(const char *pm3dir, const char *filename, bool *indexed) {
+    char *path = NULL;
+
+    pthread_mutex_lock(&search_index_lock);
+    if (search_index_built == false) {
+        search_index_build();
+    }
+    *indexed = search_index_built;
+    if (search_index_built) {
+        search_index_entry_t *e = search_index_slot(pm3dir, filename);
+        if (e->name) {
+            path = strdup(e->path);
+        }
+    }
+    pthread_mutex_unlock(&search_index_lock);
+    return path;
+}
+
+int searchFileIndex(void) {
+    pthread_mutex_lock(&search_index_lock);
+    int res = search_index_build();
+    pthread_mutex_unlock(&search_index_lock);
+    return res;
+}
+
+void searchFileFlushIndex(void) {
+    pthread_mutex_lock(&search_index_lock);
+    search_index_free();
+    pthread_mutex_unlock(&search_index_lock);
+}
+
 static int searchFinalFile(char **foundpath, const char *pm3dir, const char *searchname, bool silent) {
 
     if ((foundpath == NULL) || (pm3dir == NULL) || (searchname == NULL)) {
@@ -2793,6 +4269,25 @@ static int searchFinalFile(char **foundpath, const char *pm3dir, const char *sea
         }
     }
 
+    // the user, client and installation dirs of resources and dictionaries are indexed.
+    // A file added to them during the session is missed by the silent probes until the
+    // index is rebuilt,  a search asked for by the user goes on to check the dirs.
+    if (search_index_covers(pm3dir)) {
+        bool indexed = false;
+        char *path = search_index_lookup(pm3dir, filename, &indexed);
+        if (path) {
+            free(filename);
+            *foundpath = path;
+            if ((g_debugMode == 2) && (!silent)) {
+                PrintAndLogEx(INFO, "Found %s", *foundpath);
+            }
+            return PM3_SUCCESS;
+        }
+        if (indexed && silent) {
+            goto out;
+        }
+    }
+
     // try pm3 dirs in user .proxmark3 (user mode)
     PrintAndLogEx(DEBUG, "Searching user .proxmark3 paths");
     const char *user_path = get_my_user_directory();
@@ -2814,6 +4309,10 @@ static int searchFinalFile(char **foundpath, const char *pm3dir, const char *sea
         if (fileExists(path)) {
             free(filename);
             *foundpath = path;
+            // the index missed it
+            if (search_index_covers(pm3dir)) {
+                searchFileFlushIndex();
+            }
             if ((g_debugMode == 2) && (!silent)) {
                 PrintAndLogEx(INFO, "Found %s", *foundpath);
             }
@@ -2849,6 +4348,10 @@ static int searchFinalFile(char **foundpath, const char *pm3dir, const char *sea
         if (fileExists(path)) {
             free(filename);
             *foundpath = path;
+            // the index missed it
+            if (search_index_covers(pm3dir)) {
+                searchFileFlushIndex();
+            }
             if ((g_debugMode == 2) && (!silent)) {
                 PrintAndLogEx(INFO, "Found %s", *foundpath);
             }
@@ -2882,6 +4385,10 @@ static int searchFinalFile(char **foundpath, const char *pm3dir, const char *sea
         if (fileExists(path)) {
             free(filename);
             *foundpath = path;
+            // the index missed it
+            if (search_index_covers(pm3dir)) {
+                searchFileFlushIndex();
+            }
             if ((g_debugMode == 2) && (!silent)) {
                 PrintAndLogEx(INFO, "Found %s", *foundpath);
             }
@@ -2911,6 +4418,10 @@ static int searchFinalFile(char **foundpath, const char *pm3dir, const char *sea
         if (fileExists(path)) {
             free(filename);
             *foundpath = path;
+            // the index missed it
+            if (search_index_covers(pm3dir)) {
+                searchFileFlushIndex();
+            }
             if ((g_debugMode == 2) && (!silent)) {
                 PrintAndLogEx(INFO, "Found %s", *foundpath);
             }
@@ -2988,13 +4499,17 @@ int pm3_load_dump(const char *fn, void **pdump, size_t *dumplen, size_t maxdumpl
             break;
         }
         case DICTIONARY: {
-            PrintAndLogEx(ERR, "Only <BIN|EML|JSON|MCT|NFC formats allowed");
+            PrintAndLogEx(ERR, "Only <BIN|EML|JSON|MCT|NFC|PM3DUMP formats allowed");
             return PM3_EINVARG;
         }
         case MCT: {
             res = loadFileMCT_safe(fn, pdump, dumplen);
             break;
         }
+        case PM3DUMP: {
+            res = loadFilePM3DUMP_safe(fn, pdump, dumplen, NULL);
+            break;
+        }
         case FLIPPER: {
             nfc_df_e foo = detect_nfc_dump_format(fn, true);
             if (foo == NFC_DF_MFC || foo == NFC_DF_MFU || foo == NFC_DF_PICOPASS) {
@@ -3032,10 +4547,39 @@ int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
         return PM3_EINVARG;
     }
     saveFile(fn, ".bin", d, n);
-    saveFileJSON(fn, jsft, d, n, NULL);
+    if (g_session.dump_format == DUMP_PM3DUMP) {
+        saveFilePM3DUMP(fn, jsft, d, n, true);
+    } else {
+        saveFileJSON(fn, jsft, d, n, NULL);
+    }
     return PM3_SUCCESS;
 }
 
+// card info of a MIFARE Classic dump,  from its manufacturer block
+static void mf_dump_extdump(uint8_t *d, size_t n, iso14a_mf_extdump_t *jd) {
+    memset(jd, 0, sizeof(iso14a_mf_extdump_t));
+    jd->card_info.ats_len = 0;
+
+    // Check for 4 bytes uid: bcc corrected and single size uid bits in ATQA
+    if ((d[0] ^ d[1] ^ d[2] ^ d[3]) == d[4] && (d[6] & 0xC0) == 0) {
+        jd->card_info.uidlen = 4;
+        memcpy(jd->card_info.uid, d, jd->card_info.uidlen);
+        jd->card_info.sak = d[5];
+        memcpy(jd->card_info.atqa, &d[6], sizeof(jd->card_info.atqa));
+    }
+    // Check for 7 bytes UID: double size uid bits in ATQA
+    else if ((d[8] & 0xC0) == 0x40) {
+        jd->card_info.uidlen = 7;
+        memcpy(jd->card_info.uid, d, jd->card_info.uidlen);
+        jd->card_info.sak = d[7];
+        memcpy(jd->card_info.atqa, &d[8], sizeof(jd->card_info.atqa));
+    } else {
+        PrintAndLogEx(WARNING, "Invalid dump. UID/SAK/ATQA not found");
+    }
+    jd->dump = d;
+    jd->dumplen = n;
+}
+
 int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
 
     if (fn == NULL || d == NULL || n == 0) {
@@ -3044,28 +4588,147 @@ int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
     }
     saveFile(fn, ".bin", d, n);
 
-    iso14a_mf_extdump_t jd = {0};
-    jd.card_info.ats_len = 0;
+    iso14a_mf_extdump_t jd;
+    mf_dump_extdump(d, n, &jd);
 
-    // Check for 4 bytes uid: bcc corrected and single size uid bits in ATQA
-    if ((d[0] ^ d[1] ^ d[2] ^ d[3]) == d[4] && (d[6] & 0xC0) == 0) {
-        jd.card_info.uidlen = 4;
-        memcpy(jd.card_info.uid, d, jd.card_info.uidlen);
-        jd.card_info.sak = d[5];
-        memcpy(jd.card_info.atqa, &d[6], sizeof(jd.card_info.atqa));
-    }
-    // Check for 7 bytes UID: double size uid bits in ATQA
-    else if ((d[8] & 0xC0) == 0x40) {
-        jd.card_info.uidlen = 7;
-        memcpy(jd.card_info.uid, d, jd.card_info.uidlen);
-        jd.card_info.sak = d[7];
-        memcpy(jd.card_info.atqa, &d[8], sizeof(jd.card_info.atqa));
+    // the container holds the plain dump,  the card info is found again on export
+    if (g_session.dump_format == DUMP_PM3DUMP) {
+        saveFilePM3DUMP(fn, jsfMfc_v2, d, n, true);
     } else {
-        PrintAndLogEx(WARNING, "Invalid dump. UID/SAK/ATQA not found");
+        saveFileJSON(fn, jsfMfc_v2, (uint8_t *)&jd, sizeof(jd), NULL);
+    }
+
+    if (g_session.dump_store && jd.card_info.uidlen) {
+        dumpstore_put(jd.card_info.uid, jd.card_info.uidlen, d, n, true);
     }
-    jd.dump = d;
-    jd.dumplen = n;
-    saveFileJSON(fn, jsfMfc_v2, (uint8_t *)&jd, sizeof(jd), NULL);
     return PM3_SUCCESS;
 }
 
+int pm3_export_dump_json(const char *fn, const char *outfn) {
+
+    uint8_t *d = NULL;
+    size_t n = 0;
+    JSONFileType ftype = jsfRaw;
+    int res = loadFilePM3DUMP_safe(fn, (void **)&d, &n, &ftype);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    if (ftype == jsfCustom) {
+        PrintAndLogEx(FAILED, "no JSON layout for this dump");
+        free(d);
+        return PM3_EINVARG;
+    }
+
+    if (ftype == jsfMfc_v2) {
+        iso14a_mf_extdump_t jd;
+        mf_dump_extdump(d, n, &jd);
+        res = saveFileJSON(outfn, jsfMfc_v2, (uint8_t *)&jd, sizeof(jd), NULL);
+    } else {
+        res = saveFileJSON(outfn, ftype, d, n, NULL);
+    }
+    free(d);
+    return res;
+}
+
+// the json writers share the static sprint_hex buffers,  and two workers must not pick the same free name
+static pthread_mutex_t convert_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int convert_save_bin(const char *outfn, const uint8_t *d, size_t n, bool verbose) {
+    char *fileName = newfilenamemcopyEx(outfn, ".bin", spItemCount);
+    if (fileName == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    int res = PM3_SUCCESS;
+    FILE *f = fopen(fileName, "wb");
+    if (f == NULL || fwrite(d, 1, n, f) != n) {
+        PrintAndLogEx(WARNING, "could not write file `" _YELLOW_("%s") "`", fileName);
+        res = PM3_EFILE;
+    } else if (verbose) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " bytes to binary file `" _YELLOW_("%s") "`", n, fileName);
+    }
+    if (f) {
+        fclose(f);
+    }
+    free(fileName);
+    return res;
+}
+
+int pm3_convert_dump(const char *fn, const char *outfn, DumpFileType_t to, JSONFileType jsft, bool verbose) {
+
+    if (to != BIN && to != JSON && to != PM3DUMP) {
+        PrintAndLogEx(ERR, "Only <BIN|JSON|PM3DUMP> formats can be written");
+        return PM3_EINVARG;
+    }
+
+    uint8_t *d = NULL;
+    size_t n = 0;
+    int res;
+
+    // the layout is known for pm3dump and nfc files,  the callers choice is for the others
+    DumpFileType_t from = get_filetype(fn);
+    if (from == PM3DUMP) {
+        res = loadFilePM3DUMP_safe(fn, (void **)&d, &n, &jsft);
+    } else {
+        if (from == FLIPPER) {
+            nfc_df_e nft = detect_nfc_dump_format(fn, false);
+            if (nft == NFC_DF_MFC) {
+                jsft = jsfMfc_v2;
+            } else if (nft == NFC_DF_MFU) {
+                jsft = jsfMfuMemory;
+            } else if (nft == NFC_DF_PICOPASS) {
+                jsft = jsfIclass;
+            }
+        }
+        res = pm3_load_dump(fn, (void **)&d, &n, PM3_CONVERT_MAX_DUMP);
+    }
+
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    if (d == NULL || n == 0) {
+        free(d);
+        return PM3_ESOFT;
+    }
+
+    // ultralight json wants the dump with its header,  older dumps get one added
+    if (jsft == jsfMfuMemory) {
+        res = convert_mfu_dump_format(&d, &n, false);
+        if (res == PM3_SUCCESS && n < sizeof(mfu_dump_t)) {
+            uint8_t *tmp = realloc(d, sizeof(mfu_dump_t));
+            if (tmp == NULL) {
+                res = PM3_EMALLOC;
+            } else {
+                d = tmp;
+                memset(d + n, 0, sizeof(mfu_dump_t) - n);
+            }
+        }
+    } else if ((jsft == jsfMfc_v2 && n < MFBLOCK_SIZE) || (jsft == jsfIclass && n < sizeof(picopass_hdr_t))) {
+        PrintAndLogEx(WARNING, "dump is too short for its type");
+        res = PM3_ESOFT;
+    }
+
+    if (res != PM3_SUCCESS) {
+        free(d);
+        return res;
+    }
+
+    pthread_mutex_lock(&convert_lock);
+    if (to == BIN) {
+        res = convert_save_bin(outfn, d, n, verbose);
+    } else if (to == PM3DUMP) {
+        res = saveFilePM3DUMPex(outfn, jsft, d, n, verbose, spItemCount);
+    } else if (jsft == jsfMfc_v2) {
+        iso14a_mf_extdump_t jd;
+        mf_dump_extdump(d, n, &jd);
+        res = saveFileJSONex(outfn, jsfMfc_v2, (uint8_t *)&jd, sizeof(jd), verbose, NULL, spItemCount);
+    } else {
+        res = saveFileJSONex(outfn, jsft, d, n, verbose, NULL, spItemCount);
+    }
+    pthread_mutex_unlock(&convert_lock);
+
+    free(d);
+    return res;
+}
+
@@ -72,6 +72,7 @@ typedef enum {
     jsfLto,
     jsfCryptorf,
     jsfNDEF,
+    // stored by number in pm3dump files,  add new types at the end
 } JSONFileType;
 
 typedef enum {
@@ -81,8 +82,23 @@ typedef enum {
     DICTIONARY,
     MCT,
     FLIPPER,
+    PM3DUMP,
 } DumpFileType_t;
 
+// pm3dump container,  the plain dump behind this header.  Little endian
+#define PM3DUMP_MAGIC       "PM3D"
+#define PM3DUMP_VERSION     1
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t ftype;          // JSONFileType a JSON export is written as
+    uint16_t hdrlen;        // offset of the data,  later versions may add fields
+    uint32_t datalen;
+    uint8_t crc[4];         // crc32 of the data
+    uint64_t created;       // unix time
+} PACKED pm3dump_header_t;
+
 typedef enum {
     MFU_DF_UNKNOWN,
     MFU_DF_PLAINBIN,
@@ -102,6 +118,7 @@ typedef enum {
 } nfc_df_e;
 
 int fileExists(const char *filename);
+bool is_directory(const char *filename);
 
 // set a path in the path list g_session.defaultPaths
 bool setDefaultPath(savePaths_t pathIndex, const char *path);
@@ -124,6 +141,21 @@ void truncate_filename(char *fn,  uint16_t maxlen);
  */
 int saveFile(const char *preferredName, const char *suffix, const void *data, size_t datalen);
 
+/**
+ * @brief Utility function to save a dump to a pm3dump file,  the binary data behind a small header.
+ * Written and read back without any conversion,  the JSON file can be made from it later.
+ * E.g. dumpdata-15.pm3dump
+ *
+ * @param preferredName
+ * @param ftype JSON layout of the data,  used by the export
+ * @param data The binary data to write to the file
+ * @param datalen the length of the data
+ * @param verbose
+ * @return PM3_SUCCESS if OK
+ */
+int saveFilePM3DUMP(const char *preferredName, JSONFileType ftype, const uint8_t *data, size_t datalen, bool verbose);
+int saveFilePM3DUMPex(const char *preferredName, JSONFileType ftype, const uint8_t *data, size_t datalen, bool verbose, savePaths_t e_save_path);
+
 /** STUB
  * @brief Utility function to save JSON data to a file. This method takes a preferred name, but if that
  * file already exists, it tries with another name until it finds something suitable.
@@ -139,6 +171,40 @@ int saveFileJSON(const char *preferredName, JSONFileType ftype, uint8_t *data, s
 int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose, void (*callback)(json_t *), savePaths_t e_save_path);
 int saveFileJSONroot(const char *preferredName, void *root, size_t flags, bool verbose);
 int saveFileJSONrootEx(const char *preferredName, const void *root, size_t flags, bool verbose, bool overwrite);
+
+// Streaming JSON writer, for exports too big to build as one json_t tree.
+// Every value handed to JsonStreamAdd is written out and freed at once.
+#define JSON_STREAM_MAX_DEPTH   8
+
+typedef struct {
+    FILE *f;
+    char *filename;
+    uint8_t depth;
+    bool array[JSON_STREAM_MAX_DEPTH];
+    bool empty[JSON_STREAM_MAX_DEPTH];
+    bool flush;
+    bool verbose;
+} json_stream_t;
+
+/**
+ * @brief Open a json file for streaming and start its root object or array.
+ * Pipes and other non regular files are flushed after each record.
+ *
+ * @param js stream state
+ * @param preferredName file name, ".json" is added
+ * @param array root is an array instead of an object
+ * @param verbose print the file name when done
+ * @param overwrite don't look for a free file name
+ * @return PM3_SUCCESS or PM3_EFILE / PM3_EMALLOC
+ */
+int JsonStreamOpen(json_stream_t *js, const char *preferredName, bool array, bool verbose, bool overwrite);
+// open a nested array or object. key is ignored inside arrays
+int JsonStreamBegin(json_stream_t *js, const char *key, bool array);
+// write one value on its own line, takes the reference of value
+int JsonStreamAdd(json_stream_t *js, const char *key, json_t *value);
+int JsonStreamEnd(json_stream_t *js);
+// close every open level and the file
+int JsonStreamClose(json_stream_t *js);
 /** STUB
  * @brief Utility function to save WAVE data to a file. This method takes a preferred name, but if that
  * file already exists, it tries with another name until it finds something suitable.
@@ -149,7 +215,38 @@ int saveFileJSONrootEx(const char *preferredName, const void *root, size_t flags
  * @param datalen the length of the data
  * @return 0 for ok
  */
-int saveFileWAVE(const char *preferredName, const int *data, size_t datalen);
+int saveFileWAVE(const char *preferredName, const int16_t *data, size_t datalen);
+
+/**
+ * @brief Utility function to load a 8 or 16 bit PCM wave file into a sample buffer.
+ * Only the first channel is used, 16 bit samples are scaled down to the 8 bit graph range.
+ *
+ * @param path the file
+ * @param data sample buffer
+ * @param maxdatalen size of the buffer in samples,  extra samples are dropped
+ * @param datalen number of samples loaded
+ * @return PM3_SUCCESS if OK
+ */
+int loadFileWAVE(const char *path, int16_t *data, size_t maxdatalen, size_t *datalen);
+
+// Streaming wave writer, for samples arriving from the device while sniffing.
+// Input is the raw packed sample stream, the header is patched on close.
+typedef struct {
+    FILE *f;
+    char *filename;
+    uint32_t rate;
+    uint8_t bits_per_sample;
+    uint8_t acc;
+    uint8_t acc_bits;
+    bool error;
+    uint64_t samples;
+} wave_stream_t;
+
+int WaveStreamOpen(wave_stream_t *ws, const char *preferredName, uint32_t rate, uint8_t bits_per_sample);
+void WaveStreamWrite(wave_stream_t *ws, const uint8_t *data, size_t len);
+// raw_data_cb_t compatible, arg is the wave_stream_t
+void WaveStreamWrite_cb(const uint8_t *data, size_t len, void *arg);
+int WaveStreamClose(wave_stream_t *ws);
 
 /** STUB
  * @brief Utility function to save PM3 data to a file. This method takes a preferred name, but if that
@@ -161,7 +258,40 @@ int saveFileWAVE(const char *preferredName, const int *data, size_t datalen);
  * @param datalen the length of the data
  * @return 0 for ok
  */
-int saveFilePM3(const char *preferredName, int *data, size_t datalen);
+int saveFilePM3(const char *preferredName, int16_t *data, size_t datalen);
+
+// binary sample file,  a header and the samples as little endian int16
+#define PM3B_MAGIC      "PM3B"
+#define PM3B_VERSION    1
+
+typedef struct {
+    char magic[4];
+    uint8_t version;
+    uint8_t bits;       // 16
+    uint16_t rfu;
+    uint32_t samples;
+} PACKED pm3b_header_t;
+
+/**
+ * @brief Utility function to save samples to a binary .pm3b file,  see saveFilePM3.
+ *
+ * @param preferredName
+ * @param data samples
+ * @param datalen number of samples
+ * @return PM3_SUCCESS if OK
+ */
+int saveFilePM3B(const char *preferredName, const int16_t *data, size_t datalen);
+
+/**
+ * @brief Utility function to load a .pm3b file straight into a sample buffer.
+ *
+ * @param path the file
+ * @param data sample buffer
+ * @param maxdatalen size of the buffer in samples,  extra samples are dropped
+ * @param datalen number of samples loaded
+ * @return PM3_SUCCESS if OK
+ */
+int loadFilePM3B(const char *path, int16_t *data, size_t maxdatalen, size_t *datalen);
 
 /**
  * @brief Utility function to save a keydump into a binary file.
@@ -185,6 +315,28 @@ int createMfcKeyDump(const char *preferredName, uint8_t sectorsCnt, const sector
 */
 int loadFile_safe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen);
 int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose);
+
+// read only view of a whole file,  a mapping where mmap is available,  else a copy in memory
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    bool mapped;
+} mapped_file_t;
+
+/**
+ * @brief Utility function to map a binary file instead of reading it,  for big inputs.
+ * Searched for like loadFile_safe,  release it with releaseFileMapped.
+ *
+ * @param preferredName
+ * @param suffix the file suffix. Including the ".".
+ * @param m the file data
+ * @param verbose
+ * @return PM3_SUCCESS for ok, PM3_E* for failz
+*/
+int loadFileMapped_safe(const char *preferredName, const char *suffix, mapped_file_t *m, bool verbose);
+// same,  with the path as is
+int mapFile(const char *path, mapped_file_t *m);
+void releaseFileMapped(mapped_file_t *m);
 /**
  * @brief  Utility function to load data from a textfile (EML). This method takes a preferred name.
  * E.g. dumpdata-15.txt
@@ -196,6 +348,17 @@ int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata,
 */
 int loadFileEML_safe(const char *preferredName, void **pdata, size_t *datalen);
 
+/**
+ * @brief  Utility function to load a pm3dump file,  checks its crc and allocates memory.
+ *
+ * @param preferredName
+ * @param pdata The loaded dump
+ * @param datalen the number of bytes loaded from file
+ * @param ftype JSON layout of the data. may be NULL
+ * @return PM3_SUCCESS for ok, PM3_E* for failz
+*/
+int loadFilePM3DUMP_safe(const char *preferredName, void **pdata, size_t *datalen, JSONFileType *ftype);
+
 /**
  * @brief  Utility function to load data from a textfile (MCT). This method takes a preferred name.
  * E.g. dumpdata-15.mct
@@ -277,6 +440,47 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
 */
 int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t keylen, uint32_t *keycnt);
 
+// longest key a compiled dictionary holds
+#define DICTIONARY_MAX_KEY_LEN 32
+
+/**
+ * @brief  Utility function to compile a DICTIONARY textfile into a binary dictionary (.dicb).
+ * Duplicate keys are removed,  the first one of each is kept.
+ * The loaders above pick up `name.dicb` in place of `name.dic` when it is not older,
+ * and map it instead of parsing the text.
+ *
+ * @param preferredName text dictionary, E.g. mfc_default_keys.dic
+ * @param outName path of the compiled dictionary to write
+ * @param keylen  the number of bytes a key per row is
+ * @param sort sort the keys,  else they keep the order of the text file
+ * @param keycnt number of keys written
+ * @param dupcnt number of duplicate keys removed
+ * @return PM3_SUCCESS if OK
+*/
+int compileFileDICTIONARY(const char *preferredName, const char *outName, uint8_t keylen, bool sort, uint32_t *keycnt, uint32_t *dupcnt);
+
+typedef struct dictionary_stream_s dictionary_stream_t;
+
+/**
+ * @brief  Utility function to read a DICTIONARY in chunks while a thread parses ahead.
+ * Takes the same names as the loaders above,  and `name.dic.lz4` for an lz4 compressed one.
+ * The keys are never all in memory,  use it for dictionaries too big to load.
+ *
+ * @param pstream the opened stream,  free it with dictionary_stream_close()
+ * @param preferredName
+ * @param keylen  the number of bytes a key per row is
+ * @return PM3_SUCCESS if OK
+*/
+int dictionary_stream_open(dictionary_stream_t **pstream, const char *preferredName, uint8_t keylen);
+// next keys,  waits for the parser.  Fewer than maxkeys only at the end,  0 when there are no more
+uint32_t dictionary_stream_read(dictionary_stream_t *s, uint8_t *keys, uint32_t maxkeys);
+// true when no key follows,  waits for the parser
+bool dictionary_stream_eof(dictionary_stream_t *s);
+// keys read since open or rewind
+uint32_t dictionary_stream_count(dictionary_stream_t *s);
+int dictionary_stream_rewind(dictionary_stream_t *s);
+void dictionary_stream_close(dictionary_stream_t *s);
+
 int loadFileBinaryKey(const char *preferredName, const char *suffix, void **keya, void **keyb, size_t *alen, size_t *blen);
 
 /**
@@ -293,6 +497,10 @@ nfc_df_e detect_nfc_dump_format(const char *preferredName, bool verbose);
 
 int searchAndList(const char *pm3dir, const char *ext);
 int searchFile(char **foundpath, const char *pm3dir, const char *searchname, const char *suffix, bool silent);
+// list the resource and dictionary dirs searchFile() looks in,  it does so itself on first use
+int searchFileIndex(void);
+// after writing into those dirs,  the next search lists them again
+void searchFileFlushIndex(void);
 
 
 /**
@@ -318,7 +526,7 @@ int pm3_load_dump(const char *fn, void **pdump, size_t *dumplen, size_t maxdumpl
  * @brief Utility function to save data to three file files (BIN/JSON).
  * It also tries to save according to user preferences set dump folder paths.
  * E.g. dumpdata.bin
- * E.g. dumpdata.json
+ * E.g. dumpdata.json,  or dumpdata.pm3dump with `prefs set dumpformat --pm3dump`
  *
  * @param fn
  * @param d The binary data to write to the file
@@ -344,4 +552,30 @@ int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft);
  * @return PM3_SUCCESS if OK
  */
 int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft);
+
+/**
+ * @brief Utility function to write the JSON file of a pm3dump file,  as pm3_save_dump would have.
+ *
+ * @param fn pm3dump file
+ * @param outfn preferred name of the JSON file
+ * @return PM3_SUCCESS if OK
+ */
+int pm3_export_dump_json(const char *fn, const char *outfn);
+
+// largest dump pm3_convert_dump loads,  a 4k MIFARE Classic or iCLASS dump fits easily
+#define PM3_CONVERT_MAX_DUMP    0x10000
+
+/**
+ * @brief Utility function to convert a dump file to another format.
+ * Loads any format pm3_load_dump knows and writes BIN, JSON or PM3DUMP next to outfn,
+ * a free name is picked when the file exists.  Safe to call from several threads.
+ *
+ * @param fn dump file
+ * @param outfn preferred name of the new file,  the extension is added
+ * @param to BIN, JSON or PM3DUMP
+ * @param jsft layout of the dump,  pm3dump and nfc files bring their own
+ * @param verbose
+ * @return PM3_SUCCESS if OK
+ */
+int pm3_convert_dump(const char *fn, const char *outfn, DumpFileType_t to, JSONFileType jsft, bool verbose);
 #endif // FILEUTILS_H
@@ -30,6 +30,7 @@
 #include "util_posix.h"
 #include "comms.h"
 #include "commonutil.h"
+#include "crc32.h"
 
 #define FLASH_START            0x100000
 
@@ -37,8 +38,13 @@
 #define BOOTLOADER_END         (FLASH_START + BOOTLOADER_SIZE)
 
 #define BLOCK_SIZE             0x200
+// blocks sent ahead of their ACK,  when the bootloader understands CMD_BL_FLASH_CRC
+#define FLASH_PIPELINE_DEPTH   4
 
-#define FLASHER_VERSION        BL_VERSION_1_0_0
+#define FLASHER_VERSION        BL_VERSION_1_1_0
+
+// device info flags of the bootloader we are talking to
+static uint32_t gs_bl_state = 0;
 
 static const uint8_t elf_ident[] = {
     0x7f, 'E', 'L', 'F',
@@ -258,47 +264,25 @@ static int print_and_validate_version(struct version_information_t *vi) {
 
 // Load an ELF file for flashing
 int flash_load(flash_file_t *ctx, bool force) {
-    FILE *fd;
     Elf32_Ehdr_t *ehdr;
     Elf32_Shdr_t *shdrs = NULL;
     uint8_t *shstr = NULL;
     struct version_information_t *vi = NULL;
     int res = PM3_EUNDEF;
 
-    fd = fopen(ctx->filename, "rb");
-    if (!fd) {
+    // segments are copied out in flash_prepare,  the file itself is only read
+    res = mapFile(ctx->filename, &ctx->elf_file);
+    if (res != PM3_SUCCESS) {
         PrintAndLogEx(ERR, _RED_("Could not open file") " %s  >>> ", ctx->filename);
-        res = PM3_EFILE;
         goto fail;
     }
+    res = PM3_EUNDEF;
+    ctx->elf = ctx->elf_file.data;
 
     PrintAndLogEx(SUCCESS, _CYAN_("Loading ELF file") _YELLOW_(" %s"), ctx->filename);
 
-    // get filesize in order to malloc memory
-    fseek(fd, 0, SEEK_END);
-    long fsize = ftell(fd);
-    fseek(fd, 0, SEEK_SET);
-
-    if (fsize <= 0) {
-        PrintAndLogEx(ERR, "Error, when getting filesize");
-        res = PM3_EFILE;
-        fclose(fd);
-        goto fail;
-    }
-
-    ctx->elf = calloc(fsize + 1, sizeof(uint8_t));
-    if (!ctx->elf) {
-        PrintAndLogEx(ERR, "Error, cannot allocate memory");
-        res = PM3_EMALLOC;
-        fclose(fd);
-        goto fail;
-    }
-
-    size_t bytes_read = fread(ctx->elf, 1, fsize, fd);
-    fclose(fd);
-
-    if (bytes_read != fsize) {
-        PrintAndLogEx(ERR, "Error, bytes read mismatch file size");
+    if (ctx->elf_file.size < sizeof(Elf32_Ehdr_t)) {
+        PrintAndLogEx(ERR, "Not an ELF file or wrong ELF type");
         res = PM3_EFILE;
         goto fail;
     }
@@ -522,6 +506,8 @@ int flash_start_flashing(int enable_bl_writes, char *serial_port_name, uint32_t
     if (ret != PM3_SUCCESS)
         return ret;
 
+    gs_bl_state = state;
+
     if (state & DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO) {
         SendCommandBL(CMD_CHIP_INFO, 0, 0, 0, NULL, 0);
         PacketResponseNG resp;
@@ -607,16 +593,19 @@ int flash_reboot_bootloader(char *serial_port_name, bool wait_appear) {
     return enter_bootloader(serial_port_name, wait_appear);
 }
 
-static int write_block(uint32_t address, uint8_t *data, uint32_t length) {
+static void send_block(uint32_t address, uint8_t *data, uint32_t length) {
     uint8_t block_buf[BLOCK_SIZE];
     memset(block_buf, 0xFF, BLOCK_SIZE);
     memcpy(block_buf, data, length);
-    PacketResponseNG resp;
 #if defined ICOPYX
     SendCommandBL(CMD_FINISH_WRITE, address, 0xff, 0x1fd, block_buf, length);
 #else
     SendCommandBL(CMD_FINISH_WRITE, address, 0, 0, block_buf, length);
 #endif
+}
+
+static int wait_block_ack(void) {
+    PacketResponseNG resp;
     int ret = wait_for_ack(&resp);
     if (ret && resp.oldarg[0]) {
         uint32_t lock_bits = resp.oldarg[0] >> 16;
@@ -631,6 +620,31 @@ static int write_block(uint32_t address, uint8_t *data, uint32_t length) {
     return ret;
 }
 
+// CRC32 of the full blocks of a segment as they are in the device flash,  one per block
+static int get_block_crcs(uint32_t address, uint32_t blocks, uint32_t *crcs) {
+    for (uint32_t done = 0; done < blocks;) {
+        uint32_t n = MIN(blocks - done, BL_FLASH_CRC_MAX_BLOCKS);
+        SendCommandBL(CMD_BL_FLASH_CRC, address + done * BLOCK_SIZE, n, BLOCK_SIZE, NULL, 0);
+
+        PacketResponseNG resp;
+        WaitForResponse(CMD_UNKNOWN, &resp);
+        if (resp.cmd != CMD_BL_FLASH_CRC || resp.oldarg[0] != n) {
+            return PM3_ESOFT;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            crcs[done + i] = MemLeToUint4byte(resp.data.asBytes + i * sizeof(uint32_t));
+        }
+        done += n;
+    }
+    return PM3_SUCCESS;
+}
+
+static uint32_t block_crc(const uint8_t *data) {
+    uint8_t crc[4];
+    crc32_ex(data, BLOCK_SIZE, crc);
+    return MemLeToUint4byte(crc);
+}
+
 static const char ice[] =
     "...................................................................\n        @@@  @@@@@@@ @@@@@@@@ @@@@@@@@@@   @@@@@@  @@@  @@@\n"
     "        @@! !@@      @@!      @@! @@! @@! @@!  @@@ @@!@!@@@\n        !!@ !@!      @!!!:!   @!! !!@ @!@ @!@!@!@! @!@@!!@!\n"
@@ -642,23 +656,41 @@ static const char ice[] =
     ;
 
 // Write a file's segments to Flash
+//
+// With a bootloader which understands CMD_BL_FLASH_CRC, full blocks whose CRC32 in the
+// device already matches are skipped, a few blocks are kept in flight instead of waiting
+// for each ACK, and the written blocks are verified by CRC once the segment is done.
 int flash_write(flash_file_t *ctx) {
     int len = 0;
 
     PrintAndLogEx(SUCCESS, "Writing segments for file: %s", ctx->filename);
 
     bool filter_ansi = !g_session.supports_colors;
+    bool use_crc = (gs_bl_state & DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC);
+    uint8_t depth = use_crc ? FLASH_PIPELINE_DEPTH : 1;
 
     for (int i = 0; i < ctx->num_segs; i++) {
         flash_seg_t *seg = &ctx->segments[i];
 
         uint32_t length = seg->length;
         uint32_t blocks = (length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        uint32_t full_blocks = length / BLOCK_SIZE;
         uint32_t end = seg->start + length;
 
         PrintAndLogEx(SUCCESS, " 0x%08x..0x%08x [0x%x / %u blocks]", seg->start, end - 1, length, blocks);
         fflush(stdout);
-        int block = 0;
+
+        uint32_t *crcs = NULL;
+        if (use_crc && full_blocks) {
+            crcs = calloc(full_blocks, sizeof(uint32_t));
+            if (crcs == NULL || get_block_crcs(seg->start, full_blocks, crcs) != PM3_SUCCESS) {
+                // not fatal, just write everything
+                free(crcs);
+                crcs = NULL;
+            }
+        }
+
+        uint32_t block = 0, acked = 0, skipped = 0;
         uint8_t *data = seg->data;
         uint32_t baddr = seg->start;
 
@@ -667,27 +699,67 @@ int flash_write(flash_file_t *ctx) {
             if (block_size > BLOCK_SIZE)
                 block_size = BLOCK_SIZE;
 
-            if (write_block(baddr, data, block_size) < 0) {
-                PrintAndLogEx(ERR, "Error writing block %d of %u", block, blocks);
-                return PM3_EFATAL;
+            bool skip = (crcs != NULL) && (block < full_blocks) && (crcs[block] == block_crc(data));
+            if (skip) {
+                skipped++;
+                acked++;
+            } else {
+                if (block - acked >= depth) {
+                    if (wait_block_ack() < 0) {
+                        PrintAndLogEx(ERR, "Error writing block %u of %u", acked, blocks);
+                        free(crcs);
+                        return PM3_EFATAL;
+                    }
+                    acked++;
+                }
+                send_block(baddr, data, block_size);
             }
 
             data += block_size;
             baddr += block_size;
             length -= block_size;
             block++;
+            int c = skip ? '_' : '.';
             if (len < strlen(ice)) {
-                if (filter_ansi && !isalpha(ice[len])) {
-                    len++;
-                } else {
-                    fprintf(stdout, "%c", ice[len++]);
+                c = ice[len++];
+                if (filter_ansi && !isalpha(c)) {
+                    continue;
                 }
-            } else {
-                fprintf(stdout, ".");
             }
+            fprintf(stdout, "%c", c);
             fflush(stdout);
         }
-        PrintAndLogEx(NORMAL, " " _GREEN_("ok"));
+
+        // collect what is still in flight,  skipped blocks were counted as acked
+        while (acked < block) {
+            if (wait_block_ack() < 0) {
+                PrintAndLogEx(ERR, "Error writing block %u of %u", acked, blocks);
+                free(crcs);
+                return PM3_EFATAL;
+            }
+            acked++;
+        }
+
+        if (crcs != NULL) {
+            if (get_block_crcs(seg->start, full_blocks, crcs) != PM3_SUCCESS) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(ERR, "Error reading back block CRCs");
+                free(crcs);
+                return PM3_EFATAL;
+            }
+            for (uint32_t b = 0; b < full_blocks; b++) {
+                if (crcs[b] != block_crc((uint8_t *)seg->data + b * BLOCK_SIZE)) {
+                    PrintAndLogEx(NORMAL, "");
+                    PrintAndLogEx(ERR, "Verification failed at block %u, 0x%08x", b, seg->start + b * BLOCK_SIZE);
+                    free(crcs);
+                    return PM3_EFATAL;
+                }
+            }
+            free(crcs);
+            PrintAndLogEx(NORMAL, " " _GREEN_("ok") " ( %u unchanged, verified )", skipped);
+        } else {
+            PrintAndLogEx(NORMAL, " " _GREEN_("ok"));
+        }
         fflush(stdout);
     }
     return PM3_SUCCESS;
@@ -702,7 +774,7 @@ void flash_free(flash_file_t *ctx) {
         ctx->filename = NULL;
     }
     if (ctx->elf) {
-        free(ctx->elf);
+        releaseFileMapped(&ctx->elf_file);
         ctx->elf = NULL;
         ctx->phdrs = NULL;
         ctx->num_phdrs = 0;
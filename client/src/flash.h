@@ -21,6 +21,7 @@
 
 #include "common.h"
 #include "elf.h"
+#include "fileutils.h"   // mapped_file_t
 
 #define FLASH_MAX_FILES 4
 #define ONE_KB 1024
@@ -33,7 +34,8 @@ typedef struct {
 
 typedef struct {
     char *filename;
-    uint8_t *elf;
+    mapped_file_t elf_file;
+    uint8_t *elf;                 // elf_file.data,  read only
     Elf32_Phdr_t *phdrs;
     uint16_t num_phdrs;
     int can_write_bl;
@@ -24,13 +24,13 @@
 #include "lfdemod.h"
 #include "cmddata.h"        // for g_debugmode
 #include "commonutil.h"     // Uint4bytetomemle
+#include "graphdsp.h"
 
 
-int32_t g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
-int32_t g_OperationBuffer[MAX_GRAPH_TRACE_LEN];
-int32_t g_OverlayBuffer[MAX_GRAPH_TRACE_LEN];
+// g_GraphBuffer / g_GraphTraceLen are part of the demod context,  see lfdemodctx.h
+int16_t g_OperationBuffer[MAX_GRAPH_TRACE_LEN];
+int16_t g_OverlayBuffer[MAX_GRAPH_TRACE_LEN];
 bool    g_useOverlays = false;
-size_t  g_GraphTraceLen;
 buffer_savestate_t g_saveState_gb;
 marker_t g_MarkerA, g_MarkerB, g_MarkerC, g_MarkerD;
 marker_t *g_TempMarkers;
@@ -76,9 +76,9 @@ void AppendGraph(bool redraw, uint16_t clock, int bit) {
 size_t ClearGraph(bool redraw) {
     size_t gtl = g_GraphTraceLen;
 
-    memset(g_GraphBuffer, 0x00, g_GraphTraceLen);
-    memset(g_OperationBuffer, 0x00, g_GraphTraceLen);
-    memset(g_OverlayBuffer, 0x00, g_GraphTraceLen);
+    memset(g_GraphBuffer, 0x00, g_GraphTraceLen * sizeof(int16_t));
+    memset(g_OperationBuffer, 0x00, g_GraphTraceLen * sizeof(int16_t));
+    memset(g_OverlayBuffer, 0x00, g_GraphTraceLen * sizeof(int16_t));
 
     g_GraphTraceLen = 0;
     g_GraphStart = 0;
@@ -110,16 +110,59 @@ void setGraphBuffer(const uint8_t *src, size_t size) {
         size = MAX_GRAPH_TRACE_LEN;
     }
 
-    for (size_t i = 0; i < size; ++i) {
-        g_GraphBuffer[i] = src[i] - 128;
-        g_OperationBuffer[i] = src[i] - 128;
-    }
+    dsp_from_bytes(src, g_GraphBuffer, size);
+    memcpy(g_OperationBuffer, g_GraphBuffer, size * sizeof(int16_t));
 
     remove_temporary_markers();
     g_GraphTraceLen = size;
     RepaintGraphWindow();
 }
 
+// saturate a 32 bit intermediate to the 16 bit graph storage
+int16_t clampGraphSample(int32_t value) {
+    if (value > GRAPH_SAMPLE_MAX) {
+        return GRAPH_SAMPLE_MAX;
+    }
+    if (value < GRAPH_SAMPLE_MIN) {
+        return GRAPH_SAMPLE_MIN;
+    }
+    return value;
+}
+
+// Filters whose intermediates outgrow 16 bits work on a widened copy of the graph
+// and hand it back with setGraphBufferS32. Caller frees the returned buffer.
+int32_t *getGraphBufferS32(size_t *len) {
+    int32_t *dest = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int32_t));
+    if (dest == NULL) {
+        PrintAndLogEx(DEBUG, "ERR: getGraphBufferS32, failed to allocate memory");
+        return NULL;
+    }
+
+    for (size_t i = 0; i < g_GraphTraceLen; ++i) {
+        dest[i] = g_GraphBuffer[i];
+    }
+
+    if (len) {
+        *len = g_GraphTraceLen;
+    }
+    return dest;
+}
+
+void setGraphBufferS32(const int32_t *src, size_t len) {
+    if (src == NULL) {
+        return;
+    }
+
+    if (len > MAX_GRAPH_TRACE_LEN) {
+        len = MAX_GRAPH_TRACE_LEN;
+    }
+
+    for (size_t i = 0; i < len; ++i) {
+        g_GraphBuffer[i] = clampGraphSample(src[i]);
+    }
+    g_GraphTraceLen = len;
+}
+
 // This function assumes that the length of dest array >= g_GraphTraceLen.
 // If the length of dest array is less than g_GraphTraceLen, use getFromGraphBufferEx(dest, maxLen) instead.
 size_t getFromGraphBuffer(uint8_t *dest) {
@@ -135,20 +178,10 @@ size_t getFromGraphBufferEx(uint8_t *dest, size_t maxLen) {
         return 0;
     }
 
-    size_t i;
     maxLen = (maxLen < g_GraphTraceLen) ? maxLen : g_GraphTraceLen;
-    for (i = 0; i < maxLen; ++i) {
-        //trim
-        if (g_GraphBuffer[i] > 127) {
-            g_GraphBuffer[i] = 127;
-        }
-
-        if (g_GraphBuffer[i] < -127) {
-            g_GraphBuffer[i] = -127;
-        }
-        dest[i] = (uint8_t)(g_GraphBuffer[i] + 128);
-    }
-    return i;
+    // trims the graph to +/-127 on the way
+    dsp_to_bytes(g_GraphBuffer, dest, maxLen);
+    return maxLen;
 }
 
 //TODO: In progress function to get chunks of data from the GB w/o modifying the GB
@@ -543,6 +576,28 @@ buffer_savestate_t save_bufferS32(int32_t *src, size_t length) {
     return bst;
 }
 
+buffer_savestate_t save_bufferS16(int16_t *src, size_t length) {
+    // two samples are packed into each 32-bit word of the backing buffer
+    size_t buffSize = (length / 2) + (length % 2);
+
+    // calloc the memory needed
+    uint32_t *savedBuffer = (uint32_t *)calloc(buffSize, sizeof(uint32_t));
+
+    // Pack the source array into the backing array
+    for (size_t i = 0; i < length; i++) {
+        savedBuffer[i / 2] |= (uint32_t)(uint16_t)src[i] << ((i & 1) * 16);
+    }
+
+    buffer_savestate_t bst = {
+        .type = sizeof(int16_t),
+        .bufferSize = buffSize,
+        .buffer = savedBuffer,
+        .padding = ((buffSize * 2) - length)
+    };
+
+    return bst;
+}
+
 buffer_savestate_t save_buffer8(uint8_t *src, size_t length) {
     // We are going to be packing the 8-bit source buffer into
     // the 32-bit backing buffer, so the input length is going to be
@@ -600,6 +655,23 @@ size_t restore_bufferS32(buffer_savestate_t saveState, int32_t *dest) {
     return saveState.bufferSize;
 }
 
+size_t restore_bufferS16(buffer_savestate_t saveState, int16_t *dest) {
+    if (saveState.type != sizeof(int16_t)) {
+        PrintAndLogEx(WARNING, "Invalid Save State type! Expected int16_t");
+        PrintAndLogEx(WARNING, "Buffer not modified!\n");
+        return 0;
+    }
+
+    size_t length = ((saveState.bufferSize * 2) - saveState.padding);
+
+    // Unpack the array
+    for (size_t i = 0; i < length; i++) {
+        dest[i] = (int16_t)(saveState.buffer[i / 2] >> ((i & 1) * 16));
+    }
+
+    return length;
+}
+
 size_t restore_buffer8(buffer_savestate_t saveState, uint8_t *dest) {
     if (saveState.type != sizeof(uint8_t)) {
         PrintAndLogEx(WARNING, "Invalid Save State type! Expected uint8_t!");
@@ -20,6 +20,7 @@
 #define GRAPH_H__
 
 #include "common.h"
+#include "lfdemodctx.h"     // g_GraphBuffer, g_GraphTraceLen
 
 #ifdef __cplusplus
 extern "C" {
@@ -50,6 +51,10 @@ void convertGraphFromBitstream(void);
 void convertGraphFromBitstreamEx(int hi, int low);
 bool isGraphBitstream(void);
 
+int16_t clampGraphSample(int32_t value);
+int32_t *getGraphBufferS32(size_t *len);
+void setGraphBufferS32(const int32_t *src, size_t len);
+
 int GetAskClock(const char *str, bool verbose);
 int GetPskClock(const char *str, bool verbose);
 int GetPskCarrier(bool verbose);
@@ -62,20 +67,19 @@ extern void remove_temporary_markers(void);
 
 buffer_savestate_t save_buffer32(uint32_t *src, size_t length);
 buffer_savestate_t save_bufferS32(int32_t *src, size_t length);
+buffer_savestate_t save_bufferS16(int16_t *src, size_t length);
 buffer_savestate_t save_buffer8(uint8_t *src, size_t length);
 size_t restore_buffer32(buffer_savestate_t saveState, uint32_t *dest);
 size_t restore_bufferS32(buffer_savestate_t saveState, int32_t *dest);
+size_t restore_bufferS16(buffer_savestate_t saveState, int16_t *dest);
 size_t restore_buffer8(buffer_savestate_t saveState, uint8_t *dest);
 
-#define MAX_GRAPH_TRACE_LEN (40000 * 32)
 #define GRAPH_SAVE 1
 #define GRAPH_RESTORE 0
 
-extern int32_t g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
-extern int32_t g_OperationBuffer[MAX_GRAPH_TRACE_LEN];
-extern int32_t g_OverlayBuffer[MAX_GRAPH_TRACE_LEN];
+extern int16_t g_OperationBuffer[MAX_GRAPH_TRACE_LEN];
+extern int16_t g_OverlayBuffer[MAX_GRAPH_TRACE_LEN];
 extern bool    g_useOverlays;
-extern size_t  g_GraphTraceLen;
 
 extern marker_t g_MarkerA, g_MarkerB, g_MarkerC, g_MarkerD;
 extern marker_t *g_TempMarkers;
@@ -0,0 +1,762 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Graph filter kernels and filter chains
+//
+// The kernels work on the 16 bit graph samples,  eight at a time with SSE2
+// or NEON where the filter allows it.  The recursive ones (iir, the spike
+// cleaning of cthreshold) stay scalar.
+//
+// A filter chain runs several graph commands over the samples in blocks of
+// DSP_BLOCK, so every block goes through all stages while it is in cache.
+// hpf and norm need the statistics of their whole input first,  those are
+// collected while the stage before them writes its output,  so each of them
+// costs one pass instead of the 3-4 the stand alone commands do.
+//-----------------------------------------------------------------------------
+
+#include "graphdsp.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ui.h"
+#include "commonutil.h"     // ARRAYLEN
+#include "lfdemod.h"        // SIGNAL_MIN_SAMPLES, signalOffsetFromHistogram
+
+#if defined(__SSE2__)
+# define DSP_SIMD_SSE2
+# include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+# define DSP_SIMD_NEON
+# include <arm_neon.h>
+#endif
+
+static int16_t dsp_sat16(int32_t v) {
+    if (v > INT16_MAX) return INT16_MAX;
+    if (v < INT16_MIN) return INT16_MIN;
+    return v;
+}
+
+static int16_t dsp_trim1(int16_t v) {
+    if (v > 127) return 127;
+    if (v < -127) return -127;
+    return v;
+}
+
+// trim samples to +/-127 in place and store them biased as bytes,  see getFromGraphBuffer
+void dsp_to_bytes(int16_t *samples, uint8_t *dest, size_t n) {
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    const __m128i lo = _mm_set1_epi16(-127);
+    const __m128i hi = _mm_set1_epi16(127);
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)(samples + i)), lo), hi);
+        __m128i b = _mm_min_epi16(_mm_max_epi16(_mm_loadu_si128((const __m128i *)(samples + i + 8)), lo), hi);
+        _mm_storeu_si128((__m128i *)(samples + i), a);
+        _mm_storeu_si128((__m128i *)(samples + i + 8), b);
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_xor_si128(_mm_packs_epi16(a, b), bias));
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int16x8_t lo = vdupq_n_s16(-127);
+    const int16x8_t hi = vdupq_n_s16(127);
+    const uint8x16_t bias = vdupq_n_u8(0x80);
+    for (; i + 16 <= n; i += 16) {
+        int16x8_t a = vminq_s16(vmaxq_s16(vld1q_s16(samples + i), lo), hi);
+        int16x8_t b = vminq_s16(vmaxq_s16(vld1q_s16(samples + i + 8), lo), hi);
+        vst1q_s16(samples + i, a);
+        vst1q_s16(samples + i + 8, b);
+        int8x16_t p = vcombine_s8(vqmovn_s16(a), vqmovn_s16(b));
+        vst1q_u8(dest + i, veorq_u8(vreinterpretq_u8_s8(p), bias));
+    }
+#endif
+    for (; i < n; i++) {
+        samples[i] = dsp_trim1(samples[i]);
+        dest[i] = (uint8_t)(samples[i] + 128);
+    }
+}
+
+// dest = src - 128,  see setGraphBuffer
+void dsp_from_bytes(const uint8_t *src, int16_t *dest, size_t n) {
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dest + i), _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias));
+        _mm_storeu_si128((__m128i *)(dest + i + 8), _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), bias));
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int16x8_t bias = vdupq_n_s16(128);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        vst1q_s16(dest + i, vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(v))), bias));
+        vst1q_s16(dest + i + 8, vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(v))), bias));
+    }
+#endif
+    for (; i < n; i++) {
+        dest[i] = src[i] - 128;
+    }
+}
+
+// clamp to +/-127,  what the commands get from their closing getFromGraphBuffer
+void dsp_trim(int16_t *samples, size_t n) {
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    const __m128i lo = _mm_set1_epi16(-127);
+    const __m128i hi = _mm_set1_epi16(127);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+        _mm_storeu_si128((__m128i *)(samples + i), _mm_min_epi16(_mm_max_epi16(v, lo), hi));
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int16x8_t lo = vdupq_n_s16(-127);
+    const int16x8_t hi = vdupq_n_s16(127);
+    for (; i + 8 <= n; i += 8) {
+        vst1q_s16(samples + i, vminq_s16(vmaxq_s16(vld1q_s16(samples + i), lo), hi));
+    }
+#endif
+    for (; i < n; i++) {
+        samples[i] = dsp_trim1(samples[i]);
+    }
+}
+
+void dsp_minmax(const int16_t *in, size_t n, int16_t *min, int16_t *max) {
+    int16_t lo = INT16_MAX, hi = INT16_MIN;
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    if (n >= 8) {
+        __m128i vlo = _mm_set1_epi16(INT16_MAX);
+        __m128i vhi = _mm_set1_epi16(INT16_MIN);
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+            vlo = _mm_min_epi16(vlo, v);
+            vhi = _mm_max_epi16(vhi, v);
+        }
+        vlo = _mm_min_epi16(vlo, _mm_shuffle_epi32(vlo, _MM_SHUFFLE(1, 0, 3, 2)));
+        vlo = _mm_min_epi16(vlo, _mm_shuffle_epi32(vlo, _MM_SHUFFLE(2, 3, 0, 1)));
+        vlo = _mm_min_epi16(vlo, _mm_srli_epi32(vlo, 16));
+        vhi = _mm_max_epi16(vhi, _mm_shuffle_epi32(vhi, _MM_SHUFFLE(1, 0, 3, 2)));
+        vhi = _mm_max_epi16(vhi, _mm_shuffle_epi32(vhi, _MM_SHUFFLE(2, 3, 0, 1)));
+        vhi = _mm_max_epi16(vhi, _mm_srli_epi32(vhi, 16));
+        lo = (int16_t)_mm_extract_epi16(vlo, 0);
+        hi = (int16_t)_mm_extract_epi16(vhi, 0);
+    }
+#elif defined(DSP_SIMD_NEON)
+    if (n >= 8) {
+        int16x8_t vlo = vdupq_n_s16(INT16_MAX);
+        int16x8_t vhi = vdupq_n_s16(INT16_MIN);
+        for (; i + 8 <= n; i += 8) {
+            int16x8_t v = vld1q_s16(in + i);
+            vlo = vminq_s16(vlo, v);
+            vhi = vmaxq_s16(vhi, v);
+        }
+        lo = vminvq_s16(vlo);
+        hi = vmaxvq_s16(vhi);
+    }
+#endif
+    for (; i < n; i++) {
+        if (in[i] < lo) lo = in[i];
+        if (in[i] > hi) hi = in[i];
+    }
+    *min = lo;
+    *max = hi;
+}
+
+// samples = (samples - mid) * 256 / range,  as data norm does it.
+// |samples - mid| * 256 stays below 2^24,  so the float quotient truncates
+// to the same integer as the integer division.
+void dsp_norm(int16_t *samples, size_t n, int32_t mid, int32_t range) {
+    if (range == 0) {
+        return;
+    }
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    const __m128i vmid = _mm_set1_epi32(mid);
+    const __m128 vrange = _mm_set1_ps((float)range);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        lo = _mm_slli_epi32(_mm_sub_epi32(lo, vmid), 8);
+        hi = _mm_slli_epi32(_mm_sub_epi32(hi, vmid), 8);
+        lo = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(lo), vrange));
+        hi = _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(hi), vrange));
+        _mm_storeu_si128((__m128i *)(samples + i), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int32x4_t vmid = vdupq_n_s32(mid);
+    const float32x4_t vrange = vdupq_n_f32((float)range);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(samples + i);
+        int32x4_t lo = vshlq_n_s32(vsubq_s32(vmovl_s16(vget_low_s16(v)), vmid), 8);
+        int32x4_t hi = vshlq_n_s32(vsubq_s32(vmovl_s16(vget_high_s16(v)), vmid), 8);
+        lo = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(lo), vrange));
+        hi = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(hi), vrange));
+        vst1q_s16(samples + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+    }
+#endif
+    for (; i < n; i++) {
+        samples[i] = dsp_sat16(((int32_t)(samples[i] - mid) * 256) / range);
+    }
+}
+
+// histogram of trimmed samples, biased to 0..255 like the byte samples
+static void dsp_histogram_add(uint32_t *hist, const int16_t *samples, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        hist[dsp_trim1(samples[i]) + 128]++;
+    }
+}
+
+// subtract the DC offset,  saturating to the byte range like removeSignalOffset
+static void dsp_offset(int16_t *samples, size_t n, int offset) {
+    if (offset == 0) {
+        return;
+    }
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    const __m128i off = _mm_set1_epi16(offset);
+    const __m128i lo = _mm_set1_epi16(-128);
+    const __m128i hi = _mm_set1_epi16(127);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(samples + i)), off);
+        _mm_storeu_si128((__m128i *)(samples + i), _mm_min_epi16(_mm_max_epi16(v, lo), hi));
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int16x8_t off = vdupq_n_s16(offset);
+    const int16x8_t lo = vdupq_n_s16(-128);
+    const int16x8_t hi = vdupq_n_s16(127);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vsubq_s16(vld1q_s16(samples + i), off);
+        vst1q_s16(samples + i, vminq_s16(vmaxq_s16(v, lo), hi));
+    }
+#endif
+    for (; i < n; i++) {
+        int v = samples[i] - offset;
+        samples[i] = (v > 127) ? 127 : (v < -128) ? -128 : v;
+    }
+}
+
+// data hpf on 16 bit samples: trim, then remove the offset removeSignalOffset finds
+void dsp_hpf(int16_t *samples, size_t n) {
+    dsp_trim(samples, n);
+    if (n < SIGNAL_MIN_SAMPLES) {
+        return;
+    }
+    uint32_t hist[256] = {0};
+    dsp_histogram_add(hist, samples + SIGNAL_IGNORE_FIRST_SAMPLES, n - SIGNAL_IGNORE_FIRST_SAMPLES);
+    dsp_offset(samples, n, signalOffsetFromHistogram(hist, n - SIGNAL_IGNORE_FIRST_SAMPLES));
+}
+
+// first order low pass,  each output depends on the previous one so this one stays scalar
+// ref: http://www.edn.com/design/systems-design/4320010/A-simple-software-lowpass-filter-suits-embedded-system-applications
+void dsp_lowpass(int16_t *samples, size_t n, uint8_t shift, int32_t *reg) {
+    int32_t filter_reg = *reg;
+    for (size_t i = 0; i < n; ++i) {
+        // Update filter with current sample
+        filter_reg = filter_reg - (filter_reg >> shift) + samples[i];
+        // Scale output for unity gain
+        samples[i] = filter_reg >> shift;
+    }
+    *reg = filter_reg;
+}
+
+// keep in[0], in[factor], in[2 * factor] ... below n.  out may alias in as long as out <= in
+size_t dsp_decimate(const int16_t *in, int16_t *out, size_t n, size_t factor) {
+    if (factor == 0 || n == 0) {
+        return 0;
+    }
+    if (factor == 1) {
+        memmove(out, in, n * sizeof(int16_t));
+        return n;
+    }
+
+    size_t j = 0;
+    if (factor == 2) {
+#if defined(DSP_SIMD_SSE2)
+        for (; (j * 2) + 16 <= n; j += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(in + (j * 2)));
+            __m128i b = _mm_loadu_si128((const __m128i *)(in + (j * 2) + 8));
+            a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+            b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+            _mm_storeu_si128((__m128i *)(out + j), _mm_packs_epi32(a, b));
+        }
+#elif defined(DSP_SIMD_NEON)
+        for (; (j * 2) + 16 <= n; j += 8) {
+            int16x8x2_t v = vld2q_s16(in + (j * 2));
+            vst1q_s16(out + j, v.val[0]);
+        }
+#endif
+    }
+    for (; j * factor < n; j++) {
+        out[j] = in[j * factor];
+    }
+    return j;
+}
+
+// data dirthreshold.  Rising samples above up give 1,  falling ones below down give -1,
+// the rest repeat the previous output.  The first output is aligned with the second.
+void dsp_dirthreshold(const int16_t *in, int16_t *out, size_t n, int8_t up, int8_t down, dsp_dirthreshold_t *state) {
+    size_t i = 0;
+    bool first = (state->started == false);
+    if (first) {
+        if (n == 0) {
+            return;
+        }
+        state->prev = in[0];
+        state->last = 0;
+        state->started = true;
+        i = 1;
+    }
+
+    int16_t prev = state->prev;
+    int16_t last = state->last;
+
+#if defined(DSP_SIMD_SSE2)
+    const __m128i vup = _mm_set1_epi16(up - 1);
+    const __m128i vdown = _mm_set1_epi16(down + 1);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        // previous samples,  lane 0 gets the one carried over
+        __m128i p = _mm_insert_epi16(_mm_slli_si128(v, 2), prev, 0);
+        prev = in[i + 7];
+
+        __m128i rise = _mm_and_si128(_mm_cmpgt_epi16(v, vup), _mm_cmpgt_epi16(v, p));
+        __m128i fall = _mm_andnot_si128(rise, _mm_and_si128(_mm_cmplt_epi16(v, vdown), _mm_cmplt_epi16(v, p)));
+        // 1, -1 or 0 for hold
+        __m128i c = _mm_or_si128(_mm_and_si128(rise, one), fall);
+
+        // fill the holds with the last decision to their left
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi16(c, zero), _mm_slli_si128(c, 2)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi16(c, zero), _mm_slli_si128(c, 4)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi16(c, zero), _mm_slli_si128(c, 8)));
+        c = _mm_or_si128(c, _mm_and_si128(_mm_cmpeq_epi16(c, zero), _mm_set1_epi16(last)));
+
+        _mm_storeu_si128((__m128i *)(out + i), c);
+        last = (int16_t)_mm_extract_epi16(c, 7);
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int16x8_t vup = vdupq_n_s16(up);
+    const int16x8_t vdown = vdupq_n_s16(down);
+    const int16x8_t one = vdupq_n_s16(1);
+    const int16x8_t zero = vdupq_n_s16(0);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(in + i);
+        int16x8_t p = vextq_s16(vdupq_n_s16(prev), v, 7);
+        prev = in[i + 7];
+
+        uint16x8_t rise = vandq_u16(vcgeq_s16(v, vup), vcgtq_s16(v, p));
+        uint16x8_t fall = vbicq_u16(vandq_u16(vcleq_s16(v, vdown), vcltq_s16(v, p)), rise);
+        int16x8_t c = vorrq_s16(vandq_s16(vreinterpretq_s16_u16(rise), one), vreinterpretq_s16_u16(fall));
+
+        c = vbslq_s16(vceqq_s16(c, zero), vextq_s16(zero, c, 7), c);
+        c = vbslq_s16(vceqq_s16(c, zero), vextq_s16(zero, c, 6), c);
+        c = vbslq_s16(vceqq_s16(c, zero), vextq_s16(zero, c, 4), c);
+        c = vbslq_s16(vceqq_s16(c, zero), vdupq_n_s16(last), c);
+
+        vst1q_s16(out + i, c);
+        last = vgetq_lane_s16(c, 7);
+    }
+#endif
+    for (; i < n; i++) {
+        int16_t v = in[i];
+        if (v >= up && v > prev) {
+            last = 1;
+        } else if (v <= down && v < prev) {
+            last = -1;
+        }
+        prev = v;
+        out[i] = last;
+    }
+
+    state->prev = prev;
+    state->last = last;
+
+    if (first) {
+        out[0] = (n > 1) ? out[1] : 0;
+    }
+}
+
+// data cthreshold.  Zero everything between down and up,  then clear the spikes
+// left between two zero sum pairs.  Needs n >= 5.
+void dsp_cthreshold(const int16_t *in, int16_t *out, size_t n, int8_t up, int8_t down) {
+    if (n < 5) {
+        return;
+    }
+
+    size_t i = 0;
+#if defined(DSP_SIMD_SSE2)
+    const __m128i vup = _mm_set1_epi16(up);
+    const __m128i vdown = _mm_set1_epi16(down);
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi16(v, vup), _mm_cmplt_epi16(v, vdown));
+        __m128i o = _mm_loadu_si128((const __m128i *)(out + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_and_si128(o, outside));
+    }
+#elif defined(DSP_SIMD_NEON)
+    const int16x8_t vup = vdupq_n_s16(up);
+    const int16x8_t vdown = vdupq_n_s16(down);
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t v = vld1q_s16(in + i);
+        uint16x8_t outside = vorrq_u16(vcgtq_s16(v, vup), vcltq_s16(v, vdown));
+        vst1q_s16(out + i, vandq_s16(vld1q_s16(out + i), vreinterpretq_s16_u16(outside)));
+    }
+#endif
+    for (; i < n; ++i) {
+        if ((in[i] <= up) && (in[i] >= down)) {
+            out[i] = 0;
+        }
+    }
+
+    // clean out spikes,  uses the outputs already cleaned to the left
+    for (i = 2; i < n - 2; ++i) {
+        int a = out[i - 2] + out[i - 1];
+        int b = out[i + 2] + out[i + 1];
+        if (a == 0 && b == 0) {
+            out[i] = 0;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// filter chains
+//-----------------------------------------------------------------------------
+
+static const struct {
+    dsp_op_t op;
+    const char *name;
+    uint8_t args;       // number of mandatory arguments
+    uint8_t max_args;
+} dsp_ops[] = {
+    {DSP_HPF,          "hpf",          0, 0},
+    {DSP_NORM,         "norm",         0, 0},
+    {DSP_IIR,          "iir",          1, 1},
+    {DSP_DECIMATE,     "decimate",     0, 1},
+    {DSP_DIRTHRESHOLD, "dirthreshold", 2, 2},
+    {DSP_CTHRESHOLD,   "cthreshold",   2, 2},
+};
+
+const char *dsp_stage_name(dsp_op_t op) {
+    for (size_t i = 0; i < ARRAYLEN(dsp_ops); i++) {
+        if (dsp_ops[i].op == op) {
+            return dsp_ops[i].name;
+        }
+    }
+    return "?";
+}
+
+/**
+ * @brief Parse a filter chain like "hpf,iir:4,decimate:2,norm,dirthreshold:10:-10"
+ *
+ * @param str chain, stages separated by commas, arguments by colons
+ * @param stages at least DSP_MAX_STAGES entries
+ * @param count number of stages found
+ * @return PM3_SUCCESS or PM3_EINVARG
+ */
+int dsp_chain_parse(const char *str, dsp_stage_t *stages, size_t *count) {
+    *count = 0;
+    const char *p = str;
+
+    while (*p) {
+        while (*p == ',' || isspace((unsigned char)*p)) p++;
+        if (*p == '\0') break;
+
+        char token[40] = {0};
+        size_t tl = 0;
+        while (*p && *p != ',' && isspace((unsigned char)*p) == 0) {
+            if (tl < sizeof(token) - 1) token[tl++] = *p;
+            p++;
+        }
+
+        char *args = strchr(token, ':');
+        if (args) {
+            *args++ = '\0';
+        }
+
+        size_t op = 0;
+        for (; op < ARRAYLEN(dsp_ops); op++) {
+            if (strcmp(token, dsp_ops[op].name) == 0) break;
+        }
+        if (op == ARRAYLEN(dsp_ops)) {
+            PrintAndLogEx(ERR, "unknown filter stage " _YELLOW_("%s"), token);
+            return PM3_EINVARG;
+        }
+
+        if (*count == DSP_MAX_STAGES) {
+            PrintAndLogEx(ERR, "too many filter stages, max %u", DSP_MAX_STAGES);
+            return PM3_EINVARG;
+        }
+
+        dsp_stage_t *s = &stages[*count];
+        s->op = dsp_ops[op].op;
+        s->a = (s->op == DSP_DECIMATE) ? 2 : 0;
+        s->b = 0;
+
+        int vals[2] = {0};
+        uint8_t nargs = 0;
+        while (args && *args) {
+            char *end = NULL;
+            long v = strtol(args, &end, 10);
+            if (end == args || (*end != ':' && *end != '\0') || nargs == dsp_ops[op].max_args) {
+                PrintAndLogEx(ERR, "bad arguments for filter stage " _YELLOW_("%s"), token);
+                return PM3_EINVARG;
+            }
+            vals[nargs++] = v;
+            args = (*end == ':') ? end + 1 : end;
+        }
+        if (nargs < dsp_ops[op].args) {
+            PrintAndLogEx(ERR, "filter stage " _YELLOW_("%s") " needs %u argument(s)", token, dsp_ops[op].args);
+            return PM3_EINVARG;
+        }
+        if (nargs > 0) s->a = vals[0];
+        if (nargs > 1) s->b = vals[1];
+
+        switch (s->op) {
+            case DSP_IIR:
+                if (s->a < 0 || s->a > 255) {
+                    PrintAndLogEx(ERR, "iir factor must be 0 - 255");
+                    return PM3_EINVARG;
+                }
+                break;
+            case DSP_DECIMATE:
+                if (s->a < 1) {
+                    PrintAndLogEx(ERR, "decimate factor must be 1 or more");
+                    return PM3_EINVARG;
+                }
+                break;
+            case DSP_DIRTHRESHOLD:
+            case DSP_CTHRESHOLD:
+                if (s->a < INT8_MIN || s->a > INT8_MAX || s->b < INT8_MIN || s->b > INT8_MAX) {
+                    PrintAndLogEx(ERR, "thresholds must be -128 - 127");
+                    return PM3_EINVARG;
+                }
+                break;
+            case DSP_HPF:
+            case DSP_NORM:
+                break;
+        }
+        (*count)++;
+    }
+
+    if (*count == 0) {
+        PrintAndLogEx(ERR, "empty filter chain");
+        return PM3_EINVARG;
+    }
+    return PM3_SUCCESS;
+}
+
+// whole input statistics hpf and norm need before their first block
+typedef struct {
+    uint32_t hist[256];
+    int16_t min;
+    int16_t max;
+} dsp_stats_t;
+
+static void dsp_stats_reset(dsp_stats_t *st) {
+    memset(st->hist, 0, sizeof(st->hist));
+    st->min = INT16_MAX;
+    st->max = INT16_MIN;
+}
+
+// block of samples at position pos,  the first SIGNAL_IGNORE_FIRST_SAMPLES don't count
+static void dsp_stats_add(dsp_stats_t *st, dsp_op_t op, const int16_t *samples, size_t n, size_t pos) {
+    if (pos + n <= SIGNAL_IGNORE_FIRST_SAMPLES) {
+        return;
+    }
+    if (pos < SIGNAL_IGNORE_FIRST_SAMPLES) {
+        samples += SIGNAL_IGNORE_FIRST_SAMPLES - pos;
+        n -= SIGNAL_IGNORE_FIRST_SAMPLES - pos;
+    }
+
+    if (op == DSP_HPF) {
+        dsp_histogram_add(st->hist, samples, n);
+    } else if (op == DSP_NORM) {
+        int16_t lo, hi;
+        dsp_minmax(samples, n, &lo, &hi);
+        if (lo < st->min) st->min = lo;
+        if (hi > st->max) st->max = hi;
+    }
+}
+
+typedef struct {
+    size_t in_len;      // input samples of the stage
+    size_t seen;        // input samples consumed so far
+    bool active;        // hpf / norm have something to do
+    int offset;         // hpf
+    int32_t mid;        // norm
+    int32_t range;
+    int32_t reg;        // iir
+    dsp_dirthreshold_t dt;
+} dsp_stage_state_t;
+
+static size_t dsp_stage_block(const dsp_stage_t *s, dsp_stage_state_t *rt, int16_t *blk, size_t m) {
+    switch (s->op) {
+        case DSP_HPF:
+            dsp_trim(blk, m);
+            if (rt->active) {
+                dsp_offset(blk, m, rt->offset);
+            }
+            break;
+        case DSP_NORM:
+            if (rt->active) {
+                dsp_norm(blk, m, rt->mid, rt->range);
+            }
+            dsp_trim(blk, m);
+            break;
+        case DSP_IIR: {
+            // same shift as iceSimple_Filter
+            uint8_t shift = (s->a <= 8) ? s->a : 4;
+            dsp_lowpass(blk, m, shift, &rt->reg);
+            dsp_trim(blk, m);
+            break;
+        }
+        case DSP_DECIMATE: {
+            // keep the samples data decimate keeps,  counted from the start of the stage input
+            size_t f = s->a;
+            size_t g0 = rt->seen;
+            size_t stop = (rt->in_len / f) * f;
+            size_t first = (f - (g0 % f)) % f;
+            size_t end = (stop > g0) ? MIN(m, stop - g0) : 0;
+            rt->seen += m;
+            m = (first < end) ? dsp_decimate(blk + first, blk, end - first, f) : 0;
+            break;
+        }
+        case DSP_DIRTHRESHOLD:
+            dsp_dirthreshold(blk, blk, m, s->a, s->b, &rt->dt);
+            break;
+        case DSP_CTHRESHOLD:
+            break;
+    }
+    return m;
+}
+
+static bool dsp_needs_stats(dsp_op_t op) {
+    return (op == DSP_HPF || op == DSP_NORM);
+}
+
+static void dsp_stage_prepare(const dsp_stage_t *s, dsp_stage_state_t *rt, const dsp_stats_t *st) {
+    if (s->op == DSP_HPF) {
+        rt->active = (rt->in_len >= SIGNAL_MIN_SAMPLES);
+        if (rt->active) {
+            rt->offset = signalOffsetFromHistogram(st->hist, rt->in_len - SIGNAL_IGNORE_FIRST_SAMPLES);
+        }
+    } else if (s->op == DSP_NORM) {
+        rt->active = (rt->in_len > SIGNAL_IGNORE_FIRST_SAMPLES) && (st->max != st->min);
+        rt->mid = (st->max + st->min) / 2;
+        rt->range = st->max - st->min;
+    }
+}
+
+/**
+ * @brief Run a filter chain over samples in place
+ *
+ * The output equals running the graph commands one after another.
+ *
+ * @param samples graph samples
+ * @param len number of samples, updated when the chain decimates
+ * @param stages parsed chain
+ * @param count number of stages
+ * @return PM3_SUCCESS or PM3_EMALLOC
+ */
+int dsp_chain_run(int16_t *samples, size_t *len, const dsp_stage_t *stages, size_t count) {
+    size_t n = *len;
+    dsp_stats_t *stats = calloc(1, sizeof(dsp_stats_t));
+    if (stats == NULL) {
+        return PM3_EMALLOC;
+    }
+    bool have_stats = false;
+
+    size_t s = 0;
+    while (s < count && n > 0) {
+
+        if (dsp_needs_stats(stages[s].op) && have_stats == false) {
+            dsp_stats_reset(stats);
+            dsp_stats_add(stats, stages[s].op, samples, n, 0);
+        }
+        have_stats = false;
+
+        if (stages[s].op == DSP_CTHRESHOLD) {
+            // the spike cleaning looks both ways,  runs over the whole buffer
+            dsp_cthreshold(samples, samples, n, stages[s].a, stages[s].b);
+            dsp_trim(samples, n);
+            s++;
+            continue;
+        }
+
+        // stages run block by block up to the next one which needs statistics
+        size_t e = s + 1;
+        while (e < count && dsp_needs_stats(stages[e].op) == false && stages[e].op != DSP_CTHRESHOLD) {
+            e++;
+        }
+
+        dsp_stage_state_t rt[DSP_MAX_STAGES];
+        memset(rt, 0, sizeof(rt));
+
+        // each decimate shrinks the blocks,  keep at least two samples per block for dirthreshold
+        size_t cur = n, prod = 1;
+        for (size_t k = s; k < e; k++) {
+            rt[k - s].in_len = cur;
+            if (stages[k].op == DSP_DECIMATE) {
+                cur /= stages[k].a;
+                prod = ((size_t)stages[k].a >= n / prod) ? n : prod * stages[k].a;
+            }
+        }
+        dsp_stage_prepare(&stages[s], &rt[0], stats);
+
+        size_t block = MIN(MAX((size_t)DSP_BLOCK, 2 * prod), n);
+        int16_t *blk = calloc(block, sizeof(int16_t));
+        if (blk == NULL) {
+            free(stats);
+            return PM3_EMALLOC;
+        }
+
+        dsp_op_t next = (e < count) ? stages[e].op : DSP_CTHRESHOLD;
+        if (dsp_needs_stats(next)) {
+            dsp_stats_reset(stats);
+            have_stats = true;
+        }
+
+        size_t rpos = 0, wpos = 0;
+        while (rpos < n) {
+            size_t m = MIN(block, n - rpos);
+            memcpy(blk, samples + rpos, m * sizeof(int16_t));
+            rpos += m;
+
+            for (size_t k = s; k < e && m; k++) {
+                m = dsp_stage_block(&stages[k], &rt[k - s], blk, m);
+            }
+
+            if (have_stats) {
+                dsp_stats_add(stats, next, blk, m, wpos);
+            }
+
+            // output never outruns the input read so far
+            memcpy(samples + wpos, blk, m * sizeof(int16_t));
+            wpos += m;
+        }
+        free(blk);
+
+        n = wpos;
+        s = e;
+    }
+
+    free(stats);
+    *len = n;
+    return PM3_SUCCESS;
+}
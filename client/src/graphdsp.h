@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Graph filter kernels and filter chains
+//-----------------------------------------------------------------------------
+
+#ifndef GRAPHDSP_H__
+#define GRAPHDSP_H__
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// samples per block a filter chain runs through all its stages while in L1
+#define DSP_BLOCK           4096
+#define DSP_MAX_STAGES      16
+
+typedef enum {
+    DSP_HPF = 0,
+    DSP_NORM,
+    DSP_IIR,
+    DSP_DECIMATE,
+    DSP_DIRTHRESHOLD,
+    DSP_CTHRESHOLD,
+} dsp_op_t;
+
+typedef struct {
+    dsp_op_t op;
+    int a;              // iir k,  decimate n,  threshold up
+    int b;              // threshold down
+} dsp_stage_t;
+
+// directional threshold state carried from one block to the next
+typedef struct {
+    bool started;
+    int16_t prev;       // last input sample
+    int16_t last;       // last output sample
+} dsp_dirthreshold_t;
+
+void dsp_to_bytes(int16_t *samples, uint8_t *dest, size_t n);
+void dsp_from_bytes(const uint8_t *src, int16_t *dest, size_t n);
+void dsp_trim(int16_t *samples, size_t n);
+
+void dsp_minmax(const int16_t *in, size_t n, int16_t *min, int16_t *max);
+void dsp_norm(int16_t *samples, size_t n, int32_t mid, int32_t range);
+void dsp_hpf(int16_t *samples, size_t n);
+void dsp_lowpass(int16_t *samples, size_t n, uint8_t shift, int32_t *reg);
+size_t dsp_decimate(const int16_t *in, int16_t *out, size_t n, size_t factor);
+void dsp_dirthreshold(const int16_t *in, int16_t *out, size_t n, int8_t up, int8_t down, dsp_dirthreshold_t *state);
+void dsp_cthreshold(const int16_t *in, int16_t *out, size_t n, int8_t up, int8_t down);
+
+const char *dsp_stage_name(dsp_op_t op);
+int dsp_chain_parse(const char *str, dsp_stage_t *stages, size_t *count);
+int dsp_chain_run(int16_t *samples, size_t *len, const dsp_stage_t *stages, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,231 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Min/max pyramid of the graph samples for level of detail plotting
+//
+// The plot asks for min / max / sum of the samples behind every pixel
+// column.  With the pyramid that costs O(log n) per column instead of
+// touching every sample,  so zoomed out repaints of long captures are cheap.
+//
+// graphmip_sync() compares the buffer with the copy the pyramid was built
+// from and only rebuilds the blocks between the first and the last changed
+// sample.  No caller has to report its writes to the graph buffer.
+//-----------------------------------------------------------------------------
+
+#include "graphmip.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAPHMIP_CMP_CHUNK  256
+
+static size_t graphmip_block(uint8_t level) {
+    return (size_t)1 << (GRAPHMIP_BASE_SHIFT + (level * GRAPHMIP_LEVEL_SHIFT));
+}
+
+void graphmip_free(graphmip_t *m) {
+    free(m->samples);
+    for (uint8_t k = 0; k < GRAPHMIP_MAX_LEVELS; k++) {
+        free(m->min[k]);
+        free(m->max[k]);
+        free(m->sum[k]);
+    }
+    memset(m, 0, sizeof(graphmip_t));
+}
+
+static bool graphmip_alloc(graphmip_t *m, size_t cap) {
+    graphmip_free(m);
+
+    m->samples = calloc(cap, sizeof(int16_t));
+    if (m->samples == NULL) {
+        return false;
+    }
+    m->cap = cap;
+
+    size_t n = (cap + graphmip_block(0) - 1) >> GRAPHMIP_BASE_SHIFT;
+    for (uint8_t k = 0; k < GRAPHMIP_MAX_LEVELS; k++) {
+        m->min[k] = calloc(n, sizeof(int16_t));
+        m->max[k] = calloc(n, sizeof(int16_t));
+        m->sum[k] = calloc(n, sizeof(int64_t));
+        if (m->min[k] == NULL || m->max[k] == NULL || m->sum[k] == NULL) {
+            graphmip_free(m);
+            return false;
+        }
+        if (n == 1) {
+            break;
+        }
+        n = (n + (1 << GRAPHMIP_LEVEL_SHIFT) - 1) >> GRAPHMIP_LEVEL_SHIFT;
+    }
+    return true;
+}
+
+// first index in [from, to) where a and b differ, or to
+static size_t graphmip_first_diff(const int16_t *a, const int16_t *b, size_t from, size_t to) {
+    size_t i = from;
+    while (i < to) {
+        size_t n = MIN(GRAPHMIP_CMP_CHUNK, to - i);
+        if (memcmp(a + i, b + i, n * sizeof(int16_t)) != 0) {
+            while (a[i] == b[i]) i++;
+            return i;
+        }
+        i += n;
+    }
+    return to;
+}
+
+// one past the last index in [from, to) where a and b differ, or from
+static size_t graphmip_last_diff(const int16_t *a, const int16_t *b, size_t from, size_t to) {
+    size_t i = to;
+    while (i > from) {
+        size_t n = MIN(GRAPHMIP_CMP_CHUNK, i - from);
+        if (memcmp(a + i - n, b + i - n, n * sizeof(int16_t)) != 0) {
+            while (a[i - 1] == b[i - 1]) i--;
+            return i;
+        }
+        i -= n;
+    }
+    return from;
+}
+
+/**
+ * @brief Bring the pyramid up to date with buffer
+ *
+ * @param buffer graph samples
+ * @param len number of samples
+ * @return false if memory ran out, the pyramid is empty then
+ */
+bool graphmip_sync(graphmip_t *m, const int16_t *buffer, size_t len) {
+
+    if (len > m->cap) {
+        // leave room so a growing capture doesn't reallocate on every repaint
+        if (graphmip_alloc(m, MAX(len, m->cap * 2)) == false) {
+            return false;
+        }
+    }
+
+    // changed range of samples
+    size_t common = MIN(len, m->len);
+    size_t lo = graphmip_first_diff(buffer, m->samples, 0, common);
+    size_t hi = (len != m->len) ? len : graphmip_last_diff(buffer, m->samples, lo, common);
+    bool resized = (len != m->len);
+
+    if (lo >= hi && resized == false) {
+        return true;
+    }
+
+    if (hi > lo) {
+        memcpy(m->samples + lo, buffer + lo, (hi - lo) * sizeof(int16_t));
+    }
+
+    m->len = len;
+    m->levels = 0;
+    if (len == 0) {
+        return true;
+    }
+
+    // level 0 straight from the samples
+    size_t n = (len + graphmip_block(0) - 1) >> GRAPHMIP_BASE_SHIFT;
+    size_t blo = lo >> GRAPHMIP_BASE_SHIFT;
+    size_t bhi = (hi + graphmip_block(0) - 1) >> GRAPHMIP_BASE_SHIFT;
+    if (resized) {
+        blo = MIN(blo, n - 1);
+        bhi = n;
+    }
+    for (size_t b = blo; b < bhi; b++) {
+        size_t s = b << GRAPHMIP_BASE_SHIFT;
+        size_t e = MIN(s + graphmip_block(0), len);
+        int16_t vmin = m->samples[s], vmax = m->samples[s];
+        int64_t vsum = 0;
+        for (size_t i = s; i < e; i++) {
+            int16_t v = m->samples[i];
+            if (v < vmin) vmin = v;
+            if (v > vmax) vmax = v;
+            vsum += v;
+        }
+        m->min[0][b] = vmin;
+        m->max[0][b] = vmax;
+        m->sum[0][b] = vsum;
+    }
+    m->count[0] = n;
+    m->levels = 1;
+
+    // fold the changed blocks into the levels above
+    for (uint8_t k = 1; k < GRAPHMIP_MAX_LEVELS && m->count[k - 1] > 1; k++) {
+        size_t below = m->count[k - 1];
+        n = (below + (1 << GRAPHMIP_LEVEL_SHIFT) - 1) >> GRAPHMIP_LEVEL_SHIFT;
+        blo >>= GRAPHMIP_LEVEL_SHIFT;
+        bhi = (bhi + (1 << GRAPHMIP_LEVEL_SHIFT) - 1) >> GRAPHMIP_LEVEL_SHIFT;
+        if (resized) {
+            blo = MIN(blo, n - 1);
+            bhi = n;
+        }
+        for (size_t b = blo; b < bhi; b++) {
+            size_t s = b << GRAPHMIP_LEVEL_SHIFT;
+            size_t e = MIN(s + (1 << GRAPHMIP_LEVEL_SHIFT), below);
+            int16_t vmin = m->min[k - 1][s], vmax = m->max[k - 1][s];
+            int64_t vsum = 0;
+            for (size_t i = s; i < e; i++) {
+                if (m->min[k - 1][i] < vmin) vmin = m->min[k - 1][i];
+                if (m->max[k - 1][i] > vmax) vmax = m->max[k - 1][i];
+                vsum += m->sum[k - 1][i];
+            }
+            m->min[k][b] = vmin;
+            m->max[k][b] = vmax;
+            m->sum[k][b] = vsum;
+        }
+        m->count[k] = n;
+        m->levels = k + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Min, max and sum of the samples [from, to)
+ *
+ * Whole blocks are taken from the largest level they line up with,  only the
+ * ragged ends are read sample by sample.
+ */
+void graphmip_range(const graphmip_t *m, size_t from, size_t to, int16_t *min, int16_t *max, int64_t *sum) {
+    int16_t vmin = INT16_MAX, vmax = INT16_MIN;
+    int64_t vsum = 0;
+
+    to = MIN(to, m->len);
+    size_t i = from;
+    while (i < to) {
+
+        int8_t k = m->levels - 1;
+        while (k >= 0 && ((i & (graphmip_block(k) - 1)) != 0 || i + graphmip_block(k) > to)) {
+            k--;
+        }
+
+        if (k < 0) {
+            int16_t v = m->samples[i++];
+            if (v < vmin) vmin = v;
+            if (v > vmax) vmax = v;
+            vsum += v;
+            continue;
+        }
+
+        size_t b = i >> (GRAPHMIP_BASE_SHIFT + (k * GRAPHMIP_LEVEL_SHIFT));
+        if (m->min[k][b] < vmin) vmin = m->min[k][b];
+        if (m->max[k][b] > vmax) vmax = m->max[k][b];
+        vsum += m->sum[k][b];
+        i += graphmip_block(k);
+    }
+
+    if (min) *min = vmin;
+    if (max) *max = vmax;
+    if (sum) *sum = vsum;
+}
@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Min/max pyramid of the graph samples for level of detail plotting
+//-----------------------------------------------------------------------------
+
+#ifndef GRAPHMIP_H__
+#define GRAPHMIP_H__
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// level 0 blocks cover 16 samples, every level above covers 4 blocks of the one below
+#define GRAPHMIP_BASE_SHIFT     4
+#define GRAPHMIP_LEVEL_SHIFT    2
+#define GRAPHMIP_MAX_LEVELS     16
+
+typedef struct {
+    int16_t *samples;       // copy of the buffer the pyramid was built from
+    size_t len;
+    size_t cap;
+    uint8_t levels;
+    size_t count[GRAPHMIP_MAX_LEVELS];
+    int16_t *min[GRAPHMIP_MAX_LEVELS];
+    int16_t *max[GRAPHMIP_MAX_LEVELS];
+    int64_t *sum[GRAPHMIP_MAX_LEVELS];
+} graphmip_t;
+
+void graphmip_free(graphmip_t *m);
+bool graphmip_sync(graphmip_t *m, const int16_t *buffer, size_t len);
+void graphmip_range(const graphmip_t *m, size_t from, size_t to, int16_t *min, int16_t *max, int64_t *sum);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,403 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hardnested brute force on an OpenCL device
+//
+// Every work item takes one odd and one even half state of a bucket and runs
+// the same test as the bitsliced CPU core: decrypt the 2nd to 4th byte of the
+// test nonces and compare the parity bits.  The few survivors go back to the
+// host, which checks them against all nonces with verify_key().
+//-----------------------------------------------------------------------------
+
+#include "hardnested_opencl.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "commonutil.h"     // ARRAYLEN
+#include "ui.h"             // PrintAndLogEx
+#include "crapto1/crapto1.h"
+
+#ifdef HAVE_OPENCL
+
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/cl.h>
+#endif
+
+// work items per kernel launch, keeps a single launch well below display watchdogs
+#define HARDNESTED_OPENCL_BATCH     (1 << 24)
+#define HARDNESTED_OPENCL_MAX_HITS  (1 << 16)
+#define HARDNESTED_OPENCL_MAX_TESTS 256
+
+static const char *hardnested_opencl_src =
+    "#define LF_POLY_ODD  (0x29CE5C)\n"
+    "#define LF_POLY_EVEN (0x870804)\n"
+    "\n"
+    "inline uint filter(uint x) {\n"
+    "    uint f;\n"
+    "    f  = 0xf22c0 >> (x       & 0xf) & 16;\n"
+    "    f |= 0x6c9c0 >> (x >>  4 & 0xf) &  8;\n"
+    "    f |= 0x3c8b0 >> (x >>  8 & 0xf) &  4;\n"
+    "    f |= 0x1e458 >> (x >> 12 & 0xf) &  2;\n"
+    "    f |= 0x0d938 >> (x >> 16 & 0xf) &  1;\n"
+    "    return (0xEC57E80A >> f) & 1;\n"
+    "}\n"
+    "\n"
+    // tests: encrypted 2nd..4th nonce byte in bits 0..23,  their encrypted parity bits in 24..26
+    "__kernel void hardnested_crack(__global const uint *even, const uint even_len,\n"
+    "                               __global const uint *odd, const uint odd_base,\n"
+    "                               __constant uint *tests, const uint test_count,\n"
+    "                               __global uint *hits, volatile __global uint *hit_count, const uint max_hits) {\n"
+    "    const uint e_idx = get_global_id(0);\n"
+    "    if (e_idx >= even_len)\n"
+    "        return;\n"
+    "    const uint o_idx = odd_base + get_global_id(1);\n"
+    "    const uint even_state = even[e_idx];\n"
+    "    const uint odd_state = odd[o_idx];\n"
+    "\n"
+    "    for (uint t = 0; t < test_count; t++) {\n"
+    "        const uint test = tests[t];\n"
+    "        uint o = odd_state, e = even_state;\n"
+    "        for (int byte = 2; byte >= 0; byte--) {\n"
+    "            const uint enc = test >> (8 * byte);\n"
+    "            uint par = 0;\n"
+    "            for (int i = 0; i < 8; i++) {\n"
+    "                const uint dec = ((enc >> i) ^ filter(o)) & 1;\n"
+    "                par ^= dec;\n"
+    "                const uint fb = dec ^ (popcount((o & LF_POLY_ODD) ^ (e & LF_POLY_EVEN)) & 1);\n"
+    "                const uint n = (e << 1) | fb;\n"
+    "                e = o;\n"
+    "                o = n;\n"
+    "            }\n"
+    "            if (((test >> (24 + byte)) ^ filter(o) ^ par) & 1)\n"
+    "                return;\n"
+    "        }\n"
+    "    }\n"
+    "\n"
+    "    const uint idx = atomic_inc(hit_count);\n"
+    "    if (idx < max_hits) {\n"
+    "        hits[2 * idx] = o_idx;\n"
+    "        hits[2 * idx + 1] = e_idx;\n"
+    "    }\n"
+    "}\n";
+
+static struct {
+    bool ready;
+    cl_context context;
+    cl_command_queue queue;
+    cl_program program;
+    cl_kernel kernel;
+    cl_mem tests;
+    cl_mem hits;
+    cl_mem hit_count;
+    cl_uint test_count;
+    size_t local_ws;
+} ocl;
+
+// first GPU of any platform,  any other OpenCL device if there is no GPU
+static bool hardnested_opencl_pick_device(cl_device_id *device) {
+    cl_platform_id platforms[8];
+    cl_uint num_platforms = 0;
+    if (clGetPlatformIDs(ARRAYLEN(platforms), platforms, &num_platforms) != CL_SUCCESS || num_platforms == 0) {
+        return false;
+    }
+    if (num_platforms > ARRAYLEN(platforms)) {
+        num_platforms = ARRAYLEN(platforms);
+    }
+
+    const cl_device_type types[] = { CL_DEVICE_TYPE_GPU, CL_DEVICE_TYPE_ALL };
+    for (size_t t = 0; t < ARRAYLEN(types); t++) {
+        for (cl_uint i = 0; i < num_platforms; i++) {
+            cl_uint num_devices = 0;
+            if (clGetDeviceIDs(platforms[i], types[t], 1, device, &num_devices) == CL_SUCCESS && num_devices) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool hardnested_opencl_available(void) {
+    return true;
+}
+
+int hardnested_opencl_init(void) {
+    if (ocl.ready) {
+        return PM3_SUCCESS;
+    }
+
+    cl_device_id device;
+    if (hardnested_opencl_pick_device(&device) == false) {
+        PrintAndLogEx(ERR, "No OpenCL device found");
+        return PM3_EFAILED;
+    }
+
+    char name[128] = {0};
+    clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+
+    cl_int err;
+    ocl.context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(ERR, "clCreateContext() failed (%d)", err);
+        return PM3_EFAILED;
+    }
+
+    ocl.queue = clCreateCommandQueue(ocl.context, device, 0, &err);
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(ERR, "clCreateCommandQueue() failed (%d)", err);
+        goto fail;
+    }
+
+    ocl.program = clCreateProgramWithSource(ocl.context, 1, &hardnested_opencl_src, NULL, &err);
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(ERR, "clCreateProgramWithSource() failed (%d)", err);
+        goto fail;
+    }
+
+    err = clBuildProgram(ocl.program, 1, &device, NULL, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        char log[1024] = {0};
+        clGetProgramBuildInfo(ocl.program, device, CL_PROGRAM_BUILD_LOG, sizeof(log) - 1, log, NULL);
+        PrintAndLogEx(ERR, "clBuildProgram() failed (%d)\n%s", err, log);
+        goto fail;
+    }
+
+    ocl.kernel = clCreateKernel(ocl.program, "hardnested_crack", &err);
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(ERR, "clCreateKernel() failed (%d)", err);
+        goto fail;
+    }
+
+    ocl.tests = clCreateBuffer(ocl.context, CL_MEM_READ_ONLY, HARDNESTED_OPENCL_MAX_TESTS * sizeof(cl_uint), NULL, &err);
+    if (err == CL_SUCCESS) {
+        ocl.hits = clCreateBuffer(ocl.context, CL_MEM_WRITE_ONLY, 2 * HARDNESTED_OPENCL_MAX_HITS * sizeof(cl_uint), NULL, &err);
+    }
+    if (err == CL_SUCCESS) {
+        ocl.hit_count = clCreateBuffer(ocl.context, CL_MEM_READ_WRITE, sizeof(cl_uint), NULL, &err);
+    }
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(ERR, "clCreateBuffer() failed (%d)", err);
+        goto fail;
+    }
+
+    ocl.local_ws = 64;
+    size_t max_ws = 0;
+    if (clGetKernelWorkGroupInfo(ocl.kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_ws), &max_ws, NULL) == CL_SUCCESS && max_ws && max_ws < ocl.local_ws) {
+        ocl.local_ws = max_ws;
+    }
+
+    ocl.ready = true;
+    PrintAndLogEx(INFO, "Brute force on OpenCL device " _YELLOW_("%s"), name);
+    return PM3_SUCCESS;
+
+fail:
+    if (ocl.hit_count) clReleaseMemObject(ocl.hit_count);
+    if (ocl.hits) clReleaseMemObject(ocl.hits);
+    if (ocl.tests) clReleaseMemObject(ocl.tests);
+    if (ocl.kernel) clReleaseKernel(ocl.kernel);
+    if (ocl.program) clReleaseProgram(ocl.program);
+    if (ocl.queue) clReleaseCommandQueue(ocl.queue);
+    clReleaseContext(ocl.context);
+    memset(&ocl, 0, sizeof(ocl));
+    return PM3_EFAILED;
+}
+
+int hardnested_opencl_set_tests(const uint32_t *test_nonce, const uint8_t *test_par, uint32_t count) {
+    if (ocl.ready == false) {
+        return PM3_EFAILED;
+    }
+
+    cl_uint tests[HARDNESTED_OPENCL_MAX_TESTS];
+    if (count > ARRAYLEN(tests)) {
+        count = ARRAYLEN(tests);
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        tests[i] = (test_nonce[i] & 0x00FFFFFF) | ((cl_uint)(test_par[i] & 0x07) << 24);
+    }
+
+    if (count && clEnqueueWriteBuffer(ocl.queue, ocl.tests, CL_TRUE, 0, count * sizeof(cl_uint), tests, 0, NULL, NULL) != CL_SUCCESS) {
+        return PM3_EFAILED;
+    }
+    ocl.test_count = count;
+    return PM3_SUCCESS;
+}
+
+// run the kernel for odd states [odd_base, odd_base + odd_cnt) against all even states
+static int hardnested_opencl_run(cl_uint even_len, cl_uint odd_base, size_t odd_cnt, cl_uint *hits, cl_uint *hit_count) {
+    const cl_uint zero = 0;
+    const cl_uint max_hits = HARDNESTED_OPENCL_MAX_HITS;
+    if (clEnqueueWriteBuffer(ocl.queue, ocl.hit_count, CL_FALSE, 0, sizeof(zero), &zero, 0, NULL, NULL) != CL_SUCCESS) {
+        return PM3_EFAILED;
+    }
+
+    cl_int err = clSetKernelArg(ocl.kernel, 1, sizeof(even_len), &even_len);
+    err |= clSetKernelArg(ocl.kernel, 3, sizeof(odd_base), &odd_base);
+    err |= clSetKernelArg(ocl.kernel, 4, sizeof(cl_mem), &ocl.tests);
+    err |= clSetKernelArg(ocl.kernel, 5, sizeof(ocl.test_count), &ocl.test_count);
+    err |= clSetKernelArg(ocl.kernel, 6, sizeof(cl_mem), &ocl.hits);
+    err |= clSetKernelArg(ocl.kernel, 7, sizeof(cl_mem), &ocl.hit_count);
+    err |= clSetKernelArg(ocl.kernel, 8, sizeof(max_hits), &max_hits);
+    if (err != CL_SUCCESS) {
+        return PM3_EFAILED;
+    }
+
+    const size_t global_ws[2] = { ((even_len + ocl.local_ws - 1) / ocl.local_ws) * ocl.local_ws, odd_cnt };
+    const size_t local_ws[2] = { ocl.local_ws, 1 };
+    err = clEnqueueNDRangeKernel(ocl.queue, ocl.kernel, 2, NULL, global_ws, local_ws, 0, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        PrintAndLogEx(ERR, "clEnqueueNDRangeKernel() failed (%d)", err);
+        return PM3_EFAILED;
+    }
+
+    if (clEnqueueReadBuffer(ocl.queue, ocl.hit_count, CL_TRUE, 0, sizeof(cl_uint), hit_count, 0, NULL, NULL) != CL_SUCCESS) {
+        return PM3_EFAILED;
+    }
+    if (*hit_count && *hit_count <= max_hits) {
+        if (clEnqueueReadBuffer(ocl.queue, ocl.hits, CL_TRUE, 0, 2 * *hit_count * sizeof(cl_uint), hits, 0, NULL, NULL) != CL_SUCCESS) {
+            return PM3_EFAILED;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+static uint64_t hardnested_opencl_key(uint32_t cuid, const uint8_t *best_first_bytes, uint32_t odd, uint32_t even) {
+    struct Crypto1State pcs;
+    pcs.odd = odd;
+    pcs.even = even;
+    lfsr_rollback_byte(&pcs, (cuid >> 24) ^ best_first_bytes[0], true);
+    uint64_t key = 0;
+    crypto1_get_lfsr(&pcs, &key);
+    return key;
+}
+
+/**
+ * @brief Brute force one bucket of odd and even half states on the OpenCL device
+ *
+ * @param tested incremented by the number of states tested
+ * @param key the key found,  -1 if the bucket doesn't contain it
+ * @return PM3_SUCCESS whether a key was found or not,  PM3_EFAILED on OpenCL errors
+ */
+int hardnested_opencl_crack(statelist_t *p, uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes, uint64_t *tested, uint64_t *key) {
+    *key = -1;
+    if (ocl.ready == false) {
+        return PM3_EFAILED;
+    }
+
+    const uint32_t *even = p->states[0];
+    const uint32_t *odd = p->states[1];
+    const cl_uint even_len = p->len[0];
+    const cl_uint odd_len = p->len[1];
+    if (even_len == 0 || odd_len == 0) {
+        return PM3_SUCCESS;
+    }
+
+    cl_uint *hits = calloc(2 * HARDNESTED_OPENCL_MAX_HITS, sizeof(cl_uint));
+    if (hits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    cl_int err;
+    cl_mem even_buf = clCreateBuffer(ocl.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, even_len * sizeof(uint32_t), (void *)even, &err);
+    if (err != CL_SUCCESS) {
+        free(hits);
+        return PM3_EFAILED;
+    }
+    cl_mem odd_buf = clCreateBuffer(ocl.context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, odd_len * sizeof(uint32_t), (void *)odd, &err);
+    if (err != CL_SUCCESS) {
+        clReleaseMemObject(even_buf);
+        free(hits);
+        return PM3_EFAILED;
+    }
+
+    int res = PM3_SUCCESS;
+    if (clSetKernelArg(ocl.kernel, 0, sizeof(cl_mem), &even_buf) != CL_SUCCESS ||
+            clSetKernelArg(ocl.kernel, 2, sizeof(cl_mem), &odd_buf) != CL_SUCCESS) {
+        res = PM3_EFAILED;
+        goto out;
+    }
+
+    size_t chunk = HARDNESTED_OPENCL_BATCH / even_len;
+    if (chunk == 0) {
+        chunk = 1;
+    }
+
+    cl_uint odd_base = 0;
+    while (odd_base < odd_len) {
+        size_t odd_cnt = MIN(chunk, odd_len - odd_base);
+        cl_uint hit_count = 0;
+        res = hardnested_opencl_run(even_len, odd_base, odd_cnt, hits, &hit_count);
+        if (res != PM3_SUCCESS) {
+            goto out;
+        }
+
+        if (hit_count > HARDNESTED_OPENCL_MAX_HITS) {
+            // too few test nonces to filter well,  retry with less odd states per launch
+            if (odd_cnt > 1) {
+                chunk = (odd_cnt + 1) / 2;
+                continue;
+            }
+            for (cl_uint e = 0; e < even_len; e++) {
+                if (verify_key(cuid, nonces, best_first_bytes, odd[odd_base], even[e])) {
+                    *key = hardnested_opencl_key(cuid, best_first_bytes, odd[odd_base], even[e]);
+                    *tested += e;
+                    goto out;
+                }
+            }
+        } else {
+            for (cl_uint i = 0; i < hit_count; i++) {
+                uint32_t o = odd[hits[2 * i]];
+                uint32_t e = even[hits[2 * i + 1]];
+                if (verify_key(cuid, nonces, best_first_bytes, o, e)) {
+                    *key = hardnested_opencl_key(cuid, best_first_bytes, o, e);
+                    goto out;
+                }
+            }
+        }
+
+        *tested += (uint64_t)even_len * odd_cnt;
+        odd_base += odd_cnt;
+    }
+
+out:
+    clReleaseMemObject(odd_buf);
+    clReleaseMemObject(even_buf);
+    free(hits);
+    return res;
+}
+
+#else // HAVE_OPENCL
+
+bool hardnested_opencl_available(void) {
+    return false;
+}
+
+int hardnested_opencl_init(void) {
+    PrintAndLogEx(ERR, "Client was built without OpenCL support");
+    return PM3_ENOTIMPL;
+}
+
+int hardnested_opencl_set_tests(const uint32_t *test_nonce, const uint8_t *test_par, uint32_t count) {
+    return PM3_ENOTIMPL;
+}
+
+int hardnested_opencl_crack(statelist_t *p, uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes, uint64_t *tested, uint64_t *key) {
+    *key = -1;
+    return PM3_ENOTIMPL;
+}
+
+#endif // HAVE_OPENCL
@@ -0,0 +1,30 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hardnested brute force on an OpenCL device
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTED_OPENCL_H__
+#define HARDNESTED_OPENCL_H__
+
+#include "common.h"
+#include "hardnested_bruteforce.h"  // statelist_t, noncelist_t
+
+bool hardnested_opencl_available(void);
+int hardnested_opencl_init(void);
+int hardnested_opencl_set_tests(const uint32_t *test_nonce, const uint8_t *test_par, uint32_t count);
+int hardnested_opencl_crack(statelist_t *p, uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes, uint64_t *tested, uint64_t *key);
+
+#endif
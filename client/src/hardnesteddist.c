@@ -0,0 +1,506 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hardnested brute force spread over several hosts
+//
+// While the coordinator is in its brute force phase it listens for workers.
+// Each worker gets the nonces once,  then takes parts of the candidate states
+// from the same queue the local threads work on until the queue is empty or
+// a key is found.  A key reported by a worker is checked against all nonces
+// before it is taken,  a part of a worker that goes away is cracked locally.
+//
+// protocol,  one text line per message,  all numbers little endian:
+//   coordinator:  JOB <cuid hex> <count>\n   256 best first bytes,  <count> x ( first byte, nonce_enc[4], par_enc )
+//                 PART <odd len> <even len>\n  odd states,  even states,  4 bytes each
+//                 END\n
+//   worker:       KEY <12 hex digits>\n  |  DONE <states tested>\n
+//-----------------------------------------------------------------------------
+
+#include "hardnesteddist.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ui.h"
+#include "util.h"               // kbd_enter_pressed
+#include "util_posix.h"         // msleep
+#include "commonutil.h"         // Uint4byteToMemLe
+#include "crapto1/crapto1.h"
+#include "hardnestedserver.h"   // socket helpers
+
+#ifndef _WIN32
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+
+#define HARDNESTED_DIST_MAX_WORKERS     64
+#define HARDNESTED_DIST_RETRY_MS        2000
+#define HARDNESTED_DIST_MAX_STATES      (1 << 24)
+
+typedef enum {
+    EVEN_STATE = 0,
+    ODD_STATE = 1
+} odd_even_t;
+
+typedef struct {
+    int fd;
+    pthread_t thread;
+    char peer[INET6_ADDRSTRLEN];
+} hardnested_worker_t;
+
+static struct {
+    pthread_mutex_t lock;
+    volatile bool stop;
+    int listen_fd;
+    pthread_t accept_thread;
+    hardnested_worker_t workers[HARDNESTED_DIST_MAX_WORKERS];
+    uint32_t num_workers;
+    uint8_t *job;
+    size_t job_len;
+    uint32_t cuid;
+    noncelist_t *nonces;
+    uint8_t *best_first_bytes;
+} dist = { .lock = PTHREAD_MUTEX_INITIALIZER, .listen_fd = -1 };
+
+// the nonces of all first bytes,  the same for every worker of a brute force run
+static bool hardnested_dist_build_job(uint32_t cuid, noncelist_t *nonces, const uint8_t *best_first_bytes) {
+    uint32_t count = 0;
+    for (uint16_t i = 0; i < 256; i++) {
+        for (noncelistentry_t *p = nonces[i].first; p != NULL; p = p->next) {
+            count++;
+        }
+    }
+
+    char header[40];
+    int hlen = snprintf(header, sizeof(header), "JOB %08" PRIx32 " %" PRIu32 "\n", cuid, count);
+    dist.job_len = hlen + 256 + ((size_t)count * 6);
+    dist.job = calloc(dist.job_len, sizeof(uint8_t));
+    if (dist.job == NULL) {
+        return false;
+    }
+
+    uint8_t *d = dist.job;
+    memcpy(d, header, hlen);
+    d += hlen;
+    memcpy(d, best_first_bytes, 256);
+    d += 256;
+    for (uint16_t i = 0; i < 256; i++) {
+        for (noncelistentry_t *p = nonces[i].first; p != NULL; p = p->next) {
+            d[0] = i;
+            Uint4byteToMemLe(d + 1, p->nonce_enc);
+            d[5] = p->par_enc;
+            d += 6;
+        }
+    }
+    return true;
+}
+
+static bool hardnested_dist_send_part(int fd, const statelist_t *part) {
+    const uint32_t odd_len = part->len[ODD_STATE];
+    const uint32_t even_len = part->len[EVEN_STATE];
+    size_t len = ((size_t)odd_len + even_len) * 4;
+    uint8_t *data = calloc(len, sizeof(uint8_t));
+    if (data == NULL) {
+        return false;
+    }
+
+    uint8_t *d = data;
+    for (uint32_t i = 0; i < odd_len; i++, d += 4) {
+        Uint4byteToMemLe(d, part->states[ODD_STATE][i]);
+    }
+    for (uint32_t i = 0; i < even_len; i++, d += 4) {
+        Uint4byteToMemLe(d, part->states[EVEN_STATE][i]);
+    }
+
+    bool ok = hardnested_send_line(fd, "PART %" PRIu32 " %" PRIu32, odd_len, even_len) && hardnested_send_all(fd, data, len);
+    free(data);
+    return ok;
+}
+
+// false when the worker went away,  or when somebody else found the key meanwhile
+static bool hardnested_dist_wait_result(int fd, uint64_t *key, uint64_t *tested) {
+    while (brute_force_key_found() == false) {
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 500000 };
+        int n = select(fd + 1, &rfds, NULL, NULL, &tv);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+        if (n == 0) {
+            continue;
+        }
+
+        char line[80];
+        if (hardnested_recv_line(fd, line, sizeof(line)) == false) {
+            return false;
+        }
+        if (sscanf(line, "KEY %12" SCNx64, key) == 1) {
+            return true;
+        }
+        if (sscanf(line, "DONE %" SCNu64, tested) == 1) {
+            *key = -1;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+
+// a key from a worker only counts when it decrypts all nonces
+static bool hardnested_dist_check_key(uint64_t key) {
+    struct Crypto1State *pcs = crypto1_create(key);
+    if (pcs == NULL) {
+        return false;
+    }
+    crypto1_byte(pcs, (dist.cuid >> 24) ^ dist.best_first_bytes[0], true);
+    bool ok = verify_key(dist.cuid, dist.nonces, dist.best_first_bytes, pcs->odd & 0x00ffffff, pcs->even & 0x00ffffff);
+    crypto1_destroy(pcs);
+    return ok;
+}
+
+static void *hardnested_dist_worker_thread(void *arg) {
+    hardnested_worker_t *w = arg;
+
+    bool ok = hardnested_send_all(w->fd, dist.job, dist.job_len);
+    uint32_t parts = 0;
+    statelist_t part;
+    while (ok && brute_force_next_part(&part)) {
+        uint64_t key = -1, tested = 0;
+        ok = hardnested_dist_send_part(w->fd, &part) && hardnested_dist_wait_result(w->fd, &key, &tested);
+        if (ok == false) {
+            if (brute_force_key_found()) {
+                break;
+            }
+            // nobody else will take this part from the queue again
+            PrintAndLogEx(WARNING, "\nworker %s lost, cracking its part here", w->peer);
+            brute_force_part_done(0, brute_force_crack_part(&part, dist.cuid, dist.nonces, dist.best_first_bytes));
+            break;
+        }
+
+        if (key != -1 && hardnested_dist_check_key(key) == false) {
+            PrintAndLogEx(WARNING, "\nworker %s reported a wrong key, cracking its part here", w->peer);
+            brute_force_part_done(0, brute_force_crack_part(&part, dist.cuid, dist.nonces, dist.best_first_bytes));
+            ok = false;
+            break;
+        }
+
+        brute_force_part_done(tested, key);
+        parts++;
+    }
+
+    if (ok) {
+        hardnested_send_line(w->fd, "END");
+    }
+    close(w->fd);
+    PrintAndLogEx(INFO, "\nworker %s done, " _YELLOW_("%" PRIu32) " parts", w->peer, parts);
+    return NULL;
+}
+
+static void *hardnested_dist_accept_thread(void *arg) {
+    (void)arg;
+    while (dist.stop == false) {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        int fd = accept(dist.listen_fd, (struct sockaddr *)&addr, &addrlen);
+        if (fd < 0) {
+            if (dist.stop) {
+                break;
+            }
+            if (errno != EINTR) {
+                msleep(100);
+            }
+            continue;
+        }
+
+        pthread_mutex_lock(&dist.lock);
+        if (dist.stop || dist.num_workers == HARDNESTED_DIST_MAX_WORKERS) {
+            pthread_mutex_unlock(&dist.lock);
+            close(fd);
+            continue;
+        }
+
+        hardnested_worker_t *w = &dist.workers[dist.num_workers];
+        memset(w, 0, sizeof(hardnested_worker_t));
+        w->fd = fd;
+        snprintf(w->peer, sizeof(w->peer), "?");
+        if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr, w->peer, sizeof(w->peer));
+        } else if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr, w->peer, sizeof(w->peer));
+        }
+        hardnested_sock_opts(fd);
+
+        if (pthread_create(&w->thread, NULL, hardnested_dist_worker_thread, w) == 0) {
+            dist.num_workers++;
+            PrintAndLogEx(INFO, "\nworker %s joined", w->peer);
+        } else {
+            close(fd);
+        }
+        pthread_mutex_unlock(&dist.lock);
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Hand out parts of the running brute force to workers connecting on port
+ */
+int hardnested_dist_start(uint16_t port, uint32_t cuid, noncelist_t *nonces, uint8_t *best_first_bytes) {
+#ifdef _WIN32
+    (void)port;
+    (void)cuid;
+    (void)nonces;
+    (void)best_first_bytes;
+    PrintAndLogEx(WARNING, "The distributed brute force isn't available on Windows");
+    return PM3_ENOTIMPL;
+#else
+    if (hardnested_dist_build_job(cuid, nonces, best_first_bytes) == false) {
+        return PM3_EMALLOC;
+    }
+
+    dist.listen_fd = hardnested_listen(NULL, port);
+    if (dist.listen_fd < 0) {
+        PrintAndLogEx(WARNING, "Could not listen on port " _YELLOW_("%u") ", brute forcing locally", port);
+        free(dist.job);
+        dist.job = NULL;
+        return PM3_EIO;
+    }
+
+    dist.cuid = cuid;
+    dist.nonces = nonces;
+    dist.best_first_bytes = best_first_bytes;
+    dist.num_workers = 0;
+    dist.stop = false;
+    if (pthread_create(&dist.accept_thread, NULL, hardnested_dist_accept_thread, NULL) != 0) {
+        close(dist.listen_fd);
+        dist.listen_fd = -1;
+        free(dist.job);
+        dist.job = NULL;
+        return PM3_ESOFT;
+    }
+
+    PrintAndLogEx(INFO, "Waiting for brute force workers on port " _YELLOW_("%u"), port);
+    return PM3_SUCCESS;
+#endif
+}
+
+/**
+ * @brief Stop taking workers and wait for the parts they still work on
+ */
+void hardnested_dist_stop(void) {
+#ifndef _WIN32
+    pthread_mutex_lock(&dist.lock);
+    dist.stop = true;
+    pthread_mutex_unlock(&dist.lock);
+    shutdown(dist.listen_fd, SHUT_RDWR);
+    close(dist.listen_fd);
+    pthread_join(dist.accept_thread, NULL);
+    dist.listen_fd = -1;
+
+    for (uint32_t i = 0; i < dist.num_workers; i++) {
+        pthread_join(dist.workers[i].thread, NULL);
+    }
+    dist.num_workers = 0;
+
+    free(dist.job);
+    dist.job = NULL;
+    dist.job_len = 0;
+#endif
+}
+
+#ifndef _WIN32
+static void hardnested_work_free_nonces(noncelist_t *nonces) {
+    for (uint16_t i = 0; i < 256; i++) {
+        noncelistentry_t *p = nonces[i].first;
+        while (p != NULL) {
+            noncelistentry_t *next = p->next;
+            free(p);
+            p = next;
+        }
+    }
+    memset(nonces, 0, 256 * sizeof(noncelist_t));
+}
+
+// rebuild the nonce lists in the order the coordinator has them
+static bool hardnested_work_recv_job(int fd, const char *line, uint32_t *cuid, noncelist_t *nonces, uint8_t *best_first_bytes, uint32_t *count) {
+    if (sscanf(line, "JOB %8" SCNx32 " %" SCNu32, cuid, count) != 2 || *count > (2 * 0x40000)) {
+        return false;
+    }
+    if (hardnested_recv_all(fd, best_first_bytes, 256) == false) {
+        return false;
+    }
+
+    noncelistentry_t *tail[256] = { NULL };
+    for (uint32_t i = 0; i < *count; i++) {
+        uint8_t d[6];
+        if (hardnested_recv_all(fd, d, sizeof(d)) == false) {
+            return false;
+        }
+        noncelistentry_t *p = calloc(1, sizeof(noncelistentry_t));
+        if (p == NULL) {
+            return false;
+        }
+        p->nonce_enc = MemLeToUint4byte(d + 1);
+        p->par_enc = d[5];
+        if (tail[d[0]] == NULL) {
+            nonces[d[0]].first = p;
+        } else {
+            tail[d[0]]->next = p;
+        }
+        tail[d[0]] = p;
+        nonces[d[0]].num++;
+    }
+    return true;
+}
+
+static bool hardnested_work_recv_states(int fd, uint32_t *states, uint32_t len) {
+    uint8_t d[4];
+    for (uint32_t i = 0; i < len; i++) {
+        if (hardnested_recv_all(fd, d, sizeof(d)) == false) {
+            return false;
+        }
+        states[i] = MemLeToUint4byte(d);
+    }
+    states[len] = -1;
+    return true;
+}
+
+// one job,  part after part,  false when the connection broke
+static bool hardnested_work_job(int fd, noncelist_t *nonces, uint32_t *parts, uint32_t *keys) {
+    char line[80];
+    if (hardnested_recv_line(fd, line, sizeof(line)) == false) {
+        return false;
+    }
+
+    uint32_t cuid = 0, count = 0;
+    uint8_t best_first_bytes[256];
+    if (hardnested_work_recv_job(fd, line, &cuid, nonces, best_first_bytes, &count) == false) {
+        PrintAndLogEx(ERR, "Bad job from the coordinator");
+        hardnested_work_free_nonces(nonces);
+        return false;
+    }
+    prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+    PrintAndLogEx(INFO, "job for uid " _YELLOW_("%08" PRIx32) ", " _YELLOW_("%" PRIu32) " nonces", cuid, count);
+
+    bool ok = true;
+    while (ok) {
+        if (hardnested_recv_line(fd, line, sizeof(line)) == false) {
+            ok = false;
+            break;
+        }
+        if (strcmp(line, "END") == 0) {
+            break;
+        }
+
+        uint32_t odd_len = 0, even_len = 0;
+        if (sscanf(line, "PART %" SCNu32 " %" SCNu32, &odd_len, &even_len) != 2 ||
+                odd_len == 0 || even_len == 0 || odd_len > HARDNESTED_DIST_MAX_STATES || even_len > HARDNESTED_DIST_MAX_STATES) {
+            PrintAndLogEx(ERR, "Bad part from the coordinator");
+            ok = false;
+            break;
+        }
+
+        statelist_t part = { .next = NULL };
+        part.len[ODD_STATE] = odd_len;
+        part.len[EVEN_STATE] = even_len;
+        part.states[ODD_STATE] = calloc(odd_len + 1, sizeof(uint32_t));
+        part.states[EVEN_STATE] = calloc(even_len + 1, sizeof(uint32_t));
+        ok = (part.states[ODD_STATE] != NULL && part.states[EVEN_STATE] != NULL)
+             && hardnested_work_recv_states(fd, part.states[ODD_STATE], odd_len)
+             && hardnested_work_recv_states(fd, part.states[EVEN_STATE], even_len);
+
+        if (ok) {
+            uint64_t size = (uint64_t)odd_len * even_len;
+            nonces[best_first_bytes[0]].expected_num_brute_force = (float)size / 2;
+            uint64_t key = -1;
+            if (brute_force_bs(NULL, &part, cuid, count, size, nonces, best_first_bytes, &key)) {
+                (*keys)++;
+                ok = hardnested_send_line(fd, "KEY %012" PRIX64, key);
+            } else {
+                ok = hardnested_send_line(fd, "DONE %" PRIu64, size);
+            }
+            (*parts)++;
+        }
+        free(part.states[ODD_STATE]);
+        free(part.states[EVEN_STATE]);
+    }
+
+    hardnested_work_free_nonces(nonces);
+    return ok;
+}
+#endif
+
+/**
+ * @brief Work on the brute force parts of a coordinator until <Enter> is pressed
+ */
+int hardnested_work(const char *host, uint16_t port, bool gpu) {
+#ifdef _WIN32
+    (void)host;
+    (void)port;
+    (void)gpu;
+    PrintAndLogEx(WARNING, "The distributed brute force isn't available on Windows");
+    return PM3_ENOTIMPL;
+#else
+    noncelist_t *nonces = calloc(256, sizeof(noncelist_t));
+    if (nonces == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    brute_force_use_gpu(gpu);
+    brute_force_distribute(0);
+
+    PrintAndLogEx(INFO, "Working for " _YELLOW_("%s:%u") ", press " _GREEN_("<Enter>") " to stop", host, port);
+
+    uint32_t jobs = 0, parts = 0, keys = 0;
+    bool waiting = false;
+    while (kbd_enter_pressed() == false) {
+        // the coordinator only listens during its brute force phase
+        int fd = hardnested_connect(host, port, false);
+        if (fd < 0) {
+            if (waiting == false) {
+                PrintAndLogEx(INFO, "waiting for the coordinator...");
+                waiting = true;
+            }
+            msleep(HARDNESTED_DIST_RETRY_MS);
+            continue;
+        }
+        waiting = false;
+
+        hardnested_sock_opts(fd);
+        if (hardnested_work_job(fd, nonces, &parts, &keys) == false) {
+            PrintAndLogEx(WARNING, "Connection to the coordinator closed");
+        }
+        close(fd);
+        jobs++;
+
+        // the coordinator keeps listening until its own threads are done
+        msleep(HARDNESTED_DIST_RETRY_MS);
+    }
+
+    brute_force_use_gpu(false);
+    free(nonces);
+    PrintAndLogEx(INFO, "Worker stopped, " _YELLOW_("%" PRIu32) " jobs, " _YELLOW_("%" PRIu32) " parts, " _GREEN_("%" PRIu32) " keys found", jobs, parts, keys);
+    return PM3_SUCCESS;
+#endif
+}
@@ -0,0 +1,31 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hardnested brute force spread over several hosts
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTEDDIST_H__
+#define HARDNESTEDDIST_H__
+
+#include "common.h"
+#include "hardnested_bruteforce.h"  // statelist_t, noncelist_t
+
+#define HARDNESTED_DIST_PORT        9211
+
+int hardnested_dist_start(uint16_t port, uint32_t cuid, noncelist_t *nonces, uint8_t *best_first_bytes);
+void hardnested_dist_stop(void);
+int hardnested_work(const char *host, uint16_t port, bool gpu);
+
+#endif
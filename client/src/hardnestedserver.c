@@ -0,0 +1,528 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hardnested crack server
+//
+// A long running client keeps the hardnested tables in memory and cracks the
+// nonce files other clients send it,  one job at a time in arrival order.
+//
+// protocol,  one text line per message:
+//   client:  NONCES <size>\n  followed by <size> bytes of a nonces.bin file
+//   server:  QUEUED <jobs ahead>\n
+//            KEY <12 hex digits>\n  |  FAIL <status>\n  |  ERROR <reason>\n
+//-----------------------------------------------------------------------------
+
+#include "hardnestedserver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ui.h"
+#include "util.h"           // kbd_enter_pressed
+#include "util_posix.h"     // msleep
+#include "cmdhfmfhard.h"    // mfnestedhard
+
+#ifndef _WIN32
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// 6 bytes header,  9 bytes per nonce pair
+#define HARDNESTED_NONCE_FILE_MAX   (6 + (9 * 0x40000))
+#define HARDNESTED_RECV_TIMEOUT     10
+
+typedef struct hardnested_job_s {
+    int fd;
+    uint32_t id;
+    char *path;
+    char peer[INET6_ADDRSTRLEN];
+    struct hardnested_job_s *next;
+} hardnested_job_t;
+
+static struct {
+    pthread_mutex_t lock;
+    hardnested_job_t *head;
+    hardnested_job_t *tail;
+    uint32_t queued;
+    uint32_t next_id;
+    volatile bool stop;
+    int listen_fd;
+} server = { .lock = PTHREAD_MUTEX_INITIALIZER, .listen_fd = -1 };
+
+void hardnested_sock_opts(int fd) {
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    struct timeval tv = { .tv_sec = HARDNESTED_RECV_TIMEOUT, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+bool hardnested_send_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = data;
+    while (len) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+bool hardnested_send_line(int fd, const char *fmt, ...) {
+    char line[80];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line) - 1, fmt, args);
+    va_end(args);
+    strcat(line, "\n");
+    return hardnested_send_all(fd, line, strlen(line));
+}
+
+// one line without the newline,  false on timeout or a closed connection
+bool hardnested_recv_line(int fd, char *line, size_t size) {
+    size_t n = 0;
+    while (n < size - 1) {
+        char c;
+        ssize_t r = recv(fd, &c, 1, 0);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            return false;
+        }
+        if (c == '\n') {
+            break;
+        }
+        if (c != '\r') {
+            line[n++] = c;
+        }
+    }
+    line[n] = '\0';
+    return true;
+}
+
+bool hardnested_recv_all(int fd, void *data, size_t len) {
+    uint8_t *p = data;
+    while (len) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void hardnested_job_free(hardnested_job_t *job) {
+    if (job->fd >= 0) {
+        close(job->fd);
+    }
+    if (job->path) {
+        remove(job->path);
+        free(job->path);
+    }
+    free(job);
+}
+
+// read the nonce file of a new connection into the cache directory and queue it
+static void hardnested_receive(int fd, const char *peer) {
+    hardnested_sock_opts(fd);
+
+    char line[64];
+    uint32_t size = 0;
+    if (hardnested_recv_line(fd, line, sizeof(line)) == false || sscanf(line, "NONCES %" SCNu32, &size) != 1) {
+        hardnested_send_line(fd, "ERROR bad request");
+        close(fd);
+        return;
+    }
+
+    if (size < 6 || size > HARDNESTED_NONCE_FILE_MAX || ((size - 6) % 9) != 0) {
+        hardnested_send_line(fd, "ERROR bad nonce file size");
+        close(fd);
+        return;
+    }
+
+    hardnested_job_t *job = calloc(1, sizeof(hardnested_job_t));
+    if (job == NULL) {
+        hardnested_send_line(fd, "ERROR out of memory");
+        close(fd);
+        return;
+    }
+    job->fd = fd;
+    snprintf(job->peer, sizeof(job->peer), "%s", peer);
+
+    pthread_mutex_lock(&server.lock);
+    job->id = ++server.next_id;
+    pthread_mutex_unlock(&server.lock);
+
+    char name[48];
+    snprintf(name, sizeof(name), "hardnested-job-%d-%" PRIu32 ".bin", (int)getpid(), job->id);
+    FILE *f = NULL;
+    if (searchHomeFilePath(&job->path, CACHE_SUBDIR, name, true) == PM3_SUCCESS) {
+        f = fopen(job->path, "wb");
+    }
+    if (f == NULL) {
+        hardnested_send_line(fd, "ERROR could not store nonce file");
+        hardnested_job_free(job);
+        return;
+    }
+
+    uint8_t buf[4096];
+    uint32_t left = size;
+    while (left) {
+        ssize_t n = recv(fd, buf, MIN(left, sizeof(buf)), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0 || fwrite(buf, 1, n, f) != (size_t)n) {
+            break;
+        }
+        left -= n;
+    }
+    fclose(f);
+
+    if (left) {
+        hardnested_send_line(fd, "ERROR incomplete nonce file");
+        hardnested_job_free(job);
+        return;
+    }
+
+    pthread_mutex_lock(&server.lock);
+    uint32_t ahead = server.queued++;
+    if (server.tail) {
+        server.tail->next = job;
+    } else {
+        server.head = job;
+    }
+    server.tail = job;
+    pthread_mutex_unlock(&server.lock);
+
+    hardnested_send_line(fd, "QUEUED %" PRIu32, ahead);
+    PrintAndLogEx(INFO, "job " _YELLOW_("%" PRIu32) " from %s queued, %" PRIu32 " ahead", job->id, job->peer, ahead);
+}
+
+static void *hardnested_accept_thread(void *arg) {
+    (void)arg;
+    while (server.stop == false) {
+        struct sockaddr_storage addr;
+        socklen_t addrlen = sizeof(addr);
+        int fd = accept(server.listen_fd, (struct sockaddr *)&addr, &addrlen);
+        if (fd < 0) {
+            if (server.stop) {
+                break;
+            }
+            if (errno != EINTR) {
+                msleep(100);
+            }
+            continue;
+        }
+
+        char peer[INET6_ADDRSTRLEN] = "?";
+        if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &((struct sockaddr_in *)&addr)->sin_addr, peer, sizeof(peer));
+        } else if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &((struct sockaddr_in6 *)&addr)->sin6_addr, peer, sizeof(peer));
+        }
+
+        hardnested_receive(fd, peer);
+    }
+    return NULL;
+}
+
+static hardnested_job_t *hardnested_pop(void) {
+    pthread_mutex_lock(&server.lock);
+    hardnested_job_t *job = server.head;
+    if (job) {
+        server.head = job->next;
+        if (server.head == NULL) {
+            server.tail = NULL;
+        }
+        server.queued--;
+    }
+    pthread_mutex_unlock(&server.lock);
+    return job;
+}
+
+int hardnested_listen(const char *bind_addr, uint16_t port) {
+    char portstr[8];
+    snprintf(portstr, sizeof(portstr), "%u", port);
+
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    int s = getaddrinfo(bind_addr, portstr, &hints, &res);
+    if (s != 0) {
+        PrintAndLogEx(ERR, "error: getaddrinfo: %d: %s", s, gai_strerror(s));
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *rp = res; rp != NULL; rp = rp->ai_next) {
+        fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, rp->ai_addr, rp->ai_addrlen) == 0 && listen(fd, 16) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// -1 when nobody listens,  verbose reports name resolution errors
+int hardnested_connect(const char *host, uint16_t port, bool verbose) {
+    char portstr[8];
+    snprintf(portstr, sizeof(portstr), "%u", port);
+
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int s = getaddrinfo(host, portstr, &hints, &res);
+    if (s != 0) {
+        if (verbose) {
+            PrintAndLogEx(ERR, "error: getaddrinfo: %d: %s", s, gai_strerror(s));
+        }
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo *rp = res; rp != NULL; rp = rp->ai_next) {
+        fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (connect(fd, rp->ai_addr, rp->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+#endif
+
+/**
+ * @brief Run the crack server until <Enter> is pressed.  The first job builds the hardnested tables,
+ * every later one starts with them warm.
+ *
+ * @param bind_addr address to listen on,  the loopback one unless stations on other hosts should connect
+ */
+int hardnested_serve(const char *bind_addr, uint16_t port) {
+#ifdef _WIN32
+    (void)bind_addr;
+    (void)port;
+    PrintAndLogEx(WARNING, "The hardnested crack server isn't available on Windows");
+    return PM3_ENOTIMPL;
+#else
+    server.listen_fd = hardnested_listen(bind_addr, port);
+    if (server.listen_fd < 0) {
+        PrintAndLogEx(ERR, "Could not listen on " _YELLOW_("%s:%u"), bind_addr, port);
+        return PM3_EIO;
+    }
+
+    server.stop = false;
+    pthread_t accept_thread;
+    if (pthread_create(&accept_thread, NULL, hardnested_accept_thread, NULL) != 0) {
+        close(server.listen_fd);
+        server.listen_fd = -1;
+        return PM3_ESOFT;
+    }
+
+    PrintAndLogEx(SUCCESS, "Hardnested server listening on " _YELLOW_("%s:%u"), bind_addr, port);
+    PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to stop");
+
+    mfnestedhard_keep_warm(true);
+
+    uint32_t done = 0, found = 0;
+    while (kbd_enter_pressed() == false) {
+        hardnested_job_t *job = hardnested_pop();
+        if (job == NULL) {
+            msleep(100);
+            continue;
+        }
+
+        PrintAndLogEx(INFO, "job " _YELLOW_("%" PRIu32) " from %s started", job->id, job->peer);
+        uint64_t key = 0;
+        int res = mfnestedhard(0, 0, NULL, 0, 0, NULL, true, false, false, false, 0, &key, job->path);
+        if (res == PM3_SUCCESS) {
+            found++;
+            hardnested_send_line(job->fd, "KEY %012" PRIX64, key);
+            PrintAndLogEx(SUCCESS, "job " _YELLOW_("%" PRIu32) " key " _GREEN_("%012" PRIX64), job->id, key);
+        } else {
+            hardnested_send_line(job->fd, "FAIL %d", res);
+            PrintAndLogEx(FAILED, "job " _YELLOW_("%" PRIu32) " no key ( %d )", job->id, res);
+        }
+        done++;
+        hardnested_job_free(job);
+    }
+
+    server.stop = true;
+    shutdown(server.listen_fd, SHUT_RDWR);
+    close(server.listen_fd);
+    pthread_join(accept_thread, NULL);
+    server.listen_fd = -1;
+
+    hardnested_job_t *job;
+    while ((job = hardnested_pop()) != NULL) {
+        hardnested_send_line(job->fd, "FAIL %d", PM3_EOPABORTED);
+        hardnested_job_free(job);
+    }
+
+    mfnestedhard_keep_warm(false);
+    PrintAndLogEx(INFO, "Server stopped, " _YELLOW_("%" PRIu32) " jobs, " _GREEN_("%" PRIu32) " keys found", done, found);
+    return PM3_SUCCESS;
+#endif
+}
+
+/**
+ * @brief Send a nonce file to a crack server and wait for its key
+ */
+int hardnested_remote(const char *host, uint16_t port, const char *filename, uint64_t *foundkey) {
+#ifdef _WIN32
+    (void)host;
+    (void)port;
+    (void)filename;
+    (void)foundkey;
+    PrintAndLogEx(WARNING, "The hardnested crack server isn't available on Windows");
+    return PM3_ENOTIMPL;
+#else
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "Could not open file " _YELLOW_("%s"), filename);
+        return PM3_EFILE;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long fsize = ftell(f);
+    rewind(f);
+    if (fsize < 6 || fsize > HARDNESTED_NONCE_FILE_MAX || ((fsize - 6) % 9) != 0) {
+        PrintAndLogEx(WARNING, "File " _YELLOW_("%s") " isn't a nonce file", filename);
+        fclose(f);
+        return PM3_EFILE;
+    }
+
+    uint8_t *data = calloc(fsize, sizeof(uint8_t));
+    if (data == NULL) {
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+    size_t bytes_read = fread(data, 1, fsize, f);
+    fclose(f);
+    if (bytes_read != (size_t)fsize) {
+        free(data);
+        return PM3_EFILE;
+    }
+
+    int fd = hardnested_connect(host, port, true);
+    if (fd < 0) {
+        PrintAndLogEx(ERR, "Could not connect to " _YELLOW_("%s:%u"), host, port);
+        free(data);
+        return PM3_EIO;
+    }
+
+    hardnested_sock_opts(fd);
+
+    bool ok = hardnested_send_line(fd, "NONCES %ld", fsize) && hardnested_send_all(fd, data, fsize);
+    free(data);
+    if (ok == false) {
+        PrintAndLogEx(ERR, "Sending the nonce file failed");
+        close(fd);
+        return PM3_EIO;
+    }
+
+    PrintAndLogEx(INFO, "Sent " _YELLOW_("%ld") " nonces to " _YELLOW_("%s:%u") ", press " _GREEN_("<Enter>") " to abort", (fsize - 6) / 9 * 2, host, port);
+
+    int retval = PM3_EIO;
+    while (true) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            retval = PM3_EOPABORTED;
+            break;
+        }
+
+        // cracking takes a while,  only read once the server has something to say
+        fd_set rfds;
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        struct timeval tv = { .tv_sec = 0, .tv_usec = 500000 };
+        int n = select(fd + 1, &rfds, NULL, NULL, &tv);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n < 0) {
+                break;
+            }
+            continue;
+        }
+
+        char line[80];
+        if (hardnested_recv_line(fd, line, sizeof(line)) == false) {
+            PrintAndLogEx(ERR, "Connection to the server lost");
+            break;
+        }
+
+        uint32_t ahead = 0;
+        int status = 0;
+        if (sscanf(line, "QUEUED %" SCNu32, &ahead) == 1) {
+            PrintAndLogEx(INFO, "Queued, " _YELLOW_("%" PRIu32) " jobs ahead", ahead);
+        } else if (sscanf(line, "KEY %12" SCNx64, foundkey) == 1) {
+            retval = PM3_SUCCESS;
+            break;
+        } else if (sscanf(line, "FAIL %d", &status) == 1) {
+            retval = (status == PM3_EOPABORTED) ? PM3_EOPABORTED : PM3_EFAILED;
+            break;
+        } else {
+            PrintAndLogEx(ERR, "Server: %s", line);
+            retval = PM3_ESOFT;
+            break;
+        }
+    }
+
+    close(fd);
+    return retval;
+#endif
+}
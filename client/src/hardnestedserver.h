@@ -0,0 +1,40 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Hardnested crack server,  keeps the precomputed tables warm between jobs
+//-----------------------------------------------------------------------------
+
+#ifndef HARDNESTEDSERVER_H__
+#define HARDNESTEDSERVER_H__
+
+#include "common.h"
+
+#define HARDNESTED_SERVER_PORT      9210
+
+int hardnested_serve(const char *bind_addr, uint16_t port);
+int hardnested_remote(const char *host, uint16_t port, const char *filename, uint64_t *foundkey);
+
+#ifndef _WIN32
+// socket helpers,  shared with the distributed brute force
+void hardnested_sock_opts(int fd);
+bool hardnested_send_all(int fd, const void *data, size_t len);
+bool hardnested_send_line(int fd, const char *fmt, ...);
+bool hardnested_recv_line(int fd, char *line, size_t size);
+bool hardnested_recv_all(int fd, void *data, size_t len);
+int hardnested_listen(const char *bind_addr, uint16_t port);
+int hardnested_connect(const char *host, uint16_t port, bool verbose);
+#endif
+
+#endif
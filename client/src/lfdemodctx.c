@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// LF demodulation context
+//-----------------------------------------------------------------------------
+
+#include "lfdemodctx.h"
+
+#include <stdlib.h>
+
+// used by the console, scripts and the graph window
+static lf_demod_ctx_t lf_demod_default;
+
+__thread lf_demod_ctx_t *g_lf_demod_ctx = &lf_demod_default;
+
+lf_demod_ctx_t *lf_demod_ctx_default(void) {
+    return &lf_demod_default;
+}
+
+lf_demod_ctx_t *lf_demod_ctx_new(void) {
+    lf_demod_ctx_t *ctx = calloc(1, sizeof(lf_demod_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    signal_t s = { 255, -255, 0, 0, true };
+    ctx->signal = s;
+    return ctx;
+}
+
+void lf_demod_ctx_free(lf_demod_ctx_t *ctx) {
+    if (ctx == NULL || ctx == &lf_demod_default) {
+        return;
+    }
+    if (g_lf_demod_ctx == ctx) {
+        lf_demod_ctx_select(NULL);
+    }
+    free(ctx);
+}
+
+/**
+ * @brief Make ctx the current context of the calling thread
+ *
+ * @param ctx context from lf_demod_ctx_new, NULL selects the default context
+ * @return the previously selected context
+ */
+lf_demod_ctx_t *lf_demod_ctx_select(lf_demod_ctx_t *ctx) {
+    lf_demod_ctx_t *prev = g_lf_demod_ctx;
+
+    if (ctx == NULL || ctx == &lf_demod_default) {
+        g_lf_demod_ctx = &lf_demod_default;
+        // the default context keeps using the thread's own signal properties in lfdemod
+        setSignalPropertiesStore(NULL);
+    } else {
+        g_lf_demod_ctx = ctx;
+        setSignalPropertiesStore(&ctx->signal);
+    }
+    return prev;
+}
@@ -0,0 +1,71 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// LF demodulation context
+//
+// The sample (graph) buffer, the demod buffer and the signal properties live
+// in a context.  g_GraphBuffer, g_DemodBuffer and friends resolve to the
+// calling thread's current context,  which is a shared default one unless a
+// thread selects its own,  so the existing commands run unchanged on either.
+//-----------------------------------------------------------------------------
+
+#ifndef LFDEMODCTX_H__
+#define LFDEMODCTX_H__
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "lfdemod.h"        // signal_t
+
+#define MAX_GRAPH_TRACE_LEN (40000 * 32)
+#define MAX_DEMOD_BUF_LEN (1024*128)
+
+// graph samples are stored as 16 bit,  anything wider is clamped when stored
+#define GRAPH_SAMPLE_MIN    INT16_MIN
+#define GRAPH_SAMPLE_MAX    INT16_MAX
+
+typedef struct {
+    int16_t graph[MAX_GRAPH_TRACE_LEN];
+    size_t graph_len;
+
+    uint8_t demod[MAX_DEMOD_BUF_LEN];
+    size_t demod_len;
+    int32_t demod_start_idx;
+    int demod_clock;
+
+    signal_t signal;
+} lf_demod_ctx_t;
+
+extern __thread lf_demod_ctx_t *g_lf_demod_ctx;
+
+lf_demod_ctx_t *lf_demod_ctx_new(void);
+void lf_demod_ctx_free(lf_demod_ctx_t *ctx);
+lf_demod_ctx_t *lf_demod_ctx_select(lf_demod_ctx_t *ctx);
+lf_demod_ctx_t *lf_demod_ctx_default(void);
+
+#define g_GraphBuffer       (g_lf_demod_ctx->graph)
+#define g_GraphTraceLen     (g_lf_demod_ctx->graph_len)
+#define g_DemodBuffer       (g_lf_demod_ctx->demod)
+#define g_DemodBufferLen    (g_lf_demod_ctx->demod_len)
+#define g_DemodStartIdx     (g_lf_demod_ctx->demod_start_idx)
+#define g_DemodClock        (g_lf_demod_ctx->demod_clock)
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,302 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Incremental LF demodulation of real-time sample streams
+//
+// Samples are appended to a sliding window holding the last LFSTREAM_WINDOW
+// samples.  Every LFSTREAM_STEP new samples the window is handed to the
+// frame detectors from lfdemod.c, so a tag is reported one frame time after
+// it enters the field instead of after the whole capture.
+//-----------------------------------------------------------------------------
+
+#include "lfstream.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ui.h"
+#include "lfdemod.h"
+#include "cmdlfem410x.h"    // printEM410x
+#include "cmdlfindala.h"    // detectIndala
+
+const char *lfstream_name(lfstream_tag_t type) {
+    switch (type) {
+        case LFSTREAM_EM410X:
+            return "EM 410x";
+        case LFSTREAM_HID:
+            return "HID Prox";
+        case LFSTREAM_AWID:
+            return "AWID";
+        case LFSTREAM_INDALA:
+            return "Indala";
+    }
+    return "?";
+}
+
+void lfstream_restart(lfstream_t *s, uint8_t bits_per_sample) {
+    s->fill = 0;
+    s->fresh = 0;
+    s->bits_per_sample = (bits_per_sample == 0 || bits_per_sample > 8) ? 8 : bits_per_sample;
+    s->acc = 0;
+    s->acc_bits = 0;
+}
+
+void lfstream_init(lfstream_t *s, uint8_t bits_per_sample) {
+    memset(s, 0, sizeof(lfstream_t));
+    lfstream_restart(s, bits_per_sample);
+}
+
+// returns true the first time an id is seen and it should be printed
+static bool lfstream_report(lfstream_t *s, lfstream_tag_t type, uint32_t hi2, uint32_t hi, uint64_t lo, const char *raw) {
+    for (uint8_t i = 0; i < s->id_count; i++) {
+        lfstream_id_t *e = &s->ids[i];
+        if (e->type == type && e->hi2 == hi2 && e->hi == hi && e->lo == lo) {
+            return false;
+        }
+    }
+
+    // full list, forget the oldest one
+    if (s->id_count == LFSTREAM_MAX_IDS) {
+        memmove(s->ids, s->ids + 1, sizeof(lfstream_id_t) * (LFSTREAM_MAX_IDS - 1));
+        s->id_count--;
+    }
+
+    lfstream_id_t *e = &s->ids[s->id_count++];
+    e->type = type;
+    e->hi2 = hi2;
+    e->hi = hi;
+    e->lo = lo;
+    e->sample = s->total;
+    snprintf(e->raw, sizeof(e->raw), "%s", raw);
+    return (s->quiet == false);
+}
+
+static bool lfstream_em410x(lfstream_t *s) {
+    size_t size = s->fill;
+    size_t idx = 0;
+    int clk = 0, invert = 0;
+    uint32_t hi = 0;
+    uint64_t lo = 0;
+
+    memcpy(s->work, s->window, s->fill);
+    int errCnt = askdemod(s->work, &size, &clk, &invert, 20, 0, 1);
+    if (errCnt < 0 || errCnt > 50) {
+        return false;
+    }
+
+    int type = Em410xDecode(s->work, &size, &idx, &hi, &lo);
+    if (type <= 0) {
+        return false;
+    }
+
+    char raw[27];
+    if (type & 0x1) {
+        snprintf(raw, sizeof(raw), "%010" PRIX64, lo);
+    } else {
+        snprintf(raw, sizeof(raw), "%06X%016" PRIX64, hi, lo);
+    }
+
+    if (lfstream_report(s, LFSTREAM_EM410X, (uint32_t)type, hi, lo, raw)) {
+        printEM410x(hi, lo, false, type);
+    }
+    return true;
+}
+
+static bool lfstream_hid(lfstream_t *s) {
+    // 50 * 128 * 2 - big enough to catch 2 sequences of largest format
+    size_t size = MIN(12800, s->fill);
+    uint32_t hi2 = 0, hi = 0, lo = 0;
+    int waveIdx = 0;
+
+    memcpy(s->work, s->window, size);
+    int idx = HIDdemodFSK(s->work, &size, &hi2, &hi, &lo, &waveIdx);
+    if (idx <= 0 || lo == 0 || (size != 96 && size != 192)) {
+        return false;
+    }
+
+    char raw[25];
+    snprintf(raw, sizeof(raw), "%08x%08x%08x", hi2, hi, lo);
+
+    if (lfstream_report(s, LFSTREAM_HID, hi2, hi, lo, raw)) {
+        PrintAndLogEx(SUCCESS, "HID Prox raw: " _GREEN_("%s"), raw);
+    }
+    return true;
+}
+
+static bool lfstream_awid(lfstream_t *s) {
+    size_t size = MIN(12800, s->fill);
+    int waveIdx = 0;
+
+    memcpy(s->work, s->window, size);
+    int idx = detectAWID(s->work, &size, &waveIdx);
+    if (idx <= 0 || size != 96) {
+        return false;
+    }
+
+    uint32_t rawHi2 = bytebits_to_byte(s->work + idx, 32);
+    uint32_t rawHi = bytebits_to_byte(s->work + idx + 32, 32);
+    uint32_t rawLo = bytebits_to_byte(s->work + idx + 64, 32);
+
+    // same sanity check as the device side watch loop
+    size = removeParity(s->work, idx + 8, 4, 1, 88);
+    if (size != 66) {
+        return false;
+    }
+
+    char raw[25];
+    snprintf(raw, sizeof(raw), "%08x%08x%08x", rawHi2, rawHi, rawLo);
+
+    if (lfstream_report(s, LFSTREAM_AWID, rawHi2, rawHi, rawLo, raw)) {
+        uint8_t fmtLen = bytebits_to_byte(s->work, 8);
+        PrintAndLogEx(SUCCESS, "AWID - len: " _GREEN_("%u") " raw: " _GREEN_("%s"), fmtLen, raw);
+    }
+    return true;
+}
+
+static bool lfstream_indala(lfstream_t *s) {
+    size_t size = s->fill;
+    int clk = 0, invert = 0;
+
+    memcpy(s->work, s->window, s->fill);
+    int errCnt = pskRawDemod(s->work, &size, &clk, &invert);
+    if (errCnt < 0 || errCnt > 100) {
+        return false;
+    }
+
+    uint8_t inv = 0;
+    int idx = detectIndala(s->work, &size, &inv);
+    if (idx < 0 || (size != 64 && size != 224)) {
+        return false;
+    }
+
+    // to reduce false positives, an all zero frame isn't a tag
+    size_t cnt_zeros = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (s->work[idx + i] == 0) {
+            cnt_zeros++;
+        }
+    }
+    if (cnt_zeros * 100 / size > 95) {
+        return false;
+    }
+
+    uint32_t uid[7] = {0};
+    for (size_t i = 0; i < size / 32; i++) {
+        uid[i] = bytebits_to_byte(s->work + idx + (i * 32), 32);
+    }
+
+    // 224b ids are told apart by their last words, the first ones are mostly preamble
+    uint32_t key_hi = (size == 64) ? uid[0] : uid[4];
+    uint64_t key_lo = (size == 64) ? uid[1] : ((uint64_t)uid[5] << 32) | uid[6];
+
+    char raw[57] = {0};
+    for (size_t i = 0; i < size / 32; i++) {
+        snprintf(raw + (i * 8), sizeof(raw) - (i * 8), "%08x", uid[i]);
+    }
+
+    if (lfstream_report(s, LFSTREAM_INDALA, (uint32_t)size, key_hi, key_lo, raw)) {
+        PrintAndLogEx(SUCCESS, "Indala (%zub) raw: " _GREEN_("%s"), size, raw);
+    }
+    return true;
+}
+
+static void lfstream_scan(lfstream_t *s) {
+    s->fresh = 0;
+
+    // short windows give PSK and ASK clock detection too little to lock on to
+    if (s->fill < LFSTREAM_MIN_FILL) {
+        return;
+    }
+
+    computeSignalProperties(s->window, s->fill);
+    if (getSignalProperties()->isnoise) {
+        return;
+    }
+
+    // FSK first, ASK demod happily locks on to FSK signals
+    if (lfstream_hid(s)) return;
+    if (lfstream_awid(s)) return;
+    if (lfstream_em410x(s)) return;
+    lfstream_indala(s);
+}
+
+static void lfstream_add(lfstream_t *s, uint8_t sample) {
+    if (s->fill == LFSTREAM_WINDOW) {
+        // drop the oldest step worth of samples to make room
+        memmove(s->window, s->window + LFSTREAM_STEP, LFSTREAM_WINDOW - LFSTREAM_STEP);
+        s->fill -= LFSTREAM_STEP;
+    }
+    s->window[s->fill++] = sample;
+    s->fresh++;
+    s->total++;
+}
+
+/**
+ * @brief Feed a chunk of raw sample data, packed as configured with `lf config --bps`
+ *
+ * @param data raw bytes as received from the device
+ * @param len number of bytes
+ * @return number of scans run over the window
+ */
+int lfstream_push(lfstream_t *s, const uint8_t *data, size_t len) {
+
+    // samples which will be shifted out again before the end of this chunk aren't worth a scan
+    uint64_t samples = ((uint64_t)len * 8 + s->acc_bits) / s->bits_per_sample;
+    uint64_t skip_until = s->total + ((samples > LFSTREAM_WINDOW) ? samples - LFSTREAM_WINDOW : 0);
+
+    int scans = 0;
+    for (size_t i = 0; i < len; i++) {
+
+        if (s->bits_per_sample == 8) {
+            lfstream_add(s, data[i]);
+        } else {
+            // samples are MSB first and may straddle byte boundaries
+            for (int8_t b = 7; b >= 0; b--) {
+                s->acc |= ((data[i] >> b) & 1) << (7 - s->acc_bits);
+                if (++s->acc_bits == s->bits_per_sample) {
+                    lfstream_add(s, s->acc);
+                    s->acc = 0;
+                    s->acc_bits = 0;
+                }
+            }
+        }
+
+        if (s->fresh >= LFSTREAM_STEP && s->total >= skip_until) {
+            lfstream_scan(s);
+            scans++;
+        }
+    }
+    return scans;
+}
+
+// raw_data_cb_t adaptor, arg is the lfstream_t
+void lfstream_push_cb(const uint8_t *data, size_t len, void *arg) {
+    lfstream_push((lfstream_t *)arg, data, len);
+}
+
+/**
+ * @brief Print the ids seen since lfstream_init
+ */
+void lfstream_summary(const lfstream_t *s) {
+    if (s->id_count == 0) {
+        PrintAndLogEx(INFO, "No EM 410x / HID / AWID / Indala tag seen");
+        return;
+    }
+    PrintAndLogEx(SUCCESS, "Seen " _YELLOW_("%u") " tag(s)", s->id_count);
+    for (uint8_t i = 0; i < s->id_count; i++) {
+        const lfstream_id_t *e = &s->ids[i];
+        PrintAndLogEx(INFO, "  %-8s first seen at sample %" PRIu64, lfstream_name(e->type), e->sample);
+    }
+}
@@ -0,0 +1,72 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Incremental LF demodulation of real-time sample streams
+//-----------------------------------------------------------------------------
+
+#ifndef LFSTREAM_H__
+#define LFSTREAM_H__
+
+#include "common.h"
+
+// big enough to hold two frames of the longest supported format (EM410x 128b, RF/64)
+#define LFSTREAM_WINDOW     16384
+// rescan the window after this many new samples
+#define LFSTREAM_STEP       2048
+// don't scan before the window holds this many samples
+#define LFSTREAM_MIN_FILL   8192
+#define LFSTREAM_MAX_IDS    16
+
+typedef enum {
+    LFSTREAM_EM410X = 0,
+    LFSTREAM_HID,
+    LFSTREAM_AWID,
+    LFSTREAM_INDALA,
+} lfstream_tag_t;
+
+typedef struct {
+    lfstream_tag_t type;
+    uint32_t hi2;
+    uint32_t hi;
+    uint64_t lo;
+    uint64_t sample;        // stream position where the id was first seen
+    char raw[57];           // hex, up to 224 bits
+} lfstream_id_t;
+
+typedef struct {
+    uint8_t window[LFSTREAM_WINDOW];
+    uint8_t work[LFSTREAM_WINDOW];
+    size_t fill;            // valid samples in window
+    size_t fresh;           // samples added since the last scan
+    uint64_t total;         // samples consumed since lfstream_init
+
+    // unpacking of bit packed samples across chunk boundaries
+    uint8_t bits_per_sample;
+    uint8_t acc;
+    uint8_t acc_bits;
+
+    lfstream_id_t ids[LFSTREAM_MAX_IDS];
+    uint8_t id_count;
+    bool quiet;             // only collect ids, don't print them
+} lfstream_t;
+
+void lfstream_init(lfstream_t *s, uint8_t bits_per_sample);
+void lfstream_restart(lfstream_t *s, uint8_t bits_per_sample);
+int lfstream_push(lfstream_t *s, const uint8_t *data, size_t len);
+void lfstream_push_cb(const uint8_t *data, size_t len, void *arg);
+void lfstream_summary(const lfstream_t *s);
+const char *lfstream_name(lfstream_tag_t type);
+
+#endif
@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced iClass cipher
+//
+// Follows the byte oriented form of armsrc/optimized_cipher.c.  Register bit n
+// (LSB = 0) of every slice sits in vector [n], so the key byte lookup
+// k[select(...)] becomes a three level multiplexer and the two 8 bit additions
+// ripple carry adders.
+//-----------------------------------------------------------------------------
+#include "cipher_bs.h"
+
+#include <string.h>
+#include <stdbool.h>
+#include "cipher.h"
+#include "ui.h"
+
+typedef uint64_t __attribute__((vector_size(ICLASS_BS_SLICES / 8))) iclass_bs_t;
+
+typedef struct {
+    iclass_bs_t l[8];
+    iclass_bs_t r[8];
+    iclass_bs_t b[8];
+    iclass_bs_t t[16];
+} iclass_bs_state_t;
+
+static const iclass_bs_t bs_zero = {0};
+
+static inline iclass_bs_t bs_const(uint32_t bit) {
+    return bit ? ~bs_zero : bs_zero;
+}
+
+// out = a + b,  8 bit
+static inline void bs_add8(iclass_bs_t *out, const iclass_bs_t *a, const iclass_bs_t *b) {
+    iclass_bs_t carry = bs_zero;
+    for (int i = 0; i < 8; i++) {
+        iclass_bs_t x = a[i] ^ b[i];
+        iclass_bs_t sum = x ^ carry;
+        carry = (a[i] & b[i]) | (carry & x);
+        out[i] = sum;
+    }
+}
+
+// out = a + c,  8 bit constant
+static inline void bs_add8_const(iclass_bs_t *out, const iclass_bs_t *a, uint8_t c) {
+    iclass_bs_t b[8];
+    for (int i = 0; i < 8; i++) {
+        b[i] = bs_const((c >> i) & 1);
+    }
+    bs_add8(out, a, b);
+}
+
+// one step of the cipher,  opt_successor() on all slices
+static inline void bs_successor(const iclass_bs_t k[8][8], iclass_bs_state_t *s, iclass_bs_t y) {
+
+    const iclass_bs_t *r = s->r;
+
+    // T(t) = t15 ^ t14 ^ t10 ^ t8 ^ t5 ^ t4 ^ t1 ^ t0
+    iclass_bs_t Tt = s->t[15] ^ s->t[14] ^ s->t[10] ^ s->t[8] ^ s->t[5] ^ s->t[4] ^ s->t[1] ^ s->t[0];
+    iclass_bs_t t15 = Tt ^ r[7] ^ r[3];
+
+    // B(b) ^ r7 (paper bit numbering,  r7 is the LSB)
+    iclass_bs_t b7 = s->b[0] ^ s->b[4] ^ s->b[5] ^ s->b[6] ^ r[0];
+
+    // select(T(t), y, r),  paper bit ri is r[7 - i] here
+    iclass_bs_t z0 = (r[7] & r[5]) ^ (r[6] & ~r[4]) ^ (r[5] | r[3]);
+    iclass_bs_t z1 = (r[7] | r[5]) ^ (r[2] | r[0]) ^ r[6] ^ r[1] ^ Tt ^ y;
+    iclass_bs_t z2 = (r[4] & ~r[2]) ^ (r[3] & r[1]) ^ r[0] ^ Tt;
+
+    for (int i = 0; i < 15; i++) {
+        s->t[i] = s->t[i + 1];
+    }
+    s->t[15] = t15;
+
+    for (int i = 0; i < 7; i++) {
+        s->b[i] = s->b[i + 1];
+    }
+    s->b[7] = b7;
+
+    // k[z0 z1 z2] ^ b'
+    iclass_bs_t kb[8];
+    for (int i = 0; i < 8; i++) {
+        iclass_bs_t m0 = k[0][i] ^ ((k[0][i] ^ k[1][i]) & z2);
+        iclass_bs_t m1 = k[2][i] ^ ((k[2][i] ^ k[3][i]) & z2);
+        iclass_bs_t m2 = k[4][i] ^ ((k[4][i] ^ k[5][i]) & z2);
+        iclass_bs_t m3 = k[6][i] ^ ((k[6][i] ^ k[7][i]) & z2);
+        m0 ^= (m0 ^ m1) & z1;
+        m2 ^= (m2 ^ m3) & z1;
+        m0 ^= (m0 ^ m2) & z0;
+        kb[i] = m0 ^ s->b[i];
+    }
+
+    // r' = (k[select] ^ b') + l,  l' = r' + r
+    iclass_bs_t old_r[8];
+    memcpy(old_r, s->r, sizeof(old_r));
+    bs_add8(s->r, kb, s->l);
+    bs_add8(s->l, s->r, old_r);
+}
+
+void doMAC_bs(const uint8_t *cc_nr, const uint8_t *div_keys, size_t count, uint8_t *macs) {
+    if (count > ICLASS_BS_SLICES) {
+        count = ICLASS_BS_SLICES;
+    }
+
+    // transpose keys,  k[byte][bit]
+    iclass_bs_t k[8][8];
+    memset(k, 0, sizeof(k));
+    for (size_t n = 0; n < count; n++) {
+        const uint8_t *key = div_keys + (n * 8);
+        for (int j = 0; j < 8; j++) {
+            for (int i = 0; i < 8; i++) {
+                k[j][i][n >> 6] |= (uint64_t)((key[j] >> i) & 1) << (n & 0x3f);
+            }
+        }
+    }
+
+    // l = (k0 ^ 0x4c) + 0xEC,  r = (k0 ^ 0x4c) + 0x21,  b = 0x4c,  t = 0xE012
+    iclass_bs_state_t s;
+    iclass_bs_t k0[8];
+    for (int i = 0; i < 8; i++) {
+        k0[i] = k[0][i] ^ bs_const((0x4c >> i) & 1);
+        s.b[i] = bs_const((0x4c >> i) & 1);
+    }
+    for (int i = 0; i < 16; i++) {
+        s.t[i] = bs_const((0xE012 >> i) & 1);
+    }
+    bs_add8_const(s.l, k0, 0xEC);
+    bs_add8_const(s.r, k0, 0x21);
+
+    // input bits LSB first, byte by byte
+    for (int j = 0; j < 12; j++) {
+        for (int i = 0; i < 8; i++) {
+            bs_successor((const iclass_bs_t (*)[8])k, &s, bs_const((cc_nr[j] >> i) & 1));
+        }
+    }
+
+    // output is r bit 2 before each step,  LSB first
+    iclass_bs_t out[32];
+    for (int i = 0; i < 32; i++) {
+        out[i] = s.r[2];
+        bs_successor((const iclass_bs_t (*)[8])k, &s, bs_zero);
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        uint8_t *mac = macs + (n * 4);
+        for (int j = 0; j < 4; j++) {
+            uint8_t v = 0;
+            for (int i = 0; i < 8; i++) {
+                v |= ((out[(j * 8) + i][n >> 6] >> (n & 0x3f)) & 1) << i;
+            }
+            mac[j] = v;
+        }
+    }
+}
+
+int testMAC_bs(void) {
+    PrintAndLogEx(SUCCESS, "Testing bitsliced MAC calculation...");
+
+    uint8_t cc_nr[] = {0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x12, 0x34, 0x56, 0x78};
+
+    // a full batch of keys from a fixed xorshift,  compared with the reference doMAC
+    uint8_t keys[ICLASS_BS_SLICES * 8];
+    uint8_t macs[ICLASS_BS_SLICES * 4];
+    uint32_t x = 0x2545F491;
+    for (size_t i = 0; i < sizeof(keys); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        keys[i] = x & 0xFF;
+    }
+
+    doMAC_bs(cc_nr, keys, ICLASS_BS_SLICES, macs);
+
+    for (size_t n = 0; n < ICLASS_BS_SLICES; n++) {
+        uint8_t mac[4] = {0};
+        doMAC(cc_nr, keys + (n * 8), mac);
+        if (memcmp(mac, macs + (n * 4), 4) != 0) {
+            PrintAndLogEx(FAILED, "    bitsliced MAC calculation ( %s ) key %zu", _RED_("fail"), n);
+            return PM3_ESOFT;
+        }
+    }
+
+    PrintAndLogEx(SUCCESS, "    bitsliced MAC calculation, %d slices ( %s )", ICLASS_BS_SLICES, _GREEN_("ok"));
+    return PM3_SUCCESS;
+}
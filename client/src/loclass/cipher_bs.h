@@ -0,0 +1,50 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced iClass cipher, computes MACs for ICLASS_BS_SLICES keys side by side.
+//
+// All keys share the input (CC / NR), every register bit is a vector with one
+// bit per key.  cipher.c stays the reference,  doMAC_bs gives the same MACs.
+//-----------------------------------------------------------------------------
+#ifndef CIPHER_BS_H
+#define CIPHER_BS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// widest integer vector the build targets, same choice as crypto1_bs
+#if defined(__AVX512F__)
+#define ICLASS_BS_SLICES 512
+#elif defined(__AVX2__)
+#define ICLASS_BS_SLICES 256
+#elif defined(__SSE2__) || (defined(__ARM_NEON) && !defined(NOSIMD_BUILD))
+#define ICLASS_BS_SLICES 128
+#else
+#define ICLASS_BS_SLICES 64
+#endif
+
+/**
+ * @brief Reader MACs of up to ICLASS_BS_SLICES diversified keys over the same CC/NR
+ *
+ * @param cc_nr 12 bytes, as for doMAC
+ * @param div_keys count x 8 bytes
+ * @param count number of keys, larger counts are clamped to ICLASS_BS_SLICES
+ * @param macs count x 4 bytes out
+ */
+void doMAC_bs(const uint8_t *cc_nr, const uint8_t *div_keys, size_t count, uint8_t *macs);
+
+int testMAC_bs(void);
+
+#endif // CIPHER_BS_H
@@ -39,11 +39,13 @@
 #include <time.h>
 #include "cipherutils.h"
 #include "cipher.h"
+#include "cipher_bs.h"
 #include "ikeys.h"
 #include "elite_crack.h"
 #include "fileutils.h"
 #include "mbedtls/des.h"
 #include "util_posix.h"
+#include "threadpool.h"
 
 /**
  * @brief Permutes a key from standard NIST format to Iclass specific format
@@ -172,12 +174,11 @@ static void rk(const uint8_t *key, uint8_t n, uint8_t *outp_key) {
     }
 }
 
-static mbedtls_des_context ctx_enc;
-static mbedtls_des_context ctx_dec;
-
+// local DES contexts,  so hash2 can run on several threads at once
 static void desdecrypt_iclass(uint8_t *iclass_key, uint8_t *input, uint8_t *output) {
     uint8_t key_std_format[8] = {0};
     permutekey_rev(iclass_key, key_std_format);
+    mbedtls_des_context ctx_dec;
     mbedtls_des_setkey_dec(&ctx_dec, key_std_format);
     mbedtls_des_crypt_ecb(&ctx_dec, input, output);
 }
@@ -185,6 +186,7 @@ static void desdecrypt_iclass(uint8_t *iclass_key, uint8_t *input, uint8_t *outp
 static void desencrypt_iclass(uint8_t *iclass_key, uint8_t *input, uint8_t *output) {
     uint8_t key_std_format[8] = {0};
     permutekey_rev(iclass_key, key_std_format);
+    mbedtls_des_context ctx_enc;
     mbedtls_des_setkey_enc(&ctx_enc, key_std_format);
     mbedtls_des_crypt_ecb(&ctx_enc, input, output);
 }
@@ -287,220 +289,402 @@ static int _readFromDump(uint8_t dump[], dumpdata *item, uint8_t i) {
 }
 */
 
+/*
+ * Every dump item becomes a job.  A job is ready when at most three of its key table
+ * bytes are still unknown and none of them is being cracked by another job,  its
+ * candidates are then handed to the worker threads in slices.  So all items run
+ * concurrently as far as their bytes allow,  and a thread that runs out of work on
+ * one job continues on another.  Cheap jobs go first: their bytes often take one
+ * byte off a three byte job that would otherwise cost 256 times more.
+ */
+#define LOCLASS_SLICE_SIZE  0x10000
+
+typedef enum {
+    LOCLASS_JOB_WAITING,
+    LOCLASS_JOB_RUNNING,
+    LOCLASS_JOB_DONE,
+} loclass_job_state_t;
+
 typedef struct {
-    int thread_idx;
-    uint32_t endmask;
+    loclass_dumpdata_t item;
+    uint8_t key_index[8];
     uint8_t numbytes_to_recover;
     uint8_t bytes_to_recover[3];
-    uint8_t key_index[8];
-    uint16_t keytable[128];
-    loclass_dumpdata_t item;
-} loclass_thread_arg_t;
+    uint8_t key_sel[8];         // known key bytes,  key_pos[] marks the ones brute forced
+    uint8_t key_pos[8];         // index into bytes_to_recover,  0xFF for known bytes
+    loclass_job_state_t state;
+    uint32_t num_slices;
+    uint32_t next_slice;
+    uint32_t slices_done;
+    bool found;
+} loclass_job_t;
 
 typedef struct {
-    uint8_t values[3];
-} loclass_thread_ret_t;
-
-static size_t loclass_tc = 1;
-static int loclass_found = 0;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    loclass_job_t *jobs;
+    size_t count;
+    size_t remaining;
+    size_t running;
+    uint16_t *keytable;
+    int res;
+    uint64_t tested;
+    uint64_t start_time;
+    uint64_t last_print;
+} loclass_sched_t;
+
+// unknown key table bytes of a job,  false if one of them is being cracked right now
+static bool loclass_job_unknown(const loclass_job_t *job, const uint16_t *keytable, uint8_t bytes[8], uint8_t *num) {
+    *num = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        uint16_t v = keytable[job->key_index[i]];
+        if (v & LOCLASS_CRACKED) continue;
+        if (v & LOCLASS_BEING_CRACKED) return false;
 
-static void *bf_thread(void *thread_arg) {
+        bool dup = false;
+        for (uint8_t j = 0; j < *num; j++) {
+            dup |= (bytes[j] == job->key_index[i]);
+        }
+        if (dup == false) {
+            bytes[(*num)++] = job->key_index[i];
+        }
+    }
+    return true;
+}
 
-    loclass_thread_arg_t *targ = (loclass_thread_arg_t *)thread_arg;
-    const uint32_t endmask = targ->endmask;
-    const uint8_t numbytes_to_recover = targ->numbytes_to_recover;
-    uint32_t brute = targ->thread_idx;
+// all bytes known,  only check the item against them
+static void loclass_job_verify(loclass_job_t *job, const uint16_t *keytable) {
+    uint8_t key_sel[8], key_sel_p[8], div_key[8], mac[4];
+    for (uint8_t i = 0; i < 8; i++) {
+        key_sel[i] = keytable[job->key_index[i]] & 0xFF;
+    }
+    permutekey_rev(key_sel, key_sel_p);
+    diversifyKey(job->item.csn, key_sel_p, div_key);
+    doMAC(job->item.cc_nr, div_key, mac);
+    if (memcmp(mac, job->item.mac, 4) != 0) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "CSN %s doesn't match the recovered key table bytes", sprint_hex(job->item.csn, 8));
+    }
+}
 
-    uint8_t csn[8];
-    uint8_t cc_nr[12];
-    uint8_t mac[4];
-    uint8_t key_index[8];
-    uint8_t bytes_to_recover[3];
-    uint16_t keytable[128];
+static void loclass_job_start(loclass_job_t *job, uint16_t *keytable, const uint8_t *bytes, uint8_t num) {
+    job->numbytes_to_recover = num;
+    memcpy(job->bytes_to_recover, bytes, num);
+    for (uint8_t i = 0; i < num; i++) {
+        keytable[bytes[i]] |= LOCLASS_BEING_CRACKED;
+    }
 
-    memcpy(csn, targ->item.csn, sizeof(csn));
-    memcpy(cc_nr, targ->item.cc_nr, sizeof(cc_nr));
-    memcpy(mac, targ->item.mac, sizeof(mac));
-    memcpy(key_index, targ->key_index, sizeof(key_index));
-    memcpy(bytes_to_recover, targ->bytes_to_recover, sizeof(bytes_to_recover));
-    memcpy(keytable, targ->keytable, sizeof(keytable));
+    for (uint8_t i = 0; i < 8; i++) {
+        job->key_sel[i] = keytable[job->key_index[i]] & 0xFF;
+        job->key_pos[i] = 0xFF;
+        for (uint8_t j = 0; j < num; j++) {
+            if (job->key_index[i] == bytes[j]) {
+                job->key_pos[i] = j;
+            }
+        }
+    }
 
-    while (!(brute & endmask)) {
+    uint32_t space = 1 << (8 * num);
+    job->num_slices = (space + LOCLASS_SLICE_SIZE - 1) / LOCLASS_SLICE_SIZE;
+    job->next_slice = 0;
+    job->slices_done = 0;
+    job->state = LOCLASS_JOB_RUNNING;
+}
 
-        int found = __atomic_load_n(&loclass_found, __ATOMIC_SEQ_CST);
+// start every job that became ready,  called with the lock held
+static void loclass_start_jobs(loclass_sched_t *s) {
 
-        if (found != 0xFF) return NULL;
+    for (uint8_t n = 0; n <= 3; n++) {
 
-        //Update the keytable with the brute-values
-        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] &= 0xFF00;
-            keytable[bytes_to_recover[i]] |= (brute >> (i * 8) & 0xFF);
+        // three byte jobs wait while cheaper ones may still crack some of their bytes
+        if (n == 3) {
+            for (size_t i = 0; i < s->count; i++) {
+                if (s->jobs[i].state == LOCLASS_JOB_RUNNING && s->jobs[i].numbytes_to_recover < 3) {
+                    return;
+                }
+            }
         }
 
-        uint8_t key_sel[8] = {0};
+        for (size_t i = 0; i < s->count; i++) {
+            loclass_job_t *job = &s->jobs[i];
+            if (job->state != LOCLASS_JOB_WAITING) continue;
 
-        // Piece together the key
-        key_sel[0] = keytable[key_index[0]] & 0xFF;
-        key_sel[1] = keytable[key_index[1]] & 0xFF;
-        key_sel[2] = keytable[key_index[2]] & 0xFF;
-        key_sel[3] = keytable[key_index[3]] & 0xFF;
-        key_sel[4] = keytable[key_index[4]] & 0xFF;
-        key_sel[5] = keytable[key_index[5]] & 0xFF;
-        key_sel[6] = keytable[key_index[6]] & 0xFF;
-        key_sel[7] = keytable[key_index[7]] & 0xFF;
+            uint8_t bytes[8];
+            uint8_t num = 0;
+            if (loclass_job_unknown(job, s->keytable, bytes, &num) == false || num != n) continue;
 
-        // Permute from iclass format to standard format
+            if (num == 0) {
+                loclass_job_verify(job, s->keytable);
+                job->state = LOCLASS_JOB_DONE;
+                s->remaining--;
+                continue;
+            }
 
-        uint8_t key_sel_p[8] = {0};
-        permutekey_rev(key_sel, key_sel_p);
+            loclass_job_start(job, s->keytable, bytes, num);
+            s->running++;
+        }
+    }
+}
 
-        // Diversify
-        uint8_t div_key[8] = {0};
-        diversifyKey(csn, key_sel_p, div_key);
+// nothing runs and nothing can start,  the remaining items need more than three bytes
+static void loclass_check_stuck(loclass_sched_t *s) {
+    if (s->running || s->remaining == 0 || s->res != PM3_SUCCESS) {
+        return;
+    }
 
-        // Calc mac
-        uint8_t calculated_MAC[4] = {0};
-        doMAC(cc_nr, div_key, calculated_MAC);
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->jobs[i].state == LOCLASS_JOB_WAITING) {
+            PrintAndLogEx(NORMAL, "");
+            PrintAndLogEx(FAILED, "The CSN requires > 3 byte bruteforce, not supported");
+            PrintAndLogEx(INFO, "CSN   %s", sprint_hex(s->jobs[i].item.csn, 8));
+            PrintAndLogEx(INFO, "HASH1 %s", sprint_hex(s->jobs[i].key_index, 8));
+            PrintAndLogEx(NORMAL, "");
+            break;
+        }
+    }
+    __atomic_store_n(&s->res, PM3_ESOFT, __ATOMIC_SEQ_CST);
+}
 
-        // success
-        if (memcmp(calculated_MAC, mac, 4) == 0) {
+// candidates still to test,  running jobs plus the waiting ones in the order they would start
+static uint64_t loclass_work_left(const loclass_sched_t *s) {
+    uint64_t left = 0;
+    bool known[128] = {false};
+    bool planned[s->count];
 
-            loclass_thread_ret_t *r = (loclass_thread_ret_t *)calloc(sizeof(loclass_thread_ret_t), sizeof(uint8_t));
+    for (size_t i = 0; i < 128; i++) {
+        known[i] = (s->keytable[i] & (LOCLASS_CRACKED | LOCLASS_BEING_CRACKED)) != 0;
+    }
 
-            for (uint8_t i = 0 ; i < numbytes_to_recover; i++) {
-                r->values[i] = keytable[bytes_to_recover[i]] & 0xFF;
-            }
-            __atomic_store_n(&loclass_found, targ->thread_idx, __ATOMIC_SEQ_CST);
-            pthread_exit((void *)r);
+    for (size_t i = 0; i < s->count; i++) {
+        const loclass_job_t *job = &s->jobs[i];
+        planned[i] = (job->state != LOCLASS_JOB_WAITING);
+        if (job->state == LOCLASS_JOB_RUNNING) {
+            uint32_t space = 1 << (8 * job->numbytes_to_recover);
+            left += (uint64_t)(job->num_slices - job->slices_done) * MIN(space, LOCLASS_SLICE_SIZE);
         }
+    }
 
-        brute += loclass_tc;
-
-#define _CLR_ "\x1b[0K"
-
-        if (numbytes_to_recover == 3) {
-            if ((brute > 0) && ((brute & 0xFFFF) == 0)) {
-                PrintAndLogEx(INPLACE, "[ %02x %02x %02x ] %8u / %u", bytes_to_recover[0], bytes_to_recover[1], bytes_to_recover[2], brute, 0xFFFFFF);
+    while (true) {
+        size_t best = s->count;
+        uint8_t best_num = 4;
+        uint8_t best_bytes[8];
+        for (size_t i = 0; i < s->count; i++) {
+            if (planned[i]) continue;
+            uint8_t bytes[8];
+            uint8_t num = 0;
+            for (uint8_t j = 0; j < 8 && num < 4; j++) {
+                uint8_t idx = s->jobs[i].key_index[j];
+                if (known[idx] || memchr(bytes, idx, num)) continue;
+                bytes[num++] = idx;
             }
-        } else if (numbytes_to_recover == 2) {
-            if ((brute > 0) && ((brute & 0x3F) == 0))
-                PrintAndLogEx(INPLACE, "[ %02x %02x ] %5u / %u" _CLR_, bytes_to_recover[0], bytes_to_recover[1], brute, 0xFFFF);
-        } else {
-            if ((brute > 0) && ((brute & 0x1F) == 0))
-                PrintAndLogEx(INPLACE, "[ %02x ] %3u / %u" _CLR_, bytes_to_recover[0], brute, 0xFF);
+            if (num < best_num) {
+                best = i;
+                best_num = num;
+                memcpy(best_bytes, bytes, num);
+            }
+        }
+        if (best == s->count) {
+            break;
+        }
+        planned[best] = true;
+        for (uint8_t j = 0; j < best_num; j++) {
+            known[best_bytes[j]] = true;
         }
+        left += (best_num) ? (1 << (8 * best_num)) : 0;
     }
-    pthread_exit(NULL);
+    return left;
+}
+
+static void loclass_print_progress(loclass_sched_t *s, bool force) {
+    uint64_t now = msclock();
+    if (force == false && now - s->last_print < 1000) {
+        return;
+    }
+    s->last_print = now;
+
+    uint64_t left = loclass_work_left(s);
+    uint64_t total = s->tested + left;
+    uint64_t eta = (s->tested) ? ((now - s->start_time) * left / s->tested) / 1000 : 0;
 
-    void *dummyptr = NULL;
-    return dummyptr;
+    print_progress(s->tested, total, STYLE_BAR);
+    printf(" %3u%% ETA %02u:%02u:%02u", (uint32_t)((total) ? (s->tested * 100 / total) : 100),
+           (uint32_t)(eta / 3600), (uint32_t)((eta / 60) % 60), (uint32_t)(eta % 60));
+    fflush(stdout);
 }
 
-int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
+// test one slice of a job's candidates,  true and the candidate in hit on a MAC match
+static bool loclass_run_slice(loclass_sched_t *s, loclass_job_t *job, uint32_t slice, uint64_t *tested, uint32_t *hit) {
+    const uint32_t space = 1 << (8 * job->numbytes_to_recover);
+    const uint32_t first = slice * LOCLASS_SLICE_SIZE;
+    const uint32_t last = MIN(first + LOCLASS_SLICE_SIZE, space);
 
-    // reset thread signals
-    loclass_found = 0xFF;
+    uint8_t div_keys[ICLASS_BS_SLICES * 8];
+    uint8_t macs[ICLASS_BS_SLICES * 4];
 
-    //Get the key index (hash1)
-    uint8_t key_index[8] = {0};
-    hash1(item.csn, key_index);
+    for (uint32_t brute = first; brute < last; brute += ICLASS_BS_SLICES) {
 
-    /*
-     * Determine which bytes to retrieve. A hash is typically
-     * 01010000454501
-     * We go through that hash, and in the corresponding keytable, we put markers
-     * on what state that particular index is:
-     * - CRACKED (this has already been cracked)
-     * - BEING_CRACKED (this is being bruteforced now)
-     * - CRACK_FAILED (self-explaining...)
-     *
-     * The markers are placed in the high area of the 16 bit key-table.
-     * Only the lower eight bits correspond to the (hopefully cracked) key-value.
-     **/
-    uint8_t bytes_to_recover[3] = {0};
-    uint8_t numbytes_to_recover = 0;
-    for (uint8_t i = 0; i < 8; i++) {
-        if (keytable[key_index[i]] & (LOCLASS_CRACKED | LOCLASS_BEING_CRACKED)) continue;
+        // another slice found it or the attack failed
+        if (__atomic_load_n(&job->found, __ATOMIC_SEQ_CST) || __atomic_load_n(&s->res, __ATOMIC_SEQ_CST) != PM3_SUCCESS) {
+            return false;
+        }
 
-        bytes_to_recover[numbytes_to_recover++] = key_index[i];
-        keytable[key_index[i]] |= LOCLASS_BEING_CRACKED;
+        uint32_t cnt = MIN(last - brute, ICLASS_BS_SLICES);
+        for (uint32_t n = 0; n < cnt; n++) {
+            // Piece together the key
+            uint8_t key_sel[8];
+            for (uint8_t i = 0; i < 8; i++) {
+                key_sel[i] = (job->key_pos[i] == 0xFF) ? job->key_sel[i] : ((brute + n) >> (job->key_pos[i] * 8)) & 0xFF;
+            }
 
-        if (numbytes_to_recover > 3) {
-            PrintAndLogEx(FAILED, "The CSN requires > 3 byte bruteforce, not supported");
-            PrintAndLogEx(INFO, "CSN   %s", sprint_hex(item.csn, 8));
-            PrintAndLogEx(INFO, "HASH1 %s", sprint_hex(key_index, 8));
-            PrintAndLogEx(NORMAL, "");
-            //Before we exit, reset the 'BEING_CRACKED' to zero
-            keytable[bytes_to_recover[0]]  &= ~LOCLASS_BEING_CRACKED;
-            keytable[bytes_to_recover[1]]  &= ~LOCLASS_BEING_CRACKED;
-            keytable[bytes_to_recover[2]]  &= ~LOCLASS_BEING_CRACKED;
-            return PM3_ESOFT;
+            // Permute from iclass format to standard format
+            uint8_t key_sel_p[8] = {0};
+            permutekey_rev(key_sel, key_sel_p);
+
+            // Diversify
+            diversifyKey(job->item.csn, key_sel_p, div_keys + (n * 8));
         }
-    }
 
-    if (numbytes_to_recover == 0) {
-        PrintAndLogEx(INFO, "No bytes to recover, exiting");
-        return PM3_ESOFT;
+        // Calc macs
+        doMAC_bs(job->item.cc_nr, div_keys, cnt, macs);
+        *tested += cnt;
+
+        for (uint32_t n = 0; n < cnt; n++) {
+            if (memcmp(macs + (n * 4), job->item.mac, 4) == 0) {
+                *hit = brute + n;
+                return true;
+            }
+        }
     }
+    return false;
+}
 
-    loclass_thread_arg_t args[loclass_tc];
-    // init thread arguments
-    for (size_t i = 0; i < loclass_tc; i++) {
-        args[i].thread_idx = i;
-        args[i].numbytes_to_recover = numbytes_to_recover;
-        args[i].endmask = 1 << 8 * numbytes_to_recover;
+// book a finished slice,  called with the lock held
+static void loclass_finish_slice(loclass_sched_t *s, loclass_job_t *job, bool found, uint32_t hit, uint64_t tested) {
+    s->tested += tested;
+    job->slices_done++;
 
-        memcpy((void *)&args[i].item, (void *)&item, sizeof(loclass_dumpdata_t));
-        memcpy(args[i].bytes_to_recover, bytes_to_recover, sizeof(args[i].bytes_to_recover));
-        memcpy(args[i].key_index, key_index, sizeof(args[i].key_index));
-        memcpy(args[i].keytable, keytable, sizeof(args[i].keytable));
+    if (job->state != LOCLASS_JOB_RUNNING) {
+        return;
     }
 
-    pthread_t threads[loclass_tc];
-    // create threads
-    for (size_t i = 0; i < loclass_tc; i++) {
-        int res = pthread_create(&threads[i], NULL, bf_thread, (void *)&args[i]);
-        if (res) {
-            PrintAndLogEx(NORMAL, "");
-            PrintAndLogEx(WARNING, "Failed to create pthreads. Quitting");
-            return PM3_ESOFT;
+    if (found) {
+        __atomic_store_n(&job->found, true, __ATOMIC_SEQ_CST);
+        for (uint8_t i = 0; i < job->numbytes_to_recover; i++) {
+            s->keytable[job->bytes_to_recover[i]] = ((hit >> (i * 8)) & 0xFF) | LOCLASS_CRACKED;
         }
-    }
-    // wait for threads to terminate:
-    void *ptrs[loclass_tc];
-    for (size_t i = 0; i < loclass_tc; i++)
-        pthread_join(threads[i], &ptrs[i]);
-
-    // was it a success?
-    int res = PM3_SUCCESS;
-    if (loclass_found == 0xFF) {
-        res = PM3_ESOFT;
+    } else if (job->slices_done < job->num_slices) {
+        return;
+    } else {
         PrintAndLogEx(NORMAL, "");
-        PrintAndLogEx(WARNING, "Failed to recover %d bytes using the following CSN", numbytes_to_recover);
-        PrintAndLogEx(INFO, "CSN  %s", sprint_hex(item.csn, 8));
+        PrintAndLogEx(WARNING, "Failed to recover %d bytes using the following CSN", job->numbytes_to_recover);
+        PrintAndLogEx(INFO, "CSN  %s", sprint_hex(job->item.csn, 8));
 
         //Before we exit, reset the 'BEING_CRACKED' to zero
-        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] &= 0xFF;
-            keytable[bytes_to_recover[i]] |= LOCLASS_CRACK_FAILED;
+        for (uint8_t i = 0; i < job->numbytes_to_recover; i++) {
+            s->keytable[job->bytes_to_recover[i]] &= 0xFF;
+            s->keytable[job->bytes_to_recover[i]] |= LOCLASS_CRACK_FAILED;
         }
+        __atomic_store_n(&s->res, PM3_ESOFT, __ATOMIC_SEQ_CST);
+    }
 
-    } else {
-        loclass_thread_ret_t ice = *((loclass_thread_ret_t *)ptrs[loclass_found]);
+    job->state = LOCLASS_JOB_DONE;
+    s->running--;
+    s->remaining--;
 
-        for (uint8_t i = 0; i < numbytes_to_recover; i++) {
-            keytable[bytes_to_recover[i]] = ice.values[i];
-            keytable[bytes_to_recover[i]] &= 0xFF;
-            keytable[bytes_to_recover[i]] |= LOCLASS_CRACKED;
+    if (s->res == PM3_SUCCESS) {
+        loclass_start_jobs(s);
+        loclass_check_stuck(s);
+    }
+    pthread_cond_broadcast(&s->cond);
+}
+
+static void loclass_worker(threadpool_job_t *tp, void *arg, uint32_t index) {
+    (void)tp;
+    (void)index;
+    loclass_sched_t *s = (loclass_sched_t *)arg;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->res == PM3_SUCCESS && s->remaining) {
+
+        // next slice,  cheapest running job first
+        loclass_job_t *job = NULL;
+        for (size_t i = 0; i < s->count; i++) {
+            loclass_job_t *j = &s->jobs[i];
+            if (j->state != LOCLASS_JOB_RUNNING || j->next_slice == j->num_slices) continue;
+            if (job == NULL || j->numbytes_to_recover < job->numbytes_to_recover) {
+                job = j;
+            }
         }
-        for (size_t i = 0; i < loclass_tc; i++) {
-            free(ptrs[i]);
+
+        if (job == NULL) {
+            pthread_cond_wait(&s->cond, &s->lock);
+            continue;
         }
+
+        uint32_t slice = job->next_slice++;
+        pthread_mutex_unlock(&s->lock);
+
+        uint64_t tested = 0;
+        uint32_t hit = 0;
+        bool found = loclass_run_slice(s, job, slice, &tested, &hit);
+
+        pthread_mutex_lock(&s->lock);
+        loclass_finish_slice(s, job, found, hit, tested);
+        loclass_print_progress(s, false);
     }
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+}
 
-    memset(args, 0x00, sizeof(args));
-    memset(threads, 0x00, sizeof(threads));
-    return res;
+// run all items on the client thread pool
+static int loclass_bruteforce(const loclass_dumpdata_t *items, size_t count, uint16_t keytable[]) {
+
+    loclass_job_t *jobs = calloc(count, sizeof(loclass_job_t));
+    if (jobs == NULL) {
+        PrintAndLogEx(WARNING, "failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        memcpy(&jobs[i].item, &items[i], sizeof(loclass_dumpdata_t));
+        //Get the key index (hash1)
+        hash1(jobs[i].item.csn, jobs[i].key_index);
+        jobs[i].state = LOCLASS_JOB_WAITING;
+    }
+
+    loclass_sched_t s = {
+        .jobs = jobs,
+        .count = count,
+        .remaining = count,
+        .keytable = keytable,
+        .res = PM3_SUCCESS,
+        .start_time = msclock(),
+    };
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_cond_init(&s.cond, NULL);
+
+    pthread_mutex_lock(&s.lock);
+    loclass_start_jobs(&s);
+    loclass_check_stuck(&s);
+    pthread_mutex_unlock(&s.lock);
+
+    if (threadpool_run(loclass_worker, &s, threadpool_size()) != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "failed to allocate memory");
+        s.res = PM3_EMALLOC;
+    }
+
+    if (s.res == PM3_SUCCESS) {
+        loclass_print_progress(&s, true);
+    }
+
+    pthread_cond_destroy(&s.cond);
+    pthread_mutex_destroy(&s.lock);
+    free(jobs);
+    return s.res;
+}
+
+int bruteforceItem(loclass_dumpdata_t item, uint16_t keytable[]) {
+    return loclass_bruteforce(&item, 1, keytable);
 }
 
 /**
@@ -721,25 +905,16 @@ int calculateMasterKey(uint8_t first16bytes[], uint8_t kcus[]) {
 int bruteforceDump(uint8_t dump[], size_t dumpsize, uint16_t keytable[]) {
     uint8_t i;
     size_t itemsize = sizeof(loclass_dumpdata_t);
-    loclass_dumpdata_t *attack = (loclass_dumpdata_t *) calloc(itemsize, sizeof(uint8_t));
-    if (attack == NULL) {
-        PrintAndLogEx(WARNING, "failed to allocate memory");
-        return PM3_EMALLOC;
+    size_t itemcnt = dumpsize / itemsize;
+    if (itemcnt == 0) {
+        PrintAndLogEx(WARNING, "no items in dump");
+        return PM3_EINVARG;
     }
 
-    loclass_tc = num_CPUs();
-    PrintAndLogEx(INFO, "bruteforce using " _YELLOW_("%zu") " threads", loclass_tc);
-
-    int res = 0;
+    PrintAndLogEx(INFO, "bruteforce " _YELLOW_("%zu") " items using " _YELLOW_("%u") " threads", itemcnt, threadpool_size());
 
     uint64_t t1 = msclock();
-    for (i = 0 ; i * itemsize < dumpsize ; i++) {
-        memcpy(attack, dump + i * itemsize, itemsize);
-        res = bruteforceItem(*attack, keytable);
-        if (res != PM3_SUCCESS)
-            break;
-    }
-    free(attack);
+    int res = loclass_bruteforce((loclass_dumpdata_t *)dump, itemcnt, keytable);
     t1 = msclock() - t1;
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(SUCCESS, "time " _YELLOW_("%" PRIu64) " seconds", t1 / 1000);
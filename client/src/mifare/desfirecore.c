@@ -906,6 +906,194 @@ int DesfireExchange(DesfireContext_t *ctx, uint8_t cmd, uint8_t *data, size_t da
     return DesfireExchangeEx(false, ctx, cmd, data, datalen, respcode, resp, resplen, true, 0);
 }
 
+// Batched commands go to the card in one CMD_HF_ISO14443A_APDU_BATCH exchange,  their frames are
+// encoded before any answer is in.  That holds without authentication,  in plain communication
+// mode,  and for EV2 secure messaging where MACs and IVs depend on the command counter only.
+// D40 / EV1 chain the IV through the answers and LRP its counters,  those commands go one by one.
+bool DesfireBatchAvailable(DesfireContext_t *ctx, DesfireCommunicationMode commMode) {
+    if (ctx->cmdSet != DCCNativeISO) {
+        return false;
+    }
+
+    switch (ctx->secureChannel) {
+        case DACNone:
+        case DACEV2:
+            return true;
+        case DACd40:
+        case DACEV1:
+        case DACLRP:
+            return (commMode == DCMPlain);
+    }
+    return false;
+}
+
+static bool DesfireBatchEncode(DesfireContext_t *ctx, DesfireBatchCmd_t *c, uint8_t *apdu, int *apdulen) {
+    uint8_t enc[DESFIRE_BATCH_RESP_MAX] = {0};
+    size_t enclen = 0;
+
+    ctx->commMode = c->commMode;
+    DesfireSecureChannelEncode(ctx, c->cmd, c->data, c->datalen, enc, &enclen);
+
+    sAPDU_t sapdu = {
+        .CLA = MFDES_NATIVE_ISO7816_WRAP_CLA,
+        .INS = c->cmd,
+        .P1 = 0,
+        .P2 = 0,
+        .Lc = enclen,
+        .data = enc,
+    };
+    return (APDUEncodeS(&sapdu, false, APDU_INCLUDE_LE_00, apdu, apdulen) == 0);
+}
+
+// the answer of a command,  decoded the way DesfireExchangeISONative() and DesfireCommand() do
+static void DesfireBatchDecode(DesfireContext_t *ctx, DesfireBatchCmd_t *c, const iso14a_apdu_batch_entry_t *e) {
+    if (e->status != PM3_SUCCESS) {
+        c->res = e->status;
+        return;
+    }
+    if (e->len < 2) {
+        c->res = PM3_ECARDEXCHANGE;
+        return;
+    }
+    if (e->len > APDU_RES_LEN) {
+        c->res = PM3_EOVFLOW;
+        return;
+    }
+
+    if (GetAPDULogging()) {
+        PrintAndLogEx(SUCCESS, "<<<< %s", sprint_hex(e->data, e->len));
+    }
+
+    size_t len = e->len - 2;
+    uint16_t sw = (e->data[len] << 8) | e->data[len + 1];
+    c->respcode = ((sw & 0xFF00) == 0x9100) ? (sw & 0xFF) : 0xFF;
+
+    uint8_t data[APDU_RES_LEN] = {0};
+    uint8_t dec[APDU_RES_LEN] = {0};
+    size_t declen = 0;
+
+    // DesfireExchangeEx() decodes an empty answer after a failed exchange,  counters move on the same way
+    if (c->respcode != MFDES_S_OPERATION_OK) {
+        DesfireSecureChannelDecode(ctx, data, 0, 0xFF, dec, &declen);
+        c->res = PM3_EAPDU_FAIL;
+        return;
+    }
+
+    memcpy(data, e->data, len);
+    // in the mode encoding left,  as DesfireExchangeEx() does
+    DesfireSecureChannelDecode(ctx, data, len, c->respcode, dec, &declen);
+
+    if (declen > sizeof(c->resp)) {
+        c->res = PM3_EOVFLOW;
+        return;
+    }
+    memcpy(c->resp, dec, declen);
+    c->resplen = declen;
+    c->res = PM3_SUCCESS;
+}
+
+// Runs cmds in as few device exchanges as fit,  stops at the first failing one.  The context ends up
+// as if they were sent one by one.  Commands must have single frame answers.
+int DesfireExchangeBatch(DesfireContext_t *ctx, DesfireBatchCmd_t *cmds, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        cmds[i].res = PM3_ENODATA;
+        cmds[i].respcode = 0xFF;
+        cmds[i].resplen = 0;
+        if (DesfireBatchAvailable(ctx, cmds[i].commMode) == false) {
+            return PM3_ENOTIMPL;
+        }
+    }
+
+    uint8_t *out = calloc(ISO14A_APDU_BATCH_BUF, sizeof(uint8_t));
+    if (out == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    DesfireCommunicationMode commMode = ctx->commMode;
+    int res = PM3_SUCCESS;
+    size_t pos = 0;
+    while (pos < count && res == PM3_SUCCESS) {
+
+        // encode on a copy of the context,  advanced the way decoding each answer will
+        DesfireContext_t sim = *ctx;
+        uint8_t apdus[PM3_CMD_DATA_SIZE - sizeof(iso14a_apdu_batch_req_t)];
+        uint16_t offsets[UINT8_MAX];
+        int apdus_len = 0;
+        size_t n = 0;
+        while (pos + n < count && n < UINT8_MAX) {
+            uint8_t apdu[APDU_RES_LEN] = {0};
+            int apdulen = 0;
+            DesfireContext_t next = sim;
+            if (DesfireBatchEncode(&next, &cmds[pos + n], apdu, &apdulen) == false) {
+                res = PM3_EAPDU_ENCODEFAIL;
+                break;
+            }
+            if (apdus_len + 2 + apdulen > (int)sizeof(apdus) ||
+                    (n + 1) * (sizeof(iso14a_apdu_batch_entry_t) + DESFIRE_BATCH_RESP_MAX + 2) > ISO14A_APDU_BATCH_BUF) {
+                break;
+            }
+            if (next.secureChannel == DACEV2) {
+                next.cmdCntr++;
+            }
+            sim = next;
+
+            if (GetAPDULogging()) {
+                PrintAndLogEx(SUCCESS, ">>>> %s", sprint_hex(apdu, apdulen));
+            }
+
+            uint16_t len16 = apdulen;
+            memcpy(apdus + apdus_len, &len16, sizeof(len16));
+            memcpy(apdus + apdus_len + 2, apdu, apdulen);
+            offsets[n] = apdus_len + 2;
+            apdus_len += 2 + apdulen;
+            n++;
+        }
+        if (res != PM3_SUCCESS || n == 0) {
+            break;
+        }
+
+        int outlen = 0;
+        uint8_t done = 0;
+        res = ExchangeAPDU14aBatch(apdus, apdus_len, n, false, true, true, out, ISO14A_APDU_BATCH_BUF, &outlen, &done);
+
+        // decode on the real context,  in order,  re-encoding each frame the way it would have been sent
+        int opos = 0;
+        for (uint8_t i = 0; i < done; i++) {
+            const iso14a_apdu_batch_entry_t *e = (const iso14a_apdu_batch_entry_t *)(out + opos);
+            if (opos + (int)sizeof(iso14a_apdu_batch_entry_t) > outlen || opos + (int)sizeof(iso14a_apdu_batch_entry_t) + e->len > outlen) {
+                res = PM3_ESOFT;
+                break;
+            }
+            opos += sizeof(iso14a_apdu_batch_entry_t) + e->len;
+
+            DesfireBatchCmd_t *c = &cmds[pos + i];
+            uint8_t apdu[APDU_RES_LEN] = {0};
+            int apdulen = 0;
+            DesfireBatchEncode(ctx, c, apdu, &apdulen);
+            if (memcmp(apdu, apdus + offsets[i], apdulen) != 0) {
+                PrintAndLogEx(DEBUG, "DESFire batch: frame %u differs from its precomputed one", i);
+                c->res = PM3_ESOFT;
+                res = PM3_ESOFT;
+                break;
+            }
+
+            DesfireBatchDecode(ctx, c, e);
+            if (c->res != PM3_SUCCESS && res == PM3_SUCCESS) {
+                res = c->res;
+            }
+        }
+        pos += done;
+
+        if (res == PM3_SUCCESS && done < n) {
+            res = PM3_EAPDU_FAIL;
+        }
+    }
+
+    ctx->commMode = commMode;
+    free(out);
+    return res;
+}
+
 int DesfireSelectAID(DesfireContext_t *ctx, uint8_t *aid1, uint8_t *aid2) {
     if (aid1 == NULL) {
         return PM3_EINVARG;
@@ -1625,7 +1813,7 @@ static int DesfireAuthenticateLRP(DesfireContext_t *dctx, DesfireSecureChannel s
 }
 
 
-int DesfireAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, bool verbose) {
+void DesfireDeriveKey(DesfireContext_t *dctx) {
     if (dctx->kdfAlgo == MFDES_KDF_ALGO_AN10922) {
         MifareKdfAn10922(dctx, DCOMasterKey, dctx->kdfInput, dctx->kdfInputLen);
         PrintAndLogEx(DEBUG, " Derrived key: " _GREEN_("%s"), sprint_hex(dctx->key, desfire_get_key_block_length(dctx->keyType)));
@@ -1641,6 +1829,10 @@ int DesfireAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChann
         MifareKdfAn10922(dctx, DCOMasterKey, dctx->kdfInput, dctx->kdfInputLen);
         PrintAndLogEx(DEBUG, " Derrived key: " _GREEN_("%s"), sprint_hex(dctx->key, desfire_get_key_block_length(dctx->keyType)));
     }
+}
+
+int DesfireAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, bool verbose) {
+    DesfireDeriveKey(dctx);
 
     if (dctx->cmdSet == DCCISO && secureChannel != DACEV2)
         return DesfireAuthenticateISO(dctx, secureChannel, verbose);
@@ -1657,6 +1849,106 @@ int DesfireAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChann
     return 100;
 }
 
+// Checks keys on dctx->keyNum with authentication rounds run by the device,  in the session
+// of the application selected.  found: index of the key which authenticated,  or -1.
+// PM3_ENOTIMPL when the channel can't be checked this way,  PM3_EAPDU_FAIL when the card
+// refused to start an authentication.
+int DesfireCheckKeys(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, DesfireCryptoAlgorithm keyType,
+                     uint8_t *keys, size_t keylen, uint32_t count, int32_t *found) {
+    *found = -1;
+
+    if (dctx->cmdSet != DCCNativeISO)
+        return PM3_ENOTIMPL;
+    if (secureChannel != DACd40 && secureChannel != DACEV1 && secureChannel != DACEV2)
+        return PM3_ENOTIMPL;
+    if (secureChannel == DACEV2 && keyType != T_AES)
+        return PM3_ENOTIMPL;
+    if (secureChannel == DACd40 && keyType != T_DES && keyType != T_3DES)
+        return PM3_ENOTIMPL;
+
+    uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+    mfdes_chk_req_t *req = (mfdes_chk_req_t *)buf;
+
+    // the same RndA as the host side authentication
+    const uint8_t rnda[16] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16};
+    memcpy(req->rnda, rnda, sizeof(req->rnda));
+    req->chain_iv = (secureChannel == DACEV1);
+
+    switch (keyType) {
+        case T_DES:
+        case T_3DES:
+            req->algo = MFDES_ALGO_3DES;
+            req->keylen = 16;
+            break;
+        case T_3K3DES:
+            req->algo = MFDES_ALGO_3K3DES;
+            req->keylen = 24;
+            break;
+        case T_AES:
+            req->algo = MFDES_ALGO_AES;
+            req->keylen = 16;
+            break;
+    }
+
+    uint8_t authcmd = MFDES_AUTHENTICATE;
+    if (secureChannel == DACEV1)
+        authcmd = (keyType == T_AES) ? MFDES_AUTHENTICATE_AES : MFDES_AUTHENTICATE_ISO;
+    if (secureChannel == DACEV2)
+        authcmd = MFDES_AUTHENTICATE_EV2F;
+
+    // EV2 first authentication carries LenCap
+    uint8_t cmd[] = {MFDES_NATIVE_ISO7816_WRAP_CLA, authcmd, 0x00, 0x00, 0x01, dctx->keyNum, 0x00, 0x00};
+    req->authcmdlen = 7;
+    if (secureChannel == DACEV2) {
+        cmd[4] = 0x02;
+        req->authcmdlen = 8;
+    }
+    memcpy(req->authcmd, cmd, sizeof(req->authcmd));
+
+    size_t maxcount = MIN((sizeof(buf) - sizeof(mfdes_chk_req_t)) / req->keylen, UINT8_MAX);
+
+    DesfireContext_t kctx = *dctx;
+    uint32_t pos = 0;
+    while (pos < count) {
+        req->count = MIN(count - pos, maxcount);
+        for (uint8_t i = 0; i < req->count; i++) {
+            DesfireSetKeyNoClear(&kctx, dctx->keyNum, keyType, &keys[(pos + i) * keylen]);
+            DesfireDeriveKey(&kctx);
+
+            uint8_t *dst = &req->keys[i * req->keylen];
+            memcpy(dst, kctx.key, desfire_get_key_length(keyType));
+            if (keyType == T_DES)
+                memcpy(&dst[8], kctx.key, 8);
+        }
+
+        PacketResponseNG resp;
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_DESFIRE_CHKKEYS, buf, sizeof(mfdes_chk_req_t) + req->count * req->keylen);
+        if (WaitForResponseTimeout(CMD_HF_DESFIRE_CHKKEYS, &resp, 2000 + req->count * 100) == false) {
+            return PM3_ETIMEOUT;
+        }
+        if (resp.status != PM3_SUCCESS) {
+            return resp.status;
+        }
+
+        const mfdes_chk_resp_t *r = (const mfdes_chk_resp_t *)resp.data.asBytes;
+        if (r->found >= 0) {
+            *found = pos + r->found;
+            return PM3_SUCCESS;
+        }
+        if (r->sw) {
+            PrintAndLogEx(DEBUG, "Authentication start refused after %u keys, sw %04x", pos + r->checked, r->sw);
+            return PM3_EAPDU_FAIL;
+        }
+        pos += req->count;
+
+        if (kbd_enter_pressed()) {
+            return PM3_EOPABORTED;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 bool DesfireCheckAuthCmd(DesfireISOSelectWay way, uint32_t appID, uint8_t keyNum, uint8_t authcmd, bool checklrp) {
     size_t recv_len = 0;
     uint8_t respcode = 0;
@@ -1832,13 +2124,29 @@ int DesfireFillAppList(DesfireContext_t *dctx, PICCInfo_t *PICCInfo, AppListS ap
                 appList[i].isoFileIDEnabled = ((appList[i].numKeysRaw & 0x20) != 0);
                 appList[i].keyType = DesfireKeyTypeToAlgo(appList[i].numKeysRaw >> 6);
 
-                if (appList[i].numberOfKeys > 0)
+                if (appList[i].numberOfKeys > 0) {
+                    DesfireBatchCmd_t cmds[0x1f] = {0};
                     for (uint8_t keyn = 0; keyn < appList[i].numberOfKeys; keyn++) {
+                        cmds[keyn].cmd = MFDES_GET_KEY_VERSION;
+                        cmds[keyn].data[0] = keyn;
+                        cmds[keyn].datalen = 1;
+                        cmds[keyn].commMode = dctx->commMode;
+                        cmds[keyn].res = PM3_ENODATA;
+                    }
+                    if (appList[i].numberOfKeys > 1 && DesfireBatchAvailable(dctx, dctx->commMode))
+                        DesfireExchangeBatch(dctx, cmds, appList[i].numberOfKeys);
+
+                    for (uint8_t keyn = 0; keyn < appList[i].numberOfKeys; keyn++) {
+                        if (cmds[keyn].res == PM3_SUCCESS && cmds[keyn].resplen > 0) {
+                            appList[i].keyVersions[keyn] = cmds[keyn].resp[0];
+                            continue;
+                        }
                         res = DesfireGetKeyVersion(dctx, &keyn, 1, buf, &buflen);
                         if (res == PM3_SUCCESS && buflen > 0) {
                             appList[i].keyVersions[keyn] = buf[0];
                         }
                     }
+                }
 
                 appList[i].filesReaded = false;
                 if (readFiles) {
@@ -2110,9 +2418,27 @@ int DesfireFillFileList(DesfireContext_t *dctx, FileList_t FileList, size_t *fil
     if (buflen == 0)
         return PM3_SUCCESS;
 
+    if (buflen > (sizeof(FileList_t) / sizeof(FileListElm_t)))
+        buflen = (sizeof(FileList_t) / sizeof(FileListElm_t));
+
+    // all the settings in one go when the channel allows,  the rest one by one
+    DesfireBatchCmd_t cmds[(sizeof(FileList_t) / sizeof(FileListElm_t))] = {0};
     for (int i = 0; i < buflen; i++) {
         FileList[i].fileNum = buf[i];
-        DesfireFileSettingsStruct(dctx, FileList[i].fileNum, &FileList[i].fileSettings);
+        cmds[i].cmd = MFDES_GET_FILE_SETTINGS;
+        cmds[i].data[0] = buf[i];
+        cmds[i].datalen = 1;
+        cmds[i].commMode = dctx->commMode;
+        cmds[i].res = PM3_ENODATA;
+    }
+    if (buflen > 1 && DesfireBatchAvailable(dctx, dctx->commMode))
+        DesfireExchangeBatch(dctx, cmds, buflen);
+
+    for (int i = 0; i < buflen; i++) {
+        if (cmds[i].res == PM3_SUCCESS && cmds[i].resplen > 0)
+            DesfireFillFileSettings(cmds[i].resp, cmds[i].resplen, &FileList[i].fileSettings);
+        else
+            DesfireFileSettingsStruct(dctx, FileList[i].fileNum, &FileList[i].fileSettings);
     }
     *filescount = buflen;
 
@@ -27,6 +27,9 @@
 
 #define DESFIRE_TX_FRAME_MAX_LEN 54
 #define DESFIRE_BUFFER_SIZE 65538
+// ReadData length of one batched command,  the answer fits a single frame in any communication mode
+#define DESFIRE_BATCH_READ_CHUNK 40
+#define DESFIRE_BATCH_RESP_MAX   64
 
 enum DesfireISOSelectControlEnum {
     ISSMFDFEF     = 0x00,
@@ -192,7 +195,10 @@ int DesfireSelectAndAuthenticateEx(DesfireContext_t *dctx, DesfireSecureChannel
 int DesfireSelectAndAuthenticateW(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, DesfireISOSelectWay way, uint32_t id, bool selectfile, uint16_t isofileid, bool noauth, bool verbose);
 int DesfireSelectAndAuthenticateAppW(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, DesfireISOSelectWay way, uint32_t id, bool noauth, bool verbose);
 int DesfireSelectAndAuthenticateISO(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, bool useaid, uint32_t aid, uint16_t isoappid, bool selectfile, uint16_t isofileid, bool noauth, bool verbose);
+void DesfireDeriveKey(DesfireContext_t *dctx);
 int DesfireAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, bool verbose);
+int DesfireCheckKeys(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, DesfireCryptoAlgorithm keyType,
+                     uint8_t *keys, size_t keylen, uint32_t count, int32_t *found);
 
 bool DesfireCheckAuthCmd(DesfireISOSelectWay way, uint32_t appID, uint8_t keyNum, uint8_t authcmd, bool checklrp);
 void DesfireCheckAuthCommands(DesfireISOSelectWay way, uint32_t appID, char *dfname, uint8_t keyNum,  AuthCommandsChk_t *authCmdCheck);
@@ -222,6 +228,22 @@ int DesfireChangeKey(DesfireContext_t *dctx, bool change_master_key, uint8_t new
 int DesfireSetConfigurationCmd(DesfireContext_t *dctx, uint8_t *data, size_t len, uint8_t *resp, size_t *resplen);
 int DesfireSetConfiguration(DesfireContext_t *dctx, uint8_t paramid, uint8_t *param, size_t paramlen);
 
+// one command of a DesfireExchangeBatch(),  in: cmd..commMode,  out: res..resplen
+typedef struct {
+    uint8_t cmd;
+    uint8_t data[16];
+    uint8_t datalen;
+    DesfireCommunicationMode commMode;
+
+    int res;                // PM3_SUCCESS,  an error,  or PM3_ENODATA when it wasn't sent
+    uint8_t respcode;
+    uint8_t resp[DESFIRE_BATCH_RESP_MAX];
+    size_t resplen;
+} DesfireBatchCmd_t;
+
+bool DesfireBatchAvailable(DesfireContext_t *ctx, DesfireCommunicationMode commMode);
+int DesfireExchangeBatch(DesfireContext_t *ctx, DesfireBatchCmd_t *cmds, size_t count);
+
 int DesfireFillFileList(DesfireContext_t *dctx, FileList_t FileList, size_t *filescount, bool *isopresent);
 int DesfireGetFileIDList(DesfireContext_t *dctx, uint8_t *resp, size_t *resplen);
 int DesfireGetFileISOIDList(DesfireContext_t *dctx, uint8_t *resp, size_t *resplen);
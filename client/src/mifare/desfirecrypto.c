@@ -193,8 +193,68 @@ uint8_t *DesfireGetKey(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type) {
 }
 
 
-static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm keyType, uint8_t *data, uint8_t *dstdata, uint8_t *ivect, bool dir_to_send, bool encode) {
-    size_t block_size = desfire_get_key_block_length(keyType);
+// key schedule for one DesfireCryptoEncDecEx() call, expanded once instead of for every block
+typedef struct {
+    DesfireCryptoAlgorithm keyType;
+    bool encode;
+    mbedtls_des_context ctx;
+    mbedtls_des3_context ctx3;
+    mbedtls_aes_context actx;
+} DesfireKeySchedule_t;
+
+static void DesfireKeyScheduleInit(DesfireKeySchedule_t *ks, uint8_t *key, DesfireCryptoAlgorithm keyType, bool encode) {
+    ks->keyType = keyType;
+    ks->encode = encode;
+
+    switch (keyType) {
+        case T_DES:
+            mbedtls_des_init(&ks->ctx);
+            if (encode)
+                mbedtls_des_setkey_enc(&ks->ctx, key);
+            else
+                mbedtls_des_setkey_dec(&ks->ctx, key);
+            break;
+        case T_3DES:
+            mbedtls_des3_init(&ks->ctx3);
+            if (encode)
+                mbedtls_des3_set2key_enc(&ks->ctx3, key);
+            else
+                mbedtls_des3_set2key_dec(&ks->ctx3, key);
+            break;
+        case T_3K3DES:
+            mbedtls_des3_init(&ks->ctx3);
+            if (encode)
+                mbedtls_des3_set3key_enc(&ks->ctx3, key);
+            else
+                mbedtls_des3_set3key_dec(&ks->ctx3, key);
+            break;
+        case T_AES:
+            mbedtls_aes_init(&ks->actx);
+            if (encode)
+                mbedtls_aes_setkey_enc(&ks->actx, key, 128);
+            else
+                mbedtls_aes_setkey_dec(&ks->actx, key, 128);
+            break;
+    }
+}
+
+static void DesfireKeyScheduleFree(DesfireKeySchedule_t *ks) {
+    switch (ks->keyType) {
+        case T_DES:
+            mbedtls_des_free(&ks->ctx);
+            break;
+        case T_3DES:
+        case T_3K3DES:
+            mbedtls_des3_free(&ks->ctx3);
+            break;
+        case T_AES:
+            mbedtls_aes_free(&ks->actx);
+            break;
+    }
+}
+
+static void DesfireCryptoEncDecSingleBlock(DesfireKeySchedule_t *ks, uint8_t *data, uint8_t *dstdata, uint8_t *ivect, bool dir_to_send) {
+    size_t block_size = desfire_get_key_block_length(ks->keyType);
     uint8_t sdata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
     memcpy(sdata, data, block_size);
     if (dir_to_send) {
@@ -203,49 +263,16 @@ static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm
 
     uint8_t edata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
 
-    switch (keyType) {
+    switch (ks->keyType) {
         case T_DES:
-            if (encode)
-                des_encrypt(edata, sdata, key);
-            else
-                des_decrypt(edata, sdata, key);
+            mbedtls_des_crypt_ecb(&ks->ctx, sdata, edata);
             break;
         case T_3DES:
-            if (encode) {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set2key_enc(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            } else {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set2key_dec(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            }
-            break;
         case T_3K3DES:
-            if (encode) {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set3key_enc(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            } else {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set3key_dec(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            }
+            mbedtls_des3_crypt_ecb(&ks->ctx3, sdata, edata);
             break;
         case T_AES:
-            if (encode) {
-                mbedtls_aes_context actx;
-                mbedtls_aes_init(&actx);
-                mbedtls_aes_setkey_enc(&actx, key, 128);
-                mbedtls_aes_crypt_ecb(&actx, MBEDTLS_AES_ENCRYPT, sdata, edata);
-                mbedtls_aes_free(&actx);
-            } else {
-                mbedtls_aes_context actx;
-                mbedtls_aes_init(&actx);
-                mbedtls_aes_setkey_dec(&actx, key, 128);
-                mbedtls_aes_crypt_ecb(&actx, MBEDTLS_AES_DECRYPT, sdata, edata);
-                mbedtls_aes_free(&actx);
-            }
+            mbedtls_aes_crypt_ecb(&ks->actx, (ks->encode) ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, sdata, edata);
             break;
     }
 
@@ -283,12 +310,17 @@ void DesfireCryptoEncDecEx(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_typ
         size_t dstlen = 0;
         LRPEncDec(key, xiv, encode, srcdata, srcdatalen, data, &dstlen);
     } else {
+        DesfireKeySchedule_t ks;
+        DesfireKeyScheduleInit(&ks, key, ctx->keyType, encode);
+
         size_t offset = 0;
         while (offset < srcdatalen) {
-            DesfireCryptoEncDecSingleBlock(key, ctx->keyType, srcdata + offset, data + offset, xiv, dir_to_send, encode);
+            DesfireCryptoEncDecSingleBlock(&ks, srcdata + offset, data + offset, xiv, dir_to_send);
 
             offset += block_size;
         }
+
+        DesfireKeyScheduleFree(&ks);
     }
 
     if (iv == NULL)
@@ -0,0 +1,301 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Sorting and intersection of key / crypto1 state candidate lists
+//
+// lfsr_recovery32 and nonce2key hand out lists of up to several million
+// entries.  They are sorted with a LSD radix sort on the bytes selected by a
+// mask,  bytes which are the same in all entries are skipped.  Intersections
+// walk the shorter list and gallop through the longer one.
+//-----------------------------------------------------------------------------
+
+#include "keysort.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// in place fallback when there is no memory for the radix sort scratch buffer
+static void keysort_sift(uint64_t *list, size_t root, size_t n, uint64_t mask) {
+    uint64_t v = list[root];
+    while ((root * 2) + 1 < n) {
+        size_t child = (root * 2) + 1;
+        if (child + 1 < n && (list[child] & mask) < (list[child + 1] & mask)) {
+            child++;
+        }
+        if ((v & mask) >= (list[child] & mask)) {
+            break;
+        }
+        list[root] = list[child];
+        root = child;
+    }
+    list[root] = v;
+}
+
+static void keysort_heap(uint64_t *list, size_t n, uint64_t mask) {
+    for (size_t i = n / 2; i-- > 0;) {
+        keysort_sift(list, i, n, mask);
+    }
+    for (size_t i = n; i-- > 1;) {
+        uint64_t t = list[0];
+        list[0] = list[i];
+        list[i] = t;
+        keysort_sift(list, 0, i, mask);
+    }
+}
+
+// sorts list, scratch must hold n entries as well.  Result ends up in list
+static void keysort_lsd(uint64_t *list, uint64_t *scratch, size_t n, uint64_t mask) {
+    size_t hist[8][256];
+    memset(hist, 0, sizeof(hist));
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = list[i] & mask;
+        for (uint8_t b = 0; b < 8; b++) {
+            hist[b][(v >> (b * 8)) & 0xFF]++;
+        }
+    }
+
+    uint64_t *src = list;
+    uint64_t *dst = scratch;
+
+    for (uint8_t b = 0; b < 8; b++) {
+        uint8_t m = (mask >> (b * 8)) & 0xFF;
+        if (m == 0) {
+            continue;
+        }
+
+        // all entries share this byte,  nothing to move
+        uint8_t first = (src[0] & mask) >> (b * 8);
+        if (hist[b][first] == n) {
+            continue;
+        }
+
+        size_t pos = 0;
+        for (uint16_t i = 0; i < 256; i++) {
+            size_t c = hist[b][i];
+            hist[b][i] = pos;
+            pos += c;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            dst[hist[b][((src[i] & mask) >> (b * 8)) & 0xFF]++] = src[i];
+        }
+
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != list) {
+        memcpy(list, src, n * sizeof(uint64_t));
+    }
+}
+
+/**
+ * @brief Sort a list ascending on the bits selected by mask
+ *
+ * @param list entries,  a crypto1 state list can be passed as uint64_t
+ * @param n number of entries
+ * @param mask KEYSORT_ALL or the bits to sort on,  e.g. KEYSORT_CRYPTO1_16
+ */
+void keysort_u64(uint64_t *list, size_t n, uint64_t mask) {
+    if (n < 2) {
+        return;
+    }
+
+    uint64_t *scratch = malloc(n * sizeof(uint64_t));
+    if (scratch == NULL) {
+        keysort_heap(list, n, mask);
+        return;
+    }
+
+    keysort_lsd(list, scratch, n, mask);
+    free(scratch);
+}
+
+typedef struct {
+    uint64_t *list;
+    uint64_t *scratch;
+    const size_t *start;    // bucket offsets
+    uint16_t first;         // first and last bucket of this job
+    uint16_t last;
+    uint64_t mask;
+} keysort_job_t;
+
+static void *keysort_worker(void *arg) {
+    keysort_job_t *job = arg;
+    // the partitioned entries are in scratch,  sort them there and move them back
+    for (uint16_t i = job->first; i <= job->last; i++) {
+        size_t offset = job->start[i];
+        size_t n = job->start[i + 1] - offset;
+        if (n) {
+            keysort_lsd(job->scratch + offset, job->list + offset, n, job->mask);
+        }
+    }
+
+    size_t offset = job->start[job->first];
+    memcpy(job->list + offset, job->scratch + offset, (job->start[job->last + 1] - offset) * sizeof(uint64_t));
+    return NULL;
+}
+
+/**
+ * @brief Same as keysort_u64,  spreading the work over several threads
+ *
+ * The list is split into 256 buckets on its highest differing byte, every
+ * thread then sorts a run of buckets on the remaining bytes.
+ */
+void keysort_u64_mt(uint64_t *list, size_t n, uint64_t mask, int threads) {
+    if (threads < 2 || n < KEYSORT_MT_MIN) {
+        keysort_u64(list, n, mask);
+        return;
+    }
+
+    if (threads > 256) {
+        threads = 256;
+    }
+
+    uint64_t diff = 0;
+    for (size_t i = 1; i < n; i++) {
+        diff |= (list[i] ^ list[0]);
+    }
+    diff &= mask;
+    if (diff == 0) {
+        return;
+    }
+
+    uint8_t top = 7;
+    while (((diff >> (top * 8)) & 0xFF) == 0) {
+        top--;
+    }
+
+    uint64_t *scratch = malloc(n * sizeof(uint64_t));
+    if (scratch == NULL) {
+        keysort_heap(list, n, mask);
+        return;
+    }
+
+    size_t start[257] = {0};
+    for (size_t i = 0; i < n; i++) {
+        start[(((list[i] & mask) >> (top * 8)) & 0xFF) + 1]++;
+    }
+    for (uint16_t i = 1; i <= 256; i++) {
+        start[i] += start[i - 1];
+    }
+
+    size_t pos[256];
+    memcpy(pos, start, sizeof(pos));
+    for (size_t i = 0; i < n; i++) {
+        scratch[pos[((list[i] & mask) >> (top * 8)) & 0xFF]++] = list[i];
+    }
+
+    keysort_job_t jobs[256];
+    pthread_t thread_id[256];
+    int jobcnt = 0;
+
+    // give every thread about the same number of entries
+    uint64_t submask = mask & ~(UINT64_C(0xFF) << (top * 8));
+    size_t share = (n + threads - 1) / threads;
+    uint16_t bucket = 0;
+    while (bucket < 256) {
+        uint16_t last = bucket;
+        while (last < 256 && (start[last + 1] - start[bucket]) < share) {
+            last++;
+        }
+        if (last == 256) {
+            last = 255;
+        }
+
+        keysort_job_t *job = &jobs[jobcnt];
+        job->list = list;
+        job->scratch = scratch;
+        job->start = start;
+        job->first = bucket;
+        job->last = last;
+        job->mask = submask;
+
+        if (pthread_create(&thread_id[jobcnt], NULL, keysort_worker, job) == 0) {
+            jobcnt++;
+        } else {
+            keysort_worker(job);
+        }
+        bucket = last + 1;
+    }
+
+    for (int i = 0; i < jobcnt; i++) {
+        pthread_join(thread_id[i], NULL);
+    }
+    free(scratch);
+}
+
+// first index from lo on with list[index] >= v,  or n
+static size_t keysort_gallop(const uint64_t *list, size_t lo, size_t n, uint64_t v) {
+    size_t step = 1;
+    size_t hi = lo;
+    while (hi < n && list[hi] < v) {
+        lo = hi + 1;
+        hi += step;
+        step <<= 1;
+    }
+    if (hi > n) {
+        hi = n;
+    }
+
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (list[mid] < v) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief Common members of two ascending sorted lists,  duplicates are matched one to one
+ *
+ * @param listA first list,  receives the intersection
+ * @param listB second list
+ * @return number of entries left in listA
+ */
+size_t keysort_intersect(uint64_t *listA, size_t lenA, const uint64_t *listB, size_t lenB) {
+    if (listA == NULL || listB == NULL) {
+        return 0;
+    }
+
+    size_t out = 0;
+    size_t j = 0;
+
+    if (lenA <= lenB) {
+        for (size_t i = 0; i < lenA && j < lenB; i++) {
+            j = keysort_gallop(listB, j, lenB, listA[i]);
+            if (j < lenB && listB[j] == listA[i]) {
+                listA[out++] = listA[i];
+                j++;
+            }
+        }
+    } else {
+        // out never passes j,  the entries of listA still to look at stay intact
+        for (size_t i = 0; i < lenB && j < lenA; i++) {
+            j = keysort_gallop(listA, j, lenA, listB[i]);
+            if (j < lenA && listA[j] == listB[i]) {
+                listA[out++] = listB[i];
+                j++;
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,36 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Sorting and intersection of key / crypto1 state candidate lists
+//-----------------------------------------------------------------------------
+
+#ifndef KEYSORT_H__
+#define KEYSORT_H__
+
+#include "common.h"
+
+// sort on the whole value
+#define KEYSORT_ALL         UINT64_C(0xFFFFFFFFFFFFFFFF)
+// the 16 bits of a crypto1 state which already hold part of the key
+#define KEYSORT_CRYPTO1_16  UINT64_C(0x00FF000000FF0000)
+
+// below this many entries the multithreaded sort runs single threaded
+#define KEYSORT_MT_MIN      0x10000
+
+void keysort_u64(uint64_t *list, size_t n, uint64_t mask);
+void keysort_u64_mt(uint64_t *list, size_t n, uint64_t mask, int threads);
+size_t keysort_intersect(uint64_t *listA, size_t lenA, const uint64_t *listB, size_t lenB);
+
+#endif
@@ -40,13 +40,60 @@ void LRPClearContext(LRPContext_t *ctx) {
     ctx->useUpdatedKeyNum = 0;
 }
 
+// plaintexts, updated keys and CMAC subkeys only depend on the key. A secure channel
+// builds a fresh context for every command with the same session keys, so keep the
+// tables of the last few keys instead of redoing ~40 AES key setups each time.
+// Entries are looked up by key, a new session key just takes a new slot.
+#define LRP_TABLE_CACHE_SIZE 4
+
+typedef struct {
+    bool used;
+    uint8_t key[CRYPTO_AES128_KEY_SIZE];
+    uint8_t plaintexts[LRP_MAX_PLAINTEXTS_SIZE][CRYPTO_AES128_KEY_SIZE];
+    uint8_t updatedKeys[LRP_MAX_UPDATED_KEYS_SIZE][CRYPTO_AES128_KEY_SIZE];
+    bool subkeysValid;
+    uint8_t sk1[CRYPTO_AES128_KEY_SIZE];
+    uint8_t sk2[CRYPTO_AES128_KEY_SIZE];
+} LRPTableCache_t;
+
+static LRPTableCache_t lrp_table_cache[LRP_TABLE_CACHE_SIZE];
+static size_t lrp_table_cache_next = 0;
+
+static LRPTableCache_t *LRPCacheFind(const uint8_t *key) {
+    for (int i = 0; i < LRP_TABLE_CACHE_SIZE; i++) {
+        if (lrp_table_cache[i].used && memcmp(lrp_table_cache[i].key, key, CRYPTO_AES128_KEY_SIZE) == 0)
+            return &lrp_table_cache[i];
+    }
+    return NULL;
+}
+
+static void LRPCacheStore(LRPContext_t *ctx) {
+    LRPTableCache_t *entry = &lrp_table_cache[lrp_table_cache_next];
+    lrp_table_cache_next = (lrp_table_cache_next + 1) % LRP_TABLE_CACHE_SIZE;
+
+    memset(entry, 0, sizeof(LRPTableCache_t));
+    memcpy(entry->key, ctx->key, CRYPTO_AES128_KEY_SIZE);
+    memcpy(entry->plaintexts, ctx->plaintexts, sizeof(entry->plaintexts));
+    memcpy(entry->updatedKeys, ctx->updatedKeys, sizeof(entry->updatedKeys));
+    entry->used = true;
+}
+
 void LRPSetKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBitPadding) {
     LRPClearContext(ctx);
 
     memcpy(ctx->key, key, CRYPTO_AES128_KEY_SIZE);
 
-    LRPGeneratePlaintexts(ctx, 16);
-    LRPGenerateUpdatedKeys(ctx, 4);
+    LRPTableCache_t *entry = LRPCacheFind(key);
+    if (entry) {
+        memcpy(ctx->plaintexts, entry->plaintexts, sizeof(ctx->plaintexts));
+        ctx->plaintextsCount = LRP_MAX_PLAINTEXTS_SIZE;
+        memcpy(ctx->updatedKeys, entry->updatedKeys, sizeof(ctx->updatedKeys));
+        ctx->updatedKeysCount = LRP_MAX_UPDATED_KEYS_SIZE;
+    } else {
+        LRPGeneratePlaintexts(ctx, LRP_MAX_PLAINTEXTS_SIZE);
+        LRPGenerateUpdatedKeys(ctx, LRP_MAX_UPDATED_KEYS_SIZE);
+        LRPCacheStore(ctx);
+    }
 
     ctx->useUpdatedKeyNum = updatedKeyNum;
     ctx->useBitPadding = useBitPadding;
@@ -227,6 +274,14 @@ void LRPGenSubkeys(uint8_t *key, uint8_t *sk1, uint8_t *sk2) {
     LRPContext_t ctx = {0};
     LRPSetKey(&ctx, key, 0, true);
 
+    // LRPSetKey() left the tables of this key in the cache
+    LRPTableCache_t *entry = LRPCacheFind(key);
+    if (entry && entry->subkeysValid) {
+        memcpy(sk1, entry->sk1, CRYPTO_AES128_KEY_SIZE);
+        memcpy(sk2, entry->sk2, CRYPTO_AES128_KEY_SIZE);
+        return;
+    }
+
     uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
     LRPEvalLRP(&ctx, const00, CRYPTO_AES128_KEY_SIZE * 2, true, y);
 
@@ -235,6 +290,12 @@ void LRPGenSubkeys(uint8_t *key, uint8_t *sk1, uint8_t *sk2) {
 
     mulPolyX(y);
     memcpy(sk2, y, CRYPTO_AES128_KEY_SIZE);
+
+    if (entry) {
+        memcpy(entry->sk1, sk1, CRYPTO_AES128_KEY_SIZE);
+        memcpy(entry->sk2, sk2, CRYPTO_AES128_KEY_SIZE);
+        entry->subkeysValid = true;
+    }
 }
 
 // https://www.nxp.com/docs/en/application-note/AN12304.pdf
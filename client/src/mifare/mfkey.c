@@ -18,7 +18,11 @@
 //-----------------------------------------------------------------------------
 #include "mfkey.h"
 
+#include <pthread.h>
+
 #include "crapto1/crapto1.h"
+#include "keysort.h"
+#include "util.h"                 // num_CPUs
 
 // MIFARE
 int inline compare_uint64(const void *a, const void *b) {
@@ -32,21 +36,13 @@ uint32_t intersection(uint64_t *listA, uint64_t *listB) {
     if (listA == NULL || listB == NULL)
         return 0;
 
-    uint64_t *p1, *p2, *p3;
-    p1 = p3 = listA;
-    p2 = listB;
-
-    while (*p1 != UINT64_C(-1) && *p2 != UINT64_C(-1)) {
-        if (compare_uint64(p1, p2) == 0) {
-            *p3++ = *p1++;
-            p2++;
-        } else {
-            while (compare_uint64(p1, p2) < 0) ++p1;
-            while (compare_uint64(p1, p2) > 0) ++p2;
-        }
-    }
-    *p3 = UINT64_C(-1);
-    return p3 - listA;
+    size_t lenA = 0, lenB = 0;
+    while (listA[lenA] != UINT64_C(-1)) lenA++;
+    while (listB[lenB] != UINT64_C(-1)) lenB++;
+
+    size_t n = keysort_intersect(listA, lenA, listB, lenB);
+    listA[n] = UINT64_C(-1);
+    return n;
 }
 
 // Darkside attack (hf mf mifare)
@@ -160,6 +156,60 @@ bool mfkey32_moebius(nonces_t *data, uint64_t *outputkey) {
     return isSuccess;
 }
 
+typedef struct {
+    nonces_t *data;
+    uint64_t *keys;
+    bool *found;
+    uint32_t count;
+    uint32_t next;
+} mfkey32_batch_t;
+
+static void *mfkey32_batch_worker(void *arg) {
+    mfkey32_batch_t *batch = (mfkey32_batch_t *)arg;
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if (i >= batch->count) {
+            break;
+        }
+        batch->found[i] = mfkey32_moebius(&batch->data[i], &batch->keys[i]);
+    }
+    return NULL;
+}
+
+// mfkey32_moebius on many nonce sets at once, one worker per CPU.
+// keys[i] / found[i] are what mfkey32_moebius returns for data[i], returns the number of sets with a key
+uint32_t mfkey32_moebius_batch(nonces_t *data, uint32_t count, uint64_t *keys, bool *found) {
+    if (data == NULL || keys == NULL || found == NULL || count == 0) {
+        return 0;
+    }
+
+    mfkey32_batch_t batch = { .data = data, .keys = keys, .found = found, .count = count, .next = 0 };
+
+    pthread_t thread_id[MFKEY32_BATCH_MAX_THREADS];
+    int threads = MIN(MIN(num_CPUs(), MFKEY32_BATCH_MAX_THREADS), (int)count);
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&thread_id[started], NULL, mfkey32_batch_worker, &batch) == 0) {
+            started++;
+        }
+    }
+
+    // no thread could be started
+    if (started == 0) {
+        mfkey32_batch_worker(&batch);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(thread_id[i], NULL);
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        n += found[i];
+    }
+    return n;
+}
+
 // recover key from reader response and tag response of one authentication sequence
 int mfkey64(nonces_t *data, uint64_t *outputkey) {
     uint64_t key = 0;  // recovered key
@@ -23,9 +23,12 @@
 #include "common.h"
 #include "mifare.h"
 
+#define MFKEY32_BATCH_MAX_THREADS  64
+
 uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t par_info, uint64_t ks_info, uint64_t **keys);
 bool mfkey32(nonces_t *data, uint64_t *outputkey);
 bool mfkey32_moebius(nonces_t *data, uint64_t *outputkey);
+uint32_t mfkey32_moebius_batch(nonces_t *data, uint32_t count, uint64_t *keys, bool *found);
 int mfkey64(nonces_t *data, uint64_t *outputkey);
 
 int compare_uint64(const void *a, const void *b);
@@ -0,0 +1,322 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic dictionary key hit statistics
+//
+// Every dictionary gets a small text file under ~/.proxmark3/keystats/ which
+// counts how often each of its keys unlocked a sector.  The key list is then
+// reordered so keys with hits are tried first, most hits first, while keys
+// without hits keep their dictionary order.
+//
+// file format, one line per key:
+//   <key> <total hits> <sector>:<hits> <sector>:<hits> ...
+//-----------------------------------------------------------------------------
+
+#include "mfkeystats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "commonutil.h"     // ARRAYLEN
+#include "mifare.h"         // MF_KEY_A
+#include "ui.h"             // PrintAndLog, searchHomeFilePath
+#include "util.h"
+
+// position of key in the sorted store, or where it would be inserted
+static size_t mfc_keystats_find(const mfc_keystats_t *st, uint64_t key) {
+    size_t lo = 0, hi = st->count;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (st->stats[mid].key < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const mfc_keystat_t *mfc_keystats_get(const mfc_keystats_t *st, uint64_t key) {
+    size_t i = mfc_keystats_find(st, key);
+    if (i < st->count && st->stats[i].key == key) {
+        return &st->stats[i];
+    }
+    return NULL;
+}
+
+static mfc_keystat_t *mfc_keystats_add(mfc_keystats_t *st, uint64_t key) {
+    size_t i = mfc_keystats_find(st, key);
+    if (i < st->count && st->stats[i].key == key) {
+        return &st->stats[i];
+    }
+
+    if (st->count == st->cap) {
+        size_t cap = (st->cap) ? st->cap * 2 : 64;
+        mfc_keystat_t *p = realloc(st->stats, cap * sizeof(mfc_keystat_t));
+        if (p == NULL) {
+            PrintAndLogEx(WARNING, "failed to allocate memory for key statistics");
+            return NULL;
+        }
+        st->stats = p;
+        st->cap = cap;
+    }
+
+    memmove(&st->stats[i + 1], &st->stats[i], (st->count - i) * sizeof(mfc_keystat_t));
+    memset(&st->stats[i], 0, sizeof(mfc_keystat_t));
+    st->stats[i].key = key;
+    st->count++;
+    return &st->stats[i];
+}
+
+static int mfc_keystats_parse(mfc_keystats_t *st, char *line) {
+    char *end = NULL;
+    uint64_t key = strtoull(line, &end, 16);
+    if (end == line || (end - line) != (MIFARE_KEY_SIZE * 2)) {
+        return PM3_ESOFT;
+    }
+
+    char *p = end;
+    uint32_t hits = strtoul(p, &end, 10);
+    if (end == p) {
+        return PM3_ESOFT;
+    }
+
+    mfc_keystat_t *e = mfc_keystats_add(st, key);
+    if (e == NULL) {
+        return PM3_EMALLOC;
+    }
+    e->hits = hits;
+
+    // per sector counts are optional
+    p = end;
+    while (*p) {
+        uint32_t sector = strtoul(p, &end, 10);
+        if (end == p || *end != ':') {
+            break;
+        }
+        p = end + 1;
+        uint32_t n = strtoul(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        p = end;
+        if (sector < ARRAYLEN(e->sector_hits)) {
+            e->sector_hits[sector] = n;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
+/**
+ * @brief Load the hit statistics of a dictionary.  A missing store isn't an error, it starts out empty.
+ *
+ * @param st store to fill, free with mfc_keystats_free
+ * @param dictionary dictionary filename or path,  NULL or empty for the built in keys only
+ */
+int mfc_keystats_load(mfc_keystats_t *st, const char *dictionary) {
+    memset(st, 0, sizeof(mfc_keystats_t));
+
+    // one store per dictionary, named after the file without path and extension
+    char name[FILE_PATH_SIZE] = MFC_KEYSTATS_DEFAULT;
+    if (dictionary != NULL && dictionary[0] != '\0') {
+        const char *base = dictionary;
+        for (const char *c = dictionary; *c; c++) {
+            if (*c == '/' || *c == '\\') {
+                base = c + 1;
+            }
+        }
+        if (*base) {
+            snprintf(name, sizeof(name) - 4, "%s", base);
+            if (str_endswith(name, ".dic")) {
+                name[strlen(name) - 4] = '\0';
+            }
+        }
+    }
+    strcat(name, ".txt");
+
+    int res = searchHomeFilePath(&st->path, KEYSTATS_SUBDIR, name, true);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    FILE *f = fopen(st->path, "r");
+    if (f == NULL) {
+        PrintAndLogEx(DEBUG, "no key statistics in " _YELLOW_("%s") " yet", st->path);
+        return PM3_SUCCESS;
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        res = mfc_keystats_parse(st, line);
+        if (res == PM3_EMALLOC) {
+            break;
+        }
+    }
+    fclose(f);
+
+    PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%zu") " key statistics from " _YELLOW_("%s"), st->count, st->path);
+    return (res == PM3_EMALLOC) ? res : PM3_SUCCESS;
+}
+
+/**
+ * @brief Write the store back, if any hit was recorded since it was loaded
+ */
+int mfc_keystats_save(mfc_keystats_t *st) {
+    if (st->dirty == false || st->path == NULL) {
+        return PM3_SUCCESS;
+    }
+
+    FILE *f = fopen(st->path, "w");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "could not write key statistics to " _YELLOW_("%s"), st->path);
+        return PM3_EFILE;
+    }
+
+    fprintf(f, "# key hits sector:hits ...\n");
+    for (size_t i = 0; i < st->count; i++) {
+        const mfc_keystat_t *e = &st->stats[i];
+        fprintf(f, "%012" PRIX64 " %u", e->key, e->hits);
+        for (size_t s = 0; s < ARRAYLEN(e->sector_hits); s++) {
+            if (e->sector_hits[s]) {
+                fprintf(f, " %zu:%u", s, e->sector_hits[s]);
+            }
+        }
+        fprintf(f, "\n");
+    }
+    fclose(f);
+
+    st->dirty = false;
+    PrintAndLogEx(INFO, "saved key statistics to " _YELLOW_("%s"), st->path);
+    return PM3_SUCCESS;
+}
+
+void mfc_keystats_free(mfc_keystats_t *st) {
+    free(st->stats);
+    free(st->path);
+    memset(st, 0, sizeof(mfc_keystats_t));
+}
+
+void mfc_keystats_hit(mfc_keystats_t *st, uint64_t key, uint8_t sector) {
+    mfc_keystat_t *e = mfc_keystats_add(st, key);
+    if (e == NULL) {
+        return;
+    }
+    e->hits++;
+    if (sector < ARRAYLEN(e->sector_hits)) {
+        e->sector_hits[sector]++;
+    }
+    st->dirty = true;
+}
+
+/**
+ * @brief Count a hit for every key found in a sector table
+ */
+void mfc_keystats_record(mfc_keystats_t *st, const sector_t *e_sector, uint8_t sectors_cnt) {
+    for (uint8_t i = 0; i < sectors_cnt; i++) {
+        for (uint8_t j = MF_KEY_A; j <= MF_KEY_B; j++) {
+            if (e_sector[i].foundKey[j]) {
+                mfc_keystats_hit(st, e_sector[i].Key[j], i);
+            }
+        }
+    }
+}
+
+typedef struct {
+    uint32_t sector_hits;
+    uint32_t hits;
+    uint32_t idx;
+} mfc_keyrank_t;
+
+static int mfc_keyrank_cmp(const void *a, const void *b) {
+    const mfc_keyrank_t *x = a;
+    const mfc_keyrank_t *y = b;
+    if (x->sector_hits != y->sector_hits) {
+        return (x->sector_hits > y->sector_hits) ? -1 : 1;
+    }
+    if (x->hits != y->hits) {
+        return (x->hits > y->hits) ? -1 : 1;
+    }
+    // keep dictionary order between equals
+    return (x->idx < y->idx) ? -1 : 1;
+}
+
+/**
+ * @brief Move keys with hits to the front of a key list, most hits first
+ *
+ * @param keys key list, MIFARE_KEY_SIZE bytes per key
+ * @param keycnt number of keys
+ * @param sector rank by the hits in this sector first, -1 for total hits only
+ * @return number of keys moved to the front
+ */
+uint32_t mfc_keystats_order(const mfc_keystats_t *st, uint8_t *keys, uint32_t keycnt, int sector) {
+    if (st->count == 0 || keycnt < 2) {
+        return 0;
+    }
+
+    mfc_keyrank_t *ranks = calloc(keycnt, sizeof(mfc_keyrank_t));
+    if (ranks == NULL) {
+        return 0;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < keycnt; i++) {
+        const mfc_keystat_t *e = mfc_keystats_get(st, bytes_to_num(keys + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE));
+        if (e == NULL || e->hits == 0) {
+            continue;
+        }
+        ranks[n].sector_hits = (sector >= 0 && sector < ARRAYLEN(e->sector_hits)) ? e->sector_hits[sector] : 0;
+        ranks[n].hits = e->hits;
+        ranks[n].idx = i;
+        n++;
+    }
+
+    if (n == 0) {
+        free(ranks);
+        return 0;
+    }
+
+    uint8_t *tmp = calloc(keycnt, MIFARE_KEY_SIZE);
+    if (tmp == NULL) {
+        free(ranks);
+        return 0;
+    }
+
+    qsort(ranks, n, sizeof(mfc_keyrank_t), mfc_keyrank_cmp);
+
+    // ranked keys first, then all keys without hits in their old order
+    uint8_t *dst = tmp;
+    for (uint32_t i = 0; i < n; i++) {
+        memcpy(dst, keys + (ranks[i].idx * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        dst += MIFARE_KEY_SIZE;
+    }
+
+    for (uint32_t i = 0; i < keycnt; i++) {
+        const mfc_keystat_t *e = mfc_keystats_get(st, bytes_to_num(keys + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE));
+        if (e != NULL && e->hits) {
+            continue;
+        }
+        memcpy(dst, keys + (i * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        dst += MIFARE_KEY_SIZE;
+    }
+
+    memcpy(keys, tmp, keycnt * MIFARE_KEY_SIZE);
+    free(tmp);
+    free(ranks);
+    return n;
+}
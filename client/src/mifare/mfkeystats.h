@@ -0,0 +1,51 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// MIFARE Classic dictionary key hit statistics
+//-----------------------------------------------------------------------------
+
+#ifndef MFKEYSTATS_H__
+#define MFKEYSTATS_H__
+
+#include "common.h"
+#include "mifaredefault.h"  // MIFARE_4K_MAXSECTOR
+#include "mifarehost.h"     // sector_t
+
+// stats of all dictionary-less runs go to this store
+#define MFC_KEYSTATS_DEFAULT    "default"
+
+typedef struct {
+    uint64_t key;
+    uint32_t hits;
+    uint32_t sector_hits[MIFARE_4K_MAXSECTOR];
+} mfc_keystat_t;
+
+typedef struct {
+    char *path;
+    mfc_keystat_t *stats;   // sorted by key
+    size_t count;
+    size_t cap;
+    bool dirty;
+} mfc_keystats_t;
+
+int mfc_keystats_load(mfc_keystats_t *st, const char *dictionary);
+int mfc_keystats_save(mfc_keystats_t *st);
+void mfc_keystats_free(mfc_keystats_t *st);
+
+void mfc_keystats_hit(mfc_keystats_t *st, uint64_t key, uint8_t sector);
+void mfc_keystats_record(mfc_keystats_t *st, const sector_t *e_sector, uint8_t sectors_cnt);
+uint32_t mfc_keystats_order(const mfc_keystats_t *st, uint8_t *keys, uint32_t keycnt, int sector);
+
+#endif
@@ -23,15 +23,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "comms.h"
 #include "commonutil.h"
+#include "mifare.h"             // MF_CHKKEYS_FAST_PIPELINED
 #include "mifare4.h"
 #include "ui.h"                 // PrintAndLog...
 #include "crapto1/crapto1.h"
 #include "crc16.h"
+#include "crc32.h"
 #include "protocols.h"
 #include "mfkey.h"
+#include "keysort.h"
 #include "util_posix.h"         // msclock
 #include "cmdparser.h"          // detection of flash capabilities
 #include "cmdflashmemspiffs.h"  // upload to flash mem
@@ -42,12 +46,47 @@
 #include "mbedtls/sha1.h"       // SHA1
 #include "cmdhf14a.h"
 #include "gen4.h"
+#include "fileutils.h"          // dictionary stream
+#include "threadpool.h"
+#include "pm3metrics.h"
+
+// one darkside dataset and the key candidates recovered from it
+typedef struct {
+    uint32_t uid;
+    uint32_t nt;
+    uint32_t nr;
+    uint32_t ar;
+    uint64_t par_list;
+    uint64_t ks_list;
+    uint64_t *keylist;
+    uint32_t keycount;
+} darkside_job_t;
+
+static void darkside_worker(threadpool_job_t *tp, void *arg, uint32_t index) {
+    (void)tp;
+    darkside_job_t *job = (darkside_job_t *)arg + index;
+    job->keycount = nonce2key(job->uid, job->nt, job->nr, job->ar, job->par_list, job->ks_list, &job->keylist);
+    if (job->keycount) {
+        keysort_u64(job->keylist, job->keycount, KEYSORT_ALL);
+    }
+}
+
+static int darkside_check(uint8_t blockno, uint8_t key_type, const uint64_t *keylist, uint32_t keycount, uint64_t *key) {
+    uint8_t *keys = calloc(keycount, MIFARE_KEY_SIZE);
+    if (keys == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    for (uint32_t i = 0; i < keycount; i++) {
+        num_to_bytes(keylist[i], MIFARE_KEY_SIZE, keys + (i * MIFARE_KEY_SIZE));
+    }
+
+    int res = mfCheckKeys_stream(blockno, key_type - 0x60, false, keycount, keys, key);
+    free(keys);
+    return res;
+}
 
 int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
-    uint32_t uid = 0;
-    uint32_t nt = 0, nr = 0, ar = 0;
-    uint64_t par_list = 0, ks_list = 0;
-    uint64_t *keylist = NULL, *last_keylist = NULL;
     bool first_run = true;
 
     // message
@@ -60,10 +99,12 @@ int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
             uint8_t first_run;
             uint8_t blockno;
             uint8_t key_type;
+            uint8_t sets;
         } PACKED payload;
         payload.first_run = first_run;
         payload.blockno = blockno;
         payload.key_type = key_type;
+        payload.sets = MF_DARKSIDE_MAX_SETS;
         SendCommandNG(CMD_HF_MIFARE_READER, (uint8_t *)&payload, sizeof(payload));
 
         //flush queue
@@ -75,6 +116,11 @@ int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(INFO, "Running darkside " NOLF);
 
+        darkside_job_t jobs[MF_DARKSIDE_MAX_SETS];
+        memset(jobs, 0, sizeof(jobs));
+        uint8_t jobcount = 0;
+        bool par_zero = true;
+
         // wait cycle
         while (true) {
             PrintAndLogEx(NORMAL, "." NOLF);
@@ -90,17 +136,7 @@ int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
                     return resp.status;
                 }
 
-                struct p {
-                    int32_t isOK;
-                    uint8_t cuid[4];
-                    uint8_t nt[4];
-                    uint8_t par_list[8];
-                    uint8_t ks_list[8];
-                    uint8_t nr[4];
-                    uint8_t ar[4];
-                } PACKED;
-
-                struct p *package = (struct p *) resp.data.asBytes;
+                mf_darkside_t *package = (mf_darkside_t *) resp.data.asBytes;
 
                 if (package->isOK == -6) {
                     *key = 0101;
@@ -110,77 +146,97 @@ int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key) {
                 if (package->isOK < 0)
                     return package->isOK;
 
-
-                uid = (uint32_t)bytes_to_num(package->cuid, sizeof(package->cuid));
-                nt = (uint32_t)bytes_to_num(package->nt, sizeof(package->nr));
-                par_list = bytes_to_num(package->par_list, sizeof(package->par_list));
-                ks_list = bytes_to_num(package->ks_list, sizeof(package->ks_list));
-                nr = (uint32_t)bytes_to_num(package->nr, 4);
-                ar = (uint32_t)bytes_to_num(package->ar, 4);
+                uint32_t uid = (uint32_t)bytes_to_num(package->cuid, sizeof(package->cuid));
+
+                jobcount = MIN(package->count, MF_DARKSIDE_MAX_SETS);
+                for (uint8_t i = 0; i < jobcount; i++) {
+                    mf_darkside_set_t *set = &package->sets[i];
+                    jobs[i].uid = uid;
+                    jobs[i].nt = (uint32_t)bytes_to_num(set->nt, sizeof(set->nt));
+                    jobs[i].par_list = bytes_to_num(set->par_list, sizeof(set->par_list));
+                    jobs[i].ks_list = bytes_to_num(set->ks_list, sizeof(set->ks_list));
+                    jobs[i].nr = (uint32_t)bytes_to_num(set->nr, 4);
+                    jobs[i].ar = (uint32_t)bytes_to_num(set->ar, 4);
+                    if (jobs[i].par_list) {
+                        par_zero = false;
+                    }
+                }
                 break;
             }
         }
         PrintAndLogEx(NORMAL, "");
 
-        if (par_list == 0 && first_run == true) {
+        if (par_zero && first_run == true) {
             PrintAndLogEx(SUCCESS, "Parity is all zero. Most likely this card sends NACK on every authentication.");
         }
         first_run = false;
 
-        uint32_t keycount = nonce2key(uid, nt, nr, ar, par_list, ks_list, &keylist);
-
-        if (keycount == 0) {
-            PrintAndLogEx(FAILED, "Key not found (lfsr_common_prefix list is null). Nt = %08x", nt);
-            PrintAndLogEx(FAILED, "This is expected to happen in 25%% of all cases.");
-            PrintAndLogEx(FAILED, "Trying again with a different reader nonce...");
-            continue;
+        // every dataset gets its own lfsr_common_prefix recovery
+        if (threadpool_run(darkside_worker, jobs, jobcount) != PM3_SUCCESS) {
+            return PM3_EMALLOC;
         }
 
-        // only parity zero attack
-        if (par_list == 0) {
-            qsort(keylist, keycount, sizeof(*keylist), compare_uint64);
-            keycount = intersection(last_keylist, keylist);
-            if (keycount == 0) {
-                free(last_keylist);
-                last_keylist = keylist;
-                PrintAndLogEx(FAILED, "No candidates found, trying again");
+        // the key is in the candidate lists of all datasets
+        uint64_t *candidates = NULL;
+        uint32_t keycount = 0;
+        uint8_t lists = 0;
+        for (uint8_t i = 0; i < jobcount; i++) {
+            if (jobs[i].keycount == 0) {
+                PrintAndLogEx(FAILED, "Key not found (lfsr_common_prefix list is null). Nt = %08x", jobs[i].nt);
                 continue;
             }
+
+            lists++;
+            if (candidates == NULL) {
+                candidates = calloc(jobs[i].keycount + 1, sizeof(uint64_t));
+                if (candidates == NULL) {
+                    break;
+                }
+                memcpy(candidates, jobs[i].keylist, (jobs[i].keycount + 1) * sizeof(uint64_t));
+                keycount = jobs[i].keycount;
+            } else if (keycount) {
+                keycount = intersection(candidates, jobs[i].keylist);
+            }
         }
 
-        PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " candidate key%s", keycount, (keycount > 1) ? "s" : "");
+        if (lists == 0) {
+            free(candidates);
+            PrintAndLogEx(FAILED, "This is expected to happen in 25%% of all cases.");
+            PrintAndLogEx(FAILED, "Trying again with a different reader nonce...");
+            continue;
+        }
 
         *key = UINT64_C(-1);
-        uint8_t keyBlock[PM3_CMD_DATA_SIZE];
-        uint32_t max_keys = KEYS_IN_BLOCK;
-        for (uint32_t i = 0; i < keycount; i += max_keys) {
-
-            uint8_t size = keycount - i > max_keys ? max_keys : keycount - i;
-            register uint8_t j;
-            for (j = 0; j < size; j++) {
-                if (par_list == 0) {
-                    num_to_bytes(last_keylist[i * max_keys + j], 6, keyBlock + (j * 6));
-                } else {
-                    num_to_bytes(keylist[i * max_keys + j], 6, keyBlock + (j * 6));
-                }
-            }
+        int res = PM3_ESOFT;
+        if (keycount) {
+            PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " candidate key%s in %u datasets", keycount, (keycount > 1) ? "s" : "", lists);
+            res = darkside_check(blockno, key_type, candidates, keycount, key);
+        }
+        free(candidates);
 
-            if (mfCheckKeys(blockno, key_type - 0x60, false, size, keyBlock, key) == PM3_SUCCESS) {
-                break;
+        // datasets disagree,  try the candidates of each one
+        for (uint8_t i = 0; i < jobcount && lists > 1 && res == PM3_ESOFT; i++) {
+            if (jobs[i].keycount) {
+                PrintAndLogEx(SUCCESS, "found " _YELLOW_("%u") " candidate key%s", jobs[i].keycount, (jobs[i].keycount > 1) ? "s" : "");
+                res = darkside_check(blockno, key_type, jobs[i].keylist, jobs[i].keycount, key);
             }
         }
 
-        if (*key != UINT64_C(-1)) {
+        for (uint8_t i = 0; i < jobcount; i++) {
+            free(jobs[i].keylist);
+        }
+
+        if (res == PM3_SUCCESS) {
             break;
-        } else {
-            PrintAndLogEx(FAILED, "All key candidates failed. Restarting darkside");
-            free(last_keylist);
-            last_keylist = keylist;
-            first_run = true;
         }
+
+        if (res == PM3_EOPABORTED || res == PM3_ETIMEOUT) {
+            return res;
+        }
+
+        PrintAndLogEx(FAILED, "All key candidates failed. Restarting darkside");
+        first_run = true;
     }
-    free(last_keylist);
-    free(keylist);
     return PM3_SUCCESS;
 }
 
@@ -221,18 +277,51 @@ int mfCheckKeys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keyc
 // 0 == ok all keys found
 // 1 ==
 // 2 == Time-out, aborting
-int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy,
-                     uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory, bool verbose) {
+// copy the keys of a final fchk reply into e_sector
+static int mf_chk_fast_result(const PacketResponseNG *resp, uint8_t sectorsCnt, sector_t *e_sector) {
+    // success array. each byte is status of key
+    uint8_t arr[80];
+    uint64_t foo = 0;
+    uint16_t bar = 0;
+    foo = bytes_to_num(resp->data.asBytes + 480, 8);
+    bar = (resp->data.asBytes[489]  << 8 | resp->data.asBytes[488]);
 
-    uint64_t t2 = msclock();
+    for (uint8_t i = 0; i < 64; i++) {
+        arr[i] = (foo >> i) & 0x1;
+    }
 
-    // send keychunk
-    clearCommandBuffer();
-    SendCommandOLD(CMD_HF_MIFARE_CHKKEYS_FAST, (sectorsCnt | (firstChunk << 8) | (lastChunk << 12)), ((use_flashmemory << 8) | strategy), size, keyBlock, 6 * size);
-    PacketResponseNG resp;
+    for (uint8_t i = 0; i < 16; i++) {
+        arr[i + 64] = (bar >> i) & 0x1;
+    }
+
+    // initialize storage for found keys
+    icesector_t *tmp = calloc(sectorsCnt, sizeof(icesector_t));
+    if (tmp == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    memcpy(tmp, resp->data.asBytes, sectorsCnt * sizeof(icesector_t));
+
+    for (int i = 0; i < sectorsCnt; i++) {
+        // key A
+        if (!e_sector[i].foundKey[0]) {
+            e_sector[i].Key[0] =  bytes_to_num(tmp[i].keyA, 6);
+            e_sector[i].foundKey[0] = arr[(i * 2) ];
+        }
+        // key B
+        if (!e_sector[i].foundKey[1]) {
+            e_sector[i].Key[1] =  bytes_to_num(tmp[i].keyB, 6);
+            e_sector[i].foundKey[1] = arr[(i * 2) + 1 ];
+        }
+    }
+    free(tmp);
+    return PM3_SUCCESS;
+}
 
+// wait for the answer to one key chunk
+static int mf_chk_fast_wait(PacketResponseNG *resp) {
     uint32_t timeout = 0;
-    while (WaitForResponseTimeout(CMD_ACK, &resp, 2000) == false) {
+    while (WaitForResponseTimeout(CMD_ACK, resp, 2000) == false) {
 
         PrintAndLogEx((timeout) ? NORMAL : INFO, "." NOLF);
         fflush(stdout);
@@ -247,11 +336,27 @@ int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk,
             return PM3_ETIMEOUT;
         }
     }
-    t2 = msclock() - t2;
 
     if (timeout) {
         PrintAndLogEx(NORMAL, "");
     }
+    return PM3_SUCCESS;
+}
+
+int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy,
+                     uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory, bool verbose) {
+
+    uint64_t t2 = msclock();
+
+    // send keychunk
+    clearCommandBuffer();
+    SendCommandOLD(CMD_HF_MIFARE_CHKKEYS_FAST, (sectorsCnt | (firstChunk << 8) | (lastChunk << 12)), ((use_flashmemory << 8) | strategy), size, keyBlock, 6 * size);
+    PacketResponseNG resp;
+    if (mf_chk_fast_wait(&resp) != PM3_SUCCESS) {
+        return PM3_ETIMEOUT;
+    }
+    t2 = msclock() - t2;
+    pm3_metrics_keys_checked("mifare", size, t2);
 
     // time to convert the returned data.
     uint8_t curr_keys = resp.oldarg[0];
@@ -263,58 +368,298 @@ int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk,
     // all keys?
     if (curr_keys == sectorsCnt * 2 || lastChunk) {
 
-        // success array. each byte is status of key
-        uint8_t arr[80];
-        uint64_t foo = 0;
-        uint16_t bar = 0;
-        foo = bytes_to_num(resp.data.asBytes + 480, 8);
-        bar = (resp.data.asBytes[489]  << 8 | resp.data.asBytes[488]);
+        int res = mf_chk_fast_result(&resp, sectorsCnt, e_sector);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
 
-        for (uint8_t i = 0; i < 64; i++) {
-            arr[i] = (foo >> i) & 0x1;
+        // if all keys where found
+        if (curr_keys == sectorsCnt * 2) {
+            return PM3_SUCCESS;
         }
 
-        for (uint8_t i = 0; i < 16; i++) {
-            arr[i + 64] = (bar >> i) & 0x1;
+        // if some keys was found
+        if (curr_keys > 0)  {
+            return PM3_EPARTIAL;
         }
 
-        // initialize storage for found keys
-        icesector_t *tmp = calloc(sectorsCnt, sizeof(icesector_t));
-        if (tmp == NULL) {
-            return PM3_EMALLOC;
+        if (lastChunk) {
+            return PM3_ESOFT;
         }
+    }
+    return PM3_ESOFT;
+}
+
+// keys for the pipelined check,  the ones in memory first and then the stream if there is one
+typedef struct {
+    const uint8_t *keys;
+    uint32_t keycnt;
+    uint32_t pos;
+    dictionary_stream_t *stream;
+} mf_chk_source_t;
+
+// next chunk of keys,  *last is set when no key follows it
+static uint32_t mf_chk_source_next(mf_chk_source_t *src, uint8_t *dst, uint32_t max, bool *last) {
+    uint32_t n = MIN(max, src->keycnt - src->pos);
+    memcpy(dst, src->keys + ((size_t)src->pos * MIFARE_KEY_SIZE), (size_t)n * MIFARE_KEY_SIZE);
+    src->pos += n;
 
-        memcpy(tmp, resp.data.asBytes, sectorsCnt * sizeof(icesector_t));
+    if (src->stream && n < max) {
+        n += dictionary_stream_read(src->stream, dst + ((size_t)n * MIFARE_KEY_SIZE), max - n);
+    }
+
+    *last = (src->pos == src->keycnt) && (src->stream == NULL || dictionary_stream_eof(src->stream));
+    return n;
+}
+
+static int mf_chk_fast_pipelined(uint8_t sectorsCnt, uint8_t strategy, mf_chk_source_t *src, sector_t *e_sector, bool verbose) {
 
-        for (int i = 0; i < sectorsCnt; i++) {
-            // key A
-            if (!e_sector[i].foundKey[0]) {
-                e_sector[i].Key[0] =  bytes_to_num(tmp[i].keyA, 6);
-                e_sector[i].foundKey[0] = arr[(i * 2) ];
+    const uint32_t chunksize = PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE;
+    uint8_t chunk[(PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE) * MIFARE_KEY_SIZE];
+
+    uint32_t sent = 0, answered = 0;
+    uint32_t last_chunk = UINT32_MAX;   // index of the chunk sent as the last one
+    uint8_t in_flight = 1;  // raised to 2 once the device shows it takes pipelined chunks
+    bool done = false;
+    int res = PM3_ESOFT;
+    uint64_t keys = 0;
+    uint64_t t0 = msclock();
+
+    clearCommandBuffer();
+    do {
+        // keep the device busy,  a chunk is copied into the packet so the buffer can be reused
+        while (done == false && last_chunk == UINT32_MAX && (sent - answered) < in_flight) {
+            bool last = false;
+            uint32_t size = mf_chk_source_next(src, chunk, chunksize, &last);
+            if (size == 0 && sent == 0) {
+                return PM3_EINVARG;
             }
-            // key B
-            if (!e_sector[i].foundKey[1]) {
-                e_sector[i].Key[1] =  bytes_to_num(tmp[i].keyB, 6);
-                e_sector[i].foundKey[1] = arr[(i * 2) + 1 ];
+            uint8_t first = (sent == 0);
+            SendCommandOLD(CMD_HF_MIFARE_CHKKEYS_FAST, (sectorsCnt | (first << 8) | ((uint8_t)last << 12)), (MF_CHKKEYS_FAST_PIPELINED | strategy), size, chunk, MIFARE_KEY_SIZE * size);
+            if (last) {
+                last_chunk = sent;
             }
+            sent++;
+            keys += size;
         }
-        free(tmp);
 
-        // if all keys where found
-        if (curr_keys == sectorsCnt * 2) {
-            return PM3_SUCCESS;
+        PacketResponseNG resp;
+        if (mf_chk_fast_wait(&resp) != PM3_SUCCESS) {
+            pm3_metrics_keys_checked("mifare", keys, msclock() - t0);
+            return PM3_ETIMEOUT;
         }
+        uint32_t idx = answered++;
 
-        // if some keys was found
-        if (curr_keys > 0)  {
-            return PM3_EPARTIAL;
+        // answers to chunks which were in flight when the check ended
+        if (done) {
+            continue;
         }
 
-        if (lastChunk) {
-            return PM3_ESOFT;
+        if (idx == 0 && resp.oldarg[1]) {
+            in_flight = 2;
+        }
+
+        uint8_t curr_keys = resp.oldarg[0];
+        if (verbose) {
+            PrintAndLogEx(INFO, "Chunk %u | found %u/%u keys", idx + 1, curr_keys, (sectorsCnt << 1));
+        }
+
+        if (curr_keys == sectorsCnt * 2 || idx == last_chunk) {
+            res = mf_chk_fast_result(&resp, sectorsCnt, e_sector);
+            if (res == PM3_SUCCESS) {
+                if (curr_keys == sectorsCnt * 2) {
+                    res = PM3_SUCCESS;
+                } else {
+                    res = (curr_keys > 0) ? PM3_EPARTIAL : PM3_ESOFT;
+                }
+            }
+            done = true;
+            continue;
+        }
+
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            // stops the chunk the device is working on
+            if (sent > answered) {
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            }
+            res = PM3_EOPABORTED;
+            done = true;
+        }
+    } while (answered < sent);
+
+    pm3_metrics_keys_checked("mifare", keys, msclock() - t0);
+    return res;
+}
+
+/**
+ * @brief Run one strategy of the fast check over the whole dictionary
+ *
+ * The next key chunk is uploaded while the device is still checking the
+ * current one,  it keeps it in a second BigBuf slot.  Firmware that doesn't
+ * flag its first answer as pipelined gets one chunk at a time.
+ *
+ * @return same as mfCheckKeys_fast for the last chunk,  PM3_EOPABORTED on keyboard abort
+ */
+int mfCheckKeys_fast_pipelined(uint8_t sectorsCnt, uint8_t strategy, uint32_t keycnt, uint8_t *keyBlock, sector_t *e_sector, bool verbose) {
+    mf_chk_source_t src = { .keys = keyBlock, .keycnt = keycnt, .pos = 0, .stream = NULL };
+    return mf_chk_fast_pipelined(sectorsCnt, strategy, &src, e_sector, verbose);
+}
+
+/**
+ * @brief Same as mfCheckKeys_fast_pipelined,  the keys in keyBlock followed by a dictionary stream
+ *
+ * The stream parses the next keys while the device checks,  it is rewound for
+ * every call so each strategy goes through the whole dictionary.
+ */
+int mfCheckKeys_fast_stream(uint8_t sectorsCnt, uint8_t strategy, uint32_t keycnt, const uint8_t *keyBlock, dictionary_stream_t *stream, sector_t *e_sector, bool verbose) {
+    int res = dictionary_stream_rewind(stream);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    mf_chk_source_t src = { .keys = keyBlock, .keycnt = keycnt, .pos = 0, .stream = stream };
+    return mf_chk_fast_pipelined(sectorsCnt, strategy, &src, e_sector, verbose);
+}
+
+// Splitting a key check across all devices,  see mfCheckKeys_fast_multi
+typedef struct {
+    pm3_device_t *dev;
+    uint8_t sectorsCnt;
+    uint32_t keycnt;
+    uint8_t *keys;
+    sector_t *e_sector;
+    bool *stop;
+    uint8_t *done;
+} mf_chk_worker_t;
+
+static void *mf_chk_worker(void *arg) {
+    mf_chk_worker_t *w = (mf_chk_worker_t *)arg;
+
+    SetCurrentDevice(w->dev);
+
+    uint32_t chunksize = MIN(w->keycnt, (PM3_CMD_DATA_SIZE / MIFARE_KEY_SIZE));
+
+    // strategys. 1= deep first on sector 0 AB,  2= width first on all sectors
+    for (uint8_t strategy = 1; strategy < 3 && chunksize; strategy++) {
+
+        bool firstChunk = true, lastChunk = false;
+
+        for (uint32_t i = 0; i < w->keycnt; i += chunksize) {
+
+            if (__atomic_load_n(w->stop, __ATOMIC_SEQ_CST)) {
+                goto out;
+            }
+
+            uint32_t size = ((w->keycnt - i)  > chunksize) ? chunksize : w->keycnt - i;
+            if (size == w->keycnt - i) {
+                lastChunk = true;
+            }
+
+            int res = mfCheckKeys_fast(w->sectorsCnt, firstChunk, lastChunk, strategy, size, w->keys + (i * MIFARE_KEY_SIZE), w->e_sector, false, false);
+            firstChunk = false;
+
+            // all keys found,  tell the others
+            if (res == PM3_SUCCESS) {
+                __atomic_store_n(w->stop, true, __ATOMIC_SEQ_CST);
+                goto out;
+            }
+            if (res == PM3_ETIMEOUT) {
+                goto out;
+            }
         }
     }
-    return PM3_ESOFT;
+
+out:
+    SetCurrentDevice(NULL);
+    __atomic_add_fetch(w->done, 1, __ATOMIC_SEQ_CST);
+    return NULL;
+}
+
+/**
+ * @brief Same as running mfCheckKeys_fast over the whole dictionary,  but the dictionary is split in
+ * one part per device (see `hw attach`) and all parts are checked at the same time.
+ * Every device needs the same card on its antenna.
+ *
+ * @return PM3_SUCCESS if all keys were found, PM3_EPARTIAL if some, PM3_ESOFT if none,
+ *  PM3_ENOTIMPL if there is only one device
+ */
+int mfCheckKeys_fast_multi(uint8_t sectorsCnt, uint32_t keycnt, uint8_t *keyBlock, sector_t *e_sector) {
+
+    uint8_t ndev = GetDeviceCount();
+    if (ndev < 2) {
+        return PM3_ENOTIMPL;
+    }
+
+    mf_chk_worker_t workers[PM3_MAX_DEVICES];
+    pthread_t threads[PM3_MAX_DEVICES];
+    bool stop = false;
+    uint8_t done = 0;
+    uint8_t started = 0;
+
+    uint32_t part = (keycnt + ndev - 1) / ndev;
+
+    PrintAndLogEx(INFO, "Splitting %u keys over " _YELLOW_("%u") " devices", keycnt, ndev);
+
+    for (uint8_t d = 0; d < ndev; d++) {
+        mf_chk_worker_t *w = &workers[started];
+        uint32_t start = d * part;
+        if (start >= keycnt) {
+            break;
+        }
+        w->dev = GetDevice(d);
+        if (w->dev == NULL) {
+            continue;
+        }
+        w->sectorsCnt = sectorsCnt;
+        w->keycnt = MIN(part, keycnt - start);
+        w->keys = keyBlock + (start * MIFARE_KEY_SIZE);
+        w->stop = &stop;
+        w->done = &done;
+        w->e_sector = calloc(sectorsCnt, sizeof(sector_t));
+        if (w->e_sector == NULL) {
+            break;
+        }
+        memcpy(w->e_sector, e_sector, sectorsCnt * sizeof(sector_t));
+
+        if (pthread_create(&threads[started], NULL, mf_chk_worker, w) != 0) {
+            free(w->e_sector);
+            break;
+        }
+        started++;
+    }
+
+    // main thread keeps an eye on the keyboard
+    while (__atomic_load_n(&done, __ATOMIC_SEQ_CST) < started) {
+        if (kbd_enter_pressed()) {
+            PrintAndLogEx(WARNING, "\naborted via keyboard!\n");
+            __atomic_store_n(&stop, true, __ATOMIC_SEQ_CST);
+        }
+        msleep(100);
+    }
+
+    for (uint8_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+
+        for (uint8_t s = 0; s < sectorsCnt; s++) {
+            for (uint8_t k = 0; k < 2; k++) {
+                if (e_sector[s].foundKey[k] == 0 && workers[i].e_sector[s].foundKey[k]) {
+                    e_sector[s].Key[k] = workers[i].e_sector[s].Key[k];
+                    e_sector[s].foundKey[k] = workers[i].e_sector[s].foundKey[k];
+                }
+            }
+        }
+        free(workers[i].e_sector);
+    }
+
+    uint16_t found = 0;
+    for (uint8_t s = 0; s < sectorsCnt; s++) {
+        found += (e_sector[s].foundKey[0] != 0) + (e_sector[s].foundKey[1] != 0);
+    }
+
+    if (found == sectorsCnt * 2) {
+        return PM3_SUCCESS;
+    }
+    return (found) ? PM3_EPARTIAL : PM3_ESOFT;
 }
 
 // Trigger device to use a binary file on flash mem as keylist for mfCheckKeys.
@@ -365,6 +710,88 @@ int mfCheckKeys_file(uint8_t *destfn, uint64_t *key) {
     return PM3_SUCCESS;
 }
 
+/**
+ * @brief Check a long list of keys against one block.  The key chunks are streamed to the device,
+ * which authenticates them back-to-back instead of waiting for a round trip per chunk.
+ *
+ * @return PM3_SUCCESS and the key if one was valid,  PM3_ESOFT if none was
+ */
+int mfCheckKeys_stream(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint32_t keycnt, const uint8_t *keyBlock, uint64_t *key) {
+    *key = -1;
+
+    uint32_t chunks = (keycnt + MF_CHKKEYS_STREAM_MAX_KEYS - 1) / MF_CHKKEYS_STREAM_MAX_KEYS;
+    uint32_t sent = 0, done = 0;
+    bool found = false;
+    int res = PM3_ESOFT;
+
+    uint8_t data[PM3_CMD_DATA_SIZE] = {0};
+    mf_chkkeys_stream_t *payload = (mf_chkkeys_stream_t *)data;
+    payload->keytype = keyType;
+    payload->blockno = blockNo;
+
+    clearCommandBuffer();
+
+    while (done < chunks) {
+
+        // one chunk in flight while the device works on the other
+        while (found == false && res == PM3_ESOFT && sent < chunks && (sent - done) < 2) {
+            uint32_t pos = sent * MF_CHKKEYS_STREAM_MAX_KEYS;
+            uint8_t n = MIN(keycnt - pos, MF_CHKKEYS_STREAM_MAX_KEYS);
+
+            payload->flags = 0;
+            if (sent == 0) {
+                payload->flags |= MF_CHKKEYS_STREAM_FIRST;
+                if (clear_trace) {
+                    payload->flags |= MF_CHKKEYS_STREAM_CLEARTRACE;
+                }
+            }
+            if (sent == chunks - 1) {
+                payload->flags |= MF_CHKKEYS_STREAM_LAST;
+            }
+            payload->keycnt = n;
+            memcpy(payload->keys, keyBlock + (pos * MIFARE_KEY_SIZE), n * MIFARE_KEY_SIZE);
+            SendCommandNG(CMD_HF_MIFARE_CHKKEYS_STREAM, data, sizeof(mf_chkkeys_stream_t) + (n * MIFARE_KEY_SIZE));
+            sent++;
+        }
+
+        if (sent == done) {
+            break;
+        }
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_CHKKEYS_STREAM, &resp, 2500) == false) {
+            return PM3_ETIMEOUT;
+        }
+        done++;
+
+        if (resp.status != PM3_SUCCESS) {
+            // collect the replies still to come, then report
+            res = resp.status;
+            continue;
+        }
+
+        struct kr {
+            uint8_t key[6];
+            bool found;
+        } PACKED;
+        struct kr *keyresult = (struct kr *)&resp.data.asBytes;
+        if (keyresult->found && found == false) {
+            *key = bytes_to_num(keyresult->key, sizeof(keyresult->key));
+            found = true;
+        }
+
+        if (found == false && res == PM3_ESOFT && kbd_enter_pressed()) {
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            res = PM3_EOPABORTED;
+        }
+    }
+
+    if (found) {
+        return PM3_SUCCESS;
+    }
+    return res;
+}
+
 // PM3 imp of J-Run mf_key_brute (part 2)
 // ref: https://github.com/J-Run/mf_key_brute
 int mfKeyBrute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *resultkey) {
@@ -409,23 +836,18 @@ int mfKeyBrute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *r
     return found;
 }
 
-// Compare 16 Bits out of cryptostate
+// Compare 16 Bits out of cryptostate,  same order as keysort_u64 with KEYSORT_CRYPTO1_16
 inline static int Compare16Bits(const void *a, const void *b) {
-    if ((*(uint64_t *)b & 0x00ff000000ff0000) == (*(uint64_t *)a & 0x00ff000000ff0000)) return 0;
-    if ((*(uint64_t *)b & 0x00ff000000ff0000) > (*(uint64_t *)a & 0x00ff000000ff0000)) return 1;
-    return -1;
+    if ((*(uint64_t *)b & KEYSORT_CRYPTO1_16) == (*(uint64_t *)a & KEYSORT_CRYPTO1_16)) return 0;
+    if ((*(uint64_t *)b & KEYSORT_CRYPTO1_16) > (*(uint64_t *)a & KEYSORT_CRYPTO1_16)) return -1;
+    return 1;
 }
 
-// wrapper function for multi-threaded lfsr_recovery32
-static void
-#ifdef __has_attribute
-#if __has_attribute(force_align_arg_pointer)
-__attribute__((force_align_arg_pointer))
-#endif
-#endif
-*nested_worker_thread(void *arg) {
+// lfsr_recovery32 of statelists[index],  both lists of a nested run are one job
+static void nested_worker(threadpool_job_t *tp, void *arg, uint32_t index) {
+    (void)tp;
     struct Crypto1State *p1;
-    StateList_t *statelist = arg;
+    StateList_t *statelist = (StateList_t *)arg + index;
     statelist->head.slhead = lfsr_recovery32(statelist->ks1, statelist->nt_enc ^ statelist->uid);
 
     for (p1 = statelist->head.slhead; p1->odd | p1->even; p1++) {};
@@ -433,16 +855,25 @@ __attribute__((force_align_arg_pointer))
     statelist->len = p1 - statelist->head.slhead;
     statelist->tail.sltail = --p1;
 
-    qsort(statelist->head.slhead, statelist->len, sizeof(uint64_t), Compare16Bits);
-
-    return statelist->head.slhead;
+    keysort_u64((uint64_t *)statelist->head.slhead, statelist->len, KEYSORT_CRYPTO1_16);
 }
 
-int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
-
-    uint32_t uid;
+// one nested target,  from nonce collection over cracking to the key candidates
+typedef struct {
+    bool active;
+    uint8_t blockNo;
+    uint8_t keyType;
+    uint8_t key[6];
+    uint8_t trgBlockNo;
+    uint8_t trgKeyType;
     StateList_t statelists[2];
-    struct Crypto1State *p1, *p2, *p3, *p4;
+    threadpool_job_t *crack;
+} nested_job_t;
+
+// nonces of the next target,  collected and being cracked while the current one is verified
+static nested_job_t nested_prefetch = { .active = false };
+
+static int nested_collect(nested_job_t *job, uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool calibrate) {
 
     struct {
         uint8_t block;
@@ -484,30 +915,53 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
     if (package->isOK != PM3_SUCCESS)
         return package->isOK;
 
+    uint32_t uid;
     memcpy(&uid, package->cuid, sizeof(package->cuid));
 
     for (uint8_t i = 0; i < 2; i++) {
-        statelists[i].blockNo = package->block;
-        statelists[i].keyType = package->keytype;
-        statelists[i].uid = uid;
+        job->statelists[i].blockNo = package->block;
+        job->statelists[i].keyType = package->keytype;
+        job->statelists[i].uid = uid;
     }
 
-    memcpy(&statelists[0].nt_enc,  package->nt_a, sizeof(package->nt_a));
-    memcpy(&statelists[0].ks1, package->ks_a, sizeof(package->ks_a));
+    memcpy(&job->statelists[0].nt_enc,  package->nt_a, sizeof(package->nt_a));
+    memcpy(&job->statelists[0].ks1, package->ks_a, sizeof(package->ks_a));
 
-    memcpy(&statelists[1].nt_enc,  package->nt_b, sizeof(package->nt_b));
-    memcpy(&statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
+    memcpy(&job->statelists[1].nt_enc,  package->nt_b, sizeof(package->nt_b));
+    memcpy(&job->statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
 
-    // calc keys
-    pthread_t thread_id[2];
+    job->blockNo = blockNo;
+    job->keyType = keyType;
+    memcpy(job->key, key, sizeof(job->key));
+    job->trgBlockNo = trgBlockNo;
+    job->trgKeyType = trgKeyType;
+
+    // calc keys on the thread pool
+    job->crack = threadpool_submit(nested_worker, job->statelists, 2);
+    if (job->crack == NULL)
+        return PM3_EMALLOC;
+
+    job->active = true;
+    return PM3_SUCCESS;
+}
+
+static void nested_join(nested_job_t *job) {
+    threadpool_wait(job->crack, NULL, NULL, 0);
+    job->crack = NULL;
+}
 
-    // create and run worker threads
-    for (uint8_t i = 0; i < 2; i++)
-        pthread_create(thread_id + i, NULL, nested_worker_thread, &statelists[i]);
+static void nested_free(nested_job_t *job) {
+    if (job->active == false)
+        return;
 
-    // wait for threads to terminate:
-    for (uint8_t i = 0; i < 2; i++)
-        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
+    free(job->statelists[0].head.slhead);
+    free(job->statelists[1].head.slhead);
+    job->active = false;
+}
+
+// returns number of key candidates, left in statelists[0]
+static uint32_t nested_intersect(StateList_t *statelists) {
+    struct Crypto1State *p1, *p2, *p3, *p4;
 
     // the first 16 Bits of the cryptostate already contain part of our key.
     // Create the intersection of the two lists based on these 16 Bits and
@@ -534,8 +988,8 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
                 p2++;
             }
         } else {
-            while (Compare16Bits(p1, p2) == -1) p1++;
-            while (Compare16Bits(p1, p2) == 1) p2++;
+            while (Compare16Bits(p1, p2) == -1 && p1 <= statelists[0].tail.sltail) p1++;
+            while (Compare16Bits(p1, p2) == 1 && p2 <= statelists[1].tail.sltail) p2++;
         }
     }
 
@@ -550,69 +1004,142 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
 
     // the statelists now contain possible keys. The key we are searching for must be in the
     // intersection of both lists
-    qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-    qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
+    keysort_u64_mt(statelists[0].head.keyhead, statelists[0].len, KEYSORT_ALL, num_CPUs());
+    keysort_u64_mt(statelists[1].head.keyhead, statelists[1].len, KEYSORT_ALL, num_CPUs());
     // Create the intersection
-    statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
+    statelists[0].len = keysort_intersect(statelists[0].head.keyhead, statelists[0].len, statelists[1].head.keyhead, statelists[1].len);
+    statelists[0].head.keyhead[statelists[0].len] = UINT64_C(-1);
+    return statelists[0].len;
+}
 
-    //statelists[0].tail.keytail = --p7;
-    uint32_t keycnt = statelists[0].len;
-    if (keycnt == 0) goto out;
-
-    PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates", keycnt);
+// The list may still contain several key candidates. They are streamed to the device in one go
+static int nested_verify(StateList_t *statelists, uint32_t keycnt, uint8_t *resultKey) {
 
     memset(resultKey, 0, 6);
     uint64_t key64 = -1;
 
-    // The list may still contain several key candidates. Test each of them with mfCheckKeys
-    uint32_t max_keys = keycnt > KEYS_IN_BLOCK ? KEYS_IN_BLOCK : keycnt;
-    uint8_t keyBlock[PM3_CMD_DATA_SIZE] = {0x00};
-
-    for (uint32_t i = 0; i < keycnt; i += max_keys) {
-
-        uint64_t start_time = msclock();
+    uint8_t *keys = calloc(keycnt, MIFARE_KEY_SIZE);
+    if (keys == NULL) {
+        return PM3_EMALLOC;
+    }
 
-        uint8_t size = keycnt - i > max_keys ? max_keys : keycnt - i;
+    for (uint32_t i = 0; i < keycnt; i++) {
+        crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
+        num_to_bytes(key64, MIFARE_KEY_SIZE, keys + (i * MIFARE_KEY_SIZE));
+    }
 
-        register uint8_t j;
-        for (j = 0; j < size; j++) {
-            crypto1_get_lfsr(statelists[0].head.slhead + i, &key64);
-            num_to_bytes(key64, 6, keyBlock + j * 6);
-        }
+    uint64_t start_time = msclock();
+    int res = mfCheckKeys_stream(statelists[0].blockNo, statelists[0].keyType, false, keycnt, keys, &key64);
+    free(keys);
 
-        if (mfCheckKeys(statelists[0].blockNo, statelists[0].keyType, false, size, keyBlock, &key64) == PM3_SUCCESS) {
-            free(statelists[0].head.slhead);
-            free(statelists[1].head.slhead);
-            num_to_bytes(key64, 6, resultKey);
+    PrintAndLogEx(DEBUG, "checked key candidates in %" PRIu64 " ms", msclock() - start_time);
 
-            PrintAndLogEx(SUCCESS, "\nTarget block %4u key type %c -- found valid key [ " _GREEN_("%s") " ]",
-                          package->block,
-                          package->keytype ? 'B' : 'A',
-                          sprint_hex_inrow(resultKey, 6)
-                         );
-            return PM3_SUCCESS;
-        }
+    if (res == PM3_SUCCESS) {
+        num_to_bytes(key64, 6, resultKey);
 
-        float bruteforce_per_second = (float)(i + max_keys) / ((msclock() - start_time) / 1000.0);
-        PrintAndLogEx(INPLACE, "%6d/%u keys | %5.1f keys/sec | worst case %6.1f seconds remaining", i, keycnt, bruteforce_per_second, (keycnt - i) / bruteforce_per_second);
+        PrintAndLogEx(SUCCESS, "\nTarget block %4u key type %c -- found valid key [ " _GREEN_("%s") " ]",
+                      statelists[0].blockNo,
+                      statelists[0].keyType ? 'B' : 'A',
+                      sprint_hex_inrow(resultKey, 6)
+                     );
+        return PM3_SUCCESS;
     }
 
-out:
     PrintAndLogEx(SUCCESS, "\nTarget block %4u key type %c",
-                  package->block,
-                  package->keytype ? 'B' : 'A'
+                  statelists[0].blockNo,
+                  statelists[0].keyType ? 'B' : 'A'
                  );
 
-    free(statelists[0].head.slhead);
-    free(statelists[1].head.slhead);
+    // aborted or no reply,  not just a miss
+    if (res == PM3_EOPABORTED || res == PM3_ETIMEOUT) {
+        return res;
+    }
     return PM3_ESOFT;
 }
 
+static bool nested_prefetch_match(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType) {
+    return nested_prefetch.active &&
+           nested_prefetch.blockNo == blockNo &&
+           nested_prefetch.keyType == keyType &&
+           memcmp(nested_prefetch.key, key, sizeof(nested_prefetch.key)) == 0 &&
+           nested_prefetch.trgBlockNo == trgBlockNo &&
+           nested_prefetch.trgKeyType == trgKeyType;
+}
+
+/**
+ * @brief Forget the nonces collected ahead for a next target
+ */
+void mfnested_prefetch_drop(void) {
+    if (nested_prefetch.active) {
+        nested_join(&nested_prefetch);
+        nested_free(&nested_prefetch);
+    }
+}
+
+int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
+    mfnested_prefetch_drop();
+    return mfnested_ex(blockNo, keyType, key, trgBlockNo, trgKeyType, -1, 0, resultKey, calibrate);
+}
+
+/**
+ * @brief Nested attack on one target,  pipelined with the next one.
+ *
+ * While the host cracks the nonces of this target,  the device collects the nonces of
+ * the next target, which then are cracked while the candidates of this one are verified.
+ * A following call for that next target picks up where this left off.
+ * Drop what is left with mfnested_prefetch_drop() when done.
+ *
+ * @param nextBlockNo block of the next target,  -1 if there is none
+ */
+int mfnested_ex(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType,
+                int16_t nextBlockNo, uint8_t nextKeyType, uint8_t *resultKey, bool calibrate) {
+
+    nested_job_t job = { .active = false };
+
+    // nonces of this target already collected by the previous call?
+    if (nested_prefetch_match(blockNo, keyType, key, trgBlockNo, trgKeyType)) {
+        job = nested_prefetch;
+        nested_prefetch.active = false;
+    } else if (nextBlockNo < 0 || nested_prefetch_match(blockNo, keyType, key, nextBlockNo, nextKeyType) == false) {
+        // a retry of this target keeps the nonces of the next one
+        mfnested_prefetch_drop();
+    }
+
+    if (job.active == false) {
+        int res = nested_collect(&job, blockNo, keyType, key, trgBlockNo, trgKeyType, calibrate);
+        if (res != PM3_SUCCESS)
+            return res;
+    }
+
+    // keep the device busy with the next target while the host cracks this one
+    // a failure only costs the head start, the next call collects again
+    if (nextBlockNo >= 0 && nested_prefetch.active == false) {
+        nested_collect(&nested_prefetch, blockNo, keyType, key, nextBlockNo, nextKeyType, false);
+    }
+
+    nested_join(&job);
+
+    uint32_t keycnt = nested_intersect(job.statelists);
+    if (keycnt == 0) {
+        PrintAndLogEx(SUCCESS, "\nTarget block %4u key type %c",
+                      job.statelists[0].blockNo,
+                      job.statelists[0].keyType ? 'B' : 'A'
+                     );
+        nested_free(&job);
+        return PM3_ESOFT;
+    }
+
+    PrintAndLogEx(SUCCESS, "Found " _YELLOW_("%u") " key candidates", keycnt);
+
+    int res = nested_verify(job.statelists, keycnt, resultKey);
+    nested_free(&job);
+    return res;
+}
+
 int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey) {
 
     uint32_t uid;
     StateList_t statelists[2];
-    struct Crypto1State *p1, *p2, *p3, *p4;
 
     struct {
         uint8_t block;
@@ -663,61 +1190,10 @@ int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBl
     memcpy(&statelists[1].ks1, package->ks_b, sizeof(package->ks_b));
 
     // calc keys
-    pthread_t thread_id[2];
-
-    // create and run worker threads
-    for (uint8_t i = 0; i < 2; i++)
-        pthread_create(thread_id + i, NULL, nested_worker_thread, &statelists[i]);
+    if (threadpool_run(nested_worker, statelists, 2) != PM3_SUCCESS)
+        return PM3_EMALLOC;
 
-    // wait for threads to terminate:
-    for (uint8_t i = 0; i < 2; i++)
-        pthread_join(thread_id[i], (void *)&statelists[i].head.slhead);
-
-    // the first 16 Bits of the cryptostate already contain part of our key.
-    // Create the intersection of the two lists based on these 16 Bits and
-    // roll back the cryptostate
-    p1 = p3 = statelists[0].head.slhead;
-    p2 = p4 = statelists[1].head.slhead;
-
-    while (p1 <= statelists[0].tail.sltail && p2 <= statelists[1].tail.sltail) {
-        if (Compare16Bits(p1, p2) == 0) {
-
-            struct Crypto1State savestate;
-            savestate = *p1;
-            while (Compare16Bits(p1, &savestate) == 0 && p1 <= statelists[0].tail.sltail) {
-                *p3 = *p1;
-                lfsr_rollback_word(p3, statelists[0].nt_enc ^ statelists[0].uid, 0);
-                p3++;
-                p1++;
-            }
-            savestate = *p2;
-            while (Compare16Bits(p2, &savestate) == 0 && p2 <= statelists[1].tail.sltail) {
-                *p4 = *p2;
-                lfsr_rollback_word(p4, statelists[1].nt_enc ^ statelists[1].uid, 0);
-                p4++;
-                p2++;
-            }
-        } else {
-            while (Compare16Bits(p1, p2) == -1) p1++;
-            while (Compare16Bits(p1, p2) == 1) p2++;
-        }
-    }
-
-    p3->odd = -1;
-    p3->even = -1;
-    p4->odd = -1;
-    p4->even = -1;
-    statelists[0].len = p3 - statelists[0].head.slhead;
-    statelists[1].len = p4 - statelists[1].head.slhead;
-    statelists[0].tail.sltail = --p3;
-    statelists[1].tail.sltail = --p4;
-
-    // the statelists now contain possible keys. The key we are searching for must be in the
-    // intersection of both lists
-    qsort(statelists[0].head.keyhead, statelists[0].len, sizeof(uint64_t), compare_uint64);
-    qsort(statelists[1].head.keyhead, statelists[1].len, sizeof(uint64_t), compare_uint64);
-    // Create the intersection
-    statelists[0].len = intersection(statelists[0].head.keyhead, statelists[1].head.keyhead);
+    nested_intersect(statelists);
 
 
     /*
@@ -885,6 +1361,72 @@ out:
     return PM3_ESOFT;
 }
 
+/**
+ * @brief Test candidate keys for a sector of a static nonce card on the device.  The keystream is
+ * collected once,  every key is checked against it without an authentication.
+ *
+ * @param keys candidate keys,  MIFARE_KEY_SIZE bytes each
+ * @return PM3_SUCCESS with the key in resultKey,  PM3_ESOFT if none matched
+ */
+int mfStaticNestedChk(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType,
+                      uint32_t keycnt, const uint8_t *keys, uint8_t *resultKey) {
+
+    if (keycnt == 0)
+        return PM3_ESOFT;
+
+    mf_static_nested_chk_t *req = calloc(1, PM3_CMD_DATA_SIZE);
+    if (req == NULL)
+        return PM3_EMALLOC;
+
+    req->block = blockNo;
+    req->keytype = keyType;
+    memcpy(req->key, key, sizeof(req->key));
+    req->target_block = trgBlockNo;
+    req->target_keytype = trgKeyType;
+
+    int res = PM3_ESOFT;
+    uint32_t survivors = 0;
+
+    for (uint32_t i = 0; i < keycnt; i += MF_STATIC_CHK_MAX_KEYS) {
+
+        if (kbd_enter_pressed()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        uint16_t n = MIN(keycnt - i, MF_STATIC_CHK_MAX_KEYS);
+        req->keycnt = n;
+        memcpy(req->keys, keys + (i * MIFARE_KEY_SIZE), n * MIFARE_KEY_SIZE);
+
+        PacketResponseNG resp;
+        clearCommandBuffer();
+        SendCommandNG(CMD_HF_MIFARE_STATIC_NESTED_CHK, (uint8_t *)req, sizeof(mf_static_nested_chk_t) + (n * MIFARE_KEY_SIZE));
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_STATIC_NESTED_CHK, &resp, 2500) == false) {
+            res = PM3_ETIMEOUT;
+            break;
+        }
+
+        mf_static_nested_chk_resp_t *r = (mf_static_nested_chk_resp_t *)resp.data.asBytes;
+        res = resp.status;
+        if (res != PM3_SUCCESS && res != PM3_ESOFT)
+            break;
+
+        survivors += r->survivors;
+        if (r->found) {
+            memcpy(resultKey, r->key, MIFARE_KEY_SIZE);
+            break;
+        }
+
+        // later chunks reuse the keystream of the first one
+        memcpy(&req->ks, &r->ks, sizeof(req->ks));
+        req->flags |= MF_STATIC_CHK_KEYSTREAM;
+    }
+
+    PrintAndLogEx(DEBUG, "static nested check, %u keys, %u matched the keystream", keycnt, survivors);
+    free(req);
+    return res;
+}
+
 // MIFARE
 int mfReadSector(uint8_t sectorNo, uint8_t keyType, const uint8_t *key, uint8_t *data) {
 
@@ -907,6 +1449,62 @@ int mfReadSector(uint8_t sectorNo, uint8_t keyType, const uint8_t *key, uint8_t
     return PM3_SUCCESS;
 }
 
+/**
+ * @brief Read a whole card under the fewest auths the device can manage,  the sectors stream back while it reads.
+ *
+ * @param keyA key A of every sector,  NULL if none is known
+ * @param keyB key B of every sector,  NULL if none is known
+ * @param carddata filled with the blocks read,  MFBLOCK_SIZE per block
+ * @param blocks per sector bitmask of the blocks read
+ */
+int mfReadCard(uint8_t sectorcnt, const uint8_t *keyA, const uint8_t *keyB, uint8_t *carddata, uint16_t *blocks) {
+
+    mf_readcard_t payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.sectorcnt = MIN(sectorcnt, MF_READCARD_MAX_SECTORS);
+
+    for (uint8_t s = 0; s < payload.sectorcnt; s++) {
+        blocks[s] = 0;
+        if (keyA) {
+            payload.known_a[s / 8] |= (1 << (s % 8));
+            memcpy(payload.keys[s][MF_KEY_A], keyA + (s * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        }
+        if (keyB) {
+            payload.known_b[s / 8] |= (1 << (s % 8));
+            memcpy(payload.keys[s][MF_KEY_B], keyB + (s * MIFARE_KEY_SIZE), MIFARE_KEY_SIZE);
+        }
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_READCARD, (uint8_t *)&payload, sizeof(payload));
+
+    PacketResponseNG resp;
+    while (true) {
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_READCARD, &resp, 1500) == false) {
+            PrintAndLogEx(DEBUG, "Command execute timeout");
+            return PM3_ETIMEOUT;
+        }
+
+        // the final reply has no sector data
+        if (resp.length < sizeof(mf_readcard_sector_t)) {
+            return resp.status;
+        }
+
+        const mf_readcard_sector_t *sector = (const mf_readcard_sector_t *)resp.data.asBytes;
+        if (sector->sector >= payload.sectorcnt) {
+            continue;
+        }
+
+        blocks[sector->sector] = sector->blocks;
+        for (uint8_t b = 0; b < mfNumBlocksPerSector(sector->sector); b++) {
+            if (sector->blocks & (1 << b)) {
+                memcpy(carddata + ((mfFirstBlockOfSector(sector->sector) + b) * MFBLOCK_SIZE), sector->data + (b * MFBLOCK_SIZE), MFBLOCK_SIZE);
+            }
+        }
+        PrintAndLogEx(INPLACE, "Sector... " _YELLOW_("%2d") " ( %s )", sector->sector, (sector->blocks) ? _GREEN_("ok") : _RED_("fail"));
+    }
+}
+
 int mfReadBlock(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t *data) {
     mf_readblock_t payload = {
         .blockno = blockNo,
@@ -994,6 +1592,170 @@ int mfEmlSetMem_xt(uint8_t *data, int blockNum, int blocksCount, int blockBtWidt
     return PM3_SUCCESS;
 }
 
+// Stage a whole image on the device with BEGIN / DATA frames of cmd,  then COMMIT with <extra> in its data.
+// The data frames are not answered,  the device acts on the image only when the CRC32 in the commit matches.
+static int mf_bulk_upload(uint16_t cmd, const uint8_t *data, size_t datalen, const void *extra, size_t extralen,
+                          uint32_t timeout, PacketResponseNG *resp) {
+
+    if (datalen == 0 || datalen > UINT16_MAX || extralen > PM3_CMD_DATA_SIZE - sizeof(eml_bulk_t)) {
+        return PM3_EINVARG;
+    }
+
+    uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+    eml_bulk_t *req = (eml_bulk_t *)buf;
+
+    req->phase = EML_BULK_BEGIN;
+    req->length = datalen;
+    clearCommandBuffer();
+    SendCommandNG(cmd, buf, sizeof(eml_bulk_t));
+
+    size_t max = PM3_CMD_DATA_SIZE - sizeof(eml_bulk_t);
+    for (size_t offset = 0; offset < datalen; offset += max) {
+        size_t n = MIN(max, datalen - offset);
+        req->phase = EML_BULK_DATA;
+        req->offset = offset;
+        req->length = n;
+        memcpy(req->data, data + offset, n);
+        SendCommandNG(cmd, buf, sizeof(eml_bulk_t) + n);
+    }
+
+    req->phase = EML_BULK_COMMIT;
+    req->offset = 0;
+    req->length = datalen;
+    crc32_ex(data, datalen, req->crc);
+    if (extralen) {
+        memcpy(req->data, extra, extralen);
+    }
+    SendCommandNG(cmd, buf, sizeof(eml_bulk_t) + extralen);
+
+    if (WaitForResponseTimeout(cmd, resp, timeout) == false) {
+        return PM3_ETIMEOUT;
+    }
+    return resp->status;
+}
+
+// Upload a whole image into emulator memory with CMD_HF_MIFARE_EML_LOAD_BULK.
+int mfEmlSetMemBulk(const uint8_t *data, size_t datalen) {
+    PacketResponseNG resp;
+    return mf_bulk_upload(CMD_HF_MIFARE_EML_LOAD_BULK, data, datalen, NULL, 0, 2000, &resp);
+}
+
+// Write blocks start..end of a MIFARE Classic image onto a gen1a or gen4 GTU card with CMD_HF_MIFARE_MAGIC_LOAD_BULK.
+// The device writes them in one backdoor session and reads them back,  on failure *failed is the block concerned.
+int mfMagicLoadBulk(uint8_t type, const uint8_t *pwd, const uint8_t *data, uint16_t block_cnt,
+                    uint16_t start, uint16_t end, uint16_t *failed) {
+
+    mf_magic_bulk_t cfg = {
+        .type = type,
+        .start = start,
+        .end = end,
+    };
+    if (pwd) {
+        memcpy(cfg.pwd, pwd, sizeof(cfg.pwd));
+    }
+
+    // writes and reads,  gen1a / gen4 take a few ms per block
+    uint32_t timeout = 3000 + (end - start + 1) * 2 * 25;
+
+    PacketResponseNG resp;
+    int res = mf_bulk_upload(CMD_HF_MIFARE_MAGIC_LOAD_BULK, data, block_cnt * MFBLOCK_SIZE, &cfg, sizeof(cfg), timeout, &resp);
+    if (res == PM3_ETIMEOUT) {
+        PrintAndLogEx(WARNING, "command execute timeout");
+        return res;
+    }
+
+    if (res != PM3_SUCCESS && failed && resp.length >= sizeof(mf_magic_bulk_resp_t)) {
+        const mf_magic_bulk_resp_t *r = (const mf_magic_bulk_resp_t *)resp.data.asBytes;
+        *failed = r->block;
+    }
+    return res;
+}
+
+// emulator memory compared per chunk,  a multiple of all block widths
+#define EML_DELTA_CHUNK 64
+
+static bool eml_chunk_changed(const uint8_t *data, size_t datalen, size_t i, const uint8_t *crcs) {
+    uint8_t crc[4] = {0};
+    size_t offset = i * EML_DELTA_CHUNK;
+    crc32_ex(data + offset, MIN(EML_DELTA_CHUNK, datalen - offset), crc);
+    return (memcmp(crc, crcs + (i * 4), sizeof(crc)) != 0);
+}
+
+// Upload to emulator memory only the chunks of data that differ from what the device holds.
+// data is the image from emulator memory offset zero,  datalen a multiple of blockBtWidth.
+int mfEmlSetMemDelta(uint8_t *data, size_t datalen, int blockBtWidth, size_t *sent) {
+
+    *sent = 0;
+    size_t chunks = (datalen + EML_DELTA_CHUNK - 1) / EML_DELTA_CHUNK;
+    if (datalen == 0 || blockBtWidth == 0 || chunks > EML_CRC_MAX_CHUNKS || (datalen % blockBtWidth)) {
+        return PM3_EINVARG;
+    }
+
+    eml_crc_req_t req = {
+        .offset = 0,
+        .length = datalen,
+        .chunk = EML_DELTA_CHUNK
+    };
+
+    PacketResponseNG resp;
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_EML_CRC, (uint8_t *)&req, sizeof(req));
+    if (WaitForResponseTimeout(CMD_HF_MIFARE_EML_CRC, &resp, 1500) == false) {
+        return PM3_ETIMEOUT;
+    }
+    if (resp.status != PM3_SUCCESS) {
+        return resp.status;
+    }
+    if (resp.length < chunks * 4) {
+        return PM3_ESOFT;
+    }
+
+    // 12 is the size of the struct the fct mfEmlSetMem_xt uses to transfer to device
+    size_t max_run = ((PM3_CMD_DATA_SIZE - 12) / blockBtWidth) * blockBtWidth / EML_DELTA_CHUNK;
+
+    size_t i = 0;
+    while (i < chunks) {
+        if (eml_chunk_changed(data, datalen, i, resp.data.asBytes) == false) {
+            i++;
+            continue;
+        }
+
+        // merge consecutive changed chunks into one upload
+        size_t start = i;
+        while (i < chunks && (i - start) < max_run && eml_chunk_changed(data, datalen, i, resp.data.asBytes)) {
+            i++;
+        }
+
+        size_t offset = start * EML_DELTA_CHUNK;
+        size_t len = MIN(i * EML_DELTA_CHUNK, datalen) - offset;
+        int res = mfEmlSetMem_xt(data + offset, offset / blockBtWidth, len / blockBtWidth, blockBtWidth);
+        if (res != PM3_SUCCESS) {
+            return res;
+        }
+        *sent += len;
+    }
+    return PM3_SUCCESS;
+}
+
+// Send a CMD_HF_MIFARE_EML_SNAPSHOT request,  the reply is left in resp
+int mfEmlSnapshot(uint8_t action, const char *name, uint16_t size, PacketResponseNG *resp) {
+    eml_snapshot_req_t req = {
+        .action = action,
+        .size = size
+    };
+    memset(req.name, 0, sizeof(req.name));
+    if (name) {
+        memcpy(req.name, name, MIN(strlen(name), sizeof(req.name)));
+    }
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_EML_SNAPSHOT, (uint8_t *)&req, sizeof(req));
+    if (WaitForResponseTimeout(CMD_HF_MIFARE_EML_SNAPSHOT, resp, 1500) == false) {
+        return PM3_ETIMEOUT;
+    }
+    return resp->status;
+}
+
 // "MAGIC" CARD
 int mfCSetUID(uint8_t *uid, uint8_t uidlen, const uint8_t *atqa, const uint8_t *sak, uint8_t *old_uid, uint8_t *verifed_uid, uint8_t wipecard) {
 
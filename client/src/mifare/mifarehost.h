@@ -21,10 +21,14 @@
 #define __MIFARE_HOST_H
 
 #include "common.h"
+#include "pm3_cmd.h"
 
 #include "util.h"       // FILE_PATH_SIZE
 #include "protocol_vigik.h"
 
+// dictionary stream of fileutils.h,  which includes this file
+struct dictionary_stream_s;
+
 #define MIFARE_SECTOR_RETRY     10
 
 // mifare tracer flags
@@ -71,26 +75,41 @@ typedef struct {
 
 int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key);
 int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate);
+int mfnested_ex(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType,
+                int16_t nextBlockNo, uint8_t nextKeyType, uint8_t *resultKey, bool calibrate);
+void mfnested_prefetch_drop(void);
 int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey);
+int mfStaticNestedChk(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType,
+                      uint32_t keycnt, const uint8_t *keys, uint8_t *resultKey);
 int mfCheckKeys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key);
+int mfCheckKeys_stream(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint32_t keycnt, const uint8_t *keyBlock, uint64_t *key);
 int mfCheckKeys_fast(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk,
                      uint8_t strategy, uint32_t size, uint8_t *keyBlock, sector_t *e_sector,
                      bool use_flashmemory, bool verbose);
+int mfCheckKeys_fast_pipelined(uint8_t sectorsCnt, uint8_t strategy, uint32_t keycnt, uint8_t *keyBlock, sector_t *e_sector, bool verbose);
+int mfCheckKeys_fast_stream(uint8_t sectorsCnt, uint8_t strategy, uint32_t keycnt, const uint8_t *keyBlock, struct dictionary_stream_s *stream, sector_t *e_sector, bool verbose);
+int mfCheckKeys_fast_multi(uint8_t sectorsCnt, uint32_t keycnt, uint8_t *keyBlock, sector_t *e_sector);
 
 int mfCheckKeys_file(uint8_t *destfn, uint64_t *key);
 
 int mfKeyBrute(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint64_t *resultkey);
 
 int mfReadSector(uint8_t sectorNo, uint8_t keyType, const uint8_t *key, uint8_t *data);
+int mfReadCard(uint8_t sectorcnt, const uint8_t *keyA, const uint8_t *keyB, uint8_t *carddata, uint16_t *blocks);
 int mfReadBlock(uint8_t blockNo, uint8_t keyType, const uint8_t *key, uint8_t *data);
 
 int mfEmlGetMem(uint8_t *data, int blockNum, int blocksCount);
 int mfEmlSetMem(uint8_t *data, int blockNum, int blocksCount);
 int mfEmlSetMem_xt(uint8_t *data, int blockNum, int blocksCount, int blockBtWidth);
+int mfEmlSetMemBulk(const uint8_t *data, size_t datalen);
+int mfEmlSetMemDelta(uint8_t *data, size_t datalen, int blockBtWidth, size_t *sent);
+int mfEmlSnapshot(uint8_t action, const char *name, uint16_t size, PacketResponseNG *resp);
 
 int mfCSetUID(uint8_t *uid, uint8_t uidlen, const uint8_t *atqa, const uint8_t *sak, uint8_t *old_uid, uint8_t *verifed_uid, uint8_t wipecard);
 int mfCWipe(uint8_t *uid, const uint8_t *atqa, const uint8_t *sak);
 int mfCSetBlock(uint8_t blockNo, uint8_t *data, uint8_t *uid, uint8_t params);
+int mfMagicLoadBulk(uint8_t type, const uint8_t *pwd, const uint8_t *data, uint16_t block_cnt,
+                    uint16_t start, uint16_t end, uint16_t *failed);
 int mfCGetBlock(uint8_t blockNo, uint8_t *data, uint8_t params);
 
 int mfGen3UID(uint8_t *uid, uint8_t uidlen, uint8_t *oldUid);
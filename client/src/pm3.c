@@ -19,6 +19,7 @@
 #include "pm3.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "proxmark3.h"
 #include "cmdmain.h"
@@ -26,8 +27,38 @@
 #include "usart_defs.h"
 #include "util_posix.h"
 #include "comms.h"
+#include "util.h"           // g_printAndLog
+#include "pm3_result.h"
+#include "lfdemodctx.h"     // g_GraphBuffer, g_DemodBuffer
+#include "commonutil.h"     // Uint2byteToMemLe
+
+// index of an additional device (see AttachProxmark),  0 when it is the main one
+static uint8_t pm3_device_index(pm3_device_t *dev) {
+    for (uint8_t i = 1; i < GetDeviceCount(); i++) {
+        if (GetDevice(i) == dev) {
+            return i;
+        }
+    }
+    return 0;
+}
 
 pm3_device_t *pm3_open(const char *port) {
+    // main device is open already,  drive this one next to it
+    if (g_session.pm3_present && (port != NULL)) {
+        int res = AttachProxmark(port, USART_BAUD_RATE);
+        if (res != PM3_SUCCESS) {
+            PrintAndLogEx(ERR, _RED_("ERROR:") " cannot open %s ( %d )\n", port, res);
+            return NULL;
+        }
+        for (uint8_t i = 1; i < GetDeviceCount(); i++) {
+            pm3_device_t *dev = GetDevice(i);
+            if (strcmp(dev->conn->serial_port_name, port) == 0) {
+                return dev;
+            }
+        }
+        return NULL;
+    }
+
     pm3_init();
     OpenProxmark(&g_session.current_device, port, false, 20, false, USART_BAUD_RATE);
     if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
@@ -46,6 +77,13 @@ pm3_device_t *pm3_open(const char *port) {
 }
 
 void pm3_close(pm3_device_t *dev) {
+    uint8_t idx = pm3_device_index(dev);
+    SetCurrentDevice(NULL);
+    if (idx) {
+        DetachProxmark(idx);
+        return;
+    }
+
     // Clean up the port
     if (g_session.pm3_present) {
         clearCommandBuffer();
@@ -56,13 +94,172 @@ void pm3_close(pm3_device_t *dev) {
 }
 
 int pm3_console(pm3_device_t *dev, const char *cmd) {
-    // For now, there is no real device context:
+    SetCurrentDevice(dev);
+    pm3_result_begin();
+    int res = CommandReceived(cmd);
+    pm3_result_end();
+    FlushPrintAndLog();
+    return res;
+}
+
+// as pm3_console,  nothing is formatted or printed,  get the outcome from pm3_result_get()
+int pm3_console_quiet(pm3_device_t *dev, const char *cmd) {
+    uint8_t old_printAndLog = g_printAndLog;
+    g_printAndLog = 0;
+    int res = pm3_console(dev, cmd);
+    g_printAndLog = old_printAndLog;
+    return res;
+}
+
+const char *pm3_result_get(pm3_device_t *dev) {
     (void) dev;
-    return CommandReceived(cmd);
+    return pm3_result_text();
+}
+
+// Asynchronous commands
+//
+// pm3_send_queued() returns as soon as the command is sent, pm3_poll_queued() checks for its
+// reply without blocking, so a script can keep several commands and devices busy at once.
+// Both select dev as the current device of the calling thread.
+
+// data is a hex string,  returns the sequence ID to poll with,  or a negative PM3_E* error
+int pm3_send_queued(pm3_device_t *dev, int cmd, const char *data) {
+    uint8_t buf[PM3_CMD_DATA_SIZE] = {0};
+    int len = 0;
+    if (data && strlen(data)) {
+        len = hex_to_bytes(data, buf, sizeof(buf));
+        if (len < 0) {
+            return PM3_EINVARG;
+        }
+    }
+    return pm3_send_queued_raw(dev, cmd, buf, len);
+}
+
+// as pm3_send_queued,  data is len raw bytes
+int pm3_send_queued_raw(pm3_device_t *dev, int cmd, const void *data, size_t len) {
+    if (len > PM3_CMD_DATA_SIZE || (data == NULL && len)) {
+        return PM3_EINVARG;
+    }
+
+    SetCurrentDevice(dev);
+    uint32_t seq = 0;
+    int res = SendCommandNGQueued(cmd & 0xFFFF, (uint8_t *)data, len, cmd & 0xFFFF, &seq);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+    return (int)(seq & INT32_MAX);
+}
+
+// NULL while the reply is outstanding,  otherwise a JSON object with the reply,
+// or with "error" set to a PM3_E* error.
+const char *pm3_poll_queued(pm3_device_t *dev, int seq) {
+    static char *text = NULL;
+
+    SetCurrentDevice(dev);
+    PacketResponseNG resp;
+    int res = PollQueuedResponse(seq, &resp);
+    if (res == PM3_ENODATA) {
+        return NULL;
+    }
+
+    json_t *root = json_object();
+    if (res == PM3_SUCCESS) {
+        json_object_set_new(root, "cmd", json_integer(resp.cmd));
+        json_object_set_new(root, "status", json_integer(resp.status));
+        json_object_set_new(root, "data", pm3_result_hex(resp.data.asBytes, MIN(resp.length, PM3_CMD_DATA_SIZE)));
+    } else {
+        json_object_set_new(root, "error", json_integer(res));
+    }
+
+    free(text);
+    text = json_dumps(root, JSON_COMPACT);
+    json_decref(root);
+    return (text) ? text : "{\"error\":-12}";
+}
+
+// as pm3_poll_queued,  the reply packed as uint16 cmd, int16 status (little endian) and its data.
+// cmd is 0 and status the PM3_E* error when the reply can't be had.  Valid until the next call.
+pm3_buffer_t pm3_poll_queued_raw(pm3_device_t *dev, int seq) {
+    static uint8_t buf[4 + PM3_CMD_DATA_SIZE];
+    pm3_buffer_t b = { NULL, 0 };
+
+    SetCurrentDevice(dev);
+    PacketResponseNG resp;
+    int res = PollQueuedResponse(seq, &resp);
+    if (res == PM3_ENODATA) {
+        return b;
+    }
+
+    uint16_t len = 0;
+    if (res == PM3_SUCCESS) {
+        len = MIN(resp.length, PM3_CMD_DATA_SIZE);
+        Uint2byteToMemLe(buf, resp.cmd);
+        Uint2byteToMemLe(buf + 2, (uint16_t)resp.status);
+        memcpy(buf + 4, resp.data.asBytes, len);
+    } else {
+        Uint2byteToMemLe(buf, 0);
+        Uint2byteToMemLe(buf + 2, (uint16_t)res);
+    }
+
+    b.data = buf;
+    b.size = 4 + len;
+    return b;
+}
+
+// give up on all outstanding commands of dev
+void pm3_clear_queued(pm3_device_t *dev) {
+    SetCurrentDevice(dev);
+    clearCommandQueue();
+}
+
+// Buffers
+//
+// Direct views on client memory,  the bindings hand them out without copying
+// (a memoryview in Python).  They are valid until the next command changes them.
+
+pm3_buffer_t pm3_graph_get(pm3_device_t *dev) {
+    (void) dev;
+    pm3_buffer_t b = { g_GraphBuffer, g_GraphTraceLen * sizeof(g_GraphBuffer[0]) };
+    return b;
+}
+
+pm3_buffer_t pm3_demod_get(pm3_device_t *dev) {
+    (void) dev;
+    pm3_buffer_t b = { g_DemodBuffer, g_DemodBufferLen };
+    return b;
+}
+
+// download part of the device BigBuf into a buffer kept by libpm3,  reused by the next call
+pm3_buffer_t pm3_bigbuf_get(pm3_device_t *dev, int offset, int len) {
+    static uint8_t *buf = NULL;
+    static size_t buf_size = 0;
+    pm3_buffer_t b = { NULL, 0 };
+
+    if (offset < 0 || len <= 0 || ((uint64_t)offset + len) > g_pm3_capabilities.bigbuf_size) {
+        return b;
+    }
+
+    if (buf_size < (size_t)len) {
+        uint8_t *tmp = realloc(buf, len);
+        if (tmp == NULL) {
+            return b;
+        }
+        buf = tmp;
+        buf_size = len;
+    }
+
+    SetCurrentDevice(dev);
+    if (GetFromDevice(BIG_BUF, buf, len, offset, NULL, 0, NULL, 2500, false) == false) {
+        return b;
+    }
+
+    b.data = buf;
+    b.size = len;
+    return b;
 }
 
 const char *pm3_name_get(pm3_device_t *dev) {
-    return dev->g_conn->serial_port_name;
+    return dev->conn->serial_port_name;
 }
 
 pm3_device_t *pm3_get_current_dev(void) {
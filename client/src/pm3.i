@@ -5,6 +5,46 @@
 #include "comms.h"
 %}
 
+/* Buffers are handed out without copy in Python,  copied into a string in Lua,  None / nil when empty-handed */
+/* Raw input takes any bytes-like object in Python,  a string in Lua */
+#ifdef SWIGPYTHON
+%typemap(out) pm3_buffer_t {
+    if ($1.data == NULL) {
+        $result = SWIG_Py_Void();
+    } else {
+        $result = PyMemoryView_FromMemory((char *)$1.data, $1.size, PyBUF_WRITE);
+    }
+}
+%typemap(arginit) (const void *data, size_t len) {
+    view$argnum.obj = NULL;
+}
+%typemap(in) (const void *data, size_t len) (Py_buffer view) {
+    if (PyObject_GetBuffer($input, &view, PyBUF_SIMPLE) != 0) {
+        SWIG_fail;
+    }
+    $1 = view.buf;
+    $2 = view.len;
+}
+%typemap(freearg) (const void *data, size_t len) {
+    if (view$argnum.obj) {
+        PyBuffer_Release(&view$argnum);
+    }
+}
+#endif
+#ifdef SWIGLUA
+%typemap(out) pm3_buffer_t {
+    if ($1.data == NULL) {
+        lua_pushnil(L);
+    } else {
+        lua_pushlstring(L, (const char *)$1.data, $1.size);
+    }
+    SWIG_arg++;
+}
+%typemap(in, checkfn="lua_isstring") (const void *data, size_t len) {
+    $1 = (void *)lua_tolstring(L, $input, &$2);
+}
+#endif
+
 /* Strip "pm3_" from API functions for SWIG */
 %rename("%(strip:[pm3_])s") "";
 %feature("immutable","1") pm3_current_dev;
@@ -19,7 +59,8 @@ typedef struct {
         pm3(char *port) {
 //            printf("SWIG pm3 constructor with port, open pm3\n");
             pm3_device_t * p = pm3_open(port);
-            p->script_embedded = 0;
+            if (p)
+                p->script_embedded = 0;
             return p;
         }
         ~pm3() {
@@ -31,7 +72,17 @@ typedef struct {
             }
         }
         int console(char *cmd);
+        int console_quiet(char *cmd);
+        int send_queued(int cmd, char *data);
+        int send_queued_raw(int cmd, const void *data, size_t len);
+        char const *poll_queued(int seq);
+        pm3_buffer_t poll_queued_raw(int seq);
+        void clear_queued(void);
+        pm3_buffer_t bigbuf_get(int offset, int len);
         char const * const name;
+        char const * const result;
+        pm3_buffer_t const graph;
+        pm3_buffer_t const demod;
     }
 } pm3;
 //%nodefaultctor device;
@@ -0,0 +1,838 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Micro benchmarks of the host side crypto and demodulation kernels
+//
+// Every kernel runs on fixed inputs,  the check value of a single run
+// doesn't depend on the machine and catches functional regressions,
+// the timing catches performance regressions.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "proxmark3.h"          // pm3_init
+#include "ui.h"
+#include "fileutils.h"
+#include "preferences.h"       // preferences_load
+#include "util.h"               // g_printAndLog
+#include "util_posix.h"         // usclock
+#include "commonutil.h"         // ARRAYLEN
+#include "jansson.h"
+#include "crapto1/crapto1.h"
+#include "bucketsort.h"
+#include "crc.h"
+#include "crc16.h"
+#include "crc32.h"
+#include "crc64.h"
+#include "lfdemod.h"
+#include "emv/tlv.h"
+#include "loclass/cipher.h"
+#include "loclass/elite_crack.h"
+#include "hardnested_bf_core.h"
+
+#define BENCH_DEFAULT_MS        200
+#define BENCH_DEFAULT_REPEAT    3
+#define BENCH_MAX               64
+#define BENCH_LF_MAX_SAMPLES    (40000)
+#define BENCH_HN_FILENAME       "hardnested_bf_bench_data.bin"
+#define BENCH_HN_STATES         (2048)
+#define BENCH_SORT_LEN          (1 << 16)
+
+typedef struct {
+    const char *group;
+    char name[32];
+    const char *unit;           // what one operation processes
+    uint64_t units;             // ... and how many of it
+    uint64_t (*run)(void *arg, uint64_t iters);
+    void *arg;
+
+    // results
+    uint64_t check;
+    uint64_t iterations;
+    double ns_per_op;
+} bench_t;
+
+static bench_t benches[BENCH_MAX];
+static size_t num_benches = 0;
+
+// fixed seed,  the inputs are the same on every run and every machine
+static uint32_t bench_rand_state = 0x12345678;
+static uint32_t bench_rand(void) {
+    uint32_t x = bench_rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    bench_rand_state = x;
+    return x;
+}
+
+static void bench_rand_fill(uint8_t *d, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        d[i] = bench_rand() & 0xFF;
+    }
+}
+
+static bench_t *bench_add(const char *group, const char *name, const char *unit, uint64_t units, uint64_t (*run)(void *, uint64_t), void *arg) {
+    if (num_benches >= ARRAYLEN(benches)) {
+        return NULL;
+    }
+    bench_t *b = &benches[num_benches++];
+    b->group = group;
+    snprintf(b->name, sizeof(b->name), "%s", name);
+    b->unit = unit;
+    b->units = units;
+    b->run = run;
+    b->arg = arg;
+    return b;
+}
+
+//-----------------------------------------------------------------------------
+// crapto1
+//-----------------------------------------------------------------------------
+#define BENCH_KEY   0xA0A1A2A3A4A5ULL
+
+typedef struct {
+    uint32_t ks2[8];
+    uint32_t ks3[8];
+} recovery_arg_t;
+
+static recovery_arg_t recovery_arg;
+
+static void crapto1_prepare(void) {
+    for (size_t i = 0; i < ARRAYLEN(recovery_arg.ks2); i++) {
+        struct Crypto1State s;
+        crypto1_init(&s, BENCH_KEY ^ ((uint64_t)bench_rand() << 16) ^ bench_rand());
+        recovery_arg.ks2[i] = crypto1_word(&s, 0, 0);
+        recovery_arg.ks3[i] = crypto1_word(&s, 0, 0);
+    }
+}
+
+static uint64_t run_crypto1_word(void *arg, uint64_t iters) {
+    (void)arg;
+    struct Crypto1State s;
+    crypto1_init(&s, BENCH_KEY);
+    uint32_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc ^= crypto1_word(&s, (uint32_t)i * 0x9E3779B9, 0);
+    }
+    return acc;
+}
+
+static uint64_t run_lfsr_recovery32(void *arg, uint64_t iters) {
+    recovery_arg_t *r = (recovery_arg_t *)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        struct Crypto1State *states = lfsr_recovery32(r->ks2[i % ARRAYLEN(r->ks2)], 0);
+        if (states == NULL) {
+            continue;
+        }
+        for (struct Crypto1State *s = states; s->odd || s->even; s++) {
+            acc += 1;
+        }
+        free(states);
+    }
+    return acc;
+}
+
+static uint64_t run_lfsr_recovery64(void *arg, uint64_t iters) {
+    recovery_arg_t *r = (recovery_arg_t *)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        size_t n = i % ARRAYLEN(r->ks2);
+        struct Crypto1State *s = lfsr_recovery64(r->ks2[n], r->ks3[n]);
+        if (s == NULL) {
+            continue;
+        }
+        uint64_t lfsr = 0;
+        crypto1_get_lfsr(s, &lfsr);
+        acc ^= lfsr;
+        crypto1_destroy(s);
+    }
+    return acc;
+}
+
+typedef struct {
+    uint32_t *even;
+    uint32_t *odd;
+    uint32_t *work;
+    uint32_t *scratch;
+    bucket_info_t info;
+} sort_arg_t;
+
+static sort_arg_t sort_arg;
+
+static bool bucketsort_prepare(void) {
+    sort_arg.even = calloc(BENCH_SORT_LEN, sizeof(uint32_t));
+    sort_arg.odd = calloc(BENCH_SORT_LEN, sizeof(uint32_t));
+    sort_arg.work = calloc(BENCH_SORT_LEN * 2, sizeof(uint32_t));
+    sort_arg.scratch = calloc(BENCH_SORT_LEN, sizeof(uint32_t));
+    if (sort_arg.even == NULL || sort_arg.odd == NULL || sort_arg.work == NULL || sort_arg.scratch == NULL) {
+        return false;
+    }
+    for (uint32_t i = 0; i < BENCH_SORT_LEN; i++) {
+        sort_arg.even[i] = bench_rand();
+        // not all buckets of the odd list are used,  like in the recovery
+        sort_arg.odd[i] = bench_rand() & 0xBFFFFFFF;
+    }
+    return true;
+}
+
+// the lists are sorted in place,  every run starts from a fresh copy
+static uint64_t run_bucket_sort(void *arg, uint64_t iters) {
+    sort_arg_t *a = (sort_arg_t *)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint32_t *e = a->work;
+        uint32_t *o = a->work + BENCH_SORT_LEN;
+        memcpy(e, a->even, BENCH_SORT_LEN * sizeof(uint32_t));
+        memcpy(o, a->odd, BENCH_SORT_LEN * sizeof(uint32_t));
+        bucket_sort_intersect(e, e + BENCH_SORT_LEN - 1, o, o + BENCH_SORT_LEN - 1, &a->info, a->scratch);
+        acc += a->info.numbuckets;
+        for (uint32_t j = 0; j < a->info.numbuckets; j++) {
+            acc += (a->info.bucket_info[0][j].tail - a->info.bucket_info[0][j].head) ^ *a->info.bucket_info[1][j].head;
+        }
+    }
+    return acc;
+}
+
+//-----------------------------------------------------------------------------
+// hardnested bitsliced brute force core,  one run per SIMD back end
+//-----------------------------------------------------------------------------
+typedef enum {
+    EVEN_STATE = 0,
+    ODD_STATE = 1
+} odd_even_t;
+
+typedef struct {
+    uint32_t nonces;
+    uint32_t test_nonce[256];
+    uint8_t test_nonce_par[256];
+    uint8_t test_nonce_2nd_byte[256];
+    statelist_t part;
+} hardnested_arg_t;
+
+static hardnested_arg_t hn_arg;
+static SIMDExecInstr hn_instr[SIMD_NONE + 1];
+
+static const char *simd_name(SIMDExecInstr instr) {
+    switch (instr) {
+#if defined(COMPILER_HAS_SIMD_AVX512)
+        case SIMD_AVX512:
+            return "AVX512F";
+#endif
+#if defined(COMPILER_HAS_SIMD_X86)
+        case SIMD_AVX2:
+            return "AVX2";
+        case SIMD_AVX:
+            return "AVX";
+        case SIMD_SSE2:
+            return "SSE2";
+        case SIMD_MMX:
+            return "MMX";
+#endif
+#if defined(COMPILER_HAS_SIMD_NEON)
+        case SIMD_NEON:
+            return "NEON";
+#endif
+        case SIMD_AUTO:
+        case SIMD_NONE:
+            break;
+    }
+    return "no SIMD";
+}
+
+static bool read_u32(FILE *f, uint32_t *v) {
+    return fread(v, 1, sizeof(uint32_t), f) == sizeof(uint32_t);
+}
+
+// the format written by hardnested_bruteforce.c with WRITE_BENCH_FILE
+static bool hardnested_prepare(void) {
+    char *path = NULL;
+    if (searchFile(&path, RESOURCES_SUBDIR, BENCH_HN_FILENAME, "", true) != PM3_SUCCESS) {
+        return false;
+    }
+    FILE *f = fopen(path, "rb");
+    free(path);
+    if (f == NULL) {
+        return false;
+    }
+
+    bool ok = read_u32(f, &hn_arg.nonces) && hn_arg.nonces < 256;
+    for (uint32_t i = 0; ok && i < hn_arg.nonces; i++) {
+        ok = read_u32(f, &hn_arg.test_nonce[i]) && fread(&hn_arg.test_nonce_par[i], 1, 1, f) == 1;
+        hn_arg.test_nonce_2nd_byte[i] = (hn_arg.test_nonce[i] >> 16) & 0xFF;
+    }
+
+    for (int s = 0; ok && s < 2; s++) {
+        // even states first
+        int state = (s == 0) ? EVEN_STATE : ODD_STATE;
+        uint32_t num_states = 0;
+        ok = read_u32(f, &num_states) && num_states;
+        if (ok == false) {
+            break;
+        }
+
+        hn_arg.part.states[state] = calloc(BENCH_HN_STATES + 1, sizeof(uint32_t));
+        if (hn_arg.part.states[state] == NULL) {
+            ok = false;
+            break;
+        }
+
+        uint32_t i = 0;
+        for (; ok && i < num_states; i++) {
+            uint32_t v;
+            ok = read_u32(f, &v);
+            if (i < BENCH_HN_STATES) {
+                hn_arg.part.states[state][i] = v;
+            }
+        }
+        // short files are repeated up to the bench size
+        for (i = MIN(num_states, BENCH_HN_STATES); i < BENCH_HN_STATES; i++) {
+            hn_arg.part.states[state][i] = hn_arg.part.states[state][i - num_states];
+        }
+        hn_arg.part.states[state][BENCH_HN_STATES] = -1;
+        hn_arg.part.len[state] = BENCH_HN_STATES;
+    }
+    fclose(f);
+
+    if (ok == false) {
+        free(hn_arg.part.states[EVEN_STATE]);
+        free(hn_arg.part.states[ODD_STATE]);
+        memset(&hn_arg.part, 0, sizeof(hn_arg.part));
+    }
+    return ok;
+}
+
+static uint64_t run_hardnested(void *arg, uint64_t iters) {
+    SIMDExecInstr instr = *(SIMDExecInstr *)arg;
+
+    SetSIMDInstr(instr);
+    bitslice_test_nonces(hn_arg.nonces, hn_arg.test_nonce, hn_arg.test_nonce_par);
+
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint32_t keys_found = 0;
+        uint64_t keys_tested = 0;
+        uint64_t key = crack_states_bitsliced(0, NULL, &hn_arg.part, &keys_found, &keys_tested, hn_arg.nonces, hn_arg.test_nonce_2nd_byte, NULL);
+        acc += keys_tested ^ key;
+    }
+
+    SetSIMDInstr(SIMD_AUTO);
+    return acc;
+}
+
+//-----------------------------------------------------------------------------
+// iClass
+//-----------------------------------------------------------------------------
+static uint64_t run_iclass_mac(void *arg, uint64_t iters) {
+    (void)arg;
+    uint8_t cc_nr[12] = {0xFE, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00};
+    uint8_t div_key[8] = {0xE0, 0x33, 0xCA, 0x41, 0x9A, 0xEE, 0x43, 0xF9};
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint8_t mac[4];
+        cc_nr[8] = i & 0xFF;
+        cc_nr[9] = (i >> 8) & 0xFF;
+        doMAC(cc_nr, div_key, mac);
+        acc += (uint32_t)MemLeToUint4byte(mac);
+    }
+    return acc;
+}
+
+static uint64_t run_iclass_hash2(void *arg, uint64_t iters) {
+    (void)arg;
+    uint8_t key[8] = {0x5B, 0x7C, 0x62, 0xC4, 0x91, 0xC1, 0x1B, 0x39};
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint8_t keytable[128];
+        key[7] = i & 0xFF;
+        hash2(key, keytable);
+        for (size_t j = 0; j < sizeof(keytable); j += 8) {
+            acc += MemLeToUint4byte(keytable + j);
+        }
+    }
+    return acc;
+}
+
+//-----------------------------------------------------------------------------
+// CRC
+//-----------------------------------------------------------------------------
+#define BENCH_CRC_LEN   256
+
+static uint8_t crc_data[BENCH_CRC_LEN];
+
+static uint64_t run_crc16_a(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc += crc16_a(crc_data, sizeof(crc_data) - (i & 1));
+    }
+    return acc;
+}
+
+static uint64_t run_crc16_x25(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc += crc16_x25(crc_data, sizeof(crc_data) - (i & 1));
+    }
+    return acc;
+}
+
+static uint64_t run_crc16_iclass(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc += crc16_iclass(crc_data, sizeof(crc_data) - (i & 1));
+    }
+    return acc;
+}
+
+static uint64_t run_crc16_legic(void *arg, uint64_t iters) {
+    (void)arg;
+    // table driven,  the other CRC kernels may have changed the table
+    init_table(CRC_LEGIC);
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc += crc16_legic(crc_data, sizeof(crc_data) - (i & 1), 0x63);
+    }
+    return acc;
+}
+
+static uint64_t run_crc32(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint8_t crc[4];
+        crc32_ex(crc_data, sizeof(crc_data) - (i & 1), crc);
+        acc += MemLeToUint4byte(crc);
+    }
+    return acc;
+}
+
+static uint64_t run_crc64(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint64_t crc = 0;
+        crc64(crc_data, sizeof(crc_data) - (i & 1), &crc);
+        acc += crc;
+    }
+    return acc;
+}
+
+static uint64_t run_crc8_maxim(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc += CRC8Maxim(crc_data, sizeof(crc_data) - (i & 1));
+    }
+    return acc;
+}
+
+//-----------------------------------------------------------------------------
+// EMV TLV
+//-----------------------------------------------------------------------------
+// a SELECT response and a READ RECORD,  multiple root objects like a full transaction log
+static const uint8_t tlv_sample[] = {
+    0x6F, 0x41, 0x84, 0x07, 0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10, 0xA5, 0x36, 0x50, 0x0B, 0x56,
+    0x49, 0x53, 0x41, 0x20, 0x43, 0x52, 0x45, 0x44, 0x49, 0x54, 0x87, 0x01, 0x01, 0x9F, 0x38, 0x18,
+    0x9F, 0x66, 0x04, 0x9F, 0x02, 0x06, 0x9F, 0x03, 0x06, 0x9F, 0x1A, 0x02, 0x95, 0x05, 0x5F, 0x2A,
+    0x02, 0x9A, 0x03, 0x9C, 0x01, 0x9F, 0x37, 0x04, 0xBF, 0x0C, 0x08, 0x9F, 0x5A, 0x05, 0x31, 0x08,
+    0x40, 0x08, 0x40, 0x70, 0x79, 0x57, 0x13, 0x47, 0x61, 0x73, 0x90, 0x01, 0x01, 0x01, 0x19, 0xD2,
+    0x21, 0x22, 0x01, 0x17, 0x58, 0x92, 0x88, 0x90, 0x00, 0x0F, 0x5F, 0x20, 0x1A, 0x56, 0x49, 0x53,
+    0x41, 0x20, 0x41, 0x43, 0x51, 0x55, 0x49, 0x52, 0x45, 0x52, 0x20, 0x54, 0x45, 0x53, 0x54, 0x20,
+    0x43, 0x41, 0x52, 0x44, 0x20, 0x32, 0x39, 0x9F, 0x1F, 0x19, 0x31, 0x37, 0x35, 0x38, 0x39, 0x32,
+    0x38, 0x38, 0x39, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30,
+    0x30, 0x30, 0x30, 0x8C, 0x15, 0x9F, 0x02, 0x06, 0x9F, 0x03, 0x06, 0x9F, 0x1A, 0x02, 0x95, 0x05,
+    0x5F, 0x2A, 0x02, 0x9A, 0x03, 0x9C, 0x01, 0x9F, 0x37, 0x04, 0x5A, 0x08, 0x47, 0x61, 0x73, 0x90,
+    0x01, 0x01, 0x01, 0x19, 0x5F, 0x24, 0x03, 0x22, 0x12, 0x31, 0x5F, 0x34, 0x01, 0x01, 0x77, 0x28,
+    0x82, 0x02, 0x20, 0x00, 0x94, 0x04, 0x10, 0x02, 0x03, 0x00, 0x9F, 0x36, 0x02, 0x00, 0x01, 0x9F,
+    0x26, 0x08, 0x8A, 0x9C, 0x2D, 0x7E, 0x61, 0x10, 0x44, 0x5C, 0x9F, 0x10, 0x07, 0x06, 0x01, 0x0A,
+    0x03, 0xA0, 0x00, 0x00, 0x9F, 0x27, 0x01, 0x80,
+};
+
+static uint64_t run_tlv_parse(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        struct tlvdb *db = tlvdb_parse_multi(tlv_sample, sizeof(tlv_sample));
+        const struct tlvdb *found = tlvdb_find_full(db, 0x9f26);
+        acc += (found) ? tlvdb_get_tlv(found)->len : 0;
+        tlvdb_free(db);
+    }
+    return acc;
+}
+
+static uint64_t run_tlv_arena(void *arg, uint64_t iters) {
+    (void)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        struct tlvdb_arena *arena = tlvdb_arena_parse(tlv_sample, sizeof(tlv_sample), true);
+        const struct tlv *t = tlvdb_arena_get(arena, 0x9f26, NULL);
+        acc += ((t) ? t->len : 0) + tlvdb_arena_count(arena);
+        tlvdb_arena_free(arena);
+    }
+    return acc;
+}
+
+//-----------------------------------------------------------------------------
+// lfdemod on sample captures
+//-----------------------------------------------------------------------------
+typedef enum {
+    LF_EM410X,
+    LF_HID,
+    LF_AWID,
+    LF_INDALA,
+    LF_PAC,
+} lf_kernel_t;
+
+typedef struct {
+    lf_kernel_t kernel;
+    const char *name;
+    const char *filename;
+    uint8_t *samples;
+    uint8_t *work;
+    size_t len;
+} lf_arg_t;
+
+static lf_arg_t lf_args[] = {
+    { LF_EM410X, "ask em410x", "lf_EM4102-1.pm3", NULL, NULL, 0 },
+    { LF_HID,    "fsk hid",    "lf_ATA5577_hid.pm3", NULL, NULL, 0 },
+    { LF_AWID,   "fsk awid",   "lf_ATA5577_awid_26.pm3", NULL, NULL, 0 },
+    { LF_INDALA, "psk indala", "lf_ATA5577_indala.pm3", NULL, NULL, 0 },
+    { LF_PAC,    "nrz pac",    "lf_ATA5577_pac.pm3", NULL, NULL, 0 },
+};
+
+// pm3 text trace, one sample per line, the same way 'data load' reads it
+static bool lf_prepare(lf_arg_t *a) {
+    char *path = NULL;
+    if (searchFile(&path, TRACES_SUBDIR, a->filename, "", true) != PM3_SUCCESS) {
+        return false;
+    }
+    FILE *f = fopen(path, "r");
+    free(path);
+    if (f == NULL) {
+        return false;
+    }
+
+    a->samples = calloc(BENCH_LF_MAX_SAMPLES, sizeof(uint8_t));
+    a->work = calloc(BENCH_LF_MAX_SAMPLES, sizeof(uint8_t));
+    if (a->samples == NULL || a->work == NULL) {
+        fclose(f);
+        return false;
+    }
+
+    char line[80];
+    while (a->len < BENCH_LF_MAX_SAMPLES && fgets(line, sizeof(line), f)) {
+        int v = atoi(line);
+        if (v > 127) v = 127;
+        if (v < -127) v = -127;
+        a->samples[a->len++] = (uint8_t)(v + 128);
+    }
+    fclose(f);
+    return (a->len > 0);
+}
+
+// the demodulators work in place,  every run starts from the capture again
+static uint64_t run_lfdemod(void *arg, uint64_t iters) {
+    lf_arg_t *a = (lf_arg_t *)arg;
+    uint64_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        memcpy(a->work, a->samples, a->len);
+        size_t size = a->len;
+        int clk = 0, invert = 0, start = 0, res = -1;
+
+        computeSignalProperties(a->work, size);
+
+        switch (a->kernel) {
+            case LF_EM410X: {
+                res = askdemod_ext(a->work, &size, &clk, &invert, 100, 0, 1, &start);
+                if (res >= 0) {
+                    size_t idx = 0;
+                    uint32_t hi = 0;
+                    uint64_t lo = 0;
+                    res = Em410xDecode(a->work, &size, &idx, &hi, &lo);
+                    acc += lo;
+                }
+                break;
+            }
+            case LF_HID: {
+                uint32_t hi2 = 0, hi = 0, lo = 0;
+                res = HIDdemodFSK(a->work, &size, &hi2, &hi, &lo, &start);
+                acc += lo;
+                break;
+            }
+            case LF_AWID:
+                res = detectAWID(a->work, &size, &start);
+                break;
+            case LF_INDALA:
+                res = pskRawDemod_ext(a->work, &size, &clk, &invert, &start);
+                break;
+            case LF_PAC:
+                res = nrzRawDemod(a->work, &size, &clk, &invert, &start);
+                break;
+        }
+        acc += (uint32_t)res + size + clk;
+    }
+    return acc;
+}
+
+//-----------------------------------------------------------------------------
+static void bench_setup(void) {
+
+    bench_add("crapto1", "crypto1_word", "words", 1, run_crypto1_word, NULL);
+    crapto1_prepare();
+    bench_add("crapto1", "lfsr_recovery32", "calls", 1, run_lfsr_recovery32, &recovery_arg);
+    bench_add("crapto1", "lfsr_recovery64", "calls", 1, run_lfsr_recovery64, &recovery_arg);
+    if (bucketsort_prepare()) {
+        bench_add("crapto1", "bucket_sort_intersect", "entries", BENCH_SORT_LEN * 2, run_bucket_sort, &sort_arg);
+    }
+
+    if (hardnested_prepare()) {
+        // every instruction set below the best one this CPU supports
+        SetSIMDInstr(SIMD_AUTO);
+        size_t n = 0;
+        for (SIMDExecInstr instr = GetSIMDInstrAuto(); instr <= SIMD_NONE; instr++) {
+            hn_instr[n] = instr;
+            bench_add("hardnested", simd_name(instr), "keys", (uint64_t)BENCH_HN_STATES * BENCH_HN_STATES, run_hardnested, &hn_instr[n]);
+            n++;
+        }
+    } else {
+        PrintAndLogEx(WARNING, "no " _YELLOW_(BENCH_HN_FILENAME) " found, skipping hardnested");
+    }
+
+    bench_add("iclass", "doMAC", "calls", 1, run_iclass_mac, NULL);
+    bench_add("iclass", "hash2", "calls", 1, run_iclass_hash2, NULL);
+
+    bench_rand_fill(crc_data, sizeof(crc_data));
+    bench_add("crc", "crc16_a", "bytes", BENCH_CRC_LEN, run_crc16_a, NULL);
+    bench_add("crc", "crc16_x25", "bytes", BENCH_CRC_LEN, run_crc16_x25, NULL);
+    bench_add("crc", "crc16_iclass", "bytes", BENCH_CRC_LEN, run_crc16_iclass, NULL);
+    bench_add("crc", "crc16_legic", "bytes", BENCH_CRC_LEN, run_crc16_legic, NULL);
+    bench_add("crc", "crc32", "bytes", BENCH_CRC_LEN, run_crc32, NULL);
+    bench_add("crc", "crc64", "bytes", BENCH_CRC_LEN, run_crc64, NULL);
+    bench_add("crc", "crc8_maxim", "bytes", BENCH_CRC_LEN, run_crc8_maxim, NULL);
+
+    bench_add("tlv", "tlvdb_parse_multi", "bytes", sizeof(tlv_sample), run_tlv_parse, NULL);
+    bench_add("tlv", "tlvdb_arena_parse", "bytes", sizeof(tlv_sample), run_tlv_arena, NULL);
+
+    for (size_t i = 0; i < ARRAYLEN(lf_args); i++) {
+        if (lf_prepare(&lf_args[i]) == false) {
+            PrintAndLogEx(WARNING, "no " _YELLOW_("%s") " found, skipping %s", lf_args[i].filename, lf_args[i].name);
+            continue;
+        }
+        bench_add("lfdemod", lf_args[i].name, "samples", lf_args[i].len, run_lfdemod, &lf_args[i]);
+    }
+}
+
+static void bench_run(bench_t *b, uint64_t min_us, int repeat) {
+
+    // the check value comes from a single operation, independent of the calibration
+    b->check = b->run(b->arg, 1);
+
+    // double the iterations until a run takes a good part of the wanted time
+    uint64_t iters = 1;
+    uint64_t t = 0;
+    for (;;) {
+        uint64_t t0 = usclock();
+        b->run(b->arg, iters);
+        t = usclock() - t0;
+        if (t >= min_us / 4 || iters >= (1ULL << 40)) {
+            break;
+        }
+        iters *= 2;
+    }
+    if (t && t < min_us) {
+        iters = (iters * min_us) / t;
+    }
+
+    double best = 0;
+    for (int r = 0; r < repeat; r++) {
+        uint64_t t0 = usclock();
+        b->run(b->arg, iters);
+        double ns = (double)(usclock() - t0) * 1000.0 / (double)iters;
+        if (r == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    b->iterations = iters;
+    b->ns_per_op = best;
+}
+
+static void bench_rate_str(const bench_t *b, char *out, size_t outlen) {
+    double rate = (b->ns_per_op > 0) ? (double)b->units * 1e9 / b->ns_per_op : 0;
+    const char *prefix = "";
+    if (rate >= 1e9) {
+        rate /= 1e9;
+        prefix = "G";
+    } else if (rate >= 1e6) {
+        rate /= 1e6;
+        prefix = "M";
+    } else if (rate >= 1e3) {
+        rate /= 1e3;
+        prefix = "k";
+    }
+    snprintf(out, outlen, "%7.2f %s%s/s", rate, prefix, b->unit);
+}
+
+static int bench_save_json(const char *filename, uint64_t min_ms, int repeat) {
+    json_t *runs = json_array();
+    for (size_t i = 0; i < num_benches; i++) {
+        const bench_t *b = &benches[i];
+        if (b->iterations == 0) {
+            continue;
+        }
+        // hex string,  a json integer can't hold all 64 bits
+        char check[17];
+        snprintf(check, sizeof(check), "%016" PRIx64, b->check);
+        json_array_append_new(runs, json_pack("{s:s, s:s, s:s, s:I, s:I, s:f, s:f, s:s}",
+                                              "group", b->group,
+                                              "name", b->name,
+                                              "unit", b->unit,
+                                              "units_per_op", (json_int_t)b->units,
+                                              "iterations", (json_int_t)b->iterations,
+                                              "ns_per_op", b->ns_per_op,
+                                              "units_per_s", (b->ns_per_op > 0) ? (double)b->units * 1e9 / b->ns_per_op : 0.0,
+                                              "check", check));
+    }
+
+    json_t *root = json_pack("{s:I, s:i, s:o}", "min_ms", (json_int_t)min_ms, "repeat", repeat, "runs", runs);
+    int res;
+    if (strcmp(filename, "-") == 0) {
+        res = json_dumpf(root, stdout, JSON_INDENT(2));
+        fprintf(stdout, "\n");
+    } else {
+        res = json_dump_file(root, filename, JSON_INDENT(2));
+    }
+    json_decref(root);
+    return (res == 0) ? PM3_SUCCESS : PM3_EFILE;
+}
+
+static void show_help(const char *exec_name) {
+    PrintAndLogEx(NORMAL, "\nsyntax: %s [-h] [-l] [-f <filter>] [-t <ms>] [-r <repeat>] [-j <file>]\n", exec_name);
+    PrintAndLogEx(NORMAL, "    -h/--help                           this help");
+    PrintAndLogEx(NORMAL, "    -l/--list                           list the benchmarks");
+    PrintAndLogEx(NORMAL, "    -f/--filter <text>                  only run benchmarks whose group or name contains <text>");
+    PrintAndLogEx(NORMAL, "    -t/--time <ms>                      minimum time of one measurement (def %u)", BENCH_DEFAULT_MS);
+    PrintAndLogEx(NORMAL, "    -r/--repeat <n>                     measurements per benchmark, the best one counts (def %u)", BENCH_DEFAULT_REPEAT);
+    PrintAndLogEx(NORMAL, "    -j/--json <file>                    save the results as JSON,  '-' for stdout");
+    PrintAndLogEx(NORMAL, "\nsamples:");
+    PrintAndLogEx(NORMAL, "    %s -f crc", exec_name);
+    PrintAndLogEx(NORMAL, "    %s -j bench.json", exec_name);
+    PrintAndLogEx(NORMAL, "");
+}
+
+int main(int argc, char *argv[]) {
+
+    pm3_init();
+    // default paths used by searchFile
+    preferences_load();
+
+    const char *filter = NULL;
+    const char *json_filename = NULL;
+    bool list = false;
+    uint64_t min_ms = BENCH_DEFAULT_MS;
+    int repeat = BENCH_DEFAULT_REPEAT;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            show_help(argv[0]);
+            return 0;
+        }
+        if (strcmp(argv[i], "-l") == 0 || strcmp(argv[i], "--list") == 0) {
+            list = true;
+            continue;
+        }
+        if (i + 1 < argc) {
+            if (strcmp(argv[i], "-f") == 0 || strcmp(argv[i], "--filter") == 0) {
+                filter = argv[++i];
+                continue;
+            }
+            if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "--time") == 0) {
+                min_ms = strtoul(argv[++i], NULL, 10);
+                continue;
+            }
+            if (strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "--repeat") == 0) {
+                repeat = atoi(argv[++i]);
+                continue;
+            }
+            if (strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--json") == 0) {
+                json_filename = argv[++i];
+                continue;
+            }
+        }
+        PrintAndLogEx(ERR, _RED_("ERROR:") " invalid parameter: " _YELLOW_("%s"), argv[i]);
+        show_help(argv[0]);
+        return 1;
+    }
+
+    if (min_ms == 0) {
+        min_ms = 1;
+    }
+    if (repeat < 1) {
+        repeat = 1;
+    }
+
+    // the JSON goes to stdout alone
+    bool quiet = (json_filename != NULL && strcmp(json_filename, "-") == 0);
+    if (quiet) {
+        g_printAndLog = 0;
+    }
+
+    bench_setup();
+
+    if (list) {
+        PrintAndLogEx(INFO, "------------+-----------------------");
+        PrintAndLogEx(INFO, " group      | name");
+        PrintAndLogEx(INFO, "------------+-----------------------");
+    } else if (quiet == false) {
+        PrintAndLogEx(INFO, "------------+-----------------------+-----------------+----------------------+------------------");
+        PrintAndLogEx(INFO, " group      | name                  |           ns/op | rate                 | check");
+        PrintAndLogEx(INFO, "------------+-----------------------+-----------------+----------------------+------------------");
+    }
+
+    for (size_t i = 0; i < num_benches; i++) {
+        bench_t *b = &benches[i];
+        if (filter && strstr(b->group, filter) == NULL && strstr(b->name, filter) == NULL) {
+            continue;
+        }
+
+        if (list) {
+            PrintAndLogEx(INFO, " %-10s | %s", b->group, b->name);
+            continue;
+        }
+
+        bench_run(b, min_ms * 1000, repeat);
+
+        if (quiet == false) {
+            char rate[24];
+            bench_rate_str(b, rate, sizeof(rate));
+            PrintAndLogEx(INFO, " %-10s | %-21s | %15.1f | %-20s | %016" PRIx64,
+                          b->group, b->name, b->ns_per_op, rate, b->check);
+        }
+    }
+
+    if (list == false && json_filename != NULL && json_filename[0] != '\0') {
+        if (bench_save_json(json_filename, min_ms, repeat) != PM3_SUCCESS) {
+            PrintAndLogEx(WARNING, "failed to save " _YELLOW_("%s"), json_filename);
+            return 1;
+        }
+    }
+    return 0;
+}
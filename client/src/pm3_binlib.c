@@ -48,6 +48,7 @@
 #include <lualib.h>
 #include <lauxlib.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "pm3_binlib.h"
 
 
@@ -325,9 +326,110 @@ static int l_pack(lua_State *L) {       /** pack(f,...) */
     return 1;
 }
 
+// hex helpers,  the per byte loops of utils.lua as C
+
+static const char hexdigits[] = "0123456789ABCDEF";
+
+static int hexval(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// bin.tohex(s [, reverse])      'AB' -> '4142'
+static int l_tohex(lua_State *L) {
+    size_t len;
+    const char *s = luaL_checklstring(L, 1, &len);
+    int reverse = lua_toboolean(L, 2);
+    luaL_Buffer b;
+    char *out = luaL_buffinitsize(L, &b, len * 2);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = (uint8_t)s[reverse ? len - 1 - i : i];
+        out[i * 2] = hexdigits[c >> 4];
+        out[i * 2 + 1] = hexdigits[c & 0x0F];
+    }
+    luaL_pushresultsize(&b, len * 2);
+    return 1;
+}
+
+// bin.fromhex(s)                '4142' -> 'AB',  anything between the hex pairs is skipped
+static int l_fromhex(lua_State *L) {
+    size_t len;
+    const char *s = luaL_checklstring(L, 1, &len);
+    luaL_Buffer b;
+    char *out = luaL_buffinitsize(L, &b, len / 2);
+    size_t n = 0;
+    for (size_t i = 0; i + 1 < len;) {
+        int hi = hexval(s[i]);
+        int lo = hexval(s[i + 1]);
+        if (hi < 0 || lo < 0) {
+            i++;
+            continue;
+        }
+        out[n++] = (char)((hi << 4) | lo);
+        i += 2;
+    }
+    luaL_pushresultsize(&b, n);
+    return 1;
+}
+
+// bin.hextobytes(s)             '4142' -> {0x41, 0x42}
+static int l_hextobytes(lua_State *L) {
+    size_t len;
+    const char *s = luaL_checklstring(L, 1, &len);
+    lua_createtable(L, (int)(len / 2), 0);
+    int n = 0;
+    for (size_t i = 0; i + 1 < len;) {
+        int hi = hexval(s[i]);
+        int lo = hexval(s[i + 1]);
+        if (hi < 0 || lo < 0) {
+            i++;
+            continue;
+        }
+        lua_pushinteger(L, (hi << 4) | lo);
+        lua_rawseti(L, -2, ++n);
+        i += 2;
+    }
+    return 1;
+}
+
+// bin.bytestohex(t [, reverse])  {0x41, 0x42} -> '4142'
+static int l_bytestohex(lua_State *L) {
+    luaL_checktype(L, 1, LUA_TTABLE);
+    int reverse = lua_toboolean(L, 2);
+    int n = (int)lua_rawlen(L, 1);
+    luaL_Buffer b;
+    luaL_buffinit(L, &b);
+    for (int i = 1; i <= n; i++) {
+        lua_rawgeti(L, 1, reverse ? n - i + 1 : i);
+        lua_Number v = lua_tonumber(L, -1);
+        if ((lua_isnumber(L, -1) == 0) || (v < 0)) {
+            return luaL_error(L, "bad element #%d, non-negative number expected", reverse ? n - i + 1 : i);
+        }
+        lua_pop(L, 1);
+        if (v >= 0 && v <= 0xFF) {
+            uint8_t c = (uint8_t)v;
+            luaL_addchar(&b, hexdigits[c >> 4]);
+            luaL_addchar(&b, hexdigits[c & 0x0F]);
+        } else {
+            // same as string.format('%02X') for the odd ones
+            char tmp[24];
+            snprintf(tmp, sizeof(tmp), "%02llX", (unsigned long long)(long long)v);
+            luaL_addstring(&b, tmp);
+        }
+    }
+    luaL_pushresult(&b);
+    return 1;
+}
+
 static const luaL_Reg binlib[] = {
-    {"pack",   l_pack},
-    {"unpack", l_unpack},
+    {"pack",       l_pack},
+    {"unpack",     l_unpack},
+    {"tohex",      l_tohex},
+    {"fromhex",    l_fromhex},
+    {"hextobytes", l_hextobytes},
+    {"bytestohex", l_bytestohex},
     {NULL,     NULL}
 };
 
@@ -2684,7 +2684,8 @@ SWIGINTERN int SWIG_lua_isnilstring(lua_State *L, int idx) {
 SWIGINTERN pm3 *new_pm3__SWIG_1(char *port) {
 //            printf("SWIG pm3 constructor with port, open pm3\n");
     pm3_device_t *p = pm3_open(port);
-    p->script_embedded = 0;
+    if (p)
+        p->script_embedded = 0;
     return p;
 }
 SWIGINTERN void delete_pm3(pm3 *self) {
@@ -2791,6 +2792,214 @@ fail:
 }
 
 
+static int _wrap_pm3_console_quiet(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    char *arg2 = (char *) 0 ;
+    int result;
+
+    SWIG_check_num_args("pm3::console_quiet", 2, 2)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::console_quiet", 1, "pm3 *");
+    if (!SWIG_lua_isnilstring(L, 2)) SWIG_fail_arg("pm3::console_quiet", 2, "char *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_console_quiet", 1, SWIGTYPE_p_pm3);
+    }
+
+    arg2 = (char *)lua_tostring(L, 2);
+    result = (int)pm3_console_quiet(arg1, arg2);
+    lua_pushnumber(L, (lua_Number) result);
+    SWIG_arg++;
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_send_queued(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    char *arg3 = (char *) 0 ;
+    int result;
+
+    SWIG_check_num_args("pm3::send_queued", 3, 3)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::send_queued", 1, "pm3 *");
+    if (!lua_isnumber(L, 2)) SWIG_fail_arg("pm3::send_queued", 2, "int");
+    if (!SWIG_lua_isnilstring(L, 3)) SWIG_fail_arg("pm3::send_queued", 3, "char *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_send_queued", 1, SWIGTYPE_p_pm3);
+    }
+
+    arg2 = (int)lua_tointeger(L, 2);
+    arg3 = (char *)lua_tostring(L, 3);
+    result = (int)pm3_send_queued(arg1, arg2, arg3);
+    lua_pushnumber(L, (lua_Number) result);
+    SWIG_arg++;
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_send_queued_raw(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    void *arg3 = (void *) 0 ;
+    size_t arg4 ;
+    int result;
+
+    SWIG_check_num_args("pm3::send_queued_raw", 3, 3)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::send_queued_raw", 1, "pm3 *");
+    if (!lua_isnumber(L, 2)) SWIG_fail_arg("pm3::send_queued_raw", 2, "int");
+    if (!lua_isstring(L, 3)) SWIG_fail_arg("pm3::send_queued_raw", 3, "void const *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_send_queued_raw", 1, SWIGTYPE_p_pm3);
+    }
+
+    arg2 = (int)lua_tointeger(L, 2);
+    {
+        arg3 = (void *)lua_tolstring(L, 3, &arg4);
+    }
+    result = (int)pm3_send_queued_raw(arg1, arg2, (void const *)arg3, arg4);
+    lua_pushnumber(L, (lua_Number) result);
+    SWIG_arg++;
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_poll_queued(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    char *result = 0 ;
+
+    SWIG_check_num_args("pm3::poll_queued", 2, 2)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::poll_queued", 1, "pm3 *");
+    if (!lua_isnumber(L, 2)) SWIG_fail_arg("pm3::poll_queued", 2, "int");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_poll_queued", 1, SWIGTYPE_p_pm3);
+    }
+
+    arg2 = (int)lua_tointeger(L, 2);
+    result = (char *)pm3_poll_queued(arg1, arg2);
+    lua_pushstring(L, (const char *)result);
+    SWIG_arg++;
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_poll_queued_raw(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::poll_queued_raw", 2, 2)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::poll_queued_raw", 1, "pm3 *");
+    if (!lua_isnumber(L, 2)) SWIG_fail_arg("pm3::poll_queued_raw", 2, "int");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_poll_queued_raw", 1, SWIGTYPE_p_pm3);
+    }
+
+    arg2 = (int)lua_tointeger(L, 2);
+    result = pm3_poll_queued_raw(arg1, arg2);
+    {
+        if ((&result)->data == NULL) {
+            lua_pushnil(L);
+        } else {
+            lua_pushlstring(L, (const char *)(&result)->data, (&result)->size);
+        }
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_clear_queued(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+
+    SWIG_check_num_args("pm3::clear_queued", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::clear_queued", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_clear_queued", 1, SWIGTYPE_p_pm3);
+    }
+
+    pm3_clear_queued(arg1);
+
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_bigbuf_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    int arg3 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::bigbuf_get", 3, 3)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::bigbuf_get", 1, "pm3 *");
+    if (!lua_isnumber(L, 2)) SWIG_fail_arg("pm3::bigbuf_get", 2, "int");
+    if (!lua_isnumber(L, 3)) SWIG_fail_arg("pm3::bigbuf_get", 3, "int");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_bigbuf_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    arg2 = (int)lua_tointeger(L, 2);
+    arg3 = (int)lua_tointeger(L, 3);
+    result = pm3_bigbuf_get(arg1, arg2, arg3);
+    {
+        if ((&result)->data == NULL) {
+            lua_pushnil(L);
+        } else {
+            lua_pushlstring(L, (const char *)(&result)->data, (&result)->size);
+        }
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
 static int _wrap_pm3_name_get(lua_State *L) {
     int SWIG_arg = 0;
     pm3 *arg1 = (pm3 *) 0 ;
@@ -2815,6 +3024,90 @@ fail:
 }
 
 
+static int _wrap_pm3_result_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    char *result = 0 ;
+
+    SWIG_check_num_args("pm3::result", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::result", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_result_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = (char *)pm3_result_get(arg1);
+    lua_pushstring(L, (const char *)result);
+    SWIG_arg++;
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_graph_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::graph", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::graph", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_graph_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_graph_get(arg1);
+    {
+        if ((&result)->data == NULL) {
+            lua_pushnil(L);
+        } else {
+            lua_pushlstring(L, (const char *)(&result)->data, (&result)->size);
+        }
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_demod_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::demod", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::demod", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_demod_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_demod_get(arg1);
+    {
+        if ((&result)->data == NULL) {
+            lua_pushnil(L);
+        } else {
+            lua_pushlstring(L, (const char *)(&result)->data, (&result)->size);
+        }
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
 static void swig_delete_pm3(void *obj) {
     pm3 *arg1 = (pm3 *) obj;
     delete_pm3(arg1);
@@ -2829,10 +3122,20 @@ static int _proxy__wrap_new_pm3(lua_State *L) {
 }
 static swig_lua_attribute swig_pm3_attributes[] = {
     { "name", _wrap_pm3_name_get, SWIG_Lua_set_immutable },
+    { "result", _wrap_pm3_result_get, SWIG_Lua_set_immutable },
+    { "graph", _wrap_pm3_graph_get, SWIG_Lua_set_immutable },
+    { "demod", _wrap_pm3_demod_get, SWIG_Lua_set_immutable },
     {0, 0, 0}
 };
 static swig_lua_method swig_pm3_methods[] = {
     { "console", _wrap_pm3_console},
+    { "console_quiet", _wrap_pm3_console_quiet},
+    { "send_queued", _wrap_pm3_send_queued},
+    { "send_queued_raw", _wrap_pm3_send_queued_raw},
+    { "poll_queued", _wrap_pm3_poll_queued},
+    { "poll_queued_raw", _wrap_pm3_poll_queued_raw},
+    { "clear_queued", _wrap_pm3_clear_queued},
+    { "bigbuf_get", _wrap_pm3_bigbuf_get},
     {0, 0}
 };
 static swig_lua_method swig_pm3_meta[] = {
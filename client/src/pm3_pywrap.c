@@ -3258,7 +3258,8 @@ SWIG_AsCharPtrAndSize(PyObject *obj, char **cptr, size_t *psize, int *alloc) {
 SWIGINTERN pm3 *new_pm3__SWIG_1(char *port) {
 //            printf("SWIG pm3 constructor with port, open pm3\n");
     pm3_device_t *p = pm3_open(port);
-    p->script_embedded = 0;
+    if (p)
+        p->script_embedded = 0;
     return p;
 }
 SWIGINTERN void delete_pm3(pm3 *self) {
@@ -3276,6 +3277,37 @@ SWIG_From_int(int value) {
 }
 
 
+SWIGINTERN int
+SWIG_AsVal_long(PyObject *obj, long *val) {
+    if (PyLong_Check(obj)) {
+        long v = PyLong_AsLong(obj);
+        if (!PyErr_Occurred()) {
+            if (val) *val = v;
+            return SWIG_OK;
+        } else {
+            PyErr_Clear();
+            return SWIG_OverflowError;
+        }
+    }
+    return SWIG_TypeError;
+}
+
+
+SWIGINTERN int
+SWIG_AsVal_int(PyObject *obj, int *val) {
+    long v;
+    int res = SWIG_AsVal_long(obj, &v);
+    if (SWIG_IsOK(res)) {
+        if ((v < INT_MIN || v > INT_MAX)) {
+            return SWIG_OverflowError;
+        } else {
+            if (val) *val = (int)(v);
+        }
+    }
+    return res;
+}
+
+
 SWIGINTERNINLINE PyObject *
 SWIG_FromCharPtrAndSize(const char *carray, size_t size) {
     if (carray) {
@@ -3433,6 +3465,270 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_pm3_console_quiet(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    char *arg2 = (char *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    int res2 ;
+    char *buf2 = 0 ;
+    int alloc2 = 0 ;
+    PyObject *swig_obj[2] ;
+    int result;
+
+    (void)self;
+    if (!SWIG_Python_UnpackTuple(args, "pm3_console_quiet", 2, 2, swig_obj)) SWIG_fail;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_console_quiet" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    res2 = SWIG_AsCharPtrAndSize(swig_obj[1], &buf2, NULL, &alloc2);
+    if (!SWIG_IsOK(res2)) {
+        SWIG_exception_fail(SWIG_ArgError(res2), "in method '" "pm3_console_quiet" "', argument " "2"" of type '" "char *""'");
+    }
+    arg2 = (char *)(buf2);
+    result = (int)pm3_console_quiet(arg1, arg2);
+    resultobj = SWIG_From_int((int)(result));
+    if (alloc2 == SWIG_NEWOBJ) free((char *)buf2);
+    return resultobj;
+fail:
+    if (alloc2 == SWIG_NEWOBJ) free((char *)buf2);
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_send_queued(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    char *arg3 = (char *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    int val2 ;
+    int ecode2 = 0 ;
+    int res3 ;
+    char *buf3 = 0 ;
+    int alloc3 = 0 ;
+    PyObject *swig_obj[3] ;
+    int result;
+
+    (void)self;
+    if (!SWIG_Python_UnpackTuple(args, "pm3_send_queued", 3, 3, swig_obj)) SWIG_fail;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_send_queued" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    ecode2 = SWIG_AsVal_int(swig_obj[1], &val2);
+    if (!SWIG_IsOK(ecode2)) {
+        SWIG_exception_fail(SWIG_ArgError(ecode2), "in method '" "pm3_send_queued" "', argument " "2"" of type '" "int""'");
+    }
+    arg2 = (int)(val2);
+    res3 = SWIG_AsCharPtrAndSize(swig_obj[2], &buf3, NULL, &alloc3);
+    if (!SWIG_IsOK(res3)) {
+        SWIG_exception_fail(SWIG_ArgError(res3), "in method '" "pm3_send_queued" "', argument " "3"" of type '" "char *""'");
+    }
+    arg3 = (char *)(buf3);
+    result = (int)pm3_send_queued(arg1, arg2, arg3);
+    resultobj = SWIG_From_int((int)(result));
+    if (alloc3 == SWIG_NEWOBJ) free((char *)buf3);
+    return resultobj;
+fail:
+    if (alloc3 == SWIG_NEWOBJ) free((char *)buf3);
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_send_queued_raw(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    void *arg3 = (void *) 0 ;
+    size_t arg4 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    int val2 ;
+    int ecode2 = 0 ;
+    Py_buffer view3 ;
+    PyObject *swig_obj[3] ;
+    int result;
+
+    (void)self;
+    view3.obj = NULL;
+    if (!SWIG_Python_UnpackTuple(args, "pm3_send_queued_raw", 3, 3, swig_obj)) SWIG_fail;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_send_queued_raw" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    ecode2 = SWIG_AsVal_int(swig_obj[1], &val2);
+    if (!SWIG_IsOK(ecode2)) {
+        SWIG_exception_fail(SWIG_ArgError(ecode2), "in method '" "pm3_send_queued_raw" "', argument " "2"" of type '" "int""'");
+    }
+    arg2 = (int)(val2);
+    {
+        if (PyObject_GetBuffer(swig_obj[2], &view3, PyBUF_SIMPLE) != 0) {
+            SWIG_fail;
+        }
+        arg3 = view3.buf;
+        arg4 = view3.len;
+    }
+    result = (int)pm3_send_queued_raw(arg1, arg2, (void const *)arg3, arg4);
+    resultobj = SWIG_From_int((int)(result));
+    {
+        if (view3.obj) {
+            PyBuffer_Release(&view3);
+        }
+    }
+    return resultobj;
+fail:
+    {
+        if (view3.obj) {
+            PyBuffer_Release(&view3);
+        }
+    }
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_poll_queued(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    int val2 ;
+    int ecode2 = 0 ;
+    PyObject *swig_obj[2] ;
+    char *result = 0 ;
+
+    (void)self;
+    if (!SWIG_Python_UnpackTuple(args, "pm3_poll_queued", 2, 2, swig_obj)) SWIG_fail;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_poll_queued" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    ecode2 = SWIG_AsVal_int(swig_obj[1], &val2);
+    if (!SWIG_IsOK(ecode2)) {
+        SWIG_exception_fail(SWIG_ArgError(ecode2), "in method '" "pm3_poll_queued" "', argument " "2"" of type '" "int""'");
+    }
+    arg2 = (int)(val2);
+    result = (char *)pm3_poll_queued(arg1, arg2);
+    resultobj = SWIG_FromCharPtr((const char *)result);
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_poll_queued_raw(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    int val2 ;
+    int ecode2 = 0 ;
+    PyObject *swig_obj[2] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!SWIG_Python_UnpackTuple(args, "pm3_poll_queued_raw", 2, 2, swig_obj)) SWIG_fail;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_poll_queued_raw" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    ecode2 = SWIG_AsVal_int(swig_obj[1], &val2);
+    if (!SWIG_IsOK(ecode2)) {
+        SWIG_exception_fail(SWIG_ArgError(ecode2), "in method '" "pm3_poll_queued_raw" "', argument " "2"" of type '" "int""'");
+    }
+    arg2 = (int)(val2);
+    result = pm3_poll_queued_raw(arg1, arg2);
+    {
+        if ((&result)->data == NULL) {
+            resultobj = SWIG_Py_Void();
+        } else {
+            resultobj = PyMemoryView_FromMemory((char *)(&result)->data, (&result)->size, PyBUF_WRITE);
+        }
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_clear_queued(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_clear_queued" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    pm3_clear_queued(arg1);
+    resultobj = SWIG_Py_Void();
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_bigbuf_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    int arg2 ;
+    int arg3 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    int val2 ;
+    int ecode2 = 0 ;
+    int val3 ;
+    int ecode3 = 0 ;
+    PyObject *swig_obj[3] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!SWIG_Python_UnpackTuple(args, "pm3_bigbuf_get", 3, 3, swig_obj)) SWIG_fail;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_bigbuf_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    ecode2 = SWIG_AsVal_int(swig_obj[1], &val2);
+    if (!SWIG_IsOK(ecode2)) {
+        SWIG_exception_fail(SWIG_ArgError(ecode2), "in method '" "pm3_bigbuf_get" "', argument " "2"" of type '" "int""'");
+    }
+    arg2 = (int)(val2);
+    ecode3 = SWIG_AsVal_int(swig_obj[2], &val3);
+    if (!SWIG_IsOK(ecode3)) {
+        SWIG_exception_fail(SWIG_ArgError(ecode3), "in method '" "pm3_bigbuf_get" "', argument " "3"" of type '" "int""'");
+    }
+    arg3 = (int)(val3);
+    result = pm3_bigbuf_get(arg1, arg2, arg3);
+    {
+        if ((&result)->data == NULL) {
+            resultobj = SWIG_Py_Void();
+        } else {
+            resultobj = PyMemoryView_FromMemory((char *)(&result)->data, (&result)->size, PyBUF_WRITE);
+        }
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
 SWIGINTERN PyObject *_wrap_pm3_name_get(PyObject *self, PyObject *args) {
     PyObject *resultobj = 0;
     pm3 *arg1 = (pm3 *) 0 ;
@@ -3457,6 +3753,90 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_pm3_result_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    char *result = 0 ;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_result_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = (char *)pm3_result_get(arg1);
+    resultobj = SWIG_FromCharPtr((const char *)result);
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_graph_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_graph_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_graph_get(arg1);
+    {
+        if ((&result)->data == NULL) {
+            resultobj = SWIG_Py_Void();
+        } else {
+            resultobj = PyMemoryView_FromMemory((char *)(&result)->data, (&result)->size, PyBUF_WRITE);
+        }
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_demod_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_demod_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_demod_get(arg1);
+    {
+        if ((&result)->data == NULL) {
+            resultobj = SWIG_Py_Void();
+        } else {
+            resultobj = PyMemoryView_FromMemory((char *)(&result)->data, (&result)->size, PyBUF_WRITE);
+        }
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
 SWIGINTERN PyObject *pm3_swigregister(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
     PyObject *obj;
     if (!SWIG_Python_UnpackTuple(args, "swigregister", 1, 1, &obj)) return NULL;
@@ -3472,7 +3852,17 @@ static PyMethodDef SwigMethods[] = {
     { "new_pm3", _wrap_new_pm3, METH_VARARGS, NULL},
     { "delete_pm3", _wrap_delete_pm3, METH_O, NULL},
     { "pm3_console", _wrap_pm3_console, METH_VARARGS, NULL},
+    { "pm3_console_quiet", _wrap_pm3_console_quiet, METH_VARARGS, NULL},
+    { "pm3_send_queued", _wrap_pm3_send_queued, METH_VARARGS, NULL},
+    { "pm3_send_queued_raw", _wrap_pm3_send_queued_raw, METH_VARARGS, NULL},
+    { "pm3_poll_queued", _wrap_pm3_poll_queued, METH_VARARGS, NULL},
+    { "pm3_poll_queued_raw", _wrap_pm3_poll_queued_raw, METH_VARARGS, NULL},
+    { "pm3_clear_queued", _wrap_pm3_clear_queued, METH_O, NULL},
+    { "pm3_bigbuf_get", _wrap_pm3_bigbuf_get, METH_VARARGS, NULL},
     { "pm3_name_get", _wrap_pm3_name_get, METH_O, NULL},
+    { "pm3_result_get", _wrap_pm3_result_get, METH_O, NULL},
+    { "pm3_graph_get", _wrap_pm3_graph_get, METH_O, NULL},
+    { "pm3_demod_get", _wrap_pm3_demod_get, METH_O, NULL},
     { "pm3_swigregister", pm3_swigregister, METH_O, NULL},
     { "pm3_swiginit", pm3_swiginit, METH_VARARGS, NULL},
     { NULL, NULL, 0, NULL }
@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Structured results of a libpm3 console command
+//-----------------------------------------------------------------------------
+#include "pm3_result.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static json_t *g_result = NULL;
+static char *g_result_text = NULL;
+static bool g_result_collecting = false;
+
+void pm3_result_begin(void) {
+    json_decref(g_result);
+    g_result = json_object();
+    free(g_result_text);
+    g_result_text = NULL;
+    g_result_collecting = true;
+}
+
+void pm3_result_end(void) {
+    g_result_collecting = false;
+}
+
+bool pm3_result_collecting(void) {
+    return g_result_collecting;
+}
+
+void pm3_result_set(const char *key, json_t *value) {
+    if (g_result_collecting == false || g_result == NULL) {
+        json_decref(value);
+        return;
+    }
+    json_object_set_new(g_result, key, value);
+}
+
+void pm3_result_append(const char *key, json_t *value) {
+    if (g_result_collecting == false || g_result == NULL) {
+        json_decref(value);
+        return;
+    }
+
+    json_t *arr = json_object_get(g_result, key);
+    if (json_is_array(arr) == false) {
+        arr = json_array();
+        json_object_set_new(g_result, key, arr);
+    }
+    json_array_append_new(arr, value);
+}
+
+void pm3_result_set_str(const char *key, const char *value) {
+    if (g_result_collecting) {
+        pm3_result_set(key, json_string(value));
+    }
+}
+
+void pm3_result_set_int(const char *key, int64_t value) {
+    if (g_result_collecting) {
+        pm3_result_set(key, json_integer(value));
+    }
+}
+
+json_t *pm3_result_hex(const uint8_t *data, size_t len) {
+    static const char hex[] = "0123456789ABCDEF";
+    char *s = calloc(len * 2 + 1, sizeof(char));
+    if (s == NULL) {
+        return json_null();
+    }
+    for (size_t i = 0; i < len; i++) {
+        s[i * 2] = hex[data[i] >> 4];
+        s[i * 2 + 1] = hex[data[i] & 0x0F];
+    }
+    json_t *res = json_string(s);
+    free(s);
+    return res;
+}
+
+void pm3_result_set_hex(const char *key, const uint8_t *data, size_t len) {
+    if (g_result_collecting) {
+        pm3_result_set(key, pm3_result_hex(data, len));
+    }
+}
+
+const char *pm3_result_text(void) {
+    if (g_result == NULL) {
+        return "{}";
+    }
+    if (g_result_text == NULL) {
+        g_result_text = json_dumps(g_result, JSON_COMPACT);
+    }
+    return (g_result_text != NULL) ? g_result_text : "{}";
+}
+
+json_t *pm3_result_json(void) {
+    if (g_result == NULL) {
+        return json_object();
+    }
+    return json_incref(g_result);
+}
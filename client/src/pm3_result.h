@@ -0,0 +1,46 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Structured results of a libpm3 console command
+//
+// Commands store what they found next to what they print, libpm3 callers get
+// it back as one JSON object (pm3_result_get()) instead of parsing the console
+// text. Nothing is collected unless the command runs through pm3_console().
+//-----------------------------------------------------------------------------
+#ifndef PM3_RESULT_H__
+#define PM3_RESULT_H__
+
+#include "common.h"
+#include "jansson.h"
+
+void pm3_result_begin(void);
+void pm3_result_end(void);
+bool pm3_result_collecting(void);
+
+// value references are stolen
+void pm3_result_set(const char *key, json_t *value);
+void pm3_result_append(const char *key, json_t *value);
+
+void pm3_result_set_str(const char *key, const char *value);
+void pm3_result_set_int(const char *key, int64_t value);
+void pm3_result_set_hex(const char *key, const uint8_t *data, size_t len);
+json_t *pm3_result_hex(const uint8_t *data, size_t len);
+
+// JSON text of the last command,  "{}" when it stored nothing
+const char *pm3_result_text(void);
+// the same as a new reference
+json_t *pm3_result_json(void);
+
+#endif
@@ -0,0 +1,902 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Client daemon
+//
+// One client keeps the device connection, the hardnested tables and whatever
+// else it has loaded, and runs the console commands of other local processes.
+// Every connection is a session sending JSON-RPC 2.0 requests,  one object per
+// line,  and getting one reply line for each request carrying an id,  in order.
+//
+//   -> {"jsonrpc":"2.0","id":1,"method":"console","params":{"cmd":"hf 14a reader"}}
+//   <- {"jsonrpc":"2.0","id":1,"result":{"status":0,"result":{"uid":"..."},
+//       "output":"...","queued_ms":0.02,"run_ms":212.3}}
+//
+// methods:
+//   console {cmd, quiet}   run a console command,  status is its PM3_E* code,  result what it
+//                          stored (see pm3_result.h),  output the text it printed.
+//                          quiet skips the printing,  and the output
+//   metrics                request counts and latencies per method
+//   ping
+//
+// Commands run one at a time on the main thread.  Sessions with requests waiting
+// take turns,  one request each,  so a busy session can't starve the others.
+//
+// With a metrics port a second listener answers HTTP GET /metrics with the client
+// metrics (pm3metrics.h) in Prometheus text format,  from its own thread so a
+// scrape never waits for a running command.  A health interval runs `hw tune`
+// between requests to keep the antenna readings current.
+//-----------------------------------------------------------------------------
+
+#include "pm3daemon.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ui.h"
+#include "util.h"               // kbd_enter_pressed, g_printAndLog
+#include "util_posix.h"         // msclock
+#include "commonutil.h"         // ARRAYLEN
+#include "cmdmain.h"            // CommandReceived
+#include "cmdhfmfhard.h"        // mfnestedhard_keep_warm
+#include "hardnestedserver.h"   // socket helpers
+#include "pm3_result.h"
+#include "pm3metrics.h"
+#include "jansson.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <inttypes.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define DAEMON_MAX_SESSIONS     32
+// requests a session may have waiting,  more are refused
+#define DAEMON_SESSION_QUEUE    16
+#define DAEMON_MAX_LINE         (64 * 1024)
+#define DAEMON_HTTP_LINE        1024
+
+// JSON-RPC 2.0 error codes
+#define RPC_PARSE_ERROR         -32700
+#define RPC_INVALID_REQUEST     -32600
+#define RPC_METHOD_NOT_FOUND    -32601
+#define RPC_INVALID_PARAMS      -32602
+#define RPC_BUSY                -32000
+
+typedef struct daemon_req_s {
+    json_t *msg;
+    uint64_t t_recv;
+    struct daemon_req_s *next;
+} daemon_req_t;
+
+typedef struct {
+    int fd;
+    uint32_t id;
+    bool opened;
+    bool closed;
+    pthread_t thread;
+    pthread_mutex_t send_lock;
+    daemon_req_t *head;
+    daemon_req_t *tail;
+    uint32_t pending;
+} daemon_session_t;
+
+typedef json_t *(*daemon_method_fn)(json_t *params, int *err, const char **errmsg);
+
+typedef struct {
+    const char *name;
+    daemon_method_fn fn;
+    uint32_t count;
+    uint32_t errors;
+    double queued_ms;
+    double queued_max_ms;
+    double run_ms;
+    double run_max_ms;
+} daemon_method_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    daemon_session_t *sessions[DAEMON_MAX_SESSIONS];
+    uint32_t next_id;
+    uint8_t turn;
+    uint32_t pending;
+    uint32_t opened;
+    uint32_t closed;
+    volatile bool stop;
+    int listen_fd;
+    int metrics_fd;
+    uint64_t started;
+} srv = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER, .listen_fd = -1, .metrics_fd = -1 };
+
+static uint64_t daemon_usclock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return ((uint64_t)t.tv_sec * 1000000) + (t.tv_nsec / 1000);
+}
+
+static void daemon_send(daemon_session_t *s, json_t *msg) {
+    char *text = json_dumps(msg, JSON_COMPACT | JSON_REAL_PRECISION(6));
+    if (text == NULL) {
+        return;
+    }
+    size_t len = strlen(text);
+    char *line = realloc(text, len + 2);
+    if (line == NULL) {
+        free(text);
+        return;
+    }
+    line[len++] = '\n';
+    line[len] = '\0';
+
+    pthread_mutex_lock(&s->send_lock);
+    hardnested_send_all(s->fd, line, len);
+    pthread_mutex_unlock(&s->send_lock);
+    free(line);
+}
+
+static void daemon_reply(daemon_session_t *s, json_t *id, json_t *result) {
+    json_t *msg = json_object();
+    json_object_set_new(msg, "jsonrpc", json_string("2.0"));
+    json_object_set(msg, "id", id ? id : json_null());
+    json_object_set(msg, "result", result);
+    daemon_send(s, msg);
+    json_decref(msg);
+}
+
+static void daemon_reply_error(daemon_session_t *s, json_t *id, int code, const char *message) {
+    json_t *msg = json_object();
+    json_object_set_new(msg, "jsonrpc", json_string("2.0"));
+    json_object_set(msg, "id", id ? id : json_null());
+    json_t *err = json_object();
+    json_object_set_new(err, "code", json_integer(code));
+    json_object_set_new(err, "message", json_string(message));
+    json_object_set_new(msg, "error", err);
+    daemon_send(s, msg);
+    json_decref(msg);
+}
+
+// JSON strings must be UTF-8,  console text mostly is
+static json_t *daemon_text(char *text) {
+    json_t *res = json_string(text);
+    if (res == NULL) {
+        for (char *p = text; *p; p++) {
+            if ((uint8_t)*p >= 0x80) {
+                *p = '?';
+            }
+        }
+        res = json_string(text);
+    }
+    return res ? res : json_string("");
+}
+
+//-----------------------------------------------------------------------------
+// methods,  run on the main thread
+//-----------------------------------------------------------------------------
+
+// commands which would end,  or nest,  the daemon
+static const char *daemon_refused[] = { "daemon", "quit", "exit" };
+
+static json_t *daemon_console(json_t *params, int *err, const char **errmsg) {
+    const char *cmd = json_string_value(json_object_get(params, "cmd"));
+    if (cmd == NULL) {
+        *err = RPC_INVALID_PARAMS;
+        *errmsg = "cmd missing";
+        return NULL;
+    }
+
+    const char *word = cmd;
+    while (isspace((unsigned char)*word)) {
+        word++;
+    }
+    size_t wlen = 0;
+    while (word[wlen] && isspace((unsigned char)word[wlen]) == 0) {
+        wlen++;
+    }
+    for (size_t i = 0; i < ARRAYLEN(daemon_refused); i++) {
+        if (wlen == strlen(daemon_refused[i]) && strncasecmp(word, daemon_refused[i], wlen) == 0) {
+            *err = RPC_INVALID_PARAMS;
+            *errmsg = "command not available in the daemon";
+            return NULL;
+        }
+    }
+
+    bool quiet = json_is_true(json_object_get(params, "quiet"));
+
+    // the output goes to the session log and the reply,  not to the daemon console
+    uint8_t old_printAndLog = g_printAndLog;
+    g_printAndLog = (quiet) ? 0 : PRINTANDLOG_LOG;
+    if (quiet == false) {
+        PrintAndLogCaptureStart();
+    }
+
+    uint64_t t = daemon_usclock();
+    pm3_metrics_command_begin(cmd);
+    pm3_result_begin();
+    int status = CommandReceived(cmd);
+    pm3_result_end();
+    pm3_metrics_command_end(status, (daemon_usclock() - t) / 1000.0);
+
+    char *output = (quiet) ? NULL : PrintAndLogCaptureStop();
+    g_printAndLog = old_printAndLog;
+    FlushPrintAndLog();
+
+    json_t *res = json_object();
+    json_object_set_new(res, "status", json_integer(status));
+    json_object_set_new(res, "result", pm3_result_json());
+    if (output) {
+        json_object_set_new(res, "output", daemon_text(output));
+        free(output);
+    }
+    return res;
+}
+
+#define DAEMON_METHODS  3
+static daemon_method_t daemon_methods[DAEMON_METHODS];
+
+static json_t *daemon_get_metrics(json_t *params, int *err, const char **errmsg) {
+    (void)params;
+    (void)err;
+    (void)errmsg;
+
+    json_t *res = json_object();
+    json_object_set_new(res, "uptime_s", json_integer((msclock() - srv.started) / 1000));
+
+    pthread_mutex_lock(&srv.lock);
+    uint32_t sessions = 0;
+    for (uint8_t i = 0; i < DAEMON_MAX_SESSIONS; i++) {
+        if (srv.sessions[i] && srv.sessions[i]->closed == false) {
+            sessions++;
+        }
+    }
+    json_object_set_new(res, "sessions", json_integer(sessions));
+    json_object_set_new(res, "queued", json_integer(srv.pending));
+    pthread_mutex_unlock(&srv.lock);
+
+    json_t *methods = json_object();
+    for (uint8_t i = 0; i < DAEMON_METHODS; i++) {
+        daemon_method_t *m = &daemon_methods[i];
+        json_t *o = json_object();
+        json_object_set_new(o, "count", json_integer(m->count));
+        json_object_set_new(o, "errors", json_integer(m->errors));
+        json_object_set_new(o, "queued_ms_avg", json_real(m->count ? m->queued_ms / m->count : 0));
+        json_object_set_new(o, "queued_ms_max", json_real(m->queued_max_ms));
+        json_object_set_new(o, "run_ms_avg", json_real(m->count ? m->run_ms / m->count : 0));
+        json_object_set_new(o, "run_ms_max", json_real(m->run_max_ms));
+        json_object_set_new(methods, m->name, o);
+    }
+    json_object_set_new(res, "methods", methods);
+    return res;
+}
+
+static json_t *daemon_ping(json_t *params, int *err, const char **errmsg) {
+    (void)params;
+    (void)err;
+    (void)errmsg;
+    return json_string("pong");
+}
+
+static daemon_method_t daemon_methods[DAEMON_METHODS] = {
+    { .name = "console", .fn = daemon_console },
+    { .name = "metrics", .fn = daemon_get_metrics },
+    { .name = "ping",    .fn = daemon_ping },
+};
+
+static void daemon_handle(daemon_session_t *s, daemon_req_t *req) {
+    uint64_t t_start = daemon_usclock();
+
+    json_t *id = json_object_get(req->msg, "id");
+    const char *method = json_string_value(json_object_get(req->msg, "method"));
+    json_t *params = json_object_get(req->msg, "params");
+
+    daemon_method_t *m = NULL;
+    for (uint8_t i = 0; i < DAEMON_METHODS; i++) {
+        if (strcmp(daemon_methods[i].name, method) == 0) {
+            m = &daemon_methods[i];
+        }
+    }
+
+    int err = 0;
+    const char *errmsg = NULL;
+    json_t *result = NULL;
+    if (m == NULL) {
+        err = RPC_METHOD_NOT_FOUND;
+        errmsg = "method not found";
+    } else {
+        result = m->fn(params, &err, &errmsg);
+    }
+
+    double queued_ms = (t_start - req->t_recv) / 1000.0;
+    double run_ms = (daemon_usclock() - t_start) / 1000.0;
+
+    if (m) {
+        m->count++;
+        m->queued_ms += queued_ms;
+        m->run_ms += run_ms;
+        m->queued_max_ms = MAX(m->queued_max_ms, queued_ms);
+        m->run_max_ms = MAX(m->run_max_ms, run_ms);
+        json_t *status = json_object_get(result, "status");
+        if (err || (status && json_integer_value(status) != PM3_SUCCESS)) {
+            m->errors++;
+        }
+    }
+
+    if (json_is_object(result)) {
+        json_object_set_new(result, "queued_ms", json_real(queued_ms));
+        json_object_set_new(result, "run_ms", json_real(run_ms));
+    }
+
+    // requests without an id are notifications,  nobody waits for their reply
+    if (id) {
+        if (result) {
+            daemon_reply(s, id, result);
+        } else {
+            daemon_reply_error(s, id, err, errmsg);
+        }
+    }
+
+    if (m && m->fn == daemon_console && result) {
+        PrintAndLogEx(INFO, "session " _YELLOW_("%u") "  %s  ( queued %.1f ms, run %.1f ms )",
+                      s->id, json_string_value(json_object_get(params, "cmd")), queued_ms, run_ms);
+    }
+
+    json_decref(result);
+    json_decref(req->msg);
+    free(req);
+}
+
+//-----------------------------------------------------------------------------
+// sessions
+//-----------------------------------------------------------------------------
+
+static void daemon_request(daemon_session_t *s, const char *line, size_t len) {
+    size_t i = 0;
+    while (i < len && isspace((unsigned char)line[i])) {
+        i++;
+    }
+    if (i == len) {
+        return;
+    }
+
+    json_error_t error;
+    json_t *msg = json_loadb(line, len, 0, &error);
+    if (msg == NULL) {
+        daemon_reply_error(s, NULL, RPC_PARSE_ERROR, error.text);
+        return;
+    }
+
+    json_t *id = json_object_get(msg, "id");
+    if (json_is_object(msg) == false || json_is_string(json_object_get(msg, "method")) == false) {
+        daemon_reply_error(s, id, RPC_INVALID_REQUEST, "invalid request");
+        json_decref(msg);
+        return;
+    }
+
+    daemon_req_t *req = calloc(1, sizeof(daemon_req_t));
+    if (req == NULL) {
+        daemon_reply_error(s, id, RPC_BUSY, "out of memory");
+        json_decref(msg);
+        return;
+    }
+    req->msg = msg;
+    req->t_recv = daemon_usclock();
+
+    pthread_mutex_lock(&srv.lock);
+    bool busy = (s->pending >= DAEMON_SESSION_QUEUE);
+    if (busy == false) {
+        if (s->tail) {
+            s->tail->next = req;
+        } else {
+            s->head = req;
+        }
+        s->tail = req;
+        s->pending++;
+        srv.pending++;
+        pthread_cond_signal(&srv.cond);
+    }
+    pthread_mutex_unlock(&srv.lock);
+
+    if (busy) {
+        daemon_reply_error(s, id, RPC_BUSY, "too many requests waiting");
+        json_decref(msg);
+        free(req);
+    }
+}
+
+static void *daemon_session_thread(void *arg) {
+    daemon_session_t *s = arg;
+
+    char *line = calloc(DAEMON_MAX_LINE, sizeof(char));
+    size_t n = 0;
+    bool too_long = false;
+
+    while (line && srv.stop == false) {
+        char buf[4096];
+        ssize_t r = recv(s->fd, buf, sizeof(buf), 0);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            break;
+        }
+
+        for (ssize_t i = 0; i < r; i++) {
+            if (buf[i] == '\n') {
+                if (too_long) {
+                    daemon_reply_error(s, NULL, RPC_INVALID_REQUEST, "request too long");
+                } else {
+                    daemon_request(s, line, n);
+                }
+                n = 0;
+                too_long = false;
+            } else if (n < DAEMON_MAX_LINE) {
+                line[n++] = buf[i];
+            } else {
+                too_long = true;
+            }
+        }
+    }
+    free(line);
+
+    pthread_mutex_lock(&srv.lock);
+    s->closed = true;
+    srv.closed++;
+    pthread_cond_signal(&srv.cond);
+    pthread_mutex_unlock(&srv.lock);
+    return NULL;
+}
+
+static void daemon_session_free(daemon_session_t *s) {
+    pthread_join(s->thread, NULL);
+    close(s->fd);
+    while (s->head) {
+        daemon_req_t *req = s->head;
+        s->head = req->next;
+        json_decref(req->msg);
+        free(req);
+    }
+    pthread_mutex_destroy(&s->send_lock);
+    free(s);
+}
+
+// announce the new sessions and free those whose connection is gone.  On the main thread,
+// the output of the other threads would end up in the output of the running command
+static void daemon_sessions_update(void) {
+    pthread_mutex_lock(&srv.lock);
+    if (srv.opened == 0 && srv.closed == 0) {
+        pthread_mutex_unlock(&srv.lock);
+        return;
+    }
+    daemon_session_t *gone[DAEMON_MAX_SESSIONS];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < DAEMON_MAX_SESSIONS; i++) {
+        daemon_session_t *s = srv.sessions[i];
+        if (s && s->opened) {
+            PrintAndLogEx(INFO, "session " _YELLOW_("%u") " opened", s->id);
+            s->opened = false;
+        }
+        if (s && s->closed) {
+            srv.pending -= s->pending;
+            srv.sessions[i] = NULL;
+            gone[n++] = s;
+        }
+    }
+    srv.opened = 0;
+    srv.closed = 0;
+    pthread_mutex_unlock(&srv.lock);
+
+    for (uint8_t i = 0; i < n; i++) {
+        PrintAndLogEx(INFO, "session " _YELLOW_("%u") " closed", gone[i]->id);
+        daemon_session_free(gone[i]);
+    }
+}
+
+// the next request,  taking the sessions in turn.  Waits up to timeout_ms when there is none
+static daemon_req_t *daemon_next(daemon_session_t **session, uint32_t timeout_ms) {
+    pthread_mutex_lock(&srv.lock);
+    if (srv.pending == 0 && srv.opened == 0 && srv.closed == 0 && srv.stop == false) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += timeout_ms / 1000;
+        ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&srv.cond, &srv.lock, &ts);
+    }
+
+    daemon_req_t *req = NULL;
+    for (uint8_t k = 1; k <= DAEMON_MAX_SESSIONS && srv.pending; k++) {
+        uint8_t i = (srv.turn + k) % DAEMON_MAX_SESSIONS;
+        daemon_session_t *s = srv.sessions[i];
+        if (s == NULL || s->head == NULL || s->closed) {
+            continue;
+        }
+        req = s->head;
+        s->head = req->next;
+        if (s->head == NULL) {
+            s->tail = NULL;
+        }
+        s->pending--;
+        srv.pending--;
+        srv.turn = i;
+        *session = s;
+        break;
+    }
+    pthread_mutex_unlock(&srv.lock);
+    return req;
+}
+
+static void daemon_accept(int fd) {
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+
+    daemon_session_t *s = calloc(1, sizeof(daemon_session_t));
+    if (s == NULL) {
+        close(fd);
+        return;
+    }
+    s->fd = fd;
+    pthread_mutex_init(&s->send_lock, NULL);
+
+    pthread_mutex_lock(&srv.lock);
+    int slot = -1;
+    for (uint8_t i = 0; i < DAEMON_MAX_SESSIONS; i++) {
+        if (srv.sessions[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot >= 0) {
+        s->id = ++srv.next_id;
+        if (pthread_create(&s->thread, NULL, daemon_session_thread, s) == 0) {
+            srv.sessions[slot] = s;
+            s->opened = true;
+            srv.opened++;
+            pthread_cond_signal(&srv.cond);
+        } else {
+            slot = -1;
+        }
+    }
+    pthread_mutex_unlock(&srv.lock);
+
+    if (slot < 0) {
+        daemon_reply_error(s, NULL, RPC_BUSY, "too many sessions");
+        pthread_mutex_destroy(&s->send_lock);
+        free(s);
+        close(fd);
+    }
+}
+
+static void *daemon_accept_thread(void *arg) {
+    (void)arg;
+    while (srv.stop == false) {
+        int fd = accept(srv.listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (srv.stop) {
+                break;
+            }
+            if (errno != EINTR) {
+                msleep(100);
+            }
+            continue;
+        }
+        daemon_accept(fd);
+    }
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// metrics endpoint
+//-----------------------------------------------------------------------------
+
+static void daemon_http_reply(int fd, const char *status, const char *type, const char *body) {
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.0 %s\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n",
+                     status, type, strlen(body));
+    if (n > 0 && hardnested_send_all(fd, head, n)) {
+        hardnested_send_all(fd, body, strlen(body));
+    }
+}
+
+static void daemon_http(int fd) {
+    // a scraper that stops talking mustn't hold up the next one
+    struct timeval tv = { .tv_sec = 2, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    char request[DAEMON_HTTP_LINE];
+    if (hardnested_recv_line(fd, request, sizeof(request)) == false) {
+        return;
+    }
+    // the headers aren't needed,  but are read so the close doesn't reset the connection
+    char header[DAEMON_HTTP_LINE];
+    while (hardnested_recv_line(fd, header, sizeof(header)) && header[0]) {}
+
+    char method[8] = {0}, path[64] = {0};
+    if (sscanf(request, "%7s %63s", method, path) != 2 || strcmp(method, "GET")) {
+        daemon_http_reply(fd, "405 Method Not Allowed", "text/plain", "GET only\n");
+        return;
+    }
+    char *q = strchr(path, '?');
+    if (q) {
+        *q = '\0';
+    }
+    if (strcmp(path, "/metrics") && strcmp(path, "/")) {
+        daemon_http_reply(fd, "404 Not Found", "text/plain", "try /metrics\n");
+        return;
+    }
+
+    char *text = pm3_metrics_render();
+    if (text == NULL) {
+        daemon_http_reply(fd, "500 Internal Server Error", "text/plain", "out of memory\n");
+        return;
+    }
+
+    // the daemon's own,  the rest comes from pm3metrics
+    pthread_mutex_lock(&srv.lock);
+    uint32_t sessions = 0;
+    for (uint8_t i = 0; i < DAEMON_MAX_SESSIONS; i++) {
+        if (srv.sessions[i] && srv.sessions[i]->closed == false) {
+            sessions++;
+        }
+    }
+    uint32_t queued = srv.pending;
+    pthread_mutex_unlock(&srv.lock);
+
+    char own[512];
+    snprintf(own, sizeof(own),
+             "# HELP pm3_daemon_uptime_seconds Time since the daemon started\n"
+             "# TYPE pm3_daemon_uptime_seconds gauge\n"
+             "pm3_daemon_uptime_seconds %" PRIu64 "\n"
+             "# HELP pm3_daemon_sessions Connected sessions\n"
+             "# TYPE pm3_daemon_sessions gauge\n"
+             "pm3_daemon_sessions %u\n"
+             "# HELP pm3_daemon_queued_requests Requests waiting to run\n"
+             "# TYPE pm3_daemon_queued_requests gauge\n"
+             "pm3_daemon_queued_requests %u\n",
+             (msclock() - srv.started) / 1000, sessions, queued);
+
+    size_t len = strlen(own) + strlen(text) + 1;
+    char *body = calloc(len, sizeof(char));
+    if (body == NULL) {
+        free(text);
+        daemon_http_reply(fd, "500 Internal Server Error", "text/plain", "out of memory\n");
+        return;
+    }
+    strcpy(body, own);
+    strcat(body, text);
+    free(text);
+
+    daemon_http_reply(fd, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body);
+    free(body);
+}
+
+static void *daemon_metrics_thread(void *arg) {
+    (void)arg;
+    while (srv.stop == false) {
+        int fd = accept(srv.metrics_fd, NULL, NULL);
+        if (fd < 0) {
+            if (srv.stop) {
+                break;
+            }
+            if (errno != EINTR) {
+                msleep(100);
+            }
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        daemon_http(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+// `hw tune` between requests,  its readings go to the metrics
+static void daemon_health(void) {
+    if (g_session.pm3_present == false) {
+        return;
+    }
+    uint8_t old_printAndLog = g_printAndLog;
+    g_printAndLog = 0;
+    CommandReceived("hw tune");
+    g_printAndLog = old_printAndLog;
+    FlushPrintAndLog();
+}
+
+static int daemon_listen_unix(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        PrintAndLogEx(ERR, "Socket path too long " _YELLOW_("%s"), path);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // a socket file is left behind when a daemon didn't stop cleanly,  unless it still runs
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        PrintAndLogEx(ERR, "A daemon already listens on " _YELLOW_("%s"), path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || chmod(path, 0600) != 0 || listen(fd, 16) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+/**
+ * @brief Serve console commands to other processes until <Enter> is pressed.
+ *
+ * @param socket_path  unix socket,  only the user running the client may connect
+ * @param bind_addr    when socket_path is NULL,  TCP address to listen on
+ * @param metrics_port HTTP port for GET /metrics on bind_addr,  or 127.0.0.1.  0 for none
+ * @param health_s     seconds between `hw tune` runs for the metrics,  0 for none
+ */
+int daemon_serve(const char *socket_path, const char *bind_addr, uint16_t port, uint16_t metrics_port, uint32_t health_s) {
+#ifdef _WIN32
+    (void)socket_path;
+    (void)bind_addr;
+    (void)port;
+    (void)metrics_port;
+    (void)health_s;
+    PrintAndLogEx(WARNING, "The client daemon isn't available on Windows");
+    return PM3_ENOTIMPL;
+#else
+    if (socket_path) {
+        srv.listen_fd = daemon_listen_unix(socket_path);
+    } else {
+        srv.listen_fd = hardnested_listen(bind_addr, port);
+    }
+    if (srv.listen_fd < 0) {
+        if (socket_path) {
+            PrintAndLogEx(ERR, "Could not listen on " _YELLOW_("%s"), socket_path);
+        } else {
+            PrintAndLogEx(ERR, "Could not listen on " _YELLOW_("%s:%u"), bind_addr, port);
+        }
+        return PM3_EIO;
+    }
+
+    const char *metrics_addr = (bind_addr) ? bind_addr : "127.0.0.1";
+    if (metrics_port) {
+        srv.metrics_fd = hardnested_listen(metrics_addr, metrics_port);
+        if (srv.metrics_fd < 0) {
+            PrintAndLogEx(ERR, "Could not listen on " _YELLOW_("%s:%u"), metrics_addr, metrics_port);
+            close(srv.listen_fd);
+            srv.listen_fd = -1;
+            return PM3_EIO;
+        }
+    }
+
+    srv.stop = false;
+    srv.started = msclock();
+    pthread_t accept_thread, metrics_thread;
+    if (pthread_create(&accept_thread, NULL, daemon_accept_thread, NULL) != 0) {
+        close(srv.listen_fd);
+        srv.listen_fd = -1;
+        if (srv.metrics_fd >= 0) {
+            close(srv.metrics_fd);
+            srv.metrics_fd = -1;
+        }
+        return PM3_ESOFT;
+    }
+    if (srv.metrics_fd >= 0 && pthread_create(&metrics_thread, NULL, daemon_metrics_thread, NULL) != 0) {
+        close(srv.metrics_fd);
+        srv.metrics_fd = -1;
+        PrintAndLogEx(WARNING, "Could not start the metrics endpoint");
+    }
+
+    if (socket_path) {
+        PrintAndLogEx(SUCCESS, "Daemon listening on " _YELLOW_("%s"), socket_path);
+    } else {
+        PrintAndLogEx(SUCCESS, "Daemon listening on " _YELLOW_("%s:%u"), bind_addr, port);
+    }
+    if (srv.metrics_fd >= 0) {
+        PrintAndLogEx(SUCCESS, "Metrics on " _YELLOW_("http://%s:%u/metrics"), metrics_addr, metrics_port);
+    }
+    PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to stop");
+
+    mfnestedhard_keep_warm(true);
+
+    uint64_t kbd_check = 0;
+    // first reading right away
+    uint64_t health_check = msclock() - ((uint64_t)health_s * 1000);
+    while (true) {
+        daemon_sessions_update();
+
+        daemon_session_t *s = NULL;
+        daemon_req_t *req = daemon_next(&s, 100);
+        if (req) {
+            daemon_handle(s, req);
+        } else if (health_s && msclock() - health_check >= (uint64_t)health_s * 1000) {
+            daemon_health();
+            health_check = msclock();
+        }
+
+        if (msclock() - kbd_check >= 100) {
+            if (kbd_enter_pressed()) {
+                break;
+            }
+            kbd_check = msclock();
+        }
+    }
+
+    srv.stop = true;
+    shutdown(srv.listen_fd, SHUT_RDWR);
+    close(srv.listen_fd);
+    pthread_join(accept_thread, NULL);
+    srv.listen_fd = -1;
+    if (srv.metrics_fd >= 0) {
+        shutdown(srv.metrics_fd, SHUT_RDWR);
+        close(srv.metrics_fd);
+        pthread_join(metrics_thread, NULL);
+        srv.metrics_fd = -1;
+    }
+
+    // wake up the session threads,  their connections close
+    pthread_mutex_lock(&srv.lock);
+    for (uint8_t i = 0; i < DAEMON_MAX_SESSIONS; i++) {
+        if (srv.sessions[i]) {
+            shutdown(srv.sessions[i]->fd, SHUT_RDWR);
+            srv.sessions[i]->closed = true;
+            srv.closed++;
+        }
+    }
+    pthread_mutex_unlock(&srv.lock);
+    daemon_sessions_update();
+
+    if (socket_path) {
+        unlink(socket_path);
+    }
+
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < DAEMON_METHODS; i++) {
+        total += daemon_methods[i].count;
+    }
+    mfnestedhard_keep_warm(false);
+    PrintAndLogEx(INFO, "Daemon stopped, " _YELLOW_("%u") " requests served", total);
+    return PM3_SUCCESS;
+#endif
+}
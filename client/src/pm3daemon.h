@@ -0,0 +1,34 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Client daemon,  one long running client serves console commands to many
+// local processes over JSON-RPC
+//-----------------------------------------------------------------------------
+
+#ifndef PM3DAEMON_H__
+#define PM3DAEMON_H__
+
+#include "common.h"
+
+#define PM3DAEMON_SOCKET    "daemon.sock"
+#define PM3DAEMON_PORT      9211
+
+#define PM3DAEMON_METRICS_PORT  9212
+
+// socket_path: unix socket to listen on,  or NULL for TCP on bind_addr:port
+// metrics_port: HTTP GET /metrics,  0 for none.  health_s: `hw tune` interval,  0 for none
+int daemon_serve(const char *socket_path, const char *bind_addr, uint16_t port, uint16_t metrics_port, uint32_t health_s);
+
+#endif
@@ -21,6 +21,7 @@
 #include <stdio.h> // for Mingw readline and for getline
 #include <string.h>
 #include <signal.h>
+#include <pthread.h>
 #if defined(HAVE_READLINE)
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -31,40 +32,82 @@
 #include "pm3_cmd.h"
 #include "ui.h"                          // g_session
 #include "util.h"                        // str_ndup
+#include "commonutil.h"                  // ARRAYLEN
+
+// history entries kept,  and saved,  at most
+#define PM3LINE_HISTORY_MAX     1000
 
 #if defined(HAVE_READLINE)
 
+// the vocabulary in sorted order,  built once.  The commands sharing a prefix are
+// next to each other,  a binary search finds the first one
+static uint16_t vocabulary_index[ARRAYLEN(vocabulary)];
+static size_t vocabulary_count = 0;
+
+static int vocabulary_cmp(const void *a, const void *b) {
+    return strcmp(vocabulary[*(const uint16_t *)a].name, vocabulary[*(const uint16_t *)b].name);
+}
+
+static void vocabulary_index_build(void) {
+    vocabulary_count = 0;
+    while (vocabulary[vocabulary_count].name) {
+        vocabulary_index[vocabulary_count] = vocabulary_count;
+        vocabulary_count++;
+    }
+    qsort(vocabulary_index, vocabulary_count, sizeof(vocabulary_index[0]), vocabulary_cmp);
+}
+
+// position of the first command starting with prefix,  if any
+static size_t vocabulary_first(const char *prefix, size_t len) {
+    size_t lo = 0;
+    size_t hi = vocabulary_count;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (strncmp(vocabulary[vocabulary_index[mid]].name, prefix, len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// the next command starting with prefix from pos on,  or NULL.
+// When no pm3 device present and the command is not available offline, we skip it.
+static const char *vocabulary_next(size_t *pos, const char *prefix, size_t len) {
+    while (*pos < vocabulary_count) {
+        const vocabulary_t *v = &vocabulary[vocabulary_index[*pos]];
+        if (strncmp(v->name, prefix, len) != 0) {
+            *pos = vocabulary_count;
+            break;
+        }
+        (*pos)++;
+        if ((g_session.pm3_present == false) && (v->offline == false))  {
+            continue;
+        }
+        return v->name;
+    }
+    return NULL;
+}
+
 static char *rl_command_generator(const char *text, int state) {
-    static int index;
+    static size_t pos;
     static size_t len;
     size_t rlen = strlen(rl_line_buffer);
     const char *command;
 
     if (!state) {
-        index = 0;
+        pos = vocabulary_first(rl_line_buffer, rlen);
         len = strlen(text);
     }
 
-    while ((command = vocabulary[index].name))  {
-
-        // When no pm3 device present
-        // and the command is not available offline,
-        // we skip it.
-        if ((g_session.pm3_present == false) && (vocabulary[index].offline == false))  {
-            index++;
-            continue;
-        }
-
-        index++;
-
-        if (strncmp(command, rl_line_buffer, rlen) == 0) {
-            const char *next = command + (rlen - len);
-            const char *space = strstr(next, " ");
-            if (space != NULL) {
-                return str_ndup(next, space - next);
-            }
-            return str_dup(next);
+    if ((command = vocabulary_next(&pos, rl_line_buffer, rlen)))  {
+        const char *next = command + (rlen - len);
+        const char *space = strstr(next, " ");
+        if (space != NULL) {
+            return str_ndup(next, space - next);
         }
+        return str_dup(next);
     }
 
     return NULL;
@@ -77,39 +120,28 @@ static char **rl_command_completion(const char *text, int start, int end) {
 
 #elif defined(HAVE_LINENOISE)
 static void ln_command_completion(const char *text, linenoiseCompletions *lc) {
-    int index = 0;
     const char *prev_match = "";
     size_t prev_match_len = 0;
     size_t len = strlen(text);
+    size_t pos = vocabulary_first(text, len);
     const char *command;
-    while ((command = vocabulary[index].name))  {
-
-        // When no pm3 device present
-        // and the command is not available offline,
-        // we skip it.
-        if ((g_session.pm3_present == false) && (vocabulary[index].offline == false))  {
-            index++;
-            continue;
-        }
-
-        index++;
-
-        if (strncmp(command, text, len) == 0) {
-            const char *space = strstr(command + len, " ");
-            if (space != NULL) {
-                if ((prev_match_len == 0) || (strncmp(prev_match, command, prev_match_len < space - command ? prev_match_len : space - command) != 0)) {
-                    linenoiseAddCompletion(lc, str_ndup(command, space - command + 1));
-                    prev_match = command;
-                    prev_match_len = space - command + 1;
-                }
-            } else {
-                linenoiseAddCompletion(lc, command);
+    while ((command = vocabulary_next(&pos, text, len)))  {
+        const char *space = strstr(command + len, " ");
+        if (space != NULL) {
+            if ((prev_match_len == 0) || (strncmp(prev_match, command, prev_match_len < space - command ? prev_match_len : space - command) != 0)) {
+                linenoiseAddCompletion(lc, str_ndup(command, space - command + 1));
+                prev_match = command;
+                prev_match_len = space - command + 1;
             }
+        } else {
+            linenoiseAddCompletion(lc, command);
         }
     }
 }
 #endif // HAVE_READLINE
 
+static void history_flush(bool wait_saver);
+
 #  if defined(_WIN32)
 /*
 static bool WINAPI terminate_handler(DWORD t) {
@@ -127,7 +159,8 @@ static void sigint_handler(int signum) {
     switch (signum) {
         case SIGINT: {
             sigaction(SIGINT, &gs_old_sigint_action, NULL);
-            pm3line_flush_history();
+            // the saver may hold its lock in the interrupted code,  don't wait for it
+            history_flush(false);
             kill(0, SIGINT);
             break;
         }
@@ -157,8 +190,11 @@ void pm3line_install_signals(void) {
 
 void pm3line_init(void) {
 #if defined(HAVE_READLINE)
+    vocabulary_index_build();
+
     /* initialize history */
     using_history();
+    stifle_history(PM3LINE_HISTORY_MAX);
     rl_readline_name = "PM3";
     rl_attempted_completion_function = rl_command_completion;
 
@@ -175,6 +211,7 @@ void pm3line_init(void) {
 #endif // RL_STATE_READCMD
 #elif defined(HAVE_LINENOISE)
     linenoiseInstallWindowChangeHandler();
+    linenoiseHistorySetMaxLen(PM3LINE_HISTORY_MAX);
     linenoiseSetCompletionCallback(ln_command_completion);
 #endif // HAVE_READLINE
 }
@@ -212,9 +249,142 @@ void pm3line_update_prompt(const char *prompt) {
 #endif
 }
 
+#if defined(HAVE_READLINE)
+// drop the older copies of repeated lines,  newest first.  At most PM3LINE_HISTORY_MAX entries
+static void history_dedup(void) {
+    for (int i = history_length - 2; i >= 0; i--) {
+        HIST_ENTRY **list = history_list();
+        for (int j = i + 1; j < history_length; j++) {
+            if (strcmp(list[i]->line, list[j]->line) == 0) {
+                free_history_entry(remove_history(i));
+                break;
+            }
+        }
+    }
+}
+
+// the history is written out by a thread in the background after each new line,
+// so a crashed or killed client still has it and the prompt never waits for the disk
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    bool running;
+    bool stop;
+    char *pending;
+} history_saver = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+static void history_write_file(const char *path, const char *text) {
+    char tmp[FILE_PATH_SIZE];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) {
+        return;
+    }
+    FILE *f = fopen(tmp, "w");
+    if (f == NULL) {
+        return;
+    }
+    size_t len = strlen(text);
+    bool ok = (fwrite(text, 1, len, f) == len);
+    ok &= (fclose(f) == 0);
+    if (ok == false) {
+        remove(tmp);
+        return;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    rename(tmp, path);
+}
+
+static void *history_saver_thread(void *arg) {
+    char *path = arg;
+    pthread_mutex_lock(&history_saver.lock);
+    while (true) {
+        while (history_saver.pending == NULL && history_saver.stop == false) {
+            pthread_cond_wait(&history_saver.cond, &history_saver.lock);
+        }
+        if (history_saver.pending == NULL) {
+            break;
+        }
+        char *text = history_saver.pending;
+        history_saver.pending = NULL;
+        pthread_mutex_unlock(&history_saver.lock);
+
+        history_write_file(path, text);
+        free(text);
+
+        pthread_mutex_lock(&history_saver.lock);
+    }
+    pthread_mutex_unlock(&history_saver.lock);
+    free(path);
+    return NULL;
+}
+
+// hand a copy of the history to the saver,  replacing one it didn't get to yet
+static void history_save_async(void) {
+    if (g_session.history_path == NULL) {
+        return;
+    }
+
+    HIST_ENTRY **list = history_list();
+    size_t len = 0;
+    for (int i = 0; list && i < history_length; i++) {
+        len += strlen(list[i]->line) + 1;
+    }
+    char *text = calloc(len + 1, sizeof(char));
+    if (text == NULL) {
+        return;
+    }
+    char *p = text;
+    for (int i = 0; list && i < history_length; i++) {
+        size_t n = strlen(list[i]->line);
+        memcpy(p, list[i]->line, n);
+        p += n;
+        *p++ = '\n';
+    }
+
+    pthread_mutex_lock(&history_saver.lock);
+    if (history_saver.running == false) {
+        char *path = str_dup(g_session.history_path);
+        if (path && pthread_create(&history_saver.thread, NULL, history_saver_thread, path) == 0) {
+            history_saver.running = true;
+        } else {
+            free(path);
+        }
+    }
+    if (history_saver.running) {
+        free(history_saver.pending);
+        history_saver.pending = text;
+        text = NULL;
+        pthread_cond_signal(&history_saver.cond);
+    }
+    pthread_mutex_unlock(&history_saver.lock);
+    free(text);
+}
+
+// the final write is done by the caller,  drop what is pending and let the saver finish
+static void history_saver_stop(void) {
+    pthread_mutex_lock(&history_saver.lock);
+    if (history_saver.running == false) {
+        pthread_mutex_unlock(&history_saver.lock);
+        return;
+    }
+    free(history_saver.pending);
+    history_saver.pending = NULL;
+    history_saver.stop = true;
+    pthread_cond_signal(&history_saver.cond);
+    pthread_mutex_unlock(&history_saver.lock);
+
+    pthread_join(history_saver.thread, NULL);
+    history_saver.running = false;
+    history_saver.stop = false;
+}
+#endif // HAVE_READLINE
+
 int pm3line_load_history(const char *path) {
 #if defined(HAVE_READLINE)
     if (read_history(path) == 0) {
+        history_dedup();
         return PM3_SUCCESS;
     } else {
         return PM3_ESOFT;
@@ -233,11 +403,19 @@ int pm3line_load_history(const char *path) {
 
 void pm3line_add_history(const char *line) {
 #if defined(HAVE_READLINE)
-    HIST_ENTRY *entry = history_get(history_length);
-    // add if not identical to latest recorded line
-    if ((!entry) || (strcmp(entry->line, line) != 0)) {
-        add_history(line);
+    // a repeated line moves to the end
+    HIST_ENTRY **list = history_list();
+    for (int i = history_length - 1; list && i >= 0; i--) {
+        if (strcmp(list[i]->line, line) == 0) {
+            if (i == history_length - 1) {
+                return;
+            }
+            free_history_entry(remove_history(i));
+            break;
+        }
     }
+    add_history(line);
+    history_save_async();
 #elif defined(HAVE_LINENOISE)
     // linenoiseHistoryAdd takes already care of duplicate entries
     linenoiseHistoryAdd(line);
@@ -246,7 +424,14 @@ void pm3line_add_history(const char *line) {
 #endif
 }
 
-void pm3line_flush_history(void) {
+static void history_flush(bool wait_saver) {
+#if defined(HAVE_READLINE)
+    if (wait_saver) {
+        history_saver_stop();
+    }
+#else
+    (void) wait_saver;
+#endif
     if (g_session.history_path) {
 #if defined(HAVE_READLINE)
         write_history(g_session.history_path);
@@ -258,6 +443,10 @@ void pm3line_flush_history(void) {
     }
 }
 
+void pm3line_flush_history(void) {
+    history_flush(true);
+}
+
 void pm3line_check(int (check)(void)) {
 #if defined(HAVE_READLINE)
     rl_event_hook = check;
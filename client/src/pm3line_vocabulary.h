@@ -338,6 +338,8 @@ const static vocabulary_t vocabulary[] = {
     { 0, "hf mf darkside" },
     { 0, "hf mf nested" },
     { 1, "hf mf hardnested" },
+    { 1, "hf mf hardbench" },
+    { 1, "hf mf hardworker" },
     { 0, "hf mf staticnested" },
     { 0, "hf mf brute" },
     { 0, "hf mf autopwn" },
@@ -0,0 +1,437 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Client metrics
+//
+// Counters a fleet scrapes instead of parsing console output.  They are kept
+// all the time,  cheaply,  and `daemon --metrics` serves them over HTTP:
+//
+//   pm3_console_commands_total{protocol,result}    console commands run
+//   pm3_console_command_duration_seconds{protocol}  histogram of their run time
+//   pm3_rf_errors_total{protocol}                  device replies with an RF error status
+//   pm3_rf_timeouts_total{protocol}                waits for a reply that timed out
+//   pm3_device_commands_total{cmd}                 and the round trip histogram per
+//   pm3_device_command_duration_seconds{cmd}       device command,  see `hw timings`
+//   pm3_key_checks_total{kind}                     keys tried by the fast key checks,
+//   pm3_key_check_seconds_total{kind}              rate() of one over the other is keys/s
+//   pm3_attack_phase_seconds{attack,phase}         hardnested phases,  sum / count / last
+//   pm3_antenna_volts{band}                        last `hw tune`
+//   pm3_device_connected
+//
+// The protocol label is the first two words of the console command running,
+// "hf mf", "lf em",  or "other" outside of one.  Everything is written by the
+// main and the communication thread and read by the scraping thread,  under one lock.
+//-----------------------------------------------------------------------------
+
+#include "pm3metrics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include "ui.h"                 // g_session
+#include "comms.h"              // GetCommandTimings
+#include "commonutil.h"         // ARRAYLEN
+#include "util_posix.h"         // process_rss
+
+#define METRICS_MAX_PROTOCOLS   32
+#define METRICS_MAX_KINDS       8
+#define METRICS_MAX_PHASES      16
+#define METRICS_LABEL_LEN       24
+#define METRICS_BUCKETS         11
+
+// upper limits of the console command histogram,  in seconds.  Last bucket is +Inf
+static const double metrics_limits[METRICS_BUCKETS] = {0.01, 0.05, 0.1, 0.5, 1, 5, 10, 30, 60, 300, 0};
+
+typedef struct {
+    char name[METRICS_LABEL_LEN];
+    uint64_t ok;
+    uint64_t failed;
+    uint64_t rf_errors;
+    uint64_t rf_timeouts;
+    uint64_t hist[METRICS_BUCKETS];
+    double sum_s;
+} metrics_protocol_t;
+
+typedef struct {
+    char name[METRICS_LABEL_LEN];
+    uint64_t keys;
+    uint64_t ms;
+} metrics_kind_t;
+
+typedef struct {
+    char attack[METRICS_LABEL_LEN];
+    char phase[METRICS_LABEL_LEN];
+    uint64_t count;
+    uint64_t sum_ms;
+    uint64_t last_ms;
+} metrics_phase_t;
+
+static struct {
+    pthread_mutex_t lock;
+    int8_t current;             // protocol of the running command,  -1 for none
+    uint8_t num_protocols;
+    metrics_protocol_t protocols[METRICS_MAX_PROTOCOLS];
+    uint8_t num_kinds;
+    metrics_kind_t kinds[METRICS_MAX_KINDS];
+    uint8_t num_phases;
+    metrics_phase_t phases[METRICS_MAX_PHASES];
+    uint32_t antenna_mv[3];
+    uint64_t antenna_time;
+} metrics = { .lock = PTHREAD_MUTEX_INITIALIZER, .current = -1 };
+
+static const char *metrics_bands[3] = { "lf125", "lf134", "hf" };
+
+// label values are command words,  keep them to [a-z0-9 ] so they never need escaping
+static void metrics_label(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; src[i] && i < METRICS_LABEL_LEN - 1 && i < n; i++) {
+        char c = tolower((unsigned char)src[i]);
+        dst[i] = (isalnum((unsigned char)c) || c == ' ') ? c : '_';
+    }
+    dst[i] = '\0';
+}
+
+// "other" is slot 0,  for whatever runs outside of a console command.  Call with the lock held
+static int8_t metrics_protocol(const char *name) {
+    if (metrics.num_protocols == 0) {
+        strcpy(metrics.protocols[0].name, "other");
+        metrics.num_protocols = 1;
+    }
+    for (uint8_t i = 0; i < metrics.num_protocols; i++) {
+        if (strcmp(metrics.protocols[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (metrics.num_protocols == METRICS_MAX_PROTOCOLS) {
+        return 0;
+    }
+    metrics_protocol_t *p = &metrics.protocols[metrics.num_protocols];
+    memset(p, 0, sizeof(metrics_protocol_t));
+    strcpy(p->name, name);
+    return metrics.num_protocols++;
+}
+
+void pm3_metrics_command_begin(const char *cmd) {
+    // first two words
+    const char *s = cmd;
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    const char *e = s;
+    for (uint8_t w = 0; w < 2 && *e; w++) {
+        while (*e && isspace((unsigned char)*e) == 0) {
+            e++;
+        }
+        if (w == 0) {
+            while (isspace((unsigned char)*e)) {
+                e++;
+            }
+        }
+    }
+    while (e > s && isspace((unsigned char)e[-1])) {
+        e--;
+    }
+
+    char name[METRICS_LABEL_LEN];
+    metrics_label(name, s, e - s);
+
+    pthread_mutex_lock(&metrics.lock);
+    metrics.current = (name[0]) ? metrics_protocol(name) : -1;
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void pm3_metrics_command_end(int status, double run_ms) {
+    pthread_mutex_lock(&metrics.lock);
+    if (metrics.current >= 0) {
+        metrics_protocol_t *p = &metrics.protocols[metrics.current];
+        if (status == PM3_SUCCESS) {
+            p->ok++;
+        } else {
+            p->failed++;
+        }
+        double s = run_ms / 1000.0;
+        uint8_t b = 0;
+        while (b < METRICS_BUCKETS - 1 && s > metrics_limits[b]) {
+            b++;
+        }
+        p->hist[b]++;
+        p->sum_s += s;
+    }
+    metrics.current = -1;
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void pm3_metrics_rf_error(void) {
+    pthread_mutex_lock(&metrics.lock);
+    int8_t i = (metrics.current >= 0) ? metrics.current : metrics_protocol("other");
+    metrics.protocols[i].rf_errors++;
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void pm3_metrics_rf_timeout(void) {
+    pthread_mutex_lock(&metrics.lock);
+    int8_t i = (metrics.current >= 0) ? metrics.current : metrics_protocol("other");
+    metrics.protocols[i].rf_timeouts++;
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void pm3_metrics_keys_checked(const char *kind, uint64_t keys, uint64_t ms) {
+    pthread_mutex_lock(&metrics.lock);
+    metrics_kind_t *k = NULL;
+    for (uint8_t i = 0; i < metrics.num_kinds; i++) {
+        if (strcmp(metrics.kinds[i].name, kind) == 0) {
+            k = &metrics.kinds[i];
+        }
+    }
+    if (k == NULL && metrics.num_kinds < METRICS_MAX_KINDS) {
+        k = &metrics.kinds[metrics.num_kinds++];
+        memset(k, 0, sizeof(metrics_kind_t));
+        metrics_label(k->name, kind, strlen(kind));
+    }
+    if (k) {
+        k->keys += keys;
+        k->ms += ms;
+    }
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void pm3_metrics_phase(const char *attack, const char *phase, uint64_t ms) {
+    pthread_mutex_lock(&metrics.lock);
+    metrics_phase_t *p = NULL;
+    for (uint8_t i = 0; i < metrics.num_phases; i++) {
+        if (strcmp(metrics.phases[i].attack, attack) == 0 && strcmp(metrics.phases[i].phase, phase) == 0) {
+            p = &metrics.phases[i];
+        }
+    }
+    if (p == NULL && metrics.num_phases < METRICS_MAX_PHASES) {
+        p = &metrics.phases[metrics.num_phases++];
+        memset(p, 0, sizeof(metrics_phase_t));
+        metrics_label(p->attack, attack, strlen(attack));
+        metrics_label(p->phase, phase, strlen(phase));
+    }
+    if (p) {
+        p->count++;
+        p->sum_ms += ms;
+        p->last_ms = ms;
+    }
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+void pm3_metrics_antenna(uint32_t lf125_mv, uint32_t lf134_mv, uint32_t hf_mv) {
+    pthread_mutex_lock(&metrics.lock);
+    // a streaming tune only measures one of them
+    if (lf125_mv) {
+        metrics.antenna_mv[0] = lf125_mv;
+    }
+    if (lf134_mv) {
+        metrics.antenna_mv[1] = lf134_mv;
+    }
+    if (hf_mv) {
+        metrics.antenna_mv[2] = hf_mv;
+    }
+    metrics.antenna_time = time(NULL);
+    pthread_mutex_unlock(&metrics.lock);
+}
+
+//-----------------------------------------------------------------------------
+// exposition
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t size;
+    bool failed;
+} metrics_text_t;
+
+static void metrics_printf(metrics_text_t *t, const char *fmt, ...) {
+    if (t->failed) {
+        return;
+    }
+    while (true) {
+        va_list args;
+        va_start(args, fmt);
+        int n = vsnprintf(t->buf + t->len, t->size - t->len, fmt, args);
+        va_end(args);
+        if (n < 0) {
+            t->failed = true;
+            return;
+        }
+        if (t->len + n < t->size) {
+            t->len += n;
+            return;
+        }
+        size_t size = MAX(t->size * 2, t->len + n + 1);
+        char *buf = realloc(t->buf, size);
+        if (buf == NULL) {
+            t->failed = true;
+            return;
+        }
+        t->buf = buf;
+        t->size = size;
+    }
+}
+
+static void metrics_head(metrics_text_t *t, const char *name, const char *type, const char *help) {
+    metrics_printf(t, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void metrics_render_protocols(metrics_text_t *t) {
+    metrics_head(t, "pm3_console_commands_total", "counter", "Console commands run");
+    for (uint8_t i = 0; i < metrics.num_protocols; i++) {
+        metrics_protocol_t *p = &metrics.protocols[i];
+        if (p->ok + p->failed == 0) {
+            continue;
+        }
+        metrics_printf(t, "pm3_console_commands_total{protocol=\"%s\",result=\"ok\"} %" PRIu64 "\n", p->name, p->ok);
+        metrics_printf(t, "pm3_console_commands_total{protocol=\"%s\",result=\"failed\"} %" PRIu64 "\n", p->name, p->failed);
+    }
+
+    metrics_head(t, "pm3_console_command_duration_seconds", "histogram", "Run time of console commands");
+    for (uint8_t i = 0; i < metrics.num_protocols; i++) {
+        metrics_protocol_t *p = &metrics.protocols[i];
+        uint64_t count = p->ok + p->failed;
+        if (count == 0) {
+            continue;
+        }
+        uint64_t acc = 0;
+        for (uint8_t b = 0; b < METRICS_BUCKETS - 1; b++) {
+            acc += p->hist[b];
+            metrics_printf(t, "pm3_console_command_duration_seconds_bucket{protocol=\"%s\",le=\"%g\"} %" PRIu64 "\n", p->name, metrics_limits[b], acc);
+        }
+        metrics_printf(t, "pm3_console_command_duration_seconds_bucket{protocol=\"%s\",le=\"+Inf\"} %" PRIu64 "\n", p->name, count);
+        metrics_printf(t, "pm3_console_command_duration_seconds_sum{protocol=\"%s\"} %.6f\n", p->name, p->sum_s);
+        metrics_printf(t, "pm3_console_command_duration_seconds_count{protocol=\"%s\"} %" PRIu64 "\n", p->name, count);
+    }
+
+    metrics_head(t, "pm3_rf_errors_total", "counter", "Device replies with an RF error status");
+    for (uint8_t i = 0; i < metrics.num_protocols; i++) {
+        metrics_printf(t, "pm3_rf_errors_total{protocol=\"%s\"} %" PRIu64 "\n", metrics.protocols[i].name, metrics.protocols[i].rf_errors);
+    }
+    metrics_head(t, "pm3_rf_timeouts_total", "counter", "Waits for a device reply that timed out");
+    for (uint8_t i = 0; i < metrics.num_protocols; i++) {
+        metrics_printf(t, "pm3_rf_timeouts_total{protocol=\"%s\"} %" PRIu64 "\n", metrics.protocols[i].name, metrics.protocols[i].rf_timeouts);
+    }
+}
+
+static void metrics_render_device(metrics_text_t *t) {
+    cmd_timing_t timings[CMD_TIMING_SLOTS];
+    size_t n = GetCommandTimings(timings, ARRAYLEN(timings));
+
+    metrics_head(t, "pm3_device_commands_total", "counter", "Commands sent to the device");
+    for (size_t i = 0; i < n; i++) {
+        metrics_printf(t, "pm3_device_commands_total{cmd=\"0x%04x\"} %u\n", timings[i].cmd, timings[i].sent);
+    }
+    metrics_head(t, "pm3_device_command_errors_total", "counter", "Device replies with an RF error status");
+    for (size_t i = 0; i < n; i++) {
+        metrics_printf(t, "pm3_device_command_errors_total{cmd=\"0x%04x\"} %u\n", timings[i].cmd, timings[i].errors);
+    }
+    metrics_head(t, "pm3_device_command_timeouts_total", "counter", "Waits for a device reply that timed out");
+    for (size_t i = 0; i < n; i++) {
+        metrics_printf(t, "pm3_device_command_timeouts_total{cmd=\"0x%04x\"} %u\n", timings[i].cmd, timings[i].timeouts);
+    }
+
+    metrics_head(t, "pm3_device_command_duration_seconds", "histogram", "Round trip of device commands, command sent to reply");
+    for (size_t i = 0; i < n; i++) {
+        cmd_timing_t *c = &timings[i];
+        uint64_t acc = 0;
+        for (uint8_t b = 0; b < CMD_TIMING_BUCKETS - 1; b++) {
+            acc += c->hist[b];
+            metrics_printf(t, "pm3_device_command_duration_seconds_bucket{cmd=\"0x%04x\",le=\"%g\"} %" PRIu64 "\n"
+                           , c->cmd, GetCommandTimingBucketLimit(b) / 1000.0, acc);
+        }
+        metrics_printf(t, "pm3_device_command_duration_seconds_bucket{cmd=\"0x%04x\",le=\"+Inf\"} %u\n", c->cmd, c->replied);
+        metrics_printf(t, "pm3_device_command_duration_seconds_sum{cmd=\"0x%04x\"} %.6f\n", c->cmd, c->total_us / 1000000.0);
+        metrics_printf(t, "pm3_device_command_duration_seconds_count{cmd=\"0x%04x\"} %u\n", c->cmd, c->replied);
+    }
+}
+
+static void metrics_render_health(metrics_text_t *t) {
+    metrics_head(t, "pm3_device_connected", "gauge", "1 when a Proxmark3 is connected");
+    metrics_printf(t, "pm3_device_connected %u\n", g_session.pm3_present ? 1 : 0);
+
+    uint64_t rss = process_rss();
+    if (rss) {
+        metrics_head(t, "process_resident_memory_bytes", "gauge", "Resident memory size of the client");
+        metrics_printf(t, "process_resident_memory_bytes %" PRIu64 "\n", rss);
+    }
+
+    if (metrics.antenna_time) {
+        metrics_head(t, "pm3_antenna_volts", "gauge", "Antenna voltage of the last hw tune");
+        for (uint8_t i = 0; i < ARRAYLEN(metrics_bands); i++) {
+            if (metrics.antenna_mv[i]) {
+                metrics_printf(t, "pm3_antenna_volts{band=\"%s\"} %.3f\n", metrics_bands[i], metrics.antenna_mv[i] / 1000.0);
+            }
+        }
+        metrics_head(t, "pm3_antenna_measured_timestamp_seconds", "gauge", "Time of the last hw tune");
+        metrics_printf(t, "pm3_antenna_measured_timestamp_seconds %" PRIu64 "\n", metrics.antenna_time);
+    }
+}
+
+static void metrics_render_attacks(metrics_text_t *t) {
+    metrics_head(t, "pm3_key_checks_total", "counter", "Keys tried by the fast key checks");
+    for (uint8_t i = 0; i < metrics.num_kinds; i++) {
+        metrics_printf(t, "pm3_key_checks_total{kind=\"%s\"} %" PRIu64 "\n", metrics.kinds[i].name, metrics.kinds[i].keys);
+    }
+    metrics_head(t, "pm3_key_check_seconds_total", "counter", "Time spent in the fast key checks");
+    for (uint8_t i = 0; i < metrics.num_kinds; i++) {
+        metrics_printf(t, "pm3_key_check_seconds_total{kind=\"%s\"} %.3f\n", metrics.kinds[i].name, metrics.kinds[i].ms / 1000.0);
+    }
+
+    metrics_head(t, "pm3_attack_phase_seconds", "summary", "Time spent in the phases of long attacks");
+    for (uint8_t i = 0; i < metrics.num_phases; i++) {
+        metrics_phase_t *p = &metrics.phases[i];
+        metrics_printf(t, "pm3_attack_phase_seconds_sum{attack=\"%s\",phase=\"%s\"} %.3f\n", p->attack, p->phase, p->sum_ms / 1000.0);
+        metrics_printf(t, "pm3_attack_phase_seconds_count{attack=\"%s\",phase=\"%s\"} %" PRIu64 "\n", p->attack, p->phase, p->count);
+    }
+    metrics_head(t, "pm3_attack_phase_last_seconds", "gauge", "Time spent in the last run of each attack phase");
+    for (uint8_t i = 0; i < metrics.num_phases; i++) {
+        metrics_phase_t *p = &metrics.phases[i];
+        metrics_printf(t, "pm3_attack_phase_last_seconds{attack=\"%s\",phase=\"%s\"} %.3f\n", p->attack, p->phase, p->last_ms / 1000.0);
+    }
+}
+
+/**
+ * @brief All metrics in the Prometheus text exposition format (version 0.0.4).
+ *
+ * @return text to free(),  NULL when out of memory
+ */
+char *pm3_metrics_render(void) {
+    metrics_text_t t = { .buf = NULL, .len = 0, .size = 0, .failed = false };
+    t.size = 8192;
+    t.buf = calloc(t.size, sizeof(char));
+    if (t.buf == NULL) {
+        return NULL;
+    }
+
+    // the device table has its own lock,  don't nest them
+    metrics_render_device(&t);
+
+    pthread_mutex_lock(&metrics.lock);
+    metrics_render_health(&t);
+    metrics_render_protocols(&t);
+    metrics_render_attacks(&t);
+    pthread_mutex_unlock(&metrics.lock);
+
+    if (t.failed) {
+        free(t.buf);
+        return NULL;
+    }
+    return t.buf;
+}
@@ -0,0 +1,45 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Client metrics,  counters for long running clients in Prometheus text format
+//-----------------------------------------------------------------------------
+
+#ifndef PM3METRICS_H__
+#define PM3METRICS_H__
+
+#include "common.h"
+
+// console command about to run,  its first two words are the protocol label
+// of what gets counted until pm3_metrics_command_end()
+void pm3_metrics_command_begin(const char *cmd);
+void pm3_metrics_command_end(int status, double run_ms);
+
+// device replies with an RF error status,  and waits for a reply that timed out
+void pm3_metrics_rf_error(void);
+void pm3_metrics_rf_timeout(void);
+
+// keys tried by a key check,  kind is "mifare", "iclass", ...
+void pm3_metrics_keys_checked(const char *kind, uint64_t keys, uint64_t ms);
+
+// time spent in one phase of a long attack
+void pm3_metrics_phase(const char *attack, const char *phase, uint64_t ms);
+
+// antenna voltages in mV from `hw tune` or a streaming tune,  0 keeps the previous reading
+void pm3_metrics_antenna(uint32_t lf125_mv, uint32_t lf134_mv, uint32_t hf_mv);
+
+// everything in Prometheus text exposition format,  free() it
+char *pm3_metrics_render(void);
+
+#endif
@@ -35,6 +35,7 @@
 #include "cmdparser.h"
 #include "cliparser.h"
 #include "uart/uart.h" // uart_reconfigure_timeouts
+#include "dumpstore.h"  // DUMPSTORE_SUBDIR
 
 static int CmdHelp(const char *Cmd);
 static int setCmdHelp(const char *Cmd);
@@ -67,11 +68,14 @@ int preferences_load(void) {
     g_session.overlay_sliders = true;
     g_session.show_hints = true;
     g_session.dense_output = false;
+    g_session.dump_format = DUMP_JSON;
+    g_session.dump_store = false;
 
     g_session.bar_mode = STYLE_VALUE;
     setDefaultPath(spDefault, "");
     setDefaultPath(spDump, "");
     setDefaultPath(spTrace, "");
+    setDefaultPath(spStore, "");
 
     // default save path
     if (get_my_user_directory() != NULL) // should return path to .proxmark3 folder
@@ -91,6 +95,15 @@ int preferences_load(void) {
     else
         setDefaultPath(spTrace, ".");
 
+    // default dump store path
+    if (get_my_user_directory() != NULL) {
+        char path[FILE_PATH_SIZE] = {0};
+        snprintf(path, sizeof(path), "%s%s%s", get_my_user_directory(), PM3_USER_DIRECTORY, DUMPSTORE_SUBDIR);
+        setDefaultPath(spStore, path);
+    } else {
+        setDefaultPath(spStore, DUMPSTORE_SUBDIR);
+    }
+
     if (g_session.incognito) {
         PrintAndLogEx(INFO, "No preferences file will be loaded");
         return PM3_SUCCESS;
@@ -194,11 +207,15 @@ void preferences_save_callback(json_t *root) {
 
     JsonSaveBoolean(root, "output.dense", g_session.dense_output);
 
+    JsonSaveStr(root, "file.dump.format", (g_session.dump_format == DUMP_PM3DUMP) ? "pm3dump" : "json");
+    JsonSaveBoolean(root, "file.dump.store", g_session.dump_store);
+
     JsonSaveBoolean(root, "os.supports.colors", g_session.supports_colors);
 
     JsonSaveStr(root, "file.default.savepath", g_session.defaultPaths[spDefault]);
     JsonSaveStr(root, "file.default.dumppath", g_session.defaultPaths[spDump]);
     JsonSaveStr(root, "file.default.tracepath", g_session.defaultPaths[spTrace]);
+    JsonSaveStr(root, "file.default.storepath", g_session.defaultPaths[spStore]);
 
     // Plot window
     JsonSaveInt(root, "window.plot.xpos", g_session.plot.x);
@@ -299,6 +316,10 @@ void preferences_load_callback(json_t *root) {
     if (json_unpack_ex(root, &up_error, 0, "{s:s}", "file.default.tracepath", &s1) == 0)
         setDefaultPath(spTrace, s1);
 
+    // dump store path
+    if (json_unpack_ex(root, &up_error, 0, "{s:s}", "file.default.storepath", &s1) == 0)
+        setDefaultPath(spStore, s1);
+
     // window plot
     if (json_unpack_ex(root, &up_error, 0, "{s:i}", "window.plot.xpos", &i1) == 0)
         g_session.plot.x = i1;
@@ -337,6 +358,16 @@ void preferences_load_callback(json_t *root) {
     if (json_unpack_ex(root, &up_error, 0, "{s:b}", "output.dense", &b1) == 0)
         g_session.dense_output = (bool)b1;
 
+    if (json_unpack_ex(root, &up_error, 0, "{s:s}", "file.dump.format", &s1) == 0) {
+        strncpy(tempStr, s1, sizeof(tempStr) - 1);
+        str_lower(tempStr);
+        if (strncmp(tempStr, "json", 4) == 0) g_session.dump_format = DUMP_JSON;
+        if (strncmp(tempStr, "pm3dump", 7) == 0) g_session.dump_format = DUMP_PM3DUMP;
+    }
+
+    if (json_unpack_ex(root, &up_error, 0, "{s:b}", "file.dump.store", &b1) == 0)
+        g_session.dump_store = (bool)b1;
+
     if (json_unpack_ex(root, &up_error, 0, "{s:b}", "os.supports.colors", &b1) == 0)
         g_session.supports_colors = (bool)b1;
 
@@ -504,6 +535,9 @@ static void showSavePathState(savePaths_t path_index, prefShowOpt_t opt) {
         case spTrace:
             strcpy(s, "trace save path.........");
             break;
+        case spStore:
+            strcpy(s, "dump store path.........");
+            break;
         case spItemCount:
         default:
             strcpy(s, _RED_("unknown")" save path.......");
@@ -581,6 +615,20 @@ static void showOutputState(prefShowOpt_t opt) {
                  );
 }
 
+static void showDumpFormatState(prefShowOpt_t opt) {
+    PrintAndLogEx(INFO, "   %s dump format............. %s"
+                  , pref_show_status_msg(opt)
+                  , (g_session.dump_format == DUMP_PM3DUMP) ? pref_show_value(opt, "bin + pm3dump") : pref_show_value(opt, "bin + json")
+                 );
+}
+
+static void showDumpStoreState(prefShowOpt_t opt) {
+    PrintAndLogEx(INFO, "   %s dump store.............. %s"
+                  , pref_show_status_msg(opt)
+                  , (g_session.dump_store) ? pref_show_value(opt, "on") : pref_show_value(opt, "off")
+                 );
+}
+
 static void showClientExeDelayState(void) {
     PrintAndLogEx(INFO, "    cmd execution delay..... "_GREEN_("%u"), g_session.client_exe_delay);
 }
@@ -1005,6 +1053,95 @@ static int setCmdHint(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int setCmdDumpFormat(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs set dumpformat",
+                  "Set the file saved next to the binary file of a dump.\n"
+                  "A pm3dump file is written and loaded without conversion, `data dump2json` makes the JSON file from it",
+                  "prefs set dumpformat --json    --> save dumps as bin + json\n"
+                  "prefs set dumpformat --pm3dump --> save dumps as bin + pm3dump"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "json", "JSON file (default)"),
+        arg_lit0(NULL, "pm3dump", "pm3dump binary container"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool use_json = arg_get_lit(ctx, 1);
+    bool use_pm3dump = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    if ((use_json + use_pm3dump) > 1) {
+        PrintAndLogEx(FAILED, "Can only set one option");
+        return PM3_EINVARG;
+    }
+
+    dumpFormat_t new_value = g_session.dump_format;
+    if (use_json) {
+        new_value = DUMP_JSON;
+    }
+    if (use_pm3dump) {
+        new_value = DUMP_PM3DUMP;
+    }
+
+    if (g_session.dump_format != new_value) {
+        showDumpFormatState(prefShowOLD);
+        g_session.dump_format = new_value;
+        showDumpFormatState(prefShowNEW);
+        preferences_save();
+    } else {
+        showDumpFormatState(prefShowNone);
+    }
+
+    return PM3_SUCCESS;
+}
+
+static int setCmdDumpStore(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs set dumpstore",
+                  "Also keep saved MIFARE Classic dumps in the dump store, found by UID.\n"
+                  "Blocks that are the same in several dumps are stored once,  see `prefs set savepaths --store`",
+                  "prefs set dumpstore --on"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "on", "store saved dumps"),
+        arg_lit0(NULL, "off", "don't store saved dumps (default)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool use_on = arg_get_lit(ctx, 1);
+    bool use_off = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    if ((use_on + use_off) > 1) {
+        PrintAndLogEx(FAILED, "Can only set one option");
+        return PM3_EINVARG;
+    }
+
+    bool new_value = g_session.dump_store;
+    if (use_on) {
+        new_value = true;
+    }
+    if (use_off) {
+        new_value = false;
+    }
+
+    if (g_session.dump_store != new_value) {
+        showDumpStoreState(prefShowOLD);
+        g_session.dump_store = new_value;
+        showDumpStoreState(prefShowNEW);
+        preferences_save();
+    } else {
+        showDumpStoreState(prefShowNone);
+    }
+
+    return PM3_SUCCESS;
+}
+
 static int setCmdPlotSliders(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "prefs set plotsliders",
@@ -1052,7 +1189,8 @@ static int setCmdSavePaths(const char *Cmd) {
     CLIParserInit(&ctx, "prefs set savepaths",
                   "Set persistent preference of file paths in the client",
                   "prefs set savepaths --dump /home/mydumpfolder      -> all dump files will be saved into this folder\n"
-                  "prefs set savepaths --def /home/myfolder -c    -> create if needed, all files will be saved into this folder"
+                  "prefs set savepaths --def /home/myfolder -c    -> create if needed, all files will be saved into this folder\n"
+                  "prefs set savepaths --store /home/mystore      -> MIFARE Classic dumps are kept here, see `prefs set dumpstore`"
                  );
 
     void *argtable[] = {
@@ -1061,6 +1199,7 @@ static int setCmdSavePaths(const char *Cmd) {
         arg_str0(NULL, "def", "<path>", "default path"),
         arg_str0(NULL, "dump", "<path>", "dump file path"),
         arg_str0(NULL, "trace", "<path>", "trace path"),
+        arg_str0(NULL, "store", "<path>", "dump store path"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1077,9 +1216,13 @@ static int setCmdSavePaths(const char *Cmd) {
     int tlen = 0;
     char trace_path[FILE_PATH_SIZE] = {0};
     CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)trace_path, FILE_PATH_SIZE, &tlen);
+
+    int slen = 0;
+    char store_path[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)store_path, FILE_PATH_SIZE, &slen);
     CLIParserFree(ctx);
 
-    if (deflen == 0 && dulen == 0 && tlen == 0) {
+    if (deflen == 0 && dulen == 0 && tlen == 0 && slen == 0) {
         PrintAndLogEx(FAILED, "Must give at least one path");
         return PM3_EINVARG;
     }
@@ -1098,6 +1241,10 @@ static int setCmdSavePaths(const char *Cmd) {
         path_item = spTrace;
         path = trace_path;
     }
+    if (slen) {
+        path_item = spStore;
+        path = store_path;
+    }
 
     // remove trailing slash.
     size_t nplen = strlen(path);
@@ -1255,6 +1402,38 @@ static int getCmdOutput(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int getCmdDumpFormat(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs get dumpformat",
+                  "Get preference of the file saved next to the binary file of a dump",
+                  "prefs get dumpformat"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+    showDumpFormatState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
+static int getCmdDumpStore(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs get dumpstore",
+                  "Get preference of keeping saved dumps in the dump store",
+                  "prefs get dumpstore"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+    showDumpStoreState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
 static int getCmdPlotSlider(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "prefs get plotsliders",
@@ -1302,6 +1481,7 @@ static int getCmdSavePaths(const char *Cmd) {
     showSavePathState(spDefault, prefShowNone);
     showSavePathState(spDump, prefShowNone);
     showSavePathState(spTrace, prefShowNone);
+    showSavePathState(spStore, prefShowNone);
     return PM3_SUCCESS;
 }
 
@@ -1344,6 +1524,8 @@ static command_t CommandTableGet[] = {
     {"client.timeout",   getClientTimeout,    AlwaysAvailable, "Get client execution delay preference"},
     {"color",            getCmdColor,         AlwaysAvailable, "Get color support preference"},
     {"savepaths",        getCmdSavePaths,     AlwaysAvailable, "Get file folder  "},
+    {"dumpformat",       getCmdDumpFormat,    AlwaysAvailable, "Get dump file format preference"},
+    {"dumpstore",        getCmdDumpStore,     AlwaysAvailable, "Get dump store preference"},
     //  {"devicedebug",      getCmdDeviceDebug,   AlwaysAvailable, "Get device debug level"},
     {"emoji",            getCmdEmoji,         AlwaysAvailable, "Get emoji display preference"},
     {"hints",            getCmdHint,          AlwaysAvailable, "Get hint display preference"},
@@ -1363,6 +1545,8 @@ static command_t CommandTableSet[] = {
     {"emoji",            setCmdEmoji,         AlwaysAvailable, "Set emoji display"},
     {"hints",            setCmdHint,          AlwaysAvailable, "Set hint display"},
     {"savepaths",        setCmdSavePaths,     AlwaysAvailable, "... to be adjusted next ... "},
+    {"dumpformat",       setCmdDumpFormat,    AlwaysAvailable, "Set dump file format"},
+    {"dumpstore",        setCmdDumpStore,     AlwaysAvailable, "Set dump store"},
     //  {"devicedebug",      setCmdDeviceDebug,   AlwaysAvailable, "Set device debug level"},
     {"output",           setCmdOutput,        AlwaysAvailable, "Set dump output style"},
     {"plotsliders",      setCmdPlotSliders,   AlwaysAvailable, "Set plot slider display"},
@@ -1416,12 +1600,15 @@ static int CmdPrefShow(const char *Cmd) {
     showSavePathState(spDefault, prefShowNone);
     showSavePathState(spDump, prefShowNone);
     showSavePathState(spTrace, prefShowNone);
+    showSavePathState(spStore, prefShowNone);
     showClientDebugState(prefShowNone);
     showPlotSliderState(prefShowNone);
 //    showDeviceDebugState(prefShowNone);
     showBarModeState(prefShowNone);
     showClientExeDelayState();
     showOutputState(prefShowNone);
+    showDumpFormatState(prefShowNone);
+    showDumpStoreState(prefShowNone);
     showClientTimeoutState();
 
     PrintAndLogEx(NORMAL, "");
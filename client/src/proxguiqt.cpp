@@ -51,6 +51,9 @@ static uint32_t startMaxOld;
 static uint32_t PageWidth; // How many samples are currently visible on this 'page' / graph
 static int unlockStart = 0;
 
+// below this zoom several samples share a pixel column, those are drawn as one min / max column
+#define GRAPH_LOD_PIXELS_PER_POINT (0.5)
+
 void ProxGuiQT::ShowGraphWindow(void) {
     emit ShowGraphWindowSignal();
 }
@@ -337,12 +340,12 @@ void SliderWidget::moveEvent(QMoveEvent *event) {
 //--------------------
 void ProxWidget::applyOperation() {
     //printf("ApplyOperation()");
-    //g_saveState_gb = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
-    memcpy(g_GraphBuffer, g_OverlayBuffer, sizeof(int) * g_GraphTraceLen);
+    //g_saveState_gb = save_bufferS16(g_GraphBuffer, g_GraphTraceLen);
+    memcpy(g_GraphBuffer, g_OverlayBuffer, sizeof(int16_t) * g_GraphTraceLen);
     RepaintGraphWindow();
 }
 void ProxWidget::stickOperation() {
-    //restore_bufferS32(g_saveState_gb, g_GraphBuffer);
+    //restore_bufferS16(g_saveState_gb, g_GraphBuffer);
     //printf("stickOperation()");
 }
 void ProxWidget::vchange_autocorr(int v) {
@@ -352,7 +355,7 @@ void ProxWidget::vchange_autocorr(int v) {
     RepaintGraphWindow();
 }
 void ProxWidget::vchange_askedge(int v) {
-    //extern int AskEdgeDetect(const int *in, int *out, int len, int threshold);
+    //extern int AskEdgeDetect(const int16_t *in, int16_t *out, int len, int threshold);
     int ans = AskEdgeDetect(g_GraphBuffer, g_OverlayBuffer, g_GraphTraceLen, v);
     if (g_debugMode) printf("vchange_askedge(w:%d)%d\n", v, ans);
     g_useOverlays = true;
@@ -522,6 +525,22 @@ int Plot::yCoordOf(int v, QRect r, int maxVal) {
     return -(z * v) / maxVal + z;
 }
 
+// first sample index right of the plot area
+uint32_t Plot::visibleEnd(size_t len, QRect r) {
+    if (g_GraphStart >= len) {
+        return len;
+    }
+    double n = ceil((r.right() - r.left()) / g_GraphPixelsPerPoint);
+    uint32_t end = (uint32_t)MIN((double)len, g_GraphStart + n);
+    while (end > g_GraphStart && xCoordOf(end - 1, r) >= r.right()) {
+        end--;
+    }
+    while (end < len && xCoordOf(end, r) < r.right()) {
+        end++;
+    }
+    return end;
+}
+
 int Plot::valueOf_yCoord(int y, QRect r, int maxVal) {
     int z = (r.bottom() - r.top()) / 2;
     return (y - z) * maxVal / z;
@@ -554,7 +573,7 @@ QColor Plot::getColor(int graphNum) {
     }
 }
 
-void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
+void Plot::setMaxAndStart(int16_t *buffer, size_t len, QRect plotRect, const graphmip_t *mip) {
     if (len == 0) {
         return;
     }
@@ -577,12 +596,19 @@ void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
     }
 
     int vMin = INT_MAX, vMax = INT_MIN;
-    uint32_t sample_index = g_GraphStart ;
-    for (; sample_index < len && xCoordOf(sample_index, plotRect) < plotRect.right() ; sample_index++) {
+    if (mip != NULL && mip->len == len) {
+        int16_t lo, hi;
+        graphmip_range(mip, g_GraphStart, visibleEnd(len, plotRect), &lo, &hi, NULL);
+        vMin = lo;
+        vMax = hi;
+    } else {
+        uint32_t sample_index = g_GraphStart ;
+        for (; sample_index < len && xCoordOf(sample_index, plotRect) < plotRect.right() ; sample_index++) {
 
-        int v = buffer[sample_index];
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
+            int v = buffer[sample_index];
+            if (v < vMin) vMin = v;
+            if (v > vMax) vMax = v;
+        }
     }
 
     gs_absVMax = 0;
@@ -597,7 +623,7 @@ void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
     gs_absVMax = (int)(gs_absVMax * 1.25 + 1);
 }
 
-void Plot::appendMax(int *buffer, size_t len, QRect plotRect) {
+void Plot::appendMax(int16_t *buffer, size_t len, QRect plotRect) {
     if (len == 0) {
         return;
     }
@@ -679,7 +705,7 @@ void Plot::PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotati
     painter->drawPath(penPath);
 }
 
-void Plot::PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum) {
+void Plot::PlotGraph(int16_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum, const graphmip_t *mip) {
 
     if (len == 0) {
         return;
@@ -692,22 +718,59 @@ void Plot::PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRe
     int x = xCoordOf(g_GraphStart, plotRect);
     int y = yCoordOf(buffer[g_GraphStart], plotRect, gs_absVMax);
     penPath.moveTo(x, y);
-    for (i = g_GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
 
-        x = xCoordOf(i, plotRect);
-        v = buffer[i];
-        y = yCoordOf(v, plotRect, gs_absVMax);
+    if (g_GraphPixelsPerPoint < GRAPH_LOD_PIXELS_PER_POINT && mip != NULL && mip->len == len) {
+        // zoomed out, draw one min / max column per pixel instead of every sample
+        uint32_t end = visibleEnd(len, plotRect);
+        i = g_GraphStart;
+        for (int px = plotRect.left(); px < plotRect.right() && i < end; px++) {
+            if (xCoordOf(i, plotRect) > px) {
+                continue;
+            }
+
+            // samples landing on this pixel column
+            double est = g_GraphStart + ceil((px + 1 - plotRect.left()) / g_GraphPixelsPerPoint);
+            uint32_t e = (uint32_t)MAX((double)(i + 1), MIN((double)end, est));
+            while (e > i + 1 && xCoordOf(e - 1, plotRect) > px) {
+                e--;
+            }
+            while (e < end && xCoordOf(e, plotRect) <= px) {
+                e++;
+            }
+
+            int16_t cMin, cMax;
+            int64_t cSum;
+            graphmip_range(mip, i, e, &cMin, &cMax, &cSum);
 
-        penPath.lineTo(x, y);
+            // enter with the first sample, leave with the last one so the columns join up
+            penPath.lineTo(px, yCoordOf(buffer[i], plotRect, gs_absVMax));
+            penPath.lineTo(px, yCoordOf(cMax, plotRect, gs_absVMax));
+            penPath.lineTo(px, yCoordOf(cMin, plotRect, gs_absVMax));
+            penPath.lineTo(px, yCoordOf(buffer[e - 1], plotRect, gs_absVMax));
 
-        if (g_GraphPixelsPerPoint > 10) {
-            QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
-            painter->fillRect(f, GREEN);
+            if (cMin < vMin) vMin = cMin;
+            if (cMax > vMax) vMax = cMax;
+            vMean += cSum;
+            i = e;
+        }
+    } else {
+        for (i = g_GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
+
+            x = xCoordOf(i, plotRect);
+            v = buffer[i];
+            y = yCoordOf(v, plotRect, gs_absVMax);
+
+            penPath.lineTo(x, y);
+
+            if (g_GraphPixelsPerPoint > 10) {
+                QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
+                painter->fillRect(f, GREEN);
+            }
+            // catch stats
+            if (v < vMin) vMin = v;
+            if (v > vMax) vMax = v;
+            vMean += v;
         }
-        // catch stats
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
-        vMean += v;
     }
 
     g_GraphStop = i;
@@ -950,7 +1013,7 @@ void Plot::plotGridLines(QPainter *painter, QRect r) {
     }
 }
 
-void Plot::plotOperations(int *buffer, size_t len, QPainter *painter, QRect plotRect) {
+void Plot::plotOperations(int16_t *buffer, size_t len, QPainter *painter, QRect plotRect) {
     if (len == 0) {
         return;
     }
@@ -1016,8 +1079,11 @@ void Plot::paintEvent(QPaintEvent *event) {
     //Black foreground
     painter.fillRect(plotRect, BLACK);
 
+    // pick up whatever changed in the buffers since the last repaint
+    graphmip_sync(&graphMip, g_GraphBuffer, g_GraphTraceLen);
+
     //init graph variables
-    setMaxAndStart(g_GraphBuffer, g_GraphTraceLen, plotRect);
+    setMaxAndStart(g_GraphBuffer, g_GraphTraceLen, plotRect, &graphMip);
     //appendMax(g_OperationBuffer, g_GraphTraceLen, plotRect);
 
     // center line
@@ -1028,7 +1094,7 @@ void Plot::paintEvent(QPaintEvent *event) {
     plotGridLines(&painter, plotRect);
 
     //Start painting graph
-    PlotGraph(g_GraphBuffer, g_GraphTraceLen, plotRect, infoRect, &painter, 0);
+    PlotGraph(g_GraphBuffer, g_GraphTraceLen, plotRect, infoRect, &painter, 0, &graphMip);
     if (g_DemodBufferLen > 8) {
         PlotDemod(g_DemodBuffer, g_DemodBufferLen, plotRect, infoRect, &painter, 2, g_DemodStartIdx);
     }
@@ -1038,9 +1104,11 @@ void Plot::paintEvent(QPaintEvent *event) {
 
     //Plot the Overlay
     if (g_useOverlays) {
+        graphmip_sync(&overlayMip, g_OverlayBuffer, g_GraphTraceLen);
+
         //init graph variables
-        setMaxAndStart(g_OverlayBuffer, g_GraphTraceLen, plotRect);
-        PlotGraph(g_OverlayBuffer, g_GraphTraceLen, plotRect, infoRect, &painter, 1);
+        setMaxAndStart(g_OverlayBuffer, g_GraphTraceLen, plotRect, &overlayMip);
+        PlotGraph(g_OverlayBuffer, g_GraphTraceLen, plotRect, infoRect, &painter, 1, &overlayMip);
     }
     // End graph drawing
 
@@ -1107,10 +1175,18 @@ Plot::Plot(QWidget *parent) : QWidget(parent), g_GraphPixelsPerPoint(1) {
     g_GraphStart = 0;
     g_GraphStop = 0;
 
+    memset(&graphMip, 0, sizeof(graphMip));
+    memset(&overlayMip, 0, sizeof(overlayMip));
+
     setWindowTitle(tr("Sliders"));
     master = parent;
 }
 
+Plot::~Plot() {
+    graphmip_free(&graphMip);
+    graphmip_free(&overlayMip);
+}
+
 void Plot::closeEvent(QCloseEvent *event) {
     event->ignore();
     this->hide();
@@ -1133,7 +1209,8 @@ void Plot::Zoom(double factor, uint32_t refX) {
             }
         }
     } else {          // Zoom out
-        if (g_GraphPixelsPerPointNew >= (1.0 / ZOOM_LIMIT)) {
+        // zoomed out views are drawn from the min / max pyramid, so allow seeing the whole trace
+        if (g_GraphPixelsPerPointNew >= (1.0 / ZOOM_LIMIT) || PageWidth < g_GraphTraceLen) {
             g_GraphPixelsPerPoint = g_GraphPixelsPerPointNew;
             // shift graph towards refX when zooming out
             if (refX > g_GraphStart) {
@@ -1472,9 +1549,9 @@ void Plot::keyPressEvent(QKeyEvent *event) {
 
         case Qt::Key_Plus:
             if (event->modifiers() & Qt::ControlModifier) {
-                g_GraphBuffer[g_MarkerA.pos] += 5;
+                g_GraphBuffer[g_MarkerA.pos] = clampGraphSample(g_GraphBuffer[g_MarkerA.pos] + 5);
             } else {
-                g_GraphBuffer[g_MarkerA.pos] += 1;
+                g_GraphBuffer[g_MarkerA.pos] = clampGraphSample(g_GraphBuffer[g_MarkerA.pos] + 1);
             }
 
             RepaintGraphWindow();
@@ -1482,9 +1559,9 @@ void Plot::keyPressEvent(QKeyEvent *event) {
 
         case Qt::Key_Underscore:
             if (event->modifiers() & Qt::ControlModifier) {
-                g_GraphBuffer[g_MarkerA.pos] -= 5;
+                g_GraphBuffer[g_MarkerA.pos] = clampGraphSample(g_GraphBuffer[g_MarkerA.pos] - 5);
             } else {
-                g_GraphBuffer[g_MarkerA.pos] -= 1;
+                g_GraphBuffer[g_MarkerA.pos] = clampGraphSample(g_GraphBuffer[g_MarkerA.pos] - 1);
             }
 
             RepaintGraphWindow();
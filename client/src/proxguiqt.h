@@ -31,6 +31,7 @@
 
 #include "proxgui.h"
 #include "graph.h"
+#include "graphmip.h"
 #include "ui/ui_overlays.h"
 #include "ui/ui_image.h"
 
@@ -45,21 +46,25 @@ class Plot: public QWidget {
   private:
     QWidget *master;
     double g_GraphPixelsPerPoint; // How many visual pixels are between each sample point (x axis)
-    void PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum);
+    graphmip_t graphMip;          // min / max pyramids for drawing zoomed out views
+    graphmip_t overlayMip;
+    void PlotGraph(int16_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum, const graphmip_t *mip);
     void PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum, uint32_t plotOffset);
     void plotGridLines(QPainter *painter, QRect r);
-    void plotOperations(int *buffer, size_t len, QPainter *painter, QRect rect);
+    void plotOperations(int16_t *buffer, size_t len, QPainter *painter, QRect rect);
     void drawAnnotations(QRect annotationRect, QPainter *painter);
     void draw_marker(marker_t marker, QRect plotRect, QColor color, QPainter *painter);
     int xCoordOf(int i, QRect r);
     int yCoordOf(int v, QRect r, int maxVal);
     int valueOf_yCoord(int y, QRect r, int maxVal);
-    void setMaxAndStart(int *buffer, size_t len, QRect plotRect);
-    void appendMax(int *buffer, size_t len, QRect plotRect);
+    uint32_t visibleEnd(size_t len, QRect r);
+    void setMaxAndStart(int16_t *buffer, size_t len, QRect plotRect, const graphmip_t *mip);
+    void appendMax(int16_t *buffer, size_t len, QRect plotRect);
     QColor getColor(int graphNum);
 
   public:
     Plot(QWidget *parent = 0);
+    ~Plot();
 
   public slots:
     void Zoom(double factor, uint32_t refX);
@@ -37,6 +37,7 @@
 #include "fileutils.h"
 #include "flash.h"
 #include "preferences.h"
+#include "scriptpipe.h"
 #include "commonutil.h"
 
 #ifndef _WIN32
@@ -378,6 +379,49 @@ static bool pop_cmdscriptfile(void) {
         return true;
 }
 
+// client start up stages,  `--startup-times` prints how long each one took
+typedef enum {
+    STARTUP_INIT = 0,
+    STARTUP_ARGS,
+    STARTUP_PREFS,
+    STARTUP_CONNECT,
+    STARTUP_UI,
+    STARTUP_HISTORY,
+    STARTUP_COUNT
+} startup_stage_t;
+
+static const char *startup_stage_names[STARTUP_COUNT] = {
+    "init", "arguments", "preferences", "connect", "banner/gui", "history"
+};
+static uint32_t startup_ms[STARTUP_COUNT] = {0};
+static uint64_t startup_first = 0;
+static uint64_t startup_last = 0;
+static bool startup_times = false;
+
+// time since the previous mark goes to stage
+static void startup_mark(startup_stage_t stage) {
+    uint64_t now = msclock();
+    if (startup_first == 0) {
+        startup_first = now;
+    } else {
+        startup_ms[stage] += now - startup_last;
+    }
+    startup_last = now;
+}
+
+static void startup_print(void) {
+    PrintAndLogEx(INFO, "--- " _CYAN_("Client start up") " -----------------");
+    for (uint8_t i = 0; i < STARTUP_COUNT; i++) {
+        PrintAndLogEx(INFO, "  %-12s %5u ms", startup_stage_names[i], startup_ms[i]);
+    }
+    PrintAndLogEx(INFO, "  %-12s " _YELLOW_("%5u") " ms", "total", (uint32_t)(startup_last - startup_first));
+    uint64_t rss = process_rss();
+    if (rss) {
+        PrintAndLogEx(INFO, "  %-12s " _YELLOW_("%5" PRIu64) " kB", "resident", rss / 1024);
+    }
+    PrintAndLogEx(NORMAL, "");
+}
+
 // Main thread of PM3 Client
 void
 #ifdef __has_attribute
@@ -387,8 +431,12 @@ __attribute__((force_align_arg_pointer))
 #endif
 main_loop(const char *script_cmds_file, char *script_cmd, bool stayInCommandLoop) {
 
+    startup_mark(STARTUP_UI);
+
     char *cmd = NULL;
     bool execCommand = (script_cmd != NULL);
+    // one shot -c / -s run,  nothing to recall nor to record
+    bool oneshot = (execCommand || script_cmds_file) && (stayInCommandLoop == false);
     bool fromInteractive = false;
     uint16_t script_cmd_len = 0;
     if (execCommand) {
@@ -420,7 +468,7 @@ main_loop(const char *script_cmds_file, char *script_cmd, bool stayInCommandLoop
     g_session.history_path = NULL;
     if (g_session.incognito) {
         PrintAndLogEx(INFO, "No history will be recorded");
-    } else {
+    } else if (oneshot == false) {
         if (searchHomeFilePath(&g_session.history_path, NULL, PROXHISTORY, true) != PM3_SUCCESS) {
             g_session.history_path = NULL;
             PrintAndLogEx(ERR, "No history will be recorded");
@@ -431,6 +479,11 @@ main_loop(const char *script_cmds_file, char *script_cmd, bool stayInCommandLoop
         }
     }
 
+    startup_mark(STARTUP_HISTORY);
+    if (startup_times) {
+        startup_print();
+    }
+
     // loops every time enter is pressed...
     while (1) {
 
@@ -447,6 +500,7 @@ check_script:
 
             // read script file
             if (fgets(script_cmd_buf, sizeof(script_cmd_buf), current_cmdscriptfile()) == NULL) {
+                scriptpipe_flush();
                 if (pop_cmdscriptfile() == false) {
                     break;
                 }
@@ -569,7 +623,11 @@ check_script:
                 }
                 // process cmd
                 g_pendingPrompt = false;
+                // in a pipelined script,  lines which can't be pipelined wait for the ones before
+                scriptpipe_begin(cmd, current_cmdscriptfile() != NULL);
                 mainret = CommandReceived(cmd);
+                scriptpipe_end();
+                FlushPrintAndLog();
 
                 // exit or quit
                 if (mainret == PM3_EFATAL)
@@ -591,6 +649,8 @@ check_script:
         }
     } // end while
 
+    scriptpipe_flush();
+
     if (g_session.pm3_present) {
         clearCommandBuffer();
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
@@ -739,7 +799,9 @@ static void show_help(bool showFullHelp, char *exec_name) {
 #endif // HAVE_PYTHON
         PrintAndLogEx(NORMAL, "      -s/--script-file <cmd_script_file>  script file with one Proxmark3 command per line");
         PrintAndLogEx(NORMAL, "      -i/--interactive                    enter interactive mode after executing the script or the command");
+        PrintAndLogEx(NORMAL, "      --pipeline                          with -s, queue writes (hf mf wrbl, hf mfu wrbl) instead of waiting for each");
         PrintAndLogEx(NORMAL, "      --incognito                         do not use history, prefs file nor log files");
+        PrintAndLogEx(NORMAL, "      --startup-times                     print the time spent in each client start up stage");
         PrintAndLogEx(NORMAL, "      --ncpu <num_cores>                  override number of CPU cores");
         PrintAndLogEx(NORMAL, "\nOptions in flasher mode:");
         PrintAndLogEx(NORMAL, "      --flash                             flash Proxmark3, requires at least one --image");
@@ -853,7 +915,7 @@ static int dumpmem_pm3(char *serial_port_name, const char *filename, uint32_t ad
 finish2:
     clearCommandBuffer();
     if (in_bootloader) {
-        g_session.current_device->g_conn->run = false;
+        g_session.current_device->conn->run = false;
         SendCommandOLD(CMD_PING, 0, 0, 0, NULL, 0);
     } else {
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
@@ -984,7 +1046,8 @@ static int reboot_bootloader_pm3(char *serial_port_name) {
 #endif //LIBPM3
 
 void pm3_init(void) {
-    srand(time(0));
+    // process wide set up,  only once when libpm3 opens and closes devices again and again
+    static bool initialised = false;
 
     g_session.pm3_present = false;
     g_session.help_dump_mode = false;
@@ -994,14 +1057,22 @@ void pm3_init(void) {
     g_session.stdinOnTTY = false;
     g_session.stdoutOnTTY = false;
 
+    if (initialised) {
+        return;
+    }
+    initialised = true;
+
+    srand(time(0));
+
     // set global variables soon enough to get the log path
     set_my_executable_path();
     set_my_user_directory();
-
 }
 
 #ifndef LIBPM3
 int main(int argc, char *argv[]) {
+    // starts the clock
+    startup_mark(STARTUP_INIT);
     pm3_init();
     bool waitCOMPort = false;
     bool addScriptExec = false;
@@ -1012,6 +1083,7 @@ int main(int argc, char *argv[]) {
     uint32_t speed = 0;
 
     pm3line_init();
+    startup_mark(STARTUP_INIT);
 
     char exec_name[100] = {0};
     strncpy(exec_name, basename(argv[0]), sizeof(exec_name) - 1);
@@ -1040,6 +1112,10 @@ int main(int argc, char *argv[]) {
     //   if ((fstat (STDOUT_FILENO, &tmp_stat) == 0) && (S_ISCHR (tmp_stat.st_mode)) && isatty(STDIN_FILENO))
     g_session.stdinOnTTY = isatty(STDIN_FILENO);
     g_session.stdoutOnTTY = isatty(STDOUT_FILENO);
+    if (g_session.stdoutOnTTY == false) {
+        // redirected output goes out by blocks,  see FlushPrintAndLog()
+        setvbuf(stdout, NULL, _IOFBF, PRINT_BLOCK_BUFFER);
+    }
     g_session.supports_colors = false;
     g_session.emoji_mode = EMO_ALTTEXT;
     if (g_session.stdinOnTTY && g_session.stdoutOnTTY) {
@@ -1229,6 +1305,18 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // queue independent device commands of the script file
+        if (strcmp(argv[i], "--pipeline") == 0) {
+            scriptpipe_enable(true);
+            continue;
+        }
+
+        // report how long each client start up stage took
+        if (strcmp(argv[i], "--startup-times") == 0) {
+            startup_times = true;
+            continue;
+        }
+
         // go to dump mode
         if (strcmp(argv[i], "--dumpmem") == 0) {
             dumpmem_mode = true;
@@ -1329,6 +1417,8 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    startup_mark(STARTUP_ARGS);
+
     // Load Settings and assign
     // This will allow the command line to override the settings.json values
     preferences_load();
@@ -1338,6 +1428,10 @@ int main(int argc, char *argv[]) {
     // settings_save ();
     // End Settings
 
+    startup_mark(STARTUP_PREFS);
+    // the resource and dictionary index (searchFileIndex) is built by the first lookup,
+    // runs which don't need any of these files never pay for it
+
     // even if prefs, we disable colors if stdin or stdout is not a TTY
     if ((! g_session.stdinOnTTY) || (! g_session.stdoutOnTTY)) {
         g_session.supports_colors = false;
@@ -1406,6 +1500,8 @@ int main(int argc, char *argv[]) {
         PrintAndLogEx(INFO, _YELLOW_("OFFLINE") " mode. Check " _YELLOW_("\"%s -h\"") " if it's not what you want.\n", exec_name);
     }
 
+    startup_mark(STARTUP_CONNECT);
+
     // ascii art only in interactive client
     if (!script_cmds_file && !script_cmd && g_session.stdinOnTTY && g_session.stdoutOnTTY && !dumpmem_mode && !flash_mode && !reboot_bootloader_mode) {
         showBanner();
@@ -1434,19 +1530,24 @@ int main(int argc, char *argv[]) {
 
 #ifdef HAVE_GUI
 
+    // a one shot -c / -s run exits before anyone could look at a plot,  don't start Qt for it
+    if ((script_cmd || script_cmds_file) && (stayInCommandLoop == false)) {
+        main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
+    } else {
 #  if defined(_WIN32)
-    InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
-    MainGraphics();
-#  else
-    // for *nix distro's,  check environment variable to verify a display
-    const char *display = getenv("DISPLAY");
-    if (display && strlen(display) > 1) {
         InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
         MainGraphics();
-    } else {
-        main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
-    }
+#  else
+        // for *nix distro's,  check environment variable to verify a display
+        const char *display = getenv("DISPLAY");
+        if (display && strlen(display) > 1) {
+            InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
+            MainGraphics();
+        } else {
+            main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
+        }
 #  endif
+    }
 
 #else
     main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
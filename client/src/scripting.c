@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 #include "lauxlib.h"
 #include "cmdmain.h"
@@ -47,6 +48,8 @@
 #include "cmdlfem4x50.h"  // read 4350
 #include "em4x50.h"       // 4x50 structs
 #include "iso7816/iso7816core.h"  // ISODEPSTATE
+#include "util_posix.h"  // msclock, msleep
+#include "lfdemodctx.h"  // g_GraphBuffer, g_DemodBuffer
 
 static int returnToLuaWithError(lua_State *L, const char *fmt, ...) {
     char buffer[200];
@@ -65,6 +68,11 @@ static int l_clearCommandBuffer(lua_State *L) {
     return 0;
 }
 
+static int l_clearCommandQueue(lua_State *L) {
+    clearCommandQueue();
+    return 0;
+}
+
 /**
  * Enable / Disable fast push mode for lua scripts like hf_mf_keycheck
  * The following params expected:
@@ -183,6 +191,76 @@ static int l_SendCommandNG(lua_State *L) {
     return 1;
 }
 
+/**
+ * @brief l_SendCommandMIXRaw, as l_SendCommandMIX
+ * @param data  binary string, max 512 bytes
+ */
+static int l_SendCommandMIXRaw(lua_State *L) {
+
+    int n = lua_gettop(L);
+    if (n != 5)
+        return returnToLuaWithError(L, "You need to supply five parameters");
+
+    uint64_t cmd = luaL_checknumber(L, 1);
+    uint64_t arg0 = luaL_checknumber(L, 2);
+    uint64_t arg1 = luaL_checknumber(L, 3);
+    uint64_t arg2 = luaL_checknumber(L, 4);
+
+    size_t len;
+    const char *p_data = luaL_checklstring(L, 5, &len);
+    if (len > PM3_CMD_DATA_SIZE_MIX)
+        return returnToLuaWithError(L, "Data too large, max %zu bytes", PM3_CMD_DATA_SIZE_MIX);
+
+    clearCommandBuffer();
+    SendCommandMIX(cmd, arg0, arg1, arg2, p_data, len);
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+/**
+ * @brief l_SendCommandNGRaw, as l_SendCommandNG
+ * @param data  binary string, max 512 bytes
+ */
+static int l_SendCommandNGRaw(lua_State *L) {
+
+    int n = lua_gettop(L);
+    if (n != 2)
+        return returnToLuaWithError(L, "You need to supply two parameters");
+
+    uint16_t cmd = luaL_checknumber(L, 1);
+
+    size_t len;
+    const char *p_data = luaL_checklstring(L, 2, &len);
+    if (len > PM3_CMD_DATA_SIZE)
+        return returnToLuaWithError(L, "Data too large, max %u bytes", (uint32_t)PM3_CMD_DATA_SIZE);
+
+    clearCommandBuffer();
+    SendCommandNG(cmd, (uint8_t *)p_data, len);
+    lua_pushboolean(L, true);
+    return 1;
+}
+
+/**
+ * @brief l_GetGraphBuffer, the graph samples as a binary string of native int16,
+ * bin.unpack('s' .. count, ...) gets them back
+ * @return string, count
+ */
+static int l_GetGraphBuffer(lua_State *L) {
+    lua_pushlstring(L, (const char *)g_GraphBuffer, g_GraphTraceLen * sizeof(g_GraphBuffer[0]));
+    lua_pushunsigned(L, g_GraphTraceLen);
+    return 2;
+}
+
+/**
+ * @brief l_GetDemodBuffer, the demodulated bits as a binary string, one byte per bit
+ * @return string, count
+ */
+static int l_GetDemodBuffer(lua_State *L) {
+    lua_pushlstring(L, (const char *)g_DemodBuffer, g_DemodBufferLen);
+    lua_pushunsigned(L, g_DemodBufferLen);
+    return 2;
+}
+
 
 /**
  * @brief The following params expected:
@@ -324,6 +402,47 @@ static int l_GetFromFlashMemSpiffs(lua_State *L) {
     return 2;
 }
 
+// Push a received packet on the lua stack,  as the string Command:sendNG() unpacks
+static int pushResponse(lua_State *L, const PacketResponseNG *resp) {
+    char foo[sizeof(PacketResponseNG)];
+    int n = 0;
+
+    memcpy(foo + n, &resp->cmd, sizeof(resp->cmd));
+    n += sizeof(resp->cmd);
+
+    memcpy(foo + n, &resp->length, sizeof(resp->length));
+    n += sizeof(resp->length);
+
+    memcpy(foo + n, &resp->magic, sizeof(resp->magic));
+    n += sizeof(resp->magic);
+
+    memcpy(foo + n, &resp->status, sizeof(resp->status));
+    n += sizeof(resp->status);
+
+    memcpy(foo + n, &resp->crc, sizeof(resp->crc));
+    n += sizeof(resp->crc);
+
+    memcpy(foo + n, &resp->oldarg[0], sizeof(resp->oldarg[0]));
+    n += sizeof(resp->oldarg[0]);
+
+    memcpy(foo + n, &resp->oldarg[1], sizeof(resp->oldarg[1]));
+    n += sizeof(resp->oldarg[1]);
+
+    memcpy(foo + n, &resp->oldarg[2], sizeof(resp->oldarg[2]));
+    n += sizeof(resp->oldarg[2]);
+
+    memcpy(foo + n, resp->data.asBytes, sizeof(resp->data));
+    n += sizeof(resp->data);
+
+    memcpy(foo + n, &resp->ng, sizeof(resp->ng));
+    n += sizeof(resp->ng);
+    (void) n;
+
+    //Push it as a string
+    lua_pushlstring(L, (const char *)&foo, sizeof(foo));
+    return 1;
+}
+
 /**
  * @brief The following params expected:
  * uint32_t cmd
@@ -354,43 +473,76 @@ static int l_WaitForResponseTimeout(lua_State *L) {
         return returnToLuaWithError(L, "No response from the device");
     }
 
-    char foo[sizeof(PacketResponseNG)];
-    n = 0;
+    return pushResponse(L, &resp);
+}
 
-    memcpy(foo + n, &resp.cmd, sizeof(resp.cmd));
-    n += sizeof(resp.cmd);
+/**
+ * @brief Sends a NG command without waiting for its reply,  see SendCommandNGQueued.
+ * The following params expected:
+ * @param cmd  the command
+ * @param data  must be hexstring less than 1024 chars(512bytes)
+ * @param resp_cmd  optional,  the reply command to expect when not the same as cmd
+ * @return the sequence ID to poll with PollQueuedResponse
+ */
+static int l_SendCommandQueued(lua_State *L) {
 
-    memcpy(foo + n, &resp.length, sizeof(resp.length));
-    n += sizeof(resp.length);
+    uint8_t data[PM3_CMD_DATA_SIZE] = {0};
+    size_t len = 0, size;
 
-    memcpy(foo + n, &resp.magic, sizeof(resp.magic));
-    n += sizeof(resp.magic);
+    int n = lua_gettop(L);
+    if (n < 2 || n > 3)
+        return returnToLuaWithError(L, "You need to supply two or three parameters");
 
-    memcpy(foo + n, &resp.status, sizeof(resp.status));
-    n += sizeof(resp.status);
+    uint16_t cmd = luaL_checknumber(L, 1);
 
-    memcpy(foo + n, &resp.crc, sizeof(resp.crc));
-    n += sizeof(resp.crc);
+    const char *p_data = luaL_checklstring(L, 2, &size);
+    if (size) {
+        if (size > 1024)
+            size = 1024;
 
-    memcpy(foo + n, &resp.oldarg[0], sizeof(resp.oldarg[0]));
-    n += sizeof(resp.oldarg[0]);
+        uint32_t tmp;
+        for (int i = 0; i < size; i += 2) {
+            sscanf(&p_data[i], "%02x", &tmp);
+            data[i >> 1] = tmp & 0xFF;
+            len++;
+        }
+    }
 
-    memcpy(foo + n, &resp.oldarg[1], sizeof(resp.oldarg[1]));
-    n += sizeof(resp.oldarg[1]);
+    uint16_t resp_cmd = cmd;
+    if (n == 3)
+        resp_cmd = luaL_checknumber(L, 3);
 
-    memcpy(foo + n, &resp.oldarg[2], sizeof(resp.oldarg[2]));
-    n += sizeof(resp.oldarg[2]);
+    uint32_t seq = 0;
+    int res = SendCommandNGQueued(cmd, data, len, resp_cmd, &seq);
+    if (res != PM3_SUCCESS)
+        return returnToLuaWithError(L, "Failed to queue command, error %d", res);
 
-    memcpy(foo + n, resp.data.asBytes, sizeof(resp.data));
-    n += sizeof(resp.data);
+    lua_pushinteger(L, seq);
+    return 1;
+}
 
-    memcpy(foo + n, &resp.ng, sizeof(resp.ng));
-    n += sizeof(resp.ng);
-    (void) n;
+/**
+ * @brief Non blocking check for the reply of a command sent with SendCommandQueued
+ * @param seq  the sequence ID
+ * @return the response string,  as WaitForResponseTimeout,  or false while still outstanding
+ */
+static int l_PollQueuedResponse(lua_State *L) {
 
-    //Push it as a string
-    lua_pushlstring(L, (const char *)&foo, sizeof(foo));
-    return 1;
+    if (lua_gettop(L) != 1)
+        return returnToLuaWithError(L, "You need to supply the sequence ID");
+
+    uint32_t seq = luaL_checkinteger(L, 1);
+
+    PacketResponseNG resp;
+    int res = PollQueuedResponse(seq, &resp);
+    if (res == PM3_ENODATA) {
+        lua_pushboolean(L, false);
+        return 1;
+    }
+    if (res != PM3_SUCCESS)
+        return returnToLuaWithError(L, "No response from the device, error %d", res);
+
+    return pushResponse(L, &resp);
 }
 
 static int l_mfDarkside(lua_State *L) {
@@ -463,6 +615,22 @@ static int l_kbd_enter_pressed(lua_State *L) {
     return 1;
 }
 
+/**
+ * @brief Milliseconds since some fixed point,  for timeouts of polled commands
+ */
+static int l_msclock(lua_State *L) {
+    lua_pushinteger(L, msclock());
+    return 1;
+}
+
+/**
+ * @brief Sleep the given number of milliseconds
+ */
+static int l_msleep(lua_State *L) {
+    msleep(luaL_checkinteger(L, 1));
+    return 0;
+}
+
 /**
  * @brief Calls the command line parser to deal with the command. This enables
  * lua-scripts to do stuff like "core.console('hf mf mifare')"
@@ -863,7 +1031,7 @@ static int l_hardnested(lua_State *L) {
     }
 
     uint64_t foundkey = 0;
-    int retval = mfnestedhard(blockNo, keyType, key, trgBlockNo, trgKeyType, haveTarget ? trgkey : NULL, nonce_file_read,  nonce_file_write,  slow,  tests, &foundkey, filename);
+    int retval = mfnestedhard(blockNo, keyType, key, trgBlockNo, trgKeyType, haveTarget ? trgkey : NULL, nonce_file_read,  nonce_file_write, false, slow,  tests, &foundkey, filename);
     DropField();
 
     //Push the key onto the stack
@@ -1385,18 +1553,116 @@ static int setLuaPath(lua_State *L, const char *path) {
     return 0; // all done!
 }
 
+// compiled chunks go to ~/.proxmark3/cache/, named after a hash of the source path
+static char *lua_cache_path(const char *path) {
+    uint32_t h = 0x811c9dc5;
+    for (const char *p = path; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 0x01000193;
+    }
+
+    const char *base = path;
+    for (const char *p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') {
+            base = p + 1;
+        }
+    }
+
+    char fn[FILENAME_MAX];
+    snprintf(fn, sizeof(fn), "lua-%08x-%sc", h, base);
+
+    char *cpath = NULL;
+    if (searchHomeFilePath(&cpath, CACHE_SUBDIR, fn, true) != PM3_SUCCESS) {
+        return NULL;
+    }
+    return cpath;
+}
+
+static int lua_cache_writer(lua_State *L, const void *p, size_t sz, void *ud) {
+    (void)L;
+    return (fwrite(p, 1, sz, (FILE *)ud) == sz) ? 0 : 1;
+}
+
+int pm3_lua_loadfile(lua_State *L, const char *path) {
+    struct stat src_st, cache_st;
+    char *cpath = NULL;
+    if (stat(path, &src_st) == 0) {
+        cpath = lua_cache_path(path);
+    }
+
+    // strictly newer,  a source saved in the same second as the cache is compiled again
+    if (cpath && (stat(cpath, &cache_st) == 0) && (cache_st.st_mtime > src_st.st_mtime)) {
+        if (luaL_loadfilex(L, cpath, "b") == LUA_OK) {
+            free(cpath);
+            return LUA_OK;
+        }
+        // truncated, or from another Lua build
+        lua_pop(L, 1);
+    }
+
+    int res = luaL_loadfile(L, path);
+    if (res == LUA_OK && cpath) {
+        char tmp[strlen(cpath) + 5];
+        snprintf(tmp, sizeof(tmp), "%s.tmp", cpath);
+        FILE *f = fopen(tmp, "wb");
+        if (f) {
+            int err = lua_dump(L, lua_cache_writer, f);
+            err |= fclose(f);
+            if (err == 0) {
+                remove(cpath);
+                err = rename(tmp, cpath);
+            }
+            if (err) {
+                remove(tmp);
+            }
+        }
+    }
+    free(cpath);
+    return res;
+}
+
+// package.searchers[2] replacement,  same lookup in package.path but through the cache
+static int lua_cached_searcher(lua_State *L) {
+    const char *name = luaL_checkstring(L, 1);
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchpath");
+    lua_pushstring(L, name);
+    lua_getfield(L, -3, "path");
+    lua_call(L, 2, 2);
+    if (lua_isnil(L, -2)) {
+        // the list of tried files
+        return 1;
+    }
+    lua_pop(L, 1);
+
+    const char *filename = lua_tostring(L, -1);
+    if (pm3_lua_loadfile(L, filename) != LUA_OK) {
+        return luaL_error(L, "error loading module " LUA_QS " from file " LUA_QS ":\n\t%s", name, filename, lua_tostring(L, -1));
+    }
+    lua_pushstring(L, filename);
+    return 2;
+}
+
 int set_pm3_libraries(lua_State *L) {
     static const luaL_Reg libs[] = {
         {"SendCommandMIX",              l_SendCommandMIX},
         {"SendCommandNG",               l_SendCommandNG},
+        {"SendCommandMIXRaw",           l_SendCommandMIXRaw},
+        {"SendCommandNGRaw",            l_SendCommandNGRaw},
+        {"GetGraphBuffer",              l_GetGraphBuffer},
+        {"GetDemodBuffer",              l_GetDemodBuffer},
         {"GetFromBigBuf",               l_GetFromBigBuf},
         {"GetFromFlashMem",             l_GetFromFlashMem},
         {"GetFromFlashMemSpiffs",       l_GetFromFlashMemSpiffs},
         {"WaitForResponseTimeout",      l_WaitForResponseTimeout},
+        {"SendCommandQueued",           l_SendCommandQueued},
+        {"PollQueuedResponse",          l_PollQueuedResponse},
         {"mfDarkside",                  l_mfDarkside},
         {"foobar",                      l_foobar},
         {"kbd_enter_pressed",           l_kbd_enter_pressed},
+        {"msclock",                     l_msclock},
+        {"msleep",                      l_msleep},
         {"clearCommandBuffer",          l_clearCommandBuffer},
+        {"clearCommandQueue",           l_clearCommandQueue},
         {"console",                     l_CmdConsole},
         {"iso15693_crc",                l_iso15693_crc},
         {"iso14443b_crc",               l_iso14443b_crc},
@@ -1505,5 +1771,13 @@ int set_pm3_libraries(lua_State *L) {
         strcat(libraries_path, LUA_LIBRARIES_WILDCARD);
         setLuaPath(L, libraries_path);
     }
+
+    lua_getglobal(L, "package");
+    lua_getfield(L, -1, "searchers");
+    if (lua_istable(L, -1)) {
+        lua_pushcfunction(L, lua_cached_searcher);
+        lua_rawseti(L, -2, 2);
+    }
+    lua_pop(L, 2);
     return 1;
 }
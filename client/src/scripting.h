@@ -32,4 +32,9 @@
 
 int set_pm3_libraries(lua_State *L);
 
+/**
+ * @brief luaL_loadfile,  through a cache of compiled chunks in ~/.proxmark3/cache/
+ */
+int pm3_lua_loadfile(lua_State *L, const char *path);
+
 #endif
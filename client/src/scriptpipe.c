@@ -0,0 +1,189 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Pipelined command script execution
+//-----------------------------------------------------------------------------
+#include "scriptpipe.h"
+
+#include <string.h>
+#include <ctype.h>
+#include "comms.h"
+#include "ui.h"
+#include "commonutil.h"     // ARRAYLEN
+
+// a queued reply is given as long as the command would have waited for it
+#define SCRIPTPIPE_TIMEOUT  1500
+
+// script lines which may be pipelined,  their handlers use scriptpipe_queue_mix()
+static const char *scriptpipe_cmds[] = {
+    "hf mf wrbl",
+    "hf mfu wrbl",
+};
+
+typedef struct {
+    uint32_t seq;
+    scriptpipe_check_t check;
+    char line[64];
+} scriptpipe_entry_t;
+
+static bool scriptpipe_on = false;
+static bool scriptpipe_running = false;
+static uint32_t scriptpipe_gen = 1;
+static const char *scriptpipe_line = NULL;
+
+// oldest first
+static scriptpipe_entry_t scriptpipe_q[CMD_QUEUE_SIZE];
+static uint8_t scriptpipe_head = 0;
+static uint8_t scriptpipe_count = 0;
+
+static uint32_t scriptpipe_total = 0;
+static uint32_t scriptpipe_failed = 0;
+
+void scriptpipe_enable(bool enable) {
+    scriptpipe_on = enable;
+}
+
+bool scriptpipe_enabled(void) {
+    return scriptpipe_on;
+}
+
+bool scriptpipe_active(void) {
+    return scriptpipe_running;
+}
+
+uint32_t scriptpipe_generation(void) {
+    return scriptpipe_gen;
+}
+
+// command words must match,  separated by any amount of blanks
+static bool scriptpipe_accepts(const char *cmd) {
+    for (uint8_t i = 0; i < ARRAYLEN(scriptpipe_cmds); i++) {
+        const char *p = scriptpipe_cmds[i];
+        const char *c = cmd;
+        while (*p) {
+            if (*p == ' ') {
+                if (isspace((unsigned char)*c) == 0) {
+                    break;
+                }
+                while (isspace((unsigned char)*c)) {
+                    c++;
+                }
+                p++;
+                continue;
+            }
+            if (tolower((unsigned char)*c) != *p) {
+                break;
+            }
+            c++;
+            p++;
+        }
+        if (*p == '\0' && (*c == '\0' || isspace((unsigned char)*c))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool scriptpipe_begin(const char *cmd, bool from_script) {
+    if (scriptpipe_on == false) {
+        return false;
+    }
+
+    if (from_script && scriptpipe_accepts(cmd)) {
+        scriptpipe_running = true;
+        scriptpipe_line = cmd;
+        return true;
+    }
+
+    // barrier,  the command may need the card,  or the replies, for itself
+    scriptpipe_flush();
+    scriptpipe_gen++;
+    return false;
+}
+
+void scriptpipe_end(void) {
+    scriptpipe_running = false;
+    scriptpipe_line = NULL;
+}
+
+// collect the reply of the oldest queued command
+static int scriptpipe_collect(void) {
+    scriptpipe_entry_t *e = &scriptpipe_q[scriptpipe_head];
+
+    PacketResponseNG resp;
+    if (WaitForQueuedResponse(e->seq, &resp, SCRIPTPIPE_TIMEOUT) == false) {
+        // nothing after this can be matched anymore,  count them all as failed
+        PrintAndLogEx(FAILED, "Pipelined " _YELLOW_("%s") " ( " _RED_("timeout") " ), %u more dropped", e->line, scriptpipe_count - 1);
+        scriptpipe_failed += scriptpipe_count;
+        scriptpipe_count = 0;
+        scriptpipe_head = 0;
+        clearCommandQueue();
+        return PM3_ETIMEOUT;
+    }
+
+    int res = (e->check) ? e->check(&resp) : PM3_SUCCESS;
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "Pipelined " _YELLOW_("%s") " ( " _RED_("fail") " )", e->line);
+        scriptpipe_failed++;
+    }
+
+    scriptpipe_head = (scriptpipe_head + 1) % CMD_QUEUE_SIZE;
+    scriptpipe_count--;
+    return res;
+}
+
+int scriptpipe_queue_mix(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len,
+                         uint16_t resp_cmd, scriptpipe_check_t check) {
+
+    if (scriptpipe_count == CMD_QUEUE_SIZE) {
+        scriptpipe_collect();
+    }
+
+    scriptpipe_entry_t *e = &scriptpipe_q[(scriptpipe_head + scriptpipe_count) % CMD_QUEUE_SIZE];
+    int res = SendCommandMIXQueued(cmd, arg0, arg1, arg2, data, len, resp_cmd, &e->seq);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    e->check = check;
+    memset(e->line, 0, sizeof(e->line));
+    if (scriptpipe_line) {
+        strncpy(e->line, scriptpipe_line, sizeof(e->line) - 1);
+    }
+
+    scriptpipe_count++;
+    scriptpipe_total++;
+    return PM3_SUCCESS;
+}
+
+int scriptpipe_flush(void) {
+    if (scriptpipe_total == 0) {
+        return 0;
+    }
+
+    while (scriptpipe_count) {
+        scriptpipe_collect();
+    }
+
+    int failed = scriptpipe_failed;
+    if (failed) {
+        PrintAndLogEx(WARNING, "Pipelined %u commands, " _RED_("%u") " failed", scriptpipe_total, scriptpipe_failed);
+    } else {
+        PrintAndLogEx(SUCCESS, "Pipelined %u commands ( " _GREEN_("ok") " )", scriptpipe_total);
+    }
+    scriptpipe_total = 0;
+    scriptpipe_failed = 0;
+    return failed;
+}
@@ -0,0 +1,49 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Pipelined command script execution (-s <file> --pipeline)
+//
+// Script lines which only send one device command and don't depend on its
+// answer (hf mf wrbl, hf mfu wrbl) are queued and their reply checked later.
+// Any other line is a barrier: it first waits for all queued commands.
+//-----------------------------------------------------------------------------
+
+#ifndef SCRIPTPIPE_H__
+#define SCRIPTPIPE_H__
+
+#include "common.h"
+#include "pm3_cmd.h"        // PacketResponseNG
+
+// judge the reply of a queued command,  PM3_SUCCESS or an error
+typedef int (*scriptpipe_check_t)(const PacketResponseNG *resp);
+
+void scriptpipe_enable(bool enable);
+bool scriptpipe_enabled(void);
+
+// around each script line,  returns true when cmd runs pipelined
+bool scriptpipe_begin(const char *cmd, bool from_script);
+void scriptpipe_end(void);
+
+// the running command may queue its device command instead of waiting for it
+bool scriptpipe_active(void);
+// changes at every barrier,  cached card state is only good for one generation
+uint32_t scriptpipe_generation(void);
+
+int scriptpipe_queue_mix(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len,
+                         uint16_t resp_cmd, scriptpipe_check_t check);
+// wait for all queued commands,  returns the number which failed
+int scriptpipe_flush(void);
+
+#endif
@@ -0,0 +1,404 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Client thread pool
+//
+// The workers start with the first job and then wait for tasks for the rest
+// of the session.  Jobs are run in the order they were submitted.  A thread
+// waiting for a job doesn't work on it,  so at most num_CPUs() threads compute,
+// except when it is a worker itself (a job submitted from a task),  then it
+// runs the tasks of that job to keep the pool from waiting on itself.
+//-----------------------------------------------------------------------------
+
+#include "threadpool.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "util.h"           // num_CPUs
+#include "util_posix.h"     // msclock
+#include "ui.h"
+
+// --ncpu values above this are clamped
+#define THREADPOOL_MAX_WORKERS  256
+
+// index share of one task of threadpool_for,  [next, end) is still to do
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t next;
+    uint64_t end;
+} threadpool_range_t;
+
+struct threadpool_job_s {
+    threadpool_task_fn fn;
+    void *arg;
+    uint32_t tasks;
+    uint32_t next_task;         // first task not handed out yet
+    uint32_t finished;
+    bool cancelled;
+    uint64_t done;
+    // threadpool_for
+    threadpool_range_fn range_fn;
+    uint64_t chunk;
+    threadpool_range_t *ranges;
+    threadpool_job_t *queue_next;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;        // a job got queued
+    pthread_cond_t finished;    // a task finished
+    threadpool_job_t *head;
+    threadpool_job_t *tail;
+    uint32_t workers;
+    bool started;
+} g_pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .finished = PTHREAD_COND_INITIALIZER,
+};
+
+static __thread bool tp_is_worker = false;
+
+// called with the lock held
+static void tp_unlink(threadpool_job_t *job) {
+    threadpool_job_t *prev = NULL;
+    for (threadpool_job_t *j = g_pool.head; j != NULL; prev = j, j = j->queue_next) {
+        if (j != job) {
+            continue;
+        }
+        if (prev) {
+            prev->queue_next = j->queue_next;
+        } else {
+            g_pool.head = j->queue_next;
+        }
+        if (g_pool.tail == j) {
+            g_pool.tail = prev;
+        }
+        j->queue_next = NULL;
+        return;
+    }
+}
+
+// next task of the first queued job,  or of <only>.  Called with the lock held
+static threadpool_job_t *tp_pop(threadpool_job_t *only, uint32_t *index) {
+    threadpool_job_t *job = (only) ? only : g_pool.head;
+    if (job == NULL || job->next_task == job->tasks) {
+        return NULL;
+    }
+    *index = job->next_task++;
+    if (job->next_task == job->tasks) {
+        tp_unlink(job);
+    }
+    return job;
+}
+
+// called with the lock held
+static void tp_finish(threadpool_job_t *job) {
+    job->finished++;
+    if (job->finished == job->tasks) {
+        pthread_cond_broadcast(&g_pool.finished);
+    }
+}
+
+static bool tp_take(threadpool_range_t *r, uint64_t chunk, uint64_t *first, uint64_t *last) {
+    bool ok = false;
+    pthread_mutex_lock(&r->lock);
+    if (r->next < r->end) {
+        *first = r->next;
+        *last = MIN(r->next + chunk, r->end);
+        r->next = *last;
+        ok = true;
+    }
+    pthread_mutex_unlock(&r->lock);
+    return ok;
+}
+
+static uint64_t tp_left(threadpool_range_t *r) {
+    pthread_mutex_lock(&r->lock);
+    uint64_t left = r->end - r->next;
+    pthread_mutex_unlock(&r->lock);
+    return left;
+}
+
+// own share is done,  take half of the largest one left
+static bool tp_steal(threadpool_job_t *job, uint32_t self, uint64_t *first, uint64_t *last) {
+    for (;;) {
+        uint32_t victim = job->tasks;
+        uint64_t most = 0;
+        for (uint32_t i = 0; i < job->tasks; i++) {
+            if (i == self) {
+                continue;
+            }
+            uint64_t left = tp_left(&job->ranges[i]);
+            if (left > most) {
+                most = left;
+                victim = i;
+            }
+        }
+        if (victim == job->tasks) {
+            return false;
+        }
+
+        threadpool_range_t *v = &job->ranges[victim];
+        uint64_t from, to;
+        pthread_mutex_lock(&v->lock);
+        uint64_t left = v->end - v->next;
+        if (left == 0) {
+            // its owner was faster,  look again
+            pthread_mutex_unlock(&v->lock);
+            continue;
+        }
+        to = v->end;
+        from = (left <= job->chunk) ? v->next : v->next + left / 2;
+        v->end = from;
+        if (v->next > v->end) {
+            v->next = v->end;
+        }
+        pthread_mutex_unlock(&v->lock);
+
+        // the stolen part becomes our share,  others may steal from it in turn
+        threadpool_range_t *own = &job->ranges[self];
+        pthread_mutex_lock(&own->lock);
+        own->next = from;
+        own->end = to;
+        pthread_mutex_unlock(&own->lock);
+
+        if (tp_take(own, job->chunk, first, last)) {
+            return true;
+        }
+    }
+}
+
+static void tp_run_ranges(threadpool_job_t *job, uint32_t index) {
+    threadpool_range_t *own = &job->ranges[index];
+    uint64_t first = 0, last = 0;
+    while (threadpool_cancelled(job) == false
+            && (tp_take(own, job->chunk, &first, &last) || tp_steal(job, index, &first, &last))) {
+        job->range_fn(job, job->arg, first, last);
+        threadpool_add_done(job, last - first);
+    }
+}
+
+static void tp_execute(threadpool_job_t *job, uint32_t index) {
+    // tasks of a cancelled job only get counted
+    if (threadpool_cancelled(job)) {
+        return;
+    }
+    if (job->range_fn) {
+        tp_run_ranges(job, index);
+    } else {
+        job->fn(job, job->arg, index);
+    }
+}
+
+static void
+#ifdef __has_attribute
+#if __has_attribute(force_align_arg_pointer)
+__attribute__((force_align_arg_pointer))
+#endif
+#endif
+*tp_worker(void *arg) {
+    (void)arg;
+    tp_is_worker = true;
+
+    pthread_mutex_lock(&g_pool.lock);
+    for (;;) {
+        uint32_t index = 0;
+        threadpool_job_t *job = tp_pop(NULL, &index);
+        if (job == NULL) {
+            pthread_cond_wait(&g_pool.work, &g_pool.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&g_pool.lock);
+        tp_execute(job, index);
+        pthread_mutex_lock(&g_pool.lock);
+        tp_finish(job);
+    }
+    return NULL;
+}
+
+// called with the lock held
+static void tp_start(void) {
+    if (g_pool.started) {
+        return;
+    }
+    g_pool.started = true;
+
+    uint32_t n = MIN(MAX(num_CPUs(), 1), THREADPOOL_MAX_WORKERS);
+    for (uint32_t i = 0; i < n; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, tp_worker, NULL)) {
+            PrintAndLogEx(WARNING, "Failed to create pthreads, running with " _YELLOW_("%u") " threads", g_pool.workers);
+            break;
+        }
+        pthread_detach(t);
+        g_pool.workers++;
+    }
+}
+
+uint32_t threadpool_size(void) {
+    pthread_mutex_lock(&g_pool.lock);
+    tp_start();
+    uint32_t n = MAX(g_pool.workers, 1);
+    pthread_mutex_unlock(&g_pool.lock);
+    return n;
+}
+
+static threadpool_job_t *tp_enqueue(threadpool_job_t *job) {
+    pthread_mutex_lock(&g_pool.lock);
+    tp_start();
+    if (job->tasks) {
+        if (g_pool.tail) {
+            g_pool.tail->queue_next = job;
+        } else {
+            g_pool.head = job;
+        }
+        g_pool.tail = job;
+        pthread_cond_broadcast(&g_pool.work);
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+    return job;
+}
+
+threadpool_job_t *threadpool_submit(threadpool_task_fn fn, void *arg, uint32_t tasks) {
+    threadpool_job_t *job = calloc(1, sizeof(threadpool_job_t));
+    if (job == NULL) {
+        return NULL;
+    }
+    job->fn = fn;
+    job->arg = arg;
+    job->tasks = tasks;
+    return tp_enqueue(job);
+}
+
+static void tp_deadline(struct timespec *ts, uint64_t ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ms / 1000;
+    ts->tv_nsec += (ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+int threadpool_wait(threadpool_job_t *job, threadpool_progress_fn progress, void *progress_arg, uint32_t interval_ms) {
+    if (job == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    uint64_t next_report = msclock() + interval_ms;
+
+    pthread_mutex_lock(&g_pool.lock);
+    bool help = tp_is_worker || g_pool.workers == 0;
+    while (job->finished < job->tasks) {
+
+        uint32_t index = 0;
+        if (help && tp_pop(job, &index)) {
+            pthread_mutex_unlock(&g_pool.lock);
+            tp_execute(job, index);
+            pthread_mutex_lock(&g_pool.lock);
+            tp_finish(job);
+        } else if (progress == NULL) {
+            pthread_cond_wait(&g_pool.finished, &g_pool.lock);
+            continue;
+        } else {
+            uint64_t now = msclock();
+            if (now < next_report) {
+                struct timespec ts;
+                tp_deadline(&ts, next_report - now);
+                pthread_cond_timedwait(&g_pool.finished, &g_pool.lock, &ts);
+                continue;
+            }
+        }
+
+        if (progress && msclock() >= next_report) {
+            next_report = msclock() + interval_ms;
+            uint64_t done = __atomic_load_n(&job->done, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&g_pool.lock);
+            bool go_on = progress(job, progress_arg, done);
+            pthread_mutex_lock(&g_pool.lock);
+            if (go_on == false) {
+                threadpool_cancel(job);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+
+    int res = (threadpool_cancelled(job)) ? PM3_EOPABORTED : PM3_SUCCESS;
+    if (job->ranges) {
+        for (uint32_t i = 0; i < job->tasks; i++) {
+            pthread_mutex_destroy(&job->ranges[i].lock);
+        }
+        free(job->ranges);
+    }
+    free(job);
+    return res;
+}
+
+int threadpool_run(threadpool_task_fn fn, void *arg, uint32_t tasks) {
+    return threadpool_wait(threadpool_submit(fn, arg, tasks), NULL, NULL, 0);
+}
+
+int threadpool_for(uint64_t count, uint64_t chunk, threadpool_range_fn fn, void *arg,
+                   threadpool_progress_fn progress, void *progress_arg, uint32_t interval_ms) {
+    if (count == 0) {
+        return PM3_SUCCESS;
+    }
+    if (chunk == 0) {
+        chunk = 1;
+    }
+
+    uint32_t tasks = (uint32_t)MIN((uint64_t)threadpool_size(), (count + chunk - 1) / chunk);
+
+    threadpool_job_t *job = calloc(1, sizeof(threadpool_job_t));
+    if (job == NULL) {
+        return PM3_EMALLOC;
+    }
+    job->ranges = calloc(tasks, sizeof(threadpool_range_t));
+    if (job->ranges == NULL) {
+        free(job);
+        return PM3_EMALLOC;
+    }
+
+    // equal shares,  the first count % tasks ones get one index more
+    uint64_t share = count / tasks;
+    uint64_t rest = count % tasks;
+    for (uint32_t i = 0; i < tasks; i++) {
+        pthread_mutex_init(&job->ranges[i].lock, NULL);
+        job->ranges[i].next = i * share + MIN(i, rest);
+        job->ranges[i].end = job->ranges[i].next + share + ((i < rest) ? 1 : 0);
+    }
+
+    job->range_fn = fn;
+    job->arg = arg;
+    job->chunk = chunk;
+    job->tasks = tasks;
+    return threadpool_wait(tp_enqueue(job), progress, progress_arg, interval_ms);
+}
+
+void threadpool_cancel(threadpool_job_t *job) {
+    __atomic_store_n(&job->cancelled, true, __ATOMIC_SEQ_CST);
+}
+
+bool threadpool_cancelled(const threadpool_job_t *job) {
+    return __atomic_load_n(&job->cancelled, __ATOMIC_SEQ_CST);
+}
+
+void threadpool_add_done(threadpool_job_t *job, uint64_t n) {
+    __atomic_fetch_add(&job->done, n, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Client thread pool,  num_CPUs() long running workers shared by all
+// multithreaded attacks and generators
+//-----------------------------------------------------------------------------
+
+#ifndef THREADPOOL_H__
+#define THREADPOOL_H__
+
+#include "common.h"
+
+typedef struct threadpool_job_s threadpool_job_t;
+
+// one task of a job,  index is 0 .. tasks - 1
+typedef void (*threadpool_task_fn)(threadpool_job_t *job, void *arg, uint32_t index);
+
+// a run of indexes [first, last) of threadpool_for
+typedef void (*threadpool_range_fn)(threadpool_job_t *job, void *arg, uint64_t first, uint64_t last);
+
+// called by the waiting thread every interval,  return false to cancel the job
+typedef bool (*threadpool_progress_fn)(threadpool_job_t *job, void *arg, uint64_t done);
+
+// number of workers,  follows --ncpu / num_CPUs()
+uint32_t threadpool_size(void);
+
+// queue <tasks> tasks of fn and return at once,  wait for them with threadpool_wait()
+threadpool_job_t *threadpool_submit(threadpool_task_fn fn, void *arg, uint32_t tasks);
+
+// wait for all tasks of a job and free it,  PM3_EOPABORTED when it got cancelled
+int threadpool_wait(threadpool_job_t *job, threadpool_progress_fn progress, void *progress_arg, uint32_t interval_ms);
+
+// submit and wait
+int threadpool_run(threadpool_task_fn fn, void *arg, uint32_t tasks);
+
+// fn over the indexes 0 .. count - 1 in runs of up to <chunk>.  Every worker starts
+// on its own share of the range,  a worker that runs dry steals half of the largest
+// share left.  done in the progress callback counts finished indexes
+int threadpool_for(uint64_t count, uint64_t chunk, threadpool_range_fn fn, void *arg,
+                   threadpool_progress_fn progress, void *progress_arg, uint32_t interval_ms);
+
+// tasks not started yet are skipped,  running ones should poll threadpool_cancelled()
+void threadpool_cancel(threadpool_job_t *job);
+bool threadpool_cancelled(const threadpool_job_t *job);
+
+// progress of threadpool_submit / threadpool_run jobs,  reported by the tasks themselves
+void threadpool_add_done(threadpool_job_t *job, uint64_t n);
+
+#endif
@@ -37,6 +37,10 @@
 #include <sys/un.h>
 #include <errno.h>
 
+#if defined(__linux__)
+#include <linux/serial.h>
+#endif
+
 #ifdef HAVE_BLUEZ
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/rfcomm.h>
@@ -53,12 +57,23 @@
 # define SOL_UDP IPPROTO_UDP
 #endif
 
+// Incoming bytes are read in chunks up to this size, and handed out from there,
+// which saves two syscalls per small read (preamble / postamble) on slow links.
+#define UART_RX_BUFFER_SIZE 4096
+
+// Requested kernel socket buffer, for TCP and Bluetooth links
+#define UART_SOCKET_BUFFER_SIZE (256 * 1024)
+
 typedef struct termios term_info;
 typedef struct {
     int fd;           // Serial port file descriptor
     term_info tiOld;  // Terminal info before using the port
     term_info tiNew;  // Terminal info during the transaction
     RingBuffer *udpBuffer;
+    uint8_t rxBuf[UART_RX_BUFFER_SIZE];
+    uint32_t rxBufPos;
+    uint32_t rxBufLen;
+    uint8_t rx_empty_counter;
 } serial_port_unix_t_t;
 
 // see pm3_cmd.h
@@ -69,7 +84,6 @@ struct timeval timeout = {
 
 static uint32_t newtimeout_value = 0;
 static bool newtimeout_pending = false;
-static uint8_t rx_empty_counter = 0;
 
 int uart_reconfigure_timeouts(uint32_t value) {
     newtimeout_value = value;
@@ -81,6 +95,27 @@ uint32_t uart_get_timeouts(void) {
     return newtimeout_value;
 }
 
+// Best effort, bigger kernel buffers so bursts (dumps, traces) don't stall the sender
+static void uart_set_socket_buffers(int fd) {
+    int size = UART_SOCKET_BUFFER_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+}
+
+// Best effort, ask the serial driver to push received bytes up without waiting for its flush timer.
+// USB-serial adapters (FTDI, CP210x) used with the FPC or BT add-on otherwise add up to 16ms per read.
+static void uart_set_low_latency(int fd) {
+#if defined(__linux__) && defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+    struct serial_struct ss;
+    if (ioctl(fd, TIOCGSERIAL, &ss) == 0) {
+        ss.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &ss);
+    }
+#else
+    (void)fd;
+#endif
+}
+
 serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
     serial_port_unix_t_t *sp = calloc(sizeof(serial_port_unix_t_t), sizeof(uint8_t));
 
@@ -90,7 +125,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
     }
 
     sp->udpBuffer = NULL;
-    rx_empty_counter = 0;
+    sp->rx_empty_counter = 0;
     // init timeouts
     timeout.tv_usec = UART_FPC_CLIENT_RX_TIMEOUT_MS * 1000;
     g_conn.send_via_local_ip = false;
@@ -250,6 +285,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
                 free(sp);
                 return INVALID_SERIAL_PORT;
             }
+            uart_set_socket_buffers(sp->fd);
         } else if (isUDP) {
             sp->udpBuffer = RingBuf_create(MAX(sizeof(PacketResponseNGRaw), sizeof(PacketResponseOLD)) * 30);
         }
@@ -303,6 +339,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
         }
 
         sp->fd = sfd;
+        uart_set_socket_buffers(sp->fd);
 
         g_conn.send_via_ip = PM3_NONE;
         return sp;
@@ -427,6 +464,8 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
     // Flush all lingering data that may exist
     tcflush(sp->fd, TCIOFLUSH);
 
+    uart_set_low_latency(sp->fd);
+
     if (!uart_set_speed(sp, speed)) {
         // try fallback automatically
         speed = 115200;
@@ -467,7 +506,7 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
     uint32_t byteCount;  // FIONREAD returns size on 32b
     fd_set rfds;
     struct timeval tv;
-    const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+    serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
 
     if (newtimeout_pending) {
         timeout.tv_usec = newtimeout_value * 1000;
@@ -475,6 +514,18 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
     }
     // Reset the output count
     *pszRxLen = 0;
+
+    // hand out what is left from the last chunk read
+    if (spu->rxBufPos < spu->rxBufLen) {
+        uint32_t n = MIN(spu->rxBufLen - spu->rxBufPos, pszMaxRxLen);
+        memcpy(pbtRx, spu->rxBuf + spu->rxBufPos, n);
+        spu->rxBufPos += n;
+        *pszRxLen = n;
+        if (*pszRxLen == pszMaxRxLen) {
+            return PM3_SUCCESS;
+        }
+    }
+
     do {
         int res;
         if (spu->udpBuffer != NULL) {
@@ -528,12 +579,12 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
             // select() > 0 && byteCount > 0 ===> data available
             // select() > 0 && byteCount always equals to 0 ===> maybe disconnected
             // This happens when TCP connection is lost
-            rx_empty_counter++;
-            if (rx_empty_counter > 3) {
+            spu->rx_empty_counter++;
+            if (spu->rx_empty_counter > 3) {
                 return PM3_ENOTTY;
             }
         } else {
-            rx_empty_counter = 0;
+            spu->rx_empty_counter = 0;
         }
 
         // For UDP connection, put the incoming data into the buffer and handle them in the next round
@@ -557,9 +608,25 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
             continue;
         }
 
+        // More is available than asked for,  read a bigger chunk and keep the rest for the next call
+        if ((pszMaxRxLen - (*pszRxLen) < byteCount) && (pszMaxRxLen - (*pszRxLen) < sizeof(spu->rxBuf))) {
+            res = read(spu->fd, spu->rxBuf, MIN(byteCount, sizeof(spu->rxBuf)));
+            if (res <= 0) {
+                return PM3_EIO;
+            }
+            uint32_t n = MIN((uint32_t)res, pszMaxRxLen - (*pszRxLen));
+            memcpy(pbtRx + (*pszRxLen), spu->rxBuf, n);
+            spu->rxBufPos = n;
+            spu->rxBufLen = res;
+            *pszRxLen += n;
+            if (*pszRxLen == pszMaxRxLen) {
+                return PM3_SUCCESS;
+            }
+            continue;
+        }
+
         // Cap the number of bytes, so we don't overrun the buffer
         if (pszMaxRxLen - (*pszRxLen) < byteCount) {
-//            PrintAndLogEx(ERR, "UART:: RX prevent overrun (have %u, need %u)", pszMaxRxLen - (*pszRxLen), byteCount);
             byteCount = pszMaxRxLen - (*pszRxLen);
         }
 
@@ -620,7 +687,7 @@ int uart_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
 }
 
 bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
-    const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+    serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
     speed_t stPortSpeed;
     switch (uiPortSpeed) {
         case 0:
@@ -713,6 +780,8 @@ bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed) {
 
     // flush
     tcflush(spu->fd, TCIOFLUSH);
+    spu->rxBufPos = 0;
+    spu->rxBufLen = 0;
 
     bool result = tcsetattr(spu->fd, TCSANOW, &ti) != -1;
     if (result) {
@@ -45,6 +45,7 @@
 #include <time.h>
 #include "emojis.h"
 #include "emojis_alt.h"
+#include "graphdsp.h"     // dsp_lowpass
 session_arg_t g_session;
 
 double g_CursorScaleFactor = 1;
@@ -56,6 +57,7 @@ uint32_t g_GraphStop = 0;
 uint32_t g_GraphStart_old = 0;
 double g_GraphPixelsPerPoint = 1.f; // How many visual pixels are between each sample point (x axis)
 static bool flushAfterWrite = false;
+static FILE *logfile = NULL;
 double g_GridOffset = 0;
 bool g_GridLocked = false;
 
@@ -203,9 +205,14 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     if (g_session.show_hints == false && level == HINT)
         return;
 
+    // neither printed nor logged,  don't bother formatting
+    if (g_printAndLog == 0)
+        return;
+
     char prefix[40] = {0};
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)];
+    buffer2[0] = '\0';
     char *token = NULL;
     char *tmp_ptr = NULL;
     FILE *stream = stdout;
@@ -299,10 +306,13 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     } else {
         snprintf(buffer2, sizeof(buffer2), "%s%s", prefix, buffer);
         if (level == INPLACE) {
-            char buffer3[sizeof(buffer2)] = {0};
-            char buffer4[sizeof(buffer2)] = {0};
-            memcpy_filter_ansi(buffer3, buffer2, sizeof(buffer2), !g_session.supports_colors);
-            memcpy_filter_emoji(buffer4, buffer3, sizeof(buffer3), g_session.emoji_mode);
+            if ((g_printAndLog & PRINTANDLOG_PRINT) == 0) {
+                return;
+            }
+            char buffer3[sizeof(buffer2)];
+            char buffer4[sizeof(buffer2)];
+            memcpy_filter_ansi(buffer3, buffer2, strlen(buffer2) + 1, !g_session.supports_colors);
+            memcpy_filter_emoji(buffer4, buffer3, strlen(buffer3) + 1, g_session.emoji_mode);
             fprintf(stream, "\r%s", buffer4);
             fflush(stream);
         } else {
@@ -311,13 +321,59 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 }
 
+// capture of the printed text,  as it goes to the log
+static bool capture_on = false;
+static char *capture_buf = NULL;
+static size_t capture_len = 0;
+static size_t capture_size = 0;
+
+static void capture_append(const char *text, bool linefeed) {
+    size_t len = strlen(text);
+    size_t need = capture_len + len + 2;
+    if (need > capture_size) {
+        size_t size = MAX(need, capture_size * 2);
+        char *tmp = realloc(capture_buf, size);
+        if (tmp == NULL) {
+            return;
+        }
+        capture_buf = tmp;
+        capture_size = size;
+    }
+    memcpy(capture_buf + capture_len, text, len);
+    capture_len += len;
+    if (linefeed) {
+        capture_buf[capture_len++] = '\n';
+    }
+    capture_buf[capture_len] = '\0';
+}
+
+void PrintAndLogCaptureStart(void) {
+    pthread_mutex_lock(&g_print_lock);
+    capture_len = 0;
+    capture_on = true;
+    pthread_mutex_unlock(&g_print_lock);
+}
+
+char *PrintAndLogCaptureStop(void) {
+    pthread_mutex_lock(&g_print_lock);
+    char *res = capture_buf;
+    if (res == NULL) {
+        res = calloc(1, sizeof(char));
+    }
+    capture_buf = NULL;
+    capture_len = 0;
+    capture_size = 0;
+    capture_on = false;
+    pthread_mutex_unlock(&g_print_lock);
+    return res;
+}
+
 static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     va_list argptr;
-    static FILE *logfile = NULL;
     static int logging = 1;
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER];
+    char buffer3[MAX_PRINT_BUFFER];
 
     bool linefeed = true;
 
@@ -341,6 +397,8 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
                 printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
                 logging = 0;
             } else {
+                // block buffered,  flushed after each command and on errors
+                setvbuf(logfile, NULL, _IOFBF, PRINT_BLOCK_BUFFER);
 
                 if (g_session.supports_colors) {
                     printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
@@ -375,19 +433,45 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
 #endif
 
     va_start(argptr, fmt);
-    vsnprintf(buffer, sizeof(buffer), fmt, argptr);
+    int len = vsnprintf(buffer, sizeof(buffer), fmt, argptr);
     va_end(argptr);
-    if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == NOLF[0]) {
+    if (len < 0) {
+        len = 0;
+        buffer[0] = '\0';
+    } else if (len >= (int)sizeof(buffer)) {
+        len = sizeof(buffer) - 1;
+    }
+    if (len > 0 && buffer[len - 1] == NOLF[0]) {
         linefeed = false;
-        buffer[strlen(buffer) - 1] = 0;
+        buffer[--len] = 0;
     }
+
+    // the filters only need to walk the text itself,  and only when there is something to filter
+    bool has_ansi = (memchr(buffer, '\x1b', len) != NULL);
+    bool has_emoji = (memchr(buffer, ':', len) != NULL);
+
     bool filter_ansi = !g_session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
+    const char *text = buffer;
+    if (filter_ansi && has_ansi) {
+        memcpy_filter_ansi(buffer2, buffer, len + 1, true);
+        text = buffer2;
+    }
+
+    // without a tty, colors are off and emojis are alttext,  the printed text is also the logged one
+    const char *printed = text;
+    if (has_emoji && g_session.emoji_mode != EMO_ALIAS) {
+        memcpy_filter_emoji(buffer3, text, strlen(text) + 1, g_session.emoji_mode);
+        printed = buffer3;
+    }
+
     if (g_printAndLog & PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), g_session.emoji_mode);
-        fprintf(stream, "%s", buffer3);
+        if (stream != stdout) {
+            // keep the order when both end up in the same file
+            fflush(stdout);
+        }
+        fputs(printed, stream);
         if (linefeed)
-            fprintf(stream, "\n");
+            fputc('\n', stream);
     }
 
 #ifdef RL_STATE_READCMD
@@ -401,17 +485,29 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     }
 #endif
 
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), EMO_ALTTEXT);
-        if (filter_ansi) { // already done
-            fprintf(logfile, "%s", buffer3);
-        } else {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
-            fprintf(logfile, "%s", buffer);
+    bool to_log = (g_printAndLog & PRINTANDLOG_LOG) && logging && logfile;
+    if (to_log || capture_on) {
+        const char *logged = text;
+        if (has_emoji && (printed == text || g_session.emoji_mode != EMO_ALTTEXT)) {
+            memcpy_filter_emoji(buffer3, text, strlen(text) + 1, EMO_ALTTEXT);
+            logged = buffer3;
+        } else if (has_emoji) {
+            logged = printed;
+        }
+        if ((filter_ansi == false) && has_ansi) {
+            memcpy_filter_ansi(buffer2, logged, strlen(logged) + 1, true);
+            logged = buffer2;
+        }
+        if (capture_on) {
+            capture_append(logged, linefeed);
+        }
+        if (to_log) {
+            fputs(logged, logfile);
+            if (linefeed)
+                fputc('\n', logfile);
+            if (stream != stdout)
+                fflush(logfile);
         }
-        if (linefeed)
-            fprintf(logfile, "\n");
-        fflush(logfile);
     }
 
     if (flushAfterWrite)
@@ -421,6 +517,14 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     pthread_mutex_unlock(&g_print_lock);
 }
 
+void FlushPrintAndLog(void) {
+    pthread_mutex_lock(&g_print_lock);
+    fflush(stdout);
+    if (logfile)
+        fflush(logfile);
+    pthread_mutex_unlock(&g_print_lock);
+}
+
 void SetFlushAfterWrite(bool value) {
     flushAfterWrite = value;
 }
@@ -580,7 +684,7 @@ void memcpy_filter_emoji(void *dest, const void *src, size_t n, emojiMode_t mode
 
 /*
 // If reactivated, beware it doesn't compile on Android (DXL)
-void iceIIR_Butterworth(int *data, const size_t len) {
+void iceIIR_Butterworth(int16_t *data, const size_t len) {
 
     int *output = (int *) calloc(sizeof(int) * len, sizeof(uint8_t));
     if (!output) return;
@@ -630,21 +734,14 @@ void iceIIR_Butterworth(int *data, const size_t len) {
 }
 */
 
-void iceSimple_Filter(int *data, const size_t len, uint8_t k) {
+void iceSimple_Filter(int16_t *data, const size_t len, uint8_t k) {
 // ref: http://www.edn.com/design/systems-design/4320010/A-simple-software-lowpass-filter-suits-embedded-system-applications
 // parameter K
 #define FILTER_SHIFT 4
 
     int32_t filter_reg = 0;
     int8_t shift = (k <= 8) ? k : FILTER_SHIFT;
-
-    for (size_t i = 0; i < len; ++i) {
-        // Update filter with current sample
-        filter_reg = filter_reg - (filter_reg >> shift) + data[i];
-
-        // Scale output for unity gain
-        data[i] = filter_reg >> shift;
-    }
+    dsp_lowpass(data, len, shift, &filter_reg);
 }
 
 void print_progress(uint64_t count, uint64_t max, barMode_t style) {
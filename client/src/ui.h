@@ -31,13 +31,14 @@ extern "C" {
 #define _USE_MATH_DEFINES
 
 typedef enum {STYLE_BAR, STYLE_MIXED, STYLE_VALUE} barMode_t;
+typedef enum {DUMP_JSON, DUMP_PM3DUMP} dumpFormat_t;
 typedef enum logLevel {NORMAL, SUCCESS, INFO, FAILED, WARNING, ERR, DEBUG, INPLACE, HINT} logLevel_t;
 typedef enum emojiMode {EMO_ALIAS, EMO_EMOJI, EMO_ALTTEXT, EMO_NONE} emojiMode_t;
 typedef enum clientdebugLevel {cdbOFF, cdbSIMPLE, cdbFULL} clientdebugLevel_t;
 // typedef enum devicedebugLevel {ddbOFF, ddbERROR, ddbINFO, ddbDEBUG, ddbEXTENDED} devicedebugLevel_t;
 
 // last item spItemCount used to auto map to number of files
-typedef enum savePaths {spDefault, spDump, spTrace, spItemCount} savePaths_t;
+typedef enum savePaths {spDefault, spDump, spTrace, spStore, spItemCount} savePaths_t;
 typedef struct {int x; int y; int h; int w;} qtWindow_t;
 
 typedef struct {
@@ -50,6 +51,8 @@ typedef struct {
     bool help_dump_mode;
     bool show_hints;
     bool dense_output;
+    dumpFormat_t dump_format;
+    bool dump_store;
     bool window_changed; // track if plot/overlay pos/size changed to save on exit
     qtWindow_t plot;
     qtWindow_t overlay;
@@ -71,10 +74,17 @@ extern session_arg_t g_session;
 #define M_PI 3.14159265358979323846264338327
 #endif
 #define MAX_PRINT_BUFFER 2048
+// stdio buffer of the logfile, and of stdout when it isn't a terminal
+#define PRINT_BLOCK_BUFFER (64 * 1024)
 
 #define PROMPT_CLEARLINE PrintAndLogEx(INPLACE, "                                          \r")
 void PrintAndLogOptions(const char *str[][2], size_t size, size_t space);
 void PrintAndLogEx(logLevel_t level, const char *fmt, ...);
+// write out block buffered output,  done after each command
+void FlushPrintAndLog(void);
+// also collect what is printed,  as it goes to the log (no colors, emojis as text),  Stop returns it, to free()
+void PrintAndLogCaptureStart(void);
+char *PrintAndLogCaptureStop(void);
 void SetFlushAfterWrite(bool value);
 bool GetFlushAfterWrite(void);
 void memcpy_filter_ansi(void *dest, const void *src, size_t n, bool filter);
@@ -87,8 +97,8 @@ extern pthread_mutex_t g_print_lock;
 
 void print_progress(uint64_t count, uint64_t max, barMode_t style);
 
-void iceIIR_Butterworth(int *data, const size_t len);
-void iceSimple_Filter(int *data, const size_t len, uint8_t k);
+void iceIIR_Butterworth(int16_t *data, const size_t len);
+void iceSimple_Filter(int16_t *data, const size_t len, uint8_t k);
 #ifdef __cplusplus
 }
 #endif
@@ -17,6 +17,7 @@
 //-----------------------------------------------------------------------------
 #include "wiegand_formats.h"
 #include <stdlib.h>
+#include <pthread.h>
 #include "commonutil.h"
 
 
@@ -1429,45 +1430,45 @@ static void hid_print_card(wiegand_card_t *card, const cardformat_t format) {
 }
 
 static const cardformat_t FormatTable[] = {
-    {"H10301",  Pack_H10301,  Unpack_H10301,  "HID H10301 26-bit",          {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"ind26",   Pack_ind26,   Unpack_ind26,   "Indala 26-bit",              {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ind27",   Pack_ind27,   Unpack_ind27,   "Indala 27-bit",              {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"indasc27", Pack_indasc27, Unpack_indasc27, "Indala ASC 27-bit",       {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"Tecom27", Pack_Tecom27, Unpack_Tecom27, "Tecom 27-bit",               {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"2804W",   Pack_2804W,   Unpack_2804W,   "2804 Wiegand 28-bit",        {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ind29",   Pack_ind29,   Unpack_ind29,   "Indala 29-bit",              {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"ATSW30",  Pack_ATSW30,  Unpack_ATSW30,  "ATS Wiegand 30-bit",         {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ADT31",   Pack_ADT31,   Unpack_ADT31,   "HID ADT 31-bit",             {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"HCP32",   Pack_hcp32,   Unpack_hcp32,   "HID Check Point 32-bit",     {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"HPP32",   Pack_hpp32,   Unpack_hpp32,   "HID Hewlett-Packard 32-bit", {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"Kastle",  Pack_Kastle,  Unpack_Kastle,  "Kastle 32-bit",              {1, 1, 1, 0, 1}}, // from @xilni; PR #23 on RfidResearchGroup/proxmark3
-    {"Kantech", Pack_Kantech, Unpack_Kantech, "Indala/Kantech KFS 32-bit",  {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"WIE32",   Pack_wie32,   Unpack_wie32,   "Wiegand 32-bit",             {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"D10202",  Pack_D10202,  Unpack_D10202,  "HID D10202 33-bit",          {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"H10306",  Pack_H10306,  Unpack_H10306,  "HID H10306 34-bit",          {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"N10002",  Pack_N10002,  Unpack_N10002,  "Honeywell/Northern N10002 34-bit", {1, 1, 0, 0, 1}}, // from proxclone.com
-    {"Optus34", Pack_Optus,   Unpack_Optus,   "Indala Optus 34-bit",        {1, 1, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"SMP34",   Pack_Smartpass, Unpack_Smartpass, "Cardkey Smartpass 34-bit", {1, 1, 1, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"BQT34",   Pack_bqt34,   Unpack_bqt34,   "BQT 34-bit",                 {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"C1k35s",  Pack_C1k35s,  Unpack_C1k35s,  "HID Corporate 1000 35-bit std", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"C15001",  Pack_C15001,  Unpack_C15001,  "HID KeyScan 36-bit",         {1, 1, 0, 1, 1}}, // from Proxmark forums
-    {"S12906",  Pack_S12906,  Unpack_S12906,  "HID Simplex 36-bit",         {1, 1, 1, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"Sie36",   Pack_Sie36,   Unpack_Sie36,   "HID 36-bit Siemens",         {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"H10320",  Pack_H10320,  Unpack_H10320,  "HID H10320 36-bit BCD",      {1, 0, 0, 0, 1}}, // from Proxmark forums
-    {"H10302",  Pack_H10302,  Unpack_H10302,  "HID H10302 37-bit huge ID",  {1, 0, 0, 0, 1}}, // from Proxmark forums
-    {"H10304",  Pack_H10304,  Unpack_H10304,  "HID H10304 37-bit",          {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"P10004",  Pack_P10004,  Unpack_P10004,  "HID P10004 37-bit PCSC",     {1, 1, 0, 0, 0}}, // from @bthedorff; PR #1559
-    {"HGen37",  Pack_HGeneric37, Unpack_HGeneric37,  "HID Generic 37-bit", {1, 0, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"MDI37",   Pack_MDI37,   Unpack_MDI37,   "PointGuard MDI 37-bit",         {1, 1, 0, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"BQT38",   Pack_bqt38,   Unpack_bqt38,   "BQT 38-bit",                    {1, 1, 1, 0, 1}}, // from cardinfo.barkweb.com.au
-    {"ISCS",    Pack_iscs38,  Unpack_iscs38,  "ISCS 38-bit",                   {1, 1, 0, 1, 1}}, // from cardinfo.barkweb.com.au
-    {"PW39",    Pack_pw39,    Unpack_pw39,    "Pyramid 39-bit wiegand format", {1, 1, 0, 0, 1}},  // from cardinfo.barkweb.com.au
-    {"P10001",  Pack_P10001,  Unpack_P10001,  "HID P10001 Honeywell 40-bit",   {1, 1, 0, 1, 0}}, // from cardinfo.barkweb.com.au
-    {"Casi40",  Pack_CasiRusco40, Unpack_CasiRusco40, "Casi-Rusco 40-bit",     {1, 0, 0, 0, 0}}, // from cardinfo.barkweb.com.au
-    {"C1k48s",  Pack_C1k48s,  Unpack_C1k48s,  "HID Corporate 1000 48-bit std", {1, 1, 0, 0, 1}}, // imported from old pack/unpack
-    {"BC40",    Pack_bc40,    Unpack_bc40,    "Bundy TimeClock 40-bit",     {1, 1, 0, 1, 1}}, // from
-    {"Avig56", Pack_Avig56, Unpack_Avig56, "Avigilon 56-bit", {1, 1, 0, 0, 1}},
-    {NULL, NULL, NULL, NULL, {0, 0, 0, 0, 0}} // Must null terminate array
+    {"H10301",  Pack_H10301,  Unpack_H10301,  "HID H10301 26-bit",          {1, 1, 0, 0, 1}, 26}, // imported from old pack/unpack
+    {"ind26",   Pack_ind26,   Unpack_ind26,   "Indala 26-bit",              {1, 1, 0, 0, 1}, 26}, // from cardinfo.barkweb.com.au
+    {"ind27",   Pack_ind27,   Unpack_ind27,   "Indala 27-bit",              {1, 1, 0, 0, 0}, 27}, // from cardinfo.barkweb.com.au
+    {"indasc27", Pack_indasc27, Unpack_indasc27, "Indala ASC 27-bit",       {1, 1, 0, 0, 0}, 27}, // from cardinfo.barkweb.com.au
+    {"Tecom27", Pack_Tecom27, Unpack_Tecom27, "Tecom 27-bit",               {1, 1, 0, 0, 1}, 27}, // from cardinfo.barkweb.com.au
+    {"2804W",   Pack_2804W,   Unpack_2804W,   "2804 Wiegand 28-bit",        {1, 1, 0, 0, 1}, 28}, // from cardinfo.barkweb.com.au
+    {"ind29",   Pack_ind29,   Unpack_ind29,   "Indala 29-bit",              {1, 1, 0, 0, 0}, 29}, // from cardinfo.barkweb.com.au
+    {"ATSW30",  Pack_ATSW30,  Unpack_ATSW30,  "ATS Wiegand 30-bit",         {1, 1, 0, 0, 1}, 30}, // from cardinfo.barkweb.com.au
+    {"ADT31",   Pack_ADT31,   Unpack_ADT31,   "HID ADT 31-bit",             {1, 1, 0, 0, 0}, 31}, // from cardinfo.barkweb.com.au
+    {"HCP32",   Pack_hcp32,   Unpack_hcp32,   "HID Check Point 32-bit",     {1, 1, 0, 0, 0}, 32}, // from cardinfo.barkweb.com.au
+    {"HPP32",   Pack_hpp32,   Unpack_hpp32,   "HID Hewlett-Packard 32-bit", {1, 1, 0, 0, 0}, 32}, // from cardinfo.barkweb.com.au
+    {"Kastle",  Pack_Kastle,  Unpack_Kastle,  "Kastle 32-bit",              {1, 1, 1, 0, 1}, 32}, // from @xilni; PR #23 on RfidResearchGroup/proxmark3
+    {"Kantech", Pack_Kantech, Unpack_Kantech, "Indala/Kantech KFS 32-bit",  {1, 1, 0, 0, 0}, 32}, // from cardinfo.barkweb.com.au
+    {"WIE32",   Pack_wie32,   Unpack_wie32,   "Wiegand 32-bit",             {1, 1, 0, 0, 0}, 32}, // from cardinfo.barkweb.com.au
+    {"D10202",  Pack_D10202,  Unpack_D10202,  "HID D10202 33-bit",          {1, 1, 0, 0, 1}, 33}, // from cardinfo.barkweb.com.au
+    {"H10306",  Pack_H10306,  Unpack_H10306,  "HID H10306 34-bit",          {1, 1, 0, 0, 1}, 34}, // imported from old pack/unpack
+    {"N10002",  Pack_N10002,  Unpack_N10002,  "Honeywell/Northern N10002 34-bit", {1, 1, 0, 0, 1}, 34}, // from proxclone.com
+    {"Optus34", Pack_Optus,   Unpack_Optus,   "Indala Optus 34-bit",        {1, 1, 0, 0, 0}, 34}, // from cardinfo.barkweb.com.au
+    {"SMP34",   Pack_Smartpass, Unpack_Smartpass, "Cardkey Smartpass 34-bit", {1, 1, 1, 0, 0}, 34}, // from cardinfo.barkweb.com.au
+    {"BQT34",   Pack_bqt34,   Unpack_bqt34,   "BQT 34-bit",                 {1, 1, 0, 0, 1}, 34}, // from cardinfo.barkweb.com.au
+    {"C1k35s",  Pack_C1k35s,  Unpack_C1k35s,  "HID Corporate 1000 35-bit std", {1, 1, 0, 0, 1}, 35}, // imported from old pack/unpack
+    {"C15001",  Pack_C15001,  Unpack_C15001,  "HID KeyScan 36-bit",         {1, 1, 0, 1, 1}, 36}, // from Proxmark forums
+    {"S12906",  Pack_S12906,  Unpack_S12906,  "HID Simplex 36-bit",         {1, 1, 1, 0, 1}, 36}, // from cardinfo.barkweb.com.au
+    {"Sie36",   Pack_Sie36,   Unpack_Sie36,   "HID 36-bit Siemens",         {1, 1, 0, 0, 1}, 36}, // from cardinfo.barkweb.com.au
+    {"H10320",  Pack_H10320,  Unpack_H10320,  "HID H10320 36-bit BCD",      {1, 0, 0, 0, 1}, 36}, // from Proxmark forums
+    {"H10302",  Pack_H10302,  Unpack_H10302,  "HID H10302 37-bit huge ID",  {1, 0, 0, 0, 1}, 37}, // from Proxmark forums
+    {"H10304",  Pack_H10304,  Unpack_H10304,  "HID H10304 37-bit",          {1, 1, 0, 0, 1}, 37}, // from cardinfo.barkweb.com.au
+    {"P10004",  Pack_P10004,  Unpack_P10004,  "HID P10004 37-bit PCSC",     {1, 1, 0, 0, 0}, 37}, // from @bthedorff; PR #1559
+    {"HGen37",  Pack_HGeneric37, Unpack_HGeneric37,  "HID Generic 37-bit", {1, 0, 0, 0, 1}, 37}, // from cardinfo.barkweb.com.au
+    {"MDI37",   Pack_MDI37,   Unpack_MDI37,   "PointGuard MDI 37-bit",         {1, 1, 0, 0, 1}, 37}, // from cardinfo.barkweb.com.au
+    {"BQT38",   Pack_bqt38,   Unpack_bqt38,   "BQT 38-bit",                    {1, 1, 1, 0, 1}, 38}, // from cardinfo.barkweb.com.au
+    {"ISCS",    Pack_iscs38,  Unpack_iscs38,  "ISCS 38-bit",                   {1, 1, 0, 1, 1}, 38}, // from cardinfo.barkweb.com.au
+    {"PW39",    Pack_pw39,    Unpack_pw39,    "Pyramid 39-bit wiegand format", {1, 1, 0, 0, 1}, 39},  // from cardinfo.barkweb.com.au
+    {"P10001",  Pack_P10001,  Unpack_P10001,  "HID P10001 Honeywell 40-bit",   {1, 1, 0, 1, 0}, 40}, // from cardinfo.barkweb.com.au
+    {"Casi40",  Pack_CasiRusco40, Unpack_CasiRusco40, "Casi-Rusco 40-bit",     {1, 0, 0, 0, 0}, 40}, // from cardinfo.barkweb.com.au
+    {"C1k48s",  Pack_C1k48s,  Unpack_C1k48s,  "HID Corporate 1000 48-bit std", {1, 1, 0, 0, 1}, 48}, // imported from old pack/unpack
+    {"BC40",    Pack_bc40,    Unpack_bc40,    "Bundy TimeClock 40-bit",     {1, 1, 0, 1, 1}, 39}, // from
+    {"Avig56", Pack_Avig56, Unpack_Avig56, "Avigilon 56-bit", {1, 1, 0, 0, 1}, 56},
+    {NULL, NULL, NULL, NULL, {0, 0, 0, 0, 0}, 0} // Must null terminate array
 };
 
 void HIDListFormats(void) {
@@ -1552,25 +1553,86 @@ void HIDPackTryAll(wiegand_card_t *card, bool preamble) {
     PrintAndLogEx(NORMAL, "");
 }
 
+// formats grouped by bit length,  table order kept inside a group.  A message only
+// goes through the unpackers of its own length
+#define WIEGAND_MAX_BITS 96
+static uint8_t fmt_len_first[WIEGAND_MAX_BITS + 2];
+static uint8_t fmt_by_len[ARRAYLEN(FormatTable)];
+static pthread_once_t fmt_index_once = PTHREAD_ONCE_INIT;
+
+static void HIDIndexFormats(void) {
+    uint8_t cnt[WIEGAND_MAX_BITS + 1] = {0};
+    for (size_t i = 0; FormatTable[i].Name; i++) {
+        if (FormatTable[i].Bits <= WIEGAND_MAX_BITS) {
+            cnt[FormatTable[i].Bits]++;
+        }
+    }
+
+    fmt_len_first[0] = 0;
+    for (int len = 0; len <= WIEGAND_MAX_BITS; len++) {
+        fmt_len_first[len + 1] = fmt_len_first[len] + cnt[len];
+    }
+
+    uint8_t pos[WIEGAND_MAX_BITS + 1];
+    memcpy(pos, fmt_len_first, sizeof(pos));
+    for (size_t i = 0; FormatTable[i].Name; i++) {
+        if (FormatTable[i].Bits <= WIEGAND_MAX_BITS) {
+            fmt_by_len[pos[FormatTable[i].Bits]++] = i;
+        }
+    }
+}
+
+// unpack with every format of the message's length,  returns the number of matches
+int HIDDecode(wiegand_message_t *packed, wiegand_decode_t *out) {
+    pthread_once(&fmt_index_once, HIDIndexFormats);
+
+    out->count = 0;
+    out->valid = 0;
+    if (packed->Length > WIEGAND_MAX_BITS) {
+        return 0;
+    }
+
+    for (uint8_t k = fmt_len_first[packed->Length]; k < fmt_len_first[packed->Length + 1]; k++) {
+        if (out->count == WIEGAND_DECODE_MAX) {
+            break;
+        }
+
+        uint8_t i = fmt_by_len[k];
+        wiegand_card_t *card = &out->card[out->count];
+        if (FormatTable[i].Unpack(packed, card)) {
+            out->format_idx[out->count] = i;
+            out->count++;
+            if (FormatTable[i].Fields.hasParity == false && card->ParityValid) {
+                out->valid++;
+            }
+        }
+    }
+    return out->count;
+}
+
+// bulk decode without output,  returns how many messages matched at least one format
+size_t HIDDecodeBatch(wiegand_message_t *packed, size_t count, wiegand_decode_t *out) {
+    size_t matched = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (HIDDecode(&packed[i], &out[i])) {
+            matched++;
+        }
+    }
+    return matched;
+}
+
 bool HIDTryUnpack(wiegand_message_t *packed) {
     if (FormatTable[0].Name == NULL)
         return false;
 
-    int i = 0;
-    wiegand_card_t card;
-    memset(&card, 0, sizeof(wiegand_card_t));
-    uint8_t found_cnt = 0, found_invalid_par = 0;
+    wiegand_decode_t res;
+    HIDDecode(packed, &res);
 
-    while (FormatTable[i].Name) {
-        if (FormatTable[i].Unpack(packed, &card)) {
+    uint8_t found_cnt = res.count;
+    uint8_t found_invalid_par = found_cnt - res.valid;
 
-            found_cnt++;
-            hid_print_card(&card, FormatTable[i]);
-
-            if (FormatTable[i].Fields.hasParity || card.ParityValid == false)
-                found_invalid_par++;
-        }
-        ++i;
+    for (uint8_t i = 0; i < res.count; i++) {
+        hid_print_card(&res.card[i], FormatTable[res.format_idx[i]]);
     }
 
     if (found_cnt) {
@@ -45,13 +45,25 @@ typedef struct {
     bool (*Unpack)(wiegand_message_t *packed, wiegand_card_t *card);
     const char *Descrp;
     cardformatdescriptor_t Fields;
+    uint8_t Bits;      // wiegand length the format unpacks
 } cardformat_t;
 
+// every format that unpacked a message,  in table order
+#define WIEGAND_DECODE_MAX  8
+typedef struct {
+    uint8_t count;
+    uint8_t valid;                      // matches HIDTryUnpack counts as a success
+    int format_idx[WIEGAND_DECODE_MAX];
+    wiegand_card_t card[WIEGAND_DECODE_MAX];
+} wiegand_decode_t;
+
 void HIDListFormats(void);
 int HIDFindCardFormat(const char *format);
 cardformat_t HIDGetCardFormat(int idx);
 bool HIDPack(int format_idx, wiegand_card_t *card, wiegand_message_t *packed, bool preamble);
 bool HIDTryUnpack(wiegand_message_t *packed);
+int HIDDecode(wiegand_message_t *packed, wiegand_decode_t *out);
+size_t HIDDecodeBatch(wiegand_message_t *packed, size_t count, wiegand_decode_t *out);
 void HIDPackTryAll(wiegand_card_t *card, bool preamble);
 void HIDUnpack(int idx, wiegand_message_t *packed);
 void print_wiegand_code(wiegand_message_t *packed);
@@ -78,31 +78,89 @@ static void message_datacopy(wiegand_message_t *src, wiegand_message_t *dest) {
     dest->Top = src->Top;
     dest->Length = src->Length;
 }
-/**
- *
- * Yes, this is horribly inefficient for linear data.
- * The current code is a temporary measure to have a working function in place
- * until all the bugs shaken from the block/chunk version of the code.
- *
- */
+// <n> bits (n <= 64) of the message from ordinal position <lo> upwards,  bits above 95 read as 0
+static uint64_t message_get_bits(const wiegand_message_t *data, uint8_t lo, uint8_t n) {
+    uint64_t low = ((uint64_t)data->Mid << 32) | data->Bot;
+    uint64_t v;
+    if (lo >= 64) {
+        v = (lo >= 96) ? 0 : (data->Top >> (lo - 64));
+    } else {
+        v = low >> lo;
+        if (lo > 0) {
+            v |= (uint64_t)data->Top << (64 - lo);
+        }
+    }
+    return (n < 64) ? (v & ((1ULL << n) - 1)) : v;
+}
+
+static void message_set_bits(wiegand_message_t *data, uint64_t value, uint8_t lo, uint8_t n) {
+    uint64_t mask = (n < 64) ? ((1ULL << n) - 1) : UINT64_MAX;
+    value &= mask;
+
+    if (lo >= 64) {
+        data->Top = (data->Top & ~(uint32_t)(mask << (lo - 64))) | (uint32_t)(value << (lo - 64));
+        return;
+    }
+
+    uint64_t low = ((uint64_t)data->Mid << 32) | data->Bot;
+    low = (low & ~(mask << lo)) | (value << lo);
+    data->Mid = (uint32_t)(low >> 32);
+    data->Bot = (uint32_t)low;
+
+    // the part that spills into Top
+    if (lo > 0 && (lo + n) > 64) {
+        data->Top = (data->Top & ~(uint32_t)(mask >> (64 - lo))) | (uint32_t)(value >> (64 - lo));
+    }
+}
+
+// Linear fields are cut out of the message a word at a time.  Position 0 is the
+// first transmitted bit,  so a field maps onto ordinals Length - firstBit - length and up
 uint64_t get_linear_field(wiegand_message_t *data, uint8_t firstBit, uint8_t length) {
-    uint64_t result = 0;
-    for (uint8_t i = 0; i < length; i++) {
-        result = (result << 1) | get_bit_by_position(data, firstBit + i);
+    if (length == 0 || firstBit >= data->Length) {
+        return 0;
     }
-    return result;
+
+    if (length > 64) {
+        uint64_t result = 0;
+        for (uint16_t i = 0; i < length; i++) {
+            result = (result << 1) | get_bit_by_position(data, firstBit + i);
+        }
+        return result;
+    }
+
+    // positions past the end read as 0 and land in the low bits
+    uint8_t tail = 0;
+    if (firstBit + length > data->Length) {
+        tail = firstBit + length - data->Length;
+    }
+    uint8_t valid = length - tail;
+
+    uint64_t result = message_get_bits(data, data->Length - firstBit - valid, valid);
+    return (tail < 64) ? (result << tail) : 0;
 }
+
 bool set_linear_field(wiegand_message_t *data, uint64_t value, uint8_t firstBit, uint8_t length) {
-    wiegand_message_t tmpdata;
-    message_datacopy(data, &tmpdata);
-    bool result = true;
-    for (int i = 0; i < length; i++) {
-        result &= set_bit_by_position(&tmpdata, (value >> ((length - i) - 1)) & 1, firstBit + i);
+    if (length == 0) {
+        return true;
     }
-    if (result)
-        message_datacopy(&tmpdata, data);
 
-    return result;
+    // same as setting bit by bit,  any bit out of range fails the whole field
+    if (length > 64 || firstBit + length > data->Length || data->Length - firstBit > 96) {
+        wiegand_message_t tmpdata;
+        message_datacopy(data, &tmpdata);
+        bool result = true;
+        for (int i = 0; i < length; i++) {
+            uint8_t shift = (length - i) - 1;
+            result &= set_bit_by_position(&tmpdata, (shift < 64) ? ((value >> shift) & 1) : 0, firstBit + i);
+        }
+        if (result)
+            message_datacopy(&tmpdata, data);
+
+        return result;
+    }
+
+    message_set_bits(data, value, data->Length - firstBit - length, length);
+    return true;
 }
 
 uint64_t get_nonlinear_field(wiegand_message_t *data, uint8_t numBits, uint8_t *bits) {
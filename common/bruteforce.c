@@ -62,19 +62,184 @@ int bf_generator_set_charset(generator_context_t *ctx, uint8_t charsets) {
 
 int bf_generate(generator_context_t *ctx) {
 
+    if (ctx->index_end && ctx->index >= ctx->index_end) {
+        return BF_GENERATOR_END;
+    }
+
+    int res = BF_GENERATOR_ERROR;
+    switch (ctx->mode) {
+        case BF_MODE_RANGE: {
+            res = _bf_generate_mode_range(ctx);
+            break;
+        }
+        case BF_MODE_CHARSET: {
+            res = _bf_generate_mode_charset(ctx);
+            break;
+        }
+        case BF_MODE_SMART: {
+            res = _bf_generate_mode_smart(ctx);
+            break;
+        }
+    }
+
+    if (res == BF_GENERATOR_NEXT) {
+        ctx->index++;
+    }
+    return res;
+}
+
+// nibble sequence,  offsets per high nibble
+static uint8_t smart_nibble_max_offset(const generator_context_t *ctx) {
+    // we substract %2 value because max_offset must be even number
+    return 10 - (ctx->key_length / 2) - (ctx->key_length / 2) % 2;
+}
+
+// keys in one smart mode stage
+static uint64_t smart_stage_count(const generator_context_t *ctx, uint16_t stage) {
+    smart_generator_t *gen = smart_generators[stage];
+    if (gen == smart_generator_byte_repeat || gen == smart_generator_msb_byte_only) {
+        return 0x100;
+    }
+    if (gen == smart_generator_nibble_sequence) {
+        // high nibble A .. F
+        return 6 * smart_nibble_max_offset(ctx);
+    }
+    return 0;
+}
+
+static void smart_stage_seek(generator_context_t *ctx, uint16_t stage, uint64_t index) {
+    bf_generator_clear(ctx);
+    ctx->smart_mode_stage = stage;
+
+    smart_generator_t *gen = smart_generators[stage];
+    if (gen == smart_generator_byte_repeat || gen == smart_generator_msb_byte_only) {
+        ctx->counter1 = index;
+    } else if (gen == smart_generator_nibble_sequence) {
+        uint8_t max_offset = smart_nibble_max_offset(ctx);
+        ctx->counter1 = 0x0A + (index / max_offset);
+        ctx->counter2 = index % max_offset;
+    }
+}
+
+uint64_t bf_generator_count(const generator_context_t *ctx) {
+
+    if (ctx->key_length != BF_KEY_SIZE_32 && ctx->key_length != BF_KEY_SIZE_48 && ctx->key_length != BF_KEY_SIZE_64) {
+        return 0;
+    }
+
+    switch (ctx->mode) {
+        case BF_MODE_RANGE: {
+            if (ctx->range_high < ctx->range_low) {
+                return 0;
+            }
+            uint64_t span = ctx->range_high - ctx->range_low;
+            return (span == UINT64_MAX) ? UINT64_MAX : span + 1;
+        }
+        case BF_MODE_CHARSET: {
+            uint64_t n = 1;
+            for (uint8_t i = 0; i < ctx->key_length; i++) {
+                if (ctx->charset_length && n > UINT64_MAX / ctx->charset_length) {
+                    return UINT64_MAX;
+                }
+                n *= ctx->charset_length;
+            }
+            return n;
+        }
+        case BF_MODE_SMART: {
+            uint64_t n = 0;
+            for (uint16_t i = 0; smart_generators[i] != NULL; i++) {
+                n += smart_stage_count(ctx, i);
+            }
+            return n;
+        }
+    }
+    return 0;
+}
+
+int bf_generator_seek(generator_context_t *ctx, uint64_t index) {
+
+    if (ctx->mode != BF_MODE_RANGE && ctx->mode != BF_MODE_CHARSET && ctx->mode != BF_MODE_SMART) {
+        return BF_GENERATOR_ERROR;
+    }
+
+    uint64_t total = bf_generator_count(ctx);
+
+    bf_generator_clear(ctx);
+    ctx->index = index;
+
     switch (ctx->mode) {
         case BF_MODE_RANGE: {
-            return _bf_generate_mode_range(ctx);
+            if (index >= total) {
+                // past the end,  the next call ends the generator
+                ctx->current_key = ctx->range_high;
+                ctx->flag1 = true;
+            } else if (index == 0) {
+                ctx->current_key = ctx->range_low;
+            } else {
+                // one below,  the generator increments before it emits
+                ctx->current_key = ctx->range_low + index - 1;
+                ctx->flag1 = true;
+            }
+            break;
         }
         case BF_MODE_CHARSET: {
-            return _bf_generate_mode_charset(ctx);
+            memset(ctx->pos, 0, sizeof(ctx->pos));
+            if (index >= total) {
+                ctx->flag1 = true;
+                break;
+            }
+            // index in base charset_length,  pos[0] is the most significant digit
+            for (int8_t i = ctx->key_length - 1; i >= 0; i--) {
+                ctx->pos[i] = index % ctx->charset_length;
+                index /= ctx->charset_length;
+            }
+            break;
         }
         case BF_MODE_SMART: {
-            return _bf_generate_mode_smart(ctx);
+            uint16_t stage = 0;
+            while (smart_generators[stage] != NULL) {
+                uint64_t n = smart_stage_count(ctx, stage);
+                if (index < n) {
+                    break;
+                }
+                index -= n;
+                stage++;
+            }
+
+            if (smart_generators[stage] == NULL) {
+                ctx->smart_mode_stage = stage;
+            } else {
+                smart_stage_seek(ctx, stage, index);
+            }
+            break;
         }
     }
+    return BF_GENERATOR_NEXT;
+}
+
+int bf_generator_split(const generator_context_t *ctx, uint32_t parts, uint32_t part, generator_context_t *sub) {
+
+    if (parts == 0 || part >= parts) {
+        return BF_GENERATOR_ERROR;
+    }
 
-    return BF_GENERATOR_ERROR;
+    uint64_t total = bf_generator_count(ctx);
+
+    // the first (total % parts) slices take one key more
+    uint64_t size = total / parts;
+    uint64_t extra = total % parts;
+    uint64_t start = size * part + MIN(part, extra);
+    uint64_t end = start + size + ((part < extra) ? 1 : 0);
+
+    memcpy(sub, ctx, sizeof(generator_context_t));
+    if (start == end) {
+        // empty slice
+        sub->index_end = 0;
+        return bf_generator_seek(sub, total);
+    }
+
+    sub->index_end = end;
+    return bf_generator_seek(sub, start);
 }
 
 
@@ -123,6 +288,11 @@ uint64_t bf_get_key48(const generator_context_t *ctx) {
     return ctx->current_key & 0xFFFFFFFFFFFF;
 }
 
+// get current key, 64 bit
+uint64_t bf_get_key64(const generator_context_t *ctx) {
+    return ctx->current_key;
+}
+
 void bf_generator_clear(generator_context_t *ctx) {
     ctx->flag1 = 0;
     ctx->flag2 = 0;
@@ -133,29 +303,29 @@ void bf_generator_clear(generator_context_t *ctx) {
 
 int _bf_generate_mode_range(generator_context_t *ctx) {
 
-    if (ctx->key_length != BF_KEY_SIZE_32 && ctx->key_length != BF_KEY_SIZE_48) {
+    if (ctx->key_length != BF_KEY_SIZE_32 && ctx->key_length != BF_KEY_SIZE_48 && ctx->key_length != BF_KEY_SIZE_64) {
         return BF_GENERATOR_ERROR;
     }
 
-    if (ctx->current_key >= ctx->range_high) {
-        return BF_GENERATOR_END;
-    }
-
     // we use flag1 as indicator if value of range_low was already emitted
     // so the range generated is <range_low, range_high>
-    if (ctx->current_key <= ctx->range_low && ctx->flag1 == false) {
+    if (ctx->range_low <= ctx->range_high && ctx->current_key <= ctx->range_low && ctx->flag1 == false) {
         ctx->current_key = ctx->range_low;
         ctx->flag1 = true;
         return BF_GENERATOR_NEXT;
     }
 
+    if (ctx->current_key >= ctx->range_high) {
+        return BF_GENERATOR_END;
+    }
+
     ctx->current_key++;
     return BF_GENERATOR_NEXT;
 }
 
 int _bf_generate_mode_charset(generator_context_t *ctx) {
 
-    if (ctx->key_length != BF_KEY_SIZE_32 && ctx->key_length != BF_KEY_SIZE_48) {
+    if (ctx->key_length != BF_KEY_SIZE_32 && ctx->key_length != BF_KEY_SIZE_48 && ctx->key_length != BF_KEY_SIZE_64) {
         return BF_GENERATOR_ERROR;
     }
 
@@ -247,8 +417,7 @@ int smart_generator_nibble_sequence(generator_context_t *ctx) {
 
     uint8_t key_byte;
 
-    // we substract %2 value because max_offset must be even number
-    uint8_t max_offset = 10 - (ctx->key_length / 2) - (ctx->key_length / 2) % 2;
+    uint8_t max_offset = smart_nibble_max_offset(ctx);
 
     if (ctx->counter1 == 0x10) {
         return BF_GENERATOR_END;
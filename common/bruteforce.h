@@ -23,6 +23,7 @@
 
 #define BF_KEY_SIZE_32 4
 #define BF_KEY_SIZE_48 6
+#define BF_KEY_SIZE_64 8
 
 // bruteforcing all keys sequentially between X and Y
 #define BF_MODE_RANGE 1
@@ -57,7 +58,7 @@ typedef struct {
     // position of each of bytes in charset mode - used to iterate over alphabets
     // add more bytes to support larger keys
     // pos[0] is most significant byte - all maths avoid relying on little/big endian memory layout
-    uint8_t pos[6]; // max supported key is now 48 bit
+    uint8_t pos[8]; // max supported key is now 64 bit
 
     uint8_t key_length; // bytes
     uint64_t current_key; // Use 64 bit and truncate when needed.
@@ -68,14 +69,19 @@ typedef struct {
     ];
     uint8_t charset_length;
 
-    uint32_t range_low;
-    uint32_t range_high;
+    uint64_t range_low;
+    uint64_t range_high;
     uint16_t smart_mode_stage;
     // flags to use internally by generators as they wish
     bool flag1, flag2, flag3;
     // counters to use internally by generators as they wish
     uint32_t counter1, counter2;
 
+    // number of keys generated so far,  the first key is index 0.
+    // index_end stops the generator at that index,  0 means no limit
+    uint64_t index;
+    uint64_t index_end;
+
 } generator_context_t;
 
 
@@ -87,8 +93,19 @@ int _bf_generate_mode_range(generator_context_t *ctx);
 int _bf_generate_mode_charset(generator_context_t *ctx);
 int _bf_generate_mode_smart(generator_context_t *ctx);
 int bf_array_increment(uint8_t *data, uint8_t data_len, uint8_t modulo);
+// splittable generators,  so the key space can be shared between threads,
+// devices or hosts.  Set up the context as usual (init, charset, range) first.
+//
+// number of keys the context generates from its start,  saturates at UINT64_MAX
+uint64_t bf_generator_count(const generator_context_t *ctx);
+// the next bf_generate() returns the key with this index
+int bf_generator_seek(generator_context_t *ctx, uint64_t index);
+// sub context <part> of <parts> generates its own disjoint slice of the keys
+int bf_generator_split(const generator_context_t *ctx, uint32_t parts, uint32_t part, generator_context_t *sub);
+
 uint32_t bf_get_key32(const generator_context_t *ctx);
 uint64_t bf_get_key48(const generator_context_t *ctx);
+uint64_t bf_get_key64(const generator_context_t *ctx);
 
 // smart mode
 typedef int (smart_generator_t)(generator_context_t *ctx);
@@ -15,46 +15,68 @@
 //-----------------------------------------------------------------------------
 #include "bucketsort.h"
 
+#include <string.h>
+
+// counting sort on the MSB (contribution bits).  Both lists are only copied once into one contiguous scratch
+// buffer, and only the buckets in use are visited, which keeps the many small lists of the deeper recursion
+// levels of lfsr_recovery32 cheap
 extern void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
                                   uint32_t *const ostart, uint32_t *const ostop,
-                                  bucket_info_t *bucket_info, bucket_array_t bucket) {
-    uint32_t *p1, *p2;
+                                  bucket_info_t *bucket_info, uint32_t *scratch) {
     uint32_t *start[2];
     uint32_t *stop[2];
+    uint32_t count[2][0x100];
+    uint32_t pos[2][0x100];
+    uint64_t used[2][4] = {{0}};
+    uint64_t keep[4];
 
     start[0] = estart;
     stop[0] = estop;
     start[1] = ostart;
     stop[1] = ostop;
 
-    // init buckets to be empty
-    for (uint32_t i = 0; i < 2; i++) {
-        for (uint32_t j = 0x00; j <= 0xff; j++) {
-            bucket[i][j].bp = bucket[i][j].head;
-        }
-    }
-
-    // sort the lists into the buckets based on the MSB (contribution bits)
     for (uint32_t i = 0; i < 2; i++) {
-        for (p1 = start[i]; p1 <= stop[i]; p1++) {
-            uint32_t bucket_index = (*p1 & 0xff000000) >> 24;
-            *(bucket[i][bucket_index].bp++) = *p1;
+        for (uint32_t *p = start[i]; p <= stop[i]; p++) {
+            const uint32_t j = *p >> 24;
+            const uint64_t bit = 1ULL << (j & 0x3f);
+            if ((used[i][j >> 6] & bit) == 0) {
+                used[i][j >> 6] |= bit;
+                count[i][j] = 0;
+            }
+            count[i][j]++;
         }
     }
 
-    // write back intersecting buckets as sorted list.
+    // intersecting buckets only.
     // fill in bucket_info with head and tail of the bucket contents in the list and number of non-empty buckets.
+    for (uint32_t w = 0; w < 4; w++) {
+        keep[w] = used[0][w] & used[1][w];
+    }
     for (uint32_t i = 0; i < 2; i++) {
-        p1 = start[i];
+        uint32_t offset = 0;
         uint32_t nonempty_bucket = 0;
-        for (uint32_t j = 0x00; j <= 0xff; j++) {
-            if (bucket[0][j].bp != bucket[0][j].head && bucket[1][j].bp != bucket[1][j].head) { // non-empty intersecting buckets only
-                bucket_info->bucket_info[i][nonempty_bucket].head = p1;
-                for (p2 = bucket[i][j].head; p2 < bucket[i][j].bp; *p1++ = *p2++);
-                bucket_info->bucket_info[i][nonempty_bucket].tail = p1 - 1;
+        for (uint32_t w = 0; w < 4; w++) {
+            for (uint64_t bits = keep[w]; bits; bits &= bits - 1) {
+                const uint32_t j = (w << 6) | __builtin_ctzll(bits);
+                pos[i][j] = offset;
+                bucket_info->bucket_info[i][nonempty_bucket].head = start[i] + offset;
+                offset += count[i][j];
+                bucket_info->bucket_info[i][nonempty_bucket].tail = start[i] + offset - 1;
                 nonempty_bucket++;
             }
         }
         bucket_info->numbuckets = nonempty_bucket;
     }
+
+    // write back intersecting buckets as sorted list, keeping the order within a bucket
+    for (uint32_t i = 0; i < 2; i++) {
+        const uint32_t len = stop[i] - start[i] + 1;
+        memcpy(scratch, start[i], len * sizeof(uint32_t));
+        for (uint32_t k = 0; k < len; k++) {
+            const uint32_t j = scratch[k] >> 24;
+            if ((keep[j >> 6] >> (j & 0x3f)) & 1) {
+                start[i][pos[i][j]++] = scratch[k];
+            }
+        }
+    }
 }
@@ -18,13 +18,6 @@
 
 #include "common.h"
 
-typedef struct bucket {
-    uint32_t *head;
-    uint32_t *bp;
-} bucket_t;
-
-typedef bucket_t bucket_array_t[2][0x100];
-
 typedef struct bucket_info {
     struct {
         uint32_t *head, *tail;
@@ -32,8 +25,9 @@ typedef struct bucket_info {
     uint32_t numbuckets;
 } bucket_info_t;
 
+// scratch must hold as many entries as the longer of the two lists
 void bucket_sort_intersect(uint32_t *const estart, uint32_t *const estop,
                            uint32_t *const ostart, uint32_t *const ostop,
-                           bucket_info_t *bucket_info, bucket_array_t bucket);
+                           bucket_info_t *bucket_info, uint32_t *scratch);
 
 #endif
@@ -23,17 +23,10 @@
 
 
 #if !defined LOWMEM
-#define CONSTRUCTOR
 static uint8_t filterlut[0x100000];
 static uint8_t uc_evenparity32_lut[0x10E100A];
 
-// GUNC
-#if defined __GNUC__
-#undef CONSTRUCTOR
-#define CONSTRUCTOR __attribute__((constructor))
-#endif
-
-static void CONSTRUCTOR init_lut(void) {
+static void init_lut(void) {
 
     for (uint32_t i = 0; i < 1 << 20; ++i) {
         filterlut[i] = filter(i);
@@ -51,10 +44,22 @@ typedef void(__cdecl *PF)(void);
 #pragma section(".CRT$XCG", read)
 __declspec(allocate(".CRT$XCG")) PF f[] = { init_lut };
 
+#define lut_init()
+
+#else
+
+// the tables are 18 MB,  filled on first use rather than by a constructor so
+// processes which never recover a key don't carry them
+#include <pthread.h>
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+#define lut_init() pthread_once(&lut_once, init_lut)
+
 #endif
 
 #define filter(x) (filterlut[(x) & 0xfffff])
 #define even32(x) (uc_evenparity32_lut[(x)])
+#else
+#define lut_init()
 #endif
 
 /** update_contribution helper,
@@ -114,7 +119,7 @@ static inline void extend_table_simple(uint32_t *tbl, uint32_t **end, int bit) {
 static struct Crypto1State *
 recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
         uint32_t *e_head, uint32_t *e_tail, uint32_t eks, int rem,
-        struct Crypto1State *sl, uint32_t in, bucket_array_t bucket) {
+        struct Crypto1State *sl, uint32_t in, uint32_t *scratch) {
     bucket_info_t bucket_info;
 
     if (rem == -1) {
@@ -142,12 +147,12 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
             return sl;
     }
 
-    bucket_sort_intersect(e_head, e_tail, o_head, o_tail, &bucket_info, bucket);
+    bucket_sort_intersect(e_head, e_tail, o_head, o_tail, &bucket_info, scratch);
 
     for (int i = bucket_info.numbuckets - 1; i >= 0; i--) {
         sl = recover(bucket_info.bucket_info[1][i].head, bucket_info.bucket_info[1][i].tail, oks,
                      bucket_info.bucket_info[0][i].head, bucket_info.bucket_info[0][i].tail, eks,
-                     rem, sl, in, bucket);
+                     rem, sl, in, scratch);
     }
 
     return sl;
@@ -155,6 +160,82 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
 
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
+#define RECOVERY_TABLE_SIZE (sizeof(uint32_t) << 21)
+// tables kept for the next lfsr_recovery32 call. Nested and staticnested run it hundreds of times from
+// several threads, allocating and faulting in the tables every time cost more than the deeper recursion levels
+#define RECOVERY_POOL_SIZE  8
+
+typedef struct {
+    uint32_t *odd;
+    uint32_t *even;
+    uint32_t *scratch;
+} recovery_tables_t;
+
+#if defined __GNUC__
+static recovery_tables_t *recovery_pool[RECOVERY_POOL_SIZE];
+static int recovery_pool_used = 0;
+static char recovery_pool_lock = 0;
+
+static void recovery_pool_acquire(void) {
+    while (__atomic_test_and_set(&recovery_pool_lock, __ATOMIC_ACQUIRE)) {};
+}
+
+static void recovery_pool_release(void) {
+    __atomic_clear(&recovery_pool_lock, __ATOMIC_RELEASE);
+}
+#endif
+
+static void recovery_tables_free(recovery_tables_t *t) {
+    if (t) {
+        free(t->odd);
+        free(t->even);
+        free(t->scratch);
+        free(t);
+    }
+}
+
+static recovery_tables_t *recovery_tables_get(void) {
+    recovery_tables_t *t = NULL;
+#if defined __GNUC__
+    recovery_pool_acquire();
+    if (recovery_pool_used) {
+        t = recovery_pool[--recovery_pool_used];
+    }
+    recovery_pool_release();
+    if (t) {
+        return t;
+    }
+#endif
+
+    t = calloc(1, sizeof(recovery_tables_t));
+    if (!t) {
+        return NULL;
+    }
+    t->odd = malloc(RECOVERY_TABLE_SIZE);
+    t->even = malloc(RECOVERY_TABLE_SIZE);
+    t->scratch = malloc(RECOVERY_TABLE_SIZE);
+    if (!t->odd || !t->even || !t->scratch) {
+        recovery_tables_free(t);
+        return NULL;
+    }
+    return t;
+}
+
+static void recovery_tables_put(recovery_tables_t *t) {
+    if (!t) {
+        return;
+    }
+#if defined __GNUC__
+    recovery_pool_acquire();
+    if (recovery_pool_used < RECOVERY_POOL_SIZE) {
+        recovery_pool[recovery_pool_used++] = t;
+        t = NULL;
+    }
+    recovery_pool_release();
+#endif
+    recovery_tables_free(t);
+}
+
 /** lfsr_recovery
  * recover the state of the lfsr given 32 bits of the keystream
  * additionally you can use the in parameter to specify the value
@@ -166,35 +247,28 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     uint32_t *even_head = 0, *even_tail = 0, eks = 0;
     register int i;
 
+    lut_init();
+
     // split the keystream into an odd and even part
     for (i = 31; i >= 0; i -= 2)
         oks = oks << 1 | BEBIT(ks2, i);
     for (i = 30; i >= 0; i -= 2)
         eks = eks << 1 | BEBIT(ks2, i);
 
-    odd_head = odd_tail = calloc(1, sizeof(uint32_t) << 21);
-    even_head = even_tail = calloc(1, sizeof(uint32_t) << 21);
+    recovery_tables_t *tables = recovery_tables_get();
     statelist =  calloc(1, sizeof(struct Crypto1State) << 18);
-    if (!odd_tail-- || !even_tail-- || !statelist) {
+    if (!tables || !statelist) {
         free(statelist);
         statelist = 0;
         goto out;
     }
+    odd_head = odd_tail = tables->odd;
+    even_head = even_tail = tables->even;
+    odd_tail--;
+    even_tail--;
 
     statelist->odd = statelist->even = 0;
 
-    // allocate memory for out of place bucket_sort
-    bucket_array_t bucket;
-
-    for (i = 0; i < 2; i++) {
-        for (uint32_t j = 0; j <= 0xff; j++) {
-            bucket[i][j].head = calloc(1, sizeof(uint32_t) << 14);
-            if (!bucket[i][j].head) {
-                goto out;
-            }
-        }
-    }
-
     // initialize statelists: add all possible states which would result into the rightmost 2 bits of the keystream
     uint8_t oks_b1 = oks & 1;
     uint8_t eks_b1 = eks & 1;
@@ -217,14 +291,10 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     // 22 bits to go to recover 32 bits in total. From now on, we need to take the "in"
     // parameter into account.
     in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00); // Byte swapping
-    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, bucket);
+    recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, tables->scratch);
 
 out:
-    for (i = 0; i < 2; i++)
-        for (uint32_t j = 0; j <= 0xff; j++)
-            free(bucket[i][j].head);
-    free(odd_head);
-    free(even_head);
+    recovery_tables_put(tables);
     return statelist;
 }
 
@@ -262,6 +332,8 @@ struct Crypto1State *lfsr_recovery64(uint32_t ks2, uint32_t ks3) {
     uint32_t *tail, table[1 << 16];
     int i, j;
 
+    lut_init();
+
     sl = statelist = calloc(1, sizeof(struct Crypto1State) << 4);
     if (!sl)
         return 0;
@@ -331,6 +403,8 @@ uint8_t lfsr_rollback_bit(struct Crypto1State *s, uint32_t in, int fb) {
     uint8_t ret;
     uint32_t t;
 
+    lut_init();
+
     s->odd &= 0xffffff;
     t = s->odd, s->odd = s->even, s->even = t;
 
@@ -454,6 +528,8 @@ uint32_t *lfsr_prefix_ks(const uint8_t ks[8], int isodd) {
     uint32_t *candidates = calloc(4 << 10, sizeof(uint8_t));
     if (!candidates) return 0;
 
+    lut_init();
+
     int size = 0;
 
     for (int i = 0; i < 1 << 21; ++i) {
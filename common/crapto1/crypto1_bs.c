@@ -0,0 +1,159 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1
+//
+// The odd/even register pair of crypto1.c is kept as one bit sequence:
+// lfsr[pos + 47] is the newest bit, odd bit k sits at lfsr[pos + 47 - 2k]
+// and even bit k at lfsr[pos + 46 - 2k].  Clocking appends the feedback
+// bit, which saves all the shifting and swapping.
+//-----------------------------------------------------------------------------
+#include "crypto1_bs.h"
+
+#include <string.h>
+#include "crapto1.h"
+
+// filter function (f20), same decomposition as the hardnested brute forcer
+// sourced from ``Wirelessly Pickpocketing a Mifare Classic Card'' by Flavio Garcia, Peter van Rossum, Roel Verdult and Ronny Wichers Schreur
+#define f20a(a,b,c,d) (((a|b)^(a&d))^(c&((a^b)|d)))
+#define f20b(a,b,c,d) (((a&b)|c)^((a^b)&(c|d)))
+#define f20c(a,b,c,d,e) ((a|((b|e)&(d^e)))^((a^(b&d))&((c^d)|(b&e))))
+
+#define ODD(x, k)  ((x)[47 - (2 * (k))])
+#define EVEN(x, k) ((x)[46 - (2 * (k))])
+
+static const crypto1_bs_t bs_zero = {0};
+
+static inline crypto1_bs_t bs_const(uint32_t bit) {
+    return bit ? ~bs_zero : bs_zero;
+}
+
+static inline crypto1_bs_t bs_filter(const crypto1_bs_t *x) {
+    return f20c(
+               f20a(ODD(x, 19), ODD(x, 18), ODD(x, 17), ODD(x, 16)),
+               f20b(ODD(x, 15), ODD(x, 14), ODD(x, 13), ODD(x, 12)),
+               f20b(ODD(x, 11), ODD(x, 10), ODD(x, 9), ODD(x, 8)),
+               f20a(ODD(x, 7), ODD(x, 6), ODD(x, 5), ODD(x, 4)),
+               f20b(ODD(x, 3), ODD(x, 2), ODD(x, 1), ODD(x, 0))
+           );
+}
+
+/**
+ * @brief Load up to CRYPTO1_BS_SLICES keys, slice n gets keys[n], unused slices run with key 0
+ */
+void crypto1_bs_init(crypto1_bs_state_t *s, const uint64_t *keys, size_t count) {
+    if (count > CRYPTO1_BS_SLICES) {
+        count = CRYPTO1_BS_SLICES;
+    }
+
+    memset(s, 0, sizeof(crypto1_bs_state_t));
+
+    // same bit order as crypto1_init
+    for (size_t j = 0; j < 48; j++) {
+        crypto1_bs_t v = bs_zero;
+        for (size_t n = 0; n < count; n++) {
+            v[n >> 6] |= BIT(keys[n], j ^ 7) << (n & 0x3f);
+        }
+        s->lfsr[47 - j] = v;
+    }
+}
+
+/**
+ * @brief Clock all slices once, like crypto1_bit
+ *
+ * @param in input bit per slice
+ * @return filter output per slice
+ */
+crypto1_bs_t crypto1_bs_bit(crypto1_bs_state_t *s, crypto1_bs_t in, int is_encrypted) {
+
+    if (s->pos == CRYPTO1_BS_STEPS) {
+        memmove(s->lfsr, s->lfsr + CRYPTO1_BS_STEPS, 48 * sizeof(crypto1_bs_t));
+        s->pos = 0;
+    }
+
+    const crypto1_bs_t *x = s->lfsr + s->pos;
+    crypto1_bs_t ret = bs_filter(x);
+
+    // LF_POLY_ODD 0x29CE5C, LF_POLY_EVEN 0x870804
+    crypto1_bs_t feedin = in;
+    feedin ^= ODD(x, 2) ^ ODD(x, 3) ^ ODD(x, 4) ^ ODD(x, 6) ^ ODD(x, 9) ^ ODD(x, 10);
+    feedin ^= ODD(x, 11) ^ ODD(x, 14) ^ ODD(x, 15) ^ ODD(x, 16) ^ ODD(x, 19) ^ ODD(x, 21);
+    feedin ^= EVEN(x, 2) ^ EVEN(x, 11) ^ EVEN(x, 16) ^ EVEN(x, 17) ^ EVEN(x, 18) ^ EVEN(x, 23);
+    if (is_encrypted) {
+        feedin ^= ret;
+    }
+
+    s->lfsr[s->pos + 48] = feedin;
+    s->pos++;
+    return ret;
+}
+
+/**
+ * @brief Clock eight times with the same byte for all slices, like crypto1_byte
+ *
+ * @param ks keystream out, ks[n] holds bit n of the crypto1_byte result, can be NULL
+ */
+void crypto1_bs_byte(crypto1_bs_state_t *s, uint8_t in, int is_encrypted, crypto1_bs_t *ks) {
+    for (uint8_t i = 0; i < 8; i++) {
+        crypto1_bs_t r = crypto1_bs_bit(s, bs_const(BIT(in, i)), is_encrypted);
+        if (ks) {
+            ks[i] = r;
+        }
+    }
+}
+
+/**
+ * @brief Clock 32 times with the same word for all slices, like crypto1_word
+ *
+ * @param ks keystream out, ks[n] holds bit n of the crypto1_word result, can be NULL
+ */
+void crypto1_bs_word(crypto1_bs_state_t *s, uint32_t in, int is_encrypted, crypto1_bs_t *ks) {
+    for (uint8_t i = 0; i < 32; i++) {
+        crypto1_bs_t r = crypto1_bs_bit(s, bs_const(BEBIT(in, i)), is_encrypted);
+        if (ks) {
+            ks[i ^ 24] = r;
+        }
+    }
+}
+
+/**
+ * @brief Mask of the slices whose bits[0..nbits-1] equal the bits of value
+ */
+crypto1_bs_t crypto1_bs_equal(const crypto1_bs_t *bits, uint32_t value, uint8_t nbits) {
+    crypto1_bs_t m = ~bs_zero;
+    for (uint8_t n = 0; n < nbits; n++) {
+        m &= BIT(value, n) ? bits[n] : ~bits[n];
+    }
+    return m;
+}
+
+/**
+ * @brief Gather bits[0..nbits-1] of a single slice back into an integer
+ */
+uint32_t crypto1_bs_slice(const crypto1_bs_t *bits, uint8_t nbits, size_t slice) {
+    uint32_t r = 0;
+    for (uint8_t n = 0; n < nbits; n++) {
+        r |= (uint32_t)BIT(bits[n][slice >> 6], slice & 0x3f) << n;
+    }
+    return r;
+}
+
+bool crypto1_bs_any(crypto1_bs_t v) {
+    uint64_t r = 0;
+    for (size_t i = 0; i < CRYPTO1_BS_SLICES / 64; i++) {
+        r |= v[i];
+    }
+    return r != 0;
+}
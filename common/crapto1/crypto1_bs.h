@@ -0,0 +1,60 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Crypto1, runs CRYPTO1_BS_SLICES keys side by side.
+//
+// Every LFSR bit is a vector with one bit per key, so a single pass of the
+// cipher clocks all keys at once.  Inputs are shared by all keys, keystream
+// comes back bitsliced and the _equal / _slice helpers turn it into a match
+// mask or pull a single key out again.
+//-----------------------------------------------------------------------------
+#ifndef CRYPTO1_BS_INCLUDED
+#define CRYPTO1_BS_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// widest integer vector the build targets, the crypto1_bs_t type is plain
+// GCC vector extension so anything else still works, just narrower
+#if defined(__AVX512F__)
+#define CRYPTO1_BS_SLICES 512
+#elif defined(__AVX2__)
+#define CRYPTO1_BS_SLICES 256
+#elif defined(__SSE2__) || (defined(__ARM_NEON) && !defined(NOSIMD_BUILD))
+#define CRYPTO1_BS_SLICES 128
+#else
+#define CRYPTO1_BS_SLICES 64
+#endif
+
+typedef uint64_t __attribute__((vector_size(CRYPTO1_BS_SLICES / 8))) crypto1_bs_t;
+
+// LFSR history, clocked bits are appended and the window slides back once full
+#define CRYPTO1_BS_STEPS 64
+
+typedef struct {
+    crypto1_bs_t lfsr[48 + CRYPTO1_BS_STEPS];
+    size_t pos;
+} crypto1_bs_state_t;
+
+void crypto1_bs_init(crypto1_bs_state_t *s, const uint64_t *keys, size_t count);
+crypto1_bs_t crypto1_bs_bit(crypto1_bs_state_t *s, crypto1_bs_t in, int is_encrypted);
+void crypto1_bs_byte(crypto1_bs_state_t *s, uint8_t in, int is_encrypted, crypto1_bs_t *ks);
+void crypto1_bs_word(crypto1_bs_state_t *s, uint32_t in, int is_encrypted, crypto1_bs_t *ks);
+crypto1_bs_t crypto1_bs_equal(const crypto1_bs_t *bits, uint32_t value, uint8_t nbits);
+uint32_t crypto1_bs_slice(const crypto1_bs_t *bits, uint8_t nbits, size_t slice);
+bool crypto1_bs_any(crypto1_bs_t v);
+
+#endif
@@ -121,6 +121,100 @@ uint16_t crc16_fast(uint8_t const *d, size_t n, uint16_t initval, bool refin, bo
     return crc;
 }
 
+#ifndef ON_DEVICE
+// CRC16 with poly 0x1021,  eight bytes per step (slicing-by-8).  Nearly every CRC16 here uses
+// that poly,  these tables never change and don't depend on init_table().
+static uint16_t crc_slice_refl[8][256];
+static uint16_t crc_slice_norm[8][256];
+static bool crc_slice_init = false;
+
+static void generate_slice_tables(void) {
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t r = i;
+        uint16_t c = i << 8;
+        for (uint8_t j = 0; j < 8; j++) {
+            r = (r & 1) ? (r >> 1) ^ CRC16_POLY_KERMIT : (r >> 1);
+            c = (c & 0x8000) ? (c << 1) ^ CRC16_POLY_CCITT : (c << 1);
+        }
+        crc_slice_refl[0][i] = r;
+        crc_slice_norm[0][i] = c;
+    }
+    // [k][b] is byte b followed by k zero bytes
+    for (uint8_t k = 1; k < 8; k++) {
+        for (uint16_t i = 0; i < 256; i++) {
+            uint16_t r = crc_slice_refl[k - 1][i];
+            uint16_t c = crc_slice_norm[k - 1][i];
+            crc_slice_refl[k][i] = (r >> 8) ^ crc_slice_refl[0][r & 0xFF];
+            crc_slice_norm[k][i] = (c << 8) ^ crc_slice_norm[0][c >> 8];
+        }
+    }
+    crc_slice_init = true;
+}
+
+static uint16_t crc16_slice_refl(uint8_t const *d, size_t n, uint16_t crc) {
+    const uint16_t (*t)[256] = crc_slice_refl;
+    for (; n >= 8; n -= 8, d += 8) {
+        crc ^= d[0] | (d[1] << 8);
+        crc = t[7][crc & 0xFF] ^ t[6][crc >> 8] ^ t[5][d[2]] ^ t[4][d[3]] ^
+              t[3][d[4]] ^ t[2][d[5]] ^ t[1][d[6]] ^ t[0][d[7]];
+    }
+    if (n >= 4) {
+        crc ^= d[0] | (d[1] << 8);
+        crc = t[3][crc & 0xFF] ^ t[2][crc >> 8] ^ t[1][d[2]] ^ t[0][d[3]];
+        n -= 4;
+        d += 4;
+    }
+    while (n--) {
+        crc = (crc >> 8) ^ t[0][(crc & 0xFF) ^ *d++];
+    }
+    return crc;
+}
+
+static uint16_t crc16_slice_norm(uint8_t const *d, size_t n, uint16_t crc) {
+    const uint16_t (*t)[256] = crc_slice_norm;
+    for (; n >= 8; n -= 8, d += 8) {
+        crc ^= (d[0] << 8) | d[1];
+        crc = t[7][crc >> 8] ^ t[6][crc & 0xFF] ^ t[5][d[2]] ^ t[4][d[3]] ^
+              t[3][d[4]] ^ t[2][d[5]] ^ t[1][d[6]] ^ t[0][d[7]];
+    }
+    if (n >= 4) {
+        crc ^= (d[0] << 8) | d[1];
+        crc = t[3][crc >> 8] ^ t[2][crc & 0xFF] ^ t[1][d[2]] ^ t[0][d[3]];
+        n -= 4;
+        d += 4;
+    }
+    while (n--) {
+        crc = (crc << 8) ^ t[0][((crc >> 8) ^ *d++) & 0xFF];
+    }
+    return crc;
+}
+#endif
+
+// crc16_fast() with poly 0x1021.  The firmware keeps the single table,  callers set it up
+// with init_table() as before
+static uint16_t crc16_fast_ccitt(uint8_t const *d, size_t n, uint16_t initval, bool refin, bool refout) {
+#ifdef ON_DEVICE
+    return crc16_fast(d, n, initval, refin, refout);
+#else
+    if (n == 0)
+        return (~initval);
+
+    if (crc_slice_init == false)
+        generate_slice_tables();
+
+    uint16_t crc;
+    if (refin)
+        crc = crc16_slice_refl(d, n, reflect16(initval));
+    else
+        crc = crc16_slice_norm(d, n, initval);
+
+    if (refout ^ refin)
+        crc = reflect16(crc);
+
+    return crc;
+#endif
+}
+
 // bit looped solution  TODO REMOVED
 uint16_t update_crc16_ex(uint16_t crc, uint8_t c, uint16_t polynomial) {
     uint16_t tmp = 0;
@@ -301,24 +395,24 @@ bool check_crc(CrcType_t ct, const uint8_t *d, size_t n) {
 
 // poly=0x1021  init=0xffff  refin=false  refout=false  xorout=0x0000  check=0x29b1  residue=0x0000  name="CRC-16/CCITT-FALSE"
 uint16_t crc16_ccitt(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0xffff, false, false);
+    return crc16_fast_ccitt(d, n, 0xffff, false, false);
 }
 
 // FDX-B ISO11784/85) uses KERMIT/CCITT
 // poly 0x xx  init=0x000  refin=false  refout=true  xorout=0x0000 ...
 uint16_t crc16_fdxb(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0x0000, false, true);
+    return crc16_fast_ccitt(d, n, 0x0000, false, true);
 }
 
 // poly=0x1021  init=0x0000  refin=true  refout=true  xorout=0x0000 name="KERMIT"
 uint16_t crc16_kermit(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0x0000, true, true);
+    return crc16_fast_ccitt(d, n, 0x0000, true, true);
 }
 
 // FeliCa uses XMODEM
 // poly=0x1021  init=0x0000  refin=false  refout=false  xorout=0x0000 name="XMODEM"
 uint16_t crc16_xmodem(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0x0000, false, false);
+    return crc16_fast_ccitt(d, n, 0x0000, false, false);
 }
 
 // Following standards uses X-25
@@ -327,14 +421,14 @@ uint16_t crc16_xmodem(uint8_t const *d, size_t n) {
 //   ISO/IEC 13239 (formerly ISO/IEC 3309)
 // poly=0x1021  init=0xffff  refin=true  refout=true  xorout=0xffff name="X-25"
 uint16_t crc16_x25(uint8_t const *d, size_t n) {
-    uint16_t crc = crc16_fast(d, n, 0xffff, true, true);
+    uint16_t crc = crc16_fast_ccitt(d, n, 0xffff, true, true);
     crc = ~crc;
     return crc;
 }
 // CRC-A (14443-3)
 // poly=0x1021 init=0xc6c6 refin=true refout=true xorout=0x0000 name="CRC-A"
 uint16_t crc16_a(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0xC6C6, true, true);
+    return crc16_fast_ccitt(d, n, 0xC6C6, true, true);
 }
 
 // iClass crc
@@ -342,7 +436,7 @@ uint16_t crc16_a(uint8_t const *d, size_t n) {
 // poly       0x1021 reflected 0x8408
 // poly=0x1021  init=0x4807  refin=true  refout=true  xorout=0x0BC3  check=0xF0B8  name="CRC-16/ICLASS"
 uint16_t crc16_iclass(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0x4807, true, true);
+    return crc16_fast_ccitt(d, n, 0x4807, true, true);
 }
 
 // This CRC-16 is used in Legic Advant systems.
@@ -353,5 +447,5 @@ uint16_t crc16_legic(uint8_t const *d, size_t n, uint8_t uidcrc) {
 }
 
 uint16_t crc16_philips(uint8_t const *d, size_t n) {
-    return crc16_fast(d, n, 0x49A3, false, false);
+    return crc16_fast_ccitt(d, n, 0x49A3, false, false);
 }
@@ -18,26 +18,65 @@
 #define htole32(x) (x)
 #define CRC32_PRESET 0xFFFFFFFF
 
-static void crc32_byte(uint32_t *crc, const uint8_t value);
-
-static void crc32_byte(uint32_t *crc, const uint8_t value) {
-    /* x32 + x26 + x23 + x22 + x16 + x12 + x11 + x10 + x8 + x7 + x5 + x4 + x2 + x + 1 */
-    const uint32_t poly = 0xEDB88320;
-
-    *crc ^= value;
-    for (int current_bit = 7; current_bit >= 0; current_bit--) {
-        int bit_out = (*crc) & 0x00000001;
-        *crc >>= 1;
-        if (bit_out)
-            *crc ^= poly;
+// poly 0xEDB88320,  x32 + x26 + x23 + x22 + x16 + x12 + x11 + x10 + x8 + x7 + x5 + x4 + x2 + x + 1
+#define CRC32_POLY 0xEDB88320
+
+#ifdef ON_DEVICE
+// a nibble at a time,  the table costs 64 bytes of flash
+static const uint32_t crc32_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *d, size_t n) {
+    while (n--) {
+        crc ^= *d++;
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_nibble[crc & 0x0F];
     }
+    return crc;
 }
+#else
+// eight bytes per step (slicing-by-8),  [k][b] is byte b followed by k zero bytes
+static uint32_t crc32_slice[8][256];
+static bool crc32_slice_init = false;
 
-void crc32_ex(const uint8_t *d, const size_t n, uint8_t *crc) {
-    uint32_t c = CRC32_PRESET;
-    for (size_t i = 0; i < n; i++) {
-        crc32_byte(&c, d[i]);
+static void crc32_generate_slice_tables(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (uint8_t j = 0; j < 8; j++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32_POLY : (c >> 1);
+        }
+        crc32_slice[0][i] = c;
+    }
+    for (uint8_t k = 1; k < 8; k++) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = crc32_slice[k - 1][i];
+            crc32_slice[k][i] = (c >> 8) ^ crc32_slice[0][c & 0xFF];
+        }
+    }
+    crc32_slice_init = true;
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *d, size_t n) {
+    if (crc32_slice_init == false)
+        crc32_generate_slice_tables();
+
+    const uint32_t (*t)[256] = crc32_slice;
+    for (; n >= 8; n -= 8, d += 8) {
+        crc ^= d[0] | (d[1] << 8) | (d[2] << 16) | ((uint32_t)d[3] << 24);
+        crc = t[7][crc & 0xFF] ^ t[6][(crc >> 8) & 0xFF] ^ t[5][(crc >> 16) & 0xFF] ^ t[4][crc >> 24] ^
+              t[3][d[4]] ^ t[2][d[5]] ^ t[1][d[6]] ^ t[0][d[7]];
+    }
+    while (n--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *d++) & 0xFF];
     }
+    return crc;
+}
+#endif
+
+void crc32_ex(const uint8_t *d, const size_t n, uint8_t *crc) {
+    uint32_t c = crc32_update(CRC32_PRESET, d, n);
     crc[0] = (uint8_t) c;
     crc[1] = (uint8_t)(c >> 8);
     crc[2] = (uint8_t)(c >> 16);
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// SecureMemory left and right register steps on several states at once
+//
+// Host only.  Same layout and arithmetic as next_left() / next_right() in
+// cryptolib.c with a zero input byte, one state per lane.  The modular
+// addition is done without tables so it maps to plain vector instructions.
+//-----------------------------------------------------------------------------
+
+#ifndef _CRYPTOLIB_VEC_H_
+#define _CRYPTOLIB_VEC_H_
+
+#include <stdint.h>
+
+#if defined(__AVX512F__)
+#define CRYPTORF_VEC_LANES 8
+#elif defined(__AVX2__)
+#define CRYPTORF_VEC_LANES 4
+#else
+#define CRYPTORF_VEC_LANES 2
+#endif
+
+typedef uint64_t __attribute__((vector_size(CRYPTORF_VEC_LANES * 8))) crypto_vec_t;
+
+// funny_mod(a, 0x1f) for a in 0..62, 0x1f stays 0x1f
+static inline crypto_vec_t crypto_vec_mod31(crypto_vec_t a) {
+    return a - ((crypto_vec_t)(a > 0x1f) & 0x1f);
+}
+
+// next_left(0, s), returns the b1l output of every lane
+static inline crypto_vec_t crypto_vec_next_left(crypto_vec_t *l) {
+    crypto_vec_t b3 = (*l >> 15) & 0x1f;
+    crypto_vec_t b6 = *l & 0x1f;
+    crypto_vec_t bx = crypto_vec_mod31(b3 + (((b6 << 1) | (b6 >> 4)) & 0x1f));
+
+    *l = (*l >> 5) | (bx << 30);
+    return (bx ^ b3) & 0x0f;
+}
+
+// next_right(0, s), returns the b1r output of every lane
+static inline crypto_vec_t crypto_vec_next_right(crypto_vec_t *r) {
+    crypto_vec_t b16 = (*r >> 10) & 0x1f;
+    crypto_vec_t b18 = *r & 0x1f;
+    crypto_vec_t bx = crypto_vec_mod31(b18 + b16);
+
+    *r = (*r >> 5) | (bx << 20);
+    return (bx ^ b16) & 0x0f;
+}
+
+#endif // _CRYPTOLIB_VEC_H_
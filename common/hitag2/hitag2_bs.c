@@ -0,0 +1,271 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Hitag2
+//
+// The 48 bit shift register is kept as one bit sequence: the state at any
+// time is s[pos .. pos + 47] and clocking appends the new bit 47, which
+// saves all the shifting.
+//-----------------------------------------------------------------------------
+#include "hitag2_bs.h"
+
+#include <string.h>
+
+#define HT2BS_BIT(x, n) (((x) >> (n)) & 1)
+
+static const hitag2_bs_t bs_zero = {0};
+
+static inline hitag2_bs_t bs_const(uint64_t bit) {
+    return bit ? ~bs_zero : bs_zero;
+}
+
+// same taps as hitag2_crypt(), on the state after the shift
+static inline hitag2_bs_t bs_filter(const hitag2_bs_t *x) {
+    return HITAG2_BS_FC(
+               HITAG2_BS_FA(x[1], x[2], x[4], x[5]),
+               HITAG2_BS_FB(x[7], x[11], x[13], x[14]),
+               HITAG2_BS_FB(x[16], x[20], x[22], x[25]),
+               HITAG2_BS_FB(x[27], x[28], x[30], x[32]),
+               HITAG2_BS_FA(x[33], x[42], x[43], x[45])
+           );
+}
+
+static inline hitag2_bs_t *bs_next(hitag2_bs_state_t *s) {
+    if (s->pos == HITAG2_BS_STEPS) {
+        memmove(s->s, s->s + HITAG2_BS_STEPS, 48 * sizeof(hitag2_bs_t));
+        s->pos = 0;
+    }
+    return s->s + s->pos;
+}
+
+/**
+ * @brief Bitslice up to HITAG2_BS_SLICES values, bits[n] gets bit n of every value, unused slices are 0
+ */
+void hitag2_bs_transpose(hitag2_bs_t *bits, const uint64_t *values, size_t count, uint8_t nbits) {
+    if (count > HITAG2_BS_SLICES) {
+        count = HITAG2_BS_SLICES;
+    }
+    if (nbits > 64) {
+        nbits = 64;
+    }
+
+    // gather in plain words, element-wise vector updates are slow with wide vectors
+    uint64_t w[64][HITAG2_BS_SLICES / 64] = {{0}};
+    for (size_t i = 0; i < count; i++) {
+        uint64_t v = values[i];
+        for (uint8_t n = 0; n < nbits; n++) {
+            w[n][i >> 6] |= HT2BS_BIT(v, n) << (i & 0x3f);
+        }
+    }
+
+    for (uint8_t n = 0; n < nbits; n++) {
+        memcpy(&bits[n], w[n], sizeof(hitag2_bs_t));
+    }
+}
+
+/**
+ * @brief Same value in every slice
+ */
+void hitag2_bs_broadcast(hitag2_bs_t *bits, uint64_t value, uint8_t nbits) {
+    for (uint8_t n = 0; n < nbits; n++) {
+        bits[n] = bs_const(HT2BS_BIT(value, n));
+    }
+}
+
+/**
+ * @brief Bitslice the values base + slice, base must be a multiple of HITAG2_BS_SLICES
+ */
+void hitag2_bs_counter(hitag2_bs_t *bits, uint64_t base, uint8_t nbits) {
+    static const uint64_t pattern[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+
+    for (uint8_t n = 0; n < nbits; n++) {
+        if ((1ULL << n) >= HITAG2_BS_SLICES) {
+            bits[n] = bs_const(HT2BS_BIT(base, n));
+            continue;
+        }
+
+        hitag2_bs_t v;
+        for (size_t e = 0; e < HITAG2_BS_SLICES / 64; e++) {
+            v[e] = (n < 6) ? pattern[n] : (HT2BS_BIT(e, n - 6) ? ~0ULL : 0);
+        }
+        bits[n] = v;
+    }
+}
+
+/**
+ * @brief Mask of the first count slices, for partly filled batches
+ */
+hitag2_bs_t hitag2_bs_valid(size_t count) {
+    hitag2_bs_t v = bs_zero;
+    for (size_t e = 0; e < HITAG2_BS_SLICES / 64; e++) {
+        if (count >= (e + 1) * 64) {
+            v[e] = ~0ULL;
+        } else if (count > e * 64) {
+            v[e] = (1ULL << (count - e * 64)) - 1;
+        }
+    }
+    return v;
+}
+
+/**
+ * @brief Start every slice from a 48 bit shift register value, state[n] holds bit n
+ */
+void hitag2_bs_load(hitag2_bs_state_t *s, const hitag2_bs_t *state) {
+    memcpy(s->s, state, 48 * sizeof(hitag2_bs_t));
+    s->pos = 0;
+}
+
+/**
+ * @brief Initialise every slice like ht2_hitag2_init_ex, key[n] holds bit n of the keys
+ */
+void hitag2_bs_init(hitag2_bs_state_t *s, const hitag2_bs_t *key, uint32_t uid, uint32_t iv) {
+    hitag2_bs_t *x = s->s;
+
+    for (uint8_t i = 0; i < 32; i++) {
+        x[i] = bs_const(HT2BS_BIT(uid, i));
+    }
+
+    for (uint8_t i = 0; i < 16; i++) {
+        x[32 + i] = key[i];
+    }
+
+    // every new bit is (iv ^ upper key) xor the filter output of the state before it
+    for (uint8_t i = 0; i < 32; i++) {
+        x[48 + i] = bs_const(HT2BS_BIT(iv, i)) ^ key[16 + i] ^ bs_filter(x + 1 + i);
+    }
+
+    s->pos = 32;
+}
+
+/**
+ * @brief Clock all slices once with the LFSR feedback, returns the next keystream bit
+ */
+hitag2_bs_t hitag2_bs_bit(hitag2_bs_state_t *s) {
+    hitag2_bs_t *x = bs_next(s);
+
+    x[48] = x[0] ^ x[2] ^ x[3] ^ x[6] ^ x[7] ^ x[8] ^ x[16] ^ x[22]
+            ^ x[23] ^ x[26] ^ x[30] ^ x[41] ^ x[42] ^ x[43] ^ x[46] ^ x[47];
+    s->pos++;
+    return bs_filter(x + 1);
+}
+
+/**
+ * @brief Clock all slices once, shifting in the given bit instead of the feedback
+ */
+hitag2_bs_t hitag2_bs_bit_in(hitag2_bs_state_t *s, hitag2_bs_t in) {
+    hitag2_bs_t *x = bs_next(s);
+
+    x[48] = in;
+    s->pos++;
+    return bs_filter(x + 1);
+}
+
+/**
+ * @brief Clock steps times, like ht2_hitag2_nstep
+ *
+ * @param ks keystream out, ks[n] holds bit n of the ht2_hitag2_nstep result, can be NULL
+ */
+void hitag2_bs_nstep(hitag2_bs_state_t *s, uint8_t steps, hitag2_bs_t *ks) {
+    for (uint8_t i = 0; i < steps; i++) {
+        hitag2_bs_t r = hitag2_bs_bit(s);
+        if (ks) {
+            ks[steps - 1 - i] = r;
+        }
+    }
+}
+
+/**
+ * @brief Mask of the slices whose bits[0..nbits-1] equal the bits of value
+ */
+hitag2_bs_t hitag2_bs_equal(const hitag2_bs_t *bits, uint64_t value, uint8_t nbits) {
+    hitag2_bs_t m = ~bs_zero;
+    for (uint8_t n = 0; n < nbits; n++) {
+        m &= HT2BS_BIT(value, n) ? bits[n] : ~bits[n];
+    }
+    return m;
+}
+
+/**
+ * @brief Gather bits[0..nbits-1] of a single slice back into an integer
+ */
+uint64_t hitag2_bs_slice(const hitag2_bs_t *bits, uint8_t nbits, size_t slice) {
+    uint64_t r = 0;
+    for (uint8_t n = 0; n < nbits; n++) {
+        r |= HT2BS_BIT(bits[n][slice >> 6], slice & 0x3f) << n;
+    }
+    return r;
+}
+
+bool hitag2_bs_any(hitag2_bs_t v) {
+    uint64_t r = 0;
+    for (size_t i = 0; i < HITAG2_BS_SLICES / 64; i++) {
+        r |= v[i];
+    }
+    return r != 0;
+}
+
+/**
+ * @brief Index of the lowest set slice, -1 if none
+ */
+int hitag2_bs_first(hitag2_bs_t v) {
+    for (size_t i = 0; i < HITAG2_BS_SLICES / 64; i++) {
+        if (v[i]) {
+            return (int)(i * 64) + __builtin_ctzll(v[i]);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Test keys against one authentication, like (ar ^ ht2_hitag2_nstep(32)) == 0xFFFFFFFF
+ *
+ * @return index of the first matching key, -1 if none
+ */
+int hitag2_bs_check_keys(const uint64_t *keys, size_t count, uint32_t uid, uint32_t iv, uint32_t ar) {
+    hitag2_bs_state_t s;
+    hitag2_bs_t key[48];
+
+    for (size_t off = 0; off < count; off += HITAG2_BS_SLICES) {
+        size_t n = count - off;
+        if (n > HITAG2_BS_SLICES) {
+            n = HITAG2_BS_SLICES;
+        }
+
+        hitag2_bs_transpose(key, keys + off, n, 48);
+        hitag2_bs_init(&s, key, uid, iv);
+
+        // keystream must be ~ar, most significant bit comes first
+        hitag2_bs_t m = hitag2_bs_valid(n);
+        for (uint8_t i = 0; i < 32; i++) {
+            hitag2_bs_t r = hitag2_bs_bit(&s);
+            m &= HT2BS_BIT(ar, 31 - i) ? ~r : r;
+
+            // nearly all wrong keys are gone after a byte
+            if ((i & 7) == 7 && hitag2_bs_any(m) == false) {
+                break;
+            }
+        }
+
+        int first = hitag2_bs_first(m);
+        if (first >= 0) {
+            return (int)off + first;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,83 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Bitsliced Hitag2, runs HITAG2_BS_SLICES ciphers side by side.
+//
+// Host only.  Every register bit is a vector with one bit per cipher, so a
+// single pass clocks all of them at once.  Bit order and keystream order are
+// the ones of ht2_hitag2_init_ex / ht2_hitag2_nstep, which stay the reference.
+//-----------------------------------------------------------------------------
+#ifndef __HITAG2_BS_H
+#define __HITAG2_BS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// widest integer vector the build targets, hitag2_bs_t is plain GCC vector
+// extension so anything else still works, just narrower
+#if defined(__AVX512F__)
+#define HITAG2_BS_SLICES 512
+#define HITAG2_BS_ENGINE "AVX-512"
+#elif defined(__AVX2__)
+#define HITAG2_BS_SLICES 256
+#define HITAG2_BS_ENGINE "AVX2"
+#elif defined(__ARM_NEON) && !defined(NOSIMD_BUILD)
+#define HITAG2_BS_SLICES 128
+#define HITAG2_BS_ENGINE "NEON"
+#elif defined(__SSE2__)
+#define HITAG2_BS_SLICES 128
+#define HITAG2_BS_ENGINE "SSE2"
+#else
+#define HITAG2_BS_SLICES 64
+#define HITAG2_BS_ENGINE "64-bit"
+#endif
+
+typedef uint64_t __attribute__((vector_size(HITAG2_BS_SLICES / 8))) hitag2_bs_t;
+
+// filter function building blocks, fa/fb take the four taps in order
+// (lowest table index bit first) and fc the five fa/fb outputs in order
+#define HITAG2_BS_FA(a,b,c,d)     (~(((a|b)&c)^(a|d)^b))
+#define HITAG2_BS_FB(a,b,c,d)     (~(((d|c)&(a^b))^(d|a|b)))
+#define HITAG2_BS_FC(a,b,c,d,e)   (~((((((c^e)|d)&a)^b)&(c^b))^(((d^e)|a)&((d^b)|c))))
+
+// register history, clocked bits are appended and the window slides back once full
+#define HITAG2_BS_STEPS 64
+
+typedef struct {
+    // state bit i of every cipher is s[pos + i]
+    hitag2_bs_t s[48 + HITAG2_BS_STEPS];
+    size_t pos;
+} hitag2_bs_state_t;
+
+void hitag2_bs_transpose(hitag2_bs_t *bits, const uint64_t *values, size_t count, uint8_t nbits);
+void hitag2_bs_broadcast(hitag2_bs_t *bits, uint64_t value, uint8_t nbits);
+void hitag2_bs_counter(hitag2_bs_t *bits, uint64_t base, uint8_t nbits);
+hitag2_bs_t hitag2_bs_valid(size_t count);
+
+void hitag2_bs_load(hitag2_bs_state_t *s, const hitag2_bs_t *state);
+void hitag2_bs_init(hitag2_bs_state_t *s, const hitag2_bs_t *key, uint32_t uid, uint32_t iv);
+hitag2_bs_t hitag2_bs_bit(hitag2_bs_state_t *s);
+hitag2_bs_t hitag2_bs_bit_in(hitag2_bs_state_t *s, hitag2_bs_t in);
+void hitag2_bs_nstep(hitag2_bs_state_t *s, uint8_t steps, hitag2_bs_t *ks);
+
+hitag2_bs_t hitag2_bs_equal(const hitag2_bs_t *bits, uint64_t value, uint8_t nbits);
+uint64_t hitag2_bs_slice(const hitag2_bs_t *bits, uint8_t nbits, size_t slice);
+bool hitag2_bs_any(hitag2_bs_t v);
+int hitag2_bs_first(hitag2_bs_t v);
+
+int hitag2_bs_check_keys(const uint64_t *keys, size_t count, uint32_t uid, uint32_t iv, uint32_t ar);
+
+#endif
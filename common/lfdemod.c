@@ -69,7 +69,32 @@ uint8_t g_debugMode = 0;
 # define prnt Dbprintf
 #endif
 
+// host builds demodulate from several threads (data decode),  so the signal properties and
+// the detector caches below are kept per thread.
+#ifndef ON_DEVICE
+# define LF_THREAD __thread
+#else
+# define LF_THREAD
+#endif
+
+#ifndef ON_DEVICE
+// a client demod context can hand in its own storage,  see setSignalPropertiesStore
+static LF_THREAD signal_t signal_local = { 255, -255, 0, 0, true };
+static LF_THREAD signal_t *signal_store = NULL;
+
+static inline signal_t *lf_signal(void) {
+    return (signal_store) ? signal_store : &signal_local;
+}
+# define signalprop (*lf_signal())
+
+// NULL goes back to the calling thread's own signal properties
+void setSignalPropertiesStore(signal_t *store) {
+    signal_store = store;
+}
+#else
 static signal_t signalprop = { 255, -255, 0, 0, true };
+#endif
+
 signal_t *getSignalProperties(void) {
     return &signalprop;
 }
@@ -93,11 +118,303 @@ static void printSignal(void) {
 }
 
 #ifndef ON_DEVICE
-static int cmp_uint8(const void *a, const void *b) {
-    if (*(const uint8_t *)a < * (const uint8_t *)b)
-        return -1;
+// the percentile bands below used to sort a copy of the samples,  a
+// histogram gives the same order statistics in one pass and without the
+// sample sized stack copy
+static void sample_histogram(const uint8_t *samples, uint32_t size, uint32_t *hist) {
+    memset(hist, 0, 256 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < size; i++) {
+        hist[samples[i]]++;
+    }
+}
+
+// value at index k of the sorted samples
+static uint8_t histogram_nth(const uint32_t *hist, uint32_t k) {
+    uint32_t cum = 0;
+    for (int v = 0; v < 256; v++) {
+        cum += hist[v];
+        if (cum > k) {
+            return v;
+        }
+    }
+    return 255;
+}
+
+// DC offset removeSignalOffset takes out,  from the histogram of the samples
+// after the first SIGNAL_IGNORE_FIRST_SAMPLES
+int signalOffsetFromHistogram(const uint32_t *hist, uint32_t offset_size) {
+    uint8_t low10 = 0.5 * (histogram_nth(hist, (int)(offset_size * 0.05)) + histogram_nth(hist, (int)((offset_size - 1) * 0.05)));
+    uint8_t hi90 =  0.5 * (histogram_nth(hist, (int)(offset_size * 0.95)) + histogram_nth(hist, (int)((offset_size - 1) * 0.95)));
+
+    int acc_off = 0;
+    int32_t cnt = 0;
+    for (int v = low10; v <= hi90; v++) {
+        acc_off += (int)hist[v] * (v - 128);
+        cnt += hist[v];
+    }
+    if (cnt > 0)
+        acc_off /= cnt;
     else
-        return *(const uint8_t *)a > *(const uint8_t *)b;
+        acc_off = 0;
+    return acc_off;
+}
+#endif
+
+#ifndef ON_DEVICE
+// lf search hands the same samples to every demodulator and each of them repeats clock
+// and field clock detection.  The detectors keep their last input and result, and replay
+// it while samples, arguments and signal properties are unchanged.
+typedef struct {
+    uint8_t *samples;
+    uint8_t *out;
+    size_t size;
+    size_t cap;
+    signal_t prop;
+    int args[3];
+    int res[4];
+    bool valid;
+} lfmemo_t;
+
+static LF_THREAD lfmemo_t memo_countfc, memo_askclk, memo_nrzclk, memo_pskclk, memo_fskclk, memo_fskwave;
+
+// DetectASKClock peak miss maps,  one per tolerance
+static LF_THREAD uint8_t *miss_buf[2];
+static LF_THREAD size_t miss_cap[2];
+
+static void lfmemo_free(lfmemo_t *m) {
+    free(m->samples);
+    free(m->out);
+    memset(m, 0, sizeof(lfmemo_t));
+}
+
+// release the calling thread's detector caches,  worker threads call this before they exit
+void lfdemod_thread_free(void) {
+    lfmemo_free(&memo_countfc);
+    lfmemo_free(&memo_askclk);
+    lfmemo_free(&memo_nrzclk);
+    lfmemo_free(&memo_pskclk);
+    lfmemo_free(&memo_fskclk);
+    lfmemo_free(&memo_fskwave);
+    for (uint8_t i = 0; i < 2; i++) {
+        free(miss_buf[i]);
+        miss_buf[i] = NULL;
+        miss_cap[i] = 0;
+    }
+}
+
+static bool lfmemo_get(const lfmemo_t *m, const uint8_t *samples, size_t size, const int *args) {
+    return m->valid
+           && m->size == size
+           && memcmp(m->args, args, sizeof(m->args)) == 0
+           && m->prop.low == signalprop.low
+           && m->prop.high == signalprop.high
+           && m->prop.mean == signalprop.mean
+           && m->prop.amplitude == signalprop.amplitude
+           && m->prop.isnoise == signalprop.isnoise
+           && memcmp(m->samples, samples, size) == 0;
+}
+
+// take a copy of the input,  caller fills in res[] and sets valid once the result is known
+static bool lfmemo_set(lfmemo_t *m, const uint8_t *samples, size_t size, const int *args) {
+    m->valid = false;
+    if (size > m->cap) {
+        uint8_t *in = realloc(m->samples, size);
+        if (in == NULL) {
+            return false;
+        }
+        m->samples = in;
+        uint8_t *out = realloc(m->out, size);
+        if (out == NULL) {
+            return false;
+        }
+        m->out = out;
+        m->cap = size;
+    }
+    memcpy(m->samples, samples, size);
+    memcpy(m->args, args, sizeof(m->args));
+    m->size = size;
+    m->prop = signalprop;
+    return true;
+}
+#endif
+
+// Sample scanning kernels.  Host builds use 16 byte SSE2 / NEON vectors,  the firmware
+// keeps the plain byte loops.
+#if !defined(ON_DEVICE) && defined(__SSE2__)
+# define LF_SIMD_SSE2
+# include <emmintrin.h>
+#elif !defined(ON_DEVICE) && defined(__ARM_NEON) && defined(__aarch64__)
+# define LF_SIMD_NEON
+# include <arm_neon.h>
+#endif
+#define LF_SIMD_PROBE 16
+
+// first index from i with samples[] >= high,  size if none
+static size_t lf_find_ge(const uint8_t *samples, size_t i, size_t size, int high) {
+    if (i >= size || high <= 0) return i;
+    if (high > 255) return size;
+    // edges are usually close,  only go wide when a short scalar probe comes up empty
+    for (size_t stop = MIN(i + LF_SIMD_PROBE, size); i < stop; i++) {
+        if (samples[i] >= high) return i;
+    }
+#if defined(LF_SIMD_SSE2)
+    const __m128i h = _mm_set1_epi8((char)high);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, h), v));
+        if (m) return i + __builtin_ctz(m);
+    }
+#elif defined(LF_SIMD_NEON)
+    const uint8x16_t h = vdupq_n_u8(high);
+    for (; i + 16 <= size; i += 16) {
+        if (vmaxvq_u8(vcgeq_u8(vld1q_u8(samples + i), h))) break;
+    }
+#endif
+    while (i < size && samples[i] < high) i++;
+    return i;
+}
+
+// first index from i with samples[] <= low,  size if none
+static size_t lf_find_le(const uint8_t *samples, size_t i, size_t size, int low) {
+    if (i >= size || low >= 255) return i;
+    if (low < 0) return size;
+    for (size_t stop = MIN(i + LF_SIMD_PROBE, size); i < stop; i++) {
+        if (samples[i] <= low) return i;
+    }
+#if defined(LF_SIMD_SSE2)
+    const __m128i l = _mm_set1_epi8((char)low);
+    for (; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+        int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(v, l), v));
+        if (m) return i + __builtin_ctz(m);
+    }
+#elif defined(LF_SIMD_NEON)
+    const uint8x16_t l = vdupq_n_u8(low);
+    for (; i + 16 <= size; i += 16) {
+        if (vmaxvq_u8(vcleq_u8(vld1q_u8(samples + i), l))) break;
+    }
+#endif
+    while (i < size && samples[i] > low) i++;
+    return i;
+}
+
+// first local maximum (s[i] > s[i-1] && s[i] >= s[i+1]) in [i, end),  end if none
+// needs i >= 1 and end < size
+static size_t lf_next_peak(const uint8_t *s, size_t i, size_t end) {
+    for (size_t stop = MIN(i + LF_SIMD_PROBE, end); i < stop; i++) {
+        if (s[i] > s[i - 1] && s[i] >= s[i + 1]) return i;
+    }
+#if defined(LF_SIMD_SSE2)
+    for (; i + 16 <= end; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i prev = _mm_loadu_si128((const __m128i *)(s + i - 1));
+        __m128i next = _mm_loadu_si128((const __m128i *)(s + i + 1));
+        __m128i not_gt = _mm_cmpeq_epi8(_mm_min_epu8(v, prev), v);
+        __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(v, next), v);
+        int m = _mm_movemask_epi8(_mm_andnot_si128(not_gt, ge));
+        if (m) return i + __builtin_ctz(m);
+    }
+#elif defined(LF_SIMD_NEON)
+    for (; i + 16 <= end; i += 16) {
+        uint8x16_t v = vld1q_u8(s + i);
+        uint8x16_t m = vandq_u8(vcgtq_u8(v, vld1q_u8(s + i - 1)), vcgeq_u8(v, vld1q_u8(s + i + 1)));
+        if (vmaxvq_u8(m)) break;
+    }
+#endif
+    for (; i < end; i++) {
+        if (s[i] > s[i - 1] && s[i] >= s[i + 1]) break;
+    }
+    return i;
+}
+
+// s[] = (s[] < mean) ? 0 : 1
+static void lf_threshold(uint8_t *s, size_t n, int mean) {
+    size_t i = 0;
+    if (mean <= 0 || mean > 255) {
+        memset(s, (mean <= 0) ? 1 : 0, n);
+        return;
+    }
+#if defined(LF_SIMD_SSE2)
+    const __m128i m = _mm_set1_epi8((char)mean);
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        _mm_storeu_si128((__m128i *)(s + i), _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, m), v), one));
+    }
+#elif defined(LF_SIMD_NEON)
+    const uint8x16_t m = vdupq_n_u8(mean);
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; i + 16 <= n; i += 16) {
+        vst1q_u8(s + i, vandq_u8(vcgeq_u8(vld1q_u8(s + i), m), one));
+    }
+#endif
+    for (; i < n; i++) {
+        s[i] = (s[i] < mean) ? 0 : 1;
+    }
+}
+
+#ifndef ON_DEVICE
+// 0xFF lanes where the sample is >= h or <= l
+#if defined(LF_SIMD_SSE2)
+static inline __m128i lf_peaks16(const uint8_t *p, __m128i h, __m128i l) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, h), v), _mm_cmpeq_epi8(_mm_min_epu8(v, l), v));
+}
+#elif defined(LF_SIMD_NEON)
+static inline uint8x16_t lf_peaks16(const uint8_t *p, uint8x16_t h, uint8x16_t l) {
+    uint8x16_t v = vld1q_u8(p);
+    return vorrq_u8(vcgeq_u8(v, h), vcleq_u8(v, l));
+}
+#endif
+
+static inline bool lf_is_peak(const uint8_t *s, size_t size, size_t k, int high, int low) {
+    return (k < size) && (s[k] >= high || s[k] <= low);
+}
+
+// miss[k] = 1 when neither s[k] nor its +-tol (0 or 1) neighbours are a peak (>= high or <= low)
+static void lf_peak_miss_map(const uint8_t *s, size_t size, int high, int low, uint8_t tol, uint8_t *miss) {
+    if (size < 2) {
+        tol = 0;
+    }
+    size_t i = tol;
+    size_t end = size - tol;
+    if (high >= 1 && high <= 255 && low >= 0 && low <= 254) {
+#if defined(LF_SIMD_SSE2)
+        const __m128i h = _mm_set1_epi8((char)high);
+        const __m128i l = _mm_set1_epi8((char)low);
+        const __m128i one = _mm_set1_epi8(1);
+        for (; i + 16 <= end; i += 16) {
+            __m128i pk = lf_peaks16(s + i, h, l);
+            if (tol) {
+                pk = _mm_or_si128(pk, _mm_or_si128(lf_peaks16(s + i - 1, h, l), lf_peaks16(s + i + 1, h, l)));
+            }
+            _mm_storeu_si128((__m128i *)(miss + i), _mm_andnot_si128(pk, one));
+        }
+#elif defined(LF_SIMD_NEON)
+        const uint8x16_t h = vdupq_n_u8(high);
+        const uint8x16_t l = vdupq_n_u8(low);
+        const uint8x16_t one = vdupq_n_u8(1);
+        for (; i + 16 <= end; i += 16) {
+            uint8x16_t pk = lf_peaks16(s + i, h, l);
+            if (tol) {
+                pk = vorrq_u8(pk, vorrq_u8(lf_peaks16(s + i - 1, h, l), lf_peaks16(s + i + 1, h, l)));
+            }
+            vst1q_u8(miss + i, vbicq_u8(one, pk));
+        }
+#endif
+    }
+    // edges and whatever the vector loop left in [tol, i),  a missing neighbour counts as no peak
+    for (size_t k = 0; k < size; k++) {
+        if (k == tol && i > tol) {
+            k = i - 1;
+            continue;
+        }
+        bool pk = lf_is_peak(s, size, k, high, low);
+        if (tol) {
+            pk = pk || lf_is_peak(s, size, k + 1, high, low) || (k > 0 && lf_is_peak(s, size, k - 1, high, low));
+        }
+        miss[k] = (pk) ? 0 : 1;
+    }
 }
 #endif
 
@@ -110,23 +427,24 @@ void computeSignalProperties(const uint8_t *samples, uint32_t size) {
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
 #ifndef ON_DEVICE
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    sample_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.1)] + tmp[(int)((offset_size - 1) * 0.1)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.9)] + tmp[(int)((offset_size - 1) * 0.9)]);
+    uint8_t low10 = 0.5 * (histogram_nth(hist, (int)(offset_size * 0.1)) + histogram_nth(hist, (int)((offset_size - 1) * 0.1)));
+    uint8_t hi90 =  0.5 * (histogram_nth(hist, (int)(offset_size * 0.9)) + histogram_nth(hist, (int)((offset_size - 1) * 0.9)));
     uint32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
+    for (int v = 0; v < 256; v++) {
+        if (hist[v] == 0)
+            continue;
 
-        if (samples[i] < signalprop.low) signalprop.low = samples[i];
-        if (samples[i] > signalprop.high) signalprop.high = samples[i];
+        if (v < signalprop.low) signalprop.low = v;
+        if (v > signalprop.high) signalprop.high = v;
 
-        if (samples[i] < low10 || samples[i] > hi90)
+        if (v < low10 || v > hi90)
             continue;
 
-        sum += samples[i];
-        cnt++;
+        sum += hist[v] * v;
+        cnt += hist[v];
     }
     if (cnt > 0)
         signalprop.mean = sum / cnt;
@@ -158,26 +476,9 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
 #ifndef ON_DEVICE
-
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
-
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.05)] + tmp[(int)((offset_size - 1) * 0.05)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.95)] + tmp[(int)((offset_size - 1) * 0.95)]);
-    int32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
-
-        if (samples[i] < low10 || samples[i] > hi90)
-            continue;
-
-        acc_off += samples[i] - 128;
-        cnt++;
-    }
-    if (cnt > 0)
-        acc_off /= cnt;
-    else
-        acc_off = 0;
+    uint32_t hist[256];
+    sample_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
+    acc_off = signalOffsetFromHistogram(hist, offset_size);
 #else
     for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++)
         acc_off += samples[i] - 128;
@@ -227,17 +528,20 @@ bool parityTest(uint32_t bits, uint8_t bitLen, uint8_t pType) {
 // takes a array of binary values, start position, length of bits per parity (includes parity bit - MAX 32),
 //   Parity Type (1 for odd; 0 for even; 2 for Always 1's; 3 for Always 0's), and binary Length (length to run)
 size_t removeParity(uint8_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType, size_t bLen) {
-    uint32_t parityWd = 0;
     size_t bitCnt = 0;
-    for (int word = 0; word < (bLen); word += pLen) {
-        for (int bit = 0; bit < pLen; bit++) {
-            if (word + bit >= bLen) break;
-            parityWd = (parityWd << 1) | bits[startIdx + word + bit];
-            bits[bitCnt++] = (bits[startIdx + word + bit]);
+    for (size_t word = 0; word < bLen; word += pLen) {
+        const uint8_t *src = bits + startIdx + word;
+
+        // the compacted data never overtakes the source,  so a forward copy is safe
+        if (word + pLen > bLen) {
+            memmove(bits + bitCnt, src, bLen - word);
+            bitCnt += bLen - word;
+            break;
         }
-        if (word + pLen > bLen) break;
+        uint32_t parityWd = bytebits_to_byte((uint8_t *)src, pLen);
+        memmove(bits + bitCnt, src, pLen);
+        bitCnt += pLen - 1; // overwrite parity with next data
 
-        bitCnt--; // overwrite parity with next data
         // if parity fails then return 0
         switch (pType) {
             case 3:
@@ -251,10 +555,15 @@ size_t removeParity(uint8_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType,
                 }
                 break; // should be 1 spacer bit
             default:
-                if (parityTest(parityWd, pLen, pType) == 0) { return 0; }
+                if (parityWd <= 0xFF) {
+                    if ((oddparity8(parityWd) ^ pType) == 0) {
+                        return 0;
+                    }
+                } else if (parityTest(parityWd, pLen, pType) == 0) {
+                    return 0;
+                }
                 break; // test parity
         }
-        parityWd = 0;
     }
     // if we got here then all the parities passed
     //return size
@@ -262,7 +571,7 @@ size_t removeParity(uint8_t *bits, size_t startIdx, uint8_t pLen, uint8_t pType,
 }
 
 static size_t removeEm410xParity(uint8_t *bits, size_t startIdx, size_t *size, bool *validShort, bool *validShortExtended, bool *validLong) {
-    uint32_t parityWd = 0;
+    uint32_t parityWd;
     size_t bitCnt = 0;
     bool validColParity = false;
     bool validRowParity = true;
@@ -287,20 +596,19 @@ static size_t removeEm410xParity(uint8_t *bits, size_t startIdx, size_t *size, b
     uint16_t parityCol[4] = { 0, 0, 0, 0 };
 
     for (int word = 0; word < blen; word += 5) {
-        for (int bit = 0; bit < 5; bit++) {
-
-            if (word + bit >= blen) {
-                break;
-            }
-            parityWd = (parityWd << 1) | bits[startIdx + word + bit];
+        const uint8_t *src = bits + startIdx + word;
+        uint8_t n = MIN(5, blen - word);
 
-            if ((word <= 50) && (bit < 4)) {
-                parityCol[bit] = (parityCol[bit] << 1) | bits[startIdx + word + bit];
+        if (word <= 50) {
+            for (uint8_t bit = 0; bit < MIN(4, n); bit++) {
+                parityCol[bit] = (parityCol[bit] << 1) | src[bit];
             }
-
-            bits[bitCnt++] = (bits[startIdx + word + bit]);
         }
 
+        parityWd = bytebits_to_byte((uint8_t *)src, n);
+        memmove(bits + bitCnt, src, n);
+        bitCnt += n;
+
         if (word + 5 > blen) break;
 
         bitCnt--; // overwrite parity with next data
@@ -314,7 +622,6 @@ static size_t removeEm410xParity(uint8_t *bits, size_t startIdx, size_t *size, b
         } else {
             validRowParitySkipColP &= parityTest(parityWd, 5, 0) != 0;
         }
-        parityWd = 0;
     }
 
     if ((blen != 128) && validRowParitySkipColP && validColParity) {
@@ -377,11 +684,30 @@ int bits_to_array(const uint8_t *bits, size_t size, uint8_t *dest) {
     return PM3_SUCCESS;
 }
 
+// packs four bit bytes (0 / 1, first one is the msb) into a nibble,  one multiply places
+// every byte's bit at its own position so nothing carries into the result.
+static inline uint8_t bytebits_nibble(uint32_t v) {
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return (v * 0x00204081) >> 21 & 0x0F;
+#else
+    return (v * 0x08040201) >> 24 & 0x0F;
+#endif
+}
+
 uint32_t bytebits_to_byte(uint8_t *src, size_t numbits) {
     uint32_t num = 0;
-    for (int i = 0 ; i < numbits ; i++) {
-        num = (num << 1) | (*src);
-        src++;
+    size_t i = 0;
+    for (; i + 4 <= numbits; i += 4) {
+        uint32_t v;
+        memcpy(&v, src + i, sizeof(v));
+        // anything else than 0 / 1 (demod error markers) takes the bitwise way
+        if (v & 0xFEFEFEFE) {
+            break;
+        }
+        num = (num << 4) | bytebits_nibble(v);
+    }
+    for (; i < numbits; i++) {
+        num = (num << 1) | src[i];
     }
     return num;
 }
@@ -407,8 +733,28 @@ bool preambleSearchEx(uint8_t *bits, uint8_t *preamble, size_t pLen, size_t *siz
     if (*size <= pLen)
         return false;
 
+    // the low bits of the last pLen samples,  shifted in one at a time.  A match of those
+    // is confirmed with memcmp,  so samples other than 0 / 1 still compare as before.
+    uint64_t want = 0, mask = 0, window = 0;
+    bool packed = (pLen <= 64);
+    if (packed) {
+        for (size_t i = 0; i < pLen; i++) {
+            want = (want << 1) | (preamble[i] & 1);
+        }
+        mask = (pLen == 64) ? UINT64_MAX : (((uint64_t)1 << pLen) - 1);
+        for (size_t i = 0; i + 1 < pLen; i++) {
+            window = (window << 1) | (bits[i] & 1);
+        }
+    }
+
     uint8_t foundCnt = 0;
     for (size_t idx = 0; idx < *size - pLen; idx++) {
+        if (packed) {
+            window = (window << 1) | (bits[idx + pLen - 1] & 1);
+            if ((window & mask) != want) {
+                continue;
+            }
+        }
         if (memcmp(bits + idx, preamble, pLen) == 0) {
             //first index found
             foundCnt++;
@@ -475,13 +821,11 @@ static int getClosestClock(int testclk) {
 }
 
 void getNextLow(const uint8_t *samples, size_t size, int low, size_t *i) {
-    while ((samples[*i] > low) && (*i < size))
-        *i += 1;
+    *i = lf_find_le(samples, *i, size, low);
 }
 
 void getNextHigh(const uint8_t *samples, size_t size, int high, size_t *i) {
-    while ((samples[*i] < high) && (*i < size))
-        *i += 1;
+    *i = lf_find_ge(samples, *i, size, high);
 }
 
 // load wave counters
@@ -742,7 +1086,7 @@ int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clo
 // not perfect especially with lower clocks or VERY good antennas (heavy wave clipping)
 // maybe somehow adjust peak trimming value based on samples to fix?
 // return start index of best starting position for that clock and return clock (by reference)
-int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
+static int detect_ask_clock(uint8_t *dest, size_t size, int *clock, int maxErr) {
 
     //don't need to loop through entire array. (cotag has clock of 384)
     uint16_t loopCnt = 1000;
@@ -807,6 +1151,11 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
     uint8_t bestStart[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     size_t errCnt, arrLoc, loopEnd;
 
+#ifndef ON_DEVICE
+    // per tolerance map of samples with no peak in reach,  buffers are kept between calls
+    uint8_t *miss[2] = { NULL, NULL };
+#endif
+
     if (found_clk) {
         clkCnt = found_clk;
         num_clks = found_clk + 1;
@@ -833,19 +1182,44 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
         getNextHigh(dest, size, peak_hi, &j);
         getNextLow(dest, size, peak_low, &j);
 
+#ifndef ON_DEVICE
+        // one pass marks the samples without a peak in reach,  the offsets below only sum them up
+        if (j < loopCnt && miss[tol] == NULL) {
+            if (miss_cap[tol] < size + 1) {
+                uint8_t *p = realloc(miss_buf[tol], size + 1);
+                if (p != NULL) {
+                    miss_buf[tol] = p;
+                    miss_cap[tol] = size + 1;
+                }
+            }
+            if (miss_cap[tol] >= size + 1) {
+                miss[tol] = miss_buf[tol];
+                lf_peak_miss_map(dest, size + 1, peak_hi, peak_low, tol, miss[tol]);
+            }
+        }
+#endif
+
         for (; j < loopCnt; j++) {
             errCnt = 0;
             // now that we have the first one lined up test rest of wave array
             loopEnd = ((size - j - tol) / clk[clkCnt]) - 1;
-            for (i = 0; i < loopEnd; ++i) {
-                arrLoc = j + (i * clk[clkCnt]);
-                if (dest[arrLoc] >= peak_hi || dest[arrLoc] <= peak_low) {
-                } else if (dest[arrLoc - tol] >= peak_hi || dest[arrLoc - tol] <= peak_low) {
-                } else if (dest[arrLoc + tol] >= peak_hi || dest[arrLoc + tol] <= peak_low) {
-                } else {  //error no peak detected
-                    errCnt++;
+#ifndef ON_DEVICE
+            if (miss[tol] != NULL && j >= tol) {
+                const uint8_t *m = miss[tol] + j;
+                for (i = 0; i < loopEnd; ++i) {
+                    errCnt += m[i * clk[clkCnt]];
+                }
+            } else
+#endif
+                for (i = 0; i < loopEnd; ++i) {
+                    arrLoc = j + (i * clk[clkCnt]);
+                    if (dest[arrLoc] >= peak_hi || dest[arrLoc] <= peak_low) {
+                    } else if (dest[arrLoc - tol] >= peak_hi || dest[arrLoc - tol] <= peak_low) {
+                    } else if (dest[arrLoc + tol] >= peak_hi || dest[arrLoc + tol] <= peak_low) {
+                    } else {  //error no peak detected
+                        errCnt++;
+                    }
                 }
-            }
             // if we found no errors then we can stop here and a low clock (common clocks)
             //  this is correct one - return this clock
             // if (g_debugMode == 2) prnt("DEBUG ASK: clk %d, err %d, startpos %d, endpos %d", clk[clkCnt], errCnt, j, i);
@@ -897,6 +1271,26 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
     return bestStart[best];
 }
 
+int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
+#ifndef ON_DEVICE
+    int args[3] = { *clock, maxErr, 0 };
+    if (lfmemo_get(&memo_askclk, dest, size, args)) {
+        *clock = memo_askclk.res[1];
+        return memo_askclk.res[0];
+    }
+    bool keep = lfmemo_set(&memo_askclk, dest, size, args);
+    int start = detect_ask_clock(dest, size, clock, maxErr);
+    if (keep) {
+        memo_askclk.res[0] = start;
+        memo_askclk.res[1] = *clock;
+        memo_askclk.valid = true;
+    }
+    return start;
+#else
+    return detect_ask_clock(dest, size, clock, maxErr);
+#endif
+}
+
 int DetectStrongNRZClk(const uint8_t *dest, size_t size, int peak, int low, bool *strong) {
     //find shortest transition from high to low
     *strong = false;
@@ -941,7 +1335,7 @@ int DetectStrongNRZClk(const uint8_t *dest, size_t size, int peak, int low, bool
 }
 
 // detect nrz clock by reading #peaks vs no peaks(or errors)
-int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
+static int detect_nrz_clock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
     size_t i = 0;
     uint16_t clk[] = {8, 16, 32, 40, 50, 64, 100, 128, 255, 272, 384};
     size_t loopCnt = 4096;  //don't need to loop through entire array...
@@ -1067,10 +1461,30 @@ int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx)
     return clk[best];
 }
 
+int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
+#ifndef ON_DEVICE
+    int args[3] = { clock, 0, 0 };
+    if (lfmemo_get(&memo_nrzclk, dest, size, args)) {
+        *clockStartIdx = memo_nrzclk.res[1];
+        return memo_nrzclk.res[0];
+    }
+    bool keep = lfmemo_set(&memo_nrzclk, dest, size, args);
+    clock = detect_nrz_clock(dest, size, clock, clockStartIdx);
+    if (keep) {
+        memo_nrzclk.res[0] = clock;
+        memo_nrzclk.res[1] = *clockStartIdx;
+        memo_nrzclk.valid = true;
+    }
+    return clock;
+#else
+    return detect_nrz_clock(dest, size, clock, clockStartIdx);
+#endif
+}
+
 // countFC is to detect the field clock lengths.
 // counts and returns the 2 most common wave lengths
 // mainly used for FSK field clock detection
-uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
+static uint16_t count_fc(const uint8_t *bits, size_t size, bool fskAdj) {
     uint8_t fcLens[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint16_t fcCnts[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t fcLensFnd = 0;
@@ -1080,40 +1494,35 @@ uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
     if (size < 180) return 0;
 
     // prime i to first up transition
-    for (i = 160; i < size - 20; i++)
-        if (bits[i] > bits[i - 1] && bits[i] >= bits[i + 1])
-            break;
-
-    for (; i < size - 20; i++) {
-        if (bits[i] > bits[i - 1] && bits[i] >= bits[i + 1]) {
-            // new up transition
-            fcCounter++;
-            if (fskAdj) {
-                //if we had 5 and now have 9 then go back to 8 (for when we get a fc 9 instead of an 8)
-                if (lastFCcnt == 5 && fcCounter == 9) fcCounter--;
-
-                //if fc=9 or 4 add one (for when we get a fc 9 instead of 10 or a 4 instead of a 5)
-                if ((fcCounter == 9) || fcCounter == 4) fcCounter++;
-                // save last field clock count  (fc/xx)
-                lastFCcnt = fcCounter;
-            }
-            // find which fcLens to save it to:
-            for (int m = 0; m < 15; m++) {
-                if (fcLens[m] == fcCounter) {
-                    fcCnts[m]++;
-                    fcCounter = 0;
-                    break;
-                }
-            }
-            if (fcCounter > 0 && fcLensFnd < 15) {
-                //add new fc length
-                fcCnts[fcLensFnd]++;
-                fcLens[fcLensFnd++] = fcCounter;
+    i = lf_next_peak(bits, 160, size - 20);
+
+    // every sample counts one, so the count at an up transition is the distance to the previous one
+    size_t last = i - 1;
+    for (; i < size - 20; i = lf_next_peak(bits, i + 1, size - 20)) {
+        // new up transition
+        fcCounter = (uint8_t)(i - last);
+        last = i;
+        if (fskAdj) {
+            //if we had 5 and now have 9 then go back to 8 (for when we get a fc 9 instead of an 8)
+            if (lastFCcnt == 5 && fcCounter == 9) fcCounter--;
+
+            //if fc=9 or 4 add one (for when we get a fc 9 instead of 10 or a 4 instead of a 5)
+            if ((fcCounter == 9) || fcCounter == 4) fcCounter++;
+            // save last field clock count  (fc/xx)
+            lastFCcnt = fcCounter;
+        }
+        // find which fcLens to save it to:
+        for (int m = 0; m < 15; m++) {
+            if (fcLens[m] == fcCounter) {
+                fcCnts[m]++;
+                fcCounter = 0;
+                break;
             }
-            fcCounter = 0;
-        } else {
-            // count sample
-            fcCounter++;
+        }
+        if (fcCounter > 0 && fcLensFnd < 15) {
+            //add new fc length
+            fcCnts[fcLensFnd]++;
+            fcLens[fcLensFnd++] = fcCounter;
         }
     }
 
@@ -1159,9 +1568,27 @@ uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
     return (uint16_t)fcLens[best2] << 8 | fcLens[best1];
 }
 
+uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
+#ifndef ON_DEVICE
+    int args[3] = { fskAdj, 0, 0 };
+    if (lfmemo_get(&memo_countfc, bits, size, args)) {
+        return memo_countfc.res[0];
+    }
+    bool keep = lfmemo_set(&memo_countfc, bits, size, args);
+    uint16_t fcs = count_fc(bits, size, fskAdj);
+    if (keep) {
+        memo_countfc.res[0] = fcs;
+        memo_countfc.valid = true;
+    }
+    return fcs;
+#else
+    return count_fc(bits, size, fskAdj);
+#endif
+}
+
 // detect psk clock by reading each phase shift
 // a phase shift is determined by measuring the sample length of each wave
-int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
+static int detect_psk_clock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
     uint16_t clk[] = {255, 16, 32, 40, 50, 64, 100, 128, 256, 272, 384}; // 255 is not a valid clock
     uint16_t loopCnt = 4096;  // don't need to loop through entire array...
 
@@ -1257,8 +1684,32 @@ int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShif
     return clk[best];
 }
 
+int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
+#ifndef ON_DEVICE
+    int args[3] = { clock, *curPhase, 0 };
+    if (lfmemo_get(&memo_pskclk, dest, size, args)) {
+        *firstPhaseShift = memo_pskclk.res[1];
+        *curPhase = memo_pskclk.res[2];
+        *fc = memo_pskclk.res[3];
+        return memo_pskclk.res[0];
+    }
+    bool keep = lfmemo_set(&memo_pskclk, dest, size, args);
+    clock = detect_psk_clock(dest, size, clock, firstPhaseShift, curPhase, fc);
+    if (keep) {
+        memo_pskclk.res[0] = clock;
+        memo_pskclk.res[1] = *firstPhaseShift;
+        memo_pskclk.res[2] = *curPhase;
+        memo_pskclk.res[3] = *fc;
+        memo_pskclk.valid = true;
+    }
+    return clock;
+#else
+    return detect_psk_clock(dest, size, clock, firstPhaseShift, curPhase, fc);
+#endif
+}
+
 // detects the bit clock for FSK given the high and low Field Clocks
-uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
+static uint8_t detect_fsk_clk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
 
     if (size == 0)
         return 0;
@@ -1365,6 +1816,26 @@ uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t f
     return clk[m];
 }
 
+uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
+#ifndef ON_DEVICE
+    int args[3] = { fcHigh, fcLow, 0 };
+    if (lfmemo_get(&memo_fskclk, bits, size, args)) {
+        *firstClockEdge = memo_fskclk.res[1];
+        return memo_fskclk.res[0];
+    }
+    bool keep = lfmemo_set(&memo_fskclk, bits, size, args);
+    uint8_t clk = detect_fsk_clk(bits, size, fcHigh, fcLow, firstClockEdge);
+    if (keep) {
+        memo_fskclk.res[0] = clk;
+        memo_fskclk.res[1] = *firstClockEdge;
+        memo_fskclk.valid = true;
+    }
+    return clk;
+#else
+    return detect_fsk_clk(bits, size, fcHigh, fcLow, firstClockEdge);
+#endif
+}
+
 
 // **********************************************************************************************
 // --------------------Modulation Demods &/or Decoding Section-----------------------------------
@@ -1898,7 +2369,7 @@ int nrzRawDemod(uint8_t *dest, size_t *size, int *clk, const int *invert, int *s
 }
 
 // translate wave to 11111100000 (1 for each short wave [higher freq] 0 for each long wave [lower freq])
-static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t fclow, int *startIdx) {
+static size_t fsk_wave_demod_ex(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t fclow, int *startIdx) {
 
     if (size < 1024) return 0;   // not enough samples
 
@@ -1918,6 +2389,11 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
     last_transition = idx;
     idx++;
 
+    // threshold the rest up front,  bits are only ever written behind idx
+    if (idx < size - 20) {
+        lf_threshold(dest + idx, size - 20 - idx, signalprop.mean);
+    }
+
     // Definition:  cycles between consecutive lo-hi transitions
     // Lets define some expected lengths. FSK1 is easier since it has bigger differences between.
     // FSK1 8/5
@@ -1950,9 +2426,6 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
 
     for (; idx < size - 20; idx++) {
 
-        // threshold current value
-        dest[idx] = (dest[idx] < signalprop.mean) ? 0 : 1;
-
         // Check for 0->1 transition
         if (dest[idx - 1] < dest[idx]) {
             preLastSample = LastSample;
@@ -1991,6 +2464,30 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
     return numBits; //Actually, it returns the number of bytes, but each byte represents a bit: 1 or 0
 }
 
+static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t fclow, int *startIdx) {
+#ifndef ON_DEVICE
+    // HID, AWID, IO Prox, Pyramid and Paradox all start from the same fc/10/8 wave demod
+    int args[3] = { fchigh, fclow, *startIdx };
+    if (lfmemo_get(&memo_fskwave, dest, size, args)) {
+        memcpy(dest, memo_fskwave.out, size);
+        *startIdx = memo_fskwave.res[1];
+        return memo_fskwave.res[0];
+    }
+    bool keep = lfmemo_set(&memo_fskwave, dest, size, args);
+    size_t n = fsk_wave_demod_ex(dest, size, fchigh, fclow, startIdx);
+    if (keep) {
+        // thresholding touches the whole buffer,  not only the first n
+        memcpy(memo_fskwave.out, dest, size);
+        memo_fskwave.res[0] = n;
+        memo_fskwave.res[1] = *startIdx;
+        memo_fskwave.valid = true;
+    }
+    return n;
+#else
+    return fsk_wave_demod_ex(dest, size, fchigh, fclow, startIdx);
+#endif
+}
+
 // translate 11111100000 to 10
 //rfLen = clock, fchigh = larger field clock, fclow = smaller field clock
 static size_t aggregate_bits(uint8_t *dest, size_t size, uint8_t clk, uint8_t invert, uint8_t fchigh, uint8_t fclow, int *startIdx) {
@@ -44,6 +44,11 @@ typedef struct {
 signal_t *getSignalProperties(void);
 
 void computeSignalProperties(const uint8_t *samples, uint32_t size);
+#ifndef ON_DEVICE
+void setSignalPropertiesStore(signal_t *store);
+void lfdemod_thread_free(void);
+int signalOffsetFromHistogram(const uint32_t *hist, uint32_t offset_size);
+#endif
 void removeSignalOffset(uint8_t *samples, uint32_t size);
 void getNextLow(const uint8_t *samples, size_t size, int low, size_t *i);
 void getNextHigh(const uint8_t *samples, size_t size, int high, size_t *i);
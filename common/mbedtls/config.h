@@ -57,6 +57,10 @@
  * Comment to disable the use of assembly code.
  */
 //#define MBEDTLS_HAVE_ASM
+// x86-64 hosts only: AES-NI below needs it, the ARM firmware stays plain C
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+#define MBEDTLS_HAVE_ASM
+#endif
 
 /**
  * \def MBEDTLS_NO_UDBL_DIVISION
@@ -2275,6 +2279,10 @@
  * This modules adds support for the AES-NI instructions on x86-64
  */
 //#define MBEDTLS_AESNI_C
+// runtime cpuid check in aes.c falls back to the C tables when the cpu lacks it
+#if defined(MBEDTLS_HAVE_ASM) && defined(__GNUC__) && (defined(__x86_64__) || defined(__amd64__))
+#define MBEDTLS_AESNI_C
+#endif
 
 /**
  * \def MBEDTLS_AES_C
@@ -26,8 +26,13 @@
 
 #include "util_posix.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <time.h>
 
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
 
 // Timer functions
 #if !defined (_WIN32)
@@ -152,20 +157,44 @@ uint64_t usclock(void) {
 #include <sys/timeb.h>
     struct _timeb t;
     _ftime(&t);
-    return 1000 * (uint64_t)t.time + t.millitm;
+    return 1000000 * (uint64_t)t.time + 1000 * (uint64_t)t.millitm;
 
 // NORMAL CODE (use _ftime_s)
     //struct _timeb t;
     //if (_ftime_s(&t)) {
     //  return 0;
     //} else {
-    //  return 1000 * t.time + t.millitm;
+    //  return 1000000 * t.time + 1000 * t.millitm;
     //}
 #else
     struct timespec t;
     clock_gettime(CLOCK_MONOTONIC, &t);
-    //return (1000 * (uint64_t)t.tv_sec + t.tv_nsec / 1000);
-    return (1000 * (uint64_t)t.tv_sec + (t.tv_nsec / 1000));
+    return (1000000 * (uint64_t)t.tv_sec + (t.tv_nsec / 1000));
 #endif
 }
 
+// resident set size of this process,  what a client instance really costs
+uint64_t process_rss(void) {
+#if defined(__linux__)
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0;
+    }
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    if (n != 2) {
+        return 0;
+    }
+    return (uint64_t)resident * sysconf(_SC_PAGESIZE);
+#elif defined(__APPLE__)
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+#else
+    return 0;
+#endif
+}
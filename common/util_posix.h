@@ -31,4 +31,5 @@ void msleep(uint32_t n);    // sleep n milliseconds
 
 uint64_t msclock(void);     // a milliseconds clock
 uint64_t usclock(void);     // a microseconds clock
+uint64_t process_rss(void);  // resident set size in bytes, 0 when unknown
 #endif
@@ -23,6 +23,7 @@
 
 #ifndef AS_BOOTROM
 #include "dbprint.h"
+#include "commonutil.h"   // ARRAYLEN
 #endif // AS_BOOTROM
 
 #include "string.h"
@@ -48,6 +49,66 @@ void FlashmemSetSpiBaudrate(uint32_t baudrate) {
     Dbprintf("Spi Baudrate : %dMHz", FLASHMEM_SPIBAUDRATE / 1000000);
 }
 
+// Bulk transfers go through the SPI PDC instead of polling every byte.  Chip select stays
+// asserted (CSAAT),  the caller sends the last byte with FlashSendLastByte() to release it.
+#define FLASH_PDC_MIN   16
+
+// rx == NULL:  transmit only,  the received bytes are dropped
+static void FlashTransferPDC(const uint8_t *tx, uint8_t *rx, uint16_t len) {
+
+    AT91C_BASE_PDC_SPI->PDC_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+
+    if (rx) {
+        AT91C_BASE_PDC_SPI->PDC_RPR = (uint32_t)rx;
+        AT91C_BASE_PDC_SPI->PDC_RCR = len;
+    }
+    AT91C_BASE_PDC_SPI->PDC_TPR = (uint32_t)tx;
+    AT91C_BASE_PDC_SPI->PDC_TCR = len;
+
+    AT91C_BASE_PDC_SPI->PDC_PTCR = (rx ? AT91C_PDC_RXTEN : 0) | AT91C_PDC_TXTEN;
+
+    if (rx) {
+        while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDRX) == 0) {};
+    } else {
+        while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_ENDTX) == 0) {};
+        while ((AT91C_BASE_SPI->SPI_SR & AT91C_SPI_TXEMPTY) == 0) {};
+    }
+
+    AT91C_BASE_PDC_SPI->PDC_PTCR = AT91C_PDC_RXTDIS | AT91C_PDC_TXTDIS;
+
+    if (rx == NULL) {
+        // drop the last received byte and the overrun flag,  FlashSendByte() waits on RDRF
+        if (AT91C_BASE_SPI->SPI_RDR == 0) {};
+        if (AT91C_BASE_SPI->SPI_SR == 0) {};
+    }
+}
+
+static void FlashReadBytes(uint8_t *out, uint16_t len) {
+    uint16_t i = 0;
+    if (len > FLASH_PDC_MIN) {
+        // tx runs ahead of rx,  so the buffer doubles as the 0xFF dummy source
+        memset(out, 0xFF, len - 1);
+        FlashTransferPDC(out, out, len - 1);
+        i = len - 1;
+    }
+    for (; i < (len - 1); i++)
+        out[i] = FlashSendByte(0xFF);
+
+    out[i] = FlashSendLastByte(0xFF);
+}
+
+static void FlashWriteBytes(const uint8_t *in, uint16_t len) {
+    uint16_t i = 0;
+    if (len > FLASH_PDC_MIN) {
+        FlashTransferPDC(in, NULL, len - 1);
+        i = len - 1;
+    }
+    for (; i < (len - 1); i++)
+        FlashSendByte(in[i]);
+
+    FlashSendLastByte(in[i]);
+}
+
 // read ID out
 bool Flash_ReadID_90(flash_device_type_90_t *result) {
 
@@ -81,11 +142,7 @@ uint16_t Flash_ReadData(uint32_t address, uint8_t *out, uint16_t len) {
         FlashSendByte(DUMMYBYTE);
     }
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        out[i] = FlashSendByte(0xFF);
-
-    out[i] = FlashSendLastByte(0xFF);
+    FlashReadBytes(out, len);
     FlashStop();
     return len;
 }
@@ -111,11 +168,7 @@ uint16_t Flash_ReadDataCont(uint32_t address, uint8_t *out, uint16_t len) {
         FlashSendByte(DUMMYBYTE);
     }
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        out[i] = FlashSendByte(0xFF);
-
-    out[i] = FlashSendLastByte(0xFF);
+    FlashReadBytes(out, len);
     return len;
 }
 
@@ -154,11 +207,7 @@ uint16_t Flash_WriteData(uint32_t address, uint8_t *in, uint16_t len) {
     FlashSendByte((address >> 8) & 0xFF);
     FlashSendByte((address >> 0) & 0xFF);
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        FlashSendByte(in[i]);
-
-    FlashSendLastByte(in[i]);
+    FlashWriteBytes(in, len);
 
     FlashStop();
     return len;
@@ -187,11 +236,7 @@ uint16_t Flash_WriteDataCont(uint32_t address, uint8_t *in, uint16_t len) {
     FlashSendByte((address >> 8) & 0xFF);
     FlashSendByte((address >> 0) & 0xFF);
 
-    uint16_t i = 0;
-    for (; i < (len - 1); i++)
-        FlashSendByte(in[i]);
-
-    FlashSendLastByte(in[i]);
+    FlashWriteBytes(in, len);
     return len;
 }
 
@@ -393,32 +438,44 @@ void Flashmem_print_info(void) {
 
     DbpString(_CYAN_("Flash memory dictionary loaded"));
 
-    // load dictionary offsets.
-    uint8_t keysum[2];
-    uint16_t num;
-
+    // the index says which dictionary each section was made from
+    flash_dict_index_t idx;
     Flash_CheckBusy(BUSY_TIMEOUT);
-    uint16_t isok = Flash_ReadDataCont(DEFAULT_MF_KEYS_OFFSET, keysum, 2);
-    if (isok == 2) {
-        num = ((keysum[1] << 8) | keysum[0]);
-        if (num != 0xFFFF && num != 0x0)
-            Dbprintf("  Mifare.................. "_YELLOW_("%u")" / "_GREEN_("%u")" keys", num, DEFAULT_MF_KEYS_MAX);
-    }
+    uint16_t isok = Flash_ReadDataCont(DEFAULT_DICT_INDEX_OFFSET, (uint8_t *)&idx, sizeof(idx));
+    bool has_index = (isok == sizeof(idx)) && (idx.magic == FLASH_DICT_MAGIC) && (idx.version == FLASH_DICT_VERSION);
 
-    Flash_CheckBusy(BUSY_TIMEOUT);
-    isok = Flash_ReadDataCont(DEFAULT_T55XX_KEYS_OFFSET, keysum, 2);
-    if (isok == 2) {
-        num = ((keysum[1] << 8) | keysum[0]);
-        if (num != 0xFFFF && num != 0x0)
-            Dbprintf("  T55x7................... "_YELLOW_("%u")" / "_GREEN_("%u")" keys", num, DEFAULT_T55XX_KEYS_MAX);
-    }
-
-    Flash_CheckBusy(BUSY_TIMEOUT);
-    isok = Flash_ReadDataCont(DEFAULT_ICLASS_KEYS_OFFSET, keysum, 2);
-    if (isok == 2) {
-        num = ((keysum[1] << 8) | keysum[0]);
-        if (num != 0xFFFF && num != 0x0)
-            Dbprintf("  iClass.................. "_YELLOW_("%u")" / "_GREEN_("%u")" keys", num, DEFAULT_ICLASS_KEYS_MAX);
+    // load dictionary offsets.
+    const struct {
+        const char *desc;
+        uint32_t offset;
+        uint16_t max;
+        flash_dict_family_t family;
+    } sections[] = {
+        { "  Mifare.................. ", DEFAULT_MF_KEYS_OFFSET, DEFAULT_MF_KEYS_MAX, FLASH_DICT_MFC },
+        { "  T55x7................... ", DEFAULT_T55XX_KEYS_OFFSET, DEFAULT_T55XX_KEYS_MAX, FLASH_DICT_T55XX },
+        { "  iClass.................. ", DEFAULT_ICLASS_KEYS_OFFSET, DEFAULT_ICLASS_KEYS_MAX, FLASH_DICT_ICLASS },
+    };
+
+    for (uint8_t i = 0; i < ARRAYLEN(sections); i++) {
+        uint8_t keysum[2];
+        Flash_CheckBusy(BUSY_TIMEOUT);
+        isok = Flash_ReadDataCont(sections[i].offset, keysum, 2);
+        if (isok != 2)
+            continue;
+
+        uint16_t num = ((keysum[1] << 8) | keysum[0]);
+        if (num == 0xFFFF || num == 0x0)
+            continue;
+
+        const flash_dict_section_t *sec = &idx.section[sections[i].family];
+        if (has_index && sec->offset == sections[i].offset && sec->count == num && sec->name[0] != (char)0xFF) {
+            Dbprintf("%s"_YELLOW_("%u")" / "_GREEN_("%u")" keys ( %.*s%s )", sections[i].desc, num, sections[i].max,
+                     FLASH_DICT_NAME_LEN, sec->name,
+                     (sec->flags & FLASH_DICT_SORTED) ? ", by hits" : ""
+                    );
+        } else {
+            Dbprintf("%s"_YELLOW_("%u")" / "_GREEN_("%u")" keys", sections[i].desc, num, sections[i].max);
+        }
     }
 
     FlashStop();
@@ -112,6 +112,7 @@ AT91SAM7S256  USB Device Port
 #define SET_CONTROL_LINE_STATE        0x2221
 
 static bool isAsyncRequestFinished = false;
+static bool isAsyncWriteActive = false;
 static AT91PS_UDP pUdp = AT91C_BASE_UDP;
 static uint8_t btConfiguration = 0;
 static uint8_t btConnection    = 0;
@@ -912,6 +913,7 @@ int async_usb_write_start(void) {
     }
 
     isAsyncRequestFinished = false;
+    isAsyncWriteActive = true;
     return PM3_SUCCESS;
 }
 
@@ -981,6 +983,7 @@ int async_usb_write_stop(void) {
     // Wait for the end of transfer
     while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXPKTRDY) {
         if (usb_check() == false) {
+            isAsyncWriteActive = false;
             return PM3_EIO;
         }
     }
@@ -995,6 +998,7 @@ int async_usb_write_stop(void) {
 
         while (!(pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP)) {
             if (usb_check() == false) {
+                isAsyncWriteActive = false;
                 return PM3_EIO;
             }
         }
@@ -1002,9 +1006,30 @@ int async_usb_write_stop(void) {
         UDP_CLEAR_EP_FLAGS(AT91C_EP_IN, AT91C_UDP_TXCOMP);
         while (pUdp->UDP_CSR[AT91C_EP_IN] & AT91C_UDP_TXCOMP) {};
     }
+    isAsyncWriteActive = false;
     return PM3_SUCCESS;
 }
 
+/*
+ *----------------------------------------------------------------------------
+ * \fn     async_usb_write_cancel
+ * \brief  Give up on an async write process without flushing the FIFO
+ *----------------------------------------------------------------------------
+*/
+void async_usb_write_cancel(void) {
+    isAsyncWriteActive = false;
+}
+
+/*
+ *----------------------------------------------------------------------------
+ * \fn     async_usb_write_in_progress
+ * \return true between async_usb_write_start() and async_usb_write_stop()
+ *----------------------------------------------------------------------------
+*/
+bool async_usb_write_in_progress(void) {
+    return isAsyncWriteActive;
+}
+
 /*
  *----------------------------------------------------------------------------
  * \fn    AT91F_USB_SendData
@@ -46,6 +46,10 @@
 #define RESOURCES_SUBDIR     "resources" PATHSEP
 #define TRACES_SUBDIR        "traces" PATHSEP
 #define LOGS_SUBDIR          "logs" PATHSEP
+#define KEYSTATS_SUBDIR      "keystats" PATHSEP
+#define CHECKPOINTS_SUBDIR   "checkpoints" PATHSEP
+#define HARDBENCH_SUBDIR     "hardbench" PATHSEP
+#define CACHE_SUBDIR         "cache" PATHSEP
 #define FIRMWARES_SUBDIR     "firmware" PATHSEP
 #define BOOTROM_SUBDIR       "bootrom" PATHSEP "obj" PATHSEP
 #define FULLIMAGE_SUBDIR     "armsrc" PATHSEP "obj" PATHSEP
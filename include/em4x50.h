@@ -66,6 +66,8 @@ typedef struct {
     uint32_t addresses;
     bruteforce_mode_t bruteforce_mode;
     bruteforce_charset_t bruteforce_charset;
+    // continue from the flash checkpoint,  the other bruteforce fields are ignored
+    bool bruteforce_resume;
 } PACKED em4x50_data_t;
 
 typedef struct {
@@ -34,7 +34,7 @@ typedef struct {
     //        compilers is not guaranteed.
     // ISSUE: C99 has no _Static_assert() ... was added in C11
     // TODO: add _Static_assert(sizeof(bool)==1);
-    // TODO: add _Static_assert(sizeof(em4x70_data_t)==36);
+    // TODO: add _Static_assert(sizeof(em4x70_data_t)==40);
     bool parity;
 
     // Used for writing address
@@ -57,6 +57,9 @@ typedef struct {
     // ISSUE: Presumes target is little-endian
     uint16_t start_key;
 
+    // continue the bruteforce from the flash checkpoint
+    bool resume;
+
 } em4x70_data_t;
 
 #endif /* EM4X70_H__ */
@@ -62,6 +62,18 @@ typedef struct {
     uint8_t data[256];
 } PACKED lf_hitag_crack_response_t;
 
+// lf hitag sim --ht2,  collect > 0 gathers that many reader nR aR pairs
+typedef struct {
+    uint16_t collect;
+} PACKED lf_hitag2_sim_t;
+
+// one reply per new reader authentication while collecting
+typedef struct {
+    uint8_t uid[4];
+    uint8_t NrAr[8];
+    uint16_t count;
+} PACKED lf_hitag2_nrar_t;
+
 //---------------------------------------------------------
 // Hitag S
 //---------------------------------------------------------
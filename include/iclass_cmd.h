@@ -20,6 +20,7 @@
 #define _ICLASS_CMD_H_
 
 #include "common.h"
+#include "pm3_cmd.h"                // PM3_CMD_DATA_SIZE
 
 //-----------------------------------------------------------------------------
 // iCLASS / PICOPASS
@@ -80,6 +81,14 @@ typedef struct {
     uint8_t end_block;
 } PACKED iclass_dump_req_t;
 
+// CMD_HF_ICLASS_DUMP_BLOCKS,  dumped blocks sent while the dump is running
+#define ICLASS_DUMP_STREAM_BLOCKS   16
+typedef struct {
+    uint8_t start_block;
+    uint8_t count;
+    uint8_t data[];
+} PACKED iclass_dump_blocks_t;
+
 // iCLASS write block request data structure
 typedef struct {
     iclass_auth_req_t req;
@@ -93,18 +102,32 @@ typedef struct {
     uint8_t epurse[4];
 } PACKED iclass_credit_epurse_t;
 
+// iCLASS restore flags
+#define ICLASS_RESTORE_HOST_MAC     0x01    // block MACs computed by the client,  use them as given
+#define ICLASS_RESTORE_QUIET        0x02    // no print per block,  the results are in the reply
+
 // iCLASS dump data structure
 typedef struct {
     uint8_t blockno;
     uint8_t data[8];
+    uint8_t mac[4];
 } PACKED iclass_restore_item_t;
 
 typedef struct {
     iclass_auth_req_t req;
+    uint8_t flags;
     uint8_t item_cnt;
     iclass_restore_item_t blocks[];
 } PACKED iclass_restore_req_t;
 
+#define ICLASS_RESTORE_MAX_ITEMS    ((PM3_CMD_DATA_SIZE - sizeof(iclass_restore_req_t)) / sizeof(iclass_restore_item_t))
+
+// iCLASS restore response,  one bit per item set when its write was confirmed
+typedef struct {
+    uint8_t written;
+    uint8_t ok[(ICLASS_RESTORE_MAX_ITEMS + 7) / 8];
+} PACKED iclass_restore_resp_t;
+
 typedef struct iclass_premac {
     uint8_t mac[4];
 } PACKED iclass_premac_t;
@@ -49,6 +49,7 @@ typedef enum ISO14B_COMMAND {
     ISO14B_CLEARTRACE = (1 << 11),
     ISO14B_SELECT_XRX = (1 << 12),
     ISO14B_SELECT_PICOPASS = (1 << 13),
+    ISO14B_SELECT_PROBE = (1 << 14),
 } iso14b_command_t;
 
 typedef enum ISO14B_TYPE {
@@ -56,6 +57,7 @@ typedef enum ISO14B_TYPE {
     ISO14B_STANDARD = 1,
     ISO14B_SR = 2,
     ISO14B_CT = 4,
+    ISO14B_PICOPASS = 8,
 } iso14b_type_t;
 
 typedef struct {
@@ -71,6 +73,25 @@ typedef struct {
     uint8_t data[];
 } PACKED iso14b_raw_apdu_response_t;
 
+// ISO14B_SELECT_PROBE,  the selects are tried in this order
+#define ISO14B_PROBE_STD        0
+#define ISO14B_PROBE_SR         1
+#define ISO14B_PROBE_PICOPASS   2
+#define ISO14B_PROBE_CTS        3
+#define ISO14B_PROBE_COUNT      4
+
+typedef struct {
+    uint8_t type;                       // iso14b_type_t of the card which answered,  ISO14B_NONE if none
+    int8_t status[ISO14B_PROBE_COUNT];  // select result per variant,  PM3_ENODATA if not tried
+    uint8_t data[];                     // iso14b_card_select_t,  picopass_hdr_t or iso14b_cts_card_select_t
+} PACKED iso14b_probe_resp_t;
+
+// CMD_HF_SRI_DUMP,  blocks 0..lastblock and the system block (0xFF) in BigBuf
+typedef struct {
+    uint16_t blocks;
+    uint32_t bb_offset;
+} PACKED iso14b_srx_dump_resp_t;
+
 #define US_TO_SSP(x)   ( (int32_t) ((x) * 3.39) )
 #define SSP_TO_US(x)   ( (int32_t)((x) / 3.39) )
 
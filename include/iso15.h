@@ -44,6 +44,35 @@ typedef struct {
     uint8_t raw[];      // First byte in raw,  raw[0] is ISO15693 protocol flag byte
 } PACKED iso15_raw_cmd_t;
 
+#define ISO15_INVENTORY_MAX 32
+
+typedef struct {
+    uint8_t uid[8];     // as sent on air,  LSB first
+    uint8_t dsfid;
+} PACKED iso15_inventory_tag_t;
+
+typedef struct {
+    uint8_t count;
+    bool truncated;     // ISO15_INVENTORY_MAX tags found or masks left unresolved,  there may be more
+    iso15_inventory_tag_t tags[ISO15_INVENTORY_MAX];
+} PACKED iso15_inventory_t;
+
+typedef struct {
+    uint8_t flags;      // PM3 Flags - see iso15_command_t
+    uint8_t req_flags;  // ISO15693 protocol flag byte,  UID is sent when ISO15_REQ_ADDRESS is set
+    uint8_t uid[8];     // as sent on air,  LSB first
+    uint16_t block_cnt;
+    uint8_t block_size;
+} PACKED iso15_dump_req_t;
+
+typedef struct {
+    uint16_t block_cnt; // blocks read,  from block 0
+    uint8_t block_size;
+    uint8_t multi;      // max number of blocks which came in one READ MULTIPLE BLOCKS
+    uint8_t last_error; // tag error code which ended the dump,  0 when none
+    uint32_t bb_offset; // BigBuf offset of block_cnt entries of lock status byte + block data
+} PACKED iso15_dump_resp_t;
+
 #define ISO15693_TAG_MAX_PAGES 160 // in pages  (0xA0)
 #define ISO15693_TAG_MAX_SIZE 2048 // in byte (64 pages of 256 bits)
 
@@ -124,4 +124,42 @@ typedef struct {
     uint8_t PMi[8];
 } PACKED felica_auth2_response_t;
 
+// device side dump,  see felica_dump() in armsrc/felica.c
+#define FELICA_DUMP_MAX_SYSTEMS     8
+#define FELICA_DUMP_BUF             8192
+#define FELICA_DUMP_BLOCK_SIZE      16
+
+#define FELICA_DUMP_POLL_ONLY       (1 << 0)
+
+typedef struct {
+    uint8_t flags;
+    // system codes to poll,  0 = poll FFFF and ask the card (Request System Code)
+    uint8_t sc_count;
+    uint16_t sc[FELICA_DUMP_MAX_SYSTEMS];
+} PACKED felica_dump_req_t;
+
+typedef struct {
+    uint16_t code;
+    uint8_t IDm[8];
+    uint8_t PMm[8];
+} PACKED felica_dump_system_t;
+
+// one per service in the dump area,  followed by block_cnt blocks of 16 bytes
+typedef struct {
+    uint8_t system;             // index into systems[]
+    uint16_t code;              // service code,  bit 0 set = no authentication needed
+    uint16_t block_cnt;
+    uint8_t status[2];          // status flags which ended the read,  FF FF = no answer
+} PACKED felica_dump_service_t;
+
+typedef struct {
+    uint8_t count;
+    bool truncated;
+    uint16_t services;
+    uint8_t blocks_per_read;
+    uint32_t bb_offset;
+    uint32_t bb_len;
+    felica_dump_system_t systems[FELICA_DUMP_MAX_SYSTEMS];
+} PACKED felica_dump_resp_t;
+
 #endif // _ISO18_H_
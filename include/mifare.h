@@ -27,6 +27,9 @@
 #define MF_MAD1_SECTOR 0x00
 #define MF_MAD2_SECTOR 0x10
 
+// CMD_HF_MIFARE_CHKKEYS_FAST arg1 flag,  the client sends the next key chunk before the current one is answered
+#define MF_CHKKEYS_FAST_PIPELINED (1 << 16)
+
 //-----------------------------------------------------------------------------
 // Common types, used by client and ARM
 //-----------------------------------------------------------------------------
@@ -56,6 +59,45 @@ typedef struct {
     uint8_t ats[256];
 } PACKED iso14a_card_select_t;
 
+// For CMD_HF_ISO14443A_INVENTORY,  every card in the field selected and halted in turn
+#define ISO14A_INVENTORY_MAX    32
+
+typedef struct {
+    uint8_t uid[10];
+    uint8_t uidlen;
+    uint8_t atqa[2];
+    uint8_t sak;
+} PACKED iso14a_inventory_card_t;
+
+typedef struct {
+    uint8_t count;
+    bool truncated;     // ISO14A_INVENTORY_MAX cards found,  there may be more
+    iso14a_inventory_card_t cards[ISO14A_INVENTORY_MAX];
+} PACKED iso14a_inventory_t;
+
+#define ISO14A_APDU_BATCH_BUF   8192    // device side area for the responses of an APDU batch
+
+// APDU batch,  the request is followed by count times [uint16_t len][APDU]
+typedef struct {
+    uint16_t flags;         // iso14a_command_t,  ISO14A_CONNECT and ISO14A_NO_DISCONNECT are used
+    bool stop_on_error;     // stop at the first status word which isn't 9000, 61xx, 9100 or 91AF
+    uint8_t count;
+    uint8_t data[];
+} PACKED iso14a_apdu_batch_req_t;
+
+// one response in the BigBuf area of an APDU batch
+typedef struct {
+    int16_t status;         // PM3_SUCCESS or the error which ended the exchange
+    uint16_t len;
+    uint8_t data[];         // response APDU with status word,  chaining reassembled
+} PACKED iso14a_apdu_batch_entry_t;
+
+typedef struct {
+    uint8_t count;          // APDUs exchanged
+    uint32_t bb_offset;     // BigBuf offset of count iso14a_apdu_batch_entry_t
+    uint32_t bb_len;
+} PACKED iso14a_apdu_batch_resp_t;
+
 typedef struct {
     uint8_t uid[10];
     uint8_t uidlen;
@@ -154,6 +196,60 @@ typedef enum {
     MFDES_KDF_ALGO_GALLAGHER = 2,
 } mifare_des_kdf_algo_t;
 
+// CMD_HF_DESFIRE_CHKKEYS,  the request is followed by count keys of keylen bytes.
+// DES keys come as 2TDEA (key || key),  the host derives KDF keys.
+typedef struct {
+    uint8_t algo;           // mifare_des_authalgo_t,  MFDES_ALGO_3DES, MFDES_ALGO_3K3DES or MFDES_ALGO_AES
+    bool chain_iv;          // EV1,  the answer is enciphered on from the IV the challenge left
+    uint8_t rnda[16];
+    uint8_t authcmd[8];     // APDU which starts the authentication
+    uint8_t authcmdlen;
+    uint8_t count;
+    uint8_t keylen;
+    uint8_t keys[];
+} PACKED mfdes_chk_req_t;
+
+typedef struct {
+    uint8_t checked;        // keys tried
+    int16_t found;          // index of the key which authenticated,  -1 when none did
+    uint16_t sw;            // status word of a refused authentication start,  0 when all went through
+} PACKED mfdes_chk_resp_t;
+
+// CMD_HF_MIFAREPLUS_CHKKEYS,  SL3 AES keys of one sector.  The request is followed by count keys
+#define MFP_CHK_KEYS_MAX    28
+
+typedef struct {
+    uint8_t sector;
+    uint8_t keyab;          // bit 0 key A,  bit 1 key B
+    uint8_t rnda[16];
+    uint8_t count;
+    uint8_t keys[];
+} PACKED mfp_chk_req_t;
+
+typedef struct {
+    uint8_t checked;        // authentications done
+    int8_t found[2];        // index of the key A / key B found,  -1 when none
+    uint8_t error[2];       // card error to the first authentication step for key A / key B,  0 when none
+} PACKED mfp_chk_resp_t;
+
+// CMD_HF_DESFIRE_BRUTEAID,  select AIDs start, start + step, ... up to end
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t step;
+    uint8_t maxfound;       // stop after that many AIDs,  0 for no limit
+} PACKED mfdes_bruteaid_req_t;
+
+#define MFDES_BRUTEAID_REPLY_AIDS 16
+
+// streamed while the search runs,  the last one has done set
+typedef struct {
+    bool done;
+    uint32_t next;          // next AID to select
+    uint8_t count;
+    uint32_t aids[MFDES_BRUTEAID_REPLY_AIDS];
+} PACKED mfdes_bruteaid_resp_t;
+
 //-----------------------------------------------------------------------------
 // "hf 14a sim -x", "hf mf sim -x" attacks
 //-----------------------------------------------------------------------------
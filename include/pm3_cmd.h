@@ -152,6 +152,121 @@ typedef struct {
 #define TRACELOG_HDR_LEN        sizeof(tracelog_hdr_t)
 #define TRACELOG_PARITY_LEN(x)  (((x)->data_len - 1) / 8 + 1)
 
+// CMD_TRACE_STREAM payload,  whole trace records sent while sniffing
+typedef struct {
+    uint32_t dropped;   // records overwritten before they could be sent,  counted from the start of the sniff
+    uint8_t data[];
+} PACKED trace_stream_t;
+
+// Sniff parameter bits for the sniff commands supporting a ring trace
+// RING: overwrite the oldest records instead of stopping when the trace is full
+// STREAM: ring mode, and send finished records to the client as they come
+// COMPACT: compact trace encoding, see below.  Not combined with RING / STREAM
+#define SNIFF_PARAM_TRACE_COMPACT   0x20
+#define SNIFF_PARAM_TRACE_RING      0x40
+#define SNIFF_PARAM_TRACE_STREAM    0x80
+
+// hf 14a sniff timing mode: no trace,  no payload,  only the edges and length of each frame,
+// streamed as CMD_HF_ISO14443A_SNIFF_TIMING.  Not combined with the SNIFF_PARAM_TRACE_* bits
+#define SNIFF_PARAM_TIMING          0x10
+
+#define SNIFF_TIMING_RESPONSE       0x01    // tag -> reader
+
+typedef struct {
+    uint32_t sof;       // start of frame,  carrier periods (1/fc),  same clock as the trace timestamps
+    uint32_t eof;       // end of frame
+    uint16_t len;       // bytes,  a partial last byte included
+    uint8_t bits;       // data bits of the last byte,  0 when it is whole (7 for REQA / WUPA)
+    uint8_t flags;      // SNIFF_TIMING_*
+} PACKED sniff_timing_t;
+
+// CMD_HF_ISO14443A_SNIFF_TIMING payload
+typedef struct {
+    uint32_t dropped;   // records lost because the link couldn't keep up,  since the start of the sniff
+    uint16_t count;
+    sniff_timing_t rec[];
+} PACKED sniff_timing_chunk_t;
+
+#define SNIFF_TIMING_PER_CHUNK      ((PM3_CMD_DATA_SIZE - sizeof(sniff_timing_chunk_t)) / sizeof(sniff_timing_t))
+
+// hf 14a replay: the client turns a recorded trace into a script of reader command -> tag answer pairs
+// and loads it into emulator memory.  The script is an iso14a_replay_hdr_t followed by count entries,
+// each an iso14a_replay_entry_t followed by cmd_len command bytes and rsp_len answer bytes.
+#define ISO14A_REPLAY_MAGIC         0x59504C52  // RLPY
+#define ISO14A_REPLAY_MAX_SIZE      4096        // emulator memory
+#define ISO14A_REPLAY_MAX_FRAME     256         // command or answer bytes,  MAX_FRAME_SIZE on the device
+
+#define ISO14A_REPLAY_4BIT          0x01        // entry flag,  the answer is a 4 bit ACK / NACK
+
+// an answer this much after the recorded frame delay counts as late,  one FDT step
+#define ISO14A_REPLAY_LATE          128
+
+typedef struct {
+    uint32_t magic;
+    uint16_t count;     // entries
+    uint16_t length;    // bytes of the whole script,  header included
+} PACKED iso14a_replay_hdr_t;
+
+typedef struct {
+    uint32_t fdt;       // recorded frame delay,  end of the command to start of the answer,  1/fc
+    uint16_t cmd_len;
+    uint16_t rsp_len;   // 0 when the tag stayed silent
+    uint8_t flags;      // ISO14A_REPLAY_*
+} PACKED iso14a_replay_entry_t;
+
+// For CMD_HF_ISO14443A_REPLAY
+#define ISO14A_REPLAY_ASAP          0x01        // answer as soon as possible instead of at the recorded delay
+
+typedef struct {
+    uint8_t flags;
+    uint16_t passes;    // stop after the last entry was matched this often,  0 runs until button / client
+} PACKED iso14a_replay_param_t;
+
+// per entry,  streamed as CMD_HF_ISO14443A_REPLAY_STATS when the replay ends
+typedef struct {
+    uint32_t count;     // times the entry was matched
+    uint32_t late;      // answers more than ISO14A_REPLAY_LATE after the recorded delay
+    int32_t err_min;    // sent minus recorded frame delay,  1/fc
+    int32_t err_max;
+    int64_t err_sum;
+} PACKED iso14a_replay_stat_t;
+
+typedef struct {
+    uint16_t first;     // index of rec[0] in the script
+    uint16_t count;
+    iso14a_replay_stat_t rec[];
+} PACKED iso14a_replay_stats_chunk_t;
+
+#define ISO14A_REPLAY_STATS_PER_CHUNK   ((PM3_CMD_DATA_SIZE - sizeof(iso14a_replay_stats_chunk_t)) / sizeof(iso14a_replay_stat_t))
+
+// final CMD_HF_ISO14443A_REPLAY reply
+typedef struct {
+    uint32_t frames;        // reader frames decoded
+    uint32_t unmatched;     // frames not in the script,  left unanswered
+    uint32_t passes;        // times the last entry was matched
+    uint16_t count;         // script entries
+    uint16_t precomputed;   // answers modulated before the replay started,  the rest are encoded when due
+} PACKED iso14a_replay_result_t;
+
+// Compact trace encoding.  The trace starts with an 8 byte marker which can't be a sane tracelog_hdr_t,
+// then each record is
+//   flags byte,  TRACELOG_COMPACT_*
+//   varint  timestamp delta to the previous record (first record: absolute)
+//   varint  duration
+//   varint  data_len,  only when the flags length field is TRACELOG_COMPACT_LEN_VARINT
+//   data bytes
+//   parity bytes,  only with TRACELOG_COMPACT_PAR_RAW
+// varints are little endian base 128,  bit 7 set on all but the last byte.
+#define TRACELOG_COMPACT_MAGIC          "\xFF\xFF\xFF\xFF\xFF\xFF" "CT"
+#define TRACELOG_COMPACT_MAGIC_LEN      8
+#define TRACELOG_COMPACT_RESPONSE       0x80
+#define TRACELOG_COMPACT_PAR_MASK       0x60
+#define TRACELOG_COMPACT_PAR_NONE       0x00    // all parity bits zero
+#define TRACELOG_COMPACT_PAR_ODD        0x20    // odd parity of each data byte
+#define TRACELOG_COMPACT_PAR_RAW        0x40    // parity bytes stored
+#define TRACELOG_COMPACT_LEN_MASK       0x1F
+#define TRACELOG_COMPACT_LEN_VARINT     0x1F
+
 // T55XX - Extended to support 1 of 4 timing
 typedef struct  {
     uint16_t start_gap;
@@ -224,6 +339,23 @@ typedef struct {
     uint32_t time;
 } PACKED t55xx_test_block_t;
 
+// For CMD_LF_T55XX_BRUTE
+#define T55XX_BRUTE_MAX_CANDIDATES  16
+#define T55XX_BRUTE_ALL_DL          0x04
+
+typedef struct {
+    uint32_t start_pwd;
+    uint32_t count;
+    uint8_t flags;          // downlink mode,  T55XX_BRUTE_ALL_DL for all of them
+} PACKED t55xx_brute_req_t;
+
+typedef struct {
+    uint32_t tried;         // passwords done,  less than count when stopped early
+    uint8_t n;
+    uint32_t candidates[T55XX_BRUTE_MAX_CANDIDATES];
+    uint8_t downlink[T55XX_BRUTE_MAX_CANDIDATES];
+} PACKED t55xx_brute_resp_t;
+
 // For CMD_LF_HID_SIMULATE (FSK)
 typedef struct {
     uint32_t hi2;
@@ -268,6 +400,28 @@ typedef struct {
     uint8_t data[];
 } PACKED lf_nrzsim_t;
 
+// For CMD_LF_SIM_BRUTE,  a batch of candidate bitstreams simulated one after the other
+#define LF_SIM_BRUTE_FSK            0
+#define LF_SIM_BRUTE_ASK            1
+#define LF_SIM_BRUTE_PSK            2
+#define LF_SIM_BRUTE_MAX_BITS       256
+#define LF_SIM_BRUTE_MAX_COUNT      32
+
+typedef struct {
+    uint8_t modulation;     // LF_SIM_BRUTE_FSK / ASK / PSK
+    uint8_t fchigh;         // FSK
+    uint8_t fclow;          // FSK
+    uint8_t encoding;       // ASK,  as lf_asksim_t
+    uint8_t carrier;        // PSK
+    uint8_t invert;         // ASK
+    uint8_t separator;
+    uint8_t clock;
+    uint16_t dwell;         // ms each candidate is simulated
+    uint16_t bitslen;       // bits per candidate
+    uint8_t count;          // candidates in data[],  each packed msb first in (bitslen + 7) / 8 bytes
+    uint8_t data[];
+} PACKED lf_simbrute_t;
+
 typedef struct {
     uint8_t type;
     uint16_t len;
@@ -292,6 +446,86 @@ typedef struct {
     uint8_t key[6];
 } PACKED mf_readblock_t;
 
+// For CMD_HF_MIFARE_READCARD,  all sector keys in one request.  The device answers once per sector,
+// blocks is a bitmask of the blocks present in data.  Known keys are bitmasks over the sectors.
+#define MF_READCARD_MAX_SECTORS 40
+
+typedef struct {
+    uint8_t sectorcnt;
+    uint8_t known_a[(MF_READCARD_MAX_SECTORS + 7) / 8];
+    uint8_t known_b[(MF_READCARD_MAX_SECTORS + 7) / 8];
+    uint8_t keys[MF_READCARD_MAX_SECTORS][2][6];
+} PACKED mf_readcard_t;
+
+typedef struct {
+    uint8_t sector;
+    uint16_t blocks;
+    uint8_t data[16 * 16];
+} PACKED mf_readcard_sector_t;
+
+// For CMD_HF_MIFARE_READER,  darkside datasets collected in one call
+#define MF_DARKSIDE_MAX_SETS    4
+
+typedef struct {
+    uint8_t nt[4];
+    uint8_t par_list[8];
+    uint8_t ks_list[8];
+    uint8_t nr[4];
+    uint8_t ar[4];
+} PACKED mf_darkside_set_t;
+
+typedef struct {
+    int32_t isOK;
+    uint8_t cuid[4];
+    uint8_t count;
+    mf_darkside_set_t sets[MF_DARKSIDE_MAX_SETS];
+} PACKED mf_darkside_t;
+
+// For CMD_HF_MIFARE_CHKKEYS_STREAM,  the client sends key chunks without waiting for the replies
+#define MF_CHKKEYS_STREAM_FIRST         0x01
+#define MF_CHKKEYS_STREAM_LAST          0x02
+#define MF_CHKKEYS_STREAM_CLEARTRACE    0x04
+#define MF_CHKKEYS_STREAM_MAX_KEYS      ((PM3_CMD_DATA_SIZE - 4) / 6)
+
+typedef struct {
+    uint8_t keytype;
+    uint8_t blockno;
+    uint8_t flags;
+    uint8_t keycnt;
+    uint8_t keys[];
+} PACKED mf_chkkeys_stream_t;
+
+// For CMD_HF_MIFARE_STATIC_NESTED_CHK,  candidate keys are tested against the keystream of a static nonce card
+#define MF_STATIC_CHK_KEYSTREAM         0x01    // cuid / nt / ks given,  skip the nonce collection
+#define MF_STATIC_CHK_MAX_KEYS          ((PM3_CMD_DATA_SIZE - 33) / 6)
+
+typedef struct {
+    uint8_t cuid[4];
+    uint8_t nt_a[4];
+    uint8_t ks_a[4];
+    uint8_t nt_b[4];
+    uint8_t ks_b[4];
+} PACKED mf_static_keystream_t;
+
+typedef struct {
+    uint8_t block;
+    uint8_t keytype;
+    uint8_t key[6];
+    uint8_t target_block;
+    uint8_t target_keytype;
+    uint8_t flags;
+    mf_static_keystream_t ks;
+    uint16_t keycnt;
+    uint8_t keys[];
+} PACKED mf_static_nested_chk_t;
+
+typedef struct {
+    bool found;
+    uint8_t key[6];
+    uint16_t survivors;     // candidates which matched the keystream
+    mf_static_keystream_t ks;
+} PACKED mf_static_nested_chk_resp_t;
+
 typedef enum {
     MF_WAKE_NONE,
     MF_WAKE_WUPA, // 52(7) + anticoll
@@ -323,6 +557,84 @@ typedef struct {
     uint8_t keytype;
 } PACKED mfc_eload_t;
 
+// For CMD_HF_MIFARE_EML_LOAD_BULK,  an image is staged in BigBuf by DATA frames, which are not answered,
+// and copied into emulator memory by COMMIT once its CRC32 matches.  Only COMMIT replies.
+#define EML_BULK_BEGIN            0x01
+#define EML_BULK_DATA             0x02
+#define EML_BULK_COMMIT           0x03
+typedef struct {
+    uint8_t phase;
+    uint16_t offset;    // DATA: offset into the image
+    uint16_t length;    // BEGIN / COMMIT: image size,  DATA: bytes in data
+    uint8_t crc[4];     // COMMIT: CRC32 of the image
+    uint8_t data[];
+} PACKED eml_bulk_t;
+
+// For CMD_HF_MIFARE_MAGIC_LOAD_BULK,  the image is staged as for CMD_HF_MIFARE_EML_LOAD_BULK and the COMMIT
+// carries a mf_magic_bulk_t in data.  Blocks start..end are written in one backdoor session and read back.
+#define MF_MAGIC_BULK_GEN1A       0x01
+#define MF_MAGIC_BULK_GEN4        0x02
+typedef struct {
+    uint8_t type;       // MF_MAGIC_BULK_GEN1A / GEN4
+    uint8_t pwd[4];     // GEN4 password
+    uint16_t start;     // first block to write,  the image always starts at block 0
+    uint16_t end;       // last block to write
+} PACKED mf_magic_bulk_t;
+
+typedef struct {
+    uint16_t written;   // blocks written
+    uint16_t verified;  // blocks read back and matching
+    uint16_t block;     // block that failed,  if any
+} PACKED mf_magic_bulk_resp_t;
+
+// For CMD_HF_MIFAREU_READCARD_FAST,  pages come back in chunks as they are read
+#define MFU_READCARD_KEY_NONE     0
+#define MFU_READCARD_KEY_ULC      1
+#define MFU_READCARD_KEY_PWD      2
+typedef struct {
+    uint8_t start;      // first page
+    uint16_t pages;     // number of pages
+    uint8_t keytype;    // MFU_READCARD_KEY_*
+    uint8_t fast;       // try FAST_READ,  READ is used when the tag doesn't answer it
+    uint8_t key[16];    // UL-C key or EV1 / NTAG password
+} PACKED mfu_readcard_t;
+
+#define MFU_READCARD_DONE         0x01  // last reply,  page holds the number of pages read
+#define MFU_READCARD_FALLBACK     0x02  // FAST_READ failed,  rest read with READ
+typedef struct {
+    uint8_t flags;
+    uint16_t page;
+    uint8_t count;
+    uint8_t data[];
+} PACKED mfu_readcard_chunk_t;
+
+// For CMD_HF_MIFARE_EML_SNAPSHOT,  named copies of emulator memory kept in device RAM
+#define EML_SNAPSHOT_MAX          8
+#define EML_SNAPSHOT_NAME_LEN     16
+#define EML_SNAPSHOT_SAVE         0x01
+#define EML_SNAPSHOT_LOAD         0x02
+#define EML_SNAPSHOT_LIST         0x03
+#define EML_SNAPSHOT_CLEAR        0x04
+typedef struct {
+    uint8_t action;
+    uint16_t size;      // bytes from the start of emulator memory, SAVE only
+    char name[EML_SNAPSHOT_NAME_LEN];
+} PACKED eml_snapshot_req_t;
+
+// LIST replies with an array of these
+typedef struct {
+    uint16_t size;
+    char name[EML_SNAPSHOT_NAME_LEN];
+} PACKED eml_snapshot_info_t;
+
+// For CMD_HF_MIFARE_EML_CRC,  a CRC32 per chunk of emulator memory so clients can upload only what changed
+#define EML_CRC_MAX_CHUNKS        (PM3_CMD_DATA_SIZE / 4)
+typedef struct {
+    uint16_t offset;
+    uint16_t length;
+    uint16_t chunk;
+} PACKED eml_crc_req_t;
+
 typedef struct {
     uint8_t status;
     uint8_t CSN[8];
@@ -343,6 +655,37 @@ typedef struct {
     bool off;
 } PACKED tearoff_params_t;
 
+// CMD_MEASURE_ANTENNA_STREAM,  the device keeps measuring and reports min / max / mean
+// of every <batch> readings,  until <reports> are sent or it gets stopped
+#define ANTENNA_STREAM_LF               1   // own LF field at <divisor>
+#define ANTENNA_STREAM_HF               2   // own HF field
+#define ANTENNA_STREAM_LF_READER        3   // field of an external LF reader,  antenna not driven
+#define ANTENNA_STREAM_HF_READER        4   // field of an external HF reader
+#define ANTENNA_STREAM_FLAG_SAMPLES     0x01    // send the readings along with each report
+typedef struct {
+    uint8_t source;
+    uint8_t divisor;
+    uint8_t flags;
+    uint16_t interval_ms;   // between two readings,  0 for as fast as possible
+    uint16_t batch;         // readings per report
+    uint32_t reports;       // 0 until stopped
+} PACKED antenna_stream_t;
+
+// one report,  a report without payload ends the stream
+#define ANTENNA_STREAM_MAX_SAMPLES      240
+typedef struct {
+    uint32_t seq;
+    uint32_t ticks;         // device ms of the last reading
+    uint8_t source;
+    uint8_t shift;          // samples are mV >> shift
+    uint16_t count;         // readings in min / max / mean
+    uint16_t nsamples;
+    uint32_t min_mv;
+    uint32_t max_mv;
+    uint32_t mean_mv;
+    uint16_t samples[];     // the last nsamples readings of the batch
+} PACKED antenna_stream_report_t;
+
 // when writing to SPIFFS
 typedef struct {
     bool append : 1;
@@ -359,6 +702,96 @@ typedef struct {
     uint8_t data[PM3_CMD_DATA_SIZE - sizeof(uint32_t) - sizeof(uint16_t)];
 } PACKED flashmem_old_write_t;
 
+// Device side handler timings, see CMD_GET_TIMINGS.  Time spent in PacketReceived, in ms
+#define HANDLER_TIMING_SLOTS 32
+#define HANDLER_TIMING_FLAG_RESET 0x01
+typedef struct {
+    uint16_t cmd;
+    uint16_t max_ms;
+    uint32_t count;
+    uint32_t total_ms;
+} PACKED handler_timing_t;
+
+// Device side memory profile, see CMD_MEMPROF.  Per command peaks seen while in PacketReceived
+#define MEMPROF_SLOTS 30
+#define MEMPROF_FLAG_ENABLE  0x01
+#define MEMPROF_FLAG_DISABLE 0x02
+#define MEMPROF_FLAG_RESET   0x04
+typedef struct {
+    uint16_t cmd;
+    uint16_t peak_stack;     // bytes
+    uint32_t peak_bigbuf;    // bytes, allocations plus trace
+    uint32_t count;
+    uint32_t total_ms;
+} PACKED memprof_entry_t;
+
+typedef struct {
+    uint8_t enabled;
+    uint8_t num;
+    uint16_t stack_size;
+    uint32_t bigbuf_size;
+    memprof_entry_t entries[];
+} PACKED memprof_t;
+
+// RF decoder timing, final reply payload of sniff and sim when the firmware is built with DECODER_STATS=1
+// Times are in PIT ticks, 16 MCK cycles (1/3 us)
+#define DECODER_STATS_MILLER      0
+#define DECODER_STATS_MANCHESTER  1
+#define DECODER_STATS_15_TAG      2
+#define DECODER_STATS_15_READER   3
+#define DECODER_STATS_NUM         4
+typedef struct {
+    uint32_t calls;
+    uint32_t total;
+    uint32_t max;
+} PACKED decoder_stat_t;
+
+typedef struct {
+    decoder_stat_t dec[DECODER_STATS_NUM];
+    uint32_t overruns;     // SSC receive overruns, a sample was lost
+    uint32_t dma_lost;     // DMA ring buffer overflows
+    uint32_t max_backlog;  // deepest DMA backlog seen, in samples
+} PACKED decoder_stats_t;
+
+// For CMD_BATCH, payload is a uint8_t count followed by count sub-commands.
+// Each sub-command is a header followed by its payload,  for MIX the payload starts with 3 uint64_t args.
+typedef struct {
+    uint16_t cmd;
+    uint16_t length : 15;
+    bool ng : 1;
+    uint8_t data[];
+} PACKED batch_cmd_hdr_t;
+
+// The CMD_BATCH reply holds the replies of all sub-commands,  each a header followed by its payload.
+// Debug prints and WTX are not collected, they are sent as usual.
+typedef struct {
+    uint16_t cmd;
+    int16_t status;
+    uint16_t length : 15;
+    bool ng : 1;
+    uint8_t data[];
+} PACKED batch_reply_hdr_t;
+
+// For CMD_DOWNLOAD_BIGBUF_RAW, BigBuf bytes are streamed unframed followed by a CMD_ACK
+#define DOWNLOAD_RAW_FLAG_EML       0x01
+// With LZ4 the bytes come as framed CMD_DOWNLOADED_LZ4 chunks instead, for slow links
+#define DOWNLOAD_RAW_FLAG_LZ4       0x02
+typedef struct {
+    uint32_t startidx;
+    uint32_t len;
+    uint8_t flags;
+} PACKED download_raw_t;
+
+// CMD_DOWNLOADED_LZ4 payload,  one independent LZ4 block which decompresses to rawlen bytes at offset
+typedef struct {
+    uint32_t offset;
+    uint32_t rawlen;
+    uint8_t data[];
+} PACKED download_lz4_t;
+
+// CMD_SPIFFS_DOWNLOAD arg2
+#define SPIFFS_DOWNLOAD_FLAG_LZ4    0x01
+
 
 //-----------------------------------------------------------------------------
 // ISO 7618  Smart Card
@@ -377,15 +810,40 @@ typedef enum SMARTCARD_COMMAND {
     SC_CLEARLOG = (1 << 5),
     SC_LOG = (1 << 6),
     SC_WAIT = (1 << 7),
+    SC_GET_RESPONSE = (1 << 8),     // device follows 61xx / 9Fxx with GET RESPONSE,  whole answer in one reply
 } smartcard_command_t;
 
 typedef struct {
-    uint8_t flags;
+    uint16_t flags;
     uint32_t wait_delay;
     uint16_t len;
     uint8_t data[];
 } PACKED smart_card_raw_t;
 
+// CMD_SMART_I2C,  bus speed of the smart card module and its exchange statistics
+#define SMART_I2C_SPEED_KEEP    0
+#define SMART_I2C_SPEED_NORMAL  1
+#define SMART_I2C_SPEED_FAST    2
+
+typedef struct {
+    uint8_t speed;
+    bool reset_stats;
+} PACKED smart_i2c_req_t;
+
+typedef struct {
+    uint8_t speed;
+    uint16_t read_wait_us;      // wait before each read from the module
+    uint32_t exchanges;         // answers received from the card
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t errors;
+    uint32_t bytes_tx;
+    uint32_t bytes_rx;
+    uint32_t tx_us;             // on the bus,  writing
+    uint32_t rx_us;             // on the bus,  reading
+    uint32_t card_us;           // waiting while the module talks to the card
+} PACKED smart_i2c_stats_t;
+
 
 // For the bootloader
 #define CMD_DEVICE_INFO                                                   0x0000
@@ -395,6 +853,7 @@ typedef struct {
 #define CMD_START_FLASH                                                   0x0005
 #define CMD_CHIP_INFO                                                     0x0006
 #define CMD_BL_VERSION                                                    0x0007
+#define CMD_BL_FLASH_CRC                                                  0x0008
 #define CMD_NACK                                                          0x00fe
 #define CMD_ACK                                                           0x00ff
 
@@ -413,6 +872,8 @@ typedef struct {
 #define CMD_PING                                                          0x0109
 #define CMD_DOWNLOAD_EML_BIGBUF                                           0x0110
 #define CMD_DOWNLOADED_EML_BIGBUF                                         0x0111
+#define CMD_DOWNLOAD_BIGBUF_RAW                                           0x010C
+#define CMD_DOWNLOADED_LZ4                                                0x010D
 #define CMD_CAPABILITIES                                                  0x0112
 #define CMD_QUIT_SESSION                                                  0x0113
 #define CMD_SET_DBGMODE                                                   0x0114
@@ -422,6 +883,10 @@ typedef struct {
 #define CMD_BREAK_LOOP                                                    0x0118
 #define CMD_SET_TEAROFF                                                   0x0119
 #define CMD_GET_DBGMODE                                                   0x0120
+#define CMD_BATCH                                                         0x011A
+#define CMD_GET_TIMINGS                                                   0x011B
+#define CMD_TRACE_STREAM                                                  0x011C
+#define CMD_MEMPROF                                                       0x011D
 
 // RDV40, Flash memory operations
 #define CMD_FLASHMEM_WRITE                                                0x0121
@@ -478,6 +943,7 @@ typedef struct {
 #define CMD_SMART_ATR                                                     0x0143
 #define CMD_SMART_SETBAUD                                                 0x0144
 #define CMD_SMART_SETCLOCK                                                0x0145
+#define CMD_SMART_I2C                                                     0x0146
 
 // RDV40,  FPC USART
 #define CMD_USART_RX                                                      0x0160
@@ -546,6 +1012,8 @@ typedef struct {
 
 #define CMD_LF_T55XX_CHK_PWDS                                             0x0230
 #define CMD_LF_T55XX_DANGERRAW                                            0x0231
+#define CMD_LF_T55XX_BRUTE                                                0x0233
+#define CMD_LF_SIM_BRUTE                                                  0x0234
 
 
 // ZX8211
@@ -558,15 +1026,18 @@ typedef struct {
 #define CMD_HF_ISO15693_ACQ_RAW_ADC                                       0x0300
 #define CMD_HF_ACQ_RAW_ADC                                                0x0301
 #define CMD_HF_SRI_READ                                                   0x0303
+#define CMD_HF_SRI_DUMP                                                   0x0304
 #define CMD_HF_ISO14443B_COMMAND                                          0x0305
 #define CMD_HF_ISO15693_READER                                            0x0310
 #define CMD_HF_ISO15693_SIMULATE                                          0x0311
 #define CMD_HF_ISO15693_SNIFF                                             0x0312
 #define CMD_HF_ISO15693_COMMAND                                           0x0313
+#define CMD_HF_ISO15693_INVENTORY                                         0x0314
 #define CMD_HF_ISO15693_FINDAFI                                           0x0315
 #define CMD_HF_ISO15693_SLIX_ENABLE_PRIVACY                               0x0867
 #define CMD_HF_ISO15693_SLIX_DISABLE_PRIVACY                              0x0317
 #define CMD_HF_ISO15693_SLIX_DISABLE_EAS                                  0x0318
+#define CMD_HF_ISO15693_DUMP                                              0x0319
 #define CMD_HF_ISO15693_SLIX_ENABLE_EAS                                   0x0862
 #define CMD_HF_ISO15693_SLIX_PASS_PROTECT_AFI                             0x0863
 #define CMD_HF_ISO15693_SLIX_PASS_PROTECT_EAS                             0x0864
@@ -606,6 +1077,11 @@ typedef struct {
 #define CMD_HF_ISO14443A_SIMULATE                                         0x0384
 
 #define CMD_HF_ISO14443A_READER                                           0x0385
+#define CMD_HF_ISO14443A_INVENTORY                                        0x0386
+#define CMD_HF_ISO14443A_APDU_BATCH                                       0x038D
+#define CMD_HF_ISO14443A_SNIFF_TIMING                                     0x038E
+#define CMD_HF_ISO14443A_REPLAY                                           0x0390
+#define CMD_HF_ISO14443A_REPLAY_STATS                                     0x0395
 
 #define CMD_HF_LEGIC_SIMULATE                                             0x0387
 #define CMD_HF_LEGIC_READER                                               0x0388
@@ -630,12 +1106,14 @@ typedef struct {
 #define CMD_HF_ICLASS_CHKKEYS                                             0x039A
 #define CMD_HF_ICLASS_RESTORE                                             0x039B
 #define CMD_HF_ICLASS_CREDIT_EPURSE                                       0x039C
+#define CMD_HF_ICLASS_DUMP_BLOCKS                                         0x039D
 
 
 // For ISO1092 / FeliCa
 #define CMD_HF_FELICA_SIMULATE                                            0x03A0
 #define CMD_HF_FELICA_SNIFF                                               0x03A1
 #define CMD_HF_FELICA_COMMAND                                             0x03A2
+#define CMD_HF_FELICA_DUMP                                                0x03A3
 //temp
 #define CMD_HF_FELICALITE_DUMP                                            0x03AA
 #define CMD_HF_FELICALITE_SIMULATE                                        0x03AB
@@ -651,6 +1129,7 @@ typedef struct {
 #define CMD_MEASURE_ANTENNA_TUNING                                        0x0400
 #define CMD_MEASURE_ANTENNA_TUNING_HF                                     0x0401
 #define CMD_MEASURE_ANTENNA_TUNING_LF                                     0x0402
+#define CMD_MEASURE_ANTENNA_STREAM                                        0x0403
 #define CMD_LISTEN_READER_FIELD                                           0x0420
 #define CMD_HF_DROPFIELD                                                  0x0430
 
@@ -668,6 +1147,11 @@ typedef struct {
 #define CMD_HF_MIFARE_CGETBL                                              0x0606
 #define CMD_HF_MIFARE_CIDENT                                              0x0607
 
+#define CMD_HF_MIFARE_EML_SNAPSHOT                                        0x0608
+#define CMD_HF_MIFARE_EML_CRC                                             0x0609
+#define CMD_HF_MIFARE_EML_LOAD_BULK                                       0x060A
+#define CMD_HF_MIFARE_MAGIC_LOAD_BULK                                     0x060B
+
 #define CMD_HF_MIFARE_SIMULATE                                            0x0610
 
 #define CMD_HF_MIFARE_READER                                              0x0611
@@ -676,12 +1160,14 @@ typedef struct {
 #define CMD_HF_MIFARE_ACQ_NONCES                                          0x0614
 #define CMD_HF_MIFARE_STATIC_NESTED                                       0x0615
 #define CMD_HF_MIFARE_STATIC_ENC                                          0x0616
+#define CMD_HF_MIFARE_STATIC_NESTED_CHK                                   0x0617
 
 #define CMD_HF_MIFARE_READBL                                              0x0620
 #define CMD_HF_MIFARE_READBL_EX                                           0x0628
 #define CMD_HF_MIFAREU_READBL                                             0x0720
 #define CMD_HF_MIFARE_READSC                                              0x0621
 #define CMD_HF_MIFAREU_READCARD                                           0x0721
+#define CMD_HF_MIFAREU_READCARD_FAST                                      0x0735
 #define CMD_HF_MIFARE_WRITEBL                                             0x0622
 #define CMD_HF_MIFARE_WRITEBL_EX                                          0x0629
 #define CMD_HF_MIFARE_VALUE                                               0x0627
@@ -692,6 +1178,8 @@ typedef struct {
 #define CMD_HF_MIFARE_SETMOD                                              0x0624
 #define CMD_HF_MIFARE_CHKKEYS_FAST                                        0x0625
 #define CMD_HF_MIFARE_CHKKEYS_FILE                                        0x0626
+#define CMD_HF_MIFARE_CHKKEYS_STREAM                                      0x062A
+#define CMD_HF_MIFARE_READCARD                                            0x062B
 
 #define CMD_HF_MIFARE_SNIFF                                               0x0630
 #define CMD_HF_MIFARE_MFKEY                                               0x0631
@@ -712,10 +1200,13 @@ typedef struct {
 #define CMD_HF_DESFIRE_READER                                             0x072c
 #define CMD_HF_DESFIRE_INFO                                               0x072d
 #define CMD_HF_DESFIRE_COMMAND                                            0x072e
+#define CMD_HF_DESFIRE_CHKKEYS                                            0x072f
 
 #define CMD_HF_MIFARE_NACK_DETECT                                         0x0730
 #define CMD_HF_MIFARE_STATIC_NONCE                                        0x0731
 #define CMD_HF_MIFARE_STATIC_ENCRYPTED_NONCE                              0x0732
+#define CMD_HF_DESFIRE_BRUTEAID                                           0x0733
+#define CMD_HF_MIFAREPLUS_CHKKEYS                                         0x0734
 
 // MFU OTP TearOff
 #define CMD_HF_MFU_OTP_TEAROFF                                            0x0740
@@ -772,6 +1263,7 @@ typedef struct {
 #define FLAG_FORCED_ATQA        0x800
 #define FLAG_FORCED_SAK         0x1000
 #define FLAG_CVE21_0430         0x2000
+#define FLAG_NR_AR_STREAM       0x4000
 
 
 #define MODE_SIM_CSN        0
@@ -921,6 +1413,9 @@ typedef struct {
 /* Set if this device understands the read memory command */
 #define DEVICE_INFO_FLAG_UNDERSTANDS_READ_MEM        (1<<7)
 
+/* Set if this device understands the flash crc command */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_FLASH_CRC       (1<<8)
+
 #define BL_VERSION_MAJOR(version) ((uint32_t)(version) >> 22)
 #define BL_VERSION_MINOR(version) (((uint32_t)(version) >> 12) & 0x3ff)
 #define BL_VERSION_PATCH(version) ((uint32_t)(version) & 0xfff)
@@ -931,6 +1426,7 @@ typedef struct {
 #define BL_VERSION_INVALID  0
 // Different versions here. Each version should increase the numbers
 #define BL_VERSION_1_0_0    BL_MAKE_VERSION(1, 0, 0)
+#define BL_VERSION_1_1_0    BL_MAKE_VERSION(1, 1, 0)    // CMD_BL_FLASH_CRC
 
 /* CMD_READ_MEM_DOWNLOAD flags */
 #define READ_MEM_DOWNLOAD_FLAG_RAW                   (1<<0)
@@ -942,4 +1438,9 @@ typedef struct {
 
 #define START_FLASH_MAGIC 0x54494f44 // 'DOIT'
 
+/* CMD_BL_FLASH_CRC arguments: start address, number of blocks, block size.
+   The reply carries the number of blocks done in arg[0] and one little endian
+   CRC32 (as crc32_ex) per block in the data,  at most BL_FLASH_CRC_MAX_BLOCKS */
+#define BL_FLASH_CRC_MAX_BLOCKS   (PM3_CMD_DATA_SIZE / sizeof(uint32_t))
+
 #endif
@@ -29,6 +29,7 @@
 // 0x3D000 - 1 4kb sector = default T55XX keys dictionary
 // 0x3B000 - 1 4kb sector = default ICLASS keys dictionary
 // 0x38000 - 3 4kb sectors = default MFC keys dictionary
+// 0x37000 - 1 4kb sector = dictionary index
 //
 #ifndef FLASH_MEM_BLOCK_SIZE
 # define FLASH_MEM_BLOCK_SIZE   256
@@ -84,6 +85,48 @@
 # define DEFAULT_MF_KEYS_MAX ((DEFAULT_MF_KEYS_LEN - 2) / 6)
 #endif
 
+// Reserved space for the dictionary index = 4 kb
+// Each key dictionary section above is a 2 bytes key count followed by the keys. The client
+// writes them deduplicated and most hit keys first, the index tells which dictionary a section
+// was made from so hits found on device can be counted against it.
+#ifndef DEFAULT_DICT_INDEX_OFFSET
+# define DEFAULT_DICT_INDEX_LEN (0x1000)
+# define DEFAULT_DICT_INDEX_OFFSET (DEFAULT_MF_KEYS_OFFSET - DEFAULT_DICT_INDEX_LEN)
+#endif
+
+#define FLASH_DICT_MAGIC        0x44334D50  // "PM3D"
+#define FLASH_DICT_VERSION      1
+#define FLASH_DICT_NAME_LEN     32
+
+// section flags
+#define FLASH_DICT_DEDUP        0x01
+#define FLASH_DICT_SORTED       0x02
+
+typedef enum {
+    FLASH_DICT_MFC = 0,
+    FLASH_DICT_T55XX,
+    FLASH_DICT_ICLASS,
+    FLASH_DICT_SECTIONS
+} flash_dict_family_t;
+
+typedef struct {
+    uint32_t offset;        // start of the section, its key count
+    uint16_t count;         // copy of the section key count, stale when it differs
+    uint8_t keylen;
+    uint8_t flags;
+    uint16_t ranked;        // keys with recorded hits, at the start of the section
+    uint16_t reserved;
+    char name[FLASH_DICT_NAME_LEN];  // dictionary the section was made from
+} PACKED flash_dict_section_t;
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t sections;
+    uint16_t reserved;
+    flash_dict_section_t section[FLASH_DICT_SECTIONS];
+} PACKED flash_dict_index_t;
+
 // RDV40,  validation structure to help identifying that client/firmware is talking with RDV40
 typedef struct {
     uint8_t magic[4];
@@ -33,6 +33,7 @@
 #include <atomic>
 #include <mutex>
 #include "cryptolib.h"
+#include "cryptolib_vec.h"
 #include "util.h"
 
 #ifdef __cplusplus
@@ -357,97 +358,123 @@ static inline void sm_left_mask(const uint8_t *ks, uint8_t *mask, uint64_t rstat
 
 std::atomic<bool> key_found{0};
 std::atomic<uint64_t> key{0};
-std::atomic<size_t> g_topbits{0};
 std::mutex g_ice_mtx;
 static uint32_t g_num_cpus = std::thread::hardware_concurrency();
 
-static void ice_sm_right_thread(
-    uint8_t offset,
-    uint8_t skips,
-    const uint8_t *ks,
-    map<uint64_t, uint64_t> *bincstates,
-    uint8_t *mask
-) {
+// Hands out [first, last) chunks of 0..total to every thread from a shared
+// counter. Parts of the search space that die early just make a thread come
+// back sooner, so nobody waits at the join for a few slow static slices.
+// The work function returns false to stop taking chunks.
+static void run_chunked(uint64_t total, uint64_t chunk, const std::function<bool(uint64_t, uint64_t)> &work) {
+    std::atomic<uint64_t> next{0};
+
+    auto worker = [&]() {
+        for (;;) {
+            uint64_t first = next.fetch_add(chunk);
+            if (first >= total) break;
+            uint64_t last = (total - first > chunk) ? first + chunk : total;
+            if (work(first, last) == false) break;
+        }
+    };
 
-    uint8_t tmp_mask[16];
-    uint8_t bt;
+    uint32_t n = (g_num_cpus > 0) ? g_num_cpus : 1;
+    std::vector<std::thread> threads(n);
+    for (uint32_t m = 0; m < n; m++) {
+        threads[m] = std::thread(worker);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
 
-    for (uint64_t counter = offset; counter < 0x2000000; counter += skips) {
-        // Reset the current bitcount of correct bits
-        size_t bits = 0;
+// states base .. base + CRYPTORF_VEC_LANES - 1
+static inline crypto_vec_t vec_counter(uint64_t base) {
+    crypto_vec_t v;
+    for (int i = 0; i < CRYPTORF_VEC_LANES; i++) {
+        v[i] = base + i;
+    }
+    return v;
+}
 
-        // Copy the state we are going to test
-        uint64_t rstate = counter;
+// number of set bits of the low byte in every lane
+static inline crypto_vec_t vec_popcount8(crypto_vec_t x) {
+    x = x - ((x >> 1) & 0x55);
+    x = (x & 0x33) + ((x >> 2) & 0x33);
+    return (x + (x >> 4)) & 0x0f;
+}
 
-        for (uint8_t pos = 0; pos < 16; pos++) {
+static inline bool vec_any(crypto_vec_t v) {
+    uint64_t r = 0;
+    for (int i = 0; i < CRYPTORF_VEC_LANES; i++) {
+        r |= v[i];
+    }
+    return r != 0;
+}
 
-            next_right_fast(0, &rstate);
+static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t> *pcrstates) {
 
-            bt = next_right_fast(0, &rstate) << 4;
+    map<uint64_t, uint64_t> bincstates;
+    size_t topbits = 0;
+    uint64_t topstate = 0;
+    std::atomic<uint64_t> done{0};
 
-            next_right_fast(0, &rstate);
+    run_chunked(0x2000000, 0x10000, [&](uint64_t first, uint64_t last) {
+        vector<uint64_t> hits;
+        size_t local_topbits = 0;
+        uint64_t local_topstate = 0;
 
-            bt |= next_right_fast(0, &rstate);
+        for (uint64_t counter = first; counter < last; counter += CRYPTORF_VEC_LANES) {
+            crypto_vec_t rstate = vec_counter(counter);
+            crypto_vec_t wrong = {0};
 
-            // xor the bits with the keystream and count the "correct" bits
-            bt ^= ks[pos];
+            for (uint8_t pos = 0; pos < 16; pos++) {
+                crypto_vec_next_right(&rstate);
+                crypto_vec_t bt = crypto_vec_next_right(&rstate) << 4;
+                crypto_vec_next_right(&rstate);
+                bt |= crypto_vec_next_right(&rstate);
 
-            // Save the mask for the left produced bits
-            tmp_mask[pos] = bt;
+                // When the bit is xored away (=zero), it was the same, so correct ;)
+                wrong += vec_popcount8(bt ^ ks[pos]);
+            }
+
+            for (int i = 0; i < CRYPTORF_VEC_LANES; i++) {
+                size_t bits = 128 - wrong[i];
+
+                // lowest state wins a tie, like the single threaded search
+                if (bits > local_topbits) {
+                    local_topbits = bits;
+                    local_topstate = counter + i;
+                }
 
-            // When the bit is xored away (=zero), it was the same, so correct ;)
-            if ((bt & 0x01) == 0) bits++;
-            if (((bt >> 1) & 0x01) == 0) bits++;
-            if (((bt >> 2) & 0x01) == 0) bits++;
-            if (((bt >> 3) & 0x01) == 0) bits++;
-            if (((bt >> 4) & 0x01) == 0) bits++;
-            if (((bt >> 5) & 0x01) == 0) bits++;
-            if (((bt >> 6) & 0x01) == 0) bits++;
-            if (((bt >> 7) & 0x01) == 0) bits++;
+                // Ignore states under 90
+                if (bits >= 90) {
+                    hits.push_back((((uint64_t)bits) << 56) | (counter + i));
+                }
+            }
         }
 
         g_ice_mtx.lock();
-        if (bits > g_topbits.load(std::memory_order_relaxed)) {
-            // Copy the winning mask
-            g_topbits = bits;
-            memcpy(mask, tmp_mask, 16);
+        if (local_topbits > topbits || (local_topbits == topbits && local_topstate < topstate)) {
+            topbits = local_topbits;
+            topstate = local_topstate;
         }
-        g_ice_mtx.unlock();
-
-        // Ignore states under 90
-        if (bits >= 90) {
-            //  Make sure the bits are used for ordering
-            g_ice_mtx.lock();
-            if (bincstates->find((((uint64_t)bits) << 56) | counter) != bincstates->end())
-                bincstates->at((((uint64_t)bits) << 56) | counter) = counter;
-            else
-                bincstates->insert(std::pair<uint64_t, uint64_t>((((uint64_t)bits) << 56) | counter, counter));
-            g_ice_mtx.unlock();
+        //  Make sure the bits are used for ordering
+        for (auto h : hits) {
+            bincstates[h] = h & 0x1ffffff;
         }
-
-        if ((counter & 0xfffff) == 0) {
-            g_ice_mtx.lock();
+        if ((++done & 0xf) == 0) {
             printf(".");
             fflush(stdout);
-            g_ice_mtx.unlock();
         }
-    }
-}
-static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t> *pcrstates) {
-
-    map<uint64_t, uint64_t> bincstates;
-    g_topbits = 0;
-
-    std::vector<std::thread> threads(g_num_cpus);
-    for (uint32_t m = 0; m < g_num_cpus; m++) {
-        threads[m] = std::thread(ice_sm_right_thread, m, g_num_cpus, ks, &bincstates, mask);
-    }
-    for (auto &t : threads) {
-        t.join();
-    }
+        g_ice_mtx.unlock();
+        return true;
+    });
 
     printf("\n");
 
+    // Copy the winning mask
+    sm_left_mask(ks, mask, topstate);
+
     // Clear the candidate state vector
     pcrstates->clear();
 
@@ -460,105 +487,106 @@ static uint32_t ice_sm_right(const uint8_t *ks, uint8_t *mask, vector<uint64_t>
     // Reverse the vector order (so the highest bin comes first)
     reverse(pcrstates->begin(), pcrstates->end());
 
-    return g_topbits;
+    return topbits;
 }
 
-static void ice_sm_left_thread(
-    uint8_t offset,
-    uint8_t skips,
-    const uint8_t *ks,
-    map<uint64_t, cs_t> *bincstates,
-    const uint8_t *mask
-) {
-
-    size_t pos, bits;
-    uint8_t correct_bits[16];
-    uint8_t bt;
-    lookup_entry *lookup;
+// Clock the left states for the first bytes of keystream, lanes that get a
+// REQUIRED bit wrong are cleared in the returned mask
+static inline crypto_vec_t left_check(crypto_vec_t lstate, const uint8_t *ks, const uint8_t *mask, size_t bytes, crypto_vec_t *wrong) {
+    crypto_vec_t alive = ~(crypto_vec_t){0};
 
-    // Reset and initialize the cryptostate and vector
-    cs_t state;
-    memset(&state, 0x00, sizeof(cs_t));
-    state.invalid = false;
-
-    for (uint64_t counter = offset; counter < 0x800000000ull; counter += skips) {
-        uint64_t lstate = counter;
+    for (size_t pos = 0; pos < bytes; pos++) {
+        crypto_vec_next_left(&lstate);
+        crypto_vec_t bt = crypto_vec_next_left(&lstate) << 4;
+        crypto_vec_next_left(&lstate);
+        bt |= crypto_vec_next_left(&lstate);
 
-        for (pos = 0; pos < 16; pos++) {
-
-            lstate = (((lstate) >> 5) | ((uint64_t)left_addition[((lstate) & 0xf801f)] << 30));
-            lookup = &(lookup_left[((lstate) & 0xf801f)]);
-            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
-            bt = lookup->out << 4;
-            lstate = (((lstate) >> 5) | ((uint64_t)left_addition[((lstate) & 0xf801f)] << 30));
-            lookup = &(lookup_left[((lstate) & 0xf801f)]);
-            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
-            bt |= lookup->out;
+        // xor the bits with the keystream and count the "correct" bits
+        bt ^= ks[pos];
 
-            // xor the bits with the keystream and count the "correct" bits
-            bt ^= ks[pos];
+        // When the REQUIRED bits are NOT xored away (=zero), ignore this wrong state
+        alive &= (crypto_vec_t)((bt & mask[pos]) == 0);
+        if (vec_any(alive) == false) break;
 
-            // When the REQUIRED bits are NOT xored away (=zero), ignore this wrong state
-            if ((bt & mask[pos]) != 0) break;
+        if (wrong) *wrong += vec_popcount8(bt);
+    }
+    return alive;
+}
 
-            // Save the correct bits for statistical information
-            correct_bits[pos] = bt;
-        }
+// The left register is seven 5 bit cells. The first keystream byte only
+// depends on cells 1, 3, 4 and 6, the second one adds cells 0 and 5, cell 2
+// only counts from the third byte on. Filling the cells in that order drops
+// nearly every wrong state long before all 2^35 of them are clocked.
+#define LEFT_CELLS_A  0x100000
+#define LEFT_CHUNK    0x800
 
-        // If we have parsed all 16 bytes of keystream, we have a valid CANDIDATE!
-        if (pos == 16) {
-            // Count the total correct bits
-            bits = 0;
-            for (pos = 0; pos < 16; pos++) {
-                // Get the next byte-value with correct bits
-                bt = correct_bits[pos];
+static void ice_sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcstates) {
 
-                // Count all the (correct) bits
-                // When the bit is xored away (=zero), it was the same, so correct ;)
-                if ((bt & 0x01) == 0) bits++;
-                if (((bt >> 1) & 0x01) == 0) bits++;
-                if (((bt >> 2) & 0x01) == 0) bits++;
-                if (((bt >> 3) & 0x01) == 0) bits++;
-                if (((bt >> 4) & 0x01) == 0) bits++;
-                if (((bt >> 5) & 0x01) == 0) bits++;
-                if (((bt >> 6) & 0x01) == 0) bits++;
-                if (((bt >> 7) & 0x01) == 0) bits++;
+    map<uint64_t, cs_t> bincstates;
+    std::atomic<uint64_t> done{0};
+    const uint64_t chunks = LEFT_CELLS_A / LEFT_CHUNK;
+
+    printf("0.0%%.");
+    fflush(stdout);
+
+    run_chunked(LEFT_CELLS_A, LEFT_CHUNK, [&](uint64_t first, uint64_t last) {
+        vector<pair<uint64_t, uint64_t>> hits;
+
+        for (uint64_t a = first; a < last; a += CRYPTORF_VEC_LANES) {
+            // cells 1, 3, 4, 6
+            crypto_vec_t va = vec_counter(a);
+            crypto_vec_t la = ((va & 0x1f) << 5) | (((va >> 5) & 0x1f) << 15) | (((va >> 10) & 0x1f) << 20) | ((va >> 15) << 30);
+            crypto_vec_t alive_a = left_check(la, ks, mask, 1, NULL);
+
+            for (int i = 0; i < CRYPTORF_VEC_LANES; i++) {
+                if (alive_a[i] == 0) continue;
+
+                // cells 0, 5
+                for (uint64_t b = 0; b < 0x400; b += CRYPTORF_VEC_LANES) {
+                    crypto_vec_t vb = vec_counter(b);
+                    crypto_vec_t lb = la[i] | (vb & 0x1f) | ((vb >> 5) << 25);
+                    crypto_vec_t alive_b = left_check(lb, ks, mask, 2, NULL);
+
+                    for (int j = 0; j < CRYPTORF_VEC_LANES; j++) {
+                        if (alive_b[j] == 0) continue;
+
+                        // cell 2, all 16 bytes of keystream
+                        for (uint64_t c = 0; c < 0x20; c += CRYPTORF_VEC_LANES) {
+                            crypto_vec_t wrong = {0};
+                            crypto_vec_t lc = lb[j] | (vec_counter(c) << 10);
+                            crypto_vec_t alive_c = left_check(lc, ks, mask, 16, &wrong);
+
+                            for (int k = 0; k < CRYPTORF_VEC_LANES; k++) {
+                                if (alive_c[k]) {
+                                    hits.push_back(std::make_pair(128 - wrong[k], lc[k]));
+                                }
+                            }
+                        }
+                    }
+                }
             }
+        }
 
-            state.l = counter;
+        g_ice_mtx.lock();
+        for (auto h : hits) {
+            cs_t state;
+            memset(&state, 0x00, sizeof(cs_t));
+            state.invalid = false;
+            state.l = h.second;
 
             //  Make sure the bits are used for ordering
-            g_ice_mtx.lock();
+            bincstates[(h.first << 56) | h.second] = state;
             printf(".");
-            fflush(stdout);
-            if (bincstates->find((((uint64_t)bits) << 56) | counter) != bincstates->end())
-                bincstates->at((((uint64_t)bits) << 56) | counter) = state;
-            else
-                bincstates->insert(std::pair<uint64_t, cs_t>((((uint64_t)bits) << 56) | counter, state));
-            g_ice_mtx.unlock();
-
         }
 
-        if ((counter & 0xffffffffull) == 0) {
-            g_ice_mtx.lock();
-            printf("%02.1f%%.", ((float)100 / 8) * (counter >> 32));
-            fflush(stdout);
-            g_ice_mtx.unlock();
+        uint64_t n = ++done;
+        if (n % (chunks / 8) == 0 && n != chunks) {
+            printf("%02.1f%%.", ((float)100 / chunks) * n);
         }
-    }
-}
-
-static void ice_sm_left(const uint8_t *ks, uint8_t *mask, vector<cs_t> *pcstates) {
-
-    map<uint64_t, cs_t> bincstates;
-    std::vector<std::thread> threads(g_num_cpus);
-    for (uint32_t m = 0; m < g_num_cpus; m++) {
-        threads[m] = std::thread(ice_sm_left_thread, m, g_num_cpus, ks, &bincstates, mask);
-    }
-
-    for (auto &t : threads) {
-        t.join();
-    }
+        fflush(stdout);
+        g_ice_mtx.unlock();
+        return true;
+    });
 
     printf("100%%\n");
 
@@ -661,10 +689,8 @@ static inline void search_gc_candidates_right(const uint64_t rstate_before_gc, c
 }
 
 static inline void search_gc_candidates_left(const uint64_t lstate_before_gc, const uint8_t *Q, vector<cs_t> *pcstates) {
-    vector<cs_t> csl_cand, csl_search;
-    vector<cs_t>::iterator itsearch, itcand;
+    vector<cs_t> csl_cand;
     map<uint64_t, uint64_t> matchbox;
-    map<uint64_t, uint64_t>::iterator itmatch;
     uint64_t lstate;
     size_t counter;
 
@@ -684,42 +710,53 @@ static inline void search_gc_candidates_left(const uint64_t lstate_before_gc, co
     csl_cand = *pcstates;
     pcstates->clear();
 
-    for (itcand = csl_cand.begin(); itcand != csl_cand.end(); ++itcand) {
-        csl_search.clear();
-        csl_search.push_back(*itcand);
-
-        // Generate 2^20(+splitting) different (5 bits) values for the last 4 Gc bytes (4,5,6,7)
-        previous_left(Q[7], &csl_search);
-        previous_all_input(&csl_search, 7, CSS_LEFT);
-        previous_all_input(&csl_search, 6, CSS_LEFT);
-        previous_left(Q[6], &csl_search);
-        previous_all_input(&csl_search, 5, CSS_LEFT);
-        previous_all_input(&csl_search, 4, CSS_LEFT);
-
-        // Take the intersection of the corresponding states ~2^15 values (40-25 = 15 bits)
-        for (itsearch = csl_search.begin(); itsearch != csl_search.end(); ++itsearch) {
-            itmatch = matchbox.find(itsearch->l);
-            if (itmatch != matchbox.end()) {
-                itsearch->Gc[0] = (itmatch->second >> 15) & 0x1f;
-                itsearch->Gc[1] = (itmatch->second >> 10) & 0x1f;
-                itsearch->Gc[2] = (itmatch->second >>  5) & 0x1f;
-                itsearch->Gc[3] = itmatch->second & 0x1f;
-
-                pcstates->push_back(*itsearch);
+    // Every candidate is a task, how far it splits differs a lot between candidates
+    vector<vector<cs_t>> found(csl_cand.size());
+
+    run_chunked(csl_cand.size(), 1, [&](uint64_t first, uint64_t last) {
+        for (uint64_t i = first; i < last; i++) {
+            vector<cs_t> csl_search;
+            csl_search.push_back(csl_cand[i]);
+
+            // Generate 2^20(+splitting) different (5 bits) values for the last 4 Gc bytes (4,5,6,7)
+            previous_left(Q[7], &csl_search);
+            previous_all_input(&csl_search, 7, CSS_LEFT);
+            previous_all_input(&csl_search, 6, CSS_LEFT);
+            previous_left(Q[6], &csl_search);
+            previous_all_input(&csl_search, 5, CSS_LEFT);
+            previous_all_input(&csl_search, 4, CSS_LEFT);
+
+            // Take the intersection of the corresponding states ~2^15 values (40-25 = 15 bits)
+            for (auto itsearch = csl_search.begin(); itsearch != csl_search.end(); ++itsearch) {
+                auto itmatch = matchbox.find(itsearch->l);
+                if (itmatch != matchbox.end()) {
+                    itsearch->Gc[0] = (itmatch->second >> 15) & 0x1f;
+                    itsearch->Gc[1] = (itmatch->second >> 10) & 0x1f;
+                    itsearch->Gc[2] = (itmatch->second >>  5) & 0x1f;
+                    itsearch->Gc[3] = itmatch->second & 0x1f;
+
+                    found[i].push_back(*itsearch);
+                }
             }
+
+            g_ice_mtx.lock();
+            printf(".");
+            fflush(stdout);
+            g_ice_mtx.unlock();
         }
-        printf(".");
-        fflush(stdout);
-    }
+        return true;
+    });
     printf("\n");
+
+    // keep the candidate order of the single threaded search
+    for (auto &f : found) {
+        pcstates->insert(pcstates->end(), f.begin(), f.end());
+    }
 }
 
-void combine_valid_left_right_states(vector<cs_t> *plcstates, vector<cs_t> *prcstates, vector<uint64_t> *pgc_candidates) {
-    vector<cs_t>::iterator itl, itr;
-    size_t pos;
-    uint64_t gc;
-    bool valid;
+#define COMBINE_CHUNK 0x100
 
+void combine_valid_left_right_states(vector<cs_t> *plcstates, vector<cs_t> *prcstates, vector<uint64_t> *pgc_candidates) {
     vector<cs_t> outer, inner;
     if (plcstates->size() > prcstates->size()) {
         outer = *plcstates;
@@ -731,37 +768,48 @@ void combine_valid_left_right_states(vector<cs_t> *plcstates, vector<cs_t> *prcs
 
     printf("Outer  " _YELLOW_("%zu")" , inner " _YELLOW_("%zu") "\n", outer.size(), inner.size());
 
-    // Clean up the candidate list
-    pgc_candidates->clear();
-    for (itl = outer.begin(); itl != outer.end(); ++itl) {
-        for (itr = inner.begin(); itr != inner.end(); ++itr) {
-            valid = true;
-            // Check for left and right candidates that share the overlapping bits (8 x 2bits of Gc)
-            for (pos = 0; pos < 8; pos++) {
-                if ((itl->Gc[pos] & 0x18) != (itr->Gc[pos] & 0x18)) {
-                    valid = false;
-                    break;
+    vector<vector<uint64_t>> parts((outer.size() + COMBINE_CHUNK - 1) / COMBINE_CHUNK);
+
+    run_chunked(outer.size(), COMBINE_CHUNK, [&](uint64_t first, uint64_t last) {
+        vector<uint64_t> *part = &parts[first / COMBINE_CHUNK];
+
+        for (uint64_t o = first; o < last; o++) {
+            const cs_t *itl = &outer[o];
+            for (auto itr = inner.begin(); itr != inner.end(); ++itr) {
+                bool valid = true;
+                // Check for left and right candidates that share the overlapping bits (8 x 2bits of Gc)
+                for (size_t pos = 0; pos < 8; pos++) {
+                    if ((itl->Gc[pos] & 0x18) != (itr->Gc[pos] & 0x18)) {
+                        valid = false;
+                        break;
+                    }
                 }
-            }
 
-            if (valid) {
-                gc = 0;
-                for (pos = 0; pos < 8; pos++) {
-                    gc <<= 8;
-                    gc |= (itl->Gc[pos] | itr->Gc[pos]);
-                }
+                if (valid) {
+                    uint64_t gc = 0;
+                    for (size_t pos = 0; pos < 8; pos++) {
+                        gc <<= 8;
+                        gc |= (itl->Gc[pos] | itr->Gc[pos]);
+                    }
 
-                pgc_candidates->push_back(gc);
+                    part->push_back(gc);
+                }
             }
         }
+        return true;
+    });
+
+    // Clean up the candidate list
+    pgc_candidates->clear();
+    for (auto &p : parts) {
+        pgc_candidates->insert(pgc_candidates->end(), p.begin(), p.end());
     }
+
     printf("Found a total of " _YELLOW_("%llu")" combinations, ", ((unsigned long long)plcstates->size()) * prcstates->size());
     printf("but only " _GREEN_("%zu")" were valid!\n", pgc_candidates->size());
 }
 
 static void ice_compare(
-    uint8_t offset,
-    uint8_t skips,
     vector<uint64_t> *candidates,
     crypto_state_t *ostate,
     uint8_t *Ci,
@@ -769,37 +817,31 @@ static void ice_compare(
     uint8_t *Ch,
     uint8_t *Ci_1
 ) {
-    uint8_t Gc_chk[8] = {0};
-    uint8_t Ch_chk[8] = {0};
-    uint8_t Ci_1_chk[8] = {0};
-
-    crypto_state_t ls;
-    ls.b0 = ostate->b0;
-    ls.b1 = ostate->b1;
-    ls.b1l = ostate->b1l;
-    ls.b1r = ostate->b1r;
-    ls.b1s = ostate->b1s;
-    ls.l = ostate->l;
-    ls.m = ostate->m;
-    ls.r = ostate->r;
-
-    for (std::size_t i = offset; i < candidates->size(); i += skips) {
-        if (key_found.load(std::memory_order_relaxed))
-            break;
-
-        uint64_t tkey = candidates->at(i);
-        num_to_bytes(tkey, 8, Gc_chk);
-
-        sm_auth(Gc_chk, Ci, Q, Ch_chk, Ci_1_chk, &ls);
-        if ((memcmp(Ch_chk, Ch, 8) == 0) && (memcmp(Ci_1_chk, Ci_1, 8) == 0)) {
-            g_ice_mtx.lock();
-            key_found = true;
-            key = tkey;
-            g_ice_mtx.unlock();
-            break;
+    run_chunked(candidates->size(), 0x1000, [&](uint64_t first, uint64_t last) {
+        uint8_t Gc_chk[8] = {0};
+        uint8_t Ch_chk[8] = {0};
+        uint8_t Ci_1_chk[8] = {0};
+
+        crypto_state_t ls = *ostate;
+
+        for (uint64_t i = first; i < last; i++) {
+            if (key_found.load(std::memory_order_relaxed))
+                return false;
+
+            uint64_t tkey = candidates->at(i);
+            num_to_bytes(tkey, 8, Gc_chk);
+
+            sm_auth(Gc_chk, Ci, Q, Ch_chk, Ci_1_chk, &ls);
+            if ((memcmp(Ch_chk, Ch, 8) == 0) && (memcmp(Ci_1_chk, Ci_1, 8) == 0)) {
+                g_ice_mtx.lock();
+                key_found = true;
+                key = tkey;
+                g_ice_mtx.unlock();
+                return false;
+            }
         }
-    }
-    return;
+        return true;
+    });
 }
 
 int main(int argc, const char *argv[]) {
@@ -951,14 +993,7 @@ int main(int argc, const char *argv[]) {
 
         key_found = false;
         key = 0;
-        std::vector<std::thread> threads(g_num_cpus);
-        for (uint32_t m = 0; m < g_num_cpus; m++) {
-            threads[m] =  std::thread(ice_compare, m, g_num_cpus, &pgc_candidates, &ostate, ref(Ci), ref(Q), ref(Ch), ref(Ci_1));
-        }
-
-        for (auto &t : threads) {
-            t.join();
-        }
+        ice_compare(&pgc_candidates, &ostate, Ci, Q, Ch, Ci_1);
 
         if (key_found) {
             printf("\nValid key found [ " _GREEN_("%016" PRIx64)" ]\n\n", key.load());
@@ -1,35 +1,42 @@
 /*
  * ht2crack2buildtable.c
  * This builds the 1.2TB table and sorts it.
+ *
+ * The bucket buffer size and the thread count are taken from the machine at runtime,
+ * they can be overridden with -m and -t.  The build runs in rounds,  after every round
+ * all buckets are flushed and the state is saved in table/build.state,  so an
+ * interrupted build continues from the last round when started again in the same
+ * directory.  The sort takes the buckets from a shared counter and can be resumed too.
  */
 
 #include "ht2crackutils.h"
 #include <stdlib.h>
-
-// DATAMAX is the size of each bucket (bytes).  There are 65536 buckets so choose a value such that
-// DATAMAX * 65536 < RAM available.  For ex, if you want to use 12GB of RAM (for a 16GB machine
-// leaving some RAM free for OS and other stuff), DATAMAX = 12GB / 65536 = 196608.  Round this down
-// to a power of 10; DATAMAX = 196600.
-#define DATAMAX 196600 // around 192K rounded down to a power of 10
-
-// NUM_BUILD_THREADS and NUM_SORT_THREADS are the number of threads to run concurrently.  These should
-// ideally be equal to the number of virtual cores you have available.  A quad-core machine will
-// likely have 8 virtual cores, so set them to 8.
-//
-// If sorting fails with a 'bus error' then that is likely because your disk I/O can't keep up with
-// the read/write demands of the multi-threaded sorting.  In this case, reduce the number of sorting
-// threads.  This will most likely only be a problem with network disks; SATA should be okay;
-// USB2/3 should keep up.
-//
-// These MUST be a power of 2 for the maths to work - you have been warned!
-// Also, sort threads MUST be <= build threads or a horrible buffer overflow will happen!
-#define NUM_BUILD_THREADS 8
-#define NUM_SORT_THREADS 8
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <getopt.h>
 
 // DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
 // 6 bytes of PRNG state.
 #define DATASIZE 10
 
+// the table holds 2^TABLE_BITS entries,  2048 PRNG states apart
+#define TABLE_BITS 37
+
+// number of checkpoints during the build
+#define BUILD_ROUNDS 64
+
+// sorted buckets get an index with the first key of every INDEX_ENTRIES entries,  about one page
+#define INDEX_ENTRIES (4096 / DATASIZE)
+
+// smallest useful bucket buffer
+#define DATAMIN (1024 * DATASIZE)
+
+#define STATEFILE "table/build.state"
+#define STATEFILE_TMP "table/build.state.tmp"
+#define STATE_MAGIC "HT2BUILD"
+#define STATE_VERSION 1
+
 int debug = 0;
 
 // table entry for a bucket
@@ -38,12 +45,33 @@ struct table {
     pthread_mutex_t mutex;
     unsigned char *data;
     unsigned char *ptr;
+    uint64_t written;   // bytes in the bucket file
+};
+
+// build thread state
+struct builder {
+    int index;
+    Hitag_State hstate;
+    uint64_t done;      // entries made
+    uint64_t total;     // entries to make
+    uint64_t limit;     // entries to make in this round
 };
 
+// saved build state,  followed by nthreads x (shiftreg, done) and 65536 bucket file sizes
+struct state_hdr {
+    char magic[8];
+    uint32_t version;
+    uint32_t nthreads;
+    uint32_t table_bits;
+    uint32_t build_done;
+};
 
 // actual table
 struct table *t;
 
+// bucket buffer size (bytes),  a multiple of DATASIZE
+static size_t datamax;
+
 // jump table 1
 uint64_t d[48];
 int nsteps;
@@ -52,6 +80,54 @@ int nsteps;
 uint64_t d2[48];
 int nsteps2;
 
+// next bucket to sort
+static int sort_next = 0;
+
+static uint64_t physical_ram(void) {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pagesize = sysconf(_SC_PAGESIZE);
+    if (pages <= 0 || pagesize <= 0) {
+        return 0;
+    }
+    return (uint64_t)pages * (uint64_t)pagesize;
+}
+
+static int num_cores(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return (n > 0) ? (int)n : 1;
+}
+
+// write / read all of the data,  large requests may come back short
+static int write_all(int fd, const unsigned char *buf, uint64_t len) {
+    while (len) {
+        ssize_t n = write(fd, buf, (len > (1UL << 30)) ? (1UL << 30) : len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, unsigned char *buf, uint64_t len) {
+    while (len) {
+        ssize_t n = read(fd, buf, (len > (1UL << 30)) ? (1UL << 30) : len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
 // create table entry
 static void create_table(struct table *tt, int d_1, int d_2) {
     if (!tt) {
@@ -60,9 +136,9 @@ static void create_table(struct table *tt, int d_1, int d_2) {
     }
 
     // create some space
-    tt->data = (unsigned char *)calloc(1, DATAMAX);
+    tt->data = (unsigned char *)malloc(datamax);
     if (!(tt->data)) {
-        printf("create_table: cannot calloc data\n");
+        printf("create_table: cannot malloc data,  try a smaller -m\n");
         exit(1);
     }
 
@@ -116,18 +192,19 @@ static void free_tables(struct table *tt) {
 // write (partial) table to file
 static void writetable(struct table *t1) {
     int fd;
+    uint64_t len = t1->ptr - t1->data;
 
     if (debug) printf("writetable %s\n", t1->path);
 
     fd = open(t1->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd <= 0) {
+    if (fd < 0) {
         printf("writetable cannot open file %s for appending\n", t1->path);
         exit(1);
     }
 
     if (debug) printf("writetable %s opened\n", t1->path);
 
-    if (write(fd, t1->data, t1->ptr - t1->data) < (t1->ptr - t1->data)) {
+    if (write_all(fd, t1->data, len)) {
         printf("writetable cannot write all of the data\n");
         exit(1);
     }
@@ -135,6 +212,9 @@ static void writetable(struct table *t1) {
     if (debug) printf("writetable %s written\n", t1->path);
 
     close(fd);
+
+    t1->written += len;
+    t1->ptr = t1->data;
 }
 
 
@@ -163,19 +243,16 @@ static void store(unsigned char *data) {
     if (debug) printf("store, offset = %d, got lock\n", offset);
 
     // store the entry
-    memcpy(t1->ptr, data + 2, 10);
+    memcpy(t1->ptr, data + 2, DATASIZE);
 
     if (debug) printf("store, offset = %d, copied data\n", offset);
 
     // update the ptr
-    t1->ptr += 10;
+    t1->ptr += DATASIZE;
 
-    // check if table is full
-    if ((t1->ptr - t1->data) >= DATAMAX) {
-        // write the table to disk
+    // check if table is full,  write the table to disk
+    if ((size_t)(t1->ptr - t1->data) >= datamax) {
         writetable(t1);
-        // reset ptr
-        t1->ptr = t1->data;
     }
 
     if (debug) printf("store, offset = %d, after possible write\n", offset);
@@ -273,183 +350,371 @@ static void jumpnsteps(Hitag_State *hstate, int table) {
 
 
 // thread to build a part of the table
+//
+// thread i makes the entries i, i + n, i + 2n .. of the table,  n being the number of
+// threads,  so any thread count works.  It stops after b->limit entries,  the state is
+// kept in b for the next round.
 static void *buildtable(void *dd) {
-    Hitag_State hstate;
+    struct builder *b = (struct builder *)dd;
     Hitag_State hstate2;
-    unsigned long maxentries = 1;
-    int index = (int)(long)dd;
-    int tnum = NUM_BUILD_THREADS;
-
-    /* set random state */
-    hstate.shiftreg = 0x123456789abc;
-    buildlfsr(&hstate);
-
-    /* jump to offset using jump table 2 (2048) */
-    for (unsigned long i = 0; i < index; i++) {
-        jumpnsteps(&hstate, 2);
-    }
-
-    /* set max entries - this is a fraction of 2^37 depending on how many threads we are running.
-       1 thread  = 2^37
-       2 threads = 2^36
-       4 threads = 2^35
-       8 threads = 2^34
-       etc
-    */
-    maxentries = maxentries << 37;
-    while (!(tnum & 0x1)) {
-        maxentries = maxentries >> 1;
-        tnum = tnum >> 1;
-    }
 
     /* make the entries */
-    for (unsigned long i = 0; i < maxentries; i++) {
+    for (uint64_t i = 0; i < b->limit; i++) {
 
         // copy the current state
-        hstate2.shiftreg = hstate.shiftreg;
-        hstate2.lfsr = hstate.lfsr;
+        hstate2.shiftreg = b->hstate.shiftreg;
+        hstate2.lfsr = b->hstate.lfsr;
 
         // get 48 bits of keystream from hstate2
         // this is split into 2 x 24 bit
         uint32_t ks1 = hitag2_nstep(&hstate2, 24);
         uint32_t ks2 = hitag2_nstep(&hstate2, 24);
 
-        write_ks_s(ks1, ks2, hstate.shiftreg);
+        write_ks_s(ks1, ks2, b->hstate.shiftreg);
 
-        // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
-        // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
+        // jump hstate forward 2048 * nthreads states using di table
+        // this is because we're running nthreads threads at once, from nthreads
         // different offsets that are 2048 states apart.
-        jumpnsteps(&hstate, 1);
+        jumpnsteps(&b->hstate, 1);
     }
 
+    b->done += b->limit;
     return NULL;
 }
 
 
-// make 'table/' (unsorted) and 'sorted/' dir structures
+static void makedir(const char *path) {
+    if (mkdir(path, 0755) && errno != EEXIST) {
+        printf("cannot make dir %s\n", path);
+        exit(1);
+    }
+}
+
+// make 'table/' (unsorted) and 'sorted/' dir structures,  existing ones are kept
 static void makedirs(void) {
     char path[32];
     int i;
 
-    if (mkdir("table", 0755)) {
-        printf("cannot make dir table\n");
+    makedir("table");
+    makedir("sorted");
+
+    for (i = 0; i < 0x100; i++) {
+        snprintf(path, sizeof(path), "table/%02x", i);
+        makedir(path);
+        snprintf(path, sizeof(path), "sorted/%02x", i);
+        makedir(path);
+    }
+}
+
+
+// save the build state,  written to a temp file and renamed so a crash leaves the old one
+static void save_state(const struct builder *b, uint32_t nthreads, uint32_t table_bits, uint32_t build_done) {
+    struct state_hdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, STATE_MAGIC, sizeof(hdr.magic));
+    hdr.version = STATE_VERSION;
+    hdr.nthreads = nthreads;
+    hdr.table_bits = table_bits;
+    hdr.build_done = build_done;
+
+    size_t size = sizeof(hdr) + (nthreads * 2 * sizeof(uint64_t)) + (0x10000 * sizeof(uint64_t));
+    unsigned char *buf = (unsigned char *)calloc(1, size);
+    if (!buf) {
+        printf("save_state: cannot calloc\n");
         exit(1);
     }
-    if (mkdir("sorted", 0755)) {
-        printf("cannot make dir sorted\n");
+
+    uint64_t *p = (uint64_t *)(buf + sizeof(hdr));
+    memcpy(buf, &hdr, sizeof(hdr));
+    for (uint32_t i = 0; i < nthreads; i++) {
+        *p++ = b[i].hstate.shiftreg;
+        *p++ = b[i].done;
+    }
+    for (int i = 0; i < 0x10000; i++) {
+        *p++ = t[i].written;
+    }
+
+    int fd = open(STATEFILE_TMP, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write_all(fd, buf, size) || fsync(fd)) {
+        printf("cannot write %s\n", STATEFILE_TMP);
         exit(1);
     }
+    close(fd);
+    free(buf);
 
-    for (i = 0; i < 0x100; i++) {
-        snprintf(path, sizeof(path), "table/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
+    if (rename(STATEFILE_TMP, STATEFILE)) {
+        printf("cannot rename %s\n", STATEFILE_TMP);
+        exit(1);
+    }
+}
+
+// load the build state,  returns the builders or NULL if there is no state file
+static struct builder *load_state(uint32_t *nthreads, uint32_t *table_bits, uint32_t *build_done) {
+    struct state_hdr hdr;
+    struct stat filestat;
+
+    int fd = open(STATEFILE, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (fstat(fd, &filestat) || read_all(fd, (unsigned char *)&hdr, sizeof(hdr))
+            || memcmp(hdr.magic, STATE_MAGIC, sizeof(hdr.magic)) || hdr.version != STATE_VERSION) {
+        printf("%s is not a valid state file\n", STATEFILE);
+        exit(1);
+    }
+
+    size_t size = sizeof(hdr) + (hdr.nthreads * 2 * sizeof(uint64_t)) + (0x10000 * sizeof(uint64_t));
+    if ((uint64_t)filestat.st_size != size) {
+        printf("%s has the wrong size\n", STATEFILE);
+        exit(1);
+    }
+
+    uint64_t *p = (uint64_t *)malloc(size - sizeof(hdr));
+    struct builder *b = (struct builder *)calloc(hdr.nthreads, sizeof(struct builder));
+    if (!p || !b || read_all(fd, (unsigned char *)p, size - sizeof(hdr))) {
+        printf("cannot read %s\n", STATEFILE);
+        exit(1);
+    }
+    close(fd);
+
+    uint64_t *q = p;
+    for (uint32_t i = 0; i < hdr.nthreads; i++) {
+        b[i].index = i;
+        b[i].hstate.shiftreg = *q++;
+        buildlfsr(&b[i].hstate);
+        b[i].done = *q++;
+    }
+    for (int i = 0; i < 0x10000; i++) {
+        t[i].written = *q++;
+    }
+    free(p);
+
+    *nthreads = hdr.nthreads;
+    *table_bits = hdr.table_bits;
+    *build_done = hdr.build_done;
+    return b;
+}
+
+// drop whatever was appended after the last saved round
+static void truncate_tables(void) {
+    struct stat filestat;
+
+    for (int i = 0; i < 0x10000; i++) {
+        struct table *t1 = t + i;
+
+        if (stat(t1->path, &filestat)) {
+            if (t1->written == 0) {
+                continue;
+            }
+            printf("%s is missing,  cannot resume the build\n", t1->path);
             exit(1);
         }
-        snprintf(path, sizeof(path), "sorted/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
+
+        if ((uint64_t)filestat.st_size < t1->written) {
+            printf("%s is shorter than saved,  cannot resume the build\n", t1->path);
+            exit(1);
+        }
+
+        if ((uint64_t)filestat.st_size > t1->written && truncate(t1->path, t1->written)) {
+            printf("cannot truncate %s\n", t1->path);
             exit(1);
         }
     }
 }
 
-static int datacmp(const void *p1, const void *p2, void *dummy) {
+
+static int datacmp(const void *p1, const void *p2) {
     unsigned char *d_1 = (unsigned char *)p1;
     unsigned char *d_2 = (unsigned char *)p2;
 
     return memcmp(d_1, d_2, DATASIZE);
 }
 
+// sort one bucket,  entries are spread on their first byte and the 256 parts are sorted
+// on their own.  They are small enough to stay in cache.
+static void sortbucket(unsigned char *in, unsigned char *out, uint64_t numentries) {
+    uint64_t count[0x100] = {0};
+    uint64_t pos[0x100];
+
+    for (uint64_t i = 0; i < numentries; i++) {
+        count[in[i * DATASIZE]]++;
+    }
+
+    uint64_t sum = 0;
+    for (int i = 0; i < 0x100; i++) {
+        pos[i] = sum;
+        sum += count[i];
+    }
+
+    for (uint64_t i = 0; i < numentries; i++) {
+        unsigned char *e = in + (i * DATASIZE);
+        memcpy(out + (pos[e[0]]++ * DATASIZE), e, DATASIZE);
+    }
+
+    sum = 0;
+    for (int i = 0; i < 0x100; i++) {
+        qsort(out + (sum * DATASIZE), count[i], DATASIZE, datacmp);
+        sum += count[i];
+    }
+}
+
 static void *sorttable(void *dd) {
-    int i, j;
     int fdin;
     int fdout;
     char infile[64];
     char outfile[64];
-    unsigned char *data = NULL;
+    char tmpfile[64];
+    char idxfile[64];
     struct stat filestat;
-    int index = (int)(long)dd;
-    int space = 0x100 / NUM_SORT_THREADS;
+    unsigned char *in = NULL;
+    unsigned char *out = NULL;
+    size_t size = 0;
 
-    // create table - 50MB should be enough
-    unsigned char *table = (unsigned char *)calloc(1, 50UL * 1024UL * 1024UL);
-    if (!table) {
-        printf("sorttable: cannot calloc table\n");
-        exit(1);
-    }
+    (void)dd;
 
-    // loop over our first byte values
-    for (i = (index * space); i < ((index + 1) * space); i++) {
-        // loop over all second byte values
-        for (j = 0; j < 0x100; j++) {
+    for (;;) {
+        int index = __atomic_fetch_add(&sort_next, 1, __ATOMIC_SEQ_CST);
+        if (index >= 0x10000) {
+            break;
+        }
 
-            printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
+        int i = index >> 8;
+        int j = index & 0xff;
 
-            // open file, stat it and mmap it
-            snprintf(infile, sizeof(infile), "table/%02x/%02x.bin", i, j);
+        snprintf(infile, sizeof(infile), "table/%02x/%02x.bin", i, j);
+        snprintf(outfile, sizeof(outfile), "sorted/%02x/%02x.bin", i, j);
+        snprintf(tmpfile, sizeof(tmpfile), "sorted/%02x/%02x.tmp", i, j);
+        snprintf(idxfile, sizeof(idxfile), "sorted/%02x/%02x.idx", i, j);
 
-            fdin = open(infile, O_RDONLY);
-            if (fdin <= 0) {
-                printf("cannot open file %s\n", infile);
-                exit(1);
+        // open file and stat it,  a missing file was sorted by an earlier run
+        fdin = open(infile, O_RDONLY);
+        if (fdin < 0) {
+            if (stat(outfile, &filestat) == 0) {
+                continue;
             }
+            printf("cannot open file %s\n", infile);
+            exit(1);
+        }
 
-            if (fstat(fdin, &filestat)) {
-                printf("cannot stat file %s\n", infile);
-                exit(1);
-            }
+        printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
 
-            data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fdin, 0);
-            if (data == MAP_FAILED) {
-                printf("cannot mmap file %s\n", infile);
+        if (fstat(fdin, &filestat)) {
+            printf("cannot stat file %s\n", infile);
+            exit(1);
+        }
+
+        uint64_t numentries = filestat.st_size / DATASIZE;
+        uint64_t len = numentries * DATASIZE;
+
+        // buffers grow to the largest bucket
+        if (len > size) {
+            free(in);
+            free(out);
+            size = len;
+            in = (unsigned char *)malloc(size);
+            out = (unsigned char *)malloc(size);
+            if (!in || !out) {
+                printf("sorttable: cannot malloc %" PRIu64 " bytes\n", len);
                 exit(1);
             }
+        }
 
-            // copy data into table
-            memcpy(table, data, filestat.st_size);
-
-            uint64_t numentries = filestat.st_size / DATASIZE;
+        // one sequential read
+        if (read_all(fdin, in, len)) {
+            printf("cannot read file %s\n", infile);
+            exit(1);
+        }
+        close(fdin);
 
-            // unmap file and close it
-            if (munmap(data, filestat.st_size)) {
-                printf("cannot munmap %s\n", infile);
-                exit(1);
-            }
+        // sort it
+        sortbucket(in, out, numentries);
 
-            close(fdin);
+        // the index for ht2crack2search,  it is written first so a sorted file always has one
+        uint64_t idxnum = (numentries + INDEX_ENTRIES - 1) / INDEX_ENTRIES;
+        for (uint64_t n = 0; n < idxnum; n++) {
+            memcpy(in + (n * 4), out + (n * INDEX_ENTRIES * DATASIZE), 4);
+        }
+        fdout = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fdout < 0 || write_all(fdout, in, idxnum * 4)) {
+            printf("cannot write index %s\n", tmpfile);
+            exit(1);
+        }
+        close(fdout);
+        if (rename(tmpfile, idxfile)) {
+            printf("cannot rename %s\n", tmpfile);
+            exit(1);
+        }
 
-            // sort it
-            void *dummy = NULL; // clang
-            qsort_r(table, numentries, DATASIZE, datacmp, dummy);
+        // write to a temp file and rename it,  so there never is a partial sorted file
+        fdout = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fdout < 0) {
+            printf("cannot create outfile %s\n", tmpfile);
+            exit(1);
+        }
+        if (write_all(fdout, out, len)) {
+            printf("sorttable cannot write all of the data\n");
+            exit(1);
+        }
+        close(fdout);
 
-            // write to file
-            snprintf(outfile, sizeof(outfile), "sorted/%02x/%02x.bin", i, j);
-            fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
-            if (fdout <= 0) {
-                printf("cannot create outfile %s\n", outfile);
-                exit(1);
-            }
-            if (write(fdout, table, numentries * DATASIZE)) {
-                printf("writetable cannot write all of the data\n");
-                exit(1);
-            }
-            close(fdout);
+        if (rename(tmpfile, outfile)) {
+            printf("cannot rename %s\n", tmpfile);
+            exit(1);
+        }
 
-            // remove input file
-            if (unlink(infile)) {
-                printf("cannot remove file %s\n", infile);
-                exit(1);
-            }
+        // remove input file
+        if (unlink(infile)) {
+            printf("cannot remove file %s\n", infile);
+            exit(1);
         }
     }
 
+    free(in);
+    free(out);
     return NULL;
 }
 
+static void usage(const char *name) {
+    printf("%s [-t threads] [-m MB] [-b bits] [-d]\n", name);
+    printf("  -t  build / sort threads (def: number of cores)\n");
+    printf("  -m  memory for the bucket buffers in MB (def: 3/4 of the RAM)\n");
+    printf("  -b  table size, 2^bits entries (def: %d) - smaller tables for test runs only\n", TABLE_BITS);
+    printf("  -d  debug output\n");
+    printf("\nStarted again in the same directory, it continues an interrupted build or sort.\n");
+}
+
 int main(int argc, char *argv[]) {
-    pthread_t threads[NUM_BUILD_THREADS];
-    void *status;
+    uint32_t nthreads = num_cores();
+    uint32_t table_bits = TABLE_BITS;
+    uint32_t build_done = 0;
+    uint64_t memory = (physical_ram() / 4) * 3;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:m:b:dh")) != -1) {
+        switch (opt) {
+            case 't':
+                nthreads = strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                memory = strtoull(optarg, NULL, 0) * 1024 * 1024;
+                break;
+            case 'b':
+                table_bits = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                debug = 1;
+                break;
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (nthreads == 0 || nthreads > 1024 || table_bits < 16 || table_bits > TABLE_BITS) {
+        usage(argv[0]);
+        exit(1);
+    }
 
     // make the table of tables
     t = (struct table *)calloc(sizeof(struct table) * 65536, sizeof(uint8_t));
@@ -458,61 +723,150 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
-    // init the table
-    create_tables(t);
-
     // create the directories
     makedirs();
 
-    // build the jump table for incremental steps
-    builddi(2048 * NUM_BUILD_THREADS, 1);
+    // continue an earlier run,  it fixes the thread count and table size
+    struct builder *b = load_state(&nthreads, &table_bits, &build_done);
+    bool resumed = (b != NULL);
 
-    // build the jump table for setting the offset
-    builddi(2048, 2);
+    uint64_t entries = 1ULL << table_bits;
 
-    // start the threads
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
-        if (ret) {
-            printf("cannot start buildtable thread %ld\n", i);
-            exit(1);
+    // no bucket buffer larger than what a bucket gets in one round
+    uint64_t per_round = ((entries / 0x10000) * DATASIZE / BUILD_ROUNDS) * 5 / 4;
+    datamax = memory / 0x10000;
+    if (datamax > per_round) datamax = per_round;
+    datamax -= datamax % DATASIZE;
+    if (datamax < DATAMIN) datamax = DATAMIN;
+
+    if (build_done == 0) {
+        printf("building 2^%u entries with %u threads, %zu byte buckets (%" PRIu64 " MB)\n"
+               , table_bits, nthreads, datamax, ((uint64_t)datamax * 0x10000) >> 20);
+
+        // init the table,  the file sizes of a resumed run are kept
+        create_tables(t);
+
+        // build the jump table for incremental steps
+        builddi(2048 * nthreads, 1);
+
+        // build the jump table for setting the offset
+        builddi(2048, 2);
+
+        if (resumed) {
+            truncate_tables();
+        } else {
+            b = (struct builder *)calloc(nthreads, sizeof(struct builder));
+            if (!b) {
+                printf("malloc failed\n");
+                exit(1);
+            }
+
+            /* set random state,  thread i starts i x 2048 states further using jump table 2 */
+            Hitag_State hstate;
+            hstate.shiftreg = 0x123456789abc;
+            buildlfsr(&hstate);
+            for (uint32_t i = 0; i < nthreads; i++) {
+                b[i].index = i;
+                b[i].hstate = hstate;
+                jumpnsteps(&hstate, 2);
+            }
         }
-    }
 
-    if (debug) printf("main, started buildtable threads\n");
+        uint64_t chunk = 0;
+        for (uint32_t i = 0; i < nthreads; i++) {
+            b[i].total = (entries - i + nthreads - 1) / nthreads;
+            if (b[i].total > chunk) chunk = b[i].total;
+        }
+        chunk = (chunk + BUILD_ROUNDS - 1) / BUILD_ROUNDS;
 
-    // wait for threads to finish
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
-        if (ret) {
-            printf("cannot join buildtable thread %ld\n", i);
+        pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+        if (!threads) {
+            printf("malloc failed\n");
             exit(1);
         }
-        printf("buildtable thread %ld finished\n", i);
-    }
 
-    // write all remaining files
-    for (long i = 0; i < 0x10000; i++) {
-        struct table *t1 = t + i;
-        if (t1->ptr > t1->data) {
-            writetable(t1);
+        for (;;) {
+            uint64_t done = 0;
+            bool more = false;
+            for (uint32_t i = 0; i < nthreads; i++) {
+                uint64_t left = b[i].total - b[i].done;
+                b[i].limit = (left < chunk) ? left : chunk;
+                more |= (left > 0);
+                done += b[i].done;
+            }
+
+            if (more == false) {
+                break;
+            }
+
+            printf("buildtable: %" PRIu64 " of %" PRIu64 " entries (%.1f%%)\n", done, entries, (done * 100.0) / entries);
+
+            // start the threads
+            for (uint32_t i = 0; i < nthreads; i++) {
+                int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(b + i));
+                if (ret) {
+                    printf("cannot start buildtable thread %u\n", i);
+                    exit(1);
+                }
+            }
+
+            if (debug) printf("main, started buildtable threads\n");
+
+            // wait for threads to finish
+            for (uint32_t i = 0; i < nthreads; i++) {
+                int ret = pthread_join(threads[i], NULL);
+                if (ret) {
+                    printf("cannot join buildtable thread %u\n", i);
+                    exit(1);
+                }
+            }
+
+            // write all remaining data and save the round
+            for (long i = 0; i < 0x10000; i++) {
+                struct table *t1 = t + i;
+                if (t1->ptr > t1->data) {
+                    writetable(t1);
+                }
+            }
+            save_state(b, nthreads, table_bits, 0);
+        }
+
+        // buckets that got no entries (small test tables) still need a file to sort
+        for (long i = 0; i < 0x10000; i++) {
+            struct table *t1 = t + i;
+            if (t1->written == 0) {
+                writetable(t1);
+            }
         }
+
+        printf("buildtable finished\n");
+        save_state(b, nthreads, table_bits, 1);
+
+        // dump the memory
+        free(threads);
+        free_tables(t);
     }
 
-    // dump the memory
-    free_tables(t);
+    free(b);
     free(t);
 
 
 
     // now for the sorting
 
+    printf("sorting with %u threads\n", nthreads);
+
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    if (!threads) {
+        printf("malloc failed\n");
+        exit(1);
+    }
 
     // start the threads
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)(i));
+    for (uint32_t i = 0; i < nthreads; i++) {
+        int ret = pthread_create(&(threads[i]), NULL, sorttable, NULL);
         if (ret) {
-            printf("cannot start sorttable thread %ld\n", i);
+            printf("cannot start sorttable thread %u\n", i);
             exit(1);
         }
     }
@@ -520,20 +874,18 @@ int main(int argc, char *argv[]) {
     if (debug) printf("main, started sorttable threads\n");
 
     // wait for threads to finish
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
+    for (uint32_t i = 0; i < nthreads; i++) {
+        int ret = pthread_join(threads[i], NULL);
         if (ret) {
-            printf("cannot join sorttable thread %ld\n", i);
+            printf("cannot join sorttable thread %u\n", i);
             exit(1);
         }
-        printf("sorttable thread %ld finished\n", i);
+        printf("sorttable thread %u finished\n", i);
     }
+    free(threads);
 
-    pthread_exit(NULL);
+    // the table is complete
+    unlink(STATEFILE);
 
     return 0;
 }
-
-
-
-
@@ -7,20 +7,17 @@
 #include "ht2crackutils.h"
 
 #define INPUTFILE "sorted/%02x/%02x.bin"
+#define INDEXFILE "sorted/%02x/%02x.idx"
 #define DATASIZE 10
 
+// table entries per index slot,  about one page
+#define INDEX_ENTRIES (4096 / DATASIZE)
+
 struct rngdata {
     unsigned char *data;
     int len;
 };
 
-static int datacmp(const void *p1, const void *p2) {
-    unsigned char *d1 = (unsigned char *)p1;
-    unsigned char *d2 = (unsigned char *)p2;
-
-    return memcmp(d1, d2, DATASIZE - 6);
-}
-
 static int loadrngdata(struct rngdata *r, char *file) {
     int fd;
     int i, j;
@@ -152,26 +149,45 @@ static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
     }
 }
 
-static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
-    int fd;
-    struct stat filestat;
-    char file[64];
+// a keystream window to look up,  with the keystream 48 bits away to confirm a match
+struct cand {
+    unsigned char c[6];
+    unsigned char rt[6];
+    int fwd;
+    int bitoffset;
+};
+
+// one mapped table file,  with the sparse index when there is one
+struct tablefile {
     unsigned char *data;
-    unsigned char item[10];
-    unsigned char *found = NULL;
+    uint64_t num;           // entries
+    size_t size;
+    unsigned char *idx;     // first key of every INDEX_ENTRIES entries
+    size_t idxsize;
+    uint64_t idxnum;
+};
 
+static int candcmp(const void *p1, const void *p2) {
+    const struct cand *c1 = (const struct cand *)p1;
+    const struct cand *c2 = (const struct cand *)p2;
 
-    if (!c || !rt || !m || !s) {
-        printf("searchcand: invalid params\n");
-        return 0;
+    int res = memcmp(c1->c, c2->c, 6);
+    if (res) {
+        return res;
     }
+    return c1->bitoffset - c2->bitoffset;
+}
 
-    snprintf(file, sizeof(file), INPUTFILE, c[0], c[1]);
+static void *mapfile(const char *file, size_t *size) {
+    struct stat filestat;
+    void *data;
+    int fd;
+
+    *size = 0;
 
     fd = open(file, O_RDONLY);
-    if (fd <= 0) {
-        printf("cannot open table file %s\n", file);
-        exit(1);
+    if (fd < 0) {
+        return NULL;
     }
 
     if (fstat(fd, &filestat)) {
@@ -179,53 +195,169 @@ static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned cha
         exit(1);
     }
 
+    if (filestat.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
     data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     if (data == MAP_FAILED) {
         printf("cannot mmap file %s\n", file);
         exit(1);
     }
+    close(fd);
 
-    memcpy(item, c + 2, 4);
+    *size = filestat.st_size;
+    return data;
+}
 
-    found = (unsigned char *)bsearch(item, data, filestat.st_size / DATASIZE, DATASIZE, datacmp);
+static void opentable(struct tablefile *tf, unsigned char c0, unsigned char c1) {
+    char file[64];
 
-    if (found) {
+    memset(tf, 0, sizeof(struct tablefile));
 
-        // our candidate is in the table
-        // go backwards and see if there are other matches
-        while (((found - data) >= DATASIZE) && (!memcmp(found - DATASIZE, item, 4))) {
-            found = found - DATASIZE;
-        }
+    snprintf(file, sizeof(file), INPUTFILE, c0, c1);
+    if (access(file, R_OK)) {
+        printf("cannot open table file %s\n", file);
+        exit(1);
+    }
+
+    tf->data = (unsigned char *)mapfile(file, &tf->size);
+    tf->num = tf->size / DATASIZE;
+    if (tf->data == NULL) {
+        return;
+    }
 
-        // now test all matches
-        while (((found - data) <= (filestat.st_size - DATASIZE)) && (!memcmp(found, item, 4))) {
-            if (testcand(found, rt, fwd)) {
-                memcpy(m, c, 2);
-                memcpy(m + 2, found, 4);
-                memcpy(s, found + 4, 6);
+    // lookups jump around,  readahead would only load pages we don't need
+    madvise(tf->data, tf->size, MADV_RANDOM);
+
+    // the index is only used if it matches the table
+    snprintf(file, sizeof(file), INDEXFILE, c0, c1);
+    tf->idx = (unsigned char *)mapfile(file, &tf->idxsize);
+    tf->idxnum = tf->idxsize / 4;
+    if (tf->idx && tf->idxnum != (tf->num + INDEX_ENTRIES - 1) / INDEX_ENTRIES) {
+        munmap(tf->idx, tf->idxsize);
+        tf->idx = NULL;
+        tf->idxnum = 0;
+    }
+}
+
+static void closetable(struct tablefile *tf) {
+    if (tf->data) {
+        munmap(tf->data, tf->size);
+    }
+    if (tf->idx) {
+        munmap(tf->idx, tf->idxsize);
+    }
+    memset(tf, 0, sizeof(struct tablefile));
+}
 
-                munmap(data, filestat.st_size);
-                close(fd);
-                return 1;
+static uint32_t tablekey(const struct tablefile *tf, uint64_t n) {
+    const unsigned char *p = tf->data + (n * DATASIZE);
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// first entry in [lo, hi) with a key >= k,  hi if there is none
+static uint64_t lowerbound(const struct tablefile *tf, uint64_t lo, uint64_t hi, uint32_t k) {
+    while (lo < hi) {
+        uint64_t mid = lo + ((hi - lo) / 2);
+        if (tablekey(tf, mid) < k) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// first entry with a key >= k
+static uint64_t findfirst(const struct tablefile *tf, uint32_t k) {
+    uint64_t lo = 0;
+    uint64_t hi = tf->num;
+
+    if (tf->idx) {
+        // first index slot with a key >= k,  the entry is in the slot before or at its start
+        uint64_t blo = 0;
+        uint64_t bhi = tf->idxnum;
+        while (blo < bhi) {
+            uint64_t mid = blo + ((bhi - blo) / 2);
+            const unsigned char *p = tf->idx + (mid * 4);
+            uint32_t ik = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+            if (ik < k) {
+                blo = mid + 1;
+            } else {
+                bhi = mid;
             }
+        }
+        lo = (blo > 0) ? (blo - 1) * INDEX_ENTRIES : 0;
+        hi = (blo * INDEX_ENTRIES < tf->num) ? blo * INDEX_ENTRIES : tf->num;
+        return lowerbound(tf, lo, hi, k);
+    }
 
-            found = found + DATASIZE;
+    // no index,  the keys are close to uniform so start where k should be and widen
+    uint64_t pos = ((uint64_t)k * tf->num) >> 32;
+    uint64_t step = 1;
+    if (tablekey(tf, pos) < k) {
+        lo = pos;
+        while (lo + step < tf->num && tablekey(tf, lo + step) < k) {
+            lo += step;
+            step <<= 1;
         }
+        hi = (lo + step < tf->num) ? lo + step : tf->num;
+        return lowerbound(tf, lo + 1, hi, k);
     }
 
-    munmap(data, filestat.st_size);
-    close(fd);
+    hi = pos;
+    while (hi >= step && tablekey(tf, hi - step) >= k) {
+        hi -= step;
+        step <<= 1;
+    }
+    lo = (hi >= step) ? hi - step : 0;
+    return lowerbound(tf, lo, hi, k);
+}
+
+static int searchcand(const struct tablefile *tf, const struct cand *cd, unsigned char *m, unsigned char *s) {
+    unsigned char item[10];
+
+    if (!tf || !cd || !m || !s) {
+        printf("searchcand: invalid params\n");
+        return 0;
+    }
+
+    if (tf->num == 0) {
+        return 0;
+    }
+
+    memcpy(item, cd->c + 2, 4);
+    uint32_t k = ((uint32_t)item[0] << 24) | ((uint32_t)item[1] << 16) | ((uint32_t)item[2] << 8) | item[3];
+
+    // test all matches
+    for (uint64_t n = findfirst(tf, k); n < tf->num && tablekey(tf, n) == k; n++) {
+        const unsigned char *found = tf->data + (n * DATASIZE);
+        if (testcand(found, (unsigned char *)cd->rt, cd->fwd)) {
+            memcpy(m, cd->c, 2);
+            memcpy(m + 2, found, 4);
+            memcpy(s, found + 4, 6);
+            return 1;
+        }
+    }
 
     return 0;
 
 }
 
+// all windows are looked up in table order,  so every table file is mapped once.
+// The match at the lowest bit offset is returned.
 static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
     int i;
     int bitlen;
-    unsigned char cand[6];
-    unsigned char rngtest[6];
-    int fwd;
+    int num;
+    int files = 0;
+    struct cand *cands;
+    struct tablefile tf;
+    unsigned char m[6];
+    unsigned char s[6];
+    int found = 0;
 
     if (!r || !outmatch || !outstate || !bitoffset) {
         printf("findmatch: invalid params\n");
@@ -233,42 +365,81 @@ static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *
     }
 
     bitlen = r->len * 8;
+    if (bitlen < 96) {
+        printf("findmatch: need at least 96 bits of keystream\n");
+        return 0;
+    }
 
-    for (i = 0; i <= bitlen - 48; i++) {
-        // print progress
-        if ((i % 100) == 0) {
-            printf("searching on bit %d\n", i);
-        }
+    num = bitlen - 48 + 1;
+    cands = (struct cand *)calloc(num, sizeof(struct cand));
+    if (!cands) {
+        printf("cannot calloc\n");
+        exit(1);
+    }
+
+    for (i = 0; i < num; i++) {
+        struct cand *cd = cands + i;
 
-        if (!makecand(cand, r, i)) {
+        if (!makecand(cd->c, r, i)) {
             printf("cannot makecand, %d\n", i);
+            free(cands);
             return 0;
         }
-//        printf("cand: %02x %02x %02x %02x %02x %02x : ", cand[0], cand[1], cand[2], cand[3], cand[4], cand[5]);
-//        printbin(cand);
 
         /* make following or preceding RNG test data to confirm match */
         if (i < (bitlen - 96)) {
-            if (!makecand(rngtest, r, i + 48)) {
+            if (!makecand(cd->rt, r, i + 48)) {
                 printf("cannot makecand rngtest %d + 48\n", i);
+                free(cands);
                 return 0;
             }
-            fwd = 1;
+            cd->fwd = 1;
         } else {
-            if (!makecand(rngtest, r, i - 48)) {
+            if (!makecand(cd->rt, r, i - 48)) {
                 printf("cannot makecand rngtest %d - 48\n", i);
+                free(cands);
                 return 0;
             }
-            fwd = 0;
+            cd->fwd = 0;
         }
+        cd->bitoffset = i;
+    }
 
-        if (searchcand(cand, rngtest, fwd, outmatch, outstate)) {
-            *bitoffset = i;
-            return 1;
+    qsort(cands, num, sizeof(struct cand), candcmp);
+
+    printf("searching %d bit offsets\n", num);
+
+    memset(&tf, 0, sizeof(tf));
+    for (i = 0; i < num; i++) {
+        struct cand *cd = cands + i;
+
+        // a later offset can't beat the match we have
+        if (found && cd->bitoffset > *bitoffset) {
+            continue;
+        }
+
+        if (i == 0 || memcmp(cd->c, cands[i - 1].c, 2)) {
+            closetable(&tf);
+            opentable(&tf, cd->c[0], cd->c[1]);
+            files++;
+            if ((files % 100) == 0) {
+                printf("searching table file %d, %s\n", files, tf.idx ? "indexed" : "no index");
+            }
+        }
+
+        if (searchcand(&tf, cd, m, s)) {
+            memcpy(outmatch, m, 6);
+            memcpy(outstate, s, 6);
+            *bitoffset = cd->bitoffset;
+            found = 1;
         }
     }
+    closetable(&tf);
 
-    return 0;
+    printf("searched %d table files\n", files);
+
+    free(cands);
+    return found;
 }
 
 static void rollbackrng(Hitag_State *hstate, const unsigned char *s, int offset) {
@@ -354,8 +525,8 @@ int main(int argc, char *argv[]) {
     Hitag_State hstate;
     struct rngdata rng;
     int bitoffset = 0;
-    unsigned char rngmatch[6];
-    unsigned char rngstate[6];
+    unsigned char rngmatch[6] = {0};
+    unsigned char rngstate[6] = {0};
     char *uidstr;
     char *nRstr;
     uint64_t keyrev;
@@ -6,6 +6,7 @@
 
 #include "hitagcrypto.h"
 #include "ht2crackutils.h"
+#include "hitag2_bs.h"
 
 // max number of NrAr pairs to load - you only need 136 good pairs, but this
 // is the max
@@ -35,7 +36,7 @@ struct threaddata {
 };
 
 // macros to pick out 4 bits in various patterns of 1s & 2s & make a new number
-// these and the following hitag2_crypt function taken from Rfidler
+// these taken from Rfidler
 #define pickbits2_2(S, A, B)       ( ((S >> A) & 3) | ((S >> (B - 2)) & 0xC) )
 #define pickbits1x4(S, A, B, C, D) ( ((S >> A) & 1) | ((S >> (B - 1)) & 2) | \
                                    ((S >> (C - 2)) & 4) | ((S >> (D - 3)) & 8) )
@@ -47,22 +48,6 @@ struct threaddata {
                                    ((S >> (C - 3)) & 8) )
 
 
-static uint32_t hitag2_crypt(uint64_t s) {
-    const uint32_t ht2_function4a = 0x2C79; // 0010 1100 0111 1001
-    const uint32_t ht2_function4b = 0x6671; // 0110 0110 0111 0001
-    const uint32_t ht2_function5c = 0x7907287B; // 0111 1001 0000 0111 0010 1000 0111 1011
-    uint32_t bitindex;
-
-    bitindex = (ht2_function4a >> pickbits2_2(s, 1, 4)) & 1;
-    bitindex |= ((ht2_function4b << 1) >> pickbits1_1_2(s, 7, 11, 13)) & 0x02;
-    bitindex |= ((ht2_function4b << 2) >> pickbits1x4(s, 16, 20, 22, 25)) & 0x04;
-    bitindex |= ((ht2_function4b << 3) >> pickbits2_1_1(s, 27, 30, 32)) & 0x08;
-    bitindex |= ((ht2_function4a << 4) >> pickbits1_2_1(s, 33, 42, 45)) & 0x10;
-
-    return (ht2_function5c >> bitindex) & 1;
-}
-
-
 // this function is a modification of the filter function f, based heavily
 // on the hitag2_crypt function in Rfidler
 static int fnP(uint64_t klowery) {
@@ -123,8 +108,7 @@ static int is_kmiddle_badguess(uint64_t z, struct Tklower *Tk, int max, int aR0)
 
 // function to test if a partial key is valid
 static int testkey(uint64_t *out, uint64_t uid, uint64_t pkey, uint64_t nR, uint64_t aR) {
-    uint64_t kupper;
-    Hitag_State hstate;
+    uint64_t keys[HITAG2_BS_SLICES];
     uint32_t revaR;
     uint32_t normaR;
 
@@ -132,13 +116,15 @@ static int testkey(uint64_t *out, uint64_t uid, uint64_t pkey, uint64_t nR, uint
     revaR = rev32(aR);
     normaR = ((revaR >> 24) | ((revaR >> 8) & 0xff00) | ((revaR << 8) & 0xff0000) | (revaR << 24));
 
-    // search for remaining 14 bits
-    for (kupper = 0; kupper < 0x3fff; kupper++) {
-        uint64_t key = (kupper << 34) | pkey;
-        hitag2_init(&hstate, key, uid, nR);
-        uint64_t b = hitag2_nstep(&hstate, 32);
-        if ((normaR ^ b) == 0xffffffff) {
-            *out = key;
+    // search for remaining 14 bits, HITAG2_BS_SLICES guesses per pass
+    for (uint64_t kupper = 0; kupper < 0x4000; kupper += HITAG2_BS_SLICES) {
+        for (uint64_t i = 0; i < HITAG2_BS_SLICES; i++) {
+            keys[i] = ((kupper + i) << 34) | pkey;
+        }
+
+        int idx = hitag2_bs_check_keys(keys, HITAG2_BS_SLICES, (uint32_t)uid, (uint32_t)nR, normaR);
+        if (idx >= 0) {
+            *out = keys[idx];
             return 1;
         }
     }
@@ -178,8 +164,7 @@ static void *crack(void *d) {
     int i, j;
 
     uint64_t klower, kmiddle, klowery;
-    uint64_t y, b, z, bit;
-    uint64_t ytmp;
+    uint64_t y, z;
     uint64_t foundkey, revkey;
     int ret;
     unsigned int found;
@@ -207,38 +192,46 @@ static void *crack(void *d) {
         printf("trying klower = 0x%05"PRIx64"\n", klower);
         // build table
         unsigned int count = 0;
-        for (y = 0; y < 0x40000; y++) {
-            // create klowery
-            klowery = (y << 16) | klower;
-            // check for cases where right most bit of fc doesn't matter
 
-            if (fnP(klowery)) {
-                // store klowery
-                Tk[count].klowery = klowery;
-                // build the initial prng state
-                uint64_t shiftreg = (klower << 32) | uid;
-                // insert y into shiftreg and extract keystream, reversed order
-                b = 0;
-                ytmp = y;
-                for (j = 0; j < 2; j++) {
-                    shiftreg = shiftreg | ((ytmp & 0xffff) << 48);
-                    for (i = 0; i < 16; i++) {
-                        shiftreg = shiftreg >> 1;
-                        bit = hitag2_crypt(shiftreg);
-                        b = (b >> 1) | (bit << 31);
-                    }
-                    ytmp = ytmp >> 16;
-                }
+        // the initial prng state, the same for every y
+        hitag2_bs_t init[48];
+        hitag2_bs_broadcast(init, (klower << 32) | uid, 48);
 
-                // store the xor of y and b0-17
-                Tk[count].yxorb = y ^ (b & 0x3ffff);
+        // HITAG2_BS_SLICES values of y per pass
+        for (y = 0; y < 0x40000; y += HITAG2_BS_SLICES) {
+            hitag2_bs_state_t bs;
+            hitag2_bs_t ybits[18], b[18], zero = {0};
+            hitag2_bs_t notb32;
+
+            hitag2_bs_counter(ybits, y, 18);
+            hitag2_bs_load(&bs, init);
+
+            // insert y into shiftreg and extract keystream, b0-17 are kept
+            for (i = 0; i < 32; i++) {
+                hitag2_bs_t r = hitag2_bs_bit_in(&bs, (i < 18) ? ybits[i] : zero);
+                if (i < 18) {
+                    b[i] = r;
+                }
+            }
 
-                // get and store inverse of next bit from prng
-                // don't need to worry about shifting in the new bit because
-                // it doesn't affect the filter function anyway
-                shiftreg = shiftreg >> 1;
-                Tk[count].notb32 = hitag2_crypt(shiftreg) ^ 0x1;
+            // inverse of next bit from prng
+            // don't need to worry about shifting in the new bit because
+            // it doesn't affect the filter function anyway
+            notb32 = ~hitag2_bs_bit_in(&bs, zero);
+
+            for (j = 0; j < HITAG2_BS_SLICES; j++) {
+                // create klowery
+                klowery = ((y + j) << 16) | klower;
+                // check for cases where right most bit of fc doesn't matter
+                if (fnP(klowery) == 0) {
+                    continue;
+                }
 
+                // store klowery
+                Tk[count].klowery = klowery;
+                // store the xor of y and b0-17
+                Tk[count].yxorb = (y + j) ^ hitag2_bs_slice(b, 18, j);
+                Tk[count].notb32 = hitag2_bs_slice(&notb32, 1, j);
                 // increase count
                 count++;
             }
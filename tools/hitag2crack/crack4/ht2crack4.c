@@ -51,6 +51,7 @@
 #include <pthread.h>
 #include <getopt.h>
 #include "ht2crackutils.h"
+#include "hitag2_bs.h"
 
 /* you could have more than 32 traces, but you shouldn't really need
  * more than 16.  You can still win with 8 if you're lucky. */
@@ -822,15 +823,35 @@ int main(int argc, char *argv[]) {
 
     crack();
 
-    // test all key guesses and stop if one works
-    for (i = 0; i < num_guesses; i++) {
-        if (check_key(guesses[i].key, nonces[0].enc_nR, nonces[0].ks) &&
-                check_key(guesses[i].key, nonces[1].enc_nR, nonces[1].ks)) {
-            printf("WIN!!! :)\n");
-            revkey = rev64(guesses[i].key);
-            foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
-            printf("key = %012" PRIX64 "\n", foundkey);
-            exit(0);
+    // test all key guesses and stop if one works, the first nonce is
+    // checked HITAG2_BS_SLICES guesses at a time
+    uint64_t keys[HITAG2_BS_SLICES];
+
+    // rev32() only mirrors each byte, swap the bytes too to get the keystream word back
+    uint32_t revks = rev32(nonces[0].ks);
+    uint32_t aR0 = ~((revks >> 24) | ((revks >> 8) & 0xff00) | ((revks << 8) & 0xff0000) | (revks << 24));
+    for (i = 0; i < num_guesses; i += HITAG2_BS_SLICES) {
+        unsigned int n = num_guesses - i;
+        if (n > HITAG2_BS_SLICES) {
+            n = HITAG2_BS_SLICES;
+        }
+
+        for (unsigned int j = 0; j < n; j++) {
+            keys[j] = guesses[i + j].key;
+        }
+
+        unsigned int j = 0;
+        int idx;
+        while ((j < n) && ((idx = hitag2_bs_check_keys(keys + j, n - j, uid, nonces[0].enc_nR, aR0)) >= 0)) {
+            j += idx;
+            if (check_key(keys[j], nonces[1].enc_nR, nonces[1].ks)) {
+                printf("WIN!!! :)\n");
+                revkey = rev64(keys[j]);
+                foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
+                printf("key = %012" PRIX64 "\n", foundkey);
+                exit(0);
+            }
+            j++;
         }
     }
 
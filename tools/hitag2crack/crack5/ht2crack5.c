@@ -19,6 +19,7 @@
 #include <inttypes.h>
 #include <pthread.h>
 #include "ht2crackutils.h"
+#include "hitag2_bs.h"
 
 const uint8_t bits[9] = {20, 14, 4, 3, 1, 1, 1, 1, 1};
 #define lfsr_inv(state) (((state)<<1) | (__builtin_parityll((state) & ((0xce0044c101cd>>1)|(1ull<<(47))))))
@@ -45,9 +46,10 @@ __thread bitslice_t state[-2 + 32 + 48];
 bitslice_t keystream[32];
 bitslice_t bs_zeroes, bs_ones;
 
-#define f_a_bs(a,b,c,d)       (~(((a|b)&c)^(a|d)^b)) // 6 ops
-#define f_b_bs(a,b,c,d)       (~(((d|c)&(a^b))^(d|a|b))) // 7 ops
-#define f_c_bs(a,b,c,d,e)     (~((((((c^e)|d)&a)^b)&(c^b))^(((d^e)|a)&((d^b)|c)))) // 13 ops
+// filter functions shared with the other bitsliced Hitag2 code, 6, 7 and 13 ops
+#define f_a_bs HITAG2_BS_FA
+#define f_b_bs HITAG2_BS_FB
+#define f_c_bs HITAG2_BS_FC
 #define lfsr_bs(i) (state[-2+i+ 0].value ^ state[-2+i+ 2].value ^ state[-2+i+ 3].value ^ state[-2+i+ 6].value ^ \
                     state[-2+i+ 7].value ^ state[-2+i+ 8].value ^ state[-2+i+16].value ^ state[-2+i+22].value ^ \
                     state[-2+i+23].value ^ state[-2+i+26].value ^ state[-2+i+30].value ^ state[-2+i+41].value ^ \
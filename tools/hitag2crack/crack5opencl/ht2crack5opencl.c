@@ -33,6 +33,7 @@
 #include "threads.h"
 #include "opencl.h"
 #include "hitag2.h"
+#include "progress.h"
 #include "dolphin_macro.h"
 
 
@@ -84,6 +85,14 @@ static unsigned int profiles[11][2] = {
     { 16,   15 },
 };
 
+#define PROFILE_MAX 10
+
+// every candidate offset stands for 2^29 keys of the 2^48 key space
+#define KEYS_PER_OFFSET (1ULL << (48 - PROGRESS_OFFSET_BITS))
+
+// minimum time spent on each device/profile pair in benchmark mode
+#define BENCHMARK_MS 1000
+
 static uint64_t expand(uint64_t mask, uint64_t value) {
     uint64_t fill = 0;
 
@@ -143,6 +152,8 @@ static void usage(char *name) {
            "-P     : select the Profile, from 0 to 10. [Default: auto-tuning]\n"
            "-F     : force verify key with OpenCL instead of CPU. [Default: disabled]\n"
            "-Q     : select queue engine. 0: forward, 1: reverse, 2: random. [Default: 0]\n"
+           "-R     : save the job progress to this file and resume from it. [Default: disabled]\n"
+           "-B     : benchmark every profile on every selected device, then exit\n"
            "-s     : show the list of OpenCL platforms/devices, then exit\n"
            "-V     : enable debug messages\n"
            "-v     : show the version\n"
@@ -151,6 +162,9 @@ static void usage(char *name) {
     printf("Example, select devices 1, 2 and 3 using platform 1 and 2, with random queue engine:\n\n"
            "%s -D 2 -Q 2 -p 1,2 -d 1,2,3 2ab12bf2 4B71E49D 6A606453 D79BD94B 16A2255B\n\n", name);
 
+    printf("Example, resumable job (run the same command again after an interruption):\n\n"
+           "%s -R job.ht2c5 2ab12bf2 4B71E49D 6A606453 D79BD94B 16A2255B\n\n", name);
+
     exit(8);
 }
 
@@ -194,6 +208,114 @@ static bool parse_arg(char *restrict in, unsigned int *out, unsigned int *out_cn
     return true;
 }
 
+static double elapsed_ms(const struct timeval *start) {
+    struct timeval now, diff;
+    gettimeofday(&now, NULL);
+    timersub(&now, start, &diff);
+    return ((double) diff.tv_sec * 1000.0) + ((double) diff.tv_usec / 1000.0);
+}
+
+// run every profile on every device, one device at a time, and report the key space covered per second.
+// Slices are pulled from a shared queue by all devices, so the sum over devices of one profile
+// is what a real run with that profile (-P) gets
+static int run_benchmark(opencl_ctx_t *ctx, compute_platform_ctx_t *cd_ctx, size_t ocl_platform_cnt, size_t devices_cnt,
+                         uint64_t **matches, uint32_t **matches_found, unsigned int profile_auto) {
+    double total[PROFILE_MAX + 1] = { 0 };
+    size_t z = 0;
+
+    printf("Benchmark, %u ms per profile and device, Gkeys/s of the 2^48 key space\n\n", BENCHMARK_MS);
+
+    for (size_t w = 0; w < ocl_platform_cnt && z < devices_cnt; w++) {
+        if (!cd_ctx[w].selected) continue;
+
+        for (size_t q = 0; q < cd_ctx[w].device_cnt && z < devices_cnt; q++) {
+            if (!cd_ctx[w].device[q].selected) continue;
+
+            const size_t global_ws = ctx->global_ws[z];
+            const size_t local_ws = ctx->local_ws[z];
+            double best_rate = 0;
+            unsigned int best = 0;
+
+            printf("[%zu] %s\n", z, cd_ctx[w].device[q].name);
+
+            for (unsigned int p = 0; p <= PROFILE_MAX; p++) {
+                const uint32_t max_step = profiles[p][0];
+                const uint32_t chunk = profiles[p][1];
+
+                ctx->global_ws[z] = (size_t) 1 << chunk;
+                ctx->local_ws[z] = (local_ws > ctx->global_ws[z]) ? ctx->global_ws[z] : local_ws;
+
+                // first launch only warms up the device
+                if (runKernel(ctx, 0, matches[z], matches_found[z], z) < 0) {
+                    printf("    profile %2u : " _RED_("error") "\n", p);
+                    continue;
+                }
+
+                struct timeval start;
+                gettimeofday(&start, NULL);
+
+                uint32_t step = 1;
+                double ms = 0;
+                bool error = false;
+
+                for (; step < max_step; step++) {
+                    if (runKernel(ctx, step << chunk, matches[z], matches_found[z], z) < 0) {
+                        error = true;
+                        break;
+                    }
+
+                    ms = elapsed_ms(&start);
+                    if (ms >= BENCHMARK_MS && step >= 2) {
+                        step++;
+                        break;
+                    }
+                }
+
+                if (error || ms <= 0) {
+                    printf("    profile %2u : " _RED_("error") "\n", p);
+                    continue;
+                }
+
+                const double keys = (double)(step - 1) * (double)((uint64_t) 1 << chunk) * (double) KEYS_PER_OFFSET;
+                const double rate = keys / (ms / 1000.0);
+                const double full_s = (double)(1ULL << 48) / rate;
+
+                printf("    profile %2u : %12.2f Gkeys/s, %5u slice(s) of %.2f ms, key space in %.1f s\n"
+                       , p, rate / 1e9, max_step, ms / (double)(step - 1), full_s);
+                fflush(stdout);
+
+                total[p] += rate;
+
+                if (rate > best_rate) {
+                    best_rate = rate;
+                    best = p;
+                }
+            }
+
+            printf("    best profile: " _GREEN_("%u") ", auto-tuning selected %u\n\n", best, cd_ctx[w].device[q].profile);
+
+            ctx->global_ws[z] = global_ws;
+            ctx->local_ws[z] = local_ws;
+            z++;
+        }
+    }
+
+    if (devices_cnt > 1) {
+        unsigned int best = 0;
+
+        printf("All %zu devices, shared queue\n", devices_cnt);
+
+        for (unsigned int p = 0; p <= PROFILE_MAX; p++) {
+            printf("    profile %2u : %12.2f Gkeys/s, key space in %.1f s\n", p, total[p] / 1e9, (total[p] > 0) ? (double)(1ULL << 48) / total[p] : 0.0);
+            if (total[p] > total[best]) best = p;
+        }
+
+        printf("    best profile: " _GREEN_("%u") " (-P %u), auto-tuning selected %u\n\n", best, best, profile_auto);
+    }
+
+    return (z == devices_cnt) ? 0 : -1;
+}
+
 int main(int argc, char **argv) {
     opencl_ctx_t ctx;
 
@@ -209,13 +331,18 @@ int main(int argc, char **argv) {
     unsigned int thread_scheduler_type_selected = THREAD_TYPE_ASYNC;
     unsigned int profile_selected = 2;
     unsigned int queue_type = 0;
+    const char *resume_path = NULL;
+    bool benchmark = false;
+
+    progress_ctx_t progress;
+    memset(&progress, 0, sizeof(progress_ctx_t));
 
     uint32_t **matches_found = NULL;
     uint64_t **matches = NULL;
 
     int opt;
 
-    while ((opt = getopt(argc, argv, "p:d:D:S:P:F:Q:svVh")) != -1) {
+    while ((opt = getopt(argc, argv, "p:d:D:S:P:F:Q:R:BsvVh")) != -1) {
         switch (opt) {
             case 'p':
                 // 1, 2, 3, etc ..
@@ -255,6 +382,12 @@ int main(int argc, char **argv) {
                     usage(argv[0]);
                 }
                 break;
+            case 'R':
+                resume_path = optarg;
+                break;
+            case 'B':
+                benchmark = true;
+                break;
             case 's':
                 show = true;
                 break;
@@ -411,6 +544,14 @@ int main(int argc, char **argv) {
         }
     }
 
+    if (show == false && benchmark == false && resume_path) {
+        int ret = progress_init(&progress, resume_path, uid, nR1, aR1, nR2, aR2);
+        if (ret != PROGRESS_NOERROR) {
+            printf("Error: progress_init(%s) failed (%d): %s\n", resume_path, ret, progress_strerror(ret));
+            exit(2);
+        }
+    }
+
     memset(&ctx, 0, sizeof(opencl_ctx_t));
     memset(keystream, 0, sizeof(keystream));
     memset(candidates, 0, sizeof(candidates));
@@ -930,7 +1071,8 @@ int main(int argc, char **argv) {
                 continue;
             }
 
-            ctx.global_ws[z] = (1 << profiles[profile][1]);
+            // the benchmark reuses the buffers with every profile, size them for the largest one
+            ctx.global_ws[z] = (1 << profiles[(benchmark) ? PROFILE_MAX : profile][1]);
 
             // the following happens with cpu devices or Apple GPU
             if (ctx.local_ws[z] > 256) {
@@ -1094,6 +1236,16 @@ int main(int argc, char **argv) {
 
     // at this point z is the max value, still usefulfor free's
 
+    if (benchmark) {
+        int ret = run_benchmark(&ctx, cd_ctx, ocl_platform_cnt, selected_devices_cnt, matches, matches_found, profile);
+        z = selected_devices_cnt - 1;
+        MEMORY_FREE_OPENCL(ctx, z)
+        MEMORY_FREE_LIST_Z(matches, z)
+        MEMORY_FREE_LIST_Z(matches_found, z)
+        MEMORY_FREE_ALL
+        exit((ret == 0) ? 0 : 3);
+    }
+
 #if DEBUGME > 0
     printf("[debug] Lower profile between %zu device(s) is: %d\n", selected_devices_cnt, profile);
 #endif
@@ -1119,7 +1271,15 @@ int main(int argc, char **argv) {
     printf("[queue] Fill queue with pre-calculated offset using profile (%d): ", profile);
 #endif
 
+    size_t slices_done = 0;
+
     for (size_t step = 0; step < max_step; step++) {
+        // skip what a previous run of this job already searched
+        if (resume_path && progress_slice_done(&progress, step << chunk, chunk)) {
+            slices_done++;
+            continue;
+        }
+
         wu_queue_push(&ctx.queue_ctx, step, step << chunk, max_step);
     }
 
@@ -1127,6 +1287,13 @@ int main(int argc, char **argv) {
     printf("done\n");
 #endif
 
+    ctx.chunk = chunk;
+
+    if (resume_path) {
+        ctx.progress = &progress;
+        printf("Resume file '%s', %zu/%u slice(s) already searched\n", resume_path, slices_done, max_step);
+    }
+
     // save selected_devices_cnt
     size_t thread_count = selected_devices_cnt;
 
@@ -1315,6 +1482,18 @@ int main(int argc, char **argv) {
         }
     }
 
+    // threads are gone, the progress file can't change anymore
+    if (resume_path) {
+        // nothing left to resume once the key is found or every slice was searched
+        if (found || progress.units_done == PROGRESS_UNITS) {
+            progress_remove(&progress);
+        } else if (error == false) {
+            printf("\nSome slices failed, run the same command again to retry them\n");
+        }
+        progress_destroy(&progress);
+        ctx.progress = NULL;
+    }
+
 #if DEBUGME > 1
     printf("wu_queue_destroy\n");
     fflush(stdout);
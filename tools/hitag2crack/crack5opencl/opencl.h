@@ -35,6 +35,7 @@ License: GNU General Public License v3 or any later version (see LICENSE.txt)
 
 #include "ht2crack5opencl.h"
 #include "queue.h"
+#include "progress.h"
 #include <stdbool.h>
 
 #include <stdio.h>
@@ -112,12 +113,16 @@ typedef struct opencl_ctx {
     cl_mem *checks;                 // device memory used for uid, aR2, nR1, nR2
 
     wu_queue_ctx_t queue_ctx;
+    progress_ctx_t *progress;       // job progress file (-R), NULL if disabled
+
     bool profiling;
     unsigned char pad2[1];
     short thread_sched_type;
     bool force_hitag2_opencl;
 
     unsigned char pad3[3];
+    unsigned int chunk;             // a slice is (1 << chunk) candidate offsets
+    unsigned char pad4[4];
 
 } opencl_ctx_t;
 
@@ -0,0 +1,232 @@
+/****************************************************************************
+
+    Job progress file for ht2crack5opencl, so a killed job can be resumed.
+
+    License: GNU General Public License v3 or any later version (see LICENSE.txt)
+
+*****************************************************************************
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#include "progress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// file layout, all integers little endian:
+// magic[8] | version | uid | nR1 | aR1 | nR2 | aR2 | units | done bitmap (units / 8 bytes)
+#define PROGRESS_HEADER_SIZE (8 + (7 * 4))
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)(v);
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void progress_header(const progress_ctx_t *ctx, uint8_t *hdr) {
+    memcpy(hdr, PROGRESS_MAGIC, 8);
+    put_u32(hdr + 8, PROGRESS_VERSION);
+    put_u32(hdr + 12, ctx->uid);
+    put_u32(hdr + 16, ctx->nR1);
+    put_u32(hdr + 20, ctx->aR1);
+    put_u32(hdr + 24, ctx->nR2);
+    put_u32(hdr + 28, ctx->aR2);
+    put_u32(hdr + 32, PROGRESS_UNITS);
+}
+
+const char *progress_strerror(int error) {
+    switch (error) {
+        case PROGRESS_NOERROR:
+            return (const char *) "No error";
+        case PROGRESS_ERROR_CTX_IS_NULL:
+            return (const char *) "CTX IS NULL";
+        case PROGRESS_ERROR_MUTEX:
+            return (const char *) "INIT MUTEX FAILED";
+        case PROGRESS_ERROR_READ:
+            return (const char *) "READ FAILED";
+        case PROGRESS_ERROR_MISMATCH:
+            return (const char *) "FILE BELONGS TO ANOTHER JOB";
+        case PROGRESS_ERROR_WRITE:
+            return (const char *) "WRITE FAILED";
+    }
+
+    return (const char *) "GENERIC";
+}
+
+// load an existing progress file, a missing one is a fresh job
+static int progress_load(progress_ctx_t *ctx) {
+    FILE *fp = fopen(ctx->path, "rb");
+    if (!fp) {
+        return (errno == ENOENT) ? PROGRESS_NOERROR : PROGRESS_ERROR_READ;
+    }
+
+    uint8_t hdr[PROGRESS_HEADER_SIZE], expected[PROGRESS_HEADER_SIZE];
+    progress_header(ctx, expected);
+
+    if (fread(hdr, 1, sizeof(hdr), fp) != sizeof(hdr)) {
+        fclose(fp);
+        return PROGRESS_ERROR_READ;
+    }
+
+    if (memcmp(hdr, expected, sizeof(hdr)) != 0) {
+        fclose(fp);
+        return PROGRESS_ERROR_MISMATCH;
+    }
+
+    if (fread(ctx->done, 1, sizeof(ctx->done), fp) != sizeof(ctx->done)) {
+        fclose(fp);
+        return PROGRESS_ERROR_READ;
+    }
+
+    fclose(fp);
+
+    for (size_t i = 0; i < PROGRESS_UNITS; i++) {
+        if (ctx->done[i >> 3] & (1 << (i & 7))) ctx->units_done++;
+    }
+
+    return PROGRESS_NOERROR;
+}
+
+// write to a temporary file first, a job killed while saving keeps the previous state
+static int progress_save(progress_ctx_t *ctx) {
+    uint8_t hdr[PROGRESS_HEADER_SIZE];
+    progress_header(ctx, hdr);
+
+    FILE *fp = fopen(ctx->tmp_path, "wb");
+    if (!fp) return PROGRESS_ERROR_WRITE;
+
+    bool ok = (fwrite(hdr, 1, sizeof(hdr), fp) == sizeof(hdr));
+    ok = ok && (fwrite(ctx->done, 1, sizeof(ctx->done), fp) == sizeof(ctx->done));
+    ok = ok && (fflush(fp) == 0);
+#if !defined(_WIN32)
+    ok = ok && (fsync(fileno(fp)) == 0);
+#endif
+
+    if (fclose(fp) != 0) ok = false;
+
+    if (!ok) {
+        remove(ctx->tmp_path);
+        return PROGRESS_ERROR_WRITE;
+    }
+
+#if defined(_WIN32)
+    // rename() doesn't replace an existing file here
+    remove(ctx->path);
+#endif
+
+    if (rename(ctx->tmp_path, ctx->path) != 0) {
+        remove(ctx->tmp_path);
+        return PROGRESS_ERROR_WRITE;
+    }
+
+    return PROGRESS_NOERROR;
+}
+
+int progress_init(progress_ctx_t *ctx, const char *path, uint32_t uid, uint32_t nR1, uint32_t aR1, uint32_t nR2, uint32_t aR2) {
+    if (!ctx) return PROGRESS_ERROR_CTX_IS_NULL;
+
+    memset(ctx, 0, sizeof(progress_ctx_t));
+
+    ctx->uid = uid;
+    ctx->nR1 = nR1;
+    ctx->aR1 = aR1;
+    ctx->nR2 = nR2;
+    ctx->aR2 = aR2;
+
+    size_t len = strlen(path);
+    ctx->path = strdup(path);
+    ctx->tmp_path = (char *) calloc(len + 5, sizeof(char));
+    if (!ctx->path || !ctx->tmp_path) {
+        free(ctx->path);
+        free(ctx->tmp_path);
+        memset(ctx, 0, sizeof(progress_ctx_t));
+        return PROGRESS_ERROR_WRITE;
+    }
+
+    snprintf(ctx->tmp_path, len + 5, "%s.tmp", path);
+
+    int ret = progress_load(ctx);
+    if (ret != PROGRESS_NOERROR) {
+        free(ctx->path);
+        free(ctx->tmp_path);
+        memset(ctx, 0, sizeof(progress_ctx_t));
+        return ret;
+    }
+
+    if (pthread_mutex_init(&ctx->mutex, NULL) != 0) {
+        free(ctx->path);
+        free(ctx->tmp_path);
+        memset(ctx, 0, sizeof(progress_ctx_t));
+        return PROGRESS_ERROR_MUTEX;
+    }
+
+    return PROGRESS_NOERROR;
+}
+
+// a slice is done when every unit it covers is done, whatever profile did them
+bool progress_slice_done(progress_ctx_t *ctx, size_t off, unsigned int chunk) {
+    size_t first = off >> PROGRESS_UNIT_BITS;
+    size_t count = (chunk > PROGRESS_UNIT_BITS) ? ((size_t) 1 << (chunk - PROGRESS_UNIT_BITS)) : 1;
+
+    for (size_t i = first; i < first + count && i < PROGRESS_UNITS; i++) {
+        if (!(ctx->done[i >> 3] & (1 << (i & 7)))) return false;
+    }
+
+    return true;
+}
+
+int progress_set_slice_done(progress_ctx_t *ctx, size_t off, unsigned int chunk) {
+    size_t first = off >> PROGRESS_UNIT_BITS;
+    size_t count = (chunk > PROGRESS_UNIT_BITS) ? ((size_t) 1 << (chunk - PROGRESS_UNIT_BITS)) : 1;
+
+    pthread_mutex_lock(&ctx->mutex);
+
+    for (size_t i = first; i < first + count && i < PROGRESS_UNITS; i++) {
+        if (!(ctx->done[i >> 3] & (1 << (i & 7)))) {
+            ctx->done[i >> 3] |= (uint8_t)(1 << (i & 7));
+            ctx->units_done++;
+        }
+    }
+
+    int ret = progress_save(ctx);
+    if (ret != PROGRESS_NOERROR && !ctx->write_error) {
+        // warn once, the search itself is not affected
+        printf("\n! Warning: unable to write progress file '%s' (%d): %s\n", ctx->path, errno, strerror(errno));
+        fflush(stdout);
+        ctx->write_error = true;
+    }
+
+    pthread_mutex_unlock(&ctx->mutex);
+    return ret;
+}
+
+// the job is over (key found or key space exhausted), nothing left to resume
+void progress_remove(progress_ctx_t *ctx) {
+    if (!ctx || !ctx->path) return;
+    remove(ctx->path);
+}
+
+void progress_destroy(progress_ctx_t *ctx) {
+    if (!ctx || !ctx->path) return;
+
+    pthread_mutex_destroy(&ctx->mutex);
+    free(ctx->path);
+    free(ctx->tmp_path);
+    memset(ctx, 0, sizeof(progress_ctx_t));
+}
@@ -0,0 +1,74 @@
+/****************************************************************************
+
+    Job progress file for ht2crack5opencl, so a killed job can be resumed.
+
+    License: GNU General Public License v3 or any later version (see LICENSE.txt)
+
+*****************************************************************************
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+****************************************************************************/
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// the whole candidate space is (max_step << chunk) = 2^19 offsets with every profile.
+// Progress is tracked in units of the smallest slice (profile 0, 2^5 offsets),
+// so a job can be resumed with a different profile or device set
+#define PROGRESS_OFFSET_BITS    19
+#define PROGRESS_UNIT_BITS      5
+#define PROGRESS_UNITS          (1U << (PROGRESS_OFFSET_BITS - PROGRESS_UNIT_BITS))
+
+#define PROGRESS_MAGIC          "HT2C5JOB"
+#define PROGRESS_VERSION        1
+
+typedef enum progress_error {
+    PROGRESS_NOERROR = 0,
+    PROGRESS_ERROR_CTX_IS_NULL = -1,
+    PROGRESS_ERROR_MUTEX = -2,
+    PROGRESS_ERROR_READ = -3,
+    PROGRESS_ERROR_MISMATCH = -4,
+    PROGRESS_ERROR_WRITE = -5
+
+} progress_error_t;
+
+typedef struct progress_ctx {
+    char *path;
+    char *tmp_path;
+
+    // the job this file belongs to
+    uint32_t uid, nR1, aR1, nR2, aR2;
+
+    size_t units_done;
+    uint8_t done[PROGRESS_UNITS / 8];
+
+    bool write_error;
+    pthread_mutex_t mutex;
+
+} progress_ctx_t;
+
+int progress_init(progress_ctx_t *ctx, const char *path, uint32_t uid, uint32_t nR1, uint32_t aR1, uint32_t nR2, uint32_t aR2);
+bool progress_slice_done(progress_ctx_t *ctx, size_t off, unsigned int chunk);
+int progress_set_slice_done(progress_ctx_t *ctx, size_t off, unsigned int chunk);
+void progress_remove(progress_ctx_t *ctx);
+void progress_destroy(progress_ctx_t *ctx);
+
+const char *progress_strerror(int error);
+
+#endif // PROGRESS_H
@@ -24,6 +24,13 @@ License: GNU General Public License v3 or any later version (see LICENSE.txt)
 
 #include "threads.h"
 
+// record a slice searched without finding the key, for resume
+static void slice_done(const opencl_ctx_t *ctx, const wu_queue_data_t *wu) {
+    if (ctx->progress) {
+        progress_set_slice_done(ctx->progress, wu->off, ctx->chunk);
+    }
+}
+
 const char *thread_strerror(int error) {
     switch (error) {
         case THREAD_NOERROR:
@@ -184,8 +191,9 @@ int thread_start_scheduler(thread_ctx_t *ctx, thread_args_t *t_arg, wu_queue_ctx
 
     if (ctx->type == THREAD_TYPE_SEQ) {
         bool error = false;
-        uint32_t slice = 0;
-        for (slice = 0; slice < t_arg[0].max_slices; slice += ctx->thread_count) {
+
+        // one round starts a thread per device, each one takes a slice from the queue
+        while (wu_queue_done(queue_ctx) == 0) {
             int err = 0;
 
             if ((err = thread_start(ctx, t_arg)) != 0) {
@@ -267,7 +275,8 @@ int thread_start_scheduler(thread_ctx_t *ctx, thread_args_t *t_arg, wu_queue_ctx
                 if (cur_status == TH_WAIT) {
                     pthread_mutex_lock(&ctx->thread_mutexs[z]);
 
-                    if (wu_queue_done(queue_ctx) != QUEUE_EMPTY) {
+                    // hand the next slice to whichever device is idle, faster devices simply come back more often
+                    if (wu_queue_pop(queue_ctx, &t_arg[z].wu, false) == NO_ERROR) {
                         t_arg[z].status = TH_PROCESSING;
 
 #if TDEBUG >= 1
@@ -320,18 +329,9 @@ int thread_start_scheduler(thread_ctx_t *ctx, thread_args_t *t_arg, wu_queue_ctx
                         continue;
                     }
 
-                    // since found is handled before this part (line 237), removing the if-statement
-                    // doesn't change anything according to cppcheck.
-#if TDEBUG >= 1
-                    printf("[master] thread [%zu], the key is found. set TH_END from TH_PROCESSING\n", z);
-                    fflush(stdout);
-#endif
-                    pthread_mutex_lock(&ctx->thread_mutexs[z]);
-                    t_arg[z].status = TH_END;
-                    t_arg[z].quit = true;
-                    pthread_mutex_unlock(&ctx->thread_mutexs[z]);
+                    // still busy with its slice, a found key is handled at the top of the loop.
+                    // Ending it here would stop every device after its first slice
                     continue;
-
                 }
                 if (cur_status == TH_ERROR) {
                     // something went wrong
@@ -355,6 +355,9 @@ int thread_start_scheduler(thread_ctx_t *ctx, thread_args_t *t_arg, wu_queue_ctx
 
             if (th_cnt == ctx->thread_count) done = true;
 
+            // don't spin on the mutexes while every device is busy
+            if (!done && !ctx->enable_condusleep) usleep(100);
+
         } while (!done);
     }
 
@@ -505,7 +508,13 @@ void *computing_process(void *arg) {
     opencl_ctx_t *ctx = a->ocl_ctx;
 
     wu_queue_data_t wu;
-    wu_queue_pop(&ctx->queue_ctx, &wu, false);
+    if (wu_queue_pop(&ctx->queue_ctx, &wu, false) != NO_ERROR) {
+        // the other threads of this round took the last slices
+        a->r = false;
+        a->err = false;
+        pthread_exit(NULL);
+    }
+
     off = wu.off;
     a->slice = wu.id + 1;
 
@@ -533,6 +542,7 @@ void *computing_process(void *arg) {
 
     if (ret < 1) { // error or nada
         if (ret == -1) a->err = true;
+        else slice_done(ctx, &wu);
         pthread_exit(NULL);
     }
 
@@ -546,6 +556,8 @@ void *computing_process(void *arg) {
             a->r = try_state(matches[match], uid, aR2, nR1, nR2, &a->key);
             if (a->r) break;
         }
+
+        if (!a->r) slice_done(ctx, &wu);
     } else {
         // the OpenCL kernel return only one key if found, else nothing
 
@@ -580,7 +592,8 @@ void *computing_process_async(void *arg) {
     uint32_t nR1 = a->nR1;
     uint32_t nR2 = a->nR2;
 
-    size_t max_slices = a->max_slices;
+    wu_queue_data_t wu;
+    memset(&wu, 0, sizeof(wu_queue_data_t));
 
     opencl_ctx_t *ctx = a->ocl_ctx;
 
@@ -628,6 +641,7 @@ void *computing_process_async(void *arg) {
             pthread_cond_wait(&a->thread_ctx->thread_conds[z], &a->thread_ctx->thread_mutexs[z]);
 
             status = a->status; // read new status from master
+            wu = a->wu;         // and the work-unit that comes with TH_PROCESSING
 
 #if TDEBUG >= 2
             printf("[%s][%zu] master, got the signal with new state: %s.\n", __func__, z, thread_status_strdesc(status));
@@ -659,8 +673,6 @@ void *computing_process_async(void *arg) {
             fflush(stdout);
 #endif
 
-            wu_queue_data_t wu;
-            wu_queue_pop(&ctx->queue_ctx, &wu, false);
             uint32_t off = wu.off;
             a->slice = wu.id + 1;
 
@@ -713,10 +725,12 @@ void *computing_process_async(void *arg) {
                 printf("[%s][%zu] master, process is done but no candidates found\n", __func__, z);
                 fflush(stdout);
 #endif
+                slice_done(ctx, &wu);
+
+                // always back to the master, it knows when the queue is drained
                 pthread_mutex_lock(&a->thread_ctx->thread_mutexs[z]);
 
-                if (a->slice >= max_slices) a->status = TH_END;
-                else a->status = TH_WAIT;
+                a->status = TH_WAIT;
 
                 status = a->status;
 
@@ -814,6 +828,8 @@ void *computing_process_async(void *arg) {
                     pthread_exit(NULL);
                 }
 
+                slice_done(ctx, &wu);
+
                 // setting internal status to wait
                 status = TH_WAIT;
                 continue;
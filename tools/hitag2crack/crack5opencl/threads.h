@@ -29,6 +29,7 @@ License: GNU General Public License v3 or any later version (see LICENSE.txt)
 #include <stdarg.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include "ht2crack5opencl.h"
 #include "opencl.h"
@@ -117,6 +118,9 @@ typedef struct thread_arg {
 
     uint64_t key;
 
+    // work unit handed over by the scheduler
+    wu_queue_data_t wu;
+
     opencl_ctx_t *ocl_ctx;
     thread_ctx_t *thread_ctx;
 
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <ctype.h>
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "protocol.h"
 #include "iso14443crc.h"
 #include "util_posix.h"
@@ -135,6 +136,41 @@ static int global_found_candidate = 0;
 static uint64_t global_candidate_key = 0;
 static int thread_count = 2;
 
+// work is handed out in chunks from a shared counter, a thread done with
+// its chunk takes the next one and all of them stop once a key is found
+#define NT_CHUNK    256
+static uint32_t global_next = 0;
+static uint64_t global_tested = 0;
+
+static bool next_chunk(uint32_t chunk, uint32_t end, uint32_t *first, uint32_t *last) {
+    if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) != 0) {
+        return false;
+    }
+
+    uint32_t f = __atomic_fetch_add(&global_next, chunk, __ATOMIC_RELAXED);
+    if (f > end) {
+        return false;
+    }
+
+    *first = f;
+    *last = (end - f < chunk) ? end : f + chunk - 1;
+    return true;
+}
+
+static void reset_chunks(void) {
+    __atomic_store_n(&global_next, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&global_tested, 0, __ATOMIC_RELAXED);
+}
+
+static void print_rate(uint64_t ms, const char *what) {
+    uint64_t tested = __atomic_load_n(&global_tested, __ATOMIC_RELAXED);
+    printf("execution time " _YELLOW_("%.2f") " sec, %" PRIu64 " %s", (float)ms / 1000.0, tested, what);
+    if (ms) {
+        printf(" ( " _YELLOW_("%.0f") " %s/s )", (double)tested * 1000.0 / ms, what);
+    }
+    printf("\n");
+}
+
 static int param_getptr(const char *line, int *bg, int *en, int paramnum) {
     int i;
     int len = strlen(line);
@@ -503,140 +539,188 @@ static void *brute_thread(void *arguments) {
     // TC == 4  (
     // threads calls 0 ev1 == false
     // threads calls 0,1,2  ev1 == true
-    for (uint32_t count = args->idx; count <= 0xFFFF; count += thread_count) {
+    bool done = false;
+    uint32_t first, last;
+    while (done == false && next_chunk(NT_CHUNK, 0xFFFF, &first, &last)) {
 
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
-            break;
-        }
+        __atomic_fetch_add(&global_tested, last - first + 1, __ATOMIC_RELAXED);
 
-        nt = count << 16 | prng_successor(count, 16);
+        for (uint32_t count = first; count <= last; count++) {
 
-        if (candidate_nonce(args->xored, nt, args->ev1) == false) {
-            continue;
-        }
-
-        p64 = prng_successor(nt, 64);
-        ks2 = ar_enc ^ p64;
-        ks3 = at_enc ^ prng_successor(p64, 32);
-        revstate = lfsr_recovery64(ks2, ks3);
-        ks4 = crypto1_word(revstate, 0, 0);
+            if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) != 0) {
+                break;
+            }
 
-        if (ks4 == 0) {
-            free(revstate);
-            continue;
-        }
+            nt = count << 16 | prng_successor(count, 16);
 
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        if (args->ev1) {
-            printf("\n---> " _YELLOW_(" Possible key candidate")"  <---\n");
-        }
+            if (candidate_nonce(args->xored, nt, args->ev1) == false) {
+                continue;
+            }
 
-#if 0
-        printf("thread #%d idx %d %s\n", args->thread, args->idx, (args->ev1) ? "(Ev1)" : "");
-        printf("current nt(%08x)  ar_enc(%08x)  at_enc(%08x)\n", nt, ar_enc, at_enc);
-        printf("ks2:%08x\n", ks2);
-        printf("ks3:%08x\n", ks3);
-        printf("ks4:%08x\n", ks4);
-#endif
-        if (cmd_enc) {
-            uint32_t decrypted = ks4 ^ cmd_enc;
-            printf("CMD enc( %08x )\n", cmd_enc);
-            printf("    dec( %08x )    ", decrypted);
+            p64 = prng_successor(nt, 64);
+            ks2 = ar_enc ^ p64;
+            ks3 = at_enc ^ prng_successor(p64, 32);
+            revstate = lfsr_recovery64(ks2, ks3);
+            ks4 = crypto1_word(revstate, 0, 0);
 
-            // check if cmd exists
-            uint8_t isOK = checkValidCmd(decrypted);
-            if (isOK == false) {
-                printf(_RED_("<-- not a valid cmd\n"));
-                pthread_mutex_unlock(&print_lock);
+            if (ks4 == 0) {
                 free(revstate);
                 continue;
             }
 
-            // Add a crc-check.
-            isOK = checkCRC(decrypted);
-            if (isOK == false) {
-                printf(_RED_("<-- not a valid crc\n"));
-                pthread_mutex_unlock(&print_lock);
-                free(revstate);
-                continue;
-            } else {
-                printf("<-- " _GREEN_("valid cmd") "\n");
+            // lock this section to avoid interlacing prints from different threats
+            pthread_mutex_lock(&print_lock);
+            if (args->ev1) {
+                printf("\n---> " _YELLOW_(" Possible key candidate")"  <---\n");
             }
-        }
 
-        lfsr_rollback_word(revstate, 0, 0);
-        lfsr_rollback_word(revstate, 0, 0);
-        lfsr_rollback_word(revstate, 0, 0);
-        lfsr_rollback_word(revstate, nr_enc, 1);
-        lfsr_rollback_word(revstate, uid ^ nt, 0);
-        crypto1_get_lfsr(revstate, &key);
-        free(revstate);
-
-        if (args->ev1) {
-            // if it was EV1,  we know for sure xxxAAAAAAAA recovery
-            printf("\nKey candidate [ " _YELLOW_("....%08" PRIx64)" ]\n\n", key & 0xFFFFFFFF);
-            __sync_fetch_and_add(&global_found_candidate, 1);
-        } else {
-            printf("\nKey candidate [ " _GREEN_("....%08" PRIx64) " ]", key & 0xFFFFFFFF);
-            printf("\nKey candidate [ " _GREEN_("%12" PRIx64) " ]\n\n", key);
-            __sync_fetch_and_add(&global_found, 1);
+#if 0
+            printf("thread #%d idx %d %s\n", args->thread, args->idx, (args->ev1) ? "(Ev1)" : "");
+            printf("current nt(%08x)  ar_enc(%08x)  at_enc(%08x)\n", nt, ar_enc, at_enc);
+            printf("ks2:%08x\n", ks2);
+            printf("ks3:%08x\n", ks3);
+            printf("ks4:%08x\n", ks4);
+#endif
+            if (cmd_enc) {
+                uint32_t decrypted = ks4 ^ cmd_enc;
+                printf("CMD enc( %08x )\n", cmd_enc);
+                printf("    dec( %08x )    ", decrypted);
+
+                // check if cmd exists
+                uint8_t isOK = checkValidCmd(decrypted);
+                if (isOK == false) {
+                    printf(_RED_("<-- not a valid cmd\n"));
+                    pthread_mutex_unlock(&print_lock);
+                    free(revstate);
+                    continue;
+                }
+
+                // Add a crc-check.
+                isOK = checkCRC(decrypted);
+                if (isOK == false) {
+                    printf(_RED_("<-- not a valid crc\n"));
+                    pthread_mutex_unlock(&print_lock);
+                    free(revstate);
+                    continue;
+                } else {
+                    printf("<-- " _GREEN_("valid cmd") "\n");
+                }
+            }
+
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, 0, 0);
+            lfsr_rollback_word(revstate, nr_enc, 1);
+            lfsr_rollback_word(revstate, uid ^ nt, 0);
+            crypto1_get_lfsr(revstate, &key);
+            free(revstate);
+
+            if (args->ev1) {
+                // if it was EV1,  we know for sure xxxAAAAAAAA recovery
+                printf("\nKey candidate [ " _YELLOW_("....%08" PRIx64)" ]\n\n", key & 0xFFFFFFFF);
+                __sync_fetch_and_add(&global_found_candidate, 1);
+            } else {
+                printf("\nKey candidate [ " _GREEN_("....%08" PRIx64) " ]", key & 0xFFFFFFFF);
+                printf("\nKey candidate [ " _GREEN_("%12" PRIx64) " ]\n\n", key);
+                __sync_fetch_and_add(&global_found, 1);
+            }
+            // release lock
+            pthread_mutex_unlock(&print_lock);
+            __sync_fetch_and_add(&global_candidate_key, key);
+            done = true;
+            break;
         }
-        // release lock
-        pthread_mutex_unlock(&print_lock);
-        __sync_fetch_and_add(&global_candidate_key, key);
-        break;
     }
     free(args);
     return NULL;
 }
 
+// slices whose first decrypted byte is a known command
+static crypto1_bs_t cmd_byte_candidates(const crypto1_bs_t *ks, uint8_t enc) {
+    crypto1_bs_t m = {0};
+    for (int i = 0; i < 8; ++i) {
+        m |= crypto1_bs_equal(ks, enc ^ cmds[i][0], 8);
+    }
+    return m;
+}
+
 static void *brute_key_thread(void *arguments) {
 
     struct thread_key_args *args = (struct thread_key_args *) arguments;
     uint64_t key;
+    uint64_t keys[CRYPTO1_BS_SLICES];
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count <= 0xFFFF; count += thread_count) {
+    bool found = false;
+    uint32_t first, last;
+    while (found == false && next_chunk(CRYPTO1_BS_SLICES, 0xFFFF, &first, &last)) {
 
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
-            break;
+        uint64_t base = first;
+        size_t n = last - first + 1;
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = args->part_key | ((base + i) << 32);
         }
+        __atomic_fetch_add(&global_tested, n, __ATOMIC_RELAXED);
 
-        key = args->part_key | (count << 32);
+        // run the whole batch up to the first byte of the next command
+        crypto1_bs_state_t bs;
+        crypto1_bs_init(&bs, keys, n);
+        crypto1_bs_word(&bs, args->nt_enc ^ args->uid, 1, NULL);
+        crypto1_bs_word(&bs, args->nr_enc, 1, NULL);
+        crypto1_bs_word(&bs, 0, 0, NULL);
+        crypto1_bs_word(&bs, 0, 0, NULL);
 
-        // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+        crypto1_bs_t ks[8];
+        crypto1_bs_byte(&bs, 0x00, 0, ks);
 
-        // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
-
-        // decrypt 22 bytes
-        uint8_t dec[args->enc_len];
-        for (int i = 0; i < args->enc_len; i++) {
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+        crypto1_bs_t hits = cmd_byte_candidates(ks, local_enc[0]);
+        if (crypto1_bs_any(hits) == false) {
+            continue;
         }
 
-        crypto1_destroy(pcs);
+        // few keys survive, check their CRC the slow way
+        for (size_t i = 0; i < n; i++) {
 
-        // check if cmd exists
-        if (checkValidCmdByte(dec, args->enc_len) == false) {
-            continue;
-        }
+            if (BIT(hits[i >> 6], i & 0x3f) == 0) {
+                continue;
+            }
 
-        __sync_fetch_and_add(&global_found, 1);
+            key = keys[i];
 
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
-        printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
-        printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
-        pthread_mutex_unlock(&print_lock);
-        break;
+            // Init cipher with key
+            struct Crypto1State *pcs = crypto1_create(key);
+
+            // NESTED decrypt nt with help of new key
+            crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
+            crypto1_word(pcs, args->nr_enc, 1);
+            crypto1_word(pcs, 0, 0);
+            crypto1_word(pcs, 0, 0);
+
+            // decrypt 22 bytes
+            uint8_t dec[args->enc_len];
+            for (int j = 0; j < args->enc_len; j++) {
+                dec[j] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[j];
+            }
+
+            crypto1_destroy(pcs);
+
+            // check if cmd exists
+            if (checkValidCmdByte(dec, args->enc_len) == false) {
+                continue;
+            }
+
+            __sync_fetch_and_add(&global_found, 1);
+
+            // lock this section to avoid interlacing prints from different threats
+            pthread_mutex_lock(&print_lock);
+            printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
+            printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
+            printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
+            pthread_mutex_unlock(&print_lock);
+            found = true;
+            break;
+        }
     }
     free(args);
     return NULL;
@@ -734,8 +818,8 @@ int main(int argc, const char *argv[]) {
         def->nr_enc = nr_enc;
         def->enc_len = enc_len;
         memcpy(def->enc, enc, enc_len);
-        pthread_create(&threads[0], NULL, check_default_keys, (void *)def);
-        pthread_join(threads[0], NULL);
+        // a few dozen keys, no need for a thread
+        check_default_keys(def);
         if (global_found) {
             goto out;
         }
@@ -744,6 +828,7 @@ int main(int argc, const char *argv[]) {
     printf("\n----------- " _CYAN_("Phase 2 examine") " -------------------------------\n");
     printf("Looking for the last bytes of the encrypted tagnonce\n");
     printf("\nTarget old MFC...\n");
+    reset_chunks();
     // the rest of available threads to EV1 scenario
     for (int i = 0; i < thread_count; ++i) {
         struct thread_args *a = calloc(1, sizeof(struct thread_args));
@@ -760,12 +845,13 @@ int main(int argc, const char *argv[]) {
     }
 
     t1 = msclock() - t1;
-    printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
+    print_rate(t1, "nonces");
 
     if (!global_found && !global_found_candidate) {
         printf("\nTarget MFC Ev1...\n");
 
         t1 = msclock();
+        reset_chunks();
         // the rest of available threads to EV1 scenario
         for (int i = 0; i < thread_count; ++i) {
             struct thread_args *a = calloc(1, sizeof(struct thread_args));
@@ -782,7 +868,7 @@ int main(int argc, const char *argv[]) {
         }
 
         t1 = msclock() - t1;
-        printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
+        print_rate(t1, "nonces");
 
 
         if (!global_found && !global_found_candidate) {
@@ -809,6 +895,9 @@ int main(int argc, const char *argv[]) {
     printf("\nLooking for the upper 16 bits of the key\n");
     fflush(stdout);
 
+    t1 = msclock();
+    reset_chunks();
+
     // threads
     for (int i = 0; i < thread_count; ++i) {
         struct thread_key_args *b = calloc(1, sizeof(struct thread_key_args));
@@ -828,6 +917,9 @@ int main(int argc, const char *argv[]) {
         pthread_join(threads[i], NULL);
     }
 
+    t1 = msclock() - t1;
+    print_rate(t1, "keys");
+
     if (!global_found && !global_found_candidate) {
         printf("\nfailed to find a key\n\n");
     }
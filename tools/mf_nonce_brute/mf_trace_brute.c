@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include "ctype.h"
 #include "crapto1/crapto1.h"
+#include "crapto1/crypto1_bs.h"
 #include "protocol.h"
 #include "iso14443crc.h"
 #include <util_posix.h>
@@ -60,6 +61,26 @@ uint8_t cmds[8][2] = {
 static int global_found = 0;
 static int thread_count = 2;
 
+// work is handed out in chunks from a shared counter, a thread done with
+// its chunk takes the next one and all of them stop once a key is found
+static uint32_t global_next = 0;
+static uint64_t global_tested = 0;
+
+static bool next_chunk(uint32_t chunk, uint32_t end, uint32_t *first, uint32_t *last) {
+    if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) != 0) {
+        return false;
+    }
+
+    uint32_t f = __atomic_fetch_add(&global_next, chunk, __ATOMIC_RELAXED);
+    if (f > end) {
+        return false;
+    }
+
+    *first = f;
+    *last = (end - f < chunk) ? end : f + chunk - 1;
+    return true;
+}
+
 static int param_getptr(const char *line, int *bg, int *en, int paramnum) {
     int i;
     int len = strlen(line);
@@ -193,49 +214,88 @@ static bool checkValidCmdByte(uint8_t *cmd, uint16_t n) {
     return false;
 }
 
+// slices whose first decrypted byte is a known command
+static crypto1_bs_t cmd_byte_candidates(const crypto1_bs_t *ks, uint8_t enc) {
+    crypto1_bs_t m = {0};
+    for (int i = 0; i < 8; ++i) {
+        m |= crypto1_bs_equal(ks, enc ^ cmds[i][0], 8);
+    }
+    return m;
+}
+
 static void *brute_thread(void *arguments) {
 
     struct thread_args *args = (struct thread_args *) arguments;
-    uint64_t key = args->part_key;
+    uint64_t key;
+    uint64_t keys[CRYPTO1_BS_SLICES];
     uint8_t local_enc[args->enc_len];
     memcpy(local_enc, args->enc, args->enc_len);
 
-    for (uint64_t count = args->idx; count < 0xFFFF; count += thread_count) {
+    bool found = false;
+    uint32_t first, last;
+    while (found == false && next_chunk(CRYPTO1_BS_SLICES, 0xFFFF, &first, &last)) {
 
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
-            break;
+        uint64_t base = first;
+        size_t n = last - first + 1;
+        for (size_t i = 0; i < n; i++) {
+            keys[i] = args->part_key | ((base + i) << 32);
         }
+        __atomic_fetch_add(&global_tested, n, __ATOMIC_RELAXED);
 
-        key |= count << 32;
+        // run the whole batch up to the first byte of the next command
+        crypto1_bs_state_t bs;
+        crypto1_bs_init(&bs, keys, n);
+        crypto1_bs_word(&bs, args->nt_enc ^ args->uid, 1, NULL);
+        crypto1_bs_word(&bs, args->nr_enc, 1, NULL);
+        crypto1_bs_word(&bs, 0, 0, NULL);
+        crypto1_bs_word(&bs, 0, 0, NULL);
 
-        // Init cipher with key
-        struct Crypto1State *pcs = crypto1_create(key);
+        crypto1_bs_t ks[8];
+        crypto1_bs_byte(&bs, 0x00, 0, ks);
 
-        // NESTED decrypt nt with help of new key
-        crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
-        crypto1_word(pcs, args->nr_enc, 1);
-        crypto1_word(pcs, 0, 0);
-        crypto1_word(pcs, 0, 0);
+        crypto1_bs_t hits = cmd_byte_candidates(ks, local_enc[0]);
+        if (crypto1_bs_any(hits) == false) {
+            continue;
+        }
 
-        // decrypt 22 bytes
-        uint8_t dec[args->enc_len];
-        for (int i = 0; i < args->enc_len; i++)
-            dec[i] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[i];
+        for (size_t i = 0; i < n; i++) {
 
-        crypto1_destroy(pcs);
+            if (BIT(hits[i >> 6], i & 0x3f) == 0) {
+                continue;
+            }
 
-        if (checkValidCmdByte(dec, args->enc_len) == false) {
-            continue;
+            key = keys[i];
+
+            // Init cipher with key
+            struct Crypto1State *pcs = crypto1_create(key);
+
+            // NESTED decrypt nt with help of new key
+            crypto1_word(pcs, args->nt_enc ^ args->uid, 1);
+            crypto1_word(pcs, args->nr_enc, 1);
+            crypto1_word(pcs, 0, 0);
+            crypto1_word(pcs, 0, 0);
+
+            // decrypt 22 bytes
+            uint8_t dec[args->enc_len];
+            for (int j = 0; j < args->enc_len; j++)
+                dec[j] = crypto1_byte(pcs, 0x00, 0) ^ local_enc[j];
+
+            crypto1_destroy(pcs);
+
+            if (checkValidCmdByte(dec, args->enc_len) == false) {
+                continue;
+            }
+            __sync_fetch_and_add(&global_found, 1);
+
+            // lock this section to avoid interlacing prints from different threats
+            pthread_mutex_lock(&print_lock);
+            printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
+            printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
+            printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
+            pthread_mutex_unlock(&print_lock);
+            found = true;
+            break;
         }
-        __sync_fetch_and_add(&global_found, 1);
-
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-        printf("\nenc:  %s\n", sprint_hex_inrow_ex(local_enc, args->enc_len, 0));
-        printf("dec:  %s\n", sprint_hex_inrow_ex(dec, args->enc_len, 0));
-        printf("\nValid Key found [ " _GREEN_("%012" PRIx64) " ]\n\n", key);
-        pthread_mutex_unlock(&print_lock);
-        break;
     }
 
     free(args);
@@ -310,8 +370,11 @@ int main(int argc, const char *argv[]) {
     }
 
     t1 = msclock() - t1;
-    if (t1 > 0)
-        printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
+    if (t1 > 0) {
+        uint64_t tested = __atomic_load_n(&global_tested, __ATOMIC_RELAXED);
+        printf("execution time " _YELLOW_("%.2f") " sec, %" PRIu64 " keys ( " _YELLOW_("%.0f") " keys/s )\n",
+               (float)t1 / 1000.0, tested, (double)tested * 1000.0 / t1);
+    }
 
     // clean up mutex
     pthread_mutex_destroy(&print_lock);
@@ -1,157 +1,157 @@
+// Interleaved AES-128 decryption with the CPU AES instructions
+//
+// Brute forcing needs a fresh key schedule for every block, so one key at a
+// time leaves the AES units waiting on the previous instruction most of the
+// time. Here AESNI_KEYS keys are expanded and used side by side, which keeps
+// the pipeline full. With VAES several keys share one wide register.
+//
+// AES_PIPELINE is defined when the build targets one of the instruction sets,
+// it is still up to the caller to check the CPU at runtime (detectaes.h).
+
 #ifndef __AES_NI_H__
 #define __AES_NI_H__
 
-#include "aes-ni.h"
-// #include <stdint.h>     //for int8_t
-// #include <string.h>     //for memcmp
-// #include <wmmintrin.h>  //for intrinsics for AES-NI
-//compile using gcc and following arguments: -g;-O0;-Wall;-msse2;-msse;-march=native;-maes
+#include <stdint.h>
+
+#if defined(__VAES__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+#define AES_PIPELINE        "VAES-512"
+typedef __m512i aes_vec_t;
+#define AESV_KEYS           4
+#define AESV_LOAD(p)        _mm512_loadu_si512((const void *)(p))
+#define AESV_STORE(p, v)    _mm512_storeu_si512((void *)(p), (v))
+// maskz form, gcc 12 warns about the undefined source of the plain one
+#define AESV_BCAST(p)       _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, _mm_loadu_si128((const __m128i *)(p)))
+#define AESV_SET32(x)       _mm512_set1_epi32((int)(x))
+#define AESV_SHUFFLE(v, m)  _mm512_shuffle_epi8((v), (m))
+#define AESV_SHL(v, n)      _mm512_bslli_epi128((v), (n))
+#define AESV_DEC(v, k)      _mm512_aesdec_epi128((v), (k))
+#define AESV_DECLAST(v, k)  _mm512_aesdeclast_epi128((v), (k))
+#define AESV_ENCLAST(v, k)  _mm512_aesenclast_epi128((v), (k))
+// no wide aesimc, InvMixColumns(v) == aesdec(aesenclast(v, 0), 0)
+#define AESV_IMC(v)         _mm512_aesdec_epi128(_mm512_aesenclast_epi128((v), _mm512_setzero_si512()), _mm512_setzero_si512())
+
+#elif defined(__VAES__) && defined(__AVX2__)
+
+#include <immintrin.h>
+#define AES_PIPELINE        "VAES-256"
+typedef __m256i aes_vec_t;
+#define AESV_KEYS           2
+#define AESV_LOAD(p)        _mm256_loadu_si256((const __m256i *)(p))
+#define AESV_STORE(p, v)    _mm256_storeu_si256((__m256i *)(p), (v))
+#define AESV_BCAST(p)       _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(p)))
+#define AESV_SET32(x)       _mm256_set1_epi32((int)(x))
+#define AESV_SHUFFLE(v, m)  _mm256_shuffle_epi8((v), (m))
+#define AESV_SHL(v, n)      _mm256_bslli_epi128((v), (n))
+#define AESV_DEC(v, k)      _mm256_aesdec_epi128((v), (k))
+#define AESV_DECLAST(v, k)  _mm256_aesdeclast_epi128((v), (k))
+#define AESV_ENCLAST(v, k)  _mm256_aesenclast_epi128((v), (k))
+#define AESV_IMC(v)         _mm256_aesdec_epi128(_mm256_aesenclast_epi128((v), _mm256_setzero_si256()), _mm256_setzero_si256())
+
+#elif defined(__AES__) && defined(__SSSE3__)
+
+#include <immintrin.h>
+#define AES_PIPELINE        "AES-NI"
+typedef __m128i aes_vec_t;
+#define AESV_KEYS           1
+#define AESV_LOAD(p)        _mm_loadu_si128((const __m128i *)(p))
+#define AESV_STORE(p, v)    _mm_storeu_si128((__m128i *)(p), (v))
+#define AESV_BCAST(p)       _mm_loadu_si128((const __m128i *)(p))
+#define AESV_SET32(x)       _mm_set1_epi32((int)(x))
+#define AESV_SHUFFLE(v, m)  _mm_shuffle_epi8((v), (m))
+#define AESV_SHL(v, n)      _mm_slli_si128((v), (n))
+#define AESV_DEC(v, k)      _mm_aesdec_si128((v), (k))
+#define AESV_DECLAST(v, k)  _mm_aesdeclast_si128((v), (k))
+#define AESV_ENCLAST(v, k)  _mm_aesenclast_si128((v), (k))
+#define AESV_IMC(v)         _mm_aesimc_si128((v))
+
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+
+#include <arm_neon.h>
+#define AES_PIPELINE        "ARMv8 Crypto"
+typedef uint8x16_t aes_vec_t;
+#define AESV_KEYS           1
+#define AESV_LOAD(p)        vld1q_u8((const uint8_t *)(p))
+#define AESV_STORE(p, v)    vst1q_u8((uint8_t *)(p), (v))
+#define AESV_BCAST(p)       vld1q_u8((const uint8_t *)(p))
+#define AESV_SET32(x)       vreinterpretq_u8_u32(vdupq_n_u32((x)))
+#define AESV_SHUFFLE(v, m)  vqtbl1q_u8((v), (m))
+#define AESV_SHL(v, n)      vextq_u8(vdupq_n_u8(0), (v), 16 - (n))
+// AESD/AESE add the key before the round, x86 after it. Round keys are the
+// x86 ones, so use a zero key and add them afterwards.
+#define AESV_DEC(v, k)      (vaesimcq_u8(vaesdq_u8((v), vdupq_n_u8(0))) ^ (k))
+#define AESV_DECLAST(v, k)  (vaesdq_u8((v), vdupq_n_u8(0)) ^ (k))
+#define AESV_ENCLAST(v, k)  (vaeseq_u8((v), vdupq_n_u8(0)) ^ (k))
+#define AESV_IMC(v)         vaesimcq_u8((v))
 
-/*
-static void AES_CBC_decrypt(const uint8_t *in,  uint8_t *out,  uint8_t iv[],  uint8_t len, uint8_t *key) {
+#endif
 
-    __m128i data, last_in;
-    __m128i feedback = _mm_loadu_si128 ((__m128i*)iv);
+#if defined(AES_PIPELINE)
 
-    uint j;
-    for (uint8_t i = 0; i < len; i++){
-        last_in =_mm_loadu_si128 (&((__m128i*)in)[i]);
-        data = _mm_xor_si128 (last_in, ((__m128i*)key)[0]);
+#define AESNI_KEYS  8
+#define AESNI_VECS  (AESNI_KEYS / AESV_KEYS)
 
-        for (j = 1; j < 10; j++){
-            data = _mm_aesdec_si128 (data, ((__m128i*)key)[j]);
-        }
-        data = _mm_aesdeclast_si128 (data,((__m128i*)key)[j]);
-        data = _mm_xor_si128 (data, feedback);
-        _mm_storeu_si128 (&((__m128i*)out)[i], data);
-        feedback = last_in;
-    }
-}
-*/
-
-/*
-INLINE static __m128i AES_128_ASSIST (__m128i temp1, __m128i temp2) {
-    __m128i temp3;
-    temp2 = _mm_shuffle_epi32 (temp2 ,0xff);
-    temp3 = _mm_slli_si128 (temp1, 0x4);
-    temp1 = _mm_xor_si128 (temp1, temp3);
-    temp3 = _mm_slli_si128 (temp3, 0x4);
-    temp1 = _mm_xor_si128 (temp1, temp3);
-    temp3 = _mm_slli_si128 (temp3, 0x4);
-    temp1 = _mm_xor_si128 (temp1, temp3);
-    temp1 = _mm_xor_si128 (temp1, temp2);
-    return temp1;
-}
+// next round key of every lane. RotWord(w3) is copied to all four columns,
+// so ShiftRows in aesenclast changes nothing and only SubWord and rcon remain
+static inline aes_vec_t aesv_expand(aes_vec_t k, uint32_t rcon) {
+    static const uint8_t rotword[16] = {
+        13, 14, 15, 12, 13, 14, 15, 12, 13, 14, 15, 12, 13, 14, 15, 12
+    };
 
-static void AES_128_Key_Expansion (uint8_t *userkey, __m128i *key) {
-    __m128i temp1, temp2;
-    temp1 = _mm_loadu_si128((__m128i*)userkey);
-    key[0] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1 ,0x1);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[1] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x2);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[2] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x4);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[3] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x8);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[4] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x10);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[5] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x20);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[6] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x40);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[7] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x80);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[8] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x1b);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[9] = temp1;
-    temp2 = _mm_aeskeygenassist_si128 (temp1,0x36);
-    temp1 = AES_128_ASSIST(temp1, temp2);
-    key[10] = temp1;
+    aes_vec_t t = AESV_ENCLAST(AESV_SHUFFLE(k, AESV_BCAST(rotword)), AESV_SET32(rcon));
+    k ^= AESV_SHL(k, 4);
+    k ^= AESV_SHL(k, 8);
+    return k ^ t;
 }
 
-static void aes_inv_key_10(AESContext * ctx) {
-
-    __m128i* keysched = (__m128i*)ctx->keysched;
-    __m128i* invkeysched = (__m128i*)ctx->invkeysched;
-
-    *(invkeysched + 10) = *(keysched + 0);
-    *(invkeysched + 9) = _mm_aesimc_si128(*(keysched + 1));
-    *(invkeysched + 8) = _mm_aesimc_si128(*(keysched + 2));
-    *(invkeysched + 7) = _mm_aesimc_si128(*(keysched + 3));
-    *(invkeysched + 6) = _mm_aesimc_si128(*(keysched + 4));
-    *(invkeysched + 5) = _mm_aesimc_si128(*(keysched + 5));
-    *(invkeysched + 4) = _mm_aesimc_si128(*(keysched + 6));
-    *(invkeysched + 3) = _mm_aesimc_si128(*(keysched + 7));
-    *(invkeysched + 2) = _mm_aesimc_si128(*(keysched + 8));
-    *(invkeysched + 1) = _mm_aesimc_si128(*(keysched + 9));
-    *(invkeysched + 0) = *(keysched + 10);
-}
-
-static void aes_decrypt_cbc_ni(const uint8_t *in,  uint8_t *out,  uint8_t iv[],  uint8_t len, uint8_t *key) {
-
-    __m128i dec = _mm_setzero_si128();
-    __m128i* block = (__m128i*)in;
-    const __m128i* finish = (__m128i*)(in + len);
-
-    // Load IV
-    __m128i iv = _mm_loadu_si128((__m128i*)iv);
-
-    while (block < finish) {
-
-        // Key schedule ptr
-        __m128i* keysched = (__m128i*)ctx->invkeysched;
-        __m128i last = _mm_loadu_si128(block);
-
-        dec  = _mm_xor_si128(last, *keysched);
+/**
+ * @brief Decrypt two blocks under each of AESNI_KEYS AES-128 keys, ECB.
+ *
+ * @param keys AESNI_KEYS keys of 16 bytes, back to back
+ * @param in0 first block, the same for every key
+ * @param in1 second block, the same for every key
+ * @param out0 in0 decrypted, 16 bytes per key
+ * @param out1 in1 decrypted, 16 bytes per key
+ */
+static inline void aes128_dec2_x8(const uint8_t *keys, const uint8_t *in0, const uint8_t *in1, uint8_t *out0, uint8_t *out1) {
+    static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+    aes_vec_t rk[11][AESNI_VECS];
+    for (int v = 0; v < AESNI_VECS; v++) {
+        rk[0][v] = AESV_LOAD(keys + (v * AESV_KEYS * 16));
+    }
 
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdec_si128(dec, *(++keysched));
-        dec = _mm_aesdeclast_si128(dec, *(++keysched));
+    for (int r = 1; r < 11; r++) {
+        for (int v = 0; v < AESNI_VECS; v++) {
+            rk[r][v] = aesv_expand(rk[r - 1][v], rcon[r - 1]);
+        }
+    }
 
-        /// Xor data with IV
-        dec  = _mm_xor_si128(iv, dec);
+    const aes_vec_t b0 = AESV_BCAST(in0);
+    const aes_vec_t b1 = AESV_BCAST(in1);
 
-        // Store data
-        _mm_storeu_si128(block, dec);
-        iv = last;
+    aes_vec_t x0[AESNI_VECS], x1[AESNI_VECS];
+    for (int v = 0; v < AESNI_VECS; v++) {
+        x0[v] = b0 ^ rk[10][v];
+        x1[v] = b1 ^ rk[10][v];
+    }
 
-        // Go to next block
-        ++block;
+    // equivalent inverse cipher, middle round keys go through InvMixColumns
+    for (int r = 9; r > 0; r--) {
+        for (int v = 0; v < AESNI_VECS; v++) {
+            aes_vec_t k = AESV_IMC(rk[r][v]);
+            x0[v] = AESV_DEC(x0[v], k);
+            x1[v] = AESV_DEC(x1[v], k);
+        }
     }
 
-    // Update IV
-    _mm_storeu_si128((__m128i*)iv, dec);
+    for (int v = 0; v < AESNI_VECS; v++) {
+        AESV_STORE(out0 + (v * AESV_KEYS * 16), AESV_DECLAST(x0[v], rk[0][v]));
+        AESV_STORE(out1 + (v * AESV_KEYS * 16), AESV_DECLAST(x1[v], rk[0][v]));
+    }
 }
 
-static void aes_setup_ni(AESContext * ctx, uint8_t *key) {
-
-    __m128i *keysched = (__m128i*)ctx->keysched;
-
-    ctx->decrypt_cbc = aes_decrypt_cbc_ni;
-
-    // Now do the key setup itself.
-    AES_128_Key_Expansion (key, keysched);
-
-    // Now prepare the modified keys for the inverse cipher.
-    aes_inv_key_10(ctx);
-}
-*/
+#endif
 
 #endif
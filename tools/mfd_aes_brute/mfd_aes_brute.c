@@ -35,6 +35,8 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include "util_posix.h"
+#include "aes-ni.h"
+#include "detectaes.h"
 
 #define AEND  "\x1b[0m"
 #define _RED_(s) "\x1b[31m" s AEND
@@ -48,11 +50,15 @@ pthread_mutex_t print_lock;
 static int global_found = 0;
 static int thread_count = 2;
 
+// threads take the timestamps in chunks from a shared counter
+#define TIME_CHUNK  0x10000
+static uint64_t global_next = 0;
+static uint64_t global_stop = 0;
+static uint64_t global_tested = 0;
+static bool use_pipeline = false;
+
 typedef struct thread_args {
     int thread;
-    int idx;
-    uint64_t starttime;
-    uint64_t stoptime;
     uint8_t tag[16];
     uint8_t rdr[32];
 } targs;
@@ -70,6 +76,27 @@ static void make_key(uint32_t seed, uint8_t key[]) {
     }
 }
 
+#if defined(AES_PIPELINE)
+// make_key() for AESNI_KEYS consecutive seeds side by side, so the compiler can vectorise it
+static void make_keys(uint32_t seed, uint8_t keys[AESNI_KEYS][16]) {
+
+    uint32_t lseed[AESNI_KEYS];
+    for (int k = 0; k < AESNI_KEYS; k++) {
+        lseed[k] = seed + k;
+        lseed[k] = (lseed[k] * 22695477) % UINT_MAX;
+        lseed[k] = (lseed[k] + 1) % UINT_MAX;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        for (int k = 0; k < AESNI_KEYS; k++) {
+            lseed[k] = (lseed[k] * 22695477) % UINT_MAX;
+            lseed[k] = (lseed[k] + 1) % UINT_MAX;
+            keys[k][i] = ((lseed[k] >> 16) & 0x7fff) % 0xFF;
+        }
+    }
+}
+#endif
+
 static void handleErrors(void) {
     ERR_print_errors_fp(stderr);
     abort();
@@ -149,68 +176,125 @@ static void print_time(uint64_t at) {
     printf("%s\n", res);
 }
 
-static void *brute_thread(void *arguments) {
+static bool next_chunk(uint64_t *first, uint64_t *last) {
+    if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) != 0) {
+        return false;
+    }
 
-    struct thread_args *args = (struct thread_args *) arguments;
+    uint64_t start = __atomic_fetch_add(&global_next, TIME_CHUNK, __ATOMIC_RELAXED);
+    if (start >= global_stop) {
+        return false;
+    }
 
-    uint64_t starttime = args->starttime;
+    *first = start;
+    *last = (global_stop - start > TIME_CHUNK) ? start + TIME_CHUNK : global_stop;
+    return true;
+}
 
-    uint64_t stoptime = args->stoptime;
-    uint8_t local_tag[16];
-    uint8_t local_rdr[32];
-    memcpy(local_tag, args->tag, 16);
-    memcpy(local_rdr, args->rdr, 32);
+// the tag nonce rotated left by one byte comes back as the second reader block
+static bool check_key(const uint8_t *dec_tag, const uint8_t *dec_rdr2) {
+    if (dec_tag[0] != dec_rdr2[15]) {
+        return false;
+    }
+    return memcmp(dec_tag + 1, dec_rdr2, 15) == 0;
+}
 
-    for (uint64_t i = starttime + args->idx; i < stoptime; i += thread_count) {
+static void found_key(uint64_t timestamp, uint8_t *key) {
+    if (__sync_fetch_and_add(&global_found, 1) != 0) {
+        return;
+    }
 
-        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
-            break;
+    // lock this section to avoid interlacing prints from different threats
+    pthread_mutex_lock(&print_lock);
+
+    printf("Found timestamp........ ");
+    print_time(timestamp);
+
+    printf("key.................... \x1b[32m");
+    print_hex(key, 16);
+    printf(AEND);
+
+    pthread_mutex_unlock(&print_lock);
+}
+
+#if defined(AES_PIPELINE)
+static bool brute_chunk_pipeline(uint64_t first, uint64_t last, const uint8_t *tag, const uint8_t *rdr) {
+
+    uint8_t keys[AESNI_KEYS][16];
+    uint8_t dec_tag[AESNI_KEYS][16];
+    uint8_t dec_rdr[AESNI_KEYS][16];
+
+    for (uint64_t i = first; i < last; i += AESNI_KEYS) {
+
+        make_keys(i, keys);
+
+        // tag block has a zero iv, the second reader block is chained to the first
+        aes128_dec2_x8(&keys[0][0], tag, rdr + 16, &dec_tag[0][0], &dec_rdr[0][0]);
+
+        for (int k = 0; k < AESNI_KEYS && i + k < last; k++) {
+
+            uint8_t rdr2[16];
+            for (int j = 0; j < 16; j++) {
+                rdr2[j] = dec_rdr[k][j] ^ rdr[j];
+            }
+
+            if (check_key(dec_tag[k], rdr2)) {
+                found_key(i + k, keys[k]);
+                return true;
+            }
         }
+    }
+    return false;
+}
+#endif
+
+static bool brute_chunk(uint64_t first, uint64_t last, uint8_t *tag, uint8_t *rdr) {
+
+    for (uint64_t i = first; i < last; i++) {
 
         uint8_t key[16] = {0x00};
         make_key(i, key);
 
         uint8_t iv[16] = {0x00};
         uint8_t dec_tag[16] = {0x00};
-        decrypt_aes(local_tag, 16, key, iv, dec_tag);
+        decrypt_aes(tag, 16, key, iv, dec_tag);
 
         uint8_t dec_rdr[32] = {0x00};
-        decrypt_aes(local_rdr, 32, key, local_tag, dec_rdr);
-
-        // check rol byte first
-        if (dec_tag[0] != dec_rdr[31]) continue;
-
-        // compare rest
-        if (dec_tag[1] != dec_rdr[16]) continue;
-        if (dec_tag[2] != dec_rdr[17]) continue;
-        if (dec_tag[3] != dec_rdr[18]) continue;
-        if (dec_tag[4] != dec_rdr[19]) continue;
-        if (dec_tag[5] != dec_rdr[20]) continue;
-        if (dec_tag[6] != dec_rdr[21]) continue;
-        if (dec_tag[7] != dec_rdr[22]) continue;
-        if (dec_tag[8] != dec_rdr[23]) continue;
-        if (dec_tag[9] != dec_rdr[24]) continue;
-        if (dec_tag[10] != dec_rdr[25]) continue;
-        if (dec_tag[11] != dec_rdr[26]) continue;
-        if (dec_tag[12] != dec_rdr[27]) continue;
-        if (dec_tag[13] != dec_rdr[28]) continue;
-        if (dec_tag[14] != dec_rdr[29]) continue;
-        if (dec_tag[15] != dec_rdr[30]) continue;
-
-        __sync_fetch_and_add(&global_found, 1);
-
-        // lock this section to avoid interlacing prints from different threats
-        pthread_mutex_lock(&print_lock);
-
-        printf("Found timestamp........ ");
-        print_time(i);
-
-        printf("key.................... \x1b[32m");
-        print_hex(key, sizeof(key));
-        printf(AEND);
-
-        pthread_mutex_unlock(&print_lock);
-        break;
+        decrypt_aes(rdr, 32, key, tag, dec_rdr);
+
+        if (check_key(dec_tag, dec_rdr + 16)) {
+            found_key(i, key);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void *brute_thread(void *arguments) {
+
+    struct thread_args *args = (struct thread_args *) arguments;
+
+    uint8_t local_tag[16];
+    uint8_t local_rdr[32];
+    memcpy(local_tag, args->tag, 16);
+    memcpy(local_rdr, args->rdr, 32);
+
+    uint64_t first, last;
+    while (next_chunk(&first, &last)) {
+
+        bool found;
+#if defined(AES_PIPELINE)
+        if (use_pipeline)
+            found = brute_chunk_pipeline(first, last, local_tag, local_rdr);
+        else
+#endif
+            found = brute_chunk(first, last, local_tag, local_rdr);
+
+        __atomic_fetch_add(&global_tested, last - first, __ATOMIC_RELAXED);
+
+        if (found) {
+            break;
+        }
     }
 
     free(args);
@@ -219,10 +303,16 @@ static void *brute_thread(void *arguments) {
 
 static int usage(const char *s) {
     printf(_YELLOW_("syntax:") "\n");
-    printf("    %s <unix timestamp> <16 byte tag challenge> <32 byte reader response challenge>\n", s);
+    printf("    %s <unix timestamp> <16 byte tag challenge> <32 byte reader response challenge> [options]\n", s);
+    printf("\n");
+    printf(_YELLOW_("options:") "\n");
+    printf("    -e <unix timestamp>   stop timestamp, defaults to now\n");
+    printf("    -t <threads>          number of threads, defaults to one per cpu\n");
+    printf("    -p <part>/<parts>     only search part 1..parts of the range, to split it over processes or hosts\n");
     printf("\n");
     printf(_YELLOW_("example:") "\n");
     printf("    ./mfd_aes_brute 1605394800 bb6aea729414a5b1eff7b16328ce37fd 82f5f498dbc29f7570102397a2e5ef2b6dc14a864f665b3c54d11765af81e95c\n");
+    printf("    ./mfd_aes_brute 1136073600 3fda933e2953ca5e6cfbbf95d1b51ddf 97fe4b5de24188458d102959b888938c988e96fb98469ce7426f50f108eaa583 -p 1/2\n");
     printf("\n");
     return 1;
 }
@@ -235,7 +325,7 @@ int main(int argc, char *argv[]) {
     printf("-----------------------------------------------------\n");
     printf("\n");
 
-    if (argc != 4) return usage(argv[0]);
+    if (argc < 4 || (argc % 2) != 0) return usage(argv[0]);
 
     uint64_t start_time = 0;
     sscanf(argv[1], "%"PRIu64, &start_time);
@@ -248,8 +338,50 @@ int main(int argc, char *argv[]) {
     if (hexstr_to_byte_array(argv[3], rdr_resp_challenge, sizeof(rdr_resp_challenge)))
         return 3;
 
+#if !defined(_WIN32) || !defined(__WIN32__)
+    thread_count = sysconf(_SC_NPROCESSORS_CONF);
+    if (thread_count < 2)
+        thread_count = 2;
+#endif  /* _WIN32 */
+
+    uint64_t stop_time = time(NULL);
+    unsigned int part = 1, parts = 1;
+
+    for (int i = 4; i < argc; i += 2) {
+        if (strcmp(argv[i], "-e") == 0) {
+            if (sscanf(argv[i + 1], "%"PRIu64, &stop_time) != 1)
+                return usage(argv[0]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            thread_count = atoi(argv[i + 1]);
+            if (thread_count < 1)
+                return usage(argv[0]);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            if (sscanf(argv[i + 1], "%u/%u", &part, &parts) != 2 || part < 1 || part > parts)
+                return usage(argv[0]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    if (stop_time <= start_time) {
+        printf(_RED_("!!!") " stop timestamp must be after the start timestamp\n");
+        return 4;
+    }
+
+    // parts are contiguous, together they cover the range exactly once
+    uint64_t range = stop_time - start_time;
+    global_next = start_time + (range / parts) * (part - 1) + ((range % parts) * (part - 1)) / parts;
+    global_stop = start_time + (range / parts) * part + ((range % parts) * part) / parts;
+
     printf("Starting timestamp..... ");
-    print_time(start_time);
+    print_time(global_next);
+
+    printf("Stop timestamp......... ");
+    print_time(global_stop);
+
+    if (parts > 1) {
+        printf("Part................... " _YELLOW_("%u") " of " _YELLOW_("%u") "\n", part, parts);
+    }
 
     printf("Tag Challenge.......... ");
     print_hex(tag_challenge, sizeof(tag_challenge));
@@ -257,15 +389,13 @@ int main(int argc, char *argv[]) {
     printf("Rdr Resp & Challenge... ");
     print_hex(rdr_resp_challenge, sizeof(rdr_resp_challenge));
 
+#if defined(AES_PIPELINE)
+    use_pipeline = platform_aes_hw_available();
+#endif
+    printf("AES engine............. " _GREEN_("%s") "\n", (use_pipeline) ? AES_PIPELINE : "OpenSSL");
 
     uint64_t t1 = msclock();
 
-#if !defined(_WIN32) || !defined(__WIN32__)
-    thread_count = sysconf(_SC_NPROCESSORS_CONF);
-    if (thread_count < 2)
-        thread_count = 2;
-#endif  /* _WIN32 */
-
     printf("\nBruteforce using " _YELLOW_("%d") " threads\n", thread_count);
 
     pthread_t threads[thread_count];
@@ -274,13 +404,9 @@ int main(int argc, char *argv[]) {
     pthread_mutex_init(&print_lock, NULL);
 
     // threads
-    uint64_t stop_time = time(NULL);
     for (int i = 0; i < thread_count; ++i) {
         struct thread_args *a = calloc(1, sizeof(struct thread_args));
         a->thread = i;
-        a->idx = i;
-        a->starttime = start_time;
-        a->stoptime = stop_time;
         memcpy(a->tag, tag_challenge, 16);
         memcpy(a->rdr, rdr_resp_challenge, 32);
         pthread_create(&threads[i], NULL, brute_thread, (void *)a);
@@ -297,7 +423,7 @@ int main(int argc, char *argv[]) {
 
     t1 = msclock() - t1;
     if (t1 > 0) {
-        printf("execution time " _YELLOW_("%.2f") " sec\n", (float)t1 / 1000.0);
+        printf("execution time " _YELLOW_("%.2f") " sec, " _YELLOW_("%.0f") " keys/s\n", (float)t1 / 1000.0, (double)global_tested * 1000.0 / t1);
     }
 
     // clean up mutex
@@ -3,11 +3,44 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "crapto1/crapto1.h"
 #include "util_posix.h"
+#include "mfkey_batch.h"
 
-int main(int argc, char *argv[]) {
+// uid, nt0, {nr0}, {ar0}, nt1, {nr1}, {ar1}
+static bool mfkey32v2_crack(const uint32_t *v, uint64_t *key) {
     struct Crypto1State *s, *t;
+    bool found = false;
+    uint32_t uid = v[0], nt0 = v[1], nr0_enc = v[2], ar0_enc = v[3];
+    uint32_t nt1 = v[4], nr1_enc = v[5], ar1_enc = v[6];
+
+    uint32_t p64 = prng_successor(nt0, 64);
+    uint32_t p64b = prng_successor(nt1, 64);
+
+    s = lfsr_recovery32(ar0_enc ^ p64, 0);
+    if (!s) {
+        return false;
+    }
+
+    for (t = s; t->odd | t->even; ++t) {
+        lfsr_rollback_word(t, 0, 0);
+        lfsr_rollback_word(t, nr0_enc, 1);
+        lfsr_rollback_word(t, uid ^ nt0, 0);
+        crypto1_get_lfsr(t, key);
+
+        crypto1_word(t, uid ^ nt1, 0);
+        crypto1_word(t, nr1_enc, 1);
+        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64b)) {
+            found = true;
+            break;
+        }
+    }
+    free(s);
+    return found;
+}
+
+int main(int argc, char *argv[]) {
     uint64_t key;     // recovered key
     uint32_t uid;     // serial number
     uint32_t nt0;      // tag challenge first
@@ -22,8 +55,14 @@ int main(int argc, char *argv[]) {
     printf("Recover key from two 32-bit reader authentication answers only\n");
     printf("This version implements Moebius two different nonce solution (like the supercard)\n\n");
 
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        return mfkey_batch(argv[2], 7, mfkey32v2_crack, mfkey_batch_threads((argc > 4 && strcmp(argv[3], "-t") == 0) ? argv[4] : NULL));
+    }
+
     if (argc < 8) {
-        printf("syntax: %s <uid> <nt> <nr_0> <ar_0> <nt1> <nr_1> <ar_1>\n\n", argv[0]);
+        printf("syntax: %s <uid> <nt> <nr_0> <ar_0> <nt1> <nr_1> <ar_1>\n", argv[0]);
+        printf("        %s -f <file> [-t <threads>]\n", argv[0]);
+        printf("        file has one set per line:  uid nt nr_0 ar_0 nt1 nr_1 ar_1\n\n");
         return 1;
     }
 
@@ -47,7 +86,6 @@ int main(int argc, char *argv[]) {
     // Generate lfsr successors of the tag challenge
     printf("\nLFSR successors of the tag challenge:\n");
     uint32_t p64 = prng_successor(nt0, 64);
-    uint32_t p64b = prng_successor(nt1, 64);
 
     printf("  nt': %08x\n", p64);
     printf(" nt'': %08x\n", prng_successor(p64, 32));
@@ -57,21 +95,9 @@ int main(int argc, char *argv[]) {
     ks2 = ar0_enc ^ p64;
     printf("  ks2: %08x\n", ks2);
 
-    s = lfsr_recovery32(ar0_enc ^ p64, 0);
-
-    for (t = s; t->odd | t->even; ++t) {
-        lfsr_rollback_word(t, 0, 0);
-        lfsr_rollback_word(t, nr0_enc, 1);
-        lfsr_rollback_word(t, uid ^ nt0, 0);
-        crypto1_get_lfsr(t, &key);
-
-        crypto1_word(t, uid ^ nt1, 0);
-        crypto1_word(t, nr1_enc, 1);
-        if (ar1_enc == (crypto1_word(t, 0, 0) ^ p64b)) {
-            printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
-            break;
-        }
+    uint32_t v[7] = { uid, nt0, nr0_enc, ar0_enc, nt1, nr1_enc, ar1_enc };
+    if (mfkey32v2_crack(v, &key)) {
+        printf("\nFound Key: [%012" PRIx64 "]\n\n", key);
     }
-    free(s);
     return 0;
 }
@@ -6,6 +6,26 @@
 #include <stdlib.h>
 #include "crapto1/crapto1.h"
 #include "util_posix.h"
+#include "mfkey_batch.h"
+
+// uid, nt, {nr}, {ar}, {at}
+static bool mfkey64_crack(const uint32_t *v, uint64_t *key) {
+    uint32_t uid = v[0], nt = v[1], nr_enc = v[2];
+    uint32_t p64 = prng_successor(nt, 64);
+
+    struct Crypto1State *revstate = lfsr_recovery64(v[3] ^ p64, v[4] ^ prng_successor(p64, 32));
+    if (!revstate) {
+        return false;
+    }
+
+    lfsr_rollback_word(revstate, 0, 0);
+    lfsr_rollback_word(revstate, 0, 0);
+    lfsr_rollback_word(revstate, nr_enc, 1);
+    lfsr_rollback_word(revstate, uid ^ nt, 0);
+    crypto1_get_lfsr(revstate, key);
+    crypto1_destroy(revstate);
+    return true;
+}
 
 int main(int argc, char *argv[]) {
     struct Crypto1State *revstate;
@@ -21,8 +41,14 @@ int main(int argc, char *argv[]) {
     printf("MIFARE Classic key recovery - based 64 bits of keystream\n");
     printf("Recover key from only one complete authentication!\n\n");
 
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        return mfkey_batch(argv[2], 5, mfkey64_crack, mfkey_batch_threads((argc > 4 && strcmp(argv[3], "-t") == 0) ? argv[4] : NULL));
+    }
+
     if (argc < 6) {
-        printf(" syntax: %s <uid> <nt> <{nr}> <{ar}> <{at}> [enc...]\n\n", argv[0]);
+        printf(" syntax: %s <uid> <nt> <{nr}> <{ar}> <{at}> [enc...]\n", argv[0]);
+        printf("         %s -f <file> [-t <threads>]\n", argv[0]);
+        printf("         file has one set per line:  uid nt {nr} {ar} {at}\n\n");
         return 1;
     }
 
@@ -0,0 +1,221 @@
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef __WIN32
+#include "windows.h"
+#else
+#include "unistd.h"
+#endif
+
+#include "pthread.h"
+#include "mfkey_batch.h"
+
+
+#define MAX_THREADS             256
+#define JOB_CHUNK               1024
+
+
+typedef struct {
+    uint32_t args[MFKEY_BATCH_MAX_ARGS];
+    uint32_t line;
+    uint64_t key;
+    bool     found;
+} batch_job_t;
+
+typedef struct {
+    batch_job_t   *jobs;
+    size_t         count;
+    size_t         next;
+    mfkey_batch_fn fn;
+} batch_ctx_t;
+
+// every worker takes the next unsolved line, a slow line doesn't hold back the others
+static void *batch_worker(void *arg) {
+    batch_ctx_t *ctx = (batch_ctx_t *)arg;
+
+    for (;;) {
+        size_t i = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED);
+        if (i >= ctx->count) {
+            break;
+        }
+        batch_job_t *job = &ctx->jobs[i];
+        job->found = ctx->fn(job->args, &job->key);
+    }
+    return NULL;
+}
+
+static int num_cpus(void) {
+#ifdef __WIN32
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+// thread count from the command line, 0 or nothing means one per CPU
+int mfkey_batch_threads(const char *arg) {
+    int threads = (arg) ? atoi(arg) : 0;
+    if (threads <= 0) {
+        threads = num_cpus();
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+    return threads;
+}
+
+// one set of hex values per line, separated by spaces or commas. Empty lines and # comments are skipped
+static batch_job_t *load_jobs(const char *filename, uint8_t nargs, size_t *count) {
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        printf("Cannot open %s\n", filename);
+        return NULL;
+    }
+
+    batch_job_t *jobs = NULL;
+    size_t size = 0;
+    uint32_t lineno = 0;
+    char line[512];
+
+    *count = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *comment = strchr(line, '#');
+        if (comment) {
+            *comment = '\0';
+        }
+
+        uint32_t args[MFKEY_BATCH_MAX_ARGS];
+        uint8_t n = 0;
+        bool bad = false;
+        for (char *tok = strtok(line, " \t,\r\n"); tok; tok = strtok(NULL, " \t,\r\n")) {
+            char *end;
+            unsigned long v = strtoul(tok, &end, 16);
+            if (*end != '\0' || n == nargs) {
+                bad = true;
+                break;
+            }
+            args[n++] = (uint32_t)v;
+        }
+
+        if (n == 0 && bad == false) {
+            continue;
+        }
+
+        if (bad || n != nargs) {
+            printf("line %u: expected %u hex values, skipped\n", lineno, nargs);
+            continue;
+        }
+
+        if (*count == size) {
+            size += JOB_CHUNK;
+            batch_job_t *tmp = realloc(jobs, size * sizeof(batch_job_t));
+            if (!tmp) {
+                printf("Memory allocation error\n");
+                free(jobs);
+                fclose(f);
+                return NULL;
+            }
+            jobs = tmp;
+        }
+
+        batch_job_t *job = &jobs[(*count)++];
+        memcpy(job->args, args, sizeof(args));
+        job->line = lineno;
+        job->key = 0;
+        job->found = false;
+    }
+
+    fclose(f);
+    return jobs;
+}
+
+static int compar_key(const void *a, const void *b) {
+    uint64_t ka = *(const uint64_t *)a;
+    uint64_t kb = *(const uint64_t *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+int mfkey_batch(const char *filename, uint8_t nargs, mfkey_batch_fn fn, int threads) {
+    size_t count = 0;
+    batch_job_t *jobs = load_jobs(filename, nargs, &count);
+    if (!jobs) {
+        return 1;
+    }
+
+    if ((size_t)threads > count) {
+        threads = (count) ? (int)count : 1;
+    }
+
+    printf("Cracking %zu nonce sets with %d thread%s\n\n", count, threads, (threads > 1) ? "s" : "");
+
+    batch_ctx_t ctx = { .jobs = jobs, .count = count, .next = 0, .fn = fn };
+
+    pthread_t thread_id[MAX_THREADS];
+    int started = 0;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&thread_id[started], NULL, batch_worker, &ctx) == 0) {
+            started++;
+        }
+    }
+
+    // no thread at all, do it here
+    if (started == 0) {
+        batch_worker(&ctx);
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(thread_id[i], NULL);
+    }
+
+    uint64_t *keys = calloc(count + 1, sizeof(uint64_t));
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (jobs[i].found) {
+            printf("line %u: [%012" PRIx64 "]\n", jobs[i].line, jobs[i].key);
+            if (keys) {
+                keys[found] = jobs[i].key;
+            }
+            found++;
+        } else {
+            printf("line %u: no key\n", jobs[i].line);
+        }
+    }
+
+    printf("\nKeys found for %zu of %zu nonce sets\n", found, count);
+
+    // the same key usually comes back from many sets, list each one once
+    if (keys && found) {
+        qsort(keys, found, sizeof(uint64_t), compar_key);
+
+        size_t unique = 0;
+        for (size_t i = 0; i < found; i++) {
+            unique += (i == 0 || keys[i] != keys[i - 1]);
+        }
+
+        printf("%zu unique key%s:\n", unique, (unique > 1) ? "s" : "");
+        for (size_t i = 0; i < found;) {
+            size_t hits = 1;
+            while (i + hits < found && keys[i + hits] == keys[i]) {
+                hits++;
+            }
+            printf("  [%012" PRIx64 "]  %zu set%s\n", keys[i], hits, (hits > 1) ? "s" : "");
+            i += hits;
+        }
+    }
+    printf("\n");
+
+    free(keys);
+    free(jobs);
+    return (found) ? 0 : 1;
+}
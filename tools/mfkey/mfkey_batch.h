@@ -0,0 +1,15 @@
+#ifndef MFKEY_BATCH_H__
+#define MFKEY_BATCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MFKEY_BATCH_MAX_ARGS    8
+
+// recover a key from one line of nonce values, false if there is none
+typedef bool (*mfkey_batch_fn)(const uint32_t *args, uint64_t *key);
+
+int mfkey_batch_threads(const char *arg);
+int mfkey_batch(const char *filename, uint8_t nargs, mfkey_batch_fn fn, int threads);
+
+#endif
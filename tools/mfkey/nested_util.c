@@ -4,6 +4,7 @@
 #include <time.h>
 #include <inttypes.h>
 #include <ctype.h>
+#include <stdbool.h>
 #include "parity.h"
 
 #ifdef __WIN32
@@ -18,246 +19,319 @@
 
 #define MEM_CHUNK               10000
 #define TRY_KEYS                50
+#define THREAD_MAX              64
+
+// 48 bit keys, four passes of 12 bits
+#define RADIX_BITS              12
+#define RADIX_PASSES            4
 
 
 typedef struct {
     uint64_t       key;
-    int            count;
+    uint32_t       count;
 } countKeys;
 
+// keys of one nonce, sorted and unique
 typedef struct {
-    NtpKs1 *pNK;
-    uint32_t authuid;
-
     uint64_t *keys;
     uint32_t keyCount;
+} NonceKeys;
 
-    uint32_t startPos;
-    uint32_t endPos;
+typedef struct {
+    NtpKs1 *pNK;
+    uint32_t sizePNK;
+    uint32_t authuid;
+    NonceKeys *nk;
+    uint32_t next;
 } RecPar;
 
-inline static int compar_int(const void *a, const void *b) {
-    if (*(uint64_t *)b == *(uint64_t *)a) return 0;
-    if (*(uint64_t *)b < * (uint64_t *)a) return 1;
-    return -1;
+static int num_cpus(void) {
+#ifdef __WIN32
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#else
+    return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
 }
 
-// Compare countKeys structure
+// Most candidates first, the key decides between equal counts so the order doesn't depend on the threads
 static int compar_special_int(const void *a, const void *b) {
-    return (((countKeys *)b)->count - ((countKeys *)a)->count);
+    const countKeys *ka = (const countKeys *)a;
+    const countKeys *kb = (const countKeys *)b;
+    if (ka->count != kb->count) {
+        return (ka->count < kb->count) ? 1 : -1;
+    }
+    return (ka->key > kb->key) - (ka->key < kb->key);
 }
 
-// keys qsort and unique.
-static countKeys *uniqsort(uint64_t *possibleKeys, uint32_t size) {
-    unsigned int i, j = 0;
-    int count = 0;
-    countKeys *our_counts;
-
-    qsort(possibleKeys, size, sizeof(uint64_t), compar_int);
-
-    our_counts = calloc(size, sizeof(countKeys));
-    if (our_counts == NULL) {
-        printf("Memory allocation error for our_counts");
+// LSD radix sort, tmp must hold size keys
+static void radix_sort(uint64_t *keys, uint64_t *tmp, uint32_t size) {
+    uint32_t *counts = malloc((1 << RADIX_BITS) * sizeof(uint32_t));
+    if (counts == NULL) {
+        printf("Memory allocation error for radix counts");
         exit(EXIT_FAILURE);
     }
 
-    for (i = 0; i < size; i++) {
-        if (possibleKeys[i + 1] == possibleKeys[i]) {
-            count++;
-        } else {
-            our_counts[j].key = possibleKeys[i];
-            our_counts[j].count = count;
-            j++;
-            count = 0;
+    uint64_t *src = keys, *dst = tmp;
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        int shift = pass * RADIX_BITS;
+
+        memset(counts, 0, (1 << RADIX_BITS) * sizeof(uint32_t));
+        for (uint32_t i = 0; i < size; i++) {
+            counts[(src[i] >> shift) & ((1 << RADIX_BITS) - 1)]++;
+        }
+
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < (1 << RADIX_BITS); i++) {
+            uint32_t c = counts[i];
+            counts[i] = sum;
+            sum += c;
+        }
+
+        for (uint32_t i = 0; i < size; i++) {
+            dst[counts[(src[i] >> shift) & ((1 << RADIX_BITS) - 1)]++] = src[i];
         }
+
+        uint64_t *t = src;
+        src = dst;
+        dst = t;
     }
-    qsort(our_counts, j, sizeof(countKeys), compar_special_int);
-    return (our_counts);
+
+    // even number of passes, the result is back in keys
+    free(counts);
 }
 
-// nested decrypt
-static void *nested_revover(void *args) {
-    struct Crypto1State *revstate, * revstate_start = NULL;
+// nested decrypt of one nonce, keys come back sorted and unique
+static bool nested_recover_one(const NtpKs1 *pk, uint32_t authuid, NonceKeys *nk) {
     uint64_t lfsr = 0;
-    uint32_t i, kcount = 0;
-    bool is_ok = true;
+    uint32_t size = 0, kcount = 0;
+    uint64_t *keys = NULL;
 
-    RecPar *rp = (RecPar *)args;
+    uint32_t nt_probe = pk->ntp ^ authuid;
 
-    rp->keyCount = 0;
-    rp->keys = NULL;
+    // And finally recover the first 32 bits of the key
+    struct Crypto1State *revstate_start = lfsr_recovery32(pk->ks1, nt_probe);
+    if (revstate_start == NULL) {
+        return false;
+    }
 
-    //printf("Start pos is %d, End pos is %d\r\n", rp->startPos, rp->endPos);
+    for (struct Crypto1State *revstate = revstate_start; (revstate->odd != 0x0) || (revstate->even != 0x0); revstate++) {
+        lfsr_rollback_word(revstate, nt_probe, 0);
+        crypto1_get_lfsr(revstate, &lfsr);
+        if (kcount == size) {
+            size += MEM_CHUNK;
+            void *tmp = realloc(keys, size * sizeof(uint64_t));
+            if (tmp == NULL) {
+                printf("Memory allocation error for pk->possibleKeys");
+                free(keys);
+                free(revstate_start);
+                return false;
+            }
+            keys = (uint64_t *)tmp;
+        }
+        keys[kcount++] = lfsr;
+    }
+    free(revstate_start);
+
+    if (kcount) {
+        uint64_t *tmp = malloc(kcount * sizeof(uint64_t));
+        if (tmp == NULL) {
+            printf("Memory allocation error for radix sort");
+            free(keys);
+            return false;
+        }
+        radix_sort(keys, tmp, kcount);
+        free(tmp);
+
+        uint32_t j = 1;
+        for (uint32_t i = 1; i < kcount; i++) {
+            if (keys[i] != keys[j - 1]) {
+                keys[j++] = keys[i];
+            }
+        }
+        kcount = j;
+
+        // give back what the chunked growth left over
+        void *shrunk = realloc(keys, kcount * sizeof(uint64_t));
+        if (shrunk) {
+            keys = shrunk;
+        }
+    }
 
-    for (i = rp->startPos; i < rp->endPos; i++) {
-        uint32_t nt_probe = rp->pNK[i].ntp ^ rp->authuid;
-        uint32_t ks1 = rp->pNK[i].ks1;
+    nk->keys = keys;
+    nk->keyCount = kcount;
+    return true;
+}
 
-        /*
-        printf("     ntp = %"PRIu32"\r\n", nt_probe);
-        printf("     ks1 = %"PRIu32"\r\n", ks1);
-        printf("\r\n");
-        */
+// worker of the pool, takes the next nonce until none is left
+static void *nested_revover(void *args) {
+    RecPar *rp = (RecPar *)args;
 
-        // And finally recover the first 32 bits of the key
-        revstate = lfsr_recovery32(ks1, nt_probe);
-        if (revstate_start == NULL) {
-            revstate_start = revstate;
+    for (;;) {
+        uint32_t i = __atomic_fetch_add(&rp->next, 1, __ATOMIC_RELAXED);
+        if (i >= rp->sizePNK) {
+            break;
         }
+        // a failed nonce just contributes no keys
+        nested_recover_one(&rp->pNK[i], rp->authuid, &rp->nk[i]);
+    }
+    return NULL;
+}
+
+// Walk all sorted nonce lists at once and count in how many of them every key shows up.
+// Keys seen for two or more nonces are kept, nothing else is buffered.
+static countKeys *count_keys(NonceKeys *nk, uint32_t sizePNK, uint32_t *found) {
+    uint32_t *pos = calloc(sizePNK, sizeof(uint32_t));
+    countKeys *ck = NULL;
+    uint32_t size = 0;
+
+    *found = 0;
+    if (pos == NULL) {
+        return NULL;
+    }
 
-        while ((revstate->odd != 0x0) || (revstate->even != 0x0)) {
-            lfsr_rollback_word(revstate, nt_probe, 0);
-            crypto1_get_lfsr(revstate, &lfsr);
-            if (((kcount % MEM_CHUNK) == 0) || (kcount >= rp->keyCount)) {
-                rp->keyCount += MEM_CHUNK;
-                // printf("New chunk by %d, sizeof %lu\n", kcount, rp->keyCount * sizeof(uint64_t));
-                void *tmp = realloc(rp->keys, rp->keyCount * sizeof(uint64_t));
-                if (tmp == NULL) {
-                    printf("Memory allocation error for pk->possibleKeys");
-                    rp->keyCount = 0;
-                    is_ok = false;
-                    break;
-                }
-                rp->keys = (uint64_t *)tmp;
+    for (;;) {
+        // smallest key at the head of any list
+        bool any = false;
+        uint64_t key = 0;
+        for (uint32_t i = 0; i < sizePNK; i++) {
+            if (pos[i] < nk[i].keyCount && (any == false || nk[i].keys[pos[i]] < key)) {
+                key = nk[i].keys[pos[i]];
+                any = true;
             }
-            rp->keys[kcount] = lfsr;
-            kcount++;
-            revstate++;
         }
-        --kcount;
-        free(revstate_start);
-        revstate_start = NULL;
-        if (!is_ok) {
+        if (any == false) {
             break;
         }
-    }
-    if (is_ok) {
-        if (kcount != 0) {
-            rp->keyCount = kcount;
-            void *tmp = (uint64_t *)realloc(rp->keys, rp->keyCount * sizeof(uint64_t));
+
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < sizePNK; i++) {
+            if (pos[i] < nk[i].keyCount && nk[i].keys[pos[i]] == key) {
+                pos[i]++;
+                count++;
+            }
+        }
+
+        if (count < 2) {
+            continue;
+        }
+
+        if (*found == size) {
+            size += MEM_CHUNK;
+            void *tmp = realloc(ck, size * sizeof(countKeys));
             if (tmp == NULL) {
-                printf("Memory allocation error for pk->possibleKeys");
-                rp->keyCount = 0;
-                free(rp->keys);
-            } else {
-                rp->keys = tmp;
+                printf("Memory allocation error for our_counts");
+                free(ck);
+                free(pos);
+                *found = 0;
+                return NULL;
             }
+            ck = tmp;
         }
-    } else {
-        rp->keyCount = 0;
-        free(rp->keys);
+        ck[*found].key = key;
+        ck[*found].count = count;
+        (*found)++;
     }
-    return NULL;
+
+    free(pos);
+    if (*found) {
+        qsort(ck, *found, sizeof(countKeys), compar_special_int);
+    }
+    return ck;
 }
 
 uint64_t *nested(NtpKs1 *pNK, uint32_t sizePNK, uint32_t authuid, uint32_t *keyCount) {
-#define THREAD_MAX 4
 
     *keyCount = 0;
-    uint32_t i, j, manyThread;
+    uint32_t i;
     uint64_t *keys = (uint64_t *)NULL;
 
-    manyThread = THREAD_MAX;
-    if (manyThread > sizePNK) {
-        manyThread = sizePNK;
+    if (sizePNK == 0) {
+        return NULL;
     }
 
-    // pthread handle
-    pthread_t *threads = calloc(sizePNK, sizeof(pthread_t));
-    if (threads == NULL)  return NULL;
+    // a fixed pool, every thread picks the next nonce when it is done with one
+    int manyThread = num_cpus();
+    if (manyThread < 1) {
+        manyThread = 1;
+    }
+    if (manyThread > THREAD_MAX) {
+        manyThread = THREAD_MAX;
+    }
+    if ((uint32_t)manyThread > sizePNK) {
+        manyThread = sizePNK;
+    }
 
-    // Param
-    RecPar *pRPs = calloc(sizePNK, sizeof(RecPar));
-    if (pRPs == NULL) {
-        free(threads);
+    NonceKeys *nk = calloc(sizePNK, sizeof(NonceKeys));
+    if (nk == NULL) {
         return NULL;
     }
 
-    uint32_t average = sizePNK / manyThread;
-    uint32_t modules = sizePNK % manyThread;
-
-    // Assign tasks
-    for (i = 0, j = 0; i < manyThread; i++, j += average) {
-        pRPs[i].pNK = pNK;
-        pRPs[i].authuid = authuid;
-        pRPs[i].startPos = j;
-        pRPs[i].endPos = j + average;
-        pRPs[i].keys = NULL;
-        // last thread can decrypt more pNK
-        if (i == (manyThread - 1) && modules > 0) {
-            (pRPs[i].endPos) += modules;
+    RecPar rp = { .pNK = pNK, .sizePNK = sizePNK, .authuid = authuid, .nk = nk, .next = 0 };
+
+    // pthread handle
+    pthread_t threads[THREAD_MAX];
+    int started = 0;
+    for (i = 0; i < (uint32_t)manyThread; i++) {
+        if (pthread_create(&threads[started], NULL, nested_revover, &rp) == 0) {
+            started++;
         }
-        pthread_create(&threads[i], NULL, nested_revover, &(pRPs[i]));
     }
 
-    for (i = 0; i < manyThread; i++) {
+    // no thread at all, do it here
+    if (started == 0) {
+        nested_revover(&rp);
+    }
+
+    for (i = 0; i < (uint32_t)started; i++) {
         // wait thread exit...
         pthread_join(threads[i], NULL);
-        *keyCount += pRPs[i].keyCount;
     }
-    free(threads);
 
-    if (*keyCount == 0) {
+    uint32_t total = 0;
+    for (i = 0; i < sizePNK; i++) {
+        total += nk[i].keyCount;
+    }
+
+    if (total == 0) {
         printf("Didn't recover any keys.\r\n");
-        free(pRPs);
+        free(nk);
         return NULL;
     }
 
-    keys = calloc((*keyCount) * sizeof(uint64_t), sizeof(uint8_t));
-    if (keys == NULL) {
-        printf("Cannot allocate memory to merge keys.\r\n");
-        free(pRPs);
-        return NULL;
+    uint32_t found = 0;
+    countKeys *ck = count_keys(nk, sizePNK, &found);
+
+    for (i = 0; i < sizePNK; i++) {
+        free(nk[i].keys);
     }
+    free(nk);
 
-    for (i = 0, j = 0; i < manyThread; i++) {
-        if (pRPs[i].keyCount > 0) {
-            // printf("The thread %d recover %d keys.\r\n", i, pRPs[i].keyCount);
-            if (pRPs[i].keys != NULL) {
-                memcpy(
-                    keys + j,
-                    pRPs[i].keys,
-                    pRPs[i].keyCount * sizeof(uint64_t)
-                );
-                j += pRPs[i].keyCount;
-                free(pRPs[i].keys);
-            }
-        }
+    if (found == 0) {
+        free(ck);
+        return NULL;
     }
 
-    countKeys *ck = uniqsort(keys, *keyCount);
-    free(keys);
-    keys = (uint64_t *)NULL;
-    *keyCount = 0;
+    // We don't known this key, try to break it
+    // This key can be found here two or more times
+    if (found > TRY_KEYS) {
+        found = TRY_KEYS;
+    }
 
-    if (ck == NULL) {
-        printf("Cannot allocate memory for ck on uniqsort.");
+    keys = calloc(found, sizeof(uint64_t));
+    if (keys == NULL) {
+        printf("Cannot allocate memory for keys on merge.");
         free(ck);
-        free(pRPs);
         return NULL;
     }
 
-    for (i = 0; i < TRY_KEYS; i++) {
-        // We don't known this key, try to break it
-        // This key can be found here two or more times
-        if (ck[i].count > 0) {
-            *keyCount += 1;
-            void *tmp = realloc(keys, sizeof(uint64_t) * (*keyCount));
-            if (tmp == NULL) {
-                printf("Cannot allocate memory for keys on merge.");
-                free(ck);
-                free(keys);
-                free(pRPs);
-                return NULL;
-            }
-
-            keys = tmp;
-            keys[*keyCount - 1] = ck[i].key;
-        }
+    for (i = 0; i < found; i++) {
+        keys[i] = ck[i].key;
     }
+    *keyCount = found;
 
     free(ck);
-    free(pRPs);
     return keys;
 }
 
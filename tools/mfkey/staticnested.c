@@ -89,7 +89,16 @@ __attribute__((force_align_arg_pointer))
     return statelist->head.slhead;
 }
 
-static void pm3_staticnested(uint32_t uid, uint32_t nt1, uint32_t ks1,  uint32_t nt2, uint32_t ks2) {
+// candidates go to the dictionary file as soon as they are known
+static void print_key(FILE *dict, uint32_t n, uint64_t key64) {
+    printf("[ %u ] " _GREEN_("%012" PRIx64) "\n", n, key64);
+    if (dict) {
+        fprintf(dict, "%012" PRIX64 "\n", key64);
+        fflush(dict);
+    }
+}
+
+static void pm3_staticnested(FILE *dict, uint32_t uid, uint32_t nt1, uint32_t ks1,  uint32_t nt2, uint32_t ks2) {
 
     StateList_t statelists[2];
     struct Crypto1State *p1, * p2, * p3, * p4;
@@ -166,7 +175,7 @@ static void pm3_staticnested(uint32_t uid, uint32_t nt1, uint32_t ks1,  uint32_t
         for (uint32_t k = 0; k < keycnt; k++) {
             uint64_t key64 = 0;
             crypto1_get_lfsr(statelists[0].head.slhead + k, &key64);
-            printf("[ %u ] " _GREEN_("%012" PRIx64) "\n", k + 1, key64);
+            print_key(dict, k + 1, key64);
         }
     }
 }
@@ -178,12 +187,14 @@ static int usage(void) {
     printf("It uses the nonce, keystream sent from pm3 device to client.\n");
     printf("ie: NOT the CU data which is data in the trace.\n");
     printf("\n");
-    printf("syntax:  staticnested <uid> <nt1> <ks1> <nt2> <ks2>\n\n");
+    printf("syntax:  staticnested <uid> <nt1> <ks1> <nt2> <ks2> [<dictionary file>]\n\n");
+    printf("  key candidates are also appended to the dictionary file, one per line\n\n");
     printf("samples:\n");
     printf("\n");
     printf("  ./staticnested 461dce03 7eef3586 ffb02eda 322bc14d ffc875ca\n");
     printf("  ./staticnested 461dce03 7eef3586 1fb6b496 322bc14d 1f4eebdd\n");
     printf("  ./staticnested 461dce03 7eef3586 7fa28c7e 322bc14d 7f62b3d6\n");
+    printf("  ./staticnested 461dce03 7eef3586 7fa28c7e 322bc14d 7f62b3d6 keys.dic\n");
     printf("\n");
     return 1;
 }
@@ -192,7 +203,16 @@ int main(int argc, char *const argv[]) {
 
     printf("\nMIFARE Classic static nested key recovery\n\n");
 
-    if (argc < 5) return usage();
+    if (argc < 6) return usage();
+
+    FILE *dict = NULL;
+    if (argc > 6) {
+        dict = fopen(argv[6], "a");
+        if (dict == NULL) {
+            printf("Cannot open %s\n", argv[6]);
+            return 1;
+        }
+    }
 
     printf("Init...\n");
     NtpKs1 *pNK = calloc(2, sizeof(NtpKs1));
@@ -222,14 +242,18 @@ int main(int argc, char *const argv[]) {
     if (key_count) {
         printf("Ultra Static nested --> Found " _YELLOW_("%u") " key candidates\n", key_count);
         for (uint32_t k = 0; k < key_count; k++) {
-            printf("[ %u ] " _GREEN_("%012" PRIx64) "\n", k + 1, keys[k]);
+            print_key(dict, k + 1, keys[k]);
         }
     }
 
-    pm3_staticnested(uid, pNK[0].ntp, pNK[0].ks1, pNK[1].ntp, pNK[1].ks1);
+    pm3_staticnested(dict, uid, pNK[0].ntp, pNK[0].ks1, pNK[1].ntp, pNK[1].ks1);
 
     fflush(stdout);
     free(keys);
+    free(pNK);
+    if (dict) {
+        fclose(dict);
+    }
     exit(EXIT_SUCCESS);
 error:
     exit(EXIT_FAILURE);
@@ -13,15 +13,28 @@
 """
 
 import serial
+import struct
 from smartcard.util import toHexString, toBytes
 from smartcard.CardType import AnyCardType
 from smartcard.CardRequest import CardRequest
 
 ser = serial.Serial('/dev/rfcomm0')  # open Proxmark3 Bluetooth port
 
-def pd(data):
-        rapdu = map(ord, data)
-        return rapdu
+# reblay link frame: len, type, seq, card us (LE16), device us (LE16), payload
+REBLAY_PING = 0x01
+REBLAY_CMD = 0x02
+REBLAY_RSP = 0x03
+REBLAY_DONE = 0x04
+
+
+def send_frame(ftype, seq, payload=b''):
+        ser.write(struct.pack('<BBBHH', len(payload), ftype, seq, 0, 0) + bytes(payload))
+
+
+def read_frame():
+        flen, ftype, seq, card_us, dev_us = struct.unpack('<BBBHH', ser.read(7))
+        return ftype, seq, card_us, dev_us, list(ser.read(flen))
+
 
 apdu = [
         [0x6F, 0x23, 0x84, 0x0E, 0x32, 0x50, 0x41, 0x59, 0x2E, 0x53, 0x59, 0x53, 0x2E, 0x44, 0x44, 0x46, 0x30, 0x31, 0xA5, 0x11, 0xBF, 0x0C, 0x0E, 0x61, 0x0C, 0x4F, 0x07, 0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10, 0x87, 0x01, 0x01, 0x90, 0x00],
@@ -34,24 +47,18 @@ apdu = [
 
 print('Testing code: bluetooth has to be connected with the right rfcomm port!')
 print('Waiting for data...')
-initd = ser.read(1)
-
-bufferlen = pd(initd)[0]
-rping = ser.read(bufferlen)
-ping = pd(rping)
 
+ftype, seq, card_us, dev_us, cmd = read_frame()
 print('Terminal command:'),
-print(toHexString(ping))
+print(toHexString(cmd))
 
 for x in apdu:
         print('Sending cmd: '),
-        ser.write(x)
+        send_frame(REBLAY_RSP, seq, x)
         print(toHexString(x))
         print('--')
-
-        lenpk = ser.read(1) #first byte is the buffer length
-        bufferlen = pd(lenpk)[0]
-
-        buffer = pd(ser.read(bufferlen))
+        ftype, seq, card_us, dev_us, cmd = read_frame()
+        if (ftype == REBLAY_DONE):
+                break
         print('Terminal command:'),
-        print(toHexString(buffer))
+        print(toHexString(cmd))
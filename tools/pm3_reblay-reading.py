@@ -13,13 +13,27 @@
 """
 
 import serial
+import struct
+import time
 from smartcard.util import toHexString
 
 ser = serial.Serial('/dev/rfcomm0')  # open Proxmark3 Bluetooth port
 
-def pd(data):
-        rapdu = map(ord, data)
-        return rapdu
+# reblay link frame: len, type, seq, card us (LE16), device us (LE16), payload
+REBLAY_PING = 0x01
+REBLAY_CMD = 0x02
+REBLAY_RSP = 0x03
+REBLAY_DONE = 0x04
+
+
+def send_frame(ftype, seq, payload=b''):
+        ser.write(struct.pack('<BBBHH', len(payload), ftype, seq, 0, 0) + bytes(payload))
+
+
+def read_frame():
+        flen, ftype, seq, card_us, dev_us = struct.unpack('<BBBHH', ser.read(7))
+        return ftype, seq, card_us, dev_us, list(ser.read(flen))
+
 
 apdu = [
         [0x00, 0xA4, 0x04, 0x00, 0x0e, 0x32, 0x50, 0x41, 0x59, 0x2e, 0x53, 0x59, 0x53, 0x2e, 0x44, 0x44, 0x46, 0x30, 0x31, 0x00], # PPSE
@@ -30,13 +44,11 @@ apdu = [
 
 print('Testing code: bluetooth has to be connected with the right rfcomm port!')
 print('Waiting for data...')
-initd = ser.read(1)
-
-bufferlen = pd(initd)[0]
-rping = ser.read(bufferlen)
 
-ping = pd(rping)
-if (len(ping) == 7):
+ftype, seq, card_us, dev_us, ping = read_frame()
+if (ftype != REBLAY_PING):
+        print('expected a ping, got frame type %d' % ftype)
+elif (len(ping) == 7):
         print('UID:'),
         print(toHexString(ping[:4]))
         print('ATQA:'),
@@ -54,18 +66,17 @@ else:
         print('got ping, no sure what it means: '),
         print(ping)
 
-for x in apdu:
+for seq, x in enumerate(apdu, 1):
         print('Sending cmd: '),
-        ser.write(x)
+        send_frame(REBLAY_CMD, seq, x)
         print(toHexString(x))
-
-        lenpk = ser.read(1) #first byte is the buffer length
-        bufferlen = pd(lenpk)[0]
-
-        buffer = pd(ser.read(bufferlen))
+        t = time.time()
+        ftype, rseq, card_us, dev_us, buffer = read_frame()
+        rtt_us = int((time.time() - t) * 1000000)
         print('Card Response:'),
         print(toHexString(buffer))
+        print('round trip %u us,  card %u us,  device %u us,  link %d us' % (rtt_us, card_us, dev_us, rtt_us - dev_us))
         print('--')
 
-ser.write(b'1') #tell Proxmark3 that we finish the communication
+send_frame(REBLAY_DONE, 0)  # tell Proxmark3 that we finish the communication
 ser.close()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+
+# Load a columnar trace export, see `trace save --col`, without copying the columns.
+#
+#   pm3_tracecol.py mytrace.pm3col          -> summary
+#   pm3_tracecol.py mytrace.pm3col --csv    -> one line per record
+#
+# As a module, load() returns one dict of numpy arrays per row group, backed by the mmap.
+
+import mmap
+import struct
+import sys
+
+import numpy as np
+
+FILE_HDR = struct.Struct('<4sBBHII')
+GROUP_HDR = struct.Struct('<4sIII')
+
+
+def _col(buf, pos, dtype, count):
+    a = np.frombuffer(buf, dtype=dtype, count=count, offset=pos)
+    size = a.nbytes
+    return a, pos + size + (-size % 8)
+
+
+def load(filename):
+    with open(filename, 'rb') as f:
+        buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    magic, version, protocol, _, _, _ = FILE_HDR.unpack_from(buf, 0)
+    if magic != b'PM3C' or version != 1:
+        raise ValueError('%s is not a version 1 .pm3col file' % filename)
+
+    groups = []
+    pos = FILE_HDR.size
+    while pos + GROUP_HDR.size <= len(buf):
+        magic, rows, data_size, annot_size = GROUP_HDR.unpack_from(buf, pos)
+        if magic != b'PM3G':
+            raise ValueError('bad row group at offset %d' % pos)
+        pos += GROUP_HDR.size
+
+        g = {}
+        g['timestamp'], pos = _col(buf, pos, '<u4', rows)
+        g['duration'], pos = _col(buf, pos, '<u4', rows)
+        g['is_response'], pos = _col(buf, pos, 'u1', rows)
+        g['crc'], pos = _col(buf, pos, 'u1', rows)
+        g['data_offset'], pos = _col(buf, pos, '<u4', rows + 1)
+        g['data'], pos = _col(buf, pos, 'u1', data_size)
+        g['annot_offset'], pos = _col(buf, pos, '<u4', rows + 1)
+        g['annot'], pos = _col(buf, pos, 'u1', annot_size)
+        groups.append(g)
+
+    return protocol, groups
+
+
+def records(groups):
+    for g in groups:
+        for i in range(len(g['timestamp'])):
+            d = g['data'][g['data_offset'][i]:g['data_offset'][i + 1]]
+            a = g['annot'][g['annot_offset'][i]:g['annot_offset'][i + 1]]
+            yield (int(g['timestamp'][i]), int(g['duration'][i]), bool(g['is_response'][i]),
+                   int(g['crc'][i]), d.tobytes(), a.tobytes().decode('utf-8', 'replace'))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: %s <file.pm3col> [--csv]' % sys.argv[0])
+        return 1
+
+    protocol, groups = load(sys.argv[1])
+
+    if '--csv' in sys.argv[2:]:
+        print('timestamp,duration,src,crc,data,annotation')
+        for ts, dur, rsp, crc, data, annot in records(groups):
+            print('%d,%d,%s,%d,%s,"%s"' % (ts, dur, 'tag' if rsp else 'reader', crc, data.hex().upper(),
+                                           annot.replace('"', '""')))
+        return 0
+
+    rows = sum(len(g['timestamp']) for g in groups)
+    print('protocol %d, %d records in %d row groups' % (protocol, rows, len(groups)))
+    if rows:
+        crc = np.concatenate([g['crc'] for g in groups])
+        rsp = np.concatenate([g['is_response'] for g in groups])
+        print('reader frames %d, tag frames %d' % (np.count_nonzero(rsp == 0), np.count_nonzero(rsp)))
+        print('crc ok %d, crc bad %d' % (np.count_nonzero((crc == 1) | (crc == 3) | (crc == 4)),
+                                         np.count_nonzero(crc == 0)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())